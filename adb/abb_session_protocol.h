@@ -0,0 +1,42 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+// The abb_session: service runs any number of abb commands over one stream.
+//
+// The host sends a request per command, without waiting for the earlier ones to finish. The
+// device runs them concurrently and sends their output back as responses tagged with the id of
+// the request they belong to, interleaved in whatever order it is produced. The last response
+// of every command is a kIdExit one carrying its exit code. Commands get an empty stdin.
+
+// Followed by |length| bytes of arguments, each terminated by ABB_ARG_DELIMETER.
+struct AbbSessionRequest {
+    uint32_t id;
+    uint32_t length;
+};
+
+// Followed by |length| bytes of data. |kind| is ShellProtocol::kIdStdout, kIdStderr or kIdExit.
+struct AbbSessionResponse {
+    uint32_t id;
+    uint32_t kind;
+    uint32_t length;
+};
+
+// Largest request the device accepts.
+#define ABB_SESSION_MAX_REQUEST (64 * 1024)
@@ -204,6 +204,37 @@ std::string get_connection_string() {
     connection_properties.push_back(android::base::StringPrintf(
         "features=%s", FeatureSetToString(supported_features()).c_str()));
 
+#if !ADB_HOST
+    // Properties that host tools commonly look up, which the adb server caches so that they
+    // can be read without a round trip to the device. A device can add its own with
+    // ro.adb.banner_properties. These are best-effort: values that can't be represented in the
+    // banner are skipped, as is anything that would make the banner too long.
+    std::vector<std::string> cached_props = {
+        "ro.build.version.sdk",
+        "ro.build.version.release",
+        "ro.build.type",
+        "ro.product.cpu.abilist",
+    };
+    for (const std::string& prop :
+         android::base::Split(android::base::GetProperty("ro.adb.banner_properties", ""), ",")) {
+        if (prop.starts_with("ro.")) cached_props.push_back(prop);
+    }
+
+    size_t length = strlen(adb_device_banner) + 2 +
+                    android::base::Join(connection_properties, ';').size();
+    for (const std::string& prop : cached_props) {
+        std::string value = android::base::GetProperty(prop, "");
+        if (value.empty() || value.find_first_of(":;=") != std::string::npos ||
+            prop.find_first_of(":;=") != std::string::npos) {
+            continue;
+        }
+        std::string entry = prop + "=" + value;
+        if (length + entry.size() + 1 > MAX_PAYLOAD_V1) break;
+        length += entry.size() + 1;
+        connection_properties.push_back(std::move(entry));
+    }
+#endif
+
     return android::base::StringPrintf(
         "%s::%s", adb_device_banner,
         android::base::Join(connection_properties, ';').c_str());
@@ -243,6 +274,7 @@ void parse_banner(const std::string& banner, atransport* t) {
     // Reset the features list or else if the server sends no features we may
     // keep the existing feature set (http://b/24405971).
     t->SetFeatures("");
+    t->properties.clear();
 
     if (pieces.size() > 2) {
         const std::string& props = pieces[2];
@@ -264,6 +296,9 @@ void parse_banner(const std::string& banner, atransport* t) {
             } else if (key == "features") {
                 t->SetFeatures(value);
             }
+            if (key.starts_with("ro.")) {
+                t->properties[key] = value;
+            }
         }
     }
 
@@ -1032,6 +1067,22 @@ bool handle_host_request(const char* service, TransportType type, const char* se
         exit(0);
     }
 
+    // Traffic statistics for the selected transport, or for all of them if none was selected.
+    // This has to come before the "transport" prefix match below.
+    if (!strcmp(service, "transport-stats")) {
+        atransport* t = nullptr;
+        if (serial || transport_id || type != kTransportAny) {
+            std::string error;
+            t = acquire_one_transport(type, serial, transport_id, nullptr, &error);
+            if (t == nullptr) {
+                SendFail(reply_fd, error);
+                return true;
+            }
+        }
+        SendOkay(reply_fd, list_transport_stats(t));
+        return true;
+    }
+
     // "transport:" is used for switching transport with a specified serial number
     // "transport-usb:" is used for switching transport to the only USB transport
     // "transport-local:" is used for switching transport to the only local transport
@@ -1189,6 +1240,23 @@ bool handle_host_request(const char* service, TransportType type, const char* se
         return true;
     }
 
+    // Returns a property from the device's connection banner, if it sent that property.
+    if (!strncmp(service, "getprop:", strlen("getprop:"))) {
+        std::string error;
+        atransport* t = acquire_one_transport(type, serial, transport_id, nullptr, &error);
+        if (!t) {
+            SendFail(reply_fd, error);
+            return true;
+        }
+        auto it = t->properties.find(service + strlen("getprop:"));
+        if (it == t->properties.end()) {
+            SendFail(reply_fd, "property not cached");
+        } else {
+            SendOkay(reply_fd, it->second);
+        }
+        return true;
+    }
+
     // Indicates a new emulator instance has started.
     if (!strncmp(service, "emulator:", 9)) {
         int  port = atoi(service+9);
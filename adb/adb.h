@@ -154,12 +154,14 @@ asocket* daemon_service_to_socket(std::string_view name);
 
 #if !ADB_HOST
 unique_fd execute_binder_command(std::string_view command);
+unique_fd execute_binder_session();
 #endif
 
 #if !ADB_HOST
 int init_jdwp(void);
 asocket* create_jdwp_service_socket();
 asocket* create_jdwp_tracker_service_socket();
+asocket* create_jdwp_delta_tracker_service_socket();
 unique_fd create_jdwp_connection_fd(int jdwp_pid);
 #endif
 
@@ -25,6 +25,7 @@
 #include <sys/un.h>
 #endif
 
+#include <algorithm>
 #include <thread>
 
 #include <android-base/stringprintf.h>
@@ -129,6 +130,52 @@ bool WriteFdExactly(int fd, const void* buf, size_t len) {
     return true;
 }
 
+bool WritevFdExactly(int fd, adb_iovec* iov, int iovcnt) {
+    size_t len = 0;
+    for (int i = 0; i < iovcnt; ++i) {
+        len += iov[i].iov_len;
+    }
+
+    VLOG(RWX) << "writevx: fd=" << fd << " iovcnt=" << iovcnt << " len=" << len;
+
+    while (iovcnt > 0) {
+        // Skip past anything that has been written in full.
+        if (iov->iov_len == 0) {
+            ++iov;
+            --iovcnt;
+            continue;
+        }
+
+        ssize_t r = adb_writev(fd, iov, iovcnt);
+        if (r == -1) {
+            D("writevx: fd=%d error %d: %s", fd, errno, strerror(errno));
+            if (errno == EAGAIN) {
+                std::this_thread::yield();
+                continue;
+            } else if (errno == EPIPE) {
+                D("writevx: fd=%d disconnected", fd);
+                errno = 0;
+                return false;
+            } else {
+                return false;
+            }
+        }
+
+        size_t written = r;
+        while (written > 0) {
+            size_t n = std::min(written, iov->iov_len);
+            iov->iov_base = static_cast<char*>(iov->iov_base) + n;
+            iov->iov_len -= n;
+            written -= n;
+            if (iov->iov_len == 0) {
+                ++iov;
+                --iovcnt;
+            }
+        }
+    }
+    return true;
+}
+
 bool WriteFdExactly(int fd, const char* str) {
     return WriteFdExactly(fd, str, strlen(str));
 }
@@ -22,6 +22,7 @@
 #include <string>
 
 #include "adb_unique_fd.h"
+#include "sysdeps/uio.h"
 
 // Sends the protocol "OKAY" message.
 bool SendOkay(int fd);
@@ -68,6 +69,12 @@ bool ReadOrderlyShutdown(int fd);
 // is closed, errno will be set to 0.
 bool WriteFdExactly(int fd, const void* buf, size_t len);
 
+// Writes the contents of all of the buffers in iov to fd, in order, with as few system calls
+// as possible. iov is modified to track progress through partial writes.
+//
+// Returns false under the same conditions as WriteFdExactly.
+bool WritevFdExactly(int fd, adb_iovec* iov, int iovcnt);
+
 // Same as above, but for strings.
 bool WriteFdExactly(int fd, const char* s);
 bool WriteFdExactly(int fd, const std::string& s);
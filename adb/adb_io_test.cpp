@@ -26,6 +26,7 @@
 #include <unistd.h>
 
 #include <string>
+#include <thread>
 
 #include <android-base/file.h>
 
@@ -128,6 +129,54 @@ POSIX_TEST(io, WriteFdExactly_ENOSPC) {
     ASSERT_EQ(ENOSPC, errno);
 }
 
+POSIX_TEST(io, WritevFdExactly_whole) {
+    char foo[] = "foo";
+    char bar[] = "bar";
+    TemporaryFile tf;
+    ASSERT_NE(-1, tf.fd);
+
+    // Empty buffers in the middle should be skipped over.
+    adb_iovec iov[3];
+    iov[0].iov_base = foo;
+    iov[0].iov_len = strlen(foo);
+    iov[1].iov_base = bar;
+    iov[1].iov_len = 0;
+    iov[2].iov_base = bar;
+    iov[2].iov_len = strlen(bar);
+    ASSERT_TRUE(WritevFdExactly(tf.fd, iov, 3)) << strerror(errno);
+    ASSERT_EQ(0, lseek(tf.fd, 0, SEEK_SET));
+
+    std::string s;
+    ASSERT_TRUE(android::base::ReadFdToString(tf.fd, &s));
+    EXPECT_EQ("foobar", s);
+}
+
+POSIX_TEST(io, WritevFdExactly_partial) {
+    int fds[2];
+    ASSERT_EQ(0, pipe(fds));
+
+    // Large enough to overflow the pipe buffer, forcing short writes.
+    std::string header(24, 'h');
+    std::string payload(4 * 1024 * 1024, 'p');
+    std::string received;
+    std::thread reader([&]() {
+        received.resize(header.size() + payload.size());
+        ReadFdExactly(fds[0], &received[0], received.size());
+    });
+
+    adb_iovec iov[2];
+    iov[0].iov_base = &header[0];
+    iov[0].iov_len = header.size();
+    iov[1].iov_base = &payload[0];
+    iov[1].iov_len = payload.size();
+    ASSERT_TRUE(WritevFdExactly(fds[1], iov, 2)) << strerror(errno);
+    reader.join();
+    close(fds[0]);
+    close(fds[1]);
+
+    EXPECT_TRUE(received == header + payload);
+}
+
 POSIX_TEST(io, WriteFdExactly_string) {
   const char str[] = "Foobar";
   TemporaryFile tf;
@@ -25,6 +25,7 @@
 #include <unistd.h>
 
 #include <algorithm>
+#include <thread>
 #include <vector>
 
 #include <android-base/file.h>
@@ -374,3 +375,32 @@ void perror_exit(const char* fmt, ...) {
     error_exit_va(errno, fmt, va);
     va_end(va);
 }
+
+void WorkerPool::Run(std::function<void()> fn) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    queue_.push_back(std::move(fn));
+    if (queue_.size() > idle_ && threads_ < max_threads_) {
+        ++threads_;
+        std::thread([this]() { Work(); }).detach();
+    } else {
+        cv_.notify_one();
+    }
+}
+
+void WorkerPool::Work() {
+    adb_thread_setname(name_);
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+        ++idle_;
+        cv_.wait(lock, [this]() { return !queue_.empty(); });
+        --idle_;
+
+        std::function<void()> fn = std::move(queue_.front());
+        queue_.pop_front();
+
+        lock.unlock();
+        fn();
+        lock.lock();
+    }
+}
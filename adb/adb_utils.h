@@ -17,6 +17,8 @@
 #pragma once
 
 #include <condition_variable>
+#include <deque>
+#include <functional>
 #include <mutex>
 #include <string>
 #include <string_view>
@@ -93,6 +95,31 @@ class BlockingQueue {
     }
 };
 
+// Runs closures on up to max_threads threads of its own, started as they are needed. Closures
+// are queued while all of them are busy. The threads are never joined, so a WorkerPool must
+// outlive them: only ever create one with new, and never delete it.
+class WorkerPool {
+  public:
+    WorkerPool(std::string name, size_t max_threads)
+        : name_(std::move(name)), max_threads_(max_threads) {}
+
+    void Run(std::function<void()> fn);
+
+  private:
+    void Work();
+
+    const std::string name_;
+    const size_t max_threads_;
+
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::deque<std::function<void()>> queue_;
+    size_t threads_ = 0;
+    size_t idle_ = 0;
+
+    DISALLOW_COPY_AND_ASSIGN(WorkerPool);
+};
+
 std::string GetLogFilePath();
 
 inline std::string_view StripTrailingNulls(std::string_view str) {
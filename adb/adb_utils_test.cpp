@@ -21,7 +21,10 @@
 #include <userenv.h>
 #endif
 
+#include <atomic>
+#include <chrono>
 #include <string>
+#include <thread>
 
 #include <gtest/gtest.h>
 
@@ -225,3 +228,35 @@ TEST(adb_utils, ParseUint) {
     std::string_view substr = std::string_view(x).substr(0, std::to_string(UINT32_MAX).size());
     TestParseUint(substr, true, UINT32_MAX);
 }
+
+TEST(adb_utils, WorkerPool) {
+    static constexpr size_t kMaxThreads = 4;
+    static constexpr size_t kClosures = 32;
+    WorkerPool& pool = *new WorkerPool("test pool", kMaxThreads);
+
+    std::mutex mutex;
+    std::condition_variable cv;
+    size_t done = 0;
+    std::atomic<size_t> running(0);
+    std::atomic<size_t> most_running(0);
+
+    for (size_t i = 0; i < kClosures; ++i) {
+        pool.Run([&]() {
+            size_t now = ++running;
+            size_t most = most_running;
+            while (now > most && !most_running.compare_exchange_weak(most, now)) {
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+            --running;
+
+            std::lock_guard<std::mutex> lock(mutex);
+            ++done;
+            cv.notify_one();
+        });
+    }
+
+    std::unique_lock<std::mutex> lock(mutex);
+    ASSERT_TRUE(cv.wait_for(lock, std::chrono::seconds(10), [&]() { return done == kClosures; }));
+    EXPECT_GT(most_running, 1U);
+    EXPECT_LE(most_running, kMaxThreads);
+}
@@ -16,9 +16,16 @@
 
 #include "bugreport.h"
 
+#include <dirent.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
 
+#include <android-base/file.h>
 #include <android-base/strings.h>
 #include <android-base/test_utils.h>
 
@@ -464,3 +471,66 @@ TEST_F(BugreportTest, PullFails) {
     const char* args[] = {"bugreport", "file.zip"};
     ASSERT_EQ(1, br_.DoIt(2, args));
 }
+
+// Tests 'adb bugreport file' when the device streams the bugreport
+TEST_F(BugreportTest, OkStreaming) {
+    ExpectBugreportzVersion("1.2");
+    TemporaryDir td;
+    std::string dest_file =
+        android::base::StringPrintf("%s%cstreamed.zip", td.path, OS_PATH_SEPARATOR);
+
+    EXPECT_CALL(br_, SendShellCommand("bugreportz -s", false, _))
+        .WillOnce(DoAll(WithArg<2>(WriteOnStdout("PK\x03\x04")), WithArg<2>(WriteOnStdout("zip")),
+                        WithArg<2>(WriteOnStderr("dumpstate is slow\n")),
+                        WithArg<2>(ReturnCallbackDone(0))));
+
+    CaptureStderr();
+    std::string dest_arg = android::base::StringPrintf("%s%cstreamed", td.path, OS_PATH_SEPARATOR);
+    const char* args[] = {"bugreport", dest_arg.c_str()};
+    ASSERT_EQ(0, br_.DoIt(2, args));
+    ASSERT_THAT(GetCapturedStderr(), HasSubstr("dumpstate is slow"));
+
+    std::string content;
+    ASSERT_TRUE(android::base::ReadFileToString(dest_file, &content));
+    ASSERT_EQ("PK\x03\x04zip", content);
+    unlink(dest_file.c_str());
+}
+
+// Tests 'adb bugreport dir' when the device streams the bugreport
+TEST_F(BugreportTest, OkStreamingDirectory) {
+    ExpectBugreportzVersion("1.2");
+    TemporaryDir td;
+
+    EXPECT_CALL(br_, SendShellCommand("bugreportz -s", false, _))
+        .WillOnce(DoAll(WithArg<2>(WriteOnStdout("PK\x03\x04zip")),
+                        WithArg<2>(ReturnCallbackDone(0))));
+
+    const char* args[] = {"bugreport", td.path};
+    ASSERT_EQ(0, br_.DoIt(2, args));
+
+    std::unique_ptr<DIR, decltype(&closedir)> dir(opendir(td.path), closedir);
+    ASSERT_NE(nullptr, dir);
+    std::vector<std::string> names;
+    while (dirent* entry = readdir(dir.get())) {
+        if (android::base::StartsWith(entry->d_name, "bugreport-")) names.push_back(entry->d_name);
+    }
+    ASSERT_EQ(1U, names.size());
+    ASSERT_TRUE(android::base::EndsWith(names[0], ".zip"));
+    unlink((std::string(td.path) + OS_PATH_SEPARATOR + names[0]).c_str());
+}
+
+// Tests 'adb bugreport file' when streaming the bugreport fails half way
+TEST_F(BugreportTest, StreamingFails) {
+    ExpectBugreportzVersion("1.2");
+    TemporaryDir td;
+    std::string dest_file =
+        android::base::StringPrintf("%s%cstreamed.zip", td.path, OS_PATH_SEPARATOR);
+
+    EXPECT_CALL(br_, SendShellCommand("bugreportz -s", false, _))
+        .WillOnce(DoAll(WithArg<2>(WriteOnStdout("PK\x03\x04")),
+                        WithArg<2>(ReturnCallbackDone(666))));
+
+    const char* args[] = {"bugreport", dest_file.c_str()};
+    ASSERT_EQ(666, br_.DoIt(2, args));
+    ASSERT_NE(0, access(dest_file.c_str(), F_OK));
+}
@@ -45,9 +45,10 @@
 #include "socket_spec.h"
 #include "sysdeps/chrono.h"
 
-static TransportType __adb_transport = kTransportAny;
-static const char* __adb_serial = nullptr;
-static TransportId __adb_transport_id = 0;
+// The transport selection is per-thread so that adb --serials can drive several devices at once.
+static thread_local TransportType __adb_transport = kTransportAny;
+static thread_local const char* __adb_serial = nullptr;
+static thread_local TransportId __adb_transport_id = 0;
 
 static const char* __adb_server_socket_spec;
 
@@ -325,3 +326,8 @@ bool adb_get_feature_set(FeatureSet* feature_set, std::string* error) {
     feature_set->clear();
     return false;
 }
+
+bool adb_get_cached_property(const std::string& name, std::string* value) {
+    std::string error;
+    return adb_query(format_host_command(("getprop:" + name).c_str()), value, &error);
+}
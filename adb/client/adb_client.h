@@ -38,7 +38,7 @@ bool adb_command(const std::string& service);
 bool adb_query(const std::string& service, std::string* _Nonnull result,
                std::string* _Nonnull error);
 
-// Set the preferred transport to connect to.
+// Set the preferred transport to connect to. This only affects the calling thread.
 void adb_set_transport(TransportType type, const char* _Nullable serial, TransportId transport_id);
 void adb_get_transport(TransportType* _Nullable type, const char* _Nullable* _Nullable serial,
                        TransportId* _Nullable transport_id);
@@ -62,3 +62,9 @@ std::string format_host_command(const char* _Nonnull command);
 
 // Get the feature set of the current preferred transport.
 bool adb_get_feature_set(FeatureSet* _Nonnull feature_set, std::string* _Nonnull error);
+
+// Gets a property of the current preferred transport from the adb server's cache of the
+// device's connection banner, without a round trip to the device. Returns false if it isn't
+// cached (for example because the device or server is too old), in which case the caller
+// should fall back to asking the device.
+bool adb_get_cached_property(const std::string& name, std::string* _Nonnull value);
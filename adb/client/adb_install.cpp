@@ -405,10 +405,50 @@ int install_multiple_app(int argc, const char** argv) {
         install_cmd = "exec:cmd package";
     }
 
+    bool use_fastdeploy = false;
+    bool use_localagent = false;
     std::string cmd = android::base::StringPrintf("%s install-create -S %" PRIu64,
                                                   install_cmd.c_str(), total_size);
     for (int i = 1; i < first_apk; i++) {
-        cmd += " " + escape_arg(argv[i]);
+        if (!strcmp(argv[i], "--fastdeploy")) {
+            use_fastdeploy = true;
+        } else if (!strcmp(argv[i], "--no-fastdeploy")) {
+            use_fastdeploy = false;
+#ifndef _WIN32
+        } else if (!strcmp(argv[i], "--local-agent")) {
+            use_localagent = true;
+#endif
+        } else {
+            cmd += " " + escape_arg(argv[i]);
+        }
+    }
+
+    // With fast deploy, splits are sent as block-level deltas against the installed package.
+    const char* first_apk_file = nullptr;
+    for (int i = first_apk; i < argc; i++) {
+        if (android::base::EndsWithIgnoreCase(argv[i], ".apk")) {
+            first_apk_file = argv[i];
+            break;
+        }
+    }
+    if (use_fastdeploy && (first_apk_file == nullptr || use_legacy_install() ||
+                           get_device_api_level() < kFastDeployMinApi)) {
+        printf("Fast Deploy requires streaming installs on devices of API version %d or higher, "
+               "ignoring.\n",
+               kFastDeployMinApi);
+        use_fastdeploy = false;
+    }
+    if (use_fastdeploy) {
+        fastdeploy_set_local_agent(use_localagent);
+        update_agent(FastDeploy_AgentUpdateDifferentVersion);
+        use_fastdeploy = find_package(first_apk_file);
+    }
+
+    TemporaryFile block_hashes_file;
+    if (use_fastdeploy) {
+        FILE* block_hashes_fp = fopen(block_hashes_file.path, "wb");
+        extract_block_hashes(first_apk_file, block_hashes_fp);
+        fclose(block_hashes_fp);
     }
 
     // Create install session
@@ -454,6 +494,23 @@ int install_multiple_app(int argc, const char** argv) {
                                             install_cmd.c_str(), static_cast<uint64_t>(sb.st_size),
                                             session_id, android::base::Basename(file).c_str());
 
+        if (use_fastdeploy && android::base::EndsWithIgnoreCase(file, ".apk")) {
+            TemporaryFile patch_file;
+            create_block_patch(file, block_hashes_file.path, patch_file.path);
+
+            // Only bother with the patch if it's actually smaller than the split.
+            struct stat patch_sb;
+            if (stat(patch_file.path, &patch_sb) == 0 && patch_sb.st_size < sb.st_size) {
+                if (!write_patch_to_session(file, patch_file.path, session_id,
+                                            android::base::Basename(file))) {
+                    fprintf(stderr, "adb: failed to write %s\n", file);
+                    success = 0;
+                    goto finalize_session;
+                }
+                continue;
+            }
+        }
+
         unique_fd local_fd(adb_open(file, O_RDONLY | O_CLOEXEC));
         if (local_fd < 0) {
             fprintf(stderr, "adb: failed to open %s: %s\n", file, strerror(errno));
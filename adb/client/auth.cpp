@@ -24,10 +24,12 @@
 #include <sys/inotify.h>
 #endif
 
+#include <algorithm>
 #include <map>
 #include <mutex>
 #include <set>
 #include <string>
+#include <thread>
 
 #include <android-base/errors.h>
 #include <android-base/file.h>
@@ -45,6 +47,7 @@
 #include "adb_auth.h"
 #include "adb_io.h"
 #include "adb_utils.h"
+#include "fdevent.h"
 #include "sysdeps.h"
 #include "transport.h"
 
@@ -444,6 +447,11 @@ static void send_auth_publickey(atransport* t) {
     send_packet(p, t);
 }
 
+// RSA signatures take a while, and each device connecting has its own token to sign. Sign them
+// off the main thread, so that a fleet of devices coming online at once gets them in parallel.
+static WorkerPool& sign_pool =
+    *new WorkerPool("adb auth", std::max(1U, std::thread::hardware_concurrency()));
+
 void send_auth_response(const char* token, size_t token_size, atransport* t) {
     std::shared_ptr<RSA> key = t->NextKey();
     if (key == nullptr) {
@@ -455,18 +463,29 @@ void send_auth_response(const char* token, size_t token_size, atransport* t) {
     }
 
     LOG(INFO) << "Calling send_auth_response";
-    apacket* p = get_apacket();
+    sign_pool.Run([key, token = std::string(token, token_size), id = t->id]() {
+        std::string result = adb_auth_sign(key.get(), token.data(), token.size());
+        if (result.empty()) {
+            D("Error signing the token");
+            return;
+        }
 
-    std::string result = adb_auth_sign(key.get(), token, token_size);
-    if (result.empty()) {
-        D("Error signing the token");
-        put_apacket(p);
-        return;
-    }
+        fdevent_run_on_main_thread([result = std::move(result), id]() {
+            // The transport may have gone away while we were signing.
+            std::string error;
+            atransport* t = acquire_one_transport(kTransportAny, nullptr, id, nullptr, &error,
+                                                  true);
+            if (t == nullptr) {
+                D("Dropping signature: %s", error.c_str());
+                return;
+            }
 
-    p->msg.command = A_AUTH;
-    p->msg.arg0 = ADB_AUTH_SIGNATURE;
-    p->payload.assign(result.begin(), result.end());
-    p->msg.data_length = p->payload.size();
-    send_packet(p, t);
+            apacket* p = get_apacket();
+            p->msg.command = A_AUTH;
+            p->msg.arg0 = ADB_AUTH_SIGNATURE;
+            p->payload.assign(result.begin(), result.end());
+            p->msg.data_length = p->payload.size();
+            send_packet(p, t);
+        });
+    });
 }
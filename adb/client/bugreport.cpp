@@ -20,12 +20,18 @@
 
 #include "bugreport.h"
 
+#include <inttypes.h>
+#include <stdio.h>
+#include <time.h>
+
 #include <string>
 #include <vector>
 
 #include <android-base/file.h>
 #include <android-base/strings.h>
 
+#include "adb_io.h"
+#include "adb_unique_fd.h"
 #include "adb_utils.h"
 #include "client/file_sync_client.h"
 
@@ -196,6 +202,82 @@ class BugreportStandardStreamsCallback : public StandardStreamsCallbackInterface
     DISALLOW_COPY_AND_ASSIGN(BugreportStandardStreamsCallback);
 };
 
+// Custom callback used to write a zipped bugreport streamed by 'bugreportz -s' straight to its
+// destination, as dumpstate writes it on the device.
+class BugreportStreamingCallback : public StandardStreamsCallbackInterface {
+  public:
+    BugreportStreamingCallback(const std::string& destination, unique_fd fd, Bugreport* br)
+        : br_(br),
+          destination_(destination),
+          fd_(std::move(fd)),
+          line_message_("streaming " + android::base::Basename(destination)),
+          bytes_(0),
+          last_progress_mib_(0),
+          failed_(false) {
+    }
+
+    void OnStdout(const char* buffer, int length) {
+        if (failed_) return;
+        if (!WriteFdExactly(fd_.get(), buffer, length)) {
+            fprintf(stderr, "adb: failed to write '%s': %s\n", destination_.c_str(),
+                    strerror(errno));
+            failed_ = true;
+            return;
+        }
+        bytes_ += length;
+        uint64_t mib = bytes_ / (1024 * 1024);
+        if (mib != last_progress_mib_) {
+            last_progress_mib_ = mib;
+            br_->UpdateStreamProgress(line_message_, bytes_);
+        }
+    }
+
+    void OnStderr(const char* buffer, int length) {
+        OnStream(nullptr, stderr, buffer, length);
+    }
+
+    int Done(int status) {
+        fd_.reset();
+        if (status == 0 && !failed_ && bytes_ == 0) {
+            fprintf(stderr, "adb: bugreportz did not stream a bugreport\n");
+            status = -1;
+        } else if (status == 0 && failed_) {
+            status = 1;
+        }
+        if (status != 0) {
+            // Don't leave a truncated zip behind.
+            adb_unlink(destination_.c_str());
+        }
+        return status;
+    }
+
+  private:
+    Bugreport* br_;
+
+    // Bugreport destination on host, and the file open for it.
+    std::string destination_;
+    unique_fd fd_;
+
+    // Message displayed on LinePrinter.
+    std::string line_message_;
+
+    // Bytes written so far, and the MiB count last displayed.
+    uint64_t bytes_;
+    uint64_t last_progress_mib_;
+
+    // Whether writing the destination failed; the rest of the stream is then dropped.
+    bool failed_;
+
+    DISALLOW_COPY_AND_ASSIGN(BugreportStreamingCallback);
+};
+
+// Whether bugreportz can stream the zip to stdout as it is generated ('-s', since 1.2).
+static bool SupportsStreaming(const std::string& bugz_version) {
+    int major, minor;
+    if (sscanf(bugz_version.c_str(), "%d.%d", &major, &minor) != 2) return false;
+    return major > 1 || (major == 1 && minor >= 2);
+}
+
 int Bugreport::DoIt(int argc, const char** argv) {
     if (argc > 2) error_exit("usage: adb bugreport [PATH]");
 
@@ -244,6 +326,33 @@ int Bugreport::DoIt(int argc, const char** argv) {
         }
     }
 
+    if (SupportsStreaming(bugz_version)) {
+        // The device never names the bugreport when streaming it, so name it after the time it
+        // was taken instead.
+        if (dest_file.empty()) {
+            char date[32];
+            time_t now = time(nullptr);
+            strftime(date, sizeof(date), "%Y-%m-%d-%H-%M-%S", localtime(&now));
+            dest_file = android::base::StringPrintf("bugreport-%s.zip", date);
+        } else if (!android::base::EndsWithIgnoreCase(dest_file, ".zip")) {
+            dest_file += ".zip";
+        }
+        std::string destination = dest_file;
+        if (!dest_dir.empty()) {
+            destination = android::base::StringPrintf("%s%c%s", dest_dir.c_str(),
+                                                      OS_PATH_SEPARATOR, dest_file.c_str());
+        }
+
+        unique_fd fd(adb_creat(destination.c_str(), 0644));
+        if (fd == -1) {
+            fprintf(stderr, "adb: failed to create '%s': %s\n", destination.c_str(),
+                    strerror(errno));
+            return 1;
+        }
+        BugreportStreamingCallback stream_callback(destination, std::move(fd), this);
+        return SendShellCommand("bugreportz -s", false, &stream_callback);
+    }
+
     if (dest_file.empty()) {
         // Uses a default value until device provides the proper name
         dest_file = "bugreport.zip";
@@ -275,6 +384,12 @@ void Bugreport::UpdateProgress(const std::string& message, int progress_percenta
         LinePrinter::INFO);
 }
 
+void Bugreport::UpdateStreamProgress(const std::string& message, uint64_t bytes) {
+    line_printer_.Print(android::base::StringPrintf("[%4" PRIu64 " MiB] %s",
+                                                    bytes / (1024 * 1024), message.c_str()),
+                        LinePrinter::INFO);
+}
+
 int Bugreport::SendShellCommand(const std::string& command, bool disable_shell_protocol,
                                 StandardStreamsCallbackInterface* callback) {
     return send_shell_command(command, disable_shell_protocol, callback);
@@ -31,7 +31,11 @@
 #include <sys/stat.h>
 #include <sys/types.h>
 
+#include <condition_variable>
+#include <iostream>
+#include <map>
 #include <memory>
+#include <mutex>
 #include <string>
 #include <thread>
 #include <vector>
@@ -49,6 +53,7 @@
 #include <unistd.h>
 #endif
 
+#include "abb_session_protocol.h"
 #include "adb.h"
 #include "adb_auth.h"
 #include "adb_client.h"
@@ -86,6 +91,8 @@ static void help() {
         " -e         use TCP/IP device (error if multiple TCP/IP devices available)\n"
         " -s SERIAL  use device with given serial (overrides $ANDROID_SERIAL)\n"
         " -t ID      use device with given transport id\n"
+        " --serials SERIAL[,SERIAL...]\n"
+        "            run a non-interactive command on each device concurrently\n"
         " -H         name of adb server host [default=localhost]\n"
         " -P         port of adb server [default=5037]\n"
         " -L SOCKET  listen on given socket for adb server [default=tcp:localhost:5037]\n"
@@ -122,12 +129,14 @@ static void help() {
         " reverse --remove-all     remove all reverse socket connections from device\n"
         "\n"
         "file transfer:\n"
-        " push [--sync] LOCAL... REMOTE\n"
+        " push [--sync] [-z] LOCAL... REMOTE\n"
         "     copy local files/directories to device\n"
         "     --sync: only push files that are newer on the host than the device\n"
-        " pull [-a] REMOTE... LOCAL\n"
+        "     -z: compress the transfer, if the device supports it\n"
+        " pull [-a] [-z] REMOTE... LOCAL\n"
         "     copy files/dirs from device\n"
         "     -a: preserve file timestamp and mode\n"
+        "     -z: compress the transfer, if the device supports it\n"
         " sync [all|data|odm|oem|product_services|product|system|vendor]\n"
         "     sync a local build from $ANDROID_PRODUCT_OUT to the device (default all)\n"
         "     -l: list but don't copy\n"
@@ -157,7 +166,7 @@ static void help() {
         "     --instant: cause the app to be installed as an ephemeral install app\n"
         "     --no-streaming: always push APK to device and invoke Package Manager as separate steps\n"
         "     --streaming: force streaming APK directly into Package Manager\n"
-        "     --fastdeploy: use fast deploy\n"
+        "     --fastdeploy: use fast deploy (install-multiple: only send changed blocks)\n"
         "     --no-fastdeploy: prevent use of fast deploy\n"
         "     --force-agent: force update of deployment agent when using fast deploy\n"
         "     --date-check-agent: update deployment agent when local version is newer and using fast deploy\n"
@@ -178,6 +187,7 @@ static void help() {
         "     write bugreport to given PATH [default=bugreport.zip];\n"
         "     if PATH is a directory, the bug report is saved in that directory.\n"
         "     devices that don't support zipped bug reports output to stdout.\n"
+        "     devices that can stream bug reports write PATH as it is generated.\n"
         " jdwp                     list pids of processes hosting a JDWP transport\n"
         " logcat                   show device log (logcat --help for more)\n"
         "\n"
@@ -215,6 +225,7 @@ static void help() {
         " reconnect                kick connection from host side to force reconnect\n"
         " reconnect device         kick connection from device side to force reconnect\n"
         " reconnect offline        reset offline/unauthorized devices to force reconnect\n"
+        " transport-stats          show traffic statistics for connected devices\n"
         "\n"
         "environment variables:\n"
         " $ADB_TRACE\n"
@@ -761,6 +772,134 @@ static int adb_shell(int argc, const char** argv) {
                        service_string);
 }
 
+// Runs the abb commands read from stdin, one per line with its arguments separated by blanks,
+// over a single abb_session: connection. Every command is sent as soon as it is read, but the
+// output of each is written out in order, after that of the ones before it. Returns the exit
+// code of the last command that failed, if any.
+static int adb_abb_session() {
+    std::string error;
+    unique_fd fd(adb_connect("abb_session:", &error));
+    if (fd < 0) {
+        fprintf(stderr, "error: %s\n", error.c_str());
+        return 1;
+    }
+
+    std::mutex lock;
+    std::condition_variable cv;
+    uint32_t sent = 0;
+    bool input_done = false;
+
+    std::thread writer([&]() {
+        std::string line;
+        while (std::getline(std::cin, line)) {
+            std::string args;
+            for (const auto& arg : android::base::Split(line, " \t")) {
+                if (!arg.empty()) {
+                    args.append(arg);
+                    args.push_back(ABB_ARG_DELIMETER);
+                }
+            }
+            if (args.empty()) {
+                continue;
+            }
+            if (args.size() > ABB_SESSION_MAX_REQUEST) {
+                fprintf(stderr, "adb: abb command too long: %s\n", line.c_str());
+                continue;
+            }
+
+            AbbSessionRequest request = {.id = sent, .length = static_cast<uint32_t>(args.size())};
+            if (!WriteFdExactly(fd, &request, sizeof(request)) || !WriteFdExactly(fd, args)) {
+                break;
+            }
+            std::lock_guard guard(lock);
+            ++sent;
+            cv.notify_one();
+        }
+        std::lock_guard guard(lock);
+        input_done = true;
+        cv.notify_one();
+    });
+
+    // Output of the commands that are ahead of their turn.
+    struct Pending {
+        std::string out;
+        std::string err;
+        bool exited = false;
+        int exit_code = 0;
+    };
+    std::map<uint32_t, Pending> pending;
+    uint32_t next = 0;
+    int result = 0;
+
+    std::string data;
+    while (true) {
+        {
+            // Only block on the connection while there is a response to come.
+            std::unique_lock guard(lock);
+            cv.wait(guard, [&]() { return next < sent || input_done; });
+            if (next == sent) {
+                break;
+            }
+        }
+
+        AbbSessionResponse response;
+        if (!ReadFdExactly(fd, &response, sizeof(response))) {
+            error_exit("abb session closed by the device");
+        }
+        data.resize(response.length);
+        if (!ReadFdExactly(fd, data.data(), data.size())) {
+            error_exit("abb session closed by the device");
+        }
+
+        if (response.id != next) {
+            Pending& p = pending[response.id];
+            if (response.kind == ShellProtocol::kIdStdout) {
+                p.out.append(data);
+            } else if (response.kind == ShellProtocol::kIdStderr) {
+                p.err.append(data);
+            } else if (response.kind == ShellProtocol::kIdExit && !data.empty()) {
+                p.exited = true;
+                p.exit_code = static_cast<uint8_t>(data[0]);
+            }
+            continue;
+        }
+
+        // Output of the command whose turn it is goes straight through.
+        if (response.kind == ShellProtocol::kIdStdout) {
+            fwrite(data.data(), 1, data.size(), stdout);
+            fflush(stdout);
+        } else if (response.kind == ShellProtocol::kIdStderr) {
+            fwrite(data.data(), 1, data.size(), stderr);
+        } else if (response.kind == ShellProtocol::kIdExit && !data.empty()) {
+            int exit_code = static_cast<uint8_t>(data[0]);
+            while (true) {
+                if (exit_code != 0) {
+                    result = exit_code;
+                }
+                ++next;
+
+                // Catch up with the ones after it, up to one that is still running.
+                auto it = pending.find(next);
+                if (it == pending.end()) {
+                    break;
+                }
+                fwrite(it->second.out.data(), 1, it->second.out.size(), stdout);
+                fflush(stdout);
+                fwrite(it->second.err.data(), 1, it->second.err.size(), stderr);
+                if (!it->second.exited) {
+                    pending.erase(it);
+                    break;
+                }
+                exit_code = it->second.exit_code;
+                pending.erase(it);
+            }
+        }
+    }
+
+    writer.join();
+    return result;
+}
+
 static int adb_abb(int argc, const char** argv) {
     FeatureSet features;
     std::string error_message;
@@ -773,6 +912,13 @@ static int adb_abb(int argc, const char** argv) {
         error_exit("abb is not supported by the device");
     }
 
+    if (argc == 2 && !strcmp(argv[1], "--session")) {
+        if (!CanUseFeature(features, kFeatureAbbSession)) {
+            error_exit("abb sessions are not supported by the device");
+        }
+        return adb_abb_session();
+    }
+
     // Defaults.
     constexpr char escape_char = '~';  // -e
     constexpr bool use_shell_protocol = true;
@@ -1245,8 +1391,10 @@ static int restore(int argc, const char** argv) {
 }
 
 static void parse_push_pull_args(const char** arg, int narg, std::vector<const char*>* srcs,
-                                 const char** dst, bool* copy_attrs, bool* sync) {
+                                 const char** dst, bool* copy_attrs, bool* sync,
+                                 bool* compressed) {
     *copy_attrs = false;
+    *compressed = false;
 
     srcs->clear();
     bool ignore_flags = false;
@@ -1258,6 +1406,8 @@ static void parse_push_pull_args(const char** arg, int narg, std::vector<const c
                 // Silently ignore for backwards compatibility.
             } else if (!strcmp(*arg, "-a")) {
                 *copy_attrs = true;
+            } else if (!strcmp(*arg, "-z")) {
+                *compressed = true;
             } else if (!strcmp(*arg, "--sync")) {
                 if (sync != nullptr) {
                     *sync = true;
@@ -1347,6 +1497,43 @@ static bool _is_valid_ack_reply_fd(const int ack_reply_fd) {
 #endif
 }
 
+static int adb_run_command(int argc, const char** argv);
+
+// Runs the same command against each of |serials| concurrently, with one thread (and so
+// one adb server connection) per device. Files pushed to every device are only read once.
+static int adb_fanout(const std::vector<std::string>& serials, int argc, const char** argv) {
+    // Start the server up front rather than having every thread race to do it.
+    std::string error;
+    if (adb_connect("host:start-server", &error) < 0) {
+        error_exit("failed to start server: %s", error.c_str());
+    }
+
+    sync_share_local_files(true);
+
+    std::vector<int> results(serials.size());
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < serials.size(); ++i) {
+        threads.emplace_back([&, i]() {
+            adb_set_transport(kTransportAny, serials[i].c_str(), 0);
+            results[i] = adb_run_command(argc, argv);
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    sync_share_local_files(false);
+
+    int rc = 0;
+    for (size_t i = 0; i < serials.size(); ++i) {
+        if (results[i] != 0) {
+            fprintf(stderr, "adb: %s: command failed (%d)\n", serials[i].c_str(), results[i]);
+            rc = 1;
+        }
+    }
+    return rc;
+}
+
 int adb_commandline(int argc, const char** argv) {
     bool no_daemon = false;
     bool is_daemon = false;
@@ -1367,6 +1554,7 @@ int adb_commandline(int argc, const char** argv) {
     // We need to check for -d and -e before we look at $ANDROID_SERIAL.
     const char* serial = nullptr;
     TransportId transport_id = 0;
+    std::vector<std::string> fanout_serials;
 
     while (argc > 0) {
         if (!strcmp(argv[0],"server")) {
@@ -1395,6 +1583,14 @@ int adb_commandline(int argc, const char** argv) {
                 argc--;
                 argv++;
             }
+        } else if (!strcmp(argv[0], "--serials")) {
+            if (argc < 2) error_exit("--serials requires an argument");
+            for (const std::string& s : android::base::Split(argv[1], ",")) {
+                if (!s.empty()) fanout_serials.push_back(s);
+            }
+            if (fanout_serials.empty()) error_exit("--serials requires at least one serial");
+            argc--;
+            argv++;
         } else if (!strncmp(argv[0], "-t", 2)) {
             const char* id;
             if (isdigit(argv[0][2])) {
@@ -1448,6 +1644,9 @@ int adb_commandline(int argc, const char** argv) {
     if ((server_host_str || server_port_str) && server_socket_str) {
         error_exit("-L is incompatible with -H or -P");
     }
+    if (!fanout_serials.empty() && (serial || transport_id || transport_type != kTransportAny)) {
+        error_exit("--serials is incompatible with -s, -t, -d, or -e");
+    }
 
     // If -L, -H, or -P are specified, ignore environment variables.
     // Otherwise, prefer ADB_SERVER_SOCKET over ANDROID_ADB_SERVER_ADDRESS/PORT.
@@ -1485,8 +1684,8 @@ int adb_commandline(int argc, const char** argv) {
 
     adb_set_socket_spec(server_socket_str);
 
-    // If none of -d, -e, or -s were specified, try $ANDROID_SERIAL.
-    if (transport_type == kTransportAny && serial == nullptr) {
+    // If none of -d, -e, -s, or --serials were specified, try $ANDROID_SERIAL.
+    if (transport_type == kTransportAny && serial == nullptr && fanout_serials.empty()) {
         serial = getenv("ANDROID_SERIAL");
     }
 
@@ -1513,6 +1712,18 @@ int adb_commandline(int argc, const char** argv) {
         return 1;
     }
 
+    if (!fanout_serials.empty()) {
+        return adb_fanout(fanout_serials, argc, argv);
+    }
+    return adb_run_command(argc, argv);
+}
+
+// Runs a single command against the transport selected with adb_set_transport.
+static int adb_run_command(int argc, const char** argv) {
+    TransportType transport_type;
+    const char* serial;
+    adb_get_transport(&transport_type, &serial, nullptr);
+
     /* handle wait-for-* prefix */
     if (!strncmp(argv[0], "wait-for-", strlen("wait-for-"))) {
         const char* service = argv[0];
@@ -1705,20 +1916,22 @@ int adb_commandline(int argc, const char** argv) {
     } else if (!strcmp(argv[0], "push")) {
         bool copy_attrs = false;
         bool sync = false;
+        bool compressed = false;
         std::vector<const char*> srcs;
         const char* dst = nullptr;
 
-        parse_push_pull_args(&argv[1], argc - 1, &srcs, &dst, &copy_attrs, &sync);
+        parse_push_pull_args(&argv[1], argc - 1, &srcs, &dst, &copy_attrs, &sync, &compressed);
         if (srcs.empty() || !dst) error_exit("push requires an argument");
-        return do_sync_push(srcs, dst, sync) ? 0 : 1;
+        return do_sync_push(srcs, dst, sync, compressed) ? 0 : 1;
     } else if (!strcmp(argv[0], "pull")) {
         bool copy_attrs = false;
+        bool compressed = false;
         std::vector<const char*> srcs;
         const char* dst = ".";
 
-        parse_push_pull_args(&argv[1], argc - 1, &srcs, &dst, &copy_attrs, nullptr);
+        parse_push_pull_args(&argv[1], argc - 1, &srcs, &dst, &copy_attrs, nullptr, &compressed);
         if (srcs.empty()) error_exit("pull requires an argument");
-        return do_sync_pull(srcs, dst, copy_attrs) ? 0 : 1;
+        return do_sync_pull(srcs, dst, copy_attrs, nullptr, compressed) ? 0 : 1;
     } else if (!strcmp(argv[0], "install")) {
         if (argc < 2) error_exit("install requires an argument");
         return install_app(argc, argv);
@@ -1762,7 +1975,7 @@ int adb_commandline(int argc, const char** argv) {
     }
     /* passthrough commands */
     else if (!strcmp(argv[0], "get-state") || !strcmp(argv[0], "get-serialno") ||
-             !strcmp(argv[0], "get-devpath")) {
+             !strcmp(argv[0], "get-devpath") || !strcmp(argv[0], "transport-stats")) {
         return adb_query_command(format_host_command(argv[0]));
     }
     /* other commands */
@@ -1794,6 +2007,8 @@ int adb_commandline(int argc, const char** argv) {
         return adb_connect_command("jdwp");
     } else if (!strcmp(argv[0], "track-jdwp")) {
         return adb_connect_command("track-jdwp");
+    } else if (!strcmp(argv[0], "track-jdwp-delta")) {
+        return adb_connect_command("track-jdwp-delta");
     } else if (!strcmp(argv[0], "track-devices")) {
         return adb_connect_command("host:track-devices");
     } else if (!strcmp(argv[0], "raw")) {
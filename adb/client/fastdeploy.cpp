@@ -25,6 +25,8 @@
 #include "android-base/strings.h"
 #include "androidfw/ResourceTypes.h"
 #include "androidfw/ZipFileRO.h"
+#include "client/adb_client.h"
+#include "client/adb_install.h"
 #include "client/file_sync_client.h"
 #include "commandline.h"
 #include "fastdeploycallbacks.h"
@@ -32,7 +34,7 @@
 
 #include "adb_utils.h"
 
-static constexpr long kRequiredAgentVersion = 0x00000002;
+static constexpr long kRequiredAgentVersion = 0x00000003;
 
 static constexpr const char* kDeviceAgentPath = "/data/local/tmp/";
 
@@ -54,6 +56,11 @@ long get_agent_version() {
 }
 
 int get_device_api_level() {
+    std::string cached_sdk_version;
+    if (adb_get_cached_property("ro.build.version.sdk", &cached_sdk_version)) {
+        return strtol(cached_sdk_version.c_str(), nullptr, 10);
+    }
+
     std::vector<char> sdkVersionOutputBuffer;
     std::vector<char> sdkVersionErrorBuffer;
     int api_level = -1;
@@ -238,6 +245,20 @@ void extract_metadata(const char* apkPath, FILE* outputFp) {
     }
 }
 
+void extract_block_hashes(const char* apkPath, FILE* outputFp) {
+    std::string packageName = get_packagename_from_apk(apkPath);
+    std::string hashCommand = "/data/local/tmp/deployagent blockhashes " + packageName;
+
+    std::vector<char> hashErrorBuffer;
+    DeployAgentFileCallback cb(outputFp, &hashErrorBuffer);
+    int returnCode = send_shell_command(hashCommand, false, &cb);
+    if (returnCode != 0) {
+        fprintf(stderr, "Executing %s returned %d\n", hashCommand.c_str(), returnCode);
+        fprintf(stderr, "%*s\n", int(hashErrorBuffer.size()), hashErrorBuffer.data());
+        error_exit("Aborting");
+    }
+}
+
 static std::string get_patch_generator_command() {
     if (g_use_localagent) {
         // This should never happen on a Windows machine
@@ -269,6 +290,16 @@ void create_patch(const char* apkPath, const char* metadataPath, const char* pat
     }
 }
 
+void create_block_patch(const char* apkPath, const char* blockHashesPath, const char* patchPath) {
+    std::string generatePatchCommand = android::base::StringPrintf(
+            R"(%s --blocks "%s" "%s" > "%s")", get_patch_generator_command().c_str(), apkPath,
+            blockHashesPath, patchPath);
+    int returnCode = system(generatePatchCommand.c_str());
+    if (returnCode != 0) {
+        error_exit("Executing %s returned %d", generatePatchCommand.c_str(), returnCode);
+    }
+}
+
 std::string get_patch_path(const char* apkPath) {
     std::string packageName = get_packagename_from_apk(apkPath);
     std::string patchDevicePath =
@@ -335,6 +366,30 @@ void install_patch(const char* apkPath, const char* patchPath, int argc, const c
     }
 }
 
+bool write_patch_to_session(const char* apkPath, const char* patchPath, int session_id,
+                            const std::string& split_name) {
+    std::string packageName = get_packagename_from_apk(apkPath);
+    std::string patchDevicePath = android::base::StringPrintf(
+            "%s%s.%s.patch", kDeviceAgentPath, packageName.c_str(), split_name.c_str());
+
+    std::vector<const char*> srcs{patchPath};
+    if (!do_sync_push(srcs, patchDevicePath.c_str(), false)) {
+        fprintf(stderr, "adb: error pushing %s to %s\n", patchPath, patchDevicePath.c_str());
+        return false;
+    }
+
+    std::string applyPatchCommand = android::base::StringPrintf(
+            "/data/local/tmp/deployagent apply %s %s -session %d %s", packageName.c_str(),
+            patchDevicePath.c_str(), session_id, escape_arg(split_name).c_str());
+    int returnCode = send_shell_command(applyPatchCommand);
+    delete_device_file(patchDevicePath);
+    if (returnCode != 0) {
+        fprintf(stderr, "adb: executing %s returned %d\n", applyPatchCommand.c_str(), returnCode);
+        return false;
+    }
+    return true;
+}
+
 bool find_package(const char* apkPath) {
     const std::string findCommand =
             "/data/local/tmp/deployagent find " + get_packagename_from_apk(apkPath);
@@ -31,5 +31,13 @@ void extract_metadata(const char* apkPath, FILE* outputFp);
 void create_patch(const char* apkPath, const char* metadataPath, const char* patchPath);
 void apply_patch_on_device(const char* apkPath, const char* patchPath, const char* outputPath);
 void install_patch(const char* apkPath, const char* patchPath, int argc, const char** argv);
+
+// Block-level deltas for install-multiple: the hashes of every installed APK of the package are
+// extracted once, and each new split is rebuilt on the device from whichever installed APK it
+// shares the most blocks with.
+void extract_block_hashes(const char* apkPath, FILE* outputFp);
+void create_block_patch(const char* apkPath, const char* blockHashesPath, const char* patchPath);
+bool write_patch_to_session(const char* apkPath, const char* patchPath, int session_id,
+                            const std::string& split_name);
 std::string get_patch_path(const char* apkPath);
 bool find_package(const char* apkPath);
@@ -17,6 +17,7 @@
 #include "client/file_sync_client.h"
 
 #include <dirent.h>
+#include <fcntl.h>
 #include <inttypes.h>
 #include <limits.h>
 #include <stdio.h>
@@ -28,11 +29,17 @@
 #include <unistd.h>
 #include <utime.h>
 
+#include <algorithm>
 #include <chrono>
+#include <condition_variable>
+#include <deque>
 #include <functional>
 #include <memory>
+#include <mutex>
 #include <sstream>
 #include <string>
+#include <thread>
+#include <unordered_map>
 #include <vector>
 
 #include "sysdeps.h"
@@ -41,6 +48,7 @@
 #include "adb_client.h"
 #include "adb_io.h"
 #include "adb_utils.h"
+#include "compression.h"
 #include "file_sync_protocol.h"
 #include "line_printer.h"
 #include "sysdeps/errno.h"
@@ -49,15 +57,60 @@
 #include "client/commandline.h"
 
 #include <android-base/file.h>
+#include <android-base/mapped_file.h>
 #include <android-base/strings.h>
 #include <android-base/stringprintf.h>
-
-struct syncsendbuf {
-    unsigned id;
-    unsigned size;
-    char data[SYNC_DATA_MAX];
+#include <android-base/thread_annotations.h>
+
+// When several sync connections push the same tree at once (adb --serials), each large file is
+// mapped once and shared between them rather than being read from disk once per device.
+struct SharedMapping {
+    std::shared_ptr<android::base::MappedFile> mapping;
+    off64_t size;
+    time_t mtime;
 };
 
+static std::mutex& shared_mappings_mutex = *new std::mutex();
+static bool share_local_files GUARDED_BY(shared_mappings_mutex) = false;
+static auto& shared_mappings GUARDED_BY(shared_mappings_mutex) =
+        *new std::unordered_map<std::string, SharedMapping>();
+
+void sync_share_local_files(bool enable) {
+    std::lock_guard<std::mutex> lock(shared_mappings_mutex);
+    share_local_files = enable;
+    if (!enable) {
+        shared_mappings.clear();
+    }
+}
+
+// Returns a read-only mapping of |path|, or nullptr if sharing is disabled or the file couldn't
+// be mapped (in which case the caller should fall back to reading it).
+static std::shared_ptr<android::base::MappedFile> get_shared_mapping(const char* path,
+                                                                     const struct stat& st) {
+    std::lock_guard<std::mutex> lock(shared_mappings_mutex);
+    if (!share_local_files) {
+        return nullptr;
+    }
+
+    auto it = shared_mappings.find(path);
+    if (it != shared_mappings.end() && it->second.size == st.st_size &&
+        it->second.mtime == st.st_mtime) {
+        return it->second.mapping;
+    }
+
+    unique_fd fd(adb_open(path, O_RDONLY));
+    if (fd < 0) {
+        return nullptr;
+    }
+    std::shared_ptr<android::base::MappedFile> mapping =
+            android::base::MappedFile::FromFd(fd.get(), 0, st.st_size, PROT_READ);
+    if (!mapping) {
+        return nullptr;
+    }
+    shared_mappings[path] = {mapping, st.st_size, st.st_mtime};
+    return mapping;
+}
+
 static void ensure_trailing_separators(std::string& local_path, std::string& remote_path) {
     if (!adb_is_separator(local_path.back())) {
         local_path.push_back(OS_PATH_SEPARATOR);
@@ -202,19 +255,23 @@ struct TransferLedger {
 
 class SyncConnection {
   public:
-    SyncConnection() : expect_done_(false) {
-        max = SYNC_DATA_MAX; // TODO: decide at runtime.
+    SyncConnection() {
+        max = SYNC_DATA_MAX;
 
         std::string error;
         if (!adb_get_feature_set(&features_, &error)) {
             Error("failed to get feature set: %s", error.c_str());
         } else {
             have_stat_v2_ = CanUseFeature(features_, kFeatureStat2);
+            have_list_recursive_ = CanUseFeature(features_, kFeatureListRecursive);
             fd.reset(adb_connect("sync:", &error));
             if (fd < 0) {
                 Error("connect failed: %s", error.c_str());
+            } else if (CanUseFeature(features_, kFeatureSyncV2) && !NegotiateDataMax()) {
+                fd.reset();
             }
         }
+        buffer.resize(max);
     }
 
     ~SyncConnection() {
@@ -235,6 +292,13 @@ class SyncConnection {
 
     const FeatureSet& Features() const { return features_; }
 
+    // Compresses regular file transfers from now on, if the device supports it.
+    void EnableCompression() { compression_ = CanUseFeature(features_, kFeatureSyncBrotli); }
+
+    bool CompressionEnabled() const { return compression_; }
+
+    bool HaveListRecursive() const { return have_list_recursive_; }
+
     bool IsValid() { return fd >= 0; }
 
     bool ReceivedError(const char* from, const char* to) {
@@ -301,6 +365,40 @@ class SyncConnection {
         return WriteFdExactly(fd, &buf[0], buf.size());
     }
 
+    // Asks adbd for larger DATA chunks than the 64KiB that every version understands.
+    bool NegotiateDataMax() {
+        std::string requested_size = std::to_string(SYNC_DATA_MAX_V2);
+        if (!SendRequest(ID_DMAX, requested_size.c_str())) {
+            Error("failed to send ID_DMAX: %s", strerror(errno));
+            return false;
+        }
+
+        syncmsg msg;
+        if (!ReadFdExactly(fd, &msg.data, sizeof(msg.data))) {
+            Error("failed to read ID_DMAX response: %s", strerror(errno));
+            return false;
+        }
+        if (msg.data.id != ID_DMAX || msg.data.size < SYNC_DATA_MAX ||
+            msg.data.size > SYNC_DATA_MAX_V2) {
+            Error("protocol fault: bad ID_DMAX response (id %u, size %u)", msg.data.id,
+                  msg.data.size);
+            return false;
+        }
+
+        max = msg.data.size;
+        return true;
+    }
+
+    // Sends an ID_SEND_V2 or ID_RECV_V2 request, which is followed by its flags.
+    bool SendRequestV2(uint32_t id, const char* path, uint32_t flags) {
+        if (!SendRequest(id, path)) return false;
+
+        syncmsg msg;
+        msg.v2_setup.id = id;
+        msg.v2_setup.flags = flags;
+        return WriteFdExactly(fd, &msg.v2_setup, sizeof(msg.v2_setup));
+    }
+
     bool SendStat(const char* path_and_mode) {
         if (!have_stat_v2_) {
             errno = ENOTSUP;
@@ -410,7 +508,7 @@ class SyncConnection {
         p += sizeof(SyncRequest);
 
         WriteOrDie(lpath, rpath, &buf[0], (p - &buf[0]));
-        expect_done_ = true;
+        RecordFileSent(lpath, rpath);
 
         // RecordFilesTransferred gets called in CopyDone.
         RecordBytesTransferred(data_length);
@@ -421,7 +519,9 @@ class SyncConnection {
     bool SendLargeFile(const char* path_and_mode,
                        const char* lpath, const char* rpath,
                        unsigned mtime) {
-        if (!SendRequest(ID_SEND, path_and_mode)) {
+        bool sent = compression_ ? SendRequestV2(ID_SEND_V2, path_and_mode, kSyncFlagBrotli)
+                                 : SendRequest(ID_SEND, path_and_mode);
+        if (!sent) {
             Error("failed to send ID_SEND message '%s': %s", path_and_mode, strerror(errno));
             return false;
         }
@@ -435,25 +535,67 @@ class SyncConnection {
         uint64_t total_size = st.st_size;
         uint64_t bytes_copied = 0;
 
-        unique_fd lfd(adb_open(lpath, O_RDONLY));
-        if (lfd < 0) {
-            Error("opening '%s' locally failed: %s", lpath, strerror(errno));
-            return false;
+        std::shared_ptr<android::base::MappedFile> mapping = get_shared_mapping(lpath, st);
+        unique_fd lfd;
+        if (mapping) {
+            total_size = mapping->size();
+        } else {
+            lfd.reset(adb_open(lpath, O_RDONLY));
+            if (lfd < 0) {
+                Error("opening '%s' locally failed: %s", lpath, strerror(errno));
+                return false;
+            }
+        }
+
+        // Read (or compress) each chunk in behind its header, so that it goes out in a single
+        // write.
+        SyncRequest* req = reinterpret_cast<SyncRequest*>(&buffer[0]);
+        char* data = reinterpret_cast<char*>(req + 1);
+        size_t data_max = max - sizeof(SyncRequest);
+        req->id = ID_DATA;
+        auto send_chunk = [&](size_t size) {
+            req->path_length = size;
+            return WriteOrDie(lpath, rpath, &buffer[0], sizeof(SyncRequest) + size);
+        };
+
+        std::unique_ptr<BrotliEncoder> encoder;
+        std::vector<char> input;
+        if (compression_) {
+            encoder = std::make_unique<BrotliEncoder>();
+            if (!mapping) input.resize(data_max);
         }
 
-        syncsendbuf sbuf;
-        sbuf.id = ID_DATA;
         while (true) {
-            int bytes_read = adb_read(lfd, sbuf.data, max - sizeof(SyncRequest));
-            if (bytes_read == -1) {
-                Error("reading '%s' locally failed: %s", lpath, strerror(errno));
-                return false;
-            } else if (bytes_read == 0) {
-                break;
+            char* read_buffer;
+            int bytes_read;
+            if (mapping) {
+                // The encoder can consume the mapping directly; only the uncompressed path needs
+                // the chunk copied in behind its header.
+                read_buffer = mapping->data() + bytes_copied;
+                bytes_read = std::min<uint64_t>(data_max, total_size - bytes_copied);
+                if (!encoder) memcpy(data, read_buffer, bytes_read);
+            } else {
+                read_buffer = encoder ? &input[0] : data;
+                bytes_read = adb_read(lfd, read_buffer, data_max);
+                if (bytes_read == -1) {
+                    Error("reading '%s' locally failed: %s", lpath, strerror(errno));
+                    return false;
+                }
             }
 
-            sbuf.size = bytes_read;
-            WriteOrDie(lpath, rpath, &sbuf, sizeof(SyncRequest) + bytes_read);
+            if (encoder) {
+                if (!encoder->Encode(read_buffer, bytes_read, bytes_read == 0, data, data_max,
+                                     send_chunk)) {
+                    Error("compressing '%s' failed", lpath);
+                    return false;
+                }
+            } else if (bytes_read != 0) {
+                send_chunk(bytes_read);
+            }
+
+            if (bytes_read == 0) {
+                break;
+            }
 
             RecordBytesTransferred(bytes_read);
             bytes_copied += bytes_read;
@@ -469,10 +611,36 @@ class SyncConnection {
         syncmsg msg;
         msg.data.id = ID_DONE;
         msg.data.size = mtime;
-        expect_done_ = true;
+        WriteOrDie(lpath, rpath, &msg.data, sizeof(msg.data));
+        RecordFileSent(lpath, rpath);
 
         // RecordFilesTransferred gets called in CopyDone.
-        return WriteOrDie(lpath, rpath, &msg.data, sizeof(msg.data));
+        return true;
+    }
+
+    // Reads the ID_OKAY/ID_FAIL responses for files that have been sent but not yet
+    // acknowledged. Unless read_all is set, this only blocks once the window of outstanding
+    // files is full, which lets a push of many small files proceed without waiting a round
+    // trip per file.
+    bool ReadAcknowledgements(bool read_all = false) {
+        // adbd writes one 8-byte status per file (plus a reason on failure), and we must not let
+        // its end of the socket fill up while we're still writing, so cap the window well below
+        // what the socket buffer can hold.
+        constexpr size_t kMaxDeferredAcknowledgements = 128;
+
+        while (!deferred_acknowledgements_.empty() &&
+               (read_all || deferred_acknowledgements_.size() >= kMaxDeferredAcknowledgements)) {
+            std::pair<std::string, std::string> files =
+                    std::move(deferred_acknowledgements_.front());
+            deferred_acknowledgements_.pop_front();
+            if (!CopyDone(files.first.c_str(), files.second.c_str())) {
+                // adbd closes the connection after reporting a failure, so nothing else is
+                // coming for the remaining files.
+                deferred_acknowledgements_.clear();
+                return false;
+            }
+        }
+        return true;
     }
 
     bool CopyDone(const char* from, const char* to) {
@@ -482,14 +650,8 @@ class SyncConnection {
             return false;
         }
         if (msg.status.id == ID_OKAY) {
-            if (expect_done_) {
-                expect_done_ = false;
-                RecordFilesTransferred(1);
-                return true;
-            } else {
-                Error("failed to copy '%s' to '%s': received premature success", from, to);
-                return true;
-            }
+            RecordFilesTransferred(1);
+            return true;
         }
         if (msg.status.id != ID_FAIL) {
             Error("failed to copy '%s' to '%s': unknown reason %d", from, to, msg.status.id);
@@ -570,19 +732,30 @@ class SyncConnection {
         current_ledger_.expect_multiple_files = false;
     }
 
-    // TODO: add a char[max] buffer here, to replace syncsendbuf...
     unique_fd fd;
+
+    // The largest DATA chunk (including its header) that we'll send or accept, and a buffer
+    // of that size to build chunks in.
     size_t max;
+    std::vector<char> buffer;
 
   private:
-    bool expect_done_;
+    bool compression_ = false;
+
+    // Files that we've finished sending, but whose ID_OKAY we haven't read yet.
+    std::deque<std::pair<std::string, std::string>> deferred_acknowledgements_;
     FeatureSet features_;
     bool have_stat_v2_;
+    bool have_list_recursive_ = false;
 
     TransferLedger global_ledger_;
     TransferLedger current_ledger_;
     LinePrinter line_printer_;
 
+    void RecordFileSent(const char* from, const char* to) {
+        deferred_acknowledgements_.emplace_back(from, to);
+    }
+
     bool SendQuit() {
         return SendRequest(ID_QUIT, ""); // TODO: add a SendResponse?
     }
@@ -591,9 +764,12 @@ class SyncConnection {
         if (!WriteFdExactly(fd, data, data_length)) {
             if (errno == ECONNRESET) {
                 // Assume adbd told us why it was closing the connection, and
-                // try to read failure reason from adbd.
+                // try to read failure reason from adbd. If we have files
+                // awaiting acknowledgement, the failure belongs to one of them.
                 syncmsg msg;
-                if (!ReadFdExactly(fd, &msg.status, sizeof(msg.status))) {
+                if (!deferred_acknowledgements_.empty()) {
+                    ReadAcknowledgements(true);
+                } else if (!ReadFdExactly(fd, &msg.status, sizeof(msg.status))) {
                     Error("failed to copy '%s' to '%s': no response: %s", from, to, strerror(errno));
                 } else if (msg.status.id != ID_FAIL) {
                     Error("failed to copy '%s' to '%s': not ID_FAIL: %d", from, to, msg.status.id);
@@ -633,6 +809,43 @@ static bool sync_ls(SyncConnection& sc, const char* path,
     }
 }
 
+typedef void(sync_ls_recursive_cb)(const struct stat& st, const std::string& name);
+
+// Lists the whole tree under 'path' in a single request. Names are relative to 'path', and
+// directories are reported before their contents. Symlinks are not followed.
+static bool sync_ls_recursive(SyncConnection& sc, const char* path,
+                              const std::function<sync_ls_recursive_cb>& func) {
+    if (!sc.SendRequest(ID_LIST_RECURSIVE, path)) return false;
+
+    std::string name;
+    while (true) {
+        syncmsg msg;
+        if (!ReadFdExactly(sc.fd, &msg.dent_v2, sizeof(msg.dent_v2))) return false;
+
+        if (msg.dent_v2.id == ID_DONE) return true;
+        if (msg.dent_v2.id != ID_DENT_V2) return false;
+
+        size_t len = msg.dent_v2.namelen;
+        if (len > PATH_MAX) return false;
+
+        name.resize(len);
+        if (!ReadFdExactly(sc.fd, &name[0], len)) return false;
+
+        struct stat st = {};
+        st.st_dev = msg.dent_v2.dev;
+        st.st_ino = msg.dent_v2.ino;
+        st.st_mode = msg.dent_v2.mode;
+        st.st_nlink = msg.dent_v2.nlink;
+        st.st_uid = msg.dent_v2.uid;
+        st.st_gid = msg.dent_v2.gid;
+        st.st_size = msg.dent_v2.size;
+        st.st_atime = msg.dent_v2.atime;
+        st.st_mtime = msg.dent_v2.mtime;
+        st.st_ctime = msg.dent_v2.ctime;
+        func(st, name);
+    }
+}
+
 static bool sync_stat(SyncConnection& sc, const char* path, struct stat* st) {
     return sc.SendStat(path) && sc.FinishStat(st);
 }
@@ -679,6 +892,11 @@ static bool sync_send(SyncConnection& sc, const char* lpath, const char* rpath,
     std::string path_and_mode = android::base::StringPrintf("%s,%d", rpath, mode);
 
     if (sync) {
+        // The lstat response would be queued behind any outstanding acknowledgements.
+        if (!sc.ReadAcknowledgements(true)) {
+            return false;
+        }
+
         struct stat st;
         if (sync_lstat(sc, rpath, &st)) {
             // For links, we cannot update the atime/mtime.
@@ -703,7 +921,7 @@ static bool sync_send(SyncConnection& sc, const char* lpath, const char* rpath,
         if (!sc.SendSmallFile(path_and_mode.c_str(), lpath, rpath, mtime, buf, data_length)) {
             return false;
         }
-        return sc.CopyDone(lpath, rpath);
+        return sc.ReadAcknowledgements();
 #endif
     }
 
@@ -723,61 +941,97 @@ static bool sync_send(SyncConnection& sc, const char* lpath, const char* rpath,
             return false;
         }
     } else {
+        // SendLargeFile polls for an early failure from adbd while it's writing, which only
+        // works if there are no outstanding acknowledgements from earlier files.
+        if (!sc.ReadAcknowledgements(true)) {
+            return false;
+        }
         if (!sc.SendLargeFile(path_and_mode.c_str(), lpath, rpath, mtime)) {
             return false;
         }
     }
-    return sc.CopyDone(lpath, rpath);
+    return sc.ReadAcknowledgements();
 }
 
-static bool sync_recv(SyncConnection& sc, const char* rpath, const char* lpath,
-                      const char* name, uint64_t expected_size) {
-    if (!sc.SendRequest(ID_RECV, rpath)) return false;
+static bool sync_recv_request(SyncConnection& sc, const char* rpath) {
+    if (sc.CompressionEnabled()) {
+        return sc.SendRequestV2(ID_RECV_V2, rpath, kSyncFlagBrotli);
+    }
+    return sc.SendRequest(ID_RECV, rpath);
+}
 
-    adb_unlink(lpath);
-    unique_fd lfd(adb_creat(lpath, 0644));
-    if (lfd < 0) {
-        sc.Error("cannot create '%s': %s", lpath, strerror(errno));
-        return false;
+// Reads the reply to a RECV request already sent for |rpath|, handing the file's contents to
+// |write| as they arrive. |write| reports its own errors. Returns false on failure, leaving any
+// cleanup of |lpath| to the caller.
+static bool sync_recv_reply(SyncConnection& sc, const char* rpath, const char* lpath,
+                            const char* name, uint64_t expected_size,
+                            const std::function<bool(const char*, size_t)>& write) {
+    std::unique_ptr<BrotliDecoder> decoder;
+    std::vector<char> decode_buffer;
+    BrotliDecoder::Result decode_result = BrotliDecoder::Result::kNeedsMoreInput;
+    if (sc.CompressionEnabled()) {
+        decoder = std::make_unique<BrotliDecoder>();
+        decode_buffer.resize(sc.max);
     }
 
     uint64_t bytes_copied = 0;
     while (true) {
         syncmsg msg;
         if (!ReadFdExactly(sc.fd, &msg.data, sizeof(msg.data))) {
-            adb_unlink(lpath);
             return false;
         }
 
-        if (msg.data.id == ID_DONE) break;
+        if (msg.data.id == ID_DONE) {
+            if (decoder && decode_result != BrotliDecoder::Result::kDone) {
+                sc.Error("failed to copy '%s' to '%s': truncated compressed data", rpath, lpath);
+                return false;
+            }
+            break;
+        }
 
         if (msg.data.id != ID_DATA) {
-            adb_unlink(lpath);
             sc.ReportCopyFailure(rpath, lpath, msg);
             return false;
         }
 
         if (msg.data.size > sc.max) {
             sc.Error("msg.data.size too large: %u (max %zu)", msg.data.size, sc.max);
-            adb_unlink(lpath);
             return false;
         }
 
-        char buffer[SYNC_DATA_MAX];
-        if (!ReadFdExactly(sc.fd, buffer, msg.data.size)) {
-            adb_unlink(lpath);
+        if (!ReadFdExactly(sc.fd, &sc.buffer[0], msg.data.size)) {
             return false;
         }
 
-        if (!WriteFdExactly(lfd, buffer, msg.data.size)) {
-            sc.Error("cannot write '%s': %s", lpath, strerror(errno));
-            adb_unlink(lpath);
+        size_t bytes_written = 0;
+        bool write_failed = false;
+        if (decoder) {
+            decode_result = decoder->Decode(
+                    &sc.buffer[0], msg.data.size, &decode_buffer[0], decode_buffer.size(),
+                    [&](const char* data, size_t size) {
+                        if (!write(data, size)) {
+                            write_failed = true;
+                            return false;
+                        }
+                        bytes_written += size;
+                        return true;
+                    });
+        } else {
+            write_failed = !write(&sc.buffer[0], msg.data.size);
+            bytes_written = msg.data.size;
+        }
+
+        if (write_failed) {
+            return false;
+        }
+        if (decoder && decode_result == BrotliDecoder::Result::kError) {
+            sc.Error("failed to copy '%s' to '%s': decompression failed", rpath, lpath);
             return false;
         }
 
-        bytes_copied += msg.data.size;
+        bytes_copied += bytes_written;
 
-        sc.RecordBytesTransferred(msg.data.size);
+        sc.RecordBytesTransferred(bytes_written);
         sc.ReportProgress(name != nullptr ? name : rpath, bytes_copied, expected_size);
     }
 
@@ -785,6 +1039,31 @@ static bool sync_recv(SyncConnection& sc, const char* rpath, const char* lpath,
     return true;
 }
 
+static bool sync_recv(SyncConnection& sc, const char* rpath, const char* lpath,
+                      const char* name, uint64_t expected_size) {
+    if (!sync_recv_request(sc, rpath)) return false;
+
+    adb_unlink(lpath);
+    unique_fd lfd(adb_creat(lpath, 0644));
+    if (lfd < 0) {
+        sc.Error("cannot create '%s': %s", lpath, strerror(errno));
+        return false;
+    }
+
+    auto write = [&](const char* data, size_t size) {
+        if (!WriteFdExactly(lfd, data, size)) {
+            sc.Error("cannot write '%s': %s", lpath, strerror(errno));
+            return false;
+        }
+        return true;
+    };
+    if (!sync_recv_reply(sc, rpath, lpath, name, expected_size, write)) {
+        adb_unlink(lpath);
+        return false;
+    }
+    return true;
+}
+
 bool do_sync_ls(const char* path) {
     SyncConnection sc;
     if (!sc.IsValid()) return false;
@@ -912,23 +1191,42 @@ static bool copy_local_dir_remote(SyncConnection& sc, std::string lpath,
     }
 
     if (check_timestamps) {
-        for (const copyinfo& ci : file_list) {
-            if (!sc.SendLstat(ci.rpath.c_str())) {
-                sc.Error("failed to send lstat");
+        auto check_remote = [](copyinfo& ci, const struct stat& st) {
+            if (st.st_size == static_cast<off_t>(ci.size)) {
+                // For links, we cannot update the atime/mtime.
+                if ((S_ISREG(ci.mode & st.st_mode) && st.st_mtime == ci.time) ||
+                    (S_ISLNK(ci.mode & st.st_mode) && st.st_mtime >= ci.time)) {
+                    ci.skip = true;
+                }
+            }
+        };
+
+        if (sc.HaveListRecursive()) {
+            // Fetch the metadata for the whole remote tree at once, rather than asking
+            // about each file.
+            std::unordered_map<std::string, struct stat> remote_files;
+            auto callback = [&](const struct stat& st, const std::string& name) {
+                if (!S_ISDIR(st.st_mode)) remote_files.emplace(rpath + name, st);
+            };
+            if (!sync_ls_recursive(sc, rpath.c_str(), callback)) {
+                sc.Error("failed to list '%s'", rpath.c_str());
                 return false;
             }
-        }
-        for (copyinfo& ci : file_list) {
-            struct stat st;
-            if (sc.FinishStat(&st)) {
-                if (st.st_size == static_cast<off_t>(ci.size)) {
-                    // For links, we cannot update the atime/mtime.
-                    if ((S_ISREG(ci.mode & st.st_mode) && st.st_mtime == ci.time) ||
-                        (S_ISLNK(ci.mode & st.st_mode) && st.st_mtime >= ci.time)) {
-                        ci.skip = true;
-                    }
+            for (copyinfo& ci : file_list) {
+                auto it = remote_files.find(ci.rpath);
+                if (it != remote_files.end()) check_remote(ci, it->second);
+            }
+        } else {
+            for (const copyinfo& ci : file_list) {
+                if (!sc.SendLstat(ci.rpath.c_str())) {
+                    sc.Error("failed to send lstat");
+                    return false;
                 }
             }
+            for (copyinfo& ci : file_list) {
+                struct stat st;
+                if (sc.FinishStat(&st)) check_remote(ci, st);
+            }
         }
     }
 
@@ -948,14 +1246,20 @@ static bool copy_local_dir_remote(SyncConnection& sc, std::string lpath,
         }
     }
 
+    if (!sc.ReadAcknowledgements(true)) {
+        return false;
+    }
+
     sc.RecordFilesSkipped(skipped);
     sc.ReportTransferRate(lpath, TransferDirection::push);
     return true;
 }
 
-bool do_sync_push(const std::vector<const char*>& srcs, const char* dst, bool sync) {
+bool do_sync_push(const std::vector<const char*>& srcs, const char* dst, bool sync,
+                  bool compressed) {
     SyncConnection sc;
     if (!sc.IsValid()) return false;
+    if (compressed) sc.EnableCompression();
 
     bool success = true;
     bool dst_exists;
@@ -1040,6 +1344,7 @@ bool do_sync_push(const std::vector<const char*>& srcs, const char* dst, bool sy
         sc.NewTransfer();
         sc.SetExpectedTotalBytes(st.st_size);
         success &= sync_send(sc, src_path, dst_path, st.st_mtime, st.st_mode, sync);
+        success &= sc.ReadAcknowledgements(true);
         sc.ReportTransferRate(src_path, TransferDirection::push);
     }
 
@@ -1057,30 +1362,56 @@ static bool remote_build_list(SyncConnection& sc, std::vector<copyinfo>* file_li
                 android::base::Basename(lpath), S_IFDIR);
     file_list->push_back(ci);
 
-    // Put the files/dirs in rpath on the lists.
-    auto callback = [&](unsigned mode, unsigned size, unsigned time, const char* name) {
-        if (IsDotOrDotDot(name)) {
-            return;
+    if (sc.HaveListRecursive()) {
+        // Get the whole tree in one go. Directories come before their contents, so adding
+        // them to the list in order means they'll be created before we pull into them.
+        auto callback = [&](const struct stat& st, const std::string& name) {
+            copyinfo ci(lpath, rpath, name, st.st_mode);
+            if (S_ISDIR(st.st_mode)) {
+                file_list->push_back(ci);
+            } else if (S_ISLNK(st.st_mode)) {
+                linklist.push_back(ci);
+            } else {
+                if (!should_pull_file(ci.mode)) {
+                    sc.Warning("skipping special file '%s' (mode = 0o%o)", ci.rpath.c_str(),
+                               ci.mode);
+                    ci.skip = true;
+                }
+                ci.time = st.st_mtime;
+                ci.size = st.st_size;
+                file_list->push_back(ci);
+            }
+        };
+        if (!sync_ls_recursive(sc, rpath.c_str(), callback)) {
+            return false;
         }
+    } else {
+        // Put the files/dirs in rpath on the lists.
+        auto callback = [&](unsigned mode, unsigned size, unsigned time, const char* name) {
+            if (IsDotOrDotDot(name)) {
+                return;
+            }
 
-        copyinfo ci(lpath, rpath, name, mode);
-        if (S_ISDIR(mode)) {
-            dirlist.push_back(ci);
-        } else if (S_ISLNK(mode)) {
-            linklist.push_back(ci);
-        } else {
-            if (!should_pull_file(ci.mode)) {
-                sc.Warning("skipping special file '%s' (mode = 0o%o)", ci.rpath.c_str(), ci.mode);
-                ci.skip = true;
+            copyinfo ci(lpath, rpath, name, mode);
+            if (S_ISDIR(mode)) {
+                dirlist.push_back(ci);
+            } else if (S_ISLNK(mode)) {
+                linklist.push_back(ci);
+            } else {
+                if (!should_pull_file(ci.mode)) {
+                    sc.Warning("skipping special file '%s' (mode = 0o%o)", ci.rpath.c_str(),
+                               ci.mode);
+                    ci.skip = true;
+                }
+                ci.time = time;
+                ci.size = size;
+                file_list->push_back(ci);
             }
-            ci.time = time;
-            ci.size = size;
-            file_list->push_back(ci);
-        }
-    };
+        };
 
-    if (!sync_ls(sc, rpath.c_str(), callback)) {
-        return false;
+        if (!sync_ls(sc, rpath.c_str(), callback)) {
+            return false;
+        }
     }
 
     // Check each symlink we found to see whether it's a file or directory.
@@ -1123,6 +1454,237 @@ static int set_time_and_mode(const std::string& lpath, time_t time,
     return r1 ? r1 : r2;
 }
 
+// Writes pulled files to local disk on a small pool of threads, so that receiving from the device
+// isn't held up by local write latency. All writes to a given file are made by the same thread,
+// in order.
+class PullWriteBehind {
+  public:
+    struct File {
+        std::string lpath;
+        unique_fd fd;
+        time_t time;
+        mode_t mode;
+        size_t worker;
+        bool failed = false;
+    };
+
+    PullWriteBehind(size_t thread_count, bool copy_attrs) : copy_attrs_(copy_attrs) {
+        for (size_t i = 0; i < thread_count; ++i) {
+            workers_.emplace_back(std::make_unique<Worker>());
+        }
+        for (size_t i = 0; i < thread_count; ++i) {
+            workers_[i]->thread = std::thread([this, i]() { Run(workers_[i].get()); });
+        }
+    }
+
+    ~PullWriteBehind() { Join(); }
+
+    // Creates the local file for |ci|, with room for the size the device reported.
+    std::shared_ptr<File> Open(SyncConnection& sc, const copyinfo& ci) {
+        adb_unlink(ci.lpath.c_str());
+        unique_fd fd(adb_creat(ci.lpath.c_str(), 0644));
+        if (fd < 0) {
+            sc.Error("cannot create '%s': %s", ci.lpath.c_str(), strerror(errno));
+            return nullptr;
+        }
+#if defined(__linux__)
+        // Best effort: this only saves the filesystem from growing the file chunk by chunk.
+        if (ci.size != 0) {
+            fallocate(fd.get(), FALLOC_FL_KEEP_SIZE, 0, ci.size);
+        }
+#endif
+
+        auto file = std::make_shared<File>();
+        file->lpath = ci.lpath;
+        file->fd = std::move(fd);
+        file->time = ci.time;
+        file->mode = ci.mode;
+        file->worker = next_worker_++ % workers_.size();
+        return file;
+    }
+
+    // Queues |size| bytes of |data| to be appended to |file|, waiting for earlier writes to
+    // drain if too much is already queued. Returns false if any write has failed.
+    bool Write(SyncConnection& sc, const std::shared_ptr<File>& file, const char* data,
+               size_t size) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        space_cv_.wait(lock, [this, size]() {
+            return !error_.empty() || queued_bytes_ == 0 ||
+                   queued_bytes_ + size <= kMaxQueuedBytes;
+        });
+        if (!error_.empty()) {
+            sc.Error("%s", error_.c_str());
+            return false;
+        }
+
+        queued_bytes_ += size;
+        Enqueue(file, std::vector<char>(data, data + size), false);
+        return true;
+    }
+
+    // Queues the closing of |file|, after all of its writes.
+    void Close(const std::shared_ptr<File>& file) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        Enqueue(file, {}, true);
+    }
+
+    // Waits for all queued writes to finish. Returns false (having reported the error) if any
+    // of them failed.
+    bool Finish(SyncConnection& sc) {
+        Join();
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!error_.empty()) {
+            sc.Error("%s", error_.c_str());
+            return false;
+        }
+        return true;
+    }
+
+  private:
+    static constexpr size_t kMaxQueuedBytes = 64 * 1024 * 1024;
+
+    struct Task {
+        std::shared_ptr<File> file;
+        std::vector<char> data;
+        bool close;
+    };
+
+    struct Worker {
+        std::thread thread;
+        std::deque<Task> tasks;
+        std::condition_variable cv;
+    };
+
+    void Enqueue(const std::shared_ptr<File>& file, std::vector<char> data, bool close)
+            {
+        Worker* worker = workers_[file->worker].get();
+        worker->tasks.push_back(Task{file, std::move(data), close});
+        worker->cv.notify_one();
+    }
+
+  public:
+    // Waits for all queued work to finish, without reporting errors.
+    void Join() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (finished_) return;
+            finished_ = true;
+            for (auto& worker : workers_) {
+                worker->cv.notify_one();
+            }
+        }
+        for (auto& worker : workers_) {
+            worker->thread.join();
+        }
+    }
+
+  private:
+    void Run(Worker* worker) {
+        while (true) {
+            Task task;
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                        worker->cv.wait(lock, [this, worker]() {
+                    return finished_ || !worker->tasks.empty();
+                });
+                if (worker->tasks.empty()) return;
+                task = std::move(worker->tasks.front());
+                worker->tasks.pop_front();
+            }
+
+            File* file = task.file.get();
+            std::string error;
+            if (file->failed) {
+                // Drop the rest of a file we've already given up on.
+            } else if (task.close) {
+                file->fd.reset();
+                if (copy_attrs_ && set_time_and_mode(file->lpath, file->time, file->mode)) {
+                    error = android::base::StringPrintf("cannot set attributes of '%s': %s",
+                                                        file->lpath.c_str(), strerror(errno));
+                }
+            } else if (!WriteFdExactly(file->fd, task.data.data(), task.data.size())) {
+                error = android::base::StringPrintf("cannot write '%s': %s", file->lpath.c_str(),
+                                                    strerror(errno));
+                file->failed = true;
+                file->fd.reset();
+                adb_unlink(file->lpath.c_str());
+            }
+
+            std::lock_guard<std::mutex> lock(mutex_);
+            queued_bytes_ -= task.data.size();
+            if (!error.empty() && error_.empty()) {
+                error_ = std::move(error);
+            }
+            space_cv_.notify_one();
+        }
+    }
+
+    const bool copy_attrs_;
+    std::vector<std::unique_ptr<Worker>> workers_;
+    size_t next_worker_ = 0;
+
+    // Guards the workers' task queues, and everything below.
+    std::mutex mutex_;
+    std::condition_variable space_cv_;
+    size_t queued_bytes_ = 0;
+    bool finished_ = false;
+    std::string error_;
+};
+
+// How many files' RECV requests to keep outstanding when pulling a directory, so that the device
+// can start on the next file while we're still finishing the last one.
+static constexpr size_t kPullPipelineDepth = 8;
+
+static bool pull_files_pipelined(SyncConnection& sc, const std::vector<copyinfo>& file_list,
+                                 bool copy_attrs) {
+    std::vector<const copyinfo*> files;
+    for (const copyinfo& ci : file_list) {
+        if (!ci.skip && !S_ISDIR(ci.mode)) {
+            files.push_back(&ci);
+        }
+    }
+
+    size_t thread_count = std::clamp(std::thread::hardware_concurrency(), 1U, 4U);
+    PullWriteBehind write_behind(thread_count, copy_attrs);
+    size_t requested = 0;
+    size_t received = 0;
+    for (const copyinfo& ci : file_list) {
+        if (ci.skip) continue;
+
+        if (S_ISDIR(ci.mode)) {
+            // Entry is for an empty directory, create it and continue.
+            // TODO(b/25457350): We don't preserve permissions on directories.
+            if (!mkdirs(ci.lpath)) {
+                sc.Error("failed to create directory '%s': %s", ci.lpath.c_str(),
+                         strerror(errno));
+                return false;
+            }
+            continue;
+        }
+
+        for (; requested < files.size() && requested < received + kPullPipelineDepth;
+             ++requested) {
+            if (!sync_recv_request(sc, files[requested]->rpath.c_str())) return false;
+        }
+
+        std::shared_ptr<PullWriteBehind::File> file = write_behind.Open(sc, ci);
+        if (!file) return false;
+
+        auto write = [&](const char* data, size_t size) {
+            return write_behind.Write(sc, file, data, size);
+        };
+        if (!sync_recv_reply(sc, ci.rpath.c_str(), ci.lpath.c_str(), nullptr, ci.size, write)) {
+            write_behind.Join();
+            adb_unlink(ci.lpath.c_str());
+            return false;
+        }
+        write_behind.Close(file);
+        ++received;
+    }
+
+    return write_behind.Finish(sc);
+}
+
 static bool copy_remote_dir_local(SyncConnection& sc, std::string rpath,
                                   std::string lpath, bool copy_attrs) {
     sc.NewTransfer();
@@ -1140,41 +1702,22 @@ static bool copy_remote_dir_local(SyncConnection& sc, std::string rpath,
 
     sc.ComputeExpectedTotalBytes(file_list);
 
-    int skipped = 0;
-    for (const copyinfo &ci : file_list) {
-        if (!ci.skip) {
-            if (S_ISDIR(ci.mode)) {
-                // Entry is for an empty directory, create it and continue.
-                // TODO(b/25457350): We don't preserve permissions on directories.
-                if (!mkdirs(ci.lpath))  {
-                    sc.Error("failed to create directory '%s': %s",
-                             ci.lpath.c_str(), strerror(errno));
-                    return false;
-                }
-                continue;
-            }
-
-            if (!sync_recv(sc, ci.rpath.c_str(), ci.lpath.c_str(), nullptr, ci.size)) {
-                return false;
-            }
-
-            if (copy_attrs && set_time_and_mode(ci.lpath, ci.time, ci.mode)) {
-                return false;
-            }
-        } else {
-            skipped++;
-        }
+    if (!pull_files_pipelined(sc, file_list, copy_attrs)) {
+        return false;
     }
 
+    int skipped = std::count_if(file_list.begin(), file_list.end(),
+                                [](const copyinfo& ci) { return ci.skip; });
     sc.RecordFilesSkipped(skipped);
     sc.ReportTransferRate(rpath, TransferDirection::pull);
     return true;
 }
 
 bool do_sync_pull(const std::vector<const char*>& srcs, const char* dst,
-                  bool copy_attrs, const char* name) {
+                  bool copy_attrs, const char* name, bool compressed) {
     SyncConnection sc;
     if (!sc.IsValid()) return false;
+    if (compressed) sc.EnableCompression();
 
     bool success = true;
     struct stat st;
@@ -20,8 +20,13 @@
 #include <vector>
 
 bool do_sync_ls(const char* path);
-bool do_sync_push(const std::vector<const char*>& srcs, const char* dst, bool sync);
+bool do_sync_push(const std::vector<const char*>& srcs, const char* dst, bool sync,
+                  bool compressed = false);
 bool do_sync_pull(const std::vector<const char*>& srcs, const char* dst, bool copy_attrs,
-                  const char* name = nullptr);
+                  const char* name = nullptr, bool compressed = false);
 
 bool do_sync_sync(const std::string& lpath, const std::string& rpath, bool list_only);
+
+// When enabled, large files being pushed are mapped once and shared between all concurrent
+// sync connections in this process instead of being read separately by each of them.
+void sync_share_local_files(bool enable);
@@ -24,6 +24,8 @@
 #include <arpa/inet.h>
 #endif
 
+#include <mutex>
+#include <set>
 #include <thread>
 
 #include <android-base/stringprintf.h>
@@ -31,12 +33,22 @@
 
 #include "adb_mdns.h"
 #include "adb_trace.h"
+#include "adb_utils.h"
 #include "fdevent.h"
 #include "sysdeps.h"
 
 static DNSServiceRef service_ref;
 static fdevent* service_ref_fde;
 
+// Connecting blocks until the device answers or the connection times out, which must not hold
+// up resolving the other services on the main thread, nor connecting to them.
+static constexpr size_t kMaxConcurrentConnects = 32;
+static WorkerPool& connect_pool = *new WorkerPool("mdns connect", kMaxConcurrentConnects);
+
+// Addresses being connected to, as a service is often reported more than once.
+static std::mutex& connecting_mutex = *new std::mutex;
+static std::set<std::string>& connecting = *new std::set<std::string>;
+
 // Use adb_DNSServiceRefSockFD() instead of calling DNSServiceRefSockFD()
 // directly so that the socket is put through the appropriate compatibility
 // layers to work with the rest of ADB's internal APIs.
@@ -143,11 +155,23 @@ class ResolvedService : public AsyncServiceRef {
             return;
         }
 
-        std::string response;
-        connect_device(android::base::StringPrintf(addr_format, ip_addr, port_),
-                       &response);
-        D("Connect to %s (%s:%hu) : %s", name_.c_str(), ip_addr, port_,
-          response.c_str());
+        std::string address = android::base::StringPrintf(addr_format, ip_addr, port_);
+        {
+            std::lock_guard<std::mutex> lock(connecting_mutex);
+            if (!connecting.insert(address).second) {
+                D("Already connecting to %s (%s)", name_.c_str(), address.c_str());
+                return;
+            }
+        }
+
+        connect_pool.Run([name = name_, address]() {
+            std::string response;
+            connect_device(address, &response);
+            D("Connect to %s (%s) : %s", name.c_str(), address.c_str(), response.c_str());
+
+            std::lock_guard<std::mutex> lock(connecting_mutex);
+            connecting.erase(address);
+        });
     }
 
   private:
@@ -0,0 +1,118 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#include <functional>
+
+#include <brotli/decode.h>
+#include <brotli/encode.h>
+
+// Streaming brotli compression of sync DATA payloads.
+//
+// Both classes write into a caller-supplied output buffer and call |flush| each time it fills
+// up, so that callers can reserve space in front of the output for a DATA header and send
+// header and payload with a single write.
+
+class BrotliEncoder {
+  public:
+    BrotliEncoder() : state_(BrotliEncoderCreateInstance(nullptr, nullptr, nullptr)) {
+        // Favor throughput over ratio: we're competing with USB 2.0, not with the disk.
+        BrotliEncoderSetParameter(state_, BROTLI_PARAM_QUALITY, 1);
+    }
+
+    ~BrotliEncoder() { BrotliEncoderDestroyInstance(state_); }
+
+    // Compresses |input_size| bytes of |input|. If |finish| is set, the rest of the stream is
+    // also emitted. |flush| is called with the number of bytes ready in |output| and returns
+    // false to abort. Returns false on failure.
+    bool Encode(const char* input, size_t input_size, bool finish, char* output,
+                size_t output_size, const std::function<bool(size_t)>& flush) {
+        const uint8_t* next_in = reinterpret_cast<const uint8_t*>(input);
+        size_t available_in = input_size;
+        BrotliEncoderOperation op = finish ? BROTLI_OPERATION_FINISH : BROTLI_OPERATION_PROCESS;
+
+        while (true) {
+            uint8_t* next_out = reinterpret_cast<uint8_t*>(output + output_used_);
+            size_t available_out = output_size - output_used_;
+            if (!BrotliEncoderCompressStream(state_, op, &available_in, &next_in, &available_out,
+                                             &next_out, nullptr)) {
+                return false;
+            }
+            output_used_ = output_size - available_out;
+
+            bool done = available_in == 0 && !BrotliEncoderHasMoreOutput(state_) &&
+                        (!finish || BrotliEncoderIsFinished(state_));
+            if (output_used_ == output_size || (done && finish && output_used_ != 0)) {
+                if (!flush(output_used_)) return false;
+                output_used_ = 0;
+            }
+            if (done) return true;
+        }
+    }
+
+  private:
+    BrotliEncoderState* state_;
+    size_t output_used_ = 0;
+};
+
+class BrotliDecoder {
+  public:
+    enum class Result {
+        kError,
+        kNeedsMoreInput,
+        kDone,
+    };
+
+    BrotliDecoder() : state_(BrotliDecoderCreateInstance(nullptr, nullptr, nullptr)) {}
+
+    ~BrotliDecoder() { BrotliDecoderDestroyInstance(state_); }
+
+    // Decompresses |input_size| bytes of |input|, calling |flush| with each chunk of output
+    // placed in |output|. Returns kDone once the end of the compressed stream has been seen.
+    Result Decode(const char* input, size_t input_size, char* output, size_t output_size,
+                  const std::function<bool(const char*, size_t)>& flush) {
+        const uint8_t* next_in = reinterpret_cast<const uint8_t*>(input);
+        size_t available_in = input_size;
+
+        while (true) {
+            uint8_t* next_out = reinterpret_cast<uint8_t*>(output);
+            size_t available_out = output_size;
+            BrotliDecoderResult rc = BrotliDecoderDecompressStream(
+                    state_, &available_in, &next_in, &available_out, &next_out, nullptr);
+            if (rc == BROTLI_DECODER_RESULT_ERROR) {
+                return Result::kError;
+            }
+
+            size_t produced = output_size - available_out;
+            if (produced != 0 && !flush(output, produced)) {
+                return Result::kError;
+            }
+
+            if (rc == BROTLI_DECODER_RESULT_SUCCESS) {
+                // Trailing garbage after the end of the stream is a protocol error.
+                return available_in == 0 ? Result::kDone : Result::kError;
+            } else if (rc == BROTLI_DECODER_RESULT_NEEDS_MORE_INPUT) {
+                return Result::kNeedsMoreInput;
+            }
+        }
+    }
+
+  private:
+    BrotliDecoderState* state_;
+};
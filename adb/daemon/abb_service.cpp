@@ -14,10 +14,18 @@
  * limitations under the License.
  */
 
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#include "abb_session_protocol.h"
 #include "adb.h"
 #include "adb_io.h"
 #include "adb_unique_fd.h"
 #include "adb_utils.h"
+#include "services.h"
+#include "sysdeps.h"
+#include "shell_protocol.h"
 #include "shell_service.h"
 
 namespace {
@@ -81,8 +89,123 @@ unique_fd AbbProcess::startAbbProcess(unique_fd* error_fd) {
                            kErrorProtocol, error_fd);
 }
 
+// Runs the commands of an abb_session: connection, see abb_session_protocol.h.
+struct AbbSession {
+    explicit AbbSession(unique_fd fd) : fd_(std::move(fd)) {}
+
+    void Run();
+
+  private:
+    void Forward(uint32_t id, unique_fd command_fd);
+    bool SendResponse(uint32_t id, uint32_t kind, const char* data, uint32_t length);
+
+    // Commands past this many wait for one of the running ones to finish.
+    static constexpr size_t kMaxRunning = 16;
+
+    unique_fd fd_;
+
+    std::mutex write_locker_;
+    bool write_failed_ = false;
+
+    std::mutex running_locker_;
+    std::condition_variable running_cv_;
+    size_t running_ = 0;
+};
+
+void AbbSession::Run() {
+    while (true) {
+        AbbSessionRequest request;
+        if (!ReadFdExactly(fd_, &request, sizeof(request))) {
+            break;
+        }
+        if (request.length > ABB_SESSION_MAX_REQUEST) {
+            LOG(ERROR) << "abb session request too large: " << request.length;
+            break;
+        }
+        std::string command(request.length, '\0');
+        if (!ReadFdExactly(fd_, command.data(), command.size())) {
+            break;
+        }
+
+        {
+            std::unique_lock lock{running_locker_};
+            running_cv_.wait(lock, [this]() { return running_ < kMaxRunning; });
+            ++running_;
+        }
+
+        // On failure this is the fd of an error report in the shell protocol, forwarded the same.
+        unique_fd command_fd = execute_binder_command(command);
+        std::thread([this, id = request.id, command_fd = std::move(command_fd)]() mutable {
+            adb_thread_setname("abb session");
+            Forward(id, std::move(command_fd));
+
+            std::lock_guard lock{running_locker_};
+            --running_;
+            running_cv_.notify_all();
+        }).detach();
+    }
+
+    // Let the running commands finish before the fd goes away.
+    std::unique_lock lock{running_locker_};
+    running_cv_.wait(lock, [this]() { return running_ == 0; });
+}
+
+void AbbSession::Forward(uint32_t id, unique_fd command_fd) {
+    auto protocol = std::make_unique<ShellProtocol>(command_fd.get());
+    if (command_fd == -1 || !protocol->Write(ShellProtocol::kIdCloseStdin, 0)) {
+        char exit_code = 1;
+        SendResponse(id, ShellProtocol::kIdExit, &exit_code, 1);
+        return;
+    }
+
+    bool exited = false;
+    while (!exited && protocol->Read()) {
+        switch (protocol->id()) {
+            case ShellProtocol::kIdExit:
+                exited = true;
+                [[fallthrough]];
+            case ShellProtocol::kIdStdout:
+            case ShellProtocol::kIdStderr:
+                if (!SendResponse(id, protocol->id(), protocol->data(), protocol->data_length())) {
+                    return;
+                }
+                break;
+            default:
+                break;
+        }
+    }
+
+    if (!exited) {
+        // The host still has to be told the command is done.
+        char exit_code = 1;
+        SendResponse(id, ShellProtocol::kIdExit, &exit_code, 1);
+    }
+}
+
+bool AbbSession::SendResponse(uint32_t id, uint32_t kind, const char* data, uint32_t length) {
+    std::lock_guard lock{write_locker_};
+    if (write_failed_) {
+        return false;
+    }
+
+    AbbSessionResponse response = {.id = id, .kind = kind, .length = length};
+    if (!WriteFdExactly(fd_, &response, sizeof(response)) || !WriteFdExactly(fd_, data, length)) {
+        // Anything sent after a partial response would be garbage to the host.
+        write_failed_ = true;
+        return false;
+    }
+    return true;
+}
+
 }  // namespace
 
 unique_fd execute_binder_command(std::string_view command) {
     return abbp->sendCommand(command);
 }
+
+unique_fd execute_binder_session() {
+    return create_service_thread("abb_session", [](unique_fd fd) {
+        AbbSession session(std::move(fd));
+        session.Run();
+    });
+}
@@ -30,6 +30,7 @@
 #include <unistd.h>
 #include <utime.h>
 
+#include <algorithm>
 #include <memory>
 #include <string>
 #include <vector>
@@ -51,6 +52,7 @@
 #include "adb_io.h"
 #include "adb_trace.h"
 #include "adb_utils.h"
+#include "compression.h"
 #include "file_sync_protocol.h"
 #include "security_log_tags.h"
 #include "sysdeps/errno.h"
@@ -209,6 +211,71 @@ done:
     return WriteFdExactly(s, &msg.dent, sizeof(msg.dent));
 }
 
+static bool list_tree(int s, const std::string& root, const std::string& relative_dir,
+                      std::vector<char>& out) {
+    std::string dir_path = relative_dir.empty() ? root : root + "/" + relative_dir;
+    std::unique_ptr<DIR, int(*)(DIR*)> d(opendir(dir_path.c_str()), closedir);
+    if (!d) return true;
+
+    std::vector<std::string> subdirs;
+    dirent* de;
+    while ((de = readdir(d.get()))) {
+        if (!strcmp(de->d_name, ".") || !strcmp(de->d_name, "..")) continue;
+
+        std::string name = relative_dir.empty() ? de->d_name : relative_dir + "/" + de->d_name;
+        struct stat st;
+        if (lstat((root + "/" + name).c_str(), &st) != 0) continue;
+
+        syncmsg msg = {};
+        msg.dent_v2.id = ID_DENT_V2;
+        msg.dent_v2.dev = st.st_dev;
+        msg.dent_v2.ino = st.st_ino;
+        msg.dent_v2.mode = st.st_mode;
+        msg.dent_v2.nlink = st.st_nlink;
+        msg.dent_v2.uid = st.st_uid;
+        msg.dent_v2.gid = st.st_gid;
+        msg.dent_v2.size = st.st_size;
+        msg.dent_v2.atime = st.st_atime;
+        msg.dent_v2.mtime = st.st_mtime;
+        msg.dent_v2.ctime = st.st_ctime;
+        msg.dent_v2.namelen = name.size();
+
+        const char* p = reinterpret_cast<const char*>(&msg.dent_v2);
+        out.insert(out.end(), p, p + sizeof(msg.dent_v2));
+        out.insert(out.end(), name.begin(), name.end());
+        if (out.size() >= SYNC_DATA_MAX) {
+            if (!WriteFdExactly(s, out.data(), out.size())) return false;
+            out.clear();
+        }
+
+        // Don't descend into symlinked directories; the client resolves links itself.
+        if (S_ISDIR(st.st_mode)) subdirs.push_back(std::move(name));
+    }
+
+    // Close this directory before recursing, so deep trees don't run us out of fds.
+    d.reset();
+
+    for (const std::string& subdir : subdirs) {
+        if (!list_tree(s, root, subdir, out)) return false;
+    }
+    return true;
+}
+
+// Lists everything under 'path', with paths relative to it. Each directory is listed before
+// its contents, so that the client can create directories in the order it sees them.
+static bool do_list_recursive(int s, const char* path) {
+    std::vector<char> out;
+    std::string root = path;
+    while (root.size() > 1 && root.back() == '/') root.pop_back();
+    if (!list_tree(s, root, "", out)) return false;
+
+    syncmsg msg = {};
+    msg.dent_v2.id = ID_DONE;
+    const char* p = reinterpret_cast<const char*>(&msg.dent_v2);
+    out.insert(out.end(), p, p + sizeof(msg.dent_v2));
+    return WriteFdExactly(s, out.data(), out.size());
+}
+
 // Make sure that SendFail from adb_io.cpp isn't accidentally used in this file.
 #pragma GCC poison SendFail
 
@@ -226,9 +293,17 @@ static bool SendSyncFailErrno(int fd, const std::string& reason) {
 }
 
 static bool handle_send_file(int s, const char* path, uid_t uid, gid_t gid, uint64_t capabilities,
-                             mode_t mode, std::vector<char>& buffer, bool do_unlink) {
+                             mode_t mode, uint32_t flags, std::vector<char>& buffer,
+                             bool do_unlink) {
     syncmsg msg;
     unsigned int timestamp = 0;
+    std::unique_ptr<BrotliDecoder> decoder;
+    std::vector<char> decode_buffer;
+    BrotliDecoder::Result decode_result = BrotliDecoder::Result::kNeedsMoreInput;
+    if (flags & kSyncFlagBrotli) {
+        decoder = std::make_unique<BrotliDecoder>();
+        decode_buffer.resize(buffer.size());
+    }
 
     __android_log_security_bswrite(SEC_TAG_ADB_SEND_FILE, path);
 
@@ -288,12 +363,36 @@ static bool handle_send_file(int s, const char* path, uid_t uid, gid_t gid, uint
 
         if (!ReadFdExactly(s, &buffer[0], msg.data.size)) goto abort;
 
-        if (!WriteFdExactly(fd.get(), &buffer[0], msg.data.size)) {
+        if (decoder) {
+            if (decode_result == BrotliDecoder::Result::kDone) {
+                SendSyncFail(s, "data after end of compressed stream");
+                goto fail;
+            }
+            bool write_failed = false;
+            decode_result = decoder->Decode(
+                    &buffer[0], msg.data.size, &decode_buffer[0], decode_buffer.size(),
+                    [&](const char* data, size_t size) {
+                        write_failed = !WriteFdExactly(fd.get(), data, size);
+                        return !write_failed;
+                    });
+            if (write_failed) {
+                SendSyncFailErrno(s, "write failed");
+                goto fail;
+            } else if (decode_result == BrotliDecoder::Result::kError) {
+                SendSyncFail(s, "decompression failed");
+                goto fail;
+            }
+        } else if (!WriteFdExactly(fd.get(), &buffer[0], msg.data.size)) {
             SendSyncFailErrno(s, "write failed");
             goto fail;
         }
     }
 
+    if (decoder && decode_result != BrotliDecoder::Result::kDone) {
+        SendSyncFail(s, "truncated compressed data");
+        goto abort;
+    }
+
     if (!update_capabilities(path, capabilities)) {
         SendSyncFailErrno(s, "update_capabilities failed");
         goto fail;
@@ -394,7 +493,7 @@ static bool handle_send_link(int s, const std::string& path, std::vector<char>&
 }
 #endif
 
-static bool do_send(int s, const std::string& spec, std::vector<char>& buffer) {
+static bool do_send(int s, const std::string& spec, uint32_t flags, std::vector<char>& buffer) {
     // 'spec' is of the form "/some/path,0755". Break it up.
     size_t comma = spec.find_last_of(',');
     if (comma == std::string::npos) {
@@ -420,6 +519,10 @@ static bool do_send(int s, const std::string& spec, std::vector<char>& buffer) {
     }
 
     if (S_ISLNK(mode)) {
+        if (flags != kSyncFlagNone) {
+            SendSyncFail(s, "flags not supported for symlinks");
+            return false;
+        }
         return handle_send_link(s, path.c_str(), buffer);
     }
 
@@ -436,10 +539,31 @@ static bool do_send(int s, const std::string& spec, std::vector<char>& buffer) {
         fs_config(path.c_str(), 0, nullptr, &uid, &gid, &broken_api_hack, &capabilities);
         mode = broken_api_hack;
     }
-    return handle_send_file(s, path.c_str(), uid, gid, capabilities, mode, buffer, do_unlink);
+    return handle_send_file(s, path.c_str(), uid, gid, capabilities, mode, flags, buffer,
+                            do_unlink);
 }
 
-static bool do_recv(int s, const char* path, std::vector<char>& buffer) {
+static bool do_data_max(int s, const char* requested_size, std::vector<char>& buffer) {
+    errno = 0;
+    char* end;
+    unsigned long requested = strtoul(requested_size, &end, 10);
+    if (errno != 0 || *end != '\0') {
+        SendSyncFail(s, "bad data max");
+        return false;
+    }
+
+    // Never go below what every client can handle, nor above what we're willing to allocate.
+    size_t data_max = std::min(std::max(requested, static_cast<unsigned long>(SYNC_DATA_MAX)),
+                               static_cast<unsigned long>(SYNC_DATA_MAX_V2));
+    buffer.resize(data_max);
+
+    syncmsg msg;
+    msg.data.id = ID_DMAX;
+    msg.data.size = data_max;
+    return WriteFdExactly(s, &msg.data, sizeof(msg.data));
+}
+
+static bool do_recv(int s, const char* path, uint32_t flags, std::vector<char>& buffer) {
     __android_log_security_bswrite(SEC_TAG_ADB_RECV_FILE, path);
 
     unique_fd fd(adb_open(path, O_RDONLY | O_CLOEXEC));
@@ -452,18 +576,42 @@ static bool do_recv(int s, const char* path, std::vector<char>& buffer) {
         D("[ Failed to fadvise: %d ]", errno);
     }
 
+    // Read (or compress) each chunk in behind its header, so that it goes out in a single write.
     syncmsg msg;
-    msg.data.id = ID_DATA;
-    while (true) {
-        int r = adb_read(fd.get(), &buffer[0], buffer.size() - sizeof(msg.data));
-        if (r <= 0) {
+    char* data = &buffer[sizeof(msg.data)];
+    size_t data_max = buffer.size() - sizeof(msg.data);
+    auto send_chunk = [&](size_t size) {
+        msg.data.id = ID_DATA;
+        msg.data.size = size;
+        memcpy(&buffer[0], &msg.data, sizeof(msg.data));
+        return WriteFdExactly(s, &buffer[0], sizeof(msg.data) + size);
+    };
+
+    if (flags & kSyncFlagBrotli) {
+        BrotliEncoder encoder;
+        std::vector<char> input(data_max);
+        while (true) {
+            int r = adb_read(fd.get(), &input[0], input.size());
+            if (r < 0) {
+                SendSyncFailErrno(s, "read failed");
+                return false;
+            }
+            if (!encoder.Encode(&input[0], r, r == 0, data, data_max, send_chunk)) {
+                return false;
+            }
             if (r == 0) break;
-            SendSyncFailErrno(s, "read failed");
-            return false;
         }
-        msg.data.size = r;
-        if (!WriteFdExactly(s, &msg.data, sizeof(msg.data)) || !WriteFdExactly(s, &buffer[0], r)) {
-            return false;
+    } else {
+        while (true) {
+            int r = adb_read(fd.get(), data, data_max);
+            if (r <= 0) {
+                if (r == 0) break;
+                SendSyncFailErrno(s, "read failed");
+                return false;
+            }
+            if (!send_chunk(r)) {
+                return false;
+            }
         }
     }
 
@@ -482,12 +630,20 @@ static const char* sync_id_to_name(uint32_t id) {
       return "stat_v2";
     case ID_LIST:
       return "list";
+    case ID_LIST_RECURSIVE:
+      return "list_recursive";
     case ID_SEND:
       return "send";
     case ID_RECV:
       return "recv";
+    case ID_SEND_V2:
+      return "send_v2";
+    case ID_RECV_V2:
+      return "recv_v2";
     case ID_QUIT:
         return "quit";
+    case ID_DMAX:
+        return "data_max";
     default:
         return "???";
   }
@@ -530,11 +686,35 @@ static bool handle_sync_command(int fd, std::vector<char>& buffer) {
         case ID_LIST:
             if (!do_list(fd, name)) return false;
             break;
+        case ID_LIST_RECURSIVE:
+            if (!do_list_recursive(fd, name)) return false;
+            break;
         case ID_SEND:
-            if (!do_send(fd, name, buffer)) return false;
+            if (!do_send(fd, name, kSyncFlagNone, buffer)) return false;
             break;
         case ID_RECV:
-            if (!do_recv(fd, name, buffer)) return false;
+            if (!do_recv(fd, name, kSyncFlagNone, buffer)) return false;
+            break;
+        case ID_SEND_V2:
+        case ID_RECV_V2: {
+            syncmsg msg;
+            if (!ReadFdExactly(fd, &msg.v2_setup, sizeof(msg.v2_setup))) {
+                SendSyncFail(fd, "setup read failure");
+                return false;
+            }
+            if (msg.v2_setup.id != request.id || (msg.v2_setup.flags & ~kSyncFlagBrotli) != 0) {
+                SendSyncFail(fd, "invalid v2 setup message");
+                return false;
+            }
+            if (request.id == ID_SEND_V2) {
+                if (!do_send(fd, name, msg.v2_setup.flags, buffer)) return false;
+            } else {
+                if (!do_recv(fd, name, msg.v2_setup.flags, buffer)) return false;
+            }
+            break;
+        }
+        case ID_DMAX:
+            if (!do_data_max(fd, name, buffer)) return false;
             break;
         case ID_QUIT:
             return false;
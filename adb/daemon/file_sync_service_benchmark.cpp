@@ -0,0 +1,260 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string.h>
+
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <android-base/file.h>
+#include <android-base/logging.h>
+#include <android-base/stringprintf.h>
+#include <benchmark/benchmark.h>
+
+#include "adb_io.h"
+#include "adb_trace.h"
+#include "daemon/file_sync_service.h"
+#include "file_sync_protocol.h"
+#include "sysdeps.h"
+#include "transport.h"
+
+// End-to-end sync benchmarks: a minimal sync client talks to the real file_sync_service, with
+// the bytes in between carried as A_WRTE packets over a pair of FdConnections, the same way
+// they travel between adb and adbd.
+
+static constexpr size_t kLargeFileSize = 16 * 1024 * 1024;
+static constexpr size_t kSmallFileSize = 1024;
+
+static void CreateSocketpair(unique_fd* fd1, unique_fd* fd2) {
+    int fds[2];
+    if (adb_socketpair(fds) != 0) {
+        LOG(FATAL) << "failed to create socketpair";
+    }
+    fd1->reset(fds[0]);
+    fd2->reset(fds[1]);
+}
+
+static std::unique_ptr<Connection> MakeConnection(unique_fd fd) {
+    auto fd_connection = std::make_unique<FdConnection>(std::move(fd));
+    return std::make_unique<BlockingConnectionAdapter>(std::move(fd_connection));
+}
+
+class SyncBenchmarkConnection {
+  public:
+    SyncBenchmarkConnection() {
+        unique_fd host_transport, device_transport, service_fd;
+        CreateSocketpair(&client_fd_, &host_relay_fd_);
+        CreateSocketpair(&service_fd, &device_relay_fd_);
+        CreateSocketpair(&host_transport, &device_transport);
+
+        host_ = MakeConnection(std::move(host_transport));
+        device_ = MakeConnection(std::move(device_transport));
+
+        // Packets arriving at either end of the transport are delivered to the local socket on
+        // that side, as a local socket's enqueue would.
+        host_->SetReadCallback([this](Connection*, std::unique_ptr<apacket> packet) {
+            return WriteFdExactly(host_relay_fd_, packet->payload.data(), packet->payload.size());
+        });
+        device_->SetReadCallback([this](Connection*, std::unique_ptr<apacket> packet) {
+            return WriteFdExactly(device_relay_fd_, packet->payload.data(),
+                                  packet->payload.size());
+        });
+        for (Connection* connection : {host_.get(), device_.get()}) {
+            connection->SetErrorCallback([](Connection*, const std::string&) {});
+            connection->Start();
+        }
+
+        service_thread_ = std::thread(file_sync_service, std::move(service_fd));
+        host_relay_thread_ = std::thread(Relay, host_relay_fd_.get(), host_.get());
+        device_relay_thread_ = std::thread(Relay, device_relay_fd_.get(), device_.get());
+    }
+
+    ~SyncBenchmarkConnection() {
+        SendRequest(ID_QUIT, "");
+        service_thread_.join();
+        adb_shutdown(client_fd_.get());
+        host_relay_thread_.join();
+        device_relay_thread_.join();
+        host_->Stop();
+        device_->Stop();
+    }
+
+    int fd() const { return client_fd_.get(); }
+
+    bool SendRequest(uint32_t id, const std::string& path) {
+        std::vector<char> buf(sizeof(SyncRequest) + path.size());
+        SyncRequest* req = reinterpret_cast<SyncRequest*>(buf.data());
+        req->id = id;
+        req->path_length = path.size();
+        memcpy(req + 1, path.data(), path.size());
+        return WriteFdExactly(client_fd_, buf.data(), buf.size());
+    }
+
+    // Negotiates the DATA chunk size, returning the size the service agreed to.
+    size_t SetDataMax(size_t data_max) {
+        syncmsg msg;
+        if (!SendRequest(ID_DMAX, std::to_string(data_max)) ||
+            !ReadFdExactly(client_fd_, &msg.data, sizeof(msg.data)) || msg.data.id != ID_DMAX) {
+            LOG(FATAL) << "failed to negotiate chunk size";
+        }
+        return msg.data.size;
+    }
+
+    // Sends |size| bytes of |data| to |path| in |chunk_size| DATA chunks.
+    void Push(const std::string& path, const char* data, size_t size, size_t chunk_size) {
+        if (!SendRequest(ID_SEND, path + ",0644")) LOG(FATAL) << "failed to send SEND";
+
+        std::vector<char> buf(sizeof(syncmsg::data) + chunk_size);
+        syncmsg* msg = reinterpret_cast<syncmsg*>(buf.data());
+        for (size_t offset = 0; offset < size; offset += chunk_size) {
+            size_t length = std::min(chunk_size, size - offset);
+            msg->data.id = ID_DATA;
+            msg->data.size = length;
+            memcpy(&buf[sizeof(msg->data)], data + offset, length);
+            if (!WriteFdExactly(client_fd_, buf.data(), sizeof(msg->data) + length)) {
+                LOG(FATAL) << "failed to send DATA";
+            }
+        }
+
+        msg->data.id = ID_DONE;
+        msg->data.size = 0;
+        if (!WriteFdExactly(client_fd_, &msg->data, sizeof(msg->data)) ||
+            !ReadFdExactly(client_fd_, &msg->status, sizeof(msg->status)) ||
+            msg->status.id != ID_OKAY) {
+            LOG(FATAL) << "push of " << path << " failed";
+        }
+    }
+
+    // Receives |path|, returning the number of bytes read.
+    size_t Pull(const std::string& path, std::vector<char>* buf) {
+        if (!SendRequest(ID_RECV, path)) LOG(FATAL) << "failed to send RECV";
+
+        size_t total = 0;
+        while (true) {
+            syncmsg msg;
+            if (!ReadFdExactly(client_fd_, &msg.data, sizeof(msg.data))) {
+                LOG(FATAL) << "failed to read DATA";
+            }
+            if (msg.data.id == ID_DONE) break;
+            if (msg.data.id != ID_DATA) LOG(FATAL) << "pull of " << path << " failed";
+
+            buf->resize(std::max<size_t>(buf->size(), msg.data.size));
+            if (!ReadFdExactly(client_fd_, buf->data(), msg.data.size)) {
+                LOG(FATAL) << "failed to read DATA payload";
+            }
+            total += msg.data.size;
+        }
+        return total;
+    }
+
+    void Stat(const std::string& path) {
+        syncmsg msg;
+        if (!SendRequest(ID_LSTAT_V2, path) ||
+            !ReadFdExactly(client_fd_, &msg.stat_v2, sizeof(msg.stat_v2)) ||
+            msg.stat_v2.id != ID_LSTAT_V2) {
+            LOG(FATAL) << "stat of " << path << " failed";
+        }
+    }
+
+  private:
+    // Reads from a local socket and writes what arrives to the transport, as a local socket's
+    // read callback would.
+    static void Relay(int fd, Connection* connection) {
+        while (true) {
+            auto packet = std::make_unique<apacket>();
+            packet->payload.resize(MAX_PAYLOAD);
+            int rc = adb_read(fd, packet->payload.data(), packet->payload.size());
+            if (rc <= 0) return;
+
+            packet->payload.resize(rc);
+            memset(&packet->msg, 0, sizeof(packet->msg));
+            packet->msg.command = A_WRTE;
+            packet->msg.data_length = rc;
+            if (!connection->Write(std::move(packet))) return;
+        }
+    }
+
+    unique_fd client_fd_, host_relay_fd_, device_relay_fd_;
+    std::unique_ptr<Connection> host_, device_;
+    std::thread service_thread_, host_relay_thread_, device_relay_thread_;
+};
+
+static void BM_Sync_Push(benchmark::State& state) {
+    TemporaryDir dir;
+    std::string path = android::base::StringPrintf("%s/push", dir.path);
+    std::vector<char> data(kLargeFileSize, 'x');
+
+    SyncBenchmarkConnection connection;
+    size_t chunk_size = connection.SetDataMax(state.range(0));
+    for (auto _ : state) {
+        connection.Push(path, data.data(), data.size(), chunk_size);
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * data.size());
+}
+
+static void BM_Sync_Pull(benchmark::State& state) {
+    TemporaryDir dir;
+    std::string path = android::base::StringPrintf("%s/pull", dir.path);
+    if (!android::base::WriteStringToFile(std::string(kLargeFileSize, 'x'), path)) {
+        LOG(FATAL) << "failed to create " << path;
+    }
+
+    SyncBenchmarkConnection connection;
+    connection.SetDataMax(state.range(0));
+    std::vector<char> buf;
+    size_t bytes = 0;
+    for (auto _ : state) {
+        bytes += connection.Pull(path, &buf);
+    }
+    state.SetBytesProcessed(bytes);
+}
+
+static void BM_Sync_PushSmallFiles(benchmark::State& state) {
+    TemporaryDir dir;
+    std::vector<char> data(kSmallFileSize, 'x');
+
+    SyncBenchmarkConnection connection;
+    size_t i = 0;
+    for (auto _ : state) {
+        std::string path = android::base::StringPrintf("%s/%zu", dir.path, i++ % 1024);
+        connection.Push(path, data.data(), data.size(), SYNC_DATA_MAX);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+static void BM_Sync_Stat(benchmark::State& state) {
+    TemporaryDir dir;
+
+    SyncBenchmarkConnection connection;
+    for (auto _ : state) {
+        connection.Stat(dir.path);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+BENCHMARK(BM_Sync_Push)->Arg(SYNC_DATA_MAX)->Arg(256 * 1024)->Arg(SYNC_DATA_MAX_V2)->UseRealTime();
+BENCHMARK(BM_Sync_Pull)->Arg(SYNC_DATA_MAX)->Arg(256 * 1024)->Arg(SYNC_DATA_MAX_V2)->UseRealTime();
+BENCHMARK(BM_Sync_PushSmallFiles)->UseRealTime();
+BENCHMARK(BM_Sync_Stat)->UseRealTime();
+
+int main(int argc, char** argv) {
+    android::base::SetMinimumLogSeverity(android::base::WARNING);
+    adb_trace_init(argv);
+    ::benchmark::Initialize(&argc, argv);
+    if (::benchmark::ReportUnrecognizedArguments(argc, argv)) return 1;
+    ::benchmark::RunSpecifiedBenchmarks();
+}
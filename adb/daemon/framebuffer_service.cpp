@@ -28,6 +28,13 @@
 #include <sys/wait.h>
 #include <unistd.h>
 
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include <brotli/encode.h>
+
 #include "sysdeps.h"
 
 #include "adb.h"
@@ -58,19 +65,101 @@ struct fbinfo {
     unsigned int alpha_length;
 } __attribute__((packed));
 
-void framebuffer_service(unique_fd fd) {
-    struct fbinfo fbinfo;
-    unsigned int i, bsize;
-    char buf[640];
-    int fd_screencap;
-    int w, h, f, c;
-    int fds[2];
-    pid_t pid;
+// Fills in |fbinfo| for a screencap image of the given size, format and color space.
+// Returns false if the format isn't supported.
+static bool fill_fbinfo(int w, int h, int f, int c, fbinfo* fbinfo) {
+    fbinfo->version = DDMS_RAWIMAGE_VERSION;
+    fbinfo->colorSpace = c;
+    /* see hardware/hardware.h */
+    switch (f) {
+        case 1: /* RGBA_8888 */
+            fbinfo->bpp = 32;
+            fbinfo->size = w * h * 4;
+            fbinfo->width = w;
+            fbinfo->height = h;
+            fbinfo->red_offset = 0;
+            fbinfo->red_length = 8;
+            fbinfo->green_offset = 8;
+            fbinfo->green_length = 8;
+            fbinfo->blue_offset = 16;
+            fbinfo->blue_length = 8;
+            fbinfo->alpha_offset = 24;
+            fbinfo->alpha_length = 8;
+            break;
+        case 2: /* RGBX_8888 */
+            fbinfo->bpp = 32;
+            fbinfo->size = w * h * 4;
+            fbinfo->width = w;
+            fbinfo->height = h;
+            fbinfo->red_offset = 0;
+            fbinfo->red_length = 8;
+            fbinfo->green_offset = 8;
+            fbinfo->green_length = 8;
+            fbinfo->blue_offset = 16;
+            fbinfo->blue_length = 8;
+            fbinfo->alpha_offset = 24;
+            fbinfo->alpha_length = 0;
+            break;
+        case 3: /* RGB_888 */
+            fbinfo->bpp = 24;
+            fbinfo->size = w * h * 3;
+            fbinfo->width = w;
+            fbinfo->height = h;
+            fbinfo->red_offset = 0;
+            fbinfo->red_length = 8;
+            fbinfo->green_offset = 8;
+            fbinfo->green_length = 8;
+            fbinfo->blue_offset = 16;
+            fbinfo->blue_length = 8;
+            fbinfo->alpha_offset = 24;
+            fbinfo->alpha_length = 0;
+            break;
+        case 4: /* RGB_565 */
+            fbinfo->bpp = 16;
+            fbinfo->size = w * h * 2;
+            fbinfo->width = w;
+            fbinfo->height = h;
+            fbinfo->red_offset = 11;
+            fbinfo->red_length = 5;
+            fbinfo->green_offset = 5;
+            fbinfo->green_length = 6;
+            fbinfo->blue_offset = 0;
+            fbinfo->blue_length = 5;
+            fbinfo->alpha_offset = 0;
+            fbinfo->alpha_length = 0;
+            break;
+        case 5: /* BGRA_8888 */
+            fbinfo->bpp = 32;
+            fbinfo->size = w * h * 4;
+            fbinfo->width = w;
+            fbinfo->height = h;
+            fbinfo->red_offset = 16;
+            fbinfo->red_length = 8;
+            fbinfo->green_offset = 8;
+            fbinfo->green_length = 8;
+            fbinfo->blue_offset = 0;
+            fbinfo->blue_length = 8;
+            fbinfo->alpha_offset = 24;
+            fbinfo->alpha_length = 8;
+           break;
+        default:
+            return false;
+    }
+    return true;
 
-    if (pipe2(fds, O_CLOEXEC) < 0) return;
+}
 
-    pid = fork();
-    if (pid < 0) goto done;
+// Runs screencap with its stdout connected to |out|. Returns the child's pid, or -1 on failure.
+static pid_t start_screencap(unique_fd* out) {
+    int fds[2];
+    if (pipe2(fds, O_CLOEXEC) < 0) return -1;
+
+    pid_t pid = fork();
+    if (pid < 0) {
+        adb_close(fds[0]);
+        adb_close(fds[1]);
+        return -1;
+    }
 
     if (pid == 0) {
         dup2(fds[1], STDOUT_FILENO);
@@ -83,91 +172,33 @@ void framebuffer_service(unique_fd fd) {
     }
 
     adb_close(fds[1]);
-    fd_screencap = fds[0];
+    out->reset(fds[0]);
+    return pid;
+}
+
+// Reads screencap's header from |fd| and fills in |fbinfo|.
+static bool read_screencap_header(int fd, fbinfo* fbinfo) {
+    int w, h, f, c;
 
     /* read w, h, format & color space */
-    if(!ReadFdExactly(fd_screencap, &w, 4)) goto done;
-    if(!ReadFdExactly(fd_screencap, &h, 4)) goto done;
-    if(!ReadFdExactly(fd_screencap, &f, 4)) goto done;
-    if(!ReadFdExactly(fd_screencap, &c, 4)) goto done;
+    if (!ReadFdExactly(fd, &w, 4)) return false;
+    if (!ReadFdExactly(fd, &h, 4)) return false;
+    if (!ReadFdExactly(fd, &f, 4)) return false;
+    if (!ReadFdExactly(fd, &c, 4)) return false;
 
-    fbinfo.version = DDMS_RAWIMAGE_VERSION;
-    fbinfo.colorSpace = c;
-    /* see hardware/hardware.h */
-    switch (f) {
-        case 1: /* RGBA_8888 */
-            fbinfo.bpp = 32;
-            fbinfo.size = w * h * 4;
-            fbinfo.width = w;
-            fbinfo.height = h;
-            fbinfo.red_offset = 0;
-            fbinfo.red_length = 8;
-            fbinfo.green_offset = 8;
-            fbinfo.green_length = 8;
-            fbinfo.blue_offset = 16;
-            fbinfo.blue_length = 8;
-            fbinfo.alpha_offset = 24;
-            fbinfo.alpha_length = 8;
-            break;
-        case 2: /* RGBX_8888 */
-            fbinfo.bpp = 32;
-            fbinfo.size = w * h * 4;
-            fbinfo.width = w;
-            fbinfo.height = h;
-            fbinfo.red_offset = 0;
-            fbinfo.red_length = 8;
-            fbinfo.green_offset = 8;
-            fbinfo.green_length = 8;
-            fbinfo.blue_offset = 16;
-            fbinfo.blue_length = 8;
-            fbinfo.alpha_offset = 24;
-            fbinfo.alpha_length = 0;
-            break;
-        case 3: /* RGB_888 */
-            fbinfo.bpp = 24;
-            fbinfo.size = w * h * 3;
-            fbinfo.width = w;
-            fbinfo.height = h;
-            fbinfo.red_offset = 0;
-            fbinfo.red_length = 8;
-            fbinfo.green_offset = 8;
-            fbinfo.green_length = 8;
-            fbinfo.blue_offset = 16;
-            fbinfo.blue_length = 8;
-            fbinfo.alpha_offset = 24;
-            fbinfo.alpha_length = 0;
-            break;
-        case 4: /* RGB_565 */
-            fbinfo.bpp = 16;
-            fbinfo.size = w * h * 2;
-            fbinfo.width = w;
-            fbinfo.height = h;
-            fbinfo.red_offset = 11;
-            fbinfo.red_length = 5;
-            fbinfo.green_offset = 5;
-            fbinfo.green_length = 6;
-            fbinfo.blue_offset = 0;
-            fbinfo.blue_length = 5;
-            fbinfo.alpha_offset = 0;
-            fbinfo.alpha_length = 0;
-            break;
-        case 5: /* BGRA_8888 */
-            fbinfo.bpp = 32;
-            fbinfo.size = w * h * 4;
-            fbinfo.width = w;
-            fbinfo.height = h;
-            fbinfo.red_offset = 16;
-            fbinfo.red_length = 8;
-            fbinfo.green_offset = 8;
-            fbinfo.green_length = 8;
-            fbinfo.blue_offset = 0;
-            fbinfo.blue_length = 8;
-            fbinfo.alpha_offset = 24;
-            fbinfo.alpha_length = 8;
-           break;
-        default:
-            goto done;
-    }
+    return fill_fbinfo(w, h, f, c, fbinfo);
+}
+
+void framebuffer_service(unique_fd fd) {
+    struct fbinfo fbinfo;
+    unsigned int i, bsize;
+    char buf[640];
+    unique_fd fd_screencap;
+
+    pid_t pid = start_screencap(&fd_screencap);
+    if (pid < 0) return;
+
+    if (!read_screencap_header(fd_screencap.get(), &fbinfo)) goto done;
 
     /* write header */
     if (!WriteFdExactly(fd.get(), &fbinfo, sizeof(fbinfo))) goto done;
@@ -177,12 +208,154 @@ void framebuffer_service(unique_fd fd) {
       bsize = sizeof(buf);
       if (i + bsize > fbinfo.size)
         bsize = fbinfo.size - i;
-      if(!ReadFdExactly(fd_screencap, buf, bsize)) goto done;
+      if(!ReadFdExactly(fd_screencap.get(), buf, bsize)) goto done;
       if (!WriteFdExactly(fd.get(), buf, bsize)) goto done;
     }
 
 done:
-    adb_close(fds[0]);
+    fd_screencap.reset();
 
     TEMP_FAILURE_RETRY(waitpid(pid, nullptr, 0));
 }
+
+// Captures one frame into |pixels|, filling in |fbinfo|.
+static bool capture_frame(fbinfo* fbinfo, std::vector<char>* pixels) {
+    unique_fd fd_screencap;
+    pid_t pid = start_screencap(&fd_screencap);
+    if (pid < 0) return false;
+
+    bool ok = read_screencap_header(fd_screencap.get(), fbinfo);
+    if (ok) {
+        pixels->resize(fbinfo->size);
+        ok = ReadFdExactly(fd_screencap.get(), pixels->data(), pixels->size());
+    }
+
+    fd_screencap.reset();
+    TEMP_FAILURE_RETRY(waitpid(pid, nullptr, 0));
+    return ok;
+}
+
+static bool same_format(const fbinfo& a, const fbinfo& b) {
+    return memcmp(&a, &b, sizeof(a)) == 0;
+}
+
+struct fbstream_frame_header {
+    unsigned int flags;
+    unsigned int tile_count;
+    unsigned int data_size;   /* size of the tile data as sent */
+    unsigned int raw_size;    /* size of the tile data once decompressed */
+} __attribute__((packed));
+
+struct fbstream_tile {
+    unsigned short x;
+    unsigned short y;
+    unsigned short width;
+    unsigned short height;
+} __attribute__((packed));
+
+#define FBSTREAM_FLAG_FORMAT_CHANGED 0x1
+#define FBSTREAM_FLAG_BROTLI 0x2
+
+// Tiles are square; smaller tiles find tighter dirty regions but cost more per-tile overhead.
+static constexpr int kTileSize = 32;
+
+// Appends a record for every tile of |frame| that differs from |previous| (or every tile, if
+// |previous| is empty) to |out|. Returns the number of tiles appended.
+static unsigned int append_dirty_tiles(const fbinfo& fbinfo, const std::vector<char>& frame,
+                                       const std::vector<char>& previous, std::vector<char>* out) {
+    const size_t bytes_per_pixel = fbinfo.bpp / 8;
+    const size_t stride = fbinfo.width * bytes_per_pixel;
+    unsigned int tile_count = 0;
+
+    for (unsigned int y = 0; y < fbinfo.height; y += kTileSize) {
+        unsigned int height = std::min<unsigned int>(kTileSize, fbinfo.height - y);
+        for (unsigned int x = 0; x < fbinfo.width; x += kTileSize) {
+            unsigned int width = std::min<unsigned int>(kTileSize, fbinfo.width - x);
+            size_t row_bytes = width * bytes_per_pixel;
+            size_t offset = y * stride + x * bytes_per_pixel;
+
+            bool dirty = previous.empty();
+            for (unsigned int row = 0; !dirty && row < height; ++row) {
+                size_t row_offset = offset + row * stride;
+                dirty = memcmp(&frame[row_offset], &previous[row_offset], row_bytes) != 0;
+            }
+            if (!dirty) continue;
+
+            fbstream_tile tile = {static_cast<unsigned short>(x), static_cast<unsigned short>(y),
+                                  static_cast<unsigned short>(width),
+                                  static_cast<unsigned short>(height)};
+            const char* tile_bytes = reinterpret_cast<const char*>(&tile);
+            out->insert(out->end(), tile_bytes, tile_bytes + sizeof(tile));
+            for (unsigned int row = 0; row < height; ++row) {
+                const char* src = &frame[offset + row * stride];
+                out->insert(out->end(), src, src + row_bytes);
+            }
+            ++tile_count;
+        }
+    }
+    return tile_count;
+}
+
+void framebuffer_stream_service(unique_fd fd, int fps, bool compress) {
+    const auto frame_interval = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+            std::chrono::seconds(1)) / std::max(fps, 1);
+
+    struct fbinfo fbinfo = {};
+    struct fbinfo previous_fbinfo = {};
+    std::vector<char> frame, previous, tiles, compressed;
+    auto next_frame = std::chrono::steady_clock::now();
+
+    while (true) {
+        if (!capture_frame(&fbinfo, &frame)) {
+            LOG(ERROR) << "framebuffer-stream: failed to capture frame";
+            return;
+        }
+
+        fbstream_frame_header header = {};
+        if (!same_format(fbinfo, previous_fbinfo)) {
+            // The client needs the new format before any tiles; all of them are now dirty.
+            header.flags |= FBSTREAM_FLAG_FORMAT_CHANGED;
+            previous.clear();
+            previous_fbinfo = fbinfo;
+        }
+
+        tiles.clear();
+        header.tile_count = append_dirty_tiles(fbinfo, frame, previous, &tiles);
+        header.raw_size = tiles.size();
+        header.data_size = tiles.size();
+
+        const char* data = tiles.data();
+        if (compress && !tiles.empty()) {
+            size_t compressed_size = BrotliEncoderMaxCompressedSize(tiles.size());
+            compressed.resize(compressed_size);
+            if (BrotliEncoderCompress(1, BROTLI_DEFAULT_WINDOW, BROTLI_MODE_GENERIC, tiles.size(),
+                                      reinterpret_cast<const uint8_t*>(tiles.data()),
+                                      &compressed_size,
+                                      reinterpret_cast<uint8_t*>(compressed.data())) &&
+                compressed_size < tiles.size()) {
+                header.flags |= FBSTREAM_FLAG_BROTLI;
+                header.data_size = compressed_size;
+                data = compressed.data();
+            }
+        }
+
+        if (!WriteFdExactly(fd.get(), &header, sizeof(header))) return;
+        if ((header.flags & FBSTREAM_FLAG_FORMAT_CHANGED) &&
+            !WriteFdExactly(fd.get(), &fbinfo, sizeof(fbinfo))) {
+            return;
+        }
+        if (header.data_size && !WriteFdExactly(fd.get(), data, header.data_size)) return;
+
+        std::swap(frame, previous);
+
+        // If we've fallen behind (capture is slower than the requested rate), don't try to catch
+        // up with a burst of frames.
+        next_frame += frame_interval;
+        auto now = std::chrono::steady_clock::now();
+        if (next_frame < now) {
+            next_frame = now;
+        } else {
+            std::this_thread::sleep_until(next_frame);
+        }
+    }
+}
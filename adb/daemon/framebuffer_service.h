@@ -20,4 +20,8 @@
 
 #if defined(__ANDROID__)
 void framebuffer_service(unique_fd fd);
+
+// Streams frames at up to |fps| frames per second, sending only the tiles that changed since
+// the previous frame (optionally brotli-compressed) until the client disconnects.
+void framebuffer_stream_service(unique_fd fd, int fps, bool compress);
 #endif
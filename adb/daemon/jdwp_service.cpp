@@ -28,10 +28,15 @@
 #include <sys/un.h>
 #include <unistd.h>
 
+#include <algorithm>
 #include <list>
 #include <memory>
+#include <string>
 #include <vector>
 
+#include <android-base/file.h>
+#include <android-base/stringprintf.h>
+
 #include "adb.h"
 #include "adb_io.h"
 #include "adb_unique_fd.h"
@@ -126,6 +131,7 @@
 
 static void jdwp_process_event(int socket, unsigned events, void* _proc);
 static void jdwp_process_list_updated(void);
+static void jdwp_process_list_changed(const std::string& delta);
 
 struct JdwpProcess;
 static auto& _jdwp_list = *new std::list<std::unique_ptr<JdwpProcess>>();
@@ -169,6 +175,7 @@ struct JdwpProcess {
     }
 
     int32_t pid = -1;
+    std::string name;
     int socket = -1;
     fdevent* fde = nullptr;
 
@@ -210,6 +217,42 @@ static size_t jdwp_process_list_msg(char* buffer, size_t bufferlen) {
     return len + header_len;
 }
 
+// Returns the name a process was started with, or "?" if it can't be read. Note that a VM's
+// JDWP thread can connect before the process has been given its final name.
+static std::string jdwp_process_name(int32_t pid) {
+    std::string cmdline;
+    if (!android::base::ReadFileToString(android::base::StringPrintf("/proc/%d/cmdline", pid),
+                                         &cmdline) ||
+        cmdline.empty()) {
+        return "?";
+    }
+    // Only argv[0], and without anything that would break up the line.
+    cmdline.resize(strlen(cmdline.c_str()));
+    std::replace(cmdline.begin(), cmdline.end(), '\n', ' ');
+    return cmdline;
+}
+
+static std::string jdwp_process_added_line(const JdwpProcess& proc) {
+    return android::base::StringPrintf("+%d %s\n", proc.pid, proc.name.c_str());
+}
+
+static std::string jdwp_process_removed_line(int32_t pid) {
+    return android::base::StringPrintf("-%d\n", pid);
+}
+
+// Formats |content| as a track-jdwp message, length-prefixed with 4 hex digits in ASCII.
+// Content that doesn't fit is truncated at a line boundary.
+static std::string jdwp_delta_msg(std::string content, size_t max_len) {
+    static constexpr size_t header_len = 4;
+    size_t limit = std::min<size_t>(0xffff, max_len - header_len);
+    if (content.size() > limit) {
+        D("truncating JDWP delta message (max len = %zu)", limit);
+        size_t end = content.rfind('\n', limit - 1);
+        content.resize(end == std::string::npos ? 0 : end + 1);
+    }
+    return android::base::StringPrintf("%04zx", content.size()) + content;
+}
+
 static void jdwp_process_event(int socket, unsigned events, void* _proc) {
     JdwpProcess* proc = reinterpret_cast<JdwpProcess*>(_proc);
     CHECK_EQ(socket, proc->socket);
@@ -224,7 +267,9 @@ static void jdwp_process_event(int socket, unsigned events, void* _proc) {
 
             /* all is well, keep reading to detect connection closure */
             D("Adding pid %d to jdwp process list", proc->pid);
+            proc->name = jdwp_process_name(proc->pid);
             jdwp_process_list_updated();
+            jdwp_process_list_changed(jdwp_process_added_line(*proc));
         } else {
             // We already have the PID, if we can read from the socket, we've probably hit EOF.
             D("terminating JDWP connection %d", proc->pid);
@@ -253,8 +298,12 @@ static void jdwp_process_event(int socket, unsigned events, void* _proc) {
     return;
 
 CloseProcess:
+    int32_t pid = proc->pid;
     proc->RemoveFromList();
     jdwp_process_list_updated();
+    if (pid >= 0) {
+        jdwp_process_list_changed(jdwp_process_removed_line(pid));
+    }
 }
 
 unique_fd create_jdwp_connection_fd(int pid) {
@@ -442,10 +491,14 @@ asocket* create_jdwp_service_socket(void) {
 /** "track-jdwp" local service implementation
  ** this periodically sends the list of known JDWP process pids
  ** to the client...
+ **
+ ** "track-jdwp-delta" instead sends the list once, then only
+ ** the processes that were added or removed.
  **/
 
 struct JdwpTracker : public asocket {
     bool need_initial;
+    bool delta;
 };
 
 static auto& _jdwp_trackers = *new std::vector<std::unique_ptr<JdwpTracker>>();
@@ -456,6 +509,7 @@ static void jdwp_process_list_updated(void) {
     data.resize(jdwp_process_list_msg(&data[0], data.size()));
 
     for (auto& t : _jdwp_trackers) {
+        if (t->delta) continue;
         if (t->peer) {
             // The tracker might not have been connected yet.
             apacket::payload_type payload(data.begin(), data.end());
@@ -464,6 +518,16 @@ static void jdwp_process_list_updated(void) {
     }
 }
 
+static void jdwp_process_list_changed(const std::string& delta) {
+    for (auto& t : _jdwp_trackers) {
+        // Trackers that haven't sent their initial list yet will include this change in it.
+        if (!t->delta || t->need_initial || !t->peer) continue;
+        std::string data = jdwp_delta_msg(delta, t->get_max_payload());
+        apacket::payload_type payload(data.begin(), data.end());
+        t->peer->enqueue(t->peer, std::move(payload));
+    }
+}
+
 static void jdwp_tracker_close(asocket* s) {
     D("LS(%d): destroying jdwp tracker service", s->id);
 
@@ -484,7 +548,16 @@ static void jdwp_tracker_close(asocket* s) {
 static void jdwp_tracker_ready(asocket* s) {
     JdwpTracker* t = (JdwpTracker*)s;
 
-    if (t->need_initial) {
+    if (t->need_initial && t->delta) {
+        std::string content;
+        for (auto& proc : _jdwp_list) {
+            if (proc->pid >= 0) content += jdwp_process_added_line(*proc);
+        }
+        std::string msg = jdwp_delta_msg(std::move(content), s->get_max_payload());
+        apacket::payload_type data(msg.begin(), msg.end());
+        t->need_initial = false;
+        s->peer->enqueue(s->peer, std::move(data));
+    } else if (t->need_initial) {
         apacket::payload_type data;
         data.resize(s->get_max_payload());
         data.resize(jdwp_process_list_msg(&data[0], data.size()));
@@ -500,7 +573,7 @@ static int jdwp_tracker_enqueue(asocket* s, apacket::payload_type) {
     return -1;
 }
 
-asocket* create_jdwp_tracker_service_socket(void) {
+static asocket* create_jdwp_tracker(bool delta) {
     auto t = std::make_unique<JdwpTracker>();
     if (!t) {
         LOG(FATAL) << "failed to allocate JdwpTracker";
@@ -515,6 +588,7 @@ asocket* create_jdwp_tracker_service_socket(void) {
     t->enqueue = jdwp_tracker_enqueue;
     t->close = jdwp_tracker_close;
     t->need_initial = true;
+    t->delta = delta;
 
     asocket* result = t.get();
 
@@ -523,6 +597,14 @@ asocket* create_jdwp_tracker_service_socket(void) {
     return result;
 }
 
+asocket* create_jdwp_tracker_service_socket(void) {
+    return create_jdwp_tracker(false);
+}
+
+asocket* create_jdwp_delta_tracker_service_socket(void) {
+    return create_jdwp_tracker(true);
+}
+
 int init_jdwp(void) {
     return jdwp_control_init(&_jdwp_control, JDWP_CONTROL_NAME, JDWP_CONTROL_NAME_LEN);
 }
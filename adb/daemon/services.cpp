@@ -223,6 +223,8 @@ asocket* daemon_service_to_socket(std::string_view name) {
         return create_jdwp_service_socket();
     } else if (name == "track-jdwp") {
         return create_jdwp_tracker_service_socket();
+    } else if (name == "track-jdwp-delta") {
+        return create_jdwp_delta_tracker_service_socket();
     } else if (name.starts_with("sink:")) {
         name.remove_prefix(strlen("sink:"));
         uint64_t byte_count = 0;
@@ -247,12 +249,27 @@ unique_fd daemon_service_to_fd(std::string_view name, atransport* transport) {
     if (name.starts_with("abb:")) {
         name.remove_prefix(strlen("abb:"));
         return execute_binder_command(name);
+    } else if (name == "abb_session:") {
+        return execute_binder_session();
     }
 #endif
 
 #if defined(__ANDROID__)
     if (name.starts_with("framebuffer:")) {
         return create_service_thread("fb", framebuffer_service);
+    } else if (name.starts_with("framebuffer-stream:")) {
+        name.remove_prefix(strlen("framebuffer-stream:"));
+        int fps = 10;
+        bool compress = false;
+        for (const std::string& arg : android::base::Split(std::string(name), ",")) {
+            if (arg == "brotli") {
+                compress = true;
+            } else if (!arg.empty() && !android::base::ParseInt(arg, &fps, 1, 60)) {
+                return unique_fd{};
+            }
+        }
+        return create_service_thread("fbstream", std::bind(framebuffer_stream_service,
+                                                           std::placeholders::_1, fps, compress));
     } else if (name.starts_with("remount:")) {
         std::string arg(name.begin() + strlen("remount:"), name.end());
         return create_service_thread("remount",
@@ -71,7 +71,7 @@
 //
 // An alternate approach is to put the protocol wrapping/unwrapping in the main
 // fdevent loop, which has the advantage of being able to re-use the existing
-// select() code for handling data streams. However, implementation turned out
+// polling code for handling data streams. However, implementation turned out
 // to be more complex due to partial reads and non-blocking I/O so this model
 // was chosen instead.
 
@@ -85,9 +85,11 @@
 #include <paths.h>
 #include <pty.h>
 #include <pwd.h>
-#include <sys/select.h>
+#include <fcntl.h>
+#include <sys/epoll.h>
 #include <termios.h>
 
+#include <algorithm>
 #include <memory>
 #include <string>
 #include <thread>
@@ -174,14 +176,20 @@ class Subprocess {
     void PassDataStreams();
     void WaitForExit();
 
-    unique_fd* SelectLoop(fd_set* master_read_set_ptr,
-                          fd_set* master_write_set_ptr);
+    unique_fd* PollLoop();
+    void SetInputBlocked(bool blocked);
 
     // Input/output stream handlers. Success returns nullptr, failure returns
     // a pointer to the failed FD.
     unique_fd* PassInput();
     unique_fd* PassOutput(unique_fd* sfd, ShellProtocol::Id id);
 
+    // Moves output from |sfd| to the protocol FD through a pipe with splice(), so the data
+    // doesn't have to be copied through userspace. Returns false if splicing isn't possible,
+    // in which case the caller falls back to read()/write(); otherwise sets |dead_sfd| as
+    // PassOutput() would.
+    bool SpliceOutput(unique_fd* sfd, ShellProtocol::Id id, unique_fd** dead_sfd);
+
     const std::string command_;
     const std::string terminal_type_;
     SubprocessType type_;
@@ -194,6 +202,12 @@ class Subprocess {
     unique_fd stdinout_sfd_, stderr_sfd_, protocol_sfd_;
     std::unique_ptr<ShellProtocol> input_, output_;
     size_t input_bytes_left_ = 0;
+    unique_fd epoll_sfd_;
+
+    // Pipe used to splice subprocess output into the protocol FD.
+    bool splice_output_ = true;
+    unique_fd splice_read_sfd_, splice_write_sfd_;
+    size_t splice_size_ = 0;
 
     DISALLOW_COPY_AND_ASSIGN(Subprocess);
 };
@@ -544,24 +558,33 @@ void Subprocess::PassDataStreams() {
         return;
     }
 
+    epoll_sfd_.reset(epoll_create1(EPOLL_CLOEXEC));
+    if (epoll_sfd_ == -1) {
+        PLOG(ERROR) << "epoll_create1 failed, closing subprocess pipes";
+        stdinout_sfd_.reset();
+        stderr_sfd_.reset();
+        return;
+    }
+
     // Start by trying to read from the protocol FD, stdout, and stderr.
-    fd_set master_read_set, master_write_set;
-    FD_ZERO(&master_read_set);
-    FD_ZERO(&master_write_set);
     for (unique_fd* sfd : {&protocol_sfd_, &stdinout_sfd_, &stderr_sfd_}) {
         if (*sfd != -1) {
-            FD_SET(*sfd, &master_read_set);
+            epoll_event event = {};
+            event.events = EPOLLIN;
+            event.data.ptr = sfd;
+            if (epoll_ctl(epoll_sfd_, EPOLL_CTL_ADD, *sfd, &event) != 0) {
+                PLOG(ERROR) << "failed to add FD " << sfd->get() << " to epoll set";
+            }
         }
     }
 
     // Pass data until the protocol FD or both the subprocess pipes die, at
     // which point we can't pass any more data.
     while (protocol_sfd_ != -1 && (stdinout_sfd_ != -1 || stderr_sfd_ != -1)) {
-        unique_fd* dead_sfd = SelectLoop(&master_read_set, &master_write_set);
+        unique_fd* dead_sfd = PollLoop();
         if (dead_sfd) {
             D("closing FD %d", dead_sfd->get());
-            FD_CLR(*dead_sfd, &master_read_set);
-            FD_CLR(*dead_sfd, &master_write_set);
+            epoll_ctl(epoll_sfd_, EPOLL_CTL_DEL, *dead_sfd, nullptr);
             if (dead_sfd == &protocol_sfd_) {
                 // Using SIGHUP is a decent general way to indicate that the
                 // controlling process is going away. If specific signals are
@@ -583,62 +606,83 @@ void Subprocess::PassDataStreams() {
     }
 }
 
-namespace {
-
-inline bool ValidAndInSet(const unique_fd& sfd, fd_set* set) {
-    return sfd != -1 && FD_ISSET(sfd, set);
+void Subprocess::SetInputBlocked(bool blocked) {
+    // While a stdin packet is only partially written, stop reading the protocol FD and wait
+    // for the subprocess's stdin to become writable instead.
+    if (protocol_sfd_ != -1) {
+        epoll_event event = {};
+        event.events = blocked ? 0 : EPOLLIN;
+        event.data.ptr = &protocol_sfd_;
+        epoll_ctl(epoll_sfd_, EPOLL_CTL_MOD, protocol_sfd_, &event);
+    }
+    if (stdinout_sfd_ != -1) {
+        epoll_event event = {};
+        event.events = EPOLLIN | (blocked ? EPOLLOUT : 0);
+        event.data.ptr = &stdinout_sfd_;
+        epoll_ctl(epoll_sfd_, EPOLL_CTL_MOD, stdinout_sfd_, &event);
+    }
 }
 
-}   // namespace
-
-unique_fd* Subprocess::SelectLoop(fd_set* master_read_set_ptr,
-                                  fd_set* master_write_set_ptr) {
-    fd_set read_set, write_set;
-    int select_n = std::max(std::max(protocol_sfd_, stdinout_sfd_), stderr_sfd_) + 1;
+unique_fd* Subprocess::PollLoop() {
     unique_fd* dead_sfd = nullptr;
 
-    // Keep calling select() and passing data until an FD closes/errors.
+    // Keep calling epoll_wait() and passing data until an FD closes/errors.
     while (!dead_sfd) {
-        memcpy(&read_set, master_read_set_ptr, sizeof(read_set));
-        memcpy(&write_set, master_write_set_ptr, sizeof(write_set));
-        if (select(select_n, &read_set, &write_set, nullptr, nullptr) < 0) {
+        epoll_event events[3];
+        int event_count = epoll_wait(epoll_sfd_, events, arraysize(events), -1);
+        if (event_count < 0) {
             if (errno == EINTR) {
                 continue;
             } else {
-                PLOG(ERROR) << "select failed, closing subprocess pipes";
+                PLOG(ERROR) << "epoll_wait failed, closing subprocess pipes";
                 stdinout_sfd_.reset(-1);
                 stderr_sfd_.reset(-1);
                 return nullptr;
             }
         }
 
+        // Hangups and errors are reported as readable/writable so that the handlers see the
+        // EOF or error and report the FD as dead.
+        constexpr uint32_t kReadEvents = EPOLLIN | EPOLLHUP | EPOLLERR;
+        constexpr uint32_t kWriteEvents = EPOLLOUT | EPOLLERR;
+        uint32_t stdinout_events = 0, stderr_events = 0, protocol_events = 0;
+        for (int i = 0; i < event_count; ++i) {
+            if (events[i].data.ptr == &stdinout_sfd_) {
+                stdinout_events = events[i].events;
+            } else if (events[i].data.ptr == &stderr_sfd_) {
+                stderr_events = events[i].events;
+            } else if (events[i].data.ptr == &protocol_sfd_) {
+                protocol_events = events[i].events;
+            }
+        }
+
         // Read stdout, write to protocol FD.
-        if (ValidAndInSet(stdinout_sfd_, &read_set)) {
+        if (stdinout_sfd_ != -1 && (stdinout_events & kReadEvents)) {
             dead_sfd = PassOutput(&stdinout_sfd_, ShellProtocol::kIdStdout);
         }
 
         // Read stderr, write to protocol FD.
-        if (!dead_sfd && ValidAndInSet(stderr_sfd_, &read_set)) {
+        if (!dead_sfd && stderr_sfd_ != -1 && (stderr_events & kReadEvents)) {
             dead_sfd = PassOutput(&stderr_sfd_, ShellProtocol::kIdStderr);
         }
 
         // Read protocol FD, write to stdin.
-        if (!dead_sfd && ValidAndInSet(protocol_sfd_, &read_set)) {
+        if (!dead_sfd && protocol_sfd_ != -1 && !input_bytes_left_ &&
+            (protocol_events & kReadEvents)) {
             dead_sfd = PassInput();
             // If we didn't finish writing, block on stdin write.
             if (input_bytes_left_) {
-                FD_CLR(protocol_sfd_, master_read_set_ptr);
-                FD_SET(stdinout_sfd_, master_write_set_ptr);
+                SetInputBlocked(true);
             }
         }
 
         // Continue writing to stdin; only happens if a previous write blocked.
-        if (!dead_sfd && ValidAndInSet(stdinout_sfd_, &write_set)) {
+        if (!dead_sfd && stdinout_sfd_ != -1 && input_bytes_left_ &&
+                 (stdinout_events & kWriteEvents)) {
             dead_sfd = PassInput();
             // If we finished writing, go back to blocking on protocol read.
             if (!input_bytes_left_) {
-                FD_SET(protocol_sfd_, master_read_set_ptr);
-                FD_CLR(stdinout_sfd_, master_write_set_ptr);
+                SetInputBlocked(false);
             }
         }
     }  // while (!dead_sfd)
@@ -715,7 +759,77 @@ unique_fd* Subprocess::PassInput() {
     return nullptr;
 }
 
+bool Subprocess::SpliceOutput(unique_fd* sfd, ShellProtocol::Id id, unique_fd** dead_sfd) {
+    if (splice_read_sfd_ == -1) {
+        int pipe_fds[2];
+        if (pipe2(pipe_fds, O_CLOEXEC) != 0) {
+            PLOG(WARNING) << "failed to create splice pipe";
+            splice_output_ = false;
+            return false;
+        }
+        splice_read_sfd_.reset(pipe_fds[0]);
+        splice_write_sfd_.reset(pipe_fds[1]);
+
+        // Grow the pipe so that each splice can fill a whole packet. This is best-effort; a
+        // default-sized pipe just means more, smaller packets.
+        fcntl(splice_write_sfd_, F_SETPIPE_SZ, output_->data_capacity());
+        int pipe_size = fcntl(splice_write_sfd_, F_GETPIPE_SZ);
+        splice_size_ = pipe_size > 0 ? std::min<size_t>(pipe_size, output_->data_capacity())
+                                     : output_->data_capacity();
+    }
+
+    ssize_t bytes = splice(*sfd, nullptr, splice_write_sfd_, nullptr, splice_size_,
+                           SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+    if (bytes < 0 && errno == EINVAL) {
+        // Not every kernel can splice from every FD type (PTYs in particular).
+        D("splice unsupported for FD %d, falling back to read", sfd->get());
+        splice_output_ = false;
+        return false;
+    }
+
+    *dead_sfd = nullptr;
+    if (bytes == 0 || (bytes < 0 && errno != EAGAIN)) {
+        // read() returns EIO if a PTY closes; don't report this as an error,
+        // it just means the subprocess completed.
+        if (bytes < 0 && !(type_ == SubprocessType::kPty && errno == EIO)) {
+            PLOG(ERROR) << "error reading output FD " << *sfd;
+        }
+        *dead_sfd = sfd;
+        return true;
+    } else if (bytes < 0) {
+        return true;
+    }
+
+    if (!output_->WriteHeader(id, bytes)) {
+        if (errno != 0) {
+            PLOG(ERROR) << "error writing protocol FD " << protocol_sfd_;
+        }
+        *dead_sfd = &protocol_sfd_;
+        return true;
+    }
+
+    while (bytes > 0) {
+        ssize_t written = splice(splice_read_sfd_, nullptr, protocol_sfd_, nullptr, bytes,
+                                 SPLICE_F_MOVE | SPLICE_F_MORE);
+        if (written <= 0) {
+            if (written < 0 && errno == EINTR) {
+                continue;
+            }
+            PLOG(ERROR) << "error splicing to protocol FD " << protocol_sfd_;
+            *dead_sfd = &protocol_sfd_;
+            return true;
+        }
+        bytes -= written;
+    }
+    return true;
+}
+
 unique_fd* Subprocess::PassOutput(unique_fd* sfd, ShellProtocol::Id id) {
+    unique_fd* dead_sfd;
+    if (splice_output_ && SpliceOutput(sfd, id, &dead_sfd)) {
+        return dead_sfd;
+    }
+
     int bytes = adb_read(*sfd, output_->data(), output_->data_capacity());
     if (bytes == 0 || (bytes < 0 && errno != EAGAIN)) {
         // read() returns EIO if a PTY closes; don't report this as an error,
@@ -810,7 +924,7 @@ unique_fd StartSubprocess(std::string name, const char* terminal_type, Subproces
     // of the PTY closes, which we rely on. If we use a raw pipe, processes that don't read/write,
     // e.g. screenrecord, will never notice the broken pipe and terminate.
     // The shell protocol doesn't require a PTY because it's always monitoring the local socket FD
-    // with select() and will send SIGHUP manually to the child process.
+    // with epoll and will send SIGHUP manually to the child process.
     bool make_pty_raw = false;
     if (protocol == SubprocessProtocol::kNone && type == SubprocessType::kRaw) {
         // Disable PTY input/output processing since the client is expecting raw data.
@@ -56,7 +56,11 @@ using android::base::StringPrintf;
 static constexpr size_t kUsbReadQueueDepth = 16;
 static constexpr size_t kUsbReadSize = 16384;
 
+// Outgoing payloads are split into transfers of at most kUsbWriteSize bytes: FunctionFS
+// allocates a physically contiguous bounce buffer for each transfer, which can fail for larger
+// sizes once memory is fragmented. kUsbWriteQueueDepth of them are kept in flight at a time.
 static constexpr size_t kUsbWriteQueueDepth = 16;
+static constexpr size_t kUsbWriteSize = 16384;
 
 static const char* to_string(enum usb_functionfs_event_type type) {
     switch (type) {
@@ -110,9 +114,11 @@ struct TransferId {
 };
 
 struct IoBlock {
-    bool pending;
-    struct iocb control;
-    Block payload;
+    bool pending = false;
+    struct iocb control = {};
+
+    // Writes of a large payload share the Block, and each covers part of it.
+    std::shared_ptr<Block> payload;
 
     TransferId id() const { return TransferId::from_value(control.aio_data); }
 };
@@ -186,14 +192,20 @@ struct UsbFfsConnection : public Connection {
 
     virtual bool Write(std::unique_ptr<apacket> packet) override final {
         LOG(DEBUG) << "USB write: " << dump_header(&packet->msg);
-        Block header(sizeof(packet->msg));
-        memcpy(header.data(), &packet->msg, sizeof(packet->msg));
+        auto header = std::make_shared<Block>(sizeof(packet->msg));
+        memcpy(header->data(), &packet->msg, sizeof(packet->msg));
 
         std::lock_guard<std::mutex> lock(write_mutex_);
-        write_requests_.push_back(CreateWriteBlock(std::move(header), next_write_id_++));
+        write_requests_.push_back(
+                CreateWriteBlock(std::move(header), 0, sizeof(packet->msg), next_write_id_++));
         if (!packet->payload.empty()) {
-            write_requests_.push_back(
-                    CreateWriteBlock(std::move(packet->payload), next_write_id_++));
+            size_t size = packet->payload.size();
+            auto payload = std::make_shared<Block>(std::move(packet->payload));
+            for (size_t offset = 0; offset < size; offset += kUsbWriteSize) {
+                size_t len = std::min(kUsbWriteSize, size - offset);
+                write_requests_.push_back(
+                        CreateWriteBlock(payload, offset, len, next_write_id_++));
+            }
         }
         SubmitWrites();
         return true;
@@ -311,9 +323,19 @@ struct UsbFfsConnection : public Connection {
     void StartWorker() {
         worker_thread_ = std::thread([this]() {
             adb_thread_setname("UsbFfs-worker");
+
+            // Fill the read queue with a single submission.
+            struct iocb* iocbs[kUsbReadQueueDepth];
             for (size_t i = 0; i < kUsbReadQueueDepth; ++i) {
                 read_requests_[i] = CreateReadBlock(next_read_id_++);
-                SubmitRead(&read_requests_[i]);
+                read_requests_[i].pending = true;
+                iocbs[i] = &read_requests_[i].control;
+            }
+            int rc = io_submit(aio_context_.get(), kUsbReadQueueDepth, iocbs);
+            if (rc != static_cast<int>(kUsbReadQueueDepth)) {
+                HandleError(StringPrintf("failed to submit reads: %s",
+                                         rc == -1 ? strerror(errno) : "short submission"));
+                return;
             }
 
             while (!stopped_) {
@@ -332,22 +354,20 @@ struct UsbFfsConnection : public Connection {
 
     void PrepareReadBlock(IoBlock* block, uint64_t id) {
         block->pending = false;
-        block->payload.resize(kUsbReadSize);
+        if (!block->payload) {
+            block->payload = std::make_shared<Block>();
+        }
+        block->payload->resize(kUsbReadSize);
+        io_prep_pread(&block->control, read_fd_.get(), block->payload->data(),
+                      block->payload->size(), 0);
         block->control.aio_data = static_cast<uint64_t>(TransferId::read(id));
-        block->control.aio_buf = reinterpret_cast<uintptr_t>(block->payload.data());
-        block->control.aio_nbytes = block->payload.size();
+        block->control.aio_flags = IOCB_FLAG_RESFD;
+        block->control.aio_resfd = event_fd_.get();
     }
 
     IoBlock CreateReadBlock(uint64_t id) {
         IoBlock block;
         PrepareReadBlock(&block, id);
-        block.control.aio_rw_flags = 0;
-        block.control.aio_lio_opcode = IOCB_CMD_PREAD;
-        block.control.aio_reqprio = 0;
-        block.control.aio_fildes = read_fd_.get();
-        block.control.aio_offset = 0;
-        block.control.aio_flags = IOCB_FLAG_RESFD;
-        block.control.aio_resfd = event_fd_.get();
         return block;
     }
 
@@ -386,7 +406,7 @@ struct UsbFfsConnection : public Connection {
         uint64_t read_idx = id.id % kUsbReadQueueDepth;
         IoBlock* block = &read_requests_[read_idx];
         block->pending = false;
-        block->payload.resize(size);
+        block->payload->resize(size);
 
         // Notification for completed reads can be received out of order.
         if (block->id().id != needed_read_id_) {
@@ -407,16 +427,16 @@ struct UsbFfsConnection : public Connection {
     }
 
     void ProcessRead(IoBlock* block) {
-        if (!block->payload.empty()) {
+        if (!block->payload->empty()) {
             if (!incoming_header_.has_value()) {
-                CHECK_EQ(sizeof(amessage), block->payload.size());
+                CHECK_EQ(sizeof(amessage), block->payload->size());
                 amessage msg;
-                memcpy(&msg, block->payload.data(), sizeof(amessage));
+                memcpy(&msg, block->payload->data(), sizeof(amessage));
                 LOG(DEBUG) << "USB read:" << dump_header(&msg);
                 incoming_header_ = msg;
             } else {
                 size_t bytes_left = incoming_header_->data_length - incoming_payload_.size();
-                Block payload = std::move(block->payload);
+                Block payload = std::move(*block->payload);
                 CHECK_LE(payload.size(), bytes_left);
                 incoming_payload_.append(std::make_unique<Block>(std::move(payload)));
             }
@@ -462,17 +482,12 @@ struct UsbFfsConnection : public Connection {
         SubmitWrites();
     }
 
-    std::unique_ptr<IoBlock> CreateWriteBlock(Block payload, uint64_t id) {
+    std::unique_ptr<IoBlock> CreateWriteBlock(std::shared_ptr<Block> payload, size_t offset,
+                                              size_t len, uint64_t id) {
         auto block = std::make_unique<IoBlock>();
         block->payload = std::move(payload);
+        io_prep_pwrite(&block->control, write_fd_.get(), block->payload->data() + offset, len, 0);
         block->control.aio_data = static_cast<uint64_t>(TransferId::write(id));
-        block->control.aio_rw_flags = 0;
-        block->control.aio_lio_opcode = IOCB_CMD_PWRITE;
-        block->control.aio_reqprio = 0;
-        block->control.aio_fildes = write_fd_.get();
-        block->control.aio_buf = reinterpret_cast<uintptr_t>(block->payload.data());
-        block->control.aio_nbytes = block->payload.size();
-        block->control.aio_offset = 0;
         block->control.aio_flags = IOCB_FLAG_RESFD;
         block->control.aio_resfd = event_fd_.get();
         return block;
@@ -577,7 +592,7 @@ static void usb_ffs_open_thread() {
 
 void usb_init_legacy();
 void usb_init() {
-    if (!android::base::GetBoolProperty("persist.adb.nonblocking_ffs", false)) {
+    if (!android::base::GetBoolProperty("persist.adb.nonblocking_ffs", true)) {
         usb_init_legacy();
     } else {
         std::thread(usb_ffs_open_thread).detach();
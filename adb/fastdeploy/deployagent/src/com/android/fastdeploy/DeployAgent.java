@@ -30,12 +30,13 @@ import java.io.OutputStream;
 import java.io.RandomAccessFile;
 import java.util.Set;
 
+import com.android.fastdeploy.APKBlockHashList;
 import com.android.fastdeploy.APKMetaData;
 import com.android.fastdeploy.PatchUtils;
 
 public final class DeployAgent {
     private static final int BUFFER_SIZE = 128 * 1024;
-    private static final int AGENT_VERSION = 0x00000002;
+    private static final int AGENT_VERSION = 0x00000003;
 
     public static void main(String[] args) {
         int exitCode = 0;
@@ -53,6 +54,13 @@ public final class DeployAgent {
 
                 String packageName = args[1];
                 extractMetaData(packageName);
+            } else if (commandString.equals("blockhashes")) {
+                if (args.length != 2) {
+                    showUsage(1);
+                }
+
+                String packageName = args[1];
+                extractBlockHashes(packageName);
             } else if (commandString.equals("find")) {
                 if (args.length != 2) {
                     showUsage(1);
@@ -89,9 +97,15 @@ public final class DeployAgent {
                     if (outputStream == null) {
                         outputStream = System.out;
                     }
-                    File deviceFile = getFileFromPackageName(packageName);
-                    writePatchToStream(
-                            new RandomAccessFile(deviceFile, "r"), deltaInputStream, outputStream);
+                    writePatchToStream(packageName, deltaInputStream, outputStream);
+                } else if (outputParam.equals("-session")) {
+                    if (args.length != 6) {
+                        showUsage(1);
+                    }
+                    int sessionId = Integer.parseInt(args[4]);
+                    String splitName = args[5];
+                    exitCode = writePatchedDataToSession(
+                            packageName, deltaInputStream, sessionId, splitName);
                 } else if (outputParam.equals("-pm")) {
                     String[] sessionArgs = null;
                     if (args.length > 4) {
@@ -123,9 +137,12 @@ public final class DeployAgent {
             "version                             get the version\n" +
             "find PKGNAME                        return zero if package found, else non-zero\n" +
             "extract PKGNAME                     extract an installed package's metadata\n" +
-            "apply PKGNAME PATCHFILE [-o|-pm]    apply a patch from PATCHFILE (- for stdin) to an installed package\n" +
+            "blockhashes PKGNAME                 hash the blocks of each of an installed package's APKs\n" +
+            "apply PKGNAME PATCHFILE [-o|-pm|-session]\n" +
+            "                                    apply a patch from PATCHFILE (- for stdin) to an installed package\n" +
             " -o <FILE> directs output to FILE, default or - for stdout\n" +
-            " -pm <ARGS> directs output to package manager, passes <ARGS> to 'pm install-create'\n"
+            " -pm <ARGS> directs output to package manager, passes <ARGS> to 'pm install-create'\n" +
+            " -session <ID> <NAME> writes output to existing install session ID as NAME\n"
             );
 
         System.exit(exitCode);
@@ -184,6 +201,46 @@ public final class DeployAgent {
         apkMetaData.writeDelimitedTo(System.out);
     }
 
+    private static void extractBlockHashes(String packageName) throws IOException {
+        // Splits are installed next to the base APK.
+        File codeDirectory = getFileFromPackageName(packageName).getParentFile();
+        APKBlockHashList.Builder builder = APKBlockHashList.newBuilder();
+        File[] files = codeDirectory.listFiles();
+        if (files != null) {
+            for (File file : files) {
+                if (file.isFile() && file.getName().endsWith(".apk")) {
+                    builder.addFiles(PatchUtils.getAPKBlockHashes(file));
+                }
+            }
+        }
+        builder.build().writeDelimitedTo(System.out);
+    }
+
+    // Returns the installed file that a patch applies to, consuming the patch's header.
+    // SIGNATURE patches apply to the base APK, BLOCK_SIGNATURE ones name the APK to use.
+    private static RandomAccessFile openPatchSource(String packageName, InputStream patchData)
+            throws IOException, PatchFormatException {
+        File baseFile = getFileFromPackageName(packageName);
+        String signature = readPatchSignature(patchData);
+        if (PatchUtils.SIGNATURE.equals(signature)) {
+            return new RandomAccessFile(baseFile, "r");
+        } else if (!PatchUtils.BLOCK_SIGNATURE.equals(signature)) {
+            throw new PatchFormatException("bad signature");
+        }
+
+        long nameLength = PatchUtils.readFormattedLong(patchData);
+        if (nameLength <= 0 || nameLength > 4096) {
+            throw new PatchFormatException("bad file name length");
+        }
+        byte[] nameBuffer = new byte[(int) nameLength];
+        PatchUtils.readFully(patchData, nameBuffer, 0, nameBuffer.length);
+        String name = new String(nameBuffer, "UTF-8");
+        if (name.contains("/")) {
+            throw new PatchFormatException("bad file name");
+        }
+        return new RandomAccessFile(new File(baseFile.getParentFile(), name), "r");
+    }
+
     private static int createInstallSession(String[] args) throws IOException {
         StringBuilder commandBuilder = new StringBuilder();
         commandBuilder.append("pm install-create ");
@@ -222,7 +279,8 @@ public final class DeployAgent {
             return -1;
         }
 
-        int writeExitCode = writePatchedDataToSession(new RandomAccessFile(deviceFile, "r"), deltaStream, sessionId);
+        int writeExitCode = writePatchedDataToSession(
+                new RandomAccessFile(deviceFile, "r"), deltaStream, sessionId, null);
 
         if (writeExitCode == 0) {
             return commitInstallSession(sessionId);
@@ -231,9 +289,10 @@ public final class DeployAgent {
         }
     }
 
-    private static long writePatchToStream(RandomAccessFile oldData, InputStream patchData,
+    private static long writePatchToStream(String packageName, InputStream patchData,
         OutputStream outputStream) throws IOException, PatchFormatException {
-        long newSize = readPatchHeader(patchData);
+        RandomAccessFile oldData = openPatchSource(packageName, patchData);
+        long newSize = readPatchSize(patchData);
         long bytesWritten = writePatchedDataToStream(oldData, newSize, patchData, outputStream);
         outputStream.flush();
         if (bytesWritten != newSize) {
@@ -243,8 +302,9 @@ public final class DeployAgent {
         return bytesWritten;
     }
 
-    private static long readPatchHeader(InputStream patchData)
+    private static String readPatchSignature(InputStream patchData)
         throws IOException, PatchFormatException {
+        // Both signatures have the same length.
         byte[] signatureBuffer = new byte[PatchUtils.SIGNATURE.length()];
         try {
             PatchUtils.readFully(patchData, signatureBuffer, 0, signatureBuffer.length);
@@ -252,11 +312,19 @@ public final class DeployAgent {
             throw new PatchFormatException("truncated signature");
         }
 
-        String signature = new String(signatureBuffer, 0, signatureBuffer.length, "US-ASCII");
-        if (!PatchUtils.SIGNATURE.equals(signature)) {
+        return new String(signatureBuffer, 0, signatureBuffer.length, "US-ASCII");
+    }
+
+    private static long readPatchHeader(InputStream patchData)
+        throws IOException, PatchFormatException {
+        if (!PatchUtils.SIGNATURE.equals(readPatchSignature(patchData))) {
             throw new PatchFormatException("bad signature");
         }
+        return readPatchSize(patchData);
+    }
 
+    private static long readPatchSize(InputStream patchData)
+        throws IOException, PatchFormatException {
         long newSize = PatchUtils.readBsdiffLong(patchData);
         if (newSize < 0 || newSize > Integer.MAX_VALUE) {
             throw new PatchFormatException("bad newSize");
@@ -292,13 +360,32 @@ public final class DeployAgent {
         return newDataBytesWritten;
     }
 
-    private static int writePatchedDataToSession(RandomAccessFile oldData, InputStream patchData, int sessionId)
+    private static int writePatchedDataToSession(String packageName, InputStream patchData,
+            int sessionId, String splitName) throws IOException, PatchFormatException {
+        RandomAccessFile oldData = openPatchSource(packageName, patchData);
+        return writePatchedDataToSession(oldData, readPatchSize(patchData), patchData, sessionId,
+                splitName);
+    }
+
+    private static int writePatchedDataToSession(RandomAccessFile oldData, InputStream patchData,
+            int sessionId, String splitName) throws IOException, PatchFormatException {
+        long newSize = readPatchHeader(patchData);
+        return writePatchedDataToSession(oldData, newSize, patchData, sessionId, splitName);
+    }
+
+    private static int writePatchedDataToSession(RandomAccessFile oldData, long newSize,
+            InputStream patchData, int sessionId, String splitName)
             throws IOException, PatchFormatException {
         try {
             Process p;
-            long newSize = readPatchHeader(patchData);
             StringBuilder commandBuilder = new StringBuilder();
-            commandBuilder.append(String.format("pm install-write -S %d %d -- -", newSize, sessionId));
+            if (splitName == null) {
+                commandBuilder.append(
+                        String.format("pm install-write -S %d %d -- -", newSize, sessionId));
+            } else {
+                commandBuilder.append(String.format(
+                        "pm install-write -S %d %d %s -", newSize, sessionId, splitName));
+            }
 
             String command = commandBuilder.toString();
             p = Runtime.getRuntime().exec(command);
@@ -21,6 +21,8 @@ import java.io.IOException;
 import java.io.InputStream;
 import java.io.OutputStream;
 import java.io.RandomAccessFile;
+import java.security.MessageDigest;
+import java.security.NoSuchAlgorithmException;
 import java.util.Arrays;
 import java.util.ArrayList;
 import java.util.Collections;
@@ -35,12 +37,20 @@ import com.android.tools.build.apkzlib.zip.CentralDirectoryHeader;
 
 import com.android.fastdeploy.APKMetaData;
 import com.android.fastdeploy.APKEntry;
+import com.android.fastdeploy.APKBlockHashes;
+
+import com.google.protobuf.ByteString;
 
 class PatchUtils {
     private static final long NEGATIVE_MASK = 1L << 63;
     private static final long NEGATIVE_LONG_SIGN_MASK = 1L << 63;
     public static final String SIGNATURE = "HAMADI/IHD";
 
+    // A block patch starts with BLOCK_SIGNATURE and the name of the installed file it applies
+    // to, followed by the same contents as a SIGNATURE patch.
+    public static final String BLOCK_SIGNATURE = "HAMADI/BLK";
+    public static final int BLOCK_SIZE = 4096;
+
     private static long getOffsetFromEntry(StoredEntry entry) {
         return entry.getCentralDirectoryHeader().getOffset() + entry.getLocalHeaderSize();
     }
@@ -88,6 +98,59 @@ class PatchUtils {
         return apkEntriesBuilder.build();
     }
 
+    /**
+     * Computes the rsync-style rolling checksum of {@code length} bytes of {@code data}.
+     */
+    static int weakHash(byte[] data, int offset, int length) {
+        int a = 0;
+        int b = 0;
+        for (int i = 0; i < length; ++i) {
+            int value = data[offset + i] & 0xff;
+            a += value;
+            b += (length - i) * value;
+        }
+        return (a & 0xffff) | (b << 16);
+    }
+
+    /**
+     * Slides a window of {@code length} bytes with checksum {@code hash} forward by one byte,
+     * dropping {@code out} and adding {@code in}.
+     */
+    static int rollWeakHash(int hash, int length, byte out, byte in) {
+        int a = hash & 0xffff;
+        int b = hash >>> 16;
+        a = (a - (out & 0xff) + (in & 0xff)) & 0xffff;
+        b = (b - length * (out & 0xff) + a) & 0xffff;
+        return a | (b << 16);
+    }
+
+    static MessageDigest newStrongHash() {
+        try {
+            return MessageDigest.getInstance("SHA-256");
+        } catch (NoSuchAlgorithmException e) {
+            throw new RuntimeException(e);
+        }
+    }
+
+    public static APKBlockHashes getAPKBlockHashes(File apkFile) throws IOException {
+        APKBlockHashes.Builder builder = APKBlockHashes.newBuilder();
+        builder.setFileName(apkFile.getName());
+        builder.setBlockSize(BLOCK_SIZE);
+
+        MessageDigest digest = newStrongHash();
+        byte[] block = new byte[BLOCK_SIZE];
+        try (RandomAccessFile file = new RandomAccessFile(apkFile, "r")) {
+            // Only full blocks are hashed; a trailing partial block can't be matched anyway.
+            long blockCount = file.length() / BLOCK_SIZE;
+            for (long i = 0; i < blockCount; ++i) {
+                file.readFully(block);
+                builder.addWeakHashes(weakHash(block, 0, BLOCK_SIZE));
+                builder.addStrongHashes(ByteString.copyFrom(digest.digest(block)));
+            }
+        }
+        return builder.build();
+    }
+
     /**
      * Writes a 64-bit signed integer to the specified {@link OutputStream}. The least significant
      * byte is written first and the most significant byte is written last.
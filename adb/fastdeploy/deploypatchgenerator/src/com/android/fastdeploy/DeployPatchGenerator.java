@@ -22,7 +22,11 @@ import java.io.IOException;
 import java.io.InputStream;
 import java.io.OutputStream;
 import java.lang.StringBuilder;
+import java.nio.file.Files;
+import java.security.MessageDigest;
+import java.util.Arrays;
 import java.util.Collections;
+import java.util.HashMap;
 import java.util.Comparator;
 import java.util.List;
 import java.util.ArrayList;
@@ -35,6 +39,8 @@ import java.util.Iterator;
 import java.util.List;
 import java.util.AbstractMap.SimpleEntry;
 
+import com.android.fastdeploy.APKBlockHashList;
+import com.android.fastdeploy.APKBlockHashes;
 import com.android.fastdeploy.APKMetaData;
 import com.android.fastdeploy.APKEntry;
 
@@ -47,6 +53,14 @@ public final class DeployPatchGenerator {
                 showUsage(0);
             }
 
+            if (args[0].equals("--blocks")) {
+                if (args.length != 3) {
+                    showUsage(1);
+                }
+                createBlockPatch(new File(args[1]), args[2], System.out);
+                System.exit(0);
+            }
+
             boolean verbose = false;
             if (args.length > 2) {
                 String verboseFlag = args[2];
@@ -105,6 +119,7 @@ public final class DeployPatchGenerator {
 
     private static void showUsage(int exitCode) {
         System.err.println("usage: deploypatchgenerator <apkpath> <deviceapkmetadata> [--verbose]");
+        System.err.println("       deploypatchgenerator --blocks <apkpath> <deviceblockhashes>");
         System.err.println("");
         System.exit(exitCode);
     }
@@ -205,4 +220,134 @@ public final class DeployPatchGenerator {
         PatchUtils.writeFormattedLong(0, patchStream);
         patchStream.flush();
     }
+
+    // A run of the new file that can be copied from the installed one.
+    private static final class BlockMatch {
+        final long newOffset;
+        final long oldOffset;
+        long length;
+
+        BlockMatch(long newOffset, long oldOffset, long length) {
+            this.newOffset = newOffset;
+            this.oldOffset = oldOffset;
+            this.length = length;
+        }
+    }
+
+    // Scans |data| for blocks of |hashes|, rsync-style: a rolling checksum is slid over every
+    // offset, and candidate blocks are confirmed with their strong hash.
+    private static List<BlockMatch> findBlockMatches(byte[] data, APKBlockHashes hashes) {
+        List<BlockMatch> matches = new ArrayList<BlockMatch>();
+        int blockSize = hashes.getBlockSize();
+        if (blockSize <= 0 || data.length < blockSize || hashes.getWeakHashesCount() == 0) {
+            return matches;
+        }
+
+        HashMap<Integer, List<Integer>> blocksByWeakHash = new HashMap<Integer, List<Integer>>();
+        for (int i = 0; i < hashes.getWeakHashesCount(); ++i) {
+            blocksByWeakHash.computeIfAbsent(hashes.getWeakHashes(i), k -> new ArrayList<Integer>())
+                .add(i);
+        }
+
+        MessageDigest digest = PatchUtils.newStrongHash();
+        int offset = 0;
+        int weakHash = PatchUtils.weakHash(data, 0, blockSize);
+        while (true) {
+            int matchedBlock = -1;
+            List<Integer> candidates = blocksByWeakHash.get(weakHash);
+            if (candidates != null) {
+                digest.update(data, offset, blockSize);
+                byte[] strongHash = digest.digest();
+                for (int block : candidates) {
+                    if (Arrays.equals(strongHash, hashes.getStrongHashes(block).toByteArray())) {
+                        matchedBlock = block;
+                        break;
+                    }
+                }
+            }
+
+            if (matchedBlock != -1) {
+                long oldOffset = (long) matchedBlock * blockSize;
+                BlockMatch last = matches.isEmpty() ? null : matches.get(matches.size() - 1);
+                if (last != null && last.newOffset + last.length == offset &&
+                    last.oldOffset + last.length == oldOffset) {
+                    last.length += blockSize;
+                } else {
+                    matches.add(new BlockMatch(offset, oldOffset, blockSize));
+                }
+
+                offset += blockSize;
+                if (offset + blockSize > data.length) {
+                    break;
+                }
+                weakHash = PatchUtils.weakHash(data, offset, blockSize);
+            } else {
+                if (offset + blockSize >= data.length) {
+                    break;
+                }
+                weakHash = PatchUtils.rollWeakHash(
+                    weakHash, blockSize, data[offset], data[offset + blockSize]);
+                ++offset;
+            }
+        }
+        return matches;
+    }
+
+    private static long matchedBytes(List<BlockMatch> matches) {
+        long total = 0;
+        for (BlockMatch match : matches) {
+            total += match.length;
+        }
+        return total;
+    }
+
+    // Writes a BLOCK_SIGNATURE patch that rebuilds |hostFile| from whichever of the installed
+    // APKs in |deviceBlockHashesPath| it has the most blocks in common with.
+    static void createBlockPatch(File hostFile, String deviceBlockHashesPath,
+        OutputStream patchStream) throws IOException {
+        APKBlockHashList hashList;
+        try (InputStream is = new FileInputStream(new File(deviceBlockHashesPath))) {
+            hashList = APKBlockHashList.parseDelimitedFrom(is);
+        }
+
+        byte[] data = Files.readAllBytes(hostFile.toPath());
+        APKBlockHashes bestFile = null;
+        List<BlockMatch> bestMatches = new ArrayList<BlockMatch>();
+        for (APKBlockHashes hashes : hashList.getFilesList()) {
+            List<BlockMatch> matches = findBlockMatches(data, hashes);
+            if (bestFile == null || matchedBytes(matches) > matchedBytes(bestMatches)) {
+                bestFile = hashes;
+                bestMatches = matches;
+            }
+        }
+        if (bestFile == null) {
+            throw new IOException("no installed APKs to patch against");
+        }
+
+        long equalBytes = matchedBytes(bestMatches);
+        System.err.println(equalBytes + " bytes are equal to " + bestFile.getFileName() +
+            " out of " + data.length + " (" + (float) (equalBytes * 100) / data.length + "%)");
+
+        patchStream.write(PatchUtils.BLOCK_SIGNATURE.getBytes(StandardCharsets.US_ASCII));
+        byte[] name = bestFile.getFileName().getBytes(UTF_8);
+        PatchUtils.writeFormattedLong(name.length, patchStream);
+        patchStream.write(name);
+        PatchUtils.writeFormattedLong(data.length, patchStream);
+
+        long newOffset = 0;
+        for (BlockMatch match : bestMatches) {
+            long newDataLen = match.newOffset - newOffset;
+            PatchUtils.writeFormattedLong(newDataLen, patchStream);
+            patchStream.write(data, (int) newOffset, (int) newDataLen);
+            PatchUtils.writeFormattedLong(match.oldOffset, patchStream);
+            PatchUtils.writeFormattedLong(match.length, patchStream);
+            newOffset = match.newOffset + match.length;
+        }
+        long remainderLen = data.length - newOffset;
+        PatchUtils.writeFormattedLong(remainderLen, patchStream);
+        patchStream.write(data, (int) newOffset, (int) remainderLen);
+        PatchUtils.writeFormattedLong(0, patchStream);
+        PatchUtils.writeFormattedLong(0, patchStream);
+        patchStream.flush();
+    }
 }
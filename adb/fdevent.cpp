@@ -27,17 +27,28 @@
 #include <string.h>
 #include <unistd.h>
 
+#if defined(__linux__)
+// poll(2) costs O(registered fds) per wakeup, and we rebuild its array every time, which is
+// noticeable in an adb server with dozens of devices and many forwards. epoll only costs
+// O(ready fds), so use it wherever it's available.
+#define FDEVENT_USE_EPOLL 1
+#include <sys/epoll.h>
+#endif
+
 #include <atomic>
 #include <deque>
 #include <functional>
 #include <list>
 #include <mutex>
+#include <string>
+#include <thread>
 #include <unordered_map>
 #include <vector>
 
 #include <android-base/chrono_utils.h>
 #include <android-base/file.h>
 #include <android-base/logging.h>
+#include <android-base/macros.h>
 #include <android-base/stringprintf.h>
 #include <android-base/thread_annotations.h>
 #include <android-base/threads.h>
@@ -69,33 +80,135 @@ struct PollNode {
       pollfd.events = POLLRDHUP;
 #endif
   }
+
+#if defined(FDEVENT_USE_EPOLL)
+  // Set for fds that epoll won't accept (regular files, invalid fds), which we poll instead.
+  bool use_poll = false;
+#endif
 };
 
-// All operations to fdevent should happen only in the main thread.
-// That's why we don't need a lock for fdevent.
-static auto& g_poll_node_map = *new std::unordered_map<int, PollNode>();
-static auto& g_pending_list = *new std::list<fdevent*>();
-static std::atomic<bool> terminate_loop(false);
-static bool main_thread_valid;
-static uint64_t main_thread_id;
+struct SpinCheck {
+    fdevent* fde;
+    android::base::boot_clock::time_point timestamp;
+    uint64_t cycle;
+};
 
-static uint64_t fdevent_id;
+// The state of one event loop. All operations on a loop's fdevents happen on the thread running
+// that loop, which is why we don't need a lock for anything but the run queue.
+struct fdevent_context {
+    std::unordered_map<int, PollNode> poll_node_map;
+    std::list<fdevent*> pending_list;
+    std::atomic<bool> terminate_loop{false};
+    bool thread_valid = false;
+    uint64_t thread_id = 0;
+
+#if defined(FDEVENT_USE_EPOLL)
+    unique_fd epoll_fd;
+    size_t poll_fallback_count = 0;
+#endif
 
-static bool run_needs_flush = false;
-static auto& run_queue_notify_fd = *new unique_fd();
-static auto& run_queue_mutex = *new std::mutex();
-static auto& run_queue GUARDED_BY(run_queue_mutex) = *new std::deque<std::function<void()>>();
+    bool run_needs_flush = false;
+    fdevent* run_queue_fde = nullptr;
+    unique_fd run_queue_notify_fd;
+    std::mutex run_queue_mutex;
+    std::deque<std::function<void()>> run_queue GUARDED_BY(run_queue_mutex);
 
-void check_main_thread() {
-    if (main_thread_valid) {
-        CHECK_EQ(main_thread_id, android::base::GetThreadId());
+    std::unordered_map<uint64_t, SpinCheck> continuously_pending;
+    android::base::boot_clock::time_point last_cycle = android::base::boot_clock::now();
+
+    // Only used for loops started by fdevent_start_loop.
+    std::thread thread;
+};
+
+static auto& g_main_context = *new fdevent_context();
+
+// The loop whose thread we're on, or null for the main loop (and threads without a loop).
+static thread_local fdevent_context* t_current_context = nullptr;
+
+static std::atomic<uint64_t> fdevent_id;
+
+static fdevent_context* current_context() {
+    return t_current_context ? t_current_context : &g_main_context;
+}
+
+static void check_context_thread(const fdevent_context* context) {
+    if (context->thread_valid) {
+        CHECK_EQ(context->thread_id, android::base::GetThreadId());
     }
 }
 
+static void set_context_thread(fdevent_context* context) {
+    context->thread_valid = true;
+    context->thread_id = android::base::GetThreadId();
+}
+
+void check_main_thread() {
+    check_context_thread(&g_main_context);
+}
+
+bool fdevent_is_main_thread() {
+    return !g_main_context.thread_valid ||
+           g_main_context.thread_id == android::base::GetThreadId();
+}
+
 void set_main_thread() {
-    main_thread_valid = true;
-    main_thread_id = android::base::GetThreadId();
+    set_context_thread(&g_main_context);
+}
+
+#if defined(FDEVENT_USE_EPOLL)
+static uint32_t epoll_events_from_pollfd(const adb_pollfd& pollfd) {
+    // POLLRDHUP is always requested, see PollNode.
+    uint32_t result = EPOLLRDHUP;
+    if (pollfd.events & POLLIN) {
+        result |= EPOLLIN;
+    }
+    if (pollfd.events & POLLOUT) {
+        result |= EPOLLOUT;
+    }
+    return result;
+}
+
+static void fdevent_epoll_register(fdevent_context* context, PollNode& node) {
+    if (context->epoll_fd == -1) {
+        context->epoll_fd.reset(epoll_create1(EPOLL_CLOEXEC));
+        if (context->epoll_fd == -1) {
+            PLOG(FATAL) << "failed to create epoll fd";
+        }
+    }
+
+    epoll_event ev = {};
+    ev.events = epoll_events_from_pollfd(node.pollfd);
+    ev.data.fd = node.pollfd.fd;
+    if (epoll_ctl(context->epoll_fd.get(), EPOLL_CTL_ADD, node.pollfd.fd, &ev) != 0) {
+        // poll reports these as always readable (or POLLNVAL), and callers rely on that.
+        D("epoll_ctl(ADD) failed for fd %d, falling back to poll: %s", node.pollfd.fd,
+          strerror(errno));
+        node.use_poll = true;
+        ++context->poll_fallback_count;
+    }
+}
+
+static void fdevent_epoll_update(fdevent_context* context, const PollNode& node) {
+    if (node.use_poll) {
+        return;
+    }
+
+    epoll_event ev = {};
+    ev.events = epoll_events_from_pollfd(node.pollfd);
+    ev.data.fd = node.pollfd.fd;
+    if (epoll_ctl(context->epoll_fd.get(), EPOLL_CTL_MOD, node.pollfd.fd, &ev) != 0) {
+        PLOG(FATAL) << "epoll_ctl(MOD) failed for fd " << node.pollfd.fd;
+    }
+}
+
+static void fdevent_epoll_unregister(fdevent_context* context, const PollNode& node) {
+    if (node.use_poll) {
+        --context->poll_fallback_count;
+    } else if (epoll_ctl(context->epoll_fd.get(), EPOLL_CTL_DEL, node.pollfd.fd, nullptr) != 0) {
+        PLOG(ERROR) << "epoll_ctl(DEL) failed for fd " << node.pollfd.fd;
+    }
 }
+#endif
 
 static std::string dump_fde(const fdevent* fde) {
     std::string state;
@@ -128,11 +241,13 @@ void fdevent_install(fdevent* fde, int fd, fd_func func, void* arg) {
 }
 
 fdevent* fdevent_create(int fd, fd_func func, void* arg) {
-    check_main_thread();
+    fdevent_context* context = current_context();
+    check_context_thread(context);
     CHECK_GE(fd, 0);
 
     fdevent* fde = new fdevent();
     fde->id = fdevent_id++;
+    fde->context = context;
     fde->state = FDE_ACTIVE;
     fde->fd.reset(fd);
     fde->func = func;
@@ -143,29 +258,41 @@ fdevent* fdevent_create(int fd, fd_func func, void* arg) {
         // to handle it.
         LOG(ERROR) << "failed to set non-blocking mode for fd " << fd;
     }
-    auto pair = g_poll_node_map.emplace(fde->fd.get(), PollNode(fde));
+    auto pair = context->poll_node_map.emplace(fde->fd.get(), PollNode(fde));
     CHECK(pair.second) << "install existing fd " << fd;
+#if defined(FDEVENT_USE_EPOLL)
+    fdevent_epoll_register(context, pair.first->second);
+#endif
 
     fde->state |= FDE_CREATED;
     return fde;
 }
 
 unique_fd fdevent_release(fdevent* fde) {
-    check_main_thread();
     if (!fde) {
         return {};
     }
 
+    fdevent_context* context = fde->context;
+    check_context_thread(context);
+
     if (!(fde->state & FDE_CREATED)) {
         LOG(FATAL) << "destroying fde not created by fdevent_create(): " << dump_fde(fde);
     }
 
     unique_fd result = std::move(fde->fd);
     if (fde->state & FDE_ACTIVE) {
-        g_poll_node_map.erase(result.get());
+#if defined(FDEVENT_USE_EPOLL)
+        auto it = context->poll_node_map.find(result.get());
+        CHECK(it != context->poll_node_map.end());
+        fdevent_epoll_unregister(context, it->second);
+        context->poll_node_map.erase(it);
+#else
+        context->poll_node_map.erase(result.get());
+#endif
 
         if (fde->state & FDE_PENDING) {
-            g_pending_list.remove(fde);
+            context->pending_list.remove(fde);
         }
         fde->state = 0;
         fde->events = 0;
@@ -181,8 +308,9 @@ void fdevent_destroy(fdevent* fde) {
 }
 
 static void fdevent_update(fdevent* fde, unsigned events) {
-    auto it = g_poll_node_map.find(fde->fd.get());
-    CHECK(it != g_poll_node_map.end());
+    fdevent_context* context = fde->context;
+    auto it = context->poll_node_map.find(fde->fd.get());
+    CHECK(it != context->poll_node_map.end());
     PollNode& node = it->second;
     if (events & FDE_READ) {
         node.pollfd.events |= POLLIN;
@@ -195,11 +323,14 @@ static void fdevent_update(fdevent* fde, unsigned events) {
     } else {
         node.pollfd.events &= ~POLLOUT;
     }
+#if defined(FDEVENT_USE_EPOLL)
+    fdevent_epoll_update(context, node);
+#endif
     fde->state = (fde->state & FDE_STATEMASK) | events;
 }
 
 void fdevent_set(fdevent* fde, unsigned events) {
-    check_main_thread();
+    check_context_thread(fde->context);
     events &= FDE_EVENTMASK;
     if ((fde->state & FDE_EVENTMASK) == events) {
         return;
@@ -212,19 +343,19 @@ void fdevent_set(fdevent* fde, unsigned events) {
         // If we are pending, make sure we don't signal an event that is no longer wanted.
         fde->events &= events;
         if (fde->events == 0) {
-            g_pending_list.remove(fde);
+            fde->context->pending_list.remove(fde);
             fde->state &= ~FDE_PENDING;
         }
     }
 }
 
 void fdevent_add(fdevent* fde, unsigned events) {
-    check_main_thread();
+    check_context_thread(fde->context);
     fdevent_set(fde, (fde->state & FDE_EVENTMASK) | events);
 }
 
 void fdevent_del(fdevent* fde, unsigned events) {
-    check_main_thread();
+    check_context_thread(fde->context);
     fdevent_set(fde, (fde->state & FDE_EVENTMASK) & ~events);
 }
 
@@ -243,19 +374,19 @@ static std::string dump_pollfds(const std::vector<adb_pollfd>& pollfds) {
     return result;
 }
 
-static void fdevent_process() {
-    std::vector<adb_pollfd> pollfds;
-    for (const auto& pair : g_poll_node_map) {
-        pollfds.push_back(pair.second.pollfd);
-    }
-    CHECK_GT(pollfds.size(), 0u);
-    D("poll(), pollfds = %s", dump_pollfds(pollfds).c_str());
+static void fdevent_mark_pending(fdevent_context* context, int fd, unsigned events) {
+    auto it = context->poll_node_map.find(fd);
+    CHECK(it != context->poll_node_map.end());
+    fdevent* fde = it->second.fde;
+    CHECK_EQ(fde->fd.get(), fd);
+    fde->events |= events;
+    D("%s got events %x", dump_fde(fde).c_str(), events);
+    fde->state |= FDE_PENDING;
+    context->pending_list.push_back(fde);
+}
 
-    int ret = adb_poll(&pollfds[0], pollfds.size(), -1);
-    if (ret == -1) {
-        PLOG(ERROR) << "poll(), ret = " << ret;
-        return;
-    }
+static void fdevent_process_pollfds(fdevent_context* context,
+                                    const std::vector<adb_pollfd>& pollfds) {
     for (const auto& pollfd : pollfds) {
         if (pollfd.revents != 0) {
             D("for fd %d, revents = %x", pollfd.fd, pollfd.revents);
@@ -278,17 +409,83 @@ static void fdevent_process() {
         }
 #endif
         if (events != 0) {
-            auto it = g_poll_node_map.find(pollfd.fd);
-            CHECK(it != g_poll_node_map.end());
-            fdevent* fde = it->second.fde;
-            CHECK_EQ(fde->fd.get(), pollfd.fd);
-            fde->events |= events;
-            D("%s got events %x", dump_fde(fde).c_str(), events);
-            fde->state |= FDE_PENDING;
-            g_pending_list.push_back(fde);
+            fdevent_mark_pending(context, pollfd.fd, events);
+        }
+    }
+}
+
+#if defined(FDEVENT_USE_EPOLL)
+static void fdevent_process(fdevent_context* context) {
+    CHECK_GT(context->poll_node_map.size(), 0u);
+
+    // Anything that epoll rejected is ready (or invalid) right away, so check those first
+    // without blocking, and don't block in epoll_wait if any of them fired.
+    std::vector<adb_pollfd> pollfds;
+    if (context->poll_fallback_count > 0) {
+        for (const auto& pair : context->poll_node_map) {
+            if (pair.second.use_poll) {
+                pollfds.push_back(pair.second.pollfd);
+            }
+        }
+        D("poll(), pollfds = %s", dump_pollfds(pollfds).c_str());
+        if (adb_poll(&pollfds[0], pollfds.size(), 0) == -1) {
+            PLOG(ERROR) << "poll() failed";
+            return;
         }
     }
+    bool fallback_ready = false;
+    for (const auto& pollfd : pollfds) {
+        fallback_ready |= pollfd.revents != 0;
+    }
+
+    // epoll is level-triggered, so anything that doesn't fit will be picked up next time.
+    epoll_event epoll_events[256];
+    int ret = epoll_wait(context->epoll_fd.get(), epoll_events, arraysize(epoll_events),
+                         fallback_ready ? 0 : -1);
+    if (ret == -1) {
+        PLOG(ERROR) << "epoll_wait(), ret = " << ret;
+        return;
+    }
+
+    for (int i = 0; i < ret; ++i) {
+        const epoll_event& ev = epoll_events[i];
+        D("for fd %d, epoll events = %x", ev.data.fd, ev.events);
+        unsigned events = 0;
+        if (ev.events & EPOLLIN) {
+            events |= FDE_READ;
+        }
+        if (ev.events & EPOLLOUT) {
+            events |= FDE_WRITE;
+        }
+        if (ev.events & (EPOLLERR | EPOLLHUP | EPOLLRDHUP)) {
+            // We fake a read, as the rest of the code assumes that errors will
+            // be detected at that point.
+            events |= FDE_READ | FDE_ERROR;
+        }
+        if (events != 0) {
+            fdevent_mark_pending(context, ev.data.fd, events);
+        }
+    }
+
+    fdevent_process_pollfds(context, pollfds);
+}
+#else
+static void fdevent_process(fdevent_context* context) {
+    std::vector<adb_pollfd> pollfds;
+    for (const auto& pair : context->poll_node_map) {
+        pollfds.push_back(pair.second.pollfd);
+    }
+    CHECK_GT(pollfds.size(), 0u);
+    D("poll(), pollfds = %s", dump_pollfds(pollfds).c_str());
+
+    int ret = adb_poll(&pollfds[0], pollfds.size(), -1);
+    if (ret == -1) {
+        PLOG(ERROR) << "poll(), ret = " << ret;
+        return;
+    }
+    fdevent_process_pollfds(context, pollfds);
 }
+#endif
 
 static void fdevent_call_fdfunc(fdevent* fde) {
     unsigned events = fde->events;
@@ -299,24 +496,24 @@ static void fdevent_call_fdfunc(fdevent* fde) {
     fde->func(fde->fd.get(), events, fde->arg);
 }
 
-static void fdevent_run_flush() EXCLUDES(run_queue_mutex) {
+static void fdevent_run_flush(fdevent_context* context) EXCLUDES(context->run_queue_mutex) {
     // We need to be careful around reentrancy here, since a function we call can queue up another
     // function.
     while (true) {
         std::function<void()> fn;
         {
-            std::lock_guard<std::mutex> lock(run_queue_mutex);
-            if (run_queue.empty()) {
+            std::lock_guard<std::mutex> lock(context->run_queue_mutex);
+            if (context->run_queue.empty()) {
                 break;
             }
-            fn = run_queue.front();
-            run_queue.pop_front();
+            fn = context->run_queue.front();
+            context->run_queue.pop_front();
         }
         fn();
     }
 }
 
-static void fdevent_run_func(int fd, unsigned ev, void* /* userdata */) {
+static void fdevent_run_func(int fd, unsigned ev, void* userdata) {
     CHECK_GE(fd, 0);
     CHECK(ev & FDE_READ);
 
@@ -328,13 +525,13 @@ static void fdevent_run_func(int fd, unsigned ev, void* /* userdata */) {
     }
 
     // Mark that we need to flush, and then run it at the end of fdevent_loop.
-    run_needs_flush = true;
+    static_cast<fdevent_context*>(userdata)->run_needs_flush = true;
 }
 
-static void fdevent_run_setup() {
+static void fdevent_run_setup(fdevent_context* context) {
     {
-        std::lock_guard<std::mutex> lock(run_queue_mutex);
-        CHECK(run_queue_notify_fd.get() == -1);
+        std::lock_guard<std::mutex> lock(context->run_queue_mutex);
+        CHECK(context->run_queue_notify_fd.get() == -1);
         int s[2];
         if (adb_socketpair(s) != 0) {
             PLOG(FATAL) << "failed to create run queue notify socketpair";
@@ -344,23 +541,23 @@ static void fdevent_run_setup() {
             PLOG(FATAL) << "failed to make run queue notify socket nonblocking";
         }
 
-        run_queue_notify_fd.reset(s[0]);
-        fdevent* fde = fdevent_create(s[1], fdevent_run_func, nullptr);
-        CHECK(fde != nullptr);
-        fdevent_add(fde, FDE_READ);
+        context->run_queue_notify_fd.reset(s[0]);
+        context->run_queue_fde = fdevent_create(s[1], fdevent_run_func, context);
+        CHECK(context->run_queue_fde != nullptr);
+        fdevent_add(context->run_queue_fde, FDE_READ);
     }
 
-    fdevent_run_flush();
+    fdevent_run_flush(context);
 }
 
-void fdevent_run_on_main_thread(std::function<void()> fn) {
-    std::lock_guard<std::mutex> lock(run_queue_mutex);
-    run_queue.push_back(std::move(fn));
+static void fdevent_run_on_context(fdevent_context* context, std::function<void()> fn) {
+    std::lock_guard<std::mutex> lock(context->run_queue_mutex);
+    context->run_queue.push_back(std::move(fn));
 
     // run_queue_notify_fd could still be -1 if we're called before fdevent has finished setting up.
     // In that case, rely on the setup code to flush the queue without a notification being needed.
-    if (run_queue_notify_fd != -1) {
-        int rc = adb_write(run_queue_notify_fd.get(), "", 1);
+    if (context->run_queue_notify_fd != -1) {
+        int rc = adb_write(context->run_queue_notify_fd.get(), "", 1);
 
         // It's possible that we get EAGAIN here, if lots of notifications came in while handling.
         if (rc == 0) {
@@ -371,39 +568,40 @@ void fdevent_run_on_main_thread(std::function<void()> fn) {
     }
 }
 
-static void fdevent_check_spin(uint64_t cycle) {
+void fdevent_run_on_main_thread(std::function<void()> fn) {
+    fdevent_run_on_context(&g_main_context, std::move(fn));
+}
+
+void fdevent_run_on_loop(fdevent_context* loop, std::function<void()> fn) {
+    fdevent_run_on_context(loop, std::move(fn));
+}
+
+static void fdevent_check_spin(fdevent_context* context, uint64_t cycle) {
     // Check to see if we're spinning because we forgot about an fdevent
     // by keeping track of how long fdevents have been continuously pending.
-    struct SpinCheck {
-        fdevent* fde;
-        android::base::boot_clock::time_point timestamp;
-        uint64_t cycle;
-    };
-    static auto& g_continuously_pending = *new std::unordered_map<uint64_t, SpinCheck>();
-    static auto last_cycle = android::base::boot_clock::now();
-
     auto now = android::base::boot_clock::now();
-    if (now - last_cycle > 10ms) {
+    if (now - context->last_cycle > 10ms) {
         // We're not spinning.
-        g_continuously_pending.clear();
-        last_cycle = now;
+        context->continuously_pending.clear();
+        context->last_cycle = now;
         return;
     }
-    last_cycle = now;
+    context->last_cycle = now;
 
-    for (auto* fde : g_pending_list) {
-        auto it = g_continuously_pending.find(fde->id);
-        if (it == g_continuously_pending.end()) {
-            g_continuously_pending[fde->id] =
+    for (auto* fde : context->pending_list) {
+        auto it = context->continuously_pending.find(fde->id);
+        if (it == context->continuously_pending.end()) {
+            context->continuously_pending[fde->id] =
                     SpinCheck{.fde = fde, .timestamp = now, .cycle = cycle};
         } else {
             it->second.cycle = cycle;
         }
     }
 
-    for (auto it = g_continuously_pending.begin(); it != g_continuously_pending.end();) {
+    for (auto it = context->continuously_pending.begin();
+         it != context->continuously_pending.end();) {
         if (it->second.cycle != cycle) {
-            it = g_continuously_pending.erase(it);
+            it = context->continuously_pending.erase(it);
         } else {
             // Use an absurdly long window, since all we really care about is
             // getting a bugreport eventually.
@@ -426,51 +624,85 @@ static void fdevent_check_spin(uint64_t cycle) {
     }
 }
 
-void fdevent_loop() {
-    set_main_thread();
-    fdevent_run_setup();
+static void fdevent_loop_context(fdevent_context* context) {
+    fdevent_run_setup(context);
 
     uint64_t cycle = 0;
     while (true) {
-        if (terminate_loop) {
+        if (context->terminate_loop) {
             return;
         }
 
         D("--- --- waiting for events");
 
-        fdevent_process();
+        fdevent_process(context);
 
-        fdevent_check_spin(cycle++);
+        fdevent_check_spin(context, cycle++);
 
-        while (!g_pending_list.empty()) {
-            fdevent* fde = g_pending_list.front();
-            g_pending_list.pop_front();
+        while (!context->pending_list.empty()) {
+            fdevent* fde = context->pending_list.front();
+            context->pending_list.pop_front();
             fdevent_call_fdfunc(fde);
         }
 
-        if (run_needs_flush) {
-            fdevent_run_flush();
-            run_needs_flush = false;
+        if (context->run_needs_flush) {
+            fdevent_run_flush(context);
+            context->run_needs_flush = false;
         }
     }
 }
 
+void fdevent_loop() {
+    set_main_thread();
+    fdevent_loop_context(&g_main_context);
+}
+
+fdevent_context* fdevent_start_loop(const std::string& thread_name) {
+    fdevent_context* context = new fdevent_context();
+    context->thread = std::thread([context, thread_name]() {
+        adb_thread_setname(thread_name);
+        t_current_context = context;
+        set_context_thread(context);
+        fdevent_loop_context(context);
+
+        // Anything else still registered belongs to whoever created it, but the run queue's
+        // notification fdevent is ours.
+        fdevent_destroy(context->run_queue_fde);
+        context->run_queue_fde = nullptr;
+        t_current_context = nullptr;
+    });
+    return context;
+}
+
+void fdevent_stop_loop(fdevent_context* loop) {
+    CHECK_NE(loop, &g_main_context);
+    CHECK_NE(loop->thread.get_id(), std::this_thread::get_id()) << "can't stop a loop from itself";
+    fdevent_run_on_loop(loop, [loop]() { loop->terminate_loop = true; });
+    loop->thread.join();
+    delete loop;
+}
+
 void fdevent_terminate_loop() {
-    terminate_loop = true;
+    g_main_context.terminate_loop = true;
 }
 
 size_t fdevent_installed_count() {
-    return g_poll_node_map.size();
+    return g_main_context.poll_node_map.size();
 }
 
 void fdevent_reset() {
-    g_poll_node_map.clear();
-    g_pending_list.clear();
+    g_main_context.poll_node_map.clear();
+    g_main_context.pending_list.clear();
+    g_main_context.run_queue_fde = nullptr;
+#if defined(FDEVENT_USE_EPOLL)
+    g_main_context.epoll_fd.reset();
+    g_main_context.poll_fallback_count = 0;
+#endif
 
-    std::lock_guard<std::mutex> lock(run_queue_mutex);
-    run_queue_notify_fd.reset();
-    run_queue.clear();
+    std::lock_guard<std::mutex> lock(g_main_context.run_queue_mutex);
+    g_main_context.run_queue_notify_fd.reset();
+    g_main_context.run_queue.clear();
 
-    main_thread_valid = false;
-    terminate_loop = false;
+    g_main_context.thread_valid = false;
+    g_main_context.terminate_loop = false;
 }
@@ -21,6 +21,7 @@
 #include <stdint.h>  /* for int64_t */
 
 #include <functional>
+#include <string>
 
 #include "adb_unique_fd.h"
 
@@ -31,9 +32,16 @@
 
 typedef void (*fd_func)(int fd, unsigned events, void *userdata);
 
+// An event loop. There's always the main loop run by fdevent_loop, and more can be started with
+// fdevent_start_loop.
+struct fdevent_context;
+
 struct fdevent {
     uint64_t id;
 
+    // The loop that this fdevent belongs to. It must only be touched from that loop's thread.
+    fdevent_context* context = nullptr;
+
     unique_fd fd;
     int force_eof = 0;
 
@@ -47,6 +55,8 @@ struct fdevent {
 /* Allocate and initialize a new fdevent object
  * Note: use FD_TIMER as 'fd' to create a fd-less object
  * (used to implement timers).
+ * The fdevent belongs to the loop running on the calling thread, or to the
+ * main loop if the calling thread isn't running one.
 */
 fdevent *fdevent_create(int fd, fd_func func, void *arg);
 
@@ -70,9 +80,23 @@ void fdevent_loop();
 
 void check_main_thread();
 
+// Returns whether the calling thread is the one running the main loop (or no loop is running yet).
+bool fdevent_is_main_thread();
+
 // Queue an operation to run on the main thread.
 void fdevent_run_on_main_thread(std::function<void()> fn);
 
+// Start an additional event loop on a new thread, so that work can be spread across cores.
+// fdevents created from functions run on it (see fdevent_run_on_loop) belong to it.
+fdevent_context* fdevent_start_loop(const std::string& thread_name);
+
+// Queue an operation to run on the given loop's thread.
+void fdevent_run_on_loop(fdevent_context* loop, std::function<void()> fn);
+
+// Stop a loop started by fdevent_start_loop, and wait for its thread to exit.
+// All fdevents created on it must already have been destroyed.
+void fdevent_stop_loop(fdevent_context* loop);
+
 // The following functions are used only for tests.
 void fdevent_terminate_loop();
 size_t fdevent_installed_count();
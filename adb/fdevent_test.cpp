@@ -18,13 +18,20 @@
 
 #include <gtest/gtest.h>
 
+#include <unistd.h>
+
+#include <condition_variable>
 #include <limits>
+#include <mutex>
 #include <memory>
 #include <queue>
 #include <string>
 #include <thread>
 #include <vector>
 
+#include <android-base/file.h>
+#include <android-base/threads.h>
+
 #include "adb_io.h"
 #include "fdevent_test.h"
 
@@ -169,11 +176,88 @@ static void InvalidFdThreadFunc() {
     fdevent_loop();
 }
 
+struct AdditionalLoopArg {
+    std::mutex mutex;
+    std::condition_variable cv;
+    bool received = false;
+    uint64_t thread_id = 0;
+};
+
+static void AdditionalLoopCallback(int fd, unsigned events, void* userdata) {
+    AdditionalLoopArg* arg = reinterpret_cast<AdditionalLoopArg*>(userdata);
+    ASSERT_TRUE(events & FDE_READ);
+    char c;
+    ASSERT_EQ(1, adb_read(fd, &c, 1));
+
+    std::lock_guard<std::mutex> lock(arg->mutex);
+    arg->received = true;
+    arg->thread_id = android::base::GetThreadId();
+    arg->cv.notify_one();
+}
+
+TEST_F(FdeventTest, additional_loop) {
+    fdevent_context* loop = fdevent_start_loop("fdevent test");
+
+    int fds[2];
+    ASSERT_EQ(0, adb_socketpair(fds));
+    unique_fd writer(fds[0]);
+
+    AdditionalLoopArg arg;
+    fdevent* fde = nullptr;
+    fdevent_run_on_loop(loop, [&fde, &arg, fd = fds[1]]() {
+        fde = fdevent_create(fd, AdditionalLoopCallback, &arg);
+        fdevent_add(fde, FDE_READ);
+    });
+
+    ASSERT_TRUE(WriteFdExactly(writer.get(), "x", 1));
+    {
+        std::unique_lock<std::mutex> lock(arg.mutex);
+        ASSERT_TRUE(arg.cv.wait_for(lock, 10s, [&arg]() { return arg.received; }));
+    }
+
+    // The callback ran on the additional loop's thread, without the main loop running at all.
+    ASSERT_NE(0u, arg.thread_id);
+    ASSERT_NE(android::base::GetThreadId(), arg.thread_id);
+
+    fdevent_run_on_loop(loop, [&fde]() { fdevent_destroy(fde); });
+    fdevent_stop_loop(loop);
+}
+
 TEST_F(FdeventTest, invalid_fd) {
     std::thread thread(InvalidFdThreadFunc);
     thread.join();
 }
 
+#if !defined(_WIN32)
+struct RegularFileArg {
+    fdevent* fde;
+    unsigned events;
+};
+
+static void RegularFileEventCallback(int, unsigned events, void* userdata) {
+    RegularFileArg* arg = reinterpret_cast<RegularFileArg*>(userdata);
+    arg->events = events;
+    fdevent_destroy(arg->fde);
+    fdevent_terminate_loop();
+}
+
+// epoll refuses regular files, but they need to keep being reported as readable like poll does.
+TEST_F(FdeventTest, regular_file) {
+    TemporaryFile tf;
+    ASSERT_NE(-1, tf.fd);
+
+    RegularFileArg arg = {};
+    std::thread thread([&tf, &arg]() {
+        arg.fde = fdevent_create(dup(tf.fd), RegularFileEventCallback, &arg);
+        fdevent_add(arg.fde, FDE_READ);
+        fdevent_loop();
+    });
+    thread.join();
+
+    ASSERT_EQ(static_cast<unsigned>(FDE_READ), arg.events & FDE_READ);
+}
+#endif
+
 TEST_F(FdeventTest, run_on_main_thread) {
     std::vector<int> vec;
 
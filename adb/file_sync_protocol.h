@@ -22,14 +22,25 @@
 #define ID_STAT_V2 MKID('S', 'T', 'A', '2')
 #define ID_LSTAT_V2 MKID('L', 'S', 'T', '2')
 #define ID_LIST MKID('L', 'I', 'S', 'T')
+#define ID_LIST_RECURSIVE MKID('L', 'I', 'S', 'R')
 #define ID_SEND MKID('S', 'E', 'N', 'D')
 #define ID_RECV MKID('R', 'E', 'C', 'V')
 #define ID_DENT MKID('D', 'E', 'N', 'T')
+#define ID_DENT_V2 MKID('D', 'N', 'T', '2')
 #define ID_DONE MKID('D', 'O', 'N', 'E')
 #define ID_DATA MKID('D', 'A', 'T', 'A')
 #define ID_OKAY MKID('O', 'K', 'A', 'Y')
 #define ID_FAIL MKID('F', 'A', 'I', 'L')
 #define ID_QUIT MKID('Q', 'U', 'I', 'T')
+#define ID_DMAX MKID('D', 'M', 'A', 'X')
+#define ID_SEND_V2 MKID('S', 'N', 'D', '2')
+#define ID_RECV_V2 MKID('R', 'C', 'V', '2')
+
+enum SyncFlag : uint32_t {
+    kSyncFlagNone = 0,
+    // DATA payloads are a single brotli stream rather than raw file contents.
+    kSyncFlagBrotli = 1,
+};
 
 struct SyncRequest {
     uint32_t id;           // ID_STAT, et cetera.
@@ -65,6 +76,21 @@ union syncmsg {
         uint32_t time;
         uint32_t namelen;
     } dent;
+    struct __attribute__((packed)) {
+        uint32_t id;
+        uint32_t error;
+        uint64_t dev;
+        uint64_t ino;
+        uint32_t mode;
+        uint32_t nlink;
+        uint32_t uid;
+        uint32_t gid;
+        uint64_t size;
+        int64_t atime;
+        int64_t mtime;
+        int64_t ctime;
+        uint32_t namelen;
+    } dent_v2;
     struct __attribute__((packed)) {
         uint32_t id;
         uint32_t size;
@@ -73,6 +99,14 @@ union syncmsg {
         uint32_t id;
         uint32_t msglen;
     } status;
+    // Follows the path of an ID_SEND_V2 or ID_RECV_V2 request.
+    struct __attribute__((packed)) {
+        uint32_t id;
+        uint32_t flags;
+    } v2_setup;
 };
 
 #define SYNC_DATA_MAX (64 * 1024)
+
+// The largest chunk size that can be negotiated with ID_DMAX (requires kFeatureSyncV2).
+#define SYNC_DATA_MAX_V2 (1024 * 1024)
@@ -90,6 +90,12 @@ class ShellProtocol {
     // Returns false if the FD closed or errored.
     bool Write(Id id, size_t length);
 
+    // Writes only the header of a packet with |length| bytes of data, for callers that send
+    // the data to the FD themselves (e.g. with splice()).
+    //
+    // Returns false if the FD closed or errored.
+    bool WriteHeader(Id id, size_t length);
+
   private:
     // Packets support 4-byte lengths.
     typedef uint32_t length_t;
@@ -60,3 +60,12 @@ bool ShellProtocol::Write(Id id, size_t length) {
 
     return WriteFdExactly(fd_, buffer_, kHeaderSize + length);
 }
+
+bool ShellProtocol::WriteHeader(Id id, size_t length) {
+    char header[kHeaderSize];
+    header[0] = id;
+    length_t typed_length = length;
+    memcpy(&header[1], &typed_length, sizeof(typed_length));
+
+    return WriteFdExactly(fd_, header, kHeaderSize);
+}
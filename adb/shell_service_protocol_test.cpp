@@ -21,6 +21,7 @@
 #include <signal.h>
 #include <string.h>
 
+#include "adb_io.h"
 #include "sysdeps.h"
 
 class ShellProtocolTest : public ::testing::Test {
@@ -109,6 +110,18 @@ TEST_F(ShellProtocolTest, FullPacket) {
     ASSERT_TRUE(PacketEquals(read_protocol_, id, data, sizeof(data)));
 }
 
+// Tests a packet whose data is written separately from its header.
+TEST_F(ShellProtocolTest, SeparateHeader) {
+    ShellProtocol::Id id = ShellProtocol::kIdStdout;
+    char data[] = "header first";
+
+    ASSERT_TRUE(write_protocol_->WriteHeader(id, sizeof(data)));
+    ASSERT_TRUE(WriteFdExactly(write_fd_, data, sizeof(data)));
+
+    ASSERT_TRUE(read_protocol_->Read());
+    ASSERT_TRUE(PacketEquals(read_protocol_, id, data, sizeof(data)));
+}
+
 // Tests data that has to be read multiple times due to smaller read buffer.
 TEST_F(ShellProtocolTest, ReadBufferOverflow) {
     ShellProtocol::Id id = ShellProtocol::kIdStdin;
@@ -18,7 +18,9 @@
 #define __ADB_SOCKET_H
 
 #include <stddef.h>
+#include <stdint.h>
 
+#include <chrono>
 #include <deque>
 #include <memory>
 #include <string>
@@ -95,6 +97,18 @@ struct asocket {
     /* A socket is bound to atransport */
     atransport* transport = nullptr;
 
+    // For local asockets, the size of the next read from fd. It grows while reads keep filling
+    // the buffer and shrinks after short reads, so bulk forwards move max-payload packets while
+    // chatty sockets don't pin max-payload buffers.
+    size_t read_size = 0;
+
+    // Traffic and backpressure accounting for local asockets, logged when they're destroyed.
+    uint64_t bytes_read = 0;
+    uint64_t bytes_written = 0;
+    uint64_t stalls = 0;
+    std::chrono::steady_clock::duration stalled_time = {};
+    std::chrono::steady_clock::time_point stall_start = {};
+
     size_t get_max_payload() const;
 };
 
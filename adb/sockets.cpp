@@ -20,12 +20,14 @@
 
 #include <ctype.h>
 #include <errno.h>
+#include <inttypes.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
 
 #include <algorithm>
+#include <chrono>
 #include <mutex>
 #include <string>
 #include <vector>
@@ -117,6 +119,9 @@ static SocketFlushResult local_socket_flush_incoming(asocket* s) {
     if (!s->packet_queue.empty()) {
         std::vector<adb_iovec> iov = s->packet_queue.iovecs();
         ssize_t rc = adb_writev(s->fd, iov.data(), iov.size());
+        if (rc > 0) {
+            s->bytes_written += rc;
+        }
         if (rc > 0 && static_cast<size_t>(rc) == s->packet_queue.size()) {
             s->packet_queue.clear();
         } else if (rc > 0) {
@@ -144,13 +149,33 @@ static SocketFlushResult local_socket_flush_incoming(asocket* s) {
     return SocketFlushResult::Completed;
 }
 
+// The smallest and initial sizes of a local socket's reads; see asocket::read_size.
+static constexpr size_t kMinLocalSocketReadSize = 4 * 1024;
+static constexpr size_t kInitialLocalSocketReadSize = 64 * 1024;
+
+// Returns the size of a local socket's next read, given that the last read of |read_size|
+// bytes returned |bytes|.
+static size_t next_read_size(size_t read_size, size_t bytes, size_t max_payload) {
+    if (bytes == read_size) {
+        // There's probably more where that came from.
+        return std::min(read_size * 2, max_payload);
+    } else if (bytes != 0 && bytes < read_size / 4) {
+        return std::max(read_size / 2, std::min(kMinLocalSocketReadSize, max_payload));
+    }
+    return read_size;
+}
+
 // Returns false if the socket has been closed and destroyed as a side-effect of this function.
 static bool local_socket_flush_outgoing(asocket* s) {
     const size_t max_payload = s->get_max_payload();
+    if (s->read_size == 0) {
+        s->read_size = kInitialLocalSocketReadSize;
+    }
+    const size_t read_size = std::min(s->read_size, max_payload);
     apacket::payload_type data;
-    data.resize(max_payload);
+    data.resize(read_size);
     char* x = &data[0];
-    size_t avail = max_payload;
+    size_t avail = read_size;
     int r = 0;
     int is_eof = 0;
 
@@ -175,8 +200,11 @@ static bool local_socket_flush_outgoing(asocket* s) {
     D("LS(%d): fd=%d post avail loop. r=%d is_eof=%d forced_eof=%d", s->id, s->fd, r, is_eof,
       s->fde->force_eof);
 
-    if (avail != max_payload && s->peer) {
-        data.resize(max_payload - avail);
+    s->read_size = next_read_size(read_size, read_size - avail, max_payload);
+
+    if (avail != read_size && s->peer) {
+        data.resize(read_size - avail);
+        s->bytes_read += data.size();
 
         // s->peer->enqueue() may call s->close() and free s,
         // so save variables for debug printing below.
@@ -201,6 +229,8 @@ static bool local_socket_flush_outgoing(asocket* s) {
             ** be enabled again when we get a call to ready()
             */
             fdevent_del(s->fde, FDE_READ);
+            ++s->stalls;
+            s->stall_start = std::chrono::steady_clock::now();
         }
     }
 
@@ -233,6 +263,11 @@ static int local_socket_enqueue(asocket* s, apacket::payload_type data) {
 }
 
 static void local_socket_ready(asocket* s) {
+    if (s->stall_start != std::chrono::steady_clock::time_point()) {
+        s->stalled_time += std::chrono::steady_clock::now() - s->stall_start;
+        s->stall_start = {};
+    }
+
     /* far side is ready for data, pay attention to
        readable events */
     fdevent_add(s->fde, FDE_READ);
@@ -243,6 +278,11 @@ static void local_socket_destroy(asocket* s) {
     int exit_on_close = s->exit_on_close;
 
     D("LS(%d): destroying fde.fd=%d", s->id, s->fd);
+    D("LS(%d): read %" PRIu64 " bytes, wrote %" PRIu64 " bytes, stalled %" PRIu64
+      " times for %" PRId64 "ms waiting for the peer",
+      s->id, s->bytes_read, s->bytes_written, s->stalls,
+      static_cast<int64_t>(
+              std::chrono::duration_cast<std::chrono::milliseconds>(s->stalled_time).count()));
 
     /* IMPORTANT: the remove closes the fd
     ** that belongs to this socket
@@ -69,6 +69,11 @@ const char* const kFeaturePushSync = "push_sync";
 const char* const kFeatureApex = "apex";
 const char* const kFeatureFixedPushMkdir = "fixed_push_mkdir";
 const char* const kFeatureAbb = "abb";
+const char* const kFeatureAbbSession = "abb_session";
+const char* const kFeatureSyncV2 = "sync_v2";
+const char* const kFeatureSyncBrotli = "sync_brotli";
+const char* const kFeatureListRecursive = "list_recursive";
+const char* const kFeatureTrackJdwpDelta = "track_jdwp_delta";
 
 namespace {
 
@@ -264,6 +269,50 @@ TransportId NextTransportId() {
     return next++;
 }
 
+void ConnectionStats::RecordRead(const apacket* packet) {
+    ++packets_in;
+    bytes_in += sizeof(packet->msg) + packet->payload.size();
+}
+
+void ConnectionStats::RecordWrite(const apacket* packet) {
+    ++packets_out;
+    bytes_out += sizeof(packet->msg) + packet->msg.data_length;
+}
+
+void ConnectionStats::RecordQueueDepth(size_t depth) {
+    write_queue_depth = depth;
+    size_t max = max_write_queue_depth;
+    while (depth > max && !max_write_queue_depth.compare_exchange_weak(max, depth)) {
+    }
+}
+
+void ConnectionStats::RecordWriteLatency(std::chrono::steady_clock::duration latency) {
+    auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(latency).count();
+    size_t bucket = 0;
+    while (bucket < kWriteLatencyBuckets - 1 && ms >= (1LL << bucket)) {
+        ++bucket;
+    }
+    ++write_latency[bucket];
+}
+
+std::string ConnectionStats::ToString() const {
+    std::string result = android::base::StringPrintf(
+            "bytes_in=%" PRIu64 " packets_in=%" PRIu64 " bytes_out=%" PRIu64
+            " packets_out=%" PRIu64 " write_queue=%zu max_write_queue=%zu write_latency_ms=",
+            bytes_in.load(), packets_in.load(), bytes_out.load(), packets_out.load(),
+            write_queue_depth.load(), max_write_queue_depth.load());
+    for (size_t i = 0; i < kWriteLatencyBuckets; ++i) {
+        if (i != 0) result += ',';
+        if (i == kWriteLatencyBuckets - 1) {
+            android::base::StringAppendF(&result, ">=%d:", 1 << (i - 1));
+        } else {
+            android::base::StringAppendF(&result, "<%d:", 1 << i);
+        }
+        result += std::to_string(write_latency[i].load());
+    }
+    return result;
+}
+
 BlockingConnectionAdapter::BlockingConnectionAdapter(std::unique_ptr<BlockingConnection> connection)
     : underlying_(std::move(connection)) {}
 
@@ -305,13 +354,16 @@ void BlockingConnectionAdapter::Start() {
                 return;
             }
 
-            std::unique_ptr<apacket> packet = std::move(this->write_queue_.front());
+            std::unique_ptr<apacket> packet = std::move(this->write_queue_.front().first);
+            auto queued_time = this->write_queue_.front().second;
             this->write_queue_.pop_front();
+            stats_.RecordQueueDepth(this->write_queue_.size());
             lock.unlock();
 
             if (!this->underlying_->Write(packet.get())) {
                 break;
             }
+            stats_.RecordWriteLatency(std::chrono::steady_clock::now() - queued_time);
         }
         std::call_once(this->error_flag_, [this]() { this->error_callback_(this, "write failed"); });
     });
@@ -361,7 +413,8 @@ void BlockingConnectionAdapter::Stop() {
 bool BlockingConnectionAdapter::Write(std::unique_ptr<apacket> packet) {
     {
         std::lock_guard<std::mutex> lock(this->mutex_);
-        write_queue_.emplace_back(std::move(packet));
+        write_queue_.emplace_back(std::move(packet), std::chrono::steady_clock::now());
+        stats_.RecordQueueDepth(write_queue_.size());
     }
 
     cv_.notify_one();
@@ -390,18 +443,18 @@ bool FdConnection::Read(apacket* packet) {
 }
 
 bool FdConnection::Write(apacket* packet) {
-    if (!WriteFdExactly(fd_.get(), &packet->msg, sizeof(packet->msg))) {
+    // Send the header and the payload with a single writev, rather than a write apiece.
+    adb_iovec iov[2];
+    iov[0].iov_base = &packet->msg;
+    iov[0].iov_len = sizeof(packet->msg);
+    iov[1].iov_base = packet->payload.data();
+    iov[1].iov_len = packet->msg.data_length;
+
+    if (!WritevFdExactly(fd_.get(), iov, packet->msg.data_length ? 2 : 1)) {
         D("remote local: write terminated");
         return false;
     }
 
-    if (packet->msg.data_length) {
-        if (!WriteFdExactly(fd_.get(), &packet->payload[0], packet->msg.data_length)) {
-            D("remote local: write terminated");
-            return false;
-        }
-    }
-
     return true;
 }
 
@@ -659,12 +712,14 @@ static void transport_registration_func(int _fd, unsigned ev, void*) {
         // upon a read/write error.
         t->ref_count++;
         t->connection()->SetTransportName(t->serial_name());
-        t->connection()->SetReadCallback([t](Connection*, std::unique_ptr<apacket> p) {
+        t->connection()->SetReadCallback([t](Connection* connection, std::unique_ptr<apacket> p) {
             if (!check_header(p.get(), t)) {
                 D("%s: remote read: bad header", t->serial.c_str());
                 return false;
             }
 
+            connection->stats_.RecordRead(p.get());
+
             VLOG(TRANSPORT) << dump_packet(t->serial.c_str(), "from remote", p.get());
             apacket* packet = p.release();
 
@@ -672,8 +727,10 @@ static void transport_registration_func(int _fd, unsigned ev, void*) {
             fdevent_run_on_main_thread([packet, t]() { handle_packet(packet, t); });
             return true;
         });
-        t->connection()->SetErrorCallback([t](Connection*, const std::string& error) {
+        t->connection()->SetErrorCallback([t](Connection* connection, const std::string& error) {
             LOG(INFO) << t->serial_name() << ": connection terminated: " << error;
+            VLOG(TRANSPORT) << t->serial_name() << ": " << connection->stats_.ToString();
+            VLOG(TRANSPORT) << "block pool: " << BlockPool::Instance().GetStats().ToString();
             fdevent_run_on_main_thread([t]() {
                 handle_offline(t);
                 transport_unref(t);
@@ -946,7 +1003,9 @@ atransport::~atransport() {
 }
 
 int atransport::Write(apacket* p) {
-    return this->connection()->Write(std::unique_ptr<apacket>(p)) ? 0 : -1;
+    std::shared_ptr<Connection> connection = this->connection();
+    connection->stats_.RecordWrite(p);
+    return connection->Write(std::unique_ptr<apacket>(p)) ? 0 : -1;
 }
 
 void atransport::Kick() {
@@ -1016,6 +1075,8 @@ const FeatureSet& supported_features() {
     static const FeatureSet* features = new FeatureSet{
             kFeatureShell2,         kFeatureCmd,  kFeatureStat2,
             kFeatureFixedPushMkdir, kFeatureApex, kFeatureAbb,
+            kFeatureSyncV2,         kFeatureSyncBrotli, kFeatureListRecursive,
+            kFeatureTrackJdwpDelta, kFeatureAbbSession,
             // Increment ADB_SERVER_VERSION when adding a feature that adbd needs
             // to know about. Otherwise, the client can be stuck running an old
             // version of the server even after upgrading their copy of adb.
@@ -1174,6 +1235,29 @@ std::string list_transports(bool long_listing) {
     return result;
 }
 
+static void append_transport_stats(atransport* t, std::string* result) {
+    std::shared_ptr<Connection> connection = t->connection();
+    if (!connection) {
+        return;
+    }
+    android::base::StringAppendF(result, "%s\t%s\n", t->serial_name().c_str(),
+                                 connection->stats_.ToString().c_str());
+}
+
+std::string list_transport_stats(atransport* t) {
+    std::string result;
+    if (t) {
+        append_transport_stats(t, &result);
+        return result;
+    }
+
+    std::lock_guard<std::recursive_mutex> lock(transport_lock);
+    for (const auto& transport : transport_list) {
+        append_transport_stats(transport, &result);
+    }
+    return result;
+}
+
 void close_usb_devices(std::function<bool(const atransport*)> predicate) {
     std::lock_guard<std::recursive_mutex> lock(transport_lock);
     for (auto& t : transport_list) {
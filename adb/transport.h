@@ -19,6 +19,7 @@
 
 #include <sys/types.h>
 
+#include <array>
 #include <atomic>
 #include <chrono>
 #include <condition_variable>
@@ -30,6 +31,7 @@
 #include <string>
 #include <string_view>
 #include <thread>
+#include <unordered_map>
 #include <unordered_set>
 
 #include <android-base/macros.h>
@@ -67,9 +69,45 @@ extern const char* const kFeatureApex;
 extern const char* const kFeatureFixedPushMkdir;
 // adbd supports android binder bridge (abb).
 extern const char* const kFeatureAbb;
+// adbd supports abb_session:, running many abb commands over one connection.
+extern const char* const kFeatureAbbSession;
+// adbd supports negotiating a larger sync data chunk size with ID_DMAX.
+extern const char* const kFeatureSyncV2;
+// adbd supports brotli-compressed ID_SEND_V2/ID_RECV_V2 sync transfers.
+extern const char* const kFeatureSyncBrotli;
+// adbd supports ID_LIST_RECURSIVE, listing a whole tree with stat_v2 information.
+extern const char* const kFeatureListRecursive;
+// adbd supports track-jdwp-delta, reporting JDWP process additions and removals.
+extern const char* const kFeatureTrackJdwpDelta;
 
 TransportId NextTransportId();
 
+// Traffic counters for a Connection. These are updated from the connection's own threads as
+// well as the main thread, so everything is atomic.
+struct ConnectionStats {
+    // Buckets of the write latency histogram: bucket i counts writes that took less than 2^i ms,
+    // and the last bucket counts everything slower than that.
+    static constexpr size_t kWriteLatencyBuckets = 12;
+
+    std::atomic<uint64_t> bytes_in = 0;
+    std::atomic<uint64_t> packets_in = 0;
+    std::atomic<uint64_t> bytes_out = 0;
+    std::atomic<uint64_t> packets_out = 0;
+
+    std::atomic<size_t> write_queue_depth = 0;
+    std::atomic<size_t> max_write_queue_depth = 0;
+
+    // Time from a packet being queued with Connection::Write to it having been written.
+    std::array<std::atomic<uint64_t>, kWriteLatencyBuckets> write_latency = {};
+
+    void RecordRead(const apacket* packet);
+    void RecordWrite(const apacket* packet);
+    void RecordQueueDepth(size_t depth);
+    void RecordWriteLatency(std::chrono::steady_clock::duration latency);
+
+    std::string ToString() const;
+};
+
 // Abstraction for a non-blocking packet transport.
 struct Connection {
     Connection() = default;
@@ -100,10 +138,58 @@ struct Connection {
     std::string transport_name_;
     ReadCallback read_callback_;
     ErrorCallback error_callback_;
+    ConnectionStats stats_;
 
     static std::unique_ptr<Connection> FromFd(unique_fd fd);
 };
 
+// A Connection over a nonblocking socket that is serviced by the main fdevent loop, so that it
+// costs no threads of its own. Used for TCP and vsock transports, where a host may be talking to
+// hundreds of emulators at once.
+struct FdeventConnection : public Connection {
+    explicit FdeventConnection(unique_fd fd);
+    virtual ~FdeventConnection();
+
+    virtual bool Write(std::unique_ptr<apacket> packet) override final;
+
+    virtual void Start() override final;
+    virtual void Stop() override final;
+
+  protected:
+    // Called on the main thread when the connection shuts down, before the socket is closed.
+    virtual void Close() {}
+
+  private:
+    enum class WriteResult {
+        Error,
+        Completed,
+        TryAgain,
+    };
+
+    static void OnEvent(int fd, unsigned events, void* arg);
+    bool HandleRead(std::string* error);
+    WriteResult DispatchWrites() REQUIRES(write_mutex_);
+    void Teardown(const std::string& error);
+
+    unique_fd fd_;
+
+    // Only touched on the main thread.
+    fdevent* fde_ = nullptr;
+    bool started_ = false;
+    std::unique_ptr<amessage> read_header_;
+    IOVector read_buffer_;
+
+    // Closures posted to the main thread hold a weak reference, which dies with the fdevent.
+    std::shared_ptr<bool> alive_;
+
+    std::mutex write_mutex_;
+    bool stopped_ GUARDED_BY(write_mutex_) = false;
+    bool write_pending_ GUARDED_BY(write_mutex_) = false;
+    IOVector write_buffer_ GUARDED_BY(write_mutex_);
+
+    std::once_flag error_flag_;
+};
+
 // Abstraction for a blocking packet transport.
 struct BlockingConnection {
     BlockingConnection() = default;
@@ -141,7 +227,9 @@ struct BlockingConnectionAdapter : public Connection {
     std::thread read_thread_ GUARDED_BY(mutex_);
     std::thread write_thread_ GUARDED_BY(mutex_);
 
-    std::deque<std::unique_ptr<apacket>> write_queue_ GUARDED_BY(mutex_);
+    // Queued packets, along with the time they were queued.
+    std::deque<std::pair<std::unique_ptr<apacket>, std::chrono::steady_clock::time_point>>
+            write_queue_ GUARDED_BY(mutex_);
     std::mutex mutex_;
     std::condition_variable cv_;
 
@@ -261,6 +349,10 @@ class atransport {
     std::string device;
     std::string devpath;
 
+    // The ro.* properties from the connection banner, so that clients can read them without a
+    // round trip to the device.
+    std::unordered_map<std::string, std::string> properties;
+
     bool IsTcpDevice() const { return type == kTransportLocal; }
 
 #if ADB_HOST
@@ -373,6 +465,10 @@ void init_reconnect_handler(void);
 void init_transport_registration(void);
 void init_mdns_transport_discovery(void);
 std::string list_transports(bool long_listing);
+
+// Returns a ConnectionStats::ToString line for |t|, or for every transport if |t| is null.
+std::string list_transport_stats(atransport* t);
+
 atransport* find_transport(const char* serial);
 void kick_all_tcp_devices();
 void kick_all_transports();
@@ -101,6 +101,63 @@ void BM_Connection_Unidirectional(benchmark::State& state) {
 
 ADB_CONNECTION_BENCHMARK(BM_Connection_Unidirectional);
 
+// Like BM_Connection_Unidirectional, but keeps the write path busy with a burst of packets
+// instead of waiting for each one to arrive before sending the next.
+template <typename ConnectionType>
+void BM_Connection_Burst(benchmark::State& state) {
+    static constexpr size_t kBurstSize = 64;
+
+    int fds[2];
+    if (adb_socketpair(fds) != 0) {
+        LOG(FATAL) << "failed to create socketpair";
+    }
+
+    auto client = MakeConnection<ConnectionType>(unique_fd(fds[0]));
+    auto server = MakeConnection<ConnectionType>(unique_fd(fds[1]));
+
+    std::atomic<size_t> received_packets;
+
+    client->SetReadCallback([](Connection*, std::unique_ptr<apacket>) -> bool { return true; });
+    server->SetReadCallback([&received_packets](Connection*, std::unique_ptr<apacket>) -> bool {
+        ++received_packets;
+        return true;
+    });
+
+    client->SetErrorCallback(
+        [](Connection*, const std::string& error) { LOG(INFO) << "client closed: " << error; });
+    server->SetErrorCallback(
+        [](Connection*, const std::string& error) { LOG(INFO) << "server closed: " << error; });
+
+    client->Start();
+    server->Start();
+
+    for (auto _ : state) {
+        size_t data_size = state.range(0);
+        received_packets = 0;
+        for (size_t i = 0; i < kBurstSize; ++i) {
+            std::unique_ptr<apacket> packet = std::make_unique<apacket>();
+            memset(&packet->msg, 0, sizeof(packet->msg));
+            packet->msg.command = A_WRTE;
+            packet->msg.data_length = data_size;
+            packet->payload.resize(data_size);
+
+            memset(&packet->payload[0], 0xff, data_size);
+            client->Write(std::move(packet));
+        }
+
+        while (received_packets < kBurstSize) {
+            continue;
+        }
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * kBurstSize *
+                            state.range(0));
+
+    client->Stop();
+    server->Stop();
+}
+
+ADB_CONNECTION_BENCHMARK(BM_Connection_Burst);
+
 enum class ThreadPolicy {
     MainThread,
     SameThread,
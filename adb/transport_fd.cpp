@@ -17,6 +17,7 @@
 #include <stdint.h>
 
 #include <deque>
+#include <future>
 #include <memory>
 #include <mutex>
 #include <string>
@@ -235,3 +236,217 @@ struct NonblockingFdConnection : public Connection {
 std::unique_ptr<Connection> Connection::FromFd(unique_fd fd) {
     return std::make_unique<NonblockingFdConnection>(std::move(fd));
 }
+
+// Socket buffer size for FdeventConnection. The default is sized for a crowd of short-lived
+// connections; a transport carries everything a device does, often over a lossless local link.
+static constexpr int kFdeventConnectionSocketBufferSize = 1 * 1024 * 1024;
+
+FdeventConnection::FdeventConnection(unique_fd fd)
+    : fd_(std::move(fd)), alive_(std::make_shared<bool>(true)) {
+    set_file_block_mode(fd_.get(), false);
+    int buf_size = kFdeventConnectionSocketBufferSize;
+    adb_setsockopt(fd_.get(), SOL_SOCKET, SO_SNDBUF, &buf_size, sizeof(buf_size));
+    adb_setsockopt(fd_.get(), SOL_SOCKET, SO_RCVBUF, &buf_size, sizeof(buf_size));
+}
+
+FdeventConnection::~FdeventConnection() {
+    Stop();
+}
+
+void FdeventConnection::Start() {
+    check_main_thread();
+    if (started_) {
+        LOG(FATAL) << "FdeventConnection(" << transport_name_ << "): started multiple times";
+    }
+    started_ = true;
+
+    std::lock_guard<std::mutex> lock(write_mutex_);
+    if (stopped_) {
+        return;
+    }
+
+    // The fdevent borrows our fd: we still write to it directly from other threads.
+    fde_ = fdevent_create(fd_.get(), OnEvent, this);
+    fdevent_add(fde_, write_pending_ ? FDE_READ | FDE_WRITE : FDE_READ);
+}
+
+void FdeventConnection::Stop() {
+    {
+        std::lock_guard<std::mutex> lock(write_mutex_);
+        if (stopped_) {
+            return;
+        }
+    }
+
+    if (fdevent_is_main_thread()) {
+        Teardown("requested stop");
+        return;
+    }
+
+    std::promise<void> done;
+    fdevent_run_on_main_thread([this, &done]() {
+        Teardown("requested stop");
+        done.set_value();
+    });
+    done.get_future().wait();
+}
+
+void FdeventConnection::Teardown(const std::string& error) {
+    {
+        std::lock_guard<std::mutex> lock(write_mutex_);
+        if (stopped_) {
+            return;
+        }
+        stopped_ = true;
+        alive_.reset();
+        write_buffer_.clear();
+
+        if (fde_) {
+            // Take the fd back from the fdevent without closing it underneath ourselves.
+            int borrowed_fd = fdevent_release(fde_).release();
+            CHECK_EQ(fd_.get(), borrowed_fd);
+            fde_ = nullptr;
+        }
+
+        Close();
+        fd_.reset();
+    }
+
+    if (started_) {
+        LOG(INFO) << "FdeventConnection(" << transport_name_ << "): stopped";
+        std::call_once(error_flag_, [this, &error]() { error_callback_(this, error); });
+    }
+}
+
+void FdeventConnection::OnEvent(int, unsigned events, void* arg) {
+    auto connection = static_cast<FdeventConnection*>(arg);
+    std::string error;
+
+    if (events & FDE_WRITE) {
+        std::lock_guard<std::mutex> lock(connection->write_mutex_);
+        WriteResult result = connection->DispatchWrites();
+        if (result == WriteResult::Error) {
+            error = std::string("write failed: ") + strerror(errno);
+        } else if (result == WriteResult::Completed) {
+            connection->write_pending_ = false;
+            fdevent_del(connection->fde_, FDE_WRITE);
+        }
+    }
+
+    if (error.empty() && (events & (FDE_READ | FDE_ERROR))) {
+        connection->HandleRead(&error);
+    }
+
+    if (!error.empty()) {
+        connection->Teardown(error);
+    }
+}
+
+bool FdeventConnection::HandleRead(std::string* error) {
+    auto block = std::make_unique<IOVector::block_type>(MAX_PAYLOAD);
+    int rc = adb_read(fd_.get(), &(*block)[0], block->size());
+    if (rc == -1) {
+        if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            return true;
+        }
+        *error = std::string("read failed: ") + strerror(errno);
+        return false;
+    } else if (rc == 0) {
+        *error = "read failed: EOF";
+        return false;
+    }
+    block->resize(rc);
+    read_buffer_.append(std::move(block));
+
+    // A single read can complete any number of packets.
+    while (true) {
+        if (!read_header_) {
+            if (read_buffer_.size() < sizeof(amessage)) {
+                break;
+            }
+            auto header_buf = read_buffer_.take_front(sizeof(amessage)).coalesce();
+            CHECK_EQ(sizeof(amessage), header_buf.size());
+            read_header_ = std::make_unique<amessage>();
+            memcpy(read_header_.get(), header_buf.data(), sizeof(amessage));
+            if (read_header_->data_length > MAX_PAYLOAD) {
+                *error = android::base::StringPrintf("read overflow (data length = %" PRIu32 ")",
+                                                     read_header_->data_length);
+                return false;
+            }
+        }
+
+        if (read_buffer_.size() < read_header_->data_length) {
+            break;
+        }
+
+        auto data_chain = read_buffer_.take_front(read_header_->data_length);
+        auto packet = std::make_unique<apacket>();
+        packet->msg = *read_header_;
+        packet->payload = data_chain.coalesce<apacket::payload_type>();
+        read_header_ = nullptr;
+        if (!read_callback_(this, std::move(packet))) {
+            *error = "read callback failed";
+            return false;
+        }
+    }
+    return true;
+}
+
+FdeventConnection::WriteResult FdeventConnection::DispatchWrites() {
+    if (write_buffer_.empty()) {
+        return WriteResult::Completed;
+    }
+
+    auto iovs = write_buffer_.iovecs();
+    ssize_t rc = adb_writev(fd_.get(), iovs.data(), iovs.size());
+    if (rc == -1) {
+        if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            return WriteResult::TryAgain;
+        }
+        return WriteResult::Error;
+    } else if (rc == 0) {
+        errno = 0;
+        return WriteResult::Error;
+    }
+
+    write_buffer_.take_front(rc);
+    return write_buffer_.empty() ? WriteResult::Completed : WriteResult::TryAgain;
+}
+
+bool FdeventConnection::Write(std::unique_ptr<apacket> packet) {
+    std::lock_guard<std::mutex> lock(write_mutex_);
+    if (stopped_) {
+        return false;
+    }
+
+    const char* header_begin = reinterpret_cast<const char*>(&packet->msg);
+    const char* header_end = header_begin + sizeof(packet->msg);
+    write_buffer_.append(std::make_unique<IOVector::block_type>(header_begin, header_end));
+    if (!packet->payload.empty()) {
+        write_buffer_.append(std::make_unique<IOVector::block_type>(std::move(packet->payload)));
+    }
+
+    // If we're already waiting for the socket to drain, the main loop will send this for us.
+    if (write_pending_) {
+        return true;
+    }
+
+    WriteResult result = DispatchWrites();
+    if (result == WriteResult::Error) {
+        return false;
+    } else if (result == WriteResult::TryAgain) {
+        write_pending_ = true;
+        if (fdevent_is_main_thread()) {
+            if (fde_) fdevent_add(fde_, FDE_WRITE);
+        } else {
+            // |this| may be gone by the time this runs, but only via a Teardown on the main
+            // thread, which kills |alive_| first.
+            fdevent_run_on_main_thread([this, alive = std::weak_ptr<bool>(alive_)]() {
+                if (!alive.lock()) return;
+                std::lock_guard<std::mutex> lock(write_mutex_);
+                if (fde_) fdevent_add(fde_, FDE_WRITE);
+            });
+        }
+    }
+    return true;
+}
@@ -298,11 +298,14 @@ void local_init(int port) {
 }
 
 #if ADB_HOST
-struct EmulatorConnection : public FdConnection {
+struct EmulatorConnection : public FdeventConnection {
     EmulatorConnection(unique_fd fd, int local_port)
-        : FdConnection(std::move(fd)), local_port_(local_port) {}
+        : FdeventConnection(std::move(fd)), local_port_(local_port) {}
 
     ~EmulatorConnection() {
+        // Stop here rather than in ~FdeventConnection, so that our Close still gets called.
+        Stop();
+
         VLOG(TRANSPORT) << "remote_close, local_port = " << local_port_;
         std::unique_lock<std::mutex> lock(retry_ports_lock);
         RetryPort port;
@@ -315,7 +318,6 @@ struct EmulatorConnection : public FdConnection {
     void Close() override {
         std::lock_guard<std::mutex> lock(local_transports_lock);
         local_transports.erase(local_port_);
-        FdConnection::Close();
     }
 
     int local_port_;
@@ -353,9 +355,7 @@ int init_socket_transport(atransport* t, unique_fd fd, int adb_port, int local)
 #if ADB_HOST
     // Emulator connection.
     if (local) {
-        auto emulator_connection = std::make_unique<EmulatorConnection>(std::move(fd), adb_port);
-        t->SetConnection(
-            std::make_unique<BlockingConnectionAdapter>(std::move(emulator_connection)));
+        t->SetConnection(std::make_unique<EmulatorConnection>(std::move(fd), adb_port));
         std::lock_guard<std::mutex> lock(local_transports_lock);
         atransport* existing_transport = find_emulator_transport_by_adb_port_locked(adb_port);
         if (existing_transport != nullptr) {
@@ -374,7 +374,6 @@ int init_socket_transport(atransport* t, unique_fd fd, int adb_port, int local)
 #endif
 
     // Regular tcp connection.
-    auto fd_connection = std::make_unique<FdConnection>(std::move(fd));
-    t->SetConnection(std::make_unique<BlockingConnectionAdapter>(std::move(fd_connection)));
+    t->SetConnection(std::make_unique<FdeventConnection>(std::move(fd)));
     return fail;
 }
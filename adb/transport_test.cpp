@@ -127,6 +127,20 @@ TEST_F(TransportTest, parse_banner_features) {
     ASSERT_EQ(std::string("baz"), t.device);
 }
 
+TEST_F(TransportTest, parse_banner_properties) {
+    atransport t;
+    parse_banner("device::ro.product.name=foo;ro.build.version.sdk=29;features=woodly;x=y", &t);
+
+    ASSERT_EQ(2U, t.properties.size());
+    ASSERT_EQ(std::string("foo"), t.properties["ro.product.name"]);
+    ASSERT_EQ(std::string("29"), t.properties["ro.build.version.sdk"]);
+
+    // A reconnect replaces whatever was cached before.
+    parse_banner("device::ro.build.version.sdk=30;", &t);
+    ASSERT_EQ(1U, t.properties.size());
+    ASSERT_EQ(std::string("30"), t.properties["ro.build.version.sdk"]);
+}
+
 TEST_F(TransportTest, test_matches_target) {
     std::string serial = "foo";
     std::string devpath = "/path/to/bar";
@@ -183,3 +197,100 @@ TEST_F(TransportTest, test_matches_target_local) {
         EXPECT_FALSE(t.MatchesTarget("abc:100.100.100.100"));
     }
 }
+
+TEST_F(TransportTest, connection_stats) {
+    ConnectionStats stats;
+
+    apacket packet;
+    packet.msg.data_length = 100;
+    packet.payload.resize(100);
+    stats.RecordRead(&packet);
+    stats.RecordWrite(&packet);
+    stats.RecordWrite(&packet);
+    EXPECT_EQ(1U, stats.packets_in);
+    EXPECT_EQ(sizeof(amessage) + 100, stats.bytes_in);
+    EXPECT_EQ(2U, stats.packets_out);
+    EXPECT_EQ(2 * (sizeof(amessage) + 100), stats.bytes_out);
+
+    stats.RecordQueueDepth(5);
+    stats.RecordQueueDepth(2);
+    EXPECT_EQ(2U, stats.write_queue_depth);
+    EXPECT_EQ(5U, stats.max_write_queue_depth);
+
+    stats.RecordWriteLatency(std::chrono::microseconds(500));
+    stats.RecordWriteLatency(std::chrono::milliseconds(1));
+    stats.RecordWriteLatency(std::chrono::milliseconds(3));
+    stats.RecordWriteLatency(std::chrono::seconds(10));
+    EXPECT_EQ(1U, stats.write_latency[0]);
+    EXPECT_EQ(1U, stats.write_latency[1]);
+    EXPECT_EQ(1U, stats.write_latency[2]);
+    EXPECT_EQ(1U, stats.write_latency[ConnectionStats::kWriteLatencyBuckets - 1]);
+
+    std::string str = stats.ToString();
+    EXPECT_NE(std::string::npos, str.find("packets_out=2 ")) << str;
+    EXPECT_NE(std::string::npos, str.find("write_queue=2 max_write_queue=5 ")) << str;
+    EXPECT_NE(std::string::npos, str.find("<1:1,<2:1,<4:1,")) << str;
+    EXPECT_NE(std::string::npos, str.find(",>=1024:1")) << str;
+}
+
+TEST_F(TransportTest, fdevent_connection) {
+    int fds[2];
+    ASSERT_EQ(0, adb_socketpair(fds));
+    unique_fd peer(fds[1]);
+    PrepareThread();
+
+    std::mutex mutex;
+    std::condition_variable cv;
+    size_t bytes_read = 0;
+    std::string error;
+    auto connection = std::make_unique<FdeventConnection>(unique_fd(fds[0]));
+    connection->SetReadCallback([&](Connection*, std::unique_ptr<apacket> packet) {
+        std::lock_guard<std::mutex> lock(mutex);
+        bytes_read += packet->payload.size();
+        cv.notify_one();
+        return true;
+    });
+    connection->SetErrorCallback([&](Connection*, const std::string& e) {
+        std::lock_guard<std::mutex> lock(mutex);
+        error = e;
+        cv.notify_one();
+    });
+    fdevent_run_on_main_thread([&connection]() { connection->Start(); });
+
+    // Several packets arriving in a single read are all delivered.
+    std::string incoming;
+    for (int i = 0; i < 3; ++i) {
+        amessage msg = {};
+        msg.data_length = 100;
+        incoming.append(reinterpret_cast<const char*>(&msg), sizeof(msg));
+        incoming.append(100, 'x');
+    }
+    ASSERT_TRUE(WriteFdExactly(peer, incoming.data(), incoming.size()));
+
+    // Writes larger than the socket buffer are finished by the fdevent loop.
+    constexpr size_t kPacketCount = 64;
+    std::thread reader([&peer]() {
+        std::vector<char> buf(sizeof(amessage) + MAX_PAYLOAD);
+        for (size_t i = 0; i < kPacketCount; ++i) {
+            ASSERT_TRUE(ReadFdExactly(peer, buf.data(), buf.size()));
+        }
+    });
+    for (size_t i = 0; i < kPacketCount; ++i) {
+        auto packet = std::make_unique<apacket>();
+        packet->msg.data_length = MAX_PAYLOAD;
+        packet->payload.resize(MAX_PAYLOAD);
+        ASSERT_TRUE(connection->Write(std::move(packet)));
+    }
+    reader.join();
+
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        cv.wait(lock, [&]() { return bytes_read == 300; });
+    }
+
+    connection->Stop();
+    EXPECT_EQ("requested stop", error);
+    EXPECT_FALSE(connection->Write(std::make_unique<apacket>()));
+
+    TerminateThread();
+}
@@ -0,0 +1,107 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "types.h"
+
+#include <inttypes.h>
+
+#include <android-base/stringprintf.h>
+
+std::string BlockPool::Stats::ToString() const {
+    uint64_t requests = hits + misses;
+    return android::base::StringPrintf(
+            "hits=%" PRIu64 " misses=%" PRIu64 " hit_rate=%.1f%% dropped=%" PRIu64
+            " cached_bytes=%zu",
+            hits, misses, requests ? 100.0 * hits / requests : 0.0, dropped, cached_bytes);
+}
+
+BlockPool& BlockPool::Instance() {
+    // Intentionally leaked, so that Blocks can be freed during static destruction.
+    static BlockPool& pool = *new BlockPool();
+    return pool;
+}
+
+size_t BlockPool::Capacity(size_t size) {
+    if (size < kMinPooledSize || size > kMaxPooledSize) {
+        return size;
+    }
+
+    size_t capacity = kMinPooledSize;
+    while (capacity < size) {
+        capacity <<= 1;
+    }
+    return capacity;
+}
+
+size_t BlockPool::ClassIndex(size_t capacity) {
+    size_t index = 0;
+    while ((kMinPooledSize << index) < capacity) {
+        ++index;
+    }
+    return index;
+}
+
+std::unique_ptr<char[]> BlockPool::Allocate(size_t capacity) {
+    bool pooled = capacity >= kMinPooledSize && capacity <= kMaxPooledSize;
+    if (pooled) {
+        size_t index = ClassIndex(capacity);
+        CHECK_EQ(kMinPooledSize << index, capacity);
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto& free_list = free_[index];
+        if (!free_list.empty()) {
+            std::unique_ptr<char[]> buffer = std::move(free_list.back());
+            free_list.pop_back();
+            stats_.cached_bytes -= capacity;
+            ++stats_.hits;
+            return buffer;
+        }
+        ++stats_.misses;
+    }
+
+    // This isn't std::make_unique because that's equivalent to `new char[size]()`, which
+    // value-initializes the array instead of leaving it uninitialized. As an optimization,
+    // call new without parentheses to avoid this costly initialization.
+    return std::unique_ptr<char[]>(new char[capacity]);
+}
+
+void BlockPool::Release(std::unique_ptr<char[]> buffer, size_t capacity) {
+    if (capacity < kMinPooledSize || capacity > kMaxPooledSize) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (stats_.cached_bytes + capacity > kMaxCachedBytes) {
+        ++stats_.dropped;
+        return;
+    }
+
+    free_[ClassIndex(capacity)].push_back(std::move(buffer));
+    stats_.cached_bytes += capacity;
+}
+
+BlockPool::Stats BlockPool::GetStats() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_;
+}
+
+void BlockPool::Reset() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto& free_list : free_) {
+        free_list.clear();
+    }
+    stats_ = Stats();
+}
@@ -16,17 +16,72 @@
 
 #pragma once
 
+#include <stdint.h>
+
 #include <algorithm>
+#include <array>
 #include <deque>
 #include <memory>
+#include <mutex>
+#include <string>
 #include <type_traits>
 #include <utility>
 #include <vector>
 
 #include <android-base/logging.h>
+#include <android-base/thread_annotations.h>
 
 #include "sysdeps/uio.h"
 
+// A cache of freed Block buffers, so that bulk transfers reuse a handful of payload-sized buffers
+// instead of going back to the heap for every packet.
+//
+// Buffers between kMinPooledSize and kMaxPooledSize are rounded up to a power of two, and at most
+// kMaxCachedBytes worth of them are kept around. Everything else goes straight to the heap.
+class BlockPool {
+  public:
+    static constexpr size_t kMinPooledSize = 4096;
+    static constexpr size_t kMaxPooledSize = 1024 * 1024;  // MAX_PAYLOAD
+    static constexpr size_t kMaxCachedBytes = 4 * 1024 * 1024;
+
+    struct Stats {
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+        uint64_t dropped = 0;
+        size_t cached_bytes = 0;
+
+        std::string ToString() const;
+    };
+
+    static BlockPool& Instance();
+
+    // Returns the capacity of the buffer that will be allocated for a Block of |size| bytes.
+    static size_t Capacity(size_t size);
+
+    // Returns a buffer of |capacity| bytes, which must have come from Capacity().
+    std::unique_ptr<char[]> Allocate(size_t capacity);
+
+    // Returns a buffer previously obtained from Allocate to the pool.
+    void Release(std::unique_ptr<char[]> buffer, size_t capacity);
+
+    Stats GetStats();
+
+    // Frees all of the cached buffers and resets the statistics.
+    void Reset();
+
+  private:
+    BlockPool() = default;
+
+    static constexpr size_t kClassCount = 9;  // 4KiB, 8KiB, ..., 1MiB.
+    static_assert(kMinPooledSize << (kClassCount - 1) == kMaxPooledSize);
+
+    static size_t ClassIndex(size_t capacity);
+
+    std::mutex mutex_;
+    std::array<std::vector<std::unique_ptr<char[]>>, kClassCount> free_ GUARDED_BY(mutex_);
+    Stats stats_ GUARDED_BY(mutex_);
+};
+
 // Essentially std::vector<char>, except without zero initialization or reallocation.
 struct Block {
     using iterator = char*;
@@ -77,7 +132,9 @@ struct Block {
     }
 
     void clear() {
-        data_.reset();
+        if (data_) {
+            BlockPool::Instance().Release(std::move(data_), capacity_);
+        }
         capacity_ = 0;
         size_ = 0;
     }
@@ -108,11 +165,8 @@ struct Block {
         CHECK_EQ(0ULL, capacity_);
         CHECK_EQ(0ULL, size_);
         if (size != 0) {
-            // This isn't std::make_unique because that's equivalent to `new char[size]()`, which
-            // value-initializes the array instead of leaving it uninitialized. As an optimization,
-            // call new without parentheses to avoid this costly initialization.
-            data_.reset(new char[size]);
-            capacity_ = size;
+            capacity_ = BlockPool::Capacity(size);
+            data_ = BlockPool::Instance().Allocate(capacity_);
             size_ = size;
         }
     }
@@ -117,3 +117,51 @@ TEST(IOVector, misaligned_split) {
     ASSERT_EQ(1ULL, bc.size());
     ASSERT_EQ(*create_block("x"), bc.coalesce());
 }
+
+TEST(BlockPool, capacity) {
+    ASSERT_EQ(24ULL, BlockPool::Capacity(24));
+    ASSERT_EQ(4096ULL, BlockPool::Capacity(4096));
+    ASSERT_EQ(8192ULL, BlockPool::Capacity(4097));
+    ASSERT_EQ(1024ULL * 1024, BlockPool::Capacity(1024 * 1024));
+    ASSERT_EQ(1024ULL * 1024 + 1, BlockPool::Capacity(1024 * 1024 + 1));
+}
+
+TEST(BlockPool, reuse) {
+    BlockPool::Instance().Reset();
+
+    char* data;
+    {
+        Block block(1024 * 1024);
+        data = block.data();
+    }
+
+    // A block of the same size class should get the same buffer back.
+    Block block(768 * 1024);
+    ASSERT_EQ(data, block.data());
+    ASSERT_EQ(1024ULL * 1024, block.capacity());
+    ASSERT_EQ(768ULL * 1024, block.size());
+
+    // Small blocks never touch the pool.
+    Block small(24);
+
+    BlockPool::Stats stats = BlockPool::Instance().GetStats();
+    ASSERT_EQ(1ULL, stats.hits);
+    ASSERT_EQ(1ULL, stats.misses);
+    ASSERT_EQ(0ULL, stats.cached_bytes);
+}
+
+TEST(BlockPool, limit) {
+    BlockPool::Instance().Reset();
+
+    {
+        std::vector<Block> blocks;
+        for (size_t i = 0; i < BlockPool::kMaxCachedBytes / BlockPool::kMaxPooledSize + 1; ++i) {
+            blocks.emplace_back(BlockPool::kMaxPooledSize);
+        }
+    }
+
+    BlockPool::Stats stats = BlockPool::Instance().GetStats();
+    ASSERT_EQ(1ULL, stats.dropped);
+    ASSERT_EQ(BlockPool::kMaxCachedBytes, stats.cached_bytes);
+    BlockPool::Instance().Reset();
+}
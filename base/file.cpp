@@ -187,11 +187,29 @@ bool ReadFdToString(int fd, std::string* content) {
     content->reserve(sb.st_size);
   }
 
+  // Read straight into whatever capacity the string has, rather than copying
+  // out of a small buffer, so that a caller that reuses one string for
+  // repeated reads of the same /proc file (which reports a size of 0) reads it
+  // with one large read() and no allocation. Only once the string is full do
+  // we read into buf, which both checks for EOF without growing the string
+  // and lets append() grow it geometrically if there is more.
   char buf[BUFSIZ];
+  size_t size = 0;
   ssize_t n;
-  while ((n = TEMP_FAILURE_RETRY(read(fd, &buf[0], sizeof(buf)))) > 0) {
-    content->append(buf, n);
+  while (true) {
+    if (size < content->capacity()) {
+      content->resize(content->capacity());
+      n = TEMP_FAILURE_RETRY(read(fd, &(*content)[size], content->size() - size));
+      if (n <= 0) break;
+      size += n;
+    } else {
+      n = TEMP_FAILURE_RETRY(read(fd, &buf[0], sizeof(buf)));
+      if (n <= 0) break;
+      content->append(buf, n);
+      size += n;
+    }
   }
+  content->resize(size);
   return (n == 0) ? true : false;
 }
 
@@ -0,0 +1,43 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "android-base/file.h"
+
+#include <string>
+
+#include <benchmark/benchmark.h>
+
+// /proc/self/smaps reports a size of 0 but is typically hundreds of KiB.
+static void BM_ReadFileToString_smaps(benchmark::State& state) {
+  for (auto _ : state) {
+    std::string content;
+    android::base::ReadFileToString("/proc/self/smaps", &content);
+    benchmark::DoNotOptimize(content);
+  }
+}
+BENCHMARK(BM_ReadFileToString_smaps);
+
+// Same, reusing one string the way a polling daemon would.
+static void BM_ReadFileToString_smaps_reused(benchmark::State& state) {
+  std::string content;
+  for (auto _ : state) {
+    android::base::ReadFileToString("/proc/self/smaps", &content);
+    benchmark::DoNotOptimize(content);
+  }
+}
+BENCHMARK(BM_ReadFileToString_smaps_reused);
+
+// BENCHMARK_MAIN() is in logging_benchmark.cpp.
@@ -16,6 +16,8 @@
 
 #include "android-base/file.h"
 
+#include "android-base/unique_fd.h"
+
 #include <gtest/gtest.h>
 
 #include <errno.h>
@@ -23,6 +25,7 @@
 #include <unistd.h>
 
 #include <string>
+#include <thread>
 
 #if !defined(_WIN32)
 #include <pwd.h>
@@ -293,3 +296,45 @@ TEST(file, ReadFileToString_capacity_0) {
   EXPECT_EQ(0U, s.size());
   EXPECT_EQ(initial_capacity, s.capacity());
 }
+
+TEST(file, ReadFileToString_reuses_capacity) {
+  TemporaryFile tf;
+  ASSERT_TRUE(tf.fd != -1);
+  std::string expected(100000, 'x');
+  ASSERT_TRUE(android::base::WriteStringToFile(expected, tf.path));
+
+  std::string s;
+  ASSERT_TRUE(android::base::ReadFileToString(tf.path, &s));
+  ASSERT_EQ(expected, s);
+  const char* data = s.data();
+  size_t capacity = s.capacity();
+  ASSERT_TRUE(android::base::ReadFileToString(tf.path, &s));
+  ASSERT_EQ(expected, s);
+  EXPECT_EQ(data, s.data());
+  EXPECT_EQ(capacity, s.capacity());
+}
+
+#if !defined(_WIN32)
+TEST(file, ReadFdToString_unknown_size) {
+  // A pipe has no size either, like the files in /proc, and hands the data
+  // over at most a pipe buffer at a time.
+  int fds[2];
+  ASSERT_EQ(0, pipe(fds));
+  android::base::unique_fd read_fd(fds[0]);
+  android::base::unique_fd write_fd(fds[1]);
+
+  std::string expected;
+  for (int i = 0; expected.size() < 1024 * 1024; i++) {
+    expected += std::to_string(i) + "\n";
+  }
+  std::thread writer([&]() {
+    ASSERT_TRUE(android::base::WriteStringToFd(expected, write_fd));
+    write_fd.reset();
+  });
+
+  std::string s;
+  ASSERT_TRUE(android::base::ReadFdToString(read_fd, &s));
+  writer.join();
+  ASSERT_EQ(expected, s);
+}
+#endif
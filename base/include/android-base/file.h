@@ -77,6 +77,9 @@ class TemporaryDir {
 namespace android {
 namespace base {
 
+// Reads into the existing storage of |content| before growing it, so callers
+// that read the same file repeatedly (such as /proc files, for which fstat()
+// can't give a size) can keep one string around and avoid allocating.
 bool ReadFdToString(int fd, std::string* content);
 bool ReadFileToString(const std::string& path, std::string* content,
                       bool follow_symlinks = false);
@@ -131,6 +131,36 @@ class LogdLogger {
 };
 #endif
 
+// Wraps another logger so that messages are handed off to a background thread
+// that passes them on, rather than being written by the logging thread:
+//
+//   SetLogger(AsyncLogger(LogdLogger()));
+//
+// Messages are copied into a batch that the writer thread takes whole, so the
+// wrapped logger sees them in order. Callers only block if the writer falls
+// more than a batch behind. FATAL and FATAL_WITHOUT_ABORT messages flush
+// everything before them and are written synchronously, so nothing is lost to
+// the abort that follows. Anything else still queued at exit() is lost unless
+// Flush() is called first. After a fork(), the child has no writer thread and
+// writes synchronously.
+class AsyncLogger {
+ public:
+  explicit AsyncLogger(LogFunction&& logger);
+
+  void operator()(LogId, LogSeverity, const char* tag, const char* file, unsigned int line,
+                  const char* message);
+
+  // Blocks until everything logged so far has been passed to the wrapped
+  // logger.
+  void Flush();
+
+ private:
+  class State;
+  // Shared by the copies LogFunction makes; the writer thread is stopped when
+  // the last one is destroyed.
+  std::shared_ptr<State> state_;
+};
+
 // Configure logging based on ANDROID_LOG_TAGS environment variable.
 // We need to parse a string that looks like
 //
@@ -39,6 +39,23 @@ namespace base {
  */
 class MappedFile {
  public:
+  /**
+   * Flags for `FromFd`. They are only hints, and are ignored where the OS doesn't support them.
+   */
+  enum Flags {
+    /**
+     * Reads the whole range in and maps it up front (`MAP_POPULATE`), instead of taking a page
+     * fault for each page on first access. For mappings that are about to be read in full.
+     */
+    kPopulate = 1 << 0,
+    /**
+     * Asks for transparent huge pages (`MADV_HUGEPAGE`) where the file system supports them for
+     * file mappings, and places the mapping so that its file offsets line up with huge page
+     * boundaries. For large, long-lived, read-mostly mappings.
+     */
+    kHugePages = 1 << 1,
+  };
+
   /**
    * Creates a new mapping of the file pointed to by `fd`. Unlike the underlying OS primitives,
    * `offset` does not need to be page-aligned. If `PROT_WRITE` is set in `prot`, the mapping
@@ -46,6 +63,12 @@ class MappedFile {
    */
   static std::unique_ptr<MappedFile> FromFd(int fd, off64_t offset, size_t length, int prot);
 
+  /**
+   * As above, with a combination of `Flags`.
+   */
+  static std::unique_ptr<MappedFile> FromFd(int fd, off64_t offset, size_t length, int prot,
+                                            int flags);
+
   /**
    * Removes the mapping.
    */
@@ -54,6 +77,13 @@ class MappedFile {
   char* data() { return base_ + offset_; }
   size_t size() { return size_; }
 
+  /**
+   * Starts reading in the `length` bytes at `offset` (relative to `data()`) without waiting for
+   * them (`MADV_WILLNEED`). The range is clamped to the mapping. Returns false if the
+   * hint couldn't be given.
+   */
+  bool Prefetch(size_t offset, size_t length);
+
  private:
   DISALLOW_IMPLICIT_CONSTRUCTORS(MappedFile);
 
@@ -16,11 +16,17 @@
 
 #pragma once
 
+#include <stdint.h>
 #include <sys/cdefs.h>
 
 #include <chrono>
 #include <limits>
+#include <optional>
 #include <string>
+#include <utility>
+#include <vector>
+
+struct prop_info;
 
 namespace android {
 namespace base {
@@ -54,6 +60,11 @@ template <typename T> T GetUintProperty(const std::string& key,
 // tell you whether or not your call succeeded. A `false` return value definitely means failure.
 bool SetProperty(const std::string& key, const std::string& value);
 
+// Sets each system property `key` to `value` like SetProperty(), sending up to 128 of them to
+// init in one request. Within a request, a property that is listed more than once is only set
+// to its last value. Returns `false` if any of the properties failed to be set.
+bool SetProperties(const std::vector<std::pair<std::string, std::string>>& properties);
+
 // Waits for the system property `key` to have the value `expected_value`.
 // Times out after `relative_timeout`.
 // Returns true on success, false on timeout.
@@ -70,5 +81,32 @@ bool WaitForPropertyCreation(const std::string& key, std::chrono::milliseconds r
                                                          std::chrono::milliseconds::max());
 #endif
 
+// Cheap repeated reads of the system property `key`, for code that looks at a property far
+// more often than it changes. Looking the property up and copying its value only happens when
+// its serial shows that it changed since the last Get(). The serial is one atomic load. Until
+// the property exists, Get() only looks for it again when some property has been added since.
+//
+// Not thread safe: each thread needs its own instance, or the caller has to lock.
+class CachedProperty {
+ public:
+  explicit CachedProperty(const std::string& key);
+
+  // Returns the current value of the property, empty if it doesn't exist. The reference stays
+  // valid until the next call. `changed`, if not null, is set to whether the value may differ
+  // from the one the previous call returned.
+  const std::string& Get(bool* changed = nullptr);
+
+  const std::string& key() const { return key_; }
+
+ private:
+  std::string key_;
+  std::string value_;
+#if defined(__BIONIC__)
+  const prop_info* prop_info_ = nullptr;
+  std::optional<uint32_t> cached_area_serial_;
+  std::optional<uint32_t> cached_property_serial_;
+#endif
+};
+
 } // namespace base
 } // namespace android
@@ -36,11 +36,18 @@
 #include <sys/uio.h>
 #endif
 
+#if !defined(_WIN32)
+#include <pthread.h>
+#endif
+
+#include <atomic>
+#include <condition_variable>
 #include <iostream>
 #include <limits>
 #include <mutex>
 #include <sstream>
 #include <string>
+#include <thread>
 #include <utility>
 #include <vector>
 
@@ -278,6 +285,163 @@ void LogdLogger::operator()(LogId id, LogSeverity severity, const char* tag,
 }
 #endif
 
+// Bumped in the child on every fork(), which doesn't copy the writer threads.
+static std::atomic<uint64_t> gForkGeneration;
+
+class AsyncLogger::State {
+ public:
+  explicit State(LogFunction&& logger)
+      : logger_(std::move(logger)), fork_generation_(gForkGeneration.load()) {
+#if !defined(_WIN32)
+    static std::once_flag atfork_once;
+    std::call_once(atfork_once, []() {
+      pthread_atfork(nullptr, nullptr, []() { gForkGeneration++; });
+    });
+#endif
+    writer_.reset(new std::thread(&State::WriterLoop, this));
+  }
+
+  ~State() {
+    if (IsForkedChild()) {
+      // There is no thread to join, and a joinable std::thread can't be
+      // destroyed, so leak it.
+      writer_.release();
+      return;
+    }
+    {
+      std::lock_guard<std::mutex> lock(lock_);
+      stopping_ = true;
+    }
+    work_available_.notify_one();
+    writer_->join();
+  }
+
+  void Log(LogId id, LogSeverity severity, const char* tag, const char* file, unsigned int line,
+           const char* message) {
+    if (IsForkedChild()) {
+      // The writer thread didn't survive the fork, and neither did any lock
+      // it held; callers are serialized by the logging lock already.
+      logger_(id, severity, tag, file, line, message);
+      return;
+    }
+    if (severity >= FATAL_WITHOUT_ABORT) {
+      Flush();
+      std::lock_guard<std::mutex> lock(write_lock_);
+      logger_(id, severity, tag, file, line, message);
+      return;
+    }
+
+    std::unique_lock<std::mutex> lock(lock_);
+    space_available_.wait(lock, [this]() { return pending_.text.size() < kMaxBatchBytes; });
+    bool was_empty = pending_.entries.empty();
+    pending_.Append(id, severity, tag, file, line, message);
+    lock.unlock();
+    if (was_empty) work_available_.notify_one();
+  }
+
+  void Flush() {
+    if (IsForkedChild()) return;
+    std::unique_lock<std::mutex> lock(lock_);
+    space_available_.wait(lock, [this]() { return pending_.entries.empty() && !writing_; });
+  }
+
+ private:
+  // Once a batch is this big, callers wait for the writer to take it.
+  static constexpr size_t kMaxBatchBytes = 64 * 1024;
+
+  // The strings of each entry are stored NUL terminated in one buffer, so a
+  // batch stops allocating once it has been through the writer a few times.
+  struct Batch {
+    struct Entry {
+      LogId id;
+      LogSeverity severity;
+      unsigned int line;
+      size_t tag;
+      size_t file;
+      size_t message;
+    };
+
+    void Append(LogId id, LogSeverity severity, const char* tag, const char* file,
+                unsigned int line, const char* message) {
+      entries.push_back({id, severity, line, AppendString(tag), AppendString(file),
+                         AppendString(message)});
+    }
+
+    size_t AppendString(const char* s) {
+      size_t offset = text.size();
+      text.append(s, strlen(s) + 1);
+      return offset;
+    }
+
+    void Clear() {
+      entries.clear();
+      text.clear();
+    }
+
+    std::vector<Entry> entries;
+    std::string text;
+  };
+
+  bool IsForkedChild() const { return fork_generation_ != gForkGeneration.load(); }
+
+  void WriterLoop() {
+    Batch batch;
+    std::unique_lock<std::mutex> lock(lock_);
+    while (true) {
+      work_available_.wait(lock, [this]() { return stopping_ || !pending_.entries.empty(); });
+      if (pending_.entries.empty()) return;
+
+      std::swap(batch, pending_);
+      writing_ = true;
+      lock.unlock();
+      space_available_.notify_all();
+
+      {
+        std::lock_guard<std::mutex> write_lock(write_lock_);
+        for (const auto& entry : batch.entries) {
+          logger_(entry.id, entry.severity, &batch.text[entry.tag], &batch.text[entry.file],
+                  entry.line, &batch.text[entry.message]);
+        }
+      }
+      batch.Clear();
+
+      lock.lock();
+      writing_ = false;
+      space_available_.notify_all();
+    }
+  }
+
+  const LogFunction logger_;
+  const uint64_t fork_generation_;
+
+  // Serializes calls to logger_ between the writer and synchronous writes.
+  std::mutex write_lock_;
+
+  std::mutex lock_;
+  std::condition_variable work_available_;
+  // Signalled when pending_ is taken and when a batch has been written.
+  std::condition_variable space_available_;
+  Batch pending_;
+  bool writing_ = false;
+  bool stopping_ = false;
+
+  std::unique_ptr<std::thread> writer_;
+
+  DISALLOW_COPY_AND_ASSIGN(State);
+};
+
+AsyncLogger::AsyncLogger(LogFunction&& logger)
+    : state_(std::make_shared<State>(std::move(logger))) {}
+
+void AsyncLogger::operator()(LogId id, LogSeverity severity, const char* tag, const char* file,
+                             unsigned int line, const char* message) {
+  state_->Log(id, severity, tag, file, line, message);
+}
+
+void AsyncLogger::Flush() {
+  state_->Flush();
+}
+
 void InitLogging(char* argv[], LogFunction&& logger, AbortFunction&& aborter) {
   SetLogger(std::forward<LogFunction>(logger));
   SetAborter(std::forward<AbortFunction>(aborter));
@@ -0,0 +1,72 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "android-base/logging.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <benchmark/benchmark.h>
+
+// Cost to the logging thread of LOG(INFO) through the default logger
+// (logd on device, stderr on host) and through an AsyncLogger wrapping it.
+// stderr is pointed at /dev/null so the host numbers aren't terminal bound.
+
+class ScopedDevNullStderr {
+ public:
+  ScopedDevNullStderr() : saved_(dup(STDERR_FILENO)) {
+    int fd = open("/dev/null", O_WRONLY | O_CLOEXEC);
+    dup2(fd, STDERR_FILENO);
+    close(fd);
+  }
+  ~ScopedDevNullStderr() {
+    dup2(saved_, STDERR_FILENO);
+    close(saved_);
+  }
+
+ private:
+  int saved_;
+};
+
+#ifdef __ANDROID__
+#define DEFAULT_LOGGER android::base::LogdLogger()
+#else
+#define DEFAULT_LOGGER android::base::StderrLogger
+#endif
+
+static void BM_LOG_sync(benchmark::State& state) {
+  ScopedDevNullStderr devnull;
+  android::base::SetLogger(DEFAULT_LOGGER);
+  for (auto _ : state) {
+    LOG(INFO) << "benchmark message " << 42;
+  }
+}
+BENCHMARK(BM_LOG_sync);
+
+static void BM_LOG_async(benchmark::State& state) {
+  ScopedDevNullStderr devnull;
+  android::base::AsyncLogger logger(DEFAULT_LOGGER);
+  android::base::SetLogger(logger);
+  for (auto _ : state) {
+    LOG(INFO) << "benchmark message " << 42;
+  }
+  // Outside the timed loop: the writer catching up.
+  logger.Flush();
+  android::base::SetLogger(DEFAULT_LOGGER);
+}
+BENCHMARK(BM_LOG_async);
+
+BENCHMARK_MAIN();
@@ -22,8 +22,16 @@
 #include <signal.h>
 #endif
 
+#if !defined(_WIN32)
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+#include <memory>
+#include <mutex>
 #include <regex>
 #include <string>
+#include <vector>
 
 #include "android-base/file.h"
 #include "android-base/stringprintf.h"
@@ -648,3 +656,104 @@ TEST(logging, StdioLogger) {
   // Whereas ERROR logging includes the program name.
   ASSERT_EQ(android::base::Basename(android::base::GetExecutablePath()) + ": err\n", cap_err.str());
 }
+
+// Records what reaches the wrapped logger, as "severity tag file:line message".
+class RecordingLogger {
+ public:
+  RecordingLogger() : lines_(std::make_shared<Lines>()) {}
+
+  void operator()(android::base::LogId, android::base::LogSeverity severity, const char* tag,
+                  const char* file, unsigned int line, const char* message) {
+    std::lock_guard<std::mutex> lock(lines_->lock);
+    lines_->lines.push_back(android::base::StringPrintf("%d %s %s:%u %s", severity, tag, file,
+                                                        line, message));
+  }
+
+  std::vector<std::string> lines() const {
+    std::lock_guard<std::mutex> lock(lines_->lock);
+    return lines_->lines;
+  }
+
+ private:
+  struct Lines {
+    std::mutex lock;
+    std::vector<std::string> lines;
+  };
+  std::shared_ptr<Lines> lines_;
+};
+
+TEST(logging, AsyncLogger) {
+  RecordingLogger recorder;
+  android::base::AsyncLogger logger{android::base::LogFunction(recorder)};
+  {
+    // The strings only have to live as long as the call.
+    std::string tag = "tag";
+    std::string message = "first";
+    logger(android::base::MAIN, android::base::INFO, tag.c_str(), "file", 1, message.c_str());
+  }
+  logger(android::base::MAIN, android::base::WARNING, "tag", "file", 2, "second");
+  logger.Flush();
+
+  std::vector<std::string> expected = {
+      android::base::StringPrintf("%d tag file:1 first", android::base::INFO),
+      android::base::StringPrintf("%d tag file:2 second", android::base::WARNING),
+  };
+  EXPECT_EQ(expected, recorder.lines());
+}
+
+TEST(logging, AsyncLogger_many) {
+  RecordingLogger recorder;
+  android::base::AsyncLogger logger{android::base::LogFunction(recorder)};
+  // Well over a batch, so that callers have to wait for the writer.
+  std::string padding(100, 'x');
+  for (unsigned int i = 0; i < 10000; i++) {
+    logger(android::base::MAIN, android::base::INFO, "tag", "file", i, padding.c_str());
+  }
+  logger.Flush();
+
+  std::vector<std::string> lines = recorder.lines();
+  ASSERT_EQ(10000U, lines.size());
+  for (unsigned int i = 0; i < lines.size(); i++) {
+    ASSERT_EQ(android::base::StringPrintf("%d tag file:%u %s", android::base::INFO, i,
+                                          padding.c_str()),
+              lines[i]);
+  }
+}
+
+TEST(logging, AsyncLogger_fatal_is_synchronous) {
+  RecordingLogger recorder;
+  android::base::AsyncLogger logger{android::base::LogFunction(recorder)};
+  logger(android::base::MAIN, android::base::INFO, "tag", "file", 1, "before");
+  logger(android::base::MAIN, android::base::FATAL_WITHOUT_ABORT, "tag", "file", 2, "fatal");
+
+  // No Flush(): both have to be there already, in order.
+  std::vector<std::string> expected = {
+      android::base::StringPrintf("%d tag file:1 before", android::base::INFO),
+      android::base::StringPrintf("%d tag file:2 fatal", android::base::FATAL_WITHOUT_ABORT),
+  };
+  EXPECT_EQ(expected, recorder.lines());
+}
+
+#if !defined(_WIN32)
+TEST(logging, AsyncLogger_fork) {
+  RecordingLogger recorder;
+  android::base::AsyncLogger logger{android::base::LogFunction(recorder)};
+
+  pid_t pid = fork();
+  ASSERT_NE(-1, pid);
+  if (pid == 0) {
+    // The child has no writer thread, so this has to be written directly.
+    logger(android::base::MAIN, android::base::INFO, "tag", "file", 1, "child");
+    _exit(recorder.lines().size() == 1 ? 0 : 1);
+  }
+
+  int status;
+  ASSERT_EQ(pid, TEMP_FAILURE_RETRY(waitpid(pid, &status, 0)));
+  ASSERT_TRUE(WIFEXITED(status));
+  EXPECT_EQ(0, WEXITSTATUS(status));
+
+  logger(android::base::MAIN, android::base::INFO, "tag", "file", 2, "parent");
+  logger.Flush();
+  EXPECT_EQ(1U, recorder.lines().size());
+}
+#endif
@@ -16,6 +16,10 @@
 
 #include "android-base/mapped_file.h"
 
+#include <stdint.h>
+
+#include <algorithm>
+
 namespace android {
 namespace base {
 
@@ -29,8 +33,46 @@ static off64_t InitPageSize() {
 #endif
 }
 
-std::unique_ptr<MappedFile> MappedFile::FromFd(int fd, off64_t offset, size_t length, int prot) {
+static off64_t GetPageSize() {
   static off64_t page_size = InitPageSize();
+  return page_size;
+}
+
+#if !defined(_WIN32)
+// The PMD size, which is what transparent huge pages are on 4KiB page kernels.
+static constexpr off64_t kHugePageSize = 2 * 1024 * 1024;
+
+// A file page can only be part of a huge page if its address and its file offset are the same
+// modulo the huge page size. mmap() only guarantees page alignment, so reserve enough address
+// space to pick a suitably aligned start and unmap the rest.
+static void* MapForHugePages(size_t length, int prot, int flags, int fd, off64_t offset) {
+  length = (length + GetPageSize() - 1) & ~(GetPageSize() - 1);
+  size_t reserve_length = length + kHugePageSize;
+  void* reserve = mmap(nullptr, reserve_length, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (reserve == MAP_FAILED) return mmap(nullptr, length, prot, flags, fd, offset);
+
+  uintptr_t reserve_start = reinterpret_cast<uintptr_t>(reserve);
+  uintptr_t reserve_end = reserve_start + reserve_length;
+  uintptr_t start = reserve_start + (offset - reserve_start) % kHugePageSize;
+  void* base = mmap(reinterpret_cast<void*>(start), length, prot, flags | MAP_FIXED, fd, offset);
+  if (base == MAP_FAILED) {
+    munmap(reserve, reserve_length);
+    return MAP_FAILED;
+  }
+  uintptr_t end = start + length;
+  if (start > reserve_start) munmap(reserve, start - reserve_start);
+  if (reserve_end > end) munmap(reinterpret_cast<void*>(end), reserve_end - end);
+  return base;
+}
+#endif
+
+std::unique_ptr<MappedFile> MappedFile::FromFd(int fd, off64_t offset, size_t length, int prot) {
+  return FromFd(fd, offset, length, prot, 0);
+}
+
+std::unique_ptr<MappedFile> MappedFile::FromFd(int fd, off64_t offset, size_t length, int prot,
+                                               [[maybe_unused]] int flags) {
+  off64_t page_size = GetPageSize();
   size_t slop = offset % page_size;
   off64_t file_offset = offset - slop;
   off64_t file_length = length + slop;
@@ -49,12 +91,38 @@ std::unique_ptr<MappedFile> MappedFile::FromFd(int fd, off64_t offset, size_t le
   return std::unique_ptr<MappedFile>(
       new MappedFile{static_cast<char*>(base), length, slop, handle});
 #else
-  void* base = mmap(nullptr, file_length, prot, MAP_SHARED, fd, file_offset);
+  int map_flags = MAP_SHARED;
+#if defined(MAP_POPULATE)
+  if (flags & kPopulate) map_flags |= MAP_POPULATE;
+#endif
+  void* base;
+  if ((flags & kHugePages) && file_length >= kHugePageSize) {
+    base = MapForHugePages(file_length, prot, map_flags, fd, file_offset);
+  } else {
+    base = mmap(nullptr, file_length, prot, map_flags, fd, file_offset);
+  }
   if (base == MAP_FAILED) return nullptr;
+#if defined(MADV_HUGEPAGE)
+  // Fails with EINVAL on kernels without transparent huge page support, which is fine.
+  if (flags & kHugePages) madvise(base, file_length, MADV_HUGEPAGE);
+#endif
   return std::unique_ptr<MappedFile>(new MappedFile{static_cast<char*>(base), length, slop});
 #endif
 }
 
+bool MappedFile::Prefetch(size_t offset, size_t length) {
+  if (offset >= size_) return length == 0;
+  length = std::min(length, size_ - offset);
+#if defined(_WIN32)
+  return false;
+#else
+  // madvise() wants a page-aligned start; base_ is one.
+  size_t start = offset_ + offset;
+  size_t slop = start % GetPageSize();
+  return madvise(base_ + start - slop, length + slop, MADV_WILLNEED) == 0;
+#endif
+}
+
 MappedFile::~MappedFile() {
 #if defined(_WIN32)
   if (base_ != nullptr) UnmapViewOfFile(base_);
@@ -37,3 +37,40 @@ TEST(mapped_file, smoke) {
   ASSERT_EQ('l', m->data()[0]);
   ASSERT_EQ('o', m->data()[1]);
 }
+
+TEST(mapped_file, flags) {
+  TemporaryFile tf;
+  ASSERT_TRUE(tf.fd != -1);
+  // Large enough for the huge page path to be taken.
+  std::string content(3 * 1024 * 1024, 'x');
+  content[5000] = 'y';
+  ASSERT_TRUE(android::base::WriteStringToFd(content, tf.fd));
+
+  auto m = android::base::MappedFile::FromFd(
+      tf.fd, 4999, 4096, PROT_READ, android::base::MappedFile::kPopulate);
+  ASSERT_NE(nullptr, m);
+  ASSERT_EQ('x', m->data()[0]);
+  ASSERT_EQ('y', m->data()[1]);
+
+  m = android::base::MappedFile::FromFd(tf.fd, 4999, content.size() - 4999, PROT_READ,
+                                        android::base::MappedFile::kHugePages |
+                                            android::base::MappedFile::kPopulate);
+  ASSERT_NE(nullptr, m);
+  ASSERT_EQ(content.size() - 4999, m->size());
+  ASSERT_EQ('y', m->data()[1]);
+  ASSERT_EQ('x', m->data()[m->size() - 1]);
+}
+
+TEST(mapped_file, Prefetch) {
+  TemporaryFile tf;
+  ASSERT_TRUE(tf.fd != -1);
+  ASSERT_TRUE(android::base::WriteStringToFd(std::string(3 * 4096, 'x'), tf.fd));
+
+  auto m = android::base::MappedFile::FromFd(tf.fd, 100, 2 * 4096, PROT_READ);
+  ASSERT_NE(nullptr, m);
+  ASSERT_TRUE(m->Prefetch(0, m->size()));
+  ASSERT_TRUE(m->Prefetch(4000, 1000));
+  // Clamped to the mapping.
+  ASSERT_TRUE(m->Prefetch(4096, 1024 * 1024));
+  ASSERT_FALSE(m->Prefetch(m->size(), 1));
+}
@@ -18,8 +18,11 @@
 
 #if defined(__BIONIC__)
 #define _REALLY_INCLUDE_SYS__SYSTEM_PROPERTIES_H_
+#include <string.h>
+#include <sys/socket.h>
 #include <sys/system_properties.h>
 #include <sys/_system_properties.h>
+#include <sys/un.h>
 #endif
 
 #include <algorithm>
@@ -27,8 +30,13 @@
 #include <limits>
 #include <map>
 #include <string>
+#include <utility>
+#include <vector>
 
+#include <android-base/file.h>
+#include <android-base/macros.h>
 #include <android-base/parseint.h>
+#include <android-base/unique_fd.h>
 
 namespace android {
 namespace base {
@@ -100,10 +108,114 @@ std::string GetProperty(const std::string& key, const std::string& default_value
   return property_value.empty() ? default_value : property_value;
 }
 
+CachedProperty::CachedProperty(const std::string& key) : key_(key) {}
+
+const std::string& CachedProperty::Get(bool* changed) {
+#if defined(__BIONIC__)
+  std::optional<uint32_t> initial_property_serial = cached_property_serial_;
+
+  if (prop_info_ == nullptr) {
+    // Read the area serial before looking, so that a property added in between is looked for
+    // again on the next call.
+    uint32_t area_serial = __system_property_area_serial();
+    if (area_serial != cached_area_serial_) {
+      cached_area_serial_ = area_serial;
+      prop_info_ = __system_property_find(key_.c_str());
+    }
+  }
+
+  if (prop_info_ != nullptr && __system_property_serial(prop_info_) != cached_property_serial_) {
+    __system_property_read_callback(prop_info_,
+                                    [](void* cookie, const char*, const char* value,
+                                       unsigned serial) {
+                                      auto cached = reinterpret_cast<CachedProperty*>(cookie);
+                                      cached->value_ = value;
+                                      cached->cached_property_serial_ = serial;
+                                    },
+                                    this);
+  }
+
+  if (changed != nullptr) *changed = cached_property_serial_ != initial_property_serial;
+#else
+  auto it = g_properties.find(key_);
+  std::string value = it == g_properties.end() ? "" : it->second;
+  if (changed != nullptr) *changed = value != value_;
+  value_ = std::move(value);
+#endif
+  return value_;
+}
+
 bool SetProperty(const std::string& key, const std::string& value) {
   return (__system_property_set(key.c_str(), value.c_str()) == 0);
 }
 
+using PropertyList = std::vector<std::pair<std::string, std::string>>;
+
+#if defined(__BIONIC__)
+// Must match PROP_MSG_SETPROP_BATCH in system/core/init/property_service.cpp.
+static constexpr uint32_t kPropMsgSetPropBatch = 0x00020002;
+// The most properties that init accepts in one batch.
+static constexpr size_t kMaxPropertyBatchSize = 128;
+
+static void AppendUint32(std::string* msg, uint32_t value) {
+  msg->append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+// Sends [begin, end) to init as one batch and fills in its result for each property.
+// Returns false if init didn't reply with a result for each property, such as an init that
+// doesn't support batches, which replies PROP_ERROR_INVALID_CMD once.
+static bool SetPropertyBatch(PropertyList::const_iterator begin, PropertyList::const_iterator end,
+                             std::vector<uint32_t>* results) {
+  unique_fd fd(socket(AF_LOCAL, SOCK_STREAM | SOCK_CLOEXEC, 0));
+  if (fd == -1) return false;
+
+  sockaddr_un addr = {};
+  addr.sun_family = AF_LOCAL;
+  strlcpy(addr.sun_path, "/dev/socket/" PROP_SERVICE_NAME, sizeof(addr.sun_path));
+  if (TEMP_FAILURE_RETRY(connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr))) == -1) {
+    return false;
+  }
+
+  std::string msg;
+  AppendUint32(&msg, kPropMsgSetPropBatch);
+  AppendUint32(&msg, end - begin);
+  for (auto it = begin; it != end; ++it) {
+    AppendUint32(&msg, it->first.size());
+    msg += it->first;
+    AppendUint32(&msg, it->second.size());
+    msg += it->second;
+  }
+  if (!WriteFully(fd, msg.data(), msg.size())) return false;
+
+  results->resize(end - begin);
+  return ReadFully(fd, results->data(), results->size() * sizeof(uint32_t));
+}
+#endif
+
+bool SetProperties(const PropertyList& properties) {
+  bool success = true;
+#if defined(__BIONIC__)
+  std::vector<uint32_t> results;
+  for (auto begin = properties.begin(); begin != properties.end();) {
+    auto end = begin + std::min<size_t>(properties.end() - begin, kMaxPropertyBatchSize);
+    if (SetPropertyBatch(begin, end, &results)) {
+      success &= std::all_of(results.begin(), results.end(),
+                             [](uint32_t result) { return result == PROP_SUCCESS; });
+    } else {
+      for (auto it = begin; it != end; ++it) {
+        success &= SetProperty(it->first, it->second);
+      }
+    }
+    begin = end;
+  }
+#else
+  for (const auto& [key, value] : properties) {
+    success &= SetProperty(key, value);
+  }
+#endif
+  return success;
+}
+
 #if defined(__BIONIC__)
 
 struct WaitForPropertyData {
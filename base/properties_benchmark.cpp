@@ -0,0 +1,62 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "android-base/properties.h"
+
+#include <string>
+
+#include <benchmark/benchmark.h>
+
+// A property that exists on every device.
+static constexpr char kProperty[] = "ro.build.fingerprint";
+
+static void BM_GetProperty(benchmark::State& state) {
+  for (auto _ : state) {
+    std::string value = android::base::GetProperty(kProperty, "");
+    benchmark::DoNotOptimize(value);
+  }
+}
+BENCHMARK(BM_GetProperty);
+
+static void BM_CachedProperty(benchmark::State& state) {
+  android::base::CachedProperty cached(kProperty);
+  for (auto _ : state) {
+    const std::string& value = cached.Get();
+    benchmark::DoNotOptimize(value);
+  }
+}
+BENCHMARK(BM_CachedProperty);
+
+// The cost of waiting for a property to show up: a missing one is looked up on every
+// GetProperty() call, but only after new properties are added for CachedProperty.
+static void BM_GetProperty_missing(benchmark::State& state) {
+  for (auto _ : state) {
+    std::string value = android::base::GetProperty("debug.libbase.does_not_exist", "");
+    benchmark::DoNotOptimize(value);
+  }
+}
+BENCHMARK(BM_GetProperty_missing);
+
+static void BM_CachedProperty_missing(benchmark::State& state) {
+  android::base::CachedProperty cached("debug.libbase.does_not_exist");
+  for (auto _ : state) {
+    const std::string& value = cached.Get();
+    benchmark::DoNotOptimize(value);
+  }
+}
+BENCHMARK(BM_CachedProperty_missing);
+
+// BENCHMARK_MAIN() is in logging_benchmark.cpp.
@@ -17,6 +17,7 @@
 #include "android-base/properties.h"
 
 #include <gtest/gtest.h>
+#include <unistd.h>
 
 #include <atomic>
 #include <chrono>
@@ -53,6 +54,18 @@ TEST(properties, empty) {
   ASSERT_EQ("default", s);
 }
 
+TEST(properties, SetProperties) {
+  ASSERT_TRUE(android::base::SetProperties({
+      {"debug.libbase.property_test", "first"},
+      {"debug.libbase.property_test_2", "second"},
+      {"debug.libbase.property_test", "last"},
+  }));
+  ASSERT_EQ("last", android::base::GetProperty("debug.libbase.property_test", ""));
+  ASSERT_EQ("second", android::base::GetProperty("debug.libbase.property_test_2", ""));
+
+  ASSERT_TRUE(android::base::SetProperties({}));
+}
+
 static void CheckGetBoolProperty(bool expected, const std::string& value, bool default_value) {
   android::base::SetProperty("debug.libbase.property_test", value.c_str());
   ASSERT_EQ(expected, android::base::GetBoolProperty("debug.libbase.property_test", default_value));
@@ -230,3 +243,33 @@ TEST(properties, WaitForPropertyCreation_timeout) {
   GTEST_LOG_(INFO) << "This test does nothing on the host.\n";
 #endif
 }
+
+TEST(properties, CachedProperty) {
+  android::base::SetProperty("debug.libbase.CachedProperty_test", "");
+  android::base::CachedProperty cached("debug.libbase.CachedProperty_test");
+  bool changed;
+  ASSERT_EQ("", cached.Get());
+
+  android::base::SetProperty("debug.libbase.CachedProperty_test", "foo");
+  ASSERT_EQ("foo", cached.Get(&changed));
+  ASSERT_TRUE(changed);
+  ASSERT_EQ("foo", cached.Get(&changed));
+  ASSERT_FALSE(changed);
+
+  android::base::SetProperty("debug.libbase.CachedProperty_test", "bar");
+  ASSERT_EQ("bar", cached.Get(&changed));
+  ASSERT_TRUE(changed);
+}
+
+TEST(properties, CachedProperty_created_later) {
+#if defined(__BIONIC__)
+  std::string key = "debug.libbase.CachedProperty_test_" + std::to_string(getpid());
+  android::base::CachedProperty cached(key);
+  ASSERT_EQ("", cached.Get());
+
+  android::base::SetProperty(key, "created");
+  ASSERT_EQ("created", cached.Get());
+#else
+  GTEST_LOG_(INFO) << "This test does nothing on the host.\n";
+#endif
+}
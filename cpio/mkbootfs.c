@@ -11,6 +11,10 @@
 
 #include <stdarg.h>
 #include <fcntl.h>
+#include <pthread.h>
+#include <sys/mman.h>
+
+#include <zlib.h>
 
 #include <private/android_filesystem_config.h>
 
@@ -21,6 +25,10 @@
 ** - dotfiles are ignored
 ** - directories named 'root' are ignored
 ** - device notes, pipes, etc are not supported (error)
+** - with -z the archive is gzipped in parallel: the stream is cut into
+**   fixed-size blocks, each deflated by a worker thread with the tail of the
+**   previous block as its dictionary and joined with sync flushes, so the
+**   output is one gzip member that doesn't depend on the number of threads
 */
 
 void die(const char *why, ...)
@@ -56,6 +64,221 @@ static char *target_out_path = NULL;
 static int verbose = 0;
 static int total_size = 0;
 
+static int compress_output = 0;
+static int compress_threads = 0;
+
+/* Uncompressed bytes per compression job, and the deflate window. */
+#define GZ_BLOCK_SIZE   (1024 * 1024)
+#define GZ_DICT_SIZE    32768
+
+struct gz_block {
+    unsigned char *in;
+    size_t in_len;
+    unsigned char *out;
+    size_t out_len;
+    unsigned char dict[GZ_DICT_SIZE];
+    size_t dict_len;
+    uLong crc;
+    int last;
+    int done;
+};
+
+static struct {
+    pthread_mutex_t lock;
+    pthread_cond_t work;
+    pthread_cond_t done;
+    pthread_t *threads;
+    int nthreads;
+    struct gz_block *slots;
+    unsigned nslots;
+    /* Sequence numbers: blocks [next_write, next_submit) are in flight, and
+     * those from next_compress on wait for a worker. */
+    unsigned long next_submit, next_compress, next_write;
+    /* The block being filled, if any. */
+    struct gz_block *current;
+    unsigned char tail[GZ_DICT_SIZE];
+    size_t tail_len;
+    uLong crc;
+    uLong total_in;
+    int exiting;
+} gz = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .work = PTHREAD_COND_INITIALIZER,
+    .done = PTHREAD_COND_INITIALIZER,
+};
+
+static void gz_deflate(struct gz_block *b)
+{
+    z_stream z;
+    memset(&z, 0, sizeof(z));
+    if (deflateInit2(&z, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+        die("deflateInit2 failed");
+    if (b->dict_len && deflateSetDictionary(&z, b->dict, b->dict_len) != Z_OK)
+        die("deflateSetDictionary failed");
+
+    /* Room for the sync flush marker or the final block on top of the bound. */
+    size_t cap = deflateBound(&z, b->in_len) + 16;
+    b->out = malloc(cap);
+    if (b->out == NULL) die("cannot allocate %zu bytes", cap);
+
+    z.next_in = b->in;
+    z.avail_in = b->in_len;
+    z.next_out = b->out;
+    z.avail_out = cap;
+    int ret = deflate(&z, b->last ? Z_FINISH : Z_SYNC_FLUSH);
+    if (ret == Z_STREAM_ERROR || z.avail_in != 0 || (b->last && ret != Z_STREAM_END))
+        die("deflate failed (%d)", ret);
+    b->out_len = cap - z.avail_out;
+    deflateEnd(&z);
+
+    b->crc = crc32(0, b->in, b->in_len);
+}
+
+static void *gz_worker(void *arg)
+{
+    (void) arg;
+    pthread_mutex_lock(&gz.lock);
+    for (;;) {
+        while (!gz.exiting && gz.next_compress == gz.next_submit)
+            pthread_cond_wait(&gz.work, &gz.lock);
+        if (gz.next_compress == gz.next_submit)
+            break;
+        struct gz_block *b = &gz.slots[gz.next_compress++ % gz.nslots];
+        pthread_mutex_unlock(&gz.lock);
+
+        gz_deflate(b);
+
+        pthread_mutex_lock(&gz.lock);
+        b->done = 1;
+        pthread_cond_broadcast(&gz.done);
+    }
+    pthread_mutex_unlock(&gz.lock);
+    return NULL;
+}
+
+static void gz_init(void)
+{
+    static const unsigned char header[10] = {
+        0x1f, 0x8b, Z_DEFLATED, 0, 0, 0, 0, 0 /* no mtime */, 0, 3 /* unix */
+    };
+    fwrite(header, sizeof(header), 1, stdout);
+    gz.crc = crc32(0, NULL, 0);
+
+    gz.nthreads = compress_threads > 0 ? compress_threads : sysconf(_SC_NPROCESSORS_ONLN);
+    if (gz.nthreads < 1) gz.nthreads = 1;
+    /* Enough blocks for every worker to have one queued behind the one it is on. */
+    gz.nslots = gz.nthreads * 2;
+    gz.slots = calloc(gz.nslots, sizeof(struct gz_block));
+    gz.threads = calloc(gz.nthreads, sizeof(pthread_t));
+    if (gz.slots == NULL || gz.threads == NULL) die("cannot allocate compression state");
+    for (unsigned i = 0; i < gz.nslots; i++) {
+        gz.slots[i].in = malloc(GZ_BLOCK_SIZE);
+        if (gz.slots[i].in == NULL) die("cannot allocate %d bytes", GZ_BLOCK_SIZE);
+    }
+    for (int i = 0; i < gz.nthreads; i++) {
+        if (pthread_create(&gz.threads[i], NULL, gz_worker, NULL) != 0)
+            die("cannot create compression thread");
+    }
+}
+
+/* Writes out the oldest block in flight, waiting for it if need be. */
+static void gz_write_oldest(void)
+{
+    struct gz_block *b = &gz.slots[gz.next_write % gz.nslots];
+    pthread_mutex_lock(&gz.lock);
+    while (!b->done)
+        pthread_cond_wait(&gz.done, &gz.lock);
+    pthread_mutex_unlock(&gz.lock);
+
+    fwrite(b->out, b->out_len, 1, stdout);
+    free(b->out);
+    b->out = NULL;
+    gz.crc = crc32_combine(gz.crc, b->crc, b->in_len);
+    gz.total_in += b->in_len;
+    gz.next_write++;
+}
+
+static void gz_submit(int last)
+{
+    struct gz_block *b = gz.current;
+    memcpy(b->dict, gz.tail, gz.tail_len);
+    b->dict_len = gz.tail_len;
+    gz.tail_len = b->in_len < GZ_DICT_SIZE ? b->in_len : GZ_DICT_SIZE;
+    memcpy(gz.tail, b->in + b->in_len - gz.tail_len, gz.tail_len);
+    b->last = last;
+    b->done = 0;
+    gz.current = NULL;
+
+    pthread_mutex_lock(&gz.lock);
+    gz.next_submit++;
+    pthread_cond_signal(&gz.work);
+    pthread_mutex_unlock(&gz.lock);
+}
+
+static void gz_write(const unsigned char *data, size_t len)
+{
+    while (len) {
+        if (gz.current == NULL) {
+            while (gz.next_submit - gz.next_write >= gz.nslots)
+                gz_write_oldest();
+            gz.current = &gz.slots[gz.next_submit % gz.nslots];
+            gz.current->in_len = 0;
+        }
+        size_t n = GZ_BLOCK_SIZE - gz.current->in_len;
+        if (n > len) n = len;
+        memcpy(gz.current->in + gz.current->in_len, data, n);
+        gz.current->in_len += n;
+        data += n;
+        len -= n;
+        if (gz.current->in_len == GZ_BLOCK_SIZE)
+            gz_submit(0);
+    }
+}
+
+static void gz_finish(void)
+{
+    /* The last block ends the deflate stream, even if it is empty. */
+    if (gz.current == NULL) {
+        while (gz.next_submit - gz.next_write >= gz.nslots)
+            gz_write_oldest();
+        gz.current = &gz.slots[gz.next_submit % gz.nslots];
+        gz.current->in_len = 0;
+    }
+    gz_submit(1);
+    while (gz.next_write != gz.next_submit)
+        gz_write_oldest();
+
+    pthread_mutex_lock(&gz.lock);
+    gz.exiting = 1;
+    pthread_cond_broadcast(&gz.work);
+    pthread_mutex_unlock(&gz.lock);
+    for (int i = 0; i < gz.nthreads; i++)
+        pthread_join(gz.threads[i], NULL);
+
+    unsigned char trailer[8];
+    for (int i = 0; i < 4; i++) {
+        trailer[i] = (gz.crc >> (8 * i)) & 0xff;
+        trailer[4 + i] = (gz.total_in >> (8 * i)) & 0xff;
+    }
+    fwrite(trailer, sizeof(trailer), 1, stdout);
+}
+
+static void out_write(const void *data, size_t len)
+{
+    if (compress_output)
+        gz_write(data, len);
+    else
+        fwrite(data, len, 1, stdout);
+    total_size += len;
+}
+
+static void out_pad(int alignment)
+{
+    static const char zeroes[256];
+    int n = -total_size & (alignment - 1);
+    out_write(zeroes, n);
+}
+
 static void fix_stat(const char *path, struct stat *s)
 {
     uint64_t capabilities;
@@ -94,17 +317,16 @@ static void _eject(struct stat *s, char *out, int olen, char *data, unsigned dat
     // approximate range that was being used already, and avoiding small
     // values which may be special.
     static unsigned next_inode = 300000;
+    char header[6 + 8*13 + 1];
 
-    while(total_size & 3) {
-        total_size++;
-        putchar(0);
-    }
+    out_pad(4);
 
     fix_stat(out, s);
 //    fprintf(stderr, "_eject %s: mode=0%o\n", out, s->st_mode);
 
-    printf("%06x%08x%08x%08x%08x%08x%08x"
-           "%08x%08x%08x%08x%08x%08x%08x%s%c",
+    snprintf(header, sizeof(header),
+           "%06x%08x%08x%08x%08x%08x%08x"
+           "%08x%08x%08x%08x%08x%08x%08x",
            0x070701,
            next_inode++,  //  s.st_ino,
            s->st_mode,
@@ -118,23 +340,18 @@ static void _eject(struct stat *s, char *out, int olen, char *data, unsigned dat
            0, // devmajor
            0, // devminor,
            olen + 1,
-           0,
-           out,
            0
            );
 
-    total_size += 6 + 8*13 + olen + 1;
-
     if(strlen(out) != (unsigned int)olen) die("ACK!");
 
-    while(total_size & 3) {
-        total_size++;
-        putchar(0);
-    }
+    out_write(header, 6 + 8*13);
+    out_write(out, olen + 1);
+
+    out_pad(4);
 
     if(datasize) {
-        fwrite(data, datasize, 1, stdout);
-        total_size += datasize;
+        out_write(data, datasize);
     }
 }
 
@@ -144,10 +361,7 @@ static void _eject_trailer()
     memset(&s, 0, sizeof(s));
     _eject(&s, TRAILER, 10, 0, 0);
 
-    while(total_size & 0xff) {
-        total_size++;
-        putchar(0);
-    }
+    out_pad(256);
 }
 
 static void _archive(char *in, char *out, int ilen, int olen);
@@ -247,16 +461,18 @@ static void _archive(char *in, char *out, int ilen, int olen)
         fd = open(in, O_RDONLY);
         if(fd < 0) die("cannot open '%s' for read", in);
 
-        tmp = (char*) malloc(s.st_size);
-        if(tmp == 0) die("cannot allocate %d bytes", s.st_size);
-
-        if(read(fd, tmp, s.st_size) != s.st_size) {
-            die("cannot read %d bytes", s.st_size);
+        /* Map rather than read, so big files go straight from the page cache
+         * to the output buffer or the compressor. */
+        tmp = NULL;
+        if(s.st_size > 0) {
+            tmp = mmap(NULL, s.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if(tmp == MAP_FAILED) die("cannot map %d bytes of '%s'", (int) s.st_size, in);
+            madvise(tmp, s.st_size, MADV_SEQUENTIAL);
         }
 
         _eject(&s, out, olen, tmp, s.st_size);
 
-        free(tmp);
+        if(tmp != NULL) munmap(tmp, s.st_size);
         close(fd);
     } else if(S_ISDIR(s.st_mode)) {
         _eject(&s, out, olen, 0, 0);
@@ -346,8 +562,24 @@ int main(int argc, char *argv[])
         argv += 2;
     }
 
+    if (argc > 0 && strcmp(argv[0], "-z") == 0) {
+        compress_output = 1;
+        argc--;
+        argv++;
+    }
+
+    if (argc > 1 && strcmp(argv[0], "-j") == 0) {
+        compress_threads = atoi(argv[1]);
+        argc -= 2;
+        argv += 2;
+    }
+
     if(argc == 0) die("no directories to process?!");
 
+    /* The archive is written in many small pieces. */
+    setvbuf(stdout, NULL, _IOFBF, 1024 * 1024);
+    if (compress_output) gz_init();
+
     while(argc-- > 0){
         char *x = strchr(*argv, '=');
         if(x != 0) {
@@ -363,5 +595,7 @@ int main(int argc, char *argv[])
 
     _eject_trailer();
 
+    if (compress_output) gz_finish();
+
     return 0;
 }
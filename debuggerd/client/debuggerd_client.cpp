@@ -25,6 +25,8 @@
 #include <unistd.h>
 
 #include <chrono>
+#include <string>
+#include <vector>
 
 #include <android-base/file.h>
 #include <android-base/logging.h>
@@ -63,30 +65,30 @@ static void populate_timeval(struct timeval* tv, const Duration& duration) {
   tv->tv_usec = static_cast<long>(microseconds.count());
 }
 
-bool debuggerd_trigger_dump(pid_t tid, DebuggerdDumpType dump_type, unsigned int timeout_ms,
-                            unique_fd output_fd) {
-  pid_t pid = tid;
-  if (dump_type == kDebuggerdJavaBacktrace) {
-    // Java dumps always get sent to the tgid, so we need to resolve our tid to a tgid.
-    android::procinfo::ProcessInfo procinfo;
-    std::string error;
-    if (!android::procinfo::GetProcessInfo(tid, &procinfo, &error)) {
-      LOG(ERROR) << "libdebugged_client: failed to get process info: " << error;
-      return false;
+// What is left of a dump's timeout, a timeout of 0 never expires.
+class DumpTimeout {
+ public:
+  explicit DumpTimeout(unsigned int timeout_ms)
+      : timeout_ms_(timeout_ms),
+        end_(std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms)) {}
+
+  // Milliseconds left for poll(): -1 for no timeout, 0 once expired.
+  int remaining_ms() const {
+    if (timeout_ms_ == 0) {
+      return -1;
     }
-    pid = procinfo.pid;
+    auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(
+        end_ - std::chrono::steady_clock::now());
+    return std::max<int>(remaining.count(), 0);
   }
 
-  LOG(INFO) << "libdebuggerd_client: started dumping process " << pid;
-  unique_fd sockfd;
-  const auto end = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
-  auto time_left = [&end]() { return end - std::chrono::steady_clock::now(); };
-  auto set_timeout = [timeout_ms, &time_left](int sockfd) {
-    if (timeout_ms <= 0) {
+  // Applies what is left to the socket. Returns sockfd, or -1 once expired.
+  int set(int sockfd) const {
+    if (timeout_ms_ == 0) {
       return sockfd;
     }
 
-    auto remaining = time_left();
+    auto remaining = end_ - std::chrono::steady_clock::now();
     if (remaining < decltype(remaining)::zero()) {
       LOG(ERROR) << "libdebuggerd_client: timeout expired";
       return -1;
@@ -105,29 +107,82 @@ bool debuggerd_trigger_dump(pid_t tid, DebuggerdDumpType dump_type, unsigned int
     }
 
     return sockfd;
-  };
+  }
+
+ private:
+  unsigned int timeout_ms_;
+  std::chrono::steady_clock::time_point end_;
+};
+
+// One process being dumped, from registering the intercept to the end of
+// its output.
+struct DumpSession {
+  pid_t tid;
+  pid_t pid;
+  unique_fd sockfd;
+  unique_fd pipe_read;
+  // Set once tombstoned reports that crash_dump picked up the intercept.
+  bool started = false;
+  bool done = false;
+  // Output held back until the dump completes, when several processes
+  // share the output fd.
+  std::string output;
+};
+
+static bool receive_response(DumpSession* session, const DumpTimeout& timeout, int flags,
+                             const char* what, InterceptResponse* response) {
+  ssize_t rc = TEMP_FAILURE_RETRY(
+      recv(timeout.set(session->sockfd.get()), response, sizeof(*response), MSG_TRUNC | flags));
+  if (rc == 0) {
+    LOG(ERROR) << "libdebuggerd_client: failed to read " << what << " response from tombstoned: "
+               << "timeout reached?";
+    return false;
+  } else if (rc == -1) {
+    PLOG(ERROR) << "libdebuggerd_client: failed to read " << what << " response from tombstoned";
+    return false;
+  } else if (rc != sizeof(*response)) {
+    LOG(ERROR) << "libdebuggerd_client: received packet of unexpected length from tombstoned while "
+                  "reading "
+               << what << " response: expected " << sizeof(*response) << ", received " << rc;
+    return false;
+  }
+  return true;
+}
 
-  sockfd.reset(socket(AF_LOCAL, SOCK_SEQPACKET, 0));
-  if (sockfd == -1) {
+// Registers an intercept for the process and signals it to start the dump.
+static bool start_dump(DumpSession* session, DebuggerdDumpType dump_type,
+                       const DumpTimeout& timeout) {
+  session->pid = session->tid;
+  if (dump_type == kDebuggerdJavaBacktrace) {
+    // Java dumps always get sent to the tgid, so we need to resolve our tid to a tgid.
+    android::procinfo::ProcessInfo procinfo;
+    std::string error;
+    if (!android::procinfo::GetProcessInfo(session->tid, &procinfo, &error)) {
+      LOG(ERROR) << "libdebugged_client: failed to get process info: " << error;
+      return false;
+    }
+    session->pid = procinfo.pid;
+  }
+
+  LOG(INFO) << "libdebuggerd_client: started dumping process " << session->pid;
+  session->sockfd.reset(socket(AF_LOCAL, SOCK_SEQPACKET, 0));
+  if (session->sockfd == -1) {
     PLOG(ERROR) << "libdebugger_client: failed to create socket";
     return false;
   }
 
-  if (socket_local_client_connect(set_timeout(sockfd.get()), kTombstonedInterceptSocketName,
+  if (socket_local_client_connect(timeout.set(session->sockfd.get()),
+                                  kTombstonedInterceptSocketName,
                                   ANDROID_SOCKET_NAMESPACE_RESERVED, SOCK_SEQPACKET) == -1) {
     PLOG(ERROR) << "libdebuggerd_client: failed to connect to tombstoned";
     return false;
   }
 
-  InterceptRequest req = {.pid = pid, .dump_type = dump_type};
-  if (!set_timeout(sockfd)) {
-    PLOG(ERROR) << "libdebugger_client: failed to set timeout";
-    return false;
-  }
+  InterceptRequest req = {.pid = session->pid, .dump_type = dump_type};
 
   // Create an intermediate pipe to pass to the other end.
-  unique_fd pipe_read, pipe_write;
-  if (!Pipe(&pipe_read, &pipe_write)) {
+  unique_fd pipe_write;
+  if (!Pipe(&session->pipe_read, &pipe_write)) {
     PLOG(ERROR) << "libdebuggerd_client: failed to create pipe";
     return false;
   }
@@ -142,30 +197,19 @@ bool debuggerd_trigger_dump(pid_t tid, DebuggerdDumpType dump_type, unsigned int
     }
   }
 
-  if (fcntl(pipe_read.get(), F_SETPIPE_SZ, pipe_buffer_size) != pipe_buffer_size) {
+  if (fcntl(session->pipe_read.get(), F_SETPIPE_SZ, pipe_buffer_size) != pipe_buffer_size) {
     PLOG(ERROR) << "failed to set pipe buffer size";
   }
 
-  if (send_fd(set_timeout(sockfd), &req, sizeof(req), std::move(pipe_write)) != sizeof(req)) {
+  if (send_fd(timeout.set(session->sockfd), &req, sizeof(req), std::move(pipe_write)) !=
+      sizeof(req)) {
     PLOG(ERROR) << "libdebuggerd_client: failed to send output fd to tombstoned";
     return false;
   }
 
   // Check to make sure we've successfully registered.
   InterceptResponse response;
-  ssize_t rc =
-      TEMP_FAILURE_RETRY(recv(set_timeout(sockfd.get()), &response, sizeof(response), MSG_TRUNC));
-  if (rc == 0) {
-    LOG(ERROR) << "libdebuggerd_client: failed to read initial response from tombstoned: "
-               << "timeout reached?";
-    return false;
-  } else if (rc == -1) {
-    PLOG(ERROR) << "libdebuggerd_client: failed to read initial response from tombstoned";
-    return false;
-  } else if (rc != sizeof(response)) {
-    LOG(ERROR) << "libdebuggerd_client: received packet of unexpected length from tombstoned while "
-                  "reading initial response: expected "
-               << sizeof(response) << ", received " << rc;
+  if (!receive_response(session, timeout, 0, "initial", &response)) {
     return false;
   }
 
@@ -175,22 +219,12 @@ bool debuggerd_trigger_dump(pid_t tid, DebuggerdDumpType dump_type, unsigned int
     return false;
   }
 
-  if (!send_signal(tid, dump_type)) {
-    return false;
-  }
+  return send_signal(session->tid, dump_type);
+}
 
-  rc = TEMP_FAILURE_RETRY(recv(set_timeout(sockfd.get()), &response, sizeof(response), MSG_TRUNC));
-  if (rc == 0) {
-    LOG(ERROR) << "libdebuggerd_client: failed to read status response from tombstoned: "
-                  "timeout reached?";
-    return false;
-  } else if (rc == -1) {
-    PLOG(ERROR) << "libdebuggerd_client: failed to read status response from tombstoned";
-    return false;
-  } else if (rc != sizeof(response)) {
-    LOG(ERROR) << "libdebuggerd_client: received packet of unexpected length from tombstoned while "
-                  "reading confirmation response: expected "
-               << sizeof(response) << ", received " << rc;
+static bool check_started(DumpSession* session, const DumpTimeout& timeout, int flags) {
+  InterceptResponse response;
+  if (!receive_response(session, timeout, flags, "status", &response)) {
     return false;
   }
 
@@ -199,53 +233,113 @@ bool debuggerd_trigger_dump(pid_t tid, DebuggerdDumpType dump_type, unsigned int
     LOG(ERROR) << "libdebuggerd_client: tombstoned reported failure: " << response.error_message;
     return false;
   }
+  session->started = true;
+  return true;
+}
 
-  // Forward output from the pipe to the output fd.
+// Forwards the output of every session to output_fd. A lone session is
+// streamed through, otherwise each dump is written out whole once it
+// completes, so that they don't interleave.
+static size_t forward_output(std::vector<DumpSession>* sessions, const DumpTimeout& timeout,
+                            int output_fd) {
+  bool stream = sessions->size() == 1;
+  size_t succeeded = 0;
+  std::vector<pollfd> pfds;
+  std::vector<DumpSession*> polled;
   while (true) {
-    auto remaining_ms = std::chrono::duration_cast<std::chrono::milliseconds>(time_left()).count();
-    if (timeout_ms <= 0) {
-      remaining_ms = -1;
-    } else if (remaining_ms < 0) {
-      LOG(ERROR) << "libdebuggerd_client: timeout expired";
-      return false;
+    pfds.clear();
+    polled.clear();
+    for (auto& session : *sessions) {
+      if (session.done) {
+        continue;
+      }
+      // Output only comes after the start, but watch both so that a slow
+      // start doesn't hold up reading the other dumps.
+      if (!session.started) {
+        pfds.push_back({.fd = session.sockfd.get(), .events = POLLIN, .revents = 0});
+        polled.push_back(&session);
+      }
+      pfds.push_back({.fd = session.pipe_read.get(), .events = POLLIN, .revents = 0});
+      polled.push_back(&session);
+    }
+    if (pfds.empty()) {
+      return succeeded;
     }
 
-    struct pollfd pfd = {
-        .fd = pipe_read.get(), .events = POLLIN, .revents = 0,
-    };
-
-    rc = poll(&pfd, 1, remaining_ms);
+    int rc = poll(pfds.data(), pfds.size(), timeout.remaining_ms());
     if (rc == -1) {
       if (errno == EINTR) {
         continue;
       } else {
         PLOG(ERROR) << "libdebuggerd_client: error while polling";
-        return false;
+        return succeeded;
       }
     } else if (rc == 0) {
       LOG(ERROR) << "libdebuggerd_client: timeout expired";
-      return false;
+      return succeeded;
     }
 
-    char buf[1024];
-    rc = TEMP_FAILURE_RETRY(read(pipe_read.get(), buf, sizeof(buf)));
-    if (rc == 0) {
-      // Done.
-      break;
-    } else if (rc == -1) {
-      PLOG(ERROR) << "libdebuggerd_client: error while reading";
-      return false;
-    }
+    for (size_t i = 0; i < pfds.size(); ++i) {
+      DumpSession* session = polled[i];
+      if (pfds[i].revents == 0 || session->done) {
+        continue;
+      }
 
-    if (!android::base::WriteFully(output_fd.get(), buf, rc)) {
-      PLOG(ERROR) << "libdebuggerd_client: error while writing";
-      return false;
+      if (pfds[i].fd == session->sockfd.get()) {
+        session->done = !check_started(session, timeout, 0);
+        continue;
+      }
+
+      char buf[1024];
+      ssize_t bytes = TEMP_FAILURE_RETRY(read(session->pipe_read.get(), buf, sizeof(buf)));
+      if (bytes == -1) {
+        PLOG(ERROR) << "libdebuggerd_client: error while reading";
+        session->done = true;
+        continue;
+      } else if (bytes > 0) {
+        if (!stream) {
+          session->output.append(buf, bytes);
+        } else if (!android::base::WriteFully(output_fd, buf, bytes)) {
+          PLOG(ERROR) << "libdebuggerd_client: error while writing";
+          return succeeded;
+        }
+        continue;
+      }
+
+      // Done. The start was reported before any output, it may just not
+      // have been read yet.
+      session->done = true;
+      if (!session->started && !check_started(session, timeout, MSG_DONTWAIT)) {
+        continue;
+      }
+      if (!android::base::WriteStringToFd(session->output, output_fd)) {
+        PLOG(ERROR) << "libdebuggerd_client: error while writing";
+        return succeeded;
+      }
+      session->output.clear();
+      ++succeeded;
+      LOG(INFO) << "libdebuggerd_client: done dumping process " << session->pid;
     }
   }
+}
 
-  LOG(INFO) << "libdebuggerd_client: done dumping process " << pid;
+bool debuggerd_trigger_dump(pid_t tid, DebuggerdDumpType dump_type, unsigned int timeout_ms,
+                            unique_fd output_fd) {
+  return debuggerd_trigger_dumps({tid}, dump_type, timeout_ms, std::move(output_fd)) == 1;
+}
 
-  return true;
+size_t debuggerd_trigger_dumps(const std::vector<pid_t>& tids, DebuggerdDumpType dump_type,
+                               unsigned int timeout_ms, unique_fd output_fd) {
+  DumpTimeout timeout(timeout_ms);
+  std::vector<DumpSession> sessions;
+  for (pid_t tid : tids) {
+    DumpSession session;
+    session.tid = tid;
+    if (start_dump(&session, dump_type, timeout)) {
+      sessions.push_back(std::move(session));
+    }
+  }
+  return forward_output(&sessions, timeout, output_fd.get());
 }
 
 int dump_backtrace_to_file(pid_t tid, DebuggerdDumpType dump_type, int fd) {
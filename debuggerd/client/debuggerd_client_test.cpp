@@ -20,6 +20,7 @@
 #include <stdio.h>
 #include <unistd.h>
 
+#include <algorithm>
 #include <chrono>
 #include <thread>
 #include <vector>
@@ -124,3 +125,53 @@ TEST(debuggerd_client, no_timeout) {
   ASSERT_TRUE(
       debuggerd_trigger_dump(forkpid, kDebuggerdNativeBacktrace, 0, std::move(output_write)));
 }
+
+TEST(debuggerd_client, multiple_processes) {
+  unique_fd pipe_read, pipe_write;
+  ASSERT_TRUE(Pipe(&pipe_read, &pipe_write));
+
+  std::vector<pid_t> pids;
+  for (int i = 0; i < 6; ++i) {
+    pid_t forkpid = fork();
+    ASSERT_NE(-1, forkpid);
+    if (forkpid == 0) {
+      pipe_write.reset();
+      char dummy;
+      TEMP_FAILURE_RETRY(read(pipe_read.get(), &dummy, sizeof(dummy)));
+      exit(0);
+    }
+    pids.push_back(forkpid);
+  }
+  pipe_read.reset();
+
+  unique_fd output_read, output_write;
+  ASSERT_TRUE(Pipe(&output_read, &output_write));
+  constexpr int PIPE_SIZE = 16 * 1024 * 1024;
+  ASSERT_EQ(PIPE_SIZE, fcntl(output_read.get(), F_SETPIPE_SZ, PIPE_SIZE));
+
+  ASSERT_EQ(pids.size(),
+            debuggerd_trigger_dumps(pids, kDebuggerdNativeBacktrace, 10000, std::move(output_write)));
+  pipe_write.reset();
+
+  std::string result;
+  ASSERT_TRUE(android::base::ReadFdToString(output_read.get(), &result));
+
+  // Every dump is there, whole: each one ends before the next one starts.
+  std::vector<std::string> lines = android::base::Split(result, "\n");
+  std::vector<pid_t> ended;
+  pid_t current = 0;
+  for (const std::string& line : lines) {
+    pid_t pid;
+    if (sscanf(line.c_str(), "----- pid %d at", &pid) == 1) {
+      ASSERT_EQ(0, current) << "\nOutput: \n" << result;
+      current = pid;
+    } else if (sscanf(line.c_str(), "----- end %d -----", &pid) == 1) {
+      ASSERT_EQ(current, pid) << "\nOutput: \n" << result;
+      ended.push_back(pid);
+      current = 0;
+    }
+  }
+  std::sort(ended.begin(), ended.end());
+  std::sort(pids.begin(), pids.end());
+  EXPECT_EQ(pids, ended) << "\nOutput: \n" << result;
+}
@@ -17,6 +17,7 @@
 #include <arpa/inet.h>
 #include <dirent.h>
 #include <fcntl.h>
+#include <inttypes.h>
 #include <stdlib.h>
 #include <sys/prctl.h>
 #include <sys/ptrace.h>
@@ -26,10 +27,13 @@
 #include <syscall.h>
 #include <unistd.h>
 
+#include <chrono>
+#include <functional>
 #include <limits>
 #include <map>
 #include <memory>
 #include <set>
+#include <string>
 #include <vector>
 
 #include <android-base/file.h>
@@ -185,11 +189,32 @@ static bool activity_manager_notify(pid_t pid, int signal, const std::string& am
   return true;
 }
 
+// Identifies a crash by its signal and the innermost frames of the crashing
+// thread, which are the same wherever the same bug crashes, so that tombstoned
+// can tell a crash storm apart from unrelated crashes. Returns 0 without a
+// backtrace.
+static uint64_t crash_signature(const ThreadInfo& thread) {
+  // Enough frames to get out of abort() and the logging code into the caller.
+  static constexpr size_t kSignatureFrames = 6;
+
+  if (!thread.unwind_succeeded || thread.frames.empty() || thread.siginfo == nullptr) {
+    return 0;
+  }
+  std::string key = StringPrintf("%d %d", thread.siginfo->si_signo, thread.siginfo->si_code);
+  for (size_t i = 0; i < thread.frames.size() && i < kSignatureFrames; ++i) {
+    const backtrace_frame_data_t& frame = thread.frames[i];
+    key += StringPrintf(" %s+%" PRIx64, frame.map.name.c_str(), frame.rel_pc);
+  }
+  uint64_t signature = std::hash<std::string>()(key);
+  return signature != 0 ? signature : 1;
+}
+
 // Globals used by the abort handler.
 static pid_t g_target_thread = -1;
 static bool g_tombstoned_connected = false;
 static unique_fd g_tombstoned_socket;
 static unique_fd g_output_fd;
+static unique_fd g_proto_output_fd;
 
 static void DefuseSignalHandlers() {
   // Don't try to dump ourselves.
@@ -415,6 +440,15 @@ int main(int argc, char** argv) {
   //       unwind, do not make this too small. b/62828735
   alarm(30);
 
+  // A tombstone budget sets a softer deadline: the crashing thread is dumped
+  // first, and whatever is still left when the budget runs out is cut short.
+  auto tombstone_budget = std::chrono::milliseconds(
+      android::base::GetUintProperty<uint64_t>("debug.debuggerd.tombstone_budget_ms", 0));
+  auto tombstone_deadline = std::chrono::steady_clock::time_point::max();
+  if (tombstone_budget.count() != 0) {
+    tombstone_deadline = std::chrono::steady_clock::now() + tombstone_budget;
+  }
+
   // Get the process name (aka cmdline).
   std::string process_name = get_process_name(g_target_thread);
 
@@ -523,26 +557,6 @@ int main(int argc, char** argv) {
   // Drop our capabilities now that we've fetched all of the information we need.
   drop_capabilities();
 
-  {
-    ATRACE_NAME("tombstoned_connect");
-    LOG(INFO) << "obtaining output fd from tombstoned, type: " << dump_type;
-    g_tombstoned_connected =
-        tombstoned_connect(g_target_thread, &g_tombstoned_socket, &g_output_fd, dump_type);
-  }
-
-  if (g_tombstoned_connected) {
-    if (TEMP_FAILURE_RETRY(dup2(g_output_fd.get(), STDOUT_FILENO)) == -1) {
-      PLOG(ERROR) << "failed to dup2 output fd (" << g_output_fd.get() << ") to STDOUT_FILENO";
-    }
-  } else {
-    unique_fd devnull(TEMP_FAILURE_RETRY(open("/dev/null", O_RDWR)));
-    TEMP_FAILURE_RETRY(dup2(devnull.get(), STDOUT_FILENO));
-    g_output_fd = std::move(devnull);
-  }
-
-  LOG(INFO) << "performing dump of process " << target_process
-            << " (target tid = " << g_target_thread << ")";
-
   int signo = siginfo.si_signo;
   bool fatal_signal = signo != DEBUGGER_SIGNAL;
   bool backtrace = false;
@@ -561,6 +575,10 @@ int main(int argc, char** argv) {
     }
   }
 
+  // Libraries like libart and libc are in most processes, reuse what an
+  // earlier dump decompressed of them if a cache has been set up.
+  Backtrace::SetGlobalElfDiskCache(android::base::GetProperty("debug.debuggerd.unwind_cache", ""));
+
   // TODO: Use seccomp to lock ourselves down.
   std::unique_ptr<BacktraceMap> map(BacktraceMap::Create(vm_pid, false));
   if (!map) {
@@ -572,6 +590,55 @@ int main(int argc, char** argv) {
     LOG(FATAL) << "failed to get unwindstack::Memory handle";
   }
 
+  // The crashing thread is unwound first: nothing waits on the others, and its
+  // backtrace is what tombstoned tells repeated crashes apart by.
+  uint64_t signature = 0;
+  auto target = thread_info.find(g_target_thread);
+  if (target != thread_info.end()) {
+    ATRACE_NAME("unwind target thread");
+    target->second.unwind_succeeded =
+        unwind_thread(map.get(), target->second, &target->second.frames);
+    target->second.unwound = true;
+    if (fatal_signal) {
+      signature = crash_signature(target->second);
+    }
+  }
+
+  bool dump_declined = false;
+  {
+    ATRACE_NAME("tombstoned_connect");
+    LOG(INFO) << "obtaining output fd from tombstoned, type: " << dump_type;
+    g_tombstoned_connected =
+        tombstoned_connect(g_target_thread, &g_tombstoned_socket, &g_output_fd,
+                           &g_proto_output_fd, dump_type, signature, &dump_declined);
+  }
+
+  if (dump_declined) {
+    // tombstoned has enough tombstones of this crash already, or too many
+    // queued: just log the crashing thread and let the process go.
+    LOG(INFO) << "tombstoned declined the dump, only logging the crashing thread";
+    tombstone_deadline = std::chrono::steady_clock::now();
+  }
+
+  if (g_tombstoned_connected) {
+    if (TEMP_FAILURE_RETRY(dup2(g_output_fd.get(), STDOUT_FILENO)) == -1) {
+      PLOG(ERROR) << "failed to dup2 output fd (" << g_output_fd.get() << ") to STDOUT_FILENO";
+    }
+  } else {
+    unique_fd devnull(TEMP_FAILURE_RETRY(open("/dev/null", O_RDWR)));
+    TEMP_FAILURE_RETRY(dup2(devnull.get(), STDOUT_FILENO));
+    g_output_fd = std::move(devnull);
+  }
+
+  LOG(INFO) << "performing dump of process " << target_process
+            << " (target tid = " << g_target_thread << ")";
+
+  // With a budget, the others are unwound as they're dumped instead.
+  if (backtrace || (tombstone_budget.count() == 0 && !dump_declined)) {
+    ATRACE_NAME("unwind");
+    unwind_threads(map.get(), &thread_info);
+  }
+
   std::string amfd_data;
   if (backtrace) {
     ATRACE_NAME("dump_backtrace");
@@ -585,7 +652,14 @@ int main(int argc, char** argv) {
     {
       ATRACE_NAME("engrave_tombstone");
       engrave_tombstone(std::move(g_output_fd), map.get(), process_memory.get(), thread_info,
-                        g_target_thread, abort_msg_address, &open_files, &amfd_data);
+                        g_target_thread, abort_msg_address, &open_files, &amfd_data,
+                        tombstone_deadline);
+    }
+
+    if (g_proto_output_fd != -1) {
+      ATRACE_NAME("engrave_tombstone_proto");
+      engrave_tombstone_proto(std::move(g_proto_output_fd), map.get(), process_memory.get(),
+                              thread_info, g_target_thread, abort_msg_address);
     }
   }
 
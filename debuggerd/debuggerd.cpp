@@ -22,6 +22,7 @@
 #include <limits>
 #include <string_view>
 #include <thread>
+#include <vector>
 
 #include <android-base/file.h>
 #include <android-base/logging.h>
@@ -34,7 +35,9 @@
 using android::base::unique_fd;
 
 static void usage(int exit_code) {
-  fprintf(stderr, "usage: debuggerd [-bj] PID\n");
+  fprintf(stderr, "usage: debuggerd [-bj] PID...\n");
+  fprintf(stderr, "\n");
+  fprintf(stderr, "Several processes are dumped at once.\n");
   fprintf(stderr, "\n");
   fprintf(stderr, "-b, --backtrace    just a backtrace rather than a full tombstone\n");
   fprintf(stderr, "-j                 collect java traces\n");
@@ -59,42 +62,47 @@ static std::thread spawn_redirect_thread(unique_fd fd) {
 
 int main(int argc, char* argv[]) {
   if (argc <= 1) usage(0);
-  if (argc > 3) usage(1);
 
   DebuggerdDumpType dump_type = kDebuggerdTombstone;
 
-  if (argc == 3) {
-    std::string_view flag = argv[1];
-    if (flag == "-b" || flag == "--backtrace") {
-      dump_type = kDebuggerdNativeBacktrace;
-    } else if (flag == "-j") {
-      dump_type = kDebuggerdJavaBacktrace;
-    } else {
-      usage(1);
-    }
+  int first_pid = 1;
+  std::string_view flag = argv[1];
+  if (flag == "-b" || flag == "--backtrace") {
+    dump_type = kDebuggerdNativeBacktrace;
+    ++first_pid;
+  } else if (flag == "-j") {
+    dump_type = kDebuggerdJavaBacktrace;
+    ++first_pid;
   }
+  if (first_pid == argc) usage(1);
 
-  pid_t pid;
-  if (!android::base::ParseInt(argv[argc - 1], &pid, 1, std::numeric_limits<pid_t>::max())) {
-    usage(1);
+  std::vector<pid_t> pids;
+  for (int i = first_pid; i < argc; ++i) {
+    pid_t pid;
+    if (!android::base::ParseInt(argv[i], &pid, 1, std::numeric_limits<pid_t>::max())) {
+      usage(1);
+    }
+    pids.push_back(pid);
   }
 
   if (getuid() != 0) {
     errx(1, "root is required");
   }
 
-  // Check to see if the process exists and that we can actually send a signal to it.
-  android::procinfo::ProcessInfo proc_info;
-  if (!android::procinfo::GetProcessInfo(pid, &proc_info)) {
-    err(1, "failed to fetch info for process %d", pid);
-  }
+  for (pid_t pid : pids) {
+    // Check to see if the process exists and that we can actually send a signal to it.
+    android::procinfo::ProcessInfo proc_info;
+    if (!android::procinfo::GetProcessInfo(pid, &proc_info)) {
+      err(1, "failed to fetch info for process %d", pid);
+    }
 
-  if (proc_info.state == android::procinfo::kProcessStateZombie) {
-    errx(1, "process %d is a zombie", pid);
-  }
+    if (proc_info.state == android::procinfo::kProcessStateZombie) {
+      errx(1, "process %d is a zombie", pid);
+    }
 
-  if (kill(pid, 0) != 0) {
-    err(1, "cannot send signal to process %d", pid);
+    if (kill(pid, 0) != 0) {
+      err(1, "cannot send signal to process %d", pid);
+    }
   }
 
   unique_fd piperead, pipewrite;
@@ -103,11 +111,13 @@ int main(int argc, char* argv[]) {
   }
 
   std::thread redirect_thread = spawn_redirect_thread(std::move(piperead));
-  if (!debuggerd_trigger_dump(pid, dump_type, 0, std::move(pipewrite))) {
-    redirect_thread.join();
-    errx(1, "failed to dump process %d", pid);
-  }
-
+  size_t dumped = debuggerd_trigger_dumps(pids, dump_type, 0, std::move(pipewrite));
   redirect_thread.join();
+  if (dumped != pids.size()) {
+    if (pids.size() == 1) {
+      errx(1, "failed to dump process %d", pids[0]);
+    }
+    errx(1, "failed to dump %zu of %zu processes", pids.size() - dumped, pids.size());
+  }
   return 0;
 }
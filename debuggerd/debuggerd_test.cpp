@@ -915,6 +915,29 @@ TEST(tombstoned, no_notify) {
   }
 }
 
+TEST(tombstoned, intercept_no_proto) {
+  pid_t pid = 123'456'789;
+
+  unique_fd intercept_fd, output_fd;
+  InterceptStatus status;
+  tombstoned_intercept(pid, &intercept_fd, &output_fd, &status, kDebuggerdTombstone);
+  ASSERT_EQ(InterceptStatus::kRegistered, status);
+
+  // Only tombstones that tombstoned writes out itself get a proto.
+  {
+    unique_fd tombstoned_socket, input_fd, proto_fd;
+    ASSERT_TRUE(tombstoned_connect(pid, &tombstoned_socket, &input_fd, &proto_fd,
+                                   kDebuggerdTombstone));
+    ASSERT_EQ(-1, proto_fd.get());
+    ASSERT_TRUE(android::base::WriteFully(input_fd.get(), &pid, sizeof(pid)));
+    tombstoned_notify_completion(tombstoned_socket.get());
+  }
+
+  pid_t read_pid;
+  ASSERT_TRUE(android::base::ReadFully(output_fd.get(), &read_pid, sizeof(read_pid)));
+  ASSERT_EQ(read_pid, pid);
+}
+
 TEST(tombstoned, stress) {
   // Spawn threads to simultaneously do a bunch of failing dumps and a bunch of successful dumps.
   static constexpr int kDumpCount = 100;
@@ -1093,3 +1116,30 @@ TEST(tombstoned, interceptless_backtrace) {
   // This should be good enough, though...
   ASSERT_LT(diff, 10) << "too many new tombstones; is something crashing in the background?";
 }
+
+TEST(tombstoned, repeated_crash_declined) {
+  int max_duplicates = android::base::GetIntProperty("tombstoned.max_duplicate_tombstones", 5);
+  if (max_duplicates <= 0) {
+    return;
+  }
+
+  // A signature that no real crash, nor an earlier run of this test, has.
+  uint64_t signature = 0xdeb0'0000'0000'0000 | static_cast<uint64_t>(getpid()) << 24;
+  signature |= time(nullptr) & 0xff'ffff;
+  for (int i = 0; i <= max_duplicates; ++i) {
+    unique_fd tombstoned_socket, output_fd;
+    bool declined;
+    bool connected = tombstoned_connect(getpid(), &tombstoned_socket, &output_fd, nullptr,
+                                        kDebuggerdTombstone, signature, &declined);
+    if (i < max_duplicates) {
+      ASSERT_TRUE(connected) << "dump " << i;
+      ASSERT_FALSE(declined);
+      ASSERT_TRUE(android::base::WriteStringToFd("repeated_crash_declined\n", output_fd));
+      output_fd.reset();
+      ASSERT_TRUE(tombstoned_notify_completion(tombstoned_socket.get()));
+    } else {
+      ASSERT_FALSE(connected);
+      ASSERT_TRUE(declined);
+    }
+  }
+}
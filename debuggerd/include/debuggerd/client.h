@@ -20,6 +20,8 @@
 #include <sys/cdefs.h>
 #include <unistd.h>
 
+#include <vector>
+
 #include <android-base/unique_fd.h>
 
 #include "dump_type.h"
@@ -29,6 +31,13 @@
 bool debuggerd_trigger_dump(pid_t pid, enum DebuggerdDumpType dump_type, unsigned int timeout_ms,
                             android::base::unique_fd output_fd);
 
+// Trigger dumps of all the specified processes at once, to output_fd.
+// Each dump is written out whole as it completes, in no particular order.
+// output_fd is consumed, timeout of 0 will wait forever. Returns the number of
+// processes that were dumped successfully.
+size_t debuggerd_trigger_dumps(const std::vector<pid_t>& pids, enum DebuggerdDumpType dump_type,
+                               unsigned int timeout_ms, android::base::unique_fd output_fd);
+
 int dump_backtrace_to_file(pid_t tid, enum DebuggerdDumpType dump_type, int output_fd);
 int dump_backtrace_to_file_timeout(pid_t tid, enum DebuggerdDumpType dump_type, int timeout_secs,
                                    int output_fd);
@@ -21,6 +21,7 @@
 #include <stddef.h>
 #include <sys/types.h>
 
+#include <chrono>
 #include <map>
 #include <string>
 
@@ -46,10 +47,24 @@ void engrave_tombstone(int tombstone_fd, BacktraceMap* map, const OpenFilesList*
 void engrave_tombstone_ucontext(int tombstone_fd, uint64_t abort_msg_address, siginfo_t* siginfo,
                                 ucontext_t* ucontext);
 
+/* Sections are written out as they are ready, the crashing thread first.
+ * Past the deadline, memory dumps, maps, log tails and unwinds of the
+ * remaining threads are left out.
+ */
 void engrave_tombstone(android::base::unique_fd output_fd, BacktraceMap* map,
                        unwindstack::Memory* process_memory,
                        const std::map<pid_t, ThreadInfo>& thread_info, pid_t target_thread,
                        uint64_t abort_msg_address, OpenFilesList* open_files,
-                       std::string* amfd_data);
+                       std::string* amfd_data,
+                       std::chrono::steady_clock::time_point deadline =
+                           std::chrono::steady_clock::time_point::max());
+
+/* Writes the protobuf counterpart of the tombstone, described in
+ * proto/tombstone.proto. Lives in libdebuggerd_tombstone_proto.
+ */
+bool engrave_tombstone_proto(android::base::unique_fd output_fd, BacktraceMap* map,
+                             unwindstack::Memory* process_memory,
+                             const std::map<pid_t, ThreadInfo>& thread_info, pid_t target_thread,
+                             uint64_t abort_msg_address);
 
 #endif  // _DEBUGGERD_TOMBSTONE_H
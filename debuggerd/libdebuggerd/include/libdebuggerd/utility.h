@@ -22,11 +22,16 @@
 #include <stdbool.h>
 #include <sys/types.h>
 
+#include <chrono>
+#include <map>
 #include <string>
+#include <vector>
 
 #include <android-base/macros.h>
 #include <backtrace/Backtrace.h>
 
+#include "types.h"
+
 struct log_t {
   // Tombstone file descriptor.
   int tfd;
@@ -38,13 +43,16 @@ struct log_t {
   pid_t current_tid;
   // logd daemon crash, can block asking for logcat data, allow suppression.
   bool should_retrieve_logcat;
+  // Once past this, the expensive sections of the dump are skipped.
+  std::chrono::steady_clock::time_point deadline;
 
   log_t()
       : tfd(-1),
         amfd_data(nullptr),
         crashed_tid(-1),
         current_tid(-1),
-        should_retrieve_logcat(true) {}
+        should_retrieve_logcat(true),
+        deadline(std::chrono::steady_clock::time_point::max()) {}
 };
 
 // List of types of logs to simplify the logging decision in _LOG
@@ -70,10 +78,22 @@ class Memory;
 
 void dump_memory(log_t* log, unwindstack::Memory* backtrace, uint64_t addr, const std::string&);
 
+// Returns true, noting it in the tombstone, if the dump is past its deadline
+// and should leave out the named section.
+bool skip_past_deadline(log_t* log, logtype ltype, const char* section);
+
 void read_with_default(const char* path, char* buf, size_t len, const char* default_value);
 
 void drop_capabilities();
 
+// Unwinds the thread, from a copy of its registers, or hands back what
+// unwind_threads() found for it.
+bool unwind_thread(BacktraceMap* map, const ThreadInfo& thread,
+                   std::vector<backtrace_frame_data_t>* frames);
+// Unwinds all the threads concurrently over the shared map, for the dump to
+// then write out in order.
+void unwind_threads(BacktraceMap* map, std::map<pid_t, ThreadInfo>* threads);
+
 bool signal_has_sender(const siginfo_t*, pid_t caller_pid);
 bool signal_has_si_addr(const siginfo_t*);
 void get_signal_sender(char* buf, size_t n, const siginfo_t*);
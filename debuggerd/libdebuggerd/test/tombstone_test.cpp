@@ -17,6 +17,7 @@
 #include <stdlib.h>
 #include <time.h>
 
+#include <chrono>
 #include <memory>
 #include <string>
 
@@ -485,6 +486,21 @@ TEST_F(TombstoneTest, dump_log_file_error) {
   ASSERT_STREQ("", amfd_data_.c_str());
 }
 
+TEST_F(TombstoneTest, dump_logs_past_deadline) {
+  log_.should_retrieve_logcat = true;
+  log_.deadline = std::chrono::steady_clock::now();
+  dump_logs(&log_, 123, 10);
+
+  std::string tombstone_contents;
+  ASSERT_TRUE(lseek(log_.tfd, 0, SEEK_SET) == 0);
+  ASSERT_TRUE(android::base::ReadFdToString(log_.tfd, &tombstone_contents));
+  ASSERT_STREQ("\nlogs skipped: out of time for the tombstone\n", tombstone_contents.c_str());
+
+  // The log was never opened.
+  ASSERT_STREQ("", getFakeLogPrint().c_str());
+  ASSERT_STREQ("", amfd_data_.c_str());
+}
+
 TEST_F(TombstoneTest, dump_header_info) {
   dump_header_info(&log_);
 
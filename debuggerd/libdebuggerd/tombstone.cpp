@@ -31,6 +31,7 @@
 #include <sys/stat.h>
 #include <time.h>
 
+#include <chrono>
 #include <memory>
 #include <string>
 
@@ -450,10 +451,15 @@ static bool dump_thread(log_t* log, BacktraceMap* map, Memory* process_memory,
 
   dump_registers(log, thread_info.registers.get());
 
-  // Unwind will mutate the registers, so make a copy first.
-  std::unique_ptr<Regs> regs_copy(thread_info.registers->Clone());
+  // Once out of time, only threads that were already unwound get a backtrace.
+  if (!primary_thread && !thread_info.unwound &&
+      skip_past_deadline(log, logtype::BACKTRACE, "backtrace")) {
+    log->current_tid = log->crashed_tid;
+    return false;
+  }
+
   std::vector<backtrace_frame_data_t> frames;
-  if (!Backtrace::Unwind(regs_copy.get(), map, &frames, 0, nullptr)) {
+  if (!unwind_thread(map, thread_info, &frames)) {
     _LOG(log, logtype::THREAD, "Failed to unwind");
     return false;
   }
@@ -467,8 +473,10 @@ static bool dump_thread(log_t* log, BacktraceMap* map, Memory* process_memory,
   }
 
   if (primary_thread) {
-    dump_memory_and_code(log, map, process_memory, thread_info.registers.get());
-    if (map) {
+    if (!skip_past_deadline(log, logtype::MEMORY, "memory near registers")) {
+      dump_memory_and_code(log, map, process_memory, thread_info.registers.get());
+    }
+    if (map && !skip_past_deadline(log, logtype::MAPS, "memory map")) {
       uint64_t addr = 0;
       siginfo_t* si = thread_info.siginfo;
       if (signal_has_si_addr(si)) {
@@ -603,6 +611,9 @@ static void dump_logs(log_t* log, pid_t pid, unsigned int tail) {
     // Cowardly refuse to dump logs while we're running in-process.
     return;
   }
+  if (log->should_retrieve_logcat && skip_past_deadline(log, logtype::LOGS, "logs")) {
+    return;
+  }
 
   dump_log_file(log, pid, "system", tail);
   dump_log_file(log, pid, "main", tail);
@@ -651,7 +662,7 @@ void engrave_tombstone_ucontext(int tombstone_fd, uint64_t abort_msg_address, si
 void engrave_tombstone(unique_fd output_fd, BacktraceMap* map, Memory* process_memory,
                        const std::map<pid_t, ThreadInfo>& threads, pid_t target_thread,
                        uint64_t abort_msg_address, OpenFilesList* open_files,
-                       std::string* amfd_data) {
+                       std::string* amfd_data, std::chrono::steady_clock::time_point deadline) {
   // don't copy log messages to tombstone unless this is a dev device
   bool want_logs = android::base::GetBoolProperty("ro.debuggable", false);
 
@@ -660,6 +671,7 @@ void engrave_tombstone(unique_fd output_fd, BacktraceMap* map, Memory* process_m
   log.crashed_tid = target_thread;
   log.tfd = output_fd.get();
   log.amfd_data = amfd_data;
+  log.deadline = deadline;
 
   _LOG(&log, logtype::HEADER, "*** *** *** *** *** *** *** *** *** *** *** *** *** *** *** ***\n");
   dump_header_info(&log);
@@ -0,0 +1,197 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "DEBUG"
+
+#include "libdebuggerd/tombstone.h"
+
+#include <errno.h>
+#include <signal.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include <android-base/file.h>
+#include <android-base/properties.h>
+#include <android-base/unique_fd.h>
+#include <backtrace/Backtrace.h>
+#include <backtrace/BacktraceMap.h>
+#include <log/log.h>
+#include <unwindstack/Memory.h>
+#include <unwindstack/Regs.h>
+
+#include "libdebuggerd/elf_utils.h"
+#include "libdebuggerd/utility.h"
+
+#include "system/core/debuggerd/proto/tombstone.pb.h"
+
+using android::base::GetProperty;
+using android::base::unique_fd;
+
+using unwindstack::Memory;
+
+static void fill_abort_message(android::debuggerd::Tombstone* tombstone, Memory* process_memory,
+                               uint64_t address) {
+  size_t length;
+  if (address == 0 || !process_memory->ReadFully(address, &length, sizeof(length))) {
+    return;
+  }
+
+  // The length field includes the length of the length field itself.
+  if (length < sizeof(size_t)) {
+    return;
+  }
+  length -= sizeof(size_t);
+
+  std::string msg(length, '\0');
+  if (!process_memory->ReadFully(address + sizeof(length), &msg[0], length)) {
+    return;
+  }
+  // The message should be null terminated already.
+  msg.resize(strnlen(msg.c_str(), length));
+  tombstone->set_abort_message(msg);
+}
+
+static void fill_signal(android::debuggerd::Signal* signal, const ThreadInfo& thread_info) {
+  const siginfo_t* si = thread_info.siginfo;
+  signal->set_number(si->si_signo);
+  signal->set_name(get_signame(si));
+  signal->set_code(si->si_code);
+  signal->set_code_name(get_sigcode(si));
+
+  if (signal_has_sender(si, thread_info.pid)) {
+    signal->set_sender_uid(si->si_uid);
+    signal->set_sender_pid(si->si_pid);
+  }
+
+  if (signal_has_si_addr(si)) {
+    signal->set_fault_address(reinterpret_cast<uintptr_t>(si->si_addr));
+  }
+}
+
+// Build ids are looked up once per file, from the first readable map of it
+// that starts with an elf header.
+class BuildIdCache {
+ public:
+  BuildIdCache(BacktraceMap* map, Memory* process_memory)
+      : map_(map), process_memory_(process_memory) {}
+
+  const std::string& Get(const std::string& file_name) {
+    auto it = build_ids_.find(file_name);
+    if (it != build_ids_.end()) {
+      return it->second;
+    }
+
+    std::string& build_id = build_ids_[file_name];
+    ScopedBacktraceMapIteratorLock lock(map_);
+    for (auto map_it = map_->begin(); map_it != map_->end(); ++map_it) {
+      const backtrace_map_t* entry = *map_it;
+      if (entry->name == file_name && (entry->flags & PROT_READ) &&
+          elf_get_build_id(process_memory_, entry->start, &build_id)) {
+        break;
+      }
+    }
+    return build_id;
+  }
+
+ private:
+  BacktraceMap* map_;
+  Memory* process_memory_;
+  std::map<std::string, std::string> build_ids_;
+};
+
+static void fill_thread(android::debuggerd::Thread* thread, BacktraceMap* map,
+                        BuildIdCache* build_ids, const ThreadInfo& thread_info) {
+  thread->set_id(thread_info.tid);
+  thread->set_name(thread_info.thread_name);
+
+  thread_info.registers->IterateRegisters([thread](const char* name, uint64_t value) {
+    android::debuggerd::Register* reg = thread->add_registers();
+    reg->set_name(name);
+    reg->set_u64(value);
+  });
+
+  std::vector<backtrace_frame_data_t> frames;
+  if (!unwind_thread(map, thread_info, &frames)) {
+    return;
+  }
+  for (const auto& frame : frames) {
+    android::debuggerd::BacktraceFrame* f = thread->add_current_backtrace();
+    f->set_rel_pc(frame.rel_pc);
+    f->set_pc(frame.pc);
+    f->set_sp(frame.sp);
+    if (!frame.func_name.empty()) {
+      f->set_function_name(frame.func_name);
+      f->set_function_offset(frame.func_offset);
+    }
+    if (!frame.map.name.empty()) {
+      f->set_file_name(frame.map.name);
+      f->set_file_map_offset(frame.map.offset);
+      const std::string& build_id = build_ids->Get(frame.map.name);
+      if (!build_id.empty()) {
+        f->set_build_id(build_id);
+      }
+    }
+  }
+}
+
+bool engrave_tombstone_proto(unique_fd output_fd, BacktraceMap* map, Memory* process_memory,
+                             const std::map<pid_t, ThreadInfo>& threads, pid_t target_thread,
+                             uint64_t abort_msg_address) {
+  auto target = threads.find(target_thread);
+  if (target == threads.end()) {
+    ALOGE("failed to find target thread in thread info");
+    return false;
+  }
+  const ThreadInfo& target_info = target->second;
+
+  android::debuggerd::Tombstone tombstone;
+  tombstone.set_build_fingerprint(GetProperty("ro.build.fingerprint", "unknown"));
+  tombstone.set_revision(GetProperty("ro.revision", "unknown"));
+  tombstone.set_abi(ABI_STRING);
+  tombstone.set_timestamp(time(nullptr));
+  tombstone.set_pid(target_info.pid);
+  tombstone.set_tid(target_info.tid);
+  tombstone.set_process_name(target_info.process_name);
+  if (target_info.siginfo) {
+    fill_signal(tombstone.mutable_signal_info(), target_info);
+  }
+  fill_abort_message(&tombstone, process_memory, abort_msg_address);
+
+  BuildIdCache build_ids(map, process_memory);
+  fill_thread(tombstone.add_threads(), map, &build_ids, target_info);
+  for (const auto& [tid, thread_info] : threads) {
+    if (tid != target_thread) {
+      fill_thread(tombstone.add_threads(), map, &build_ids, thread_info);
+    }
+  }
+
+  std::string serialized;
+  if (!tombstone.SerializeToString(&serialized)) {
+    ALOGE("failed to serialize the tombstone proto");
+    return false;
+  }
+  if (!android::base::WriteStringToFd(serialized, output_fd.get())) {
+    ALOGE("failed to write the tombstone proto: %s", strerror(errno));
+    return false;
+  }
+  return true;
+}
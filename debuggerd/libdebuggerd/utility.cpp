@@ -28,7 +28,11 @@
 #include <sys/wait.h>
 #include <unistd.h>
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <string>
+#include <thread>
 
 #include <android-base/logging.h>
 #include <android-base/properties.h>
@@ -39,6 +43,7 @@
 #include <debuggerd/handler.h>
 #include <log/log.h>
 #include <unwindstack/Memory.h>
+#include <unwindstack/Regs.h>
 
 using android::base::unique_fd;
 
@@ -254,6 +259,58 @@ void drop_capabilities() {
   }
 }
 
+bool skip_past_deadline(log_t* log, logtype ltype, const char* section) {
+  if (std::chrono::steady_clock::now() < log->deadline) {
+    return false;
+  }
+  _LOG(log, ltype, "\n%s skipped: out of time for the tombstone\n", section);
+  return true;
+}
+
+bool unwind_thread(BacktraceMap* map, const ThreadInfo& thread,
+                   std::vector<backtrace_frame_data_t>* frames) {
+  if (thread.unwound) {
+    *frames = thread.frames;
+    return thread.unwind_succeeded;
+  }
+
+  // Unwind will mutate the registers, so make a copy first.
+  std::unique_ptr<unwindstack::Regs> regs_copy(thread.registers->Clone());
+  return Backtrace::Unwind(regs_copy.get(), map, frames, 0, nullptr);
+}
+
+void unwind_threads(BacktraceMap* map, std::map<pid_t, ThreadInfo>* threads) {
+  // The maps and the elf files behind them are shared, and locked where
+  // they get filled in lazily, so beyond a handful of threads the unwinds
+  // mostly wait for each other.
+  static constexpr size_t kMaxUnwindThreads = 8;
+
+  std::vector<ThreadInfo*> work;
+  for (auto& [tid, thread] : *threads) {
+    work.push_back(&thread);
+  }
+
+  std::atomic<size_t> next(0);
+  auto unwind = [map, &work, &next]() {
+    for (size_t i; (i = next.fetch_add(1)) < work.size();) {
+      ThreadInfo* thread = work[i];
+      thread->unwind_succeeded = unwind_thread(map, *thread, &thread->frames);
+      thread->unwound = true;
+    }
+  };
+
+  size_t count = std::min<size_t>(
+      {work.size(), kMaxUnwindThreads, std::max(std::thread::hardware_concurrency(), 1U)});
+  std::vector<std::thread> unwinders;
+  for (size_t i = 1; i < count; ++i) {
+    unwinders.emplace_back(unwind);
+  }
+  unwind();
+  for (auto& unwinder : unwinders) {
+    unwinder.join();
+  }
+}
+
 bool signal_has_si_addr(const siginfo_t* si) {
   // Manually sent signals won't have si_addr.
   if (si->si_code == SI_USER || si->si_code == SI_QUEUE || si->si_code == SI_TKILL) {
@@ -41,12 +41,25 @@ enum class CrashPacketType : uint8_t {
   // Responses to kRequest.
   // kPerformDump sends along an output fd via cmsg(3).
   kPerformDump = 128,
+  // Sent instead of kPerformDump when tombstoned won't take the dump, for a
+  // repeat of a crash it has just stored or when its queue is full.
   kAbortDump,
+  // Follows kPerformDump when it says so, with the fd for the protobuf
+  // tombstone.
+  kPerformDumpProto,
 };
 
 struct DumpRequest {
   DebuggerdDumpType dump_type;
   int32_t pid;
+  // Identifies a fatal crash independently of the process it happened in,
+  // so that tombstoned can tell repeats of it apart. 0 if unknown.
+  uint64_t crash_signature;
+};
+
+struct PerformDump {
+  // Whether a kPerformDumpProto packet follows.
+  bool proto_follows;
 };
 
 // The full packet must always be written, regardless of whether the union is used.
@@ -54,6 +67,7 @@ struct TombstonedCrashPacket {
   CrashPacketType packet_type;
   union {
     DumpRequest dump_request;
+    PerformDump perform_dump;
   } packet;
 };
 
@@ -25,4 +25,18 @@
 bool tombstoned_connect(pid_t pid, android::base::unique_fd* tombstoned_socket,
                         android::base::unique_fd* output_fd, DebuggerdDumpType dump_type);
 
+// As above, but also hands back the fd for the protobuf tombstone, if
+// tombstoned wants one for this dump. Otherwise proto_output_fd is left at -1.
+bool tombstoned_connect(pid_t pid, android::base::unique_fd* tombstoned_socket,
+                        android::base::unique_fd* output_fd,
+                        android::base::unique_fd* proto_output_fd, DebuggerdDumpType dump_type);
+
+// As above, for a fatal crash with the given signature (see DumpRequest).
+// Returns false with dump_declined set if tombstoned won't take the dump,
+// which it does for repeats of the same crash during a crash storm.
+bool tombstoned_connect(pid_t pid, android::base::unique_fd* tombstoned_socket,
+                        android::base::unique_fd* output_fd,
+                        android::base::unique_fd* proto_output_fd, DebuggerdDumpType dump_type,
+                        uint64_t crash_signature, bool* dump_declined);
+
 bool tombstoned_notify_completion(int tombstoned_socket);
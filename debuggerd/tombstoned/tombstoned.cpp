@@ -15,13 +15,16 @@
  */
 
 #include <fcntl.h>
+#include <inttypes.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <unistd.h>
 
+#include <algorithm>
 #include <array>
+#include <chrono>
 #include <deque>
 #include <string>
 #include <unordered_map>
@@ -31,9 +34,12 @@
 #include <event2/listener.h>
 #include <event2/thread.h>
 
+#include <android-base/file.h>
 #include <android-base/logging.h>
+#include <android-base/parseint.h>
 #include <android-base/properties.h>
 #include <android-base/stringprintf.h>
+#include <android-base/strings.h>
 #include <android-base/unique_fd.h>
 #include <cutils/sockets.h>
 
@@ -55,6 +61,31 @@ enum CrashStatus {
   kCrashStatusQueued,
 };
 
+// Queued crashes of the processes that matter most to the user are dumped
+// first, so that they don't sit behind a storm of background crashes.
+enum CrashPriority {
+  // Negative oom_score_adj: system_server, persistent apps and daemons.
+  kCrashPrioritySystem,
+  // The foreground app, and native processes that don't adjust their score.
+  kCrashPriorityForeground,
+  kCrashPriorityBackground,
+  kCrashPriorityCount,
+};
+
+static CrashPriority get_crash_priority(pid_t pid) {
+  std::string content;
+  int oom_score_adj;
+  if (!android::base::ReadFileToString(StringPrintf("/proc/%d/oom_score_adj", pid), &content) ||
+      !android::base::ParseInt(android::base::Trim(content), &oom_score_adj)) {
+    // Don't let a process that can't be looked at jump the queue.
+    return kCrashPriorityBackground;
+  }
+  if (oom_score_adj < 0) {
+    return kCrashPrioritySystem;
+  }
+  return oom_score_adj == 0 ? kCrashPriorityForeground : kCrashPriorityBackground;
+}
+
 // Ownership of Crash is a bit messy.
 // It's either owned by an active event that must have a timeout, or owned by
 // queued_requests, in the case that multiple crashes come in at the same time.
@@ -63,24 +94,96 @@ struct Crash {
 
   std::string crash_tombstone_path;
   unique_fd crash_tombstone_fd;
+  // The protobuf counterpart of the tombstone, only for native crashes.
+  std::string crash_tombstone_proto_path;
+  unique_fd crash_tombstone_proto_fd;
   unique_fd crash_socket_fd;
   pid_t crash_pid;
   event* crash_event = nullptr;
 
   DebuggerdDumpType crash_type;
+  uint64_t crash_signature = 0;
+  CrashPriority crash_priority = kCrashPriorityBackground;
+  // Someone waits for this dump, so it's never dropped.
+  bool crash_intercepted = false;
+};
+
+// Limits how many tombstones a crash signature gets within a window of time.
+// When a library crashes in many processes at once, the repeats would
+// otherwise rotate every older tombstone out and keep the queue full.
+class DuplicateCrashFilter {
+ public:
+  DuplicateCrashFilter(size_t max_per_window, std::chrono::steady_clock::duration window)
+      : max_per_window_(max_per_window), window_(window) {}
+
+  static DuplicateCrashFilter* for_tombstones() {
+    static DuplicateCrashFilter filter(
+        GetIntProperty("tombstoned.max_duplicate_tombstones", 5), std::chrono::minutes(1));
+    return &filter;
+  }
+
+  // Returns whether a crash with this signature should get a tombstone. A
+  // signature of 0 and a max_per_window of 0 are unlimited.
+  bool should_dump(uint64_t signature) {
+    if (signature == 0 || max_per_window_ == 0) {
+      return true;
+    }
+
+    auto now = std::chrono::steady_clock::now();
+    if (windows_.size() >= kMaxWindows) {
+      prune(now);
+    }
+    Window& window = windows_[signature];
+    if (window.count == 0 || now - window.start >= window_) {
+      window.start = now;
+      window.count = 0;
+    }
+    return ++window.count <= max_per_window_;
+  }
+
+ private:
+  static constexpr size_t kMaxWindows = 256;
+
+  struct Window {
+    std::chrono::steady_clock::time_point start;
+    size_t count = 0;
+  };
+
+  void prune(std::chrono::steady_clock::time_point now) {
+    for (auto it = windows_.begin(); it != windows_.end();) {
+      if (now - it->second.start >= window_) {
+        it = windows_.erase(it);
+      } else {
+        ++it;
+      }
+    }
+    // As many distinct crashes within one window aren't a storm of one.
+    if (windows_.size() >= kMaxWindows) {
+      windows_.clear();
+    }
+  }
+
+  const size_t max_per_window_;
+  const std::chrono::steady_clock::duration window_;
+  std::unordered_map<uint64_t, Window> windows_;
+
+  DISALLOW_COPY_AND_ASSIGN(DuplicateCrashFilter);
 };
 
 class CrashQueue {
  public:
+  // A max_queued_dumps of 0 doesn't bound the queue.
   CrashQueue(const std::string& dir_path, const std::string& file_name_prefix, size_t max_artifacts,
-             size_t max_concurrent_dumps)
+             size_t max_concurrent_dumps, size_t max_queued_dumps = 0)
       : file_name_prefix_(file_name_prefix),
         dir_path_(dir_path),
         dir_fd_(open(dir_path.c_str(), O_DIRECTORY | O_RDONLY | O_CLOEXEC)),
         max_artifacts_(max_artifacts),
         next_artifact_(0),
         max_concurrent_dumps_(max_concurrent_dumps),
-        num_concurrent_dumps_(0) {
+        num_concurrent_dumps_(0),
+        max_queued_dumps_(max_queued_dumps),
+        num_queued_dumps_(0) {
     if (dir_fd_ == -1) {
       PLOG(FATAL) << "failed to open directory: " << dir_path;
     }
@@ -93,13 +196,35 @@ class CrashQueue {
   }
 
   static CrashQueue* for_crash(const Crash* crash) {
-    return (crash->crash_type == kDebuggerdJavaBacktrace) ? for_anrs() : for_tombstones();
+    switch (crash->crash_type) {
+      case kDebuggerdJavaBacktrace:
+        return for_anrs();
+      case kDebuggerdNativeBacktrace:
+        return for_native_backtraces();
+      default:
+        return for_tombstones();
+    }
   }
 
   static CrashQueue* for_tombstones() {
+    // Each dump runs in its own crash_dump process, so running several at
+    // once keeps a crash storm from backing up. There must be more
+    // tombstones than dumps running at once, see the constructor.
+    static const size_t max_tombstones = GetIntProperty("tombstoned.max_tombstone_count", 10);
+    static CrashQueue queue(
+        "/data/tombstones", "tombstone_" /* file_name_prefix */, max_tombstones,
+        std::clamp<size_t>(GetIntProperty("tombstoned.max_concurrent_tombstones", 2), 1,
+                           std::max<size_t>(max_tombstones, 2) - 1),
+        GetIntProperty("tombstoned.max_queued_tombstones", 32));
+    return &queue;
+  }
+
+  // Native backtraces only ever go to an intercept or /dev/null, never to a
+  // file of the queue, which just keeps a batch of them from all running at
+  // once.
+  static CrashQueue* for_native_backtraces() {
     static CrashQueue queue("/data/tombstones", "tombstone_" /* file_name_prefix */,
-                            GetIntProperty("tombstoned.max_tombstone_count", 10),
-                            1 /* max_concurrent_dumps */);
+                            5 /* max_artifacts, unused */, 4 /* max_concurrent_dumps */);
     return &queue;
   }
 
@@ -135,20 +260,38 @@ class CrashQueue {
     return file_name;
   }
 
-  bool maybe_enqueue_crash(Crash* crash) {
-    if (num_concurrent_dumps_ == max_concurrent_dumps_) {
-      queued_requests_.push_back(crash);
-      return true;
+  // Queues the crash if max_concurrent_dumps are already running, and
+  // returns whether it did. When the queue is full as well, the newest queued
+  // crash of a lower priority makes room, or else the crash itself doesn't
+  // get in: whichever that is comes back in |dropped|, for the caller to
+  // abort.
+  bool maybe_enqueue_crash(Crash* crash, Crash** dropped) {
+    *dropped = nullptr;
+    if (num_concurrent_dumps_ < max_concurrent_dumps_) {
+      return false;
     }
 
-    return false;
+    if (max_queued_dumps_ != 0 && num_queued_dumps_ >= max_queued_dumps_ &&
+        !crash->crash_intercepted) {
+      *dropped = remove_newest_below(crash->crash_priority);
+      if (*dropped == nullptr) {
+        *dropped = crash;
+        return true;
+      }
+    }
+    queued_requests_[crash->crash_priority].push_back(crash);
+    ++num_queued_dumps_;
+    return true;
   }
 
   void maybe_dequeue_crashes(void (*handler)(Crash* crash)) {
-    while (!queued_requests_.empty() && num_concurrent_dumps_ < max_concurrent_dumps_) {
-      Crash* next_crash = queued_requests_.front();
-      queued_requests_.pop_front();
-      handler(next_crash);
+    for (auto& queue : queued_requests_) {
+      while (!queue.empty() && num_concurrent_dumps_ < max_concurrent_dumps_) {
+        Crash* next_crash = queue.front();
+        queue.pop_front();
+        --num_queued_dumps_;
+        handler(next_crash);
+      }
     }
   }
 
@@ -157,6 +300,21 @@ class CrashQueue {
   void on_crash_completed() { --num_concurrent_dumps_; }
 
  private:
+  Crash* remove_newest_below(CrashPriority priority) {
+    for (int i = kCrashPriorityCount - 1; i > priority; --i) {
+      auto& queue = queued_requests_[i];
+      auto it = std::find_if(queue.rbegin(), queue.rend(),
+                             [](const Crash* crash) { return !crash->crash_intercepted; });
+      if (it != queue.rend()) {
+        Crash* crash = *it;
+        queue.erase(std::next(it).base());
+        --num_queued_dumps_;
+        return crash;
+      }
+    }
+    return nullptr;
+  }
+
   void find_oldest_artifact() {
     size_t oldest_tombstone = 0;
     time_t oldest_time = std::numeric_limits<time_t>::max();
@@ -194,7 +352,11 @@ class CrashQueue {
   const size_t max_concurrent_dumps_;
   size_t num_concurrent_dumps_;
 
-  std::deque<Crash*> queued_requests_;
+  const size_t max_queued_dumps_;
+  size_t num_queued_dumps_;
+
+  // FIFO within each priority.
+  std::array<std::deque<Crash*>, kCrashPriorityCount> queued_requests_;
 
   DISALLOW_COPY_AND_ASSIGN(CrashQueue);
 };
@@ -207,8 +369,35 @@ static void crash_accept_cb(evconnlistener* listener, evutil_socket_t sockfd, so
 static void crash_request_cb(evutil_socket_t sockfd, short ev, void* arg);
 static void crash_completed_cb(evutil_socket_t sockfd, short ev, void* arg);
 
+static bool send_output_fd(Crash* crash, const TombstonedCrashPacket& response,
+                           unique_fd output_fd) {
+  ssize_t rc = send_fd(crash->crash_socket_fd, &response, sizeof(response), std::move(output_fd));
+  if (rc == -1) {
+    PLOG(WARNING) << "failed to send response to CrashRequest";
+    return false;
+  } else if (rc != sizeof(response)) {
+    PLOG(WARNING) << "crash socket write returned short";
+    return false;
+  }
+  return true;
+}
+
+// Tells crash_dump that there won't be a tombstone, so that it lets the
+// crashing process go as soon as it's logged the crash.
+static void abort_request(Crash* crash) {
+  TombstonedCrashPacket response = {
+    .packet_type = CrashPacketType::kAbortDump
+  };
+  if (TEMP_FAILURE_RETRY(write(crash->crash_socket_fd, &response, sizeof(response))) !=
+      sizeof(response)) {
+    PLOG(WARNING) << "failed to send kAbortDump";
+  }
+  delete crash;
+}
+
 static void perform_request(Crash* crash) {
   unique_fd output_fd;
+  unique_fd proto_output_fd;
   bool intercepted =
       intercept_manager->GetIntercept(crash->crash_pid, crash->crash_type, &output_fd);
   if (!intercepted) {
@@ -218,18 +407,24 @@ static void perform_request(Crash* crash) {
     } else {
       std::tie(crash->crash_tombstone_path, output_fd) = CrashQueue::for_crash(crash)->get_output();
       crash->crash_tombstone_fd.reset(dup(output_fd.get()));
+      if (crash->crash_type == kDebuggerdTombstone) {
+        std::tie(crash->crash_tombstone_proto_path, proto_output_fd) =
+            CrashQueue::for_crash(crash)->get_output();
+        crash->crash_tombstone_proto_fd.reset(dup(proto_output_fd.get()));
+      }
     }
   }
 
   TombstonedCrashPacket response = {
     .packet_type = CrashPacketType::kPerformDump
   };
-  ssize_t rc = send_fd(crash->crash_socket_fd, &response, sizeof(response), std::move(output_fd));
-  if (rc == -1) {
-    PLOG(WARNING) << "failed to send response to CrashRequest";
-    goto fail;
-  } else if (rc != sizeof(response)) {
-    PLOG(WARNING) << "crash socket write returned short";
+  response.packet.perform_dump.proto_follows = proto_output_fd != -1;
+  TombstonedCrashPacket proto_response = {
+    .packet_type = CrashPacketType::kPerformDumpProto
+  };
+  if (!send_output_fd(crash, response, std::move(output_fd)) ||
+      (response.packet.perform_dump.proto_follows &&
+       !send_output_fd(crash, proto_response, std::move(proto_output_fd)))) {
     goto fail;
   } else {
     // TODO: Make this configurable by the interceptor?
@@ -317,8 +512,27 @@ static void crash_request_cb(evutil_socket_t sockfd, short ev, void* arg) {
 
   LOG(INFO) << "received crash request for pid " << crash->crash_pid;
 
-  if (CrashQueue::for_crash(crash)->maybe_enqueue_crash(crash)) {
-    LOG(INFO) << "enqueueing crash request for pid " << crash->crash_pid;
+  crash->crash_signature = request.packet.dump_request.crash_signature;
+  crash->crash_priority = get_crash_priority(crash->crash_pid);
+  crash->crash_intercepted = intercept_manager->intercepts.count(crash->crash_pid) != 0;
+
+  if (crash->crash_type == kDebuggerdTombstone && !crash->crash_intercepted &&
+      !DuplicateCrashFilter::for_tombstones()->should_dump(crash->crash_signature)) {
+    LOG(INFO) << "declining repeated crash for pid " << crash->crash_pid << " (signature "
+              << StringPrintf("%016" PRIx64, crash->crash_signature) << ")";
+    abort_request(crash);
+    return;
+  }
+
+  Crash* dropped;
+  if (CrashQueue::for_crash(crash)->maybe_enqueue_crash(crash, &dropped)) {
+    if (dropped != crash) {
+      LOG(INFO) << "enqueueing crash request for pid " << crash->crash_pid;
+    }
+    if (dropped) {
+      LOG(WARNING) << "crash queue full, dropping crash request for pid " << dropped->crash_pid;
+      abort_request(dropped);
+    }
   } else {
     perform_request(crash);
   }
@@ -381,6 +595,22 @@ static void crash_completed_cb(evutil_socket_t sockfd, short ev, void* arg) {
       }
     }
 
+    // Whether or not this dump has one, don't leave an older crash's proto
+    // next to the new tombstone.
+    if (crash->crash_type != kDebuggerdJavaBacktrace) {
+      std::string proto_path = tombstone_path + ".pb";
+      rc = unlink(proto_path.c_str());
+      if (rc != 0 && errno != ENOENT) {
+        PLOG(ERROR) << "failed to unlink tombstone proto at " << proto_path;
+      } else if (crash->crash_tombstone_proto_fd != -1) {
+        fd_path = StringPrintf("/proc/self/fd/%d", crash->crash_tombstone_proto_fd.get());
+        rc = linkat(AT_FDCWD, fd_path.c_str(), AT_FDCWD, proto_path.c_str(), AT_SYMLINK_FOLLOW);
+        if (rc != 0) {
+          PLOG(ERROR) << "failed to link tombstone proto";
+        }
+      }
+    }
+
     // If we don't have O_TMPFILE, we need to clean up after ourselves.
     if (!crash->crash_tombstone_path.empty()) {
       rc = unlink(crash->crash_tombstone_path.c_str());
@@ -388,6 +618,13 @@ static void crash_completed_cb(evutil_socket_t sockfd, short ev, void* arg) {
         PLOG(ERROR) << "failed to unlink temporary tombstone at " << crash->crash_tombstone_path;
       }
     }
+    if (!crash->crash_tombstone_proto_path.empty()) {
+      rc = unlink(crash->crash_tombstone_proto_path.c_str());
+      if (rc != 0) {
+        PLOG(ERROR) << "failed to unlink temporary tombstone proto at "
+                    << crash->crash_tombstone_proto_path;
+      }
+    }
   }
 
 fail:
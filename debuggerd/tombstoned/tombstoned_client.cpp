@@ -30,8 +30,59 @@
 
 using android::base::unique_fd;
 
+static bool receive_output_fd(int sockfd, CrashPacketType expected_type,
+                              TombstonedCrashPacket* packet, unique_fd* output_fd) {
+  ssize_t rc = recv_fd(sockfd, packet, sizeof(*packet), output_fd);
+  if (rc == -1) {
+    async_safe_format_log(ANDROID_LOG_ERROR, "libc",
+                          "failed to read response to DumpRequest packet: %s", strerror(errno));
+    return false;
+  } else if (rc != sizeof(*packet)) {
+    async_safe_format_log(
+        ANDROID_LOG_ERROR, "libc",
+        "received DumpRequest response packet of incorrect length (expected %zu, got %zd)",
+        sizeof(*packet), rc);
+    return false;
+  } else if (expected_type == CrashPacketType::kPerformDumpProto &&
+             packet->packet_type != expected_type) {
+    async_safe_format_log(ANDROID_LOG_ERROR, "libc",
+                          "received unexpected packet type %u instead of kPerformDumpProto",
+                          static_cast<unsigned>(packet->packet_type));
+    return false;
+  } else if (packet->packet_type == CrashPacketType::kAbortDump) {
+    // Comes without an fd.
+    return true;
+  }
+
+  // Make the fd O_APPEND so that our output is guaranteed to be at the end of a file.
+  // (This also makes selinux rules consistent, because selinux distinguishes between writing to
+  // a regular fd, and writing to an fd with O_APPEND).
+  int flags = fcntl(output_fd->get(), F_GETFL);
+  if (fcntl(output_fd->get(), F_SETFL, flags | O_APPEND) != 0) {
+    async_safe_format_log(ANDROID_LOG_WARN, "libc", "failed to set output fd flags: %s",
+                          strerror(errno));
+  }
+  return true;
+}
+
 bool tombstoned_connect(pid_t pid, unique_fd* tombstoned_socket, unique_fd* output_fd,
                         DebuggerdDumpType dump_type) {
+  return tombstoned_connect(pid, tombstoned_socket, output_fd, nullptr, dump_type);
+}
+
+bool tombstoned_connect(pid_t pid, unique_fd* tombstoned_socket, unique_fd* output_fd,
+                        unique_fd* proto_output_fd, DebuggerdDumpType dump_type) {
+  return tombstoned_connect(pid, tombstoned_socket, output_fd, proto_output_fd, dump_type, 0,
+                            nullptr);
+}
+
+bool tombstoned_connect(pid_t pid, unique_fd* tombstoned_socket, unique_fd* output_fd,
+                        unique_fd* proto_output_fd, DebuggerdDumpType dump_type,
+                        uint64_t crash_signature, bool* dump_declined) {
+  if (dump_declined) {
+    *dump_declined = false;
+  }
+
   unique_fd sockfd(
       socket_local_client((dump_type != kDebuggerdJavaBacktrace ? kTombstonedCrashSocketName
                                                                 : kTombstonedJavaTraceSocketName),
@@ -46,6 +97,7 @@ bool tombstoned_connect(pid_t pid, unique_fd* tombstoned_socket, unique_fd* outp
   packet.packet_type = CrashPacketType::kDumpRequest;
   packet.packet.dump_request.pid = pid;
   packet.packet.dump_request.dump_type = dump_type;
+  packet.packet.dump_request.crash_signature = crash_signature;
   if (TEMP_FAILURE_RETRY(write(sockfd, &packet, sizeof(packet))) != sizeof(packet)) {
     async_safe_format_log(ANDROID_LOG_ERROR, "libc", "failed to write DumpRequest packet: %s",
                           strerror(errno));
@@ -53,30 +105,32 @@ bool tombstoned_connect(pid_t pid, unique_fd* tombstoned_socket, unique_fd* outp
   }
 
   unique_fd tmp_output_fd;
-  ssize_t rc = recv_fd(sockfd, &packet, sizeof(packet), &tmp_output_fd);
-  if (rc == -1) {
-    async_safe_format_log(ANDROID_LOG_ERROR, "libc",
-                          "failed to read response to DumpRequest packet: %s", strerror(errno));
+  if (!receive_output_fd(sockfd.get(), CrashPacketType::kPerformDump, &packet, &tmp_output_fd)) {
     return false;
-  } else if (rc != sizeof(packet)) {
-    async_safe_format_log(
-        ANDROID_LOG_ERROR, "libc",
-        "received DumpRequest response packet of incorrect length (expected %zu, got %zd)",
-        sizeof(packet), rc);
+  }
+  if (packet.packet_type == CrashPacketType::kAbortDump) {
+    async_safe_format_log(ANDROID_LOG_INFO, "libc", "tombstoned declined the dump");
+    if (dump_declined) {
+      *dump_declined = true;
+    }
     return false;
   }
 
-  // Make the fd O_APPEND so that our output is guaranteed to be at the end of a file.
-  // (This also makes selinux rules consistent, because selinux distinguishes between writing to
-  // a regular fd, and writing to an fd with O_APPEND).
-  int flags = fcntl(tmp_output_fd.get(), F_GETFL);
-  if (fcntl(tmp_output_fd.get(), F_SETFL, flags | O_APPEND) != 0) {
-    async_safe_format_log(ANDROID_LOG_WARN, "libc", "failed to set output fd flags: %s",
-                          strerror(errno));
+  // Read the proto fd even if the caller doesn't want it, so that the socket
+  // is left at the completion handshake.
+  unique_fd tmp_proto_output_fd;
+  if (packet.packet_type == CrashPacketType::kPerformDump &&
+      packet.packet.perform_dump.proto_follows &&
+      !receive_output_fd(sockfd.get(), CrashPacketType::kPerformDumpProto, &packet,
+                         &tmp_proto_output_fd)) {
+    return false;
   }
 
   *tombstoned_socket = std::move(sockfd);
   *output_fd = std::move(tmp_output_fd);
+  if (proto_output_fd) {
+    *proto_output_fd = std::move(tmp_proto_output_fd);
+  }
   return true;
 }
 
@@ -17,8 +17,11 @@
 
 #define FB_CMD_GETVAR "getvar"
 #define FB_CMD_DOWNLOAD "download"
+#define FB_CMD_DOWNLOAD_COMPRESSED "download-compressed"
 #define FB_CMD_UPLOAD "upload"
 #define FB_CMD_FLASH "flash"
+#define FB_CMD_FLASH_STREAM "flash-stream"
+#define FB_CMD_HASH_BLOCKS "hash-blocks"
 #define FB_CMD_ERASE "erase"
 #define FB_CMD_BOOT "boot"
 #define FB_CMD_SET_ACTIVE "set_active"
@@ -66,3 +69,4 @@
 #define FB_VAR_BATTERY_VOLTAGE "battery-voltage"
 #define FB_VAR_BATTERY_SOC_OK "battery-soc-ok"
 #define FB_VAR_SUPER_PARTITION_NAME "super-partition-name"
+#define FB_VAR_DOWNLOAD_COMPRESSION "download-compression"
@@ -19,6 +19,9 @@
 #include <sys/socket.h>
 #include <sys/un.h>
 
+#include <algorithm>
+
+#include <android-base/file.h>
 #include <android-base/logging.h>
 #include <android-base/parseint.h>
 #include <android-base/properties.h>
@@ -31,7 +34,9 @@
 #include <libgsi/libgsi.h>
 #include <liblp/builder.h>
 #include <liblp/liblp.h>
+#include <openssl/sha.h>
 #include <uuid/uuid.h>
+#include <zlib.h>
 
 #include "constants.h"
 #include "fastboot_device.h"
@@ -101,7 +106,8 @@ bool GetVarHandler(FastbootDevice* device, const std::vector<std::string>& args)
             {FB_VAR_BATTERY_VOLTAGE, {GetBatteryVoltage, nullptr}},
             {FB_VAR_BATTERY_SOC_OK, {GetBatterySoCOk, nullptr}},
             {FB_VAR_HW_REVISION, {GetHardwareRevision, nullptr}},
-            {FB_VAR_SUPER_PARTITION_NAME, {GetSuperPartitionName, nullptr}}};
+            {FB_VAR_SUPER_PARTITION_NAME, {GetSuperPartitionName, nullptr}},
+            {FB_VAR_DOWNLOAD_COMPRESSION, {GetDownloadCompression, nullptr}}};
 
     if (args.size() < 2) {
         return device->WriteFail("Missing argument");
@@ -194,6 +200,83 @@ bool DownloadHandler(FastbootDevice* device, const std::vector<std::string>& arg
     return device->WriteStatus(FastbootResult::FAIL, "Couldn't download data");
 }
 
+// Reads |compressed_size| bytes of zlib data from the transport and inflates
+// them into the download buffer, which must be filled exactly. All of the
+// data is read even if it turns out to be corrupt.
+static bool InflateDownload(FastbootDevice* device, uint32_t compressed_size) {
+    std::vector<char>& data = device->download_data();
+    z_stream zstream = {};
+    if (inflateInit(&zstream) != Z_OK) {
+        LOG(ERROR) << "Couldn't initialize zlib";
+        return false;
+    }
+    zstream.next_out = reinterpret_cast<Bytef*>(data.data());
+    zstream.avail_out = data.size();
+
+    std::vector<char> buffer(std::min<uint32_t>(compressed_size, 1024 * 1024));
+    int zerr = Z_OK;
+    for (uint32_t remaining = compressed_size; remaining > 0;) {
+        size_t len = std::min<size_t>(remaining, buffer.size());
+        auto read_ret = device->get_transport()->Read(buffer.data(), len);
+        if (read_ret < 0 || static_cast<size_t>(read_ret) != len) {
+            PLOG(ERROR) << "Couldn't read compressed data";
+            inflateEnd(&zstream);
+            return false;
+        }
+        remaining -= len;
+        if (zerr != Z_OK) continue;
+
+        zstream.next_in = reinterpret_cast<Bytef*>(buffer.data());
+        zstream.avail_in = len;
+        zerr = inflate(&zstream, Z_NO_FLUSH);
+        if (zerr == Z_STREAM_END && (zstream.avail_in != 0 || remaining != 0)) {
+            zerr = Z_DATA_ERROR;
+        } else if (zerr == Z_BUF_ERROR && zstream.avail_out != 0) {
+            // Z_BUF_ERROR only means that no progress was possible.
+            zerr = Z_OK;
+        }
+    }
+    size_t total_out = zstream.total_out;
+    inflateEnd(&zstream);
+    if (zerr != Z_STREAM_END || total_out != data.size()) {
+        LOG(ERROR) << "Corrupt compressed download: " << zerr << ", " << total_out << " of "
+                   << data.size() << " bytes";
+        return false;
+    }
+    return true;
+}
+
+bool DownloadCompressedHandler(FastbootDevice* device, const std::vector<std::string>& args) {
+    if (args.size() < 3) {
+        return device->WriteStatus(FastbootResult::FAIL, "size arguments unspecified");
+    }
+
+    if (GetDeviceLockStatus()) {
+        return device->WriteStatus(FastbootResult::FAIL,
+                                   "Download is not allowed on locked devices");
+    }
+
+    // arg[1] is the size of the data once inflated, arg[2] the size sent.
+    unsigned int size;
+    unsigned int compressed_size;
+    if (!android::base::ParseUint("0x" + args[1], &size, kMaxDownloadSizeDefault) ||
+        !android::base::ParseUint("0x" + args[2], &compressed_size) || compressed_size == 0) {
+        return device->WriteStatus(FastbootResult::FAIL, "Invalid size");
+    }
+    device->download_data().resize(size);
+    if (!device->WriteStatus(FastbootResult::DATA,
+                             android::base::StringPrintf("%08x", compressed_size))) {
+        return false;
+    }
+
+    if (InflateDownload(device, compressed_size)) {
+        return device->WriteStatus(FastbootResult::OKAY, "");
+    }
+
+    device->download_data().clear();
+    return device->WriteStatus(FastbootResult::FAIL, "Couldn't download data");
+}
+
 bool FlashHandler(FastbootDevice* device, const std::vector<std::string>& args) {
     if (args.size() < 2) {
         return device->WriteStatus(FastbootResult::FAIL, "Invalid arguments");
@@ -211,6 +294,79 @@ bool FlashHandler(FastbootDevice* device, const std::vector<std::string>& args)
     return device->WriteStatus(FastbootResult::OKAY, "Flashing succeeded");
 }
 
+bool FlashStreamHandler(FastbootDevice* device, const std::vector<std::string>& args) {
+    if (args.size() < 3) {
+        return device->WriteStatus(FastbootResult::FAIL, "Invalid arguments");
+    }
+
+    if (GetDeviceLockStatus()) {
+        return device->WriteStatus(FastbootResult::FAIL,
+                                   "Flashing is not allowed on locked devices");
+    }
+
+    // arg[1] is the partition, arg[2] the size of the image that follows.
+    uint32_t size;
+    if (!android::base::ParseUint("0x" + args[2], &size)) {
+        return device->WriteStatus(FastbootResult::FAIL, "Invalid size");
+    }
+    return FlashStream(device, args[1], size);
+}
+
+bool HashBlocksHandler(FastbootDevice* device, const std::vector<std::string>& args) {
+    if (args.size() < 4) {
+        return device->WriteStatus(FastbootResult::FAIL, "Invalid arguments");
+    }
+
+    if (GetDeviceLockStatus()) {
+        return device->WriteStatus(FastbootResult::FAIL,
+                                   "Reading partitions is not allowed on locked devices");
+    }
+
+    // arg[2] is the size of each hashed range, arg[3] the number of bytes to
+    // hash from the start of the partition.
+    uint32_t range_size;
+    uint64_t length;
+    if (!android::base::ParseUint("0x" + args[2], &range_size, kMaxHashRangeSize) ||
+        range_size == 0 || !android::base::ParseUint("0x" + args[3], &length) || length == 0) {
+        return device->WriteStatus(FastbootResult::FAIL, "Invalid range");
+    }
+
+    PartitionHandle handle;
+    if (!OpenPartition(device, args[1], &handle, O_RDONLY)) {
+        return device->WriteStatus(FastbootResult::FAIL, "Could not open partition");
+    }
+    if (length > get_block_device_size(handle.fd())) {
+        return device->WriteStatus(FastbootResult::FAIL, "Length exceeds partition size");
+    }
+    uint64_t count = (length - 1) / range_size + 1;
+    if (count * SHA256_DIGEST_LENGTH > kMaxDownloadSizeDefault) {
+        return device->WriteStatus(FastbootResult::FAIL, "Too many ranges");
+    }
+
+    std::vector<char> hashes(count * SHA256_DIGEST_LENGTH);
+    std::vector<char> buffer(range_size);
+    for (uint64_t i = 0; i < count; i++) {
+        uint64_t offset = i * range_size;
+        size_t len = std::min<uint64_t>(range_size, length - offset);
+        if (!android::base::ReadFullyAtOffset(handle.fd(), buffer.data(), len, offset)) {
+            PLOG(ERROR) << "Could not read " << args[1] << " at " << offset;
+            return device->WriteStatus(FastbootResult::FAIL, "Could not read partition");
+        }
+        SHA256(reinterpret_cast<const uint8_t*>(buffer.data()), len,
+               reinterpret_cast<uint8_t*>(&hashes[i * SHA256_DIGEST_LENGTH]));
+    }
+
+    if (!device->WriteStatus(FastbootResult::DATA,
+                             android::base::StringPrintf("%08zx", hashes.size()))) {
+        return false;
+    }
+    if (!device->HandleData(false, &hashes)) {
+        PLOG(ERROR) << "Couldn't upload hashes";
+        return false;
+    }
+    return device->WriteStatus(FastbootResult::OKAY, "");
+}
+
 bool SetActiveHandler(FastbootDevice* device, const std::vector<std::string>& args) {
     if (args.size() < 2) {
         return device->WriteStatus(FastbootResult::FAIL, "Missing slot argument");
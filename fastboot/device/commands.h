@@ -20,6 +20,7 @@
 #include <vector>
 
 constexpr unsigned int kMaxDownloadSizeDefault = 0x20000000;
+constexpr unsigned int kMaxHashRangeSize = 16 * 1024 * 1024;
 
 class FastbootDevice;
 
@@ -34,6 +35,7 @@ enum class FastbootResult {
 using CommandHandler = std::function<bool(FastbootDevice*, const std::vector<std::string>&)>;
 
 bool DownloadHandler(FastbootDevice* device, const std::vector<std::string>& args);
+bool DownloadCompressedHandler(FastbootDevice* device, const std::vector<std::string>& args);
 bool SetActiveHandler(FastbootDevice* device, const std::vector<std::string>& args);
 bool ShutDownHandler(FastbootDevice* device, const std::vector<std::string>& args);
 bool RebootHandler(FastbootDevice* device, const std::vector<std::string>& args);
@@ -43,6 +45,8 @@ bool RebootRecoveryHandler(FastbootDevice* device, const std::vector<std::string
 bool GetVarHandler(FastbootDevice* device, const std::vector<std::string>& args);
 bool EraseHandler(FastbootDevice* device, const std::vector<std::string>& args);
 bool FlashHandler(FastbootDevice* device, const std::vector<std::string>& args);
+bool FlashStreamHandler(FastbootDevice* device, const std::vector<std::string>& args);
+bool HashBlocksHandler(FastbootDevice* device, const std::vector<std::string>& args);
 bool CreatePartitionHandler(FastbootDevice* device, const std::vector<std::string>& args);
 bool DeletePartitionHandler(FastbootDevice* device, const std::vector<std::string>& args);
 bool ResizePartitionHandler(FastbootDevice* device, const std::vector<std::string>& args);
@@ -40,6 +40,7 @@ FastbootDevice::FastbootDevice()
     : kCommandMap({
               {FB_CMD_SET_ACTIVE, SetActiveHandler},
               {FB_CMD_DOWNLOAD, DownloadHandler},
+              {FB_CMD_DOWNLOAD_COMPRESSED, DownloadCompressedHandler},
               {FB_CMD_GETVAR, GetVarHandler},
               {FB_CMD_SHUTDOWN, ShutDownHandler},
               {FB_CMD_REBOOT, RebootHandler},
@@ -48,6 +49,8 @@ FastbootDevice::FastbootDevice()
               {FB_CMD_REBOOT_RECOVERY, RebootRecoveryHandler},
               {FB_CMD_ERASE, EraseHandler},
               {FB_CMD_FLASH, FlashHandler},
+              {FB_CMD_FLASH_STREAM, FlashStreamHandler},
+              {FB_CMD_HASH_BLOCKS, HashBlocksHandler},
               {FB_CMD_CREATE_PARTITION, CreatePartitionHandler},
               {FB_CMD_DELETE_PARTITION, DeletePartitionHandler},
               {FB_CMD_RESIZE_PARTITION, ResizePartitionHandler},
@@ -16,17 +16,22 @@
 #include "flashing.h"
 
 #include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
 #include <sys/stat.h>
 #include <unistd.h>
 
 #include <algorithm>
+#include <future>
 #include <memory>
 #include <set>
 #include <string>
 
 #include <android-base/file.h>
 #include <android-base/logging.h>
+#include <android-base/stringprintf.h>
 #include <android-base/strings.h>
+#include <asyncio/AsyncIO.h>
 #include <ext4_utils/ext4_utils.h>
 #include <fs_mgr_overlayfs.h>
 #include <fstab/fstab.h>
@@ -44,6 +49,35 @@ namespace {
 
 constexpr uint32_t SPARSE_HEADER_MAGIC = 0xed26ff3a;
 
+// Size of each of the two buffers flash-stream reads into; one is filled from
+// the transport while the other is written to the block device.
+constexpr size_t kStreamBufferSize = 16 * 1024 * 1024;
+
+// On-disk sparse image layout, as in libsparse's private sparse_format.h.
+struct SparseHeader {
+    uint32_t magic;
+    uint16_t major_version;
+    uint16_t minor_version;
+    uint16_t file_hdr_sz;
+    uint16_t chunk_hdr_sz;
+    uint32_t blk_sz;
+    uint32_t total_blks;
+    uint32_t total_chunks;
+    uint32_t image_checksum;
+};
+
+struct SparseChunkHeader {
+    uint16_t chunk_type;
+    uint16_t reserved1;
+    uint32_t chunk_sz;
+    uint32_t total_sz;
+};
+
+constexpr uint16_t kChunkTypeRaw = 0xCAC1;
+constexpr uint16_t kChunkTypeFill = 0xCAC2;
+constexpr uint16_t kChunkTypeDontCare = 0xCAC3;
+constexpr uint16_t kChunkTypeCrc32 = 0xCAC4;
+
 void WipeOverlayfsForPartition(FastbootDevice* device, const std::string& partition_name) {
     // May be called, in the case of sparse data, multiple times so cache/skip.
     static std::set<std::string> wiped;
@@ -82,35 +116,254 @@ int FlashRawDataChunk(int fd, const char* data, size_t len) {
     return 0;
 }
 
-int FlashRawData(int fd, const std::vector<char>& downloaded_data) {
-    int ret = FlashRawDataChunk(fd, downloaded_data.data(), downloaded_data.size());
-    if (ret < 0) {
-        return -errno;
+namespace {
+
+// Writes to a block device with O_DIRECT from a small pool of aligned buffers
+// submitted with aio, so that flashing neither fills the page cache (evicting
+// everything else in recovery) nor stalls on writeback. Pieces that O_DIRECT
+// can't write, like an unaligned tail, go through the page cache. If the
+// device doesn't support O_DIRECT or aio, everything is written as before.
+class BlockWriter {
+  public:
+    // Writing starts at the current offset of |fd|.
+    explicit BlockWriter(int fd);
+    ~BlockWriter();
+
+    // These return 0 on success or a negative errno.
+    int Write(const char* data, size_t len);
+    // Leaves the next |len| bytes of the device as they are.
+    int Skip(uint64_t len);
+    // Writes out and waits for everything still pending.
+    int Finish();
+
+  private:
+    static constexpr size_t kAlignment = 4096;
+    static constexpr size_t kBufferSize = 1024 * 1024;
+    static constexpr size_t kBufferCount = 4;
+
+    struct Buffer {
+        std::unique_ptr<char, decltype(&free)> data{nullptr, free};
+        iocb cb = {};
+        bool in_flight = false;
+    };
+
+    void Submit();
+    void Wait(size_t index);
+    void WaitAll();
+    void WriteBuffered(const char* data, size_t len, uint64_t offset);
+    void SetError(int error);
+
+    int fd_;
+    int flags_ = 0;
+    bool direct_ = false;
+    aio_context_t ctx_ = 0;
+    Buffer buffers_[kBufferCount];
+    size_t current_ = 0;
+    size_t used_ = 0;
+    // Device offset of the start of the current buffer.
+    uint64_t offset_ = 0;
+    int error_ = 0;
+};
+
+BlockWriter::BlockWriter(int fd) : fd_(fd) {
+    off64_t offset = lseek64(fd, 0, SEEK_CUR);
+    int flags = fcntl(fd, F_GETFL);
+    if (offset < 0 || flags < 0) {
+        return;
+    }
+    if (io_setup(kBufferCount, &ctx_) < 0) {
+        PLOG(WARNING) << "io_setup failed, not using direct I/O";
+        ctx_ = 0;
+        return;
+    }
+    for (auto& buffer : buffers_) {
+        void* data;
+        if (posix_memalign(&data, kAlignment, kBufferSize) != 0) {
+            return;
+        }
+        buffer.data.reset(reinterpret_cast<char*>(data));
+    }
+    if (fcntl(fd, F_SETFL, flags | O_DIRECT) < 0) {
+        PLOG(WARNING) << "O_DIRECT isn't supported, not using direct I/O";
+        return;
+    }
+    flags_ = flags;
+    offset_ = offset;
+    direct_ = true;
+}
+
+BlockWriter::~BlockWriter() {
+    // The kernel may still be reading from the buffers.
+    WaitAll();
+    if (ctx_) {
+        io_destroy(ctx_);
+    }
+    if (direct_) {
+        fcntl(fd_, F_SETFL, flags_);
+    }
+}
+
+void BlockWriter::SetError(int error) {
+    if (error_ == 0) {
+        error_ = error;
+    }
+}
+
+int BlockWriter::Write(const char* data, size_t len) {
+    if (!direct_) {
+        return FlashRawDataChunk(fd_, data, len) < 0 ? -errno : 0;
+    }
+    while (len > 0 && error_ == 0) {
+        Wait(current_);
+        size_t n = std::min(len, kBufferSize - used_);
+        memcpy(buffers_[current_].data.get() + used_, data, n);
+        used_ += n;
+        data += n;
+        len -= n;
+        if (used_ == kBufferSize) {
+            Submit();
+        }
+    }
+    return error_;
+}
+
+int BlockWriter::Skip(uint64_t len) {
+    if (!direct_) {
+        return lseek64(fd_, len, SEEK_CUR) >= 0 ? 0 : -errno;
+    }
+    Submit();
+    offset_ += len;
+    return error_;
+}
+
+int BlockWriter::Finish() {
+    if (!direct_) {
+        return 0;
+    }
+    Submit();
+    WaitAll();
+    // Nothing is left in the page cache, but the device may still cache data.
+    if (error_ == 0 && fsync(fd_) < 0) {
+        PLOG(ERROR) << "Failed to sync block device";
+        SetError(-errno);
+    }
+    return error_;
+}
+
+void BlockWriter::Submit() {
+    Buffer& buffer = buffers_[current_];
+    size_t len = used_;
+    uint64_t offset = offset_;
+    used_ = 0;
+    offset_ += len;
+    if (len == 0 || error_ != 0) {
+        return;
+    }
+
+    if (len % kAlignment != 0 || offset % kAlignment != 0) {
+        WriteBuffered(buffer.data.get(), len, offset);
+        return;
+    }
+
+    io_prep_pwrite(&buffer.cb, fd_, buffer.data.get(), len, offset);
+    buffer.cb.aio_data = current_;
+    iocb* cbs[] = {&buffer.cb};
+    if (io_submit(ctx_, 1, cbs) != 1) {
+        PLOG(ERROR) << "Failed to submit write of len " << len;
+        SetError(errno ? -errno : -EIO);
+        return;
+    }
+    buffer.in_flight = true;
+    current_ = (current_ + 1) % kBufferCount;
+}
+
+void BlockWriter::Wait(size_t index) {
+    while (buffers_[index].in_flight) {
+        io_event events[kBufferCount];
+        int n = io_getevents(ctx_, 1, kBufferCount, events, nullptr);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            PLOG(ERROR) << "io_getevents failed";
+            SetError(-errno);
+            return;
+        }
+        for (int i = 0; i < n; i++) {
+            Buffer& done = buffers_[events[i].data];
+            done.in_flight = false;
+            if (events[i].res < 0) {
+                LOG(ERROR) << "Failed to flash data of len " << done.cb.aio_nbytes << ": "
+                           << strerror(-events[i].res);
+                SetError(events[i].res);
+            } else if (static_cast<uint64_t>(events[i].res) != done.cb.aio_nbytes) {
+                LOG(ERROR) << "Short write flashing data of len " << done.cb.aio_nbytes;
+                SetError(-EIO);
+            }
+        }
+    }
+}
+
+void BlockWriter::WaitAll() {
+    for (size_t i = 0; i < kBufferCount; i++) {
+        Wait(i);
+    }
+}
+
+void BlockWriter::WriteBuffered(const char* data, size_t len, uint64_t offset) {
+    // Let the direct writes finish first, they may share a device block.
+    WaitAll();
+    if (fcntl(fd_, F_SETFL, flags_) < 0) {
+        SetError(-errno);
+        return;
+    }
+    while (len > 0) {
+        ssize_t n = TEMP_FAILURE_RETRY(pwrite64(fd_, data, len, offset));
+        if (n < 0) {
+            PLOG(ERROR) << "Failed to flash data of len " << len;
+            SetError(-errno);
+            break;
+        }
+        data += n;
+        len -= n;
+        offset += n;
+    }
+    if (fcntl(fd_, F_SETFL, flags_ | O_DIRECT) < 0) {
+        SetError(-errno);
     }
-    return ret;
 }
 
 int WriteCallback(void* priv, const void* data, size_t len) {
-    int fd = reinterpret_cast<long long>(priv);
+    BlockWriter* writer = reinterpret_cast<BlockWriter*>(priv);
     if (!data) {
-        return lseek64(fd, len, SEEK_CUR) >= 0 ? 0 : -errno;
+        return writer->Skip(len);
     }
-    return FlashRawDataChunk(fd, reinterpret_cast<const char*>(data), len);
+    return writer->Write(reinterpret_cast<const char*>(data), len);
 }
 
-int FlashSparseData(int fd, std::vector<char>& downloaded_data) {
+int FlashSparseData(BlockWriter* writer, std::vector<char>& downloaded_data) {
     struct sparse_file* file = sparse_file_import_buf(downloaded_data.data(), true, false);
     if (!file) {
         return -ENOENT;
     }
-    return sparse_file_callback(file, false, false, WriteCallback, reinterpret_cast<void*>(fd));
+    return sparse_file_callback(file, false, false, WriteCallback, writer);
+}
+
+}  // namespace
+
+int FlashRawData(int fd, const std::vector<char>& downloaded_data) {
+    BlockWriter writer(fd);
+    int ret = writer.Write(downloaded_data.data(), downloaded_data.size());
+    int finish_ret = writer.Finish();
+    return ret ? ret : finish_ret;
 }
 
 int FlashBlockDevice(int fd, std::vector<char>& downloaded_data) {
     lseek64(fd, 0, SEEK_SET);
     if (downloaded_data.size() >= sizeof(SPARSE_HEADER_MAGIC) &&
         *reinterpret_cast<uint32_t*>(downloaded_data.data()) == SPARSE_HEADER_MAGIC) {
-        return FlashSparseData(fd, downloaded_data);
+        BlockWriter writer(fd);
+        int ret = FlashSparseData(&writer, downloaded_data);
+        int finish_ret = writer.Finish();
+        return ret ? ret : finish_ret;
     } else {
         return FlashRawData(fd, downloaded_data);
     }
@@ -132,6 +385,269 @@ int Flash(FastbootDevice* device, const std::string& partition_name) {
     return FlashBlockDevice(handle.fd(), data);
 }
 
+namespace {
+
+// Writes an image to a block device as it arrives, in pieces of any size.
+// Sparse images are expanded on the fly, anything else is written as is.
+class StreamFlasher {
+  public:
+    StreamFlasher(int fd, uint64_t device_size) : writer_(fd), device_size_(device_size) {}
+
+    // Returns 0 on success or a negative errno.
+    int Write(const char* data, size_t len);
+    // Checks that a sparse image was complete.
+    int Finish();
+
+  private:
+    enum class State { kMagic, kFileHeader, kChunkHeader, kFillValue, kChunkData, kRaw, kDone };
+
+    // Appends to pending_ until it holds |size| bytes; returns whether it does.
+    bool Gather(const char** data, size_t* len, size_t size);
+    int ParseFileHeader();
+    int ParseChunkHeader();
+    int WriteFill(uint32_t value);
+    void NextChunk();
+
+    BlockWriter writer_;
+    uint64_t device_size_;
+    State state_ = State::kMagic;
+    std::vector<char> pending_;
+    SparseHeader header_ = {};
+    uint32_t chunks_left_ = 0;
+    uint64_t offset_ = 0;
+    // Header or checksum bytes to drop before the next state.
+    uint64_t skip_ = 0;
+    uint64_t chunk_left_ = 0;
+};
+
+bool StreamFlasher::Gather(const char** data, size_t* len, size_t size) {
+    size_t n = std::min(*len, size - pending_.size());
+    pending_.insert(pending_.end(), *data, *data + n);
+    *data += n;
+    *len -= n;
+    return pending_.size() == size;
+}
+
+int StreamFlasher::ParseFileHeader() {
+    memcpy(&header_, pending_.data(), sizeof(header_));
+    pending_.clear();
+    if (header_.major_version != 1 || header_.file_hdr_sz < sizeof(SparseHeader) ||
+        header_.chunk_hdr_sz < sizeof(SparseChunkHeader) || header_.blk_sz == 0 ||
+        header_.blk_sz % 4 != 0) {
+        LOG(ERROR) << "Invalid sparse image header";
+        return -EINVAL;
+    }
+    if (static_cast<uint64_t>(header_.total_blks) * header_.blk_sz > device_size_) {
+        return -EOVERFLOW;
+    }
+    skip_ = header_.file_hdr_sz - sizeof(SparseHeader);
+    chunks_left_ = header_.total_chunks;
+    state_ = chunks_left_ ? State::kChunkHeader : State::kDone;
+    return 0;
+}
+
+int StreamFlasher::ParseChunkHeader() {
+    SparseChunkHeader chunk;
+    memcpy(&chunk, pending_.data(), sizeof(chunk));
+    pending_.clear();
+    skip_ = header_.chunk_hdr_sz - sizeof(SparseChunkHeader);
+
+    uint64_t bytes = static_cast<uint64_t>(chunk.chunk_sz) * header_.blk_sz;
+    if (offset_ + bytes > static_cast<uint64_t>(header_.total_blks) * header_.blk_sz) {
+        LOG(ERROR) << "Sparse chunk extends past the end of the image";
+        return -EINVAL;
+    }
+    if (chunk.total_sz < header_.chunk_hdr_sz) {
+        return -EINVAL;
+    }
+    uint64_t data_sz = chunk.total_sz - header_.chunk_hdr_sz;
+    switch (chunk.chunk_type) {
+        case kChunkTypeRaw:
+            if (data_sz != bytes) return -EINVAL;
+            chunk_left_ = bytes;
+            if (bytes) {
+                state_ = State::kChunkData;
+            } else {
+                NextChunk();
+            }
+            return 0;
+        case kChunkTypeFill:
+            if (data_sz != sizeof(uint32_t)) return -EINVAL;
+            chunk_left_ = bytes;
+            state_ = State::kFillValue;
+            return 0;
+        case kChunkTypeDontCare:
+            if (data_sz != 0) return -EINVAL;
+            if (int ret = writer_.Skip(bytes); ret < 0) return ret;
+            offset_ += bytes;
+            NextChunk();
+            return 0;
+        case kChunkTypeCrc32:
+            if (data_sz != sizeof(uint32_t)) return -EINVAL;
+            skip_ += data_sz;
+            NextChunk();
+            return 0;
+        default:
+            LOG(ERROR) << "Unknown sparse chunk type " << chunk.chunk_type;
+            return -EINVAL;
+    }
+}
+
+int StreamFlasher::WriteFill(uint32_t value) {
+    std::vector<uint32_t> fill(std::min<uint64_t>(chunk_left_, 1024 * 1024) / sizeof(value),
+                               value);
+    while (chunk_left_ > 0) {
+        size_t n = std::min<uint64_t>(chunk_left_, fill.size() * sizeof(value));
+        if (int ret = writer_.Write(reinterpret_cast<const char*>(fill.data()), n); ret < 0) {
+            return ret;
+        }
+        chunk_left_ -= n;
+        offset_ += n;
+    }
+    NextChunk();
+    return 0;
+}
+
+void StreamFlasher::NextChunk() {
+    state_ = --chunks_left_ ? State::kChunkHeader : State::kDone;
+}
+
+int StreamFlasher::Write(const char* data, size_t len) {
+    int ret = 0;
+    while (len > 0 && ret == 0) {
+        if (skip_ > 0) {
+            size_t n = std::min<uint64_t>(skip_, len);
+            data += n;
+            len -= n;
+            skip_ -= n;
+            continue;
+        }
+        switch (state_) {
+            case State::kMagic:
+                if (!Gather(&data, &len, sizeof(SPARSE_HEADER_MAGIC))) break;
+                if (*reinterpret_cast<uint32_t*>(pending_.data()) == SPARSE_HEADER_MAGIC) {
+                    state_ = State::kFileHeader;
+                } else {
+                    state_ = State::kRaw;
+                    ret = writer_.Write(pending_.data(), pending_.size());
+                    pending_.clear();
+                }
+                break;
+            case State::kFileHeader:
+                if (Gather(&data, &len, sizeof(SparseHeader))) ret = ParseFileHeader();
+                break;
+            case State::kChunkHeader:
+                if (Gather(&data, &len, sizeof(SparseChunkHeader))) ret = ParseChunkHeader();
+                break;
+            case State::kFillValue:
+                if (Gather(&data, &len, sizeof(uint32_t))) {
+                    uint32_t value;
+                    memcpy(&value, pending_.data(), sizeof(value));
+                    pending_.clear();
+                    ret = WriteFill(value);
+                }
+                break;
+            case State::kChunkData: {
+                size_t n = std::min<uint64_t>(chunk_left_, len);
+                ret = writer_.Write(data, n);
+                if (ret < 0) break;
+                data += n;
+                len -= n;
+                chunk_left_ -= n;
+                offset_ += n;
+                if (!chunk_left_) NextChunk();
+                break;
+            }
+            case State::kRaw:
+                ret = writer_.Write(data, len);
+                len = 0;
+                break;
+            case State::kDone:
+                LOG(ERROR) << "Unexpected data after the end of the sparse image";
+                ret = -EINVAL;
+                break;
+        }
+    }
+    return ret;
+}
+
+int StreamFlasher::Finish() {
+    if (state_ == State::kMagic) {
+        // Images smaller than the sparse magic are written as raw data.
+        state_ = State::kRaw;
+        if (int ret = writer_.Write(pending_.data(), pending_.size()); ret < 0) return ret;
+    }
+    if ((state_ != State::kRaw && state_ != State::kDone) || skip_ > 0) {
+        LOG(ERROR) << "Sparse image is truncated";
+        return -EINVAL;
+    }
+    return writer_.Finish();
+}
+
+}  // namespace
+
+bool FlashStream(FastbootDevice* device, const std::string& partition_name, uint32_t size) {
+    PartitionHandle handle;
+    if (!OpenPartition(device, partition_name, &handle)) {
+        return device->WriteFail(strerror(ENOENT));
+    }
+    uint64_t device_size = get_block_device_size(handle.fd());
+    if (size == 0) {
+        return device->WriteFail(strerror(EINVAL));
+    } else if (size > device_size) {
+        return device->WriteFail(strerror(EOVERFLOW));
+    }
+    WipeOverlayfsForPartition(device, partition_name);
+    lseek64(handle.fd(), 0, SEEK_SET);
+
+    if (!device->WriteStatus(FastbootResult::DATA, android::base::StringPrintf("%08x", size))) {
+        return false;
+    }
+
+    // Read the next buffer from the transport while the previous one is
+    // being written. After a write error the rest of the data is still read,
+    // so that the host sees the failure instead of a stalled transfer.
+    StreamFlasher flasher(handle.fd(), device_size);
+    size_t buffer_size = std::min<size_t>(size, kStreamBufferSize);
+    std::vector<char> buffers[2] = {std::vector<char>(buffer_size),
+                                    std::vector<char>(buffer_size)};
+    std::future<int> pending;
+    int ret = 0;
+    bool read_ok = true;
+    for (uint32_t remaining = size, i = 0; remaining > 0 && read_ok; i ^= 1) {
+        size_t len = std::min<size_t>(remaining, buffer_size);
+        auto read_ret = device->get_transport()->Read(buffers[i].data(), len);
+        read_ok = read_ret >= 0 && static_cast<size_t>(read_ret) == len;
+        remaining -= len;
+
+        if (pending.valid()) {
+            int write_ret = pending.get();
+            if (ret == 0) ret = write_ret;
+        }
+        if (read_ok && ret == 0) {
+            pending = std::async(std::launch::async, [&flasher, &buffers, i, len] {
+                return flasher.Write(buffers[i].data(), len);
+            });
+        }
+    }
+    if (pending.valid()) {
+        int write_ret = pending.get();
+        if (ret == 0) ret = write_ret;
+    }
+
+    if (!read_ok) {
+        PLOG(ERROR) << "Couldn't download data";
+        return device->WriteFail("Couldn't download data");
+    }
+    if (ret == 0) {
+        ret = flasher.Finish();
+    }
+    if (ret < 0) {
+        return device->WriteFail(strerror(-ret));
+    }
+    return device->WriteOkay("Flashing succeeded");
+}
+
 bool UpdateSuper(FastbootDevice* device, const std::string& super_name, bool wipe) {
     std::vector<char> data = std::move(device->download_data());
     if (data.empty()) {
@@ -22,4 +22,7 @@
 class FastbootDevice;
 
 int Flash(FastbootDevice* device, const std::string& partition_name);
+// Receives an image of |size| bytes and writes it to the partition as it
+// arrives, without staging it in memory. Sends the final status itself.
+bool FlashStream(FastbootDevice* device, const std::string& partition_name, uint32_t size);
 bool UpdateSuper(FastbootDevice* device, const std::string& super_name, bool wipe);
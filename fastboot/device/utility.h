@@ -15,6 +15,8 @@
  */
 #pragma once
 
+#include <fcntl.h>
+
 #include <optional>
 #include <string>
 
@@ -62,7 +64,8 @@ std::string GetSuperSlotSuffix(FastbootDevice* device, const std::string& partit
 std::optional<std::string> FindPhysicalPartition(const std::string& name);
 bool LogicalPartitionExists(FastbootDevice* device, const std::string& name,
                             bool* is_zero_length = nullptr);
-bool OpenPartition(FastbootDevice* device, const std::string& name, PartitionHandle* handle);
+bool OpenPartition(FastbootDevice* device, const std::string& name, PartitionHandle* handle,
+                   int flags = O_WRONLY);
 bool GetSlotNumber(const std::string& slot, android::hardware::boot::V1_0::Slot* number);
 std::vector<std::string> ListPartitions(FastbootDevice* device);
 bool GetDeviceLockStatus();
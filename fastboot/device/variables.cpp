@@ -378,6 +378,12 @@ bool GetIsUserspace(FastbootDevice* /* device */, const std::vector<std::string>
     return true;
 }
 
+bool GetDownloadCompression(FastbootDevice* /* device */,
+                            const std::vector<std::string>& /* args */, std::string* message) {
+    *message = "deflate";
+    return true;
+}
+
 std::vector<std::vector<std::string>> GetAllPartitionArgsWithSlot(FastbootDevice* device) {
     std::vector<std::vector<std::string>> args;
     auto partitions = ListPartitions(device);
@@ -61,6 +61,8 @@ bool GetBatterySoCOk(FastbootDevice* device, const std::vector<std::string>& arg
                      std::string* message);
 bool GetSuperPartitionName(FastbootDevice* device, const std::vector<std::string>& args,
                            std::string* message);
+bool GetDownloadCompression(FastbootDevice* device, const std::vector<std::string>& args,
+                            std::string* message);
 
 // Helpers for getvar all.
 std::vector<std::vector<std::string>> GetAllPartitionArgsWithSlot(FastbootDevice* device);
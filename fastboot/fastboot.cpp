@@ -45,6 +45,9 @@
 
 #include <chrono>
 #include <functional>
+#include <future>
+#include <map>
+#include <mutex>
 #include <regex>
 #include <string>
 #include <thread>
@@ -60,6 +63,7 @@
 #include <android-base/unique_fd.h>
 #include <build/version.h>
 #include <liblp/liblp.h>
+#include <openssl/sha.h>
 #include <platform_tools_version.h>
 #include <sparse/sparse.h>
 #include <ziparchive/zip_archive.h>
@@ -81,7 +85,10 @@ using android::base::Trim;
 using android::base::unique_fd;
 using namespace std::string_literals;
 
-static const char* serial = nullptr;
+// The device the current thread talks to; see -s.
+static thread_local const char* serial = nullptr;
+// Set when several devices are flashed at once, one per thread.
+static bool g_multiple_devices = false;
 
 static bool g_long_listing = false;
 // Don't resparse files in too-big chunks.
@@ -89,7 +96,7 @@ static bool g_long_listing = false;
 // let's keep it at 1GB to avoid memory pressure on the host.
 static constexpr int64_t RESPARSE_LIMIT = 1 * 1024 * 1024 * 1024;
 static uint64_t sparse_limit = 0;
-static int64_t target_sparse_limit = -1;
+static thread_local int64_t target_sparse_limit = -1;
 
 static unsigned g_base_addr = 0x10000000;
 static boot_img_hdr_v1 g_boot_img_hdr = {};
@@ -97,10 +104,11 @@ static std::string g_cmdline;
 
 static bool g_disable_verity = false;
 static bool g_disable_verification = false;
+static bool g_incremental = false;
 
 static const std::string convert_fbe_marker_filename("convert_fbe");
 
-fastboot::FastBootDriver* fb = nullptr;
+thread_local fastboot::FastBootDriver* fb = nullptr;
 
 enum fb_buffer_type {
     FB_BUFFER_FD,
@@ -191,15 +199,28 @@ static std::string find_item(const std::string& item) {
     return "";
 }
 
-double last_start_time;
+static thread_local double last_start_time;
+// With several devices the status and result of a command are printed as
+// one line, prefixed with the device, so that the devices don't interleave.
+static thread_local std::string last_status;
+static std::mutex g_output_lock;
 
 static void Status(const std::string& message) {
     static constexpr char kStatusFormat[] = "%-50s ";
-    fprintf(stderr, kStatusFormat, message.c_str());
+    if (g_multiple_devices) {
+        last_status = message;
+    } else {
+        fprintf(stderr, kStatusFormat, message.c_str());
+    }
     last_start_time = now();
 }
 
 static void Epilog(int status) {
+    std::unique_lock<std::mutex> lock(g_output_lock, std::defer_lock);
+    if (g_multiple_devices) {
+        lock.lock();
+        fprintf(stderr, "%s: %-50s ", serial, last_status.c_str());
+    }
     if (status) {
         fprintf(stderr, "FAILED (%s)\n", fb->Error().c_str());
         die("Command failed");
@@ -210,7 +231,12 @@ static void Epilog(int status) {
 }
 
 static void InfoMessage(const std::string& info) {
-    fprintf(stderr, "(bootloader) %s\n", info.c_str());
+    if (g_multiple_devices) {
+        std::lock_guard<std::mutex> lock(g_output_lock);
+        fprintf(stderr, "%s: (bootloader) %s\n", serial, info.c_str());
+    } else {
+        fprintf(stderr, "(bootloader) %s\n", info.c_str());
+    }
 }
 
 static int64_t get_file_size(int fd) {
@@ -416,7 +442,8 @@ static int show_help() {
             "\n"
             "options:\n"
             " -w                         Wipe userdata.\n"
-            " -s SERIAL                  Specify a USB device.\n"
+            " -s SERIAL                  Specify a USB device. Given more than once,\n"
+            "                            runs the commands on all the devices at once.\n"
             " -s tcp|udp:HOST[:PORT]     Specify a network device.\n"
             " -S SIZE[K|M|G]             Break into sparse files no larger than SIZE.\n"
             " --force                    Force a flash operation that may be unsafe.\n"
@@ -427,6 +454,8 @@ static int show_help() {
             " --skip-reboot              Don't reboot device after flashing.\n"
             " --disable-verity           Sets disable-verity when flashing vbmeta.\n"
             " --disable-verification     Sets disable-verification when flashing vbmeta.\n"
+            " --incremental              Only send the parts of images that differ from\n"
+            "                            the partitions (fastbootd only).\n"
 #if !defined(_WIN32)
             " --wipe-and-use-fbe         Enable file-based encryption, wiping userdata.\n"
 #endif
@@ -789,10 +818,7 @@ static void DumpInfo() {
 
 }
 
-static struct sparse_file** load_sparse_files(int fd, int64_t max_size) {
-    struct sparse_file* s = sparse_file_import_auto(fd, false, true);
-    if (!s) die("cannot sparse read file");
-
+static struct sparse_file** resparse_file(struct sparse_file* s, int64_t max_size) {
     if (max_size <= 0 || max_size > std::numeric_limits<uint32_t>::max()) {
       die("invalid max size %" PRId64, max_size);
     }
@@ -809,6 +835,13 @@ static struct sparse_file** load_sparse_files(int fd, int64_t max_size) {
     return out_s;
 }
 
+static struct sparse_file** load_sparse_files(int fd, int64_t max_size) {
+    struct sparse_file* s = sparse_file_import_auto(fd, false, true);
+    if (!s) die("cannot sparse read file");
+
+    return resparse_file(s, max_size);
+}
+
 static int64_t get_target_sparse_limit() {
     std::string max_download_size;
     if (fb->GetVar("max-download-size", &max_download_size) != fastboot::SUCCESS ||
@@ -829,7 +862,8 @@ static int64_t get_target_sparse_limit() {
     return limit;
 }
 
-static int64_t get_sparse_limit(int64_t size) {
+// Returns the largest download for the current device, or 0 for no limit.
+static int64_t get_device_sparse_limit() {
     int64_t limit = sparse_limit;
     if (limit == 0) {
         // Unlimited, so see what the target device's limit is.
@@ -839,19 +873,26 @@ static int64_t get_sparse_limit(int64_t size) {
         }
         if (target_sparse_limit > 0) {
             limit = target_sparse_limit;
-        } else {
-            return 0;
         }
     }
+    return limit;
+}
 
-    if (size > limit) {
+static int64_t get_sparse_limit(int64_t size, int64_t limit) {
+    if (limit > 0 && size > limit) {
         return std::min(limit, RESPARSE_LIMIT);
     }
 
     return 0;
 }
 
-static bool load_buf_fd(int fd, struct fastboot_buffer* buf) {
+static int64_t get_sparse_limit(int64_t size) {
+    return get_sparse_limit(size, get_device_sparse_limit());
+}
+
+// |device_limit| is the result of get_device_sparse_limit(), so that images
+// can be loaded on threads that don't talk to the device.
+static bool load_buf_fd(int fd, struct fastboot_buffer* buf, int64_t device_limit) {
     int64_t sz = get_file_size(fd);
     if (sz == -1) {
         return false;
@@ -865,7 +906,8 @@ static bool load_buf_fd(int fd, struct fastboot_buffer* buf) {
     }
 
     lseek(fd, 0, SEEK_SET);
-    int64_t limit = get_sparse_limit(sz);
+    buf->fd = fd;
+    int64_t limit = get_sparse_limit(sz, device_limit);
     if (limit) {
         sparse_file** s = load_sparse_files(fd, limit);
         if (s == nullptr) {
@@ -883,6 +925,10 @@ static bool load_buf_fd(int fd, struct fastboot_buffer* buf) {
     return true;
 }
 
+static bool load_buf_fd(int fd, struct fastboot_buffer* buf) {
+    return load_buf_fd(fd, buf, get_device_sparse_limit());
+}
+
 static bool load_buf(const char* fname, struct fastboot_buffer* buf) {
     unique_fd fd(TEMP_FAILURE_RETRY(open(fname, O_RDONLY | O_BINARY)));
 
@@ -911,8 +957,10 @@ static void rewrite_vbmeta_buffer(struct fastboot_buffer* buf) {
 
     int fd = make_temporary_fd("vbmeta rewriting");
 
-    std::string data;
-    if (!android::base::ReadFdToString(buf->fd, &data)) {
+    // The original fd may be shared with other devices, so it is read with
+    // pread and left open.
+    std::string data(buf->sz, '\0');
+    if (!android::base::ReadFullyAtOffset(buf->fd, data.data(), data.size(), 0)) {
         die("Failed reading from vbmeta");
     }
 
@@ -932,37 +980,150 @@ static void rewrite_vbmeta_buffer(struct fastboot_buffer* buf) {
     if (!android::base::WriteStringToFd(data, fd)) {
         die("Failed writing to modified vbmeta");
     }
-    close(buf->fd);
     buf->fd = fd;
     lseek(fd, 0, SEEK_SET);
 }
 
+static void flash_sparse_files(const std::string& partition, sparse_file** s) {
+    std::vector<std::pair<sparse_file*, int64_t>> sparse_files;
+    while (*s) {
+        int64_t sz = sparse_file_len(*s, true, false);
+        sparse_files.emplace_back(*s, sz);
+        ++s;
+    }
+
+    for (size_t i = 0; i < sparse_files.size(); ++i) {
+        const auto& pair = sparse_files[i];
+        fb->FlashPartition(partition, pair.first, pair.second, i + 1, sparse_files.size());
+    }
+}
+
+static bool is_userspace_fastboot() {
+    std::string value;
+    return fb->GetVar("is-userspace", &value) == fastboot::SUCCESS && value == "yes";
+}
+
+// --incremental compares images with partitions in ranges of this size.
+static constexpr uint32_t kIncrementalRangeSize = 1024 * 1024;
+
+struct RangeHasher {
+    SHA256_CTX ctx;
+    uint64_t range_left = kIncrementalRangeSize;
+    std::vector<char> hashes;
+
+    void Finish() {
+        hashes.resize(hashes.size() + SHA256_DIGEST_LENGTH);
+        SHA256_Final(reinterpret_cast<uint8_t*>(&hashes[hashes.size() - SHA256_DIGEST_LENGTH]),
+                     &ctx);
+        SHA256_Init(&ctx);
+        range_left = kIncrementalRangeSize;
+    }
+};
+
+// Hashes the expanded image, with the holes read as zeros.
+static int hash_ranges_cb(void* priv, const void* data, size_t len) {
+    static const char kZeros[64 * 1024] = {};
+    RangeHasher* hasher = reinterpret_cast<RangeHasher*>(priv);
+    const char* p = reinterpret_cast<const char*>(data);
+    while (len > 0) {
+        size_t n = std::min<uint64_t>({len, hasher->range_left, data ? len : sizeof(kZeros)});
+        SHA256_Update(&hasher->ctx, data ? p : kZeros, n);
+        if (data) p += n;
+        len -= n;
+        hasher->range_left -= n;
+        if (hasher->range_left == 0) hasher->Finish();
+    }
+    return 0;
+}
+
+// Sends only the ranges of the image that differ from the partition, as a
+// sparse image whose other ranges are holes. Returns false if the image has
+// to be flashed in full instead.
+static bool flash_incremental(const std::string& partition, struct fastboot_buffer* buf) {
+    if (!is_userspace_fastboot()) {
+        verbose("incremental flashing requires fastbootd, sending all of '%s'",
+                partition.c_str());
+        return false;
+    }
+
+    lseek(buf->fd, 0, SEEK_SET);
+    sparse_file* s = sparse_file_import_auto(buf->fd, false, false);
+    if (!s) die("cannot sparse read file");
+    unsigned int block_size = sparse_file_block_size(s);
+    int64_t len = sparse_file_len(s, false, false);
+
+    std::string partition_size_str;
+    uint64_t partition_size;
+    if (kIncrementalRangeSize % block_size != 0 ||
+        fb->GetVar("partition-size:" + partition, &partition_size_str) != fastboot::SUCCESS ||
+        !android::base::ParseUint(partition_size_str, &partition_size) ||
+        static_cast<uint64_t>(len) > partition_size) {
+        verbose("cannot flash '%s' incrementally, sending all of it", partition.c_str());
+        sparse_file_destroy(s);
+        return false;
+    }
+
+    std::vector<char> remote;
+    fb->HashBlocks(partition, kIncrementalRangeSize, len, &remote);
+
+    RangeHasher hasher;
+    SHA256_Init(&hasher.ctx);
+    if (sparse_file_callback(s, false, false, hash_ranges_cb, &hasher) < 0) {
+        die("failed to read image for '%s'", partition.c_str());
+    }
+    if (hasher.range_left != kIncrementalRangeSize) hasher.Finish();
+    if (hasher.hashes.size() != remote.size()) {
+        die("device sent %zu bytes of hashes for '%s', expected %zu", remote.size(),
+            partition.c_str(), hasher.hashes.size());
+    }
+
+    unsigned int range_blocks = kIncrementalRangeSize / block_size;
+    size_t ranges = remote.size() / SHA256_DIGEST_LENGTH;
+    size_t changed = 0;
+    sparse_file* delta = sparse_file_new(block_size, len);
+    if (!delta) die("failed to allocate sparse file");
+    for (size_t i = 0; i < ranges; i++) {
+        size_t offset = i * SHA256_DIGEST_LENGTH;
+        if (memcmp(&remote[offset], &hasher.hashes[offset], SHA256_DIGEST_LENGTH) == 0) {
+            continue;
+        }
+        if (sparse_file_copy_blocks(s, delta, i * range_blocks, range_blocks) < 0) {
+            die("failed to build incremental image for '%s'", partition.c_str());
+        }
+        changed++;
+    }
+    fprintf(stderr, "%zu of %zu ranges of '%s' changed\n", changed, ranges, partition.c_str());
+
+    if (changed > 0) {
+        int64_t limit = get_sparse_limit(sparse_file_len(delta, true, false));
+        if (limit) {
+            flash_sparse_files(partition, resparse_file(delta, limit));
+        } else {
+            sparse_file* files[] = {delta, nullptr};
+            flash_sparse_files(partition, files);
+        }
+    }
+    sparse_file_destroy(delta);
+    sparse_file_destroy(s);
+    return true;
+}
+
 static void flash_buf(const std::string& partition, struct fastboot_buffer *buf)
 {
-    sparse_file** s;
-
     // Rewrite vbmeta if that's what we're flashing and modification has been requested.
     if ((g_disable_verity || g_disable_verification) &&
         (partition == "vbmeta" || partition == "vbmeta_a" || partition == "vbmeta_b")) {
         rewrite_vbmeta_buffer(buf);
     }
 
-    switch (buf->type) {
-        case FB_BUFFER_SPARSE: {
-            std::vector<std::pair<sparse_file*, int64_t>> sparse_files;
-            s = reinterpret_cast<sparse_file**>(buf->data);
-            while (*s) {
-                int64_t sz = sparse_file_len(*s, true, false);
-                sparse_files.emplace_back(*s, sz);
-                ++s;
-            }
+    if (g_incremental && flash_incremental(partition, buf)) {
+        return;
+    }
 
-            for (size_t i = 0; i < sparse_files.size(); ++i) {
-                const auto& pair = sparse_files[i];
-                fb->FlashPartition(partition, pair.first, pair.second, i + 1, sparse_files.size());
-            }
+    switch (buf->type) {
+        case FB_BUFFER_SPARSE:
+            flash_sparse_files(partition, reinterpret_cast<sparse_file**>(buf->data));
             break;
-        }
         case FB_BUFFER_FD:
             fb->FlashPartition(partition, buf->fd, buf->sz);
             break;
@@ -1144,11 +1305,6 @@ static void set_active(const std::string& slot_override) {
     }
 }
 
-static bool is_userspace_fastboot() {
-    std::string value;
-    return fb->GetVar("is-userspace", &value) == fastboot::SUCCESS && value == "yes";
-}
-
 static void reboot_to_userspace_fastboot() {
     fb->RebootTo("fastboot");
 
@@ -1281,17 +1437,64 @@ void FlashAllTool::CollectImages() {
     }
 }
 
+struct PreparedImage {
+    bool loaded;
+    int error;
+    fastboot_buffer buf;
+};
+
+// When several devices are flashed at once, each image is loaded once for
+// all of them. Flashing only reads the shared fds through mmap, so they can
+// be used from several threads.
+static std::mutex g_prepared_images_lock;
+static std::map<std::pair<std::string, int64_t>, std::shared_future<PreparedImage>>
+        g_prepared_images;
+
 void FlashAllTool::FlashImages(const std::vector<std::pair<const Image*, std::string>>& images) {
-    for (const auto& [image, slot] : images) {
-        fastboot_buffer buf;
+    // Query the device's download limit up front, since images are loaded on
+    // threads that must not use the transport.
+    int64_t device_limit = get_device_sparse_limit();
+    auto load = [this, device_limit](const Image* image) {
+        PreparedImage prepared = {};
         int fd = source_.OpenFile(image->img_name);
-        if (fd < 0 || !load_buf_fd(fd, &buf)) {
+        prepared.loaded = fd >= 0 && load_buf_fd(fd, &prepared.buf, device_limit);
+        prepared.error = errno;
+        return prepared;
+    };
+    auto prepare = [load, device_limit](const Image* image) {
+        if (!g_multiple_devices) {
+            return load(image);
+        }
+        std::shared_future<PreparedImage> prepared;
+        {
+            std::lock_guard<std::mutex> lock(g_prepared_images_lock);
+            auto& entry = g_prepared_images[{image->img_name, device_limit}];
+            if (!entry.valid()) {
+                entry = std::async(std::launch::deferred, load, image).share();
+            }
+            prepared = entry;
+        }
+        // The first device to get here loads the image, the others wait.
+        return prepared.get();
+    };
+
+    // Loading an image extracts and resparses it, which is slow for large
+    // images, so the next image is prepared while the current one is sent.
+    std::future<PreparedImage> next;
+    for (size_t i = 0; i < images.size(); i++) {
+        const auto& [image, slot] = images[i];
+        PreparedImage prepared = next.valid() ? next.get() : prepare(image);
+        if (i + 1 < images.size()) {
+            next = std::async(std::launch::async, prepare, images[i + 1].first);
+        }
+
+        if (!prepared.loaded) {
             if (image->optional_if_no_image) {
                 continue;
             }
-            die("could not load '%s': %s", image->img_name, strerror(errno));
+            die("could not load '%s': %s", image->img_name, strerror(prepared.error));
         }
-        FlashImage(*image, slot, &buf);
+        FlashImage(*image, slot, &prepared.buf);
     }
 }
 
@@ -1580,6 +1783,7 @@ int FastBootTool::Main(int argc, char* argv[]) {
     int longindex;
     std::string slot_override;
     std::string next_active;
+    std::vector<std::string> serials;
 
     g_boot_img_hdr.kernel_addr = 0x00008000;
     g_boot_img_hdr.ramdisk_addr = 0x01000000;
@@ -1595,6 +1799,7 @@ int FastBootTool::Main(int argc, char* argv[]) {
         {"force", no_argument, 0, 0},
         {"header-version", required_argument, 0, 0},
         {"help", no_argument, 0, 'h'},
+        {"incremental", no_argument, 0, 0},
         {"kernel-offset", required_argument, 0, 0},
         {"os-patch-level", required_argument, 0, 0},
         {"os-version", required_argument, 0, 0},
@@ -1632,6 +1837,8 @@ int FastBootTool::Main(int argc, char* argv[]) {
                 force_flash = true;
             } else if (name == "header-version") {
                 g_boot_img_hdr.header_version = strtoul(optarg, nullptr, 0);
+            } else if (name == "incremental") {
+                g_incremental = true;
             } else if (name == "kernel-offset") {
                 g_boot_img_hdr.kernel_addr = strtoul(optarg, 0, 16);
             } else if (name == "os-patch-level") {
@@ -1679,6 +1886,7 @@ int FastBootTool::Main(int argc, char* argv[]) {
                     break;
                 case 's':
                     serial = optarg;
+                    serials.emplace_back(optarg);
                     break;
                 case 'S':
                     if (!android::base::ParseByteCount(optarg, &sparse_limit)) {
@@ -1713,275 +1921,305 @@ int FastBootTool::Main(int argc, char* argv[]) {
         return show_help();
     }
 
-    Transport* transport = open_device();
-    if (transport == nullptr) {
-        return 1;
-    }
-    fastboot::DriverCallbacks driver_callbacks = {
-        .prolog = Status,
-        .epilog = Epilog,
-        .info = InfoMessage,
-    };
-    fastboot::FastBootDriver fastboot_driver(transport, driver_callbacks, false);
-    fb = &fastboot_driver;
-
-    const double start = now();
-
-    if (slot_override != "") slot_override = verify_slot(slot_override);
-    if (next_active != "") next_active = verify_slot(next_active, false);
-
-    if (wants_set_active) {
-        if (next_active == "") {
-            if (slot_override == "") {
-                std::string current_slot;
-                if (fb->GetVar("current-slot", &current_slot) == fastboot::SUCCESS) {
-                    next_active = verify_slot(current_slot, false);
+    // Everything from here on talks to one device. Each device given with -s
+    // runs it on its own thread, with its own copy of the options.
+    auto run_commands = [=]() mutable -> int {
+        Transport* transport = open_device();
+        if (transport == nullptr) {
+            return 1;
+        }
+        fastboot::DriverCallbacks driver_callbacks = {
+            .prolog = Status,
+            .epilog = Epilog,
+            .info = InfoMessage,
+        };
+        fastboot::FastBootDriver fastboot_driver(transport, driver_callbacks, false);
+        fb = &fastboot_driver;
+
+        const double start = now();
+
+        if (slot_override != "") slot_override = verify_slot(slot_override);
+        if (next_active != "") next_active = verify_slot(next_active, false);
+
+        if (wants_set_active) {
+            if (next_active == "") {
+                if (slot_override == "") {
+                    std::string current_slot;
+                    if (fb->GetVar("current-slot", &current_slot) == fastboot::SUCCESS) {
+                        next_active = verify_slot(current_slot, false);
+                    } else {
+                        wants_set_active = false;
+                    }
                 } else {
-                    wants_set_active = false;
+                    next_active = verify_slot(slot_override, false);
                 }
-            } else {
-                next_active = verify_slot(slot_override, false);
             }
         }
-    }
 
-    std::vector<std::string> args(argv, argv + argc);
-    while (!args.empty()) {
-        std::string command = next_arg(&args);
+        std::vector<std::string> args(argv, argv + argc);
+        while (!args.empty()) {
+            std::string command = next_arg(&args);
+
+            if (command == FB_CMD_GETVAR) {
+                std::string variable = next_arg(&args);
+                DisplayVarOrError(variable, variable);
+            } else if (command == FB_CMD_ERASE) {
+                std::string partition = next_arg(&args);
+                auto erase = [&](const std::string& partition) {
+                    std::string partition_type;
+                    if (fb->GetVar("partition-type:" + partition, &partition_type) ==
+                                fastboot::SUCCESS &&
+                        fs_get_generator(partition_type) != nullptr) {
+                        fprintf(stderr,
+                                "******** Did you mean to fastboot format this %s partition?\n",
+                                partition_type.c_str());
+                    }
 
-        if (command == FB_CMD_GETVAR) {
-            std::string variable = next_arg(&args);
-            DisplayVarOrError(variable, variable);
-        } else if (command == FB_CMD_ERASE) {
-            std::string partition = next_arg(&args);
-            auto erase = [&](const std::string& partition) {
-                std::string partition_type;
-                if (fb->GetVar("partition-type:" + partition, &partition_type) == fastboot::SUCCESS &&
-                    fs_get_generator(partition_type) != nullptr) {
-                    fprintf(stderr, "******** Did you mean to fastboot format this %s partition?\n",
-                            partition_type.c_str());
+                    fb->Erase(partition);
+                };
+                do_for_partitions(partition, slot_override, erase, true);
+            } else if (android::base::StartsWith(command, "format")) {
+                // Parsing for: "format[:[type][:[size]]]"
+                // Some valid things:
+                //  - select only the size, and leave default fs type:
+                //    format::0x4000000 userdata
+                //  - default fs type and size:
+                //    format userdata
+                //    format:: userdata
+                std::vector<std::string> pieces = android::base::Split(command, ":");
+                std::string type_override;
+                if (pieces.size() > 1) type_override = pieces[1].c_str();
+                std::string size_override;
+                if (pieces.size() > 2) size_override = pieces[2].c_str();
+
+                std::string partition = next_arg(&args);
+
+                auto format = [&](const std::string& partition) {
+                    fb_perform_format(partition, 0, type_override, size_override, "");
+                };
+                do_for_partitions(partition.c_str(), slot_override, format, true);
+            } else if (command == "signature") {
+                std::string filename = next_arg(&args);
+                std::vector<char> data;
+                if (!ReadFileToVector(filename, &data)) {
+                    die("could not load '%s': %s", filename.c_str(), strerror(errno));
                 }
+                if (data.size() != 256) die("signature must be 256 bytes (got %zu)", data.size());
+                fb->Download("signature", data);
+                fb->RawCommand("signature", "installing signature");
+            } else if (command == FB_CMD_REBOOT) {
+                wants_reboot = true;
+
+                if (args.size() == 1) {
+                    std::string what = next_arg(&args);
+                    if (what == "bootloader") {
+                        wants_reboot = false;
+                        wants_reboot_bootloader = true;
+                    } else if (what == "recovery") {
+                        wants_reboot = false;
+                        wants_reboot_recovery = true;
+                    } else if (what == "fastboot") {
+                        wants_reboot = false;
+                        wants_reboot_fastboot = true;
+                    } else {
+                        syntax_error("unknown reboot target %s", what.c_str());
+                    }
 
-                fb->Erase(partition);
-            };
-            do_for_partitions(partition, slot_override, erase, true);
-        } else if (android::base::StartsWith(command, "format")) {
-            // Parsing for: "format[:[type][:[size]]]"
-            // Some valid things:
-            //  - select only the size, and leave default fs type:
-            //    format::0x4000000 userdata
-            //  - default fs type and size:
-            //    format userdata
-            //    format:: userdata
-            std::vector<std::string> pieces = android::base::Split(command, ":");
-            std::string type_override;
-            if (pieces.size() > 1) type_override = pieces[1].c_str();
-            std::string size_override;
-            if (pieces.size() > 2) size_override = pieces[2].c_str();
-
-            std::string partition = next_arg(&args);
-
-            auto format = [&](const std::string& partition) {
-                fb_perform_format(partition, 0, type_override, size_override, "");
-            };
-            do_for_partitions(partition.c_str(), slot_override, format, true);
-        } else if (command == "signature") {
-            std::string filename = next_arg(&args);
-            std::vector<char> data;
-            if (!ReadFileToVector(filename, &data)) {
-                die("could not load '%s': %s", filename.c_str(), strerror(errno));
-            }
-            if (data.size() != 256) die("signature must be 256 bytes (got %zu)", data.size());
-            fb->Download("signature", data);
-            fb->RawCommand("signature", "installing signature");
-        } else if (command == FB_CMD_REBOOT) {
-            wants_reboot = true;
-
-            if (args.size() == 1) {
-                std::string what = next_arg(&args);
-                if (what == "bootloader") {
-                    wants_reboot = false;
-                    wants_reboot_bootloader = true;
-                } else if (what == "recovery") {
-                    wants_reboot = false;
-                    wants_reboot_recovery = true;
-                } else if (what == "fastboot") {
-                    wants_reboot = false;
-                    wants_reboot_fastboot = true;
+                }
+                if (!args.empty()) syntax_error("junk after reboot command");
+            } else if (command == FB_CMD_REBOOT_BOOTLOADER) {
+                wants_reboot_bootloader = true;
+            } else if (command == FB_CMD_REBOOT_RECOVERY) {
+                wants_reboot_recovery = true;
+            } else if (command == FB_CMD_REBOOT_FASTBOOT) {
+                wants_reboot_fastboot = true;
+            } else if (command == FB_CMD_CONTINUE) {
+                fb->Continue();
+            } else if (command == FB_CMD_BOOT) {
+                std::string kernel = next_arg(&args);
+                std::string ramdisk;
+                if (!args.empty()) ramdisk = next_arg(&args);
+                std::string second_stage;
+                if (!args.empty()) second_stage = next_arg(&args);
+
+                auto data = LoadBootableImage(kernel, ramdisk, second_stage);
+                fb->Download("boot.img", data);
+                fb->Boot();
+            } else if (command == FB_CMD_FLASH) {
+                std::string pname = next_arg(&args);
+
+                std::string fname;
+                if (!args.empty()) {
+                    fname = next_arg(&args);
                 } else {
-                    syntax_error("unknown reboot target %s", what.c_str());
+                    fname = find_item(pname);
                 }
-
-            }
-            if (!args.empty()) syntax_error("junk after reboot command");
-        } else if (command == FB_CMD_REBOOT_BOOTLOADER) {
-            wants_reboot_bootloader = true;
-        } else if (command == FB_CMD_REBOOT_RECOVERY) {
-            wants_reboot_recovery = true;
-        } else if (command == FB_CMD_REBOOT_FASTBOOT) {
-            wants_reboot_fastboot = true;
-        } else if (command == FB_CMD_CONTINUE) {
-            fb->Continue();
-        } else if (command == FB_CMD_BOOT) {
-            std::string kernel = next_arg(&args);
-            std::string ramdisk;
-            if (!args.empty()) ramdisk = next_arg(&args);
-            std::string second_stage;
-            if (!args.empty()) second_stage = next_arg(&args);
-
-            auto data = LoadBootableImage(kernel, ramdisk, second_stage);
-            fb->Download("boot.img", data);
-            fb->Boot();
-        } else if (command == FB_CMD_FLASH) {
-            std::string pname = next_arg(&args);
-
-            std::string fname;
-            if (!args.empty()) {
-                fname = next_arg(&args);
-            } else {
-                fname = find_item(pname);
-            }
-            if (fname.empty()) die("cannot determine image filename for '%s'", pname.c_str());
-
-            auto flash = [&](const std::string &partition) {
-                if (should_flash_in_userspace(partition) && !is_userspace_fastboot() &&
-                    !force_flash) {
-                    die("The partition you are trying to flash is dynamic, and "
-                        "should be flashed via fastbootd. Please run:\n"
-                        "\n"
-                        "    fastboot reboot fastboot\n"
-                        "\n"
-                        "And try again. If you are intentionally trying to "
-                        "overwrite a fixed partition, use --force.");
+                if (fname.empty()) die("cannot determine image filename for '%s'", pname.c_str());
+
+                auto flash = [&](const std::string &partition) {
+                    if (should_flash_in_userspace(partition) && !is_userspace_fastboot() &&
+                        !force_flash) {
+                        die("The partition you are trying to flash is dynamic, and "
+                            "should be flashed via fastbootd. Please run:\n"
+                            "\n"
+                            "    fastboot reboot fastboot\n"
+                            "\n"
+                            "And try again. If you are intentionally trying to "
+                            "overwrite a fixed partition, use --force.");
+                    }
+                    do_flash(partition.c_str(), fname.c_str());
+                };
+                do_for_partitions(pname.c_str(), slot_override, flash, true);
+            } else if (command == "flash:raw") {
+                std::string partition = next_arg(&args);
+                std::string kernel = next_arg(&args);
+                std::string ramdisk;
+                if (!args.empty()) ramdisk = next_arg(&args);
+                std::string second_stage;
+                if (!args.empty()) second_stage = next_arg(&args);
+
+                auto data = LoadBootableImage(kernel, ramdisk, second_stage);
+                auto flashraw = [&data](const std::string& partition) {
+                    fb->FlashPartition(partition, data);
+                };
+                do_for_partitions(partition, slot_override, flashraw, true);
+            } else if (command == "flashall") {
+                if (slot_override == "all") {
+                    fprintf(stderr,
+                            "Warning: slot set to 'all'. Secondary slots will not be flashed.\n");
+                    do_flashall(slot_override, true, wants_wipe);
+                } else {
+                    do_flashall(slot_override, skip_secondary, wants_wipe);
+                }
+                wants_reboot = true;
+            } else if (command == "update") {
+                bool slot_all = (slot_override == "all");
+                if (slot_all) {
+                    fprintf(stderr,
+                            "Warning: slot set to 'all'. Secondary slots will not be flashed.\n");
+                }
+                std::string filename = "update.zip";
+                if (!args.empty()) {
+                    filename = next_arg(&args);
+                }
+                do_update(filename.c_str(), slot_override, skip_secondary || slot_all);
+                wants_reboot = true;
+            } else if (command == FB_CMD_SET_ACTIVE) {
+                std::string slot = verify_slot(next_arg(&args), false);
+                fb->SetActive(slot);
+            } else if (command == "stage") {
+                std::string filename = next_arg(&args);
+
+                struct fastboot_buffer buf;
+                if (!load_buf(filename.c_str(), &buf) || buf.type != FB_BUFFER_FD) {
+                    die("cannot load '%s'", filename.c_str());
+                }
+                fb->Download(filename, buf.fd, buf.sz);
+            } else if (command == "get_staged") {
+                std::string filename = next_arg(&args);
+                fb->Upload(filename);
+            } else if (command == FB_CMD_OEM) {
+                do_oem_command(FB_CMD_OEM, &args);
+            } else if (command == "flashing") {
+                if (args.empty()) {
+                    syntax_error("missing 'flashing' command");
+                } else if (args.size() == 1 && (args[0] == "unlock" || args[0] == "lock" ||
+                                                args[0] == "unlock_critical" ||
+                                                args[0] == "lock_critical" ||
+                                                args[0] == "get_unlock_ability")) {
+                    do_oem_command("flashing", &args);
+                } else {
+                    syntax_error("unknown 'flashing' command %s", args[0].c_str());
+                }
+            } else if (command == FB_CMD_CREATE_PARTITION) {
+                std::string partition = next_arg(&args);
+                std::string size = next_arg(&args);
+                fb->CreatePartition(partition, size);
+            } else if (command == FB_CMD_DELETE_PARTITION) {
+                std::string partition = next_arg(&args);
+                fb->DeletePartition(partition);
+            } else if (command == FB_CMD_RESIZE_PARTITION) {
+                std::string partition = next_arg(&args);
+                std::string size = next_arg(&args);
+                fb->ResizePartition(partition, size);
+            } else if (command == "gsi") {
+                if (args.empty()) {
+                    syntax_error("missing 'wipe' or 'disable' argument");
+                } else if (args.size() == 1 && args[0] == "wipe") {
+                    fb->RawCommand("gsi:wipe", "wiping GSI");
+                } else if (args.size() == 1 && args[0] == "disable") {
+                    fb->RawCommand("gsi:disable", "disabling GSI");
+                } else {
+                    syntax_error("expected 'wipe' or 'disable'");
                 }
-                do_flash(partition.c_str(), fname.c_str());
-            };
-            do_for_partitions(pname.c_str(), slot_override, flash, true);
-        } else if (command == "flash:raw") {
-            std::string partition = next_arg(&args);
-            std::string kernel = next_arg(&args);
-            std::string ramdisk;
-            if (!args.empty()) ramdisk = next_arg(&args);
-            std::string second_stage;
-            if (!args.empty()) second_stage = next_arg(&args);
-
-            auto data = LoadBootableImage(kernel, ramdisk, second_stage);
-            auto flashraw = [&data](const std::string& partition) {
-                fb->FlashPartition(partition, data);
-            };
-            do_for_partitions(partition, slot_override, flashraw, true);
-        } else if (command == "flashall") {
-            if (slot_override == "all") {
-                fprintf(stderr, "Warning: slot set to 'all'. Secondary slots will not be flashed.\n");
-                do_flashall(slot_override, true, wants_wipe);
-            } else {
-                do_flashall(slot_override, skip_secondary, wants_wipe);
-            }
-            wants_reboot = true;
-        } else if (command == "update") {
-            bool slot_all = (slot_override == "all");
-            if (slot_all) {
-                fprintf(stderr, "Warning: slot set to 'all'. Secondary slots will not be flashed.\n");
-            }
-            std::string filename = "update.zip";
-            if (!args.empty()) {
-                filename = next_arg(&args);
-            }
-            do_update(filename.c_str(), slot_override, skip_secondary || slot_all);
-            wants_reboot = true;
-        } else if (command == FB_CMD_SET_ACTIVE) {
-            std::string slot = verify_slot(next_arg(&args), false);
-            fb->SetActive(slot);
-        } else if (command == "stage") {
-            std::string filename = next_arg(&args);
-
-            struct fastboot_buffer buf;
-            if (!load_buf(filename.c_str(), &buf) || buf.type != FB_BUFFER_FD) {
-                die("cannot load '%s'", filename.c_str());
-            }
-            fb->Download(filename, buf.fd, buf.sz);
-        } else if (command == "get_staged") {
-            std::string filename = next_arg(&args);
-            fb->Upload(filename);
-        } else if (command == FB_CMD_OEM) {
-            do_oem_command(FB_CMD_OEM, &args);
-        } else if (command == "flashing") {
-            if (args.empty()) {
-                syntax_error("missing 'flashing' command");
-            } else if (args.size() == 1 && (args[0] == "unlock" || args[0] == "lock" ||
-                                            args[0] == "unlock_critical" ||
-                                            args[0] == "lock_critical" ||
-                                            args[0] == "get_unlock_ability")) {
-                do_oem_command("flashing", &args);
-            } else {
-                syntax_error("unknown 'flashing' command %s", args[0].c_str());
-            }
-        } else if (command == FB_CMD_CREATE_PARTITION) {
-            std::string partition = next_arg(&args);
-            std::string size = next_arg(&args);
-            fb->CreatePartition(partition, size);
-        } else if (command == FB_CMD_DELETE_PARTITION) {
-            std::string partition = next_arg(&args);
-            fb->DeletePartition(partition);
-        } else if (command == FB_CMD_RESIZE_PARTITION) {
-            std::string partition = next_arg(&args);
-            std::string size = next_arg(&args);
-            fb->ResizePartition(partition, size);
-        } else if (command == "gsi") {
-            if (args.empty()) {
-                syntax_error("missing 'wipe' or 'disable' argument");
-            } else if (args.size() == 1 && args[0] == "wipe") {
-                fb->RawCommand("gsi:wipe", "wiping GSI");
-            } else if (args.size() == 1 && args[0] == "disable") {
-                fb->RawCommand("gsi:disable", "disabling GSI");
             } else {
-                syntax_error("expected 'wipe' or 'disable'");
+                syntax_error("unknown command %s", command.c_str());
             }
-        } else {
-            syntax_error("unknown command %s", command.c_str());
         }
-    }
 
-    if (wants_wipe) {
-        std::vector<std::string> partitions = { "userdata", "cache", "metadata" };
-        for (const auto& partition : partitions) {
-            std::string partition_type;
-            if (fb->GetVar("partition-type:" + partition, &partition_type) != fastboot::SUCCESS) {
-                continue;
-            }
-            if (partition_type.empty()) continue;
-            fb->Erase(partition);
-            if (partition == "userdata" && set_fbe_marker) {
-                fprintf(stderr, "setting FBE marker on initial userdata...\n");
-                std::string initial_userdata_dir = create_fbemarker_tmpdir();
-                fb_perform_format(partition, 1, "", "", initial_userdata_dir);
-                delete_fbemarker_tmpdir(initial_userdata_dir);
-            } else {
-                fb_perform_format(partition, 1, "", "", "");
+        if (wants_wipe) {
+            std::vector<std::string> partitions = { "userdata", "cache", "metadata" };
+            for (const auto& partition : partitions) {
+                std::string partition_type;
+                if (fb->GetVar("partition-type:" + partition, &partition_type) !=
+                    fastboot::SUCCESS) {
+                    continue;
+                }
+                if (partition_type.empty()) continue;
+                fb->Erase(partition);
+                if (partition == "userdata" && set_fbe_marker) {
+                    fprintf(stderr, "setting FBE marker on initial userdata...\n");
+                    std::string initial_userdata_dir = create_fbemarker_tmpdir();
+                    fb_perform_format(partition, 1, "", "", initial_userdata_dir);
+                    delete_fbemarker_tmpdir(initial_userdata_dir);
+                } else {
+                    fb_perform_format(partition, 1, "", "", "");
+                }
             }
         }
-    }
-    if (wants_set_active) {
-        fb->SetActive(next_active);
-    }
-    if (wants_reboot && !skip_reboot) {
-        fb->Reboot();
-        fb->WaitForDisconnect();
-    } else if (wants_reboot_bootloader) {
-        fb->RebootTo("bootloader");
-        fb->WaitForDisconnect();
-    } else if (wants_reboot_recovery) {
-        fb->RebootTo("recovery");
-        fb->WaitForDisconnect();
-    } else if (wants_reboot_fastboot) {
-        reboot_to_userspace_fastboot();
-    }
+        if (wants_set_active) {
+            fb->SetActive(next_active);
+        }
+        if (wants_reboot && !skip_reboot) {
+            fb->Reboot();
+            fb->WaitForDisconnect();
+        } else if (wants_reboot_bootloader) {
+            fb->RebootTo("bootloader");
+            fb->WaitForDisconnect();
+        } else if (wants_reboot_recovery) {
+            fb->RebootTo("recovery");
+            fb->WaitForDisconnect();
+        } else if (wants_reboot_fastboot) {
+            reboot_to_userspace_fastboot();
+        }
 
-    fprintf(stderr, "Finished. Total time: %.3fs\n", (now() - start));
+        fprintf(stderr, "Finished. Total time: %.3fs\n", (now() - start));
 
-    auto* old_transport = fb->set_transport(nullptr);
-    delete old_transport;
+        auto* old_transport = fb->set_transport(nullptr);
+        delete old_transport;
 
+        return 0;
+    };
+
+    if (serials.size() <= 1) {
+        return run_commands();
+    }
+#if defined(_WIN32)
+    die("flashing multiple devices at once is not supported on Windows");
+#endif
+    if (g_incremental) die("--incremental cannot be used with multiple devices");
+
+    g_multiple_devices = true;
+    std::vector<std::thread> threads;
+    for (const std::string& device_serial : serials) {
+        threads.emplace_back([run_commands, device_serial]() mutable {
+            serial = device_serial.c_str();
+            run_commands();
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
     return 0;
 }
 
@@ -45,6 +45,7 @@
 #include <android-base/stringprintf.h>
 #include <android-base/strings.h>
 #include <android-base/unique_fd.h>
+#include <zlib.h>
 
 #include "constants.h"
 #include "transport.h"
@@ -102,6 +103,31 @@ RetCode FastBootDriver::GetVarAll(std::vector<std::string>* response) {
     return GetVar("all", &tmp, response);
 }
 
+RetCode FastBootDriver::HashBlocks(const std::string& partition, uint32_t range_size,
+                                   uint64_t length, std::vector<char>* hashes) {
+    prolog_("Hashing '" + partition + "'");
+    auto result = HashBlocksInner(partition, range_size, length, hashes);
+    epilog_(result);
+    return result;
+}
+
+RetCode FastBootDriver::HashBlocksInner(const std::string& partition, uint32_t range_size,
+                                        uint64_t length, std::vector<char>* hashes) {
+    std::string cmd(StringPrintf("%s:%s:%08" PRIx32 ":%" PRIx64, FB_CMD_HASH_BLOCKS,
+                                 partition.c_str(), range_size, length));
+    RetCode ret;
+    int dsize;
+    if ((ret = RawCommand(cmd, nullptr, nullptr, &dsize))) {
+        return ret;
+    }
+
+    hashes->resize(dsize);
+    if ((ret = ReadBuffer(*hashes))) {
+        return ret;
+    }
+    return HandleResponse();
+}
+
 RetCode FastBootDriver::Reboot(std::string* response, std::vector<std::string>* info) {
     return RawCommand(FB_CMD_REBOOT, "Rebooting", response, info);
 }
@@ -148,6 +174,31 @@ RetCode FastBootDriver::FlashPartition(const std::string& partition, sparse_file
     return Flash(partition);
 }
 
+RetCode FastBootDriver::FlashStream(const std::string& partition, int fd, uint32_t size) {
+    prolog_(StringPrintf("Streaming '%s' (%u KB)", partition.c_str(), size / 1024));
+    auto result = FlashStreamInner(partition, fd, size);
+    epilog_(result);
+    return result;
+}
+
+RetCode FastBootDriver::FlashStreamInner(const std::string& partition, int fd, uint32_t size) {
+    if (size == 0) {
+        error_ = "Cannot stream an empty image";
+        return BAD_ARG;
+    }
+
+    std::string cmd(
+            StringPrintf("%s:%s:%08" PRIx32, FB_CMD_FLASH_STREAM, partition.c_str(), size));
+    RetCode ret;
+    if ((ret = RawCommand(cmd))) {
+        return ret;
+    }
+    if ((ret = SendBuffer(fd, size))) {
+        return ret;
+    }
+    return HandleResponse();
+}
+
 RetCode FastBootDriver::Partitions(std::vector<std::tuple<std::string, uint64_t>>* partitions) {
     std::vector<std::string> all;
     RetCode ret;
@@ -251,6 +302,13 @@ RetCode FastBootDriver::Download(sparse_file* s, bool use_crc, std::string* resp
 
     RetCode ret;
     uint32_t u32size = static_cast<uint32_t>(size);
+    if (SupportsCompressedDownload()) {
+        std::vector<char> compressed;
+        if (CompressSparse(s, use_crc, &compressed) && compressed.size() < u32size) {
+            return DownloadCompressed(u32size, compressed, response, info);
+        }
+    }
+
     if ((ret = DownloadCommand(u32size, response, info))) {
         return ret;
     }
@@ -260,6 +318,7 @@ RetCode FastBootDriver::Download(sparse_file* s, bool use_crc, std::string* resp
         std::vector<char> tpbuf;
     } cb_priv;
     cb_priv.self = this;
+    cb_priv.tpbuf.reserve(TRANSPORT_CHUNK_SIZE);
 
     auto cb = [](void* priv, const void* buf, size_t len) -> int {
         SparseCBPrivate* data = static_cast<SparseCBPrivate*>(priv);
@@ -400,6 +459,73 @@ RetCode FastBootDriver::DownloadCommand(uint32_t size, std::string* response,
     return SUCCESS;
 }
 
+bool FastBootDriver::SupportsCompressedDownload() {
+    if (!compression_checked_) {
+        std::string value;
+        compression_supported_ =
+                GetVar(FB_VAR_DOWNLOAD_COMPRESSION, &value) == SUCCESS && value == "deflate";
+        compression_checked_ = true;
+    }
+    return compression_supported_;
+}
+
+// Appends the deflate output for |len| bytes of |data| to |out|.
+static bool DeflateInto(z_stream* zstream, const void* data, size_t len, int flush,
+                        std::vector<char>* out) {
+    zstream->next_in = reinterpret_cast<Bytef*>(const_cast<void*>(data));
+    zstream->avail_in = len;
+    int zerr;
+    do {
+        size_t used = zstream->total_out;
+        if (out->size() - used < 64 * 1024) {
+            out->resize(used + std::max<size_t>(used / 2, 1024 * 1024));
+        }
+        zstream->next_out = reinterpret_cast<Bytef*>(out->data() + used);
+        zstream->avail_out = out->size() - used;
+        zerr = deflate(zstream, flush);
+        if (zerr != Z_OK && zerr != Z_STREAM_END && zerr != Z_BUF_ERROR) {
+            return false;
+        }
+    } while (flush == Z_FINISH ? zerr != Z_STREAM_END : zstream->avail_in > 0);
+    return true;
+}
+
+bool FastBootDriver::CompressSparse(sparse_file* s, bool use_crc, std::vector<char>* out) {
+    struct Compressor {
+        z_stream zstream;
+        std::vector<char>* out;
+    } compressor = {};
+    compressor.out = out;
+    if (deflateInit(&compressor.zstream, Z_BEST_SPEED) != Z_OK) {
+        return false;
+    }
+
+    auto cb = [](void* priv, const void* buf, size_t len) -> int {
+        Compressor* c = static_cast<Compressor*>(priv);
+        return DeflateInto(&c->zstream, buf, len, Z_NO_FLUSH, c->out) ? 0 : -1;
+    };
+    bool ok = sparse_file_callback(s, true, use_crc, cb, &compressor) == 0 &&
+              DeflateInto(&compressor.zstream, nullptr, 0, Z_FINISH, out);
+    out->resize(compressor.zstream.total_out);
+    deflateEnd(&compressor.zstream);
+    return ok;
+}
+
+RetCode FastBootDriver::DownloadCompressed(uint32_t size, const std::vector<char>& compressed,
+                                           std::string* response, std::vector<std::string>* info) {
+    std::string cmd(android::base::StringPrintf("%s:%08" PRIx32 ":%08zx",
+                                                FB_CMD_DOWNLOAD_COMPRESSED, size,
+                                                compressed.size()));
+    RetCode ret;
+    if ((ret = RawCommand(cmd, response, info))) {
+        return ret;
+    }
+    if ((ret = SendBuffer(compressed))) {
+        return ret;
+    }
+    return HandleResponse(response, info);
+}
+
 RetCode FastBootDriver::HandleResponse(std::string* response, std::vector<std::string>* info,
                                        int* dsize) {
     char status[FB_RESPONSE_SZ + 1];
@@ -565,6 +691,9 @@ int FastBootDriver::SparseWriteCallback(std::vector<char>& tpbuf, const char* da
 
 Transport* FastBootDriver::set_transport(Transport* transport) {
     std::swap(transport_, transport);
+    // The new transport may be a different device, or the same device in
+    // another fastboot implementation.
+    compression_checked_ = false;
     return transport;
 }
 
@@ -66,7 +66,10 @@ class FastBootDriver {
   public:
     static constexpr int RESP_TIMEOUT = 30;  // 30 seconds
     static constexpr uint32_t MAX_DOWNLOAD_SIZE = std::numeric_limits<uint32_t>::max();
-    static constexpr size_t TRANSPORT_CHUNK_SIZE = 1024;
+    // Sparse images are sent in multiples of this, so that no write ends in a short USB packet.
+    // It is large because over TCP and UDP each write is a framed message, and over UDP one that
+    // ends with a round trip.
+    static constexpr size_t TRANSPORT_CHUNK_SIZE = 1024 * 1024;
 
     FastBootDriver(Transport* transport, DriverCallbacks driver_callbacks = {},
                    bool no_checks = false);
@@ -96,6 +99,10 @@ class FastBootDriver {
     RetCode GetVar(const std::string& key, std::string* val,
                    std::vector<std::string>* info = nullptr);
     RetCode GetVarAll(std::vector<std::string>* response);
+    // Fetches the SHA-256 digest of each |range_size| range of the first
+    // |length| bytes of the partition.
+    RetCode HashBlocks(const std::string& partition, uint32_t range_size, uint64_t length,
+                       std::vector<char>* hashes);
     RetCode Reboot(std::string* response = nullptr, std::vector<std::string>* info = nullptr);
     RetCode RebootTo(std::string target, std::string* response = nullptr,
                      std::vector<std::string>* info = nullptr);
@@ -110,6 +117,9 @@ class FastBootDriver {
     RetCode FlashPartition(const std::string& partition, int fd, uint32_t sz);
     RetCode FlashPartition(const std::string& partition, sparse_file* s, uint32_t sz,
                            size_t current, size_t total);
+    // Sends the image with a single flash-stream command, which fastbootd
+    // writes as it arrives.
+    RetCode FlashStream(const std::string& partition, int fd, uint32_t sz);
 
     RetCode Partitions(std::vector<std::tuple<std::string, uint64_t>>* partitions);
     RetCode Require(const std::string& var, const std::vector<std::string>& allowed, bool* reqmet,
@@ -150,16 +160,28 @@ class FastBootDriver {
     RetCode ReadBuffer(std::vector<char>& buf);
     RetCode ReadBuffer(void* buf, size_t size);
 
+    RetCode FlashStreamInner(const std::string& partition, int fd, uint32_t size);
+    RetCode HashBlocksInner(const std::string& partition, uint32_t range_size, uint64_t length,
+                            std::vector<char>* hashes);
     RetCode UploadInner(const std::string& outfile, std::string* response = nullptr,
                         std::vector<std::string>* info = nullptr);
 
     int SparseWriteCallback(std::vector<char>& tpbuf, const char* data, size_t len);
 
+    // Sparse downloads are deflated when the device supports it, since the
+    // raw chunks of partially filled filesystem images compress well.
+    bool SupportsCompressedDownload();
+    bool CompressSparse(sparse_file* s, bool use_crc, std::vector<char>* out);
+    RetCode DownloadCompressed(uint32_t size, const std::vector<char>& compressed,
+                               std::string* response, std::vector<std::string>* info);
+
     std::string error_;
     std::function<void(const std::string&)> prolog_;
     std::function<void(int)> epilog_;
     std::function<void(const std::string&)> info_;
     bool disable_checks_;
+    bool compression_checked_ = false;
+    bool compression_supported_ = false;
 };
 
 }  // namespace fastboot
@@ -292,4 +292,34 @@ void ExtensionsPartition<UNLOCKED>::SetUp() {
 template class ExtensionsPartition<true>;
 template class ExtensionsPartition<false>;
 
+std::string Benchmark::results_path = "";
+
+void Benchmark::SetUp() {
+    ASSERT_NO_FATAL_FAILURE(ModeTest<true>::SetUp());
+
+    std::string var;
+    ASSERT_EQ(fb->GetVar("max-download-size", &var), SUCCESS) << "Getting max download size failed";
+    max_dl = strtoll(var.c_str(), nullptr, 16);
+    ASSERT_GT(max_dl, 0) << "Max download size reported was invalid";
+
+    ASSERT_EQ(fb->GetVar("product", &product), SUCCESS) << "getvar:product failed";
+    mode = UserSpaceFastboot() ? "fastbootd" : "bootloader";
+}
+
+void Benchmark::Report(const std::string& name, const std::string& param, double value,
+                       const std::string& unit) {
+    const std::string key = param.empty() ? name : name + "/" + param;
+    RecordProperty(key, android::base::StringPrintf("%.3f %s", value, unit.c_str()));
+    printf("%s %s: %.3f %s\n", mode.c_str(), key.c_str(), value, unit.c_str());
+
+    if (results_path.empty()) {
+        return;
+    }
+    // product,mode,benchmark,param,value,unit
+    std::ofstream out(results_path, std::ios::app);
+    out << product << ',' << mode << ',' << name << ',' << param << ','
+        << android::base::StringPrintf("%.3f", value) << ',' << unit << '\n';
+    EXPECT_TRUE(out.good()) << "Writing results to '" << results_path << "' failed";
+}
+
 }  // end namespace fastboot
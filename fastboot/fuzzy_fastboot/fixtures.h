@@ -136,4 +136,21 @@ class UserdataPartition : public ExtensionsPartition<true> {};
 
 class SparseTestPartition : public ExtensionsPartition<true> {};
 
+// Only run in benchmark mode (--benchmark=)
+class Benchmark : public ModeTest<true> {
+  public:
+    // Where Report() appends its results as CSV
+    static std::string results_path;
+
+  protected:
+    void SetUp() override;
+    // Adds a result to the gtest output and to the results file
+    void Report(const std::string& name, const std::string& param, double value,
+                const std::string& unit);
+
+    int64_t max_dl;
+    std::string product;
+    std::string mode;  // "fastbootd" or "bootloader"
+};
+
 }  // end namespace fastboot
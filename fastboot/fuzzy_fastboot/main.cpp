@@ -33,6 +33,7 @@
 #include <sys/time.h>
 #include <sys/types.h>
 #include <unistd.h>
+#include <algorithm>
 #include <chrono>
 #include <cstdlib>
 #include <fstream>
@@ -872,6 +873,101 @@ TEST_F(Fuzz, USBResetAfterDownload) {
     EXPECT_EQ(fb->GetVarAll(&all), SUCCESS) << "getvar:all failed after USB reset.";
 }
 
+// Benchmarks
+// Seconds taken by f()
+template <typename F>
+double TimeIt(F f) {
+    auto start = std::chrono::steady_clock::now();
+    f();
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count();
+}
+
+// The p-th percentile of a sorted, non-empty vector
+double Percentile(const std::vector<double>& sorted, double p) {
+    size_t i = std::min(sorted.size() - 1, static_cast<size_t>(p / 100 * sorted.size()));
+    return sorted[i];
+}
+
+constexpr double MB = 1024.0 * 1024.0;
+
+TEST_F(Benchmark, DownloadThroughput) {
+    const int64_t max_size = std::min<int64_t>(max_dl, 256 * 1024 * 1024);
+    for (int64_t size = 4096; size <= max_size; size *= 4) {
+        std::vector<char> buf = RandomBuf(size);
+        double best = 0;
+        for (int i = 0; i < 3; i++) {
+            RetCode ret;
+            double secs = TimeIt([&]() { ret = fb->Download(buf); });
+            ASSERT_EQ(ret, SUCCESS) << "Download of " << size << " bytes failed";
+            best = std::max(best, size / MB / secs);
+        }
+        Report("download", std::to_string(size), best, "MiB/s");
+    }
+}
+
+// Writes the same amount of data as a raw image, as a sparse image of it, and as a sparse image
+// of a single fill chunk
+TEST_F(Benchmark, FlashThroughput) {
+    const int64_t size = std::min<int64_t>(max_dl, 64 * 1024 * 1024) / 4096 * 4096;
+    std::vector<char> buf = RandomBuf(size);
+
+    auto flash = [&](const std::string& param) {
+        RetCode ret;
+        double secs = TimeIt([&]() { ret = fb->Flash("userdata"); });
+        ASSERT_EQ(ret, SUCCESS) << "Flashing " << param << " image failed";
+        Report("flash", param, size / MB / secs, "MiB/s");
+    };
+
+    ASSERT_EQ(fb->Download(buf), SUCCESS) << "Download raw image failed";
+    ASSERT_NO_FATAL_FAILURE(flash("raw"));
+
+    SparseWrapper data(4096, size);
+    ASSERT_TRUE(*data) << "Sparse image creation failed";
+    ASSERT_EQ(sparse_file_add_data(*data, buf.data(), buf.size(), 0), 0)
+            << "Adding data failed to sparse file: " << data.Rep();
+    ASSERT_EQ(fb->Download(*data), SUCCESS) << "Download sparse failed: " << data.Rep();
+    ASSERT_NO_FATAL_FAILURE(flash("sparse_data"));
+
+    SparseWrapper fill(4096, size);
+    ASSERT_TRUE(*fill) << "Sparse image creation failed";
+    ASSERT_EQ(sparse_file_add_fill(*fill, 0xdeadbeef, size, 0), 0)
+            << "Adding fill to sparse file failed: " << fill.Rep();
+    ASSERT_EQ(fb->Download(*fill), SUCCESS) << "Download sparse failed: " << fill.Rep();
+    ASSERT_NO_FATAL_FAILURE(flash("sparse_fill"));
+}
+
+TEST_F(Benchmark, CommandLatency) {
+    std::vector<double> usecs;
+    for (int i = 0; i < 200; i++) {
+        std::string resp;
+        RetCode ret;
+        usecs.push_back(TimeIt([&]() { ret = fb->GetVar("product", &resp); }) * 1e6);
+        ASSERT_EQ(ret, SUCCESS) << "getvar:product failed";
+    }
+    std::sort(usecs.begin(), usecs.end());
+    Report("getvar_latency", "p50", Percentile(usecs, 50), "us");
+    Report("getvar_latency", "p90", Percentile(usecs, 90), "us");
+    Report("getvar_latency", "p99", Percentile(usecs, 99), "us");
+    Report("getvar_latency", "max", usecs.back(), "us");
+}
+
+TEST_F(Benchmark, GetVarAll) {
+    std::vector<double> msecs;
+    size_t vars = 0;
+    for (int i = 0; i < 10; i++) {
+        std::vector<std::string> all;
+        RetCode ret;
+        msecs.push_back(TimeIt([&]() { ret = fb->GetVarAll(&all); }) * 1e3);
+        ASSERT_EQ(ret, SUCCESS) << "getvar:all failed";
+        vars = all.size();
+    }
+    std::sort(msecs.begin(), msecs.end());
+    Report("getvar_all", "p50", Percentile(msecs, 50), "ms");
+    Report("getvar_all", "max", msecs.back(), "ms");
+    Report("getvar_all", "vars", vars, "count");
+}
+
 // Getvar XML tests
 TEST_P(ExtensionsGetVarConformance, VarExists) {
     std::string resp;
@@ -1658,6 +1754,20 @@ int main(int argc, char** argv) {
     }
 
     ::testing::InitGoogleTest(&argc, argv);
+
+    // Benchmarks are slow, so they only run in benchmark mode, and then by themselves unless
+    // a filter says otherwise
+    std::string& filter = ::testing::GTEST_FLAG(filter);
+    if (args.find("benchmark") != args.end()) {
+        fastboot::Benchmark::results_path = args.at("benchmark");
+        if (filter == "*") {
+            filter = "Benchmark.*";
+        }
+    } else {
+        filter += (filter.find('-') == std::string::npos ? "-" : ":");
+        filter += "Benchmark.*";
+    }
+
     auto ret = RUN_ALL_TESTS();
     if (fastboot::FastBootTest::serial_port > 0) {
         close(fastboot::FastBootTest::serial_port);
@@ -33,6 +33,7 @@
 #include <errno.h>
 #include <stdio.h>
 
+#include <algorithm>
 #include <list>
 #include <memory>
 #include <vector>
@@ -130,9 +131,16 @@ class UdpTransport : public Transport {
                                    uint8_t* rx_data, size_t rx_length, int attempts,
                                    std::string* error);
 
+    // Sends |tx_data| as a run of packets keeping up to |window_size_| of them unacknowledged, for
+    // writes whose every response is an empty ACK. On a timeout only the packets that haven't
+    // been acknowledged yet are re-transmitted. Returns false and fills |error| on failure.
+    bool SendWindowed(Id id, const uint8_t* tx_data, size_t tx_length, int attempts,
+                      std::string* error);
+
     std::unique_ptr<Socket> socket_;
     int sequence_ = -1;
     size_t max_data_length_ = kMinPacketSize - kHeaderSize;
+    size_t window_size_ = 1;
     std::vector<uint8_t> rx_packet_;
 
     DISALLOW_COPY_AND_ASSIGN(UdpTransport);
@@ -168,11 +176,13 @@ bool UdpTransport::InitializeProtocol(std::string* error) {
     // The first two bytes contain the next expected sequence number.
     sequence_ = ExtractUint16(rx_data);
 
-    // Now send the initialization packet with our version and maximum packet size.
-    uint8_t init_data[] = {kProtocolVersion >> 8, kProtocolVersion & 0xFF,
-                           kHostMaxPacketSize >> 8, kHostMaxPacketSize & 0xFF};
-    rx_bytes = SendData(kIdInitialization, init_data, sizeof(init_data), rx_data, sizeof(rx_data),
-                        kMaxTransmissionAttempts, error);
+    // Now send the initialization packet with our version, maximum packet size and window size.
+    uint8_t init_data[] = {kProtocolVersion >> 8,   kProtocolVersion & 0xFF,
+                           kHostMaxPacketSize >> 8, kHostMaxPacketSize & 0xFF,
+                           kHostMaxWindowSize >> 8, kHostMaxWindowSize & 0xFF};
+    uint8_t init_rx_data[6];
+    rx_bytes = SendData(kIdInitialization, init_data, sizeof(init_data), init_rx_data,
+                        sizeof(init_rx_data), kMaxTransmissionAttempts, error);
     if (rx_bytes == -1) {
         return false;
     } else if (rx_bytes < 4) {
@@ -181,14 +191,15 @@ bool UdpTransport::InitializeProtocol(std::string* error) {
     }
 
     // The first two data bytes contain the version, the second two bytes contain the target max
-    // supported packet size, which must be at least 512 bytes.
-    uint16_t version = ExtractUint16(rx_data);
-    if (version < kProtocolVersion) {
+    // supported packet size, which must be at least 512 bytes. Version 2 targets may follow with
+    // their window size.
+    uint16_t version = ExtractUint16(init_rx_data);
+    if (version < kMinProtocolVersion) {
         *error = android::base::StringPrintf("target reported invalid protocol version %d",
                                              version);
         return false;
     }
-    uint16_t packet_size = ExtractUint16(rx_data + 2);
+    uint16_t packet_size = ExtractUint16(init_rx_data + 2);
     if (packet_size < kMinPacketSize) {
         *error = android::base::StringPrintf("target reported invalid packet size %d", packet_size);
         return false;
@@ -198,6 +209,12 @@ bool UdpTransport::InitializeProtocol(std::string* error) {
     max_data_length_ = packet_size - kHeaderSize;
     rx_packet_.resize(packet_size);
 
+    window_size_ = 1;
+    if (version >= kWindowedProtocolVersion && rx_bytes >= 6) {
+        uint16_t window_size = ExtractUint16(init_rx_data + 4);
+        window_size_ = std::max<uint16_t>(1, std::min(kHostMaxWindowSize, window_size));
+    }
+
     return true;
 }
 
@@ -210,6 +227,12 @@ ssize_t UdpTransport::SendData(Id id, const uint8_t* tx_data, size_t tx_length,
         return -1;
     }
 
+    // Multi-packet writes can be pipelined if the target negotiated a window.
+    if (window_size_ > 1 && rx_data == nullptr && rx_length == 0 && id == kIdFastboot &&
+        tx_length > max_data_length_) {
+        return SendWindowed(id, tx_data, tx_length, attempts, error) ? 0 : -1;
+    }
+
     Header header;
     size_t packet_data_length;
     ssize_t ret = 0;
@@ -324,6 +347,90 @@ ssize_t UdpTransport::SendSinglePacketHelper(
     return total_data_bytes;
 }
 
+bool UdpTransport::SendWindowed(Id id, const uint8_t* tx_data, size_t tx_length,
+                                const int attempts, std::string* error) {
+    error->clear();
+
+    size_t packet_count = (tx_length + max_data_length_ - 1) / max_data_length_;
+    uint16_t first_sequence = sequence_;
+    std::vector<bool> acked(packet_count, false);
+    // Packets before |base| are all acknowledged, packets from |next| on haven't been sent yet.
+    size_t base = 0;
+    size_t next = 0;
+
+    auto send_packet = [&](size_t index) {
+        Header header;
+        size_t offset = index * max_data_length_;
+        size_t length = std::min(max_data_length_, tx_length - offset);
+        header.Set(id, first_sequence + index,
+                   index + 1 < packet_count ? kFlagContinuation : kFlagNone);
+        if (!socket_->Send({{header.bytes(), kHeaderSize}, {tx_data + offset, length}})) {
+            *error = Socket::GetErrorMessage();
+            return false;
+        }
+        return true;
+    };
+
+    int attempts_left = attempts;
+    while (base < packet_count) {
+        for (; next < packet_count && next < base + window_size_; ++next) {
+            if (!send_packet(next)) {
+                return false;
+            }
+        }
+
+        ssize_t bytes = socket_->Receive(rx_packet_.data(), rx_packet_.size(), kResponseTimeoutMs);
+        if (bytes == -1) {
+            if (!socket_->ReceiveTimedOut()) {
+                *error = Socket::GetErrorMessage();
+                return false;
+            }
+            if (--attempts_left <= 0) {
+                *error = "no response from target";
+                return false;
+            }
+            for (size_t i = base; i < next; ++i) {
+                if (!acked[i] && !send_packet(i)) {
+                    return false;
+                }
+            }
+            continue;
+        } else if (bytes < static_cast<ssize_t>(kHeaderSize)) {
+            *error = "protocol error: incomplete header";
+            return false;
+        }
+
+        // Anything that isn't a response to a packet in flight is a stale duplicate.
+        uint16_t offset = ExtractUint16(&rx_packet_[kIndexSeqH]) -
+                          static_cast<uint16_t>(first_sequence + base);
+        if (offset >= next - base ||
+            (rx_packet_[kIndexId] != id && rx_packet_[kIndexId] != kIdError)) {
+            continue;
+        }
+
+        if (rx_packet_[kIndexId] == kIdError) {
+            // Error messages are short, so a continued one is reported as far as it got.
+            error->assign(rx_packet_.data() + kHeaderSize, rx_packet_.data() + bytes);
+            *error = "target reported error: " + *error;
+            return false;
+        } else if (bytes > static_cast<ssize_t>(kHeaderSize) ||
+                   (rx_packet_[kIndexFlags] & kFlagContinuation)) {
+            // UDP protocol error: only empty ACK packets are allowed when writing to a device.
+            *error = "target sent fastboot data out-of-turn";
+            return false;
+        }
+
+        acked[base + offset] = true;
+        while (base < packet_count && acked[base]) {
+            ++base;
+            attempts_left = attempts;
+        }
+    }
+
+    sequence_ = static_cast<uint16_t>(first_sequence + packet_count);
+    return true;
+}
+
 ssize_t UdpTransport::Read(void* data, size_t length) {
     // Read from the target by sending an empty packet.
     std::string error;
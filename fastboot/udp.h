@@ -45,10 +45,15 @@ std::unique_ptr<Transport> Connect(const std::string& hostname, int port, std::s
 // Internal namespace for test use only.
 namespace internal {
 
-constexpr uint16_t kProtocolVersion = 1;
+// The version the host sends. Version 2 adds the window size to the Init packet; version 1
+// targets are still accepted and are driven one packet at a time.
+constexpr uint16_t kProtocolVersion = 2;
+constexpr uint16_t kMinProtocolVersion = 1;
+constexpr uint16_t kWindowedProtocolVersion = 2;
 
-// This will be negotiated with the device so may end up being smaller.
+// These will be negotiated with the device so may end up being smaller.
 constexpr uint16_t kHostMaxPacketSize = 8192;
+constexpr uint16_t kHostMaxWindowSize = 32;
 
 // Retransmission constants. Retransmission timeout must be at least 500ms, and the host must
 // attempt to send packets for at least 1 minute once the device has connected. See
@@ -56,6 +56,17 @@ static std::string InitPacket(uint16_t sequence, uint16_t version, uint16_t max_
            PacketValue(version) + PacketValue(max_packet_size);
 }
 
+// Returns a version 2 Init packet, which adds a 2-byte |window_size|.
+static std::string InitPacket(uint16_t sequence, uint16_t version, uint16_t max_packet_size,
+                              uint16_t window_size) {
+    return InitPacket(sequence, version, max_packet_size) + PacketValue(window_size);
+}
+
+// Returns the Init packet the host sends.
+static std::string HostInitPacket(uint16_t sequence) {
+    return InitPacket(sequence, kProtocolVersion, kHostMaxPacketSize, kHostMaxWindowSize);
+}
+
 // Returns a Fastboot packet with |data|.
 static std::string FastbootPacket(uint16_t sequence, const std::string& data = "",
                                   char flags = kFlagNone) {
@@ -89,7 +100,7 @@ TEST_F(UdpConnectTest, InitializationSuccess) {
     for (uint16_t seq : kTestSequenceNumbers) {
         mock_socket_->ExpectSend(QueryPacket(0));
         mock_socket_->AddReceive(QueryPacket(0, seq));
-        mock_socket_->ExpectSend(InitPacket(seq, kProtocolVersion, kHostMaxPacketSize));
+        mock_socket_->ExpectSend(HostInitPacket(seq));
         mock_socket_->AddReceive(InitPacket(seq, kProtocolVersion, 1024));
 
         EXPECT_TRUE(UdpConnect());
@@ -103,7 +114,7 @@ TEST_F(UdpConnectTest, InitializationContinuationSuccess) {
     mock_socket_->ExpectSend(std::string{kIdDeviceQuery, kFlagNone, 0, 1});
     mock_socket_->AddReceive(std::string{kIdDeviceQuery, kFlagNone, 0, 1, 0x55});
 
-    mock_socket_->ExpectSend(InitPacket(0x4455, kProtocolVersion, kHostMaxPacketSize));
+    mock_socket_->ExpectSend(HostInitPacket(0x4455));
     mock_socket_->AddReceive(std::string{kIdInitialization, kFlagContinuation, 0x44, 0x55, 0});
     mock_socket_->ExpectSend(std::string{kIdInitialization, kFlagNone, 0x44, 0x56});
     mock_socket_->AddReceive(std::string{kIdInitialization, kFlagContinuation, 0x44, 0x56, 1});
@@ -121,14 +132,21 @@ TEST_F(UdpConnectTest, InitializationContinuationSuccess) {
 TEST_F(UdpConnectTest, InitializationVersionMismatch) {
     mock_socket_->ExpectSend(QueryPacket(0));
     mock_socket_->AddReceive(QueryPacket(0, 0));
-    mock_socket_->ExpectSend(InitPacket(0, kProtocolVersion, kHostMaxPacketSize));
-    mock_socket_->AddReceive(InitPacket(0, 2, 1024));
+    mock_socket_->ExpectSend(HostInitPacket(0));
+    mock_socket_->AddReceive(InitPacket(0, 3, 1024, 8));
+
+    EXPECT_TRUE(UdpConnect());
+
+    mock_socket_->ExpectSend(QueryPacket(0));
+    mock_socket_->AddReceive(QueryPacket(0, 0));
+    mock_socket_->ExpectSend(HostInitPacket(0));
+    mock_socket_->AddReceive(InitPacket(0, kMinProtocolVersion, 1024));
 
     EXPECT_TRUE(UdpConnect());
 
     mock_socket_->ExpectSend(QueryPacket(0));
     mock_socket_->AddReceive(QueryPacket(0, 0));
-    mock_socket_->ExpectSend(InitPacket(0, kProtocolVersion, kHostMaxPacketSize));
+    mock_socket_->ExpectSend(HostInitPacket(0));
     mock_socket_->AddReceive(InitPacket(0, 0, 1024));
 
     EXPECT_FALSE(UdpConnect());
@@ -154,7 +172,7 @@ TEST_F(UdpConnectTest, InitResponseTimeoutFailure) {
     mock_socket_->ExpectSend(QueryPacket(0));
     mock_socket_->AddReceive(QueryPacket(0, 0));
     for (int i = 0; i < kMaxTransmissionAttempts; ++i) {
-        mock_socket_->ExpectSend(InitPacket(0, kProtocolVersion, kHostMaxPacketSize));
+        mock_socket_->ExpectSend(HostInitPacket(0));
         mock_socket_->AddReceiveTimeout();
     }
 
@@ -164,7 +182,7 @@ TEST_F(UdpConnectTest, InitResponseTimeoutFailure) {
 TEST_F(UdpConnectTest, InitResponseReceiveFailure) {
     mock_socket_->ExpectSend(QueryPacket(0));
     mock_socket_->AddReceive(QueryPacket(0, 0));
-    mock_socket_->ExpectSend(InitPacket(0, kProtocolVersion, kHostMaxPacketSize));
+    mock_socket_->ExpectSend(HostInitPacket(0));
     mock_socket_->AddReceiveFailure();
 
     EXPECT_FALSE(UdpConnect());
@@ -182,10 +200,10 @@ TEST_F(UdpConnectTest, ResponseRecovery) {
 
     // Subsequent packets try up to (kMaxTransmissionAttempts - 1) times.
     for (int i = 0; i < kMaxTransmissionAttempts - 1; ++i) {
-        mock_socket_->ExpectSend(InitPacket(0, kProtocolVersion, kHostMaxPacketSize));
+        mock_socket_->ExpectSend(HostInitPacket(0));
         mock_socket_->AddReceiveTimeout();
     }
-    mock_socket_->ExpectSend(InitPacket(0, kProtocolVersion, kHostMaxPacketSize));
+    mock_socket_->ExpectSend(HostInitPacket(0));
     mock_socket_->AddReceive(InitPacket(0, kProtocolVersion, 1024));
 
     EXPECT_TRUE(UdpConnect());
@@ -195,7 +213,7 @@ TEST_F(UdpConnectTest, ResponseRecovery) {
 TEST_F(UdpConnectTest, ExtraResponseDataSuccess) {
     mock_socket_->ExpectSend(QueryPacket(0));
     mock_socket_->AddReceive(QueryPacket(0, 0) + "foo");
-    mock_socket_->ExpectSend(InitPacket(0, kProtocolVersion, kHostMaxPacketSize));
+    mock_socket_->ExpectSend(HostInitPacket(0));
     mock_socket_->AddReceive(InitPacket(0, kProtocolVersion, 1024) + "bar");
 
     EXPECT_TRUE(UdpConnect());
@@ -208,7 +226,7 @@ TEST_F(UdpConnectTest, WrongSequenceRecovery) {
     mock_socket_->AddReceive(QueryPacket(1, 0));
     mock_socket_->AddReceive(QueryPacket(0, 0));
 
-    mock_socket_->ExpectSend(InitPacket(0, kProtocolVersion, kHostMaxPacketSize));
+    mock_socket_->ExpectSend(HostInitPacket(0));
     mock_socket_->AddReceive(InitPacket(1, kProtocolVersion, 1024));
     mock_socket_->AddReceive(InitPacket(0, kProtocolVersion, 1024));
 
@@ -221,7 +239,7 @@ TEST_F(UdpConnectTest, WrongIdRecovery) {
     mock_socket_->AddReceive(FastbootPacket(0));
     mock_socket_->AddReceive(QueryPacket(0, 0));
 
-    mock_socket_->ExpectSend(InitPacket(0, kProtocolVersion, kHostMaxPacketSize));
+    mock_socket_->ExpectSend(HostInitPacket(0));
     mock_socket_->AddReceive(FastbootPacket(0));
     mock_socket_->AddReceive(InitPacket(0, kProtocolVersion, 1024));
 
@@ -251,7 +269,7 @@ TEST_F(UdpConnectTest, InvalidInitResponseFailure) {
 
     mock_socket_->ExpectSend(QueryPacket(0));
     mock_socket_->AddReceive(QueryPacket(0, 0));
-    mock_socket_->ExpectSend(InitPacket(0, kProtocolVersion, kHostMaxPacketSize));
+    mock_socket_->ExpectSend(HostInitPacket(0));
     mock_socket_->AddReceive(InitPacket(0, kProtocolVersion, 511));
 
     EXPECT_FALSE(UdpConnect(&error));
@@ -259,7 +277,7 @@ TEST_F(UdpConnectTest, InvalidInitResponseFailure) {
 
     mock_socket_->ExpectSend(QueryPacket(0));
     mock_socket_->AddReceive(QueryPacket(0, 0));
-    mock_socket_->ExpectSend(InitPacket(0, kProtocolVersion, kHostMaxPacketSize));
+    mock_socket_->ExpectSend(HostInitPacket(0));
     mock_socket_->AddReceive(InitPacket(0, 0, 1024));
 
     EXPECT_FALSE(UdpConnect(&error));
@@ -277,7 +295,7 @@ TEST_F(UdpConnectTest, ErrorResponseFailure) {
 
     mock_socket_->ExpectSend(QueryPacket(0));
     mock_socket_->AddReceive(QueryPacket(0, 0));
-    mock_socket_->ExpectSend(InitPacket(0, kProtocolVersion, kHostMaxPacketSize));
+    mock_socket_->ExpectSend(HostInitPacket(0));
     mock_socket_->AddReceive(ErrorPacket(0, "error2"));
 
     EXPECT_FALSE(UdpConnect(&error));
@@ -309,15 +327,21 @@ class UdpTest : public ::testing::Test {
     }
 
     // Sets up |mock_socket_| to correctly initialize the protocol and creates |transport_|. This
-    // can be called multiple times in a test if needed.
-    bool InitializeTransport(uint16_t starting_sequence, int device_max_packet_size = 512) {
+    // can be called multiple times in a test if needed. A |device_window_size| of 0 leaves the
+    // window size out of the response, as a version 1 device would.
+    bool InitializeTransport(uint16_t starting_sequence, int device_max_packet_size = 512,
+                             uint16_t device_window_size = 0) {
         mock_socket_ = new SocketMock;
         mock_socket_->ExpectSend(QueryPacket(0));
         mock_socket_->AddReceive(QueryPacket(0, starting_sequence));
-        mock_socket_->ExpectSend(
-                InitPacket(starting_sequence, kProtocolVersion, kHostMaxPacketSize));
-        mock_socket_->AddReceive(
-                InitPacket(starting_sequence, kProtocolVersion, device_max_packet_size));
+        mock_socket_->ExpectSend(HostInitPacket(starting_sequence));
+        if (device_window_size == 0) {
+            mock_socket_->AddReceive(
+                    InitPacket(starting_sequence, kProtocolVersion, device_max_packet_size));
+        } else {
+            mock_socket_->AddReceive(InitPacket(starting_sequence, kProtocolVersion,
+                                                device_max_packet_size, device_window_size));
+        }
 
         std::string error;
         transport_ = Connect(std::unique_ptr<Socket>(mock_socket_), &error);
@@ -529,3 +553,138 @@ TEST_F(UdpTest, CloseTransport) {
     EXPECT_EQ(-1, transport_->Write("foo", 3));
     EXPECT_EQ(-1, transport_->Read(buffer, sizeof(buffer)));
 }
+
+// Returns |count| chunks of distinct data, each filling a packet of |max_packet_size| bytes.
+static std::vector<std::string> MakeChunks(size_t count, size_t max_packet_size = 512) {
+    std::vector<std::string> chunks;
+    for (size_t i = 0; i < count; ++i) {
+        chunks.emplace_back(max_packet_size - 4, static_cast<char>('a' + i));
+    }
+    return chunks;
+}
+
+// Tests that a write keeps up to the negotiated window of packets in flight.
+TEST_F(UdpTest, WindowedWrite) {
+    ASSERT_TRUE(InitializeTransport(0, 512, 2));
+    std::vector<std::string> chunks = MakeChunks(3);
+
+    mock_socket_->ExpectSend(FastbootPacket(1, chunks[0], kFlagContinuation));
+    mock_socket_->ExpectSend(FastbootPacket(2, chunks[1], kFlagContinuation));
+    mock_socket_->AddReceive(FastbootPacket(1));
+    mock_socket_->ExpectSend(FastbootPacket(3, chunks[2]));
+    mock_socket_->AddReceive(FastbootPacket(2));
+    mock_socket_->AddReceive(FastbootPacket(3));
+    EXPECT_TRUE(Write(chunks[0] + chunks[1] + chunks[2]));
+
+    // The sequence carries on after the window, and small writes and reads are not pipelined.
+    mock_socket_->ExpectSend(FastbootPacket(4, "foo"));
+    mock_socket_->AddReceive(FastbootPacket(4));
+    EXPECT_TRUE(Write("foo"));
+    mock_socket_->ExpectSend(FastbootPacket(5));
+    mock_socket_->AddReceive(FastbootPacket(5, "bar"));
+    EXPECT_TRUE(Read("bar"));
+}
+
+// Tests that the window size is capped to what the host supports.
+TEST_F(UdpTest, WindowSizeLimit) {
+    ASSERT_TRUE(InitializeTransport(0, 512, 0xFFFF));
+    std::vector<std::string> chunks = MakeChunks(kHostMaxWindowSize + 1);
+
+    std::string data;
+    for (size_t i = 0; i < chunks.size(); ++i) {
+        data += chunks[i];
+        if (i < kHostMaxWindowSize) {
+            mock_socket_->ExpectSend(FastbootPacket(i + 1, chunks[i], kFlagContinuation));
+        }
+    }
+    mock_socket_->AddReceive(FastbootPacket(1));
+    mock_socket_->ExpectSend(FastbootPacket(kHostMaxWindowSize + 1, chunks.back()));
+    for (size_t i = 1; i < chunks.size(); ++i) {
+        mock_socket_->AddReceive(FastbootPacket(i + 1));
+    }
+    EXPECT_TRUE(Write(data));
+}
+
+// Tests that a timeout only re-transmits the packets that haven't been acknowledged, and that
+// ACKs may arrive in any order.
+TEST_F(UdpTest, WindowedSelectiveRetransmit) {
+    ASSERT_TRUE(InitializeTransport(0, 512, 4));
+    std::vector<std::string> chunks = MakeChunks(4);
+
+    mock_socket_->ExpectSend(FastbootPacket(1, chunks[0], kFlagContinuation));
+    mock_socket_->ExpectSend(FastbootPacket(2, chunks[1], kFlagContinuation));
+    mock_socket_->ExpectSend(FastbootPacket(3, chunks[2], kFlagContinuation));
+    mock_socket_->ExpectSend(FastbootPacket(4, chunks[3]));
+    mock_socket_->AddReceive(FastbootPacket(3));
+    mock_socket_->AddReceive(FastbootPacket(2));
+    mock_socket_->AddReceiveTimeout();
+    mock_socket_->ExpectSend(FastbootPacket(1, chunks[0], kFlagContinuation));
+    mock_socket_->ExpectSend(FastbootPacket(4, chunks[3]));
+    mock_socket_->AddReceive(FastbootPacket(1));
+    // Duplicate and stale ACKs are ignored.
+    mock_socket_->AddReceive(FastbootPacket(3));
+    mock_socket_->AddReceive(FastbootPacket(0));
+    mock_socket_->AddReceive(FastbootPacket(4));
+    EXPECT_TRUE(Write(chunks[0] + chunks[1] + chunks[2] + chunks[3]));
+}
+
+// Tests a windowed write across the sequence number wrap.
+TEST_F(UdpTest, WindowedSequenceWrap) {
+    ASSERT_TRUE(InitializeTransport(0xFFFE, 512, 4));
+    std::vector<std::string> chunks = MakeChunks(3);
+
+    mock_socket_->ExpectSend(FastbootPacket(0xFFFF, chunks[0], kFlagContinuation));
+    mock_socket_->ExpectSend(FastbootPacket(0x0000, chunks[1], kFlagContinuation));
+    mock_socket_->ExpectSend(FastbootPacket(0x0001, chunks[2]));
+    mock_socket_->AddReceive(FastbootPacket(0x0001));
+    mock_socket_->AddReceive(FastbootPacket(0xFFFF));
+    mock_socket_->AddReceive(FastbootPacket(0x0000));
+    EXPECT_TRUE(Write(chunks[0] + chunks[1] + chunks[2]));
+
+    mock_socket_->ExpectSend(FastbootPacket(0x0002, "foo"));
+    mock_socket_->AddReceive(FastbootPacket(0x0002));
+    EXPECT_TRUE(Write("foo"));
+}
+
+// Tests the failures during a windowed write.
+TEST_F(UdpTest, WindowedWriteFailures) {
+    std::vector<std::string> chunks = MakeChunks(2);
+    std::string data = chunks[0] + chunks[1];
+
+    // An error for any packet in flight aborts the write.
+    ASSERT_TRUE(InitializeTransport(0, 512, 2));
+    mock_socket_->ExpectSend(FastbootPacket(1, chunks[0], kFlagContinuation));
+    mock_socket_->ExpectSend(FastbootPacket(2, chunks[1]));
+    mock_socket_->AddReceive(ErrorPacket(2, "test error"));
+    EXPECT_FALSE(Write(data));
+
+    // ACKs may not carry data.
+    ASSERT_TRUE(InitializeTransport(0, 512, 2));
+    mock_socket_->ExpectSend(FastbootPacket(1, chunks[0], kFlagContinuation));
+    mock_socket_->ExpectSend(FastbootPacket(2, chunks[1]));
+    mock_socket_->AddReceive(FastbootPacket(1, "foo"));
+    EXPECT_FALSE(Write(data));
+
+    // Receive failures abort too.
+    ASSERT_TRUE(InitializeTransport(0, 512, 2));
+    mock_socket_->ExpectSend(FastbootPacket(1, chunks[0], kFlagContinuation));
+    mock_socket_->ExpectSend(FastbootPacket(2, chunks[1]));
+    mock_socket_->AddReceiveFailure();
+    EXPECT_FALSE(Write(data));
+}
+
+// Tests giving up on a windowed write after the maximum number of attempts.
+TEST_F(UdpTest, WindowedTimeoutFailure) {
+    ASSERT_TRUE(InitializeTransport(0, 512, 2));
+    std::vector<std::string> chunks = MakeChunks(2);
+
+    mock_socket_->ExpectSend(FastbootPacket(1, chunks[0], kFlagContinuation));
+    mock_socket_->ExpectSend(FastbootPacket(2, chunks[1]));
+    mock_socket_->AddReceive(FastbootPacket(2));
+    for (int i = 1; i < kMaxTransmissionAttempts; ++i) {
+        mock_socket_->AddReceiveTimeout();
+        mock_socket_->ExpectSend(FastbootPacket(1, chunks[0], kFlagContinuation));
+    }
+    mock_socket_->AddReceiveTimeout();
+    EXPECT_FALSE(Write(chunks[0] + chunks[1]));
+}
@@ -0,0 +1,119 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <fs_mgr/file_wait.h>
+
+#include <errno.h>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <thread>
+
+#include <android-base/file.h>
+#include <android-base/logging.h>
+#include <android-base/unique_fd.h>
+
+namespace android {
+namespace fs_mgr {
+
+using namespace std::chrono_literals;
+using android::base::unique_fd;
+
+static bool FileExists(const std::string& path) {
+    return access(path.c_str(), F_OK) == 0 || errno != ENOENT;
+}
+
+// Returns the closest ancestor of |path| that currently exists. Watching it
+// catches the creation of whichever missing directory lies on the way to
+// |path|, after which the watch is moved one level down.
+static std::string ExistingAncestor(const std::string& path) {
+    std::string dir = android::base::Dirname(path);
+    while (dir != "/" && dir != "." && !FileExists(dir)) {
+        dir = android::base::Dirname(dir);
+    }
+    return dir;
+}
+
+static bool WaitForFilesImpl(const std::vector<std::string>& paths,
+                             const std::chrono::milliseconds& relative_timeout, bool deleted) {
+    auto start_time = std::chrono::steady_clock::now();
+
+    unique_fd inotify_fd(inotify_init1(IN_CLOEXEC | IN_NONBLOCK));
+    if (inotify_fd < 0) {
+        PLOG(WARNING) << "inotify_init1 failed, falling back to polling";
+    }
+    uint32_t mask = deleted ? (IN_DELETE | IN_MOVED_FROM) : (IN_CREATE | IN_MOVED_TO);
+
+    std::vector<std::string> pending = paths;
+    while (true) {
+        // Watches are (re-)added before checking the files, so that a file
+        // created in between the check and the poll still wakes us up.
+        if (inotify_fd >= 0) {
+            for (const auto& path : pending) {
+                std::string dir = deleted ? android::base::Dirname(path) : ExistingAncestor(path);
+                if (inotify_add_watch(inotify_fd, dir.c_str(), mask) < 0 && errno != ENOENT) {
+                    PLOG(WARNING) << "inotify_add_watch failed for " << dir
+                                  << ", falling back to polling";
+                    inotify_fd.reset();
+                    break;
+                }
+            }
+        }
+
+        pending.erase(std::remove_if(pending.begin(), pending.end(),
+                                     [deleted](const std::string& path) {
+                                         return FileExists(path) != deleted;
+                                     }),
+                      pending.end());
+        if (pending.empty()) return true;
+
+        auto remaining = relative_timeout - (std::chrono::steady_clock::now() - start_time);
+        if (remaining <= 0ms) return false;
+        auto remaining_ms = std::chrono::ceil<std::chrono::milliseconds>(remaining);
+
+        if (inotify_fd < 0) {
+            std::this_thread::sleep_for(std::min(remaining_ms, 10ms));
+            continue;
+        }
+
+        struct pollfd pfd = {.fd = inotify_fd, .events = POLLIN, .revents = 0};
+        int rv = TEMP_FAILURE_RETRY(poll(&pfd, 1, remaining_ms.count()));
+        if (rv < 0) {
+            PLOG(ERROR) << "poll on inotify fd failed";
+            return false;
+        }
+        // Every pending path is re-checked, so the events themselves only
+        // need to be drained.
+        char buffer[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+        while (read(inotify_fd, buffer, sizeof(buffer)) > 0) {
+        }
+    }
+}
+
+bool WaitForFiles(const std::vector<std::string>& paths,
+                  const std::chrono::milliseconds& relative_timeout) {
+    return WaitForFilesImpl(paths, relative_timeout, false);
+}
+
+bool WaitForFilesDeleted(const std::vector<std::string>& paths,
+                         const std::chrono::milliseconds& relative_timeout) {
+    return WaitForFilesImpl(paths, relative_timeout, true);
+}
+
+}  // namespace fs_mgr
+}  // namespace android
@@ -34,11 +34,12 @@
 #include <time.h>
 #include <unistd.h>
 
+#include <algorithm>
 #include <functional>
+#include <future>
 #include <map>
 #include <memory>
 #include <string>
-#include <thread>
 #include <utility>
 #include <vector>
 
@@ -56,6 +57,7 @@
 #include <ext4_utils/ext4_utils.h>
 #include <ext4_utils/wipe.h>
 #include <fs_avb/fs_avb.h>
+#include <fs_mgr/file_wait.h>
 #include <fs_mgr_overlayfs.h>
 #include <libdm/dm.h>
 #include <liblp/metadata_format.h>
@@ -115,26 +117,19 @@ enum FsStatFlags {
     FS_STAT_ENABLE_VERITY_FAILED = 0x80000,
 };
 
-// TODO: switch to inotify()
 bool fs_mgr_wait_for_file(const std::string& filename,
                           const std::chrono::milliseconds relative_timeout,
                           FileWaitMode file_wait_mode) {
-    auto start_time = std::chrono::steady_clock::now();
-
-    while (true) {
-        int rv = access(filename.c_str(), F_OK);
-        if (file_wait_mode == FileWaitMode::Exists) {
-            if (!rv || errno != ENOENT) return true;
-        } else if (file_wait_mode == FileWaitMode::DoesNotExist) {
-            if (rv && errno == ENOENT) return true;
-        }
-
-        std::this_thread::sleep_for(50ms);
+    return fs_mgr_wait_for_files({filename}, relative_timeout, file_wait_mode);
+}
 
-        auto now = std::chrono::steady_clock::now();
-        auto time_elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(now - start_time);
-        if (time_elapsed > relative_timeout) return false;
+bool fs_mgr_wait_for_files(const std::vector<std::string>& filenames,
+                           const std::chrono::milliseconds relative_timeout,
+                           FileWaitMode file_wait_mode) {
+    if (file_wait_mode == FileWaitMode::DoesNotExist) {
+        return android::fs_mgr::WaitForFilesDeleted(filenames, relative_timeout);
     }
+    return android::fs_mgr::WaitForFiles(filenames, relative_timeout);
 }
 
 static void log_fs_stat(const std::string& blk_device, int fs_stat) {
@@ -663,9 +658,12 @@ static bool fs_match(const std::string& in1, const std::string& in2) {
 // end_idx: On return, will be the last entry that was looked at.
 // attempted_idx: On return, will indicate which fstab entry
 //     succeeded. In case of failure, it will be the start_idx.
+// checks: Results of prepare_fs_for_mount() already running for some
+//     entries, by index. Those are used, and removed, instead of checking
+//     the entry again.
 // Sets errno to match the 1st mount failure on failure.
 static bool mount_with_alternatives(const Fstab& fstab, int start_idx, int* end_idx,
-                                    int* attempted_idx) {
+                                    int* attempted_idx, std::map<int, std::future<int>>* checks) {
     unsigned long i;
     int mount_errno = 0;
     bool mounted = false;
@@ -684,7 +682,13 @@ static bool mount_with_alternatives(const Fstab& fstab, int start_idx, int* end_
             continue;
         }
 
-        int fs_stat = prepare_fs_for_mount(fstab[i].blk_device, fstab[i]);
+        int fs_stat;
+        if (auto check = checks->find(i); check != checks->end()) {
+            fs_stat = check->second.get();
+            checks->erase(check);
+        } else {
+            fs_stat = prepare_fs_for_mount(fstab[i].blk_device, fstab[i]);
+        }
         if (fs_stat & FS_STAT_INVALID_MAGIC) {
             LERROR << __FUNCTION__
                    << "(): skipping mount due to invalid magic, mountpoint=" << fstab[i].mount_point
@@ -1016,6 +1020,73 @@ static bool IsMountPointMounted(const std::string& mount_point) {
     return it != fstab.end();
 }
 
+// Entries that fs_mgr_mount_all() never mounts, whatever their state.
+static bool IsSkippedByMountAll(const FstabEntry& entry, int mount_mode) {
+    // Don't mount entries that are managed by vold or not for the mount mode.
+    if (entry.fs_mgr_flags.vold_managed || entry.fs_mgr_flags.recovery_only ||
+        ((mount_mode == MOUNT_MODE_LATE) && !entry.fs_mgr_flags.late_mount) ||
+        ((mount_mode == MOUNT_MODE_EARLY) && entry.fs_mgr_flags.late_mount)) {
+        return true;
+    }
+
+    // Skip swap and raw partition entries such as boot, recovery, etc.
+    return entry.fs_type == "swap" || entry.fs_type == "emmc" || entry.fs_type == "mtd";
+}
+
+// Whether |path| is |dir| or inside of it.
+static bool IsInMountPoint(const std::string& path, const std::string& dir) {
+    if (!StartsWith(path, dir)) {
+        return false;
+    }
+    return path.size() == dir.size() || dir.back() == '/' || path[dir.size()] == '/';
+}
+
+// Starts prepare_fs_for_mount() in the background for the entries that
+// fs_mgr_mount_all() mounts straight from their block device, so that fsck of
+// independent partitions after an unclean shutdown runs in parallel instead of
+// one after the other. Entries whose block device is set up in the mount loop
+// (labels, logical partitions, verity, block checkpoints), first stage
+// entries and entries nested inside one of the other mount points (their
+// check needs the parent to be mounted) are left to the loop. Only the first
+// of several alternatives for a mount point is checked.
+static std::map<int, std::future<int>> CheckFilesystemsAhead(const Fstab& fstab, int mount_mode) {
+    std::map<int, std::future<int>> checks;
+    if (!android::base::GetBoolProperty("ro.fs_mgr.parallel_check", false)) {
+        return checks;
+    }
+
+    auto mounted_here = [&](const FstabEntry& entry) {
+        return !entry.fs_mgr_flags.first_stage_mount && !IsSkippedByMountAll(entry, mount_mode) &&
+               entry.mount_point != "/" && entry.mount_point != "/system";
+    };
+    for (size_t i = 0; i < fstab.size(); i++) {
+        const auto& entry = fstab[i];
+        if ((i > 0 && fstab[i - 1].mount_point == entry.mount_point) || !mounted_here(entry) ||
+            StartsWith(entry.blk_device, "LABEL=") || entry.fs_mgr_flags.logical ||
+            entry.fs_mgr_flags.avb || entry.fs_mgr_flags.verify ||
+            entry.fs_mgr_flags.checkpoint_blk) {
+            continue;
+        }
+        if (std::any_of(fstab.begin(), fstab.end(), [&](const auto& other) {
+                return other.mount_point != entry.mount_point && mounted_here(other) &&
+                       IsInMountPoint(entry.mount_point, other.mount_point);
+            })) {
+            continue;
+        }
+
+        // The mount loop updates its entries while this runs, so use a copy.
+        checks.emplace(i, std::async(std::launch::async, [entry]() {
+                           // If the device doesn't show up, the mount loop skips the entry.
+                           if (entry.fs_mgr_flags.wait &&
+                               !fs_mgr_wait_for_file(entry.blk_device, 20s)) {
+                               return 0;
+                           }
+                           return prepare_fs_for_mount(entry.blk_device, entry);
+                       }));
+    }
+    return checks;
+}
+
 // When multiple fstab records share the same mount_point, it will try to mount each
 // one in turn, and ignore any duplicates after a first successful mount.
 // Returns -1 on error, and  FS_MGR_MNTALL_* otherwise.
@@ -1029,6 +1100,8 @@ int fs_mgr_mount_all(Fstab* fstab, int mount_mode) {
         return FS_MGR_MNTALL_FAIL;
     }
 
+    auto checks = CheckFilesystemsAhead(*fstab, mount_mode);
+
     for (size_t i = 0; i < fstab->size(); i++) {
         auto& current_entry = (*fstab)[i];
 
@@ -1042,16 +1115,7 @@ int fs_mgr_mount_all(Fstab* fstab, int mount_mode) {
             continue;
         }
 
-        // Don't mount entries that are managed by vold or not for the mount mode.
-        if (current_entry.fs_mgr_flags.vold_managed || current_entry.fs_mgr_flags.recovery_only ||
-            ((mount_mode == MOUNT_MODE_LATE) && !current_entry.fs_mgr_flags.late_mount) ||
-            ((mount_mode == MOUNT_MODE_EARLY) && current_entry.fs_mgr_flags.late_mount)) {
-            continue;
-        }
-
-        // Skip swap and raw partition entries such as boot, recovery, etc.
-        if (current_entry.fs_type == "swap" || current_entry.fs_type == "emmc" ||
-            current_entry.fs_type == "mtd") {
+        if (IsSkippedByMountAll(current_entry, mount_mode)) {
             continue;
         }
 
@@ -1119,7 +1183,8 @@ int fs_mgr_mount_all(Fstab* fstab, int mount_mode) {
         int top_idx = i;
         int attempted_idx = -1;
 
-        bool mret = mount_with_alternatives(*fstab, i, &last_idx_inspected, &attempted_idx);
+        bool mret =
+                mount_with_alternatives(*fstab, i, &last_idx_inspected, &attempted_idx, &checks);
         auto& attempted_entry = (*fstab)[attempted_idx];
         i = last_idx_inspected;
         int mount_errno = errno;
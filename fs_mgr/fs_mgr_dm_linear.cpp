@@ -154,16 +154,43 @@ std::unique_ptr<LpMetadata> ReadCurrentMetadata(const std::string& block_device)
 }
 
 bool CreateLogicalPartitions(const LpMetadata& metadata, const std::string& super_device) {
+    return CreateLogicalPartitions(metadata, super_device, {});
+}
+
+bool CreateLogicalPartitions(const LpMetadata& metadata, const std::string& super_device,
+                             const std::chrono::milliseconds& timeout_ms) {
+    std::vector<std::unique_ptr<DmTable>> tables;
+    std::vector<std::pair<std::string, const DmTable*>> devices;
     for (const auto& partition : metadata.partitions) {
         if (!partition.num_extents) {
             LINFO << "Skipping zero-length logical partition: " << GetPartitionName(partition);
             continue;
         }
-        std::string path;
-        if (!CreateLogicalPartition(metadata, partition, false, {}, super_device, &path)) {
+        auto table = std::make_unique<DmTable>();
+        if (!CreateDmTable(metadata, partition, super_device, table.get())) {
             LERROR << "Could not create logical partition: " << GetPartitionName(partition);
             return false;
         }
+        devices.emplace_back(GetPartitionName(partition), table.get());
+        tables.emplace_back(std::move(table));
+    }
+
+    DeviceMapper& dm = DeviceMapper::Instance();
+    std::vector<std::string> paths;
+    if (!dm.CreateDevices(devices, &paths)) {
+        LERROR << "Could not create logical partitions";
+        return false;
+    }
+    if (timeout_ms > std::chrono::milliseconds::zero() &&
+        !fs_mgr_wait_for_files(paths, timeout_ms, FileWaitMode::Exists)) {
+        for (const auto& device : devices) {
+            DestroyLogicalPartition(device.first, {});
+        }
+        LERROR << "Timed out waiting for logical partition device paths";
+        return false;
+    }
+    for (size_t i = 0; i < devices.size(); i++) {
+        LINFO << "Created logical partition " << devices[i].first << " on device " << paths[i];
     }
     return true;
 }
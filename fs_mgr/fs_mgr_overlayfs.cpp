@@ -245,13 +245,21 @@ bool fs_mgr_rw_access(const std::string& path) {
     return ret;
 }
 
-bool fs_mgr_overlayfs_already_mounted(const std::string& mount_point, bool overlay_only = true) {
-    Fstab fstab;
-    if (!ReadFstabFromFile("/proc/mounts", &fstab)) {
-        return false;
+// Snapshot of /proc/mounts. Callers that check several mount points in a row
+// read it once and hand it to fs_mgr_overlayfs_already_mounted() instead of
+// re-parsing the mount table for every candidate.
+Fstab fs_mgr_overlayfs_mounts() {
+    Fstab mounts;
+    if (!ReadFstabFromFile("/proc/mounts", &mounts)) {
+        return {};
     }
+    return mounts;
+}
+
+bool fs_mgr_overlayfs_already_mounted(const Fstab& mounts, const std::string& mount_point,
+                                      bool overlay_only = true) {
     const auto lowerdir = kLowerdirOption + mount_point;
-    for (const auto& entry : fstab) {
+    for (const auto& entry : mounts) {
         if (overlay_only && "overlay" != entry.fs_type && "overlayfs" != entry.fs_type) continue;
         if (mount_point != entry.mount_point) continue;
         if (!overlay_only) return true;
@@ -265,6 +273,10 @@ bool fs_mgr_overlayfs_already_mounted(const std::string& mount_point, bool overl
     return false;
 }
 
+bool fs_mgr_overlayfs_already_mounted(const std::string& mount_point, bool overlay_only = true) {
+    return fs_mgr_overlayfs_already_mounted(fs_mgr_overlayfs_mounts(), mount_point, overlay_only);
+}
+
 std::vector<std::string> fs_mgr_overlayfs_verity_enabled_list() {
     std::vector<std::string> ret;
     auto save_errno = errno;
@@ -791,9 +803,10 @@ bool fs_mgr_overlayfs_setup_scratch(const Fstab& fstab, bool* change) {
     return fs_mgr_overlayfs_mount_scratch(scratch_device, mnt_type);
 }
 
-bool fs_mgr_overlayfs_scratch_can_be_mounted(const std::string& scratch_device) {
+bool fs_mgr_overlayfs_scratch_can_be_mounted(const Fstab& mounts,
+                                              const std::string& scratch_device) {
     if (scratch_device.empty()) return false;
-    if (fs_mgr_overlayfs_already_mounted(kScratchMountPoint, false)) return false;
+    if (fs_mgr_overlayfs_already_mounted(mounts, kScratchMountPoint, false)) return false;
     if (android::base::StartsWith(scratch_device, kPhysicalDevice)) return true;
     if (fs_mgr_rw_access(scratch_device)) return true;
     auto slot_number = fs_mgr_overlayfs_slot_number();
@@ -820,13 +833,16 @@ bool fs_mgr_overlayfs_mount_all(Fstab* fstab) {
     auto ret = false;
     if (fs_mgr_overlayfs_invalid()) return ret;
 
+    // Mounting an overlay only adds an entry for its own mount point, so one
+    // snapshot of the mount table stays accurate for the whole candidate list.
+    const auto mounts = fs_mgr_overlayfs_mounts();
     auto scratch_can_be_mounted = true;
     for (const auto& mount_point : fs_mgr_candidate_list(fstab)) {
-        if (fs_mgr_overlayfs_already_mounted(mount_point)) continue;
+        if (fs_mgr_overlayfs_already_mounted(mounts, mount_point)) continue;
         if (scratch_can_be_mounted) {
             scratch_can_be_mounted = false;
             auto scratch_device = fs_mgr_overlayfs_scratch_device();
-            if (fs_mgr_overlayfs_scratch_can_be_mounted(scratch_device) &&
+            if (fs_mgr_overlayfs_scratch_can_be_mounted(mounts, scratch_device) &&
                 fs_mgr_wait_for_file(scratch_device, 10s)) {
                 const auto mount_type = fs_mgr_overlayfs_scratch_mount_type();
                 if (fs_mgr_overlayfs_mount_scratch(scratch_device, mount_type,
@@ -853,10 +869,11 @@ std::vector<std::string> fs_mgr_overlayfs_required_devices(Fstab* fstab) {
         return {};
     }
 
+    const auto mounts = fs_mgr_overlayfs_mounts();
     for (const auto& mount_point : fs_mgr_candidate_list(fstab)) {
-        if (fs_mgr_overlayfs_already_mounted(mount_point)) continue;
+        if (fs_mgr_overlayfs_already_mounted(mounts, mount_point)) continue;
         auto device = fs_mgr_overlayfs_scratch_device();
-        if (!fs_mgr_overlayfs_scratch_can_be_mounted(device)) break;
+        if (!fs_mgr_overlayfs_scratch_can_be_mounted(mounts, device)) break;
         return {device};
     }
     return {};
@@ -955,14 +972,15 @@ bool fs_mgr_overlayfs_teardown(const char* mount_point, bool* change) {
 }
 
 bool fs_mgr_overlayfs_is_setup() {
-    if (fs_mgr_overlayfs_already_mounted(kScratchMountPoint, false)) return true;
+    const auto mounts = fs_mgr_overlayfs_mounts();
+    if (fs_mgr_overlayfs_already_mounted(mounts, kScratchMountPoint, false)) return true;
     Fstab fstab;
     if (!ReadDefaultFstab(&fstab)) {
         return false;
     }
     if (fs_mgr_overlayfs_invalid()) return false;
     for (const auto& mount_point : fs_mgr_candidate_list(&fstab)) {
-        if (fs_mgr_overlayfs_already_mounted(mount_point)) return true;
+        if (fs_mgr_overlayfs_already_mounted(mounts, mount_point)) return true;
     }
     return false;
 }
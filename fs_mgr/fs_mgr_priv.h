@@ -19,6 +19,7 @@
 
 #include <chrono>
 #include <string>
+#include <vector>
 
 #include <android-base/logging.h>
 #include <fs_mgr.h>
@@ -141,6 +142,10 @@ enum class FileWaitMode { Exists, DoesNotExist };
 bool fs_mgr_wait_for_file(const std::string& filename,
                           const std::chrono::milliseconds relative_timeout,
                           FileWaitMode wait_mode = FileWaitMode::Exists);
+// Same as above, but waits for a whole set of files against a single deadline.
+bool fs_mgr_wait_for_files(const std::vector<std::string>& filenames,
+                           const std::chrono::milliseconds relative_timeout,
+                           FileWaitMode wait_mode = FileWaitMode::Exists);
 
 bool fs_mgr_set_blk_ro(const std::string& blockdev, bool readonly = true);
 bool fs_mgr_update_for_slotselect(Fstab* fstab);
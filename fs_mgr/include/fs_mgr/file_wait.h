@@ -0,0 +1,48 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+namespace android {
+namespace fs_mgr {
+
+// Wait at most |relative_timeout| for every path in |paths| to exist. The
+// parent directories do not need to exist yet. Waiting is done with inotify,
+// so the caller wakes up as soon as the last file is created rather than on
+// the next tick of a polling loop. Returns false on timeout.
+bool WaitForFiles(const std::vector<std::string>& paths,
+                  const std::chrono::milliseconds& relative_timeout);
+
+// Same as above, but waits for every path in |paths| to not exist.
+bool WaitForFilesDeleted(const std::vector<std::string>& paths,
+                         const std::chrono::milliseconds& relative_timeout);
+
+inline bool WaitForFile(const std::string& path,
+                        const std::chrono::milliseconds& relative_timeout) {
+    return WaitForFiles({path}, relative_timeout);
+}
+
+inline bool WaitForFileDeleted(const std::string& path,
+                               const std::chrono::milliseconds& relative_timeout) {
+    return WaitForFilesDeleted({path}, relative_timeout);
+}
+
+}  // namespace fs_mgr
+}  // namespace android
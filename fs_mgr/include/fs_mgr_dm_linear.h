@@ -45,6 +45,12 @@ std::unique_ptr<LpMetadata> ReadCurrentMetadata(const std::string& block_device)
 // metadata must have been read from the current slot.
 bool CreateLogicalPartitions(const LpMetadata& metadata, const std::string& block_device);
 
+// Same as above, but if |timeout_ms| is non-zero, block for up to that long
+// until the device paths of all partitions are available. The devices are all
+// created first and then waited for together, rather than one at a time.
+bool CreateLogicalPartitions(const LpMetadata& metadata, const std::string& block_device,
+                             const std::chrono::milliseconds& timeout_ms);
+
 // Create block devices for all logical partitions. This is a convenience
 // method for ReadMetadata and CreateLogicalPartitions.
 bool CreateLogicalPartitions(const std::string& block_device);
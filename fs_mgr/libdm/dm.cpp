@@ -121,6 +121,42 @@ bool DeviceMapper::CreateDevice(const std::string& name, const DmTable& table) {
     return true;
 }
 
+bool DeviceMapper::CreateDevices(
+        const std::vector<std::pair<std::string, const DmTable*>>& devices,
+        std::vector<std::string>* paths) {
+    std::vector<std::string> created;
+    std::vector<std::string> device_paths;
+    created.reserve(devices.size());
+    device_paths.reserve(devices.size());
+
+    bool ok = true;
+    for (const auto& [name, table] : devices) {
+        if (!CreateDevice(name, *table)) {
+            ok = false;
+            break;
+        }
+        created.emplace_back(name);
+
+        std::string path;
+        if (!GetDmDevicePathByName(name, &path)) {
+            ok = false;
+            break;
+        }
+        device_paths.emplace_back(std::move(path));
+    }
+
+    if (!ok) {
+        for (auto iter = created.rbegin(); iter != created.rend(); iter++) {
+            DeleteDevice(*iter);
+        }
+        return false;
+    }
+    if (paths) {
+        *paths = std::move(device_paths);
+    }
+    return true;
+}
+
 bool DeviceMapper::LoadTableAndActivate(const std::string& name, const DmTable& table) {
     std::string ioctl_buffer(sizeof(struct dm_ioctl), 0);
     ioctl_buffer += table.Serialize();
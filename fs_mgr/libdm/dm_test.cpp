@@ -180,6 +180,36 @@ TEST(libdm, DmLinear) {
     ASSERT_TRUE(dev.Destroy());
 }
 
+TEST(libdm, CreateDevices) {
+    unique_fd tmp(CreateTempFile("file_1", 4096));
+    ASSERT_GE(tmp, 0);
+    LoopDevice loop(tmp);
+    ASSERT_TRUE(loop.valid());
+
+    DmTable table_a;
+    ASSERT_TRUE(table_a.AddTarget(make_unique<DmTargetLinear>(0, 1, loop.device(), 0)));
+    DmTable table_b;
+    ASSERT_TRUE(table_b.AddTarget(make_unique<DmTargetLinear>(0, 1, loop.device(), 1)));
+
+    DeviceMapper& dm = DeviceMapper::Instance();
+    vector<string> paths;
+    ASSERT_TRUE(dm.CreateDevices(
+            {{"libdm-test-batch-a", &table_a}, {"libdm-test-batch-b", &table_b}}, &paths));
+    ASSERT_EQ(paths.size(), 2);
+    EXPECT_EQ(dm.GetState("libdm-test-batch-a"), DmDeviceState::ACTIVE);
+    EXPECT_EQ(dm.GetState("libdm-test-batch-b"), DmDeviceState::ACTIVE);
+    EXPECT_NE(paths[0], paths[1]);
+    ASSERT_TRUE(dm.DeleteDevice("libdm-test-batch-a"));
+    ASSERT_TRUE(dm.DeleteDevice("libdm-test-batch-b"));
+
+    // A failure part way through must not leave the earlier devices behind.
+    DmTable invalid;
+    ASSERT_FALSE(dm.CreateDevices({{"libdm-test-batch-a", &table_a},
+                                   {"libdm-test-batch-c", &invalid}}));
+    EXPECT_EQ(dm.GetState("libdm-test-batch-a"), DmDeviceState::INVALID);
+    EXPECT_EQ(dm.GetState("libdm-test-batch-c"), DmDeviceState::INVALID);
+}
+
 TEST(libdm, DmVerityArgsAvb2) {
     std::string device = "/dev/block/platform/soc/1da4000.ufshc/by-name/vendor_a";
     std::string algorithm = "sha1";
@@ -85,6 +85,16 @@ class DeviceMapper final {
     // is not able to be activated, it is destroyed, and false is returned.
     bool CreateDevice(const std::string& name, const DmTable& table);
 
+    // Creates, loads and activates a batch of devices, given as pairs of device
+    // name and table. If any device fails, every device created by this call is
+    // destroyed, and false is returned. On success, |paths| (if not null) holds
+    // the /dev path of each device, in the same order as |devices|.
+    //
+    // The /dev nodes are not waited for, so that callers can wait for the whole
+    // batch at once instead of serializing on each device's uevent.
+    bool CreateDevices(const std::vector<std::pair<std::string, const DmTable*>>& devices,
+                       std::vector<std::string>* paths = nullptr);
+
     // Loads the device mapper table from parameter into the underlying device
     // mapper device with given name and activate / resumes the device in the
     // process. A device with the given name must already exist.
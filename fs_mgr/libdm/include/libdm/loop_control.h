@@ -17,13 +17,29 @@
 #ifndef _LIBDM_LOOP_CONTROL_H_
 #define _LIBDM_LOOP_CONTROL_H_
 
+#include <stdint.h>
+
 #include <string>
+#include <vector>
 
 #include <android-base/unique_fd.h>
 
 namespace android {
 namespace dm {
 
+// How a backing file is attached to a loop device.
+struct LoopConfig {
+    int file_fd = -1;
+    // Read and write the backing file with direct I/O, bypassing its page
+    // cache. Falls back to buffered I/O if the file or its filesystem can not
+    // do direct I/O at 'block_size'.
+    bool direct_io = false;
+    // Logical block size of the loop device, or 0 to keep the default of
+    // 512 bytes. Direct I/O needs it to be at least the logical block size of
+    // the device holding the backing file.
+    uint32_t block_size = 0;
+};
+
 class LoopControl final {
   public:
     LoopControl();
@@ -32,6 +48,11 @@ class LoopControl final {
     // by 'loopdev'
     bool Attach(int file_fd, std::string* loopdev) const;
 
+    // Attaches each of 'configs' to a free loop device, in order, and returns
+    // the devices in 'loopdevs'. Either all of them are attached or, on
+    // failure, none is.
+    bool Attach(const std::vector<LoopConfig>& configs, std::vector<std::string>* loopdevs) const;
+
     // Detach the loop device given by 'loopdev' from the attached backing file.
     bool Detach(const std::string& loopdev) const;
 
@@ -42,6 +63,7 @@ class LoopControl final {
 
   private:
     bool FindFreeLoopDevice(std::string* loopdev) const;
+    bool Configure(const std::string& loopdev, const LoopConfig& config) const;
 
     static constexpr const char* kLoopControlDevice = "/dev/loop-control";
 
@@ -42,18 +42,62 @@ bool LoopControl::Attach(int file_fd, std::string* loopdev) const {
         LOG(ERROR) << "Failed to attach, no free loop devices";
         return false;
     }
+    return Configure(*loopdev, LoopConfig{.file_fd = file_fd});
+}
+
+bool LoopControl::Attach(const std::vector<LoopConfig>& configs,
+                         std::vector<std::string>* loopdevs) const {
+    loopdevs->clear();
+    for (const auto& config : configs) {
+        // The kernel hands out the same free device until it is configured,
+        // so each one has to be set up before asking for the next.
+        std::string loopdev;
+        if (!FindFreeLoopDevice(&loopdev)) {
+            LOG(ERROR) << "Failed to attach, no free loop devices";
+        } else if (Configure(loopdev, config)) {
+            loopdevs->emplace_back(std::move(loopdev));
+            continue;
+        }
+
+        for (const auto& attached : *loopdevs) {
+            Detach(attached);
+        }
+        loopdevs->clear();
+        return false;
+    }
+    return true;
+}
 
-    android::base::unique_fd loop_fd(TEMP_FAILURE_RETRY(open(loopdev->c_str(), O_RDWR | O_CLOEXEC)));
+bool LoopControl::Configure(const std::string& loopdev, const LoopConfig& config) const {
+    android::base::unique_fd loop_fd(TEMP_FAILURE_RETRY(open(loopdev.c_str(), O_RDWR | O_CLOEXEC)));
     if (loop_fd < 0) {
-        PLOG(ERROR) << "Failed to open: " << *loopdev;
+        PLOG(ERROR) << "Failed to open: " << loopdev;
         return false;
     }
 
-    int rc = ioctl(loop_fd, LOOP_SET_FD, file_fd);
+    int rc = ioctl(loop_fd, LOOP_SET_FD, config.file_fd);
     if (rc < 0) {
         PLOG(ERROR) << "Failed LOOP_SET_FD";
         return false;
     }
+
+    if (config.block_size) {
+        rc = ioctl(loop_fd, LOOP_SET_BLOCK_SIZE, static_cast<unsigned long>(config.block_size));
+        if (rc < 0) {
+            PLOG(ERROR) << "Failed LOOP_SET_BLOCK_SIZE to " << config.block_size << " for '"
+                        << loopdev << "'";
+            ioctl(loop_fd, LOOP_CLR_FD, 0);
+            return false;
+        }
+    }
+
+    if (config.direct_io) {
+        rc = ioctl(loop_fd, LOOP_SET_DIRECT_IO, 1UL);
+        if (rc < 0) {
+            // Still usable, only through the page cache.
+            PLOG(WARNING) << "Failed LOOP_SET_DIRECT_IO for '" << loopdev << "'";
+        }
+    }
     return true;
 }
 
@@ -62,3 +62,27 @@ TEST(libdm, LoopControl) {
     ASSERT_TRUE(android::base::ReadFully(loop_fd, buffer, sizeof(buffer)));
     ASSERT_EQ(memcmp(buffer, "Hello", 6), 0);
 }
+
+TEST(libdm, LoopControlBulk) {
+    unique_fd fd1 = TempFile();
+    ASSERT_GE(fd1, 0);
+    unique_fd fd2 = TempFile();
+    ASSERT_GE(fd2, 0);
+
+    LoopControl control;
+    std::vector<std::string> devices;
+    ASSERT_TRUE(control.Attach({{.file_fd = fd1, .direct_io = true}, {.file_fd = fd2}}, &devices));
+    ASSERT_EQ(devices.size(), 2u);
+    EXPECT_NE(devices[0], devices[1]);
+
+    for (const auto& device : devices) {
+        char buffer[6];
+        unique_fd loop_fd(open(device.c_str(), O_RDWR));
+        ASSERT_GE(loop_fd, 0);
+        ASSERT_TRUE(android::base::ReadFully(loop_fd, buffer, sizeof(buffer)));
+        ASSERT_EQ(memcmp(buffer, "Hello", 6), 0);
+    }
+    for (const auto& device : devices) {
+        ASSERT_TRUE(control.Detach(device));
+    }
+}
@@ -27,6 +27,7 @@
 #include <sys/vfs.h>
 #include <unistd.h>
 
+#include <algorithm>
 #include <string>
 #include <utility>
 #include <vector>
@@ -44,6 +45,10 @@ namespace fiemap_writer {
 // If we find more, then it is treated as error for now.
 static constexpr const uint32_t kMaxExtents = 512;
 
+// Zeroes are written out in chunks of this size when a file is allocated. Writing a block at a
+// time spends most of the time in syscalls for multi-gigabyte files.
+static constexpr const uint64_t kMaxZeroWriteSize = 1024 * 1024;
+
 // TODO: Fallback to using fibmap if FIEMAP_EXTENT_MERGED is set.
 static constexpr const uint32_t kUnsupportedExtentFlags =
         FIEMAP_EXTENT_UNKNOWN | FIEMAP_EXTENT_UNWRITTEN | FIEMAP_EXTENT_DELALLOC |
@@ -230,10 +235,13 @@ static bool AllocateFile(int file_fd, const std::string& file_path, uint64_t blo
         return false;
     }
 
-    // write zeroes in 'blocksz' byte increments until we reach file_size to make sure the data
+    // write zeroes in large, block aligned chunks until we reach file_size to make sure the data
     // blocks are actually written to by the file system and thus getting rid of the holes in the
-    // file.
-    auto buffer = std::unique_ptr<void, decltype(&free)>(calloc(1, blocksz), free);
+    // file. The extents would otherwise be left unwritten, which we can't use for raw block i/o.
+    uint64_t write_size = std::min(std::max(kMaxZeroWriteSize - kMaxZeroWriteSize % blocksz,
+                                            blocksz),
+                                   file_size);
+    auto buffer = std::unique_ptr<void, decltype(&free)>(calloc(1, write_size), free);
     if (buffer == nullptr) {
         LOG(ERROR) << "failed to allocate memory for writing file";
         return false;
@@ -246,9 +254,10 @@ static bool AllocateFile(int file_fd, const std::string& file_path, uint64_t blo
     }
 
     int permille = -1;
-    for (; offset < file_size; offset += blocksz) {
-        if (!::android::base::WriteFully(file_fd, buffer.get(), blocksz)) {
-            PLOG(ERROR) << "Failed to write" << blocksz << " bytes at offset" << offset
+    while (offset < file_size) {
+        uint64_t chunk = std::min(write_size, file_size - offset);
+        if (!::android::base::WriteFully(file_fd, buffer.get(), chunk)) {
+            PLOG(ERROR) << "Failed to write" << chunk << " bytes at offset" << offset
                         << " in file " << file_path;
             return false;
         }
@@ -261,6 +270,7 @@ static bool AllocateFile(int file_fd, const std::string& file_path, uint64_t blo
             }
             permille = new_permille;
         }
+        offset += chunk;
     }
 
     if (lseek64(file_fd, 0, SEEK_SET) < 0) {
@@ -573,38 +583,43 @@ bool FiemapWriter::Write(off64_t off, uint8_t* buffer, uint64_t size) {
         return false;
     }
 
-    // find extents that must be written to and then write one at a time.
-    uint32_t num_extent = 1;
-    uint32_t buffer_offset = 0;
-    for (auto& extent : extents_) {
-        uint64_t e_start = extent.fe_logical;
-        uint64_t e_end = extent.fe_logical + extent.fe_length;
-        // Do we write in this extent ?
-        if (off >= e_start && off < e_end) {
-            uint64_t written = WriteExtent(extent, buffer + buffer_offset, off, size);
-            if (written == 0) {
-                return false;
-            }
+    // The extents are sorted by logical offset, so find the one containing 'off' and then write
+    // out the following extents in order until the whole buffer has been consumed.
+    auto extent = std::upper_bound(
+            extents_.begin(), extents_.end(), static_cast<uint64_t>(off),
+            [](uint64_t offset, const struct fiemap_extent& ext) { return offset < ext.fe_logical; });
+    if (extent == extents_.begin()) {
+        LOG(ERROR) << "Failed write: no extent found for offset " << off;
+        return false;
+    }
+    --extent;
 
-            buffer_offset += written;
-            off += written;
-            size -= written;
+    uint64_t buffer_offset = 0;
+    for (; size && extent != extents_.end(); ++extent) {
+        uint64_t e_start = extent->fe_logical;
+        uint64_t e_end = extent->fe_logical + extent->fe_length;
+        uint64_t written = WriteExtent(*extent, buffer + buffer_offset, off, size);
+        if (written == 0) {
+            return false;
+        }
 
-            // Paranoid check to make sure we are done with this extent now
-            if (size && (off >= e_start && off < e_end)) {
-                LOG(ERROR) << "Failed to write extent fully";
-                LogExtent(num_extent, extent);
-                return false;
-            }
+        buffer_offset += written;
+        off += written;
+        size -= written;
 
-            if (size == 0) {
-                // done
-                break;
-            }
+        // Paranoid check to make sure we are done with this extent now
+        if (size && (off >= e_start && off < e_end)) {
+            LOG(ERROR) << "Failed to write extent fully";
+            LogExtent(extent - extents_.begin() + 1, *extent);
+            return false;
         }
-        num_extent++;
     }
 
+    if (size) {
+        LOG(ERROR) << "Failed write: " << size << " bytes at offset " << off
+                   << " are not backed by an extent";
+        return false;
+    }
     return true;
 }
 
@@ -638,19 +653,22 @@ uint64_t FiemapWriter::WriteExtent(const struct fiemap_extent& ext, uint8_t* buf
                    << bdev_path_ << " of size " << bdev_size_ << " bytes";
         return 0;
     }
-    if (TEMP_FAILURE_RETRY(lseek64(bdev_fd_, bdev_offset, SEEK_SET)) == -1) {
-        PLOG(ERROR) << "Failed write extent, seek offset for " << bdev_path_ << " offset "
-                    << bdev_offset;
-        return 0;
-    }
 
-    // Determine how much we want to write at once.
+    // Determine how much we want to write at once. This is written with pwrite() so that
+    // each extent costs a single syscall rather than a seek and a write.
     uint64_t logical_end = logical_off + length;
     uint64_t write_size = (e_end <= logical_end) ? (e_end - logical_off) : length;
-    if (!android::base::WriteFully(bdev_fd_, buffer, write_size)) {
-        PLOG(ERROR) << "Failed write extent, write " << bdev_path_ << " at " << bdev_offset
-                    << " size " << write_size;
-        return 0;
+    uint64_t remaining = write_size;
+    while (remaining) {
+        ssize_t n = TEMP_FAILURE_RETRY(pwrite64(bdev_fd_, buffer, remaining, bdev_offset));
+        if (n <= 0) {
+            PLOG(ERROR) << "Failed write extent, write " << bdev_path_ << " at " << bdev_offset
+                        << " size " << remaining;
+            return 0;
+        }
+        buffer += n;
+        bdev_offset += n;
+        remaining -= n;
     }
 
     return write_size;
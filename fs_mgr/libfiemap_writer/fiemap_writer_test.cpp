@@ -25,6 +25,7 @@
 #include <unistd.h>
 
 #include <string>
+#include <vector>
 
 #include <android-base/file.h>
 #include <android-base/logging.h>
@@ -156,6 +157,20 @@ TEST_F(FiemapWriterTest, CheckWriteError) {
     EXPECT_TRUE(fptr->Flush());
 }
 
+TEST_F(FiemapWriterTest, CheckWriteAcrossExtents) {
+    FiemapUniquePtr fptr = FiemapWriter::Open(testfile, testfile_size);
+    ASSERT_NE(fptr, nullptr);
+
+    // A single write covering the whole file has to walk every extent.
+    std::vector<uint8_t> buffer(testfile_size, 0xa0);
+    ASSERT_TRUE(fptr->Write(0, buffer.data(), buffer.size()));
+    EXPECT_TRUE(fptr->Flush());
+
+    // Writes past the end of the file must still fail.
+    uint64_t blocksize = fptr->block_size();
+    EXPECT_FALSE(fptr->Write(testfile_size - blocksize, buffer.data(), 2 * blocksize));
+}
+
 class TestExistingFile : public ::testing::Test {
   protected:
     void SetUp() override {
@@ -18,7 +18,10 @@
 
 #include <unistd.h>
 
+#include <algorithm>
 #include <array>
+#include <future>
+#include <iterator>
 #include <sstream>
 
 #include <android-base/file.h>
@@ -498,16 +501,40 @@ VBMetaVerifyResult LoadAndVerifyVbmetaImpl(
         if (fatal_error) {
             return VBMetaVerifyResult::kError;
         }
-        for (auto& chain : chain_partitions) {
-            auto sub_ret = LoadAndVerifyVbmetaImpl(
+
+        // The chained partitions are independent of each other, so their vbmeta images are
+        // read and verified concurrently. The results are merged in descriptor order below,
+        // which keeps |out_vbmeta_images| (and hence the vbmeta digest) the same as loading
+        // them one after another.
+        auto load_chain = [&](const ChainInfo& chain, std::vector<VBMetaData>* images) {
+            return LoadAndVerifyVbmetaImpl(
                     chain.partition_name, ab_suffix, ab_other_suffix, chain.public_key_blob,
                     allow_verification_error, load_chained_vbmeta, rollback_protection,
                     device_path_constructor, true, /* is_chained_vbmeta */
-                    out_vbmeta_images);
+                    out_vbmeta_images ? images : nullptr);
+        };
+        std::vector<std::vector<VBMetaData>> chain_images(chain_partitions.size());
+        // The first chained partition is loaded on this thread.
+        std::vector<std::future<VBMetaVerifyResult>> chain_results;
+        for (size_t i = 1; i < chain_partitions.size(); i++) {
+            chain_results.emplace_back(std::async(std::launch::async, load_chain,
+                                                  std::cref(chain_partitions[i]),
+                                                  &chain_images[i]));
+        }
+
+        for (size_t i = 0; i < chain_partitions.size(); i++) {
+            auto sub_ret = (i == 0) ? load_chain(chain_partitions[0], &chain_images[0])
+                                    : chain_results[i - 1].get();
+            if (out_vbmeta_images) {
+                std::move(chain_images[i].begin(), chain_images[i].end(),
+                          std::back_inserter(*out_vbmeta_images));
+            }
             if (sub_ret != VBMetaVerifyResult::kSuccess) {
                 verify_result = sub_ret;  // might be 'ERROR' or 'ERROR VERIFICATION'.
                 if (verify_result == VBMetaVerifyResult::kError) {
-                    return verify_result;  // stop here if we got an 'ERROR'.
+                    // Stop here if we got an 'ERROR'. The futures still in flight are
+                    // waited for when |chain_results| goes out of scope.
+                    return verify_result;
                 }
             }
         }
@@ -19,6 +19,7 @@
 #include <string.h>
 
 #include <algorithm>
+#include <atomic>
 
 #include <android-base/properties.h>
 #include <android-base/unique_fd.h>
@@ -50,10 +51,20 @@ bool ZeroExtent::AddTo(LpMetadata* out) const {
     return true;
 }
 
+static uint64_t NextPartitionRevision() {
+    static std::atomic<uint64_t> next_revision = 1;
+    return next_revision++;
+}
+
 Partition::Partition(const std::string& name, const std::string& group_name, uint32_t attributes)
-    : name_(name), group_name_(group_name), attributes_(attributes), size_(0) {}
+    : name_(name),
+      group_name_(group_name),
+      attributes_(attributes),
+      size_(0),
+      revision_(NextPartitionRevision()) {}
 
 void Partition::AddExtent(std::unique_ptr<Extent>&& extent) {
+    revision_ = NextPartitionRevision();
     size_ += extent->num_sectors() * LP_SECTOR_SIZE;
 
     if (LinearExtent* new_extent = extent->AsLinearExtent()) {
@@ -74,11 +85,13 @@ void Partition::AddExtent(std::unique_ptr<Extent>&& extent) {
 }
 
 void Partition::RemoveExtents() {
+    revision_ = NextPartitionRevision();
     size_ = 0;
     extents_.clear();
 }
 
 void Partition::ShrinkTo(uint64_t aligned_size) {
+    revision_ = NextPartitionRevision();
     if (aligned_size == 0) {
         RemoveExtents();
         return;
@@ -490,63 +503,118 @@ void MetadataBuilder::RemovePartition(const std::string& name) {
     }
 }
 
-void MetadataBuilder::ExtentsToFreeList(const std::vector<Interval>& extents,
+void MetadataBuilder::ExtentsToFreeList(uint32_t device_index,
+                                        const std::multiset<Interval>& extents,
                                         std::vector<Interval>* free_regions) const {
+    const auto& block_device = block_devices_[device_index];
+
     // Convert the extent list into a list of gaps between the extents; i.e.,
-    // the list of ranges that are free on the disk.
-    for (size_t i = 1; i < extents.size(); i++) {
-        const Interval& previous = extents[i - 1];
-        const Interval& current = extents[i];
-        DCHECK(previous.device_index == current.device_index);
-
-        uint64_t aligned = AlignSector(block_devices_[current.device_index], previous.end);
-        if (aligned >= current.start) {
+    // the list of ranges that are free on the disk. The first and last sectors
+    // act as 0-length extents, so that the space in between is treated as
+    // available.
+    uint64_t previous_end = block_device.first_logical_sector;
+    auto add_gap = [&](uint64_t start) -> void {
+        uint64_t aligned = AlignSector(block_device, previous_end);
+        if (aligned >= start) {
             // There is no gap between these two extents, try the next one.
             // Note that we check with >= instead of >, since alignment may
             // bump the ending sector past the beginning of the next extent.
-            continue;
+            return;
         }
 
         // The new interval represents the free space starting at the end of
         // the previous interval, and ending at the start of the next interval.
-        free_regions->emplace_back(current.device_index, aligned, current.start);
+        free_regions->emplace_back(device_index, aligned, start);
+    };
+    for (const auto& extent : extents) {
+        add_gap(extent.start);
+        previous_end = extent.end;
     }
+    add_gap(block_device.size / LP_SECTOR_SIZE);
 }
 
 auto MetadataBuilder::GetFreeRegions() const -> std::vector<Interval> {
     std::vector<Interval> free_regions;
 
-    // Collect all extents in the partition table, per-device, then sort them
-    // by starting sector.
-    std::vector<std::vector<Interval>> device_extents(block_devices_.size());
+    const auto& device_extents = ExtentIndex();
+    for (size_t i = 0; i < device_extents.size(); i++) {
+        ExtentsToFreeList(i, device_extents[i], &free_regions);
+    }
+    return free_regions;
+}
+
+bool MetadataBuilder::IsExtentIndexCurrent() const {
+    if (extent_index_.size() != block_devices_.size() ||
+        extent_index_revisions_.size() != partitions_.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < partitions_.size(); i++) {
+        if (extent_index_revisions_[i].first != partitions_[i].get() ||
+            extent_index_revisions_[i].second != partitions_[i]->revision()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+auto MetadataBuilder::ExtentIndex() const -> const std::vector<std::multiset<Interval>>& {
+    if (IsExtentIndexCurrent()) {
+        return extent_index_;
+    }
+
+    extent_index_.assign(block_devices_.size(), {});
+    extent_index_revisions_.clear();
     for (const auto& partition : partitions_) {
-        for (const auto& extent : partition->extents()) {
-            LinearExtent* linear = extent->AsLinearExtent();
-            if (!linear) {
-                continue;
-            }
-            CHECK(linear->device_index() < device_extents.size());
-            auto& extents = device_extents[linear->device_index()];
-            extents.emplace_back(linear->device_index(), linear->physical_sector(),
-                                 linear->physical_sector() + extent->num_sectors());
+        AddToExtentIndex(*partition.get());
+        extent_index_revisions_.emplace_back(partition.get(), partition->revision());
+    }
+    return extent_index_;
+}
+
+void MetadataBuilder::AddToExtentIndex(const Partition& partition) const {
+    for (const auto& extent : partition.extents()) {
+        LinearExtent* linear = extent->AsLinearExtent();
+        if (!linear) {
+            continue;
         }
+        CHECK(linear->device_index() < extent_index_.size());
+        extent_index_[linear->device_index()].emplace(
+                linear->device_index(), linear->physical_sector(), linear->end_sector());
     }
+}
 
-    // Add 0-length intervals for the first and last sectors. This will cause
-    // ExtentToFreeList() to treat the space in between as available.
-    for (size_t i = 0; i < device_extents.size(); i++) {
-        auto& extents = device_extents[i];
-        const auto& block_device = block_devices_[i];
+void MetadataBuilder::RemoveFromExtentIndex(const Partition& partition) const {
+    for (const auto& extent : partition.extents()) {
+        LinearExtent* linear = extent->AsLinearExtent();
+        if (!linear) {
+            continue;
+        }
+        auto& extents = extent_index_[linear->device_index()];
+        auto iter = extents.find(Interval(linear->device_index(), linear->physical_sector(),
+                                          linear->end_sector()));
+        CHECK(iter != extents.end());
+        extents.erase(iter);
+    }
+}
 
-        uint64_t first_sector = block_device.first_logical_sector;
-        uint64_t last_sector = block_device.size / LP_SECTOR_SIZE;
-        extents.emplace_back(i, first_sector, first_sector);
-        extents.emplace_back(i, last_sector, last_sector);
+// Apply |change| to the extents of |partition|. If the extent index was up to
+// date beforehand, only this partition's entries are replaced, rather than
+// having the next GetFreeRegions() call re-index every partition.
+void MetadataBuilder::UpdateExtentIndex(Partition* partition, const std::function<void()>& change) {
+    if (!IsExtentIndexCurrent()) {
+        change();
+        return;
+    }
 
-        std::sort(extents.begin(), extents.end());
-        ExtentsToFreeList(extents, &free_regions);
+    RemoveFromExtentIndex(*partition);
+    change();
+    AddToExtentIndex(*partition);
+    for (auto& entry : extent_index_revisions_) {
+        if (entry.first == partition) {
+            entry.second = partition->revision();
+            break;
+        }
     }
-    return free_regions;
 }
 
 bool MetadataBuilder::ValidatePartitionSizeChange(Partition* partition, uint64_t old_size,
@@ -637,9 +705,11 @@ bool MetadataBuilder::GrowPartition(Partition* partition, uint64_t aligned_size)
     }
 
     // Everything succeeded, so commit the new extents.
-    for (auto& extent : new_extents) {
-        partition->AddExtent(std::move(extent));
-    }
+    UpdateExtentIndex(partition, [&]() -> void {
+        for (auto& extent : new_extents) {
+            partition->AddExtent(std::move(extent));
+        }
+    });
     return true;
 }
 
@@ -678,7 +748,7 @@ std::vector<MetadataBuilder::Interval> MetadataBuilder::PrioritizeSecondHalfOfSu
 }
 
 void MetadataBuilder::ShrinkPartition(Partition* partition, uint64_t aligned_size) {
-    partition->ShrinkTo(aligned_size);
+    UpdateExtentIndex(partition, [&]() -> void { partition->ShrinkTo(aligned_size); });
 }
 
 std::unique_ptr<LpMetadata> MetadataBuilder::Export() {
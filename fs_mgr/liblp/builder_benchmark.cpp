@@ -0,0 +1,58 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string>
+#include <vector>
+
+#include <android-base/logging.h>
+#include <benchmark/benchmark.h>
+#include <liblp/builder.h>
+
+using namespace android::fs_mgr;
+
+// Resize partitions back and forth on a super partition whose partitions were
+// grown in lockstep, so that each of them is split into many extents.
+static void BM_ResizeFragmented(benchmark::State& state) {
+    android::base::SetMinimumLogSeverity(android::base::ERROR);
+
+    BlockDeviceInfo super("super", 64ULL * 1024 * 1024 * 1024, 0, 0, 4096);
+    auto builder = MetadataBuilder::New({super}, "super", 65536, 2);
+    CHECK(builder);
+
+    const int num_partitions = state.range(0);
+    const int extents_per_partition = state.range(1);
+    std::vector<Partition*> partitions;
+    for (int i = 0; i < num_partitions; i++) {
+        partitions.emplace_back(builder->AddPartition("partition" + std::to_string(i) + "_a", 0));
+        CHECK(partitions.back());
+    }
+    for (int round = 1; round <= extents_per_partition; round++) {
+        for (auto partition : partitions) {
+            CHECK(builder->ResizePartition(partition, round * 4 * 1024 * 1024));
+        }
+    }
+
+    size_t index = 0;
+    for (auto _ : state) {
+        Partition* partition = partitions[index++ % partitions.size()];
+        builder->ResizePartition(partition, partition->size() + 4096);
+        builder->ResizePartition(partition, partition->size() - 4096);
+    }
+    state.SetItemsProcessed(state.iterations() * 2);
+}
+BENCHMARK(BM_ResizeFragmented)->Args({16, 16})->Args({64, 64})->Args({128, 32});
+
+BENCHMARK_MAIN();
@@ -112,6 +112,33 @@ TEST_F(BuilderTest, ResizePartition) {
     EXPECT_EQ(system->extents().size(), 0);
 }
 
+TEST_F(BuilderTest, ResizeAfterDirectExtentChanges) {
+    unique_ptr<MetadataBuilder> builder = MetadataBuilder::New(1024 * 1024, 1024, 2);
+    ASSERT_NE(builder, nullptr);
+
+    Partition* system = builder->AddPartition("system", LP_PARTITION_ATTR_READONLY);
+    Partition* vendor = builder->AddPartition("vendor", LP_PARTITION_ATTR_READONLY);
+    ASSERT_NE(system, nullptr);
+    ASSERT_NE(vendor, nullptr);
+    ASSERT_TRUE(builder->ResizePartition(system, 65536));
+    ASSERT_TRUE(builder->ResizePartition(vendor, 65536));
+
+    // Space released behind the builder's back must be reused, and space
+    // claimed behind its back must not be handed out again.
+    system->RemoveExtents();
+    ASSERT_TRUE(builder->ResizePartition(vendor, 131072));
+    ASSERT_EQ(vendor->extents().size(), 2);
+    LinearExtent* extent = vendor->extents()[1]->AsLinearExtent();
+    ASSERT_NE(extent, nullptr);
+    EXPECT_EQ(extent->physical_sector(), 32);
+
+    system->AddExtent(std::make_unique<LinearExtent>(128, 0, 32 + 256));
+    ASSERT_TRUE(builder->ResizePartition(vendor, 196608));
+    extent = vendor->extents().back()->AsLinearExtent();
+    ASSERT_NE(extent, nullptr);
+    EXPECT_EQ(extent->physical_sector(), 32 + 256 + 128);
+}
+
 TEST_F(BuilderTest, PartitionAlignment) {
     unique_ptr<MetadataBuilder> builder = MetadataBuilder::New(1024 * 1024, 1024, 2);
     ASSERT_NE(builder, nullptr);
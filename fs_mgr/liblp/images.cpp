@@ -16,7 +16,12 @@
 
 #include "images.h"
 
+#include <errno.h>
 #include <limits.h>
+#include <string.h>
+
+#include <algorithm>
+#include <vector>
 
 #include <android-base/file.h>
 
@@ -265,25 +270,112 @@ bool SparseBuilder::Build() {
     return true;
 }
 
-static inline bool HasFillValue(uint32_t* buffer, size_t count) {
-    uint32_t fill_value = buffer[0];
-    for (size_t i = 1; i < count; i++) {
-        if (fill_value != buffer[i]) {
-            return false;
+// Each sparse chunk length is 32 bits, so runs are added in pieces of at most
+// this many bytes (rounded down to the block size).
+static constexpr uint64_t kMaxSparseChunkBytes = 1024 * 1024 * 1024;
+
+// Images are scanned for fill blocks this many bytes (rounded down to the
+// block size) at a time.
+static constexpr size_t kImageReadBytes = 1024 * 1024;
+
+namespace {
+
+// Where a range of a partition image goes in the output devices.
+struct ImageExtent {
+    uint64_t image_offset;
+    uint64_t length;
+    sparse_file* device;
+    uint32_t block;
+};
+
+// A run of image blocks that all hold the same 32-bit fill value, or that are
+// plain data to be read from the image when the sparse file is written.
+struct ImageRun {
+    bool is_fill = false;
+    uint32_t fill_value = 0;
+    uint64_t offset = 0;
+    uint64_t length = 0;
+};
+
+}  // namespace
+
+static inline bool IsFillBlock(const uint32_t* buffer, size_t count) {
+    // Every word equals the next one; memcmp is vectorized where it matters.
+    return memcmp(buffer, buffer + 1, (count - 1) * sizeof(uint32_t)) == 0;
+}
+
+// Finds the first range of |fd| at or after |pos| that may hold data. Holes
+// read as zeroes, so they can be added as fills without being read.
+static void FindDataRange(int fd, uint64_t pos, uint64_t file_length, uint64_t* data_start,
+                          uint64_t* data_end) {
+    *data_start = pos;
+    *data_end = file_length;
+#if defined(SEEK_DATA)
+    int64_t start = SeekFile64(fd, pos, SEEK_DATA);
+    if (start < 0) {
+        // ENXIO means that there is no data past |pos|; otherwise the file
+        // system can't tell, and everything has to be read.
+        if (errno == ENXIO) *data_start = file_length;
+        return;
+    }
+    *data_start = std::min(static_cast<uint64_t>(start), file_length);
+    int64_t end = SeekFile64(fd, start, SEEK_HOLE);
+    if (end >= 0) *data_end = std::min(static_cast<uint64_t>(end), file_length);
+#else
+    (void)fd;
+#endif
+}
+
+// Adds |run| to the devices, splitting it where it crosses an extent.
+static bool AddImageRun(const std::vector<ImageExtent>& extents, size_t* extent_index, int fd,
+                        uint32_t block_size, const ImageRun& run) {
+    const uint64_t max_chunk = kMaxSparseChunkBytes - kMaxSparseChunkBytes % block_size;
+    uint64_t offset = run.offset;
+    uint64_t end = run.offset + run.length;
+    while (offset < end) {
+        while (offset >= extents[*extent_index].image_offset + extents[*extent_index].length) {
+            (*extent_index)++;
         }
+        const ImageExtent& extent = extents[*extent_index];
+        uint64_t extent_end = extent.image_offset + extent.length;
+        uint64_t length = std::min({end, extent_end, offset + max_chunk}) - offset;
+        uint32_t block = extent.block + (offset - extent.image_offset) / block_size;
+
+        if (run.is_fill) {
+            int rv = sparse_file_add_fill(extent.device, run.fill_value, length, block);
+            if (rv) {
+                LERROR << "sparse_file_add_fill failed with code: " << rv;
+                return false;
+            }
+        } else {
+            int rv = sparse_file_add_fd(extent.device, fd, offset, length, block);
+            if (rv) {
+                LERROR << "sparse_file_add_fd failed with code: " << rv;
+                return false;
+            }
+        }
+        offset += length;
     }
     return true;
 }
 
 bool SparseBuilder::AddPartitionImage(const LpMetadataPartition& partition,
                                       const std::string& file) {
-    // Track which extent we're processing.
-    uint32_t extent_index = partition.first_extent_index;
-
-    const LpMetadataExtent& extent = metadata_.extents[extent_index];
-    if (extent.target_type != LP_TARGET_TYPE_LINEAR) {
-        LERROR << "Partition should only have linear extents: " << GetPartitionName(partition);
-        return false;
+    std::vector<ImageExtent> extents;
+    uint64_t image_offset = 0;
+    for (size_t i = 0; i < partition.num_extents; i++) {
+        const LpMetadataExtent& extent = metadata_.extents[partition.first_extent_index + i];
+        if (extent.target_type != LP_TARGET_TYPE_LINEAR) {
+            LERROR << "Partition should only have linear extents: " << GetPartitionName(partition);
+            return false;
+        }
+        uint32_t block;
+        if (!SectorToBlock(extent.target_data, &block)) {
+            return false;
+        }
+        uint64_t length = extent.num_sectors * LP_SECTOR_SIZE;
+        extents.push_back({image_offset, length, device_images_[extent.target_source].get(), block});
+        image_offset += length;
     }
 
     int fd = OpenImageFile(file);
@@ -305,69 +397,72 @@ bool SparseBuilder::AddPartitionImage(const LpMetadataPartition& partition,
                << ")";
         return false;
     }
-    if (SeekFile64(fd, 0, SEEK_SET)) {
-        PERROR << "lseek failed";
-        return false;
-    }
 
-    // We track the current logical sector and the position the current extent
-    // ends at.
-    uint64_t output_sector = 0;
-    uint64_t extent_last_sector = extent.num_sectors;
+    // Blocks are gathered into runs of the same kind, so that a run of data
+    // or of one fill value costs a single sparse chunk however long it is.
+    // Data is never copied: the chunks reference the image's fd.
+    size_t extent_index = 0;
+    ImageRun pending;
+    auto add_blocks = [&](bool is_fill, uint32_t fill_value, uint64_t offset,
+                          uint64_t length) -> bool {
+        if (pending.length && pending.is_fill == is_fill &&
+            (!is_fill || pending.fill_value == fill_value) &&
+            pending.offset + pending.length == offset) {
+            pending.length += length;
+            return true;
+        }
+        if (pending.length &&
+            !AddImageRun(extents, &extent_index, fd, block_size_, pending)) {
+            return false;
+        }
+        pending = {is_fill, fill_value, offset, length};
+        return true;
+    };
 
-    // We also track the output device and the current output block within that
-    // device.
-    uint32_t output_block;
-    if (!SectorToBlock(extent.target_data, &output_block)) {
-        return false;
-    }
-    sparse_file* output_device = device_images_[extent.target_source].get();
+    size_t read_bytes = std::max<size_t>(kImageReadBytes - kImageReadBytes % block_size_,
+                                         block_size_);
+    std::vector<uint32_t> buffer(read_bytes / sizeof(uint32_t));
+    const size_t block_words = block_size_ / sizeof(uint32_t);
 
-    // Proceed to read the file and build sparse images.
     uint64_t pos = 0;
-    uint64_t remaining = file_length;
-    while (remaining) {
-        // Check if we need to advance to the next extent.
-        if (output_sector == extent_last_sector) {
-            extent_index++;
-            if (extent_index >= partition.first_extent_index + partition.num_extents) {
-                LERROR << "image is larger than extent table";
-                return false;
-            }
-
-            const LpMetadataExtent& extent = metadata_.extents[extent_index];
-            extent_last_sector += extent.num_sectors;
-            output_device = device_images_[extent.target_source].get();
-            if (!SectorToBlock(extent.target_data, &output_block)) {
+    while (pos < file_length) {
+        uint64_t data_start, data_end;
+        FindDataRange(fd, pos, file_length, &data_start, &data_end);
+
+        // Whole blocks in a hole are zero fills.
+        uint64_t hole_end = data_start - data_start % block_size_;
+        if (hole_end > pos) {
+            if (!add_blocks(true, 0, pos, hole_end - pos)) {
                 return false;
             }
+            pos = hole_end;
         }
 
-        uint32_t buffer[block_size_ / sizeof(uint32_t)];
-        size_t read_size = remaining >= sizeof(buffer) ? sizeof(buffer) : size_t(remaining);
-        if (!android::base::ReadFully(fd, buffer, sizeof(buffer))) {
-            PERROR << "read failed";
-            return false;
-        }
-        if (read_size != sizeof(buffer) || !HasFillValue(buffer, read_size / sizeof(uint32_t))) {
-            int rv = sparse_file_add_fd(output_device, fd, pos, read_size, output_block);
-            if (rv) {
-                LERROR << "sparse_file_add_fd failed with code: " << rv;
+        // Partial blocks at the edges of the data are read along with it.
+        uint64_t scan_end = (data_end + block_size_ - 1) / block_size_ * block_size_;
+        scan_end = std::min(scan_end, file_length);
+        while (pos < scan_end) {
+            size_t size = std::min<uint64_t>(read_bytes, scan_end - pos);
+            if (!android::base::ReadFullyAtOffset(fd, buffer.data(), size, pos)) {
+                PERROR << "read failed";
                 return false;
             }
-        } else {
-            int rv = sparse_file_add_fill(output_device, buffer[0], read_size, output_block);
-            if (rv) {
-                LERROR << "sparse_file_add_fill failed with code: " << rv;
-                return false;
+            for (size_t i = 0; i < size; i += block_size_) {
+                size_t length = std::min<size_t>(block_size_, size - i);
+                const uint32_t* block = &buffer[i / sizeof(uint32_t)];
+                // A partial last block is padded with zeroes, so it's data.
+                bool is_fill = length == block_size_ && IsFillBlock(block, block_words);
+                if (!add_blocks(is_fill, is_fill ? block[0] : 0, pos + i, length)) {
+                    return false;
+                }
             }
+            pos += size;
         }
-        pos += read_size;
-        remaining -= read_size;
-        output_sector += block_size_ / LP_SECTOR_SIZE;
-        output_block++;
     }
 
+    if (pending.length && !AddImageRun(extents, &extent_index, fd, block_size_, pending)) {
+        return false;
+    }
     return true;
 }
 
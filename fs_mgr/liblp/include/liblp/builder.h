@@ -20,10 +20,13 @@
 #include <stddef.h>
 #include <stdint.h>
 
+#include <functional>
 #include <map>
 #include <memory>
 #include <optional>
 #include <set>
+#include <utility>
+#include <vector>
 
 #include "liblp.h"
 #include "partition_opener.h"
@@ -122,11 +125,17 @@ class Partition final {
     void ShrinkTo(uint64_t aligned_size);
     void set_group_name(const std::string& group_name) { group_name_ = group_name; }
 
+    // Changes whenever the extent list changes. Revisions are unique across
+    // all partitions, so a (partition, revision) pair identifies one exact
+    // extent list.
+    uint64_t revision() const { return revision_; }
+
     std::string name_;
     std::string group_name_;
     std::vector<std::unique_ptr<Extent>> extents_;
     uint32_t attributes_;
     uint64_t size_;
+    uint64_t revision_;
 };
 
 class MetadataBuilder {
@@ -321,8 +330,17 @@ class MetadataBuilder {
         }
     };
     std::vector<Interval> GetFreeRegions() const;
-    void ExtentsToFreeList(const std::vector<Interval>& extents,
+    void ExtentsToFreeList(uint32_t device_index, const std::multiset<Interval>& extents,
                            std::vector<Interval>* free_regions) const;
+
+    // The linear extents of all partitions, sorted per block device. This is
+    // patched in place when ResizePartition() changes a partition, and rebuilt
+    // from scratch if partitions were changed in any other way.
+    const std::vector<std::multiset<Interval>>& ExtentIndex() const;
+    bool IsExtentIndexCurrent() const;
+    void AddToExtentIndex(const Partition& partition) const;
+    void RemoveFromExtentIndex(const Partition& partition) const;
+    void UpdateExtentIndex(Partition* partition, const std::function<void()>& change);
     std::vector<Interval> PrioritizeSecondHalfOfSuper(const std::vector<Interval>& free_list);
 
     static bool sABOverrideValue;
@@ -335,6 +353,11 @@ class MetadataBuilder {
     std::vector<LpMetadataBlockDevice> block_devices_;
     bool auto_slot_suffixing_;
     bool ignore_slot_suffixing_;
+
+    mutable std::vector<std::multiset<Interval>> extent_index_;
+    // The partition revisions that |extent_index_| reflects, in the same order
+    // as |partitions_|.
+    mutable std::vector<std::pair<const Partition*, uint64_t>> extent_index_revisions_;
 };
 
 // Read BlockDeviceInfo for a given block device. This always returns false
@@ -358,6 +358,36 @@ TEST(liblp, ReadBackupMetadata) {
     EXPECT_EQ(ReadMetadata(opener, "super", 0), nullptr);
 }
 
+// Test that metadata that doesn't fit in the first read is read back whole.
+TEST(liblp, ReadLargeMetadata) {
+    constexpr size_t kLargeDiskSize = 1024 * 1024;
+    constexpr size_t kLargeMetadataSize = 64 * 1024;
+    BlockDeviceInfo device_info("super", kLargeDiskSize, 0, 0, 4096);
+    unique_ptr<MetadataBuilder> builder =
+            MetadataBuilder::New(device_info, kLargeMetadataSize, kMetadataSlots);
+    ASSERT_NE(builder, nullptr);
+    for (size_t i = 0; i < 400; i++) {
+        ASSERT_NE(builder->AddPartition("partition" + std::to_string(i), LP_PARTITION_ATTR_NONE),
+                  nullptr);
+    }
+    unique_ptr<LpMetadata> exported = builder->Export();
+    ASSERT_NE(exported, nullptr);
+
+    unique_fd fd = CreateFakeDisk(kLargeDiskSize);
+    ASSERT_GE(fd, 0);
+    TestPartitionOpener opener({{"super", fd}}, {{"super", device_info}});
+    ASSERT_TRUE(FlashPartitionTable(opener, "super", *exported.get()));
+    ASSERT_TRUE(UpdatePartitionTable(opener, "super", *exported.get(), 1));
+
+    for (uint32_t slot = 0; slot < kMetadataSlots; slot++) {
+        unique_ptr<LpMetadata> imported = ReadMetadata(opener, "super", slot);
+        ASSERT_NE(imported, nullptr);
+        ASSERT_GT(imported->header.tables_size, 16 * 1024);
+        ASSERT_EQ(imported->partitions.size(), exported->partitions.size());
+        EXPECT_EQ(GetPartitionName(imported->partitions.back()), "partition399");
+    }
+}
+
 // Test that we don't attempt to write metadata if it would overflow its
 // reserved space.
 TEST(liblp, TooManyPartitions) {
@@ -618,6 +648,59 @@ TEST(liblp, FlashSparseImage) {
     ASSERT_NE(ReadBackupMetadata(fd.get(), geometry, 0), nullptr);
 }
 
+// Test that partition images made of data, fills and holes end up intact in
+// the sparse image.
+TEST(liblp, FlashSparseImageWithPartitionImage) {
+    constexpr size_t kBlockSize = 4096;
+    constexpr size_t kLargeDiskSize = 4 * 1024 * 1024;
+    unique_fd fd = CreateFakeDisk(kLargeDiskSize);
+    ASSERT_GE(fd, 0);
+
+    BlockDeviceInfo device_info("super", kLargeDiskSize, 0, 0, kBlockSize);
+    unique_ptr<MetadataBuilder> builder =
+            MetadataBuilder::New(device_info, kBlockSize, kMetadataSlots);
+    ASSERT_NE(builder, nullptr);
+    Partition* system = builder->AddPartition("system", LP_PARTITION_ATTR_NONE);
+    ASSERT_NE(system, nullptr);
+    ASSERT_TRUE(builder->ResizePartition(system, 1024 * 1024));
+    unique_ptr<LpMetadata> exported = builder->Export();
+    ASSERT_NE(exported, nullptr);
+
+    // Data, zeroes, a fill value, more data, a hole and a partial last block.
+    std::string image(42 * kBlockSize + 100, '\0');
+    for (size_t i = 0; i < kBlockSize; i++) {
+        image[i] = static_cast<char>(i * 7);
+    }
+    memset(&image[2 * kBlockSize], 0xab, kBlockSize);
+    for (size_t i = 3 * kBlockSize; i < 5 * kBlockSize; i++) {
+        image[i] = static_cast<char>(i * 13);
+    }
+    for (size_t i = 41 * kBlockSize; i < image.size(); i++) {
+        image[i] = static_cast<char>(i * 3);
+    }
+    TemporaryFile tf;
+    ASSERT_GE(tf.fd, 0);
+    ASSERT_TRUE(android::base::WriteFully(tf.fd, image.data(), 5 * kBlockSize));
+    ASSERT_EQ(ftruncate(tf.fd, 41 * kBlockSize), 0);
+    ASSERT_EQ(lseek(tf.fd, 41 * kBlockSize, SEEK_SET), static_cast<off_t>(41 * kBlockSize));
+    ASSERT_TRUE(android::base::WriteFully(tf.fd, &image[41 * kBlockSize],
+                                          image.size() - 41 * kBlockSize));
+
+    SparseBuilder sparse(*exported.get(), kBlockSize, {{"system", tf.path}});
+    ASSERT_TRUE(sparse.IsValid());
+    ASSERT_TRUE(sparse.Build());
+    const auto& images = sparse.device_images();
+    ASSERT_EQ(images.size(), static_cast<size_t>(1));
+    ASSERT_NE(lseek(fd.get(), 0, SEEK_SET), -1);
+    ASSERT_EQ(sparse_file_write(images[0].get(), fd.get(), false, false, false), 0);
+
+    const LpMetadataExtent& extent = exported->extents[exported->partitions[0].first_extent_index];
+    std::string written(image.size(), '\0');
+    ASSERT_TRUE(android::base::ReadFullyAtOffset(fd.get(), &written[0], written.size(),
+                                                 extent.target_data * LP_SECTOR_SIZE));
+    ASSERT_TRUE(written == image);
+}
+
 TEST(liblp, AutoSlotSuffixing) {
     unique_ptr<MetadataBuilder> builder = CreateDefaultBuilder();
     ASSERT_NE(builder, nullptr);
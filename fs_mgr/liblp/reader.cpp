@@ -20,7 +20,9 @@
 #include <stdlib.h>
 #include <unistd.h>
 
+#include <algorithm>
 #include <functional>
+#include <vector>
 
 #include <android-base/file.h>
 #include <android-base/unique_fd.h>
@@ -48,6 +50,66 @@ class FileReader final : public Reader {
     int fd_;
 };
 
+// Reads through a window of the device that is refilled with block-aligned
+// reads. The first read also covers the geometry and the start of the first
+// metadata slot, which is all of the metadata on most devices, so that the
+// first-stage mount path usually costs a single read instead of three.
+class BlockReader final : public Reader {
+  public:
+    static constexpr size_t kBlockSize = 4096;
+    static constexpr size_t kMinReadSize = 16 * 1024;
+
+    explicit BlockReader(int fd) : fd_(fd), pos_(0), window_start_(0), device_size_(0) {}
+
+    void Seek(uint64_t pos) { pos_ = pos; }
+
+    bool ReadFully(void* out, size_t length) override {
+        uint8_t* dest = reinterpret_cast<uint8_t*>(out);
+        while (length) {
+            if (pos_ < window_start_ || pos_ >= window_start_ + window_.size()) {
+                if (!Fill(length)) {
+                    return false;
+                }
+            }
+            size_t offset = pos_ - window_start_;
+            size_t n = std::min(length, window_.size() - offset);
+            memcpy(dest, window_.data() + offset, n);
+            dest += n;
+            pos_ += n;
+            length -= n;
+        }
+        return true;
+    }
+
+  private:
+    bool Fill(size_t length) {
+        if (!device_size_ && !GetDescriptorSize(fd_, &device_size_)) {
+            return false;
+        }
+        if (pos_ >= device_size_) {
+            errno = EINVAL;
+            return false;
+        }
+        uint64_t start = pos_ - pos_ % kBlockSize;
+        uint64_t end = pos_ + std::max<uint64_t>(length, kMinReadSize);
+        end = std::min((end + kBlockSize - 1) / kBlockSize * kBlockSize, device_size_);
+
+        window_.resize(end - start);
+        if (!android::base::ReadFullyAtOffset(fd_, window_.data(), window_.size(), start)) {
+            window_.clear();
+            return false;
+        }
+        window_start_ = start;
+        return true;
+    }
+
+    int fd_;
+    uint64_t pos_;
+    uint64_t window_start_;
+    uint64_t device_size_;
+    std::vector<uint8_t> window_;
+};
+
 class MemoryReader final : public Reader {
   public:
     MemoryReader(const void* buffer, size_t size)
@@ -111,6 +173,22 @@ bool ParseGeometry(const void* buffer, LpMetadataGeometry* geometry) {
     return true;
 }
 
+static bool ReadGeometry(BlockReader* reader, LpMetadataGeometry* geometry) {
+    std::unique_ptr<uint8_t[]> buffer = std::make_unique<uint8_t[]>(LP_METADATA_GEOMETRY_SIZE);
+    for (int64_t offset : {GetPrimaryGeometryOffset(), GetBackupGeometryOffset()}) {
+        reader->Seek(offset);
+        if (!reader->ReadFully(buffer.get(), LP_METADATA_GEOMETRY_SIZE)) {
+            PERROR << __PRETTY_FUNCTION__ << " read " << LP_METADATA_GEOMETRY_SIZE
+                   << " bytes failed, offset " << offset;
+            continue;
+        }
+        if (ParseGeometry(buffer.get(), geometry)) {
+            return true;
+        }
+    }
+    return false;
+}
+
 bool ReadPrimaryGeometry(int fd, LpMetadataGeometry* geometry) {
     std::unique_ptr<uint8_t[]> buffer = std::make_unique<uint8_t[]>(LP_METADATA_GEOMETRY_SIZE);
     if (SeekFile64(fd, GetPrimaryGeometryOffset(), SEEK_SET) < 0) {
@@ -403,8 +481,9 @@ std::unique_ptr<LpMetadata> ReadMetadata(const IPartitionOpener& opener,
         return nullptr;
     }
 
+    BlockReader reader(fd);
     LpMetadataGeometry geometry;
-    if (!ReadLogicalPartitionGeometry(fd, &geometry)) {
+    if (!ReadGeometry(&reader, &geometry)) {
         return nullptr;
     }
     if (slot_number >= geometry.metadata_slot_count) {
@@ -419,11 +498,8 @@ std::unique_ptr<LpMetadata> ReadMetadata(const IPartitionOpener& opener,
     std::unique_ptr<LpMetadata> metadata;
 
     for (const auto& offset : offsets) {
-        if (SeekFile64(fd, offset, SEEK_SET) < 0) {
-            PERROR << __PRETTY_FUNCTION__ << " lseek failed, offset " << offset;
-            continue;
-        }
-        if ((metadata = ParseMetadata(geometry, fd)) != nullptr) {
+        reader.Seek(offset);
+        if ((metadata = ParseMetadata(geometry, &reader)) != nullptr) {
             break;
         }
     }
@@ -0,0 +1,86 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <string>
+#include <thread>
+
+#include <android-base/file.h>
+#include <android-base/unique_fd.h>
+#include <fs_mgr/file_wait.h>
+#include <gtest/gtest.h>
+
+using namespace std::chrono_literals;
+using android::base::unique_fd;
+using android::fs_mgr::WaitForFile;
+using android::fs_mgr::WaitForFileDeleted;
+using android::fs_mgr::WaitForFiles;
+
+static void CreateFile(const std::string& path) {
+    unique_fd fd(open(path.c_str(), O_CREAT | O_WRONLY | O_CLOEXEC, 0644));
+    ASSERT_GE(fd, 0);
+}
+
+TEST(file_wait, exists) {
+    TemporaryDir dir;
+    std::string path = std::string(dir.path) + "/file";
+    CreateFile(path);
+    EXPECT_TRUE(WaitForFile(path, 0ms));
+    EXPECT_FALSE(WaitForFileDeleted(path, 0ms));
+    ASSERT_EQ(unlink(path.c_str()), 0);
+}
+
+TEST(file_wait, timeout) {
+    TemporaryDir dir;
+    std::string path = std::string(dir.path) + "/missing/file";
+    auto start = std::chrono::steady_clock::now();
+    EXPECT_FALSE(WaitForFile(path, 100ms));
+    EXPECT_GE(std::chrono::steady_clock::now() - start, 100ms);
+    EXPECT_TRUE(WaitForFileDeleted(path, 0ms));
+}
+
+TEST(file_wait, create_in_missing_dirs) {
+    TemporaryDir dir;
+    std::string a = std::string(dir.path) + "/a";
+    std::string b = a + "/b";
+    std::string file1 = b + "/file";
+    std::string file2 = std::string(dir.path) + "/other";
+
+    std::thread creator([&]() {
+        std::this_thread::sleep_for(50ms);
+        mkdir(a.c_str(), 0755);
+        mkdir(b.c_str(), 0755);
+        CreateFile(file1);
+        CreateFile(file2);
+    });
+    EXPECT_TRUE(WaitForFiles({file1, file2}, 10s));
+    creator.join();
+
+    std::thread deleter([&]() {
+        std::this_thread::sleep_for(50ms);
+        unlink(file1.c_str());
+    });
+    EXPECT_TRUE(WaitForFileDeleted(file1, 10s));
+    deleter.join();
+
+    unlink(file2.c_str());
+    rmdir(b.c_str());
+    rmdir(a.c_str());
+}
@@ -87,6 +87,7 @@ BatteryMonitor::BatteryMonitor()
       mBatteryDevicePresent(false),
       mBatteryFixedCapacity(0),
       mBatteryFixedTemperature(0) {
+    initBatteryProperties(&mBatteryProps);
     initBatteryProperties(&props);
 }
 
@@ -140,10 +141,51 @@ int BatteryMonitor::getBatteryHealth(const char* status) {
     return ret;
 }
 
+// Returns the cached fd for |path|, opening it on first use or when |reopen|
+// is set. Failures to open are not cached, so that a power supply registered
+// late is picked up. Called with mSysfsLock held.
+int BatteryMonitor::getSysfsFd(std::string_view path, bool reopen) {
+    auto it = mSysfsFds.find(path);
+    if (it != mSysfsFds.end() && !reopen)
+        return it->second.get();
+
+    android::base::unique_fd fd(
+            TEMP_FAILURE_RETRY(open(std::string(path).c_str(), O_RDONLY | O_CLOEXEC)));
+    if (fd == -1) {
+        if (it != mSysfsFds.end())
+            mSysfsFds.erase(it);
+        return -1;
+    }
+    int raw = fd.get();
+    if (it != mSysfsFds.end())
+        it->second = std::move(fd);
+    else
+        mSysfsFds.emplace(path, std::move(fd));
+    return raw;
+}
+
 int BatteryMonitor::readFromFile(const String8& path, std::string* buf) {
-    if (android::base::ReadFileToString(path.c_str(), buf)) {
-        *buf = android::base::Trim(*buf);
+    buf->clear();
+    if (path.isEmpty())
+        return 0;
+
+    char data[4096];
+    ssize_t len = -1;
+    {
+        // getProperty() may run on another thread than update().
+        std::lock_guard<std::mutex> lock(mSysfsLock);
+        std::string_view key(path.string(), path.length());
+        // An fd of a power supply that was unregistered fails with ENODEV;
+        // reopen once in case it came back under the same name.
+        for (int attempt = 0; attempt < 2 && len < 0; attempt++) {
+            int fd = getSysfsFd(key, attempt > 0);
+            if (fd == -1)
+                break;
+            len = TEMP_FAILURE_RETRY(pread(fd, data, sizeof(data), 0));
+        }
     }
+    if (len > 0)
+        *buf = android::base::Trim(std::string(data, len));
     return buf->length();
 }
 
@@ -200,93 +242,134 @@ int BatteryMonitor::getIntField(const String8& path) {
     return value;
 }
 
-bool BatteryMonitor::update(void) {
-    bool logthis;
+void BatteryMonitor::readBattery() {
+    BatteryProperties* battery = &mBatteryProps;
 
-    initBatteryProperties(&props);
+    initBatteryProperties(battery);
 
     if (!mHealthdConfig->batteryPresentPath.isEmpty())
-        props.batteryPresent = getBooleanField(mHealthdConfig->batteryPresentPath);
+        battery->batteryPresent = getBooleanField(mHealthdConfig->batteryPresentPath);
     else
-        props.batteryPresent = mBatteryDevicePresent;
+        battery->batteryPresent = mBatteryDevicePresent;
 
-    props.batteryLevel = mBatteryFixedCapacity ?
+    battery->batteryLevel = mBatteryFixedCapacity ?
         mBatteryFixedCapacity :
         getIntField(mHealthdConfig->batteryCapacityPath);
-    props.batteryVoltage = getIntField(mHealthdConfig->batteryVoltagePath) / 1000;
+    battery->batteryVoltage = getIntField(mHealthdConfig->batteryVoltagePath) / 1000;
 
     if (!mHealthdConfig->batteryCurrentNowPath.isEmpty())
-        props.batteryCurrent = getIntField(mHealthdConfig->batteryCurrentNowPath) / 1000;
+        battery->batteryCurrent = getIntField(mHealthdConfig->batteryCurrentNowPath) / 1000;
 
     if (!mHealthdConfig->batteryFullChargePath.isEmpty())
-        props.batteryFullCharge = getIntField(mHealthdConfig->batteryFullChargePath);
+        battery->batteryFullCharge = getIntField(mHealthdConfig->batteryFullChargePath);
 
     if (!mHealthdConfig->batteryCycleCountPath.isEmpty())
-        props.batteryCycleCount = getIntField(mHealthdConfig->batteryCycleCountPath);
+        battery->batteryCycleCount = getIntField(mHealthdConfig->batteryCycleCountPath);
 
     if (!mHealthdConfig->batteryChargeCounterPath.isEmpty())
-        props.batteryChargeCounter = getIntField(mHealthdConfig->batteryChargeCounterPath);
+        battery->batteryChargeCounter = getIntField(mHealthdConfig->batteryChargeCounterPath);
 
-    props.batteryTemperature = mBatteryFixedTemperature ?
+    battery->batteryTemperature = mBatteryFixedTemperature ?
         mBatteryFixedTemperature :
         getIntField(mHealthdConfig->batteryTemperaturePath);
 
     std::string buf;
 
     if (readFromFile(mHealthdConfig->batteryStatusPath, &buf) > 0)
-        props.batteryStatus = getBatteryStatus(buf.c_str());
+        battery->batteryStatus = getBatteryStatus(buf.c_str());
 
     if (readFromFile(mHealthdConfig->batteryHealthPath, &buf) > 0)
-        props.batteryHealth = getBatteryHealth(buf.c_str());
+        battery->batteryHealth = getBatteryHealth(buf.c_str());
 
     if (readFromFile(mHealthdConfig->batteryTechnologyPath, &buf) > 0)
-        props.batteryTechnology = String8(buf.c_str());
+        battery->batteryTechnology = String8(buf.c_str());
+}
+
+void BatteryMonitor::readCharger(Charger* charger) {
+    charger->onlineType = ANDROID_POWER_SUPPLY_TYPE_UNKNOWN;
+    charger->maxChargingCurrent = 0;
+    charger->maxChargingVoltage = 0;
+
+    if (!getIntField(charger->onlinePath))
+        return;
+
+    charger->onlineType = readPowerSupplyType(charger->typePath);
+    switch (charger->onlineType) {
+    case ANDROID_POWER_SUPPLY_TYPE_AC:
+    case ANDROID_POWER_SUPPLY_TYPE_USB:
+    case ANDROID_POWER_SUPPLY_TYPE_WIRELESS:
+        break;
+    default:
+        KLOG_WARNING(LOG_TAG, "%s: Unknown power supply type\n",
+                     charger->name.string());
+    }
+
+    // Both files are optional; a missing voltage_max means plain VBUS.
+    std::string buf;
+    if (readFromFile(charger->currentMaxPath, &buf) > 0)
+        android::base::ParseInt(buf, &charger->maxChargingCurrent);
+
+    charger->maxChargingVoltage = DEFAULT_VBUS_VOLTAGE;
+    if (readFromFile(charger->voltageMaxPath, &buf) > 0) {
+        charger->maxChargingVoltage = 0;
+        android::base::ParseInt(buf, &charger->maxChargingVoltage);
+    }
+}
+
+bool BatteryMonitor::update(void) {
+    readBattery();
+    for (Charger& charger : mChargers)
+        readCharger(&charger);
+    return publish();
+}
+
+bool BatteryMonitor::update(const char* powerSupplyName) {
+    if (powerSupplyName == nullptr)
+        return update();
+
+    for (Charger& charger : mChargers) {
+        if (charger.name == powerSupplyName) {
+            readCharger(&charger);
+            return publish();
+        }
+    }
+    for (const String8& name : mBatteryNames) {
+        if (name == powerSupplyName) {
+            readBattery();
+            return publish();
+        }
+    }
+    return update();
+}
+
+bool BatteryMonitor::publish() {
+    bool logthis;
+
+    props = mBatteryProps;
 
     double MaxPower = 0;
 
-    for (size_t i = 0; i < mChargerNames.size(); i++) {
-        String8 path;
-        path.appendFormat("%s/%s/online", POWER_SUPPLY_SYSFS_PATH,
-                          mChargerNames[i].string());
-        if (getIntField(path)) {
-            path.clear();
-            path.appendFormat("%s/%s/type", POWER_SUPPLY_SYSFS_PATH,
-                              mChargerNames[i].string());
-            switch(readPowerSupplyType(path)) {
-            case ANDROID_POWER_SUPPLY_TYPE_AC:
-                props.chargerAcOnline = true;
-                break;
-            case ANDROID_POWER_SUPPLY_TYPE_USB:
-                props.chargerUsbOnline = true;
-                break;
-            case ANDROID_POWER_SUPPLY_TYPE_WIRELESS:
-                props.chargerWirelessOnline = true;
-                break;
-            default:
-                KLOG_WARNING(LOG_TAG, "%s: Unknown power supply type\n",
-                             mChargerNames[i].string());
-            }
-            path.clear();
-            path.appendFormat("%s/%s/current_max", POWER_SUPPLY_SYSFS_PATH,
-                              mChargerNames[i].string());
-            int ChargingCurrent =
-                    (access(path.string(), R_OK) == 0) ? getIntField(path) : 0;
+    for (const Charger& charger : mChargers) {
+        switch (charger.onlineType) {
+        case ANDROID_POWER_SUPPLY_TYPE_AC:
+            props.chargerAcOnline = true;
+            break;
+        case ANDROID_POWER_SUPPLY_TYPE_USB:
+            props.chargerUsbOnline = true;
+            break;
+        case ANDROID_POWER_SUPPLY_TYPE_WIRELESS:
+            props.chargerWirelessOnline = true;
+            break;
+        default:
+            break;
+        }
 
-            path.clear();
-            path.appendFormat("%s/%s/voltage_max", POWER_SUPPLY_SYSFS_PATH,
-                              mChargerNames[i].string());
-
-            int ChargingVoltage =
-                (access(path.string(), R_OK) == 0) ? getIntField(path) :
-                DEFAULT_VBUS_VOLTAGE;
-
-            double power = ((double)ChargingCurrent / MILLION) *
-                           ((double)ChargingVoltage / MILLION);
-            if (MaxPower < power) {
-                props.maxChargingCurrent = ChargingCurrent;
-                props.maxChargingVoltage = ChargingVoltage;
-                MaxPower = power;
-            }
+        double power = ((double)charger.maxChargingCurrent / MILLION) *
+                       ((double)charger.maxChargingVoltage / MILLION);
+        if (MaxPower < power) {
+            props.maxChargingCurrent = charger.maxChargingCurrent;
+            props.maxChargingVoltage = charger.maxChargingVoltage;
+            MaxPower = power;
         }
     }
 
@@ -497,12 +580,25 @@ void BatteryMonitor::init(struct healthd_config *hc) {
             case ANDROID_POWER_SUPPLY_TYPE_WIRELESS:
                 path.clear();
                 path.appendFormat("%s/%s/online", POWER_SUPPLY_SYSFS_PATH, name);
-                if (access(path.string(), R_OK) == 0)
-                    mChargerNames.add(String8(name));
+                if (access(path.string(), R_OK) == 0) {
+                    Charger charger;
+                    charger.name = String8(name);
+                    charger.onlinePath = path;
+                    charger.typePath.appendFormat("%s/%s/type", POWER_SUPPLY_SYSFS_PATH, name);
+                    charger.currentMaxPath.appendFormat("%s/%s/current_max",
+                                                        POWER_SUPPLY_SYSFS_PATH, name);
+                    charger.voltageMaxPath.appendFormat("%s/%s/voltage_max",
+                                                        POWER_SUPPLY_SYSFS_PATH, name);
+                    charger.onlineType = ANDROID_POWER_SUPPLY_TYPE_UNKNOWN;
+                    charger.maxChargingCurrent = 0;
+                    charger.maxChargingVoltage = 0;
+                    mChargers.push_back(charger);
+                }
                 break;
 
             case ANDROID_POWER_SUPPLY_TYPE_BATTERY:
                 mBatteryDevicePresent = true;
+                mBatteryNames.push_back(String8(name));
 
                 if (mHealthdConfig->batteryStatusPath.isEmpty()) {
                     path.clear();
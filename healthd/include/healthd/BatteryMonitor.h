@@ -17,6 +17,14 @@
 #ifndef HEALTHD_BATTERYMONITOR_H
 #define HEALTHD_BATTERYMONITOR_H
 
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <android-base/unique_fd.h>
 #include <batteryservice/BatteryService.h>
 #include <utils/String8.h>
 #include <utils/Vector.h>
@@ -39,19 +47,48 @@ class BatteryMonitor {
     BatteryMonitor();
     void init(struct healthd_config *hc);
     bool update(void);
+    // Only re-reads the power supply named |powerSupplyName|, e.g. the
+    // POWER_SUPPLY_NAME of a power_supply uevent, and reuses the last readings
+    // of the others. Names of neither a charger nor a battery fall back to a
+    // full update.
+    bool update(const char* powerSupplyName);
     int getChargeStatus();
     status_t getProperty(int id, struct BatteryProperty *val);
     void dumpState(int fd);
     friend struct BatteryProperties getBatteryProperties(BatteryMonitor* batteryMonitor);
 
   private:
+    struct Charger {
+        String8 name;
+        String8 onlinePath;
+        String8 typePath;
+        String8 currentMaxPath;
+        String8 voltageMaxPath;
+        PowerSupplyType onlineType;  // ANDROID_POWER_SUPPLY_TYPE_UNKNOWN if offline
+        int maxChargingCurrent;
+        int maxChargingVoltage;
+    };
+
     struct healthd_config *mHealthdConfig;
-    Vector<String8> mChargerNames;
+    std::vector<Charger> mChargers;
+    std::vector<String8> mBatteryNames;
     bool mBatteryDevicePresent;
     int mBatteryFixedCapacity;
     int mBatteryFixedTemperature;
+    // Last battery readings, before healthd_board_battery_update().
+    struct BatteryProperties mBatteryProps;
     struct BatteryProperties props;
 
+    // Sysfs files stay open and are re-read with pread() at offset 0, which
+    // makes sysfs regenerate the value, saving an open and close per read.
+    std::map<std::string, android::base::unique_fd, std::less<>> mSysfsFds;
+    std::mutex mSysfsLock;
+
+    void readBattery();
+    void readCharger(Charger* charger);
+    bool publish();
+    int getSysfsFd(std::string_view path, bool reopen);
+
     int getBatteryStatus(const char* status);
     int getBatteryHealth(const char* status);
     int readFromFile(const String8& path, std::string* buf);
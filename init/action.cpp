@@ -21,8 +21,10 @@
 #include <android-base/properties.h>
 #include <android-base/strings.h>
 
+#include "boot_trace.h"
 #include "util.h"
 
+using android::base::boot_clock;
 using android::base::Join;
 
 namespace android {
@@ -110,6 +112,36 @@ void Action::ExecuteOneCommand(std::size_t command) const {
     ExecuteCommand(cmd);
 }
 
+// Commands that run in the subcontext can only change init's state by setting properties, which
+// init does before the subcontext runs anything else, so consecutive ones are sent together.
+std::size_t Action::ExecuteCommands(std::size_t command) const {
+    if (!subcontext_ || !commands_[command].execute_in_subcontext()) {
+        ExecuteOneCommand(command);
+        return 1;
+    }
+
+    // Copy the commands for the same reason as ExecuteOneCommand().
+    std::vector<Command> cmds;
+    for (auto i = command; i < commands_.size() && commands_[i].execute_in_subcontext(); ++i) {
+        cmds.emplace_back(commands_[i]);
+    }
+    std::vector<const std::vector<std::string>*> args;
+    for (const auto& cmd : cmds) {
+        args.emplace_back(&cmd.args());
+    }
+
+    android::base::Timer t;
+    auto results = subcontext_->ExecuteCommands(args);
+    if (!results) {
+        ReportCommandResult(cmds[0], results.error(), t.duration());
+        return 1;
+    }
+    for (std::size_t i = 0; i < results->size(); ++i) {
+        ReportCommandResult(cmds[i], (*results)[i].first, (*results)[i].second);
+    }
+    return results->size();
+}
+
 void Action::ExecuteAllCommands() const {
     for (const auto& c : commands_) {
         ExecuteCommand(c);
@@ -119,7 +151,15 @@ void Action::ExecuteAllCommands() const {
 void Action::ExecuteCommand(const Command& command) const {
     android::base::Timer t;
     auto result = command.InvokeFunc(subcontext_);
-    auto duration = t.duration();
+    ReportCommandResult(command, result, t.duration());
+}
+
+void Action::ReportCommandResult(const Command& command, const Result<Success>& result,
+                                 std::chrono::milliseconds duration) const {
+    auto end = boot_clock::now();
+    BootTraceEvent("command", command.BuildCommandString(), end - duration, end,
+                   BuildTriggersString() + " (" + filename_ + ":" + std::to_string(command.line()) +
+                           ")");
 
     // There are many legacy paths in rootdir/init.rc that will virtually never exist on a new
     // device, such as '/sys/class/leds/jogball-backlight/brightness'.  As of this writing, there
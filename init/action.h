@@ -17,6 +17,7 @@
 #ifndef _INIT_ACTION_H
 #define _INIT_ACTION_H
 
+#include <chrono>
 #include <map>
 #include <queue>
 #include <string>
@@ -42,6 +43,8 @@ class Command {
     Result<Success> InvokeFunc(Subcontext* subcontext) const;
     std::string BuildCommandString() const;
 
+    bool execute_in_subcontext() const { return execute_in_subcontext_; }
+    const std::vector<std::string>& args() const { return args_; }
     int line() const { return line_; }
 
   private:
@@ -65,6 +68,8 @@ class Action {
     void AddCommand(BuiltinFunction f, std::vector<std::string>&& args, int line);
     std::size_t NumCommands() const;
     void ExecuteOneCommand(std::size_t command) const;
+    // Executes 'command' and possibly the ones after it, and returns how many were executed.
+    std::size_t ExecuteCommands(std::size_t command) const;
     void ExecuteAllCommands() const;
     bool CheckEvent(const EventTrigger& event_trigger) const;
     bool CheckEvent(const PropertyChange& property_change) const;
@@ -74,6 +79,9 @@ class Action {
 
     bool oneshot() const { return oneshot_; }
     const std::string& filename() const { return filename_; }
+    const std::map<std::string, std::string>& property_triggers() const {
+        return property_triggers_;
+    }
     int line() const { return line_; }
     static void set_function_map(const KeywordFunctionMap* function_map) {
         function_map_ = function_map;
@@ -81,6 +89,8 @@ class Action {
 
   private:
     void ExecuteCommand(const Command& command) const;
+    void ReportCommandResult(const Command& command, const Result<Success>& result,
+                             std::chrono::milliseconds duration) const;
     bool CheckPropertyTriggers(const std::string& name = "",
                                const std::string& value = "") const;
 
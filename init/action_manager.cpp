@@ -29,6 +29,9 @@ ActionManager& ActionManager::GetInstance() {
 }
 
 void ActionManager::AddAction(std::unique_ptr<Action> action) {
+    for (const auto& [trigger_name, trigger_value] : action->property_triggers()) {
+        property_trigger_actions_[trigger_name].emplace_back(action.get());
+    }
     actions_.emplace_back(std::move(action));
 }
 
@@ -53,9 +56,29 @@ void ActionManager::QueueBuiltinAction(BuiltinFunction func, const std::string&
     actions_.emplace_back(std::move(action));
 }
 
+void ActionManager::QueueMatchingActions(const PropertyChange& property_change) {
+    auto it = property_trigger_actions_.find(property_change.first);
+    if (it == property_trigger_actions_.end()) {
+        return;
+    }
+    for (const auto& action : it->second) {
+        if (action->CheckEvent(property_change)) {
+            current_executing_actions_.emplace(action);
+        }
+    }
+}
+
 void ActionManager::ExecuteOneCommand() {
     // Loop through the event queue until we have an action to execute
     while (current_executing_actions_.empty() && !event_queue_.empty()) {
+        // A change of one property can only match the actions that have a trigger on it. An empty
+        // name is QueueAllPropertyActions(), which still needs to look at every action.
+        auto property_change = std::get_if<PropertyChange>(&event_queue_.front());
+        if (property_change != nullptr && !property_change->first.empty()) {
+            QueueMatchingActions(*property_change);
+            event_queue_.pop();
+            continue;
+        }
         for (const auto& action : actions_) {
             if (std::visit([&action](const auto& event) { return action->CheckEvent(event); },
                            event_queue_.front())) {
@@ -77,16 +100,21 @@ void ActionManager::ExecuteOneCommand() {
                   << ":" << action->line() << ")";
     }
 
-    action->ExecuteOneCommand(current_command_);
+    current_command_ += action->ExecuteCommands(current_command_);
 
     // If this was the last command in the current action, then remove
     // the action from the executing list.
     // If this action was oneshot, then also remove it from actions_.
-    ++current_command_;
     if (current_command_ == action->NumCommands()) {
         current_executing_actions_.pop();
         current_command_ = 0;
         if (action->oneshot()) {
+            for (const auto& [trigger_name, trigger_value] : action->property_triggers()) {
+                auto& trigger_actions = property_trigger_actions_[trigger_name];
+                trigger_actions.erase(
+                        std::remove(trigger_actions.begin(), trigger_actions.end(), action),
+                        trigger_actions.end());
+            }
             auto eraser = [&action](std::unique_ptr<Action>& a) { return a.get() == action; };
             actions_.erase(std::remove_if(actions_.begin(), actions_.end(), eraser));
         }
@@ -17,6 +17,7 @@
 #ifndef _INIT_ACTION_MANAGER_H
 #define _INIT_ACTION_MANAGER_H
 
+#include <map>
 #include <string>
 #include <vector>
 
@@ -47,7 +48,12 @@ class ActionManager {
     ActionManager(ActionManager const&) = delete;
     void operator=(ActionManager const&) = delete;
 
+    void QueueMatchingActions(const PropertyChange& property_change);
+
     std::vector<std::unique_ptr<Action>> actions_;
+    // Actions with a trigger on each property, in the same order as actions_, so that a property
+    // change doesn't check the triggers of every action.
+    std::map<std::string, std::vector<const Action*>> property_trigger_actions_;
     std::queue<std::variant<EventTrigger, PropertyChange, BuiltinAction>> event_queue_;
     std::queue<const Action*> current_executing_actions_;
     std::size_t current_command_;
@@ -0,0 +1,110 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "boot_trace.h"
+
+#include <unistd.h>
+
+#include <chrono>
+#include <vector>
+
+#include <android-base/stringprintf.h>
+
+#include "util.h"
+
+using android::base::boot_clock;
+using android::base::StringAppendF;
+
+namespace android {
+namespace init {
+
+namespace {
+
+struct BootTraceRecord {
+    const char* category;
+    std::string name;
+    std::string detail;
+    boot_clock::time_point start;
+    boot_clock::duration duration;
+};
+
+std::vector<BootTraceRecord> records;
+// Index in records of the next record to overwrite, once it is full.
+size_t next_record = 0;
+
+void AppendJsonString(const std::string& string, std::string* out) {
+    out->push_back('"');
+    for (unsigned char c : string) {
+        if (c == '"' || c == '\\') {
+            out->push_back('\\');
+            out->push_back(c);
+        } else if (c < 0x20) {
+            StringAppendF(out, "\\u%04x", c);
+        } else {
+            out->push_back(c);
+        }
+    }
+    out->push_back('"');
+}
+
+}  // namespace
+
+void BootTraceEvent(const char* category, std::string name, boot_clock::time_point start,
+                    boot_clock::time_point end, std::string detail) {
+    BootTraceRecord record = {category, std::move(name), std::move(detail), start, end - start};
+    if (records.size() < kBootTraceCapacity) {
+        records.emplace_back(std::move(record));
+    } else {
+        records[next_record] = std::move(record);
+        next_record = (next_record + 1) % kBootTraceCapacity;
+    }
+}
+
+std::string BootTraceToJson() {
+    using std::chrono::microseconds;
+    std::string json = "{\"traceEvents\":[";
+    pid_t pid = getpid();
+    for (size_t i = 0; i < records.size(); ++i) {
+        const auto& record = records[(next_record + i) % records.size()];
+        if (i != 0) json += ",\n";
+        json += "{\"name\":";
+        AppendJsonString(record.name, &json);
+        StringAppendF(&json, ",\"cat\":\"%s\",\"ph\":\"X\",\"ts\":%lld,\"dur\":%lld,\"pid\":%d,"
+                      "\"tid\":%d",
+                      record.category,
+                      static_cast<long long>(std::chrono::duration_cast<microseconds>(
+                                                     record.start.time_since_epoch())
+                                                     .count()),
+                      static_cast<long long>(
+                              std::chrono::duration_cast<microseconds>(record.duration).count()),
+                      pid, pid);
+        if (!record.detail.empty()) {
+            json += ",\"args\":{\"detail\":";
+            AppendJsonString(record.detail, &json);
+            json += "}";
+        }
+        json += "}";
+    }
+    json += "]}\n";
+    return json;
+}
+
+Result<Success> do_dump_boot_trace(const BuiltinArguments& args) {
+    return WriteFile(args[1], BootTraceToJson());
+}
+
+}  // namespace init
+}  // namespace android
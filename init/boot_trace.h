@@ -0,0 +1,64 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <string>
+
+#include <android-base/chrono_utils.h>
+
+#include "builtin_arguments.h"
+#include "result.h"
+
+namespace android {
+namespace init {
+
+// init keeps the last kBootTraceCapacity timed steps of its work (commands, service starts,
+// property sets and waits) in memory, so that where boot time goes can be seen once boot is done.
+// They are written out in the JSON trace event format, which Perfetto and chrome://tracing load.
+// Timestamps are in CLOCK_BOOTTIME, the clock atrace uses, so the two line up.
+constexpr size_t kBootTraceCapacity = 4096;
+
+void BootTraceEvent(const char* category, std::string name,
+                    android::base::boot_clock::time_point start,
+                    android::base::boot_clock::time_point end, std::string detail = "");
+
+// Records the time between its construction and destruction.
+class ScopedBootTrace {
+  public:
+    ScopedBootTrace(const char* category, std::string name, std::string detail = "")
+        : category_(category),
+          name_(std::move(name)),
+          detail_(std::move(detail)),
+          start_(android::base::boot_clock::now()) {}
+    ~ScopedBootTrace() {
+        BootTraceEvent(category_, std::move(name_), start_, android::base::boot_clock::now(),
+                       std::move(detail_));
+    }
+
+  private:
+    const char* category_;
+    std::string name_;
+    std::string detail_;
+    android::base::boot_clock::time_point start_;
+};
+
+std::string BootTraceToJson();
+
+Result<Success> do_dump_boot_trace(const BuiltinArguments& args);
+
+}  // namespace init
+}  // namespace android
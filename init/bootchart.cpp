@@ -26,19 +26,27 @@
 #include <time.h>
 #include <unistd.h>
 
+#include <algorithm>
 #include <chrono>
 #include <condition_variable>
 #include <memory>
 #include <mutex>
+#include <string_view>
 #include <thread>
+#include <unordered_map>
 
 #include <android-base/chrono_utils.h>
 #include <android-base/file.h>
 #include <android-base/logging.h>
+#include <android-base/parseint.h>
 #include <android-base/properties.h>
 #include <android-base/stringprintf.h>
+#include <android-base/strings.h>
+#include <android-base/unique_fd.h>
 
+using android::base::StringAppendF;
 using android::base::StringPrintf;
+using android::base::unique_fd;
 using android::base::boot_clock;
 using namespace std::chrono_literals;
 
@@ -90,90 +98,237 @@ static void log_header() {
   fprintf(&*fp, "system.kernel.options = %s\n", kernel_cmdline.c_str());
 }
 
-static void log_uptime(FILE* log) {
-  fprintf(log, "%lld\n", get_uptime_jiffies());
+// What is sampled is kept in memory, and only written out once this much has piled up or
+// bootcharting finishes, so that the writes don't compete with the boot they measure.
+static constexpr size_t kMaxBufferedLog = 4 * 1024 * 1024;
+
+// /proc/<pid>/stat fds kept open between samples, leaving init plenty of fds of its own.
+static constexpr size_t kMaxCachedStatFds = 512;
+
+// A log file in /data/bootchart, written out in large chunks.
+class BootchartLog {
+  public:
+    bool Open(const char* filename) {
+        fd_.reset(TEMP_FAILURE_RETRY(
+                open(filename, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666)));
+        if (fd_ == -1) {
+            PLOG(ERROR) << "bootchart: failed to open " << filename;
+            return false;
+        }
+        buffer_.reserve(kMaxBufferedLog);
+        return true;
+    }
+
+    std::string& buffer() { return buffer_; }
+
+    void Flush(bool force) {
+        if (buffer_.empty() || (!force && buffer_.size() < kMaxBufferedLog)) return;
+        if (!android::base::WriteFully(fd_, buffer_.data(), buffer_.size())) {
+            PLOG(ERROR) << "bootchart: failed to write log";
+        }
+        buffer_.clear();
+    }
+
+  private:
+    unique_fd fd_;
+    std::string buffer_;
+};
+
+// Reads the procfs file open as |fd| into |content|, reusing its storage. procfs regenerates
+// a file on every read from its start, so it only has to be opened once.
+static bool read_proc_file(int fd, std::string* content) {
+    content->clear();
+    char buf[4096];
+    off64_t offset = 0;
+    while (true) {
+        ssize_t n = TEMP_FAILURE_RETRY(pread64(fd, buf, sizeof(buf), offset));
+        if (n < 0) return false;
+        if (n == 0) return true;
+        content->append(buf, n);
+        offset += n;
+    }
 }
 
-static void log_file(FILE* log, const char* procfile) {
-  log_uptime(log);
+static unique_fd open_proc_file(const std::string& path) {
+    unique_fd fd(TEMP_FAILURE_RETRY(open(path.c_str(), O_RDONLY | O_CLOEXEC)));
+    if (fd == -1) PLOG(ERROR) << "bootchart: failed to open " << path;
+    return fd;
+}
 
-  std::string content;
-  if (android::base::ReadFileToString(procfile, &content)) {
-    fprintf(log, "%s\n", content.c_str());
-  }
+static void log_uptime(std::string* log) {
+    StringAppendF(log, "%lld\n", get_uptime_jiffies());
+}
+
+static void log_file(BootchartLog* log, int fd, std::string* scratch) {
+    log_uptime(&log->buffer());
+
+    if (read_proc_file(fd, scratch)) {
+        log->buffer().append(*scratch);
+        log->buffer().push_back('\n');
+    }
 }
 
-static void log_processes(FILE* log) {
-  log_uptime(log);
-
-  std::unique_ptr<DIR, int(*)(DIR*)> dir(opendir("/proc"), closedir);
-  struct dirent* entry;
-  while ((entry = readdir(dir.get())) != NULL) {
-    // Only match numeric values.
-    int pid = atoi(entry->d_name);
-    if (pid == 0) continue;
-
-    // /proc/<pid>/stat only has truncated task names, so get the full
-    // name from /proc/<pid>/cmdline.
-    std::string cmdline;
-    android::base::ReadFileToString(StringPrintf("/proc/%d/cmdline", pid), &cmdline);
-    const char* full_name = cmdline.c_str(); // So we stop at the first NUL.
-
-    // Read process stat line.
-    std::string stat;
-    if (android::base::ReadFileToString(StringPrintf("/proc/%d/stat", pid), &stat)) {
-      if (!cmdline.empty()) {
-        // Substitute the process name with its real name.
-        size_t open = stat.find('(');
-        size_t close = stat.find_last_of(')');
-        if (open != std::string::npos && close != std::string::npos) {
-          stat.replace(open + 1, close - open - 1, full_name);
+// Samples /proc/<pid>/stat of every process, keeping their fds open and only reading the full
+// name of a process from /proc/<pid>/cmdline when the name in its stat line changes.
+class ProcessSampler {
+  public:
+    bool Open() {
+        dir_.reset(opendir("/proc"));
+        if (!dir_) PLOG(ERROR) << "bootchart: failed to open /proc";
+        return dir_ != nullptr;
+    }
+
+    void Sample(BootchartLog* log) {
+        std::string* out = &log->buffer();
+        log_uptime(out);
+        ++generation_;
+
+        rewinddir(dir_.get());
+        struct dirent* entry;
+        while ((entry = readdir(dir_.get())) != NULL) {
+            // Only match numeric values.
+            int pid = atoi(entry->d_name);
+            if (pid == 0) continue;
+
+            Process& process = processes_[pid];
+            if (!ReadStat(pid, &process)) {
+                processes_.erase(pid);
+                continue;
+            }
+            process.generation = generation_;
+
+            // /proc/<pid>/stat only has truncated task names, so use the full
+            // name from /proc/<pid>/cmdline.
+            size_t open = stat_.find('(');
+            size_t close = stat_.find_last_of(')');
+            if (open == std::string::npos || close == std::string::npos) {
+                out->append(stat_);
+                continue;
+            }
+            std::string_view comm(stat_.data() + open + 1, close - open - 1);
+            if (comm != process.comm) {
+                process.comm = comm;
+                std::string cmdline;
+                android::base::ReadFileToString(StringPrintf("/proc/%d/cmdline", pid), &cmdline);
+                process.name = cmdline.c_str();  // So we stop at the first NUL.
+            }
+            if (process.name.empty()) {
+                out->append(stat_);
+            } else {
+                out->append(stat_, 0, open + 1);
+                out->append(process.name);
+                out->append(stat_, close, std::string::npos);
+            }
+        }
+        out->push_back('\n');
+
+        // Forget about the processes that are gone.
+        for (auto it = processes_.begin(); it != processes_.end();) {
+            if (it->second.generation != generation_) {
+                if (it->second.stat_fd != -1) --cached_fds_;
+                it = processes_.erase(it);
+            } else {
+                ++it;
+            }
         }
-      }
-      fputs(stat.c_str(), log);
     }
-  }
 
-  fputc('\n', log);
-}
+  private:
+    struct Process {
+        unique_fd stat_fd;
+        std::string comm;
+        std::string name;
+        uint64_t generation = 0;
+    };
+
+    // Reads the stat line of |pid| into stat_, through its cached fd if it has one.
+    bool ReadStat(int pid, Process* process) {
+        std::string path = StringPrintf("/proc/%d/stat", pid);
+        if (process->stat_fd != -1) {
+            if (read_proc_file(process->stat_fd, &stat_)) return true;
+            // Either the process is gone, or it is gone and its pid reused.
+            process->stat_fd.reset();
+            --cached_fds_;
+            process->comm.clear();
+        }
+        if (cached_fds_ >= kMaxCachedStatFds) {
+            return android::base::ReadFileToString(path, &stat_);
+        }
+        process->stat_fd.reset(TEMP_FAILURE_RETRY(open(path.c_str(), O_RDONLY | O_CLOEXEC)));
+        if (process->stat_fd == -1) return false;
+        ++cached_fds_;
+        return read_proc_file(process->stat_fd, &stat_);
+    }
+
+    std::unique_ptr<DIR, int (*)(DIR*)> dir_{nullptr, closedir};
+    std::unordered_map<int, Process> processes_;
+    size_t cached_fds_ = 0;
+    uint64_t generation_ = 0;
+    std::string stat_;
+};
 
-static void bootchart_thread_main() {
+static void bootchart_thread_main(std::chrono::milliseconds interval) {
   LOG(INFO) << "Bootcharting started";
 
   // Open log files.
-  auto stat_log = fopen_unique("/data/bootchart/proc_stat.log", "we");
-  if (!stat_log) return;
-  auto proc_log = fopen_unique("/data/bootchart/proc_ps.log", "we");
-  if (!proc_log) return;
-  auto disk_log = fopen_unique("/data/bootchart/proc_diskstats.log", "we");
-  if (!disk_log) return;
+  BootchartLog stat_log;
+  if (!stat_log.Open("/data/bootchart/proc_stat.log")) return;
+  BootchartLog proc_log;
+  if (!proc_log.Open("/data/bootchart/proc_ps.log")) return;
+  BootchartLog disk_log;
+  if (!disk_log.Open("/data/bootchart/proc_diskstats.log")) return;
+
+  unique_fd proc_stat = open_proc_file("/proc/stat");
+  if (proc_stat == -1) return;
+  unique_fd proc_diskstats = open_proc_file("/proc/diskstats");
+  if (proc_diskstats == -1) return;
+  ProcessSampler processes;
+  if (!processes.Open()) return;
 
   log_header();
 
+  std::string scratch;
+  auto next = std::chrono::steady_clock::now();
   while (true) {
+    next += interval;
     {
       std::unique_lock<std::mutex> lock(g_bootcharting_finished_mutex);
-      g_bootcharting_finished_cv.wait_for(lock, 200ms);
+      g_bootcharting_finished_cv.wait_until(lock, next, [] { return g_bootcharting_finished; });
       if (g_bootcharting_finished) break;
     }
 
-    log_file(&*stat_log, "/proc/stat");
-    log_file(&*disk_log, "/proc/diskstats");
-    log_processes(&*proc_log);
+    log_file(&stat_log, proc_stat, &scratch);
+    log_file(&disk_log, proc_diskstats, &scratch);
+    processes.Sample(&proc_log);
+
+    stat_log.Flush(false);
+    disk_log.Flush(false);
+    proc_log.Flush(false);
   }
 
+  stat_log.Flush(true);
+  disk_log.Flush(true);
+  proc_log.Flush(true);
+
   LOG(INFO) << "Bootcharting finished";
 }
 
 static Result<Success> do_bootchart_start() {
-    // We don't care about the content, but we do care that /data/bootchart/enabled actually exists.
+    // We do care that /data/bootchart/enabled actually exists. Its content, if any, is the
+    // sampling interval in milliseconds.
     std::string start;
     if (!android::base::ReadFileToString("/data/bootchart/enabled", &start)) {
         LOG(VERBOSE) << "Not bootcharting";
         return Success();
     }
 
-    g_bootcharting_thread = new std::thread(bootchart_thread_main);
+    // Samples are timestamped in jiffies, sampling more often than that is pointless.
+    unsigned int interval_ms = 200;
+    android::base::ParseUint(android::base::Trim(start), &interval_ms, 10000u);
+    interval_ms = std::max(interval_ms, 10u);
+
+    g_bootcharting_thread =
+            new std::thread(bootchart_thread_main, std::chrono::milliseconds(interval_ms));
     return Success();
 }
 
@@ -61,6 +61,7 @@
 #include <system/thread_defs.h>
 
 #include "action_manager.h"
+#include "boot_trace.h"
 #include "bootchart.h"
 #include "init.h"
 #include "parser.h"
@@ -1112,6 +1113,7 @@ const BuiltinFunctionMap::Map& BuiltinFunctionMap::map() const {
         {"class_stop",              {1,     1,    {false,  do_class_stop}}},
         {"copy",                    {2,     2,    {true,   do_copy}}},
         {"domainname",              {1,     1,    {true,   do_domainname}}},
+        {"dump_boot_trace",         {1,     1,    {false,  do_dump_boot_trace}}},
         {"enable",                  {1,     1,    {false,  do_enable}}},
         {"exec",                    {1,     kMax, {false,  do_exec}}},
         {"exec_background",         {1,     kMax, {false,  do_exec_background}}},
@@ -134,13 +134,17 @@ bool Permissions::Match(const std::string& path) const {
 bool SysfsPermissions::MatchWithSubsystem(const std::string& path,
                                           const std::string& subsystem) const {
     std::string path_basename = Basename(path);
-    if (name().find(subsystem) != std::string::npos) {
+    if (MatchesSubsystem(subsystem)) {
         if (Match("/sys/class/" + subsystem + "/" + path_basename)) return true;
         if (Match("/sys/bus/" + subsystem + "/devices/" + path_basename)) return true;
     }
     return Match(path);
 }
 
+bool SysfsPermissions::MatchesSubsystem(const std::string& subsystem) const {
+    return name().find(subsystem) != std::string::npos;
+}
+
 void SysfsPermissions::SetPermissions(const std::string& path) const {
     std::string attribute_file = path + "/" + attribute_;
     LOG(VERBOSE) << "fixup " << attribute_file << " " << uid() << " " << gid() << " " << std::oct
@@ -157,6 +161,47 @@ void SysfsPermissions::SetPermissions(const std::string& path) const {
     }
 }
 
+void PermissionsMatcher::Add(size_t index, const Permissions& permissions) {
+    if (permissions.wildcard_) {
+        wildcard_rules_.emplace_back(index, permissions.name_);
+        return;
+    }
+
+    size_t node = 0;
+    for (char c : permissions.name_) {
+        auto [it, inserted] = nodes_[node].children.emplace(c, nodes_.size());
+        node = it->second;
+        if (inserted) nodes_.emplace_back();
+    }
+    if (permissions.prefix_) {
+        nodes_[node].prefix_rules.emplace_back(index);
+    } else {
+        nodes_[node].exact_rules.emplace_back(index);
+    }
+}
+
+void PermissionsMatcher::FindMatches(const std::string& path, std::vector<size_t>* matches) const {
+    size_t node = 0;
+    for (size_t i = 0;; ++i) {
+        matches->insert(matches->end(), nodes_[node].prefix_rules.begin(),
+                        nodes_[node].prefix_rules.end());
+        if (i == path.size()) {
+            matches->insert(matches->end(), nodes_[node].exact_rules.begin(),
+                            nodes_[node].exact_rules.end());
+            break;
+        }
+        auto it = nodes_[node].children.find(path[i]);
+        if (it == nodes_[node].children.end()) break;
+        node = it->second;
+    }
+
+    for (const auto& [index, pattern] : wildcard_rules_) {
+        if (fnmatch(pattern.c_str(), path.c_str(), FNM_PATHNAME) == 0) {
+            matches->emplace_back(index);
+        }
+    }
+}
+
 // Given a path that may start with a platform device, find the parent platform device by finding a
 // parent directory with a 'subsystem' symlink that points to the platform bus.
 // If it doesn't start with a platform device, return false
@@ -194,8 +239,24 @@ void DeviceHandler::FixupSysPermissions(const std::string& upath,
     // contain, so we prepend it...
     std::string path = "/sys" + upath;
 
-    for (const auto& s : sysfs_permissions_) {
-        if (s.MatchWithSubsystem(path, subsystem)) s.SetPermissions(path);
+    // Collect the rules that MatchWithSubsystem() would accept, then apply them in their order in
+    // the list.
+    std::vector<size_t> matches;
+    sysfs_permissions_matcher_.FindMatches(path, &matches);
+    std::vector<size_t> subsystem_matches;
+    std::string path_basename = Basename(path);
+    sysfs_permissions_matcher_.FindMatches("/sys/class/" + subsystem + "/" + path_basename,
+                                           &subsystem_matches);
+    sysfs_permissions_matcher_.FindMatches("/sys/bus/" + subsystem + "/devices/" + path_basename,
+                                           &subsystem_matches);
+    for (size_t index : subsystem_matches) {
+        if (sysfs_permissions_[index].MatchesSubsystem(subsystem)) matches.emplace_back(index);
+    }
+    std::sort(matches.begin(), matches.end());
+    matches.erase(std::unique(matches.begin(), matches.end()), matches.end());
+
+    for (size_t index : matches) {
+        sysfs_permissions_[index].SetPermissions(path);
     }
 
     if (!skip_restorecon_ && access(path.c_str(), F_OK) == 0) {
@@ -208,15 +269,17 @@ void DeviceHandler::FixupSysPermissions(const std::string& upath,
 
 std::tuple<mode_t, uid_t, gid_t> DeviceHandler::GetDevicePermissions(
     const std::string& path, const std::vector<std::string>& links) const {
-    // Search the perms list in reverse so that ueventd.$hardware can override ueventd.rc.
-    for (auto it = dev_permissions_.crbegin(); it != dev_permissions_.crend(); ++it) {
-        if (it->Match(path) || std::any_of(links.cbegin(), links.cend(),
-                                           [it](const auto& link) { return it->Match(link); })) {
-            return {it->perm(), it->uid(), it->gid()};
-        }
+    std::vector<size_t> matches;
+    dev_permissions_matcher_.FindMatches(path, &matches);
+    for (const auto& link : links) {
+        dev_permissions_matcher_.FindMatches(link, &matches);
     }
     /* Default if nothing found. */
-    return {0600, 0, 0};
+    if (matches.empty()) return {0600, 0, 0};
+
+    // Use the last matching rule in the list so that ueventd.$hardware can override ueventd.rc.
+    const auto& permissions = dev_permissions_[*std::max_element(matches.begin(), matches.end())];
+    return {permissions.perm(), permissions.uid(), permissions.gid()};
 }
 
 void DeviceHandler::MakeDevice(const std::string& path, bool block, int major, int minor,
@@ -433,6 +496,8 @@ DeviceHandler::DeviceHandler(std::vector<Permissions> dev_permissions,
                              bool skip_restorecon)
     : dev_permissions_(std::move(dev_permissions)),
       sysfs_permissions_(std::move(sysfs_permissions)),
+      dev_permissions_matcher_(dev_permissions_),
+      sysfs_permissions_matcher_(sysfs_permissions_),
       subsystems_(std::move(subsystems)),
       boot_devices_(std::move(boot_devices)),
       skip_restorecon_(skip_restorecon),
@@ -21,6 +21,7 @@
 #include <sys/types.h>
 
 #include <algorithm>
+#include <map>
 #include <set>
 #include <string>
 #include <vector>
@@ -36,6 +37,7 @@ namespace init {
 
 class Permissions {
   public:
+    friend class PermissionsMatcher;
     friend void TestPermissions(const Permissions& expected, const Permissions& test);
 
     Permissions(const std::string& name, mode_t perm, uid_t uid, gid_t gid);
@@ -67,12 +69,44 @@ class SysfsPermissions : public Permissions {
         : Permissions(name, perm, uid, gid), attribute_(attribute) {}
 
     bool MatchWithSubsystem(const std::string& path, const std::string& subsystem) const;
+    // Whether MatchWithSubsystem() also tries the /sys/class and /sys/bus paths for 'subsystem'.
+    bool MatchesSubsystem(const std::string& subsystem) const;
     void SetPermissions(const std::string& path) const;
 
   private:
     const std::string attribute_;
 };
 
+// Finds the rules in a list of Permissions that match a path without trying each of them in turn.
+// Exact names and names that only end with '*' are looked up in a trie of their characters, and
+// only names with other wildcards are matched one by one with fnmatch().
+class PermissionsMatcher {
+  public:
+    PermissionsMatcher() : nodes_(1) {}
+    template <typename T>
+    explicit PermissionsMatcher(const std::vector<T>& permissions) : PermissionsMatcher() {
+        for (size_t i = 0; i < permissions.size(); ++i) {
+            Add(i, permissions[i]);
+        }
+    }
+
+    // Appends the indices of the rules that match 'path' to 'matches', in no particular order.
+    void FindMatches(const std::string& path, std::vector<size_t>* matches) const;
+
+  private:
+    struct Node {
+        std::map<char, size_t> children;
+        std::vector<size_t> exact_rules;
+        std::vector<size_t> prefix_rules;
+    };
+
+    void Add(size_t index, const Permissions& permissions);
+
+    // nodes_[0] is the root, for the empty prefix.
+    std::vector<Node> nodes_;
+    std::vector<std::pair<size_t, std::string>> wildcard_rules_;
+};
+
 class Subsystem {
   public:
     friend class SubsystemParser;
@@ -133,6 +167,8 @@ class DeviceHandler : public UeventHandler {
 
     std::vector<Permissions> dev_permissions_;
     std::vector<SysfsPermissions> sysfs_permissions_;
+    PermissionsMatcher dev_permissions_matcher_;
+    PermissionsMatcher sysfs_permissions_matcher_;
     std::vector<Subsystem> subsystems_;
     std::set<std::string> boot_devices_;
     bool skip_restorecon_;
@@ -0,0 +1,74 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "devices.h"
+
+#include <string>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+namespace android {
+namespace init {
+
+// A rule set shaped like a device's ueventd.rc files: mostly exact names and prefixes, with a few
+// other wildcards.
+static std::vector<Permissions> MakePermissions() {
+    std::vector<Permissions> permissions;
+    for (int i = 0; i < 300; ++i) {
+        permissions.emplace_back("/dev/device" + std::to_string(i), 0660, 0, 1000);
+    }
+    for (int i = 0; i < 100; ++i) {
+        permissions.emplace_back("/dev/class" + std::to_string(i) + "/*", 0660, 0, 1000);
+    }
+    for (int i = 0; i < 10; ++i) {
+        permissions.emplace_back("/dev/wild" + std::to_string(i) + "*name", 0660, 0, 1000);
+    }
+    return permissions;
+}
+
+static const std::vector<std::string> kPaths = {
+    "/dev/device150", "/dev/class42/node0", "/dev/wild3_abc_name", "/dev/block/sda1",
+};
+
+static void BM_PermissionsMatchEach(benchmark::State& state) {
+    auto permissions = MakePermissions();
+    while (state.KeepRunning()) {
+        for (const auto& path : kPaths) {
+            for (auto it = permissions.crbegin(); it != permissions.crend(); ++it) {
+                if (it->Match(path)) break;
+            }
+        }
+    }
+}
+BENCHMARK(BM_PermissionsMatchEach);
+
+static void BM_PermissionsMatcher(benchmark::State& state) {
+    auto permissions = MakePermissions();
+    PermissionsMatcher matcher(permissions);
+    std::vector<size_t> matches;
+    while (state.KeepRunning()) {
+        for (const auto& path : kPaths) {
+            matches.clear();
+            matcher.FindMatches(path, &matches);
+            benchmark::DoNotOptimize(matches.data());
+        }
+    }
+}
+BENCHMARK(BM_PermissionsMatcher);
+
+}  // namespace init
+}  // namespace android
@@ -309,5 +309,33 @@ TEST(device_handler, SysfsPermissionsMatchWithSubsystemBus) {
     EXPECT_EQ(1001U, permissions.gid());
 }
 
+TEST(device_handler, PermissionsMatcher) {
+    std::vector<Permissions> permissions = {
+        {"/dev/null", 0666, 0, 0},
+        {"/dev/dri/*", 0666, 0, 1000},
+        {"/dev/device*name", 0666, 0, 1000},
+        {"/dev/device*name*", 0666, 0, 1000},
+        {"/dev/dri/card0", 0660, 0, 1000},
+        {"/dev/null", 0600, 0, 0},
+        {"/dev/*", 0600, 0, 0},
+        {"*", 0600, 0, 0},
+    };
+    PermissionsMatcher matcher(permissions);
+
+    for (const auto& path :
+         {"/dev/null", "/dev/nul", "/dev/nullsuffix", "/dev/dri/", "/dev/dri/card0",
+          "/dev/dri/card0/x", "/dev/dr/non_match", "/dev/devicename", "/dev/device123namesomething",
+          "/dev/device123name/something", "/sys/null", "", "/"}) {
+        std::vector<size_t> expected;
+        for (size_t i = 0; i < permissions.size(); ++i) {
+            if (permissions[i].Match(path)) expected.emplace_back(i);
+        }
+        std::vector<size_t> matches;
+        matcher.FindMatches(path, &matches);
+        std::sort(matches.begin(), matches.end());
+        EXPECT_EQ(expected, matches) << path;
+    }
+}
+
 }  // namespace init
 }  // namespace android
@@ -59,6 +59,21 @@ static bool IsBooting() {
 FirmwareHandler::FirmwareHandler(std::vector<std::string> firmware_directories)
     : firmware_directories_(std::move(firmware_directories)) {}
 
+bool FirmwareHandler::OpenFirmware(const std::string& firmware, std::string* file, unique_fd* fd,
+                                   size_t* size) const {
+    for (const auto& firmware_directory : firmware_directories_) {
+        *file = firmware_directory + firmware;
+        fd->reset(open(file->c_str(), O_RDONLY | O_CLOEXEC));
+        struct stat sb;
+        if (*fd != -1 && fstat(*fd, &sb) != -1) {
+            *size = sb.st_size;
+            return true;
+        }
+    }
+    fd->reset();
+    return false;
+}
+
 void FirmwareHandler::ProcessFirmwareEvent(const Uevent& uevent) {
     int booting = IsBooting();
 
@@ -81,14 +96,12 @@ void FirmwareHandler::ProcessFirmwareEvent(const Uevent& uevent) {
     }
 
 try_loading_again:
-    for (const auto& firmware_directory : firmware_directories_) {
-        std::string file = firmware_directory + uevent.firmware;
-        unique_fd fw_fd(open(file.c_str(), O_RDONLY | O_CLOEXEC));
-        struct stat sb;
-        if (fw_fd != -1 && fstat(fw_fd, &sb) != -1) {
-            LoadFirmware(uevent, root, fw_fd, sb.st_size, loading_fd, data_fd);
-            return;
-        }
+    std::string file;
+    unique_fd fw_fd;
+    size_t fw_size;
+    if (OpenFirmware(uevent.firmware, &file, &fw_fd, &fw_size)) {
+        LoadFirmware(uevent, root, fw_fd, fw_size, loading_fd, data_fd);
+        return;
     }
 
     if (booting) {
@@ -121,5 +134,29 @@ void FirmwareHandler::HandleUevent(const Uevent& uevent) {
     }
 }
 
+void FirmwareHandler::PreloadFirmware(const std::vector<std::string>& firmware) const {
+    auto pid = fork();
+    if (pid == -1) {
+        PLOG(ERROR) << "could not fork to preload firmware";
+    }
+    if (pid != 0) return;
+
+    Timer t;
+    for (const auto& name : firmware) {
+        std::string file;
+        unique_fd fw_fd;
+        size_t fw_size;
+        if (!OpenFirmware(name, &file, &fw_fd, &fw_size)) {
+            LOG(WARNING) << "firmware: could not find '" << name << "' to preload";
+            continue;
+        }
+        if (readahead(fw_fd, 0, fw_size) == -1) {
+            PLOG(WARNING) << "firmware: readahead of '" << file << "' failed";
+        }
+    }
+    LOG(INFO) << "preloading " << firmware.size() << " firmware files took " << t;
+    _exit(EXIT_SUCCESS);
+}
+
 }  // namespace init
 }  // namespace android
@@ -20,6 +20,8 @@
 #include <string>
 #include <vector>
 
+#include <android-base/unique_fd.h>
+
 #include "uevent.h"
 #include "uevent_handler.h"
 
@@ -33,7 +35,13 @@ class FirmwareHandler : public UeventHandler {
 
     void HandleUevent(const Uevent& uevent) override;
 
+    // Reads the given firmware into the page cache from a child process, so that the requests
+    // drivers make for it during coldboot don't have to wait for storage.
+    void PreloadFirmware(const std::vector<std::string>& firmware) const;
+
   private:
+    bool OpenFirmware(const std::string& firmware, std::string* file, android::base::unique_fd* fd,
+                      size_t* size) const;
     void ProcessFirmwareEvent(const Uevent& uevent);
 
     std::vector<std::string> firmware_directories_;
@@ -21,6 +21,7 @@
 #include <unistd.h>
 
 #include <chrono>
+#include <map>
 #include <memory>
 #include <set>
 #include <string>
@@ -81,7 +82,8 @@ class FirstStageMount {
     bool TrySkipMountingPartitions();
     bool IsDmLinearEnabled();
     bool GetDmLinearMetadataDevice();
-    bool InitDmLinearBackingDevices(const android::fs_mgr::LpMetadata& metadata);
+    void InitDmLinearBackingDevices();
+    void HandleSeenRequiredDevices();
     void UseGsiIfPresent();
 
     ListenerAction UeventCallback(const Uevent& uevent);
@@ -94,7 +96,12 @@ class FirstStageMount {
 
     Fstab fstab_;
     std::string lp_metadata_partition_;
+    std::unique_ptr<android::fs_mgr::LpMetadata> lp_metadata_;
     std::set<std::string> required_devices_partition_names_;
+    // Every block device uevent seen so far, by partition name. Devices that only become required
+    // later, such as the ones backing the super partition, are looked up here instead of walking
+    // /sys again.
+    std::map<std::string, Uevent> block_uevents_;
     std::string super_partition_name_;
     std::unique_ptr<DeviceHandler> device_handler_;
     UeventListener uevent_listener_;
@@ -271,28 +278,39 @@ bool FirstStageMount::InitRequiredDevices() {
     return true;
 }
 
-bool FirstStageMount::InitDmLinearBackingDevices(const android::fs_mgr::LpMetadata& metadata) {
-    auto partition_names = android::fs_mgr::GetBlockDevicePartitionNames(metadata);
+// Called as soon as the super partition's device node exists, so that the devices backing it are
+// waited for together with the rest of the required devices rather than after them.
+void FirstStageMount::InitDmLinearBackingDevices() {
+    lp_metadata_ = android::fs_mgr::ReadCurrentMetadata(lp_metadata_partition_);
+    if (!lp_metadata_) {
+        return;
+    }
+
+    const auto super_device = android::fs_mgr::GetMetadataSuperBlockDevice(*lp_metadata_.get());
+    auto partition_names = android::fs_mgr::GetBlockDevicePartitionNames(*lp_metadata_.get());
     for (const auto& partition_name : partition_names) {
-        const auto super_device = android::fs_mgr::GetMetadataSuperBlockDevice(metadata);
         if (partition_name == android::fs_mgr::GetBlockDevicePartitionName(*super_device)) {
             continue;
         }
         required_devices_partition_names_.emplace(partition_name);
     }
-    if (required_devices_partition_names_.empty()) {
-        return true;
-    }
-
-    auto uevent_callback = [this](const Uevent& uevent) { return UeventCallback(uevent); };
-    uevent_listener_.RegenerateUevents(uevent_callback);
+    HandleSeenRequiredDevices();
+}
 
-    if (!required_devices_partition_names_.empty()) {
-        LOG(ERROR) << __PRETTY_FUNCTION__ << ": partition(s) not found after polling timeout: "
-                   << android::base::Join(required_devices_partition_names_, ", ");
-        return false;
+// Creates the required devices whose uevents have already been seen and removes them from
+// required_devices_partition_names_.
+void FirstStageMount::HandleSeenRequiredDevices() {
+    for (auto iter = required_devices_partition_names_.begin();
+         iter != required_devices_partition_names_.end();) {
+        auto seen = block_uevents_.find(*iter);
+        if (seen == block_uevents_.end()) {
+            ++iter;
+            continue;
+        }
+        LOG(VERBOSE) << __PRETTY_FUNCTION__ << ": found partition: " << *iter;
+        device_handler_->HandleUevent(seen->second);
+        iter = required_devices_partition_names_.erase(iter);
     }
-    return true;
 }
 
 bool FirstStageMount::CreateLogicalPartitions() {
@@ -305,30 +323,28 @@ bool FirstStageMount::CreateLogicalPartitions() {
         return false;
     }
 
-    auto metadata = android::fs_mgr::ReadCurrentMetadata(lp_metadata_partition_);
-    if (!metadata) {
+    if (!lp_metadata_) {
         LOG(ERROR) << "Could not read logical partition metadata from " << lp_metadata_partition_;
         return false;
     }
-    if (!InitDmLinearBackingDevices(*metadata.get())) {
-        return false;
-    }
-    return android::fs_mgr::CreateLogicalPartitions(*metadata.get(), lp_metadata_partition_);
+    return android::fs_mgr::CreateLogicalPartitions(*lp_metadata_.get(), lp_metadata_partition_);
 }
 
 ListenerAction FirstStageMount::HandleBlockDevice(const std::string& name, const Uevent& uevent) {
     // Matches partition name to create device nodes.
     // Both required_devices_partition_names_ and uevent->partition_name have A/B
     // suffix when A/B is used.
+    block_uevents_.emplace(name, uevent);
     auto iter = required_devices_partition_names_.find(name);
     if (iter != required_devices_partition_names_.end()) {
         LOG(VERBOSE) << __PRETTY_FUNCTION__ << ": found partition: " << *iter;
+        required_devices_partition_names_.erase(iter);
+        device_handler_->HandleUevent(uevent);
         if (IsDmLinearEnabled() && name == super_partition_name_) {
             std::vector<std::string> links = device_handler_->GetBlockDeviceSymlinks(uevent);
             lp_metadata_partition_ = links[0];
+            InitDmLinearBackingDevices();
         }
-        required_devices_partition_names_.erase(iter);
-        device_handler_->HandleUevent(uevent);
         if (required_devices_partition_names_.empty()) {
             return ListenerAction::kStop;
         } else {
@@ -507,9 +523,14 @@ bool FirstStageMount::MountPartitions() {
     for (auto const& device : devices) {
         if (android::base::StartsWith(device, "/dev/block/by-name/")) {
             required_devices_partition_names_.emplace(basename(device.c_str()));
+            HandleSeenRequiredDevices();
+            if (required_devices_partition_names_.empty()) continue;
+
             auto uevent_callback = [this](const Uevent& uevent) { return UeventCallback(uevent); };
             uevent_listener_.RegenerateUevents(uevent_callback);
-            uevent_listener_.Poll(uevent_callback, 10s);
+            if (!required_devices_partition_names_.empty()) {
+                uevent_listener_.Poll(uevent_callback, 10s);
+            }
         } else {
             InitMappedDevice(device);
         }
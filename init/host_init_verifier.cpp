@@ -15,6 +15,7 @@
 //
 
 #include <errno.h>
+#include <getopt.h>
 #include <pwd.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -45,6 +46,7 @@ using namespace std::literals;
 using android::base::ParseInt;
 using android::base::ReadFileToString;
 using android::base::Split;
+using android::base::WriteStringToFile;
 
 static std::string passwd_file;
 
@@ -124,34 +126,112 @@ static Result<Success> do_stub(const BuiltinArguments& args) {
 
 #include "generated_stub_builtin_function_map.h"
 
+static Parser CreateParser() {
+    ActionManager& am = ActionManager::GetInstance();
+    ServiceList& sl = ServiceList::GetInstance();
+    Parser parser;
+    parser.AddSectionParser("service", std::make_unique<ServiceParser>(&sl, nullptr));
+    parser.AddSectionParser("on", std::make_unique<ActionParser>(&am, nullptr));
+    parser.AddSectionParser("import", std::make_unique<HostImportParser>());
+    return parser;
+}
+
+// Checks each of the given <on-device path>=<host path> files and writes them to output as one
+// compiled config, which init loads instead of tokenizing them again on boot.
+static int CompileConfigs(const std::string& output, const std::vector<std::string>& files) {
+    Parser parser = CreateParser();
+    CompiledConfig config;
+    for (const auto& file : files) {
+        auto equal_pos = file.find('=');
+        if (equal_pos == std::string::npos) {
+            LOG(ERROR) << "Expected <on-device path>=<host path>, got '" << file << "'";
+            return EXIT_FAILURE;
+        }
+        std::string device_path = file.substr(0, equal_pos);
+        std::string host_path = file.substr(equal_pos + 1);
+
+        std::string contents;
+        if (!ReadFileToString(host_path, &contents) ||
+            !parser.ParseConfigFileInsecure(host_path)) {
+            LOG(ERROR) << "Failed to open init rc script '" << host_path << "'";
+            return EXIT_FAILURE;
+        }
+        if (parser.parse_error_count() > 0) {
+            LOG(ERROR) << "Failed to parse init script '" << host_path << "' with "
+                       << parser.parse_error_count() << " errors";
+            return EXIT_FAILURE;
+        }
+        *config.add_files() = CompileConfigFile(device_path, std::move(contents));
+    }
+
+    std::string data;
+    if (!config.SerializeToString(&data) || !WriteStringToFile(data, output)) {
+        LOG(ERROR) << "Failed to write compiled config '" << output << "'";
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
+
+static void PrintUsage(const char* name) {
+    LOG(ERROR) << "Usage: " << name << " <init rc file> [passwd file]\n"
+               << "       " << name
+               << " --compile=<output> [--passwd=<passwd file>] <on-device path>=<host path>...";
+}
+
 int main(int argc, char** argv) {
     android::base::InitLogging(argv, &android::base::StdioLogger);
     android::base::SetMinimumLogSeverity(android::base::ERROR);
 
-    if (argc != 2 && argc != 3) {
-        LOG(ERROR) << "Usage: " << argv[0] << " <init rc file> [passwd file]";
+    static const struct option long_options[] = {
+            {"compile", required_argument, nullptr, 'c'},
+            {"passwd", required_argument, nullptr, 'p'},
+            {nullptr, 0, nullptr, 0},
+    };
+    std::string compile_output;
+    int opt;
+    while ((opt = getopt_long(argc, argv, "", long_options, nullptr)) != -1) {
+        switch (opt) {
+            case 'c':
+                compile_output = optarg;
+                break;
+            case 'p':
+                passwd_file = optarg;
+                break;
+            default:
+                PrintUsage(argv[0]);
+                return EXIT_FAILURE;
+        }
+    }
+
+    const BuiltinFunctionMap function_map;
+    Action::set_function_map(&function_map);
+
+    if (!compile_output.empty()) {
+        if (optind == argc) {
+            PrintUsage(argv[0]);
+            return EXIT_FAILURE;
+        }
+        return CompileConfigs(compile_output, std::vector<std::string>(argv + optind, argv + argc));
+    }
+
+    if (argc - optind != 1 && argc - optind != 2) {
+        PrintUsage(argv[0]);
         return EXIT_FAILURE;
     }
+    const char* init_rc = argv[optind];
 
-    if (argc == 3) {
-        passwd_file = argv[2];
+    if (argc - optind == 2) {
+        passwd_file = argv[optind + 1];
     }
 
-    const BuiltinFunctionMap function_map;
-    Action::set_function_map(&function_map);
-    ActionManager& am = ActionManager::GetInstance();
-    ServiceList& sl = ServiceList::GetInstance();
-    Parser parser;
-    parser.AddSectionParser("service", std::make_unique<ServiceParser>(&sl, nullptr));
-    parser.AddSectionParser("on", std::make_unique<ActionParser>(&am, nullptr));
-    parser.AddSectionParser("import", std::make_unique<HostImportParser>());
+    Parser parser = CreateParser();
 
-    if (!parser.ParseConfigFileInsecure(argv[1])) {
-        LOG(ERROR) << "Failed to open init rc script '" << argv[1] << "'";
+    if (!parser.ParseConfigFileInsecure(init_rc)) {
+        LOG(ERROR) << "Failed to open init rc script '" << init_rc << "'";
         return EXIT_FAILURE;
     }
     if (parser.parse_error_count() > 0) {
-        LOG(ERROR) << "Failed to parse init script '" << argv[1] << "' with "
+        LOG(ERROR) << "Failed to parse init script '" << init_rc << "' with "
                    << parser.parse_error_count() << " errors";
         return EXIT_FAILURE;
     }
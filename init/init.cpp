@@ -25,6 +25,7 @@
 #include <string.h>
 #include <sys/mount.h>
 #include <sys/signalfd.h>
+#include <sys/timerfd.h>
 #include <sys/types.h>
 #include <unistd.h>
 
@@ -49,6 +50,7 @@
 #endif
 
 #include "action_parser.h"
+#include "boot_trace.h"
 #include "boringssl_self_test.h"
 #include "epoll.h"
 #include "first_stage_mount.h"
@@ -82,6 +84,8 @@ static char qemu[32];
 std::string default_console = "/dev/console";
 
 static int signal_fd = -1;
+static int process_action_timer_fd = -1;
+static std::optional<boot_clock::time_point> process_action_timer_time;
 
 static std::unique_ptr<Timer> waiting_for_prop(nullptr);
 static std::string wait_prop_name;
@@ -122,6 +126,13 @@ static void LoadBootScripts(ActionManager& action_manager, ServiceList& service_
 
     std::string bootscript = GetProperty("ro.boot.init_rc", "");
     if (bootscript.empty()) {
+        // Files compiled by host_init_verifier at build time skip the tokenizer, as long as they
+        // haven't changed since.
+        for (const auto& partition : {"/system", "/product", "/product_services", "/odm",
+                                      "/vendor"}) {
+            parser.LoadCompiledConfig(std::string(partition) + "/etc/init.compiled");
+        }
+
         parser.ParseConfig("/init.rc");
         if (!parser.ParseConfig("/system/etc/init")) {
             late_import_paths.emplace_back("/system/etc/init");
@@ -191,41 +202,14 @@ void property_changed(const std::string& name, const std::string& value) {
     if (waiting_for_prop) {
         if (wait_prop_name == name && wait_prop_value == value) {
             LOG(INFO) << "Wait for property took " << *waiting_for_prop;
+            auto end = boot_clock::now();
+            BootTraceEvent("wait", "wait_for_prop " + name, end - waiting_for_prop->duration(),
+                           end, value);
             ResetWaitForProp();
         }
     }
 }
 
-static std::optional<boot_clock::time_point> HandleProcessActions() {
-    std::optional<boot_clock::time_point> next_process_action_time;
-    for (const auto& s : ServiceList::GetInstance()) {
-        if ((s->flags() & SVC_RUNNING) && s->timeout_period()) {
-            auto timeout_time = s->time_started() + *s->timeout_period();
-            if (boot_clock::now() > timeout_time) {
-                s->Timeout();
-            } else {
-                if (!next_process_action_time || timeout_time < *next_process_action_time) {
-                    next_process_action_time = timeout_time;
-                }
-            }
-        }
-
-        if (!(s->flags() & SVC_RESTARTING)) continue;
-
-        auto restart_time = s->time_started() + s->restart_period();
-        if (boot_clock::now() > restart_time) {
-            if (auto result = s->Start(); !result) {
-                LOG(ERROR) << "Could not restart process '" << s->name() << "': " << result.error();
-            }
-        } else {
-            if (!next_process_action_time || restart_time < *next_process_action_time) {
-                next_process_action_time = restart_time;
-            }
-        }
-    }
-    return next_process_action_time;
-}
-
 static Result<Success> DoControlStart(Service* service) {
     return service->Start();
 }
@@ -554,6 +538,47 @@ static void InstallSignalFdHandler(Epoll* epoll) {
     }
 }
 
+static void HandleProcessActionTimerFd() {
+    // The due restarts and timeouts are handled by the main loop once it may start processes.
+    uint64_t expirations;
+    if (TEMP_FAILURE_RETRY(read(process_action_timer_fd, &expirations, sizeof(expirations))) == -1) {
+        PLOG(ERROR) << "failed to read process action timerfd";
+    }
+    process_action_timer_time.reset();
+}
+
+static void InstallProcessActionTimerFdHandler(Epoll* epoll) {
+    // boot_clock is CLOCK_BOOTTIME, so that the deadlines carry on across suspend.
+    process_action_timer_fd = timerfd_create(CLOCK_BOOTTIME, TFD_CLOEXEC | TFD_NONBLOCK);
+    if (process_action_timer_fd == -1) {
+        PLOG(FATAL) << "failed to create process action timerfd";
+    }
+
+    if (auto result = epoll->RegisterHandler(process_action_timer_fd, HandleProcessActionTimerFd);
+        !result) {
+        LOG(FATAL) << result.error();
+    }
+}
+
+// Wakes the main loop up when the next service is due for a restart or a timeout.
+static void ArmProcessActionTimer(std::optional<boot_clock::time_point> time) {
+    if (time == process_action_timer_time) return;
+
+    itimerspec spec = {};
+    if (time) {
+        auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(time->time_since_epoch());
+        spec.it_value.tv_sec = ns.count() / 1000000000;
+        spec.it_value.tv_nsec = ns.count() % 1000000000;
+        // All zeros would disarm the timer instead.
+        if (spec.it_value.tv_sec == 0 && spec.it_value.tv_nsec == 0) spec.it_value.tv_nsec = 1;
+    }
+    if (timerfd_settime(process_action_timer_fd, TFD_TIMER_ABSTIME, &spec, nullptr) == -1) {
+        PLOG(ERROR) << "failed to arm process action timerfd";
+        return;
+    }
+    process_action_timer_time = time;
+}
+
 void HandleKeychord(const std::vector<int>& keycodes) {
     // Only handle keychords if adb is enabled.
     std::string adb_enabled = android::base::GetProperty("init.svc.adbd", "");
@@ -656,6 +681,7 @@ int SecondStageMain(int argc, char** argv) {
     }
 
     InstallSignalFdHandler(&epoll);
+    InstallProcessActionTimerFdHandler(&epoll);
 
     property_load_boot_defaults();
     fs_mgr_vendor_overlay_mount_all();
@@ -737,14 +763,8 @@ int SecondStageMain(int argc, char** argv) {
         }
         if (!(waiting_for_prop || Service::is_exec_service_running())) {
             if (!shutting_down) {
-                auto next_process_action_time = HandleProcessActions();
-
                 // If there's a process that needs restarting, wake up in time for that.
-                if (next_process_action_time) {
-                    epoll_timeout = std::chrono::ceil<std::chrono::milliseconds>(
-                            *next_process_action_time - boot_clock::now());
-                    if (*epoll_timeout < 0ms) epoll_timeout = 0ms;
-                }
+                ArmProcessActionTimer(Service::HandleProcessActions());
             }
 
             // If there's more work to do, wake up again immediately.
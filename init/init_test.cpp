@@ -112,6 +112,87 @@ execute_third
     TestInitText(init_script, test_function_map, commands, &service_list);
 }
 
+TEST(init, PropertyTriggerOrder) {
+    std::string init_script =
+        R"init(
+on property:init.test.a=1
+execute_first
+
+on property:init.test.b=1
+fail_test
+
+on property:init.test.a=*
+execute_second
+
+on property:init.test.a=2
+fail_test
+
+)init";
+
+    int num_executed = 0;
+    TestFunctionMap test_function_map;
+    test_function_map.Add("execute_first", [&num_executed]() { EXPECT_EQ(0, num_executed++); });
+    test_function_map.Add("execute_second", [&num_executed]() { EXPECT_EQ(1, num_executed++); });
+    test_function_map.Add("fail_test", []() { FAIL() << "unexpected property trigger"; });
+
+    ActionManagerCommand property_change = [](ActionManager& am) {
+        am.QueuePropertyChange("init.test.a", "1");
+    };
+    std::vector<ActionManagerCommand> commands{property_change};
+
+    ServiceList service_list;
+    TestInitText(init_script, test_function_map, commands, &service_list);
+
+    EXPECT_EQ(2, num_executed);
+}
+
+TEST(init, CompiledConfig) {
+    std::string init_script =
+        R"init(
+on boot
+execute_first
+)init";
+    std::string compiled_script =
+        R"init(
+on boot
+execute_second
+)init";
+
+    TemporaryFile tf;
+    ASSERT_TRUE(tf.fd != -1);
+    ASSERT_TRUE(android::base::WriteStringToFd(init_script, tf.fd));
+
+    // The stored tokens are used only while the hash matches the file, so a compiled config of
+    // different contents with the hash of this file shows which of the two init parsed.
+    CompiledConfig config;
+    auto file = config.add_files();
+    *file = CompileConfigFile(tf.path, compiled_script);
+    file->set_sha256(CompileConfigFile(tf.path, init_script).sha256());
+    TemporaryFile compiled;
+    ASSERT_TRUE(compiled.fd != -1);
+    ASSERT_TRUE(android::base::WriteStringToFd(config.SerializeAsString(), compiled.fd));
+
+    bool first_executed = false;
+    bool second_executed = false;
+    TestFunctionMap test_function_map;
+    test_function_map.Add("execute_first", [&first_executed]() { first_executed = true; });
+    test_function_map.Add("execute_second", [&second_executed]() { second_executed = true; });
+    Action::set_function_map(&test_function_map);
+
+    ActionManager am;
+    Parser parser;
+    parser.AddSectionParser("on", std::make_unique<ActionParser>(&am, nullptr));
+    ASSERT_TRUE(parser.LoadCompiledConfig(compiled.path));
+    ASSERT_TRUE(parser.ParseConfig(tf.path));
+
+    am.QueueEventTrigger("boot");
+    while (am.HasMoreCommands()) {
+        am.ExecuteOneCommand();
+    }
+    EXPECT_FALSE(first_executed);
+    EXPECT_TRUE(second_executed);
+}
+
 TEST(init, OverrideService) {
     std::string init_script = R"init(
 service A something
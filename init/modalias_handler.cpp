@@ -20,12 +20,18 @@
 #include <sys/syscall.h>
 
 #include <algorithm>
+#include <atomic>
 #include <functional>
+#include <map>
+#include <mutex>
 #include <string>
+#include <thread>
 #include <vector>
 
 #include <android-base/chrono_utils.h>
+#include <android-base/file.h>
 #include <android-base/logging.h>
+#include <android-base/strings.h>
 #include <android-base/unique_fd.h>
 
 #include "parser.h"
@@ -33,6 +39,15 @@
 namespace android {
 namespace init {
 
+// Returns the name that a module at 'path_name' has in modules.alias and as a key of module_deps_.
+static std::string ModuleName(const std::string& path_name) {
+    std::string name = base::Basename(path_name);
+    if (base::EndsWith(name, ".ko")) name.resize(name.size() - 3);
+    // module names can have '-', but their file names will have '_'
+    std::replace(name.begin(), name.end(), '-', '_');
+    return name;
+}
+
 Result<Success> ModaliasHandler::ParseDepCallback(std::vector<std::string>&& args) {
     std::vector<std::string> deps;
 
@@ -130,15 +145,77 @@ Result<Success> ModaliasHandler::InsmodWithDeps(const std::string& module_name,
     }
     auto& dependencies = it->second;
 
-    // load module dependencies in reverse order
-    for (auto dep = dependencies.rbegin(); dep != dependencies.rend() - 1; ++dep) {
-        if (auto result = Insmod(*dep, ""); !result) return result;
+    // Group the module dependencies by their depth in the dependency graph. A module only depends
+    // on modules of lower depths, so the modules of each depth can be loaded concurrently once the
+    // lower ones are loaded.
+    std::unordered_map<std::string, size_t> depths;
+    depths[dependencies[0]] = SIZE_MAX;
+    std::map<size_t, std::vector<std::string>> modules_by_depth;
+    for (auto dep = dependencies.begin() + 1; dep != dependencies.end(); ++dep) {
+        modules_by_depth[DependencyDepth(*dep, &depths)].emplace_back(*dep);
+    }
+    for (const auto& [depth, path_names] : modules_by_depth) {
+        if (auto result = InsmodAll(path_names); !result) return result;
     }
 
     // load target module itself with args
     return Insmod(dependencies[0], args);
 }
 
+// Returns 0 for a module without dependencies, and otherwise one more than the greatest depth of
+// its dependencies.
+size_t ModaliasHandler::DependencyDepth(const std::string& path_name,
+                                        std::unordered_map<std::string, size_t>* depths) {
+    auto [depth, inserted] = depths->emplace(path_name, 0);
+    // A module that is being visited is part of a dependency cycle, which modules.dep can't
+    // express, so pick any order for it.
+    if (!inserted) return depth->second == SIZE_MAX ? 0 : depth->second;
+
+    auto it = module_deps_.find(ModuleName(path_name));
+    if (it == module_deps_.end()) return 0;
+
+    depth->second = SIZE_MAX;
+    size_t result = 0;
+    for (auto dep = it->second.begin() + 1; dep != it->second.end(); ++dep) {
+        result = std::max(result, DependencyDepth(*dep, depths) + 1);
+    }
+    (*depths)[path_name] = result;
+    return result;
+}
+
+// Loads modules that don't depend on each other, with a thread for each CPU.
+Result<Success> ModaliasHandler::InsmodAll(const std::vector<std::string>& path_names) {
+    size_t num_threads = std::min<size_t>(path_names.size(), std::thread::hardware_concurrency());
+    if (num_threads <= 1) {
+        for (const auto& path_name : path_names) {
+            if (auto result = Insmod(path_name, ""); !result) return result;
+        }
+        return Success();
+    }
+
+    std::atomic<size_t> next_module(0);
+    std::mutex error_lock;
+    Result<Success> first_error = Success();
+    auto load_modules = [&]() {
+        for (size_t i = next_module++; i < path_names.size(); i = next_module++) {
+            if (auto result = Insmod(path_names[i], ""); !result) {
+                std::lock_guard<std::mutex> lock(error_lock);
+                if (first_error) first_error = std::move(result);
+            }
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (size_t i = 1; i < num_threads; ++i) {
+        threads.emplace_back(load_modules);
+    }
+    load_modules();
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    return first_error;
+}
+
 void ModaliasHandler::HandleUevent(const Uevent& uevent) {
     if (uevent.modalias.empty()) return;
 
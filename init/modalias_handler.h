@@ -36,7 +36,10 @@ class ModaliasHandler : public UeventHandler {
 
   private:
     Result<Success> InsmodWithDeps(const std::string& module_name, const std::string& args);
+    Result<Success> InsmodAll(const std::vector<std::string>& path_names);
     Result<Success> Insmod(const std::string& path_name, const std::string& args);
+    size_t DependencyDepth(const std::string& path_name,
+                           std::unordered_map<std::string, size_t>* depths);
 
     Result<Success> ParseDepCallback(std::vector<std::string>&& args);
     Result<Success> ParseAliasCallback(std::vector<std::string>&& args);
@@ -18,11 +18,14 @@
 
 #include <dirent.h>
 
+#include <iterator>
+
 #include <android-base/chrono_utils.h>
 #include <android-base/file.h>
 #include <android-base/logging.h>
 #include <android-base/stringprintf.h>
 #include <android-base/strings.h>
+#include <openssl/sha.h>
 
 #include "tokenizer.h"
 #include "util.h"
@@ -30,6 +33,55 @@
 namespace android {
 namespace init {
 
+static std::string Sha256(const std::string& data) {
+    uint8_t hash[SHA256_DIGEST_LENGTH];
+    SHA256(reinterpret_cast<const uint8_t*>(data.data()), data.size(), hash);
+    return std::string(reinterpret_cast<const char*>(hash), sizeof(hash));
+}
+
+std::vector<ConfigLine> TokenizeConfig(std::string* data) {
+    data->push_back('\n');  // TODO: fix tokenizer
+    data->push_back('\0');
+
+    parse_state state;
+    state.line = 0;
+    state.ptr = data->data();
+    state.nexttoken = 0;
+
+    std::vector<ConfigLine> lines;
+    std::vector<std::string> args;
+    for (;;) {
+        switch (next_token(&state)) {
+            case T_EOF:
+                return lines;
+            case T_NEWLINE:
+                state.line++;
+                if (!args.empty()) {
+                    lines.push_back({state.line, std::move(args)});
+                    args.clear();
+                }
+                break;
+            case T_TEXT:
+                args.emplace_back(state.text);
+                break;
+        }
+    }
+}
+
+CompiledConfig::File CompileConfigFile(const std::string& path, std::string contents) {
+    CompiledConfig::File file;
+    file.set_path(path);
+    file.set_sha256(Sha256(contents));
+    for (auto& [line, args] : TokenizeConfig(&contents)) {
+        auto compiled_line = file.add_lines();
+        compiled_line->set_line(line);
+        for (auto& arg : args) {
+            compiled_line->add_args(std::move(arg));
+        }
+    }
+    return file;
+}
+
 Parser::Parser() {}
 
 void Parser::AddSectionParser(const std::string& name, std::unique_ptr<SectionParser> parser) {
@@ -41,17 +93,12 @@ void Parser::AddSingleLineParser(const std::string& prefix, LineCallback callbac
 }
 
 void Parser::ParseData(const std::string& filename, std::string* data) {
-    data->push_back('\n');  // TODO: fix tokenizer
-    data->push_back('\0');
-
-    parse_state state;
-    state.line = 0;
-    state.ptr = data->data();
-    state.nexttoken = 0;
+    ParseLines(filename, TokenizeConfig(data));
+}
 
+void Parser::ParseLines(const std::string& filename, std::vector<ConfigLine>&& lines) {
     SectionParser* section_parser = nullptr;
     int section_start_line = -1;
-    std::vector<std::string> args;
 
     // If we encounter a bad section start, there is no valid parser object to parse the subsequent
     // sections, so we must suppress errors until the next valid section is found.
@@ -70,63 +117,89 @@ void Parser::ParseData(const std::string& filename, std::string* data) {
         section_start_line = -1;
     };
 
-    for (;;) {
-        switch (next_token(&state)) {
-            case T_EOF:
-                end_section();
-
-                for (const auto& [section_name, section_parser] : section_parsers_) {
-                    section_parser->EndFile();
-                }
+    for (auto& [line, args] : lines) {
+        // If we have a line matching a prefix we recognize, call its callback and unset any
+        // current section parsers.  This is meant for /sys/ and /dev/ line entries for
+        // uevent.
+        auto line_callback = std::find_if(
+            line_callbacks_.begin(), line_callbacks_.end(),
+            [&args = args](const auto& c) { return android::base::StartsWith(args[0], c.first); });
+        if (line_callback != line_callbacks_.end()) {
+            end_section();
 
-                return;
-            case T_NEWLINE: {
-                state.line++;
-                if (args.empty()) break;
-                // If we have a line matching a prefix we recognize, call its callback and unset any
-                // current section parsers.  This is meant for /sys/ and /dev/ line entries for
-                // uevent.
-                auto line_callback = std::find_if(
-                    line_callbacks_.begin(), line_callbacks_.end(),
-                    [&args](const auto& c) { return android::base::StartsWith(args[0], c.first); });
-                if (line_callback != line_callbacks_.end()) {
-                    end_section();
-
-                    if (auto result = line_callback->second(std::move(args)); !result) {
-                        parse_error_count_++;
-                        LOG(ERROR) << filename << ": " << state.line << ": " << result.error();
-                    }
-                } else if (section_parsers_.count(args[0])) {
-                    end_section();
-                    section_parser = section_parsers_[args[0]].get();
-                    section_start_line = state.line;
-                    if (auto result =
-                            section_parser->ParseSection(std::move(args), filename, state.line);
-                        !result) {
-                        parse_error_count_++;
-                        LOG(ERROR) << filename << ": " << state.line << ": " << result.error();
-                        section_parser = nullptr;
-                        bad_section_found = true;
-                    }
-                } else if (section_parser) {
-                    if (auto result = section_parser->ParseLineSection(std::move(args), state.line);
-                        !result) {
-                        parse_error_count_++;
-                        LOG(ERROR) << filename << ": " << state.line << ": " << result.error();
-                    }
-                } else if (!bad_section_found) {
-                    parse_error_count_++;
-                    LOG(ERROR) << filename << ": " << state.line
-                               << ": Invalid section keyword found";
-                }
-                args.clear();
-                break;
+            if (auto result = line_callback->second(std::move(args)); !result) {
+                parse_error_count_++;
+                LOG(ERROR) << filename << ": " << line << ": " << result.error();
             }
-            case T_TEXT:
-                args.emplace_back(state.text);
-                break;
+        } else if (section_parsers_.count(args[0])) {
+            end_section();
+            section_parser = section_parsers_[args[0]].get();
+            section_start_line = line;
+            if (auto result = section_parser->ParseSection(std::move(args), filename, line);
+                !result) {
+                parse_error_count_++;
+                LOG(ERROR) << filename << ": " << line << ": " << result.error();
+                section_parser = nullptr;
+                bad_section_found = true;
+            }
+        } else if (section_parser) {
+            if (auto result = section_parser->ParseLineSection(std::move(args), line); !result) {
+                parse_error_count_++;
+                LOG(ERROR) << filename << ": " << line << ": " << result.error();
+            }
+        } else if (!bad_section_found) {
+            parse_error_count_++;
+            LOG(ERROR) << filename << ": " << line << ": Invalid section keyword found";
         }
     }
+
+    end_section();
+
+    for (const auto& [section_name, section_parser] : section_parsers_) {
+        section_parser->EndFile();
+    }
+}
+
+bool Parser::LoadCompiledConfig(const std::string& path) {
+    std::string data;
+    if (!android::base::ReadFileToString(path, &data)) {
+        return false;
+    }
+
+    CompiledConfig config;
+    if (!config.ParseFromString(data)) {
+        LOG(ERROR) << "Unable to parse compiled config '" << path << "'";
+        return false;
+    }
+    for (auto& file : *config.mutable_files()) {
+        std::string file_path = file.path();
+        compiled_files_[file_path] = std::move(file);
+    }
+    return true;
+}
+
+bool Parser::ParseCompiledConfigFile(const std::string& path, const std::string& contents) {
+    auto it = compiled_files_.find(path);
+    if (it == compiled_files_.end()) {
+        return false;
+    }
+    CompiledConfig::File file = std::move(it->second);
+    compiled_files_.erase(it);
+
+    if (file.sha256() != Sha256(contents)) {
+        LOG(INFO) << "Compiled config for '" << path << "' is out of date";
+        return false;
+    }
+
+    std::vector<ConfigLine> lines;
+    lines.reserve(file.lines_size());
+    for (auto& line : *file.mutable_lines()) {
+        auto args = line.mutable_args();
+        lines.push_back({line.line(), {std::make_move_iterator(args->begin()),
+                                       std::make_move_iterator(args->end())}});
+    }
+    ParseLines(path, std::move(lines));
+    return true;
 }
 
 bool Parser::ParseConfigFileInsecure(const std::string& path) {
@@ -148,7 +221,9 @@ bool Parser::ParseConfigFile(const std::string& path) {
         return false;
     }
 
-    ParseData(path, &config_contents.value());
+    if (!ParseCompiledConfigFile(path, *config_contents)) {
+        ParseData(path, &config_contents.value());
+    }
 
     LOG(VERBOSE) << "(Parsing " << path << " took " << t << ".)";
     return true;
@@ -23,6 +23,7 @@
 #include <vector>
 
 #include "result.h"
+#include "system/core/init/compiled_config.pb.h"
 
 //  SectionParser is an interface that can parse a given 'section' in init.
 //
@@ -48,6 +49,18 @@
 namespace android {
 namespace init {
 
+// A non-empty line of a config file, split into its words.
+struct ConfigLine {
+    int line;
+    std::vector<std::string> args;
+};
+
+// Splits the contents of a config file into lines. data is modified.
+std::vector<ConfigLine> TokenizeConfig(std::string* data);
+
+// Returns the lines of a config file in the form that Parser::LoadCompiledConfig() reads.
+CompiledConfig::File CompileConfigFile(const std::string& path, std::string contents);
+
 class SectionParser {
   public:
     virtual ~SectionParser() {}
@@ -79,14 +92,21 @@ class Parser {
     // Host init verifier check file permissions.
     bool ParseConfigFileInsecure(const std::string& path);
 
+    // Loads config files compiled by host_init_verifier. A compiled file is used instead of
+    // tokenizing the file again when its contents still have the same hash.
+    bool LoadCompiledConfig(const std::string& path);
+
     size_t parse_error_count() const { return parse_error_count_; }
 
   private:
     void ParseData(const std::string& filename, std::string* data);
+    void ParseLines(const std::string& filename, std::vector<ConfigLine>&& lines);
+    bool ParseCompiledConfigFile(const std::string& path, const std::string& contents);
     bool ParseConfigDir(const std::string& path);
 
     std::map<std::string, std::unique_ptr<SectionParser>> section_parsers_;
     std::vector<std::pair<std::string, LineCallback>> line_callbacks_;
+    std::map<std::string, CompiledConfig::File> compiled_files_;
     size_t parse_error_count_ = 0;
 };
 
@@ -22,12 +22,14 @@
 #include <sys/system_properties.h>
 #include <sys/types.h>
 
+#include <map>
 #include <memory>
 
 #include <android-base/file.h>
 #include <android-base/logging.h>
 #include <android-base/strings.h>
 #include <android-base/unique_fd.h>
+#include <google/protobuf/io/coded_stream.h>
 
 #include "util.h"
 
@@ -45,6 +47,23 @@ namespace {
 
 constexpr const char kLegacyPersistentPropertyDir[] = "/data/property";
 
+// Property updates are appended to a journal next to the property file, each one a serialized
+// PersistentProperties with a single record, so that the journal is a concatenation of messages in
+// the format of the file itself. The journal is folded into the property file when it grows past
+// this size, and on every boot.
+constexpr off_t kMaxJournalSize = 32 * 1024;
+
+// The tag of the properties field of PersistentProperties, which starts each journal entry.
+constexpr uint32_t kJournalEntryTag = (1 << 3) | 2;
+
+// The property file that was last read or written successfully. Updates of it go to the journal;
+// until then they rewrite the whole file, which also recovers a file that can't be parsed.
+std::string journal_base_filename;
+
+std::string JournalFilename() {
+    return persistent_property_filename + ".journal";
+}
+
 void AddPersistentProperty(const std::string& name, const std::string& value,
                            PersistentProperties* persistent_properties) {
     auto persistent_property_record = persistent_properties->add_properties();
@@ -139,6 +158,73 @@ PersistentProperties LoadPersistentPropertiesFromMemory() {
     return persistent_properties;
 }
 
+// Applies the journal on top of persistent_properties. A journal entry that was only partially
+// written ends the journal.
+void ApplyPersistentPropertyJournal(PersistentProperties* persistent_properties) {
+    std::string journal;
+    if (!android::base::ReadFileToString(JournalFilename(), &journal) || journal.empty()) {
+        return;
+    }
+
+    std::map<std::string, PersistentProperties::PersistentPropertyRecord*> records;
+    for (auto& record : *persistent_properties->mutable_properties()) {
+        records[record.name()] = &record;
+    }
+
+    google::protobuf::io::CodedInputStream input(reinterpret_cast<const uint8_t*>(journal.data()),
+                                                 journal.size());
+    for (uint32_t tag = input.ReadTag(); tag != 0; tag = input.ReadTag()) {
+        uint32_t length;
+        if (tag != kJournalEntryTag || !input.ReadVarint32(&length) ||
+            input.BytesUntilLimit() < static_cast<int>(length)) {
+            LOG(ERROR) << "Ignoring the truncated end of the persistent property journal";
+            break;
+        }
+        auto limit = input.PushLimit(length);
+        PersistentProperties::PersistentPropertyRecord record;
+        if (!record.ParseFromCodedStream(&input)) {
+            LOG(ERROR) << "Ignoring the unparseable end of the persistent property journal";
+            break;
+        }
+        input.PopLimit(limit);
+
+        auto it = records.find(record.name());
+        if (it != records.end()) {
+            it->second->set_value(record.value());
+        } else {
+            auto new_record = persistent_properties->add_properties();
+            *new_record = std::move(record);
+            records[new_record->name()] = new_record;
+        }
+    }
+}
+
+Result<off_t> AppendPersistentPropertyJournal(const std::string& name, const std::string& value) {
+    PersistentProperties entry;
+    AddPersistentProperty(name, value, &entry);
+    std::string serialized_string;
+    if (!entry.SerializeToString(&serialized_string)) {
+        return Error() << "Unable to serialize property";
+    }
+
+    unique_fd fd(TEMP_FAILURE_RETRY(
+        open(JournalFilename().c_str(), O_WRONLY | O_CREAT | O_APPEND | O_NOFOLLOW | O_CLOEXEC,
+             0600)));
+    if (fd == -1) {
+        return ErrnoError() << "Could not open persistent property journal";
+    }
+    if (!WriteStringToFd(serialized_string, fd)) {
+        return ErrnoError() << "Unable to write to persistent property journal";
+    }
+    fsync(fd);
+
+    struct stat sb;
+    if (fstat(fd, &sb) == -1) {
+        return ErrnoError() << "fstat on persistent property journal failed";
+    }
+    return sb.st_size;
+}
+
 Result<std::string> ReadPersistentPropertyFile() {
     const std::string temp_filename = persistent_property_filename + ".tmp";
     if (access(temp_filename.c_str(), F_OK) == 0) {
@@ -161,7 +247,11 @@ Result<PersistentProperties> LoadPersistentPropertyFile() {
     if (!file_contents) return file_contents.error();
 
     PersistentProperties persistent_properties;
-    if (persistent_properties.ParseFromString(*file_contents)) return persistent_properties;
+    if (persistent_properties.ParseFromString(*file_contents)) {
+        ApplyPersistentPropertyJournal(&persistent_properties);
+        journal_base_filename = persistent_property_filename;
+        return persistent_properties;
+    }
 
     // If the file cannot be parsed in either format, then we don't have any recovery
     // mechanisms, so we delete it to allow for future writes to take place successfully.
@@ -191,12 +281,27 @@ Result<Success> WritePersistentPropertyFile(const PersistentProperties& persiste
         unlink(temp_filename.c_str());
         return Error(saved_errno) << "Unable to rename persistent property file";
     }
+
+    // The new file holds everything that was in the journal.
+    unlink(JournalFilename().c_str());
+    journal_base_filename = persistent_property_filename;
     return Success();
 }
 
-// Persistent properties are not written often, so we rather not keep any data in memory and read
-// then rewrite the persistent property file for each update.
+// Persistent properties are not written often, so we rather not keep any data in memory. Each
+// update is appended to the journal, and the property file is read and rewritten only when the
+// journal grows too large, or when the property file hasn't been read successfully yet.
 void WritePersistentProperty(const std::string& name, const std::string& value) {
+    if (journal_base_filename == persistent_property_filename) {
+        auto journal_size = AppendPersistentPropertyJournal(name, value);
+        if (journal_size && *journal_size < kMaxJournalSize) {
+            return;
+        }
+        if (!journal_size) {
+            LOG(ERROR) << "Rewriting persistent properties: " << journal_size.error();
+        }
+    }
+
     auto persistent_properties = LoadPersistentPropertyFile();
 
     if (!persistent_properties) {
@@ -237,6 +342,11 @@ PersistentProperties LoadPersistentProperties() {
             LOG(ERROR) << "Unable to write single persistent property file: " << result.error();
             // Fall through so that we still set the properties that we've read.
         }
+    } else if (access(JournalFilename().c_str(), F_OK) == 0) {
+        // Start each boot from a single file, which also drops a partially written journal entry.
+        if (auto result = WritePersistentPropertyFile(*persistent_properties); !result) {
+            LOG(ERROR) << "Unable to fold the persistent property journal: " << result.error();
+        }
     }
 
     return *persistent_properties;
@@ -17,6 +17,8 @@
 #include "persistent_properties.h"
 
 #include <errno.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 #include <vector>
 
@@ -152,5 +154,94 @@ TEST(persistent_properties, UpdatePropertyBadParse) {
     EXPECT_FALSE(it == read_back_properties.properties().end());
 }
 
+TEST(persistent_properties, Journal) {
+    TemporaryFile tf;
+    ASSERT_TRUE(tf.fd != -1);
+    persistent_property_filename = tf.path;
+    std::string journal = tf.path + ".journal"s;
+
+    std::vector<std::pair<std::string, std::string>> persistent_properties = {
+        {"persist.sys.locale", "en-US"},
+        {"persist.sys.timezone", "America/Los_Angeles"},
+    };
+    ASSERT_TRUE(WritePersistentPropertyFile(VectorToPersistentProperties(persistent_properties)));
+
+    WritePersistentProperty("persist.sys.locale", "pt-BR");
+    WritePersistentProperty("persist.test.new", "1");
+    WritePersistentProperty("persist.test.new", "2");
+    ASSERT_EQ(0, access(journal.c_str(), F_OK));
+
+    std::vector<std::pair<std::string, std::string>> persistent_properties_expected = {
+        {"persist.sys.locale", "pt-BR"},
+        {"persist.sys.timezone", "America/Los_Angeles"},
+        {"persist.test.new", "2"},
+    };
+
+    auto journaled_properties = LoadPersistentPropertyFile();
+    ASSERT_TRUE(journaled_properties) << journaled_properties.error();
+    CheckPropertiesEqual(persistent_properties_expected, *journaled_properties);
+
+    // Loading the properties at boot folds the journal into the property file.
+    auto read_back_properties = LoadPersistentProperties();
+    CheckPropertiesEqual(persistent_properties_expected, read_back_properties);
+    EXPECT_EQ(-1, access(journal.c_str(), F_OK));
+
+    read_back_properties = LoadPersistentProperties();
+    CheckPropertiesEqual(persistent_properties_expected, read_back_properties);
+}
+
+TEST(persistent_properties, JournalTruncatedEntry) {
+    TemporaryFile tf;
+    ASSERT_TRUE(tf.fd != -1);
+    persistent_property_filename = tf.path;
+    std::string journal = tf.path + ".journal"s;
+
+    std::vector<std::pair<std::string, std::string>> persistent_properties = {
+        {"persist.sys.locale", "en-US"},
+    };
+    ASSERT_TRUE(WritePersistentPropertyFile(VectorToPersistentProperties(persistent_properties)));
+
+    WritePersistentProperty("persist.sys.locale", "pt-BR");
+    struct stat sb;
+    ASSERT_EQ(0, stat(journal.c_str(), &sb));
+    WritePersistentProperty("persist.sys.locale", "fr-FR");
+
+    // Lose part of the last entry, as if writing it had been interrupted.
+    ASSERT_EQ(0, truncate(journal.c_str(), sb.st_size + 3));
+
+    std::vector<std::pair<std::string, std::string>> persistent_properties_expected = {
+        {"persist.sys.locale", "pt-BR"},
+    };
+
+    auto read_back_properties = LoadPersistentProperties();
+    CheckPropertiesEqual(persistent_properties_expected, read_back_properties);
+    EXPECT_EQ(-1, access(journal.c_str(), F_OK));
+}
+
+TEST(persistent_properties, JournalSizeLimit) {
+    TemporaryFile tf;
+    ASSERT_TRUE(tf.fd != -1);
+    persistent_property_filename = tf.path;
+    std::string journal = tf.path + ".journal"s;
+
+    ASSERT_TRUE(WritePersistentPropertyFile(VectorToPersistentProperties({})));
+
+    std::string value(91, 'x');
+    for (int i = 0; i < 1000; ++i) {
+        WritePersistentProperty("persist.test.value", value + std::to_string(i));
+        struct stat sb;
+        if (stat(journal.c_str(), &sb) == 0) {
+            ASSERT_LT(sb.st_size, 32 * 1024);
+        }
+    }
+
+    std::vector<std::pair<std::string, std::string>> persistent_properties_expected = {
+        {"persist.test.value", value + "999"},
+    };
+
+    auto read_back_properties = LoadPersistentProperties();
+    CheckPropertiesEqual(persistent_properties_expected, read_back_properties);
+}
+
 }  // namespace init
 }  // namespace android
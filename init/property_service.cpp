@@ -39,8 +39,10 @@
 #define _REALLY_INCLUDE_SYS__SYSTEM_PROPERTIES_H_
 #include <sys/_system_properties.h>
 
+#include <map>
 #include <memory>
 #include <queue>
+#include <set>
 #include <vector>
 
 #include <android-base/chrono_utils.h>
@@ -57,6 +59,7 @@
 #include <selinux/label.h>
 #include <selinux/selinux.h>
 
+#include "boot_trace.h"
 #include "epoll.h"
 #include "init.h"
 #include "persistent_properties.h"
@@ -81,6 +84,11 @@ using android::properties::PropertyInfoEntry;
 
 #define RECOVERY_MOUNT_POINT "/recovery"
 
+// Sets several properties in one request: a uint32 count, followed by that many name and value
+// strings in the format of PROP_MSG_SETPROP2. The reply is one uint32 result per property.
+// Must match kPropMsgSetPropBatch in system/core/base/properties.cpp.
+#define PROP_MSG_SETPROP_BATCH 0x00020002
+
 namespace android {
 namespace init {
 
@@ -330,6 +338,12 @@ class SocketConnection {
         return result == sizeof(value);
     }
 
+    bool SendUint32s(const std::vector<uint32_t>& values) {
+        size_t size = values.size() * sizeof(values[0]);
+        ssize_t result = TEMP_FAILURE_RETRY(send(socket_, values.data(), size, 0));
+        return result == static_cast<ssize_t>(size);
+    }
+
     int socket() { return socket_; }
 
     const ucred& cred() { return cred_; }
@@ -445,8 +459,14 @@ bool CheckControlPropertyPerms(const std::string& name, const std::string& value
 }
 
 // This returns one of the enum of PROP_SUCCESS or PROP_ERROR*.
-uint32_t HandlePropertySet(const std::string& name, const std::string& value,
-                           const std::string& source_context, const ucred& cr, std::string* error) {
+// If allowed_target_contexts is not null, the SELinux check is skipped for the target contexts in
+// it, and target contexts that pass the check are added to it.
+static uint32_t HandlePropertySet(const std::string& name, const std::string& value,
+                                  const std::string& source_context, const ucred& cr,
+                                  std::string* error,
+                                  std::set<std::string>* allowed_target_contexts) {
+    ScopedBootTrace trace("property", name, source_context);
+
     if (!IsLegalPropertyName(name)) {
         *error = "Illegal property name";
         return PROP_ERROR_INVALID_NAME;
@@ -467,9 +487,16 @@ uint32_t HandlePropertySet(const std::string& name, const std::string& value,
     const char* type = nullptr;
     property_info_area->GetPropertyInfo(name.c_str(), &target_context, &type);
 
-    if (!CheckMacPerms(name, target_context, source_context.c_str(), cr)) {
-        *error = "SELinux permission check failed";
-        return PROP_ERROR_PERMISSION_DENIED;
+    bool cached = allowed_target_contexts != nullptr && target_context != nullptr &&
+                  allowed_target_contexts->count(target_context);
+    if (!cached) {
+        if (!CheckMacPerms(name, target_context, source_context.c_str(), cr)) {
+            *error = "SELinux permission check failed";
+            return PROP_ERROR_PERMISSION_DENIED;
+        }
+        if (allowed_target_contexts != nullptr && target_context != nullptr) {
+            allowed_target_contexts->emplace(target_context);
+        }
     }
 
     if (type == nullptr || !CheckType(type, value)) {
@@ -500,6 +527,45 @@ uint32_t HandlePropertySet(const std::string& name, const std::string& value,
     return PropertySet(name, value, error);
 }
 
+uint32_t HandlePropertySet(const std::string& name, const std::string& value,
+                           const std::string& source_context, const ucred& cr, std::string* error) {
+    return HandlePropertySet(name, value, source_context, cr, error, nullptr);
+}
+
+// Sets a batch of properties from one client. The permission of the client to set properties of a
+// target context is checked once for the batch. A property that is in the batch more than once is
+// only set to its last value, so it is written and triggers actions once, and all of its entries
+// get the result of that last one.
+static std::vector<uint32_t> HandlePropertySetBatch(
+        const std::vector<std::pair<std::string, std::string>>& properties,
+        const std::string& source_context, const ucred& cr) {
+    std::map<std::string, size_t> last_index;
+    for (size_t i = 0; i < properties.size(); ++i) {
+        last_index[properties[i].first] = i;
+    }
+
+    std::set<std::string> allowed_target_contexts;
+    std::vector<uint32_t> results(properties.size());
+    for (size_t i = 0; i < properties.size(); ++i) {
+        const auto& [name, value] = properties[i];
+        if (last_index[name] != i) {
+            continue;
+        }
+        std::string error;
+        results[i] =
+                HandlePropertySet(name, value, source_context, cr, &error, &allowed_target_contexts);
+        if (results[i] != PROP_SUCCESS) {
+            LOG(ERROR) << "Unable to set property '" << name << "' to '" << value
+                       << "' from uid:" << cr.uid << " gid:" << cr.gid << " pid:" << cr.pid << ": "
+                       << error;
+        }
+    }
+    for (size_t i = 0; i < properties.size(); ++i) {
+        results[i] = results[last_index[properties[i].first]];
+    }
+    return results;
+}
+
 static void handle_property_set_fd() {
     static constexpr uint32_t kDefaultSocketTimeout = 2000; /* ms */
 
@@ -575,6 +641,33 @@ static void handle_property_set_fd() {
         break;
       }
 
+    case PROP_MSG_SETPROP_BATCH: {
+        // Like RecvString(), don't let a client make init allocate arbitrarily much.
+        static constexpr uint32_t kMaxBatchSize = 128;
+
+        uint32_t count = 0;
+        if (!socket.RecvUint32(&count, &timeout_ms) || count > kMaxBatchSize) {
+            LOG(ERROR) << "sys_prop(PROP_MSG_SETPROP_BATCH): error while reading the count";
+            socket.SendUint32(PROP_ERROR_READ_DATA);
+            return;
+        }
+
+        std::vector<std::pair<std::string, std::string>> properties(count);
+        for (auto& [name, value] : properties) {
+            if (!socket.RecvString(&name, &timeout_ms) ||
+                !socket.RecvString(&value, &timeout_ms)) {
+                PLOG(ERROR) << "sys_prop(PROP_MSG_SETPROP_BATCH): error while reading name/value "
+                               "from the socket";
+                socket.SendUint32(PROP_ERROR_READ_DATA);
+                return;
+            }
+        }
+
+        socket.SendUint32s(
+                HandlePropertySetBatch(properties, socket.source_context(), socket.cred()));
+        break;
+      }
+
     default:
         LOG(ERROR) << "sys_prop: invalid command " << cmd;
         socket.SendUint32(PROP_ERROR_INVALID_CMD);
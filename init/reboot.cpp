@@ -30,9 +30,11 @@
 #include <sys/types.h>
 #include <sys/wait.h>
 
+#include <functional>
 #include <memory>
 #include <set>
 #include <thread>
+#include <utility>
 #include <vector>
 
 #include <android-base/chrono_utils.h>
@@ -132,6 +134,9 @@ class MountEntry {
         return android::base::StartsWith(mntent.mnt_fsname, "/data/");
     }
 
+    const std::string& mnt_fsname() const { return mnt_fsname_; }
+    const std::string& mnt_dir() const { return mnt_dir_; }
+
   private:
     bool IsF2Fs() const { return mnt_type_ == "f2fs"; }
 
@@ -167,6 +172,78 @@ static void LogShutdownTime(UmountStat stat, Timer* t) {
                  << stat;
 }
 
+// Collects how long each shutdown phase took, so that a slow reboot can be
+// attributed from a single log line.
+class ShutdownTimings {
+  public:
+    // Ends the current phase, which started at the previous call.
+    void EndPhase(const std::string& name) {
+        phases_.emplace_back(name, phase_timer_.duration());
+        phase_timer_ = Timer();
+    }
+
+    void Log(const Timer& total) const {
+        std::string report;
+        for (const auto& [name, duration] : phases_) {
+            report += StringPrintf(" %s:%lldms", name.c_str(),
+                                   static_cast<long long>(duration.count()));
+        }
+        LOG(INFO) << "Shutdown phases:" << report << " total:" << total.duration().count() << "ms";
+    }
+
+  private:
+    Timer phase_timer_;
+    std::vector<std::pair<std::string, std::chrono::milliseconds>> phases_;
+};
+
+static bool IsNestedIn(const std::string& dir, const std::string& parent) {
+    return dir != parent && (parent == "/" || android::base::StartsWith(dir, parent + "/"));
+}
+
+// Runs |fn| on every entry, concurrently for the mount points that are not
+// nested in one another: a mount is only handed to |fn| once every mount below
+// it has been. Entries of independent block devices are thus unmounted or
+// synced in parallel rather than waiting on each other's flush. Returns false
+// if any call returned false.
+static bool ForEachMountInParallel(std::vector<MountEntry>* entries,
+                                   const std::function<bool(MountEntry&)>& fn) {
+    bool success = true;
+    std::vector<MountEntry*> remaining;
+    for (auto& entry : *entries) {
+        remaining.emplace_back(&entry);
+    }
+    while (!remaining.empty()) {
+        std::vector<MountEntry*> wave;
+        std::vector<MountEntry*> later;
+        for (size_t i = 0; i < remaining.size(); i++) {
+            const std::string& dir = remaining[i]->mnt_dir();
+            bool has_child = false;
+            for (size_t j = 0; j < remaining.size() && !has_child; j++) {
+                // Entries are in reverse mount order, so of two mounts stacked
+                // on the same directory the earlier one is on top.
+                has_child = IsNestedIn(remaining[j]->mnt_dir(), dir) ||
+                            (j < i && remaining[j]->mnt_dir() == dir);
+            }
+            (has_child ? later : wave).emplace_back(remaining[i]);
+        }
+
+        std::vector<std::thread> threads;
+        std::vector<char> results(wave.size());
+        for (size_t i = 1; i < wave.size(); i++) {
+            threads.emplace_back([&fn, &results, &wave, i] { results[i] = fn(*wave[i]); });
+        }
+        results[0] = fn(*wave[0]);
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        for (char result : results) {
+            if (!result) success = false;
+        }
+        remaining = std::move(later);
+    }
+    return success;
+}
+
 /* Find all read+write block devices and emulated devices in /proc/mounts
  * and add them to correpsponding list.
  */
@@ -235,8 +312,10 @@ static UmountStat UmountPartitions(std::chrono::milliseconds timeout) {
                 sync();
             }
         }
-        for (auto& entry : block_devices) {
-            if (!entry.Umount(timeout == 0ms)) unmount_done = false;
+        bool force = timeout == 0ms;
+        if (!ForEachMountInParallel(&block_devices,
+                                    [force](MountEntry& entry) { return entry.Umount(force); })) {
+            unmount_done = false;
         }
         if (unmount_done) {
             return UMOUNT_STAT_SUCCESS;
@@ -248,6 +327,32 @@ static UmountStat UmountPartitions(std::chrono::milliseconds timeout) {
     }
 }
 
+// Flushes every R/W block device, the independent ones concurrently, so that
+// their writeback overlaps. The final sync() then only has
+// to pick up what is left elsewhere.
+static void SyncPartitions() {
+    std::vector<MountEntry> block_devices;
+    std::vector<MountEntry> emulated_devices;
+    if (FindPartitionsToUmount(&block_devices, &emulated_devices, false)) {
+        std::set<std::string> seen;
+        std::vector<MountEntry> to_sync;
+        for (auto& entry : block_devices) {
+            // Bind mounts share the filesystem of their source.
+            if (seen.insert(entry.mnt_fsname()).second) to_sync.emplace_back(entry);
+        }
+        ForEachMountInParallel(&to_sync, [](MountEntry& entry) {
+            unique_fd fd(TEMP_FAILURE_RETRY(
+                    open(entry.mnt_dir().c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC)));
+            if (fd == -1 || syncfs(fd) == -1) {
+                PLOG(WARNING) << "syncfs of " << entry.mnt_dir() << " failed";
+                return false;
+            }
+            return true;
+        });
+    }
+    sync();
+}
+
 static void KillAllProcesses() { android::base::WriteStringToFile("i", "/proc/sysrq-trigger"); }
 
 /* Try umounting all emulated file systems R/W block device cfile systems.
@@ -340,6 +445,7 @@ static void KillZramBackingDevice() {
 static void DoReboot(unsigned int cmd, const std::string& reason, const std::string& rebootTarget,
                      bool runFsck) {
     Timer t;
+    ShutdownTimings timings;
     LOG(INFO) << "Reboot start, reason: " << reason << ", rebootTarget: " << rebootTarget;
 
     // Ensure last reboot reason is reduced to canonical
@@ -426,6 +532,7 @@ static void DoReboot(unsigned int cmd, const std::string& reason, const std::str
             bootAnim->SetShutdownCritical();
         }
     }
+    timings.EndPhase("prepare");
 
     // optional shutdown step
     // 1. terminate all services except shutdown critical ones. wait for delay to finish
@@ -440,6 +547,14 @@ static void DoReboot(unsigned int cmd, const std::string& reason, const std::str
         int service_count = 0;
         // Only wait up to half of timeout here
         auto termination_wait_timeout = shutdown_timeout / 2;
+        // A service that ignores SIGTERM is killed once it has had this long,
+        // rather than holding up the whole wait: the others have been
+        // terminating concurrently in the meantime.
+        auto service_term_timeout = std::chrono::milliseconds(android::base::GetUintProperty(
+                "ro.init.shutdown.service_term_timeout_ms",
+                static_cast<uint64_t>(termination_wait_timeout.count())));
+        Timer term_timer;
+        bool killed_stragglers = false;
         while (t.duration() < termination_wait_timeout) {
             ReapAnyOutstandingChildren();
 
@@ -452,8 +567,14 @@ static void DoReboot(unsigned int cmd, const std::string& reason, const std::str
                 // it is only used by the shell.
                 if (!s->IsShutdownCritical() && s->pid() != 0 && (s->flags() & SVC_CONSOLE) == 0) {
                     service_count++;
+                    if (!killed_stragglers && term_timer.duration() >= service_term_timeout) {
+                        LOG(INFO) << "Service '" << s->name() << "' did not exit on SIGTERM in "
+                                  << service_term_timeout.count() << "ms, killing it";
+                        s->Stop();
+                    }
                 }
             }
+            if (term_timer.duration() >= service_term_timeout) killed_stragglers = true;
 
             if (service_count == 0) {
                 // All terminable services terminated. We can exit early.
@@ -461,11 +582,12 @@ static void DoReboot(unsigned int cmd, const std::string& reason, const std::str
             }
 
             // Wait a bit before recounting the number or running services.
-            std::this_thread::sleep_for(50ms);
+            std::this_thread::sleep_for(10ms);
         }
         LOG(INFO) << "Terminating running services took " << t
                   << " with remaining services:" << service_count;
     }
+    timings.EndPhase("terminate_services");
 
     // minimum safety steps before restarting
     // 2. kill all services except ones that are necessary for the shutdown sequence.
@@ -474,6 +596,7 @@ static void DoReboot(unsigned int cmd, const std::string& reason, const std::str
     }
     SubcontextTerminate();
     ReapAnyOutstandingChildren();
+    timings.EndPhase("kill_services");
 
     // 3. send volume shutdown to vold
     Service* voldService = ServiceList::GetInstance().FindService("vold");
@@ -483,6 +606,7 @@ static void DoReboot(unsigned int cmd, const std::string& reason, const std::str
     } else {
         LOG(INFO) << "vold not running, skipping vold shutdown";
     }
+    timings.EndPhase("vold");
     // logcat stopped here
     for (const auto& s : ServiceList::GetInstance().services_in_shutdown_order()) {
         if (kill_after_apps.count(s->name())) s->Stop();
@@ -491,13 +615,16 @@ static void DoReboot(unsigned int cmd, const std::string& reason, const std::str
     {
         Timer sync_timer;
         LOG(INFO) << "sync() before umount...";
-        sync();
+        SyncPartitions();
         LOG(INFO) << "sync() before umount took" << sync_timer;
     }
+    timings.EndPhase("sync");
     // 5. drop caches and disable zram backing device, if exist
     KillZramBackingDevice();
+    timings.EndPhase("zram");
 
     UmountStat stat = TryUmountAndFsck(runFsck, shutdown_timeout - t.duration());
+    timings.EndPhase(runFsck ? "umount_fsck" : "umount");
     // Follow what linux shutdown is doing: one more sync with little bit delay
     {
         Timer sync_timer;
@@ -506,6 +633,8 @@ static void DoReboot(unsigned int cmd, const std::string& reason, const std::str
         LOG(INFO) << "sync() after umount took" << sync_timer;
     }
     if (!is_thermal_shutdown) std::this_thread::sleep_for(100ms);
+    timings.EndPhase("final_sync");
+    timings.Log(t);
     LogShutdownTime(stat, &t);
     // Reboot regardless of umount status. If umount fails, fsck after reboot will fix it.
     RebootSystem(cmd, rebootTarget);
@@ -30,6 +30,9 @@
 #include <termios.h>
 #include <unistd.h>
 
+#include <algorithm>
+#include <functional>
+
 #include <android-base/file.h>
 #include <android-base/logging.h>
 #include <android-base/parseint.h>
@@ -42,6 +45,7 @@
 #include <selinux/selinux.h>
 #include <system/thread_defs.h>
 
+#include "boot_trace.h"
 #include "rlimit_parser.h"
 #include "util.h"
 
@@ -209,6 +213,8 @@ static bool ExpandArgsAndExecv(const std::vector<std::string>& args, bool sigsto
 
 unsigned long Service::next_start_order_ = 1;
 bool Service::is_exec_service_running_ = false;
+std::vector<Service::ProcessAction> Service::process_actions_;
+std::unordered_map<pid_t, Service*> Service::services_by_pid_;
 
 Service::Service(const std::string& name, Subcontext* subcontext_for_restart_commands,
                  const std::vector<std::string>& args)
@@ -238,6 +244,71 @@ Service::Service(const std::string& name, unsigned flags, uid_t uid, gid_t gid,
       start_order_(0),
       args_(args) {}
 
+Service::~Service() {
+    SetPid(0);
+    auto it = std::remove_if(process_actions_.begin(), process_actions_.end(),
+                             [this](const ProcessAction& action) { return action.second == this; });
+    if (it != process_actions_.end()) {
+        process_actions_.erase(it, process_actions_.end());
+        std::make_heap(process_actions_.begin(), process_actions_.end(), std::greater<>());
+    }
+}
+
+Service* Service::FindByPid(pid_t pid) {
+    auto it = services_by_pid_.find(pid);
+    return it != services_by_pid_.end() ? it->second : nullptr;
+}
+
+void Service::SetPid(pid_t pid) {
+    if (pid_) {
+        auto it = services_by_pid_.find(pid_);
+        if (it != services_by_pid_.end() && it->second == this) services_by_pid_.erase(it);
+    }
+    pid_ = pid;
+    if (pid_) services_by_pid_[pid_] = this;
+}
+
+std::optional<boot_clock::time_point> Service::process_action_time() const {
+    if ((flags_ & SVC_RUNNING) && timeout_period_) {
+        return time_started_ + *timeout_period_;
+    }
+    if (flags_ & SVC_RESTARTING) {
+        return time_started_ + restart_period_;
+    }
+    return {};
+}
+
+void Service::ScheduleProcessAction() {
+    if (auto time = process_action_time()) {
+        process_actions_.emplace_back(*time, this);
+        std::push_heap(process_actions_.begin(), process_actions_.end(), std::greater<>());
+    }
+}
+
+std::optional<boot_clock::time_point> Service::HandleProcessActions() {
+    while (!process_actions_.empty()) {
+        auto [time, service] = process_actions_.front();
+        if (service->process_action_time() != time) {
+            // Started, stopped or reaped since
+            std::pop_heap(process_actions_.begin(), process_actions_.end(), std::greater<>());
+            process_actions_.pop_back();
+            continue;
+        }
+        if (boot_clock::now() <= time) {
+            return time;
+        }
+        std::pop_heap(process_actions_.begin(), process_actions_.end(), std::greater<>());
+        process_actions_.pop_back();
+
+        if (service->flags_ & SVC_RUNNING) {
+            service->Timeout();
+        } else if (auto result = service->Start(); !result) {
+            LOG(ERROR) << "Could not restart process '" << service->name() << "': " << result.error();
+        }
+    }
+    return {};
+}
+
 void Service::NotifyStateChange(const std::string& new_state) const {
     if ((flags_ & SVC_TEMPORARY) != 0) {
         // Services created by 'exec' are temporary and don't have properties tracking their state.
@@ -351,7 +422,7 @@ void Service::Reap(const siginfo_t& siginfo) {
 
     if (flags_ & SVC_TEMPORARY) return;
 
-    pid_ = 0;
+    SetPid(0);
     flags_ &= (~SVC_RUNNING);
     start_order_ = 0;
 
@@ -389,6 +460,7 @@ void Service::Reap(const siginfo_t& siginfo) {
 
     flags_ &= (~SVC_RESTART);
     flags_ |= SVC_RESTARTING;
+    ScheduleProcessAction();
 
     // Execute all onrestart commands for this service.
     onrestart_.ExecuteAllCommands();
@@ -896,6 +968,8 @@ Result<Success> Service::Start() {
         return Success();
     }
 
+    ScopedBootTrace trace("service", "start " + name_);
+
     bool needs_console = (flags_ & SVC_CONSOLE);
     if (needs_console) {
         if (console_.empty()) {
@@ -1023,7 +1097,7 @@ Result<Success> Service::Start() {
     }
 
     if (pid < 0) {
-        pid_ = 0;
+        SetPid(0);
         return ErrnoError() << "Failed to fork";
     }
 
@@ -1036,8 +1110,9 @@ Result<Success> Service::Start() {
     }
 
     time_started_ = boot_clock::now();
-    pid_ = pid;
+    SetPid(pid);
     flags_ |= SVC_RUNNING;
+    ScheduleProcessAction();
     start_order_ = next_start_order_++;
     process_cgroup_empty_ = false;
 
@@ -26,6 +26,7 @@
 #include <optional>
 #include <set>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 #include <android-base/chrono_utils.h>
@@ -71,6 +72,7 @@ class Service {
             const std::vector<gid_t>& supp_gids, const CapSet& capabilities,
             unsigned namespace_flags, const std::string& seclabel,
             Subcontext* subcontext_for_restart_commands, const std::vector<std::string>& args);
+    ~Service();
 
     static std::unique_ptr<Service> MakeTemporaryOneshotService(const std::vector<std::string>& args);
 
@@ -99,6 +101,11 @@ class Service {
 
     static bool is_exec_service_running() { return is_exec_service_running_; }
 
+    // Restarts and times out the services that are due to, and returns when the next one is.
+    static std::optional<android::base::boot_clock::time_point> HandleProcessActions();
+    // The service whose process has this pid, if any.
+    static Service* FindByPid(pid_t pid);
+
     const std::string& name() const { return name_; }
     const std::set<std::string>& classnames() const { return classnames_; }
     unsigned flags() const { return flags_; }
@@ -176,8 +183,19 @@ class Service {
     template <typename T>
     Result<Success> AddDescriptor(std::vector<std::string>&& args);
 
+    // When the service is to be restarted or timed out, if it is to be at all.
+    std::optional<android::base::boot_clock::time_point> process_action_time() const;
+    void ScheduleProcessAction();
+    void SetPid(pid_t pid);
+
     static unsigned long next_start_order_;
     static bool is_exec_service_running_;
+    // Min-heap of the times services were due for a restart or a timeout when they were scheduled.
+    // Entries no longer matching process_action_time() of their service are stale and dropped.
+    using ProcessAction = std::pair<android::base::boot_clock::time_point, Service*>;
+    static std::vector<ProcessAction> process_actions_;
+    // Services by the pid of their running process, for reaping.
+    static std::unordered_map<pid_t, Service*> services_by_pid_;
 
     std::string name_;
     std::set<std::string> classnames_;
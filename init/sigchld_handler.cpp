@@ -61,13 +61,13 @@ static bool ReapOneProcess() {
     std::string wait_string;
     Service* service = nullptr;
 
-    if (PropertyChildReap(pid)) {
+    // Services come first, as they are what exits en masse during shutdown or zygote restarts.
+    service = Service::FindByPid(pid);
+    if (!service && PropertyChildReap(pid)) {
         name = "Async property child";
-    } else if (SubcontextChildReap(pid)) {
+    } else if (!service && SubcontextChildReap(pid)) {
         name = "Subcontext";
     } else {
-        service = ServiceList::GetInstance().FindService(pid, &Service::pid);
-
         if (service) {
             name = StringPrintf("Service '%s' (pid %d)", service->name().c_str(), pid);
             if (service->flags() & SVC_EXEC) {
@@ -21,6 +21,7 @@
 #include <sys/socket.h>
 #include <unistd.h>
 
+#include <android-base/chrono_utils.h>
 #include <android-base/file.h>
 #include <android-base/logging.h>
 #include <android-base/strings.h>
@@ -105,6 +106,8 @@ class SubcontextProcess {
   private:
     void RunCommand(const SubcontextCommand::ExecuteCommand& execute_command,
                     SubcontextReply* reply) const;
+    void RunCommands(const SubcontextCommand::ExecuteCommands& execute_commands,
+                     SubcontextReply* reply) const;
     void ExpandArgs(const SubcontextCommand::ExpandArgsCommand& expand_args_command,
                     SubcontextReply* reply) const;
 
@@ -146,6 +149,22 @@ void SubcontextProcess::RunCommand(const SubcontextCommand::ExecuteCommand& exec
     }
 }
 
+void SubcontextProcess::RunCommands(const SubcontextCommand::ExecuteCommands& execute_commands,
+                                    SubcontextReply* reply) const {
+    auto* execute_commands_reply = reply->mutable_execute_commands_reply();
+    for (const auto& execute_command : execute_commands.commands()) {
+        android::base::Timer t;
+        auto* command_reply = execute_commands_reply->add_replies();
+        RunCommand(execute_command, command_reply);
+        execute_commands_reply->add_durations_ms(t.duration().count());
+
+        // Later commands may depend on the properties set by this one, which only init can set.
+        if (command_reply->properties_to_set_size() > 0) break;
+        // Leave room for the reply of one more command.
+        if (reply->ByteSizeLong() > kBufferSize / 2) break;
+    }
+}
+
 void SubcontextProcess::ExpandArgs(const SubcontextCommand::ExpandArgsCommand& expand_args_command,
                                    SubcontextReply* reply) const {
     for (const auto& arg : expand_args_command.args()) {
@@ -201,6 +220,10 @@ void SubcontextProcess::MainLoop() {
                 ExpandArgs(subcontext_command.expand_args_command(), &reply);
                 break;
             }
+            case SubcontextCommand::kExecuteCommands: {
+                RunCommands(subcontext_command.execute_commands(), &reply);
+                break;
+            }
             default:
                 LOG(FATAL) << "Unknown message type from init: "
                            << subcontext_command.command_case();
@@ -309,7 +332,11 @@ Result<Success> Subcontext::Execute(const std::vector<std::string>& args) {
         return subcontext_reply.error();
     }
 
-    for (const auto& property : subcontext_reply->properties_to_set()) {
+    return HandleExecuteReply(*subcontext_reply);
+}
+
+Result<Success> Subcontext::HandleExecuteReply(const SubcontextReply& subcontext_reply) {
+    for (const auto& property : subcontext_reply.properties_to_set()) {
         ucred cr = {.pid = pid_, .uid = 0, .gid = 0};
         std::string error;
         if (HandlePropertySet(property.name(), property.value(), context_, cr, &error) != 0) {
@@ -318,19 +345,61 @@ Result<Success> Subcontext::Execute(const std::vector<std::string>& args) {
         }
     }
 
-    if (subcontext_reply->reply_case() == SubcontextReply::kFailure) {
-        auto& failure = subcontext_reply->failure();
+    if (subcontext_reply.reply_case() == SubcontextReply::kFailure) {
+        auto& failure = subcontext_reply.failure();
         return ResultError(failure.error_string(), failure.error_errno());
     }
 
-    if (subcontext_reply->reply_case() != SubcontextReply::kSuccess) {
+    if (subcontext_reply.reply_case() != SubcontextReply::kSuccess) {
         return Error() << "Unexpected message type from subcontext: "
-                       << subcontext_reply->reply_case();
+                       << subcontext_reply.reply_case();
     }
 
     return Success();
 }
 
+Result<std::vector<std::pair<Result<Success>, std::chrono::milliseconds>>>
+Subcontext::ExecuteCommands(const std::vector<const std::vector<std::string>*>& commands) {
+    auto subcontext_command = SubcontextCommand();
+    auto* execute_commands = subcontext_command.mutable_execute_commands();
+    for (const auto* args : commands) {
+        auto* execute_command = execute_commands->add_commands();
+        std::copy(args->begin(), args->end(),
+                  RepeatedPtrFieldBackInserter(execute_command->mutable_args()));
+        // Send as many of the commands as fit in one message.
+        if (execute_commands->commands_size() > 1 &&
+            subcontext_command.ByteSizeLong() > kBufferSize) {
+            execute_commands->mutable_commands()->RemoveLast();
+            break;
+        }
+    }
+
+    auto subcontext_reply = TransmitMessage(subcontext_command);
+    if (!subcontext_reply) {
+        return subcontext_reply.error();
+    }
+
+    if (subcontext_reply->reply_case() != SubcontextReply::kExecuteCommandsReply) {
+        return Error() << "Unexpected message type from subcontext: "
+                       << subcontext_reply->reply_case();
+    }
+
+    auto& execute_commands_reply = subcontext_reply->execute_commands_reply();
+    if (execute_commands_reply.replies_size() == 0 ||
+        execute_commands_reply.replies_size() > execute_commands->commands_size() ||
+        execute_commands_reply.durations_ms_size() != execute_commands_reply.replies_size()) {
+        return Error() << "Subcontext ran " << execute_commands_reply.replies_size() << " of "
+                       << execute_commands->commands_size() << " commands";
+    }
+
+    std::vector<std::pair<Result<Success>, std::chrono::milliseconds>> results;
+    for (int i = 0; i < execute_commands_reply.replies_size(); ++i) {
+        results.emplace_back(HandleExecuteReply(execute_commands_reply.replies(i)),
+                             std::chrono::milliseconds(execute_commands_reply.durations_ms(i)));
+    }
+    return results;
+}
+
 Result<std::vector<std::string>> Subcontext::ExpandArgs(const std::vector<std::string>& args) {
     auto subcontext_command = SubcontextCommand{};
     std::copy(args.begin(), args.end(),
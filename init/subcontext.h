@@ -19,6 +19,7 @@
 
 #include <signal.h>
 
+#include <chrono>
 #include <string>
 #include <vector>
 
@@ -43,6 +44,13 @@ class Subcontext {
     }
 
     Result<Success> Execute(const std::vector<std::string>& args);
+
+    // Runs a sequence of commands in a single round trip, and returns the result and duration of
+    // the leading commands that ran, at least one.  The subcontext stops early after a command that
+    // sets properties, so that init sets them before any later command runs, and when its reply
+    // grows too large to send.
+    Result<std::vector<std::pair<Result<Success>, std::chrono::milliseconds>>> ExecuteCommands(
+            const std::vector<const std::vector<std::string>*>& commands);
     Result<std::vector<std::string>> ExpandArgs(const std::vector<std::string>& args);
     void Restart();
 
@@ -53,6 +61,7 @@ class Subcontext {
   private:
     void Fork();
     Result<SubcontextReply> TransmitMessage(const SubcontextCommand& subcontext_command);
+    Result<Success> HandleExecuteReply(const SubcontextReply& subcontext_reply);
 
     std::string path_prefix_;
     std::string context_;
@@ -50,6 +50,35 @@ static void BenchmarkSuccess(benchmark::State& state) {
 
 BENCHMARK(BenchmarkSuccess);
 
+static void BenchmarkSuccessBatched(benchmark::State& state) {
+    if (getuid() != 0) {
+        state.SkipWithError("Skipping benchmark, must be run as root.");
+        return;
+    }
+    char* context;
+    if (getcon(&context) != 0) {
+        state.SkipWithError("getcon() failed");
+        return;
+    }
+
+    auto subcontext = Subcontext("path", context);
+    free(context);
+
+    auto args = std::vector<std::string>{"return_success"};
+    auto commands = std::vector<const std::vector<std::string>*>(state.range(0), &args);
+    while (state.KeepRunning()) {
+        subcontext.ExecuteCommands(commands).IgnoreError();
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+
+    if (subcontext.pid() > 0) {
+        kill(subcontext.pid(), SIGTERM);
+        kill(subcontext.pid(), SIGKILL);
+    }
+}
+
+BENCHMARK(BenchmarkSuccessBatched)->Arg(1)->Arg(8)->Arg(32);
+
 TestFunctionMap BuildTestFunctionMap() {
     TestFunctionMap test_function_map;
     test_function_map.Add("return_success", 0, 0, true,
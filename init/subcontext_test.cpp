@@ -121,6 +121,42 @@ TEST(subcontext, MultipleCommands) {
     });
 }
 
+TEST(subcontext, ExecuteCommands) {
+    RunTest([](auto& subcontext, auto& context_string) {
+        auto first_pid = subcontext.pid();
+
+        auto expected_words = std::vector<std::string>{
+            "this",
+            "is",
+            "a",
+            "test",
+        };
+
+        auto args = std::vector<std::vector<std::string>>();
+        for (const auto& word : expected_words) {
+            args.emplace_back(std::vector<std::string>{"add_word", word});
+        }
+        args.emplace_back(std::vector<std::string>{"return_words_as_error"});
+        args.emplace_back(std::vector<std::string>{"generate_sane_error"});
+        auto commands = std::vector<const std::vector<std::string>*>();
+        for (const auto& command_args : args) {
+            commands.emplace_back(&command_args);
+        }
+
+        auto results = subcontext.ExecuteCommands(commands);
+        ASSERT_TRUE(results) << results.error();
+        ASSERT_EQ(commands.size(), results->size());
+        for (size_t i = 0; i < expected_words.size(); ++i) {
+            EXPECT_TRUE((*results)[i].first) << (*results)[i].first.error();
+        }
+        ASSERT_FALSE((*results)[4].first);
+        EXPECT_EQ(Join(expected_words, " "), (*results)[4].first.error_string());
+        ASSERT_FALSE((*results)[5].first);
+        EXPECT_EQ("Sane error!", (*results)[5].first.error_string());
+        EXPECT_EQ(first_pid, subcontext.pid());
+    });
+}
+
 TEST(subcontext, RecoverAfterAbort) {
     RunTest([](auto& subcontext, auto& context_string) {
         auto first_pid = subcontext.pid();
@@ -22,8 +22,10 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
 #include <sys/wait.h>
 
+#include <atomic>
 #include <set>
 #include <thread>
 
@@ -83,10 +85,11 @@
 // 1) ueventd regenerates uevents by doing the /sys traversal and listens to the netlink socket for
 //    the generated uevents.  It writes these uevents into a queue represented by a vector.
 //
-// 2) ueventd forks 'n' separate uevent handler subprocesses and has each of them to handle the
-//    uevents in the queue based on a starting offset (their process number) and a stride (the total
-//    number of processes).  Note that no IPC happens at this point and only const functions from
-//    DeviceHandler should be called from this context.
+// 2) ueventd forks 'n' separate uevent handler subprocesses and has each of them take the next
+//    unhandled uevent from the queue until it is empty, so that a subprocess that is slow to handle
+//    one uevent doesn't hold up the others.  The only IPC at this point is the index of the next
+//    unhandled uevent, which the subprocesses share through an anonymous shared mapping, and only
+//    const functions from DeviceHandler should be called from this context.
 //
 // 3) In parallel to the subprocesses handling the uevents, the main thread of ueventd calls
 //    selinux_android_restorecon() recursively on /sys/class, /sys/block, and /sys/devices.
@@ -117,7 +120,7 @@ class ColdBoot {
     void Run();
 
   private:
-    void UeventHandlerMain(unsigned int process_num, unsigned int total_processes);
+    void UeventHandlerMain();
     void RegenerateUevents();
     void ForkSubProcesses();
     void DoRestoreCon();
@@ -128,12 +131,15 @@ class ColdBoot {
 
     unsigned int num_handler_subprocesses_;
     std::vector<Uevent> uevent_queue_;
+    // Index of the next uevent in uevent_queue_ to handle, shared with the subprocesses.
+    std::atomic<size_t>* next_uevent_ = nullptr;
 
     std::set<pid_t> subprocess_pids_;
 };
 
-void ColdBoot::UeventHandlerMain(unsigned int process_num, unsigned int total_processes) {
-    for (unsigned int i = process_num; i < uevent_queue_.size(); i += total_processes) {
+void ColdBoot::UeventHandlerMain() {
+    for (size_t i = next_uevent_->fetch_add(1, std::memory_order_relaxed); i < uevent_queue_.size();
+         i = next_uevent_->fetch_add(1, std::memory_order_relaxed)) {
         auto& uevent = uevent_queue_[i];
 
         for (auto& uevent_handler : uevent_handlers_) {
@@ -151,6 +157,13 @@ void ColdBoot::RegenerateUevents() {
 }
 
 void ColdBoot::ForkSubProcesses() {
+    void* shared = mmap(nullptr, sizeof(*next_uevent_), PROT_READ | PROT_WRITE,
+                        MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (shared == MAP_FAILED) {
+        PLOG(FATAL) << "mmap() failed!";
+    }
+    next_uevent_ = new (shared) std::atomic<size_t>(0);
+
     for (unsigned int i = 0; i < num_handler_subprocesses_; ++i) {
         auto pid = fork();
         if (pid < 0) {
@@ -158,7 +171,7 @@ void ColdBoot::ForkSubProcesses() {
         }
 
         if (pid == 0) {
-            UeventHandlerMain(i, num_handler_subprocesses_);
+            UeventHandlerMain();
         }
 
         subprocess_pids_.emplace(pid);
@@ -200,16 +213,22 @@ void ColdBoot::WaitForSubProcesses() {
             LOG(FATAL) << "subprocess killed by signal " << WTERMSIG(status);
         }
     }
+
+    munmap(next_uevent_, sizeof(*next_uevent_));
+    next_uevent_ = nullptr;
 }
 
 void ColdBoot::Run() {
     android::base::Timer cold_boot_timer;
 
     RegenerateUevents();
+    LOG(INFO) << "Coldboot regenerated " << uevent_queue_.size() << " uevents after "
+              << cold_boot_timer;
 
     ForkSubProcesses();
 
     DoRestoreCon();
+    LOG(INFO) << "Coldboot restorecon of /sys done after " << cold_boot_timer;
 
     WaitForSubProcesses();
 
@@ -246,8 +265,12 @@ int ueventd_main(int argc, char** argv) {
             std::move(ueventd_configuration.dev_permissions),
             std::move(ueventd_configuration.sysfs_permissions),
             std::move(ueventd_configuration.subsystems), fs_mgr_get_boot_devices(), true));
-    uevent_handlers.emplace_back(std::make_unique<FirmwareHandler>(
-            std::move(ueventd_configuration.firmware_directories)));
+    auto firmware_handler = std::make_unique<FirmwareHandler>(
+            std::move(ueventd_configuration.firmware_directories));
+    if (!ueventd_configuration.firmware_preload.empty()) {
+        firmware_handler->PreloadFirmware(ueventd_configuration.firmware_preload);
+    }
+    uevent_handlers.emplace_back(std::move(firmware_handler));
 
     if (ueventd_configuration.enable_modalias_handling) {
         uevent_handlers.emplace_back(std::make_unique<ModaliasHandler>());
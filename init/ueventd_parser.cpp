@@ -88,6 +88,17 @@ Result<Success> ParseFirmwareDirectoriesLine(std::vector<std::string>&& args,
     return Success();
 }
 
+Result<Success> ParseFirmwarePreloadLine(std::vector<std::string>&& args,
+                                         std::vector<std::string>* firmware_preload) {
+    if (args.size() < 2) {
+        return Error() << "firmware_preload must have at least 1 entry";
+    }
+
+    std::move(std::next(args.begin()), args.end(), std::back_inserter(*firmware_preload));
+
+    return Success();
+}
+
 Result<Success> ParseModaliasHandlingLine(std::vector<std::string>&& args,
                                           bool* enable_modalias_handling) {
     if (args.size() != 2) {
@@ -219,6 +230,9 @@ UeventdConfiguration ParseConfig(const std::vector<std::string>& configs) {
     parser.AddSingleLineParser("firmware_directories",
                                std::bind(ParseFirmwareDirectoriesLine, _1,
                                          &ueventd_configuration.firmware_directories));
+    parser.AddSingleLineParser("firmware_preload",
+                               std::bind(ParseFirmwarePreloadLine, _1,
+                                         &ueventd_configuration.firmware_preload));
     parser.AddSingleLineParser("modalias_handling",
                                std::bind(ParseModaliasHandlingLine, _1,
                                          &ueventd_configuration.enable_modalias_handling));
@@ -32,6 +32,7 @@ struct UeventdConfiguration {
     std::vector<std::string> firmware_directories;
     bool enable_modalias_handling = false;
     size_t uevent_socket_rcvbuf_size = 0;
+    std::vector<std::string> firmware_preload;
 };
 
 UeventdConfiguration ParseConfig(const std::vector<std::string>& configs);
@@ -65,6 +65,7 @@ void TestUeventdFile(const std::string& content, const UeventdConfiguration& exp
     TestVector(expected.sysfs_permissions, result.sysfs_permissions, TestSysfsPermissions);
     TestVector(expected.dev_permissions, result.dev_permissions, TestPermissions);
     EXPECT_EQ(expected.firmware_directories, result.firmware_directories);
+    EXPECT_EQ(expected.firmware_preload, result.firmware_preload);
 }
 
 TEST(ueventd_parser, EmptyFile) {
@@ -147,6 +148,21 @@ uevent_socket_rcvbuf_size 8M
     TestUeventdFile(ueventd_file, {{}, {}, {}, {}, false, 8 * 1024 * 1024});
 }
 
+TEST(ueventd_parser, FirmwarePreload) {
+    auto ueventd_file = R"(
+firmware_preload a.bin subdir/b.bin
+firmware_preload c.bin
+)";
+
+    auto firmware_preload = std::vector<std::string>{
+            "a.bin",
+            "subdir/b.bin",
+            "c.bin",
+    };
+
+    TestUeventdFile(ueventd_file, {{}, {}, {}, {}, false, 0, firmware_preload});
+}
+
 TEST(ueventd_parser, AllTogether) {
     auto ueventd_file = R"(
 
@@ -222,6 +238,7 @@ TEST(ueventd_parser, ParseErrors) {
 /dev/rtc0                 0640   baduidbad     system
 /dev/rtc0                 0640   system     baduidbad
 firmware_directories #no directory listed
+firmware_preload #no firmware listed
 /sys/devices/platform/trusty.*      trusty_version        badmode  root   log
 /sys/devices/platform/trusty.*      trusty_version        0440  baduidbad   log
 /sys/devices/platform/trusty.*      trusty_version        0440  root   baduidbad
@@ -41,6 +41,8 @@
 #include <selinux/android.h>
 
 #if defined(__ANDROID__)
+#include <fs_mgr/file_wait.h>
+
 #include "selinux.h"
 #else
 #include "host_init_stubs.h"
@@ -226,13 +228,20 @@ bool mkdir_recursive(const std::string& path, mode_t mode) {
 
 int wait_for_file(const char* filename, std::chrono::nanoseconds timeout) {
     android::base::Timer t;
-    while (t.duration() < timeout) {
+#if defined(__ANDROID__)
+    bool found = android::fs_mgr::WaitForFile(
+            filename, std::chrono::duration_cast<std::chrono::milliseconds>(timeout));
+#else
+    bool found = false;
+    while (!found && t.duration() < timeout) {
         struct stat sb;
-        if (stat(filename, &sb) != -1) {
-            LOG(INFO) << "wait for '" << filename << "' took " << t;
-            return 0;
-        }
-        std::this_thread::sleep_for(10ms);
+        found = stat(filename, &sb) != -1;
+        if (!found) std::this_thread::sleep_for(10ms);
+    }
+#endif
+    if (found) {
+        LOG(INFO) << "wait for '" << filename << "' took " << t;
+        return 0;
     }
     LOG(WARNING) << "wait for '" << filename << "' timed out and took " << t;
     return -1;
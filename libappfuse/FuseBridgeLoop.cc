@@ -17,8 +17,12 @@
 #include "libappfuse/FuseBridgeLoop.h"
 
 #include <sys/epoll.h>
+#include <sys/eventfd.h>
 #include <sys/socket.h>
+#include <unistd.h>
 
+#include <algorithm>
+#include <thread>
 #include <unordered_map>
 
 #include <android-base/logging.h>
@@ -58,6 +62,27 @@ void GetObservedEvents(FuseBridgeState state, int* device_events, int* proxy_eve
     }
 }
 
+// Lets the threads of a multi-threaded loop share a callback which is not
+// thread-safe.
+class SerializedCallback : public FuseBridgeLoopCallback {
+  public:
+    explicit SerializedCallback(FuseBridgeLoopCallback* callback) : callback_(callback) {}
+
+    void OnMount(int mount_id) override {
+        std::lock_guard<std::mutex> lock(mutex_);
+        callback_->OnMount(mount_id);
+    }
+
+    void OnClosed(int mount_id) override {
+        std::lock_guard<std::mutex> lock(mutex_);
+        callback_->OnClosed(mount_id);
+    }
+
+  private:
+    FuseBridgeLoopCallback* const callback_;
+    std::mutex mutex_;
+};
+
 void LogResponseError(const std::string& message, const FuseResponse& response) {
     LOG(ERROR) << message << ": header.len=" << response.header.len
                << " header.error=" << response.header.error
@@ -269,14 +294,23 @@ class BridgeEpollController : private EpollController {
             bridge->state_ != FuseBridgeState::kClosing ? EPOLL_CTL_MOD : EPOLL_CTL_DEL, bridge);
     }
 
+    // The stop event is never read, so that it wakes up every thread.
+    bool AddStopPoll(int stop_fd) const {
+        return EpollController::InvokeControl(EPOLL_CTL_ADD, stop_fd, EPOLLIN, nullptr);
+    }
+
     bool Wait(size_t bridge_count, std::unordered_set<FuseBridgeEntry*>* entries_out) {
         CHECK(entries_out);
-        const size_t event_count = std::max<size_t>(bridge_count * 2, 1);
+        const size_t event_count = bridge_count * 2 + 1;
         if (!EpollController::Wait(event_count)) {
             return false;
         }
         entries_out->clear();
         for (const auto& event : events()) {
+            if (event.data.ptr == nullptr) {
+                // Stop event.
+                continue;
+            }
             FuseBridgeEntryEvent* const entry_event =
                 reinterpret_cast<FuseBridgeEntryEvent*>(event.data.ptr);
             entry_event->events = event.events;
@@ -310,17 +344,48 @@ class BridgeEpollController : private EpollController {
     }
 };
 
-FuseBridgeLoop::FuseBridgeLoop() : opened_(true) {
-    base::unique_fd epoll_fd(epoll_create1(EPOLL_CLOEXEC));
-    if (epoll_fd.get() == -1) {
-        PLOG(ERROR) << "Failed to open FD for epoll";
+struct FuseBridgeLoop::LoopThread {
+    std::unique_ptr<BridgeEpollController> epoll_controller;
+
+    // Map between |mount_id| and the bridge entries served by the thread.
+    std::map<int, std::unique_ptr<FuseBridgeEntry>> bridges;
+
+    // False once the thread has stopped serving bridges.
+    bool opened = true;
+};
+
+FuseBridgeLoop::FuseBridgeLoop() : FuseBridgeLoop(1) {}
+
+FuseBridgeLoop::FuseBridgeLoop(size_t thread_count) : opened_(true) {
+    CHECK_GT(thread_count, 0u);
+    stop_fd_.reset(eventfd(/* initval */ 0, EFD_CLOEXEC));
+    if (stop_fd_.get() == -1) {
+        PLOG(ERROR) << "Failed to open FD for stop event";
         opened_ = false;
         return;
     }
-    epoll_controller_.reset(new BridgeEpollController(std::move(epoll_fd)));
+    for (size_t i = 0; i < thread_count; i++) {
+        base::unique_fd epoll_fd(epoll_create1(EPOLL_CLOEXEC));
+        if (epoll_fd.get() == -1) {
+            PLOG(ERROR) << "Failed to open FD for epoll";
+            opened_ = false;
+            return;
+        }
+        std::unique_ptr<LoopThread> thread(new LoopThread());
+        thread->epoll_controller.reset(new BridgeEpollController(std::move(epoll_fd)));
+        if (!thread->epoll_controller->AddStopPoll(stop_fd_)) {
+            opened_ = false;
+            return;
+        }
+        threads_.push_back(std::move(thread));
+    }
 }
 
-FuseBridgeLoop::~FuseBridgeLoop() { CHECK(bridges_.empty()); }
+FuseBridgeLoop::~FuseBridgeLoop() {
+    for (const auto& thread : threads_) {
+        CHECK(thread->bridges.empty());
+    }
+}
 
 bool FuseBridgeLoop::AddBridge(int mount_id, base::unique_fd dev_fd, base::unique_fd proxy_fd) {
     LOG(VERBOSE) << "Adding bridge " << mount_id;
@@ -332,30 +397,43 @@ bool FuseBridgeLoop::AddBridge(int mount_id, base::unique_fd dev_fd, base::uniqu
         LOG(ERROR) << "Tried to add a mount to a closed bridge";
         return false;
     }
-    if (bridges_.count(mount_id)) {
-        LOG(ERROR) << "Tried to add a mount point that has already been added";
-        return false;
+    // Serve the new bridge from the thread having the fewest bridges.
+    LoopThread* target = nullptr;
+    for (const auto& thread : threads_) {
+        if (thread->bridges.count(mount_id)) {
+            LOG(ERROR) << "Tried to add a mount point that has already been added";
+            return false;
+        }
+        if (thread->opened && (!target || thread->bridges.size() < target->bridges.size())) {
+            target = thread.get();
+        }
     }
-    if (!epoll_controller_->AddBridgePoll(bridge.get())) {
+    CHECK(target);
+    if (!target->epoll_controller->AddBridgePoll(bridge.get())) {
         return false;
     }
 
-    bridges_.emplace(mount_id, std::move(bridge));
+    target->bridges.emplace(mount_id, std::move(bridge));
     return true;
 }
 
-bool FuseBridgeLoop::ProcessEventLocked(const std::unordered_set<FuseBridgeEntry*>& entries,
-                                        FuseBridgeLoopCallback* callback) {
+bool FuseBridgeLoop::ProcessEvent(LoopThread* thread,
+                                  const std::unordered_set<FuseBridgeEntry*>& entries,
+                                  FuseBridgeLoopCallback* callback) {
+    // Entries are only transferred by the thread serving them, so the lock is
+    // only needed to remove them.
     for (auto entry : entries) {
         entry->Transfer(callback);
-        if (!epoll_controller_->UpdateOrDeleteBridgePoll(entry)) {
+        if (!thread->epoll_controller->UpdateOrDeleteBridgePoll(entry)) {
             return false;
         }
         if (entry->IsClosing()) {
             const int mount_id = entry->mount_id();
+            std::lock_guard<std::mutex> lock(mutex_);
             callback->OnClosed(mount_id);
-            bridges_.erase(mount_id);
-            if (bridges_.size() == 0) {
+            thread->bridges.erase(mount_id);
+            if (std::all_of(threads_.begin(), threads_.end(),
+                            [](const auto& t) { return t->bridges.empty(); })) {
                 // All bridges are now closed.
                 return false;
             }
@@ -364,23 +442,66 @@ bool FuseBridgeLoop::ProcessEventLocked(const std::unordered_set<FuseBridgeEntry
     return true;
 }
 
-void FuseBridgeLoop::Start(FuseBridgeLoopCallback* callback) {
-    LOG(DEBUG) << "Start fuse bridge loop";
+void FuseBridgeLoop::CloseBridgesLocked(LoopThread* thread, FuseBridgeLoopCallback* callback) {
+    for (auto it = thread->bridges.begin(); it != thread->bridges.end();) {
+        callback->OnClosed(it->second->mount_id());
+        it = thread->bridges.erase(it);
+    }
+    thread->opened = false;
+
+    // The loop is closed once there is no bridge or no thread left. The other
+    // threads are blocked in epoll_wait, so wake them up.
+    if (std::any_of(threads_.begin(), threads_.end(),
+                    [](const auto& t) { return t->opened && !t->bridges.empty(); })) {
+        return;
+    }
+    opened_ = false;
+    const uint64_t value = 1;
+    if (write(stop_fd_, &value, sizeof(value)) == -1) {
+        PLOG(ERROR) << "Failed to send a stop event";
+    }
+}
+
+void FuseBridgeLoop::Run(LoopThread* thread, FuseBridgeLoopCallback* callback) {
     std::unordered_set<FuseBridgeEntry*> entries;
     while (true) {
-        const bool wait_result = epoll_controller_->Wait(bridges_.size(), &entries);
-        LOG(VERBOSE) << "Receive epoll events";
+        size_t bridge_count;
         {
             std::lock_guard<std::mutex> lock(mutex_);
-            if (!(wait_result && ProcessEventLocked(entries, callback))) {
-                for (auto it = bridges_.begin(); it != bridges_.end();) {
-                    callback->OnClosed(it->second->mount_id());
-                    it = bridges_.erase(it);
-                }
-                opened_ = false;
+            if (!opened_) {
                 return;
             }
+            bridge_count = thread->bridges.size();
         }
+        const bool wait_result = thread->epoll_controller->Wait(bridge_count, &entries);
+        LOG(VERBOSE) << "Receive epoll events";
+        if (!(wait_result && ProcessEvent(thread, entries, callback))) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            CloseBridgesLocked(thread, callback);
+            return;
+        }
+    }
+}
+
+void FuseBridgeLoop::Start(FuseBridgeLoopCallback* callback) {
+    LOG(DEBUG) << "Start fuse bridge loop";
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!opened_) {
+            LOG(ERROR) << "Tried to start a closed bridge loop";
+            return;
+        }
+    }
+
+    SerializedCallback serialized_callback(callback);
+    std::vector<std::thread> extra_threads;
+    for (size_t i = 1; i < threads_.size(); i++) {
+        extra_threads.emplace_back(&FuseBridgeLoop::Run, this, threads_[i].get(),
+                                   &serialized_callback);
+    }
+    Run(threads_[0].get(), &serialized_callback);
+    for (auto& thread : extra_threads) {
+        thread.join();
     }
 }
 
@@ -18,9 +18,11 @@
 #define ANDROID_LIBAPPFUSE_FUSEBRIDGELOOP_H_
 
 #include <map>
+#include <memory>
 #include <mutex>
 #include <queue>
 #include <unordered_set>
+#include <vector>
 
 #include <android-base/macros.h>
 
@@ -42,8 +44,15 @@ class BridgeEpollController;
 class FuseBridgeLoop final {
   public:
     FuseBridgeLoop();
+    // Creates a loop which serves its bridges from |thread_count| threads. Each
+    // bridge is handled by a single thread, so this helps when several mounts
+    // are busy at the same time.
+    explicit FuseBridgeLoop(size_t thread_count);
     ~FuseBridgeLoop();
 
+    // Runs the loop until all bridges are closed. Extra threads of a
+    // multi-threaded loop are started and joined by this method. |callback| is
+    // invoked by one thread at a time, though not always by the caller's thread.
     void Start(FuseBridgeLoopCallback* callback);
 
     // Add bridge to the loop. It's OK to invoke the method from a different
@@ -51,15 +60,19 @@ class FuseBridgeLoop final {
     bool AddBridge(int mount_id, base::unique_fd dev_fd, base::unique_fd proxy_fd);
 
   private:
-    bool ProcessEventLocked(const std::unordered_set<FuseBridgeEntry*>& entries,
-                            FuseBridgeLoopCallback* callback);
+    struct LoopThread;
 
-    std::unique_ptr<BridgeEpollController> epoll_controller_;
+    void Run(LoopThread* thread, FuseBridgeLoopCallback* callback);
+    bool ProcessEvent(LoopThread* thread, const std::unordered_set<FuseBridgeEntry*>& entries,
+                      FuseBridgeLoopCallback* callback);
+    void CloseBridgesLocked(LoopThread* thread, FuseBridgeLoopCallback* callback);
 
-    // Map between |mount_id| and bridge entry.
-    std::map<int, std::unique_ptr<FuseBridgeEntry>> bridges_;
+    std::vector<std::unique_ptr<LoopThread>> threads_;
 
-    // Lock for multi-threading.
+    // Wakes up every thread once the loop is closed.
+    base::unique_fd stop_fd_;
+
+    // Lock for multi-threading. It guards the bridge maps and |opened_|.
     std::mutex mutex_;
 
     bool opened_;
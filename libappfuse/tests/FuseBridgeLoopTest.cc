@@ -210,5 +210,50 @@ TEST_F(FuseBridgeLoopTest, Proxy) {
   Close();
 }
 
+TEST(FuseBridgeLoopMultiThreadTest, Proxy) {
+  constexpr int kMountCount = 4;
+  base::unique_fd dev_sockets[kMountCount][2];
+  base::unique_fd proxy_sockets[kMountCount][2];
+  Callback callback;
+  FuseBridgeLoop loop(2);
+  for (int i = 0; i < kMountCount; i++) {
+    ASSERT_TRUE(SetupMessageSockets(&dev_sockets[i]));
+    ASSERT_TRUE(SetupMessageSockets(&proxy_sockets[i]));
+    ASSERT_TRUE(loop.AddBridge(i, std::move(dev_sockets[i][1]), std::move(proxy_sockets[i][0])));
+  }
+  std::thread thread([&] { loop.Start(&callback); });
+
+  // Round trip a FUSE_READ on every mount concurrently.
+  std::thread clients[kMountCount];
+  for (int i = 0; i < kMountCount; i++) {
+    clients[i] = std::thread([&, i] {
+      std::unique_ptr<FuseBuffer> buffer(new FuseBuffer());
+      for (uint64_t unique = 1; unique <= 100; unique++) {
+        buffer->request.Reset(sizeof(fuse_read_in), FUSE_READ, unique);
+        ASSERT_TRUE(buffer->request.Write(dev_sockets[i][0]));
+        ASSERT_TRUE(buffer->request.Read(proxy_sockets[i][1]));
+        EXPECT_EQ(unique, buffer->request.header.unique);
+
+        buffer->response.Reset(kFuseMaxRead, kFuseSuccess, unique);
+        buffer->response.read_data[0] = i;
+        ASSERT_TRUE(buffer->response.Write(proxy_sockets[i][1]));
+        ASSERT_TRUE(buffer->response.Read(dev_sockets[i][0]));
+        EXPECT_EQ(unique, buffer->response.header.unique);
+        EXPECT_EQ(i, buffer->response.read_data[0]);
+      }
+    });
+  }
+  for (auto& client : clients) {
+    client.join();
+  }
+
+  for (int i = 0; i < kMountCount; i++) {
+    dev_sockets[i][0].reset();
+    proxy_sockets[i][1].reset();
+  }
+  thread.join();
+  EXPECT_TRUE(callback.closed);
+}
+
 }  // namespace fuse
 }  // namespace android
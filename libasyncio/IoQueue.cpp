@@ -0,0 +1,456 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <asyncio/IoQueue.h>
+
+#include <asyncio/AsyncIO.h>
+#include <errno.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <vector>
+
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#define HAVE_IO_URING 1
+
+#ifndef __NR_io_uring_setup
+#define __NR_io_uring_setup 425
+#endif
+#ifndef __NR_io_uring_enter
+#define __NR_io_uring_enter 426
+#endif
+#endif
+
+namespace android {
+namespace asyncio {
+
+namespace {
+
+// Hands out the indices of a fixed table of per-operation state, which ties a
+// completion back to the caller's user_data and keeps the iovec or iocb that
+// the kernel reads alive until the operation completes.
+template <typename Op>
+class OpTable {
+  public:
+    explicit OpTable(unsigned depth) : ops_(depth) {
+        free_.reserve(depth);
+        for (unsigned i = depth; i > 0; i--) {
+            free_.push_back(i - 1);
+        }
+    }
+
+    bool full() const { return free_.empty(); }
+
+    uint32_t Get() {
+        uint32_t index = free_.back();
+        free_.pop_back();
+        return index;
+    }
+
+    void Put(uint32_t index) { free_.push_back(index); }
+
+    Op& operator[](uint32_t index) { return ops_[index]; }
+
+  private:
+    std::vector<Op> ops_;
+    std::vector<uint32_t> free_;
+};
+
+#if defined(HAVE_IO_URING)
+
+int io_uring_setup(unsigned entries, io_uring_params* params) {
+    return syscall(__NR_io_uring_setup, entries, params);
+}
+
+int io_uring_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags) {
+    return syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, nullptr, 0);
+}
+
+class IoUringQueue : public IoQueue {
+  public:
+    static std::unique_ptr<IoQueue> Create(unsigned depth);
+    ~IoUringQueue() override;
+
+    Backend backend() const override { return Backend::kIoUring; }
+
+    bool PrepRead(int fd, void* buf, size_t len, off64_t offset, uint64_t user_data) override {
+        return Prep(IORING_OP_READV, fd, buf, len, offset, 0, user_data);
+    }
+    bool PrepWrite(int fd, const void* buf, size_t len, off64_t offset,
+                   uint64_t user_data) override {
+        return Prep(IORING_OP_WRITEV, fd, const_cast<void*>(buf), len, offset, 0, user_data);
+    }
+    bool PrepFsync(int fd, bool datasync, uint64_t user_data) override {
+        return Prep(IORING_OP_FSYNC, fd, nullptr, 0, 0, datasync ? IORING_FSYNC_DATASYNC : 0,
+                    user_data);
+    }
+
+    int Submit() override;
+    int Wait(Completion* out, size_t max, size_t min) override;
+
+  private:
+    struct Op {
+        uint64_t user_data;
+        iovec iov;
+    };
+
+    explicit IoUringQueue(unsigned depth) : ops_(depth) {}
+
+    bool Map(unsigned depth);
+    size_t Reap(Completion* out, size_t max);
+    bool Prep(uint8_t opcode, int fd, void* buf, size_t len, off64_t offset, uint32_t fsync_flags,
+              uint64_t user_data);
+
+    OpTable<Op> ops_;
+    int ring_fd_ = -1;
+
+    void* sq_ring_ = MAP_FAILED;
+    size_t sq_ring_size_ = 0;
+    void* cq_ring_ = MAP_FAILED;
+    size_t cq_ring_size_ = 0;
+    io_uring_sqe* sqes_ = static_cast<io_uring_sqe*>(MAP_FAILED);
+    size_t sqes_size_ = 0;
+
+    // Pointers into the rings shared with the kernel.
+    unsigned* sq_head_ = nullptr;
+    unsigned* sq_tail_ = nullptr;
+    unsigned* sq_array_ = nullptr;
+    unsigned sq_mask_ = 0;
+    unsigned sq_entries_ = 0;
+    unsigned* cq_head_ = nullptr;
+    unsigned* cq_tail_ = nullptr;
+    io_uring_cqe* cqes_ = nullptr;
+    unsigned cq_mask_ = 0;
+
+    // Filled in but not yet published to the kernel by Submit().
+    unsigned sq_tail_local_ = 0;
+    unsigned to_submit_ = 0;
+    size_t in_flight_ = 0;
+};
+
+std::unique_ptr<IoQueue> IoUringQueue::Create(unsigned depth) {
+    std::unique_ptr<IoUringQueue> queue(new IoUringQueue(depth));
+    if (!queue->Map(depth)) {
+        return nullptr;
+    }
+    return queue;
+}
+
+bool IoUringQueue::Map(unsigned depth) {
+    io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    ring_fd_ = io_uring_setup(depth, &params);
+    if (ring_fd_ == -1) {
+        return false;
+    }
+
+    sq_ring_size_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    sq_ring_ = mmap(nullptr, sq_ring_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                    ring_fd_, IORING_OFF_SQ_RING);
+    if (sq_ring_ == MAP_FAILED) {
+        return false;
+    }
+    cq_ring_size_ = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    cq_ring_ = mmap(nullptr, cq_ring_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                    ring_fd_, IORING_OFF_CQ_RING);
+    if (cq_ring_ == MAP_FAILED) {
+        return false;
+    }
+    sqes_size_ = params.sq_entries * sizeof(io_uring_sqe);
+    sqes_ = static_cast<io_uring_sqe*>(mmap(nullptr, sqes_size_, PROT_READ | PROT_WRITE,
+                                            MAP_SHARED | MAP_POPULATE, ring_fd_,
+                                            IORING_OFF_SQES));
+    if (sqes_ == MAP_FAILED) {
+        return false;
+    }
+
+    char* sq = static_cast<char*>(sq_ring_);
+    sq_head_ = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+    sq_tail_ = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+    sq_array_ = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+    sq_mask_ = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+    sq_entries_ = params.sq_entries;
+    sq_tail_local_ = *sq_tail_;
+
+    char* cq = static_cast<char*>(cq_ring_);
+    cq_head_ = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+    cq_tail_ = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+    cqes_ = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+    cq_mask_ = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+    return true;
+}
+
+IoUringQueue::~IoUringQueue() {
+    if (sqes_ != MAP_FAILED) munmap(sqes_, sqes_size_);
+    if (cq_ring_ != MAP_FAILED) munmap(cq_ring_, cq_ring_size_);
+    if (sq_ring_ != MAP_FAILED) munmap(sq_ring_, sq_ring_size_);
+    // Closing the ring waits for the operations still in flight.
+    if (ring_fd_ != -1) close(ring_fd_);
+}
+
+bool IoUringQueue::Prep(uint8_t opcode, int fd, void* buf, size_t len, off64_t offset,
+                        uint32_t fsync_flags, uint64_t user_data) {
+    if (ops_.full() ||
+        sq_tail_local_ - __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE) >= sq_entries_) {
+        return false;
+    }
+
+    uint32_t index = ops_.Get();
+    Op& op = ops_[index];
+    op.user_data = user_data;
+    op.iov.iov_base = buf;
+    op.iov.iov_len = len;
+
+    unsigned slot = sq_tail_local_ & sq_mask_;
+    io_uring_sqe* sqe = &sqes_[slot];
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = opcode;
+    sqe->fd = fd;
+    sqe->off = offset;
+    if (opcode == IORING_OP_FSYNC) {
+        sqe->fsync_flags = fsync_flags;
+    } else {
+        sqe->addr = reinterpret_cast<uintptr_t>(&op.iov);
+        sqe->len = 1;
+    }
+    sqe->user_data = index;
+    sq_array_[slot] = slot;
+
+    sq_tail_local_++;
+    to_submit_++;
+    return true;
+}
+
+int IoUringQueue::Submit() {
+    if (to_submit_ == 0) {
+        return 0;
+    }
+    __atomic_store_n(sq_tail_, sq_tail_local_, __ATOMIC_RELEASE);
+
+    int rc = io_uring_enter(ring_fd_, to_submit_, 0, 0);
+    if (rc < 0) {
+        return -errno;
+    }
+    to_submit_ -= rc;
+    in_flight_ += rc;
+    return rc;
+}
+
+size_t IoUringQueue::Reap(Completion* out, size_t max) {
+    unsigned head = *cq_head_;
+    unsigned tail = __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE);
+    size_t count = 0;
+    while (head != tail && count < max) {
+        const io_uring_cqe& cqe = cqes_[head & cq_mask_];
+        uint32_t index = cqe.user_data;
+        out[count].user_data = ops_[index].user_data;
+        out[count].result = cqe.res;
+        ops_.Put(index);
+        count++;
+        head++;
+    }
+    __atomic_store_n(cq_head_, head, __ATOMIC_RELEASE);
+    in_flight_ -= count;
+    return count;
+}
+
+int IoUringQueue::Wait(Completion* out, size_t max, size_t min) {
+    min = std::min({min, max, in_flight_});
+
+    size_t count = 0;
+    while (true) {
+        count += Reap(out + count, max - count);
+        if (count >= min) {
+            return count;
+        }
+        if (io_uring_enter(ring_fd_, 0, min - count, IORING_ENTER_GETEVENTS) < 0 &&
+            errno != EINTR) {
+            return count > 0 ? static_cast<int>(count) : -errno;
+        }
+    }
+}
+
+#endif  // HAVE_IO_URING
+
+class AioQueue : public IoQueue {
+  public:
+    static std::unique_ptr<IoQueue> Create(unsigned depth);
+    ~AioQueue() override;
+
+    Backend backend() const override { return Backend::kAio; }
+
+    bool PrepRead(int fd, void* buf, size_t len, off64_t offset, uint64_t user_data) override {
+        return Prep(IOCB_CMD_PREAD, fd, buf, len, offset, user_data);
+    }
+    bool PrepWrite(int fd, const void* buf, size_t len, off64_t offset,
+                   uint64_t user_data) override {
+        return Prep(IOCB_CMD_PWRITE, fd, buf, len, offset, user_data);
+    }
+    bool PrepFsync(int fd, bool datasync, uint64_t user_data) override {
+        return Prep(datasync ? IOCB_CMD_FDSYNC : IOCB_CMD_FSYNC, fd, nullptr, 0, 0, user_data);
+    }
+
+    int Submit() override;
+    int Wait(Completion* out, size_t max, size_t min) override;
+
+  private:
+    struct Op {
+        uint64_t user_data;
+        iocb cb;
+    };
+
+    explicit AioQueue(unsigned depth) : ops_(depth) { queued_.reserve(depth); }
+
+    bool Prep(uint16_t opcode, int fd, const void* buf, size_t len, off64_t offset,
+              uint64_t user_data);
+
+    OpTable<Op> ops_;
+    aio_context_t ctx_ = 0;
+    std::vector<iocb*> queued_;
+    // fsyncs, which AIO only gained in 4.18, run synchronously in Submit().
+    std::vector<Completion> done_;
+    size_t in_flight_ = 0;
+};
+
+std::unique_ptr<IoQueue> AioQueue::Create(unsigned depth) {
+    std::unique_ptr<AioQueue> queue(new AioQueue(depth));
+    if (io_setup(depth, &queue->ctx_) != 0) {
+        return nullptr;
+    }
+    return queue;
+}
+
+AioQueue::~AioQueue() {
+    // Destroying the context waits for the operations still in flight.
+    if (ctx_ != 0) io_destroy(ctx_);
+}
+
+bool AioQueue::Prep(uint16_t opcode, int fd, const void* buf, size_t len, off64_t offset,
+                    uint64_t user_data) {
+    if (ops_.full()) {
+        return false;
+    }
+
+    uint32_t index = ops_.Get();
+    Op& op = ops_[index];
+    op.user_data = user_data;
+    io_prep(&op.cb, fd, buf, len, offset, opcode == IOCB_CMD_PREAD);
+    op.cb.aio_lio_opcode = opcode;
+    op.cb.aio_data = index;
+    queued_.push_back(&op.cb);
+    return true;
+}
+
+int AioQueue::Submit() {
+    size_t started = 0;
+    while (started < queued_.size()) {
+        iocb* cb = queued_[started];
+        if (cb->aio_lio_opcode == IOCB_CMD_FSYNC || cb->aio_lio_opcode == IOCB_CMD_FDSYNC) {
+            int rc = (cb->aio_lio_opcode == IOCB_CMD_FDSYNC) ? fdatasync(cb->aio_fildes)
+                                                             : fsync(cb->aio_fildes);
+            done_.push_back({ops_[cb->aio_data].user_data, rc == 0 ? 0 : -errno});
+            ops_.Put(cb->aio_data);
+            started++;
+            continue;
+        }
+
+        // Submit everything up to the next fsync at once.
+        size_t end = started + 1;
+        while (end < queued_.size() && queued_[end]->aio_lio_opcode != IOCB_CMD_FSYNC &&
+               queued_[end]->aio_lio_opcode != IOCB_CMD_FDSYNC) {
+            end++;
+        }
+        size_t batch = end - started;
+        int rc = io_submit(ctx_, batch, &queued_[started]);
+        if (rc < 0) {
+            if (started == 0) {
+                return -errno;
+            }
+            break;
+        }
+        in_flight_ += rc;
+        started += rc;
+        if (static_cast<size_t>(rc) < batch) {
+            break;
+        }
+    }
+    queued_.erase(queued_.begin(), queued_.begin() + started);
+    return started;
+}
+
+int AioQueue::Wait(Completion* out, size_t max, size_t min) {
+    size_t count = std::min(max, done_.size());
+    std::copy(done_.begin(), done_.begin() + count, out);
+    done_.erase(done_.begin(), done_.begin() + count);
+
+    min = std::min({min, max, count + in_flight_});
+    while (count < max && in_flight_ > 0) {
+        io_event events[64];
+        long want = std::min(max - count, sizeof(events) / sizeof(events[0]));
+        long need = (min > count) ? std::min<long>(min - count, want) : 0;
+        timespec zero = {};
+        int rc = io_getevents(ctx_, need, want, events, need == 0 ? &zero : nullptr);
+        if (rc < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return count > 0 ? static_cast<int>(count) : -errno;
+        }
+
+        for (int i = 0; i < rc; i++) {
+            uint32_t index = events[i].data;
+            out[count].user_data = ops_[index].user_data;
+            out[count].result = events[i].res;
+            ops_.Put(index);
+            count++;
+        }
+        in_flight_ -= rc;
+        if (count >= min) {
+            break;
+        }
+    }
+    return count;
+}
+
+}  // namespace
+
+std::unique_ptr<IoQueue> IoQueue::Create(unsigned depth, bool allow_io_uring) {
+    if (depth == 0) {
+        errno = EINVAL;
+        return nullptr;
+    }
+#if defined(HAVE_IO_URING)
+    // io_uring may be missing from the kernel or blocked by seccomp or SELinux.
+    if (allow_io_uring) {
+        std::unique_ptr<IoQueue> queue = IoUringQueue::Create(depth);
+        if (queue) {
+            return queue;
+        }
+    }
+#else
+    (void)allow_io_uring;
+#endif
+    return AioQueue::Create(depth);
+}
+
+}  // namespace asyncio
+}  // namespace android
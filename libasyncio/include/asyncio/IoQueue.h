@@ -0,0 +1,87 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#include <memory>
+
+namespace android {
+namespace asyncio {
+
+/**
+ * A batching queue of asynchronous file operations: operations are queued
+ * with the Prep*() calls, started together by one Submit() and reaped with
+ * Wait().
+ *
+ * io_uring is used when the kernel has it, so buffered reads and writes
+ * complete asynchronously too. Otherwise the queue falls back to the Linux AIO
+ * syscalls of AsyncIO.h, under which only O_DIRECT files and FunctionFS
+ * endpoints are truly asynchronous: other reads and writes may block in
+ * Submit(), and fsyncs run synchronously in Submit().
+ *
+ * Operations are not ordered against each other, so an fsync only covers the
+ * writes that completed before it was submitted.
+ *
+ * An IoQueue is not thread-safe.
+ */
+class IoQueue {
+  public:
+    enum class Backend { kIoUring, kAio };
+
+    struct Completion {
+        uint64_t user_data;
+        // Bytes transferred, or -errno.
+        int64_t result;
+    };
+
+    // |depth| is the number of operations that may be queued or in flight at
+    // once. Returns nullptr with errno set on failure.
+    static std::unique_ptr<IoQueue> Create(unsigned depth, bool allow_io_uring = true);
+    virtual ~IoQueue() = default;
+
+    virtual Backend backend() const = 0;
+
+    // Each returns false, queueing nothing, when |depth| operations are already
+    // queued or in flight. Buffers must stay valid until the completion.
+    virtual bool PrepRead(int fd, void* buf, size_t len, off64_t offset, uint64_t user_data) = 0;
+    virtual bool PrepWrite(int fd, const void* buf, size_t len, off64_t offset,
+                           uint64_t user_data) = 0;
+    virtual bool PrepFsync(int fd, bool datasync, uint64_t user_data) = 0;
+
+    // Starts the operations queued since the last call, with a single syscall
+    // where possible. Returns how many were started or -errno; the rest stay
+    // queued for the next call.
+    virtual int Submit() = 0;
+
+    // Reaps at most |max| completions into |out|, blocking until at least
+    // |min| are available. |min| is capped by the number of started
+    // operations, so a |min| of 0 only polls. Returns the count or -errno.
+    virtual int Wait(Completion* out, size_t max, size_t min) = 0;
+
+  protected:
+    IoQueue() = default;
+
+  private:
+    IoQueue(const IoQueue&) = delete;
+    IoQueue& operator=(const IoQueue&) = delete;
+};
+
+}  // namespace asyncio
+}  // namespace android
@@ -18,11 +18,17 @@
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/ptrace.h>
+#include <sys/wait.h>
+#include <unistd.h>
 
+#include <algorithm>
 #include <memory>
 #include <set>
 #include <string>
+#include <vector>
 
+#include <android-base/macros.h>
 #include <backtrace/Backtrace.h>
 #include <demangle.h>
 #include <unwindstack/Elf.h>
@@ -41,13 +47,40 @@
 #include "UnwindStack.h"
 #include "UnwindStackMap.h"
 
-bool Backtrace::Unwind(unwindstack::Regs* regs, BacktraceMap* back_map,
-                       std::vector<backtrace_frame_data_t>* frames, size_t num_ignore_frames,
-                       std::vector<std::string>* skip_names, BacktraceUnwindError* error) {
-  UnwindStackMap* stack_map = reinterpret_cast<UnwindStackMap*>(back_map);
-  auto process_memory = stack_map->process_memory();
+// Serves reads of a copy of the top of a thread's stack, taken while the
+// thread was stopped, and passes every other read through to the process.
+class MemoryStackSnapshot : public unwindstack::Memory {
+ public:
+  MemoryStackSnapshot(const std::shared_ptr<unwindstack::Memory>& process_memory, uint64_t start,
+                      std::vector<uint8_t>&& data)
+      : process_memory_(process_memory), start_(start), data_(std::move(data)) {}
+  virtual ~MemoryStackSnapshot() = default;
+
+  size_t Read(uint64_t addr, void* dst, size_t size) override {
+    uint64_t end = start_ + data_.size();
+    if (addr >= start_ && addr < end) {
+      size = std::min<uint64_t>(size, end - addr);
+      memcpy(dst, &data_[addr - start_], size);
+      return size;
+    }
+    if (addr < start_ && addr + size > start_) {
+      size = start_ - addr;
+    }
+    return process_memory_->Read(addr, dst, size);
+  }
+
+ private:
+  std::shared_ptr<unwindstack::Memory> process_memory_;
+  uint64_t start_;
+  std::vector<uint8_t> data_;
+};
+
+static bool UnwindWithMemory(unwindstack::Regs* regs, UnwindStackMap* stack_map,
+                             const std::shared_ptr<unwindstack::Memory>& process_memory,
+                             std::vector<backtrace_frame_data_t>* frames, size_t num_ignore_frames,
+                             std::vector<std::string>* skip_names, BacktraceUnwindError* error) {
   unwindstack::Unwinder unwinder(MAX_BACKTRACE_FRAMES + num_ignore_frames, stack_map->stack_maps(),
-                                 regs, stack_map->process_memory());
+                                 regs, process_memory);
   unwinder.SetResolveNames(stack_map->ResolveNames());
   stack_map->SetArch(regs->Arch());
   if (stack_map->GetJitDebug() != nullptr) {
@@ -125,6 +158,14 @@ bool Backtrace::Unwind(unwindstack::Regs* regs, BacktraceMap* back_map,
   return true;
 }
 
+bool Backtrace::Unwind(unwindstack::Regs* regs, BacktraceMap* back_map,
+                       std::vector<backtrace_frame_data_t>* frames, size_t num_ignore_frames,
+                       std::vector<std::string>* skip_names, BacktraceUnwindError* error) {
+  UnwindStackMap* stack_map = reinterpret_cast<UnwindStackMap*>(back_map);
+  return UnwindWithMemory(regs, stack_map, stack_map->process_memory(), frames, num_ignore_frames,
+                          skip_names, error);
+}
+
 bool Backtrace::UnwindOffline(unwindstack::Regs* regs, BacktraceMap* back_map,
                               const backtrace_stackinfo_t& stack,
                               std::vector<backtrace_frame_data_t>* frames,
@@ -188,6 +229,90 @@ size_t UnwindStackPtrace::Read(uint64_t addr, uint8_t* buffer, size_t bytes) {
   return memory_.Read(addr, buffer, bytes);
 }
 
+UnwindStackSample::UnwindStackSample(pid_t pid, pid_t tid, BacktraceMap* map)
+    : Backtrace(pid, tid, map), memory_(pid) {}
+
+std::string UnwindStackSample::GetFunctionNameRaw(uint64_t pc, uint64_t* offset) {
+  return GetMap()->GetFunctionName(pc, offset);
+}
+
+// Stops the thread just long enough to read its registers and copy the top of
+// its stack. Returns the signal that was about to be delivered when the thread
+// stopped, which must be passed on when detaching, or -1 on failure.
+static int StopAndWait(pid_t tid) {
+  if (ptrace(PTRACE_SEIZE, tid, 0, 0) != 0) {
+    BACK_LOGW("ptrace seize of %d failed: %s", tid, strerror(errno));
+    return -1;
+  }
+  if (ptrace(PTRACE_INTERRUPT, tid, 0, 0) != 0) {
+    BACK_LOGW("ptrace interrupt of %d failed: %s", tid, strerror(errno));
+    ptrace(PTRACE_DETACH, tid, 0, 0);
+    return -1;
+  }
+
+  int status;
+  if (TEMP_FAILURE_RETRY(waitpid(tid, &status, __WALL)) != tid || !WIFSTOPPED(status)) {
+    BACK_LOGW("waiting for %d to stop failed", tid);
+    ptrace(PTRACE_DETACH, tid, 0, 0);
+    return -1;
+  }
+  // A signal that arrived before the interrupt stops the thread first, which
+  // is just as good a place to sample it, as long as the signal is not lost.
+  if ((status >> 16) == PTRACE_EVENT_STOP) {
+    return 0;
+  }
+  return WSTOPSIG(status);
+}
+
+bool UnwindStackSample::Unwind(size_t num_ignore_frames, void* context) {
+  if (context != nullptr) {
+    error_.error_code = BACKTRACE_UNWIND_ERROR_UNSUPPORTED_OPERATION;
+    return false;
+  }
+
+  int signal = StopAndWait(Tid());
+  if (signal < 0) {
+    error_.error_code = BACKTRACE_UNWIND_ERROR_SETUP_FAILED;
+    return false;
+  }
+
+  std::unique_ptr<unwindstack::Regs> regs(unwindstack::Regs::RemoteGet(Tid()));
+  std::vector<uint8_t> stack;
+  uint64_t sp = 0;
+  if (regs != nullptr) {
+    sp = regs->sp();
+    backtrace_map_t map;
+    FillInMap(sp, &map);
+    if (BacktraceMap::IsValid(map) && (map.flags & PROT_READ)) {
+      stack.resize(std::min<uint64_t>(map.end - sp, kMaxStackSnapshotSize));
+      stack.resize(memory_.Read(sp, stack.data(), stack.size()));
+    }
+  }
+  ptrace(PTRACE_DETACH, Tid(), 0, signal);
+
+  if (regs == nullptr) {
+    error_.error_code = BACKTRACE_UNWIND_ERROR_SETUP_FAILED;
+    return false;
+  }
+
+  UnwindStackMap* stack_map = reinterpret_cast<UnwindStackMap*>(GetMap());
+  auto process_memory =
+      std::make_shared<MemoryStackSnapshot>(stack_map->process_memory(), sp, std::move(stack));
+  return UnwindWithMemory(regs.get(), stack_map, process_memory, &frames_, num_ignore_frames,
+                          nullptr, &error_);
+}
+
+size_t UnwindStackSample::Read(uint64_t addr, uint8_t* buffer, size_t bytes) {
+  return memory_.Read(addr, buffer, bytes);
+}
+
+bool UnwindStackSample::ReadWord(uint64_t ptr, word_t* out_value) {
+  if (!VerifyReadWordArgs(ptr, out_value)) {
+    return false;
+  }
+  return memory_.ReadFully(ptr, out_value, sizeof(*out_value));
+}
+
 UnwindStackOffline::UnwindStackOffline(ArchEnum arch, pid_t pid, pid_t tid, BacktraceMap* map,
                                        bool map_shared)
     : Backtrace(pid, tid, map), arch_(arch) {
@@ -234,6 +359,16 @@ bool UnwindStackOffline::ReadWord(uint64_t, word_t*) {
   return false;
 }
 
+Backtrace* Backtrace::CreateSample(pid_t pid, pid_t tid, BacktraceMap* map) {
+  if (pid < 0 || pid == getpid()) {
+    return nullptr;
+  }
+  if (tid == BACKTRACE_CURRENT_THREAD) {
+    tid = pid;
+  }
+  return new UnwindStackSample(pid, tid, map);
+}
+
 Backtrace* Backtrace::CreateOffline(ArchEnum arch, pid_t pid, pid_t tid,
                                     const std::vector<backtrace_map_t>& maps,
                                     const backtrace_stackinfo_t& stack) {
@@ -255,3 +390,7 @@ Backtrace* Backtrace::CreateOffline(ArchEnum arch, pid_t pid, pid_t tid, Backtra
 void Backtrace::SetGlobalElfCache(bool enable) {
   unwindstack::Elf::SetCachingEnabled(enable);
 }
+
+void Backtrace::SetGlobalElfDiskCache(const std::string& directory) {
+  unwindstack::Elf::SetDiskCacheDirectory(directory);
+}
@@ -52,6 +52,28 @@ class UnwindStackPtrace : public BacktracePtrace {
   unwindstack::MemoryRemote memory_;
 };
 
+// Samples a thread of a process that the caller has not attached to, stopping
+// it only while its registers and the top of its stack are copied.
+class UnwindStackSample : public Backtrace {
+ public:
+  UnwindStackSample(pid_t pid, pid_t tid, BacktraceMap* map);
+  virtual ~UnwindStackSample() = default;
+
+  bool Unwind(size_t num_ignore_frames, void* context) override;
+
+  std::string GetFunctionNameRaw(uint64_t pc, uint64_t* offset) override;
+
+  size_t Read(uint64_t addr, uint8_t* buffer, size_t bytes) override;
+
+  bool ReadWord(uint64_t ptr, word_t* out_value) override;
+
+ private:
+  // Deeper frames are still unwound, but read from the running thread.
+  static constexpr size_t kMaxStackSnapshotSize = 128 * 1024;
+
+  unwindstack::MemoryRemote memory_;
+};
+
 class UnwindStackOffline : public Backtrace {
  public:
   UnwindStackOffline(ArchEnum arch, pid_t pid, pid_t tid, BacktraceMap* map, bool map_shared);
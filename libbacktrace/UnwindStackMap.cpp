@@ -18,9 +18,14 @@
 #include <stdlib.h>
 #include <sys/types.h>
 
+#include <algorithm>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
+#include <android-base/file.h>
 #include <backtrace/BacktraceMap.h>
 #include <unwindstack/Elf.h>
 #include <unwindstack/MapInfo.h>
@@ -30,29 +35,101 @@
 #include "UnwindStackMap.h"
 
 //-------------------------------------------------------------------------
-UnwindStackMap::UnwindStackMap(pid_t pid) : BacktraceMap(pid) {}
+// Parsing the maps is cheap next to what the MapInfos load as they are
+// used: the Elf of every library an unwind goes through, and the jit and
+// dex state. So callers creating a map per request or per thread of the
+// same process share all of that for as long as its maps read the same.
+struct UnwindStackMap::ProcessState {
+  pid_t pid;
+  std::string maps_text;
+  std::unique_ptr<unwindstack::Maps> maps;
+  std::shared_ptr<unwindstack::Memory> process_memory;
+  std::unique_ptr<unwindstack::JitDebug> jit_debug;
+#if !defined(NO_LIBDEXFILE_SUPPORT)
+  std::unique_ptr<unwindstack::DexFiles> dex_files;
+#endif
+};
+
+// States stay alive as long as a map uses them, and the most recently built
+// ones a while longer, so that creating and deleting a map per request
+// still finds the state of the last one.
+static constexpr size_t kMaxRecentProcessStates = 8;
+
+static std::mutex g_process_states_lock;
+
+std::shared_ptr<UnwindStackMap::ProcessState> UnwindStackMap::GetProcessState(
+    pid_t pid, std::string&& maps_text) {
+  static auto& states = *new std::unordered_map<pid_t, std::weak_ptr<ProcessState>>;
+  static auto& recent = *new std::vector<std::shared_ptr<ProcessState>>;
+
+  {
+    std::lock_guard<std::mutex> guard(g_process_states_lock);
+    auto entry = states.find(pid);
+    if (entry != states.end()) {
+      std::shared_ptr<ProcessState> state = entry->second.lock();
+      if (state != nullptr && state->maps_text == maps_text) {
+        return state;
+      }
+    }
+  }
 
-bool UnwindStackMap::Build() {
-  if (pid_ == 0) {
-    pid_ = getpid();
-    stack_maps_.reset(new unwindstack::LocalMaps);
-  } else {
-    stack_maps_.reset(new unwindstack::RemoteMaps(pid_));
+  std::shared_ptr<ProcessState> state(new ProcessState);
+  state->pid = pid;
+  state->maps_text = std::move(maps_text);
+  state->maps.reset(new unwindstack::BufferMaps(state->maps_text.c_str()));
+  if (!state->maps->Parse()) {
+    return nullptr;
   }
 
   // Create the process memory object.
-  process_memory_ = unwindstack::Memory::CreateProcessMemory(pid_);
+  state->process_memory = unwindstack::Memory::CreateProcessMemory(pid);
 
   // Create a JitDebug object for getting jit unwind information.
   std::vector<std::string> search_libs_{"libart.so", "libartd.so"};
-  jit_debug_.reset(new unwindstack::JitDebug(process_memory_, search_libs_));
+  state->jit_debug.reset(new unwindstack::JitDebug(state->process_memory, search_libs_));
 #if !defined(NO_LIBDEXFILE_SUPPORT)
-  dex_files_.reset(new unwindstack::DexFiles(process_memory_, search_libs_));
+  state->dex_files.reset(new unwindstack::DexFiles(state->process_memory, search_libs_));
 #endif
 
-  if (!stack_maps_->Parse()) {
+  std::lock_guard<std::mutex> guard(g_process_states_lock);
+  for (auto it = states.begin(); it != states.end();) {
+    it = it->second.expired() ? states.erase(it) : std::next(it);
+  }
+  states[pid] = state;
+  recent.erase(std::remove_if(recent.begin(), recent.end(),
+                              [pid](const std::shared_ptr<ProcessState>& other) {
+                                return other->pid == pid;
+                              }),
+               recent.end());
+  recent.push_back(state);
+  if (recent.size() > kMaxRecentProcessStates) {
+    recent.erase(recent.begin());
+  }
+  return state;
+}
+
+UnwindStackMap::UnwindStackMap(pid_t pid) : BacktraceMap(pid) {}
+
+bool UnwindStackMap::Build() {
+  if (pid_ == 0) {
+    pid_ = getpid();
+  }
+
+  std::string maps_text;
+  if (!android::base::ReadFileToString("/proc/" + std::to_string(pid_) + "/maps", &maps_text)) {
+    return false;
+  }
+  std::shared_ptr<ProcessState> state = GetProcessState(pid_, std::move(maps_text));
+  if (state == nullptr) {
     return false;
   }
+  // Keep the state alive through each of the objects handed out.
+  stack_maps_ = std::shared_ptr<unwindstack::Maps>(state, state->maps.get());
+  process_memory_ = state->process_memory;
+  jit_debug_ = std::shared_ptr<unwindstack::JitDebug>(state, state->jit_debug.get());
+#if !defined(NO_LIBDEXFILE_SUPPORT)
+  dex_files_ = std::shared_ptr<unwindstack::DexFiles>(state, state->dex_files.get());
+#endif
 
   // Iterate through the maps and fill in the backtrace_map_t structure.
   for (auto* map_info : *stack_maps_) {
@@ -22,6 +22,7 @@
 
 #include <memory>
 #include <mutex>
+#include <string>
 #include <unordered_map>
 #include <vector>
 
@@ -64,11 +65,15 @@ class UnwindStackMap : public BacktraceMap {
  protected:
   uint64_t GetLoadBias(size_t index) override;
 
-  std::unique_ptr<unwindstack::Maps> stack_maps_;
+  // Shared by the maps of a process built while its maps file reads the same.
+  struct ProcessState;
+  static std::shared_ptr<ProcessState> GetProcessState(pid_t pid, std::string&& maps_text);
+
+  std::shared_ptr<unwindstack::Maps> stack_maps_;
   std::shared_ptr<unwindstack::Memory> process_memory_;
-  std::unique_ptr<unwindstack::JitDebug> jit_debug_;
+  std::shared_ptr<unwindstack::JitDebug> jit_debug_;
 #if !defined(NO_LIBDEXFILE_SUPPORT)
-  std::unique_ptr<unwindstack::DexFiles> dex_files_;
+  std::shared_ptr<unwindstack::DexFiles> dex_files_;
 #endif
 
   unwindstack::ArchEnum arch_ = unwindstack::ARCH_UNKNOWN;
@@ -24,6 +24,7 @@
 #include <sys/wait.h>
 #include <unistd.h>
 
+#include <memory>
 #include <string>
 
 #include <android-base/file.h>
@@ -163,4 +164,16 @@ static void BM_create_backtrace(benchmark::State& state) {
 }
 BENCHMARK(BM_create_backtrace);
 
+// A new map for every backtrace, as callers taking one backtrace per request
+// do. Maps of a process share what they load while its maps read the same.
+static void BM_create_map_and_backtrace(benchmark::State& state) {
+  while (state.KeepRunning()) {
+    std::unique_ptr<BacktraceMap> backtrace_map(BacktraceMap::Create(getpid()));
+    std::unique_ptr<Backtrace> backtrace(
+        Backtrace::Create(getpid(), android::base::GetThreadId(), backtrace_map.get()));
+    backtrace->Unwind(0);
+  }
+}
+BENCHMARK(BM_create_map_and_backtrace);
+
 BENCHMARK_MAIN();
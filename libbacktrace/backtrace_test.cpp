@@ -449,6 +449,45 @@ TEST_F(BacktraceTest, ptrace_max_trace) {
   ASSERT_EQ(waitpid(pid, &status, 0), pid);
 }
 
+TEST_F(BacktraceTest, sample_trace) {
+  pid_t pid;
+  if ((pid = fork()) == 0) {
+    ASSERT_NE(test_level_one_(1, 2, 3, 4, nullptr, nullptr), 0);
+    _exit(1);
+  }
+
+  // The caller does not attach, the sample stops the process by itself.
+  uint64_t start = NanoTime();
+  bool verified = false;
+  std::string last_dump;
+  std::unique_ptr<BacktraceMap> map(BacktraceMap::Create(pid, false));
+  ASSERT_TRUE(map.get() != nullptr);
+  do {
+    usleep(US_PER_MSEC);
+    std::unique_ptr<Backtrace> backtrace(
+        Backtrace::CreateSample(pid, BACKTRACE_CURRENT_THREAD, map.get()));
+    ASSERT_TRUE(backtrace.get() != nullptr);
+    ASSERT_TRUE(backtrace->Unwind(0));
+    if (ReadyLevelBacktrace(backtrace.get())) {
+      VerifyLevelDump(backtrace.get());
+      verified = true;
+    } else {
+      last_dump = DumpFrames(backtrace.get());
+    }
+  } while (!verified && (NanoTime() - start) <= 5 * NS_PER_SEC);
+  ASSERT_TRUE(verified) << "Last backtrace:\n" << last_dump;
+
+  // The process is left running once the sample is done.
+  ASSERT_EQ(0, waitpid(pid, nullptr, WNOHANG));
+  kill(pid, SIGKILL);
+  int status;
+  ASSERT_EQ(waitpid(pid, &status, 0), pid);
+}
+
+TEST_F(BacktraceTest, sample_current_process) {
+  ASSERT_TRUE(Backtrace::CreateSample(getpid(), BACKTRACE_CURRENT_THREAD) == nullptr);
+}
+
 static void VerifyProcessIgnoreFrames(Backtrace* bt_all, create_func_t create_func,
                                       map_create_func_t map_create_func) {
   std::unique_ptr<BacktraceMap> map(map_create_func(bt_all->Pid(), false));
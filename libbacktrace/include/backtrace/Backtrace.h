@@ -111,6 +111,8 @@ class Backtrace {
   };
 
   static void SetGlobalElfCache(bool enable);
+  // See unwindstack::Elf::SetDiskCacheDirectory().
+  static void SetGlobalElfDiskCache(const std::string& directory);
 
   // Create the correct Backtrace object based on what is to be unwound.
   // If pid < 0 or equals the current pid, then the Backtrace object
@@ -124,6 +126,15 @@ class Backtrace {
   // If map is not NULL, the map is still owned by the caller.
   static Backtrace* Create(pid_t pid, pid_t tid, BacktraceMap* map = nullptr);
 
+  // Create a Backtrace object for a thread of a different process that the
+  // caller is not ptrace attached to, meant for periodically sampling a live
+  // process. Each unwind stops the thread only long enough to read its
+  // registers and copy the top of its stack with process_vm_readv, then lets
+  // it run again before unwinding from the copy. The rest of the unwind reads
+  // the running process, so frames below the copied stack may be inconsistent.
+  // Returns NULL if pid is the current process.
+  static Backtrace* CreateSample(pid_t pid, pid_t tid, BacktraceMap* map = nullptr);
+
   // Create an offline Backtrace object that can be used to do an unwind without a process
   // that is still running. By default, information is only cached in the map
   // file. If the calling code creates the map, data can be cached between
@@ -26,17 +26,111 @@
 #include <errno.h>
 #include <fcntl.h>
 #include <linux/ashmem.h>
+#include <linux/memfd.h>
 #include <pthread.h>
 #include <string.h>
 #include <sys/ioctl.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
+#include <sys/syscall.h>
 #include <sys/sysmacros.h>
 #include <sys/types.h>
 #include <unistd.h>
+#include <cutils/properties.h>
 #include <log/log.h>
 
 #define ASHMEM_DEVICE "/dev/ashmem"
 
+#ifndef F_SEAL_FUTURE_WRITE
+#define F_SEAL_FUTURE_WRITE 0x0010
+#endif
+
+/*
+ * memfd regions are opt-in with sys.use_memfd, and used only if the kernel
+ * can make them read-only once mapped writable, like ASHMEM_SET_PROT_MASK
+ * (F_SEAL_FUTURE_WRITE, Linux 5.1). Creating one is a single syscall instead
+ * of an open and two ioctls on /dev/ashmem.
+ */
+static pthread_once_t __memfd_once = PTHREAD_ONCE_INIT;
+static bool __memfd_supported;
+
+static int __memfd_create(const char* name, unsigned int flags)
+{
+#if defined(__NR_memfd_create)
+    return syscall(__NR_memfd_create, name, flags);
+#else
+    errno = ENOSYS;
+    return -1;
+#endif
+}
+
+static void __memfd_check_support()
+{
+    if (!property_get_bool("sys.use_memfd", false)) {
+        return;
+    }
+
+    int fd = __memfd_create("memfd_test", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    if (fd < 0) {
+        ALOGI("memfd_create failed (%s), using ashmem", strerror(errno));
+        return;
+    }
+    if (TEMP_FAILURE_RETRY(fcntl(fd, F_ADD_SEALS, F_SEAL_FUTURE_WRITE)) < 0) {
+        ALOGI("F_SEAL_FUTURE_WRITE unsupported (%s), using ashmem", strerror(errno));
+    } else {
+        __memfd_supported = true;
+    }
+    close(fd);
+}
+
+static bool __has_memfd_support()
+{
+    pthread_once(&__memfd_once, __memfd_check_support);
+    return __memfd_supported;
+}
+
+/* Only shmem files, which memfds are, have seals. */
+static bool __is_memfd(int fd)
+{
+    return __has_memfd_support() && TEMP_FAILURE_RETRY(fcntl(fd, F_GET_SEALS)) >= 0;
+}
+
+static int __memfd_create_region(const char* name, size_t size)
+{
+    int fd = __memfd_create(name ? name : "ashmem", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    if (fd < 0) {
+        return fd;
+    }
+
+    /* ashmem regions can't be resized once created either. */
+    if (TEMP_FAILURE_RETRY(ftruncate(fd, size)) < 0 ||
+        TEMP_FAILURE_RETRY(fcntl(fd, F_ADD_SEALS, F_SEAL_GROW | F_SEAL_SHRINK)) < 0) {
+        int save_errno = errno;
+        close(fd);
+        errno = save_errno;
+        return -1;
+    }
+    return fd;
+}
+
+static int __memfd_set_prot_region(int fd, int prot)
+{
+    int seals = TEMP_FAILURE_RETRY(fcntl(fd, F_GET_SEALS));
+    if (seals < 0) {
+        return -1;
+    }
+
+    if (prot & PROT_WRITE) {
+        /* Like ashmem, write access can't be given back once it is taken away. */
+        if (seals & F_SEAL_FUTURE_WRITE) {
+            errno = EINVAL;
+            return -1;
+        }
+        return 0;
+    }
+    return TEMP_FAILURE_RETRY(fcntl(fd, F_ADD_SEALS, F_SEAL_FUTURE_WRITE));
+}
+
 /* ashmem identity */
 static dev_t __ashmem_rdev;
 /*
@@ -143,6 +237,9 @@ static int __ashmem_check_failure(int fd, int result)
 
 int ashmem_valid(int fd)
 {
+    if (__is_memfd(fd)) {
+        return 1;
+    }
     return __ashmem_is_ashmem(fd, 0) >= 0;
 }
 
@@ -157,6 +254,10 @@ int ashmem_create_region(const char *name, size_t size)
 {
     int ret, save_errno;
 
+    if (__has_memfd_support()) {
+        return __memfd_create_region(name, size);
+    }
+
     int fd = __ashmem_open();
     if (fd < 0) {
         return fd;
@@ -188,11 +289,20 @@ error:
 
 int ashmem_set_prot_region(int fd, int prot)
 {
+    if (__is_memfd(fd)) {
+        return __memfd_set_prot_region(fd, prot);
+    }
+
     return __ashmem_check_failure(fd, TEMP_FAILURE_RETRY(ioctl(fd, ASHMEM_SET_PROT_MASK, prot)));
 }
 
 int ashmem_pin_region(int fd, size_t offset, size_t len)
 {
+    /* memfd pages are never purged, so they are always pinned. */
+    if (__is_memfd(fd)) {
+        return ASHMEM_NOT_PURGED;
+    }
+
     // TODO: should LP64 reject too-large offset/len?
     ashmem_pin pin = { static_cast<uint32_t>(offset), static_cast<uint32_t>(len) };
 
@@ -201,6 +311,10 @@ int ashmem_pin_region(int fd, size_t offset, size_t len)
 
 int ashmem_unpin_region(int fd, size_t offset, size_t len)
 {
+    if (__is_memfd(fd)) {
+        return ASHMEM_IS_UNPINNED;
+    }
+
     // TODO: should LP64 reject too-large offset/len?
     ashmem_pin pin = { static_cast<uint32_t>(offset), static_cast<uint32_t>(len) };
 
@@ -209,5 +323,13 @@ int ashmem_unpin_region(int fd, size_t offset, size_t len)
 
 int ashmem_get_size_region(int fd)
 {
+    if (__is_memfd(fd)) {
+        struct stat st;
+        if (TEMP_FAILURE_RETRY(fstat(fd, &st)) < 0) {
+            return -1;
+        }
+        return st.st_size;
+    }
+
     return __ashmem_check_failure(fd, TEMP_FAILURE_RETRY(ioctl(fd, ASHMEM_GET_SIZE, NULL)));
 }
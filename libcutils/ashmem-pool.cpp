@@ -0,0 +1,217 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <cutils/ashmem.h>
+
+/*
+ * Sub-allocator over ashmem_create_region, see cutils/ashmem.h.
+ */
+#define LOG_TAG "ashmem"
+
+#include <errno.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <log/log.h>
+
+static constexpr size_t kAlignment = 64;
+static constexpr size_t kMinHeapSize = 64 * 1024;
+static constexpr size_t kMaxHeapSize = 1024 * 1024;
+static constexpr size_t kMaxPooledSize = kMaxHeapSize / 4;
+
+static size_t round_up(size_t size, size_t alignment) {
+    return (size + alignment - 1) & ~(alignment - 1);
+}
+
+namespace {
+
+// One backing region, mapped once for all of its allocations.
+struct Heap {
+    Heap(int fd, void* base, size_t size, bool dedicated)
+        : fd(fd), base(base), size(size), used(0), dedicated(dedicated) {
+        if (!dedicated) free_ranges[0] = size;
+    }
+    ~Heap() {
+        munmap(base, size);
+        close(fd);
+    }
+
+    // Takes |size| bytes from the first free range that fits. Returns the
+    // offset, or -1 if nothing fits.
+    ssize_t Take(size_t size);
+    void Give(size_t offset, size_t size);
+
+    int fd;
+    void* base;
+    size_t size;
+    size_t used;
+    bool dedicated;
+    // Offset to length, with adjacent ranges merged.
+    std::map<size_t, size_t> free_ranges;
+};
+
+ssize_t Heap::Take(size_t size) {
+    for (auto it = free_ranges.begin(); it != free_ranges.end(); ++it) {
+        if (it->second < size) continue;
+        size_t offset = it->first;
+        size_t remaining = it->second - size;
+        free_ranges.erase(it);
+        if (remaining) free_ranges[offset + size] = remaining;
+        used += size;
+        return offset;
+    }
+    return -1;
+}
+
+void Heap::Give(size_t offset, size_t size) {
+    used -= size;
+    auto next = free_ranges.lower_bound(offset);
+    if (next != free_ranges.end() && offset + size == next->first) {
+        size += next->second;
+        next = free_ranges.erase(next);
+    }
+    if (next != free_ranges.begin()) {
+        auto prev = std::prev(next);
+        if (prev->first + prev->second == offset) {
+            offset = prev->first;
+            size += prev->second;
+        }
+    }
+    free_ranges[offset] = size;
+
+    // Give the whole pages of the free range back to the kernel; they read
+    // back as zeros.
+    size_t page_size = getpagesize();
+    size_t start = round_up(offset, page_size);
+    size_t end = (offset + size) & ~(page_size - 1);
+    if (end > start) {
+        madvise(static_cast<char*>(base) + start, end - start, MADV_REMOVE);
+    }
+}
+
+}  // namespace
+
+struct ashmem_pool {
+    std::string name;
+    std::mutex lock;
+    std::vector<std::unique_ptr<Heap>> heaps;
+    size_t next_heap_size = kMinHeapSize;
+};
+
+static std::unique_ptr<Heap> create_heap(const char* name, size_t size, bool dedicated) {
+    int fd = ashmem_create_region(name, size);
+    if (fd < 0) return nullptr;
+    void* base = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (base == MAP_FAILED) {
+        int save_errno = errno;
+        close(fd);
+        errno = save_errno;
+        return nullptr;
+    }
+    return std::make_unique<Heap>(fd, base, size, dedicated);
+}
+
+static void fill_region(const Heap& heap, size_t offset, size_t size,
+                        struct ashmem_pool_region* region) {
+    region->fd = heap.fd;
+    region->offset = offset;
+    region->size = size;
+    region->data = static_cast<char*>(heap.base) + offset;
+}
+
+struct ashmem_pool* ashmem_pool_create(const char* name) {
+    ashmem_pool* pool = new ashmem_pool;
+    if (name) pool->name = name;
+    return pool;
+}
+
+void ashmem_pool_destroy(struct ashmem_pool* pool) {
+    delete pool;
+}
+
+int ashmem_pool_alloc(struct ashmem_pool* pool, size_t size, struct ashmem_pool_region* region) {
+    if (size == 0) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    if (size > kMaxPooledSize) {
+        std::unique_ptr<Heap> heap =
+                create_heap(pool->name.c_str(), round_up(size, getpagesize()), true);
+        if (!heap) return -1;
+        fill_region(*heap, 0, size, region);
+        std::lock_guard<std::mutex> lock(pool->lock);
+        pool->heaps.push_back(std::move(heap));
+        return 0;
+    }
+
+    size_t aligned_size = round_up(size, kAlignment);
+    std::lock_guard<std::mutex> lock(pool->lock);
+    // The newest heaps are the largest, and the likeliest to have room.
+    for (auto it = pool->heaps.rbegin(); it != pool->heaps.rend(); ++it) {
+        Heap& heap = **it;
+        if (heap.dedicated) continue;
+        ssize_t offset = heap.Take(aligned_size);
+        if (offset < 0) continue;
+        fill_region(heap, offset, size, region);
+        memset(region->data, 0, size);
+        return 0;
+    }
+
+    size_t heap_size = pool->next_heap_size;
+    while (heap_size < aligned_size) heap_size *= 2;
+    std::unique_ptr<Heap> heap = create_heap(pool->name.c_str(), heap_size, false);
+    if (!heap) return -1;
+    pool->next_heap_size = std::min(heap_size * 2, kMaxHeapSize);
+    fill_region(*heap, heap->Take(aligned_size), size, region);
+    pool->heaps.push_back(std::move(heap));
+    return 0;
+}
+
+void ashmem_pool_free(struct ashmem_pool* pool, const struct ashmem_pool_region* region) {
+    std::lock_guard<std::mutex> lock(pool->lock);
+    auto it = std::find_if(pool->heaps.begin(), pool->heaps.end(),
+                           [region](const std::unique_ptr<Heap>& heap) {
+                               return heap->fd == region->fd;
+                           });
+    if (it == pool->heaps.end()) {
+        ALOGE("ashmem_pool_free: fd %d is not from this pool", region->fd);
+        return;
+    }
+
+    Heap& heap = **it;
+    if (!heap.dedicated) {
+        heap.Give(region->offset, round_up(region->size, kAlignment));
+        if (heap.used != 0) return;
+        // Keep one empty heap around, so that a pool that is drained and
+        // refilled doesn't create a region every time.
+        size_t shared_heaps = std::count_if(pool->heaps.begin(), pool->heaps.end(),
+                                            [](const std::unique_ptr<Heap>& heap) {
+                                                return !heap->dedicated;
+                                            });
+        if (shared_heaps == 1) return;
+    }
+    pool->heaps.erase(it);
+}
@@ -31,6 +31,14 @@
 #include <sys/stat.h>
 #include <sys/types.h>
 
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <string>
+#include <vector>
+
 #include <log/log.h>
 #include <private/android_filesystem_config.h>
 #include <utils/Compat.h>
@@ -270,7 +278,9 @@ static inline bool prefix_cmp(bool partial, const char* prefix, size_t len, cons
 
 // alias prefixes of "<partition>/<stuff>" to "system/<partition>/<stuff>" or
 // "system/<partition>/<stuff>" to "<partition>/<stuff>"
-static bool fs_config_cmp(bool partial, const char* prefix, size_t len, const char* path,
+//
+// This is the reference for FsConfigTrie below, which is what fs_config() uses.
+__attribute__((unused)) static bool fs_config_cmp(bool partial, const char* prefix, size_t len, const char* path,
                           size_t plen) {
     // If name ends in * then allow partial matches.
     if (!partial && prefix[len - 1] == '*') {
@@ -298,66 +308,211 @@ static bool fs_config_cmp(bool partial, const char* prefix, size_t len, const ch
 auto __for_testing_only__fs_config_cmp = fs_config_cmp;
 #endif
 
-void fs_config(const char* path, int dir, const char* target_out_path, unsigned* uid, unsigned* gid,
-               unsigned* mode, uint64_t* capabilities) {
-    const struct fs_path_config* pc;
-    size_t which, plen;
+namespace {
+
+// Index over one rule table. Find() returns the same rule as scanning the
+// table in order with fs_config_cmp(), but walks the path once instead of
+// comparing it against every rule. Image builds call fs_config() for every
+// file, so this matters for partitions with many files.
+class FsConfigTrie {
+  public:
+    static constexpr size_t kNoMatch = SIZE_MAX;
+
+    void Add(bool dir, const char* prefix, size_t index) {
+        size_t len = strlen(prefix);
+        bool partial = dir;
+        // If name ends in * then allow partial matches.
+        if (!partial && len > 0 && prefix[len - 1] == '*') {
+            len--;
+            partial = true;
+        }
+        Insert(std::string(prefix, len), partial, index);
+
+        // The aliases fs_config_cmp() allows between "<partition>/<stuff>"
+        // and "system/<partition>/<stuff>".
+        static const char system[] = "system/";
+        const size_t system_len = strlen(system);
+        if (is_partition(prefix, len)) {
+            Insert(system + std::string(prefix, len), partial, index);
+        } else if (len > system_len && !strncmp(prefix, system, system_len) &&
+                   is_partition(prefix + system_len, len - system_len)) {
+            Insert(std::string(prefix + system_len, len - system_len), partial, index);
+        }
+    }
 
-    if (path[0] == '/') {
-        path++;
+    // Returns the index of the first rule added that matches path, or kNoMatch.
+    size_t Find(const char* path, size_t plen) const {
+        size_t best = kNoMatch;
+        const Node* node = &nodes_[0];
+        for (size_t depth = 0;; ++depth) {
+            best = std::min(best, node->partial);
+            if (depth == plen) {
+                return std::min(best, node->exact);
+            }
+            auto it = node->children.find(path[depth]);
+            if (it == node->children.end()) {
+                return best;
+            }
+            node = &nodes_[it->second];
+        }
     }
 
-    plen = strlen(path);
+  private:
+    struct Node {
+        std::map<char, size_t> children;
+        // First rule matching paths that begin with, or are equal to, this node.
+        size_t partial = kNoMatch;
+        size_t exact = kNoMatch;
+    };
+
+    void Insert(const std::string& key, bool partial, size_t index) {
+        size_t node = 0;
+        for (char c : key) {
+            auto it = nodes_[node].children.find(c);
+            if (it != nodes_[node].children.end()) {
+                node = it->second;
+                continue;
+            }
+            nodes_.emplace_back();
+            nodes_[node].children[c] = nodes_.size() - 1;
+            node = nodes_.size() - 1;
+        }
+        size_t& slot = partial ? nodes_[node].partial : nodes_[node].exact;
+        slot = std::min(slot, index);
+    }
 
-    for (which = 0; which < (sizeof(conf) / sizeof(conf[0])); ++which) {
-        struct fs_path_config_from_file header;
+    std::vector<Node> nodes_{1};
+};
 
-        int fd = fs_config_open(dir, which, target_out_path);
-        if (fd < 0) continue;
+// The rules from one fs_config_(dirs|files) file, kept until the file changes.
+struct FsConfigFile {
+    bool loaded = false;
+    struct stat st;
+    std::vector<fs_path_config> rules;
+    std::vector<std::unique_ptr<char[]>> prefixes;
+    FsConfigTrie trie;
+};
 
-        while (TEMP_FAILURE_RETRY(read(fd, &header, sizeof(header))) == sizeof(header)) {
-            char* prefix;
-            uint16_t host_len = get2LE((const uint8_t*)&header.len);
-            ssize_t len, remainder = host_len - sizeof(header);
-            if (remainder <= 0) {
-                ALOGE("%s len is corrupted", conf[which][dir]);
-                break;
-            }
-            prefix = static_cast<char*>(calloc(1, remainder));
-            if (!prefix) {
-                ALOGE("%s out of memory", conf[which][dir]);
-                break;
-            }
-            if (TEMP_FAILURE_RETRY(read(fd, prefix, remainder)) != remainder) {
-                free(prefix);
-                ALOGE("%s prefix is truncated", conf[which][dir]);
-                break;
-            }
-            len = strnlen(prefix, remainder);
-            if (len >= remainder) {  // missing a terminating null
-                free(prefix);
-                ALOGE("%s is corrupted", conf[which][dir]);
-                break;
-            }
-            if (fs_config_cmp(dir, prefix, len, path, plen)) {
-                free(prefix);
-                close(fd);
-                *uid = get2LE((const uint8_t*)&(header.uid));
-                *gid = get2LE((const uint8_t*)&(header.gid));
-                *mode = (*mode & (~07777)) | get2LE((const uint8_t*)&(header.mode));
-                *capabilities = get8LE((const uint8_t*)&(header.capabilities));
-                return;
-            }
-            free(prefix);
+bool same_file(const struct stat& a, const struct stat& b) {
+    return a.st_dev == b.st_dev && a.st_ino == b.st_ino && a.st_size == b.st_size &&
+           a.st_mtime == b.st_mtime;
+}
+
+void fs_config_load(int fd, const char* conf_name, int dir, FsConfigFile* file) {
+    struct fs_path_config_from_file header;
+    while (TEMP_FAILURE_RETRY(read(fd, &header, sizeof(header))) == sizeof(header)) {
+        uint16_t host_len = get2LE((const uint8_t*)&header.len);
+        ssize_t len, remainder = host_len - sizeof(header);
+        if (remainder <= 0) {
+            ALOGE("%s len is corrupted", conf_name);
+            break;
+        }
+        std::unique_ptr<char[]> prefix(new (std::nothrow) char[remainder]());
+        if (!prefix) {
+            ALOGE("%s out of memory", conf_name);
+            break;
+        }
+        if (TEMP_FAILURE_RETRY(read(fd, prefix.get(), remainder)) != remainder) {
+            ALOGE("%s prefix is truncated", conf_name);
+            break;
         }
+        len = strnlen(prefix.get(), remainder);
+        if (len >= remainder) {  // missing a terminating null
+            ALOGE("%s is corrupted", conf_name);
+            break;
+        }
+        file->trie.Add(dir, prefix.get(), file->rules.size());
+        file->rules.push_back({get2LE((const uint8_t*)&(header.mode)),
+                               get2LE((const uint8_t*)&(header.uid)),
+                               get2LE((const uint8_t*)&(header.gid)),
+                               get8LE((const uint8_t*)&(header.capabilities)), prefix.get()});
+        file->prefixes.push_back(std::move(prefix));
+    }
+}
+
+std::mutex fs_config_files_lock;
+
+// Looks path up in conf[which][dir], parsing the file only when it is seen
+// for the first time or has changed since.
+bool fs_config_find_in_file(int dir, size_t which, const char* target_out_path, const char* path,
+                            size_t plen, fs_path_config* out) {
+    static std::map<std::string, FsConfigFile>* files = new std::map<std::string, FsConfigFile>;
+
+    int fd = fs_config_open(dir, which, target_out_path);
+    if (fd < 0) return false;
+
+    struct stat st;
+    if (fstat(fd, &st) < 0) {
         close(fd);
+        return false;
+    }
+    std::string key = std::string(target_out_path ? target_out_path : "") + '\0' +
+                      conf[which][dir];
+
+    std::lock_guard<std::mutex> lock(fs_config_files_lock);
+    FsConfigFile& file = (*files)[key];
+    if (!file.loaded || !same_file(file.st, st)) {
+        file = FsConfigFile();
+        file.loaded = true;
+        file.st = st;
+        fs_config_load(fd, conf[which][dir], dir, &file);
     }
+    close(fd);
+
+    size_t index = file.trie.Find(path, plen);
+    if (index == FsConfigTrie::kNoMatch) return false;
+    *out = file.rules[index];
+    return true;
+}
+
+const fs_path_config* fs_config_find_builtin(int dir, const char* path, size_t plen) {
+    static const FsConfigTrie* tries[2] = {};
+    static std::once_flag once;
+    std::call_once(once, [] {
+        for (int d = 0; d < 2; ++d) {
+            auto trie = new FsConfigTrie;
+            const fs_path_config* pc = d ? android_dirs : android_files;
+            for (size_t i = 0; pc[i].prefix; ++i) {
+                trie->Add(d, pc[i].prefix, i);
+            }
+            tries[d] = trie;
+        }
+    });
 
-    for (pc = dir ? android_dirs : android_files; pc->prefix; pc++) {
-        if (fs_config_cmp(dir, pc->prefix, strlen(pc->prefix), path, plen)) {
+    const fs_path_config* table = dir ? android_dirs : android_files;
+    size_t index = tries[!!dir]->Find(path, plen);
+    if (index != FsConfigTrie::kNoMatch) return &table[index];
+
+    // The null-prefixed default at the end of the table.
+    while (table->prefix) table++;
+    return table;
+}
+
+}  // namespace
+#ifndef __ANDROID_VNDK__
+const fs_path_config* (*__for_testing_only__fs_config_find_builtin)(int, const char*, size_t) =
+        fs_config_find_builtin;
+#endif
+
+void fs_config(const char* path, int dir, const char* target_out_path, unsigned* uid, unsigned* gid,
+               unsigned* mode, uint64_t* capabilities) {
+    if (path[0] == '/') {
+        path++;
+    }
+
+    size_t plen = strlen(path);
+
+    fs_path_config rule;
+    const fs_path_config* pc = nullptr;
+    for (size_t which = 0; which < (sizeof(conf) / sizeof(conf[0])); ++which) {
+        if (fs_config_find_in_file(dir, which, target_out_path, path, plen, &rule)) {
+            pc = &rule;
             break;
         }
     }
+    if (!pc) {
+        pc = fs_config_find_builtin(dir, path, plen);
+    }
     *uid = pc->uid;
     *gid = pc->gid;
     *mode = (*mode & (~07777)) | pc->mode;
@@ -19,27 +19,48 @@
 #include <assert.h>
 #include <errno.h>
 #include <pthread.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/types.h>
 
+// Open addressing with linear probing: entries live directly in one array,
+// so puts don't allocate and lookups walk adjacent memory instead of chasing
+// a linked list per bucket.
+//
+// Removed entries become tombstones rather than being shifted back, because
+// callers such as str_parms remove entries from inside hashmapForEach(), and
+// moving entries behind the iterator would make it skip them.
+enum EntryState : uint8_t {
+    kEmpty = 0,
+    kFull,
+    kTombstone,
+};
+
 typedef struct Entry Entry;
 struct Entry {
     void* key;
-    int hash;
     void* value;
-    Entry* next;
+    int hash;
+    EntryState state;
 };
 
 struct Hashmap {
-    Entry** buckets;
-    size_t bucketCount;
+    Entry* entries;
+    size_t capacity;
     int (*hash)(void* key);
     bool (*equals)(void* keyA, void* keyB);
     pthread_mutex_t lock;
     size_t size;
+    // Full entries plus tombstones; bounds the length of any probe sequence.
+    size_t used;
 };
 
+// 0.75 load factor, counting tombstones.
+static inline bool overLoaded(size_t used, size_t capacity) {
+    return used > capacity * 3 / 4;
+}
+
 Hashmap* hashmapCreate(size_t initialCapacity,
         int (*hash)(void* key), bool (*equals)(void* keyA, void* keyB)) {
     assert(hash != NULL);
@@ -51,20 +72,21 @@ Hashmap* hashmapCreate(size_t initialCapacity,
     }
 
     // 0.75 load factor.
-    size_t minimumBucketCount = initialCapacity * 4 / 3;
-    map->bucketCount = 1;
-    while (map->bucketCount <= minimumBucketCount) {
-        // Bucket count must be power of 2.
-        map->bucketCount <<= 1;
+    size_t minimumCapacity = initialCapacity * 4 / 3;
+    map->capacity = 2;
+    while (map->capacity <= minimumCapacity) {
+        // Capacity must be power of 2.
+        map->capacity <<= 1;
     }
 
-    map->buckets = static_cast<Entry**>(calloc(map->bucketCount, sizeof(Entry*)));
-    if (map->buckets == NULL) {
+    map->entries = static_cast<Entry*>(calloc(map->capacity, sizeof(Entry)));
+    if (map->entries == NULL) {
         free(map);
         return NULL;
     }
 
     map->size = 0;
+    map->used = 0;
 
     map->hash = hash;
     map->equals = equals;
@@ -93,39 +115,51 @@ static inline int hashKey(Hashmap* map, void* key) {
     return h;
 }
 
-static inline size_t calculateIndex(size_t bucketCount, int hash) {
-    return ((size_t) hash) & (bucketCount - 1);
+static inline size_t calculateIndex(size_t capacity, int hash) {
+    return ((size_t) hash) & (capacity - 1);
 }
 
-static void expandIfNecessary(Hashmap* map) {
-    // If the load factor exceeds 0.75...
-    if (map->size > (map->bucketCount * 3 / 4)) {
-        // Start off with a 0.33 load factor.
-        size_t newBucketCount = map->bucketCount << 1;
-        Entry** newBuckets = static_cast<Entry**>(calloc(newBucketCount, sizeof(Entry*)));
-        if (newBuckets == NULL) {
-            // Abort expansion.
-            return;
-        }
+// Rebuilds the table with the given capacity, which also drops tombstones.
+static bool rehash(Hashmap* map, size_t newCapacity) {
+    Entry* newEntries = static_cast<Entry*>(calloc(newCapacity, sizeof(Entry)));
+    if (newEntries == NULL) {
+        return false;
+    }
 
-        // Move over existing entries.
-        size_t i;
-        for (i = 0; i < map->bucketCount; i++) {
-            Entry* entry = map->buckets[i];
-            while (entry != NULL) {
-                Entry* next = entry->next;
-                size_t index = calculateIndex(newBucketCount, entry->hash);
-                entry->next = newBuckets[index];
-                newBuckets[index] = entry;
-                entry = next;
-            }
+    for (size_t i = 0; i < map->capacity; i++) {
+        const Entry& entry = map->entries[i];
+        if (entry.state != kFull) continue;
+        size_t index = calculateIndex(newCapacity, entry.hash);
+        while (newEntries[index].state != kEmpty) {
+            index = (index + 1) & (newCapacity - 1);
         }
+        newEntries[index] = entry;
+    }
 
-        // Copy over internals.
-        free(map->buckets);
-        map->buckets = newBuckets;
-        map->bucketCount = newBucketCount;
+    free(map->entries);
+    map->entries = newEntries;
+    map->capacity = newCapacity;
+    map->used = map->size;
+    return true;
+}
+
+// Makes room for one more entry. Returns false only if there is no room left.
+static bool expandIfNecessary(Hashmap* map) {
+    if (!overLoaded(map->used + 1, map->capacity)) {
+        return true;
     }
+    // Tombstones alone can push the load up. If clearing them leaves the
+    // table at most half full, keep the capacity rather than growing a table
+    // that doesn't hold more entries.
+    size_t newCapacity = map->capacity;
+    if (map->size + 1 > newCapacity / 2) {
+        newCapacity <<= 1;
+    }
+    if (rehash(map, newCapacity)) {
+        return true;
+    }
+    // Without an expansion, carry on as long as an empty slot is left to end probes.
+    return map->used + 1 < map->capacity;
 }
 
 void hashmapLock(Hashmap* map) {
@@ -137,16 +171,7 @@ void hashmapUnlock(Hashmap* map) {
 }
 
 void hashmapFree(Hashmap* map) {
-    size_t i;
-    for (i = 0; i < map->bucketCount; i++) {
-        Entry* entry = map->buckets[i];
-        while (entry != NULL) {
-            Entry* next = entry->next;
-            free(entry);
-            entry = next;
-        }
-    }
-    free(map->buckets);
+    free(map->entries);
     pthread_mutex_destroy(&map->lock);
     free(map);
 }
@@ -166,18 +191,6 @@ int hashmapHash(void* key, size_t keySize) {
     return h;
 }
 
-static Entry* createEntry(void* key, int hash, void* value) {
-    Entry* entry = static_cast<Entry*>(malloc(sizeof(Entry)));
-    if (entry == NULL) {
-        return NULL;
-    }
-    entry->key = key;
-    entry->hash = hash;
-    entry->value = value;
-    entry->next = NULL;
-    return entry;
-}
-
 static inline bool equalKeys(void* keyA, int hashA, void* keyB, int hashB,
         bool (*equals)(void*, void*)) {
     if (keyA == keyB) {
@@ -189,86 +202,77 @@ static inline bool equalKeys(void* keyA, int hashA, void* keyB, int hashB,
     return equals(keyA, keyB);
 }
 
-void* hashmapPut(Hashmap* map, void* key, void* value) {
-    int hash = hashKey(map, key);
-    size_t index = calculateIndex(map->bucketCount, hash);
-
-    Entry** p = &(map->buckets[index]);
+// Returns the full entry for key, or NULL. Tombstones are skipped without
+// looking at their keys, which the caller may already have freed.
+static Entry* findEntry(Hashmap* map, void* key, int hash) {
+    size_t index = calculateIndex(map->capacity, hash);
     while (true) {
-        Entry* current = *p;
-
-        // Add a new entry.
-        if (current == NULL) {
-            *p = createEntry(key, hash, value);
-            if (*p == NULL) {
-                errno = ENOMEM;
-                return NULL;
-            }
-            map->size++;
-            expandIfNecessary(map);
+        Entry* entry = &map->entries[index];
+        if (entry->state == kEmpty) {
             return NULL;
         }
-
-        // Replace existing entry.
-        if (equalKeys(current->key, current->hash, key, hash, map->equals)) {
-            void* oldValue = current->value;
-            current->value = value;
-            return oldValue;
+        if (entry->state == kFull && equalKeys(entry->key, entry->hash, key, hash, map->equals)) {
+            return entry;
         }
-
-        // Move to next entry.
-        p = &current->next;
+        index = (index + 1) & (map->capacity - 1);
     }
 }
 
-void* hashmapGet(Hashmap* map, void* key) {
+void* hashmapPut(Hashmap* map, void* key, void* value) {
     int hash = hashKey(map, key);
-    size_t index = calculateIndex(map->bucketCount, hash);
 
-    Entry* entry = map->buckets[index];
-    while (entry != NULL) {
-        if (equalKeys(entry->key, entry->hash, key, hash, map->equals)) {
-            return entry->value;
-        }
-        entry = entry->next;
+    // Replace existing entry.
+    Entry* entry = findEntry(map, key, hash);
+    if (entry != NULL) {
+        void* oldValue = entry->value;
+        entry->value = value;
+        return oldValue;
     }
 
+    // Add a new entry, reusing the first tombstone on the way if there is one.
+    if (!expandIfNecessary(map)) {
+        errno = ENOMEM;
+        return NULL;
+    }
+    size_t index = calculateIndex(map->capacity, hash);
+    while (map->entries[index].state == kFull) {
+        index = (index + 1) & (map->capacity - 1);
+    }
+    entry = &map->entries[index];
+    if (entry->state == kEmpty) {
+        map->used++;
+    }
+    entry->key = key;
+    entry->value = value;
+    entry->hash = hash;
+    entry->state = kFull;
+    map->size++;
     return NULL;
 }
 
-void* hashmapRemove(Hashmap* map, void* key) {
-    int hash = hashKey(map, key);
-    size_t index = calculateIndex(map->bucketCount, hash);
-
-    // Pointer to the current entry.
-    Entry** p = &(map->buckets[index]);
-    Entry* current;
-    while ((current = *p) != NULL) {
-        if (equalKeys(current->key, current->hash, key, hash, map->equals)) {
-            void* value = current->value;
-            *p = current->next;
-            free(current);
-            map->size--;
-            return value;
-        }
+void* hashmapGet(Hashmap* map, void* key) {
+    Entry* entry = findEntry(map, key, hashKey(map, key));
+    return entry != NULL ? entry->value : NULL;
+}
 
-        p = &current->next;
+void* hashmapRemove(Hashmap* map, void* key) {
+    Entry* entry = findEntry(map, key, hashKey(map, key));
+    if (entry == NULL) {
+        return NULL;
     }
-
-    return NULL;
+    void* value = entry->value;
+    entry->state = kTombstone;
+    map->size--;
+    return value;
 }
 
 void hashmapForEach(Hashmap* map, bool (*callback)(void* key, void* value, void* context),
                     void* context) {
-    size_t i;
-    for (i = 0; i < map->bucketCount; i++) {
-        Entry* entry = map->buckets[i];
-        while (entry != NULL) {
-            Entry *next = entry->next;
-            if (!callback(entry->key, entry->value, context)) {
-                return;
-            }
-            entry = next;
+    for (size_t i = 0; i < map->capacity; i++) {
+        Entry* entry = &map->entries[i];
+        if (entry->state != kFull) continue;
+        if (!callback(entry->key, entry->value, context)) {
+            return;
         }
     }
 }
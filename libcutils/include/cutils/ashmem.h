@@ -27,6 +27,38 @@ int ashmem_pin_region(int fd, size_t offset, size_t len);
 int ashmem_unpin_region(int fd, size_t offset, size_t len);
 int ashmem_get_size_region(int fd);
 
+/*
+ * A pool that carves small regions out of a few larger shared regions, for
+ * callers that create many small ones: most allocations then cost neither a
+ * new region nor a new mapping. The backing regions grow from 64KiB to 1MiB
+ * as the pool fills up, and are released once they are empty. Sizes above
+ * 256KiB get a region of their own.
+ *
+ * A region from the pool shares its fd with its neighbours, and whoever is
+ * sent the fd can map all of them: only use one pool for regions shared with
+ * the same peer, or with peers that may see each other's data. The offset of
+ * a region is only 64-byte aligned, so a peer has to map from the page below
+ * it.
+ *
+ * A pool is thread-safe.
+ */
+struct ashmem_pool;
+
+struct ashmem_pool_region {
+    int fd;         /* owned by the pool, and only valid until the region is freed */
+    size_t offset;  /* of the region in fd */
+    size_t size;
+    void* data;     /* zero-filled read-write mapping of the region in this process */
+};
+
+/* `name' labels the backing regions, as for ashmem_create_region. */
+struct ashmem_pool* ashmem_pool_create(const char* name);
+/* Frees the pool along with all regions still allocated from it. */
+void ashmem_pool_destroy(struct ashmem_pool* pool);
+/* Returns 0 on success, or <0 with errno set on error. */
+int ashmem_pool_alloc(struct ashmem_pool* pool, size_t size, struct ashmem_pool_region* region);
+void ashmem_pool_free(struct ashmem_pool* pool, const struct ashmem_pool_region* region);
+
 #ifdef __cplusplus
 }
 #endif
@@ -17,6 +17,7 @@
 #ifndef __CUTILS_STR_PARMS_H
 #define __CUTILS_STR_PARMS_H
 
+#include <stddef.h>
 #include <stdint.h>
 #include <sys/cdefs.h>
 
@@ -55,6 +56,54 @@ char *str_parms_to_str(struct str_parms *str_parms);
 /* debug */
 void str_parms_dump(struct str_parms *str_parms);
 
+/*
+ * A read-only alternative to str_parms_create_str() for parameter strings
+ * that only need to be queried. Keys and values are indexed in place in a
+ * single pass over the string, which must outlive the view; nothing is
+ * copied, and nothing is allocated unless the string has more than
+ * STR_PARMS_VIEW_INLINE_PAIRS pairs. Lookups give the same results as the
+ * str_parms_get_*() functions would, including the last value winning for
+ * repeated keys.
+ *
+ *     struct str_parms_view view;
+ *     if (str_parms_view_init(&view, kvpairs) == 0) {
+ *         int rate;
+ *         if (str_parms_view_get_int(&view, "sampling_rate", &rate) == 0) ...
+ *         str_parms_view_release(&view);
+ *     }
+ */
+#define STR_PARMS_VIEW_INLINE_PAIRS 8
+
+struct str_parms_view_pair {
+    const char *key;
+    size_t key_len;
+    const char *value;
+    size_t value_len;
+};
+
+struct str_parms_view {
+    size_t count;
+    // NULL while the pairs fit in inline_pairs.
+    struct str_parms_view_pair *heap_pairs;
+    size_t heap_capacity;
+    struct str_parms_view_pair inline_pairs[STR_PARMS_VIEW_INLINE_PAIRS];
+};
+
+// Returns 0, or -ENOMEM if the pairs didn't fit inline and couldn't be
+// allocated, in which case the view is left empty. Releasing it is safe
+// either way.
+int str_parms_view_init(struct str_parms_view *view, const char *string);
+void str_parms_view_release(struct str_parms_view *view);
+
+// Same contracts as the corresponding str_parms functions above.
+int str_parms_view_has_key(const struct str_parms_view *view, const char *key);
+int str_parms_view_get_str(const struct str_parms_view *view, const char *key,
+                           char *out_val, int len);
+int str_parms_view_get_int(const struct str_parms_view *view, const char *key,
+                           int *out_val);
+int str_parms_view_get_float(const struct str_parms_view *view, const char *key,
+                             float *out_val);
+
 __END_DECLS
 
 #endif /* __CUTILS_STR_PARMS_H */
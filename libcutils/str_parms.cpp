@@ -367,3 +367,141 @@ void str_parms_dump(struct str_parms *str_parms)
 {
     hashmapForEach(str_parms->map, dump_entry, str_parms);
 }
+
+static int str_parms_view_append(struct str_parms_view *view, const char *key,
+                                 size_t key_len, const char *value, size_t value_len)
+{
+    struct str_parms_view_pair *pairs = view->inline_pairs;
+    if (view->count >= STR_PARMS_VIEW_INLINE_PAIRS) {
+        if (view->count >= view->heap_capacity) {
+            size_t capacity = view->heap_capacity ? view->heap_capacity * 2
+                                                  : STR_PARMS_VIEW_INLINE_PAIRS * 2;
+            void *p = realloc(view->heap_pairs, capacity * sizeof(*pairs));
+            if (!p)
+                return -ENOMEM;
+            if (!view->heap_pairs)
+                memcpy(p, view->inline_pairs, sizeof(view->inline_pairs));
+            view->heap_pairs = static_cast<str_parms_view_pair*>(p);
+            view->heap_capacity = capacity;
+        }
+        pairs = view->heap_pairs;
+    }
+
+    pairs[view->count++] = {key, key_len, value, value_len};
+    return 0;
+}
+
+int str_parms_view_init(struct str_parms_view *view, const char *string)
+{
+    view->count = 0;
+    view->heap_pairs = NULL;
+    view->heap_capacity = 0;
+
+    /* Same splitting as str_parms_create_str(): empty pairs and pairs with
+     * an empty key are skipped, and the value runs to the next ';'. */
+    const char *p = string;
+    while (*p) {
+        const char *kvpair = p;
+        size_t pair_len = strcspn(kvpair, ";");
+        p = kvpair[pair_len] ? kvpair + pair_len + 1 : kvpair + pair_len;
+        if (pair_len == 0)
+            continue;
+
+        const char *eq = static_cast<const char*>(memchr(kvpair, '=', pair_len));
+        if (eq == kvpair)
+            continue;
+
+        int ret;
+        if (eq) {
+            ret = str_parms_view_append(view, kvpair, eq - kvpair, eq + 1,
+                                        kvpair + pair_len - (eq + 1));
+        } else {
+            ret = str_parms_view_append(view, kvpair, pair_len, kvpair + pair_len, 0);
+        }
+        if (ret) {
+            str_parms_view_release(view);
+            return ret;
+        }
+    }
+
+    return 0;
+}
+
+void str_parms_view_release(struct str_parms_view *view)
+{
+    free(view->heap_pairs);
+    view->heap_pairs = NULL;
+    view->heap_capacity = 0;
+    view->count = 0;
+}
+
+static const struct str_parms_view_pair *str_parms_view_find(
+        const struct str_parms_view *view, const char *key)
+{
+    const struct str_parms_view_pair *pairs =
+            view->heap_pairs ? view->heap_pairs : view->inline_pairs;
+    size_t key_len = strlen(key);
+
+    /* Search backwards so that repeated keys resolve to the last value, as
+     * they do when str_parms_create_str() replaces them in its hashmap. */
+    for (size_t i = view->count; i > 0; i--) {
+        const struct str_parms_view_pair *pair = &pairs[i - 1];
+        if (pair->key_len == key_len && !memcmp(pair->key, key, key_len))
+            return pair;
+    }
+    return NULL;
+}
+
+int str_parms_view_has_key(const struct str_parms_view *view, const char *key)
+{
+    return str_parms_view_find(view, key) != NULL;
+}
+
+int str_parms_view_get_str(const struct str_parms_view *view, const char *key,
+                           char *val, int len)
+{
+    const struct str_parms_view_pair *pair = str_parms_view_find(view, key);
+    if (!pair)
+        return -ENOENT;
+
+    /* strlcpy() semantics, for a source that isn't NUL terminated. */
+    if (len > 0) {
+        size_t n = pair->value_len < (size_t)len - 1 ? pair->value_len : (size_t)len - 1;
+        memcpy(val, pair->value, n);
+        val[n] = '\0';
+    }
+    return pair->value_len;
+}
+
+/* Values are parsed in place. They end at a ';' or the terminating NUL, and
+ * neither can continue a number, so strtol() and strtof() stop exactly at
+ * the end of the value when all of it is numeric. */
+int str_parms_view_get_int(const struct str_parms_view *view, const char *key, int *val)
+{
+    const struct str_parms_view_pair *pair = str_parms_view_find(view, key);
+    if (!pair)
+        return -ENOENT;
+
+    char *end;
+    *val = (int)strtol(pair->value, &end, 0);
+    if (pair->value_len != 0 && end == pair->value + pair->value_len)
+        return 0;
+
+    return -EINVAL;
+}
+
+int str_parms_view_get_float(const struct str_parms_view *view, const char *key,
+                             float *val)
+{
+    const struct str_parms_view_pair *pair = str_parms_view_find(view, key);
+    if (!pair)
+        return -ENOENT;
+
+    char *end;
+    float out = strtof(pair->value, &end);
+    if (pair->value_len == 0 || end != pair->value + pair->value_len)
+        return -EINVAL;
+
+    *val = out;
+    return 0;
+}
@@ -15,6 +15,7 @@
  */
 
 #include <errno.h>
+#include <fcntl.h>
 #include <linux/fs.h>
 #include <stdint.h>
 #include <string.h>
@@ -275,3 +276,81 @@ TEST(AshmemTest, ForkMultiRegionTest) {
         EXPECT_EQ(0, munmap(region, size));
     }
 }
+
+TEST(AshmemTest, PoolRegionsShareHeaps) {
+    ashmem_pool* pool = ashmem_pool_create("pool-test");
+    ASSERT_NE(nullptr, pool);
+
+    constexpr int nRegions = 64;
+    ashmem_pool_region regions[nRegions];
+    for (int i = 0; i < nRegions; i++) {
+        ASSERT_EQ(0, ashmem_pool_alloc(pool, 100, &regions[i])) << strerror(errno);
+        ASSERT_EQ(0U, regions[i].offset % 64);
+        uint8_t* data = static_cast<uint8_t*>(regions[i].data);
+        for (size_t j = 0; j < regions[i].size; j++) {
+            ASSERT_EQ(0, data[j]);
+        }
+        memset(data, i, regions[i].size);
+    }
+    // Small regions come out of one heap.
+    for (int i = 1; i < nRegions; i++) {
+        EXPECT_EQ(regions[0].fd, regions[i].fd);
+    }
+
+    // The regions are visible through their fd and offset.
+    size_t pageSize = getpagesize();
+    for (int i = 0; i < nRegions; i++) {
+        size_t slop = regions[i].offset % pageSize;
+        void* mapped = mmap(nullptr, slop + regions[i].size, PROT_READ, MAP_SHARED,
+                            regions[i].fd, regions[i].offset - slop);
+        ASSERT_NE(MAP_FAILED, mapped);
+        EXPECT_EQ(i, static_cast<uint8_t*>(mapped)[slop]);
+        EXPECT_EQ(i, static_cast<uint8_t*>(mapped)[slop + regions[i].size - 1]);
+        EXPECT_EQ(0, munmap(mapped, slop + regions[i].size));
+    }
+
+    // Freed space is reused, zero-filled.
+    ashmem_pool_free(pool, &regions[10]);
+    ashmem_pool_region region;
+    ASSERT_EQ(0, ashmem_pool_alloc(pool, 80, &region));
+    EXPECT_EQ(regions[10].fd, region.fd);
+    EXPECT_EQ(regions[10].offset, region.offset);
+    EXPECT_EQ(0, static_cast<uint8_t*>(region.data)[0]);
+    regions[10] = region;
+
+    for (int i = 0; i < nRegions; i++) {
+        ashmem_pool_free(pool, &regions[i]);
+    }
+    ashmem_pool_destroy(pool);
+}
+
+TEST(AshmemTest, PoolGrowsAndReleasesHeaps) {
+    ashmem_pool* pool = ashmem_pool_create(nullptr);
+    ASSERT_NE(nullptr, pool);
+
+    // More than fits in the first heap.
+    constexpr size_t size = 16 * 1024;
+    constexpr int nRegions = 32;
+    ashmem_pool_region regions[nRegions];
+    for (int i = 0; i < nRegions; i++) {
+        ASSERT_EQ(0, ashmem_pool_alloc(pool, size, &regions[i]));
+        memset(regions[i].data, 0xff, size);
+    }
+    EXPECT_NE(regions[0].fd, regions[nRegions - 1].fd);
+    for (int i = 0; i < nRegions; i++) {
+        ashmem_pool_free(pool, &regions[i]);
+    }
+
+    // Large regions get a region of their own.
+    ashmem_pool_region large;
+    ASSERT_EQ(0, ashmem_pool_alloc(pool, 1024 * 1024, &large));
+    EXPECT_EQ(0U, large.offset);
+    EXPECT_EQ(static_cast<int>(1024 * 1024), ashmem_get_size_region(large.fd));
+    memset(large.data, 0xff, large.size);
+    ashmem_pool_free(pool, &large);
+    EXPECT_EQ(-1, fcntl(large.fd, F_GETFD));
+
+    ashmem_pool_region region;
+    EXPECT_NE(0, ashmem_pool_alloc(pool, 0, &region));
+    ashmem_pool_destroy(pool);
+}
@@ -30,6 +30,8 @@
 extern const fs_path_config* __for_testing_only__android_dirs;
 extern const fs_path_config* __for_testing_only__android_files;
 extern bool (*__for_testing_only__fs_config_cmp)(bool, const char*, size_t, const char*, size_t);
+extern const fs_path_config* (*__for_testing_only__fs_config_find_builtin)(int, const char*,
+                                                                           size_t);
 
 // Maximum entries in system/core/libcutils/fs_config.cpp:android_* before we
 // hit a nullptr termination, before we declare the list is just too big or
@@ -246,3 +248,43 @@ TEST(fs_config, odm_files_alias) {
 TEST(fs_config, system_alias) {
     EXPECT_FALSE(check_fs_config_cmp(fs_config_cmp_tests));
 }
+
+// The indexed lookup must pick the same rule as the first match of a linear
+// scan with fs_config_cmp().
+static void check_find_builtin(const fs_path_config* paths, bool dir) {
+    std::vector<std::string> candidates = {"", "system", "system/", "vendor/", "x"};
+    for (size_t idx = 0; paths[idx].prefix; ++idx) {
+        std::string prefix(paths[idx].prefix);
+        if (android::base::EndsWith(prefix, "*")) prefix.pop_back();
+        for (const auto& path : {prefix, "system/" + prefix}) {
+            candidates.push_back(path);
+            candidates.push_back(path + "x");
+            candidates.push_back(path + "/x");
+            if (!path.empty()) candidates.push_back(path.substr(0, path.size() - 1));
+        }
+        if (android::base::StartsWith(prefix, "system/")) {
+            candidates.push_back(prefix.substr(strlen("system/")) + "/x");
+        }
+    }
+
+    for (const auto& path : candidates) {
+        const fs_path_config* expected = paths;
+        for (; expected->prefix; ++expected) {
+            if (__for_testing_only__fs_config_cmp(dir, expected->prefix, strlen(expected->prefix),
+                                                  path.c_str(), path.size())) {
+                break;
+            }
+        }
+        EXPECT_EQ(expected,
+                  __for_testing_only__fs_config_find_builtin(dir, path.c_str(), path.size()))
+                << (dir ? "dir " : "file ") << path;
+    }
+}
+
+TEST(fs_config, find_builtin_dirs) {
+    check_find_builtin(__for_testing_only__android_dirs, true);
+}
+
+TEST(fs_config, find_builtin_files) {
+    check_find_builtin(__for_testing_only__android_files, false);
+}
@@ -0,0 +1,74 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string.h>
+
+#include <string>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+#include <cutils/hashmap.h>
+
+// String keys, hashed and compared the way str_parms does.
+static int str_hash(void* key) {
+    const char* str = static_cast<const char*>(key);
+    return hashmapHash(key, strlen(str));
+}
+
+static bool str_equals(void* a, void* b) {
+    return !strcmp(static_cast<const char*>(a), static_cast<const char*>(b));
+}
+
+static std::vector<std::string> MakeKeys(size_t count) {
+    std::vector<std::string> keys;
+    for (size_t i = 0; i < count; i++) {
+        keys.push_back("audio_param_" + std::to_string(i));
+    }
+    return keys;
+}
+
+static void BM_hashmapPut(benchmark::State& state) {
+    auto keys = MakeKeys(state.range(0));
+    for (auto _ : state) {
+        Hashmap* map = hashmapCreate(5, str_hash, str_equals);
+        for (auto& key : keys) {
+            hashmapPut(map, &key[0], &key[0]);
+        }
+        hashmapFree(map);
+    }
+    state.SetItemsProcessed(state.iterations() * keys.size());
+}
+BENCHMARK(BM_hashmapPut)->Arg(8)->Arg(64)->Arg(1024);
+
+static void BM_hashmapGet(benchmark::State& state) {
+    auto keys = MakeKeys(state.range(0));
+    // Separate copies, so lookups can't succeed on pointer equality alone.
+    auto lookups = keys;
+    Hashmap* map = hashmapCreate(5, str_hash, str_equals);
+    for (auto& key : keys) {
+        hashmapPut(map, &key[0], &key[0]);
+    }
+    for (auto _ : state) {
+        for (auto& key : lookups) {
+            benchmark::DoNotOptimize(hashmapGet(map, &key[0]));
+        }
+    }
+    hashmapFree(map);
+    state.SetItemsProcessed(state.iterations() * keys.size());
+}
+BENCHMARK(BM_hashmapGet)->Arg(8)->Arg(64)->Arg(1024);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,128 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <cutils/hashmap.h>
+
+#include <stdint.h>
+
+#include <gtest/gtest.h>
+
+static int int_hash(void* key) {
+    return static_cast<int>(reinterpret_cast<uintptr_t>(key));
+}
+
+// Deliberately bad, so that every key collides.
+static int constant_hash(void*) {
+    return 42;
+}
+
+static bool int_equals(void* a, void* b) {
+    return a == b;
+}
+
+static void* key(uintptr_t k) {
+    return reinterpret_cast<void*>(k);
+}
+
+TEST(hashmap, put_get_remove) {
+    Hashmap* map = hashmapCreate(0, int_hash, int_equals);
+    ASSERT_NE(nullptr, map);
+
+    EXPECT_EQ(nullptr, hashmapGet(map, key(1)));
+    EXPECT_EQ(nullptr, hashmapPut(map, key(1), key(10)));
+    EXPECT_EQ(key(10), hashmapGet(map, key(1)));
+    EXPECT_EQ(key(10), hashmapPut(map, key(1), key(11)));
+    EXPECT_EQ(key(11), hashmapGet(map, key(1)));
+    EXPECT_EQ(key(11), hashmapRemove(map, key(1)));
+    EXPECT_EQ(nullptr, hashmapGet(map, key(1)));
+    EXPECT_EQ(nullptr, hashmapRemove(map, key(1)));
+
+    hashmapFree(map);
+}
+
+static void check_many(int (*hash)(void*)) {
+    Hashmap* map = hashmapCreate(4, hash, int_equals);
+    ASSERT_NE(nullptr, map);
+
+    const uintptr_t kCount = 1000;
+    for (uintptr_t i = 1; i <= kCount; i++) {
+        ASSERT_EQ(nullptr, hashmapPut(map, key(i), key(i + kCount)));
+    }
+    for (uintptr_t i = 1; i <= kCount; i++) {
+        ASSERT_EQ(key(i + kCount), hashmapGet(map, key(i))) << i;
+    }
+    // Churn through removals and re-insertions, so that the table is full of
+    // tombstones that have to be skipped and reused.
+    for (int round = 0; round < 5; round++) {
+        for (uintptr_t i = 1; i <= kCount; i += 2) {
+            ASSERT_EQ(key(i + kCount), hashmapRemove(map, key(i)));
+        }
+        for (uintptr_t i = 1; i <= kCount; i++) {
+            ASSERT_EQ((i % 2) ? nullptr : key(i + kCount), hashmapGet(map, key(i))) << i;
+        }
+        for (uintptr_t i = 1; i <= kCount; i += 2) {
+            ASSERT_EQ(nullptr, hashmapPut(map, key(i), key(i + kCount)));
+        }
+    }
+
+    hashmapFree(map);
+}
+
+TEST(hashmap, many) {
+    check_many(int_hash);
+}
+
+TEST(hashmap, many_colliding) {
+    check_many(constant_hash);
+}
+
+struct RemoveContext {
+    Hashmap* map;
+    size_t visited;
+};
+
+static bool remove_entry(void* k, void*, void* context) {
+    RemoveContext* ctxt = static_cast<RemoveContext*>(context);
+    hashmapRemove(ctxt->map, k);
+    ctxt->visited++;
+    return true;
+}
+
+static bool count_entry(void*, void*, void* context) {
+    (*static_cast<size_t*>(context))++;
+    return true;
+}
+
+TEST(hashmap, remove_during_for_each) {
+    Hashmap* map = hashmapCreate(0, constant_hash, int_equals);
+    ASSERT_NE(nullptr, map);
+
+    for (uintptr_t i = 1; i <= 100; i++) {
+        hashmapPut(map, key(i), key(i));
+    }
+
+    // As str_parms_destroy() does: every entry has to be visited once even
+    // though each visit removes it.
+    RemoveContext ctxt = {map, 0};
+    hashmapForEach(map, remove_entry, &ctxt);
+    EXPECT_EQ(100U, ctxt.visited);
+
+    size_t remaining = 0;
+    hashmapForEach(map, count_entry, &remaining);
+    EXPECT_EQ(0U, remaining);
+
+    hashmapFree(map);
+}
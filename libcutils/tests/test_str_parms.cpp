@@ -17,6 +17,9 @@
 #include <cutils/str_parms.h>
 #include <gtest/gtest.h>
 
+#include <string>
+#include <vector>
+
 static void test_str_parms_str(const char* str, const char* expected) {
     str_parms* str_parms = str_parms_create_str(str);
     str_parms_add_str(str_parms, "dude", "woah");
@@ -55,3 +58,83 @@ TEST(str_parms, put_ENOMEM) {
     ASSERT_EQ(ENOMEM, errno);
     test_str_parms_str("foo=bar;baz=", "foo=bar;baz=");
 }
+
+static void test_str_parms_view(const char* str, const std::vector<const char*>& keys) {
+    str_parms* str_parms = str_parms_create_str(str);
+    ASSERT_NE(nullptr, str_parms);
+    str_parms_view view;
+    ASSERT_EQ(0, str_parms_view_init(&view, str));
+
+    for (const char* key : keys) {
+        EXPECT_EQ(str_parms_has_key(str_parms, key), str_parms_view_has_key(&view, key))
+                << str << " " << key;
+
+        char expected[8] = "x";
+        char actual[8] = "x";
+        EXPECT_EQ(str_parms_get_str(str_parms, key, expected, sizeof(expected)),
+                  str_parms_view_get_str(&view, key, actual, sizeof(actual)))
+                << str << " " << key;
+        EXPECT_STREQ(expected, actual) << str << " " << key;
+
+        int expected_int = -1;
+        int actual_int = -1;
+        EXPECT_EQ(str_parms_get_int(str_parms, key, &expected_int),
+                  str_parms_view_get_int(&view, key, &actual_int))
+                << str << " " << key;
+        EXPECT_EQ(expected_int, actual_int) << str << " " << key;
+
+        float expected_float = -1;
+        float actual_float = -1;
+        EXPECT_EQ(str_parms_get_float(str_parms, key, &expected_float),
+                  str_parms_view_get_float(&view, key, &actual_float))
+                << str << " " << key;
+        EXPECT_EQ(expected_float, actual_float) << str << " " << key;
+    }
+
+    str_parms_view_release(&view);
+    str_parms_destroy(str_parms);
+}
+
+TEST(str_parms, view_matches_str_parms) {
+    std::vector<const char*> keys = {"", "foo", "fo", "fooo", "baz", "n", "f"};
+    test_str_parms_view("", keys);
+    test_str_parms_view(";;", keys);
+    test_str_parms_view("=", keys);
+    test_str_parms_view("=bar;foo", keys);
+    test_str_parms_view("foo", keys);
+    test_str_parms_view("foo=", keys);
+    test_str_parms_view("foo=;baz=2", keys);
+    test_str_parms_view("foo=bar;baz=a=b", keys);
+    test_str_parms_view("foo=bar_longer_than_the_buffer", keys);
+    test_str_parms_view("n=42;f=1.5", keys);
+    test_str_parms_view("n=0x10;f=-2.5e3;", keys);
+    test_str_parms_view("n=42x;f=1.5.5", keys);
+    test_str_parms_view("n= ;f=;foo=12", keys);
+    test_str_parms_view("n=1;n=2;;n=3", keys);
+    test_str_parms_view("foo=bar1;baz=bat;foo=bar2", keys);
+}
+
+TEST(str_parms, view_many_pairs) {
+    std::string str;
+    for (int i = 0; i < 100; i++) {
+        str += "key" + std::to_string(i) + "=" + std::to_string(i) + ";";
+    }
+
+    str_parms_view view;
+    ASSERT_EQ(0, str_parms_view_init(&view, str.c_str()));
+    EXPECT_EQ(100U, view.count);
+    for (int i = 0; i < 100; i++) {
+        int value = -1;
+        ASSERT_EQ(0, str_parms_view_get_int(&view, ("key" + std::to_string(i)).c_str(), &value));
+        EXPECT_EQ(i, value);
+    }
+    str_parms_view_release(&view);
+}
+
+TEST(str_parms, view_inline_storage) {
+    str_parms_view view;
+    ASSERT_EQ(0, str_parms_view_init(&view, "routing=2;sampling_rate=48000;format=1"));
+    EXPECT_EQ(3U, view.count);
+    EXPECT_EQ(nullptr, view.heap_pairs);
+    str_parms_view_release(&view);
+}
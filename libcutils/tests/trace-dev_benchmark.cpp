@@ -0,0 +1,67 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <string>
+
+#include <android-base/stringprintf.h>
+#include <benchmark/benchmark.h>
+
+#include "../trace-dev.cpp"
+
+// Events go to /dev/null rather than trace_marker, so that the numbers show
+// the cost of formatting on top of a write() rather than ftrace itself.
+class ScopedMarkerFd {
+  public:
+    ScopedMarkerFd() { atrace_marker_fd = open("/dev/null", O_WRONLY | O_CLOEXEC); }
+    ~ScopedMarkerFd() {
+        close(atrace_marker_fd);
+        atrace_marker_fd = -1;
+    }
+};
+
+// The floor: a write() of a message that is already formatted.
+static void BM_WritePreformatted(benchmark::State& state) {
+    ScopedMarkerFd fd;
+    std::string begin = android::base::StringPrintf("B|%d|%s", getpid(), "RenderThread::draw");
+    std::string end = android::base::StringPrintf("E|%d", getpid());
+    for (auto _ : state) {
+        write(atrace_marker_fd, begin.c_str(), begin.size());
+        write(atrace_marker_fd, end.c_str(), end.size());
+    }
+}
+BENCHMARK(BM_WritePreformatted);
+
+static void BM_BeginEnd(benchmark::State& state) {
+    ScopedMarkerFd fd;
+    for (auto _ : state) {
+        atrace_begin_body("RenderThread::draw");
+        atrace_end_body();
+    }
+}
+BENCHMARK(BM_BeginEnd);
+
+static void BM_Int(benchmark::State& state) {
+    ScopedMarkerFd fd;
+    for (auto _ : state) {
+        atrace_int_body("frames", 42);
+    }
+}
+BENCHMARK(BM_Int);
+
+BENCHMARK_MAIN();
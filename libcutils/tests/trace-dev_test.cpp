@@ -97,6 +97,17 @@ TEST_F(TraceDevTest, atrace_begin_body_truncated) {
   ASSERT_STREQ(expected.c_str(), actual.c_str());
 }
 
+TEST_F(TraceDevTest, atrace_end_body) {
+  atrace_end_body();
+
+  ASSERT_EQ(0, lseek(atrace_marker_fd, 0, SEEK_SET));
+
+  std::string actual;
+  ASSERT_TRUE(android::base::ReadFdToString(atrace_marker_fd, &actual));
+  std::string expected = android::base::StringPrintf("E|%d", getpid());
+  ASSERT_STREQ(expected.c_str(), actual.c_str());
+}
+
 TEST_F(TraceDevTest, atrace_async_begin_body_normal) {
   atrace_async_begin_body("fake_name", 12345);
 
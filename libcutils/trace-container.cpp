@@ -169,7 +169,7 @@ void atrace_begin_body(const char* name)
 
     if (atrace_marker_fd < 0) return;
 
-    WRITE_MSG("B|%d|", "%s", name, "");
+    atrace_write_event('B', name);
 }
 
 void atrace_end_body()
@@ -181,7 +181,7 @@ void atrace_end_body()
 
     if (atrace_marker_fd < 0) return;
 
-    WRITE_MSG("E|%d", "%s", "", "");
+    atrace_write_event('E', NULL);
 }
 
 void atrace_async_begin_body(const char* name, int32_t cookie)
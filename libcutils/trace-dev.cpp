@@ -50,12 +50,12 @@ void atrace_setup()
 
 void atrace_begin_body(const char* name)
 {
-    WRITE_MSG("B|%d|", "%s", name, "");
+    atrace_write_event('B', name);
 }
 
 void atrace_end_body()
 {
-    WRITE_MSG("E|%d", "%s", "", "");
+    atrace_write_event('E', NULL);
 }
 
 void atrace_async_begin_body(const char* name, int32_t cookie)
@@ -50,6 +50,29 @@ int ion_query_get_heaps(int fd, int cnt, void* buffers);
 
 int ion_is_legacy(int fd);
 
+/**
+  * Optional pool of freed ion buffers, for callers that allocate and free buffers
+  * of the same size over and over, such as camera and codec pipelines do per frame.
+  * Buffers are matched on (len, heap_mask, flags) and reused in place of a fresh
+  * allocation. A reused buffer is not cleared, so it still holds the data written
+  * by this process, and only buffers that are no longer mapped or shared anywhere
+  * may be freed into the pool.
+  *
+  * The pool keeps at most |max_bytes|, dropping the least recently freed buffers
+  * first. On memory pressure, e.g. from onTrimMemory() or a PSI monitor, call
+  * ion_pool_trim() to give buffers back to the kernel. The pool does not own |fd|.
+  */
+struct ion_pool;
+
+struct ion_pool* ion_pool_create(int fd, size_t max_bytes);
+void ion_pool_destroy(struct ion_pool* pool);
+int ion_pool_alloc_fd(struct ion_pool* pool, size_t len, unsigned int heap_mask,
+                      unsigned int flags, int* handle_fd);
+int ion_pool_free_fd(struct ion_pool* pool, size_t len, unsigned int heap_mask,
+                     unsigned int flags, int handle_fd);
+void ion_pool_trim(struct ion_pool* pool, size_t max_bytes);
+size_t ion_pool_size(struct ion_pool* pool);
+
 __END_DECLS
 
 #endif /* __SYS_CORE_ION_H */
@@ -22,8 +22,10 @@
 #include <errno.h>
 #include <fcntl.h>
 #include <linux/ion.h>
+#include <pthread.h>
 #include <stdatomic.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <sys/ioctl.h>
 #include <sys/mman.h>
@@ -197,25 +199,201 @@ int ion_sync_fd(int fd, int handle_fd) {
     return ion_ioctl(fd, ION_IOC_SYNC, &data);
 }
 
-int ion_query_heap_cnt(int fd, int* cnt) {
+/**
+  * The heaps are fixed once the ion device has probed, so the first successful
+  * query is kept for the lifetime of the process, like g_ion_version.
+  */
+static pthread_mutex_t g_heaps_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct ion_heap_data* g_heaps;
+static int g_heap_cnt = -1;
+
+/* Called with g_heaps_lock held. */
+static int ion_cache_heaps(int fd) {
     int ret;
     struct ion_heap_query query;
+    struct ion_heap_data* heaps;
 
-    memset(&query, 0, sizeof(query));
+    if (g_heap_cnt >= 0) return 0;
 
+    memset(&query, 0, sizeof(query));
     ret = ion_ioctl(fd, ION_IOC_HEAP_QUERY, &query);
     if (ret < 0) return ret;
 
-    *cnt = query.cnt;
+    heaps = calloc(query.cnt ? query.cnt : 1, sizeof(*heaps));
+    if (heaps == NULL) return -ENOMEM;
+
+    query.heaps = (uintptr_t)heaps;
+    ret = ion_ioctl(fd, ION_IOC_HEAP_QUERY, &query);
+    if (ret < 0) {
+        free(heaps);
+        return ret;
+    }
+
+    g_heaps = heaps;
+    g_heap_cnt = query.cnt;
+    return 0;
+}
+
+int ion_query_heap_cnt(int fd, int* cnt) {
+    int ret;
+
+    pthread_mutex_lock(&g_heaps_lock);
+    ret = ion_cache_heaps(fd);
+    if (ret == 0) *cnt = g_heap_cnt;
+    pthread_mutex_unlock(&g_heaps_lock);
     return ret;
 }
 
 int ion_query_get_heaps(int fd, int cnt, void* buffers) {
     int ret;
-    struct ion_heap_query query = {
-        .cnt = cnt, .heaps = (uintptr_t)buffers,
-    };
 
-    ret = ion_ioctl(fd, ION_IOC_HEAP_QUERY, &query);
+    if (cnt > 0 && buffers == NULL) return -EFAULT;
+
+    pthread_mutex_lock(&g_heaps_lock);
+    ret = ion_cache_heaps(fd);
+    if (ret == 0 && cnt > 0) {
+        int n = (cnt < g_heap_cnt) ? cnt : g_heap_cnt;
+        memcpy(buffers, g_heaps, n * sizeof(*g_heaps));
+    }
+    pthread_mutex_unlock(&g_heaps_lock);
     return ret;
 }
+
+struct ion_pool_buffer {
+    size_t len;
+    unsigned int heap_mask;
+    unsigned int flags;
+    int handle_fd;
+    struct ion_pool_buffer* next;
+};
+
+struct ion_pool {
+    int fd;
+    size_t max_bytes;
+    pthread_mutex_t lock;
+    size_t bytes;                    /* guarded by lock */
+    struct ion_pool_buffer* buffers; /* guarded by lock, most recently freed first */
+};
+
+/**
+  * Unlinks the oldest buffers until at most |max_bytes| are left in the pool and
+  * returns them, so that they can be closed after dropping the lock.
+  * Called with pool->lock held.
+  */
+static struct ion_pool_buffer* ion_pool_trim_locked(struct ion_pool* pool, size_t max_bytes) {
+    struct ion_pool_buffer** link = &pool->buffers;
+    struct ion_pool_buffer* trimmed = NULL;
+    size_t kept = 0;
+
+    while (*link != NULL) {
+        struct ion_pool_buffer* buf = *link;
+        if (kept + buf->len <= max_bytes) {
+            kept += buf->len;
+            link = &buf->next;
+            continue;
+        }
+        *link = buf->next;
+        buf->next = trimmed;
+        trimmed = buf;
+    }
+    pool->bytes = kept;
+    return trimmed;
+}
+
+static void ion_pool_release(struct ion_pool_buffer* buf) {
+    while (buf != NULL) {
+        struct ion_pool_buffer* next = buf->next;
+        close(buf->handle_fd);
+        free(buf);
+        buf = next;
+    }
+}
+
+struct ion_pool* ion_pool_create(int fd, size_t max_bytes) {
+    struct ion_pool* pool = calloc(1, sizeof(*pool));
+    if (pool == NULL) return NULL;
+
+    pool->fd = fd;
+    pool->max_bytes = max_bytes;
+    pthread_mutex_init(&pool->lock, NULL);
+    return pool;
+}
+
+void ion_pool_destroy(struct ion_pool* pool) {
+    if (pool == NULL) return;
+
+    ion_pool_trim(pool, 0);
+    pthread_mutex_destroy(&pool->lock);
+    free(pool);
+}
+
+int ion_pool_alloc_fd(struct ion_pool* pool, size_t len, unsigned int heap_mask,
+                      unsigned int flags, int* handle_fd) {
+    struct ion_pool_buffer** link;
+    struct ion_pool_buffer* found = NULL;
+
+    if (handle_fd == NULL) return -EINVAL;
+
+    pthread_mutex_lock(&pool->lock);
+    for (link = &pool->buffers; *link != NULL; link = &(*link)->next) {
+        struct ion_pool_buffer* buf = *link;
+        if (buf->len == len && buf->heap_mask == heap_mask && buf->flags == flags) {
+            *link = buf->next;
+            pool->bytes -= len;
+            found = buf;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&pool->lock);
+
+    if (found == NULL) return ion_alloc_fd(pool->fd, len, 0, heap_mask, flags, handle_fd);
+
+    *handle_fd = found->handle_fd;
+    free(found);
+    return 0;
+}
+
+int ion_pool_free_fd(struct ion_pool* pool, size_t len, unsigned int heap_mask,
+                     unsigned int flags, int handle_fd) {
+    struct ion_pool_buffer* buf;
+    struct ion_pool_buffer* trimmed;
+
+    if (handle_fd < 0) return -EINVAL;
+
+    buf = (len <= pool->max_bytes) ? malloc(sizeof(*buf)) : NULL;
+    if (buf == NULL) return ion_close(handle_fd);
+
+    buf->len = len;
+    buf->heap_mask = heap_mask;
+    buf->flags = flags;
+    buf->handle_fd = handle_fd;
+
+    pthread_mutex_lock(&pool->lock);
+    buf->next = pool->buffers;
+    pool->buffers = buf;
+    pool->bytes += len;
+    trimmed = (pool->bytes > pool->max_bytes) ? ion_pool_trim_locked(pool, pool->max_bytes) : NULL;
+    pthread_mutex_unlock(&pool->lock);
+
+    ion_pool_release(trimmed);
+    return 0;
+}
+
+void ion_pool_trim(struct ion_pool* pool, size_t max_bytes) {
+    struct ion_pool_buffer* trimmed;
+
+    pthread_mutex_lock(&pool->lock);
+    trimmed = ion_pool_trim_locked(pool, max_bytes);
+    pthread_mutex_unlock(&pool->lock);
+
+    ion_pool_release(trimmed);
+}
+
+size_t ion_pool_size(struct ion_pool* pool) {
+    size_t bytes;
+
+    pthread_mutex_lock(&pool->lock);
+    bytes = pool->bytes;
+    pthread_mutex_unlock(&pool->lock);
+    return bytes;
+}
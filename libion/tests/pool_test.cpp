@@ -0,0 +1,111 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <ion/ion.h>
+#include "ion_test_fixture.h"
+
+class Pool : public IonAllHeapsTest {
+};
+
+TEST_F(Pool, ReusesMatchingBuffer)
+{
+    static const size_t size = 64*1024;
+    for (unsigned int heapMask : m_allHeaps) {
+        SCOPED_TRACE(::testing::Message() << "heap " << heapMask);
+        struct ion_pool* pool = ion_pool_create(m_ionFd, 4*size);
+        ASSERT_TRUE(pool != NULL);
+
+        int fd = -1;
+        ASSERT_EQ(0, ion_pool_alloc_fd(pool, size, heapMask, 0, &fd));
+        ASSERT_GE(fd, 0);
+        ASSERT_EQ(0, ion_pool_free_fd(pool, size, heapMask, 0, fd));
+        ASSERT_EQ(size, ion_pool_size(pool));
+
+        // A different size or flags must not get the pooled buffer.
+        int other_fd = -1;
+        ASSERT_EQ(0, ion_pool_alloc_fd(pool, 2*size, heapMask, 0, &other_fd));
+        ASSERT_NE(fd, other_fd);
+        ASSERT_EQ(0, close(other_fd));
+        ASSERT_EQ(size, ion_pool_size(pool));
+
+        int reused_fd = -1;
+        ASSERT_EQ(0, ion_pool_alloc_fd(pool, size, heapMask, 0, &reused_fd));
+        ASSERT_EQ(fd, reused_fd);
+        ASSERT_EQ(0U, ion_pool_size(pool));
+
+        ASSERT_EQ(0, close(reused_fd));
+        ion_pool_destroy(pool);
+    }
+}
+
+TEST_F(Pool, TrimsOldestFirst)
+{
+    static const size_t size = 4*1024;
+    unsigned int heapMask = m_firstHeap;
+    struct ion_pool* pool = ion_pool_create(m_ionFd, 2*size);
+    ASSERT_TRUE(pool != NULL);
+
+    int fds[3];
+    for (int& fd : fds) {
+        ASSERT_EQ(0, ion_pool_alloc_fd(pool, size, heapMask, 0, &fd));
+    }
+    for (int fd : fds) {
+        ASSERT_EQ(0, ion_pool_free_fd(pool, size, heapMask, 0, fd));
+    }
+    // The first buffer went over the limit and was closed.
+    ASSERT_EQ(2*size, ion_pool_size(pool));
+    ASSERT_EQ(-1, fcntl(fds[0], F_GETFD));
+
+    ion_pool_trim(pool, size);
+    ASSERT_EQ(size, ion_pool_size(pool));
+    ASSERT_EQ(-1, fcntl(fds[1], F_GETFD));
+
+    int fd = -1;
+    ASSERT_EQ(0, ion_pool_alloc_fd(pool, size, heapMask, 0, &fd));
+    ASSERT_EQ(fds[2], fd);
+    ASSERT_EQ(0, close(fd));
+
+    ion_pool_destroy(pool);
+}
+
+TEST_F(Pool, HeapQueryIsStable)
+{
+    // Heap queries need a 4.12+ kernel.
+    if (ion_is_legacy(m_ionFd)) {
+        return;
+    }
+
+    int cnt = 0;
+    ASSERT_EQ(0, ion_query_heap_cnt(m_ionFd, &cnt));
+    ASSERT_GT(cnt, 0);
+
+    int again = 0;
+    ASSERT_EQ(0, ion_query_heap_cnt(m_ionFd, &again));
+    ASSERT_EQ(cnt, again);
+
+    // Room for |cnt| entries of struct ion_heap_data, which is 48 bytes.
+    std::vector<char> first(cnt * 64, 0), second(cnt * 64, 0);
+    ASSERT_EQ(0, ion_query_get_heaps(m_ionFd, cnt, first.data()));
+    ASSERT_EQ(0, ion_query_get_heaps(m_ionFd, cnt, second.data()));
+    ASSERT_EQ(first, second);
+}
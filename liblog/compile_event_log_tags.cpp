@@ -0,0 +1,39 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Build time compiler of event-log-tags into the table that
+// android_openEventTagMap() and logd map instead of parsing the text.
+//
+//   compile_event_log_tags <event-log-tags> <event-log-tags.bin>
+
+#include <stdio.h>
+#include <string.h>
+
+#include <private/android_logger.h>
+
+int main(int argc, char** argv) {
+  if (argc != 3) {
+    fprintf(stderr, "usage: %s <event-log-tags> <event-log-tags.bin>\n",
+            argv[0]);
+    return 1;
+  }
+  int ret = __android_log_compile_event_tags(argv[1], argv[2]);
+  if (ret) {
+    fprintf(stderr, "%s: %s: %s\n", argv[0], argv[1], strerror(-ret));
+    return 1;
+  }
+  return 0;
+}
@@ -24,11 +24,15 @@
 #include <stdlib.h>
 #include <string.h>
 #include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
+#include <algorithm>
 #include <functional>
 #include <string>
 #include <string_view>
 #include <unordered_map>
+#include <vector>
 
 #include <log/event_tag_map.h>
 #include <log/log_properties.h>
@@ -117,6 +121,8 @@ struct EventTagMap {
   // memory-mapped source file; we get strings from here
   void* mapAddr[NUM_MAPS];
   size_t mapLen[NUM_MAPS];
+  // compiled EVENT_TAG_TABLE_FILE, in place of mapAddr[0] when present
+  const android_event_tag_table_t* table;
 
  private:
   std::unordered_map<uint32_t, TagFmt> Idx2TagFmt;
@@ -126,7 +132,7 @@ struct EventTagMap {
   android::RWLock rwlock;
 
  public:
-  EventTagMap() {
+  EventTagMap() : table(NULL) {
     memset(mapAddr, 0, sizeof(mapAddr));
     memset(mapLen, 0, sizeof(mapLen));
   }
@@ -141,12 +147,21 @@ struct EventTagMap {
         mapAddr[which] = 0;
       }
     }
+    if (table) __android_log_unmap_event_tags(table);
   }
 
   bool emplaceUnique(uint32_t tag, const TagFmt& tagfmt, bool verbose = false);
   const TagFmt* find(uint32_t tag) const;
   int find(TagFmt&& tagfmt) const;
   int find(MapString&& tag) const;
+
+  bool findTable(uint32_t tag, std::string_view* name,
+                 std::string_view* format) const;
+  int findTable(const MapString& name, const MapString* format) const;
+  bool writeTable(int fd, uint64_t sourceSize, uint64_t sourceHash) const;
+
+ private:
+  std::string_view tableString(uint32_t offset, uint16_t len) const;
 };
 
 bool EventTagMap::emplaceUnique(uint32_t tag, const TagFmt& tagfmt,
@@ -214,6 +229,9 @@ const TagFmt* EventTagMap::find(uint32_t tag) const {
 }
 
 int EventTagMap::find(TagFmt&& tagfmt) const {
+  int ret = findTable(tagfmt.first, &tagfmt.second);
+  if (ret != -1) return ret;
+
   std::unordered_map<TagFmt, uint32_t>::const_iterator it;
   android::RWLock::AutoRLock readLock(const_cast<android::RWLock&>(rwlock));
   it = TagFmt2Idx.find(std::move(tagfmt));
@@ -222,6 +240,9 @@ int EventTagMap::find(TagFmt&& tagfmt) const {
 }
 
 int EventTagMap::find(MapString&& tag) const {
+  int ret = findTable(tag, NULL);
+  if (ret != -1) return ret;
+
   std::unordered_map<MapString, uint32_t>::const_iterator it;
   android::RWLock::AutoRLock readLock(const_cast<android::RWLock&>(rwlock));
   it = Tag2Idx.find(std::move(tag));
@@ -229,6 +250,166 @@ int EventTagMap::find(MapString&& tag) const {
   return it->second;
 }
 
+static const android_event_tag_table_entry_t* tableEntries(
+    const android_event_tag_table_t* table) {
+  return reinterpret_cast<const android_event_tag_table_entry_t*>(table + 1);
+}
+
+static const uint32_t* tableIndex(const android_event_tag_table_t* table,
+                                  uint32_t offset) {
+  return reinterpret_cast<const uint32_t*>(
+      reinterpret_cast<const char*>(table) + offset);
+}
+
+// Empty if out of bounds, the header only vouches for the offsets.
+std::string_view EventTagMap::tableString(uint32_t offset,
+                                          uint16_t len) const {
+  size_t avail = table->size - table->strings_offset;
+  if ((offset >= avail) || (len >= (avail - offset))) {
+    return std::string_view();
+  }
+  return std::string_view(
+      reinterpret_cast<const char*>(table) + table->strings_offset + offset,
+      len);
+}
+
+bool EventTagMap::findTable(uint32_t tag, std::string_view* name,
+                            std::string_view* format) const {
+  if (!table) return false;
+  const android_event_tag_table_entry_t* begin = tableEntries(table);
+  const android_event_tag_table_entry_t* end = begin + table->count;
+  const android_event_tag_table_entry_t* entry = std::lower_bound(
+      begin, end, tag,
+      [](const android_event_tag_table_entry_t& entry, uint32_t tag) {
+        return entry.tag < tag;
+      });
+  if ((entry == end) || (entry->tag != tag)) return false;
+  *name = tableString(entry->name_offset, entry->name_len);
+  *format = tableString(entry->format_offset, entry->format_len);
+  return (name->data() != NULL) && (format->data() != NULL);
+}
+
+// Tag for name, and format unless NULL, out of the table. -1 if not there.
+int EventTagMap::findTable(const MapString& name,
+                           const MapString* format) const {
+  if (!table) return -1;
+  const android_event_tag_table_entry_t* entries = tableEntries(table);
+  const uint32_t* index =
+      tableIndex(table, format ? table->keys_offset : table->names_offset);
+  size_t low = 0;
+  size_t high = format ? table->keys_count : table->names_count;
+  while (low < high) {
+    size_t mid = (low + high) / 2;
+    if (index[mid] >= table->count) return -1;
+    const android_event_tag_table_entry_t& entry = entries[index[mid]];
+    int cmp = tableString(entry.name_offset, entry.name_len)
+                  .compare(std::string_view(name));
+    if (!cmp && format) {
+      cmp = tableString(entry.format_offset, entry.format_len)
+                .compare(std::string_view(*format));
+    }
+    if (!cmp) return entry.tag;
+    if (cmp < 0) {
+      low = mid + 1;
+    } else {
+      high = mid;
+    }
+  }
+  return -1;
+}
+
+static bool writeAll(int fd, const void* buf, size_t len) {
+  const char* cp = static_cast<const char*>(buf);
+  while (len) {
+    ssize_t ret = TEMP_FAILURE_RETRY(write(fd, cp, len));
+    if (ret <= 0) return false;
+    cp += ret;
+    len -= ret;
+  }
+  return true;
+}
+
+// Lays out what was parsed as an android_event_tag_table_t.
+bool EventTagMap::writeTable(int fd, uint64_t sourceSize,
+                             uint64_t sourceHash) const {
+  std::vector<uint32_t> tags;
+  tags.reserve(Idx2TagFmt.size());
+  for (const auto& it : Idx2TagFmt) tags.push_back(it.first);
+  std::sort(tags.begin(), tags.end());
+
+  std::vector<android_event_tag_table_entry_t> entries;
+  std::vector<std::pair<std::string_view, std::string_view>> strs;
+  std::string strings;
+  for (uint32_t tag : tags) {
+    const TagFmt& tagfmt = Idx2TagFmt.find(tag)->second;
+    if ((tagfmt.first.length() > UINT16_MAX) ||
+        (tagfmt.second.length() > UINT16_MAX)) {
+      errno = E2BIG;
+      return false;
+    }
+    android_event_tag_table_entry_t entry;
+    entry.tag = tag;
+    entry.name_offset = strings.length();
+    entry.name_len = tagfmt.first.length();
+    strings.append(tagfmt.first.data(), tagfmt.first.length());
+    strings.push_back('\0');
+    entry.format_offset = strings.length();
+    entry.format_len = tagfmt.second.length();
+    strings.append(tagfmt.second.data(), tagfmt.second.length());
+    strings.push_back('\0');
+    entries.push_back(entry);
+    strs.push_back(std::make_pair(std::string_view(tagfmt.first),
+                                  std::string_view(tagfmt.second)));
+  }
+
+  // Only those that agree with the entry, a duplicate tag number leaves
+  // the name or format it brought without one.
+  auto indexOf = [&tags](uint32_t tag) {
+    return std::lower_bound(tags.begin(), tags.end(), tag) - tags.begin();
+  };
+  std::vector<uint32_t> names;
+  for (const auto& it : Tag2Idx) {
+    uint32_t i = indexOf(it.second);
+    if (strs[i].first == std::string_view(it.first)) names.push_back(i);
+  }
+  std::sort(names.begin(), names.end(), [&strs](uint32_t a, uint32_t b) {
+    return strs[a].first < strs[b].first;
+  });
+  std::vector<uint32_t> keys;
+  for (const auto& it : TagFmt2Idx) {
+    uint32_t i = indexOf(it.second);
+    if ((strs[i].first == std::string_view(it.first.first)) &&
+        (strs[i].second == std::string_view(it.first.second))) {
+      keys.push_back(i);
+    }
+  }
+  std::sort(keys.begin(), keys.end(),
+            [&strs](uint32_t a, uint32_t b) { return strs[a] < strs[b]; });
+
+  android_event_tag_table_t header;
+  header.magic = EVENT_TAG_TABLE_MAGIC;
+  header.source_size = sourceSize;
+  header.source_hash = sourceHash;
+  header.count = entries.size();
+  header.names_count = names.size();
+  header.names_offset = sizeof(header) + entries.size() * sizeof(entries[0]);
+  header.keys_count = keys.size();
+  header.keys_offset = header.names_offset + names.size() * sizeof(names[0]);
+  header.strings_offset = header.keys_offset + keys.size() * sizeof(keys[0]);
+  uint64_t size = (uint64_t)header.strings_offset + strings.length();
+  if (size > UINT32_MAX) {
+    errno = E2BIG;
+    return false;
+  }
+  header.size = size;
+
+  return writeAll(fd, &header, sizeof(header)) &&
+         writeAll(fd, entries.data(), entries.size() * sizeof(entries[0])) &&
+         writeAll(fd, names.data(), names.size() * sizeof(names[0])) &&
+         writeAll(fd, keys.data(), keys.size() * sizeof(keys[0])) &&
+         writeAll(fd, strings.data(), strings.length());
+}
+
 // The position after the end of a valid section of the tag string,
 // caller makes sure delimited appropriately.
 static const char* endOfTag(const char* cp) {
@@ -446,7 +627,17 @@ LIBLOG_ABI_PUBLIC EventTagMap* android_openEventTagMap(const char* fileName) {
     goto fail_close;
   }
 
+  if (!fileName) {
+    newTagMap->table =
+        __android_log_map_event_tags(EVENT_TAG_TABLE_FILE, eventTagFiles[0]);
+  }
+
   for (which = 0; which < NUM_MAPS; ++which) {
+    if (!which && newTagMap->table) {
+      close(fd[which]); /* fd DONE */
+      fd[which] = -1;
+      continue;
+    }
     if (fd[which] >= 0) {
       newTagMap->mapAddr[which] =
           mmap(NULL, end[which], which ? PROT_READ : PROT_READ | PROT_WRITE,
@@ -468,6 +659,7 @@ LIBLOG_ABI_PUBLIC EventTagMap* android_openEventTagMap(const char* fileName) {
   }
 
   for (which = 0; which < NUM_MAPS; ++which) {
+    if (!which && newTagMap->table) continue;
     if (parseMapLines(newTagMap, which) != 0) {
       delete newTagMap;
       return NULL;
@@ -492,6 +684,105 @@ LIBLOG_ABI_PUBLIC void android_closeEventTagMap(EventTagMap* map) {
   if (map) delete map;
 }
 
+// FNV-1a
+static int hashEventTagFile(const char* fileName, uint64_t* size,
+                            uint64_t* hash) {
+  int fd = open(fileName, O_RDONLY | O_CLOEXEC);
+  if (fd < 0) return -errno;
+
+  struct stat st;
+  if (fstat(fd, &st) < 0) {
+    int save_errno = errno;
+    close(fd);
+    return -save_errno;
+  }
+  *size = st.st_size;
+  *hash = 0xcbf29ce484222325ULL;
+  if (!st.st_size) {
+    close(fd);
+    return 0;
+  }
+
+  void* addr = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  int save_errno = errno;
+  close(fd);
+  if (addr == MAP_FAILED) return -save_errno;
+
+  const uint8_t* cp = static_cast<const uint8_t*>(addr);
+  for (off_t i = 0; i < st.st_size; ++i) {
+    *hash ^= cp[i];
+    *hash *= 0x100000001b3ULL;
+  }
+  munmap(addr, st.st_size);
+  return 0;
+}
+
+static bool indexFits(uint32_t offset, uint32_t count, size_t len) {
+  return (offset <= len) && (count <= ((len - offset) / sizeof(uint32_t)));
+}
+
+LIBLOG_ABI_PRIVATE const android_event_tag_table_t*
+__android_log_map_event_tags(const char* table, const char* source) {
+  uint64_t sourceSize, sourceHash;
+  if (hashEventTagFile(source, &sourceSize, &sourceHash)) return NULL;
+
+  int fd = open(table, O_RDONLY | O_CLOEXEC);
+  if (fd < 0) return NULL;
+  struct stat st;
+  if ((fstat(fd, &st) < 0) ||
+      ((size_t)st.st_size < sizeof(android_event_tag_table_t)) ||
+      ((uint64_t)st.st_size > UINT32_MAX)) {
+    close(fd);
+    return NULL;
+  }
+  size_t len = st.st_size;
+  // Shared, and never written to, so the pages are too between processes
+  void* addr = mmap(NULL, len, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (addr == MAP_FAILED) return NULL;
+
+  const android_event_tag_table_t* t =
+      static_cast<const android_event_tag_table_t*>(addr);
+  if ((t->magic != EVENT_TAG_TABLE_MAGIC) || (t->size != len) ||
+      (t->source_size != sourceSize) || (t->source_hash != sourceHash) ||
+      (t->count > ((len - sizeof(*t)) /
+                   sizeof(android_event_tag_table_entry_t))) ||
+      !indexFits(t->names_offset, t->names_count, len) ||
+      !indexFits(t->keys_offset, t->keys_count, len) ||
+      (t->strings_offset > len)) {
+    munmap(addr, len);
+    return NULL;
+  }
+  return t;
+}
+
+LIBLOG_ABI_PRIVATE void __android_log_unmap_event_tags(
+    const android_event_tag_table_t* table) {
+  if (table) munmap(const_cast<android_event_tag_table_t*>(table), table->size);
+}
+
+LIBLOG_ABI_PRIVATE int __android_log_compile_event_tags(const char* source,
+                                                        const char* table) {
+  uint64_t sourceSize, sourceHash;
+  int ret = hashEventTagFile(source, &sourceSize, &sourceHash);
+  if (ret) return ret;
+
+  EventTagMap* map = android_openEventTagMap(source);
+  if (!map) return errno ? -errno : -EINVAL;
+
+  int fd = open(table, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if (fd < 0) {
+    ret = -errno;
+    android_closeEventTagMap(map);
+    return ret;
+  }
+  ret = map->writeTable(fd, sourceSize, sourceHash) ? 0 : -errno;
+  if (close(fd) && !ret) ret = -errno;
+  android_closeEventTagMap(map);
+  if (ret) unlink(table);
+  return ret;
+}
+
 // Cache miss, go to logd to acquire a public reference.
 // Because we lack access to a SHARED PUBLIC /dev/event-log-tags file map?
 static const TagFmt* __getEventTag(EventTagMap* map, unsigned int tag) {
@@ -539,6 +830,11 @@ LIBLOG_ABI_PUBLIC const char* android_lookupEventTag_len(const EventTagMap* map,
                                                          size_t* len,
                                                          unsigned int tag) {
   if (len) *len = 0;
+  std::string_view name, format;
+  if (map->findTable(tag, &name, &format)) {
+    if (len) *len = name.length();
+    return name.data();
+  }
   const TagFmt* str = map->find(tag);
   if (!str) {
     str = __getEventTag(const_cast<EventTagMap*>(map), tag);
@@ -552,6 +848,11 @@ LIBLOG_ABI_PUBLIC const char* android_lookupEventTag_len(const EventTagMap* map,
 LIBLOG_ABI_PUBLIC const char* android_lookupEventFormat_len(
     const EventTagMap* map, size_t* len, unsigned int tag) {
   if (len) *len = 0;
+  std::string_view name, format;
+  if (map->findTable(tag, &name, &format)) {
+    if (len) *len = format.length();
+    return format.data();
+  }
   const TagFmt* str = map->find(tag);
   if (!str) {
     str = __getEventTag(const_cast<EventTagMap*>(map), tag);
@@ -17,9 +17,11 @@
 #pragma once
 
 #include <pthread.h>
+#include <stdint.h>
 
 #include <android/log.h>
 #include <log/event_tag_map.h>
+#include <log/log_id.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -154,6 +156,57 @@ char* android_log_formatLogLine(AndroidLogFormat* p_format, char* defaultBuffer,
 int android_log_printLogLine(AndroidLogFormat* p_format, int fd,
                              const AndroidLogEntry* entry);
 
+/**
+ * Framed binary form of an AndroidLogEntry, for machine consumers such as
+ * logcat --framed. Each frame is this header, followed by tag_len bytes of
+ * tag and then the message up to len, neither nul terminated. Binary log
+ * payloads are already decoded to text. All fields are little endian, and
+ * hdr_size allows fields to be appended in the future.
+ */
+typedef struct __attribute__((__packed__)) {
+  uint32_t len;      /* of the whole frame */
+  uint16_t hdr_size; /* sizeof(android_log_frame_t) */
+  uint8_t log_id;
+  uint8_t priority;
+  uint32_t uid;
+  int32_t pid;
+  int32_t tid;
+  uint32_t sec;
+  uint32_t nsec;
+  uint16_t tag_len;
+  uint16_t reserved;
+} android_log_frame_t;
+
+/**
+ * Formats entry as a frame into a buffer
+ *
+ * Uses defaultBuffer if it can, otherwise malloc()'s a new buffer
+ * If return value != defaultBuffer, caller must call free()
+ * Returns NULL on error
+ */
+char* android_log_formatFramedEntry(char* defaultBuffer,
+                                    size_t defaultBufferSize, log_id_t logId,
+                                    const AndroidLogEntry* entry,
+                                    size_t* p_outLength);
+
+/**
+ * Writes entry as a frame to fd.
+ *
+ * Returns the number of bytes written, or -1 on error
+ */
+int android_log_printFramedEntry(int fd, log_id_t logId,
+                                 const AndroidLogEntry* entry);
+
+/**
+ * Splits the frame at the start of buf into an AndroidLogEntry allocated by
+ * caller. Pointers will point directly into buf.
+ *
+ * Returns the length of the frame, 0 if the first len bytes of buf do not
+ * hold a whole frame yet, and -1 on an invalid frame
+ */
+int android_log_processFramedEntry(const char* buf, size_t len,
+                                   AndroidLogEntry* entry, log_id_t* logId);
+
 #ifdef __cplusplus
 }
 #endif
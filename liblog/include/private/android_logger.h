@@ -52,6 +52,20 @@ typedef struct __attribute__((__packed__)) {
   log_time realtime;
 } android_log_header_t;
 
+/*
+ * A datagram to logd whose header id is LOG_ID_BATCH carries several entries
+ * back to back, each an android_log_batch_entry_t followed by len bytes of
+ * payload. The tid and realtime of the outer header are unused. Batches come
+ * from a single thread, so the socket credentials apply to every entry.
+ */
+#define LOG_ID_BATCH ((typeof_log_id_t)0xFF)
+#define LOGGER_BATCH_MAX_SIZE (16 * 1024)
+
+typedef struct __attribute__((__packed__)) {
+  android_log_header_t header;
+  uint16_t len;
+} android_log_batch_entry_t;
+
 /* Event Header Structure to logd */
 typedef struct __attribute__((__packed__)) {
   int32_t tag;  // Little Endian Order
@@ -147,6 +161,84 @@ bool __android_logger_property_get_bool(const char* key, int flag);
 unsigned long __android_logger_get_buffer_size(log_id_t logId);
 bool __android_logger_valid_buffer_size(unsigned long value);
 
+/*
+ * Opt the calling thread in to batched writes to logd: its messages are held
+ * back and sent together once max_size bytes are pending, the oldest pending
+ * message is more than max_delay_ms old, or a message of flush_prio or above
+ * is written. Security messages are never held back. Pending messages are
+ * sent by __android_log_flush_batch() and at thread exit, and are lost if the
+ * process dies first. A max_size of 0 turns batching off again.
+ * Returns 0 or -errno.
+ */
+int __android_log_set_batching(size_t max_size, uint32_t max_delay_ms,
+                               int flush_prio);
+int __android_log_flush_batch();
+
+/*
+ * Ask the reader transport to only return entries that pass filter, a
+ * whitespace separated list of tag:priority rules as for
+ * android_log_addFilterString(), and whose message matches the Perl
+ * compatible regex. Either may be NULL. This only cuts down on what needs
+ * to be passed to the reader, so the caller must still apply both itself.
+ * Call before the first read. Returns 0 or -errno.
+ */
+int android_logger_list_set_filter(struct logger_list* logger_list,
+                                   const char* filter, const char* regex);
+
+/*
+ * Ask logd to push new entries to a blocking reader as they are added,
+ * rather than have the reader woken up to look for them, in batches of up to
+ * batch_entries held back for no more than batch_delay_us. A batch_entries
+ * of 1 sends every entry by itself, 0 turns the push off again. Call before
+ * the first read. Returns 0 or -errno.
+ */
+int android_logger_list_set_push(struct logger_list* logger_list,
+                                 unsigned int batch_entries,
+                                 unsigned int batch_delay_us);
+
+/*
+ * Compiled form of EVENT_TAG_MAP_FILE, generated at build time. Everything
+ * is sorted so that it is used as is out of a read only shared mapping
+ * instead of being parsed again by every process. It records the size and
+ * a hash of the text it was compiled from, and is ignored in favour of the
+ * text once those no longer match. Native byte order.
+ */
+#define EVENT_TAG_TABLE_FILE "/system/etc/event-log-tags.bin"
+#define EVENT_TAG_TABLE_MAGIC 0x31475445 /* "ETG1" */
+
+typedef struct __attribute__((__packed__)) {
+  uint32_t magic;
+  uint32_t size;           /* of the whole table */
+  uint64_t source_size;    /* of the text compiled from */
+  uint64_t source_hash;    /* FNV-1a of the text compiled from */
+  uint32_t count;          /* entries, sorted by tag, following the header */
+  uint32_t names_count;    /* uint32_t entry indexes sorted by name, */
+  uint32_t names_offset;   /* one for each name */
+  uint32_t keys_count;     /* uint32_t entry indexes sorted by name and */
+  uint32_t keys_offset;    /* format, one for each pair of them */
+  uint32_t strings_offset; /* nul terminated names and formats */
+} android_event_tag_table_t;
+
+typedef struct __attribute__((__packed__)) {
+  uint32_t tag;
+  uint32_t name_offset; /* from strings_offset */
+  uint32_t format_offset;
+  uint16_t name_len;
+  uint16_t format_len;
+} android_event_tag_table_entry_t;
+
+/*
+ * Compiles the event-log-tags text in source to a table. Returns 0 or -errno.
+ */
+int __android_log_compile_event_tags(const char* source, const char* table);
+/*
+ * Maps the table, provided it is still current for source. Returns NULL
+ * otherwise.
+ */
+const android_event_tag_table_t* __android_log_map_event_tags(
+    const char* table, const char* source);
+void __android_log_unmap_event_tags(const android_event_tag_table_t* table);
+
 /* Retrieve the composed event buffer */
 int android_log_write_list_buffer(android_log_context ctx, const char** msg);
 
@@ -14,6 +14,7 @@
  * limitations under the License.
  */
 
+#include <ctype.h>
 #include <endian.h>
 #include <errno.h>
 #include <fcntl.h>
@@ -448,7 +449,7 @@ static int logdOpen(struct android_log_logger_list* logger_list,
   struct sigaction ignore;
   struct sigaction old_sigaction;
   unsigned int old_alarm = 0;
-  char buffer[256], *cp, c;
+  char buffer[1024], *cp, c;
   int e, ret, remaining, sock;
 
   if (!logger_list) {
@@ -514,9 +515,48 @@ static int logdOpen(struct android_log_logger_list* logger_list,
   if (logger_list->pid) {
     ret = snprintf(cp, remaining, " pid=%u", logger_list->pid);
     ret = min(ret, remaining);
+    remaining -= ret;
+    cp += ret;
+  }
+
+  if (logger_list->push_entries && !(logger_list->mode & ANDROID_LOG_NONBLOCK)) {
+    ret = snprintf(cp, remaining, " push=%u,%u", logger_list->push_entries,
+                   logger_list->push_delay_us);
+    ret = min(ret, remaining);
+    remaining -= ret;
     cp += ret;
   }
 
+  /*
+   * The filters are only an optimization, the caller applies them again. So
+   * leave out rather than truncate what does not fit, or tags that would not
+   * survive the translation to a comma separated list.
+   */
+  if (logger_list->filter && !strchr(logger_list->filter, ',')) {
+    ret = snprintf(cp, remaining, " filter=%s", logger_list->filter);
+    if (ret < remaining) {
+      char* rule;
+      for (rule = cp + 1; *rule; ++rule) {
+        if (isspace(*rule)) *rule = ',';
+      }
+      remaining -= ret;
+      cp += ret;
+    } else {
+      *cp = '\0';
+    }
+  }
+
+  /* extends to the end of the command, must be last */
+  if (logger_list->regex) {
+    ret = snprintf(cp, remaining, " regex=%s", logger_list->regex);
+    if (ret < remaining) {
+      remaining -= ret;
+      cp += ret;
+    } else {
+      *cp = '\0';
+    }
+  }
+
   if (logger_list->mode & ANDROID_LOG_NONBLOCK) {
     /* Deal with an unresponsive logd */
     memset(&ignore, 0, sizeof(ignore));
@@ -19,6 +19,7 @@
 #include <fcntl.h>
 #include <inttypes.h>
 #include <poll.h>
+#include <pthread.h>
 #include <stdarg.h>
 #include <stdatomic.h>
 #include <stdio.h>
@@ -123,6 +124,241 @@ static int logdAvailable(log_id_t logId) {
   return 1;
 }
 
+static atomic_int dropped;
+static atomic_int droppedSecurity;
+
+/*
+ * The write below could be lost, but will never block.
+ *
+ * ENOTCONN occurs if logd has died.
+ * ENOENT occurs if logd is not running and socket is missing.
+ * ECONNREFUSED occurs if we can not reconnect to logd.
+ * EAGAIN occurs if logd is overloaded.
+ */
+static ssize_t logdSend(int sock, struct iovec* vec, size_t nr) {
+  ssize_t ret;
+
+  if (sock < 0) {
+    ret = sock;
+  } else {
+    ret = TEMP_FAILURE_RETRY(writev(sock, vec, nr));
+    if (ret < 0) {
+      ret = -errno;
+    }
+  }
+  switch (ret) {
+    case -ENOTCONN:
+    case -ECONNREFUSED:
+    case -ENOENT:
+      if (__android_log_trylock()) {
+        return ret; /* in a signal handler? try again when less stressed */
+      }
+      __logdClose(ret);
+      ret = logdOpen();
+      __android_log_unlock();
+
+      if (ret < 0) {
+        return ret;
+      }
+
+      ret = TEMP_FAILURE_RETRY(writev(atomic_load(&logdLoggerWrite.context.sock), vec, nr));
+      if (ret < 0) {
+        ret = -errno;
+      }
+      [[fallthrough]];
+    default:
+      break;
+  }
+
+  return ret;
+}
+
+/*
+ * Per-thread batch of entries, see __android_log_set_batching(). Laid out as
+ * the payload of a LOG_ID_BATCH datagram.
+ */
+struct LogdBatch {
+  size_t maxSize;
+  uint32_t maxDelayMs;
+  int flushPrio;
+  pid_t pid; /* a forked child must not send the batch of its parent */
+  bool busy; /* set while the batch is modified, in case of a signal handler */
+  size_t used;
+  size_t count;
+  struct timespec first; /* realtime of the oldest entry */
+  unsigned char buffer[LOGGER_BATCH_MAX_SIZE];
+};
+
+static pthread_key_t logdBatchKey;
+static pthread_once_t logdBatchOnce = PTHREAD_ONCE_INIT;
+static atomic_bool logdBatchKeyCreated;
+
+static int logdFlushBatch(LogdBatch* batch) {
+  ssize_t ret;
+  android_log_header_t header;
+  struct iovec vec[2];
+
+  if (!batch->used) {
+    return 0;
+  }
+  if (batch->pid != getpid()) {
+    batch->pid = getpid();
+    batch->used = batch->count = 0;
+    return 0;
+  }
+
+  header.id = LOG_ID_BATCH;
+  header.tid = gettid();
+  header.realtime.tv_sec = batch->first.tv_sec;
+  header.realtime.tv_nsec = batch->first.tv_nsec;
+
+  vec[0].iov_base = &header;
+  vec[0].iov_len = sizeof(header);
+  vec[1].iov_base = batch->buffer;
+  vec[1].iov_len = batch->used;
+
+  ret = logdSend(atomic_load(&logdLoggerWrite.context.sock), vec, 2);
+  if (ret == -EAGAIN) {
+    atomic_fetch_add_explicit(&dropped, batch->count, memory_order_relaxed);
+  }
+  batch->used = batch->count = 0;
+
+  return (ret < 0) ? ret : 0;
+}
+
+/* Called at thread exit */
+static void logdDestroyBatch(void* obj) {
+  LogdBatch* batch = static_cast<LogdBatch*>(obj);
+
+  logdFlushBatch(batch);
+  free(batch);
+}
+
+static void logdCreateBatchKey() {
+  if (!pthread_key_create(&logdBatchKey, logdDestroyBatch)) {
+    atomic_store(&logdBatchKeyCreated, true);
+  }
+}
+
+static LogdBatch* logdGetBatch() {
+  if (!atomic_load(&logdBatchKeyCreated)) {
+    return nullptr;
+  }
+  return static_cast<LogdBatch*>(pthread_getspecific(logdBatchKey));
+}
+
+static ssize_t logdBatchWrite(LogdBatch* batch, const android_log_header_t* header,
+                              const struct timespec* ts, int prio, const struct iovec* vec,
+                              size_t nr) {
+  android_log_batch_entry_t entry;
+  size_t i, payloadSize;
+  ssize_t ret;
+  int64_t age;
+
+  for (payloadSize = 0, i = 0; i < nr; i++) {
+    payloadSize += vec[i].iov_len;
+  }
+
+  batch->busy = true;
+
+  if (batch->pid != getpid()) {
+    batch->pid = getpid();
+    batch->used = batch->count = 0;
+  }
+  if (batch->used + sizeof(entry) + payloadSize > batch->maxSize) {
+    logdFlushBatch(batch);
+  }
+  if (!batch->used) {
+    batch->first = *ts;
+  }
+
+  /* the buffer always has room for one entry of LOGGER_ENTRY_MAX_PAYLOAD */
+  entry.header = *header;
+  entry.len = payloadSize;
+  memcpy(batch->buffer + batch->used, &entry, sizeof(entry));
+  batch->used += sizeof(entry);
+  for (i = 0; i < nr; i++) {
+    memcpy(batch->buffer + batch->used, vec[i].iov_base, vec[i].iov_len);
+    batch->used += vec[i].iov_len;
+  }
+  ++batch->count;
+  ret = payloadSize;
+
+  /* a clock going backwards counts as too old */
+  age = (ts->tv_sec - batch->first.tv_sec) * INT64_C(1000) +
+        (ts->tv_nsec - batch->first.tv_nsec) / 1000000;
+  if ((prio >= batch->flushPrio) || (batch->used >= batch->maxSize) || (age < 0) ||
+      (age > batch->maxDelayMs)) {
+    int err = logdFlushBatch(batch);
+    if (err < 0) {
+      ret = err;
+    }
+  }
+
+  batch->busy = false;
+  return ret;
+}
+
+LIBLOG_ABI_PRIVATE int __android_log_set_batching(size_t max_size, uint32_t max_delay_ms,
+                                                  int flush_prio) {
+  LogdBatch* batch;
+  int ret;
+
+  pthread_once(&logdBatchOnce, logdCreateBatchKey);
+  if (!atomic_load(&logdBatchKeyCreated)) {
+    return -EAGAIN;
+  }
+
+  batch = static_cast<LogdBatch*>(pthread_getspecific(logdBatchKey));
+  if (batch && batch->busy) {
+    return -EBUSY;
+  }
+  if (!max_size) {
+    if (batch) {
+      pthread_setspecific(logdBatchKey, nullptr);
+      logdDestroyBatch(batch);
+    }
+    return 0;
+  }
+
+  if (batch) {
+    logdFlushBatch(batch);
+  } else {
+    batch = static_cast<LogdBatch*>(calloc(1, sizeof(*batch)));
+    if (!batch) {
+      return -ENOMEM;
+    }
+    ret = pthread_setspecific(logdBatchKey, batch);
+    if (ret) {
+      free(batch);
+      return -ret;
+    }
+    batch->pid = getpid();
+  }
+  batch->maxSize = min(max_size, (size_t)LOGGER_BATCH_MAX_SIZE);
+  batch->maxDelayMs = max_delay_ms;
+  batch->flushPrio = flush_prio;
+
+  return 0;
+}
+
+LIBLOG_ABI_PRIVATE int __android_log_flush_batch() {
+  LogdBatch* batch = logdGetBatch();
+  int ret;
+
+  if (!batch) {
+    return 0;
+  }
+  if (batch->busy) {
+    return -EBUSY;
+  }
+  batch->busy = true;
+  ret = logdFlushBatch(batch);
+  batch->busy = false;
+
+  return ret;
+}
+
 static int logdWrite(log_id_t logId, struct timespec* ts, struct iovec* vec, size_t nr) {
   ssize_t ret;
   int sock;
@@ -130,8 +366,7 @@ static int logdWrite(log_id_t logId, struct timespec* ts, struct iovec* vec, siz
   struct iovec newVec[nr + headerLength];
   android_log_header_t header;
   size_t i, payloadSize;
-  static atomic_int dropped;
-  static atomic_int droppedSecurity;
+  LogdBatch* batch;
 
   sock = atomic_load(&logdLoggerWrite.context.sock);
   if (sock < 0) switch (sock) {
@@ -231,45 +466,22 @@ static int logdWrite(log_id_t logId, struct timespec* ts, struct iovec* vec, siz
     }
   }
 
-  /*
-   * The write below could be lost, but will never block.
-   *
-   * ENOTCONN occurs if logd has died.
-   * ENOENT occurs if logd is not running and socket is missing.
-   * ECONNREFUSED occurs if we can not reconnect to logd.
-   * EAGAIN occurs if logd is overloaded.
-   */
-  if (sock < 0) {
-    ret = sock;
-  } else {
-    ret = TEMP_FAILURE_RETRY(writev(sock, newVec, i));
-    if (ret < 0) {
-      ret = -errno;
+  batch = logdGetBatch();
+  if (batch && !batch->busy) {
+    if (logId != LOG_ID_SECURITY) {
+      int prio = ANDROID_LOG_UNKNOWN;
+      if ((logId != LOG_ID_EVENTS) && (logId != LOG_ID_STATS) && nr && vec[0].iov_len) {
+        prio = *static_cast<const unsigned char*>(vec[0].iov_base);
+      }
+      return logdBatchWrite(batch, &header, ts, prio, newVec + headerLength, i - headerLength);
     }
+    /* keep what the thread logged before in order with the security entry */
+    batch->busy = true;
+    logdFlushBatch(batch);
+    batch->busy = false;
   }
-  switch (ret) {
-    case -ENOTCONN:
-    case -ECONNREFUSED:
-    case -ENOENT:
-      if (__android_log_trylock()) {
-        return ret; /* in a signal handler? try again when less stressed */
-      }
-      __logdClose(ret);
-      ret = logdOpen();
-      __android_log_unlock();
 
-      if (ret < 0) {
-        return ret;
-      }
-
-      ret = TEMP_FAILURE_RETRY(writev(atomic_load(&logdLoggerWrite.context.sock), newVec, i));
-      if (ret < 0) {
-        ret = -errno;
-      }
-      [[fallthrough]];
-    default:
-      break;
-  }
+  ret = logdSend(sock, newVec, i);
 
   if (ret > (ssize_t)sizeof(header)) {
     ret -= sizeof(header);
@@ -103,6 +103,10 @@ struct android_log_logger_list {
   unsigned int tail;
   log_time start;
   pid_t pid;
+  char* filter; /* see android_logger_list_set_filter() */
+  char* regex;
+  unsigned int push_entries; /* see android_logger_list_set_push() */
+  unsigned int push_delay_us;
 };
 
 struct android_log_logger {
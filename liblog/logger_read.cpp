@@ -463,5 +463,56 @@ LIBLOG_ABI_PUBLIC void android_logger_list_free(struct logger_list* logger_list)
     android_logger_free((struct logger*)logger);
   }
 
+  free(logger_list_internal->filter);
+  free(logger_list_internal->regex);
   free(logger_list_internal);
 }
+
+LIBLOG_ABI_PRIVATE int android_logger_list_set_filter(struct logger_list* logger_list,
+                                                      const char* filter, const char* regex) {
+  struct android_log_logger_list* logger_list_internal =
+      (struct android_log_logger_list*)logger_list;
+  char* newFilter = NULL;
+  char* newRegex = NULL;
+
+  if (!logger_list_internal) {
+    return -EINVAL;
+  }
+
+  if (filter && *filter) {
+    newFilter = strdup(filter);
+    if (!newFilter) {
+      return -ENOMEM;
+    }
+  }
+  if (regex && *regex) {
+    newRegex = strdup(regex);
+    if (!newRegex) {
+      free(newFilter);
+      return -ENOMEM;
+    }
+  }
+
+  free(logger_list_internal->filter);
+  logger_list_internal->filter = newFilter;
+  free(logger_list_internal->regex);
+  logger_list_internal->regex = newRegex;
+
+  return 0;
+}
+
+LIBLOG_ABI_PRIVATE int android_logger_list_set_push(struct logger_list* logger_list,
+                                                    unsigned int batch_entries,
+                                                    unsigned int batch_delay_us) {
+  struct android_log_logger_list* logger_list_internal =
+      (struct android_log_logger_list*)logger_list;
+
+  if (!logger_list_internal) {
+    return -EINVAL;
+  }
+
+  logger_list_internal->push_entries = batch_entries;
+  logger_list_internal->push_delay_us = batch_delay_us;
+
+  return 0;
+}
@@ -1853,3 +1853,131 @@ done:
 
   return ret;
 }
+
+static inline uint16_t toLE16(uint16_t val) {
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+  return __builtin_bswap16(val);
+#else
+  return val;
+#endif
+}
+
+static inline uint32_t toLE32(uint32_t val) {
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+  return __builtin_bswap32(val);
+#else
+  return val;
+#endif
+}
+
+LIBLOG_ABI_PUBLIC char* android_log_formatFramedEntry(char* defaultBuffer,
+                                                      size_t defaultBufferSize,
+                                                      log_id_t logId,
+                                                      const AndroidLogEntry* entry,
+                                                      size_t* p_outLength) {
+  android_log_frame_t frame;
+  char* outBuffer = defaultBuffer;
+  size_t tagLen = MIN(entry->tagLen, (size_t)UINT16_MAX);
+  size_t messageLen = entry->messageLen;
+  size_t totalLen = sizeof(frame) + tagLen + messageLen;
+
+  if (totalLen > INT32_MAX) {
+    return NULL;
+  }
+
+  frame.len = toLE32(totalLen);
+  frame.hdr_size = toLE16(sizeof(frame));
+  frame.log_id = logId;
+  frame.priority = entry->priority;
+  frame.uid = toLE32(entry->uid);
+  frame.pid = toLE32(entry->pid);
+  frame.tid = toLE32(entry->tid);
+  frame.sec = toLE32(entry->tv_sec);
+  frame.nsec = toLE32(entry->tv_nsec);
+  frame.tag_len = toLE16(tagLen);
+  frame.reserved = 0;
+
+  if (totalLen > defaultBufferSize) {
+    outBuffer = static_cast<char*>(malloc(totalLen));
+    if (!outBuffer) return NULL;
+  }
+  memcpy(outBuffer, &frame, sizeof(frame));
+  memcpy(outBuffer + sizeof(frame), entry->tag, tagLen);
+  memcpy(outBuffer + sizeof(frame) + tagLen, entry->message, messageLen);
+
+  if (p_outLength) *p_outLength = totalLen;
+  return outBuffer;
+}
+
+LIBLOG_ABI_PUBLIC int android_log_printFramedEntry(int fd, log_id_t logId,
+                                                   const AndroidLogEntry* entry) {
+  char defaultBuffer[512];
+  char* outBuffer;
+  size_t totalLen, written;
+  int ret;
+
+  outBuffer = android_log_formatFramedEntry(defaultBuffer, sizeof(defaultBuffer),
+                                            logId, entry, &totalLen);
+  if (!outBuffer) return -1;
+
+  /* a partial frame would throw the reader off, so write it all */
+  for (written = 0; written < totalLen; written += ret) {
+    ret = write(fd, outBuffer + written, totalLen - written);
+    if (ret < 0) {
+      if (errno == EINTR) {
+        ret = 0;
+        continue;
+      }
+      fprintf(stderr, "+++ LOG: write failed (errno=%d)\n", errno);
+      break;
+    }
+  }
+
+  if (outBuffer != defaultBuffer) {
+    free(outBuffer);
+  }
+
+  return (written < totalLen) ? -1 : (int)totalLen;
+}
+
+LIBLOG_ABI_PUBLIC int android_log_processFramedEntry(const char* buf, size_t len,
+                                                     AndroidLogEntry* entry,
+                                                     log_id_t* logId) {
+  android_log_frame_t frame;
+  size_t frameLen, hdrSize, tagLen;
+
+  if (len < sizeof(frame.len) + sizeof(frame.hdr_size)) {
+    return 0;
+  }
+  memcpy(&frame, buf, sizeof(frame.len) + sizeof(frame.hdr_size));
+  frameLen = toLE32(frame.len);
+  hdrSize = toLE16(frame.hdr_size);
+  if ((hdrSize < sizeof(frame)) || (frameLen < hdrSize) || (frameLen > INT32_MAX)) {
+    return -1;
+  }
+  if (len < frameLen) {
+    return 0;
+  }
+
+  memcpy(&frame, buf, sizeof(frame));
+  tagLen = toLE16(frame.tag_len);
+  if (tagLen > frameLen - hdrSize) {
+    return -1;
+  }
+
+  if (logId) {
+    *logId = static_cast<log_id_t>(frame.log_id);
+  }
+  entry->priority = static_cast<android_LogPriority>(frame.priority);
+  entry->uid = toLE32(frame.uid);
+  entry->pid = toLE32(frame.pid);
+  entry->tid = toLE32(frame.tid);
+  entry->tv_sec = toLE32(frame.sec);
+  entry->tv_nsec = toLE32(frame.nsec);
+  entry->tag = buf + hdrSize;
+  entry->tagLen = tagLen;
+  entry->message = buf + hdrSize + tagLen;
+  entry->messageLen = frameLen - hdrSize - tagLen;
+
+  return frameLen;
+}
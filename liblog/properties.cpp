@@ -18,6 +18,7 @@
 
 #include <ctype.h>
 #include <pthread.h>
+#include <stdatomic.h>
 #include <stdlib.h>
 #include <string.h>
 #define _REALLY_INCLUDE_SYS__SYSTEM_PROPERTIES_H_
@@ -89,7 +90,106 @@ static void refresh_cache(struct cache_char* cache, const char* key) {
   }
 }
 
-static int __android_log_level(const char* tag, size_t len, int default_prio) {
+/*
+ * Lock free cache of the outcome of the property lookups below, per tag. The
+ * property area serial changes with any property set or added, so as long as
+ * it stays the same every outcome remains valid, and the common check is one
+ * load of that serial plus a compare of the tag. Each slot is a sequence
+ * lock, odd while being written; tags too long for a slot are not cached.
+ */
+#define LOGGABLE_CACHE_SLOTS 64
+#define LOGGABLE_CACHE_WORDS 4
+#define LOGGABLE_CACHE_TAG_MAX (LOGGABLE_CACHE_WORDS * sizeof(uint64_t))
+
+struct loggable_cache_slot {
+  atomic_uint_least32_t sequence;
+  atomic_uint_least32_t serial;
+  atomic_uint_least32_t len_c; /* tag length << 8 | resolved character */
+  atomic_uint_fast64_t tag[LOGGABLE_CACHE_WORDS];
+};
+
+static struct loggable_cache_slot loggable_cache[LOGGABLE_CACHE_SLOTS];
+
+static struct loggable_cache_slot* loggable_cache_prepare(
+    const char* tag, size_t len, uint64_t words[LOGGABLE_CACHE_WORDS]) {
+  uint32_t hash = 2166136261U;
+  size_t i;
+
+  memset(words, 0, LOGGABLE_CACHE_TAG_MAX);
+  if (len) memcpy(words, tag, len);
+  for (i = 0; i < len; ++i) {
+    hash = (hash ^ (unsigned char)tag[i]) * 16777619U;
+  }
+  return &loggable_cache[hash % LOGGABLE_CACHE_SLOTS];
+}
+
+static int loggable_cache_find(const char* tag, size_t len, uint32_t serial,
+                               char* c) {
+  uint64_t words[LOGGABLE_CACHE_WORDS];
+  struct loggable_cache_slot* slot;
+  uint32_t sequence, len_c;
+  size_t i;
+  int match;
+
+  if (len > LOGGABLE_CACHE_TAG_MAX) {
+    return 0;
+  }
+  slot = loggable_cache_prepare(tag, len, words);
+
+  sequence = atomic_load_explicit(&slot->sequence, memory_order_acquire);
+  if (sequence & 1) {
+    return 0;
+  }
+  match = (atomic_load_explicit(&slot->serial, memory_order_relaxed) ==
+           serial);
+  len_c = atomic_load_explicit(&slot->len_c, memory_order_relaxed);
+  match = match && ((len_c >> 8) == len);
+  for (i = 0; match && (i < LOGGABLE_CACHE_WORDS); ++i) {
+    match = atomic_load_explicit(&slot->tag[i], memory_order_relaxed) ==
+            words[i];
+  }
+  atomic_thread_fence(memory_order_acquire);
+  if (!match ||
+      (atomic_load_explicit(&slot->sequence, memory_order_relaxed) !=
+       sequence)) {
+    return 0;
+  }
+  *c = len_c & 0xFF;
+  return 1;
+}
+
+static void loggable_cache_store(const char* tag, size_t len,
+                                 uint32_t serial, char c) {
+  uint64_t words[LOGGABLE_CACHE_WORDS];
+  struct loggable_cache_slot* slot;
+  uint32_t sequence;
+  size_t i;
+
+  if (len > LOGGABLE_CACHE_TAG_MAX) {
+    return;
+  }
+  slot = loggable_cache_prepare(tag, len, words);
+
+  /* Another writer holds the slot, leave it the winner. */
+  sequence = atomic_load_explicit(&slot->sequence, memory_order_relaxed);
+  if ((sequence & 1) ||
+      !atomic_compare_exchange_strong_explicit(&slot->sequence, &sequence,
+                                               sequence + 1,
+                                               memory_order_relaxed,
+                                               memory_order_relaxed)) {
+    return;
+  }
+  atomic_thread_fence(memory_order_release);
+  atomic_store_explicit(&slot->serial, serial, memory_order_relaxed);
+  atomic_store_explicit(&slot->len_c, (len << 8) | (unsigned char)c,
+                        memory_order_relaxed);
+  for (i = 0; i < LOGGABLE_CACHE_WORDS; ++i) {
+    atomic_store_explicit(&slot->tag[i], words[i], memory_order_relaxed);
+  }
+  atomic_store_explicit(&slot->sequence, sequence + 2, memory_order_release);
+}
+
+static char __android_log_level_char(const char* tag, size_t len) {
   /* sizeof() is used on this array below */
   static const char log_namespace[] = "persist.log.tag.";
   static const size_t base_offset = 8; /* skip "persist." */
@@ -248,6 +348,20 @@ static int __android_log_level(const char* tag, size_t len, int default_prio) {
     unlock();
   }
 
+  return c;
+}
+
+static int __android_log_level(const char* tag, size_t len, int default_prio) {
+  const size_t taglen = tag ? len : 0;
+  /* Read first, so that a change made while we look is seen next time. */
+  uint32_t serial = __system_property_area_serial();
+  char c;
+
+  if (!loggable_cache_find(tag, taglen, serial, &c)) {
+    c = __android_log_level_char(tag, taglen);
+    loggable_cache_store(tag, taglen, serial, c);
+  }
+
   switch (toupper(c)) {
     /* clang-format off */
     case 'V': return ANDROID_LOG_VERBOSE;
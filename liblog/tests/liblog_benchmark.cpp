@@ -24,12 +24,15 @@
 #include <sys/uio.h>
 #include <unistd.h>
 
+#include <string>
 #include <unordered_set>
+#include <vector>
 
 #include <android-base/file.h>
 #include <benchmark/benchmark.h>
 #include <cutils/sockets.h>
 #include <log/event_tag_map.h>
+#include <log/log_event_list.h>
 #include <log/log_transport.h>
 #include <private/android_logger.h>
 
@@ -90,6 +93,51 @@ static void BM_log_maximum_null(benchmark::State& state) {
 }
 BENCHMARK(BM_log_maximum_null);
 
+/*
+ *	Measure print messages stuffed into the log from several threads of one
+ * process at once, as an app or system_server with many busy threads does.
+ * Compared with BM_log_maximum, shows what the writers cost each other in
+ * liblog and what logd keeps up with.
+ */
+static void BM_log_maximum_threads(benchmark::State& state) {
+  while (state.KeepRunning()) {
+    __android_log_print(ANDROID_LOG_INFO, "BM_log_maximum_threads", "%zu",
+                        state.iterations());
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_log_maximum_threads)->ThreadRange(1, 16)->UseRealTime();
+
+/*
+ *	The same without logd, leaving only the contention between the writers
+ * inside liblog. The transport is switched before the first thread, and only
+ * switched back after the last, passes the KeepRunning() barriers.
+ */
+static void BM_log_maximum_null_threads(benchmark::State& state) {
+  if (state.thread_index == 0) set_log_null();
+  BM_log_maximum_threads(state);
+  if (state.thread_index == 0) set_log_default();
+}
+BENCHMARK(BM_log_maximum_null_threads)->ThreadRange(1, 16)->UseRealTime();
+
+/*
+ *	Measure the cost of the tag length, from a typical tag to the longest a
+ * tag ever reasonably gets, to the null transport so that only the work in
+ * liblog counts.
+ */
+static void BM_log_tag_length(benchmark::State& state) {
+  std::string tag(state.range(0), 't');
+
+  set_log_null();
+  while (state.KeepRunning()) {
+    __android_log_write(ANDROID_LOG_INFO, tag.c_str(), "a typical message");
+  }
+  set_log_default();
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) *
+                          state.range(0));
+}
+BENCHMARK(BM_log_tag_length)->Arg(8)->Arg(32)->Arg(128)->Arg(512);
+
 /*
  *	Measure the time it takes to collect the time using
  * discrete acquisition (state.PauseTiming() to state.ResumeTiming())
@@ -628,6 +676,45 @@ static void BM_log_event_overhead_null(benchmark::State& state) {
 }
 BENCHMARK(BM_log_event_overhead_null);
 
+/*
+ *	Measure an event built with android_log_event_list, the way the framework
+ * reports most of its events: a list of a few integers and a string.
+ * Includes building the list, not only writing it.
+ */
+static void BM_log_event_list(benchmark::State& state) {
+  for (int64_t i = 0; state.KeepRunning(); ++i) {
+    android_log_event_list ctx(42);
+    ctx << (int32_t)i << i << "BM_log_event_list" << (float)i;
+    ctx.write(LOG_ID_EVENTS);
+    state.PauseTiming();
+    logd_yield();
+    state.ResumeTiming();
+  }
+}
+BENCHMARK(BM_log_event_list);
+
+static void BM_log_event_list_null(benchmark::State& state) {
+  set_log_null();
+  BM_log_event_list(state);
+  set_log_default();
+}
+BENCHMARK(BM_log_event_list_null);
+
+/*
+ *	Event lists from several threads at once, without logd.
+ */
+static void BM_log_event_list_null_threads(benchmark::State& state) {
+  if (state.thread_index == 0) set_log_null();
+  for (int64_t i = 0; state.KeepRunning(); ++i) {
+    android_log_event_list ctx(42);
+    ctx << (int32_t)i << i << "BM_log_event_list" << (float)i;
+    ctx.write(LOG_ID_EVENTS);
+  }
+  if (state.thread_index == 0) set_log_default();
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_log_event_list_null_threads)->ThreadRange(1, 16)->UseRealTime();
+
 /*
  *	Measure the time it takes to submit the android event logging call
  * using discrete acquisition under very-light load (<1% CPU utilization).
@@ -825,6 +912,36 @@ static void BM_is_loggable(benchmark::State& state) {
 }
 BENCHMARK(BM_is_loggable);
 
+/*
+ *	Measure __android_log_is_loggable for a spread of tags, each with a
+ * property lookup of its own, as in a process with many logging sites.
+ */
+static void BM_is_loggable_tags(benchmark::State& state) {
+  std::vector<std::string> tags;
+  for (int i = 0; i < state.range(0); ++i) {
+    tags.push_back("BM_is_loggable_" + std::to_string(i));
+  }
+
+  size_t index = 0;
+  while (state.KeepRunning()) {
+    const std::string& tag = tags[index];
+    __android_log_is_loggable_len(ANDROID_LOG_WARN, tag.c_str(), tag.length(),
+                                  ANDROID_LOG_VERBOSE);
+    if (++index >= tags.size()) index = 0;
+  }
+}
+BENCHMARK(BM_is_loggable_tags)->Arg(1)->Arg(16)->Arg(256);
+
+/*
+ *	Measure __android_log_is_loggable from several threads at once, which
+ * all share its cache.
+ */
+static void BM_is_loggable_threads(benchmark::State& state) {
+  BM_is_loggable(state);
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_is_loggable_threads)->ThreadRange(1, 16)->UseRealTime();
+
 /*
  *	Measure the time it takes for android_log_clockid.
  */
@@ -611,6 +611,56 @@ TEST(liblog, __android_log_buf_write_and_print__newline_space_prefix) {
   buf_write_test("\n Hello World \n");
 }
 
+TEST(liblog, android_log_printFramedEntry) {
+  static const char tag[] = "liblog";
+  static const char message[] = "Hello World";
+  AndroidLogEntry entry;
+  memset(&entry, 0, sizeof(entry));
+  entry.tv_sec = 1234;
+  entry.tv_nsec = 5678;
+  entry.priority = ANDROID_LOG_WARN;
+  entry.uid = AID_SYSTEM;
+  entry.pid = getpid();
+  entry.tid = gettid();
+  entry.tag = tag;
+  entry.tagLen = strlen(tag);
+  entry.message = message;
+  entry.messageLen = strlen(message);
+
+  int fd[2];
+  ASSERT_EQ(0, pipe(fd));
+  int len = android_log_printFramedEntry(fd[1], LOG_ID_SYSTEM, &entry);
+  EXPECT_EQ(
+      static_cast<int>(sizeof(android_log_frame_t) + strlen(tag) + strlen(message)),
+      len);
+  EXPECT_EQ(len, android_log_printFramedEntry(fd[1], LOG_ID_SYSTEM, &entry));
+  close(fd[1]);
+
+  char buf[256];
+  ssize_t size = TEMP_FAILURE_RETRY(read(fd[0], buf, sizeof(buf)));
+  close(fd[0]);
+  ASSERT_EQ(2 * len, size);
+
+  AndroidLogEntry parsed;
+  log_id_t logId = LOG_ID_MAX;
+  EXPECT_EQ(0, android_log_processFramedEntry(buf, len - 1, &parsed, &logId));
+  ASSERT_EQ(len, android_log_processFramedEntry(buf, size, &parsed, &logId));
+  EXPECT_EQ(LOG_ID_SYSTEM, logId);
+  EXPECT_EQ(entry.tv_sec, parsed.tv_sec);
+  EXPECT_EQ(entry.tv_nsec, parsed.tv_nsec);
+  EXPECT_EQ(entry.priority, parsed.priority);
+  EXPECT_EQ(entry.uid, parsed.uid);
+  EXPECT_EQ(entry.pid, parsed.pid);
+  EXPECT_EQ(entry.tid, parsed.tid);
+  EXPECT_EQ(std::string(tag), std::string(parsed.tag, parsed.tagLen));
+  EXPECT_EQ(std::string(message), std::string(parsed.message, parsed.messageLen));
+  EXPECT_EQ(len, android_log_processFramedEntry(buf + len, size - len, &parsed, &logId));
+
+  // A tag running past the end of the frame
+  reinterpret_cast<android_log_frame_t*>(buf)->tag_len = len;
+  EXPECT_EQ(-1, android_log_processFramedEntry(buf, size, &parsed, &logId));
+}
+
 #ifdef USING_LOGGER_DEFAULT  // requires blocking reader functionality
 #ifdef TEST_PREFIX
 static unsigned signaled;
@@ -1131,6 +1181,59 @@ TEST(liblog, max_payload) {
 #endif
 }
 
+TEST(liblog, __android_log_set_batching) {
+#if defined(TEST_PREFIX) && defined(__ANDROID__)
+  TEST_PREFIX
+  struct logger_list* logger_list;
+
+  pid_t pid = getpid();
+
+  ASSERT_TRUE(
+      NULL !=
+      (logger_list = android_logger_list_open(
+           LOG_ID_MAIN, ANDROID_LOG_RDONLY | ANDROID_LOG_NONBLOCK, 1000, pid)));
+
+  static const char tag[] = "liblog_batch";
+  static const int num = 32;
+
+  // Hold everything back until the explicit flush.
+  ASSERT_EQ(0, __android_log_set_batching(LOGGER_BATCH_MAX_SIZE, 60000,
+                                          ANDROID_LOG_SILENT));
+  for (int i = 0; i < num; ++i) {
+    EXPECT_LT(0, __android_log_buf_print(LOG_ID_MAIN, ANDROID_LOG_INFO, tag,
+                                         "%d", i));
+  }
+  EXPECT_EQ(0, __android_log_flush_batch());
+  EXPECT_EQ(0, __android_log_set_batching(0, 0, 0));
+  usleep(1000000);
+
+  int count = 0;
+
+  for (;;) {
+    log_msg log_msg;
+    if (android_logger_list_read(logger_list, &log_msg) <= 0) {
+      break;
+    }
+
+    char* data = log_msg.msg();
+    if ((log_msg.entry.pid != pid) || (log_msg.id() != LOG_ID_MAIN) || !data ||
+        strcmp(++data, tag)) {
+      continue;
+    }
+    data += strlen(data) + 1;
+
+    EXPECT_EQ(count, atoi(data));
+    ++count;
+  }
+
+  EXPECT_EQ(SUPPORTS_END_TO_END ? num : 0, count);
+
+  android_logger_list_close(logger_list);
+#else
+  GTEST_LOG_(INFO) << "This test does nothing.\n";
+#endif
+}
+
 TEST(liblog, __android_log_buf_print__maxtag) {
 #ifdef TEST_PREFIX
   TEST_PREFIX
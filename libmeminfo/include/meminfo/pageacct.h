@@ -39,8 +39,20 @@ class PageAcct final {
     bool PageFlags(uint64_t pfn, uint64_t* flags);
     bool PageMapCount(uint64_t pfn, uint64_t* mapcount);
 
+    // Same as above, but reads the values of 'count' consecutive page frames starting
+    // at 'pfn' with a single read.
+    bool PageFlags(uint64_t pfn, uint64_t* flags, size_t count);
+    bool PageMapCount(uint64_t pfn, uint64_t* mapcount, size_t count);
+
     int IsPageIdle(uint64_t pfn);
 
+    // Batched idle page tracking. MarkPagesIdle() sets the idle bit of every page frame in
+    // 'pfns'. GetPagesIdle() reports for each page frame in 'pfns' whether it is still idle,
+    // i.e. whether it wasn't accessed since it was marked. Page frames that share a bitmap
+    // word, or sit in adjacent words, are written or read with a single call.
+    bool MarkPagesIdle(const std::vector<uint64_t>& pfns);
+    bool GetPagesIdle(const std::vector<uint64_t>& pfns, std::vector<bool>* idle);
+
     // The only way to create PageAcct object
     static PageAcct& Instance() {
         static PageAcct instance;
@@ -53,6 +65,7 @@ class PageAcct final {
     PageAcct() : kpagecount_fd_(-1), kpageflags_fd_(-1), pageidle_fd_(-1) {}
     int MarkPageIdle(uint64_t pfn) const;
     int GetPageIdle(uint64_t pfn) const;
+    bool AccessIdleBitmap(const std::vector<uint64_t>& words, uint64_t* bits, bool write) const;
 
     // Non-copyable & Non-movable
     PageAcct(const PageAcct&) = delete;
@@ -18,6 +18,7 @@
 
 #include <sys/types.h>
 
+#include <map>
 #include <string>
 #include <vector>
 
@@ -122,5 +123,15 @@ bool SmapsOrRollupFromFile(const std::string& path, MemUsage* stats);
 // as /proc/<pid>/smaps or /proc/<pid>/smaps_rollup
 bool SmapsOrRollupPssFromFile(const std::string& path, uint64_t* pss);
 
+// Collects the same statistics as ProcMemInfo::SmapsOrRollup for every process in 'pids', using
+// up to 'num_threads' threads (0 means one per online cpu). This is intended for whole-system
+// snapshots: /proc/<pid>/smaps_rollup is read whenever the kernel supports it, so no per-vma
+// data is parsed and no pagemap is walked.
+// The statistics are stored in 'stats' keyed by pid. Processes that could not be read, e.g.
+// because they exited in the meantime, are left out.
+// Returns 'false' if none of the processes could be read.
+bool SmapsOrRollupForPids(const std::vector<pid_t>& pids, std::map<pid_t, MemUsage>* stats,
+                          size_t num_threads = 0);
+
 }  // namespace meminfo
 }  // namespace android
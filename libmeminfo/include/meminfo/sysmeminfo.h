@@ -81,7 +81,7 @@ class SysMemInfo final {
     std::map<std::string, uint64_t> mem_in_kb_;
     bool MemZramDevice(const std::string& zram_dev, uint64_t* mem_zram_dev);
     bool ReadMemInfo(const std::vector<std::string>& tags, const std::string& path,
-                     std::function<void(const std::string&, uint64_t)> store_val);
+                     std::function<void(size_t, uint64_t)> store_val);
 };
 
 // Parse /proc/vmallocinfo and return total physical memory mapped
@@ -0,0 +1,60 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <sys/types.h>
+
+#include <map>
+#include <set>
+#include <vector>
+
+#include "meminfo.h"
+
+namespace android {
+namespace meminfo {
+
+class WorkingSetTracker final {
+    // Tracks the working set of several processes over time using the kernel's idle page
+    // tracking (CONFIG_IDLE_PAGE_TRACKING). Unlike ProcMemInfo::ResetWorkingSet(), this doesn't
+    // clear the referenced bits of the processes' page tables, so it doesn't perturb them or
+    // the page reclaim decisions made for them.
+  public:
+    static bool IsSupported();
+
+    // Starts tracking 'pid' by marking all of its resident pages idle. The first Sample()
+    // after this reports the pages 'pid' accessed in between.
+    // Returns 'false' if the process can't be read or idle page tracking isn't supported.
+    bool AddPid(pid_t pid);
+    void RemovePid(pid_t pid);
+    const std::set<pid_t>& Pids() const { return pids_; }
+
+    // Stores in 'wss' the working set of each tracked process, i.e. the Rss, Pss and Uss of
+    // the resident pages it accessed since the previous Sample() or AddPid(). All pages are
+    // then marked idle again to start the next window, so calling this periodically yields
+    // a working set per period. Processes that have exited are no longer tracked.
+    // As with ProcMemInfo::Wss(), vss is the same as rss.
+    // Returns 'false' if the idle page bitmap or page counts couldn't be accessed.
+    bool Sample(std::map<pid_t, MemUsage>* wss);
+
+  private:
+    static bool ReadPageFrames(pid_t pid, std::vector<uint64_t>* pfns);
+
+    std::set<pid_t> pids_;
+};
+
+}  // namespace meminfo
+}  // namespace android
@@ -26,6 +26,7 @@
 #include <meminfo/pageacct.h>
 #include <meminfo/procmeminfo.h>
 #include <meminfo/sysmeminfo.h>
+#include <meminfo/workingset.h>
 #include <pagemap/pagemap.h>
 
 #include <android-base/file.h>
@@ -263,6 +264,34 @@ TEST_F(ValidatePageAcct, TestPageIdle) {
     }
 }
 
+TEST(TestWorkingSetTracker, TestSample) {
+    // skip the test if idle page tracking isn't enabled
+    if (!WorkingSetTracker::IsSupported()) {
+        return;
+    }
+
+    std::vector<char> buf(64 * getpagesize());
+    memset(buf.data(), 1, buf.size());
+
+    WorkingSetTracker tracker;
+    ASSERT_TRUE(tracker.AddPid(getpid()));
+    ASSERT_FALSE(tracker.AddPid(-1));
+    EXPECT_EQ(tracker.Pids().size(), 1);
+
+    // Everything touched after AddPid() must be part of the working set.
+    memset(buf.data(), 2, buf.size());
+    std::map<pid_t, MemUsage> wss;
+    ASSERT_TRUE(tracker.Sample(&wss));
+    ASSERT_EQ(wss.count(getpid()), 1);
+    EXPECT_GE(wss[getpid()].rss, buf.size());
+    EXPECT_GE(wss[getpid()].uss, buf.size());
+    EXPECT_EQ(wss[getpid()].vss, wss[getpid()].rss);
+
+    tracker.RemovePid(getpid());
+    ASSERT_TRUE(tracker.Sample(&wss));
+    EXPECT_TRUE(wss.empty());
+}
+
 TEST(TestProcMemInfo, MapsEmpty) {
     ProcMemInfo proc_mem(pid);
     const std::vector<Vma>& maps = proc_mem.Maps();
@@ -426,6 +455,21 @@ TEST(TestProcMemInfo, SmapsOrRollupPssSmapsTest) {
     EXPECT_EQ(pss, 19119);
 }
 
+TEST(TestProcMemInfo, SmapsOrRollupForPidsTest) {
+    // The second pid is invalid and must be skipped.
+    std::vector<pid_t> pids = {pid, -1, 1};
+    std::map<pid_t, MemUsage> stats;
+    ASSERT_TRUE(SmapsOrRollupForPids(pids, &stats, 2));
+    ASSERT_EQ(stats.count(-1), 0);
+    ASSERT_EQ(stats.count(pid), 1);
+    EXPECT_GT(stats[pid].rss, 0);
+    EXPECT_GT(stats[pid].pss, 0);
+
+    std::map<pid_t, MemUsage> invalid;
+    EXPECT_FALSE(SmapsOrRollupForPids({-1}, &invalid));
+    EXPECT_TRUE(invalid.empty());
+}
+
 TEST(TestProcMemInfo, ForEachVmaFromFileTest) {
     std::string exec_dir = ::android::base::GetExecutableDirectory();
     std::string path = ::android::base::StringPrintf("%s/testdata1/smaps_short", exec_dir.c_str());
@@ -18,6 +18,8 @@
 #include <fcntl.h>
 #include <unistd.h>
 
+#include <algorithm>
+
 #include <android-base/logging.h>
 #include <android-base/unique_fd.h>
 
@@ -32,6 +34,22 @@ static inline off64_t pfn_to_idle_bitmap_offset(uint64_t pfn) {
     return static_cast<off64_t>((pfn >> 6) << 3);
 }
 
+// Returns the sorted, unique indices of the idle bitmap words holding 'pfns'.
+static std::vector<uint64_t> idle_bitmap_words(const std::vector<uint64_t>& pfns) {
+    std::vector<uint64_t> words;
+    words.reserve(pfns.size());
+    for (uint64_t pfn : pfns) {
+        words.emplace_back(pfn >> 6);
+    }
+    std::sort(words.begin(), words.end());
+    words.erase(std::unique(words.begin(), words.end()), words.end());
+    return words;
+}
+
+static inline size_t idle_bitmap_word_index(const std::vector<uint64_t>& words, uint64_t pfn) {
+    return std::lower_bound(words.begin(), words.end(), pfn >> 6) - words.begin();
+}
+
 uint64_t pagesize(void) {
     static uint64_t pagesize = sysconf(_SC_PAGE_SIZE);
     return pagesize;
@@ -102,6 +120,38 @@ bool PageAcct::PageMapCount(uint64_t pfn, uint64_t* mapcount) {
     return true;
 }
 
+bool PageAcct::PageFlags(uint64_t pfn, uint64_t* flags, size_t count) {
+    if (!flags) return false;
+
+    if (kpageflags_fd_ < 0) {
+        if (!InitPageAcct()) return false;
+    }
+
+    size_t size = count * sizeof(uint64_t);
+    if (pread64(kpageflags_fd_, flags, size, pfn * sizeof(uint64_t)) !=
+        static_cast<ssize_t>(size)) {
+        PLOG(ERROR) << "Failed to read page flags for pages " << pfn << "-" << pfn + count - 1;
+        return false;
+    }
+    return true;
+}
+
+bool PageAcct::PageMapCount(uint64_t pfn, uint64_t* mapcount, size_t count) {
+    if (!mapcount) return false;
+
+    if (kpagecount_fd_ < 0) {
+        if (!InitPageAcct()) return false;
+    }
+
+    size_t size = count * sizeof(uint64_t);
+    if (pread64(kpagecount_fd_, mapcount, size, pfn * sizeof(uint64_t)) !=
+        static_cast<ssize_t>(size)) {
+        PLOG(ERROR) << "Failed to read map count for pages " << pfn << "-" << pfn + count - 1;
+        return false;
+    }
+    return true;
+}
+
 int PageAcct::IsPageIdle(uint64_t pfn) {
     if (pageidle_fd_ < 0) {
         if (!InitPageAcct(true)) return -EOPNOTSUPP;
@@ -138,6 +188,62 @@ int PageAcct::GetPageIdle(uint64_t pfn) const {
     return !!(idle_bits & (1ULL << (pfn % 64)));
 }
 
+bool PageAcct::MarkPagesIdle(const std::vector<uint64_t>& pfns) {
+    if (pageidle_fd_ < 0) {
+        if (!InitPageAcct(true)) return false;
+    }
+
+    std::vector<uint64_t> words = idle_bitmap_words(pfns);
+    std::vector<uint64_t> bits(words.size(), 0);
+    for (uint64_t pfn : pfns) {
+        bits[idle_bitmap_word_index(words, pfn)] |= 1ULL << (pfn % 64);
+    }
+
+    return AccessIdleBitmap(words, bits.data(), true);
+}
+
+bool PageAcct::GetPagesIdle(const std::vector<uint64_t>& pfns, std::vector<bool>* idle) {
+    if (!idle) return false;
+
+    if (pageidle_fd_ < 0) {
+        if (!InitPageAcct(true)) return false;
+    }
+
+    std::vector<uint64_t> words = idle_bitmap_words(pfns);
+    std::vector<uint64_t> bits(words.size());
+    if (!AccessIdleBitmap(words, bits.data(), false)) return false;
+
+    idle->resize(pfns.size());
+    for (size_t i = 0; i < pfns.size(); i++) {
+        (*idle)[i] = !!(bits[idle_bitmap_word_index(words, pfns[i])] & (1ULL << (pfns[i] % 64)));
+    }
+    return true;
+}
+
+// Reads or writes the bitmap 'words' from or to 'bits', with one call per run of adjacent words.
+bool PageAcct::AccessIdleBitmap(const std::vector<uint64_t>& words, uint64_t* bits,
+                                bool write) const {
+    for (size_t i = 0; i < words.size();) {
+        size_t count = 1;
+        while (i + count < words.size() && words[i + count] == words[i] + count) {
+            count++;
+        }
+
+        size_t size = count * sizeof(uint64_t);
+        off64_t offset = static_cast<off64_t>(words[i] * sizeof(uint64_t));
+        ssize_t ret = write ? pwrite64(pageidle_fd_, &bits[i], size, offset)
+                            : pread64(pageidle_fd_, &bits[i], size, offset);
+        if (ret != static_cast<ssize_t>(size)) {
+            PLOG(ERROR) << "Failed to " << (write ? "write" : "read")
+                        << " page idle bitmap for pages " << (words[i] << 6) << "-"
+                        << ((words[i] + count) << 6) - 1;
+            return false;
+        }
+        i += count;
+    }
+    return true;
+}
+
 // Public methods
 bool page_present(uint64_t pagemap_val) {
     return PAGE_PRESENT(pagemap_val);
@@ -21,11 +21,13 @@
 #include <stdio.h>
 #include <unistd.h>
 
+#include <algorithm>
 #include <atomic>
 #include <fstream>
 #include <iostream>
 #include <memory>
 #include <string>
+#include <thread>
 #include <utility>
 
 #include <android-base/file.h>
@@ -218,17 +220,14 @@ bool ProcMemInfo::PageMap(const Vma& vma, std::vector<uint64_t>* pagemap) {
     }
 
     uint64_t nr_pages = (vma.end - vma.start) / getpagesize();
-    pagemap->reserve(nr_pages);
-
-    uint64_t idx = vma.start / getpagesize();
-    uint64_t last = idx + nr_pages;
-    uint64_t val;
-    for (; idx < last; idx++) {
-        if (pread64(pagemap_fd, &val, sizeof(uint64_t), idx * sizeof(uint64_t)) < 0) {
-            PLOG(ERROR) << "Failed to read page frames from page map for pid: " << pid_;
-            return false;
-        }
-        pagemap->emplace_back(val);
+    pagemap->resize(nr_pages);
+
+    size_t bytes = nr_pages * sizeof(uint64_t);
+    off64_t offset = vma.start / getpagesize() * sizeof(uint64_t);
+    if (pread64(pagemap_fd, pagemap->data(), bytes, offset) != static_cast<ssize_t>(bytes)) {
+        PLOG(ERROR) << "Failed to read page frames from page map for pid: " << pid_;
+        pagemap->clear();
+        return false;
     }
 
     return true;
@@ -298,6 +297,38 @@ bool ProcMemInfo::ReadVmaStats(int pagemap_fd, Vma& vma, bool get_wss, bool use_
 
     std::unique_ptr<uint64_t[]> pg_flags(new uint64_t[num_pages]);
     std::unique_ptr<uint64_t[]> pg_counts(new uint64_t[num_pages]);
+    // Resident pages are often physically contiguous, so the flags and map counts are read
+    // for each run of consecutive page frames at once instead of page by page.
+    for (uint64_t i = 0; i < num_pages;) {
+        uint64_t p = pg_frames[i];
+        if (!PAGE_PRESENT(p) || PAGE_SWAPPED(p)) {
+            ++i;
+            continue;
+        }
+
+        uint64_t page_frame = PAGE_PFN(p);
+        uint64_t run = 1;
+        for (; i + run < num_pages; ++run) {
+            uint64_t next = pg_frames[i + run];
+            if (!PAGE_PRESENT(next) || PAGE_SWAPPED(next) || PAGE_PFN(next) != page_frame + run) {
+                break;
+            }
+        }
+
+        if (!pinfo.PageFlags(page_frame, &pg_flags[i], run)) {
+            LOG(ERROR) << "Failed to get page flags for " << page_frame << " in process " << pid_;
+            swap_offsets_.clear();
+            return false;
+        }
+
+        if (!pinfo.PageMapCount(page_frame, &pg_counts[i], run)) {
+            LOG(ERROR) << "Failed to get page count for " << page_frame << " in process " << pid_;
+            swap_offsets_.clear();
+            return false;
+        }
+        i += run;
+    }
+
     for (uint64_t i = 0; i < num_pages; ++i) {
         if (!get_wss) {
             vma.usage.vss += pagesz;
@@ -312,21 +343,10 @@ bool ProcMemInfo::ReadVmaStats(int pagemap_fd, Vma& vma, bool get_wss, bool use_
         }
 
         uint64_t page_frame = PAGE_PFN(p);
-        if (!pinfo.PageFlags(page_frame, &pg_flags[i])) {
-            LOG(ERROR) << "Failed to get page flags for " << page_frame << " in process " << pid_;
-            swap_offsets_.clear();
-            return false;
-        }
 
         // skip unwanted pages from the count
         if ((pg_flags[i] & pgflags_mask_) != pgflags_) continue;
 
-        if (!pinfo.PageMapCount(page_frame, &pg_counts[i])) {
-            LOG(ERROR) << "Failed to get page count for " << page_frame << " in process " << pid_;
-            swap_offsets_.clear();
-            return false;
-        }
-
         // Page was unmapped between the presence check at the beginning of the loop and here.
         if (pg_counts[i] == 0) {
             pg_frames[i] = 0;
@@ -490,6 +510,48 @@ bool SmapsOrRollupFromFile(const std::string& path, MemUsage* stats) {
     return true;
 }
 
+bool SmapsOrRollupForPids(const std::vector<pid_t>& pids, std::map<pid_t, MemUsage>* stats,
+                          size_t num_threads) {
+    stats->clear();
+    if (pids.empty()) return false;
+
+    // Probe once up front with our own pid, which is always readable, so that the workers
+    // don't race on the first check and an exited process can't mark rollup as unsupported.
+    const char* file = IsSmapsRollupSupported(getpid()) ? "smaps_rollup" : "smaps";
+
+    std::vector<MemUsage> usages(pids.size());
+    std::unique_ptr<bool[]> valid(new bool[pids.size()]());
+    std::atomic<size_t> next(0);
+    auto worker = [&]() {
+        for (size_t i = next++; i < pids.size(); i = next++) {
+            std::string path = ::android::base::StringPrintf("/proc/%d/%s", pids[i], file);
+            valid[i] = SmapsOrRollupFromFile(path, &usages[i]);
+        }
+    };
+
+    if (num_threads == 0) {
+        num_threads = std::max(1L, sysconf(_SC_NPROCESSORS_ONLN));
+    }
+    num_threads = std::min(num_threads, pids.size());
+
+    // The calling thread does its share of the work too.
+    std::vector<std::thread> threads;
+    for (size_t i = 1; i < num_threads; i++) {
+        threads.emplace_back(worker);
+    }
+    worker();
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    for (size_t i = 0; i < pids.size(); i++) {
+        if (valid[i]) {
+            stats->emplace(pids[i], usages[i]);
+        }
+    }
+    return !stats->empty();
+}
+
 bool SmapsOrRollupPssFromFile(const std::string& path, uint64_t* pss) {
     auto fp = std::unique_ptr<FILE, decltype(&fclose)>{fopen(path.c_str(), "re"), fclose};
     if (fp == nullptr) {
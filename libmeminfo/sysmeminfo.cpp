@@ -54,8 +54,8 @@ const std::vector<std::string> SysMemInfo::kDefaultSysMemInfoTags = {
 };
 
 bool SysMemInfo::ReadMemInfo(const std::string& path) {
-    return ReadMemInfo(SysMemInfo::kDefaultSysMemInfoTags, path,
-                       [&](const std::string& tag, uint64_t val) { mem_in_kb_[tag] = val; });
+    const auto& tags = SysMemInfo::kDefaultSysMemInfoTags;
+    return ReadMemInfo(tags, path, [&](size_t index, uint64_t val) { mem_in_kb_[tags[index]] = val; });
 }
 
 bool SysMemInfo::ReadMemInfo(std::vector<uint64_t>* out, const std::string& path) {
@@ -67,16 +67,8 @@ bool SysMemInfo::ReadMemInfo(const std::vector<std::string>& tags, std::vector<u
     out->clear();
     out->resize(tags.size());
 
-    return ReadMemInfo(tags, path, [&]([[maybe_unused]] const std::string& tag, uint64_t val) {
-        auto it = std::find(tags.begin(), tags.end(), tag);
-        if (it == tags.end()) {
-            LOG(ERROR) << "Tried to store invalid tag: " << tag;
-            return;
-        }
-        auto index = std::distance(tags.begin(), it);
-        // store the values in the same order as the tags
-        out->at(index) = val;
-    });
+    // store the values in the same order as the tags
+    return ReadMemInfo(tags, path, [&](size_t index, uint64_t val) { (*out)[index] = val; });
 }
 
 uint64_t SysMemInfo::ReadVmallocInfo() {
@@ -120,7 +112,7 @@ bool SysMemInfo::ReadMemInfo(const std::vector<std::string>& tags, const std::st
 
 #else
 bool SysMemInfo::ReadMemInfo(const std::vector<std::string>& tags, const std::string& path,
-                             std::function<void(const std::string&, uint64_t)> store_val) {
+                             std::function<void(size_t, uint64_t)> store_val) {
     char buffer[4096];
     int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
     if (fd < 0) {
@@ -135,41 +127,43 @@ bool SysMemInfo::ReadMemInfo(const std::vector<std::string>& tags, const std::st
     }
 
     buffer[len] = '\0';
-    char* p = buffer;
     uint32_t found = 0;
+
+    // Special case for "Zram:" tag that android_os_Debug and friends look
+    // up along with the rest of the numbers from /proc/meminfo
+    auto zram_tag = std::find(tags.begin(), tags.end(), "Zram:");
+    if (zram_tag != tags.end()) {
+        store_val(std::distance(tags.begin(), zram_tag), mem_zram_kb());
+        found++;
+    }
+
+    char* p = buffer;
+    char* const end = buffer + len;
     uint32_t lineno = 0;
-    bool zram_tag_found = false;
-    while (*p && found < tags.size()) {
-        for (auto& tag : tags) {
-            // Special case for "Zram:" tag that android_os_Debug and friends look
-            // up along with the rest of the numbers from /proc/meminfo
-            if (!zram_tag_found && tag == "Zram:") {
-                store_val(tag, mem_zram_kb());
-                zram_tag_found = true;
-                found++;
+    while (p < end && found < tags.size()) {
+        char* eol = static_cast<char*>(memchr(p, '\n', end - p));
+        if (eol == nullptr) eol = end;
+        const size_t line_len = eol - p;
+
+        for (size_t i = 0; i < tags.size(); i++) {
+            const std::string& tag = tags[i];
+            // Comparing the first character before the rest rules out almost every tag cheaply.
+            if (tag.size() > line_len || p[0] != tag[0] || memcmp(p, tag.data(), tag.size())) {
                 continue;
             }
-
-            if (strncmp(p, tag.c_str(), tag.size()) == 0) {
-                p += tag.size();
-                while (*p == ' ') p++;
-                char* endptr = nullptr;
-                uint64_t val = strtoull(p, &endptr, 10);
-                if (p == endptr) {
-                    PLOG(ERROR) << "Failed to parse line:" << lineno + 1 << " in file: " << path;
-                    return false;
-                }
-                store_val(tag, val);
-                p = endptr;
-                found++;
-                break;
+            char* val_start = p + tag.size();
+            char* endptr = nullptr;
+            uint64_t val = strtoull(val_start, &endptr, 10);
+            if (val_start == endptr) {
+                PLOG(ERROR) << "Failed to parse line:" << lineno + 1 << " in file: " << path;
+                return false;
             }
+            store_val(i, val);
+            found++;
+            break;
         }
 
-        while (*p && *p != '\n') {
-            p++;
-        }
-        if (*p) p++;
+        p = eol + 1;
         lineno++;
     }
 
@@ -0,0 +1,159 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <memory>
+#include <string>
+#include <utility>
+
+#include <android-base/logging.h>
+#include <android-base/stringprintf.h>
+#include <android-base/unique_fd.h>
+#include <procinfo/process_map.h>
+
+#include "meminfo_private.h"
+
+namespace android {
+namespace meminfo {
+
+bool WorkingSetTracker::IsSupported() {
+    return PageAcct::KernelHasPageIdle();
+}
+
+bool WorkingSetTracker::AddPid(pid_t pid) {
+    std::vector<uint64_t> pfns;
+    if (!ReadPageFrames(pid, &pfns)) {
+        return false;
+    }
+
+    if (!PageAcct::Instance().MarkPagesIdle(pfns)) {
+        LOG(ERROR) << "Failed to mark the pages of process " << pid << " idle";
+        return false;
+    }
+
+    pids_.insert(pid);
+    return true;
+}
+
+void WorkingSetTracker::RemovePid(pid_t pid) {
+    pids_.erase(pid);
+}
+
+bool WorkingSetTracker::Sample(std::map<pid_t, MemUsage>* wss) {
+    PageAcct& pinfo = PageAcct::Instance();
+    uint64_t pagesz = getpagesize();
+
+    wss->clear();
+    // The accessed pages of every process are collected before any page is marked idle again,
+    // so that all processes are measured over the same window even if they share pages.
+    std::vector<uint64_t> all_pfns;
+    for (auto it = pids_.begin(); it != pids_.end();) {
+        pid_t pid = *it;
+        std::vector<uint64_t> pfns;
+        if (!ReadPageFrames(pid, &pfns)) {
+            it = pids_.erase(it);
+            continue;
+        }
+        ++it;
+
+        std::vector<bool> idle;
+        if (!pinfo.GetPagesIdle(pfns, &idle)) {
+            LOG(ERROR) << "Failed to read the idle state of the pages of process " << pid;
+            return false;
+        }
+
+        MemUsage& usage = (*wss)[pid];
+        for (size_t i = 0; i < pfns.size(); i++) {
+            if (idle[i]) continue;
+
+            // Accessed pages of a vma usually are contiguous, so their map counts
+            // are read a run at a time.
+            size_t run = 1;
+            while (i + run < pfns.size() && !idle[i + run] && pfns[i + run] == pfns[i] + run) {
+                run++;
+            }
+            std::unique_ptr<uint64_t[]> counts(new uint64_t[run]);
+            if (!pinfo.PageMapCount(pfns[i], counts.get(), run)) {
+                LOG(ERROR) << "Failed to get page counts for process " << pid;
+                return false;
+            }
+
+            for (size_t j = 0; j < run; j++) {
+                // The page was unmapped since its page frame was read.
+                if (counts[j] == 0) continue;
+                usage.rss += pagesz;
+                usage.pss += pagesz / counts[j];
+                usage.uss += counts[j] == 1 ? pagesz : 0;
+            }
+            i += run - 1;
+        }
+        usage.vss = usage.rss;
+
+        all_pfns.insert(all_pfns.end(), pfns.begin(), pfns.end());
+    }
+
+    if (!pinfo.MarkPagesIdle(all_pfns)) {
+        LOG(ERROR) << "Failed to mark the tracked pages idle";
+        return false;
+    }
+    return true;
+}
+
+bool WorkingSetTracker::ReadPageFrames(pid_t pid, std::vector<uint64_t>* pfns) {
+    std::vector<std::pair<uint64_t, uint64_t>> vmas;
+    std::string maps_file = ::android::base::StringPrintf("/proc/%d/maps", pid);
+    if (!::android::procinfo::ReadMapFile(
+                maps_file, [&](uint64_t start, uint64_t end, uint16_t, uint64_t, const char*) {
+                    vmas.emplace_back(start, end);
+                })) {
+        LOG(ERROR) << "Failed to parse " << maps_file;
+        return false;
+    }
+
+    std::string pagemap_file = ::android::base::StringPrintf("/proc/%d/pagemap", pid);
+    ::android::base::unique_fd pagemap_fd(
+            TEMP_FAILURE_RETRY(open(pagemap_file.c_str(), O_RDONLY | O_CLOEXEC)));
+    if (pagemap_fd < 0) {
+        PLOG(ERROR) << "Failed to open " << pagemap_file;
+        return false;
+    }
+
+    uint64_t pagesz = getpagesize();
+    std::vector<uint64_t> pagemap;
+    pfns->clear();
+    for (const auto& [start, end] : vmas) {
+        uint64_t num_pages = (end - start) / pagesz;
+        pagemap.resize(num_pages);
+        size_t bytes = num_pages * sizeof(uint64_t);
+        if (pread64(pagemap_fd, pagemap.data(), bytes, start / pagesz * sizeof(uint64_t)) !=
+            static_cast<ssize_t>(bytes)) {
+            PLOG(ERROR) << "Failed to read page frames from page map for pid: " << pid;
+            return false;
+        }
+
+        for (uint64_t p : pagemap) {
+            if (PAGE_PRESENT(p) && !PAGE_SWAPPED(p)) {
+                pfns->emplace_back(PAGE_PFN(p));
+            }
+        }
+    }
+    return true;
+}
+
+}  // namespace meminfo
+}  // namespace android
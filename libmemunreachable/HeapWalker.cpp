@@ -16,9 +16,15 @@
 
 #include <errno.h>
 #include <inttypes.h>
+#include <limits.h>
+#include <linux/futex.h>
+#include <sched.h>
 #include <sys/mman.h>
+#include <sys/prctl.h>
+#include <sys/syscall.h>
 #include <unistd.h>
 
+#include <algorithm>
 #include <map>
 #include <utility>
 
@@ -26,10 +32,120 @@
 #include "HeapWalker.h"
 #include "LeakFolding.h"
 #include "ScopedSignalHandler.h"
+#include "Stack.h"
 #include "log.h"
 
 namespace android {
 
+// Ranges larger than this are walked a piece at a time, so that the rest of a
+// large root or anonymous mapping can be picked up by another walker.
+static constexpr size_t kWalkChunkSize = 64 * 1024;
+
+static constexpr size_t kWalkerStackSize = 64 * 1024;
+
+static long futex(int* uaddr, int op, int val) {
+  return syscall(SYS_futex, uaddr, op, val, nullptr, nullptr, 0);
+}
+
+// Ranges waiting to be walked, shared between the walker threads.  A walker
+// that runs out of work of its own waits here until another walker shares
+// some, or until all of them are waiting, which means the walk is done.
+//
+// The walker threads are not pthreads, and libc mutexes may skip the atomic
+// operations when libc believes the process is single threaded, so the queue
+// is locked with futexes directly.
+class HeapWalker::WorkQueue {
+ public:
+  WorkQueue(const Allocator<Range>& allocator, size_t walkers)
+      : ranges_(allocator), num_walkers_(walkers), waiting_(0), lock_(0), seq_(0) {}
+
+  template <class It>
+  void Push(It begin, It end) {
+    Lock();
+    ranges_.insert(ranges_.end(), begin, end);
+    NotifyAll();
+    Unlock();
+  }
+
+  // Returns false once there is nothing left to walk.
+  bool Pop(Range* range) {
+    Lock();
+    __atomic_fetch_add(&waiting_, 1, __ATOMIC_RELAXED);
+    while (ranges_.empty() && waiting_ < num_walkers_) {
+      Wait();
+    }
+    bool ret = !ranges_.empty();
+    if (ret) {
+      __atomic_fetch_sub(&waiting_, 1, __ATOMIC_RELAXED);
+      *range = ranges_.back();
+      ranges_.pop_back();
+    } else {
+      NotifyAll();
+    }
+    Unlock();
+    return ret;
+  }
+
+  // Called for a walker thread that could not be started.
+  void RemoveWalker() {
+    Lock();
+    num_walkers_--;
+    NotifyAll();
+    Unlock();
+  }
+
+  // Whether some walker is waiting for work.  Read without the lock, so it is
+  // only a hint for when to share.
+  bool Starved() const { return __atomic_load_n(&waiting_, __ATOMIC_RELAXED) > 0; }
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(WorkQueue);
+
+  // lock_ is 0 when unlocked, 1 when locked and 2 when locked with waiters.
+  void Lock() {
+    int c = 0;
+    if (__atomic_compare_exchange_n(&lock_, &c, 1, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+      return;
+    }
+    while (__atomic_exchange_n(&lock_, 2, __ATOMIC_ACQUIRE) != 0) {
+      futex(&lock_, FUTEX_WAIT_PRIVATE, 2);
+    }
+  }
+
+  void Unlock() {
+    if (__atomic_exchange_n(&lock_, 0, __ATOMIC_RELEASE) == 2) {
+      futex(&lock_, FUTEX_WAKE_PRIVATE, 1);
+    }
+  }
+
+  // Called with the lock held.  NotifyAll is also only called with the lock
+  // held, so a change to seq_ between Unlock and FUTEX_WAIT isn't missed.
+  void Wait() {
+    int seq = __atomic_load_n(&seq_, __ATOMIC_RELAXED);
+    Unlock();
+    futex(&seq_, FUTEX_WAIT_PRIVATE, seq);
+    Lock();
+  }
+
+  void NotifyAll() {
+    __atomic_fetch_add(&seq_, 1, __ATOMIC_RELAXED);
+    futex(&seq_, FUTEX_WAKE_PRIVATE, INT_MAX);
+  }
+
+  allocator::vector<Range> ranges_;
+  size_t num_walkers_;
+  size_t waiting_;
+  int lock_;
+  int seq_;
+};
+
+struct HeapWalker::WalkerThreadArgs {
+  HeapWalker* heap_walker;
+  Walker* walker;
+  WorkQueue* queue;
+  pid_t tid;
+};
+
 bool HeapWalker::Allocation(uintptr_t begin, uintptr_t end) {
   if (end == begin) {
     end = begin + 1;
@@ -47,6 +163,7 @@ bool HeapWalker::Allocation(uintptr_t begin, uintptr_t end) {
     valid_allocations_range_.begin = std::min(valid_allocations_range_.begin, begin);
     valid_allocations_range_.end = std::max(valid_allocations_range_.end, end);
     allocation_bytes_ += range.size();
+    index_valid_ = false;
     return true;
   } else {
     Range overlap = inserted.first->first;
@@ -59,38 +176,203 @@ bool HeapWalker::Allocation(uintptr_t begin, uintptr_t end) {
   }
 }
 
-bool HeapWalker::WordContainsAllocationPtr(uintptr_t word_ptr, Range* range, AllocationInfo** info) {
-  walking_ptr_ = word_ptr;
+bool HeapWalker::WordContainsAllocationPtr(Walker& walker, uintptr_t word_ptr, Range* range,
+                                           AllocationInfo** info) {
+  walker.ptr = word_ptr;
   // This access may segfault if the process under test has done something strange,
   // for example mprotect(PROT_NONE) on a native heap page.  If so, it will be
   // caught and handled by mmaping a zero page over the faulting page.
   uintptr_t value = *reinterpret_cast<uintptr_t*>(word_ptr);
-  walking_ptr_ = 0;
+  walker.ptr = 0;
   if (value >= valid_allocations_range_.begin && value < valid_allocations_range_.end) {
-    AllocationMap::iterator it = allocations_.find(Range{value, value + 1});
-    if (it != allocations_.end()) {
-      *range = it->first;
-      *info = &it->second;
-      return true;
+    // The last allocation starting at or before value is the only one that
+    // can contain it.  The search is branchless, since whether a word is a
+    // pointer is about as predictable as a coin flip.
+    const uintptr_t* base = index_begins_.data();
+    size_t n = index_begins_.size();
+    while (n > 1) {
+      size_t half = n / 2;
+      base = (base[half] <= value) ? base + half : base;
+      n -= half;
+    }
+    if (n == 1 && *base <= value) {
+      AllocationMap::value_type* entry = index_entries_[base - index_begins_.data()];
+      if (value < entry->first.end) {
+        *range = entry->first;
+        *info = &entry->second;
+        return true;
+      }
     }
   }
   return false;
 }
 
-void HeapWalker::RecurseRoot(const Range& root) {
-  allocator::vector<Range> to_do(1, root, allocator_);
-  while (!to_do.empty()) {
-    Range range = to_do.back();
-    to_do.pop_back();
+void HeapWalker::BuildIndex() {
+  index_begins_.clear();
+  index_entries_.clear();
+  index_begins_.reserve(allocations_.size());
+  index_entries_.reserve(allocations_.size());
+  for (auto& it : allocations_) {
+    index_begins_.push_back(it.first.begin);
+    index_entries_.push_back(&it);
+  }
+  index_valid_ = true;
+}
+
+void HeapWalker::TrackPointerFreePages(const allocator::vector<uintptr_t>& skip_pages) {
+  track_pages_ = true;
+  skip_pages_.assign(skip_pages.begin(), skip_pages.end());
+}
+
+void HeapWalker::BuildPages() {
+  const uintptr_t page_size = sysconf(_SC_PAGE_SIZE);
+  pages_.clear();
+  auto add = [&](const Range& range) {
+    for (uintptr_t page = range.begin & ~(page_size - 1); page < range.end; page += page_size) {
+      if (pages_.empty() || pages_.back() != page) {
+        pages_.push_back(page);
+      }
+    }
+  };
+  for (auto& it : allocations_) {
+    add(it.first);
+  }
+  for (auto& root : roots_) {
+    add(root);
+  }
+  std::sort(pages_.begin(), pages_.end());
+  pages_.erase(std::unique(pages_.begin(), pages_.end()), pages_.end());
+
+  page_states_.assign(pages_.size(), kPageUnknown);
+  auto page = pages_.begin();
+  for (uintptr_t skip : skip_pages_) {
+    page = std::lower_bound(page, pages_.end(), skip);
+    if (page == pages_.end()) {
+      break;
+    }
+    if (*page == skip) {
+      page_states_[page - pages_.begin()] = kPageSkip;
+    }
+  }
+}
+
+void HeapWalker::PointerFreePages(allocator::vector<uintptr_t>& pages) {
+  pages.clear();
+  for (size_t i = 0; i < pages_.size(); i++) {
+    if (page_states_[i] == kPagePointerFree || page_states_[i] == kPageSkip) {
+      pages.push_back(pages_[i]);
+    }
+  }
+}
+
+// Like ForEachPtrInRange, but with page tracking skips the pages in
+// skip_pages_, and reads the whole of each page it is the first to visit to
+// find out whether the page holds any pointers.
+template <class F>
+void HeapWalker::ForEachPtrInTrackedRange(Walker& walker, const Range& range, F&& f) {
+  if (!track_pages_) {
+    ForEachPtrInRange(walker, range, f);
+    return;
+  }
+
+  const uintptr_t page_size = sysconf(_SC_PAGE_SIZE);
+  const uintptr_t begin = (range.begin + (sizeof(uintptr_t) - 1)) & ~(sizeof(uintptr_t) - 1);
+  auto page_it = std::lower_bound(pages_.begin(), pages_.end(), range.begin & ~(page_size - 1));
+  for (uintptr_t pos = begin; pos < range.end;) {
+    uintptr_t page = pos & ~(page_size - 1);
+    uintptr_t next = std::min(page + page_size, range.end);
+    while (page_it != pages_.end() && *page_it < page) {
+      page_it++;
+    }
+    if (page_it == pages_.end() || *page_it != page) {
+      // Not a page of a root or allocation, e.g. the root_vals_ buffer.
+      ForEachPtrInRange(walker, Range{pos, next}, f);
+      pos = next;
+      continue;
+    }
+
+    uint8_t* state = &page_states_[page_it - pages_.begin()];
+    uint8_t unknown = kPageUnknown;
+    if (__atomic_load_n(state, __ATOMIC_RELAXED) == kPageSkip) {
+      // Held no pointers last time and hasn't been written since.
+    } else if (__atomic_compare_exchange_n(state, &unknown, kPageClassifying, false,
+                                           __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+      // A page that faults is read as zeroes, which says nothing about what the
+      // process has in it, so any fault in the meantime counts as pointers.
+      size_t segv_page_count = __atomic_load_n(&segv_page_count_, __ATOMIC_RELAXED);
+      bool pointers = false;
+      for (uintptr_t i = page; i < page + page_size; i += sizeof(uintptr_t)) {
+        Range ref_range;
+        AllocationInfo* ref_info;
+        if (WordContainsAllocationPtr(walker, i, &ref_range, &ref_info)) {
+          pointers = true;
+          if (i >= pos && i < range.end) {
+            f(ref_range, ref_info);
+          }
+        }
+      }
+      if (__atomic_load_n(&segv_page_count_, __ATOMIC_RELAXED) != segv_page_count) {
+        pointers = true;
+      }
+      __atomic_store_n(state, pointers ? kPagePointers : kPagePointerFree, __ATOMIC_RELAXED);
+    } else {
+      ForEachPtrInRange(walker, Range{pos, next}, f);
+    }
+    pos = next;
+  }
+}
+
+void HeapWalker::Walk(Walker& walker, WorkQueue& queue) {
+  // Each walker has its own heap for its stack of ranges, so walkers only
+  // touch shared state through the queue.
+  Heap heap;
+  allocator::vector<Range> to_do(heap);
+  Range range;
+  while (queue.Pop(&range)) {
+    to_do.push_back(range);
+    while (!to_do.empty()) {
+      range = to_do.back();
+      to_do.pop_back();
+      if (range.size() > kWalkChunkSize) {
+        uintptr_t split = (range.begin + kWalkChunkSize) & ~(sizeof(uintptr_t) - 1);
+        to_do.push_back(Range{split, range.end});
+        range.end = split;
+      }
+
+      walker.range = range;
+      ForEachPtrInTrackedRange(walker, range, [&](Range& ref_range, AllocationInfo* ref_info) {
+        // Other walkers may find the same allocation, only the one that
+        // marks it walks it.
+        if (!__atomic_load_n(&ref_info->referenced_from_root, __ATOMIC_RELAXED) &&
+            !__atomic_exchange_n(&ref_info->referenced_from_root, true, __ATOMIC_RELAXED)) {
+          to_do.push_back(ref_range);
+        }
+      });
+      walker.range = Range{0, 0};
 
-    walking_range_ = range;
-    ForEachPtrInRange(range, [&](Range& ref_range, AllocationInfo* ref_info) {
-      if (!ref_info->referenced_from_root) {
-        ref_info->referenced_from_root = true;
-        to_do.push_back(ref_range);
+      if (to_do.size() > 1 && queue.Starved()) {
+        // Share the oldest half, those are the most likely to lead to more work.
+        auto half = to_do.begin() + to_do.size() / 2;
+        queue.Push(to_do.begin(), half);
+        to_do.erase(to_do.begin(), half);
       }
-    });
-    walking_range_ = Range{0, 0};
+    }
+  }
+}
+
+int HeapWalker::WalkerThread(void* arg) {
+  prctl(PR_SET_NAME, "libmemunreachable heap walker");
+  WalkerThreadArgs* args = reinterpret_cast<WalkerThreadArgs*>(arg);
+  args->heap_walker->Walk(*args->walker, *args->queue);
+  return 0;
+}
+
+// The kernel clears *tid and wakes it once the thread has exited, after which
+// its stack is no longer in use.
+static void WaitForWalkerThread(pid_t* tid) {
+  pid_t t;
+  while ((t = __atomic_load_n(tid, __ATOMIC_ACQUIRE)) != 0) {
+    futex(tid, FUTEX_WAIT, t);
   }
 }
 
@@ -115,21 +397,61 @@ size_t HeapWalker::AllocationBytes() {
   return allocation_bytes_;
 }
 
-bool HeapWalker::DetectLeaks() {
-  // Recursively walk pointers from roots to mark referenced allocations
-  for (auto it = roots_.begin(); it != roots_.end(); it++) {
-    RecurseRoot(*it);
+bool HeapWalker::DetectLeaks(size_t num_walkers) {
+  num_walkers = std::max<size_t>(1, std::min(num_walkers, kMaxWalkers));
+
+  if (!index_valid_) {
+    BuildIndex();
+  }
+  if (track_pages_) {
+    BuildPages();
   }
 
+  // Recursively walk pointers from roots to mark referenced allocations
+  WorkQueue queue(allocator_, num_walkers);
+  queue.Push(roots_.begin(), roots_.end());
+
   Range vals;
   vals.begin = reinterpret_cast<uintptr_t>(root_vals_.data());
   vals.end = vals.begin + root_vals_.size() * sizeof(uintptr_t);
+  queue.Push(&vals, &vals + 1);
+
+  // The extra walkers are threads of this process created directly with
+  // clone, like PtracerThread, so that they allocate only from allocator_.
+  // They share the signal handlers, so a fault that HandleSegFault doesn't
+  // expect still takes down the whole process.
+  allocator::vector<Allocator<Stack>::unique_ptr> stacks(allocator_);
+  allocator::vector<WalkerThreadArgs> threads(allocator_);
+  threads.reserve(num_walkers - 1);
+  for (size_t i = 1; i < num_walkers; i++) {
+    stacks.push_back(Allocator<Stack>(allocator_).make_unique(kWalkerStackSize));
+    threads.push_back(WalkerThreadArgs{this, &walkers_[i], &queue, 0});
+    WalkerThreadArgs& thread = threads.back();
+    void* stack_top = stacks.back()->top();
+    int flags = CLONE_VM | CLONE_FS | CLONE_FILES | CLONE_SIGHAND | CLONE_THREAD | CLONE_SYSVSEM |
+                CLONE_PARENT_SETTID | CLONE_CHILD_CLEARTID;
+    if (stack_top == nullptr ||
+        clone(WalkerThread, stack_top, flags, &thread, &thread.tid, nullptr, &thread.tid) < 0) {
+      MEM_ALOGW("failed to start heap walker thread: %s", strerror(errno));
+      thread.tid = 0;
+      queue.RemoveWalker();
+    }
+  }
 
-  RecurseRoot(vals);
+  Walk(walkers_[0], queue);
+
+  for (auto& thread : threads) {
+    WaitForWalkerThread(&thread.tid);
+  }
 
   if (segv_page_count_ > 0) {
     MEM_ALOGE("%zu pages skipped due to segfaults", segv_page_count_);
   }
+  if (track_pages_) {
+    MEM_ALOGI("%zu of %zu pages skipped as unchanged",
+              static_cast<size_t>(std::count(page_states_.begin(), page_states_.end(), kPageSkip)),
+              pages_.size());
+  }
 
   return true;
 }
@@ -182,19 +504,20 @@ static bool MapOverPage(void* addr) {
 void HeapWalker::HandleSegFault(ScopedSignalHandler& handler, int signal, siginfo_t* si,
                                 void* /*uctx*/) {
   uintptr_t addr = reinterpret_cast<uintptr_t>(si->si_addr);
-  if (addr != walking_ptr_) {
+  Walker* walker = std::find_if(std::begin(walkers_), std::end(walkers_),
+                                [addr](const Walker& w) { return addr != 0 && w.ptr == addr; });
+  if (walker == std::end(walkers_)) {
     handler.reset();
     return;
   }
-  if (!segv_logged_) {
+  if (!__atomic_exchange_n(&segv_logged_, true, __ATOMIC_RELAXED)) {
     MEM_ALOGW("failed to read page at %p, signal %d", si->si_addr, signal);
-    if (walking_range_.begin != 0U) {
-      MEM_ALOGW("while walking range %p-%p", reinterpret_cast<void*>(walking_range_.begin),
-                reinterpret_cast<void*>(walking_range_.end));
+    if (walker->range.begin != 0U) {
+      MEM_ALOGW("while walking range %p-%p", reinterpret_cast<void*>(walker->range.begin),
+                reinterpret_cast<void*>(walker->range.end));
     }
-    segv_logged_ = true;
   }
-  segv_page_count_++;
+  __atomic_fetch_add(&segv_page_count_, 1, __ATOMIC_RELAXED);
   if (!MapOverPage(si->si_addr)) {
     handler.reset();
   }
@@ -15,6 +15,7 @@
  */
 
 #include <inttypes.h>
+#include <sched.h>
 #include <string.h>
 
 #include <functional>
@@ -37,6 +38,7 @@
 #include "PtracerThread.h"
 #include "ScopedDisableMalloc.h"
 #include "Semaphore.h"
+#include "SoftDirty.h"
 #include "ThreadCapture.h"
 
 #include "bionic.h"
@@ -58,6 +60,12 @@ class MemUnreachable {
                           const allocator::vector<uintptr_t>& refs);
   bool GetUnreachableMemory(allocator::vector<Leak>& leaks, size_t limit, size_t* num_leaks,
                             size_t* leak_bytes);
+  void TrackPointerFreePages(const allocator::vector<uintptr_t>& skip_pages) {
+    heap_walker_.TrackPointerFreePages(skip_pages);
+  }
+  void PointerFreePages(allocator::vector<uintptr_t>& pages) {
+    heap_walker_.PointerFreePages(pages);
+  }
   size_t Allocations() { return heap_walker_.Allocations(); }
   size_t AllocationBytes() { return heap_walker_.AllocationBytes(); }
 
@@ -138,7 +146,15 @@ bool MemUnreachable::GetUnreachableMemory(allocator::vector<Leak>& leaks, size_t
   MEM_ALOGI("sweeping process %d for unreachable memory", pid_);
   leaks.clear();
 
-  if (!heap_walker_.DetectLeaks()) {
+  // The walk only reads the snapshot, so it can use every CPU this process may
+  // run on. sched_getaffinity is used rather than sysconf, which may allocate.
+  cpu_set_t cpus;
+  size_t num_walkers = 1;
+  if (sched_getaffinity(0, sizeof(cpus), &cpus) == 0) {
+    num_walkers = CPU_COUNT(&cpus);
+  }
+
+  if (!heap_walker_.DetectLeaks(num_walkers)) {
     return false;
   }
 
@@ -275,7 +291,13 @@ static inline const char* plural(T val) {
 }
 
 bool GetUnreachableMemory(UnreachableMemoryInfo& info, size_t limit) {
+  return GetUnreachableMemory(info, limit, nullptr);
+}
+
+bool GetUnreachableMemory(UnreachableMemoryInfo& info, size_t limit,
+                          UnreachableMemorySnapshot* snapshot) {
   int parent_pid = getpid();
+  const uintptr_t page_size = sysconf(_SC_PAGE_SIZE);
   int parent_tid = gettid();
 
   Heap heap;
@@ -317,6 +339,25 @@ bool GetUnreachableMemory(UnreachableMemoryInfo& info, size_t limit) {
       return 1;
     }
 
+    // Find the pages that held no pointers last time and haven't been
+    // written to since, then start tracking writes for the next call.
+    allocator::vector<uintptr_t> skip_pages(heap);
+    bool track_pages = false;
+    if (snapshot != nullptr) {
+      allocator::vector<uintptr_t> previous_pages(heap);
+      previous_pages.reserve(snapshot->pages_.size());
+      for (uintptr_t page_number : snapshot->pages_) {
+        previous_pages.push_back(page_number * page_size);
+      }
+      track_pages =
+          SoftDirtyCleanPages(parent_pid, previous_pages.data(), previous_pages.size(),
+                              skip_pages) &&
+          ClearSoftDirty(parent_pid);
+      if (!track_pages) {
+        skip_pages.clear();
+      }
+    }
+
     // malloc must be enabled to call fork, at_fork handlers take the same
     // locks as ScopedDisableMalloc.  All threads are paused in ptrace, so
     // memory state is still consistent.  Unfreeze the original thread so it
@@ -345,6 +386,9 @@ bool GetUnreachableMemory(UnreachableMemoryInfo& info, size_t limit) {
       if (!unreachable.CollectAllocations(thread_info, mappings, refs)) {
         _exit(2);
       }
+      if (track_pages) {
+        unreachable.TrackPointerFreePages(skip_pages);
+      }
       size_t num_allocations = unreachable.Allocations();
       size_t allocation_bytes = unreachable.AllocationBytes();
 
@@ -354,11 +398,20 @@ bool GetUnreachableMemory(UnreachableMemoryInfo& info, size_t limit) {
       size_t leak_bytes = 0;
       bool ok = unreachable.GetUnreachableMemory(leaks, limit, &num_leaks, &leak_bytes);
 
+      allocator::vector<uintptr_t> pointer_free_pages{heap};
+      if (track_pages) {
+        unreachable.PointerFreePages(pointer_free_pages);
+        for (auto& page : pointer_free_pages) {
+          page /= page_size;
+        }
+      }
+
       ok = ok && pipe.Sender().Send(num_allocations);
       ok = ok && pipe.Sender().Send(allocation_bytes);
       ok = ok && pipe.Sender().Send(num_leaks);
       ok = ok && pipe.Sender().Send(leak_bytes);
       ok = ok && pipe.Sender().SendVector(leaks);
+      ok = ok && pipe.Sender().SendVector(pointer_free_pages);
 
       if (!ok) {
         _exit(3);
@@ -410,9 +463,14 @@ bool GetUnreachableMemory(UnreachableMemoryInfo& info, size_t limit) {
   ok = ok && pipe.Receiver().Receive(&info.num_leaks);
   ok = ok && pipe.Receiver().Receive(&info.leak_bytes);
   ok = ok && pipe.Receiver().ReceiveVector(info.leaks);
+  std::vector<uintptr_t> pointer_free_pages;
+  ok = ok && pipe.Receiver().ReceiveVector(pointer_free_pages);
   if (!ok) {
     return false;
   }
+  if (snapshot != nullptr) {
+    snapshot->pages_.swap(pointer_free_pages);
+  }
 
   MEM_ALOGI("unreachable memory detection done");
   MEM_ALOGE("%zu bytes in %zu allocation%s unreachable out of %zu bytes in %zu allocation%s",
@@ -15,12 +15,10 @@
  */
 
 #include <errno.h>
-#include <fcntl.h>
 #include <inttypes.h>
+#include <stdio.h>
 #include <string.h>
-#include <unistd.h>
 
-#include <android-base/unique_fd.h>
 #include <procinfo/process_map.h>
 
 #include "ProcessMappings.h"
@@ -39,19 +37,13 @@ struct ReadMapCallback {
 };
 
 bool ProcessMappings(pid_t pid, allocator::vector<Mapping>& mappings) {
-  char map_buffer[1024];
-  snprintf(map_buffer, sizeof(map_buffer), "/proc/%d/maps", pid);
-  android::base::unique_fd fd(open(map_buffer, O_RDONLY));
-  if (fd == -1) {
-    return false;
-  }
-  allocator::string content(mappings.get_allocator());
-  ssize_t n;
-  while ((n = TEMP_FAILURE_RETRY(read(fd, map_buffer, sizeof(map_buffer)))) > 0) {
-    content.append(map_buffer, n);
-  }
+  char map_file[64];
+  snprintf(map_file, sizeof(map_file), "/proc/%d/maps", pid);
+  // Parsed a chunk at a time rather than read whole, and from the heap since
+  // this runs on a minimal stack.
+  allocator::vector<char> buffer(android::procinfo::kMapFileChunkSize, mappings.get_allocator());
   ReadMapCallback callback(mappings);
-  return android::procinfo::ReadMapFileContent(&content[0], callback);
+  return android::procinfo::ReadMapFileChunked(map_file, buffer.data(), buffer.size(), callback);
 }
 
 }  // namespace android
@@ -0,0 +1,117 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "SoftDirty.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <android-base/macros.h>
+#include <android-base/unique_fd.h>
+
+#include "log.h"
+
+namespace android {
+
+// See Documentation/admin-guide/mm/soft-dirty.rst in the kernel.
+static constexpr uint64_t kPagemapSoftDirty = 1ULL << 55;
+
+static int OpenProcFile(pid_t pid, const char* name, int flags) {
+  char path[64];
+  snprintf(path, sizeof(path), "/proc/%d/%s", pid, name);
+  int fd = TEMP_FAILURE_RETRY(open(path, flags | O_CLOEXEC));
+  if (fd < 0) {
+    MEM_ALOGE("failed to open %s: %s", path, strerror(errno));
+  }
+  return fd;
+}
+
+template <class F>
+static bool ForEachPagemapEntry(int fd, const uintptr_t* pages, size_t count, F&& f) {
+  const uintptr_t page_size = sysconf(_SC_PAGE_SIZE);
+  // Kept small, this runs on the collection thread's stack.
+  uint64_t entries[64];
+  for (size_t i = 0; i < count;) {
+    // Read the entries of a run of consecutive pages at once.
+    size_t n = 1;
+    while (n < arraysize(entries) && i + n < count && pages[i + n] == pages[i] + n * page_size) {
+      n++;
+    }
+    off64_t offset = static_cast<off64_t>(pages[i] / page_size) * sizeof(uint64_t);
+    ssize_t bytes = TEMP_FAILURE_RETRY(pread64(fd, entries, n * sizeof(uint64_t), offset));
+    if (bytes != static_cast<ssize_t>(n * sizeof(uint64_t))) {
+      MEM_ALOGE("failed to read pagemap at %" PRIxPTR ": %s", pages[i],
+                bytes < 0 ? strerror(errno) : "short read");
+      return false;
+    }
+    for (size_t j = 0; j < n; j++) {
+      f(pages[i + j], entries[j]);
+    }
+    i += n;
+  }
+  return true;
+}
+
+bool SoftDirtyCleanPages(pid_t pid, const uintptr_t* pages, size_t count,
+                         allocator::vector<uintptr_t>& clean) {
+  android::base::unique_fd fd(OpenProcFile(pid, "pagemap", O_RDONLY));
+  if (fd == -1) {
+    return false;
+  }
+  return ForEachPagemapEntry(fd, pages, count, [&](uintptr_t page, uint64_t entry) {
+    if (!(entry & kPagemapSoftDirty)) {
+      clean.push_back(page);
+    }
+  });
+}
+
+bool ClearSoftDirty(pid_t pid) {
+  android::base::unique_fd clear_refs(OpenProcFile(pid, "clear_refs", O_WRONLY));
+  if (clear_refs == -1) {
+    return false;
+  }
+  if (TEMP_FAILURE_RETRY(write(clear_refs, "4", 1)) != 1) {
+    MEM_ALOGE("failed to clear soft-dirty bits: %s", strerror(errno));
+    return false;
+  }
+
+  // Kernels built without CONFIG_MEM_SOFT_DIRTY accept the write above but
+  // never report a page as written, so check a page written since.
+  volatile uintptr_t probe = 0;
+  probe = probe + 1;
+  uintptr_t page = reinterpret_cast<uintptr_t>(&probe) & ~(sysconf(_SC_PAGE_SIZE) - 1);
+
+  android::base::unique_fd pagemap(OpenProcFile(pid, "pagemap", O_RDONLY));
+  if (pagemap == -1) {
+    return false;
+  }
+  bool dirty = false;
+  if (!ForEachPagemapEntry(pagemap, &page, 1, [&](uintptr_t, uint64_t entry) {
+        dirty = entry & kPagemapSoftDirty;
+      })) {
+    return false;
+  }
+  if (!dirty) {
+    MEM_ALOGI("soft-dirty page tracking not supported");
+  }
+  return dirty;
+}
+
+}  // namespace android
@@ -0,0 +1,39 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef LIBMEMUNREACHABLE_SOFT_DIRTY_H_
+#define LIBMEMUNREACHABLE_SOFT_DIRTY_H_
+
+#include <sys/types.h>
+
+#include "Allocator.h"
+
+namespace android {
+
+// Appends the pages in pages (sorted page addresses) that the kernel reports
+// as not written by pid since the last ClearSoftDirty to clean.
+bool SoftDirtyCleanPages(pid_t pid, const uintptr_t* pages, size_t count,
+                         allocator::vector<uintptr_t>& clean);
+
+// Clears the soft-dirty bits of all of pid's pages.  Returns false if that
+// failed or the kernel doesn't track soft-dirty pages, in which case
+// SoftDirtyCleanPages can't be relied on.  Must be called from a thread that
+// shares pid's address space.
+bool ClearSoftDirty(pid_t pid);
+
+}  // namespace android
+
+#endif  // LIBMEMUNREACHABLE_SOFT_DIRTY_H_
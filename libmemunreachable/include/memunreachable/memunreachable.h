@@ -69,6 +69,30 @@ struct UnreachableMemoryInfo {
 
 bool GetUnreachableMemory(UnreachableMemoryInfo& info, size_t limit = 100);
 
+// What a GetUnreachableMemory call learned about the process, for the next
+// call to reuse.  Pages that held no pointers to allocations last time and
+// that the kernel's soft-dirty tracking reports as not written to since are
+// not read again, which makes periodic checks of a mostly idle heap cheaper.
+// Without soft-dirty support in the kernel every call does a full scan.  The
+// soft-dirty bits of the whole process are cleared on every call, so this
+// can't be used together with anything else that relies on them.
+class UnreachableMemorySnapshot {
+ public:
+  // The number of pages the next call may skip if they are unchanged.
+  size_t pointer_free_pages() const { return pages_.size(); }
+
+ private:
+  friend bool GetUnreachableMemory(UnreachableMemoryInfo& info, size_t limit,
+                                   UnreachableMemorySnapshot* snapshot);
+  // Page numbers rather than addresses, so the next scan doesn't take them
+  // for pointers to the start of page aligned allocations.
+  std::vector<uintptr_t> pages_;
+};
+
+// Same as above, but reads and updates snapshot.
+bool GetUnreachableMemory(UnreachableMemoryInfo& info, size_t limit,
+                          UnreachableMemorySnapshot* snapshot);
+
 std::string GetUnreachableMemoryString(bool log_contents = false, size_t limit = 100);
 
 }  // namespace android
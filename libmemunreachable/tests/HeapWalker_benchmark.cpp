@@ -0,0 +1,75 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdint.h>
+
+#include <random>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include "Allocator.h"
+#include "HeapWalker.h"
+
+namespace android {
+
+// Scans a root of 64Ki words over state.range(0) allocations of 16 bytes,
+// each followed by a 16 byte gap.  A quarter of the words point into an
+// allocation, a quarter into a gap and the rest are outside the heap.
+static void BM_HeapWalker_ForEachPtrInRange(benchmark::State& state) {
+  const size_t num_allocations = state.range(0);
+  const uintptr_t heap_base = 0x10000000;
+  const size_t slot_size = 32;
+
+  Heap heap;
+  HeapWalker heap_walker(heap);
+  for (size_t i = 0; i < num_allocations; i++) {
+    uintptr_t begin = heap_base + i * slot_size;
+    heap_walker.Allocation(begin, begin + slot_size / 2);
+  }
+
+  std::mt19937 rng(42);
+  std::uniform_int_distribution<size_t> slot(0, num_allocations - 1);
+  std::vector<uintptr_t> root(64 * 1024);
+  for (size_t i = 0; i < root.size(); i++) {
+    uintptr_t value = heap_base + slot(rng) * slot_size;
+    switch (i % 4) {
+      case 0:
+        root[i] = value + 8;
+        break;
+      case 1:
+        root[i] = value + slot_size / 2 + 8;
+        break;
+      default:
+        root[i] = rng();
+        break;
+    }
+  }
+  Range range{reinterpret_cast<uintptr_t>(root.data()),
+              reinterpret_cast<uintptr_t>(root.data() + root.size())};
+
+  size_t found = 0;
+  for (auto _ : state) {
+    heap_walker.ForEachPtrInRange(range, [&](Range&, HeapWalker::AllocationInfo*) { found++; });
+  }
+  benchmark::DoNotOptimize(found);
+  state.SetItemsProcessed(state.iterations() * root.size());
+}
+BENCHMARK(BM_HeapWalker_ForEachPtrInRange)->Range(1 << 10, 1 << 20);
+
+}  // namespace android
+
+BENCHMARK_MAIN();
@@ -220,4 +220,187 @@ TEST_F(HeapWalkerTest, segv) {
   ASSERT_EQ(0U, leaked.size());
 }
 
+TEST_F(HeapWalkerTest, allocation_after_lookup) {
+  char buffer1[16]{};
+  char buffer2[16]{};
+  void* buffer3[2] = {&buffer1[4], &buffer2[8]};
+
+  HeapWalker heap_walker(heap_);
+  heap_walker.Allocation(buffer_begin(buffer1), buffer_end(buffer1));
+
+  size_t found = 0;
+  auto count = [&](Range&, HeapWalker::AllocationInfo*) { found++; };
+  heap_walker.ForEachPtrInRange(Range{buffer_begin(buffer3), buffer_end(buffer3)}, count);
+  EXPECT_EQ(1U, found);
+
+  heap_walker.Allocation(buffer_begin(buffer2), buffer_end(buffer2));
+
+  found = 0;
+  heap_walker.ForEachPtrInRange(Range{buffer_begin(buffer3), buffer_end(buffer3)}, count);
+  EXPECT_EQ(2U, found);
+}
+
+TEST_F(HeapWalkerTest, walkers) {
+  // A tree of live nodes, a ring of leaked ones, and a live mapping larger
+  // than one walk chunk that only references its node from its last word.
+  const size_t num_nodes = 4096;
+  const size_t num_live = num_nodes / 2;
+  const size_t big_size = 1024 * 1024;
+  uintptr_t* nodes = reinterpret_cast<uintptr_t*>(mmap(NULL, num_nodes * 2 * sizeof(uintptr_t),
+                                                       PROT_READ | PROT_WRITE,
+                                                       MAP_ANONYMOUS | MAP_PRIVATE, -1, 0));
+  ASSERT_NE(MAP_FAILED, nodes);
+  uintptr_t* big = reinterpret_cast<uintptr_t*>(
+      mmap(NULL, big_size, PROT_READ | PROT_WRITE, MAP_ANONYMOUS | MAP_PRIVATE, -1, 0));
+  ASSERT_NE(MAP_FAILED, big);
+  auto node = [&](size_t i) { return reinterpret_cast<uintptr_t>(&nodes[i * 2]); };
+
+  for (size_t i = 0; i < num_live - 1; i++) {
+    nodes[i * 2] = 2 * i + 1 < num_live - 1 ? node(2 * i + 1) : 0;
+    nodes[i * 2 + 1] = 2 * i + 2 < num_live - 1 ? node(2 * i + 2) : 0;
+  }
+  big[big_size / sizeof(uintptr_t) - 1] = node(num_live - 1);
+  nodes[(num_live - 1) * 2] = 0;
+  nodes[(num_live - 1) * 2 + 1] = 0;
+  for (size_t i = num_live; i < num_nodes; i++) {
+    nodes[i * 2] = node(i + 1 < num_nodes ? i + 1 : num_live);
+    nodes[i * 2 + 1] = 0;
+  }
+
+  uintptr_t root[2] = {node(0), reinterpret_cast<uintptr_t>(big)};
+
+  for (size_t num_walkers : {size_t(1), size_t(2), HeapWalker::kMaxWalkers}) {
+    HeapWalker heap_walker(heap_);
+    for (size_t i = 0; i < num_nodes; i++) {
+      heap_walker.Allocation(node(i), node(i) + 2 * sizeof(uintptr_t));
+    }
+    heap_walker.Allocation(buffer_begin(big), buffer_begin(big) + big_size);
+    heap_walker.Root(buffer_begin(root), buffer_end(root));
+
+    ASSERT_EQ(true, heap_walker.DetectLeaks(num_walkers));
+
+    allocator::vector<Range> leaked(heap_);
+    size_t num_leaks = 0;
+    size_t leaked_bytes = 0;
+    ASSERT_EQ(true, heap_walker.Leaked(leaked, num_nodes, &num_leaks, &leaked_bytes));
+
+    EXPECT_EQ(num_nodes - num_live, num_leaks) << num_walkers << " walkers";
+    EXPECT_EQ((num_nodes - num_live) * 2 * sizeof(uintptr_t), leaked_bytes);
+    ASSERT_EQ(num_nodes - num_live, leaked.size());
+    EXPECT_EQ(node(num_live), leaked[0].begin);
+  }
+
+  munmap(big, big_size);
+  munmap(nodes, num_nodes * 2 * sizeof(uintptr_t));
+}
+
+TEST_F(HeapWalkerTest, segv_walkers) {
+  const size_t page_size = sysconf(_SC_PAGE_SIZE);
+  void* buffers[16];
+  for (auto& buffer : buffers) {
+    buffer = mmap(NULL, page_size, PROT_NONE, MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
+    ASSERT_NE(MAP_FAILED, buffer);
+  }
+
+  HeapWalker heap_walker(heap_);
+  for (auto& buffer : buffers) {
+    heap_walker.Allocation(buffer_begin(buffer), buffer_begin(buffer) + page_size);
+  }
+  heap_walker.Root(buffer_begin(buffers), buffer_end(buffers));
+
+  ASSERT_EQ(true, heap_walker.DetectLeaks(HeapWalker::kMaxWalkers));
+
+  allocator::vector<Range> leaked(heap_);
+  size_t num_leaks = 0;
+  size_t leaked_bytes = 0;
+  ASSERT_EQ(true, heap_walker.Leaked(leaked, 100, &num_leaks, &leaked_bytes));
+
+  EXPECT_EQ(0U, num_leaks);
+  EXPECT_EQ(0U, leaked_bytes);
+  ASSERT_EQ(0U, leaked.size());
+}
+
+TEST_F(HeapWalkerTest, pointer_free_pages) {
+  const size_t page_size = sysconf(_SC_PAGE_SIZE);
+  uintptr_t* pages = reinterpret_cast<uintptr_t*>(
+      mmap(NULL, 3 * page_size, PROT_READ | PROT_WRITE, MAP_ANONYMOUS | MAP_PRIVATE, -1, 0));
+  ASSERT_NE(MAP_FAILED, pages);
+  uintptr_t page0 = reinterpret_cast<uintptr_t>(pages);
+  uintptr_t page1 = page0 + page_size;
+  uintptr_t page2 = page1 + page_size;
+  const size_t words = page_size / sizeof(uintptr_t);
+
+  // page0 is a root holding a pointer to page1, which only holds data.
+  // page2 is split between a live allocation and a leaked one that points to
+  // itself, which must not be mistaken for a reference from the live one.
+  pages[0] = page1 + 8;
+  for (size_t i = 0; i < words; i++) {
+    pages[words + i] = i;
+  }
+  pages[words * 2 + words / 2] = page2 + page_size / 2 + 8;
+  pages[1] = page2;
+
+  HeapWalker heap_walker(heap_);
+  heap_walker.Allocation(page1, page2);
+  heap_walker.Allocation(page2, page2 + page_size / 2);
+  heap_walker.Allocation(page2 + page_size / 2, page2 + page_size);
+  heap_walker.Root(page0, page1);
+  heap_walker.TrackPointerFreePages(allocator::vector<uintptr_t>(heap_));
+
+  ASSERT_EQ(true, heap_walker.DetectLeaks());
+
+  allocator::vector<Range> leaked(heap_);
+  size_t num_leaks = 0;
+  size_t leaked_bytes = 0;
+  ASSERT_EQ(true, heap_walker.Leaked(leaked, 100, &num_leaks, &leaked_bytes));
+  EXPECT_EQ(1U, num_leaks);
+  ASSERT_EQ(1U, leaked.size());
+  EXPECT_EQ(page2 + page_size / 2, leaked[0].begin);
+
+  allocator::vector<uintptr_t> pointer_free(heap_);
+  heap_walker.PointerFreePages(pointer_free);
+  ASSERT_EQ(1U, pointer_free.size());
+  EXPECT_EQ(page1, pointer_free[0]);
+
+  munmap(pages, 3 * page_size);
+}
+
+TEST_F(HeapWalkerTest, skip_pages) {
+  const size_t page_size = sysconf(_SC_PAGE_SIZE);
+  uintptr_t* pages = reinterpret_cast<uintptr_t*>(
+      mmap(NULL, 2 * page_size, PROT_READ | PROT_WRITE, MAP_ANONYMOUS | MAP_PRIVATE, -1, 0));
+  ASSERT_NE(MAP_FAILED, pages);
+  uintptr_t page0 = reinterpret_cast<uintptr_t>(pages);
+  uintptr_t page1 = page0 + page_size;
+  pages[0] = page1;
+
+  for (bool skip : {false, true}) {
+    HeapWalker heap_walker(heap_);
+    heap_walker.Allocation(page1, page1 + page_size);
+    heap_walker.Root(page0, page1);
+    allocator::vector<uintptr_t> skip_pages(heap_);
+    if (skip) {
+      skip_pages.push_back(page0);
+    }
+    heap_walker.TrackPointerFreePages(skip_pages);
+
+    ASSERT_EQ(true, heap_walker.DetectLeaks(HeapWalker::kMaxWalkers));
+
+    allocator::vector<Range> leaked(heap_);
+    size_t num_leaks = 0;
+    size_t leaked_bytes = 0;
+    ASSERT_EQ(true, heap_walker.Leaked(leaked, 100, &num_leaks, &leaked_bytes));
+    // A skipped page is not read, so the pointer in it is not seen.
+    EXPECT_EQ(skip ? 1U : 0U, num_leaks);
+
+    allocator::vector<uintptr_t> pointer_free(heap_);
+    heap_walker.PointerFreePages(pointer_free);
+    // When page1 is leaked it is never read, so nothing is known about it.
+    ASSERT_EQ(1U, pointer_free.size());
+    EXPECT_EQ(skip ? page0 : page1, pointer_free[0]);
+  }
+
+  munmap(pages, 2 * page_size);
+}
+
 }  // namespace android
@@ -226,6 +226,46 @@ TEST_F(MemunreachableTest, twice) {
   }
 }
 
+TEST_F(MemunreachableTest, snapshot) {
+  HiddenPointer hidden_ptr;
+  UnreachableMemorySnapshot snapshot;
+
+  {
+    void* ptr = hidden_ptr.Get();
+    Ref(&ptr);
+
+    UnreachableMemoryInfo info;
+
+    ASSERT_TRUE(GetUnreachableMemory(info, 100, &snapshot));
+    ASSERT_EQ(0U, info.leaks.size());
+
+    ptr = nullptr;
+  }
+
+  {
+    UnreachableMemoryInfo info;
+
+    ASSERT_TRUE(GetUnreachableMemory(info, 100, &snapshot));
+    ASSERT_EQ(1U, info.leaks.size());
+  }
+
+  {
+    UnreachableMemoryInfo info;
+
+    ASSERT_TRUE(GetUnreachableMemory(info, 100, &snapshot));
+    ASSERT_EQ(1U, info.leaks.size());
+  }
+
+  hidden_ptr.Free();
+
+  {
+    UnreachableMemoryInfo info;
+
+    ASSERT_TRUE(GetUnreachableMemory(info, 100, &snapshot));
+    ASSERT_EQ(0U, info.leaks.size());
+  }
+}
+
 TEST_F(MemunreachableTest, log) {
   HiddenPointer hidden_ptr;
 
@@ -88,6 +88,58 @@ extern bool packagelist_parse(pfn_on_package callback, void *userdata);
  */
 extern void packagelist_free(pkg_info *info);
 
+/**
+ * An index over a memory mapped snapshot of the packages list, for looking up
+ * single packages. Opening it only reads the name and uid of each line, and a
+ * lookup fully parses just the line it finds, so no per-package allocations
+ * are made. The snapshot does not follow later updates of the file.
+ */
+typedef struct packagelist_index packagelist_index;
+
+/**
+ * Maps and indexes the file specified by PACKAGES_LIST_FILE.
+ * @return
+ *  The index, to be released with packagelist_index_close(), or NULL on
+ *  failure.
+ */
+extern packagelist_index *packagelist_index_open(void);
+
+/**
+ * Same as packagelist_index_open(), for the packages list at |path|.
+ */
+extern packagelist_index *packagelist_index_open_file(const char *path);
+
+/**
+ * Unmaps and frees an index. The pkg_info structs returned by lookups stay
+ * valid.
+ * @param index
+ *  The index to close, may be NULL.
+ */
+extern void packagelist_index_close(packagelist_index *index);
+
+/**
+ * @return
+ *  The number of packages in the index.
+ */
+extern size_t packagelist_index_count(const packagelist_index *index);
+
+/**
+ * Looks up a package by name.
+ * @return
+ *  The package, to be freed with packagelist_free(), or NULL if there is no
+ *  such package or its line could not be parsed.
+ */
+extern pkg_info *packagelist_index_find_name(const packagelist_index *index, const char *name);
+
+/**
+ * Looks up a package by uid. Of packages sharing a uid, the first one in the
+ * file is returned.
+ * @return
+ *  The package, to be freed with packagelist_free(), or NULL if there is no
+ *  such package or its line could not be parsed.
+ */
+extern pkg_info *packagelist_index_find_uid(const packagelist_index *index, uid_t uid);
+
 __END_DECLS
 
 #endif /* PACKAGELISTPARSER_H_ */
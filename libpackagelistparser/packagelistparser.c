@@ -21,11 +21,16 @@
 #define LOG_TAG "packagelistparser"
 
 #include <errno.h>
+#include <fcntl.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/limits.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 #include <log/log.h>
 #include <packagelistparser/packagelistparser.h>
@@ -87,157 +92,170 @@ static bool parse_gids(char *gids, gid_t *gid_list, size_t *cnt)
     return true;
 }
 
-extern bool packagelist_parse(pfn_on_package callback, void *userdata)
+/*
+ * Parses one NUL-terminated line of the packages list into |pkg_info|. On
+ * failure *errmsg is set, unless the failure was an allocation.
+ */
+static bool parse_line(char *buf, struct pkg_info *pkg_info, const char **errmsg)
 {
-
-    FILE *fp;
     char *cur;
     char *next;
     char *endptr;
     unsigned long tmp;
-    ssize_t bytesread;
 
-    bool rc = false;
-    char *buf = NULL;
-    size_t buflen = 0;
-    unsigned long lineno = 1;
-    const char *errmsg = NULL;
-    struct pkg_info *pkg_info = NULL;
+    next = buf;
 
-    fp = fopen(PACKAGES_LIST_FILE, "re");
-    if (!fp) {
-        CLOGE("Could not open: \"%s\", error: \"%s\"\n", PACKAGES_LIST_FILE,
-                strerror(errno));
+    cur = strsep(&next, " \t\r\n");
+    if (!cur) {
+        *errmsg = "Could not get next token for \"package name\"";
         return false;
     }
 
-    while ((bytesread = getline(&buf, &buflen, fp)) > 0) {
+    pkg_info->name = strdup(cur);
+    if (!pkg_info->name) {
+        return false;
+    }
 
-        pkg_info = calloc(1, sizeof(*pkg_info));
-        if (!pkg_info) {
-            goto err;
-        }
+    cur = strsep(&next, " \t\r\n");
+    if (!cur) {
+        *errmsg = "Could not get next token for field \"uid\"";
+        return false;
+    }
 
-        next = buf;
+    tmp = strtoul(cur, &endptr, 10);
+    if (*endptr != '\0') {
+        *errmsg = "Could not convert field \"uid\" to integer value";
+        return false;
+    }
 
-        cur = strsep(&next, " \t\r\n");
-        if (!cur) {
-            errmsg = "Could not get next token for \"package name\"";
-            goto err;
-        }
+    /*
+     * if unsigned long is greater than size of uid_t,
+     * prevent a truncation based roll-over
+     */
+    if (tmp > UID_MAX) {
+        *errmsg = "Field \"uid\" greater than UID_MAX";
+        return false;
+    }
 
-        pkg_info->name = strdup(cur);
-        if (!pkg_info->name) {
-            goto err;
-        }
+    pkg_info->uid = (uid_t) tmp;
 
-        cur = strsep(&next, " \t\r\n");
-        if (!cur) {
-            errmsg = "Could not get next token for field \"uid\"";
-            goto err;
-        }
+    cur = strsep(&next, " \t\r\n");
+    if (!cur) {
+        *errmsg = "Could not get next token for field \"debuggable\"";
+        return false;
+    }
 
-        tmp = strtoul(cur, &endptr, 10);
-        if (*endptr != '\0') {
-            errmsg = "Could not convert field \"uid\" to integer value";
-            goto err;
-        }
+    tmp = strtoul(cur, &endptr, 10);
+    if (*endptr != '\0') {
+        *errmsg = "Could not convert field \"debuggable\" to integer value";
+        return false;
+    }
 
-        /*
-         * if unsigned long is greater than size of uid_t,
-         * prevent a truncation based roll-over
-         */
-        if (tmp > UID_MAX) {
-            errmsg = "Field \"uid\" greater than UID_MAX";
-            goto err;
-        }
+    /* should be a valid boolean of 1 or 0 */
+    if (!(tmp == 0 || tmp == 1)) {
+        *errmsg = "Field \"debuggable\" is not 0 or 1 boolean value";
+        return false;
+    }
 
-        pkg_info->uid = (uid_t) tmp;
+    pkg_info->debuggable = (bool) tmp;
 
-        cur = strsep(&next, " \t\r\n");
-        if (!cur) {
-            errmsg = "Could not get next token for field \"debuggable\"";
-            goto err;
+    cur = strsep(&next, " \t\r\n");
+    if (!cur) {
+        *errmsg = "Could not get next token for field \"data dir\"";
+        return false;
+    }
+
+    pkg_info->data_dir = strdup(cur);
+    if (!pkg_info->data_dir) {
+        return false;
+    }
+
+    cur = strsep(&next, " \t\r\n");
+    if (!cur) {
+        *errmsg = "Could not get next token for field \"seinfo\"";
+        return false;
+    }
+
+    pkg_info->seinfo = strdup(cur);
+    if (!pkg_info->seinfo) {
+        return false;
+    }
+
+    cur = strsep(&next, " \t\r\n");
+    if (!cur) {
+        *errmsg = "Could not get next token for field \"gid(s)\"";
+        return false;
+    }
+
+    /*
+     * Parse the gid list, could be in the form of none, single gid or list:
+     * none
+     * gid
+     * gid, gid ...
+     */
+    pkg_info->gids.cnt = get_gid_cnt(cur);
+    if (pkg_info->gids.cnt > 0) {
+
+        pkg_info->gids.gids = calloc(pkg_info->gids.cnt, sizeof(gid_t));
+        if (!pkg_info->gids.gids) {
+            return false;
         }
 
+        if (!parse_gids(cur, pkg_info->gids.gids, &pkg_info->gids.cnt)) {
+            *errmsg = "Could not parse field \"gid list\"";
+            return false;
+        }
+    }
+
+    cur = strsep(&next, " \t\r\n");
+    if (cur) {
         tmp = strtoul(cur, &endptr, 10);
         if (*endptr != '\0') {
-            errmsg = "Could not convert field \"debuggable\" to integer value";
-            goto err;
+            *errmsg = "Could not convert field \"profileable_from_shell\" to integer value";
+            return false;
         }
 
         /* should be a valid boolean of 1 or 0 */
         if (!(tmp == 0 || tmp == 1)) {
-            errmsg = "Field \"debuggable\" is not 0 or 1 boolean value";
-            goto err;
+            *errmsg = "Field \"profileable_from_shell\" is not 0 or 1 boolean value";
+            return false;
         }
 
-        pkg_info->debuggable = (bool) tmp;
-
-        cur = strsep(&next, " \t\r\n");
-        if (!cur) {
-            errmsg = "Could not get next token for field \"data dir\"";
-            goto err;
-        }
+        pkg_info->profileable_from_shell = (bool)tmp;
+    }
 
-        pkg_info->data_dir = strdup(cur);
-        if (!pkg_info->data_dir) {
-            goto err;
-        }
+    return true;
+}
 
-        cur = strsep(&next, " \t\r\n");
-        if (!cur) {
-            errmsg = "Could not get next token for field \"seinfo\"";
-            goto err;
-        }
+extern bool packagelist_parse(pfn_on_package callback, void *userdata)
+{
 
-        pkg_info->seinfo = strdup(cur);
-        if (!pkg_info->seinfo) {
-            goto err;
-        }
+    FILE *fp;
+    ssize_t bytesread;
 
-        cur = strsep(&next, " \t\r\n");
-        if (!cur) {
-            errmsg = "Could not get next token for field \"gid(s)\"";
-            goto err;
-        }
+    bool rc = false;
+    char *buf = NULL;
+    size_t buflen = 0;
+    unsigned long lineno = 1;
+    const char *errmsg = NULL;
+    struct pkg_info *pkg_info = NULL;
 
-        /*
-         * Parse the gid list, could be in the form of none, single gid or list:
-         * none
-         * gid
-         * gid, gid ...
-         */
-        pkg_info->gids.cnt = get_gid_cnt(cur);
-        if (pkg_info->gids.cnt > 0) {
+    fp = fopen(PACKAGES_LIST_FILE, "re");
+    if (!fp) {
+        CLOGE("Could not open: \"%s\", error: \"%s\"\n", PACKAGES_LIST_FILE,
+                strerror(errno));
+        return false;
+    }
 
-            pkg_info->gids.gids = calloc(pkg_info->gids.cnt, sizeof(gid_t));
-            if (!pkg_info->gids.gids) {
-                goto err;
-            }
+    while ((bytesread = getline(&buf, &buflen, fp)) > 0) {
 
-            rc = parse_gids(cur, pkg_info->gids.gids, &pkg_info->gids.cnt);
-            if (!rc) {
-                errmsg = "Could not parse field \"gid list\"";
-                goto err;
-            }
+        pkg_info = calloc(1, sizeof(*pkg_info));
+        if (!pkg_info) {
+            goto err;
         }
 
-        cur = strsep(&next, " \t\r\n");
-        if (cur) {
-            tmp = strtoul(cur, &endptr, 10);
-            if (*endptr != '\0') {
-                errmsg = "Could not convert field \"profileable_from_shell\" to integer value";
-                goto err;
-            }
-
-            /* should be a valid boolean of 1 or 0 */
-            if (!(tmp == 0 || tmp == 1)) {
-                errmsg = "Field \"profileable_from_shell\" is not 0 or 1 boolean value";
-                goto err;
-            }
-
-            pkg_info->profileable_from_shell = (bool)tmp;
+        if (!parse_line(buf, pkg_info, &errmsg)) {
+            goto err;
         }
 
         rc = callback(pkg_info, userdata);
@@ -280,3 +298,270 @@ void packagelist_free(pkg_info *info)
         free(info);
     }
 }
+
+/* One line of the packages list, pointing into the mapping. */
+struct packagelist_entry {
+    const char *line;
+    size_t len;      /* line length, without the newline */
+    size_t name_len;
+    uid_t uid;
+};
+
+struct packagelist_index {
+    char *map;
+    size_t size;
+    size_t cnt;
+    struct packagelist_entry *by_name;  /* sorted by name */
+    struct packagelist_entry **by_uid;  /* sorted by uid */
+};
+
+static int compare_names(const char *a, size_t a_len, const char *b, size_t b_len)
+{
+    int rc = memcmp(a, b, a_len < b_len ? a_len : b_len);
+    if (rc) {
+        return rc;
+    }
+    return a_len < b_len ? -1 : a_len > b_len;
+}
+
+static int compare_entries_by_name(const void *a, const void *b)
+{
+    const struct packagelist_entry *ea = a;
+    const struct packagelist_entry *eb = b;
+    int rc = compare_names(ea->line, ea->name_len, eb->line, eb->name_len);
+    if (rc) {
+        return rc;
+    }
+    /* Keep file order between (invalid) duplicates, like a linear scan. */
+    return ea->line < eb->line ? -1 : ea->line > eb->line;
+}
+
+static int compare_entries_by_uid(const void *a, const void *b)
+{
+    const struct packagelist_entry *ea = *(const struct packagelist_entry * const *)a;
+    const struct packagelist_entry *eb = *(const struct packagelist_entry * const *)b;
+    if (ea->uid != eb->uid) {
+        return ea->uid < eb->uid ? -1 : 1;
+    }
+    /* Packages sharing a uid are found in file order. */
+    return ea->line < eb->line ? -1 : ea->line > eb->line;
+}
+
+static bool is_field_separator(char c)
+{
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+/*
+ * Reads only the name and uid fields of the line at |line|. The full line is
+ * parsed by parse_line() once it has been looked up.
+ */
+static bool index_line(const char *line, size_t len, struct packagelist_entry *entry)
+{
+    size_t i = 0;
+    uint64_t uid = 0;
+
+    while (i < len && !is_field_separator(line[i])) {
+        i++;
+    }
+    entry->name_len = i;
+    if (i == 0 || i == len) {
+        return false;
+    }
+    i++;
+
+    if (i == len || line[i] < '0' || line[i] > '9') {
+        return false;
+    }
+    for (; i < len && !is_field_separator(line[i]); i++) {
+        if (line[i] < '0' || line[i] > '9') {
+            return false;
+        }
+        uid = uid * 10 + (uint64_t)(line[i] - '0');
+        if (uid > UID_MAX) {
+            return false;
+        }
+    }
+    entry->uid = (uid_t) uid;
+    entry->len = len;
+    return true;
+}
+
+extern packagelist_index *packagelist_index_open_file(const char *path)
+{
+    int fd;
+    struct stat st;
+    size_t pos, lines = 0, lineno = 0;
+    const char *nl;
+    packagelist_index *index;
+
+    index = calloc(1, sizeof(*index));
+    if (!index) {
+        return NULL;
+    }
+
+    fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd == -1) {
+        CLOGE("Could not open: \"%s\", error: \"%s\"\n", path, strerror(errno));
+        free(index);
+        return NULL;
+    }
+    if (fstat(fd, &st) == -1) {
+        CLOGE("Could not stat: \"%s\", error: \"%s\"\n", path, strerror(errno));
+        goto err_close;
+    }
+    index->size = (size_t)st.st_size;
+    if (index->size > 0) {
+        /*
+         * PackageManager replaces the file by rename(), so the mapping stays
+         * a consistent snapshot for as long as the index is open.
+         */
+        index->map = mmap(NULL, index->size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (index->map == MAP_FAILED) {
+            CLOGE("Could not mmap: \"%s\", error: \"%s\"\n", path, strerror(errno));
+            index->map = NULL;
+            goto err_close;
+        }
+    }
+    close(fd);
+
+    for (pos = 0; pos < index->size; lines++) {
+        nl = memchr(index->map + pos, '\n', index->size - pos);
+        pos = nl ? (size_t)(nl - index->map) + 1 : index->size;
+    }
+
+    if (lines > 0) {
+        index->by_name = calloc(lines, sizeof(*index->by_name));
+        index->by_uid = calloc(lines, sizeof(*index->by_uid));
+        if (!index->by_name || !index->by_uid) {
+            goto err;
+        }
+    }
+
+    for (pos = 0; pos < index->size; ) {
+        size_t len;
+        struct packagelist_entry *entry = &index->by_name[index->cnt];
+
+        nl = memchr(index->map + pos, '\n', index->size - pos);
+        len = nl ? (size_t)(nl - index->map) - pos : index->size - pos;
+        lineno++;
+        if (len > 0) {
+            if (!index_line(index->map + pos, len, entry)) {
+                CLOGE("Error Parsing \"%s\" on line: %zu for reason: %s", path, lineno,
+                        "Could not read fields \"package name\" and \"uid\"");
+                goto err;
+            }
+            entry->line = index->map + pos;
+            index->cnt++;
+        }
+        pos += len + (nl ? 1 : 0);
+    }
+
+    qsort(index->by_name, index->cnt, sizeof(*index->by_name), compare_entries_by_name);
+    for (pos = 0; pos < index->cnt; pos++) {
+        index->by_uid[pos] = &index->by_name[pos];
+    }
+    qsort(index->by_uid, index->cnt, sizeof(*index->by_uid), compare_entries_by_uid);
+
+    return index;
+
+err_close:
+    close(fd);
+err:
+    packagelist_index_close(index);
+    return NULL;
+}
+
+extern packagelist_index *packagelist_index_open(void)
+{
+    return packagelist_index_open_file(PACKAGES_LIST_FILE);
+}
+
+void packagelist_index_close(packagelist_index *index)
+{
+    if (index) {
+        if (index->map) {
+            munmap(index->map, index->size);
+        }
+        free(index->by_name);
+        free(index->by_uid);
+        free(index);
+    }
+}
+
+size_t packagelist_index_count(const packagelist_index *index)
+{
+    return index->cnt;
+}
+
+/* Fully parses the line of |entry| into a new pkg_info. */
+static pkg_info *parse_entry(const struct packagelist_entry *entry)
+{
+    const char *errmsg = NULL;
+    struct pkg_info *pkg_info;
+    char *buf;
+
+    buf = malloc(entry->len + 1);
+    pkg_info = calloc(1, sizeof(*pkg_info));
+    if (!buf || !pkg_info) {
+        goto err;
+    }
+    memcpy(buf, entry->line, entry->len);
+    buf[entry->len] = '\0';
+
+    if (!parse_line(buf, pkg_info, &errmsg)) {
+        goto err;
+    }
+    free(buf);
+    return pkg_info;
+
+err:
+    if (errmsg) {
+        CLOGE("Error Parsing package \"%.*s\" for reason: %s", (int)entry->name_len,
+                entry->line, errmsg);
+    }
+    free(buf);
+    packagelist_free(pkg_info);
+    return NULL;
+}
+
+pkg_info *packagelist_index_find_name(const packagelist_index *index, const char *name)
+{
+    size_t lo = 0, hi = index->cnt, name_len = strlen(name);
+
+    /* Lower bound, so that the first of several duplicates is found. */
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        const struct packagelist_entry *entry = &index->by_name[mid];
+        if (compare_names(entry->line, entry->name_len, name, name_len) < 0) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    if (lo < index->cnt) {
+        const struct packagelist_entry *entry = &index->by_name[lo];
+        if (!compare_names(entry->line, entry->name_len, name, name_len)) {
+            return parse_entry(entry);
+        }
+    }
+    return NULL;
+}
+
+pkg_info *packagelist_index_find_uid(const packagelist_index *index, uid_t uid)
+{
+    size_t lo = 0, hi = index->cnt;
+
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (index->by_uid[mid]->uid < uid) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    if (lo < index->cnt && index->by_uid[lo]->uid == uid) {
+        return parse_entry(index->by_uid[lo]);
+    }
+    return NULL;
+}
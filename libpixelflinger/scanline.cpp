@@ -25,6 +25,11 @@
 #include <cutils/memory.h>
 #include <log/log.h>
 
+#if defined(__aarch64__) || defined(__ARM_HAVE_NEON)
+#include <arm_neon.h>
+#define HAVE_NEON_SCANLINES 1
+#endif
+
 #include "buffer.h"
 #include "scanline.h"
 
@@ -112,6 +117,7 @@ static void scanline_t32cb16_clamp_dither(context_t* c);
 static void scanline_col32cb16blend(context_t* c);
 static void scanline_t16cb16_clamp(context_t* c);
 static void scanline_t16cb16blend_clamp_mod(context_t* c);
+static void scanline_t32cb32blend(context_t* c);
 static void scanline_memcpy(context_t* c);
 static void scanline_memset8(context_t* c);
 static void scanline_memset16(context_t* c);
@@ -138,6 +144,11 @@ extern "C" void scanline_t32cb16blend_mips64(uint16_t*, uint32_t*, size_t);
 extern "C" void scanline_col32cb16blend_mips64(uint16_t *dst, uint32_t col, size_t ct);
 #endif
 
+extern "C" void scanline_t32cb32blend_c(uint32_t* dst, const uint32_t* src, size_t ct);
+#if defined(HAVE_NEON_SCANLINES)
+extern "C" void scanline_t32cb32blend_neon(uint32_t* dst, const uint32_t* src, size_t ct);
+#endif
+
 // ----------------------------------------------------------------------------
 
 static inline uint16_t  convertAbgr8888ToRgb565(uint32_t  pix)
@@ -247,6 +258,10 @@ static shortcut_t shortcuts[] = {
     { { { 0x03515104, 0x00000077, { 0x00000000, 0x00000000 } },
         { 0xFFFFFFFF, 0xFFFFFFFF, { 0xFFFFFFFF, 0xFFFFFFFF } } },
         "565 fb, 8888 fixed color", scanline_col32cb16blend, init_y_packed  },  
+    /* same as first entry, onto an 8888 fb which has nothing to dither */
+    { { { 0x03515101, 0x00000077, { 0x00000A01, 0x00000000 } },
+        { 0xFFFFFFFF, 0xFFFFFEFF, { 0xFFFFFFFF, 0x0000003F } } },
+        "8888 fb, 8888 tx, blend SRC_OVER", scanline_t32cb32blend, init_y_noop },
     { { { 0x00000000, 0x00000000, { 0x00000000, 0x00000000 } },
         { 0x00000000, 0x00000007, { 0x00000000, 0x00000000 } } },
         "(nop) alpha test", scanline_noop, init_y_noop },
@@ -2225,6 +2240,73 @@ void scanline_t32cb16blend_srca(context_t* c)
     }
 }
 
+/* Blends premultiplied 8888 pixels onto 8888 ones. Unlike blender_32to16,
+ * alpha is blended too, with the same factor:
+ *     d = min(s + ((d * (0x100 - (sA + (sA>>7)))) >> 8), 0xff)
+ * The NEON version does 8 pixels at a time, one channel per register.
+ */
+extern "C" void scanline_t32cb32blend_c(uint32_t* dst, const uint32_t* src, size_t ct)
+{
+    while (ct--) {
+        uint32_t s = *src++;
+        if (s != 0) {
+            uint32_t sA = s >> 24;
+            if (sA == 0xff) {
+                *dst = s;
+            } else {
+                uint32_t f = 0x100 - (sA + (sA>>7));
+                uint32_t d = *dst;
+                uint32_t r = 0;
+                for (int shift = 0; shift < 32; shift += 8) {
+                    uint32_t v = ((s >> shift) & 0xff) + ((((d >> shift) & 0xff) * f) >> 8);
+                    r |= (v > 0xff ? 0xff : v) << shift;
+                }
+                *dst = r;
+            }
+        }
+        dst++;
+    }
+}
+
+#if defined(HAVE_NEON_SCANLINES)
+extern "C" void scanline_t32cb32blend_neon(uint32_t* dst, const uint32_t* src, size_t ct)
+{
+    const uint16x8_t one = vdupq_n_u16(0x100);
+    for ( ; ct >= 8 ; ct -= 8, src += 8, dst += 8) {
+        uint8x8x4_t s = vld4_u8(reinterpret_cast<const uint8_t*>(src));
+        uint8x8x4_t d = vld4_u8(reinterpret_cast<const uint8_t*>(dst));
+        uint16x8_t sA = vmovl_u8(s.val[3]);
+        uint16x8_t f = vsubq_u16(one, vaddq_u16(sA, vshrq_n_u16(sA, 7)));
+        for (int i = 0 ; i < 4 ; i++) {
+            uint16x8_t fd = vmulq_u16(vmovl_u8(d.val[i]), f);
+            s.val[i] = vqadd_u8(s.val[i], vshrn_n_u16(fd, 8));
+        }
+        vst4_u8(reinterpret_cast<uint8_t*>(dst), s);
+    }
+    scanline_t32cb32blend_c(dst, src, ct);
+}
+#endif
+
+void scanline_t32cb32blend(context_t* c)
+{
+    int32_t x = c->iterators.xl;
+    size_t ct = c->iterators.xr - x;
+    int32_t y = c->iterators.y;
+    surface_t* cb = &(c->state.buffers.color);
+    uint32_t* dst = reinterpret_cast<uint32_t*>(cb->data) + (x+(cb->stride*y));
+
+    surface_t* tex = &(c->state.texture[0].surface);
+    const int32_t u = (c->state.texture[0].shade.is0>>16) + x;
+    const int32_t v = (c->state.texture[0].shade.it0>>16) + y;
+    const uint32_t *src = reinterpret_cast<uint32_t*>(tex->data)+(u+(tex->stride*v));
+
+#if defined(HAVE_NEON_SCANLINES)
+    scanline_t32cb32blend_neon(dst, src, ct);
+#else
+    scanline_t32cb32blend_c(dst, src, ct);
+#endif
+}
+
 void scanline_t16cb16blend_clamp_mod(context_t* c)
 {
     const int a = c->iterators.ydady >> (GGL_COLOR_BITS-8);
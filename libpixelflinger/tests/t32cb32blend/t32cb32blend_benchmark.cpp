@@ -0,0 +1,85 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+extern "C" void scanline_t32cb32blend_c(uint32_t* dst, const uint32_t* src, size_t ct);
+#if defined(__aarch64__) || defined(__ARM_HAVE_NEON)
+extern "C" void scanline_t32cb32blend_neon(uint32_t* dst, const uint32_t* src, size_t ct);
+#endif
+
+// A 1080 pixel wide scanline of premultiplied pixels, with the fully
+// transparent and opaque ones the C version takes shortcuts for.
+static std::vector<uint32_t> make_src(size_t ct) {
+    std::vector<uint32_t> src(ct);
+    srand(ct);
+    for (uint32_t& s : src) {
+        uint32_t a = rand() & 0xff;
+        if ((rand() & 7) == 0) a = 0;
+        if ((rand() & 7) == 0) a = 0xff;
+        uint32_t r = (rand() & 0xff) * a / 0xff;
+        uint32_t g = (rand() & 0xff) * a / 0xff;
+        uint32_t b = (rand() & 0xff) * a / 0xff;
+        s = (a << 24) | (b << 16) | (g << 8) | r;
+    }
+    return src;
+}
+
+static constexpr size_t kWidth = 1080;
+
+static void BM_t32cb32blend_c(benchmark::State& state) {
+    std::vector<uint32_t> src = make_src(kWidth);
+    std::vector<uint32_t> dst(kWidth, 0xff336699);
+    for (auto _ : state) {
+        scanline_t32cb32blend_c(dst.data(), src.data(), kWidth);
+        benchmark::DoNotOptimize(dst.data());
+    }
+    state.SetItemsProcessed(state.iterations() * kWidth);
+}
+BENCHMARK(BM_t32cb32blend_c);
+
+#if defined(__aarch64__) || defined(__ARM_HAVE_NEON)
+static void BM_t32cb32blend_neon(benchmark::State& state) {
+    std::vector<uint32_t> src = make_src(kWidth);
+
+    // Check against the C version first; odd counts cover the tail.
+    for (size_t ct : {kWidth, kWidth - 1, size_t(7)}) {
+        std::vector<uint32_t> expected(ct, 0xff336699), actual(ct, 0xff336699);
+        scanline_t32cb32blend_c(expected.data(), src.data(), ct);
+        scanline_t32cb32blend_neon(actual.data(), src.data(), ct);
+        if (expected != actual) {
+            state.SkipWithError("NEON result differs from C");
+            return;
+        }
+    }
+
+    std::vector<uint32_t> dst(kWidth, 0xff336699);
+    for (auto _ : state) {
+        scanline_t32cb32blend_neon(dst.data(), src.data(), kWidth);
+        benchmark::DoNotOptimize(dst.data());
+    }
+    state.SetItemsProcessed(state.iterations() * kWidth);
+}
+BENCHMARK(BM_t32cb32blend_neon);
+#endif
+
+BENCHMARK_MAIN();
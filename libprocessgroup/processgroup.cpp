@@ -22,6 +22,7 @@
 #include <errno.h>
 #include <fcntl.h>
 #include <inttypes.h>
+#include <poll.h>
 #include <signal.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -31,17 +32,20 @@
 #include <unistd.h>
 
 #include <chrono>
+#include <map>
 #include <memory>
 #include <mutex>
 #include <set>
 #include <string>
 #include <thread>
+#include <tuple>
 
 #include <android-base/file.h>
 #include <android-base/logging.h>
 #include <android-base/properties.h>
 #include <android-base/stringprintf.h>
 #include <android-base/strings.h>
+#include <android-base/unique_fd.h>
 #include <cutils/android_filesystem_config.h>
 
 #include <processgroup/processgroup.h>
@@ -49,6 +53,7 @@
 using android::base::GetBoolProperty;
 using android::base::StartsWith;
 using android::base::StringPrintf;
+using android::base::unique_fd;
 using android::base::WriteStringToFile;
 
 using namespace std::chrono_literals;
@@ -57,6 +62,9 @@ static const char kCpuacctCgroup[] = "/acct";
 static const char kMemoryCgroup[] = "/dev/memcg/apps";
 
 #define PROCESSGROUP_CGROUP_PROCS_FILE "/cgroup.procs"
+// Only present when the hierarchy is mounted as cgroup v2.
+#define PROCESSGROUP_CGROUP_EVENTS_FILE "/cgroup.events"
+#define PROCESSGROUP_CGROUP_FREEZE_FILE "/cgroup.freeze"
 
 static bool isMemoryCgroupSupported() {
     static bool memcg_supported = !access("/dev/memcg/memory.limit_in_bytes", F_OK);
@@ -71,9 +79,26 @@ static std::string ConvertUidPidToPath(const char* cgroup, uid_t uid, int pid) {
     return StringPrintf("%s/uid_%d/pid_%d", cgroup, uid, pid);
 }
 
+// Files opened by SetProcessGroupValue, kept open so that repeated updates of a process group
+// only cost a write. Entries are dropped when their group is removed.
+using CgroupValueKey = std::tuple<uid_t, int, std::string>;
+static std::mutex cgroup_value_fds_lock;
+static std::map<CgroupValueKey, unique_fd> cgroup_value_fds;
+
+static void ForgetProcessGroupValueFds(uid_t uid, int pid) {
+    std::lock_guard<std::mutex> lock(cgroup_value_fds_lock);
+    auto it = cgroup_value_fds.lower_bound(CgroupValueKey(uid, pid, ""));
+    while (it != cgroup_value_fds.end() && std::get<0>(it->first) == uid &&
+           std::get<1>(it->first) == pid) {
+        it = cgroup_value_fds.erase(it);
+    }
+}
+
 static int RemoveProcessGroup(const char* cgroup, uid_t uid, int pid) {
     int ret;
 
+    ForgetProcessGroupValueFds(uid, pid);
+
     auto uid_pid_path = ConvertUidPidToPath(cgroup, uid, pid);
     ret = rmdir(uid_pid_path.c_str());
 
@@ -106,6 +131,10 @@ static void RemoveUidProcessGroups(const std::string& uid_path) {
 void removeAllProcessGroups()
 {
     LOG(VERBOSE) << "removeAllProcessGroups()";
+    {
+        std::lock_guard<std::mutex> lock(cgroup_value_fds_lock);
+        cgroup_value_fds.clear();
+    }
     for (const char* cgroup_root_path : {kCpuacctCgroup, kMemoryCgroup}) {
         std::unique_ptr<DIR, decltype(&closedir)> root(opendir(cgroup_root_path), closedir);
         if (root == NULL) {
@@ -199,6 +228,71 @@ static int DoKillProcessGroupOnce(const char* cgroup, uid_t uid, int initialPid,
     return feof(fd.get()) ? processes : -1;
 }
 
+// Waits up to 'timeout' for the "populated 0" line in cgroup.events, which the kernel
+// notifies pollers of with POLLPRI whenever it changes.
+static bool WaitForEmptyCgroup(const std::string& events_path, std::chrono::milliseconds timeout) {
+    unique_fd fd(TEMP_FAILURE_RETRY(open(events_path.c_str(), O_RDONLY | O_CLOEXEC)));
+    if (fd < 0) {
+        PLOG(WARNING) << "Failed to open " << events_path;
+        return false;
+    }
+
+    auto deadline = std::chrono::steady_clock::now() + timeout;
+    while (true) {
+        char buf[128];
+        ssize_t len = TEMP_FAILURE_RETRY(pread(fd, buf, sizeof(buf) - 1, 0));
+        if (len < 0) {
+            PLOG(WARNING) << "Failed to read " << events_path;
+            return false;
+        }
+        buf[len] = '\0';
+        if (strstr(buf, "populated 0") != nullptr) {
+            return true;
+        }
+
+        auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(
+                deadline - std::chrono::steady_clock::now());
+        if (remaining <= 0ms) {
+            return false;
+        }
+        struct pollfd pfd = {fd, POLLPRI, 0};
+        if (poll(&pfd, 1, remaining.count()) < 0 && errno != EINTR) {
+            PLOG(WARNING) << "Failed to poll " << events_path;
+            return false;
+        }
+    }
+}
+
+// On cgroup v2 the group is frozen while it is signalled, so that none of its processes can fork
+// new ones in the meantime, and a single pass of signals is enough. Instead of rereading
+// cgroup.procs after sleeps, we then wait for the kernel to report that the group is empty.
+// Returns true if the group was emptied within 'timeout'.
+static bool KillFrozenProcessGroup(const char* cgroup, uid_t uid, int initialPid, int signal,
+                                   std::chrono::milliseconds timeout) {
+    auto group_path = ConvertUidPidToPath(cgroup, uid, initialPid);
+    auto events_path = group_path + PROCESSGROUP_CGROUP_EVENTS_FILE;
+    if (access(events_path.c_str(), F_OK)) {
+        return false;
+    }
+
+    // cgroup.freeze needs a 5.2+ kernel, without it we still wait on cgroup.events.
+    auto freeze_path = group_path + PROCESSGROUP_CGROUP_FREEZE_FILE;
+    bool frozen = !access(freeze_path.c_str(), F_OK) && WriteStringToFile("1", freeze_path);
+
+    int processes = DoKillProcessGroupOnce(cgroup, uid, initialPid, signal);
+
+    // Signals other than SIGKILL are only handled once the processes run again.
+    if (frozen && !WriteStringToFile("0", freeze_path)) {
+        PLOG(WARNING) << "Failed to unfreeze " << group_path;
+    }
+
+    if (processes <= 0) {
+        return processes == 0;
+    }
+    LOG(VERBOSE) << "Killed " << processes << " processes for processgroup " << initialPid;
+    return WaitForEmptyCgroup(events_path, timeout);
+}
+
 static int KillProcessGroup(uid_t uid, int initialPid, int signal, int retries) {
     const char* cgroup =
             (!access(ConvertUidPidToPath(kCpuacctCgroup, uid, initialPid).c_str(), F_OK))
@@ -208,8 +302,13 @@ static int KillProcessGroup(uid_t uid, int initialPid, int signal, int retries)
     std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
 
     int retry = retries;
-    int processes;
-    while ((processes = DoKillProcessGroupOnce(cgroup, uid, initialPid, signal)) > 0) {
+    int processes = -1;
+    if (retries > 0 && KillFrozenProcessGroup(cgroup, uid, initialPid, signal, retries * 5ms)) {
+        processes = 0;
+    }
+    // Without cgroup v2, or if the group didn't empty in time, fall back to polling cgroup.procs.
+    while (processes != 0 &&
+           (processes = DoKillProcessGroupOnce(cgroup, uid, initialPid, signal)) > 0) {
         LOG(VERBOSE) << "Killed " << processes << " processes for processgroup " << initialPid;
         if (retry > 0) {
             std::this_thread::sleep_for(5ms);
@@ -319,13 +418,33 @@ static bool SetProcessGroupValue(uid_t uid, int pid, const std::string& file_nam
         return false;
     }
 
-    auto path = ConvertUidPidToPath(kMemoryCgroup, uid, pid) + file_name;
-
-    if (!WriteStringToFile(std::to_string(value), path)) {
-        PLOG(ERROR) << "Failed to write '" << value << "' to " << path;
-        return false;
+    std::string str = std::to_string(value);
+    std::lock_guard<std::mutex> lock(cgroup_value_fds_lock);
+    unique_fd& fd = cgroup_value_fds[CgroupValueKey(uid, pid, file_name)];
+    // A cached fd goes stale if the group was removed and recreated behind our back, so a
+    // failed write is retried once on a freshly opened file.
+    for (bool cached = fd >= 0;; cached = false) {
+        if (fd < 0) {
+            auto path = ConvertUidPidToPath(kMemoryCgroup, uid, pid) + file_name;
+            fd.reset(TEMP_FAILURE_RETRY(open(path.c_str(), O_WRONLY | O_CLOEXEC)));
+            if (fd < 0) {
+                PLOG(ERROR) << "Failed to open " << path;
+                cgroup_value_fds.erase(CgroupValueKey(uid, pid, file_name));
+                return false;
+            }
+        }
+        if (TEMP_FAILURE_RETRY(write(fd, str.c_str(), str.size())) ==
+            static_cast<ssize_t>(str.size())) {
+            return true;
+        }
+        if (!cached) {
+            PLOG(ERROR) << "Failed to write '" << value << "' to "
+                        << ConvertUidPidToPath(kMemoryCgroup, uid, pid) << file_name;
+            cgroup_value_fds.erase(CgroupValueKey(uid, pid, file_name));
+            return false;
+        }
+        fd.reset();
     }
-    return true;
 }
 
 bool setProcessGroupSwappiness(uid_t uid, int pid, int swappiness) {
@@ -16,16 +16,20 @@
 
 #pragma once
 
+#include <fcntl.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/mman.h>
 #include <sys/types.h>
+#include <unistd.h>
 
 #include <functional>
+#include <memory>
 #include <string>
 #include <vector>
 
 #include <android-base/file.h>
+#include <android-base/unique_fd.h>
 
 namespace android {
 namespace procinfo {
@@ -133,14 +137,64 @@ bool ReadMapFileContent(char* content, const CallbackType& callback) {
   return true;
 }
 
+// Enough for any line of a maps file: a path is at most PATH_MAX, and the
+// fields before it take less than 100 bytes.
+constexpr size_t kMapFileChunkSize = 16 * 1024;
+
+// Reads |map_file| a chunk at a time into |buffer|, calling |callback| for each
+// line as soon as it has been read, rather than reading the whole file first.
+// Nothing is allocated, so this can be used where malloc can't, and a caller
+// that keeps its buffer around reads maps at no memory cost beyond it. Fails
+// if a line doesn't fit in |buffer_size| - 1 bytes.
+template <class CallbackType>
+bool ReadMapFileChunked(const char* map_file, char* buffer, size_t buffer_size,
+                        const CallbackType& callback) {
+  android::base::unique_fd fd(TEMP_FAILURE_RETRY(open(map_file, O_RDONLY | O_CLOEXEC)));
+  if (fd == -1 || buffer_size < 2) {
+    return false;
+  }
+
+  // buffer holds [0, used): the partial line left over from the last chunk
+  // followed by what was just read. One byte is kept for the terminator.
+  size_t used = 0;
+  while (true) {
+    ssize_t n = TEMP_FAILURE_RETRY(read(fd, buffer + used, buffer_size - 1 - used));
+    if (n < 0) {
+      return false;
+    }
+    if (n == 0) {
+      // A last line without a newline.
+      buffer[used] = '\0';
+      return ReadMapFileContent(buffer, callback);
+    }
+    used += n;
+
+    char* last_newline = static_cast<char*>(memrchr(buffer, '\n', used));
+    if (last_newline == nullptr) {
+      if (used == buffer_size - 1) {
+        return false;
+      }
+      continue;
+    }
+    // Parse the complete lines, then move what's left to the front.
+    size_t complete = last_newline + 1 - buffer;
+    char next = buffer[complete];
+    buffer[complete] = '\0';
+    if (!ReadMapFileContent(buffer, callback)) {
+      return false;
+    }
+    buffer[complete] = next;
+    used -= complete;
+    memmove(buffer, buffer + complete, used);
+  }
+}
+
 inline bool ReadMapFile(
     const std::string& map_file,
     const std::function<void(uint64_t, uint64_t, uint16_t, uint64_t, const char*)>& callback) {
-  std::string content;
-  if (!android::base::ReadFileToString(map_file, &content)) {
-    return false;
-  }
-  return ReadMapFileContent(&content[0], callback);
+  // One chunk, rather than a string that grows to the size of the whole file.
+  std::unique_ptr<char[]> buffer(new char[kMapFileChunkSize]);
+  return ReadMapFileChunked(map_file.c_str(), buffer.get(), kMapFileChunkSize, callback);
 }
 
 inline bool ReadProcessMaps(
@@ -39,6 +39,21 @@ static void BM_ReadMapFile(benchmark::State& state) {
 }
 BENCHMARK(BM_ReadMapFile);
 
+static void BM_ReadMapFileChunked(benchmark::State& state) {
+  std::string map_file = android::base::GetExecutableDirectory() + "/testdata/maps";
+  std::vector<char> buffer(android::procinfo::kMapFileChunkSize);
+  for (auto _ : state) {
+    std::vector<android::procinfo::MapInfo> maps;
+    android::procinfo::ReadMapFileChunked(
+        map_file.c_str(), buffer.data(), buffer.size(),
+        [&](uint64_t start, uint64_t end, uint16_t flags, uint64_t pgoff, const char* name) {
+          maps.emplace_back(start, end, flags, pgoff, name);
+        });
+    CHECK_EQ(maps.size(), 2043u);
+  }
+}
+BENCHMARK(BM_ReadMapFileChunked);
+
 static void BM_unwindstack_FileMaps(benchmark::State& state) {
   std::string map_file = android::base::GetExecutableDirectory() + "/testdata/maps";
   for (auto _ : state) {
@@ -17,6 +17,7 @@
 #include <procinfo/process_map.h>
 
 #include <string>
+#include <vector>
 
 #include <android-base/file.h>
 
@@ -58,3 +59,64 @@ TEST(process_map, ReadProcessMaps) {
   ASSERT_TRUE(android::procinfo::ReadProcessMaps(getpid(), &maps));
   ASSERT_GT(maps.size(), 0u);
 }
+
+TEST(process_map, ReadMapFileChunked) {
+  std::string map_file = android::base::GetExecutableDirectory() + "/testdata/maps";
+  std::string content;
+  ASSERT_TRUE(android::base::ReadFileToString(map_file, &content));
+  std::vector<android::procinfo::MapInfo> expected;
+  ASSERT_TRUE(android::procinfo::ReadMapFileContent(
+      &content[0], [&](uint64_t start, uint64_t end, uint16_t flags, uint64_t pgoff,
+                       const char* name) { expected.emplace_back(start, end, flags, pgoff, name); }));
+  ASSERT_EQ(2043u, expected.size());
+
+  // Small buffers split lines across reads in every possible way.
+  for (size_t buffer_size : {200, 257, 4096, 65536}) {
+    std::vector<char> buffer(buffer_size);
+    std::vector<android::procinfo::MapInfo> maps;
+    ASSERT_TRUE(android::procinfo::ReadMapFileChunked(
+        map_file.c_str(), buffer.data(), buffer.size(),
+        [&](uint64_t start, uint64_t end, uint16_t flags, uint64_t pgoff, const char* name) {
+          maps.emplace_back(start, end, flags, pgoff, name);
+        }))
+        << buffer_size;
+    ASSERT_EQ(expected.size(), maps.size()) << buffer_size;
+    for (size_t i = 0; i < maps.size(); i++) {
+      ASSERT_EQ(expected[i].start, maps[i].start) << buffer_size << " " << i;
+      ASSERT_EQ(expected[i].end, maps[i].end) << buffer_size << " " << i;
+      ASSERT_EQ(expected[i].flags, maps[i].flags) << buffer_size << " " << i;
+      ASSERT_EQ(expected[i].pgoff, maps[i].pgoff) << buffer_size << " " << i;
+      ASSERT_EQ(expected[i].name, maps[i].name) << buffer_size << " " << i;
+    }
+  }
+}
+
+TEST(process_map, ReadMapFileChunked_line_too_long) {
+  std::string map_file = android::base::GetExecutableDirectory() + "/testdata/maps";
+  // Shorter than the longest line in the file.
+  char buffer[64];
+  ASSERT_FALSE(android::procinfo::ReadMapFileChunked(
+      map_file.c_str(), buffer, sizeof(buffer),
+      [](uint64_t, uint64_t, uint16_t, uint64_t, const char*) {}));
+}
+
+TEST(process_map, ReadMapFileChunked_no_trailing_newline) {
+  TemporaryFile tf;
+  ASSERT_TRUE(android::base::WriteStringToFd(
+      "00400000-00409000 r-xp 00000000 fc:00 426998  /usr/lib/gvfs/gvfsd-http\n"
+      "7f0000000000-7f0000001000 rw-p 00001000 00:00 0",
+      tf.fd));
+
+  char buffer[100];
+  std::vector<android::procinfo::MapInfo> maps;
+  ASSERT_TRUE(android::procinfo::ReadMapFileChunked(
+      tf.path, buffer, sizeof(buffer),
+      [&](uint64_t start, uint64_t end, uint16_t flags, uint64_t pgoff, const char* name) {
+        maps.emplace_back(start, end, flags, pgoff, name);
+      }));
+  ASSERT_EQ(2u, maps.size());
+  ASSERT_EQ("/usr/lib/gvfs/gvfsd-http", maps[0].name);
+  ASSERT_EQ(0x7f0000000000ULL, maps[1].start);
+  ASSERT_EQ(PROT_READ | PROT_WRITE, maps[1].flags);
+  ASSERT_EQ("", maps[1].name);
+}
@@ -16,6 +16,7 @@
 
 #include <assert.h>
 #include <errno.h>
+#include <limits.h>
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
@@ -147,7 +148,6 @@ void backed_block_list_move(struct backed_block_list* from, struct backed_block_
   }
 
   from->last_used = nullptr;
-  to->last_used = nullptr;
   if (from->data_blocks == start) {
     from->data_blocks = end->next;
   } else {
@@ -162,8 +162,17 @@ void backed_block_list_move(struct backed_block_list* from, struct backed_block_
   if (!to->data_blocks) {
     to->data_blocks = start;
     end->next = nullptr;
+  } else if (to->data_blocks->block > start->block) {
+    end->next = to->data_blocks;
+    to->data_blocks = start;
   } else {
-    for (bb = to->data_blocks; bb; bb = bb->next) {
+    /* Ranges are mostly moved in order, as sparse_file_resparse() does, so
+       start searching from the end of the previous move when possible */
+    if (to->last_used && to->last_used->block < start->block)
+      bb = to->last_used;
+    else
+      bb = to->data_blocks;
+    for (; bb; bb = bb->next) {
       if (!bb->next || bb->next->block > start->block) {
         end->next = bb->next;
         bb->next = start;
@@ -171,6 +180,7 @@ void backed_block_list_move(struct backed_block_list* from, struct backed_block_
       }
     }
   }
+  to->last_used = end;
 }
 
 /* may free b */
@@ -195,6 +205,11 @@ static int merge_bb(struct backed_block_list* bbl, struct backed_block* a, struc
     return -EINVAL;
   }
 
+  /* The merged length would not fit */
+  if (a->len > UINT_MAX - b->len) {
+    return -EINVAL;
+  }
+
   switch (a->type) {
     case BACKED_BLOCK_DATA:
       /* Don't support merging data for now */
@@ -38,7 +38,8 @@
 #endif
 
 void usage() {
-  fprintf(stderr, "Usage: img2simg <raw_image_file> <sparse_image_file> [<block_size>]\n");
+  fprintf(stderr, "Usage: img2simg [-s] <raw_image_file> <sparse_image_file> [<block_size>]\n");
+  fprintf(stderr, "  -s  Turn holes in the raw image into don't care chunks\n");
 }
 
 int main(int argc, char* argv[]) {
@@ -47,7 +48,22 @@ int main(int argc, char* argv[]) {
   int ret;
   struct sparse_file* s;
   unsigned int block_size = 4096;
+  enum sparse_read_mode mode = SPARSE_READ_MODE_NORMAL;
   off64_t len;
+  int opt;
+
+  while ((opt = getopt(argc, argv, "s")) != -1) {
+    switch (opt) {
+      case 's':
+        mode = SPARSE_READ_MODE_HOLE;
+        break;
+      default:
+        usage();
+        exit(-1);
+    }
+  }
+  argc -= optind - 1;
+  argv += optind - 1;
 
   if (argc < 3 || argc > 4) {
     usage();
@@ -93,7 +109,7 @@ int main(int argc, char* argv[]) {
   }
 
   sparse_file_verbose(s);
-  ret = sparse_file_read(s, in, false, false);
+  ret = sparse_file_read(s, in, mode, false);
   if (ret) {
     fprintf(stderr, "Failed to read file\n");
     exit(-1);
@@ -227,23 +227,43 @@ int sparse_file_foreach_chunk(struct sparse_file *s, bool sparse, bool crc,
 	int (*write)(void *priv, const void *data, size_t len, unsigned int block,
 		     unsigned int nr_blocks),
 	void *priv);
+/**
+ * enum sparse_read_mode - the method to use when reading in files
+ * @SPARSE_READ_MODE_NORMAL: The input is a regular file. Constant chunks of
+ *                           data (including holes) will be converted to
+ *                           fill chunks.
+ * @SPARSE_READ_MODE_SPARSE: The input is an Android sparse file.
+ * @SPARSE_READ_MODE_HOLE: The input is a regular file. Holes will be converted
+ *                         to "don't care" chunks. Other constant chunks will
+ *                         be converted to fill chunks.
+ */
+enum sparse_read_mode {
+	SPARSE_READ_MODE_NORMAL = false,
+	SPARSE_READ_MODE_SPARSE = true,
+	SPARSE_READ_MODE_HOLE,
+};
+
 /**
  * sparse_file_read - read a file into a sparse file cookie
  *
  * @s - sparse file cookie
  * @fd - file descriptor to read from
- * @sparse - read a file in the Android sparse file format
+ * @mode - mode to use when reading the input file
  * @crc - verify the crc of a file in the Android sparse file format
  *
- * Reads a file into a sparse file cookie.  If sparse is true, the file is
- * assumed to be in the Android sparse file format.  If sparse is false, the
- * file will be sparsed by looking for block aligned chunks of all zeros or
- * another 32 bit value.  If crc is true, the crc of the sparse file will be
- * verified.
+ * Reads a file into a sparse file cookie. If @mode is
+ * %SPARSE_READ_MODE_SPARSE, the file is assumed to be in the Android sparse
+ * file format. If @mode is %SPARSE_READ_MODE_NORMAL, the file will be sparsed
+ * by looking for block aligned chunks of all zeros or another 32 bit value.
+ * If @mode is %SPARSE_READ_MODE_HOLE, the file will be sparsed the same way,
+ * but holes in the file, as reported by SEEK_DATA/SEEK_HOLE, are not read
+ * and become "don't care" chunks. On systems without SEEK_HOLE this behaves
+ * like %SPARSE_READ_MODE_NORMAL. If crc is true, the crc of the sparse file
+ * will be verified.
  *
  * Returns 0 on success, negative errno on error.
  */
-int sparse_file_read(struct sparse_file *s, int fd, bool sparse, bool crc);
+int sparse_file_read(struct sparse_file *s, int fd, enum sparse_read_mode mode, bool crc);
 
 /**
  * sparse_file_read_buf - read a buffer into a sparse file cookie
@@ -307,6 +327,24 @@ struct sparse_file *sparse_file_import_buf(char* buf, bool verbose, bool crc);
  */
 struct sparse_file *sparse_file_import_auto(int fd, bool crc, bool verbose);
 
+/**
+ * sparse_file_copy_blocks - copy a range of blocks into another sparse file
+ *
+ * @in_s - sparse file cookie to copy from
+ * @out_s - sparse file cookie to copy to, with the same block size
+ * @block - first block of the range
+ * @nr_blocks - number of blocks in the range
+ *
+ * Adds the parts of the chunks of in_s that overlap the range to out_s, at
+ * the same block offsets.  The copies refer to the same data buffers, files
+ * and fds as in_s.  Blocks of the range that are holes in in_s stay holes in
+ * out_s.
+ *
+ * Returns 0 on success, negative errno on error.
+ */
+int sparse_file_copy_blocks(struct sparse_file *in_s, struct sparse_file *out_s,
+		unsigned int block, unsigned int nr_blocks);
+
 /** sparse_file_resparse - rechunk an existing sparse file into smaller files
  *
  * @in_s - sparse file cookie of the existing sparse file
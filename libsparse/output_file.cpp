@@ -36,6 +36,7 @@
 
 #ifndef _WIN32
 #include <sys/mman.h>
+#include <sys/uio.h>
 #define O_BINARY 0
 #else
 #define ftruncate64 ftruncate
@@ -60,6 +61,11 @@
 #define SPARSE_HEADER_LEN (sizeof(sparse_header_t))
 #define CHUNK_HEADER_LEN (sizeof(chunk_header_t))
 
+/* Small writes to a file are collected until this much is pending */
+#define WRITE_BUF_SIZE (1024 * 1024)
+/* Fill chunks are generated this many bytes at a time */
+#define FILL_BUF_SIZE (1024 * 1024)
+
 #define container_of(inner, outer_t, elem) ((outer_t*)((char*)(inner)-offsetof(outer_t, elem)))
 
 struct output_file_ops {
@@ -67,6 +73,7 @@ struct output_file_ops {
   int (*skip)(struct output_file*, int64_t);
   int (*pad)(struct output_file*, int64_t);
   int (*write)(struct output_file*, void*, size_t);
+  int (*flush)(struct output_file*);
   void (*close)(struct output_file*);
 };
 
@@ -88,6 +95,7 @@ struct output_file {
   int64_t len;
   char* zero_buf;
   uint32_t* fill_buf;
+  unsigned int fill_buf_len;
   char* buf;
 };
 
@@ -101,6 +109,8 @@ struct output_file_gz {
 struct output_file_normal {
   struct output_file out;
   int fd;
+  char* write_buf;
+  size_t write_buf_len;
 };
 
 #define to_output_file_normal(_o) container_of((_o), struct output_file_normal, out)
@@ -117,13 +127,95 @@ static int file_open(struct output_file* out, int fd) {
   struct output_file_normal* outn = to_output_file_normal(out);
 
   outn->fd = fd;
+  outn->write_buf = reinterpret_cast<char*>(malloc(WRITE_BUF_SIZE));
+  if (!outn->write_buf) {
+    error_errno("malloc write_buf");
+    return -ENOMEM;
+  }
+  outn->write_buf_len = 0;
   return 0;
 }
 
+/* Write out whatever is pending in write_buf followed by len bytes of data,
+ * in one system call where possible */
+static int file_write_through(struct output_file_normal* outn, void* data, size_t len) {
+#ifndef _WIN32
+  struct iovec iov[2] = {
+      {.iov_base = outn->write_buf, .iov_len = outn->write_buf_len},
+      {.iov_base = data, .iov_len = len},
+  };
+  struct iovec* cur = iov;
+  int cnt = 2;
+  ssize_t ret;
+
+  while (cnt > 0) {
+    if (cur->iov_len == 0) {
+      cur++;
+      cnt--;
+      continue;
+    }
+    ret = writev(outn->fd, cur, cnt);
+    if (ret < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      error_errno("writev");
+      return -1;
+    }
+
+    while (cnt > 0 && (size_t)ret >= cur->iov_len) {
+      ret -= cur->iov_len;
+      cur++;
+      cnt--;
+    }
+    if (cnt > 0) {
+      cur->iov_base = (char*)cur->iov_base + ret;
+      cur->iov_len -= ret;
+    }
+  }
+#else
+  void* bufs[2] = {outn->write_buf, data};
+  size_t lens[2] = {outn->write_buf_len, len};
+  ssize_t ret;
+
+  for (int i = 0; i < 2; i++) {
+    while (lens[i] > 0) {
+      ret = write(outn->fd, bufs[i], lens[i]);
+      if (ret < 0) {
+        if (errno == EINTR) {
+          continue;
+        }
+        error_errno("write");
+        return -1;
+      }
+
+      bufs[i] = (char*)bufs[i] + ret;
+      lens[i] -= ret;
+    }
+  }
+#endif
+
+  outn->write_buf_len = 0;
+  return 0;
+}
+
+static int file_flush(struct output_file* out) {
+  struct output_file_normal* outn = to_output_file_normal(out);
+
+  if (outn->write_buf_len == 0) {
+    return 0;
+  }
+  return file_write_through(outn, nullptr, 0);
+}
+
 static int file_skip(struct output_file* out, int64_t cnt) {
   off64_t ret;
   struct output_file_normal* outn = to_output_file_normal(out);
 
+  if (file_flush(out) < 0) {
+    return -1;
+  }
+
   ret = lseek64(outn->fd, cnt, SEEK_CUR);
   if (ret < 0) {
     error_errno("lseek64");
@@ -136,6 +228,11 @@ static int file_pad(struct output_file* out, int64_t len) {
   int ret;
   struct output_file_normal* outn = to_output_file_normal(out);
 
+  ret = file_flush(out);
+  if (ret < 0) {
+    return ret;
+  }
+
   ret = ftruncate64(outn->fd, len);
   if (ret < 0) {
     return -errno;
@@ -145,29 +242,23 @@ static int file_pad(struct output_file* out, int64_t len) {
 }
 
 static int file_write(struct output_file* out, void* data, size_t len) {
-  ssize_t ret;
   struct output_file_normal* outn = to_output_file_normal(out);
 
-  while (len > 0) {
-    ret = write(outn->fd, data, len);
-    if (ret < 0) {
-      if (errno == EINTR) {
-        continue;
-      }
-      error_errno("write");
-      return -1;
-    }
-
-    data = (char*)data + ret;
-    len -= ret;
+  /* Chunk headers, padding and fill blocks are gathered up, large chunks of
+   * data go straight out along with whatever was gathered before them */
+  if (outn->write_buf_len + len <= WRITE_BUF_SIZE) {
+    memcpy(outn->write_buf + outn->write_buf_len, data, len);
+    outn->write_buf_len += len;
+    return 0;
   }
 
-  return 0;
+  return file_write_through(outn, data, len);
 }
 
 static void file_close(struct output_file* out) {
   struct output_file_normal* outn = to_output_file_normal(out);
 
+  free(outn->write_buf);
   free(outn);
 }
 
@@ -176,6 +267,7 @@ static struct output_file_ops file_ops = {
     .skip = file_skip,
     .pad = file_pad,
     .write = file_write,
+    .flush = file_flush,
     .close = file_close,
 };
 
@@ -250,11 +342,16 @@ static void gz_file_close(struct output_file* out) {
   free(outgz);
 }
 
+static int gz_file_flush(struct output_file* out __unused) {
+  return 0;
+}
+
 static struct output_file_ops gz_file_ops = {
     .open = gz_file_open,
     .skip = gz_file_skip,
     .pad = gz_file_pad,
     .write = gz_file_write,
+    .flush = gz_file_flush,
     .close = gz_file_close,
 };
 
@@ -289,6 +386,10 @@ static int callback_file_write(struct output_file* out, void* data, size_t len)
   return outc->write(outc->priv, data, len);
 }
 
+static int callback_file_flush(struct output_file* out __unused) {
+  return 0;
+}
+
 static void callback_file_close(struct output_file* out) {
   struct output_file_callback* outc = to_output_file_callback(out);
 
@@ -300,6 +401,7 @@ static struct output_file_ops callback_file_ops = {
     .skip = callback_file_skip,
     .pad = callback_file_pad,
     .write = callback_file_write,
+    .flush = callback_file_flush,
     .close = callback_file_close,
 };
 
@@ -340,6 +442,13 @@ static int write_sparse_skip_chunk(struct output_file* out, int64_t skip_len) {
   ret = out->ops->write(out, &chunk_header, sizeof(chunk_header));
   if (ret < 0) return -1;
 
+  if (out->use_crc) {
+    /* The reader checksums the skipped blocks as zeroes */
+    for (int64_t i = 0; i < skip_len / out->block_size; i++) {
+      out->crc32 = sparse_crc32(out->crc32, out->zero_buf, out->block_size);
+    }
+  }
+
   out->cur_out_ptr += skip_len;
   out->chunk_cnt++;
 
@@ -348,7 +457,8 @@ static int write_sparse_skip_chunk(struct output_file* out, int64_t skip_len) {
 
 static int write_sparse_fill_chunk(struct output_file* out, unsigned int len, uint32_t fill_val) {
   chunk_header_t chunk_header;
-  int rnd_up_len, count;
+  unsigned int rnd_up_len, crc_len, count;
+  unsigned int i;
   int ret;
 
   /* Round up the fill length to a multiple of the block size */
@@ -366,8 +476,16 @@ static int write_sparse_fill_chunk(struct output_file* out, unsigned int len, ui
   if (ret < 0) return -1;
 
   if (out->use_crc) {
-    count = out->block_size / sizeof(uint32_t);
-    while (count--) out->crc32 = sparse_crc32(out->crc32, &fill_val, sizeof(uint32_t));
+    /* The checksum covers every block of the fill, as the reader computes it */
+    crc_len = rnd_up_len;
+    for (i = 0; i < min(crc_len, out->fill_buf_len) / sizeof(uint32_t); i++) {
+      out->fill_buf[i] = fill_val;
+    }
+    while (crc_len) {
+      count = min(crc_len, out->fill_buf_len);
+      out->crc32 = sparse_crc32(out->crc32, out->fill_buf, count);
+      crc_len -= count;
+    }
   }
 
   out->cur_out_ptr += rnd_up_len;
@@ -465,12 +583,12 @@ static int write_normal_fill_chunk(struct output_file* out, unsigned int len, ui
   unsigned int write_len;
 
   /* Initialize fill_buf with the fill_val */
-  for (i = 0; i < out->block_size / sizeof(uint32_t); i++) {
+  for (i = 0; i < min(len, out->fill_buf_len) / sizeof(uint32_t); i++) {
     out->fill_buf[i] = fill_val;
   }
 
   while (len) {
-    write_len = min(len, out->block_size);
+    write_len = min(len, out->fill_buf_len);
     ret = out->ops->write(out, out->fill_buf, write_len);
     if (ret < 0) {
       return ret;
@@ -497,9 +615,16 @@ static struct sparse_file_ops normal_file_ops = {
     .write_end_chunk = write_normal_end_chunk,
 };
 
-void output_file_close(struct output_file* out) {
+int output_file_close(struct output_file* out) {
+  int ret;
+
+  /* Padding isn't possible on every output, so only a failure to write out
+   * buffered data is reported */
   out->sparse_ops->write_end_chunk(out);
+  ret = out->ops->flush(out);
   out->ops->close(out);
+
+  return ret;
 }
 
 static int output_file_init(struct output_file* out, int block_size, int64_t len, bool sparse,
@@ -519,7 +644,11 @@ static int output_file_init(struct output_file* out, int block_size, int64_t len
     return -ENOMEM;
   }
 
-  out->fill_buf = reinterpret_cast<uint32_t*>(calloc(block_size, 1));
+  out->fill_buf_len = ALIGN_DOWN(FILL_BUF_SIZE, block_size);
+  if (out->fill_buf_len == 0) {
+    out->fill_buf_len = block_size;
+  }
+  out->fill_buf = reinterpret_cast<uint32_t*>(calloc(out->fill_buf_len, 1));
   if (!out->fill_buf) {
     error_errno("malloc fill_buf");
     ret = -ENOMEM;
@@ -629,11 +758,15 @@ struct output_file* output_file_open_fd(int fd, unsigned int block_size, int64_t
     return nullptr;
   }
 
-  out->ops->open(out, fd);
+  ret = out->ops->open(out, fd);
+  if (ret < 0) {
+    free(out);
+    return nullptr;
+  }
 
   ret = output_file_init(out, block_size, len, sparse, chunks, crc);
   if (ret < 0) {
-    free(out);
+    out->ops->close(out);
     return nullptr;
   }
 
@@ -15,8 +15,11 @@
  */
 
 #include <assert.h>
+#include <errno.h>
 #include <stdlib.h>
 
+#include <algorithm>
+
 #include <sparse/sparse.h>
 
 #include "defs.h"
@@ -148,7 +151,9 @@ int sparse_file_write(struct sparse_file* s, int fd, bool gz, bool sparse, bool
 
   ret = write_all_blocks(s, out);
 
-  output_file_close(out);
+  if (output_file_close(out) < 0 && !ret) {
+    ret = -EIO;
+  }
 
   return ret;
 }
@@ -248,16 +253,71 @@ unsigned int sparse_file_block_size(struct sparse_file* s) {
   return s->block_size;
 }
 
+int sparse_file_copy_blocks(struct sparse_file* in_s, struct sparse_file* out_s,
+                            unsigned int block, unsigned int nr_blocks) {
+  struct backed_block* bb;
+  unsigned int block_size = in_s->block_size;
+  int64_t end = static_cast<int64_t>(block) + nr_blocks;
+  int ret = 0;
+
+  if (out_s->block_size != block_size) {
+    return -EINVAL;
+  }
+
+  for (bb = backed_block_iter_new(in_s->backed_block_list); bb && !ret;
+       bb = backed_block_iter_next(bb)) {
+    unsigned int bb_block = backed_block_block(bb);
+    unsigned int bb_len = backed_block_len(bb);
+    int64_t bb_end = bb_block + DIV_ROUND_UP(static_cast<int64_t>(bb_len), block_size);
+    if (bb_end <= block) {
+      continue;
+    }
+    if (bb_block >= end) {
+      break;
+    }
+
+    unsigned int first = std::max(bb_block, block);
+    int64_t skip = static_cast<int64_t>(first - bb_block) * block_size;
+    unsigned int len = std::min(static_cast<int64_t>(bb_len), (end - bb_block) * block_size) - skip;
+    switch (backed_block_type(bb)) {
+      case BACKED_BLOCK_DATA:
+        ret = sparse_file_add_data(out_s, reinterpret_cast<char*>(backed_block_data(bb)) + skip,
+                                   len, first);
+        break;
+      case BACKED_BLOCK_FILE:
+        ret = sparse_file_add_file(out_s, backed_block_filename(bb),
+                                   backed_block_file_offset(bb) + skip, len, first);
+        break;
+      case BACKED_BLOCK_FD:
+        ret = sparse_file_add_fd(out_s, backed_block_fd(bb), backed_block_file_offset(bb) + skip,
+                                 len, first);
+        break;
+      case BACKED_BLOCK_FILL:
+        ret = sparse_file_add_fill(out_s, backed_block_fill_val(bb), len, first);
+        break;
+    }
+  }
+
+  return ret;
+}
+
+/* Returns the size of the chunk that write_all_blocks() emits for bb in a
+ * sparse file without a crc, without going through the data */
+static int64_t sparse_chunk_len(struct backed_block* bb, unsigned int block_size) {
+  if (backed_block_type(bb) == BACKED_BLOCK_FILL) {
+    return sizeof(chunk_header_t) + sizeof(uint32_t);
+  }
+  return sizeof(chunk_header_t) + ALIGN((int64_t)backed_block_len(bb), block_size);
+}
+
 static struct backed_block* move_chunks_up_to_len(struct sparse_file* from, struct sparse_file* to,
                                                   unsigned int len) {
   int64_t count = 0;
-  struct output_file* out_counter;
   struct backed_block* last_bb = nullptr;
   struct backed_block* bb;
   struct backed_block* start;
   unsigned int last_block = 0;
   int64_t file_len = 0;
-  int ret;
 
   /*
    * overhead is sparse file header, the potential end skip
@@ -267,23 +327,13 @@ static struct backed_block* move_chunks_up_to_len(struct sparse_file* from, stru
   len -= overhead;
 
   start = backed_block_iter_new(from->backed_block_list);
-  out_counter = output_file_open_callback(out_counter_write, &count, to->block_size, to->len, false,
-                                          true, 0, false);
-  if (!out_counter) {
-    return nullptr;
-  }
 
   for (bb = start; bb; bb = backed_block_iter_next(bb)) {
     count = 0;
     if (backed_block_block(bb) > last_block) count += sizeof(chunk_header_t);
     last_block = backed_block_block(bb) + DIV_ROUND_UP(backed_block_len(bb), to->block_size);
+    count += sparse_chunk_len(bb, to->block_size);
 
-    /* will call out_counter_write to update count */
-    ret = sparse_file_write_block(out_counter, bb);
-    if (ret) {
-      bb = nullptr;
-      goto out;
-    }
     if (file_len + count > len) {
       /*
        * If the remaining available size is more than 1/8th of the
@@ -304,9 +354,6 @@ static struct backed_block* move_chunks_up_to_len(struct sparse_file* from, stru
 move:
   backed_block_list_move(from->backed_block_list, to->backed_block_list, start, last_bb);
 
-out:
-  output_file_close(out_counter);
-
   return bb;
 }
 
@@ -17,6 +17,7 @@
 #define _FILE_OFFSET_BITS 64
 #define _LARGEFILE64_SOURCE 1
 
+#include <errno.h>
 #include <fcntl.h>
 #include <inttypes.h>
 #include <stdarg.h>
@@ -410,67 +411,124 @@ static int sparse_file_read_sparse(struct sparse_file* s, SparseFileSource* sour
   return 0;
 }
 
-static int sparse_file_read_normal(struct sparse_file* s, int fd) {
+/* Returns true if the block consists of the same 32 bit value repeated */
+static bool is_fill_block(const uint32_t* block, unsigned int block_size) {
+  /* Every word equals the next one iff the block equals itself shifted by a
+   * word, which lets memcmp do the comparison a vector at a time. */
+  return memcmp(block, block + 1, block_size - sizeof(uint32_t)) == 0;
+}
+
+static int do_sparse_file_read_normal(struct sparse_file* s, int fd, uint32_t* buf,
+                                      unsigned int buf_blocks, int64_t offset, int64_t remain) {
   int ret;
-  uint32_t* buf = (uint32_t*)malloc(s->block_size);
-  unsigned int block = 0;
-  int64_t remain = s->len;
-  int64_t offset = 0;
+  unsigned int block = offset / s->block_size;
   unsigned int to_read;
-  unsigned int i;
-  bool sparse_block;
+  unsigned int len;
 
-  if (!buf) {
-    return -ENOMEM;
+  if (lseek64(fd, offset, SEEK_SET) < 0) {
+    return -errno;
   }
 
   while (remain > 0) {
-    to_read = std::min(remain, (int64_t)(s->block_size));
+    to_read = std::min(remain, (int64_t)buf_blocks * s->block_size);
     ret = read_all(fd, buf, to_read);
     if (ret < 0) {
       error("failed to read sparse file");
-      free(buf);
       return ret;
     }
 
-    if (to_read == s->block_size) {
-      sparse_block = true;
-      for (i = 1; i < s->block_size / sizeof(uint32_t); i++) {
-        if (buf[0] != buf[i]) {
-          sparse_block = false;
-          break;
-        }
+    for (unsigned int pos = 0; pos < to_read; pos += len) {
+      const uint32_t* data = buf + pos / sizeof(uint32_t);
+      len = std::min(to_read - pos, s->block_size);
+
+      if (len == s->block_size && is_fill_block(data, len)) {
+        /* TODO: add flag to use skip instead of fill for data[0] == 0 */
+        sparse_file_add_fill(s, data[0], len, block);
+      } else {
+        sparse_file_add_fd(s, fd, offset, len, block);
       }
-    } else {
-      sparse_block = false;
-    }
 
-    if (sparse_block) {
-      /* TODO: add flag to use skip instead of fill for buf[0] == 0 */
-      sparse_file_add_fill(s, buf[0], to_read, block);
-    } else {
-      sparse_file_add_fd(s, fd, offset, to_read, block);
+      offset += len;
+      block++;
     }
 
     remain -= to_read;
-    offset += to_read;
-    block++;
   }
 
-  free(buf);
   return 0;
 }
 
-int sparse_file_read(struct sparse_file* s, int fd, bool sparse, bool crc) {
-  if (crc && !sparse) {
-    return -EINVAL;
+static int sparse_file_read_hole(struct sparse_file* s, int fd, uint32_t* buf,
+                                 unsigned int buf_blocks) {
+#if defined(SEEK_HOLE) && defined(SEEK_DATA)
+  int ret;
+  int64_t end = 0;
+
+  while (end < s->len) {
+    int64_t start = lseek64(fd, end, SEEK_DATA);
+    if (start < 0) {
+      /* Nothing but a hole up to the end of the file */
+      if (errno == ENXIO) break;
+      /* SEEK_DATA isn't supported here, read the whole file instead */
+      if (end == 0 && errno == EINVAL) {
+        return do_sparse_file_read_normal(s, fd, buf, buf_blocks, 0, s->len);
+      }
+      return -errno;
+    }
+    end = lseek64(fd, start, SEEK_HOLE);
+    if (end < 0) {
+      return -errno;
+    }
+
+    /* Read every block that holds some data, holes become don't care */
+    start = ALIGN_DOWN(start, s->block_size);
+    end = std::min(ALIGN(end, (int64_t)s->block_size), s->len);
+    ret = do_sparse_file_read_normal(s, fd, buf, buf_blocks, start, end - start);
+    if (ret < 0) {
+      return ret;
+    }
+  }
+
+  return 0;
+#else
+  return do_sparse_file_read_normal(s, fd, buf, buf_blocks, 0, s->len);
+#endif
+}
+
+static int sparse_file_read_normal(struct sparse_file* s, int fd, enum sparse_read_mode mode) {
+  int ret;
+  unsigned int buf_blocks = std::max((int64_t)1, COPY_BUF_SIZE / s->block_size);
+  uint32_t* buf = (uint32_t*)malloc((size_t)buf_blocks * s->block_size);
+
+  if (!buf) {
+    return -ENOMEM;
   }
 
-  if (sparse) {
-    SparseFileFdSource source(fd);
-    return sparse_file_read_sparse(s, &source, crc);
+  if (mode == SPARSE_READ_MODE_HOLE) {
+    ret = sparse_file_read_hole(s, fd, buf, buf_blocks);
   } else {
-    return sparse_file_read_normal(s, fd);
+    ret = do_sparse_file_read_normal(s, fd, buf, buf_blocks, 0, s->len);
+  }
+
+  free(buf);
+  return ret;
+}
+
+int sparse_file_read(struct sparse_file* s, int fd, enum sparse_read_mode mode, bool crc) {
+  if (crc && mode != SPARSE_READ_MODE_SPARSE) {
+    return -EINVAL;
+  }
+
+  switch (mode) {
+    case SPARSE_READ_MODE_SPARSE: {
+      SparseFileFdSource source(fd);
+      return sparse_file_read_sparse(s, &source, crc);
+    }
+    case SPARSE_READ_MODE_NORMAL:
+    case SPARSE_READ_MODE_HOLE:
+      return sparse_file_read_normal(s, fd, mode);
+    default:
+      return -EINVAL;
   }
 }
 
@@ -567,7 +625,7 @@ struct sparse_file* sparse_file_import_auto(int fd, bool crc, bool verbose) {
     return nullptr;
   }
 
-  ret = sparse_file_read_normal(s, fd);
+  ret = sparse_file_read_normal(s, fd, SPARSE_READ_MODE_NORMAL);
   if (ret < 0) {
     sparse_file_destroy(s);
     return nullptr;
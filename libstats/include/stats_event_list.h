@@ -26,6 +26,19 @@ void reset_log_context(android_log_context ctx);
 int write_to_logger(android_log_context context, log_id_t id);
 void note_log_drop(int error);
 void stats_log_close();
+/*
+ * Opt-in batching of the calling process's atoms. Each thread keeps up to
+ * |max_atoms| atoms (at most 64) and sends them together with one syscall
+ * once that many are pending, or on the first write after the oldest has
+ * waited |max_delay_ms| (no time bound if <= 0). Atoms keep the timestamp
+ * of their write. A batch that statsd cannot take yet (EAGAIN) is retried
+ * on the next flush instead of being dropped. Pending atoms are otherwise
+ * only sent by stats_log_flush() or when their thread exits, so a thread
+ * that may go idle should flush. A |max_atoms| <= 1 turns batching off.
+ */
+void stats_log_set_batching(int max_atoms, int max_delay_ms);
+/* Sends the calling thread's batched atoms. Returns 0 or -errno. */
+int stats_log_flush();
 int android_log_write_char_array(android_log_context ctx, const char* value, size_t len);
 #ifdef __cplusplus
 }
@@ -124,7 +124,16 @@ void note_log_drop(int error) {
     statsdLoggerWrite.noteDrop(error);
 }
 
+void stats_log_set_batching(int max_atoms, int max_delay_ms) {
+    statsd_writer_set_batching(max_atoms, max_delay_ms);
+}
+
+int stats_log_flush() {
+    return statsdLoggerWrite.flush ? (*statsdLoggerWrite.flush)() : 0;
+}
+
 void stats_log_close() {
+    stats_log_flush();
     statsd_writer_init_lock();
     write_to_statsd = __write_to_statsd_init;
     if (statsdLoggerWrite.close) {
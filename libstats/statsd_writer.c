@@ -22,6 +22,7 @@
 #include <fcntl.h>
 #include <inttypes.h>
 #include <poll.h>
+#include <pthread.h>
 #include <private/android_filesystem_config.h>
 #include <private/android_logger.h>
 #include <stdarg.h>
@@ -51,6 +52,37 @@ static pthread_mutex_t log_init_lock = PTHREAD_MUTEX_INITIALIZER;
 static atomic_int dropped = 0;
 static atomic_int log_error = 0;
 
+#if defined(__linux__)
+#define STATSD_BATCHING 1
+#endif
+
+#ifdef STATSD_BATCHING
+/*
+ * Per-thread batching of atoms. Every atom is still sent as its own datagram
+ * with its own header, so statsd receives exactly what unbatched writes would
+ * have sent; the datagrams are only deferred and handed to the kernel
+ * together with one sendmmsg().
+ */
+#define STATSD_BATCH_MAX_ATOMS 64
+#define STATSD_BATCH_BYTES (16 * 1024)
+
+static atomic_int batch_max_atoms = 0; /* <= 1 disables batching */
+static atomic_int batch_max_delay_ms = 0;
+
+struct statsd_batch {
+    unsigned count;
+    size_t used;
+    int busy;               /* set while appending, see statsdGetBatch() */
+    struct timespec oldest; /* CLOCK_MONOTONIC time of the first pending atom */
+    struct mmsghdr msgs[STATSD_BATCH_MAX_ATOMS];
+    struct iovec iov[STATSD_BATCH_MAX_ATOMS];
+    uint8_t data[STATSD_BATCH_BYTES];
+};
+
+static pthread_once_t batch_key_once = PTHREAD_ONCE_INIT;
+static pthread_key_t batch_key;
+#endif
+
 void statsd_writer_init_lock() {
     /*
      * If we trigger a signal handler in the middle of locked activity and the
@@ -72,6 +104,7 @@ static int statsdOpen();
 static void statsdClose();
 static int statsdWrite(struct timespec* ts, struct iovec* vec, size_t nr);
 static void statsdNoteDrop();
+static int statsdFlush();
 
 struct android_log_transport_write statsdLoggerWrite = {
         .name = "statsd",
@@ -81,6 +114,7 @@ struct android_log_transport_write statsdLoggerWrite = {
         .close = statsdClose,
         .write = statsdWrite,
         .noteDrop = statsdNoteDrop,
+        .flush = statsdFlush,
 };
 
 /* log_init_lock assumed */
@@ -152,11 +186,268 @@ static int statsdAvailable() {
     return 1;
 }
 
-static void statsdNoteDrop(int error) {
-    atomic_fetch_add_explicit(&dropped, 1, memory_order_relaxed);
+static void statsdNoteDrops(int count, int error) {
+    atomic_fetch_add_explicit(&dropped, count, memory_order_relaxed);
     atomic_exchange_explicit(&log_error, error, memory_order_relaxed);
 }
 
+static void statsdNoteDrop(int error) {
+    statsdNoteDrops(1, error);
+}
+
+/* If we dropped events before, try to tell statsd. */
+static void statsdReportDrops(int sock, android_log_header_t header) {
+    /*
+     * Plain load first: the exchange below is a write to a cache line shared
+     * by every logging thread, and there are almost never drops to report.
+     */
+    if (sock < 0 || !atomic_load_explicit(&dropped, memory_order_relaxed)) {
+        return;
+    }
+    int32_t snapshot = atomic_exchange_explicit(&dropped, 0, memory_order_relaxed);
+    if (snapshot) {
+        android_log_event_int_t buffer;
+        struct iovec vec[2];
+        ssize_t ret;
+
+        header.id = LOG_ID_STATS;
+        // store the last log error in the tag field. This tag field is not used by statsd.
+        buffer.header.tag = htole32(atomic_load(&log_error));
+        buffer.payload.type = EVENT_TYPE_INT;
+        buffer.payload.data = htole32(snapshot);
+
+        vec[0].iov_base = &header;
+        vec[0].iov_len = sizeof(header);
+        vec[1].iov_base = &buffer;
+        vec[1].iov_len = sizeof(buffer);
+
+        ret = TEMP_FAILURE_RETRY(writev(sock, vec, 2));
+        if (ret != (ssize_t)(sizeof(header) + sizeof(buffer))) {
+            atomic_fetch_add_explicit(&dropped, snapshot, memory_order_relaxed);
+        }
+    }
+}
+
+static int statsdReconnectable(int negative_errno) {
+    switch (negative_errno) {
+        case -ENOTCONN:
+        case -ECONNREFUSED:
+        case -ENOENT:
+            return 1;
+        default:
+            return 0;
+    }
+}
+
+#ifdef STATSD_BATCHING
+/*
+ * Sends every pending datagram of |batch|. On EAGAIN the unsent ones are kept
+ * for the next flush; on any other error they are counted as dropped, since
+ * their writers were already told they were sent.
+ */
+static int statsdFlushBatch(struct statsd_batch* batch) {
+    unsigned sent = 0, i;
+    int ret = 0, retried = 0;
+    int sock = atomic_load(&statsdLoggerWrite.sock);
+    android_log_header_t header;
+
+    if (!batch->count) {
+        return 0;
+    }
+
+    memcpy(&header, batch->data, sizeof(header));
+    statsdReportDrops(sock, header);
+
+    while (sent < batch->count) {
+        if (sock < 0) {
+            ret = sock;
+        } else {
+            int n = TEMP_FAILURE_RETRY(
+                    sendmmsg(sock, batch->msgs + sent, batch->count - sent, 0));
+            if (n > 0) {
+                sent += n;
+                continue;
+            }
+            ret = n < 0 ? -errno : -EAGAIN;
+        }
+        if (retried || !statsdReconnectable(ret)) {
+            break;
+        }
+        retried = 1;
+        if (statd_writer_trylock()) {
+            break;
+        }
+        __statsdClose(ret);
+        ret = statsdOpen();
+        statsd_writer_init_unlock();
+        if (ret < 0) {
+            break;
+        }
+        sock = atomic_load(&statsdLoggerWrite.sock);
+    }
+
+    if (sent == batch->count) {
+        batch->count = 0;
+        batch->used = 0;
+        return 0;
+    }
+    if (ret != -EAGAIN) {
+        statsdNoteDrops(batch->count - sent, ret);
+        batch->count = 0;
+        batch->used = 0;
+        return ret;
+    }
+
+    /* Move the unsent datagrams to the front. */
+    if (sent) {
+        size_t offset = (uint8_t*)batch->iov[sent].iov_base - batch->data;
+        memmove(batch->data, batch->data + offset, batch->used - offset);
+        batch->used -= offset;
+        batch->count -= sent;
+        for (i = 0; i < batch->count; i++) {
+            batch->iov[i].iov_base = (uint8_t*)batch->iov[i + sent].iov_base - offset;
+            batch->iov[i].iov_len = batch->iov[i + sent].iov_len;
+            batch->msgs[i].msg_hdr.msg_iov = &batch->iov[i];
+        }
+    }
+    return ret;
+}
+
+static void statsdBatchDestroy(void* arg) {
+    struct statsd_batch* batch = arg;
+    if (statsdFlushBatch(batch) == -EAGAIN) {
+        statsdNoteDrops(batch->count, -EAGAIN);
+    }
+    free(batch);
+}
+
+static void statsdBatchKeyInit() {
+    pthread_key_create(&batch_key, statsdBatchDestroy);
+}
+
+/*
+ * Returns the calling thread's batch, or NULL if its atoms should be written
+ * directly: batching is off, allocation failed, or a signal handler is
+ * logging while the thread itself is in the middle of an append.
+ */
+static struct statsd_batch* statsdGetBatch() {
+    struct statsd_batch* batch;
+
+    pthread_once(&batch_key_once, statsdBatchKeyInit);
+    batch = pthread_getspecific(batch_key);
+    if (atomic_load_explicit(&batch_max_atoms, memory_order_relaxed) <= 1) {
+        /* Batching was turned off, send whatever is left first. */
+        if (batch && !batch->busy) {
+            statsdFlushBatch(batch);
+        }
+        return NULL;
+    }
+    if (!batch) {
+        batch = malloc(sizeof(*batch));
+        if (!batch) {
+            return NULL;
+        }
+        batch->count = 0;
+        batch->used = 0;
+        batch->busy = 0;
+        if (pthread_setspecific(batch_key, batch)) {
+            free(batch);
+            return NULL;
+        }
+    }
+    return batch->busy ? NULL : batch;
+}
+
+static int64_t statsdElapsedMs(const struct timespec* since) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - since->tv_sec) * 1000 + (now.tv_nsec - since->tv_nsec) / 1000000;
+}
+
+static int statsdBatchWrite(struct statsd_batch* batch, const android_log_header_t* header,
+                            struct iovec* vec, size_t nr) {
+    size_t i, len, payloadSize = 0;
+    uint8_t* p;
+    int max_atoms, max_delay_ms;
+
+    for (i = 0; i < nr; i++) {
+        payloadSize += vec[i].iov_len;
+    }
+    payloadSize = min(payloadSize, (size_t)LOGGER_ENTRY_MAX_PAYLOAD);
+
+    batch->busy = 1;
+    if (batch->count == STATSD_BATCH_MAX_ATOMS ||
+        batch->used + sizeof(*header) + payloadSize > sizeof(batch->data)) {
+        statsdFlushBatch(batch);
+        if (batch->count == STATSD_BATCH_MAX_ATOMS ||
+            batch->used + sizeof(*header) + payloadSize > sizeof(batch->data)) {
+            /* statsd is still not keeping up; the caller notes this drop. */
+            batch->busy = 0;
+            return -EAGAIN;
+        }
+    }
+
+    if (!batch->count) {
+        clock_gettime(CLOCK_MONOTONIC, &batch->oldest);
+    }
+    p = batch->data + batch->used;
+    memcpy(p, header, sizeof(*header));
+    p += sizeof(*header);
+    for (len = 0, i = 0; i < nr && len < payloadSize; i++) {
+        size_t n = min(vec[i].iov_len, payloadSize - len);
+        memcpy(p + len, vec[i].iov_base, n);
+        len += n;
+    }
+
+    batch->iov[batch->count].iov_base = batch->data + batch->used;
+    batch->iov[batch->count].iov_len = sizeof(*header) + payloadSize;
+    memset(&batch->msgs[batch->count], 0, sizeof(batch->msgs[batch->count]));
+    batch->msgs[batch->count].msg_hdr.msg_iov = &batch->iov[batch->count];
+    batch->msgs[batch->count].msg_hdr.msg_iovlen = 1;
+    batch->used += sizeof(*header) + payloadSize;
+    batch->count++;
+
+    max_atoms = atomic_load_explicit(&batch_max_atoms, memory_order_relaxed);
+    max_delay_ms = atomic_load_explicit(&batch_max_delay_ms, memory_order_relaxed);
+    if (batch->count >= (unsigned)max_atoms ||
+        (max_delay_ms > 0 && statsdElapsedMs(&batch->oldest) >= max_delay_ms)) {
+        statsdFlushBatch(batch);
+    }
+    batch->busy = 0;
+
+    return payloadSize;
+}
+#endif
+
+void statsd_writer_set_batching(int max_atoms, int max_delay_ms) {
+#ifdef STATSD_BATCHING
+    if (max_atoms > STATSD_BATCH_MAX_ATOMS) {
+        max_atoms = STATSD_BATCH_MAX_ATOMS;
+    }
+    atomic_store(&batch_max_delay_ms, max_delay_ms);
+    atomic_store(&batch_max_atoms, max_atoms);
+    if (max_atoms <= 1) {
+        statsdFlush();
+    }
+#else
+    (void)max_atoms;
+    (void)max_delay_ms;
+#endif
+}
+
+static int statsdFlush() {
+#ifdef STATSD_BATCHING
+    struct statsd_batch* batch;
+
+    pthread_once(&batch_key_once, statsdBatchKeyInit);
+    batch = pthread_getspecific(batch_key);
+    if (batch && !batch->busy) {
+        return statsdFlushBatch(batch);
+    }
+#endif
+    return 0;
+}
+
 static int statsdWrite(struct timespec* ts, struct iovec* vec, size_t nr) {
     ssize_t ret;
     int sock;
@@ -192,35 +483,24 @@ static int statsdWrite(struct timespec* ts, struct iovec* vec, size_t nr) {
      *  };
      */
 
+    header.id = LOG_ID_STATS;
     header.tid = gettid();
     header.realtime.tv_sec = ts->tv_sec;
     header.realtime.tv_nsec = ts->tv_nsec;
 
-    newVec[0].iov_base = (unsigned char*)&header;
-    newVec[0].iov_len = sizeof(header);
-
-    // If we dropped events before, try to tell statsd.
+#ifdef STATSD_BATCHING
     if (sock >= 0) {
-        int32_t snapshot = atomic_exchange_explicit(&dropped, 0, memory_order_relaxed);
-        if (snapshot) {
-            android_log_event_int_t buffer;
-            header.id = LOG_ID_STATS;
-            // store the last log error in the tag field. This tag field is not used by statsd.
-            buffer.header.tag = htole32(atomic_load(&log_error));
-            buffer.payload.type = EVENT_TYPE_INT;
-            buffer.payload.data = htole32(snapshot);
-
-            newVec[headerLength].iov_base = &buffer;
-            newVec[headerLength].iov_len = sizeof(buffer);
-
-            ret = TEMP_FAILURE_RETRY(writev(sock, newVec, 2));
-            if (ret != (ssize_t)(sizeof(header) + sizeof(buffer))) {
-                atomic_fetch_add_explicit(&dropped, snapshot, memory_order_relaxed);
-            }
+        struct statsd_batch* batch = statsdGetBatch();
+        if (batch) {
+            return statsdBatchWrite(batch, &header, vec, nr);
         }
     }
+#endif
 
-    header.id = LOG_ID_STATS;
+    newVec[0].iov_base = (unsigned char*)&header;
+    newVec[0].iov_len = sizeof(header);
+
+    statsdReportDrops(sock, header);
 
     for (payloadSize = 0, i = headerLength; i < nr + headerLength; i++) {
         newVec[i].iov_base = vec[i - headerLength].iov_base;
@@ -30,6 +30,11 @@ void statsd_writer_init_lock();
 int statsd_writer_init_trylock();
 void statsd_writer_init_unlock();
 
+/**
+ * Per-thread batching, see stats_log_set_batching().
+ */
+void statsd_writer_set_batching(int max_atoms, int max_delay_ms);
+
 struct android_log_transport_write {
     const char* name; /* human name to describe the transport */
     atomic_int sock;
@@ -40,6 +45,8 @@ struct android_log_transport_write {
     int (*write)(struct timespec* ts, struct iovec* vec, size_t nr);
     /* note one log drop */
     void (*noteDrop)(int error);
+    /* send the calling thread's batched logs, returns 0 or -errno */
+    int (*flush)();
 };
 
 #endif  // ANDROID_STATS_LOG_STATS_WRITER_H
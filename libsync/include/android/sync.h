@@ -37,6 +37,8 @@
  * break builds.
  */
 
+#include <stddef.h>
+
 #include "../ndk/sync.h"
 
 __BEGIN_DECLS
@@ -44,6 +46,24 @@ __BEGIN_DECLS
 /* timeout in msecs */
 int sync_wait(int fd, int timeout);
 
+/* sync_wait_many() flags */
+#define SYNC_WAIT_ALL 0 /* return once every fence has signaled */
+#define SYNC_WAIT_ANY 1 /* return once any fence has signaled */
+
+/* Waits for count fences with a single poll() at a time, timeout in msecs.
+ * Negative fds stand for fences that already signaled. Returns 0 once all of
+ * them signaled (SYNC_WAIT_ALL), or the index of one that did (SYNC_WAIT_ANY).
+ * Returns -1 and sets errno like sync_wait() otherwise.
+ */
+int sync_wait_many(const int* fds, size_t count, int timeout, int flags);
+
+/* Merges count fences into one with a balanced tree of merges, closing the
+ * intermediate fences on the way. Negative fds are skipped; a single
+ * remaining fence is dup()ed. Returns -1 and sets errno on failure, including
+ * EINVAL when there is no fence at all to merge.
+ */
+int sync_merge_many(const char* name, const int* fds, size_t count);
+
 __END_DECLS
 
 #endif /* __SYS_CORE_SYNC_H */
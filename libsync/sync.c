@@ -22,7 +22,10 @@
 #include <poll.h>
 #include <stdatomic.h>
 #include <stdint.h>
+#include <stdlib.h>
 #include <string.h>
+#include <time.h>
+#include <unistd.h>
 
 #include <sys/ioctl.h>
 #include <sys/stat.h>
@@ -206,6 +209,186 @@ int sync_merge(const char *name, int fd1, int fd2)
     return ret;
 }
 
+static int64_t now_ms(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+int sync_wait_many(const int *fds, size_t count, int timeout, int flags)
+{
+    struct pollfd stack_pfds[16];
+    struct pollfd *pfds = stack_pfds;
+    size_t *indices = NULL;
+    size_t stack_indices[16];
+    size_t pending = 0;
+    int64_t deadline = 0;
+    size_t i, j;
+    int ret = 0;
+
+    if ((fds == NULL && count) || (flags != SYNC_WAIT_ALL && flags != SYNC_WAIT_ANY)) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    if (count > sizeof(stack_pfds) / sizeof(stack_pfds[0])) {
+        pfds = malloc(count * sizeof(*pfds));
+        indices = malloc(count * sizeof(*indices));
+        if (pfds == NULL || indices == NULL) {
+            free(pfds);
+            free(indices);
+            errno = ENOMEM;
+            return -1;
+        }
+    } else {
+        indices = stack_indices;
+    }
+
+    for (i = 0; i < count; i++) {
+        if (fds[i] < 0) {
+            /* Already signaled */
+            if (flags == SYNC_WAIT_ANY) {
+                ret = i;
+                goto out;
+            }
+            continue;
+        }
+        pfds[pending].fd = fds[i];
+        pfds[pending].events = POLLIN;
+        indices[pending] = i;
+        pending++;
+    }
+
+    if (timeout > 0) {
+        deadline = now_ms() + timeout;
+    }
+
+    while (pending) {
+        int n = poll(pfds, pending, timeout);
+        if (n == -1) {
+            if (errno == EINTR || errno == EAGAIN) {
+                goto next;
+            }
+            ret = -1;
+            goto out;
+        }
+        if (n == 0) {
+            errno = ETIME;
+            ret = -1;
+            goto out;
+        }
+
+        /* Drop what signaled, and poll again for the rest */
+        for (i = 0, j = 0; i < pending; i++) {
+            if (pfds[i].revents & (POLLERR | POLLNVAL)) {
+                errno = EINVAL;
+                ret = -1;
+                goto out;
+            }
+            if (pfds[i].revents) {
+                if (flags == SYNC_WAIT_ANY) {
+                    ret = indices[i];
+                    goto out;
+                }
+                continue;
+            }
+            pfds[j] = pfds[i];
+            indices[j] = indices[i];
+            j++;
+        }
+        pending = j;
+
+next:
+        if (timeout > 0) {
+            int64_t left = deadline - now_ms();
+            timeout = left > 0 ? left : 0;
+        }
+    }
+
+out:
+    if (pfds != stack_pfds) {
+        free(pfds);
+        free(indices);
+    }
+    return ret;
+}
+
+/* Merges fds[0..count) pairwise, halves first, so that no fence gets copied
+ * into more than log2(count) intermediate ones. */
+static int sync_merge_range(const char *name, const int *fds, size_t count)
+{
+    int left, right, ret;
+    int saved_errno;
+
+    if (count == 1) {
+        return dup(fds[0]);
+    }
+    if (count == 2) {
+        return sync_merge(name, fds[0], fds[1]);
+    }
+
+    left = sync_merge_range(name, fds, count / 2);
+    if (left < 0) {
+        return -1;
+    }
+    right = sync_merge_range(name, fds + count / 2, count - count / 2);
+    if (right < 0) {
+        saved_errno = errno;
+        close(left);
+        errno = saved_errno;
+        return -1;
+    }
+
+    ret = sync_merge(name, left, right);
+    saved_errno = errno;
+    close(left);
+    close(right);
+    errno = saved_errno;
+    return ret;
+}
+
+int sync_merge_many(const char *name, const int *fds, size_t count)
+{
+    int stack_valid[16];
+    int *valid = stack_valid;
+    size_t n = 0;
+    size_t i;
+    int ret;
+
+    if (fds == NULL && count) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    if (count > sizeof(stack_valid) / sizeof(stack_valid[0])) {
+        valid = malloc(count * sizeof(*valid));
+        if (valid == NULL) {
+            errno = ENOMEM;
+            return -1;
+        }
+    }
+
+    for (i = 0; i < count; i++) {
+        if (fds[i] >= 0) {
+            valid[n++] = fds[i];
+        }
+    }
+
+    if (n == 0) {
+        errno = EINVAL;
+        ret = -1;
+    } else {
+        ret = sync_merge_range(name, valid, n);
+    }
+
+    if (valid != stack_valid) {
+        free(valid);
+    }
+    return ret;
+}
+
 static struct sync_fence_info_data *legacy_sync_fence_info(int fd)
 {
     struct sync_fence_info_data *legacy_info;
@@ -14,6 +14,7 @@
 #include <tuple>
 #include <random>
 #include <unordered_map>
+#include <memory>
 
 /* These deprecated declarations were in the legacy android/sync.h. They've been removed to
  * encourage code to move to the modern equivalents. But they are still implemented in libsync.so
@@ -477,6 +478,74 @@ TEST(FenceTest, MultiTimelineWait) {
     ASSERT_EQ(mergedFence.wait(100), 0);
 }
 
+TEST(FenceTest, WaitMany) {
+    SyncTimeline timelineA, timelineB, timelineC;
+
+    SyncFence fenceA(timelineA, 5);
+    SyncFence fenceB(timelineB, 5);
+    SyncFence fenceC(timelineC, 5);
+    int fds[] = {fenceA.getFd(), -1, fenceB.getFd(), fenceC.getFd()};
+
+    // Nothing signaled but the -1 placeholder.
+    ASSERT_EQ(sync_wait_many(fds, 4, 0, SYNC_WAIT_ALL), -1);
+    ASSERT_EQ(errno, ETIME);
+    ASSERT_EQ(sync_wait_many(fds, 4, 0, SYNC_WAIT_ANY), 1);
+    fds[1] = fenceA.getFd();
+    ASSERT_EQ(sync_wait_many(fds, 4, 0, SYNC_WAIT_ANY), -1);
+    ASSERT_EQ(errno, ETIME);
+
+    timelineB.inc(5);
+    ASSERT_EQ(sync_wait_many(fds, 4, 100, SYNC_WAIT_ANY), 2);
+    ASSERT_EQ(sync_wait_many(fds, 4, 0, SYNC_WAIT_ALL), -1);
+    ASSERT_EQ(errno, ETIME);
+
+    timelineA.inc(5);
+    timelineC.inc(5);
+    ASSERT_EQ(sync_wait_many(fds, 4, 100, SYNC_WAIT_ALL), 0);
+
+    ASSERT_EQ(sync_wait_many(fds, 4, 0, 42), -1);
+    ASSERT_EQ(errno, EINVAL);
+}
+
+TEST(FenceTest, MergeMany) {
+    const int kTimelines = 37;
+    vector<unique_ptr<SyncTimeline>> timelines;
+    vector<unique_ptr<SyncFence>> fences;
+    vector<int> fds;
+    for (int i = 0; i < kTimelines; i++) {
+        timelines.emplace_back(new SyncTimeline);
+        fences.emplace_back(new SyncFence(*timelines.back(), 1));
+        ASSERT_TRUE(fences.back()->isValid());
+        fds.push_back(fences.back()->getFd());
+        // Skipped placeholders for fences that already signaled.
+        if (i % 5 == 0) fds.push_back(-1);
+    }
+
+    int merged = sync_merge_many("merged", fds.data(), fds.size());
+    ASSERT_GE(merged, 0);
+    struct sync_file_info* info = sync_file_info(merged);
+    ASSERT_NE(info, nullptr);
+    ASSERT_EQ(info->num_fences, kTimelines);
+    sync_file_info_free(info);
+
+    for (int i = 0; i < kTimelines; i++) {
+        ASSERT_EQ(sync_wait(merged, 0), -1);
+        timelines[i]->inc(1);
+    }
+    ASSERT_EQ(sync_wait(merged, 100), 0);
+    close(merged);
+
+    // A single fence comes back as is, none at all is an error.
+    int single = fences[0]->getFd();
+    merged = sync_merge_many("single", &single, 1);
+    ASSERT_GE(merged, 0);
+    ASSERT_NE(merged, single);
+    close(merged);
+    int none = -1;
+    ASSERT_EQ(sync_merge_many("none", &none, 1), -1);
+    ASSERT_EQ(errno, EINVAL);
+}
+
 TEST(FenceTest, GetInfoActive) {
     SyncTimeline timeline;
     ASSERT_TRUE(timeline.isValid());
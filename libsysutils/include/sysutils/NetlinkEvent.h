@@ -16,9 +16,13 @@
 #ifndef _NETLINKEVENT_H
 #define _NETLINKEVENT_H
 
+#include <stddef.h>
+#include <stdint.h>
+
 #include <sysutils/NetlinkListener.h>
 
 #define NL_PARAMS_MAX 32
+#define NL_STORAGE_SIZE 1024
 
 class NetlinkEvent {
 public:
@@ -38,15 +42,23 @@ public:
 
 private:
     int  mSeq;
-    char *mPath;
+    const char *mPath;
     Action mAction;
-    char *mSubsystem;
-    char *mParams[NL_PARAMS_MAX];
+    const char *mSubsystem;
+    const char *mParams[NL_PARAMS_MAX];
+
+    // Binary messages format their params into mStorage. Params which don't
+    // fit are allocated on the heap and flagged in mHeapParams.
+    char mStorage[NL_STORAGE_SIZE];
+    size_t mStorageUsed;
+    uint32_t mHeapParams;
 
 public:
     NetlinkEvent();
     virtual ~NetlinkEvent();
 
+    // ASCII events refer to |buffer| rather than copying it, so it must
+    // outlive the event.
     bool decode(char *buffer, int size, int format = NetlinkListener::NETLINK_FORMAT_ASCII);
     const char *findParam(const char *paramName);
 
@@ -65,6 +77,10 @@ public:
     bool parseRtMessage(const struct nlmsghdr *nh);
     bool parseNdUserOptMessage(const struct nlmsghdr *nh);
     struct nlattr* findNlAttr(const nlmsghdr* nl, size_t hdrlen, uint16_t attr);
+
+ private:
+    char *allocParam(int index, size_t size);
+    void setParam(int index, const char *fmt, ...) __attribute__((format(printf, 3, 4)));
 };
 
 #endif
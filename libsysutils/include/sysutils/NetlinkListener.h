@@ -21,7 +21,9 @@
 class NetlinkEvent;
 
 class NetlinkListener : public SocketListener {
-    char mBuffer[64 * 1024] __attribute__((aligned(4)));
+    // Datagrams are received up to kBatchSize at a time, one per buffer.
+    static const int kBatchSize = 8;
+    char mBuffer[kBatchSize][64 * 1024] __attribute__((aligned(4)));
     int mFormat;
 
 public:
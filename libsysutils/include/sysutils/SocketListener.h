@@ -30,6 +30,7 @@ class SocketListener {
     std::unordered_map<int, SocketClient*> mClients;
     pthread_mutex_t         mClientsLock;
     int                     mCtrlPipe[2];
+    int                     mEpollFd;
     pthread_t               mThread;
     bool                    mUseCmdNum;
 
@@ -47,7 +48,7 @@ public:
 
     void runOnEachSocket(SocketClientCommand *command);
 
-    bool release(SocketClient *c) { return release(c, true); }
+    bool release(SocketClient *c);
 
 protected:
     virtual bool onDataAvailable(SocketClient *c) = 0;
@@ -59,7 +60,9 @@ private:
     // while processing it.
     std::vector<SocketClient*> snapshotClients();
 
-    bool release(SocketClient *c, bool wakeup);
+    // Adds |fd| to the epoll set. Clients stay registered until released, so
+    // waiting for events doesn't depend on the number of clients.
+    bool watchFd(int fd);
     void runListener();
     void init(const char *socketName, int socketFd, bool listen, bool useCmdNum);
 };
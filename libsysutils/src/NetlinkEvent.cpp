@@ -30,6 +30,8 @@
 #include <net/if.h>
 #include <netinet/icmp6.h>
 #include <netinet/in.h>
+#include <stdarg.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/socket.h>
@@ -47,19 +49,59 @@ NetlinkEvent::NetlinkEvent() {
     memset(mParams, 0, sizeof(mParams));
     mPath = nullptr;
     mSubsystem = nullptr;
+    mStorageUsed = 0;
+    mHeapParams = 0;
 }
 
 NetlinkEvent::~NetlinkEvent() {
-    int i;
-    if (mPath)
-        free(mPath);
-    if (mSubsystem)
-        free(mSubsystem);
-    for (i = 0; i < NL_PARAMS_MAX; i++) {
-        if (!mParams[i])
-            break;
-        free(mParams[i]);
+    for (int i = 0; i < NL_PARAMS_MAX; i++) {
+        if (mHeapParams & (1u << i))
+            free(const_cast<char *>(mParams[i]));
+    }
+}
+
+/*
+ * Returns a buffer of |size| bytes for param |index|, carved out of mStorage
+ * when it fits.
+ */
+char *NetlinkEvent::allocParam(int index, size_t size) {
+    char *param;
+    if (size <= sizeof(mStorage) - mStorageUsed) {
+        param = mStorage + mStorageUsed;
+        mStorageUsed += size;
+    } else {
+        param = (char *) malloc(size);
+        if (param)
+            mHeapParams |= 1u << index;
+    }
+    mParams[index] = param;
+    return param;
+}
+
+void NetlinkEvent::setParam(int index, const char *fmt, ...) {
+    char *param = mStorage + mStorageUsed;
+    const size_t avail = sizeof(mStorage) - mStorageUsed;
+
+    va_list ap;
+    va_start(ap, fmt);
+    int len = vsnprintf(param, avail, fmt, ap);
+    va_end(ap);
+    if (len < 0)
+        return;
+
+    if ((size_t) len < avail) {
+        mStorageUsed += len + 1;
+        mParams[index] = param;
+        return;
     }
+
+    // Too long for what's left of mStorage.
+    param = allocParam(index, len + 1);
+    if (!param)
+        return;
+    va_start(ap, fmt);
+    vsnprintf(param, len + 1, fmt, ap);
+    va_end(ap);
 }
 
 void NetlinkEvent::dump() {
@@ -136,16 +178,16 @@ bool NetlinkEvent::parseIfInfoMessage(const struct nlmsghdr *nh) {
     for (rta = IFLA_RTA(ifi); RTA_OK(rta, len); rta = RTA_NEXT(rta, len)) {
         switch(rta->rta_type) {
             case IFLA_IFNAME:
-                asprintf(&mParams[0], "INTERFACE=%s", (char *) RTA_DATA(rta));
+                setParam(0, "INTERFACE=%s", (char *) RTA_DATA(rta));
                 // We can get the interface change information from sysfs update
                 // already. But in case we missed those message when devices start.
                 // We do a update again when received a kLinkUp event. To make
                 // the message consistent, use IFINDEX here as well since sysfs
                 // uses IFINDEX.
-                asprintf(&mParams[1], "IFINDEX=%d", ifi->ifi_index);
+                setParam(1, "IFINDEX=%d", ifi->ifi_index);
                 mAction = (ifi->ifi_flags & IFF_LOWER_UP) ? Action::kLinkUp :
                                                             Action::kLinkDown;
-                mSubsystem = strdup("net");
+                mSubsystem = "net";
                 return true;
         }
     }
@@ -234,18 +276,18 @@ bool NetlinkEvent::parseIfAddrMessage(const struct nlmsghdr *nh) {
     // Fill in netlink event information.
     mAction = (type == RTM_NEWADDR) ? Action::kAddressUpdated :
                                       Action::kAddressRemoved;
-    mSubsystem = strdup("net");
-    asprintf(&mParams[0], "ADDRESS=%s/%d", addrstr, ifaddr->ifa_prefixlen);
-    asprintf(&mParams[1], "INTERFACE=%s", ifname);
-    asprintf(&mParams[2], "FLAGS=%u", ifaddr->ifa_flags);
-    asprintf(&mParams[3], "SCOPE=%u", ifaddr->ifa_scope);
-    asprintf(&mParams[4], "IFINDEX=%u", ifaddr->ifa_index);
+    mSubsystem = "net";
+    setParam(0, "ADDRESS=%s/%d", addrstr, ifaddr->ifa_prefixlen);
+    setParam(1, "INTERFACE=%s", ifname);
+    setParam(2, "FLAGS=%u", ifaddr->ifa_flags);
+    setParam(3, "SCOPE=%u", ifaddr->ifa_scope);
+    setParam(4, "IFINDEX=%u", ifaddr->ifa_index);
 
     if (cacheinfo) {
-        asprintf(&mParams[5], "PREFERRED=%u", cacheinfo->ifa_prefered);
-        asprintf(&mParams[6], "VALID=%u", cacheinfo->ifa_valid);
-        asprintf(&mParams[7], "CSTAMP=%u", cacheinfo->cstamp);
-        asprintf(&mParams[8], "TSTAMP=%u", cacheinfo->tstamp);
+        setParam(5, "PREFERRED=%u", cacheinfo->ifa_prefered);
+        setParam(6, "VALID=%u", cacheinfo->ifa_valid);
+        setParam(7, "CSTAMP=%u", cacheinfo->cstamp);
+        setParam(8, "TSTAMP=%u", cacheinfo->tstamp);
     }
 
     return true;
@@ -261,9 +303,9 @@ bool NetlinkEvent::parseUlogPacketMessage(const struct nlmsghdr *nh) {
         return false;
 
     devname = pm->indev_name[0] ? pm->indev_name : pm->outdev_name;
-    asprintf(&mParams[0], "ALERT_NAME=%s", pm->prefix);
-    asprintf(&mParams[1], "INTERFACE=%s", devname);
-    mSubsystem = strdup("qlog");
+    setParam(0, "ALERT_NAME=%s", pm->prefix);
+    setParam(1, "INTERFACE=%s", devname);
+    mSubsystem = "qlog";
     mAction = Action::kChange;
     return true;
 }
@@ -301,16 +343,17 @@ bool NetlinkEvent::parseNfPacketMessage(struct nlmsghdr *nh) {
         raw = (char*)nlAttrData(payload);
     }
 
-    char* hex = (char*) calloc(1, 5 + (len * 2));
-    strcpy(hex, "HEX=");
-    for (int i = 0; i < len; i++) {
-        hex[4 + (i * 2)] = "0123456789abcdef"[(raw[i] >> 4) & 0xf];
-        hex[5 + (i * 2)] = "0123456789abcdef"[raw[i] & 0xf];
+    setParam(0, "UID=%d", uid);
+    char* hex = allocParam(1, 5 + (len * 2));
+    if (hex) {
+        strcpy(hex, "HEX=");
+        for (int i = 0; i < len; i++) {
+            hex[4 + (i * 2)] = "0123456789abcdef"[(raw[i] >> 4) & 0xf];
+            hex[5 + (i * 2)] = "0123456789abcdef"[raw[i] & 0xf];
+        }
+        hex[4 + (len * 2)] = '\0';
     }
-
-    asprintf(&mParams[0], "UID=%d", uid);
-    mParams[1] = hex;
-    mSubsystem = strdup("strict");
+    mSubsystem = "strict";
     mAction = Action::kChange;
     return true;
 }
@@ -400,10 +443,10 @@ bool NetlinkEvent::parseRtMessage(const struct nlmsghdr *nh) {
     // Fill in netlink event information.
     mAction = (type == RTM_NEWROUTE) ? Action::kRouteUpdated :
                                        Action::kRouteRemoved;
-    mSubsystem = strdup("net");
-    asprintf(&mParams[0], "ROUTE=%s/%d", dst, prefixLength);
-    asprintf(&mParams[1], "GATEWAY=%s", (*gw) ? gw : "");
-    asprintf(&mParams[2], "INTERFACE=%s", (*dev) ? dev : "");
+    mSubsystem = "net";
+    setParam(0, "ROUTE=%s/%d", dst, prefixLength);
+    setParam(1, "GATEWAY=%s", (*gw) ? gw : "");
+    setParam(2, "INTERFACE=%s", (*dev) ? dev : "");
 
     return true;
 }
@@ -482,7 +525,7 @@ bool NetlinkEvent::parseNdUserOptMessage(const struct nlmsghdr *nh) {
         static const size_t kMaxSingleAddressLength =
                 INET6_ADDRSTRLEN + strlen("%") + IFNAMSIZ + strlen(",");
         const size_t bufsize = kTagLength + numaddrs * kMaxSingleAddressLength;
-        char *buf = (char *) malloc(bufsize);
+        char *buf = allocParam(2, bufsize);
         if (!buf) {
             SLOGE("RDNSS option: out of memory\n");
             return false;
@@ -505,10 +548,9 @@ bool NetlinkEvent::parseNdUserOptMessage(const struct nlmsghdr *nh) {
         buf[pos] = '\0';
 
         mAction = Action::kRdnss;
-        mSubsystem = strdup("net");
-        asprintf(&mParams[0], "INTERFACE=%s", ifname);
-        asprintf(&mParams[1], "LIFETIME=%u", lifetime);
-        mParams[2] = buf;
+        mSubsystem = "net";
+        setParam(0, "INTERFACE=%s", ifname);
+        setParam(1, "LIFETIME=%u", lifetime);
     } else if (opthdr->nd_opt_type == ND_OPT_DNSSL) {
         // TODO: support DNSSL.
     } else {
@@ -622,7 +664,7 @@ bool NetlinkEvent::parseAsciiNetlinkMessage(char *buffer, int size) {
                     return false;
                 }
             }
-            mPath = strdup(p+1);
+            mPath = p+1;
             first = 0;
         } else {
             const char* a;
@@ -636,9 +678,9 @@ bool NetlinkEvent::parseAsciiNetlinkMessage(char *buffer, int size) {
             } else if ((a = HAS_CONST_PREFIX(s, end, "SEQNUM=")) != nullptr) {
                 mSeq = atoi(a);
             } else if ((a = HAS_CONST_PREFIX(s, end, "SUBSYSTEM=")) != nullptr) {
-                mSubsystem = strdup(a);
+                mSubsystem = a;
             } else if (param_idx < NL_PARAMS_MAX) {
-                mParams[param_idx++] = strdup(s);
+                mParams[param_idx++] = s;
             }
         }
         s += strlen(s) + 1;
@@ -0,0 +1,136 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <sysutils/NetlinkEvent.h>
+
+#include <arpa/inet.h>
+#include <linux/if_addr.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+#include <net/if.h>
+#include <netinet/icmp6.h>
+#include <string.h>
+
+#include <string>
+
+#include <gtest/gtest.h>
+
+namespace {
+
+// Builds a netlink message with the given header and attributes.
+class MessageBuilder {
+  public:
+    MessageBuilder(uint16_t type, const void* header, size_t headerLen) {
+        memset(mBuf, 0, sizeof(mBuf));
+        nh()->nlmsg_type = type;
+        nh()->nlmsg_len = NLMSG_LENGTH(headerLen);
+        memcpy(NLMSG_DATA(nh()), header, headerLen);
+    }
+
+    void addAttr(uint16_t type, const void* data, size_t len) {
+        rtattr* rta = reinterpret_cast<rtattr*>(mBuf + NLMSG_ALIGN(nh()->nlmsg_len));
+        rta->rta_type = type;
+        rta->rta_len = RTA_LENGTH(len);
+        memcpy(RTA_DATA(rta), data, len);
+        nh()->nlmsg_len = NLMSG_ALIGN(nh()->nlmsg_len) + RTA_ALIGN(rta->rta_len);
+    }
+
+    char* data() { return mBuf; }
+    int size() { return nh()->nlmsg_len; }
+
+  private:
+    nlmsghdr* nh() { return reinterpret_cast<nlmsghdr*>(mBuf); }
+
+    char mBuf[8192] __attribute__((aligned(4)));
+};
+
+}  // unnamed namespace
+
+TEST(NetlinkEventTest, AsciiRefersToBuffer) {
+    char buffer[] =
+            "add@/devices/virtual/net/wlan0\0ACTION=add\0SUBSYSTEM=net\0INTERFACE=wlan0\0"
+            "IFINDEX=5";
+    NetlinkEvent evt;
+    ASSERT_TRUE(evt.decode(buffer, sizeof(buffer), NetlinkListener::NETLINK_FORMAT_ASCII));
+
+    EXPECT_EQ(NetlinkEvent::Action::kAdd, evt.getAction());
+    EXPECT_STREQ("net", evt.getSubsystem());
+    EXPECT_STREQ("wlan0", evt.findParam("INTERFACE"));
+    EXPECT_STREQ("5", evt.findParam("IFINDEX"));
+    EXPECT_EQ(nullptr, evt.findParam("MISSING"));
+
+    const char* interface = evt.findParam("INTERFACE");
+    EXPECT_TRUE(interface >= buffer && interface < buffer + sizeof(buffer));
+}
+
+TEST(NetlinkEventTest, IfAddrMessage) {
+    ifaddrmsg ifaddr = {};
+    ifaddr.ifa_family = AF_INET;
+    ifaddr.ifa_prefixlen = 24;
+    ifaddr.ifa_scope = RT_SCOPE_UNIVERSE;
+    ifaddr.ifa_index = if_nametoindex("lo");
+    MessageBuilder msg(RTM_NEWADDR, &ifaddr, sizeof(ifaddr));
+    in_addr addr;
+    inet_pton(AF_INET, "192.0.2.1", &addr);
+    msg.addAttr(IFA_ADDRESS, &addr, sizeof(addr));
+    ifa_cacheinfo cacheinfo = {.ifa_prefered = 10, .ifa_valid = 20, .cstamp = 30, .tstamp = 40};
+    msg.addAttr(IFA_CACHEINFO, &cacheinfo, sizeof(cacheinfo));
+
+    NetlinkEvent evt;
+    ASSERT_TRUE(evt.decode(msg.data(), msg.size(), NetlinkListener::NETLINK_FORMAT_BINARY));
+
+    EXPECT_EQ(NetlinkEvent::Action::kAddressUpdated, evt.getAction());
+    EXPECT_STREQ("net", evt.getSubsystem());
+    EXPECT_STREQ("192.0.2.1/24", evt.findParam("ADDRESS"));
+    EXPECT_STREQ("lo", evt.findParam("INTERFACE"));
+    EXPECT_STREQ(std::to_string(ifaddr.ifa_index).c_str(), evt.findParam("IFINDEX"));
+    EXPECT_STREQ("10", evt.findParam("PREFERRED"));
+    EXPECT_STREQ("20", evt.findParam("VALID"));
+    EXPECT_STREQ("30", evt.findParam("CSTAMP"));
+    EXPECT_STREQ("40", evt.findParam("TSTAMP"));
+}
+
+TEST(NetlinkEventTest, RdnssLongerThanStorage) {
+    // Enough link-local servers that the SERVERS= param doesn't fit in the
+    // event's own storage.
+    constexpr int kNumAddrs = 32;
+    char body[sizeof(nduseroptmsg) + sizeof(nd_opt_rdnss) + kNumAddrs * sizeof(in6_addr)] = {};
+    nduseroptmsg* opt = reinterpret_cast<nduseroptmsg*>(body);
+    opt->nduseropt_family = AF_INET6;
+    opt->nduseropt_opts_len = sizeof(nd_opt_rdnss) + kNumAddrs * sizeof(in6_addr);
+    opt->nduseropt_ifindex = if_nametoindex("lo");
+    opt->nduseropt_icmp_type = ND_ROUTER_ADVERT;
+    nd_opt_rdnss* rdnss = reinterpret_cast<nd_opt_rdnss*>(opt + 1);
+    rdnss->nd_opt_rdnss_type = ND_OPT_RDNSS;
+    rdnss->nd_opt_rdnss_len = 1 + 2 * kNumAddrs;
+    rdnss->nd_opt_rdnss_lifetime = htonl(600);
+    in6_addr* addrs = reinterpret_cast<in6_addr*>(rdnss + 1);
+    std::string expected;
+    for (int i = 0; i < kNumAddrs; i++) {
+        std::string addr = "fe80::" + std::to_string(i + 1);
+        inet_pton(AF_INET6, addr.c_str(), &addrs[i]);
+        expected += (i ? "," : "") + addr + "%lo";
+    }
+    MessageBuilder msg(RTM_NEWNDUSEROPT, body, sizeof(body));
+
+    NetlinkEvent evt;
+    ASSERT_TRUE(evt.decode(msg.data(), msg.size(), NetlinkListener::NETLINK_FORMAT_BINARY));
+
+    EXPECT_EQ(NetlinkEvent::Action::kRdnss, evt.getAction());
+    EXPECT_STREQ("lo", evt.findParam("INTERFACE"));
+    EXPECT_STREQ("600", evt.findParam("LIFETIME"));
+    EXPECT_EQ(expected, evt.findParam("SERVERS"));
+}
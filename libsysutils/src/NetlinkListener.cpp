@@ -24,7 +24,6 @@
 
 #include <linux/netlink.h> /* out of order because must follow sys/socket.h */
 
-#include <cutils/uevent.h>
 #include <log/log.h>
 #include <sysutils/NetlinkEvent.h>
 
@@ -43,33 +42,82 @@ NetlinkListener::NetlinkListener(int socket, int format) :
                             SocketListener(socket, false), mFormat(format) {
 }
 
+/*
+ * Checks that a datagram came from the kernel with sender credentials, like
+ * uevent_kernel_recv() does.
+ */
+static bool isFromKernel(const struct msghdr& hdr, bool require_group) {
+    struct cmsghdr *cmsg = CMSG_FIRSTHDR(&hdr);
+    if (cmsg == nullptr || cmsg->cmsg_type != SCM_CREDENTIALS) {
+        /* ignoring netlink message with no sender credentials */
+        return false;
+    }
+
+    const struct sockaddr_nl *addr = (const struct sockaddr_nl *) hdr.msg_name;
+    if (addr->nl_pid != 0) {
+        /* ignore non-kernel */
+        return false;
+    }
+    if (require_group && addr->nl_groups == 0) {
+        /* ignore unicast messages when requested */
+        return false;
+    }
+    return true;
+}
+
 bool NetlinkListener::onDataAvailable(SocketClient *cli)
 {
     int socket = cli->getSocket();
-    ssize_t count;
-    uid_t uid = -1;
 
     bool require_group = true;
     if (mFormat == NETLINK_FORMAT_BINARY_UNICAST) {
         require_group = false;
     }
 
-    count = TEMP_FAILURE_RETRY(uevent_kernel_recv(socket,
-            mBuffer, sizeof(mBuffer), require_group, &uid));
+    // Take whatever is queued, up to kBatchSize datagrams, in one system call.
+    struct mmsghdr msgs[kBatchSize];
+    struct iovec iovs[kBatchSize];
+    struct sockaddr_nl addrs[kBatchSize];
+    char controls[kBatchSize][CMSG_SPACE(sizeof(struct ucred))];
+    memset(msgs, 0, sizeof(msgs));
+    for (int i = 0; i < kBatchSize; i++) {
+        iovs[i].iov_base = mBuffer[i];
+        iovs[i].iov_len = sizeof(mBuffer[i]);
+        msgs[i].msg_hdr.msg_name = &addrs[i];
+        msgs[i].msg_hdr.msg_namelen = sizeof(addrs[i]);
+        msgs[i].msg_hdr.msg_iov = &iovs[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+        msgs[i].msg_hdr.msg_control = controls[i];
+        msgs[i].msg_hdr.msg_controllen = sizeof(controls[i]);
+    }
+
+    int count = TEMP_FAILURE_RETRY(recvmmsg(socket, msgs, kBatchSize, MSG_DONTWAIT, nullptr));
     if (count < 0) {
-        SLOGE("recvmsg failed (%s)", strerror(errno));
+        if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            return true;
+        }
+        SLOGE("recvmmsg failed (%s)", strerror(errno));
         return false;
     }
 
-    NetlinkEvent *evt = new NetlinkEvent();
-    if (evt->decode(mBuffer, count, mFormat)) {
-        onEvent(evt);
-    } else if (mFormat != NETLINK_FORMAT_BINARY) {
-        // Don't complain if parseBinaryNetlinkMessage returns false. That can
-        // just mean that the buffer contained no messages we're interested in.
-        SLOGE("Error decoding NetlinkEvent");
-    }
+    for (int i = 0; i < count; i++) {
+        const size_t len = msgs[i].msg_len;
+        if (!isFromKernel(msgs[i].msg_hdr, require_group)) {
+            /* clear residual potentially malicious data */
+            memset(mBuffer[i], 0, len);
+            SLOGE("Ignoring netlink message not sent by the kernel");
+            continue;
+        }
 
-    delete evt;
+        // The event refers to mBuffer[i] instead of copying the params out.
+        NetlinkEvent evt;
+        if (evt.decode(mBuffer[i], len, mFormat)) {
+            onEvent(&evt);
+        } else if (mFormat != NETLINK_FORMAT_BINARY) {
+            // Don't complain if parseBinaryNetlinkMessage returns false. That can
+            // just mean that the buffer contained no messages we're interested in.
+            SLOGE("Error decoding NetlinkEvent");
+        }
+    }
     return true;
 }
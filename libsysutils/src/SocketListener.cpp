@@ -19,13 +19,14 @@
 #include <errno.h>
 #include <stdio.h>
 #include <stdlib.h>
-#include <sys/poll.h>
+#include <sys/epoll.h>
 #include <sys/socket.h>
 #include <sys/time.h>
 #include <sys/types.h>
 #include <sys/un.h>
 #include <unistd.h>
 
+#include <algorithm>
 #include <vector>
 
 #include <cutils/sockets.h>
@@ -34,7 +35,6 @@
 #include <sysutils/SocketClient.h>
 
 #define CtrlPipe_Shutdown 0
-#define CtrlPipe_Wakeup   1
 
 SocketListener::SocketListener(const char *socketName, bool listen) {
     init(socketName, -1, listen, false);
@@ -53,6 +53,9 @@ void SocketListener::init(const char *socketName, int socketFd, bool listen, boo
     mSocketName = socketName;
     mSock = socketFd;
     mUseCmdNum = useCmdNum;
+    mCtrlPipe[0] = -1;
+    mCtrlPipe[1] = -1;
+    mEpollFd = -1;
     pthread_mutex_init(&mClientsLock, nullptr);
 }
 
@@ -64,6 +67,9 @@ SocketListener::~SocketListener() {
         close(mCtrlPipe[0]);
         close(mCtrlPipe[1]);
     }
+    if (mEpollFd != -1) {
+        close(mEpollFd);
+    }
     for (auto pair : mClients) {
         pair.second->decRef();
     }
@@ -100,6 +106,15 @@ int SocketListener::startListener(int backlog) {
         return -1;
     }
 
+    mEpollFd = epoll_create1(EPOLL_CLOEXEC);
+    if (mEpollFd < 0) {
+        SLOGE("epoll_create1 failed (%s)", strerror(errno));
+        return -1;
+    }
+    if (!watchFd(mCtrlPipe[0]) || !watchFd(mSock)) {
+        return -1;
+    }
+
     if (pthread_create(&mThread, nullptr, SocketListener::threadStart, this)) {
         SLOGE("pthread_create (%s)", strerror(errno));
         return -1;
@@ -127,6 +142,8 @@ int SocketListener::stopListener() {
     close(mCtrlPipe[1]);
     mCtrlPipe[0] = -1;
     mCtrlPipe[1] = -1;
+    close(mEpollFd);
+    mEpollFd = -1;
 
     if (mSocketName && mSock > -1) {
         close(mSock);
@@ -148,82 +165,93 @@ void *SocketListener::threadStart(void *obj) {
     return nullptr;
 }
 
-void SocketListener::runListener() {
-    while (true) {
-        std::vector<pollfd> fds;
+bool SocketListener::watchFd(int fd) {
+    epoll_event event = {};
+    event.events = EPOLLIN;
+    event.data.fd = fd;
+    if (epoll_ctl(mEpollFd, EPOLL_CTL_ADD, fd, &event) < 0) {
+        SLOGE("epoll_ctl failed for fd %d (%s)", fd, strerror(errno));
+        return false;
+    }
+    return true;
+}
 
-        pthread_mutex_lock(&mClientsLock);
-        fds.reserve(2 + mClients.size());
-        fds.push_back({.fd = mCtrlPipe[0], .events = POLLIN});
-        if (mListen) fds.push_back({.fd = mSock, .events = POLLIN});
-        for (auto pair : mClients) {
-            // NB: calling out to an other object with mClientsLock held (safe)
-            const int fd = pair.second->getSocket();
-            if (fd != pair.first) SLOGE("fd mismatch: %d != %d", fd, pair.first);
-            fds.push_back({.fd = fd, .events = POLLIN});
-        }
-        pthread_mutex_unlock(&mClientsLock);
+void SocketListener::runListener() {
+    // Level-triggered: onDataAvailable() may leave data behind for the next
+    // round, just like with poll().
+    constexpr int kMaxEvents = 32;
+    epoll_event events[kMaxEvents];
 
+    while (true) {
         SLOGV("mListen=%d, mSocketName=%s", mListen, mSocketName);
-        int rc = TEMP_FAILURE_RETRY(poll(fds.data(), fds.size(), -1));
+        int rc = TEMP_FAILURE_RETRY(epoll_wait(mEpollFd, events, kMaxEvents, -1));
         if (rc < 0) {
-            SLOGE("poll failed (%s) mListen=%d", strerror(errno), mListen);
+            SLOGE("epoll_wait failed (%s) mListen=%d", strerror(errno), mListen);
             sleep(1);
             continue;
         }
 
-        if (fds[0].revents & (POLLIN | POLLERR)) {
+        if (std::any_of(events, events + rc,
+                        [this](const epoll_event& e) { return e.data.fd == mCtrlPipe[0]; })) {
             char c = CtrlPipe_Shutdown;
             TEMP_FAILURE_RETRY(read(mCtrlPipe[0], &c, 1));
-            if (c == CtrlPipe_Shutdown) {
-                break;
+            break;
+        }
+
+        // Add all active clients to the pending list first, so we can release
+        // the lock before invoking the callbacks. This is done before accepting,
+        // so that a new client can't be mistaken for a released client whose
+        // fd it reuses.
+        bool acceptPending = false;
+        std::vector<SocketClient*> pending;
+        pthread_mutex_lock(&mClientsLock);
+        for (int i = 0; i < rc; ++i) {
+            const epoll_event& e = events[i];
+            if (!(e.events & (EPOLLIN | EPOLLERR | EPOLLHUP))) continue;
+            if (mListen && e.data.fd == mSock) {
+                acceptPending = true;
+                continue;
             }
-            continue;
+            auto it = mClients.find(e.data.fd);
+            if (it == mClients.end()) {
+                // Released by another thread since epoll_wait() returned.
+                continue;
+            }
+            SocketClient* c = it->second;
+            pending.push_back(c);
+            c->incRef();
         }
-        if (mListen && (fds[1].revents & (POLLIN | POLLERR))) {
+        pthread_mutex_unlock(&mClientsLock);
+
+        if (acceptPending) {
             int c = TEMP_FAILURE_RETRY(accept4(mSock, nullptr, nullptr, SOCK_CLOEXEC));
             if (c < 0) {
                 SLOGE("accept failed (%s)", strerror(errno));
                 sleep(1);
-                continue;
-            }
-            pthread_mutex_lock(&mClientsLock);
-            mClients[c] = new SocketClient(c, true, mUseCmdNum);
-            pthread_mutex_unlock(&mClientsLock);
-        }
-
-        // Add all active clients to the pending list first, so we can release
-        // the lock before invoking the callbacks.
-        std::vector<SocketClient*> pending;
-        pthread_mutex_lock(&mClientsLock);
-        const int size = fds.size();
-        for (int i = mListen ? 2 : 1; i < size; ++i) {
-            const struct pollfd& p = fds[i];
-            if (p.revents & (POLLIN | POLLERR)) {
-                auto it = mClients.find(p.fd);
-                if (it == mClients.end()) {
-                    SLOGE("fd vanished: %d", p.fd);
-                    continue;
+            } else {
+                pthread_mutex_lock(&mClientsLock);
+                SocketClient* client = new SocketClient(c, true, mUseCmdNum);
+                if (watchFd(c)) {
+                    mClients[c] = client;
+                } else {
+                    client->decRef();
                 }
-                SocketClient* c = it->second;
-                pending.push_back(c);
-                c->incRef();
+                pthread_mutex_unlock(&mClientsLock);
             }
         }
-        pthread_mutex_unlock(&mClientsLock);
 
         for (SocketClient* c : pending) {
             // Process it, if false is returned, remove from the map
             SLOGV("processing fd %d", c->getSocket());
             if (!onDataAvailable(c)) {
-                release(c, false);
+                release(c);
             }
             c->decRef();
         }
     }
 }
 
-bool SocketListener::release(SocketClient* c, bool wakeup) {
+bool SocketListener::release(SocketClient* c) {
     bool ret = false;
     /* if our sockets are connection-based, remove and destroy it */
     if (mListen && c) {
@@ -231,13 +259,14 @@ bool SocketListener::release(SocketClient* c, bool wakeup) {
         SLOGV("going to zap %d for %s", c->getSocket(), mSocketName);
         pthread_mutex_lock(&mClientsLock);
         ret = (mClients.erase(c->getSocket()) != 0);
+        if (ret) {
+            // Unregister while the fd is still open: closing it only removes it
+            // from the epoll set once no other reference to the file is left.
+            epoll_ctl(mEpollFd, EPOLL_CTL_DEL, c->getSocket(), nullptr);
+        }
         pthread_mutex_unlock(&mClientsLock);
         if (ret) {
             ret = c->decRef();
-            if (wakeup) {
-                char b = CtrlPipe_Wakeup;
-                TEMP_FAILURE_RETRY(write(mCtrlPipe[1], &b, 1));
-            }
         }
     }
     return ret;
@@ -181,3 +181,34 @@ TEST_F(FrameworkListenerTest, MultipleClients) {
     EXPECT_EQ(std::string("42 test,2") + '\0', recvReply(client2.get()));
     EXPECT_EQ(std::string("42 test,1") + '\0', recvReply(client1.get()));
 }
+
+TEST_F(FrameworkListenerTest, ManyClients) {
+    // Connect one at a time, since the listen backlog is short.
+    std::vector<unique_fd> clients;
+    for (int i = 0; i < 100; i++) {
+        clients.push_back(clientSocket(mSocketPath));
+        sendCmd(clients.back().get(), "test");
+        EXPECT_EQ(std::string("42 test") + '\0', recvReply(clients.back().get()));
+    }
+
+    // More clients are ready than the listener handles in one round.
+    for (int i = 0; i < 100; i++) {
+        sendCmd(clients[i].get(), ("test " + std::to_string(i)).c_str());
+    }
+    for (int i = 0; i < 100; i++) {
+        EXPECT_EQ("42 test," + std::to_string(i) + '\0', recvReply(clients[i].get()));
+    }
+}
+
+TEST_F(FrameworkListenerTest, ClientDisconnects) {
+    unique_fd client1 = clientSocket(mSocketPath);
+    unique_fd client2 = clientSocket(mSocketPath);
+    sendCmd(client1.get(), "test 1");
+    EXPECT_EQ(std::string("42 test,1") + '\0', recvReply(client1.get()));
+
+    // The listener releases the client and keeps serving the others.
+    client1.reset();
+    sendCmd(client2.get(), "test 2");
+    EXPECT_EQ(std::string("42 test,2") + '\0', recvReply(client2.get()));
+    testCommand("test 3", "42 test,3");
+}
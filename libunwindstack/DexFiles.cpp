@@ -20,7 +20,11 @@
 #include <sys/types.h>
 #include <unistd.h>
 
+#include <algorithm>
 #include <memory>
+#include <unordered_set>
+#include <utility>
+#include <vector>
 
 #include <unwindstack/DexFiles.h>
 #include <unwindstack/MapInfo.h>
@@ -31,6 +35,20 @@
 
 namespace unwindstack {
 
+struct DEXFileDescriptor32 {
+  uint32_t version;
+  uint32_t action_flag;
+  uint32_t relevant_entry;
+  uint32_t first_entry;
+};
+
+struct DEXFileDescriptor64 {
+  uint32_t version;
+  uint32_t action_flag;
+  uint64_t relevant_entry;
+  uint64_t first_entry;
+};
+
 struct DEXFileEntry32 {
   uint32_t next;
   uint32_t prev;
@@ -55,14 +73,14 @@ void DexFiles::ProcessArch() {
     case ARCH_ARM:
     case ARCH_MIPS:
     case ARCH_X86:
-      read_entry_ptr_func_ = &DexFiles::ReadEntryPtr32;
+      read_descriptor_func_ = &DexFiles::ReadDescriptor32;
       read_entry_func_ = &DexFiles::ReadEntry32;
       break;
 
     case ARCH_ARM64:
     case ARCH_MIPS64:
     case ARCH_X86_64:
-      read_entry_ptr_func_ = &DexFiles::ReadEntryPtr64;
+      read_descriptor_func_ = &DexFiles::ReadDescriptor64;
       read_entry_func_ = &DexFiles::ReadEntry64;
       break;
 
@@ -71,51 +89,57 @@ void DexFiles::ProcessArch() {
   }
 }
 
-uint64_t DexFiles::ReadEntryPtr32(uint64_t addr) {
-  uint32_t entry;
-  const uint32_t field_offset = 12;  // offset of first_entry_ in the descriptor struct.
-  if (!memory_->ReadFully(addr + field_offset, &entry, sizeof(entry))) {
-    return 0;
+bool DexFiles::ReadDescriptor32(uint64_t addr, Descriptor* desc) {
+  DEXFileDescriptor32 dex_desc;
+  if (!memory_->ReadFully(addr, &dex_desc, sizeof(dex_desc))) {
+    return false;
   }
-  return entry;
+  desc->action_flag = dex_desc.action_flag;
+  desc->relevant_entry = dex_desc.relevant_entry;
+  desc->first_entry = dex_desc.first_entry;
+  return true;
 }
 
-uint64_t DexFiles::ReadEntryPtr64(uint64_t addr) {
-  uint64_t entry;
-  const uint32_t field_offset = 16;  // offset of first_entry_ in the descriptor struct.
-  if (!memory_->ReadFully(addr + field_offset, &entry, sizeof(entry))) {
-    return 0;
+bool DexFiles::ReadDescriptor64(uint64_t addr, Descriptor* desc) {
+  DEXFileDescriptor64 dex_desc;
+  if (!memory_->ReadFully(addr, &dex_desc, sizeof(dex_desc))) {
+    return false;
   }
-  return entry;
+  desc->action_flag = dex_desc.action_flag;
+  desc->relevant_entry = dex_desc.relevant_entry;
+  desc->first_entry = dex_desc.first_entry;
+  return true;
 }
 
-bool DexFiles::ReadEntry32() {
+bool DexFiles::ReadEntry32(uint64_t addr, uint64_t* next, uint64_t* dex_file) {
   DEXFileEntry32 entry;
-  if (!memory_->ReadFully(entry_addr_, &entry, sizeof(entry)) || entry.dex_file == 0) {
-    entry_addr_ = 0;
+  if (!memory_->ReadFully(addr, &entry, sizeof(entry)) || entry.dex_file == 0) {
     return false;
   }
 
-  addrs_.push_back(entry.dex_file);
-  entry_addr_ = entry.next;
+  *next = entry.next;
+  *dex_file = entry.dex_file;
   return true;
 }
 
-bool DexFiles::ReadEntry64() {
+bool DexFiles::ReadEntry64(uint64_t addr, uint64_t* next, uint64_t* dex_file) {
   DEXFileEntry64 entry;
-  if (!memory_->ReadFully(entry_addr_, &entry, sizeof(entry)) || entry.dex_file == 0) {
-    entry_addr_ = 0;
+  if (!memory_->ReadFully(addr, &entry, sizeof(entry)) || entry.dex_file == 0) {
     return false;
   }
 
-  addrs_.push_back(entry.dex_file);
-  entry_addr_ = entry.next;
+  *next = entry.next;
+  *dex_file = entry.dex_file;
   return true;
 }
 
 bool DexFiles::ReadVariableData(uint64_t ptr_offset) {
-  entry_addr_ = (this->*read_entry_ptr_func_)(ptr_offset);
-  return entry_addr_ != 0;
+  Descriptor desc;
+  if (!(this->*read_descriptor_func_)(ptr_offset, &desc) || desc.first_entry == 0) {
+    return false;
+  }
+  descriptor_addr_ = ptr_offset;
+  return true;
 }
 
 void DexFiles::Init(Maps* maps) {
@@ -123,11 +147,36 @@ void DexFiles::Init(Maps* maps) {
     return;
   }
   initialized_ = true;
-  entry_addr_ = 0;
+  descriptor_addr_ = 0;
 
   FindAndReadVariable(maps, "__dex_debug_descriptor");
 }
 
+// Walks the entry list again if the descriptor changed since the last walk.
+// Dex files already in files_ are kept, so they are not read again.
+void DexFiles::UpdateEntries() {
+  Descriptor desc;
+  if (descriptor_addr_ == 0 || !(this->*read_descriptor_func_)(descriptor_addr_, &desc) ||
+      desc == descriptor_) {
+    return;
+  }
+  descriptor_ = desc;
+
+  std::vector<uint64_t> addrs;
+  std::unordered_set<uint64_t> entries;
+  uint64_t entry_addr = desc.first_entry;
+  while (entry_addr != 0 && entries.insert(entry_addr).second) {
+    uint64_t dex_file;
+    if (!(this->*read_entry_func_)(entry_addr, &entry_addr, &dex_file)) {
+      break;
+    }
+    addrs.push_back(dex_file);
+  }
+  std::sort(addrs.begin(), addrs.end());
+  addrs.erase(std::unique(addrs.begin(), addrs.end()), addrs.end());
+  addrs_ = std::move(addrs);
+}
+
 DexFile* DexFiles::GetDexFile(uint64_t dex_file_offset, MapInfo* info) {
   // Lock while processing the data.
   DexFile* dex_file;
@@ -142,14 +191,23 @@ DexFile* DexFiles::GetDexFile(uint64_t dex_file_offset, MapInfo* info) {
   return dex_file;
 }
 
-bool DexFiles::GetAddr(size_t index, uint64_t* addr) {
-  if (index < addrs_.size()) {
-    *addr = addrs_[index];
-    return true;
-  }
-  if (entry_addr_ != 0 && (this->*read_entry_func_)()) {
-    *addr = addrs_.back();
-    return true;
+// Dex files do not overlap, so the last one starting at or before dex_pc
+// is tried first.
+bool DexFiles::FindMethodInformation(MapInfo* info, uint64_t dex_pc, std::string* method_name,
+                                     uint64_t* method_offset) {
+  auto first = std::lower_bound(addrs_.begin(), addrs_.end(), info->start);
+  auto it = std::upper_bound(first, addrs_.end(), dex_pc);
+  while (it != first) {
+    uint64_t addr = *--it;
+    if (addr >= info->end) {
+      continue;
+    }
+
+    DexFile* dex_file = GetDexFile(addr, info);
+    if (dex_file != nullptr &&
+        dex_file->GetMethodInformation(dex_pc - addr, method_name, method_offset)) {
+      return true;
+    }
   }
   return false;
 }
@@ -161,18 +219,10 @@ void DexFiles::GetMethodInformation(Maps* maps, MapInfo* info, uint64_t dex_pc,
     Init(maps);
   }
 
-  size_t index = 0;
-  uint64_t addr;
-  while (GetAddr(index++, &addr)) {
-    if (addr < info->start || addr >= info->end) {
-      continue;
-    }
-
-    DexFile* dex_file = GetDexFile(addr, info);
-    if (dex_file != nullptr &&
-        dex_file->GetMethodInformation(dex_pc - addr, method_name, method_offset)) {
-      break;
-    }
+  // Only go back to the process when none of the known dex files match.
+  if (!FindMethodInformation(info, dex_pc, method_name, method_offset)) {
+    UpdateEntries();
+    FindMethodInformation(info, dex_pc, method_name, method_offset);
   }
 }
 
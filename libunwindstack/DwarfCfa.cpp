@@ -51,16 +51,26 @@ bool DwarfCfa<AddressType>::GetLocationInfo(uint64_t pc, uint64_t start_offset,
   memory_->set_cur_offset(start_offset);
   uint64_t cfa_offset;
   cur_pc_ = fde_->pc_start;
-  loc_regs->pc_start = cur_pc_;
+  // Kept apart from loc_regs, since DW_CFA_restore_state overwrites pc_start.
+  uint64_t row_start = cur_pc_;
   while (true) {
     if (cur_pc_ > pc) {
+      loc_regs->pc_start = row_start;
       loc_regs->pc_end = cur_pc_;
       return true;
     }
     if ((cfa_offset = memory_->cur_offset()) >= end_offset) {
+      loc_regs->pc_start = row_start;
       loc_regs->pc_end = fde_->pc_end;
       return true;
     }
+    if (rows_ != nullptr && cur_pc_ != row_start) {
+      // The pc moved on, so the previous row is done.
+      loc_regs->pc_start = row_start;
+      loc_regs->pc_end = cur_pc_;
+      rows_->push_back(*loc_regs);
+    }
+    row_start = cur_pc_;
     loc_regs->pc_start = cur_pc_;
     operands_.clear();
     // Read the cfa information.
@@ -88,6 +88,9 @@ class DwarfCfa {
 
   void set_cie_loc_regs(const dwarf_loc_regs_t* cie_loc_regs) { cie_loc_regs_ = cie_loc_regs; }
 
+  // When set, every row that is complete before the returned one is added to rows.
+  void set_rows(std::vector<dwarf_loc_regs_t>* rows) { rows_ = rows; }
+
  protected:
   std::string GetOperandString(uint8_t operand, uint64_t value, uint64_t* cur_pc);
 
@@ -102,6 +105,7 @@ class DwarfCfa {
 
   AddressType cur_pc_;
   const dwarf_loc_regs_t* cie_loc_regs_ = nullptr;
+  std::vector<dwarf_loc_regs_t>* rows_ = nullptr;
   std::vector<AddressType> operands_;
   std::stack<dwarf_loc_regs_t> loc_reg_state_;
 
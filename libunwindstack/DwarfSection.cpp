@@ -16,6 +16,8 @@
 
 #include <stdint.h>
 
+#include <algorithm>
+
 #include <unwindstack/DwarfError.h>
 #include <unwindstack/DwarfLocation.h>
 #include <unwindstack/DwarfMemory.h>
@@ -565,9 +567,38 @@ bool DwarfSectionImpl<AddressType>::GetCfaLocationInfo(uint64_t pc, const DwarfF
     }
     cie_loc_regs_[fde->cie_offset] = *loc_regs;
   }
-  cfa.set_cie_loc_regs(&cie_loc_regs_[fde->cie_offset]);
-  if (!cfa.GetLocationInfo(pc, fde->cfa_instructions_offset, fde->cfa_instructions_end, loc_regs)) {
-    last_error_ = cfa.last_error();
+  const dwarf_loc_regs_t* cie_loc_regs = &cie_loc_regs_[fde->cie_offset];
+
+  // Interpret the whole fde once and cache every row, so that any later
+  // pc in the same function finds its row without running the cfa again.
+  std::vector<dwarf_loc_regs_t> rows;
+  dwarf_loc_regs_t last_row;
+  cfa.set_cie_loc_regs(cie_loc_regs);
+  cfa.set_rows(&rows);
+  if (cfa.GetLocationInfo(UINT64_MAX, fde->cfa_instructions_offset, fde->cfa_instructions_end,
+                          &last_row)) {
+    rows.push_back(std::move(last_row));
+    bool found = false;
+    for (dwarf_loc_regs_t& row : rows) {
+      row.cie = fde->cie;
+      if (!found && pc >= row.pc_start && pc < row.pc_end) {
+        *loc_regs = row;
+        found = true;
+      }
+      loc_regs_.emplace(row.pc_end, std::move(row));
+    }
+    if (found) {
+      return true;
+    }
+  }
+
+  // Either pc is outside of every row, or instructions after it cannot be
+  // interpreted. Only go as far as pc.
+  DwarfCfa<AddressType> pc_cfa(&memory_, fde);
+  pc_cfa.set_cie_loc_regs(cie_loc_regs);
+  if (!pc_cfa.GetLocationInfo(pc, fde->cfa_instructions_offset, fde->cfa_instructions_end,
+                              loc_regs)) {
+    last_error_ = pc_cfa.last_error();
     return false;
   }
   return true;
@@ -652,6 +683,19 @@ void DwarfSectionImplNoHdr<AddressType>::InsertFde(const DwarfFde* fde) {
   }
 }
 
+// Called once all of the fdes have been read. The map is only needed while
+// entries are still being added to it, the array is a fraction of its size
+// and is searched without chasing pointers.
+template <typename AddressType>
+void DwarfSectionImplNoHdr<AddressType>::BuildFdeIndex() {
+  fde_index_.reserve(fdes_.size());
+  for (const auto& entry : fdes_) {
+    fde_index_.push_back(FdeInterval{entry.first, entry.second.first, entry.second.second});
+  }
+  fdes_.clear();
+  fde_index_built_ = true;
+}
+
 template <typename AddressType>
 bool DwarfSectionImplNoHdr<AddressType>::GetNextCieOrFde(DwarfFde** fde_entry) {
   uint64_t start_offset = next_entries_offset_;
@@ -752,7 +796,7 @@ void DwarfSectionImplNoHdr<AddressType>::GetFdes(std::vector<const DwarfFde*>* f
     }
   }
 
-  while (next_entries_offset_ < entries_end_) {
+  while (!fde_index_built_ && next_entries_offset_ < entries_end_) {
     DwarfFde* fde;
     if (!GetNextCieOrFde(&fde)) {
       break;
@@ -764,13 +808,27 @@ void DwarfSectionImplNoHdr<AddressType>::GetFdes(std::vector<const DwarfFde*>* f
 
     if (next_entries_offset_ < memory_.cur_offset()) {
       // Simply consider the processing done in this case.
+      BuildFdeIndex();
       break;
     }
   }
+  if (!fde_index_built_ && next_entries_offset_ >= entries_end_) {
+    BuildFdeIndex();
+  }
 }
 
 template <typename AddressType>
 const DwarfFde* DwarfSectionImplNoHdr<AddressType>::GetFdeFromPc(uint64_t pc) {
+  if (fde_index_built_) {
+    auto it = std::upper_bound(
+        fde_index_.begin(), fde_index_.end(), pc,
+        [](uint64_t value, const FdeInterval& interval) { return value < interval.pc_end; });
+    if (it != fde_index_.end() && pc >= it->pc_start) {
+      return it->fde;
+    }
+    return nullptr;
+  }
+
   // Search in the list of fdes we already have.
   auto it = fdes_.upper_bound(pc);
   if (it != fdes_.end()) {
@@ -799,6 +857,8 @@ const DwarfFde* DwarfSectionImplNoHdr<AddressType>::GetFdeFromPc(uint64_t pc) {
       break;
     }
   }
+  // Every entry has been read now, from here on search the index.
+  BuildFdeIndex();
   return nullptr;
 }
 
@@ -15,12 +15,22 @@
  */
 
 #include <elf.h>
+#include <fcntl.h>
+#include <stdio.h>
 #include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
+#include <algorithm>
 #include <memory>
 #include <mutex>
 #include <string>
 #include <utility>
+#include <vector>
+
+#include <android-base/file.h>
+#include <android-base/stringprintf.h>
+#include <android-base/unique_fd.h>
 
 #define LOG_TAG "unwind"
 #include <log/log.h>
@@ -39,6 +49,20 @@ namespace unwindstack {
 bool Elf::cache_enabled_;
 std::unordered_map<std::string, std::pair<std::shared_ptr<Elf>, bool>>* Elf::cache_;
 std::mutex* Elf::cache_lock_;
+std::string* Elf::disk_cache_directory_;
+
+// Header of a disk cache file, followed by size bytes of decompressed data.
+struct DiskCacheHeader {
+  static constexpr uint32_t kMagic = 0x43445755;  // "UWDC"
+  static constexpr uint32_t kVersion = 1;
+
+  uint32_t magic;
+  uint32_t version;
+  // Size of the compressed section the data came from, a cheap check that
+  // the build id is not shared by an elf built differently.
+  uint64_t compressed_size;
+  uint64_t size;
+};
 
 bool Elf::Init() {
   load_bias_ = 0;
@@ -68,7 +92,28 @@ void Elf::InitGnuDebugdata() {
     return;
   }
 
-  gnu_debugdata_memory_.reset(interface_->CreateGnuDebugdataMemory());
+  std::string cache_path;
+  if (disk_cache_directory_ != nullptr) {
+    std::string build_id = interface_->GetBuildID();
+    if (!build_id.empty()) {
+      cache_path = *disk_cache_directory_ + '/';
+      for (char c : build_id) {
+        cache_path += android::base::StringPrintf("%02x", static_cast<uint8_t>(c));
+      }
+      cache_path += ".gnu_debugdata";
+    }
+  }
+
+  Memory* memory = cache_path.empty() ? nullptr : DiskCacheGet(cache_path);
+  if (memory == nullptr) {
+    memory = interface_->CreateGnuDebugdataMemory();
+    if (memory != nullptr && !cache_path.empty()) {
+      // CreateGnuDebugdataMemory() always returns a MemoryXz. Writing the
+      // cache entry decompresses all of it, but only the first time.
+      DiskCacheAdd(cache_path, static_cast<MemoryXz*>(memory));
+    }
+  }
+  gnu_debugdata_memory_.reset(memory);
   gnu_debugdata_interface_.reset(CreateInterfaceFromMemory(gnu_debugdata_memory_.get()));
   ElfInterface* gnu = gnu_debugdata_interface_.get();
   if (gnu == nullptr) {
@@ -109,6 +154,31 @@ bool Elf::GetFunctionName(uint64_t addr, std::string* name, uint64_t* func_offse
                      gnu_debugdata_interface_->GetFunctionName(addr, name, func_offset)));
 }
 
+size_t Elf::GetFunctionNames(const std::vector<uint64_t>& addrs, std::vector<std::string>* names,
+                             std::vector<uint64_t>* func_offsets) {
+  names->assign(addrs.size(), "");
+  func_offsets->assign(addrs.size(), 0);
+
+  std::lock_guard<std::mutex> guard(lock_);
+  if (!valid_) {
+    return 0;
+  }
+  size_t found = 0;
+  for (size_t i = 0; i < addrs.size(); i++) {
+    std::string* name = &(*names)[i];
+    uint64_t* func_offset = &(*func_offsets)[i];
+    if (interface_->GetFunctionName(addrs[i], name, func_offset) ||
+        (gnu_debugdata_interface_ &&
+         gnu_debugdata_interface_->GetFunctionName(addrs[i], name, func_offset))) {
+      found++;
+    } else {
+      name->clear();
+      *func_offset = 0;
+    }
+  }
+  return found;
+}
+
 bool Elf::GetGlobalVariable(const std::string& name, uint64_t* memory_address) {
   if (!valid_) {
     return false;
@@ -325,6 +395,61 @@ void Elf::SetCachingEnabled(bool enable) {
   }
 }
 
+void Elf::SetDiskCacheDirectory(const std::string& directory) {
+  delete disk_cache_directory_;
+  disk_cache_directory_ = directory.empty() ? nullptr : new std::string(directory);
+}
+
+Memory* Elf::DiskCacheGet(const std::string& path) {
+  android::base::unique_fd fd(TEMP_FAILURE_RETRY(open(path.c_str(), O_RDONLY | O_CLOEXEC)));
+  if (fd == -1) {
+    return nullptr;
+  }
+
+  DiskCacheHeader header;
+  struct stat buf;
+  if (!android::base::ReadFully(fd, &header, sizeof(header)) || fstat(fd, &buf) == -1 ||
+      header.magic != DiskCacheHeader::kMagic || header.version != DiskCacheHeader::kVersion ||
+      header.compressed_size != interface_->gnu_debugdata_size() || header.size == 0 ||
+      header.size != static_cast<uint64_t>(buf.st_size) - sizeof(header)) {
+    return nullptr;
+  }
+
+  std::unique_ptr<MemoryFileAtOffset> memory(new MemoryFileAtOffset);
+  if (!memory->Init(path, sizeof(header), header.size)) {
+    return nullptr;
+  }
+  return memory.release();
+}
+
+void Elf::DiskCacheAdd(const std::string& path, MemoryXz* memory) {
+  DiskCacheHeader header;
+  header.magic = DiskCacheHeader::kMagic;
+  header.version = DiskCacheHeader::kVersion;
+  header.compressed_size = interface_->gnu_debugdata_size();
+  header.size = memory->Size();
+
+  // Write to a file of our own first, so that no reader ever sees a
+  // partial one, and concurrent writers of the same data do not collide.
+  std::string tmp_path = path + android::base::StringPrintf(".%d.tmp", getpid());
+  android::base::unique_fd fd(TEMP_FAILURE_RETRY(
+      open(tmp_path.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0644)));
+  if (fd == -1) {
+    return;
+  }
+  bool written = android::base::WriteFully(fd, &header, sizeof(header));
+  std::vector<uint8_t> buffer(64 * 1024);
+  for (uint64_t offset = 0; written && offset < header.size; offset += buffer.size()) {
+    size_t len = std::min(static_cast<uint64_t>(buffer.size()), header.size - offset);
+    written = memory->ReadFully(offset, buffer.data(), len) &&
+              android::base::WriteFully(fd, buffer.data(), len);
+  }
+  fd.reset();
+  if (!written || rename(tmp_path.c_str(), path.c_str()) == -1) {
+    unlink(tmp_path.c_str());
+  }
+}
+
 void Elf::CacheLock() {
   cache_lock_->lock();
 }
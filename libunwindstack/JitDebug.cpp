@@ -17,10 +17,17 @@
 #include <stdint.h>
 #include <sys/mman.h>
 
+#include <algorithm>
+#include <iterator>
 #include <memory>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 
+#include <unwindstack/DwarfSection.h>
+#include <unwindstack/DwarfStructs.h>
 #include <unwindstack/Elf.h>
+#include <unwindstack/ElfInterface.h>
 #include <unwindstack/JitDebug.h>
 #include <unwindstack/Maps.h>
 #include <unwindstack/Memory.h>
@@ -74,71 +81,68 @@ JitDebug::JitDebug(std::shared_ptr<Memory>& memory) : Global(memory) {}
 JitDebug::JitDebug(std::shared_ptr<Memory>& memory, std::vector<std::string>& search_libs)
     : Global(memory, search_libs) {}
 
-JitDebug::~JitDebug() {
-  for (auto* elf : elf_list_) {
-    delete elf;
-  }
-}
-
-uint64_t JitDebug::ReadDescriptor32(uint64_t addr) {
-  JITDescriptor32 desc;
-  if (!memory_->ReadFully(addr, &desc, sizeof(desc))) {
-    return 0;
-  }
+JitDebug::~JitDebug() {}
 
-  if (desc.header.version != 1 || desc.first_entry == 0) {
-    // Either unknown version, or no jit entries.
-    return 0;
+bool JitDebug::ReadDescriptor32(uint64_t addr, Descriptor* desc) {
+  JITDescriptor32 jit_desc;
+  if (!memory_->ReadFully(addr, &jit_desc, sizeof(jit_desc)) || jit_desc.header.version != 1) {
+    // Either unreadable, or an unknown version.
+    return false;
   }
 
-  return desc.first_entry;
+  desc->action_flag = jit_desc.header.action_flag;
+  desc->relevant_entry = jit_desc.relevant_entry;
+  desc->first_entry = jit_desc.first_entry;
+  return true;
 }
 
-uint64_t JitDebug::ReadDescriptor64(uint64_t addr) {
-  JITDescriptor64 desc;
-  if (!memory_->ReadFully(addr, &desc, sizeof(desc))) {
-    return 0;
+bool JitDebug::ReadDescriptor64(uint64_t addr, Descriptor* desc) {
+  JITDescriptor64 jit_desc;
+  if (!memory_->ReadFully(addr, &jit_desc, sizeof(jit_desc)) || jit_desc.header.version != 1) {
+    // Either unreadable, or an unknown version.
+    return false;
   }
 
-  if (desc.header.version != 1 || desc.first_entry == 0) {
-    // Either unknown version, or no jit entries.
-    return 0;
-  }
-
-  return desc.first_entry;
+  desc->action_flag = jit_desc.header.action_flag;
+  desc->relevant_entry = jit_desc.relevant_entry;
+  desc->first_entry = jit_desc.first_entry;
+  return true;
 }
 
-uint64_t JitDebug::ReadEntry32Pack(uint64_t* start, uint64_t* size) {
+bool JitDebug::ReadEntry32Pack(uint64_t addr, uint64_t* next, uint64_t* start, uint64_t* size) {
   JITCodeEntry32Pack code;
-  if (!memory_->ReadFully(entry_addr_, &code, sizeof(code))) {
-    return 0;
+  if (!memory_->ReadFully(addr, &code, sizeof(code))) {
+    return false;
   }
 
+  *next = code.next;
   *start = code.symfile_addr;
   *size = code.symfile_size;
-  return code.next;
+  return true;
 }
 
-uint64_t JitDebug::ReadEntry32Pad(uint64_t* start, uint64_t* size) {
+bool JitDebug::ReadEntry32Pad(uint64_t addr, uint64_t* next, uint64_t* start, uint64_t* size) {
   JITCodeEntry32Pad code;
-  if (!memory_->ReadFully(entry_addr_, &code, sizeof(code))) {
-    return 0;
+  if (!memory_->ReadFully(addr, &code, sizeof(code))) {
+    return false;
   }
 
+  *next = code.next;
   *start = code.symfile_addr;
   *size = code.symfile_size;
-  return code.next;
+  return true;
 }
 
-uint64_t JitDebug::ReadEntry64(uint64_t* start, uint64_t* size) {
+bool JitDebug::ReadEntry64(uint64_t addr, uint64_t* next, uint64_t* start, uint64_t* size) {
   JITCodeEntry64 code;
-  if (!memory_->ReadFully(entry_addr_, &code, sizeof(code))) {
-    return 0;
+  if (!memory_->ReadFully(addr, &code, sizeof(code))) {
+    return false;
   }
 
+  *next = code.next;
   *start = code.symfile_addr;
   *size = code.symfile_size;
-  return code.next;
+  return true;
 }
 
 void JitDebug::ProcessArch() {
@@ -166,8 +170,13 @@ void JitDebug::ProcessArch() {
 }
 
 bool JitDebug::ReadVariableData(uint64_t ptr) {
-  entry_addr_ = (this->*read_descriptor_func_)(ptr);
-  return entry_addr_ != 0;
+  Descriptor desc;
+  if (!(this->*read_descriptor_func_)(ptr, &desc) || desc.first_entry == 0) {
+    // No jit entries in this descriptor.
+    return false;
+  }
+  descriptor_addr_ = ptr;
+  return true;
 }
 
 void JitDebug::Init(Maps* maps) {
@@ -180,37 +189,78 @@ void JitDebug::Init(Maps* maps) {
   FindAndReadVariable(maps, "__jit_debug_descriptor");
 }
 
-Elf* JitDebug::GetElf(Maps* maps, uint64_t pc) {
-  // Use a single lock, this object should be used so infrequently that
-  // a fine grain lock is unnecessary.
-  std::lock_guard<std::mutex> guard(lock_);
-  if (!initialized_) {
-    Init(maps);
+// Finds the lowest and highest pc of the elf, from the PT_LOAD segments or
+// failing that from the fdes.
+static bool GetPcRange(Elf* elf, uint64_t* start, uint64_t* end) {
+  ElfInterface* interface = elf->interface();
+  if (elf->gnu_debugdata_interface() != nullptr) {
+    // The pcs could come from either interface.
+    return false;
   }
 
-  // Search the existing elf object first.
-  for (Elf* elf : elf_list_) {
-    if (elf->IsValidPc(pc)) {
-      return elf;
+  uint64_t min_pc = UINT64_MAX;
+  uint64_t max_pc = 0;
+  for (const auto& entry : interface->pt_loads()) {
+    const LoadInfo& load = entry.second;
+    min_pc = std::min(min_pc, load.table_offset);
+    max_pc = std::max(max_pc, load.table_offset + load.table_size);
+  }
+  if (interface->pt_loads().empty()) {
+    std::vector<const DwarfFde*> fdes;
+    for (DwarfSection* section : {interface->debug_frame(), interface->eh_frame()}) {
+      if (section != nullptr) {
+        section->GetFdes(&fdes);
+      }
     }
+    for (const DwarfFde* fde : fdes) {
+      min_pc = std::min(min_pc, fde->pc_start);
+      max_pc = std::max(max_pc, fde->pc_end);
+    }
+  }
+  if (min_pc >= max_pc) {
+    return false;
   }
+  *start = min_pc;
+  *end = max_pc;
+  return true;
+}
 
-  while (entry_addr_ != 0) {
+void JitDebug::BuildCodeIndex() {
+  code_index_.clear();
+  unindexed_elfs_.clear();
+  for (auto& entry : entries_) {
+    Elf* elf = entry.second.elf.get();
     uint64_t start;
-    uint64_t size;
-    entry_addr_ = (this->*read_entry_func_)(&start, &size);
-
-    Elf* elf = new Elf(new MemoryRange(memory_, start, size, 0));
-    elf->Init();
-    if (!elf->valid()) {
-      // The data is not formatted in a way we understand, do not attempt
-      // to process any other entries.
-      entry_addr_ = 0;
-      delete elf;
-      return nullptr;
+    uint64_t end;
+    if (!GetPcRange(elf, &start, &end)) {
+      unindexed_elfs_.push_back(elf);
+      continue;
     }
-    elf_list_.push_back(elf);
 
+    // Leave the range out if it overlaps a range already in the index.
+    auto next = code_index_.lower_bound(start);
+    if (next != code_index_.end() && next->first < end) {
+      unindexed_elfs_.push_back(elf);
+      continue;
+    }
+    if (next != code_index_.begin() && std::prev(next)->second.end > start) {
+      unindexed_elfs_.push_back(elf);
+      continue;
+    }
+    code_index_.emplace_hint(next, start, CodeRange{end, elf});
+  }
+}
+
+Elf* JitDebug::FindElf(uint64_t pc) {
+  auto it = code_index_.upper_bound(pc);
+  if (it != code_index_.begin()) {
+    --it;
+    if (pc < it->second.end && it->second.elf->IsValidPc(pc)) {
+      return it->second.elf;
+    }
+  }
+
+  for (Elf* elf : unindexed_elfs_) {
     if (elf->IsValidPc(pc)) {
       return elf;
     }
@@ -218,4 +268,67 @@ Elf* JitDebug::GetElf(Maps* maps, uint64_t pc) {
   return nullptr;
 }
 
+// Walks the entry list again if the descriptor changed since the last walk.
+// Only entries that were not seen before get a new Elf object.
+void JitDebug::UpdateEntries() {
+  Descriptor desc;
+  if (descriptor_addr_ == 0 || !(this->*read_descriptor_func_)(descriptor_addr_, &desc) ||
+      desc == descriptor_) {
+    return;
+  }
+  descriptor_ = desc;
+
+  std::unordered_map<uint64_t, Entry> entries;
+  uint64_t entry_addr = desc.first_entry;
+  while (entry_addr != 0 && entries.count(entry_addr) == 0) {
+    uint64_t next;
+    uint64_t start;
+    uint64_t size;
+    if (!(this->*read_entry_func_)(entry_addr, &next, &start, &size)) {
+      break;
+    }
+
+    auto old_entry = entries_.find(entry_addr);
+    if (old_entry != entries_.end() && old_entry->second.symfile_addr == start &&
+        old_entry->second.symfile_size == size) {
+      entries[entry_addr] = std::move(old_entry->second);
+      entries_.erase(old_entry);
+    } else {
+      std::unique_ptr<Elf> elf(new Elf(new MemoryRange(memory_, start, size, 0)));
+      elf->Init();
+      if (!elf->valid()) {
+        // The data is not formatted in a way we understand, do not attempt
+        // to process any other entries.
+        break;
+      }
+      entries[entry_addr] = Entry{start, size, std::move(elf)};
+    }
+    entry_addr = next;
+  }
+
+  for (auto& entry : entries_) {
+    removed_elfs_.push_back(std::move(entry.second.elf));
+  }
+  entries_ = std::move(entries);
+  BuildCodeIndex();
+}
+
+Elf* JitDebug::GetElf(Maps* maps, uint64_t pc) {
+  // Use a single lock, this object should be used so infrequently that
+  // a fine grain lock is unnecessary.
+  std::lock_guard<std::mutex> guard(lock_);
+  if (!initialized_) {
+    Init(maps);
+  }
+
+  // Only go back to the process when the pc is not covered by an entry
+  // that is already known.
+  Elf* elf = FindElf(pc);
+  if (elf == nullptr) {
+    UpdateEntries();
+    elf = FindElf(pc);
+  }
+  return elf;
+}
+
 }  // namespace unwindstack
@@ -28,7 +28,10 @@
 
 #include <pthread.h>
 #include <stdint.h>
+#include <sys/mman.h>
+#include <ucontext.h>
 
+#include <atomic>
 #include <memory>
 #include <string>
 #include <vector>
@@ -55,9 +58,63 @@ bool LocalUnwinder::Init() {
 
   process_memory_ = unwindstack::Memory::CreateProcessMemory(getpid());
 
+  fp_maps_.reset(new FramePointerMaps);
+  fp_maps_->generation = 0;
+  fp_maps_->num_stack_ranges = 0;
+  fp_maps_->num_code_ranges = 0;
+  UpdateFramePointerMapsLocked();
+
   return true;
 }
 
+bool LocalUnwinder::UpdateFramePointerMaps() {
+  pthread_rwlock_wrlock(&maps_rwlock_);
+  bool parsed = maps_->Reparse();
+  if (parsed) {
+    UpdateFramePointerMapsLocked();
+  }
+  pthread_rwlock_unlock(&maps_rwlock_);
+  return parsed;
+}
+
+void LocalUnwinder::UpdateFramePointerMapsLocked() {
+  // Adjacent maps are merged, since the unwinder only cares about where a
+  // range ends. Whatever does not fit is left out, which only means some
+  // unwinds stop early.
+  auto add_range = [](Range* ranges, size_t* count, uintptr_t start, uintptr_t end) {
+    if (*count != 0 && ranges[*count - 1].end == start) {
+      ranges[*count - 1].end = end;
+    } else if (*count < kMaxFramePointerRanges) {
+      ranges[*count].start = start;
+      ranges[*count].end = end;
+      (*count)++;
+    }
+  };
+
+  FramePointerMaps* fp_maps = fp_maps_.get();
+  uint64_t generation = fp_maps->generation.load(std::memory_order_relaxed);
+  fp_maps->generation.store(generation + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+
+  size_t num_stack_ranges = 0;
+  size_t num_code_ranges = 0;
+  for (const MapInfo* info : *maps_) {
+    if (info->flags & MAPS_FLAGS_DEVICE_MAP) {
+      continue;
+    }
+    if ((info->flags & (PROT_READ | PROT_WRITE)) == (PROT_READ | PROT_WRITE)) {
+      add_range(fp_maps->stack_ranges, &num_stack_ranges, info->start, info->end);
+    }
+    if (info->flags & PROT_EXEC) {
+      add_range(fp_maps->code_ranges, &num_code_ranges, info->start, info->end);
+    }
+  }
+  fp_maps->num_stack_ranges = num_stack_ranges;
+  fp_maps->num_code_ranges = num_code_ranges;
+
+  fp_maps->generation.store(generation + 2, std::memory_order_release);
+}
+
 bool LocalUnwinder::ShouldSkipLibrary(const std::string& map_name) {
   for (const std::string& skip_library : skip_libraries_) {
     if (skip_library == map_name) {
@@ -77,6 +134,7 @@ MapInfo* LocalUnwinder::GetMapInfo(uint64_t pc) {
     // This is guaranteed not to invalidate any previous MapInfo objects so
     // we don't need to worry about any MapInfo* values already in use.
     if (maps_->Reparse()) {
+      UpdateFramePointerMapsLocked();
       map_info = maps_->Find(pc);
     }
     pthread_rwlock_unlock(&maps_rwlock_);
@@ -144,4 +202,103 @@ bool LocalUnwinder::Unwind(std::vector<LocalFrameData>* frame_info, size_t max_f
   return num_frames != 0;
 }
 
+// Nothing in here may allocate, lock or call anything that does.
+__attribute__((noinline)) size_t LocalUnwinder::UnwindFramePointers(void* ucontext,
+                                                                    uint64_t* pcs,
+                                                                    size_t max_frames) {
+  FramePointerMaps* fp_maps = fp_maps_.get();
+  if (fp_maps == nullptr || max_frames == 0) {
+    return 0;
+  }
+  uint64_t generation = fp_maps->generation.load(std::memory_order_acquire);
+  if (generation & 1) {
+    return 0;
+  }
+
+  uintptr_t sp;
+  uintptr_t fp;
+  size_t num_frames = 0;
+  if (ucontext != nullptr) {
+    const mcontext_t& mcontext = reinterpret_cast<ucontext_t*>(ucontext)->uc_mcontext;
+#if defined(__aarch64__)
+    pcs[num_frames++] = mcontext.pc;
+    sp = mcontext.sp;
+    fp = mcontext.regs[29];
+#elif defined(__x86_64__)
+    pcs[num_frames++] = mcontext.gregs[REG_RIP];
+    sp = mcontext.gregs[REG_RSP];
+    fp = mcontext.gregs[REG_RBP];
+#elif defined(__i386__)
+    pcs[num_frames++] = mcontext.gregs[REG_EIP];
+    sp = mcontext.gregs[REG_ESP];
+    fp = mcontext.gregs[REG_EBP];
+#else
+    pcs[num_frames++] = mcontext.arm_pc;
+    return num_frames;
+#endif
+  } else {
+#if defined(__arm__)
+    pcs[num_frames++] = reinterpret_cast<uintptr_t>(__builtin_return_address(0));
+    return num_frames;
+#else
+    // The record of this function leads to the caller.
+    fp = reinterpret_cast<uintptr_t>(__builtin_frame_address(0));
+    sp = fp;
+#endif
+  }
+
+  // The ranges may be rewritten under us, so every count is clamped, and
+  // anything read is only trusted if the generation is unchanged at the end.
+  auto find_range = [](const Range* ranges, size_t count, uintptr_t addr, Range* range) {
+    if (count > kMaxFramePointerRanges) {
+      count = kMaxFramePointerRanges;
+    }
+    size_t first = 0;
+    size_t last = count;
+    while (first < last) {
+      size_t index = (first + last) / 2;
+      Range cur = ranges[index];
+      if (addr < cur.start) {
+        last = index;
+      } else if (addr >= cur.end) {
+        first = index + 1;
+      } else {
+        *range = cur;
+        return true;
+      }
+    }
+    return false;
+  };
+
+  // Frame records hold the caller's frame pointer followed by the return
+  // address, and each one must be above the last within the same stack.
+  Range stack;
+  if (find_range(fp_maps->stack_ranges, fp_maps->num_stack_ranges, sp, &stack)) {
+    constexpr uintptr_t kRecordSize = 2 * sizeof(uintptr_t);
+    uintptr_t min_fp = sp;
+    while (num_frames < max_frames) {
+      if (fp < min_fp || fp % sizeof(uintptr_t) != 0 || fp >= stack.end ||
+          stack.end - fp < kRecordSize) {
+        break;
+      }
+      const uintptr_t* record = reinterpret_cast<const uintptr_t*>(fp);
+      uintptr_t next_fp = record[0];
+      uintptr_t return_address = record[1];
+      Range code;
+      if (!find_range(fp_maps->code_ranges, fp_maps->num_code_ranges, return_address, &code)) {
+        break;
+      }
+      pcs[num_frames++] = return_address;
+      min_fp = fp + kRecordSize;
+      fp = next_fp;
+    }
+  }
+
+  std::atomic_thread_fence(std::memory_order_acquire);
+  if (fp_maps->generation.load(std::memory_order_relaxed) != generation) {
+    return 0;
+  }
+  return num_frames;
+}
+
 }  // namespace unwindstack
@@ -150,6 +150,15 @@ bool Memory::ReadFully(uint64_t addr, void* dst, size_t size) {
   return rc == size;
 }
 
+size_t Memory::ReadBlocks(uint64_t addr, uint8_t* const* dsts, size_t block_size, size_t count) {
+  for (size_t i = 0; i < count; i++) {
+    if (!ReadFully(addr, dsts[i], block_size) || __builtin_add_overflow(addr, block_size, &addr)) {
+      return i;
+    }
+  }
+  return count;
+}
+
 bool Memory::ReadString(uint64_t addr, std::string* string, uint64_t max_read) {
   string->clear();
   uint64_t bytes_read = 0;
@@ -297,6 +306,49 @@ size_t MemoryRemote::Read(uint64_t addr, void* dst, size_t size) {
   }
 }
 
+size_t MemoryRemote::ReadBlocks(uint64_t addr, uint8_t* const* dsts, size_t block_size,
+                                size_t count) {
+  uintptr_t read_func = read_redirect_func_.load();
+  if (read_func != 0 && read_func != reinterpret_cast<uintptr_t>(ProcessVmRead)) {
+    return Memory::ReadBlocks(addr, dsts, block_size, count);
+  }
+
+  // One iovec per block on both sides, the transfer then stops short only
+  // at a block that is not readable.
+  constexpr size_t kMaxIovecs = 64;
+  struct iovec dst_iovs[kMaxIovecs];
+  struct iovec src_iovs[kMaxIovecs];
+  count = std::min(count, kMaxIovecs);
+  uint64_t cur = addr;
+  size_t iovecs_used;
+  for (iovecs_used = 0; iovecs_used < count; iovecs_used++) {
+    // struct iovec uses void* for iov_base.
+    uint64_t end;
+    if (__builtin_add_overflow(cur, block_size, &end) || end - 1 > UINTPTR_MAX) {
+      break;
+    }
+    dst_iovs[iovecs_used].iov_base = dsts[iovecs_used];
+    dst_iovs[iovecs_used].iov_len = block_size;
+    src_iovs[iovecs_used].iov_base = reinterpret_cast<void*>(cur);
+    src_iovs[iovecs_used].iov_len = block_size;
+    cur = end;
+  }
+  if (iovecs_used == 0) {
+    return 0;
+  }
+
+  ssize_t rc = process_vm_readv(pid_, dst_iovs, iovecs_used, src_iovs, iovecs_used, 0);
+  if (rc > 0) {
+    read_redirect_func_ = reinterpret_cast<uintptr_t>(ProcessVmRead);
+    return rc / block_size;
+  }
+  if (read_func == 0) {
+    // Let Read() decide whether ptrace has to be used instead.
+    return Memory::ReadBlocks(addr, dsts, block_size, count);
+  }
+  return 0;
+}
+
 size_t MemoryLocal::Read(uint64_t addr, void* dst, size_t size) {
   return ProcessVmRead(getpid(), addr, dst, size);
 }
@@ -406,6 +458,49 @@ size_t MemoryOfflineParts::Read(uint64_t addr, void* dst, size_t size) {
   return 0;
 }
 
+uint8_t* MemoryCache::GetPage(uint64_t page) {
+  auto entry = cache_.find(page);
+  if (entry == cache_.end()) {
+    return FillPages(page);
+  }
+  pages_.splice(pages_.begin(), pages_, entry->second);
+  return entry->second->data;
+}
+
+uint8_t* MemoryCache::FillPages(uint64_t page) {
+  // Read ahead through the following pages, up to the first one cached.
+  size_t count = 1;
+  while (count < kReadAheadPages && page + count <= (UINT64_MAX >> kCacheBits) &&
+         cache_.count(page + count) == 0) {
+    count++;
+  }
+
+  std::list<CachePage> fill(count);
+  uint8_t* dsts[kReadAheadPages];
+  size_t i = 0;
+  for (CachePage& cache_page : fill) {
+    cache_page.page = page + i;
+    dsts[i++] = cache_page.data;
+  }
+
+  size_t read = impl_->ReadBlocks(page << kCacheBits, dsts, kCacheSize, count);
+  if (read == 0) {
+    return nullptr;
+  }
+  fill.resize(read);
+  for (auto it = fill.begin(); it != fill.end(); ++it) {
+    cache_[it->page] = it;
+  }
+  // The requested page becomes the most recently used one. Only now drop
+  // the least recently used pages, as many as were actually added.
+  pages_.splice(pages_.begin(), fill);
+  while (pages_.size() > kMaxCachedPages) {
+    cache_.erase(pages_.back().page);
+    pages_.pop_back();
+  }
+  return pages_.front().data;
+}
+
 size_t MemoryCache::Read(uint64_t addr, void* dst, size_t size) {
   // Only bother caching and looking at the cache if this is a small read for now.
   if (size > 64) {
@@ -413,17 +508,9 @@ size_t MemoryCache::Read(uint64_t addr, void* dst, size_t size) {
   }
 
   uint64_t addr_page = addr >> kCacheBits;
-  auto entry = cache_.find(addr_page);
-  uint8_t* cache_dst;
-  if (entry != cache_.end()) {
-    cache_dst = entry->second;
-  } else {
-    cache_dst = cache_[addr_page];
-    if (!impl_->ReadFully(addr_page << kCacheBits, cache_dst, kCacheSize)) {
-      // Erase the entry.
-      cache_.erase(addr_page);
-      return impl_->Read(addr, dst, size);
-    }
+  uint8_t* cache_dst = GetPage(addr_page);
+  if (cache_dst == nullptr) {
+    return impl_->Read(addr, dst, size);
   }
   size_t max_read = ((addr_page + 1) << kCacheBits) - addr;
   if (size <= max_read) {
@@ -437,16 +524,9 @@ size_t MemoryCache::Read(uint64_t addr, void* dst, size_t size) {
   dst = &reinterpret_cast<uint8_t*>(dst)[max_read];
   addr_page++;
 
-  entry = cache_.find(addr_page);
-  if (entry != cache_.end()) {
-    cache_dst = entry->second;
-  } else {
-    cache_dst = cache_[addr_page];
-    if (!impl_->ReadFully(addr_page << kCacheBits, cache_dst, kCacheSize)) {
-      // Erase the entry.
-      cache_.erase(addr_page);
-      return impl_->Read(addr_page << kCacheBits, dst, size - max_read) + max_read;
-    }
+  cache_dst = GetPage(addr_page);
+  if (cache_dst == nullptr) {
+    return impl_->Read(addr_page << kCacheBits, dst, size - max_read) + max_read;
   }
   memcpy(dst, cache_dst, size - max_read);
   return size;
@@ -0,0 +1,266 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <7zCrc.h>
+#include <Xz.h>
+#include <XzCrc64.h>
+
+#include <unwindstack/Memory.h>
+
+namespace unwindstack {
+
+// Sizes from the xz file format specification.
+static constexpr size_t kXzStreamHeaderSize = 12;
+static constexpr size_t kXzStreamFooterSize = 12;
+static constexpr uint8_t kXzFooterMagic[] = {'Y', 'Z'};
+
+static uint32_t ReadLe32(const uint8_t* data) {
+  return data[0] | (data[1] << 8) | (data[2] << 16) | (static_cast<uint32_t>(data[3]) << 24);
+}
+
+// Decodes a multibyte integer of the xz index, advancing |offset|.
+static bool ReadXzVarint(const uint8_t* data, size_t end, size_t* offset, uint64_t* value) {
+  *value = 0;
+  for (size_t i = 0; i < 9 && *offset < end; i++) {
+    uint8_t byte = data[(*offset)++];
+    *value |= static_cast<uint64_t>(byte & 0x7f) << (i * 7);
+    if ((byte & 0x80) == 0) {
+      // The encoding must be minimal.
+      return i == 0 || byte != 0;
+    }
+  }
+  return false;
+}
+
+static void* XzAlloc(ISzAllocPtr, size_t size) {
+  return malloc(size);
+}
+
+static void XzFree(ISzAllocPtr, void* ptr) {
+  free(ptr);
+}
+
+MemoryXz::MemoryXz(Memory* memory, uint64_t addr, uint64_t size)
+    : memory_(memory), addr_(addr), compressed_(size) {}
+
+bool MemoryXz::Init() {
+  // TODO: Only call these initialization functions once.
+  CrcGenerateTable();
+  Crc64GenerateTable();
+
+  if (compressed_.size() < kXzStreamHeaderSize + kXzStreamFooterSize ||
+      !memory_->ReadFully(addr_, compressed_.data(), compressed_.size())) {
+    return false;
+  }
+  if (ReadIndex()) {
+    return true;
+  }
+  blocks_.clear();
+  return DecompressAll();
+}
+
+// Builds the block list from the index at the end of the stream. Only a
+// lone stream without padding is handled here, anything else is left to
+// DecompressAll().
+bool MemoryXz::ReadIndex() {
+  const uint8_t* data = compressed_.data();
+  size_t footer = compressed_.size() - kXzStreamFooterSize;
+  if (memcmp(&data[footer + 10], kXzFooterMagic, sizeof(kXzFooterMagic)) != 0 ||
+      CrcCalc(&data[footer + 4], 6) != ReadLe32(&data[footer]) ||
+      memcmp(&data[footer + 8], &data[6], 2) != 0) {
+    return false;
+  }
+  uint64_t index_size = (static_cast<uint64_t>(ReadLe32(&data[footer + 4])) + 1) * 4;
+  if (index_size > footer - kXzStreamHeaderSize) {
+    return false;
+  }
+  size_t index = footer - index_size;
+  size_t index_crc = footer - 4;
+  if (data[index] != 0 || CrcCalc(&data[index], index_crc - index) != ReadLe32(&data[index_crc])) {
+    return false;
+  }
+
+  size_t offset = index + 1;
+  uint64_t count;
+  if (!ReadXzVarint(data, index_crc, &offset, &count) || count > index_size) {
+    return false;
+  }
+  uint64_t compressed_offset = kXzStreamHeaderSize;
+  uint64_t decompressed_offset = 0;
+  blocks_.resize(count);
+  for (Block& block : blocks_) {
+    uint64_t unpadded_size;
+    if (!ReadXzVarint(data, index_crc, &offset, &unpadded_size) ||
+        !ReadXzVarint(data, index_crc, &offset, &block.size) || unpadded_size == 0 ||
+        unpadded_size > index || block.size > SIZE_MAX - decompressed_offset) {
+      return false;
+    }
+    block.compressed_offset = compressed_offset;
+    block.compressed_size = (unpadded_size + 3) & ~3ULL;
+    block.offset = decompressed_offset;
+    compressed_offset += block.compressed_size;
+    decompressed_offset += block.size;
+    if (compressed_offset > index) {
+      return false;
+    }
+  }
+  // The blocks must exactly fill the space between the header and the index.
+  if (compressed_offset != index) {
+    return false;
+  }
+  while (offset < index_crc) {
+    if (data[offset++] != 0) {
+      return false;
+    }
+  }
+
+  // Drop empty blocks so that every block covers a part of the data.
+  blocks_.erase(std::remove_if(blocks_.begin(), blocks_.end(),
+                               [](const Block& block) { return block.size == 0; }),
+                blocks_.end());
+  size_ = decompressed_offset;
+  return true;
+}
+
+// Decompresses one block by handing the unpacker the stream header followed
+// by just that block. The unpacker verifies the block's check as it finishes
+// the block, there is no need to go on into the index.
+bool MemoryXz::Decompress(Block* block) {
+  std::vector<uint8_t> src(kXzStreamHeaderSize + block->compressed_size);
+  memcpy(src.data(), compressed_.data(), kXzStreamHeaderSize);
+  memcpy(&src[kXzStreamHeaderSize], &compressed_[block->compressed_offset],
+         block->compressed_size);
+  std::unique_ptr<uint8_t[]> dst(new uint8_t[block->size]);
+
+  ISzAlloc alloc;
+  alloc.Alloc = XzAlloc;
+  alloc.Free = XzFree;
+  CXzUnpacker state;
+  XzUnpacker_Construct(&state, &alloc);
+
+  int return_val;
+  size_t src_offset = 0;
+  size_t dst_offset = 0;
+  ECoderStatus status;
+  do {
+    size_t src_remaining = src.size() - src_offset;
+    size_t dst_remaining = block->size - dst_offset;
+    return_val = XzUnpacker_Code(&state, &dst[dst_offset], &dst_remaining, &src[src_offset],
+                                 &src_remaining, false, CODER_FINISH_ANY, &status);
+    if (src_remaining == 0 && dst_remaining == 0) {
+      break;
+    }
+    src_offset += src_remaining;
+    dst_offset += dst_remaining;
+  } while (return_val == SZ_OK && src_offset < src.size());
+  XzUnpacker_Free(&state);
+  if (return_val != SZ_OK || src_offset != src.size() || dst_offset != block->size) {
+    return false;
+  }
+  block->data = std::move(dst);
+  return true;
+}
+
+// Fallback for streams whose index is unusable: decompress everything now,
+// into a single block.
+bool MemoryXz::DecompressAll() {
+  ISzAlloc alloc;
+  alloc.Alloc = XzAlloc;
+  alloc.Free = XzFree;
+  CXzUnpacker state;
+  XzUnpacker_Construct(&state, &alloc);
+
+  std::vector<uint8_t> dst(5 * compressed_.size());
+  int return_val;
+  size_t src_offset = 0;
+  size_t dst_offset = 0;
+  ECoderStatus status;
+  do {
+    size_t src_remaining = compressed_.size() - src_offset;
+    size_t dst_remaining = dst.size() - dst_offset;
+    if (dst_remaining < 2 * compressed_.size()) {
+      dst.resize(dst.size() + 2 * compressed_.size());
+      dst_remaining += 2 * compressed_.size();
+    }
+    return_val = XzUnpacker_Code(&state, &dst[dst_offset], &dst_remaining, &compressed_[src_offset],
+                                 &src_remaining, true, CODER_FINISH_ANY, &status);
+    src_offset += src_remaining;
+    dst_offset += dst_remaining;
+  } while (return_val == SZ_OK && status == CODER_STATUS_NOT_FINISHED);
+  XzUnpacker_Free(&state);
+  if (return_val != SZ_OK || !XzUnpacker_IsStreamWasFinished(&state) || dst_offset == 0) {
+    return false;
+  }
+
+  Block block;
+  block.compressed_offset = 0;
+  block.compressed_size = compressed_.size();
+  block.offset = 0;
+  block.size = dst_offset;
+  block.data.reset(new uint8_t[dst_offset]);
+  memcpy(block.data.get(), dst.data(), dst_offset);
+  blocks_.push_back(std::move(block));
+  size_ = dst_offset;
+
+  // Nothing is left to decompress.
+  compressed_.clear();
+  compressed_.shrink_to_fit();
+  return true;
+}
+
+size_t MemoryXz::Read(uint64_t addr, void* dst, size_t size) {
+  if (addr >= size_) {
+    return 0;
+  }
+  size = std::min(static_cast<uint64_t>(size), size_ - addr);
+
+  // Find the last block starting at or before addr.
+  auto it = std::upper_bound(blocks_.begin(), blocks_.end(), addr,
+                             [](uint64_t addr, const Block& block) { return addr < block.offset; });
+  size_t bytes = 0;
+  for (--it; bytes < size && it != blocks_.end(); ++it) {
+    const uint8_t* data;
+    {
+      std::lock_guard<std::mutex> guard(lock_);
+      if (it->data == nullptr && !Decompress(&*it)) {
+        break;
+      }
+      data = it->data.get();
+    }
+    uint64_t offset = addr + bytes - it->offset;
+    size_t len = std::min(static_cast<uint64_t>(size - bytes), it->size - offset);
+    memcpy(reinterpret_cast<uint8_t*>(dst) + bytes, &data[offset], len);
+    bytes += len;
+  }
+  return bytes;
+}
+
+size_t MemoryXz::DecompressedBlockCount() {
+  std::lock_guard<std::mutex> guard(lock_);
+  return std::count_if(blocks_.begin(), blocks_.end(),
+                       [](const Block& block) { return block.data != nullptr; });
+}
+
+}  // namespace unwindstack
@@ -16,9 +16,11 @@
 
 #include <elf.h>
 #include <stdint.h>
+#include <string.h>
 
 #include <algorithm>
 #include <string>
+#include <vector>
 
 #include <unwindstack/Memory.h>
 
@@ -29,8 +31,7 @@ namespace unwindstack {
 
 Symbols::Symbols(uint64_t offset, uint64_t size, uint64_t entry_size, uint64_t str_offset,
                  uint64_t str_size)
-    : cur_offset_(offset),
-      offset_(offset),
+    : offset_(offset),
       end_(offset + size),
       entry_size_(entry_size),
       str_offset_(str_offset),
@@ -45,7 +46,7 @@ const Symbols::Info* Symbols::GetInfoFromCache(uint64_t addr) {
     const Info* info = &symbols_[current];
     if (addr < info->start_offset) {
       last = current;
-    } else if (addr < info->end_offset) {
+    } else if (addr - info->start_offset < info->size) {
       return info;
     } else {
       first = current + 1;
@@ -55,52 +56,63 @@ const Symbols::Info* Symbols::GetInfoFromCache(uint64_t addr) {
 }
 
 template <typename SymType>
-bool Symbols::GetName(uint64_t addr, Memory* elf_memory, std::string* name, uint64_t* func_offset) {
-  if (symbols_.size() != 0) {
-    const Info* info = GetInfoFromCache(addr);
-    if (info) {
-      CHECK(addr >= info->start_offset && addr <= info->end_offset);
-      *func_offset = addr - info->start_offset;
-      return elf_memory->ReadString(info->str_offset, name, str_end_ - info->str_offset);
-    }
+void Symbols::ReadAllSymbols(Memory* elf_memory) {
+  symbols_read_ = true;
+  if (entry_size_ == 0 || end_ < offset_ + entry_size_) {
+    return;
   }
 
-  bool symbol_added = false;
-  bool return_value = false;
-  while (cur_offset_ + entry_size_ <= end_) {
-    SymType entry;
-    if (!elf_memory->ReadFully(cur_offset_, &entry, sizeof(entry))) {
-      // Stop all processing, something looks like it is corrupted.
-      cur_offset_ = UINT64_MAX;
-      return false;
-    }
-    cur_offset_ += entry_size_;
-
-    if (entry.st_shndx != SHN_UNDEF && ELF32_ST_TYPE(entry.st_info) == STT_FUNC) {
-      // Treat st_value as virtual address.
-      uint64_t start_offset = entry.st_value;
-      uint64_t end_offset = start_offset + entry.st_size;
-
-      // Cache the value.
-      symbols_.emplace_back(start_offset, end_offset, str_offset_ + entry.st_name);
-      symbol_added = true;
-
-      if (addr >= start_offset && addr < end_offset) {
-        *func_offset = addr - start_offset;
-        uint64_t offset = str_offset_ + entry.st_name;
-        if (offset < str_end_) {
-          return_value = elf_memory->ReadString(offset, name, str_end_ - offset);
-        }
+  // Read the table in chunks rather than an entry at a time.
+  constexpr size_t kEntriesPerRead = 256;
+  uint64_t num_entries = (end_ - offset_) / entry_size_;
+  std::vector<uint8_t> buffer;
+  bool corrupted = false;
+  for (uint64_t first = 0; first < num_entries && !corrupted; first += kEntriesPerRead) {
+    size_t count = std::min(static_cast<uint64_t>(kEntriesPerRead), num_entries - first);
+    buffer.resize((count - 1) * entry_size_ + sizeof(SymType));
+    uint64_t chunk_offset = offset_ + first * entry_size_;
+    bool chunk_read = elf_memory->ReadFully(chunk_offset, buffer.data(), buffer.size());
+
+    for (size_t i = 0; i < count; i++) {
+      SymType entry;
+      if (chunk_read) {
+        memcpy(&entry, &buffer[i * entry_size_], sizeof(entry));
+      } else if (!elf_memory->ReadFully(chunk_offset + i * entry_size_, &entry, sizeof(entry))) {
+        // Stop all processing, something looks like it is corrupted.
+        corrupted = true;
         break;
       }
+      // Nothing real is 4GB in size, skip anything that claims to be.
+      if (entry.st_shndx != SHN_UNDEF && ELF32_ST_TYPE(entry.st_info) == STT_FUNC &&
+          entry.st_size <= UINT32_MAX) {
+        // Treat st_value as virtual address.
+        symbols_.emplace_back(entry.st_value, entry.st_size, entry.st_name);
+      }
     }
   }
 
-  if (symbol_added) {
-    std::sort(symbols_.begin(), symbols_.end(),
-              [](const Info& a, const Info& b) { return a.start_offset < b.start_offset; });
+  std::sort(symbols_.begin(), symbols_.end(),
+            [](const Info& a, const Info& b) { return a.start_offset < b.start_offset; });
+  symbols_.shrink_to_fit();
+}
+
+template <typename SymType>
+bool Symbols::GetName(uint64_t addr, Memory* elf_memory, std::string* name, uint64_t* func_offset) {
+  if (!symbols_read_) {
+    ReadAllSymbols<SymType>(elf_memory);
+  }
+
+  const Info* info = GetInfoFromCache(addr);
+  if (info == nullptr) {
+    return false;
+  }
+  CHECK(addr >= info->start_offset && addr - info->start_offset < info->size);
+  *func_offset = addr - info->start_offset;
+  uint64_t offset = str_offset_ + info->name;
+  if (offset >= str_end_) {
+    return false;
   }
-  return return_value;
+  return elf_memory->ReadString(offset, name, str_end_ - offset);
 }
 
 template <typename SymType>
@@ -28,12 +28,14 @@ namespace unwindstack {
 class Memory;
 
 class Symbols {
+  // Kept compact, a large library has tens of thousands of these.
   struct Info {
-    Info(uint64_t start_offset, uint64_t end_offset, uint64_t str_offset)
-        : start_offset(start_offset), end_offset(end_offset), str_offset(str_offset) {}
+    Info(uint64_t start_offset, uint32_t size, uint32_t name)
+        : start_offset(start_offset), size(size), name(name) {}
     uint64_t start_offset;
-    uint64_t end_offset;
-    uint64_t str_offset;
+    uint32_t size;
+    // Offset of the name in the string table.
+    uint32_t name;
   };
 
  public:
@@ -51,11 +53,16 @@ class Symbols {
 
   void ClearCache() {
     symbols_.clear();
-    cur_offset_ = offset_;
+    symbols_read_ = false;
   }
 
  private:
-  uint64_t cur_offset_;
+  // Reads all function symbols of the table at once and sorts them by
+  // address, so that every lookup is a binary search.
+  template <typename SymType>
+  void ReadAllSymbols(Memory* elf_memory);
+
+  bool symbols_read_ = false;
   uint64_t offset_;
   uint64_t end_;
   uint64_t entry_size_;
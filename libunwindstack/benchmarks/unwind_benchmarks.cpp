@@ -15,20 +15,27 @@
  */
 
 #include <stdint.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
 
 #include <memory>
+#include <vector>
 
 #include <benchmark/benchmark.h>
 
 #include <android-base/strings.h>
 
 #include <unwindstack/Elf.h>
+#include <unwindstack/LocalUnwinder.h>
 #include <unwindstack/Maps.h>
 #include <unwindstack/Memory.h>
 #include <unwindstack/Regs.h>
 #include <unwindstack/RegsGetLocal.h>
 #include <unwindstack/Unwinder.h>
 
+#include "DwarfDebugFrame.h"
+
 size_t Call6(std::shared_ptr<unwindstack::Memory>& process_memory, unwindstack::Maps* maps) {
   std::unique_ptr<unwindstack::Regs> regs(unwindstack::Regs::CreateFromLocal());
   unwindstack::RegsGetLocal(regs.get());
@@ -83,6 +90,80 @@ static void BM_cached_unwind(benchmark::State& state) {
 }
 BENCHMARK(BM_cached_unwind);
 
+static void BM_local_unwinder_unwind(benchmark::State& state) {
+  unwindstack::LocalUnwinder unwinder;
+  if (!unwinder.Init()) {
+    state.SkipWithError("Failed to init local unwinder.");
+  }
+
+  for (auto _ : state) {
+    std::vector<unwindstack::LocalFrameData> frame_info;
+    benchmark::DoNotOptimize(unwinder.Unwind(&frame_info, 64));
+  }
+}
+BENCHMARK(BM_local_unwinder_unwind);
+
+static void BM_local_unwinder_unwind_frame_pointers(benchmark::State& state) {
+  unwindstack::LocalUnwinder unwinder;
+  if (!unwinder.Init()) {
+    state.SkipWithError("Failed to init local unwinder.");
+  }
+
+  uint64_t pcs[64];
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(unwinder.UnwindFramePointers(nullptr, pcs, 64));
+  }
+}
+BENCHMARK(BM_local_unwinder_unwind_frame_pointers);
+
+static void BM_local_maps_parse(benchmark::State& state) {
+  for (auto _ : state) {
+    unwindstack::LocalMaps maps;
+    if (!maps.Parse()) {
+      state.SkipWithError("Failed to parse local maps.");
+      break;
+    }
+  }
+}
+BENCHMARK(BM_local_maps_parse);
+
+// The common case: an unknown pc forces a reparse, but nothing changed.
+// The argument adds that many maps, as in an app with lots of JIT code.
+static void BM_local_updatable_maps_reparse(benchmark::State& state) {
+  size_t extra_maps = state.range(0);
+  size_t page_size = getpagesize();
+  uint8_t* mapping = nullptr;
+  if (extra_maps != 0) {
+    mapping = reinterpret_cast<uint8_t*>(mmap(nullptr, extra_maps * page_size, PROT_READ,
+                                              MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+    if (mapping == MAP_FAILED) {
+      state.SkipWithError("Failed to create maps.");
+      return;
+    }
+    // Alternate the protections so that no two neighbours are merged.
+    for (size_t i = 0; i < extra_maps; i += 2) {
+      mprotect(&mapping[i * page_size], page_size, PROT_READ | PROT_WRITE);
+    }
+  }
+
+  unwindstack::LocalUpdatableMaps maps;
+  if (!maps.Parse()) {
+    state.SkipWithError("Failed to parse local maps.");
+  }
+
+  for (auto _ : state) {
+    if (!maps.Reparse()) {
+      state.SkipWithError("Failed to reparse local maps.");
+      break;
+    }
+  }
+
+  if (mapping != nullptr) {
+    munmap(mapping, extra_maps * page_size);
+  }
+}
+BENCHMARK(BM_local_updatable_maps_reparse)->Arg(0)->Arg(4000);
+
 static void Initialize(benchmark::State& state, unwindstack::Maps& maps,
                        unwindstack::MapInfo** build_id_map_info) {
   if (!maps.Parse()) {
@@ -142,4 +223,61 @@ static void BM_get_build_id_from_file(benchmark::State& state) {
 }
 BENCHMARK(BM_get_build_id_from_file);
 
+// A .debug_frame of one cie followed by |count| fdes of 0x10 bytes of pc
+// each, the way a binary without .eh_frame_hdr describes its functions.
+static void CreateDebugFrame(size_t count, unwindstack::MemoryBuffer* memory) {
+  static constexpr size_t kEntrySize = 16;
+  memory->Resize((count + 1) * kEntrySize);
+  uint8_t* data = memory->GetPtr(0);
+  memset(data, 0, memory->Size());
+
+  // cie: length, id, version 1, no augmentation, code alignment 1,
+  // data alignment -4, return address register 14, nops to pad.
+  uint32_t value = kEntrySize - 4;
+  memcpy(data, &value, sizeof(value));
+  value = 0xffffffff;
+  memcpy(&data[4], &value, sizeof(value));
+  data[8] = 1;
+  data[10] = 1;
+  data[11] = 0x7c;
+  data[12] = 14;
+
+  for (size_t i = 0; i < count; i++) {
+    uint8_t* fde = &data[(i + 1) * kEntrySize];
+    uint32_t values[] = {kEntrySize - 4, 0, static_cast<uint32_t>(0x1000 + i * 0x10), 0x10};
+    memcpy(fde, values, sizeof(values));
+  }
+}
+
+static void BM_debug_frame_get_fde_from_pc(benchmark::State& state) {
+  unwindstack::MemoryBuffer memory;
+  CreateDebugFrame(state.range(0), &memory);
+  unwindstack::DwarfDebugFrame<uint32_t> debug_frame(&memory);
+  if (!debug_frame.Init(0, memory.Size(), 0) || debug_frame.GetFdeFromPc(0) != nullptr) {
+    state.SkipWithError("Failed to init the .debug_frame.");
+  }
+
+  uint64_t pc_range = state.range(0) * 0x10;
+  uint64_t offset = 0;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(debug_frame.GetFdeFromPc(0x1000 + offset));
+    // Stride through the section, so that each lookup lands somewhere new.
+    offset = (offset + 0x9d8) % pc_range;
+  }
+}
+BENCHMARK(BM_debug_frame_get_fde_from_pc)->Arg(1000)->Arg(50000);
+
+// The first lookup, which reads in all of the entries.
+static void BM_debug_frame_first_lookup(benchmark::State& state) {
+  unwindstack::MemoryBuffer memory;
+  CreateDebugFrame(state.range(0), &memory);
+
+  for (auto _ : state) {
+    unwindstack::DwarfDebugFrame<uint32_t> debug_frame(&memory);
+    debug_frame.Init(0, memory.Size(), 0);
+    benchmark::DoNotOptimize(debug_frame.GetFdeFromPc(0));
+  }
+}
+BENCHMARK(BM_debug_frame_first_lookup)->Arg(1000)->Arg(50000);
+
 BENCHMARK_MAIN();
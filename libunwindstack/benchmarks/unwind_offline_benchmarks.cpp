@@ -0,0 +1,288 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+#include <benchmark/benchmark.h>
+
+#include <android-base/file.h>
+
+#include <unwindstack/MachineArm.h>
+#include <unwindstack/MachineArm64.h>
+#include <unwindstack/MachineX86_64.h>
+#include <unwindstack/Maps.h>
+#include <unwindstack/Memory.h>
+#include <unwindstack/Regs.h>
+#include <unwindstack/RegsArm.h>
+#include <unwindstack/RegsArm64.h>
+#include <unwindstack/RegsX86_64.h>
+#include <unwindstack/Unwinder.h>
+
+// Replays the unwinds captured in the offline test data, the same snapshots
+// that UnwindOfflineTest verifies. A cold unwind starts from freshly parsed
+// maps, so every elf file is opened and read again. A warm unwind reuses the
+// maps, and so the elf and dwarf data cached by a previous unwind.
+
+namespace unwindstack {
+
+static std::unordered_map<std::string, uint32_t> g_arm_regs = {
+    {"r0", ARM_REG_R0},  {"r1", ARM_REG_R1}, {"r2", ARM_REG_R2},   {"r3", ARM_REG_R3},
+    {"r4", ARM_REG_R4},  {"r5", ARM_REG_R5}, {"r6", ARM_REG_R6},   {"r7", ARM_REG_R7},
+    {"r8", ARM_REG_R8},  {"r9", ARM_REG_R9}, {"r10", ARM_REG_R10}, {"r11", ARM_REG_R11},
+    {"ip", ARM_REG_R12}, {"sp", ARM_REG_SP}, {"lr", ARM_REG_LR},   {"pc", ARM_REG_PC},
+};
+
+static std::unordered_map<std::string, uint32_t> g_arm64_regs = {
+    {"x0", ARM64_REG_R0},   {"x1", ARM64_REG_R1},   {"x2", ARM64_REG_R2},   {"x3", ARM64_REG_R3},
+    {"x4", ARM64_REG_R4},   {"x5", ARM64_REG_R5},   {"x6", ARM64_REG_R6},   {"x7", ARM64_REG_R7},
+    {"x8", ARM64_REG_R8},   {"x9", ARM64_REG_R9},   {"x10", ARM64_REG_R10}, {"x11", ARM64_REG_R11},
+    {"x12", ARM64_REG_R12}, {"x13", ARM64_REG_R13}, {"x14", ARM64_REG_R14}, {"x15", ARM64_REG_R15},
+    {"x16", ARM64_REG_R16}, {"x17", ARM64_REG_R17}, {"x18", ARM64_REG_R18}, {"x19", ARM64_REG_R19},
+    {"x20", ARM64_REG_R20}, {"x21", ARM64_REG_R21}, {"x22", ARM64_REG_R22}, {"x23", ARM64_REG_R23},
+    {"x24", ARM64_REG_R24}, {"x25", ARM64_REG_R25}, {"x26", ARM64_REG_R26}, {"x27", ARM64_REG_R27},
+    {"x28", ARM64_REG_R28}, {"x29", ARM64_REG_R29}, {"sp", ARM64_REG_SP},   {"lr", ARM64_REG_LR},
+    {"pc", ARM64_REG_PC},
+};
+
+static std::unordered_map<std::string, uint32_t> g_x86_64_regs = {
+    {"rax", X86_64_REG_RAX}, {"rbx", X86_64_REG_RBX}, {"rcx", X86_64_REG_RCX},
+    {"rdx", X86_64_REG_RDX}, {"r8", X86_64_REG_R8},   {"r9", X86_64_REG_R9},
+    {"r10", X86_64_REG_R10}, {"r11", X86_64_REG_R11}, {"r12", X86_64_REG_R12},
+    {"r13", X86_64_REG_R13}, {"r14", X86_64_REG_R14}, {"r15", X86_64_REG_R15},
+    {"rdi", X86_64_REG_RDI}, {"rsi", X86_64_REG_RSI}, {"rbp", X86_64_REG_RBP},
+    {"rsp", X86_64_REG_RSP}, {"rip", X86_64_REG_RIP},
+};
+
+class OfflineUnwind {
+ public:
+  ~OfflineUnwind() {
+    if (cwd_ != nullptr && chdir(cwd_) != 0) {
+      fprintf(stderr, "Failed to change back to %s\n", cwd_);
+    }
+    free(cwd_);
+  }
+
+  // Loads the snapshot and changes into its directory, so that the relative
+  // names in maps.txt find the elf files.
+  bool Init(const std::string& name, ArchEnum arch, std::string* error) {
+    dir_ = android::base::GetExecutableDirectory() + "/tests/files/offline/" + name + "/";
+    if (!android::base::ReadFileToString(dir_ + "maps.txt", &maps_data_)) {
+      *error = "Failed to read " + dir_ + "maps.txt";
+      return false;
+    }
+    if (!ReadStack(error) || !ReadRegs(arch, error)) {
+      return false;
+    }
+    cwd_ = getcwd(nullptr, 0);
+    if (chdir(dir_.c_str()) != 0) {
+      *error = "Failed to change to " + dir_;
+      return false;
+    }
+    return true;
+  }
+
+  std::unique_ptr<Maps> CreateMaps() {
+    std::unique_ptr<Maps> maps(new BufferMaps(maps_data_.c_str()));
+    if (!maps->Parse()) {
+      return nullptr;
+    }
+    return maps;
+  }
+
+  size_t Unwind(Maps* maps) {
+    std::unique_ptr<Regs> regs(regs_->Clone());
+    Unwinder unwinder(128, maps, regs.get(), process_memory_);
+    unwinder.Unwind();
+    return unwinder.NumFrames();
+  }
+
+ private:
+  bool ReadStack(std::string* error) {
+    std::string stack_name(dir_ + "stack.data");
+    struct stat st;
+    if (stat(stack_name.c_str(), &st) == 0 && S_ISREG(st.st_mode)) {
+      std::unique_ptr<MemoryOffline> stack_memory(new MemoryOffline);
+      if (!stack_memory->Init(stack_name, 0)) {
+        *error = "Failed to read " + stack_name;
+        return false;
+      }
+      process_memory_.reset(stack_memory.release());
+      return true;
+    }
+
+    std::unique_ptr<MemoryOfflineParts> stack_memory(new MemoryOfflineParts);
+    for (size_t i = 0;; i++) {
+      stack_name = dir_ + "stack" + std::to_string(i) + ".data";
+      if (stat(stack_name.c_str(), &st) == -1 || !S_ISREG(st.st_mode)) {
+        if (i == 0) {
+          *error = "No stack data files found in " + dir_;
+          return false;
+        }
+        break;
+      }
+      MemoryOffline* memory = new MemoryOffline;
+      if (!memory->Init(stack_name, 0)) {
+        delete memory;
+        *error = "Failed to read " + stack_name;
+        return false;
+      }
+      stack_memory->Add(memory);
+    }
+    process_memory_.reset(stack_memory.release());
+    return true;
+  }
+
+  template <typename AddressType>
+  bool ReadRegs(RegsImpl<AddressType>* regs,
+                const std::unordered_map<std::string, uint32_t>& name_to_reg,
+                std::string* error) {
+    FILE* fp = fopen((dir_ + "regs.txt").c_str(), "r");
+    if (fp == nullptr) {
+      *error = "Failed to open " + dir_ + "regs.txt";
+      return false;
+    }
+    bool success = true;
+    while (!feof(fp)) {
+      uint64_t value;
+      char reg_name[100];
+      if (fscanf(fp, "%99s %" SCNx64 "\n", reg_name, &value) != 2) {
+        *error = "Malformed " + dir_ + "regs.txt";
+        success = false;
+        break;
+      }
+      std::string name(reg_name);
+      if (!name.empty()) {
+        // Remove the : from the end.
+        name.resize(name.size() - 1);
+      }
+      auto entry = name_to_reg.find(name);
+      if (entry == name_to_reg.end()) {
+        *error = "Unknown register named " + name;
+        success = false;
+        break;
+      }
+      (*regs)[entry->second] = value;
+    }
+    fclose(fp);
+    return success;
+  }
+
+  bool ReadRegs(ArchEnum arch, std::string* error) {
+    switch (arch) {
+      case ARCH_ARM: {
+        RegsArm* regs = new RegsArm;
+        regs_.reset(regs);
+        return ReadRegs<uint32_t>(regs, g_arm_regs, error);
+      }
+      case ARCH_ARM64: {
+        RegsArm64* regs = new RegsArm64;
+        regs_.reset(regs);
+        return ReadRegs<uint64_t>(regs, g_arm64_regs, error);
+      }
+      case ARCH_X86_64: {
+        RegsX86_64* regs = new RegsX86_64;
+        regs_.reset(regs);
+        return ReadRegs<uint64_t>(regs, g_x86_64_regs, error);
+      }
+      default:
+        *error = "Unsupported arch " + std::to_string(arch);
+        return false;
+    }
+  }
+
+  char* cwd_ = nullptr;
+  std::string dir_;
+  std::string maps_data_;
+  std::unique_ptr<Regs> regs_;
+  std::shared_ptr<Memory> process_memory_;
+};
+
+static void BM_offline_unwind_cold(benchmark::State& state, const char* name, ArchEnum arch) {
+  OfflineUnwind offline;
+  std::string error;
+  if (!offline.Init(name, arch, &error)) {
+    state.SkipWithError(error.c_str());
+    return;
+  }
+
+  for (auto _ : state) {
+    state.PauseTiming();
+    std::unique_ptr<Maps> maps(offline.CreateMaps());
+    if (maps == nullptr) {
+      state.SkipWithError("Failed to parse maps.");
+      break;
+    }
+    state.ResumeTiming();
+
+    benchmark::DoNotOptimize(offline.Unwind(maps.get()));
+
+    // Freeing the elf data is not part of the unwind.
+    state.PauseTiming();
+    maps.reset();
+    state.ResumeTiming();
+  }
+}
+
+static void BM_offline_unwind_warm(benchmark::State& state, const char* name, ArchEnum arch) {
+  OfflineUnwind offline;
+  std::string error;
+  if (!offline.Init(name, arch, &error)) {
+    state.SkipWithError(error.c_str());
+    return;
+  }
+  std::unique_ptr<Maps> maps(offline.CreateMaps());
+  if (maps == nullptr) {
+    state.SkipWithError("Failed to parse maps.");
+    return;
+  }
+  size_t num_frames = offline.Unwind(maps.get());
+
+  for (auto _ : state) {
+    if (offline.Unwind(maps.get()) != num_frames) {
+      state.SkipWithError("Unwind results changed between unwinds.");
+      break;
+    }
+  }
+  state.counters["frames"] = num_frames;
+}
+
+BENCHMARK_CAPTURE(BM_offline_unwind_cold, straddle_arm, "straddle_arm", ARCH_ARM);
+BENCHMARK_CAPTURE(BM_offline_unwind_warm, straddle_arm, "straddle_arm", ARCH_ARM);
+BENCHMARK_CAPTURE(BM_offline_unwind_cold, offset_arm, "offset_arm", ARCH_ARM);
+BENCHMARK_CAPTURE(BM_offline_unwind_warm, offset_arm, "offset_arm", ARCH_ARM);
+BENCHMARK_CAPTURE(BM_offline_unwind_cold, gnu_debugdata_arm, "gnu_debugdata_arm", ARCH_ARM);
+BENCHMARK_CAPTURE(BM_offline_unwind_warm, gnu_debugdata_arm, "gnu_debugdata_arm", ARCH_ARM);
+BENCHMARK_CAPTURE(BM_offline_unwind_cold, straddle_arm64, "straddle_arm64", ARCH_ARM64);
+BENCHMARK_CAPTURE(BM_offline_unwind_warm, straddle_arm64, "straddle_arm64", ARCH_ARM64);
+BENCHMARK_CAPTURE(BM_offline_unwind_cold, shared_lib_in_apk_arm64, "shared_lib_in_apk_arm64",
+                  ARCH_ARM64);
+BENCHMARK_CAPTURE(BM_offline_unwind_warm, shared_lib_in_apk_arm64, "shared_lib_in_apk_arm64",
+                  ARCH_ARM64);
+BENCHMARK_CAPTURE(BM_offline_unwind_cold, eh_frame_hdr_begin_x86_64, "eh_frame_hdr_begin_x86_64",
+                  ARCH_X86_64);
+BENCHMARK_CAPTURE(BM_offline_unwind_warm, eh_frame_hdr_begin_x86_64, "eh_frame_hdr_begin_x86_64",
+                  ARCH_X86_64);
+
+}  // namespace unwindstack
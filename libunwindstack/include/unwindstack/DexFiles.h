@@ -50,27 +50,32 @@ class DexFiles : public Global {
  private:
   void Init(Maps* maps);
 
-  bool GetAddr(size_t index, uint64_t* addr);
+  bool ReadDescriptor32(uint64_t addr, Descriptor* desc);
 
-  uint64_t ReadEntryPtr32(uint64_t addr);
+  bool ReadDescriptor64(uint64_t addr, Descriptor* desc);
 
-  uint64_t ReadEntryPtr64(uint64_t addr);
+  bool ReadEntry32(uint64_t addr, uint64_t* next, uint64_t* dex_file);
 
-  bool ReadEntry32();
-
-  bool ReadEntry64();
+  bool ReadEntry64(uint64_t addr, uint64_t* next, uint64_t* dex_file);
 
   bool ReadVariableData(uint64_t ptr_offset) override;
 
   void ProcessArch() override;
 
+  bool FindMethodInformation(MapInfo* info, uint64_t dex_pc, std::string* method_name,
+                             uint64_t* method_offset);
+
+  void UpdateEntries();
+
   std::mutex lock_;
   bool initialized_ = false;
   std::unordered_map<uint64_t, std::unique_ptr<DexFile>> files_;
 
-  uint64_t entry_addr_ = 0;
-  uint64_t (DexFiles::*read_entry_ptr_func_)(uint64_t) = nullptr;
-  bool (DexFiles::*read_entry_func_)() = nullptr;
+  uint64_t descriptor_addr_ = 0;
+  Descriptor descriptor_;
+  bool (DexFiles::*read_descriptor_func_)(uint64_t, Descriptor*) = nullptr;
+  bool (DexFiles::*read_entry_func_)(uint64_t, uint64_t*, uint64_t*) = nullptr;
+  // The address of every dex file in the list, sorted.
   std::vector<uint64_t> addrs_;
 };
 
@@ -22,6 +22,7 @@
 #include <iterator>
 #include <map>
 #include <unordered_map>
+#include <vector>
 
 #include <unwindstack/DwarfError.h>
 #include <unwindstack/DwarfLocation.h>
@@ -186,9 +187,21 @@ class DwarfSectionImplNoHdr : public DwarfSectionImpl<AddressType> {
 
   void InsertFde(const DwarfFde* fde);
 
+  void BuildFdeIndex();
+
   uint64_t next_entries_offset_ = 0;
 
   std::map<uint64_t, std::pair<uint64_t, const DwarfFde*>> fdes_;
+
+  // Once every entry has been read, fdes_ is replaced by this array of the
+  // same intervals, sorted by end pc, to binary search.
+  struct FdeInterval {
+    uint64_t pc_end;
+    uint64_t pc_start;
+    const DwarfFde* fde;
+  };
+  std::vector<FdeInterval> fde_index_;
+  bool fde_index_built_ = false;
 };
 
 }  // namespace unwindstack
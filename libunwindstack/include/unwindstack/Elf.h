@@ -24,6 +24,7 @@
 #include <string>
 #include <unordered_map>
 #include <utility>
+#include <vector>
 
 #include <unwindstack/ElfInterface.h>
 #include <unwindstack/Memory.h>
@@ -63,6 +64,12 @@ class Elf {
 
   bool GetFunctionName(uint64_t addr, std::string* name, uint64_t* func_offset);
 
+  // Looks up many addresses at once, for post-processing of profiles. Entry
+  // i of |names| and |func_offsets| is set for addrs[i], the name is left
+  // empty if none is found. Returns the number of addresses found.
+  size_t GetFunctionNames(const std::vector<uint64_t>& addrs, std::vector<std::string>* names,
+                          std::vector<uint64_t>* func_offsets);
+
   bool GetGlobalVariable(const std::string& name, uint64_t* memory_address);
 
   uint64_t GetRelPc(uint64_t pc, const MapInfo* map_info);
@@ -107,6 +114,11 @@ class Elf {
   static void SetCachingEnabled(bool enable);
   static bool CachingEnabled() { return cache_enabled_; }
 
+  // Keeps the decompressed .gnu_debugdata of every elf with a build id in
+  // |directory|, so that later unwinds, in this process or another, map it
+  // instead of decompressing it again. An empty directory disables this.
+  static void SetDiskCacheDirectory(const std::string& directory);
+
   static void CacheLock();
   static void CacheUnlock();
   static void CacheAdd(MapInfo* info);
@@ -127,9 +139,13 @@ class Elf {
   std::unique_ptr<Memory> gnu_debugdata_memory_;
   std::unique_ptr<ElfInterface> gnu_debugdata_interface_;
 
+  Memory* DiskCacheGet(const std::string& path);
+  void DiskCacheAdd(const std::string& path, MemoryXz* memory);
+
   static bool cache_enabled_;
   static std::unordered_map<std::string, std::pair<std::shared_ptr<Elf>, bool>>* cache_;
   static std::mutex* cache_lock_;
+  static std::string* disk_cache_directory_;
 };
 
 }  // namespace unwindstack
@@ -45,6 +45,19 @@ class Global {
   ArchEnum arch() { return arch_; }
 
  protected:
+  // The parts of a jit or dex descriptor that change whenever an entry is
+  // added to or removed from its list.
+  struct Descriptor {
+    uint32_t action_flag = 0;
+    uint64_t relevant_entry = 0;
+    uint64_t first_entry = 0;
+
+    bool operator==(const Descriptor& other) const {
+      return action_flag == other.action_flag && relevant_entry == other.relevant_entry &&
+             first_entry == other.first_entry;
+    }
+  };
+
   uint64_t GetVariableOffset(MapInfo* info, const std::string& variable);
   void FindAndReadVariable(Maps* maps, const char* variable);
 
@@ -19,9 +19,11 @@
 
 #include <stdint.h>
 
+#include <map>
 #include <memory>
 #include <mutex>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 #include <unwindstack/Global.h>
@@ -43,25 +45,50 @@ class JitDebug : public Global {
   Elf* GetElf(Maps* maps, uint64_t pc);
 
  private:
+  struct Entry {
+    uint64_t symfile_addr;
+    uint64_t symfile_size;
+    std::unique_ptr<Elf> elf;
+  };
+
+  struct CodeRange {
+    uint64_t end;
+    Elf* elf;
+  };
+
   void Init(Maps* maps);
 
-  uint64_t (JitDebug::*read_descriptor_func_)(uint64_t) = nullptr;
-  uint64_t (JitDebug::*read_entry_func_)(uint64_t*, uint64_t*) = nullptr;
+  bool (JitDebug::*read_descriptor_func_)(uint64_t, Descriptor*) = nullptr;
+  bool (JitDebug::*read_entry_func_)(uint64_t, uint64_t*, uint64_t*, uint64_t*) = nullptr;
 
-  uint64_t ReadDescriptor32(uint64_t);
-  uint64_t ReadDescriptor64(uint64_t);
+  bool ReadDescriptor32(uint64_t addr, Descriptor* desc);
+  bool ReadDescriptor64(uint64_t addr, Descriptor* desc);
 
-  uint64_t ReadEntry32Pack(uint64_t* start, uint64_t* size);
-  uint64_t ReadEntry32Pad(uint64_t* start, uint64_t* size);
-  uint64_t ReadEntry64(uint64_t* start, uint64_t* size);
+  bool ReadEntry32Pack(uint64_t addr, uint64_t* next, uint64_t* start, uint64_t* size);
+  bool ReadEntry32Pad(uint64_t addr, uint64_t* next, uint64_t* start, uint64_t* size);
+  bool ReadEntry64(uint64_t addr, uint64_t* next, uint64_t* start, uint64_t* size);
 
   bool ReadVariableData(uint64_t ptr_offset) override;
 
   void ProcessArch() override;
 
-  uint64_t entry_addr_ = 0;
+  Elf* FindElf(uint64_t pc);
+  void UpdateEntries();
+  void BuildCodeIndex();
+
+  uint64_t descriptor_addr_ = 0;
+  Descriptor descriptor_;
   bool initialized_ = false;
-  std::vector<Elf*> elf_list_;
+
+  // Keyed by the address of the entry in the process.
+  std::unordered_map<uint64_t, Entry> entries_;
+  // Elf objects of entries that are gone. They are kept for as long as this
+  // object lives since a caller may still be using them.
+  std::vector<std::unique_ptr<Elf>> removed_elfs_;
+  // The pc range of each elf, keyed by the start of the range. Elf objects
+  // whose pc range is unknown or overlaps another are searched one by one.
+  std::map<uint64_t, CodeRange> code_index_;
+  std::vector<Elf*> unindexed_elfs_;
 
   std::mutex lock_;
 };
@@ -21,6 +21,7 @@
 #include <stdint.h>
 #include <sys/types.h>
 
+#include <atomic>
 #include <memory>
 #include <string>
 #include <vector>
@@ -70,15 +71,56 @@ class LocalUnwinder {
 
   MapInfo* GetMapInfo(uint64_t pc);
 
+  // Rereads the maps and refreshes the snapshot of stack and code ranges
+  // used by UnwindFramePointers(). Init() takes the first snapshot, call
+  // this again after libraries are loaded or threads created. This is not
+  // async-signal-safe.
+  bool UpdateFramePointerMaps();
+
+  // Walks the frame pointer chain and stores up to max_frames raw pcs in
+  // pcs, returning the number stored. No lookups are done, so the pcs other
+  // than the first are unadjusted return addresses.
+  //
+  // This is async-signal-safe: it does not allocate or take any locks. Pass
+  // the ucontext of a signal handler to unwind the interrupted code, or
+  // nullptr to unwind the caller. A frame is only followed if its record is
+  // in the stack containing sp and its return address is in executable code,
+  // according to the last UpdateFramePointerMaps(). A sample that races with
+  // UpdateFramePointerMaps() is dropped and 0 is returned.
+  //
+  // Code built without frame pointers ends the unwind early. On arm, where
+  // there is no single frame record layout, only the pc is returned.
+  size_t UnwindFramePointers(void* ucontext, uint64_t* pcs, size_t max_frames);
+
   ErrorCode LastErrorCode() { return last_error_.code; }
   uint64_t LastErrorAddress() { return last_error_.address; }
 
+  static constexpr size_t kMaxFramePointerRanges = 2048;
+
  private:
+  struct Range {
+    uintptr_t start;
+    uintptr_t end;
+  };
+
+  // Written under maps_rwlock_ and read without any lock, which works as a
+  // seqlock: generation is odd while the ranges are being rewritten.
+  struct FramePointerMaps {
+    std::atomic<uint64_t> generation;
+    size_t num_stack_ranges;
+    size_t num_code_ranges;
+    Range stack_ranges[kMaxFramePointerRanges];
+    Range code_ranges[kMaxFramePointerRanges];
+  };
+
+  void UpdateFramePointerMapsLocked();
+
   pthread_rwlock_t maps_rwlock_;
   std::unique_ptr<LocalUpdatableMaps> maps_ = nullptr;
   std::shared_ptr<Memory> process_memory_;
   std::vector<std::string> skip_libraries_;
   ErrorData last_error_;
+  std::unique_ptr<FramePointerMaps> fp_maps_;
 };
 
 }  // namespace unwindstack
@@ -22,8 +22,10 @@
 #include <unistd.h>
 
 #include <atomic>
+#include <list>
 #include <map>
 #include <memory>
+#include <mutex>
 #include <string>
 #include <unordered_map>
 #include <vector>
@@ -46,6 +48,11 @@ class Memory {
 
   bool ReadFully(uint64_t addr, void* dst, size_t size);
 
+  // Reads |count| consecutive blocks of |block_size| bytes starting at |addr|,
+  // block i into dsts[i]. Returns the number of leading blocks that were read
+  // completely. Implementations may do this in fewer calls than one per block.
+  virtual size_t ReadBlocks(uint64_t addr, uint8_t* const* dsts, size_t block_size, size_t count);
+
   inline bool Read32(uint64_t addr, uint32_t* dst) {
     return ReadFully(addr, dst, sizeof(uint32_t));
   }
@@ -62,13 +69,32 @@ class MemoryCache : public Memory {
 
   size_t Read(uint64_t addr, void* dst, size_t size) override;
 
-  void Clear() override { cache_.clear(); }
+  void Clear() override {
+    cache_.clear();
+    pages_.clear();
+  }
 
  private:
   constexpr static size_t kCacheBits = 12;
   constexpr static size_t kCacheMask = (1 << kCacheBits) - 1;
   constexpr static size_t kCacheSize = 1 << kCacheBits;
-  std::unordered_map<uint64_t, uint8_t[kCacheSize]> cache_;
+  // Least recently used pages are dropped beyond this many.
+  constexpr static size_t kMaxCachedPages = 1024;
+  // A miss also fetches up to this many following pages not yet cached, in
+  // the same read. Stack scans and CFA evaluation mostly walk upwards.
+  constexpr static size_t kReadAheadPages = 8;
+
+  struct CachePage {
+    uint64_t page;
+    uint8_t data[kCacheSize];
+  };
+
+  uint8_t* GetPage(uint64_t page);
+  uint8_t* FillPages(uint64_t page);
+
+  // Most recently used first.
+  std::list<CachePage> pages_;
+  std::unordered_map<uint64_t, std::list<CachePage>::iterator> cache_;
 
   std::unique_ptr<Memory> impl_;
 };
@@ -90,6 +116,49 @@ class MemoryBuffer : public Memory {
   std::vector<uint8_t> raw_;
 };
 
+// MemoryXz presents the decompressed contents of an xz stream, such as a
+// .gnu_debugdata section. The stream is decompressed lazily, one xz block at
+// a time, so that a read only costs the blocks it touches. A stream that was
+// compressed as a single block is still decompressed in one go, on the first
+// read.
+class MemoryXz : public Memory {
+ public:
+  MemoryXz(Memory* memory, uint64_t addr, uint64_t size);
+  virtual ~MemoryXz() = default;
+
+  // Reads the compressed data and the block index of the stream. If the
+  // index cannot be used, the whole stream is decompressed right away.
+  bool Init();
+
+  size_t Read(uint64_t addr, void* dst, size_t size) override;
+
+  uint64_t Size() { return size_; }
+
+  size_t BlockCount() { return blocks_.size(); }
+  size_t DecompressedBlockCount();
+
+ private:
+  struct Block {
+    uint64_t compressed_offset;
+    uint64_t compressed_size;
+    uint64_t offset;
+    uint64_t size;
+    std::unique_ptr<uint8_t[]> data;
+  };
+
+  bool ReadIndex();
+  bool DecompressAll();
+  bool Decompress(Block* block);
+
+  Memory* memory_;
+  uint64_t addr_;
+  std::vector<uint8_t> compressed_;
+  uint64_t size_ = 0;
+
+  std::mutex lock_;
+  std::vector<Block> blocks_;
+};
+
 class MemoryFileAtOffset : public Memory {
  public:
   MemoryFileAtOffset() = default;
@@ -116,6 +185,9 @@ class MemoryRemote : public Memory {
 
   size_t Read(uint64_t addr, void* dst, size_t size) override;
 
+  // Reads all blocks with a single vectored process_vm_readv when possible.
+  size_t ReadBlocks(uint64_t addr, uint8_t* const* dsts, size_t block_size, size_t count) override;
+
   pid_t pid() { return pid_; }
 
  private:
@@ -106,11 +106,23 @@ class DexFilesTest : public ::testing::Test {
 };
 
 void DexFilesTest::WriteDescriptor32(uint64_t addr, uint32_t head) {
+  //   uint32_t version
+  memory_->SetData32(addr, 1);
+  //   uint32_t action_flag
+  memory_->SetData32(addr + 4, 0);
+  //   void* relevant_entry_
+  memory_->SetData32(addr + 8, 0);
   //   void* first_entry_
   memory_->SetData32(addr + 12, head);
 }
 
 void DexFilesTest::WriteDescriptor64(uint64_t addr, uint64_t head) {
+  //   uint32_t version
+  memory_->SetData32(addr, 1);
+  //   uint32_t action_flag
+  memory_->SetData32(addr + 4, 0);
+  //   void* relevant_entry_
+  memory_->SetData64(addr + 8, 0);
   //   void* first_entry_
   memory_->SetData64(addr + 16, head);
 }
@@ -233,6 +245,28 @@ TEST_F(DexFilesTest, get_method_information_cached) {
   EXPECT_EQ(0U, method_offset);
 }
 
+TEST_F(DexFilesTest, get_method_information_entry_added) {
+  std::string method_name = "nothing";
+  uint64_t method_offset = 0x124;
+  MapInfo* info = maps_->Get(kMapDexFiles);
+
+  WriteDescriptor32(0xf800, 0x200000);
+  WriteEntry32(0x200000, 0, 0, 0x100000);
+
+  dex_files_->GetMethodInformation(maps_.get(), info, 0x300100, &method_name, &method_offset);
+  EXPECT_EQ("nothing", method_name);
+  EXPECT_EQ(0x124U, method_offset);
+
+  // Add a new entry at the head of the list.
+  WriteEntry32(0x200100, 0x200000, 0, 0x300000);
+  WriteDescriptor32(0xf800, 0x200100);
+  WriteDex(0x300000);
+
+  dex_files_->GetMethodInformation(maps_.get(), info, 0x300100, &method_name, &method_offset);
+  EXPECT_EQ("Main.<init>", method_name);
+  EXPECT_EQ(0U, method_offset);
+}
+
 TEST_F(DexFilesTest, get_method_information_search_libs) {
   std::string method_name = "nothing";
   uint64_t method_offset = 0x124;
@@ -243,6 +243,34 @@ TYPED_TEST_P(DwarfDebugFrameTest, GetFdeFromPc32_reverse) {
   ASSERT_TRUE(fde == nullptr);
 }
 
+TYPED_TEST_P(DwarfDebugFrameTest, GetFdeFromPc32_after_all_read) {
+  SetFourFdes32(&this->memory_);
+  ASSERT_TRUE(this->debug_frame_->Init(0x5000, 0x600, 0));
+
+  // A miss reads every entry, later lookups only use the index.
+  ASSERT_TRUE(this->debug_frame_->GetFdeFromPc(0) == nullptr);
+  this->memory_.Clear();
+
+  const DwarfFde* fde = this->debug_frame_->GetFdeFromPc(0x2600);
+  ASSERT_TRUE(fde != nullptr);
+  EXPECT_EQ(0x2500U, fde->pc_start);
+
+  fde = this->debug_frame_->GetFdeFromPc(0x1500);
+  ASSERT_TRUE(fde != nullptr);
+  EXPECT_EQ(0x1500U, fde->pc_start);
+
+  fde = this->debug_frame_->GetFdeFromPc(0x48ff);
+  ASSERT_TRUE(fde != nullptr);
+  EXPECT_EQ(0x4500U, fde->pc_start);
+
+  EXPECT_TRUE(this->debug_frame_->GetFdeFromPc(0x1700) == nullptr);
+  EXPECT_TRUE(this->debug_frame_->GetFdeFromPc(0x4a00) == nullptr);
+
+  std::vector<const DwarfFde*> fdes;
+  this->debug_frame_->GetFdes(&fdes);
+  ASSERT_EQ(4U, fdes.size());
+}
+
 TYPED_TEST_P(DwarfDebugFrameTest, GetFdeFromPc32_not_in_section) {
   SetFourFdes32(&this->memory_);
   ASSERT_TRUE(this->debug_frame_->Init(0x5000, 0x500, 0));
@@ -798,7 +826,8 @@ TYPED_TEST_P(DwarfDebugFrameTest, GetFdeFromPc_interleaved) {
 
 REGISTER_TYPED_TEST_CASE_P(
     DwarfDebugFrameTest, GetFdes32, GetFdes32_after_GetFdeFromPc, GetFdes32_not_in_section,
-    GetFdeFromPc32, GetFdeFromPc32_reverse, GetFdeFromPc32_not_in_section, GetFdes64,
+    GetFdeFromPc32, GetFdeFromPc32_reverse, GetFdeFromPc32_after_all_read,
+    GetFdeFromPc32_not_in_section, GetFdes64,
     GetFdes64_after_GetFdeFromPc, GetFdes64_not_in_section, GetFdeFromPc64, GetFdeFromPc64_reverse,
     GetFdeFromPc64_not_in_section, GetCieFde32, GetCieFde64, GetCieFromOffset32_cie_cached,
     GetCieFromOffset64_cie_cached, GetCieFromOffset32_version1, GetCieFromOffset64_version1,
@@ -51,6 +51,13 @@ class TestDwarfSectionImpl : public DwarfSectionImpl<TypeParam> {
     this->cie_loc_regs_[offset] = loc_regs;
   }
   void TestClearCachedCieLocRegs() { this->cie_loc_regs_.clear(); }
+  const dwarf_loc_regs_t* TestGetCachedLocRegs(uint64_t pc) {
+    auto it = this->loc_regs_.upper_bound(pc);
+    if (it == this->loc_regs_.end() || pc < it->second.pc_start) {
+      return nullptr;
+    }
+    return &it->second;
+  }
   void TestClearError() { this->last_error_.code = DWARF_ERROR_NONE; }
 };
 
@@ -549,6 +556,106 @@ TYPED_TEST_P(DwarfSectionImplTest, GetCfaLocationInfo_cie_cached) {
   ASSERT_EQ(3U, entry->second.values[0]);
 }
 
+TYPED_TEST_P(DwarfSectionImplTest, GetCfaLocationInfo_caches_all_rows) {
+  DwarfCie cie{};
+  cie.code_alignment_factor = 1;
+  DwarfFde fde{};
+  fde.cie = &cie;
+  fde.cie_offset = 0x8000;
+  fde.pc_start = 0x1000;
+  fde.pc_end = 0x1100;
+  fde.cfa_instructions_offset = 0x6000;
+  fde.cfa_instructions_end = 0x600b;
+
+  this->section_->TestSetCachedCieLocRegs(0x8000, dwarf_loc_regs_t());
+  // DW_CFA_register r2 r1, DW_CFA_advance_loc 0x10, DW_CFA_register r2 r3,
+  // DW_CFA_advance_loc 0x20, DW_CFA_register r2 r5.
+  this->memory_.SetMemory(0x6000, std::vector<uint8_t>{0x09, 0x02, 0x01, 0x50, 0x09, 0x02, 0x03,
+                                                       0x60, 0x09, 0x02, 0x05});
+
+  dwarf_loc_regs_t loc_regs;
+  ASSERT_TRUE(this->section_->GetCfaLocationInfo(0x1018, &fde, &loc_regs));
+  EXPECT_EQ(0x1010U, loc_regs.pc_start);
+  EXPECT_EQ(0x1030U, loc_regs.pc_end);
+  ASSERT_EQ(1U, loc_regs.size());
+  EXPECT_EQ(3U, loc_regs[2].values[0]);
+
+  // Every row of the fde is cached, not just the one for the pc.
+  uint64_t expected[][3] = {{0x1000, 0x1010, 1}, {0x1010, 0x1030, 3}, {0x1030, 0x1100, 5}};
+  for (const auto& row : expected) {
+    const dwarf_loc_regs_t* cached = this->section_->TestGetCachedLocRegs(row[0]);
+    ASSERT_TRUE(cached != nullptr) << "No row for pc 0x" << std::hex << row[0];
+    EXPECT_EQ(row[0], cached->pc_start);
+    EXPECT_EQ(row[1], cached->pc_end);
+    EXPECT_EQ(&cie, cached->cie);
+    ASSERT_EQ(1U, cached->count(2));
+    EXPECT_EQ(row[2], cached->at(2).values[0]);
+  }
+  EXPECT_TRUE(this->section_->TestGetCachedLocRegs(0x1100) == nullptr);
+}
+
+TYPED_TEST_P(DwarfSectionImplTest, GetCfaLocationInfo_caches_rows_after_restore_state) {
+  DwarfCie cie{};
+  cie.code_alignment_factor = 1;
+  DwarfFde fde{};
+  fde.cie = &cie;
+  fde.cie_offset = 0x8000;
+  fde.pc_start = 0x1000;
+  fde.pc_end = 0x1100;
+  fde.cfa_instructions_offset = 0x6000;
+  fde.cfa_instructions_end = 0x600e;
+
+  this->section_->TestSetCachedCieLocRegs(0x8000, dwarf_loc_regs_t());
+  // DW_CFA_register r2 r1, DW_CFA_remember_state, DW_CFA_advance_loc 0x10,
+  // DW_CFA_register r2 r3, DW_CFA_advance_loc 0x10, DW_CFA_restore_state,
+  // DW_CFA_advance_loc 0x10, DW_CFA_register r2 r5.
+  this->memory_.SetMemory(0x6000, std::vector<uint8_t>{0x09, 0x02, 0x01, 0x0a, 0x50, 0x09, 0x02,
+                                                       0x03, 0x50, 0x0b, 0x50, 0x09, 0x02, 0x05});
+
+  dwarf_loc_regs_t loc_regs;
+  ASSERT_TRUE(this->section_->GetCfaLocationInfo(0x1000, &fde, &loc_regs));
+
+  // The row after the restore starts where it was restored, not where the
+  // remembered row started.
+  uint64_t expected[][3] = {
+      {0x1000, 0x1010, 1}, {0x1010, 0x1020, 3}, {0x1020, 0x1030, 1}, {0x1030, 0x1100, 5}};
+  for (const auto& row : expected) {
+    const dwarf_loc_regs_t* cached = this->section_->TestGetCachedLocRegs(row[0]);
+    ASSERT_TRUE(cached != nullptr) << "No row for pc 0x" << std::hex << row[0];
+    EXPECT_EQ(row[0], cached->pc_start);
+    EXPECT_EQ(row[1], cached->pc_end);
+    ASSERT_EQ(1U, cached->count(2));
+    EXPECT_EQ(row[2], cached->at(2).values[0]);
+  }
+}
+
+TYPED_TEST_P(DwarfSectionImplTest, GetCfaLocationInfo_bad_instruction_after_pc) {
+  DwarfCie cie{};
+  cie.code_alignment_factor = 1;
+  DwarfFde fde{};
+  fde.cie = &cie;
+  fde.cie_offset = 0x8000;
+  fde.pc_start = 0x1000;
+  fde.pc_end = 0x1100;
+  fde.cfa_instructions_offset = 0x6000;
+  fde.cfa_instructions_end = 0x6006;
+
+  this->section_->TestSetCachedCieLocRegs(0x8000, dwarf_loc_regs_t());
+  // DW_CFA_register r2 r1, DW_CFA_advance_loc 0x10, an illegal instruction.
+  this->memory_.SetMemory(0x6000, std::vector<uint8_t>{0x09, 0x02, 0x01, 0x50, 0x3f, 0x00});
+
+  dwarf_loc_regs_t loc_regs;
+  ASSERT_TRUE(this->section_->GetCfaLocationInfo(0x1008, &fde, &loc_regs));
+  EXPECT_EQ(0x1000U, loc_regs.pc_start);
+  EXPECT_EQ(0x1010U, loc_regs.pc_end);
+  ASSERT_EQ(1U, loc_regs.size());
+  EXPECT_EQ(1U, loc_regs[2].values[0]);
+  EXPECT_TRUE(this->section_->TestGetCachedLocRegs(0x1008) == nullptr);
+
+  ASSERT_FALSE(this->section_->GetCfaLocationInfo(0x1010, &fde, &loc_regs));
+  EXPECT_EQ(DWARF_ERROR_ILLEGAL_VALUE, this->section_->LastErrorCode());
+}
+
 TYPED_TEST_P(DwarfSectionImplTest, Log) {
   DwarfCie cie{};
   cie.cfa_instructions_offset = 0x5000;
@@ -580,7 +687,10 @@ REGISTER_TYPED_TEST_CASE_P(DwarfSectionImplTest, GetCieFromOffset_fail_should_no
                            Eval_invalid_register, Eval_different_reg_locations,
                            Eval_return_address_undefined, Eval_pc_zero, Eval_return_address,
                            Eval_ignore_large_reg_loc, Eval_reg_expr, Eval_reg_val_expr,
-                           GetCfaLocationInfo_cie_not_cached, GetCfaLocationInfo_cie_cached, Log);
+                           GetCfaLocationInfo_cie_not_cached, GetCfaLocationInfo_cie_cached,
+                           GetCfaLocationInfo_caches_all_rows,
+                           GetCfaLocationInfo_caches_rows_after_restore_state,
+                           GetCfaLocationInfo_bad_instruction_after_pc, Log);
 
 typedef ::testing::Types<uint32_t, uint64_t> DwarfSectionImplTestTypes;
 INSTANTIATE_TYPED_TEST_CASE_P(, DwarfSectionImplTest, DwarfSectionImplTestTypes);
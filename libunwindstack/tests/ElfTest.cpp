@@ -20,6 +20,9 @@
 #include <sys/types.h>
 #include <unistd.h>
 
+#include <string>
+
+#include <android-base/file.h>
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
 
@@ -531,4 +534,67 @@ TEST_F(ElfTest, error_code_valid) {
   EXPECT_EQ(0x1000U, elf.GetLastErrorAddress());
 }
 
+static void InitFromFile(const std::string& file, Elf** elf) {
+  MemoryFileAtOffset* memory = new MemoryFileAtOffset;
+  ASSERT_TRUE(memory->Init(file, 0));
+  *elf = new Elf(memory);
+  ASSERT_TRUE((*elf)->Init());
+  ASSERT_TRUE((*elf)->gnu_debugdata_interface() != nullptr);
+}
+
+TEST_F(ElfTest, get_function_names) {
+  std::string file(TestGetFileDirectory() + "offline/gnu_debugdata_arm/libandroid_runtime.so");
+  Elf* elf;
+  ASSERT_NO_FATAL_FAILURE(InitFromFile(file, &elf));
+  std::unique_ptr<Elf> elf_ptr(elf);
+
+  std::vector<std::string> names;
+  std::vector<uint64_t> func_offsets;
+  // Only in the .symtab of the .gnu_debugdata, then an address in no function.
+  ASSERT_EQ(2U, elf->GetFunctionNames({0x6d5e1, 0, 0x6d5e4}, &names, &func_offsets));
+  ASSERT_EQ(3U, names.size());
+  ASSERT_EQ(3U, func_offsets.size());
+  EXPECT_EQ("_ZN7androidL25runtime_isSensitiveThreadEv", names[0]);
+  EXPECT_EQ(8U, func_offsets[0]);
+  EXPECT_EQ("", names[1]);
+  EXPECT_EQ(0U, func_offsets[1]);
+  EXPECT_EQ("_ZN7androidL25runtime_isSensitiveThreadEv", names[2]);
+  EXPECT_EQ(12U, func_offsets[2]);
+}
+
+TEST_F(ElfTest, gnu_debugdata_disk_cache) {
+  TemporaryDir dir;
+  Elf::SetDiskCacheDirectory(dir.path);
+  std::string file(TestGetFileDirectory() + "offline/gnu_debugdata_arm/libandroid_runtime.so");
+  // Named after GetBuildID(), which leaves off the last byte of the note.
+  std::string cache_file(std::string(dir.path) + "/d75bc4c9ec2b53085c418234f8cd71.gnu_debugdata");
+
+  Elf* elf;
+  ASSERT_NO_FATAL_FAILURE(InitFromFile(file, &elf));
+  std::unique_ptr<Elf> first(elf);
+  struct stat buf;
+  ASSERT_EQ(0, stat(cache_file.c_str(), &buf));
+  off_t size = buf.st_size;
+  ASSERT_LT(static_cast<off_t>(first->interface()->gnu_debugdata_size()), size);
+
+  // Comes from the cache this time.
+  ASSERT_NO_FATAL_FAILURE(InitFromFile(file, &elf));
+  std::unique_ptr<Elf> second(elf);
+  std::string name;
+  uint64_t func_offset;
+  // Only in the .symtab of the .gnu_debugdata.
+  ASSERT_TRUE(second->GetFunctionName(0x6d5e1, &name, &func_offset));
+  EXPECT_EQ("_ZN7androidL25runtime_isSensitiveThreadEv", name);
+  EXPECT_EQ(8U, func_offset);
+
+  // A damaged cache file is replaced.
+  ASSERT_EQ(0, truncate(cache_file.c_str(), size / 2));
+  ASSERT_NO_FATAL_FAILURE(InitFromFile(file, &elf));
+  delete elf;
+  ASSERT_EQ(0, stat(cache_file.c_str(), &buf));
+  EXPECT_EQ(size, buf.st_size);
+
+  Elf::SetDiskCacheDirectory("");
+}
+
 }  // namespace unwindstack
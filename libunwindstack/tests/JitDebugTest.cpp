@@ -382,6 +382,77 @@ TEST_F(JitDebugTest, get_elf_multiple_entries) {
   EXPECT_EQ(nullptr, jit_debug_->GetElf(maps_.get(), 0x2700));
 }
 
+TEST_F(JitDebugTest, get_elf_entry_added) {
+  CreateElf<Elf32_Ehdr, Elf32_Shdr>(0x4000, ELFCLASS32, EM_ARM, 0x1500, 0x200);
+  CreateElf<Elf32_Ehdr, Elf32_Shdr>(0x5000, ELFCLASS32, EM_ARM, 0x2300, 0x400);
+
+  WriteDescriptor32(0xf800, 0x200000);
+  WriteEntry32Pad(0x200000, 0, 0, 0x4000, 0x1000);
+
+  Elf* elf_1 = jit_debug_->GetElf(maps_.get(), 0x1500);
+  ASSERT_TRUE(elf_1 != nullptr);
+  EXPECT_EQ(nullptr, jit_debug_->GetElf(maps_.get(), 0x2400));
+
+  // Add a new entry at the head of the list.
+  WriteEntry32Pad(0x200100, 0, 0x200000, 0x5000, 0x1000);
+  WriteEntry32Pad(0x200000, 0x200100, 0, 0x4000, 0x1000);
+  WriteDescriptor32(0xf800, 0x200100);
+
+  Elf* elf_2 = jit_debug_->GetElf(maps_.get(), 0x2400);
+  ASSERT_TRUE(elf_2 != nullptr);
+  EXPECT_NE(elf_1, elf_2);
+  // The existing entry is not processed again.
+  EXPECT_EQ(elf_1, jit_debug_->GetElf(maps_.get(), 0x1500));
+}
+
+TEST_F(JitDebugTest, get_elf_entry_removed) {
+  CreateElf<Elf32_Ehdr, Elf32_Shdr>(0x4000, ELFCLASS32, EM_ARM, 0x1500, 0x200);
+  CreateElf<Elf32_Ehdr, Elf32_Shdr>(0x5000, ELFCLASS32, EM_ARM, 0x2300, 0x400);
+
+  WriteDescriptor32(0xf800, 0x200000);
+  WriteEntry32Pad(0x200000, 0, 0x200100, 0x4000, 0x1000);
+  WriteEntry32Pad(0x200100, 0x200000, 0, 0x5000, 0x1000);
+
+  ASSERT_TRUE(jit_debug_->GetElf(maps_.get(), 0x1500) != nullptr);
+  Elf* elf_2 = jit_debug_->GetElf(maps_.get(), 0x2400);
+  ASSERT_TRUE(elf_2 != nullptr);
+
+  // Remove the first entry.
+  WriteEntry32Pad(0x200100, 0, 0, 0x5000, 0x1000);
+  WriteDescriptor32(0xf800, 0x200100);
+
+  // Known pcs do not look at the list again, only a miss does.
+  EXPECT_EQ(elf_2, jit_debug_->GetElf(maps_.get(), 0x2400));
+  EXPECT_EQ(nullptr, jit_debug_->GetElf(maps_.get(), 0x3000));
+  EXPECT_EQ(nullptr, jit_debug_->GetElf(maps_.get(), 0x1500));
+  EXPECT_EQ(elf_2, jit_debug_->GetElf(maps_.get(), 0x2400));
+}
+
+TEST_F(JitDebugTest, get_elf_many_entries) {
+  static constexpr size_t kEntries = 64;
+  WriteDescriptor32(0xf800, 0x200000);
+  for (size_t i = 0; i < kEntries; i++) {
+    uint64_t elf_addr = 0x300000 + i * 0x1000;
+    CreateElf<Elf32_Ehdr, Elf32_Shdr>(elf_addr, ELFCLASS32, EM_ARM, 0x10000 + i * 0x1000, 0x800);
+    uint32_t next = (i + 1 == kEntries) ? 0 : 0x200000 + (i + 1) * 0x20;
+    WriteEntry32Pad(0x200000 + i * 0x20, 0, next, elf_addr, 0x1000);
+  }
+
+  std::vector<Elf*> elfs;
+  for (size_t i = 0; i < kEntries; i++) {
+    Elf* elf = jit_debug_->GetElf(maps_.get(), 0x10000 + i * 0x1000 + 0x400);
+    ASSERT_TRUE(elf != nullptr) << "Failed at entry " << i;
+    elfs.push_back(elf);
+  }
+
+  memory_->Clear();
+  for (size_t i = 0; i < kEntries; i++) {
+    EXPECT_EQ(elfs[i], jit_debug_->GetElf(maps_.get(), 0x10000 + i * 0x1000));
+    EXPECT_EQ(elfs[i], jit_debug_->GetElf(maps_.get(), 0x10000 + i * 0x1000 + 0x7ff));
+    EXPECT_EQ(nullptr, jit_debug_->GetElf(maps_.get(), 0x10000 + i * 0x1000 + 0x800));
+  }
+}
+
 TEST_F(JitDebugTest, get_elf_search_libs) {
   CreateElf<Elf32_Ehdr, Elf32_Shdr>(0x4000, ELFCLASS32, EM_ARM, 0x1500, 0x200);
 
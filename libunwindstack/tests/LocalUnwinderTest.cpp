@@ -18,6 +18,7 @@
 #include <inttypes.h>
 #include <signal.h>
 #include <stdint.h>
+#include <sys/time.h>
 
 #include <memory>
 #include <string>
@@ -27,7 +28,11 @@
 
 #include <android-base/stringprintf.h>
 
+#include <unwindstack/Elf.h>
 #include <unwindstack/LocalUnwinder.h>
+#include <unwindstack/MapInfo.h>
+#include <unwindstack/Memory.h>
+#include <unwindstack/Regs.h>
 
 namespace unwindstack {
 
@@ -204,4 +209,130 @@ TEST_F(LocalUnwinderTest, unwind_after_dlopen) {
   ASSERT_TRUE(expected_function_names.empty()) << ErrorMsg(expected_function_names, frame_info);
 }
 
+static constexpr size_t kMaxFramePointerFrames = 64;
+static uint64_t g_fp_pcs[kMaxFramePointerFrames];
+static size_t g_fp_num_pcs;
+static volatile sig_atomic_t g_fp_spinning;
+static volatile sig_atomic_t g_fp_sampled;
+
+// The frame pointer unwinder only returns pcs, look up the names afterwards.
+static void VerifyFramePointerPcs(LocalUnwinder* unwinder, const uint64_t* pcs, size_t num_pcs,
+                                  std::vector<const char*> expected_function_names) {
+  std::shared_ptr<Memory> process_memory(Memory::CreateProcessMemory(getpid()));
+  std::vector<LocalFrameData> frame_info;
+  for (size_t i = 0; i < num_pcs; i++) {
+    MapInfo* map_info = unwinder->GetMapInfo(pcs[i]);
+    ASSERT_TRUE(map_info != nullptr) << "No map for pc 0x" << std::hex << pcs[i];
+    Elf* elf = map_info->GetElf(process_memory, Regs::CurrentArch());
+    uint64_t rel_pc = elf->GetRelPc(pcs[i], map_info);
+    std::string func_name;
+    uint64_t func_offset = 0;
+    elf->GetFunctionName(rel_pc, &func_name, &func_offset);
+    frame_info.emplace_back(map_info, pcs[i], rel_pc, func_name, func_offset);
+  }
+
+  for (auto& frame : frame_info) {
+    if (frame.function_name == expected_function_names.back()) {
+      expected_function_names.pop_back();
+      if (expected_function_names.empty()) {
+        break;
+      }
+    }
+  }
+
+  ASSERT_TRUE(expected_function_names.empty()) << ErrorMsg(expected_function_names, frame_info);
+}
+
+extern "C" void FramePointerInnerFunction(LocalUnwinder* unwinder) {
+  uint64_t pcs[kMaxFramePointerFrames];
+  size_t num_pcs = unwinder->UnwindFramePointers(nullptr, pcs, kMaxFramePointerFrames);
+  ASSERT_NE(0U, num_pcs);
+#if !defined(__arm__)
+  VerifyFramePointerPcs(unwinder, pcs, num_pcs,
+                        {"FramePointerOuterFunction", "FramePointerMiddleFunction",
+                         "FramePointerInnerFunction"});
+#endif
+}
+
+extern "C" void FramePointerMiddleFunction(LocalUnwinder* unwinder) {
+  FramePointerInnerFunction(unwinder);
+}
+
+extern "C" void FramePointerOuterFunction(LocalUnwinder* unwinder) {
+  FramePointerMiddleFunction(unwinder);
+}
+
+TEST_F(LocalUnwinderTest, frame_pointers) {
+  FramePointerOuterFunction(unwinder_.get());
+}
+
+TEST_F(LocalUnwinderTest, frame_pointers_max_frames) {
+  uint64_t pcs[2];
+  ASSERT_EQ(0U, unwinder_->UnwindFramePointers(nullptr, pcs, 0));
+#if !defined(__arm__)
+  ASSERT_EQ(2U, unwinder_->UnwindFramePointers(nullptr, pcs, 2));
+#endif
+}
+
+TEST_F(LocalUnwinderTest, frame_pointers_without_init) {
+  LocalUnwinder unwinder;
+  uint64_t pcs[kMaxFramePointerFrames];
+  ASSERT_EQ(0U, unwinder.UnwindFramePointers(nullptr, pcs, kMaxFramePointerFrames));
+}
+
+static void FramePointerProfHandler(int, siginfo_t*, void* ucontext) {
+  // Only take a sample once the spin loop is running.
+  if (g_fp_spinning && !g_fp_sampled) {
+    g_fp_num_pcs = g_unwinder->UnwindFramePointers(ucontext, g_fp_pcs, kMaxFramePointerFrames);
+    g_fp_sampled = 1;
+  }
+}
+
+// Spin until a profiling signal interrupts this function.
+extern "C" void FramePointerSpinInnerFunction() {
+  g_fp_spinning = 1;
+  while (!g_fp_sampled) {
+  }
+}
+
+extern "C" void FramePointerSpinMiddleFunction() {
+  FramePointerSpinInnerFunction();
+}
+
+extern "C" void FramePointerSpinOuterFunction() {
+  FramePointerSpinMiddleFunction();
+}
+
+TEST_F(LocalUnwinderTest, frame_pointers_signal) {
+  g_unwinder = unwinder_.get();
+  g_fp_num_pcs = 0;
+  g_fp_spinning = 0;
+  g_fp_sampled = 0;
+
+  struct sigaction act, oldact;
+  memset(&act, 0, sizeof(act));
+  act.sa_sigaction = FramePointerProfHandler;
+  act.sa_flags = SA_RESTART | SA_SIGINFO;
+  ASSERT_EQ(0, sigaction(SIGPROF, &act, &oldact));
+
+  struct itimerval timer = {};
+  timer.it_interval.tv_usec = 1000;
+  timer.it_value.tv_usec = 1000;
+  ASSERT_EQ(0, setitimer(ITIMER_PROF, &timer, nullptr));
+
+  FramePointerSpinOuterFunction();
+  g_fp_spinning = 0;
+
+  timer = {};
+  ASSERT_EQ(0, setitimer(ITIMER_PROF, &timer, nullptr));
+  ASSERT_EQ(0, sigaction(SIGPROF, &oldact, nullptr));
+
+  ASSERT_NE(0U, g_fp_num_pcs);
+#if !defined(__arm__)
+  VerifyFramePointerPcs(unwinder_.get(), g_fp_pcs, g_fp_num_pcs,
+                        {"FramePointerSpinOuterFunction", "FramePointerSpinMiddleFunction",
+                         "FramePointerSpinInnerFunction"});
+#endif
+}
+
 }  // namespace unwindstack
@@ -0,0 +1,168 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdint.h>
+#include <sys/mman.h>
+
+#include <string>
+#include <vector>
+
+#include <android-base/file.h>
+#include <android-base/test_utils.h>
+#include <gtest/gtest.h>
+
+#include <unwindstack/MapInfo.h>
+#include <unwindstack/Maps.h>
+
+namespace unwindstack {
+
+class TestUpdatableMaps : public LocalUpdatableMaps {
+ public:
+  TestUpdatableMaps() : LocalUpdatableMaps() {}
+  virtual ~TestUpdatableMaps() = default;
+
+  const std::string GetMapsFile() const override { return maps_file_; }
+
+  void TestSetMapsFile(const std::string& maps_file) { maps_file_ = maps_file; }
+
+ private:
+  std::string maps_file_;
+};
+
+class LocalUpdatableMapsTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    maps_.TestSetMapsFile(tf_.path);
+    ASSERT_TRUE(
+        android::base::WriteStringToFile("3000-4000 r-xp 00000 00:00 0\n"
+                                          "8000-9000 r-xp 00000 00:00 0\n",
+                                          tf_.path));
+    ASSERT_TRUE(maps_.Parse());
+    ASSERT_EQ(2U, maps_.Total());
+  }
+
+  static void VerifyPrevMaps(Maps* maps) {
+    MapInfo* prev_map = nullptr;
+    for (MapInfo* info : *maps) {
+      ASSERT_EQ(prev_map, info->prev_map);
+      prev_map = info;
+    }
+  }
+
+  TemporaryFile tf_;
+  TestUpdatableMaps maps_;
+};
+
+TEST_F(LocalUpdatableMapsTest, same_map) {
+  MapInfo* map0 = maps_.Get(0);
+  MapInfo* map1 = maps_.Get(1);
+
+  ASSERT_TRUE(maps_.Reparse());
+  ASSERT_EQ(2U, maps_.Total());
+  EXPECT_EQ(map0, maps_.Get(0));
+  EXPECT_EQ(map1, maps_.Get(1));
+  VerifyPrevMaps(&maps_);
+}
+
+TEST_F(LocalUpdatableMapsTest, add_map) {
+  MapInfo* map0 = maps_.Get(0);
+  MapInfo* map1 = maps_.Get(1);
+
+  ASSERT_TRUE(
+      android::base::WriteStringToFile("1000-2000 r--p 00000 00:00 0 /fake/lib.so\n"
+                                       "3000-4000 r-xp 00000 00:00 0\n"
+                                       "5000-6000 r--p 00000 00:00 0 /fake/lib2.so\n"
+                                       "8000-9000 r-xp 00000 00:00 0\n"
+                                       "a000-f000 rw-p 00000 00:00 0\n",
+                                       tf_.path));
+  ASSERT_TRUE(maps_.Reparse());
+  ASSERT_EQ(5U, maps_.Total());
+
+  MapInfo* info = maps_.Get(0);
+  EXPECT_EQ(0x1000U, info->start);
+  EXPECT_EQ("/fake/lib.so", info->name);
+  EXPECT_EQ(map0, maps_.Get(1));
+  info = maps_.Get(2);
+  EXPECT_EQ(0x5000U, info->start);
+  EXPECT_EQ("/fake/lib2.so", info->name);
+  EXPECT_EQ(map1, maps_.Get(3));
+  info = maps_.Get(4);
+  EXPECT_EQ(0xa000U, info->start);
+  EXPECT_EQ(0xf000U, info->end);
+  EXPECT_EQ(static_cast<uint64_t>(PROT_READ | PROT_WRITE), info->flags);
+  VerifyPrevMaps(&maps_);
+}
+
+TEST_F(LocalUpdatableMapsTest, delete_map) {
+  MapInfo* map1 = maps_.Get(1);
+
+  ASSERT_TRUE(android::base::WriteStringToFile("8000-9000 r-xp 00000 00:00 0\n", tf_.path));
+  ASSERT_TRUE(maps_.Reparse());
+  ASSERT_EQ(1U, maps_.Total());
+  EXPECT_EQ(map1, maps_.Get(0));
+  VerifyPrevMaps(&maps_);
+}
+
+TEST_F(LocalUpdatableMapsTest, changed_map) {
+  MapInfo* map0 = maps_.Get(0);
+  MapInfo* map1 = maps_.Get(1);
+
+  // Same start, but a different protection, end, and offset.
+  ASSERT_TRUE(
+      android::base::WriteStringToFile("3000-4000 r--p 00000 00:00 0\n"
+                                       "8000-a000 r-xp 00000 00:00 0\n",
+                                       tf_.path));
+  ASSERT_TRUE(maps_.Reparse());
+  ASSERT_EQ(2U, maps_.Total());
+  MapInfo* info = maps_.Get(0);
+  EXPECT_NE(map0, info);
+  EXPECT_EQ(0x3000U, info->start);
+  EXPECT_EQ(static_cast<uint64_t>(PROT_READ), info->flags);
+  info = maps_.Get(1);
+  EXPECT_NE(map1, info);
+  EXPECT_EQ(0x8000U, info->start);
+  EXPECT_EQ(0xa000U, info->end);
+  VerifyPrevMaps(&maps_);
+
+  map0 = maps_.Get(0);
+  ASSERT_TRUE(
+      android::base::WriteStringToFile("3000-4000 r--p 00000 00:00 0\n"
+                                       "8000-a000 r-xp 01000 00:00 0\n",
+                                       tf_.path));
+  ASSERT_TRUE(maps_.Reparse());
+  ASSERT_EQ(2U, maps_.Total());
+  EXPECT_EQ(map0, maps_.Get(0));
+  EXPECT_EQ(0x1000U, maps_.Get(1)->offset);
+  VerifyPrevMaps(&maps_);
+}
+
+TEST_F(LocalUpdatableMapsTest, reparse_fails) {
+  MapInfo* map0 = maps_.Get(0);
+  MapInfo* map1 = maps_.Get(1);
+
+  ASSERT_TRUE(
+      android::base::WriteStringToFile("1000-2000 r--p 00000 00:00 0\n"
+                                       "3000-4000 r-xp 00000 00:00 0\n"
+                                       "not a map line\n",
+                                       tf_.path));
+  ASSERT_FALSE(maps_.Reparse());
+  ASSERT_EQ(2U, maps_.Total());
+  EXPECT_EQ(map0, maps_.Get(0));
+  EXPECT_EQ(map1, maps_.Get(1));
+  VerifyPrevMaps(&maps_);
+}
+
+}  // namespace unwindstack
@@ -15,6 +15,7 @@
  */
 
 #include <stdint.h>
+#include <string.h>
 
 #include <vector>
 
@@ -140,4 +141,72 @@ TEST_F(MemoryCacheTest, read_for_cache_fail_cross) {
   ASSERT_EQ(expect, buffer);
 }
 
+TEST_F(MemoryCacheTest, read_ahead) {
+  std::vector<uint8_t> buffer(kMaxCachedSize);
+  ASSERT_TRUE(memory_cache_->ReadFully(0x8010, buffer.data(), kMaxCachedSize));
+  ASSERT_EQ(std::vector<uint8_t>(kMaxCachedSize, 0xab), buffer);
+
+  // The following page was fetched along with the first one.
+  memory_->SetMemoryBlock(0x9000, 4096, 0xff);
+  ASSERT_TRUE(memory_cache_->ReadFully(0x9010, buffer.data(), kMaxCachedSize));
+  ASSERT_EQ(std::vector<uint8_t>(kMaxCachedSize, 0xde), buffer);
+
+  // The partial page after that could not be fetched, so is not cached.
+  memory_->SetMemoryBlock(0xa000, 3000, 0xff);
+  ASSERT_TRUE(memory_cache_->ReadFully(0xa010, buffer.data(), kMaxCachedSize));
+  ASSERT_EQ(std::vector<uint8_t>(kMaxCachedSize, 0xff), buffer);
+}
+
+TEST_F(MemoryCacheTest, read_ahead_stops_at_cached) {
+  std::vector<uint8_t> buffer(kMaxCachedSize);
+  ASSERT_TRUE(memory_cache_->ReadFully(0x9010, buffer.data(), kMaxCachedSize));
+  ASSERT_EQ(std::vector<uint8_t>(kMaxCachedSize, 0xde), buffer);
+
+  // Fetching the page before does not replace the already cached one.
+  memory_->SetMemoryBlock(0x9000, 4096, 0xff);
+  ASSERT_TRUE(memory_cache_->ReadFully(0x8010, buffer.data(), kMaxCachedSize));
+  ASSERT_EQ(std::vector<uint8_t>(kMaxCachedSize, 0xab), buffer);
+  ASSERT_TRUE(memory_cache_->ReadFully(0x9010, buffer.data(), kMaxCachedSize));
+  ASSERT_EQ(std::vector<uint8_t>(kMaxCachedSize, 0xde), buffer);
+}
+
+// Every other page is readable and holds its own value.
+class MemoryAlternatePages : public Memory {
+ public:
+  size_t Read(uint64_t addr, void* dst, size_t size) override {
+    if (((addr >> 12) & 1) != 0 || ((addr + size - 1) >> 12) != (addr >> 12)) {
+      return 0;
+    }
+    memset(dst, value_, size);
+    return size;
+  }
+
+  void set_value(uint8_t value) { value_ = value; }
+
+ private:
+  uint8_t value_ = 0x11;
+};
+
+TEST(MemoryCacheLruTest, least_recently_used_evicted) {
+  constexpr size_t kMaxCachedPages = 1024;
+  MemoryAlternatePages* memory = new MemoryAlternatePages;
+  MemoryCache memory_cache(memory);
+
+  uint8_t value;
+  for (size_t i = 0; i < kMaxCachedPages; i++) {
+    ASSERT_TRUE(memory_cache.ReadFully(i * 0x2000, &value, 1));
+  }
+  // Touch the first page again, which leaves the second the oldest.
+  ASSERT_TRUE(memory_cache.ReadFully(0, &value, 1));
+  ASSERT_TRUE(memory_cache.ReadFully(kMaxCachedPages * 0x2000, &value, 1));
+
+  memory->set_value(0x22);
+  ASSERT_TRUE(memory_cache.ReadFully(0, &value, 1));
+  ASSERT_EQ(0x11, value);
+  ASSERT_TRUE(memory_cache.ReadFully(0x4000, &value, 1));
+  ASSERT_EQ(0x11, value);
+  ASSERT_TRUE(memory_cache.ReadFully(0x2000, &value, 1));
+  ASSERT_EQ(0x22, value);
+}
+
 }  // namespace unwindstack
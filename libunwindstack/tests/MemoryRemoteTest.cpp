@@ -299,6 +299,50 @@ TEST_F(MemoryRemoteTest, read_munmap_hole) {
   }
 }
 
+TEST_F(MemoryRemoteTest, read_blocks) {
+  size_t page_size = getpagesize();
+  void* mapping =
+      mmap(nullptr, 4 * getpagesize(), PROT_READ | PROT_WRITE, MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
+  ASSERT_NE(MAP_FAILED, mapping);
+  for (size_t i = 0; i < 4; i++) {
+    memset(static_cast<char*>(mapping) + i * page_size, 0x10 + i, page_size);
+  }
+  ASSERT_EQ(0, munmap(static_cast<char*>(mapping) + 2 * page_size, page_size));
+
+  pid_t pid;
+  if ((pid = fork()) == 0) {
+    while (true)
+      ;
+    exit(1);
+  }
+  ASSERT_LT(0, pid);
+  TestScopedPidReaper reap(pid);
+
+  ASSERT_EQ(0, munmap(mapping, 2 * page_size));
+  ASSERT_EQ(0, munmap(static_cast<char*>(mapping) + 3 * page_size, page_size));
+
+  ASSERT_TRUE(Attach(pid));
+
+  MemoryRemote remote(pid);
+  uint64_t addr = reinterpret_cast<uint64_t>(mapping);
+  std::vector<std::vector<uint8_t>> blocks(4, std::vector<uint8_t>(page_size, 0xCC));
+  uint8_t* dsts[4];
+  for (size_t i = 0; i < 4; i++) {
+    dsts[i] = blocks[i].data();
+  }
+  // The transfer stops at the unmapped page.
+  ASSERT_EQ(2U, remote.ReadBlocks(addr, dsts, page_size, 4));
+  ASSERT_EQ(std::vector<uint8_t>(page_size, 0x10), blocks[0]);
+  ASSERT_EQ(std::vector<uint8_t>(page_size, 0x11), blocks[1]);
+  ASSERT_EQ(std::vector<uint8_t>(page_size, 0xCC), blocks[2]);
+
+  ASSERT_EQ(1U, remote.ReadBlocks(addr + 3 * page_size, dsts, page_size, 1));
+  ASSERT_EQ(std::vector<uint8_t>(page_size, 0x13), blocks[0]);
+  ASSERT_EQ(0U, remote.ReadBlocks(addr + 2 * page_size, dsts, page_size, 2));
+
+  ASSERT_TRUE(Detach(pid));
+}
+
 // Verify that the memory remote object chooses a memory read function
 // properly. Either process_vm_readv or ptrace.
 TEST_F(MemoryRemoteTest, read_choose_correctly) {
@@ -0,0 +1,146 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include <android-base/file.h>
+#include <gtest/gtest.h>
+
+#include <unwindstack/Memory.h>
+
+#include "ElfTestUtils.h"
+#include "MemoryFake.h"
+
+namespace unwindstack {
+
+// Both files hold the same 64KiB of data, compressed once with 4KiB blocks
+// and once as a single block.
+class MemoryXzTest : public ::testing::Test {
+ protected:
+  static constexpr uint64_t kCompressedAddr = 0x1000;
+  static constexpr size_t kDataSize = 65536;
+
+  static uint8_t ExpectedByte(uint64_t offset) { return offset * 13 + (offset >> 9); }
+
+  void SetCompressed(const std::string& name) {
+    ASSERT_TRUE(android::base::ReadFileToString(TestGetFileDirectory() + name, &compressed_));
+    memory_.SetMemory(kCompressedAddr, compressed_.data(), compressed_.size());
+  }
+
+  void VerifyRead(MemoryXz* xz, uint64_t addr, size_t size) {
+    std::vector<uint8_t> buffer(size);
+    ASSERT_TRUE(xz->ReadFully(addr, buffer.data(), size));
+    for (size_t i = 0; i < size; i++) {
+      ASSERT_EQ(ExpectedByte(addr + i), buffer[i]) << "Failed at offset " << addr + i;
+    }
+  }
+
+  std::string compressed_;
+  MemoryFake memory_;
+};
+
+TEST_F(MemoryXzTest, multi_block_lazy) {
+  SetCompressed("xz_multi_block.xz");
+  MemoryXz xz(&memory_, kCompressedAddr, compressed_.size());
+  ASSERT_TRUE(xz.Init());
+  ASSERT_EQ(kDataSize, xz.Size());
+  ASSERT_EQ(16U, xz.BlockCount());
+  ASSERT_EQ(0U, xz.DecompressedBlockCount());
+
+  VerifyRead(&xz, 0x2100, 0x100);
+  EXPECT_EQ(1U, xz.DecompressedBlockCount());
+
+  // Reading inside the same block does not decompress anything else.
+  VerifyRead(&xz, 0x2f00, 0x100);
+  EXPECT_EQ(1U, xz.DecompressedBlockCount());
+
+  // A read across a block boundary decompresses both sides.
+  VerifyRead(&xz, 0x8ff0, 0x20);
+  EXPECT_EQ(3U, xz.DecompressedBlockCount());
+
+  VerifyRead(&xz, 0, kDataSize);
+  EXPECT_EQ(16U, xz.DecompressedBlockCount());
+}
+
+TEST_F(MemoryXzTest, single_block) {
+  SetCompressed("xz_single_block.xz");
+  MemoryXz xz(&memory_, kCompressedAddr, compressed_.size());
+  ASSERT_TRUE(xz.Init());
+  ASSERT_EQ(kDataSize, xz.Size());
+  ASSERT_EQ(1U, xz.BlockCount());
+  ASSERT_EQ(0U, xz.DecompressedBlockCount());
+
+  VerifyRead(&xz, 0x4000, 0x10);
+  EXPECT_EQ(1U, xz.DecompressedBlockCount());
+  VerifyRead(&xz, 0, kDataSize);
+}
+
+TEST_F(MemoryXzTest, read_past_end) {
+  SetCompressed("xz_multi_block.xz");
+  MemoryXz xz(&memory_, kCompressedAddr, compressed_.size());
+  ASSERT_TRUE(xz.Init());
+
+  std::vector<uint8_t> buffer(0x100);
+  ASSERT_EQ(0x10U, xz.Read(kDataSize - 0x10, buffer.data(), buffer.size()));
+  for (size_t i = 0; i < 0x10; i++) {
+    ASSERT_EQ(ExpectedByte(kDataSize - 0x10 + i), buffer[i]);
+  }
+  ASSERT_EQ(0U, xz.Read(kDataSize, buffer.data(), buffer.size()));
+  ASSERT_EQ(0U, xz.Read(UINT64_MAX, buffer.data(), buffer.size()));
+  EXPECT_EQ(1U, xz.DecompressedBlockCount());
+}
+
+TEST_F(MemoryXzTest, corrupt_block) {
+  SetCompressed("xz_multi_block.xz");
+  // Damage the compressed data of the second block only.
+  compressed_[316 + 100] ^= 0xff;
+  memory_.SetMemory(kCompressedAddr, compressed_.data(), compressed_.size());
+  MemoryXz xz(&memory_, kCompressedAddr, compressed_.size());
+  ASSERT_TRUE(xz.Init());
+
+  VerifyRead(&xz, 0, 0x1000);
+  std::vector<uint8_t> buffer(0x100);
+  ASSERT_EQ(0x10U, xz.Read(0xff0, buffer.data(), buffer.size()));
+  ASSERT_EQ(0U, xz.Read(0x1000, buffer.data(), buffer.size()));
+  VerifyRead(&xz, 0x2000, 0x1000);
+}
+
+TEST_F(MemoryXzTest, corrupt_index) {
+  SetCompressed("xz_multi_block.xz");
+  // Damage the index, which also makes the full decompression fail.
+  compressed_[compressed_.size() - 20] ^= 0xff;
+  memory_.SetMemory(kCompressedAddr, compressed_.data(), compressed_.size());
+  MemoryXz xz(&memory_, kCompressedAddr, compressed_.size());
+  ASSERT_FALSE(xz.Init());
+}
+
+TEST_F(MemoryXzTest, not_xz) {
+  std::vector<uint8_t> data(0x200, 0x5a);
+  memory_.SetMemory(kCompressedAddr, data.data(), data.size());
+  MemoryXz xz(&memory_, kCompressedAddr, data.size());
+  ASSERT_FALSE(xz.Init());
+}
+
+TEST_F(MemoryXzTest, read_compressed_fails) {
+  SetCompressed("xz_multi_block.xz");
+  MemoryXz xz(&memory_, kCompressedAddr, compressed_.size() + 1);
+  ASSERT_FALSE(xz.Init());
+}
+
+}  // namespace unwindstack
@@ -302,6 +302,37 @@ TYPED_TEST_P(SymbolsTest, symtab_read_cached) {
   ASSERT_EQ(3U, func_offset);
 }
 
+// Verify a large table in descending address order is found in full.
+TYPED_TEST_P(SymbolsTest, many_entries) {
+  constexpr size_t kNumEntries = 5000;
+  Symbols symbols(0x10000, kNumEntries * sizeof(TypeParam), sizeof(TypeParam), 0x1000, 0x100);
+
+  TypeParam sym;
+  for (size_t i = 0; i < kNumEntries; i++) {
+    this->InitSym(&sym, 0x100000 + (kNumEntries - i) * 0x20, 0x10, (i % 2) * 0x10);
+    this->memory_.SetMemory(0x10000 + i * sizeof(sym), &sym, sizeof(sym));
+  }
+  this->memory_.SetMemory(0x1000, "even_function");
+  this->memory_.SetMemory(0x1010, "odd_function");
+
+  std::string name;
+  uint64_t func_offset;
+  ASSERT_TRUE(symbols.GetName<TypeParam>(0x100000 + kNumEntries * 0x20 + 4, &this->memory_, &name,
+                                         &func_offset));
+  ASSERT_EQ("even_function", name);
+  ASSERT_EQ(4U, func_offset);
+  for (size_t i = 0; i < kNumEntries; i++) {
+    uint64_t addr = 0x100000 + (kNumEntries - i) * 0x20;
+    ASSERT_TRUE(symbols.GetName<TypeParam>(addr + 0xf, &this->memory_, &name, &func_offset))
+        << "Failed at entry " << i;
+    ASSERT_EQ((i % 2) ? "odd_function" : "even_function", name);
+    ASSERT_EQ(0xfU, func_offset);
+    // Nothing in the gaps between functions.
+    ASSERT_FALSE(symbols.GetName<TypeParam>(addr + 0x10, &this->memory_, &name, &func_offset));
+  }
+  ASSERT_FALSE(symbols.GetName<TypeParam>(0x100000, &this->memory_, &name, &func_offset));
+}
+
 TYPED_TEST_P(SymbolsTest, get_global) {
   uint64_t start_offset = 0x1000;
   uint64_t str_offset = 0xa000;
@@ -364,7 +395,7 @@ TYPED_TEST_P(SymbolsTest, get_global) {
 
 REGISTER_TYPED_TEST_CASE_P(SymbolsTest, function_bounds_check, no_symbol, multiple_entries,
                            multiple_entries_nonstandard_size, symtab_value_out_of_bounds,
-                           symtab_read_cached, get_global);
+                           symtab_read_cached, many_entries, get_global);
 
 typedef ::testing::Types<Elf32_Sym, Elf64_Sym> SymbolsTestTypes;
 INSTANTIATE_TYPED_TEST_CASE_P(, SymbolsTest, SymbolsTestTypes);
@@ -32,6 +32,7 @@ extern "C" {
 
 struct usb_host_context;
 struct usb_endpoint_descriptor;
+struct usb_bulk_stream;
 
 struct usb_descriptor_iter {
     unsigned char*  config;
@@ -266,6 +267,28 @@ struct usb_request *usb_request_wait(struct usb_device *dev, int timeoutMillis);
 /* Cancels a pending usb_request_queue() operation. */
 int usb_request_cancel(struct usb_request *req);
 
+/* Creates a stream for large transfers on a bulk endpoint, which keeps up to
+ * num_urbs requests of urb_size bytes each in flight so that the bus never
+ * idles between them, unlike usb_device_bulk_transfer().
+ * Returns NULL with errno set on error.
+ */
+struct usb_bulk_stream *usb_bulk_stream_new(struct usb_device *device, int endpoint,
+        int num_urbs, unsigned int urb_size);
+
+/* Releases all resources associated with the stream */
+void usb_bulk_stream_free(struct usb_bulk_stream *stream);
+
+/* Reads or writes length bytes through the stream, straight from or into buffer.
+ * A read stops early at a short packet, like usb_device_bulk_transfer().
+ * timeoutMillis is how long to wait for each request to complete; -1 waits forever.
+ * Returns number of bytes transferred, or negative value for error.
+ *
+ * Requests are reaped like in usb_request_wait(), so no other requests may be
+ * queued on the device while a transfer is running.
+ */
+int usb_bulk_stream_transfer(struct usb_bulk_stream *stream, void *buffer, unsigned int length,
+        int timeoutMillis);
+
 #ifdef __cplusplus
 }
 #endif
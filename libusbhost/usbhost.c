@@ -39,6 +39,7 @@
 #include <string.h>
 #include <stddef.h>
 
+#include <sys/epoll.h>
 #include <sys/ioctl.h>
 #include <sys/types.h>
 #include <sys/time.h>
@@ -86,6 +87,16 @@ struct usb_device {
     int writeable;
 };
 
+struct usb_bulk_stream {
+    struct usb_device *dev;
+    int endpoint;
+    int epoll_fd;
+    unsigned int urb_size;
+    int num_urbs;
+    int in_flight;
+    struct usbdevfs_urb urbs[];
+};
+
 static inline int badname(const char *name)
 {
     while(*name) {
@@ -778,3 +789,166 @@ int usb_request_cancel(struct usb_request *req)
     struct usbdevfs_urb *urb = ((struct usbdevfs_urb*)req->private_data);
     return ioctl(req->dev->fd, USBDEVFS_DISCARDURB, urb);
 }
+
+struct usb_bulk_stream *usb_bulk_stream_new(struct usb_device *device, int endpoint,
+        int num_urbs, unsigned int urb_size)
+{
+    if (num_urbs <= 0 || urb_size == 0) {
+        errno = EINVAL;
+        return NULL;
+    }
+    // submitting requests requires read/write permission
+    if (!usb_device_reopen_writeable(device))
+        return NULL;
+
+    struct usb_bulk_stream *stream =
+            calloc(1, sizeof(*stream) + num_urbs * sizeof(struct usbdevfs_urb));
+    if (!stream)
+        return NULL;
+
+    // usbfs reports completed requests as POLLOUT.
+    stream->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    struct epoll_event event = {.events = EPOLLOUT, .data = {.ptr = NULL}};
+    if (stream->epoll_fd < 0 ||
+            epoll_ctl(stream->epoll_fd, EPOLL_CTL_ADD, device->fd, &event) < 0) {
+        int saved_errno = errno;
+        if (stream->epoll_fd >= 0)
+            close(stream->epoll_fd);
+        free(stream);
+        errno = saved_errno;
+        return NULL;
+    }
+
+    stream->dev = device;
+    stream->endpoint = endpoint;
+    stream->urb_size = urb_size;
+    stream->num_urbs = num_urbs;
+    return stream;
+}
+
+void usb_bulk_stream_free(struct usb_bulk_stream *stream)
+{
+    close(stream->epoll_fd);
+    free(stream);
+}
+
+static void usb_bulk_stream_discard(struct usb_bulk_stream *stream)
+{
+    for (int i = 0; i < stream->num_urbs; i++) {
+        if (stream->urbs[i].usercontext)
+            ioctl(stream->dev->fd, USBDEVFS_DISCARDURB, &stream->urbs[i]);
+    }
+}
+
+/* Reaps one of the stream's requests, waiting for up to timeoutMillis. */
+static struct usbdevfs_urb *usb_bulk_stream_reap(struct usb_bulk_stream *stream,
+        int timeoutMillis)
+{
+    struct usbdevfs_urb *urb = NULL;
+    while (TEMP_FAILURE_RETRY(ioctl(stream->dev->fd, USBDEVFS_REAPURBNDELAY, &urb)) < 0) {
+        if (errno != EAGAIN)
+            return NULL;
+        struct epoll_event event;
+        int res = TEMP_FAILURE_RETRY(epoll_wait(stream->epoll_fd, &event, 1, timeoutMillis));
+        if (res < 0)
+            return NULL;
+        if (res == 0) {
+            errno = ETIMEDOUT;
+            return NULL;
+        }
+    }
+    urb->usercontext = NULL;
+    stream->in_flight--;
+    return urb;
+}
+
+int usb_bulk_stream_transfer(struct usb_bulk_stream *stream, void *buffer, unsigned int length,
+        int timeoutMillis)
+{
+    int is_in = (stream->endpoint & USB_ENDPOINT_DIR_MASK) == USB_DIR_IN;
+    unsigned int submitted = 0;
+    unsigned int transferred = 0;
+    int done = 0;
+    int discarded = 0;
+    int error = 0;
+
+    while (!done || stream->in_flight > 0) {
+        while (!done && submitted < length && stream->in_flight < stream->num_urbs) {
+            struct usbdevfs_urb *urb = NULL;
+            for (int i = 0; i < stream->num_urbs && !urb; i++) {
+                if (!stream->urbs[i].usercontext)
+                    urb = &stream->urbs[i];
+            }
+
+            memset(urb, 0, sizeof(*urb));
+            urb->type = USBDEVFS_URB_TYPE_BULK;
+            urb->endpoint = stream->endpoint;
+            urb->buffer = (char *) buffer + submitted;
+            urb->buffer_length = length - submitted < stream->urb_size ?
+                    length - submitted : stream->urb_size;
+            urb->usercontext = stream;
+            // Make a short packet fail the request, so that the kernel
+            // cancels the reads queued behind it instead of letting them take
+            // the start of whatever the device sends next.
+            if (is_in) {
+                urb->flags = USBDEVFS_URB_SHORT_NOT_OK;
+                if (submitted)
+                    urb->flags |= USBDEVFS_URB_BULK_CONTINUATION;
+            }
+
+            if (TEMP_FAILURE_RETRY(ioctl(stream->dev->fd, USBDEVFS_SUBMITURB, urb)) < 0) {
+                D("[ submit urb - error %d]\n", errno);
+                urb->usercontext = NULL;
+                error = errno;
+                done = 1;
+                break;
+            }
+            stream->in_flight++;
+            submitted += urb->buffer_length;
+        }
+
+        if (stream->in_flight == 0)
+            break;
+        if (done && !discarded) {
+            usb_bulk_stream_discard(stream);
+            discarded = 1;
+        }
+
+        // Discarded requests complete right away.
+        struct usbdevfs_urb *urb = usb_bulk_stream_reap(stream, done ? -1 : timeoutMillis);
+        if (!urb) {
+            D("[ reap urb - error %d]\n", errno);
+            if (done) {
+                // The device is gone, and the kernel has let go of the
+                // requests without completing them.
+                for (int i = 0; i < stream->num_urbs; i++)
+                    stream->urbs[i].usercontext = NULL;
+                stream->in_flight = 0;
+                break;
+            }
+            error = errno;
+            done = 1;
+            continue;
+        }
+
+        D("[ urb @%p status = %d, actual = %d ]\n", urb, urb->status, urb->actual_length);
+        if (done)
+            continue;
+        if (urb->status == 0 || urb->status == -EREMOTEIO) {
+            // Requests on one endpoint complete in order, so the data is
+            // contiguous up to the first short one.
+            transferred += urb->actual_length;
+            if (urb->actual_length < urb->buffer_length)
+                done = 1;
+        } else {
+            error = -urb->status;
+            done = 1;
+        }
+    }
+
+    if (error) {
+        errno = error;
+        return -1;
+    }
+    return transferred;
+}
@@ -38,6 +38,14 @@ CallStack::CallStack(const char* logtag, int32_t ignoreDepth) {
 CallStack::~CallStack() {
 }
 
+static void formatFrames(Backtrace* backtrace, Vector<String8>* frameLines) {
+    frameLines->setCapacity(backtrace->NumFrames());
+    for (size_t i = 0; i < backtrace->NumFrames(); i++) {
+      frameLines->push_back(String8(backtrace->FormatFrameData(i).c_str()));
+    }
+}
+
+// Both update()s call Unwind() themselves, so that |ignoreDepth| counts from the caller.
 void CallStack::update(int32_t ignoreDepth, pid_t tid) {
     mFrameLines.clear();
 
@@ -45,9 +53,17 @@ void CallStack::update(int32_t ignoreDepth, pid_t tid) {
     if (!backtrace->Unwind(ignoreDepth)) {
         ALOGW("%s: Failed to unwind callstack.", __FUNCTION__);
     }
-    for (size_t i = 0; i < backtrace->NumFrames(); i++) {
-      mFrameLines.push_back(String8(backtrace->FormatFrameData(i).c_str()));
+    formatFrames(backtrace.get(), &mFrameLines);
+}
+
+void CallStack::update(int32_t ignoreDepth, pid_t tid, BacktraceMap* map) {
+    mFrameLines.clear();
+
+    std::unique_ptr<Backtrace> backtrace(Backtrace::Create(BACKTRACE_CURRENT_PROCESS, tid, map));
+    if (!backtrace->Unwind(ignoreDepth)) {
+        ALOGW("%s: Failed to unwind callstack.", __FUNCTION__);
     }
+    formatFrames(backtrace.get(), &mFrameLines);
 }
 
 void CallStack::log(const char* logtag, android_LogPriority priority, const char* prefix) const {
@@ -41,11 +41,46 @@
 #include <memory.h>
 #include <errno.h>
 #include <assert.h>
+#include <stdint.h>
 
 using namespace android;
 
 /*static*/ long FileMap::mPageSize = -1;
 
+#if !defined(__MINGW32__)
+// The PMD size, which is what transparent huge pages are on 4KiB page kernels.
+static const size_t kHugePageSize = 2 * 1024 * 1024;
+
+// A file page can only be part of a huge page if its address and its file
+// offset are the same modulo the huge page size.  mmap() only guarantees page
+// alignment, so reserve enough address space to pick an aligned start and
+// unmap the rest.
+static void* mmapForHugePages(size_t length, size_t pageSize, int prot, int flags, int fd,
+        off64_t offset)
+{
+    length = (length + pageSize - 1) & ~(pageSize - 1);
+    size_t reserveLength = length + kHugePageSize;
+    void* reserve = mmap(nullptr, reserveLength, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (reserve == MAP_FAILED)
+        return mmap(nullptr, length, prot, flags, fd, offset);
+
+    uintptr_t reserveStart = reinterpret_cast<uintptr_t>(reserve);
+    uintptr_t reserveEnd = reserveStart + reserveLength;
+    uintptr_t start = reserveStart + (offset - reserveStart) % kHugePageSize;
+    void* ptr = mmap(reinterpret_cast<void*>(start), length, prot, flags | MAP_FIXED, fd, offset);
+    if (ptr == MAP_FAILED) {
+        munmap(reserve, reserveLength);
+        return MAP_FAILED;
+    }
+    uintptr_t end = start + length;
+    if (start > reserveStart)
+        munmap(reserve, start - reserveStart);
+    if (reserveEnd > end)
+        munmap(reinterpret_cast<void*>(end), reserveEnd - end);
+    return ptr;
+}
+#endif
+
 // Constructor.  Create an empty object.
 FileMap::FileMap(void)
     : mFileName(nullptr),
@@ -134,8 +169,16 @@ FileMap::~FileMap(void)
 // Returns "false" on failure.
 bool FileMap::create(const char* origFileName, int fd, off64_t offset, size_t length,
         bool readOnly)
+{
+    return create(origFileName, fd, offset, length, readOnly, 0);
+}
+
+bool FileMap::create(const char* origFileName, int fd, off64_t offset, size_t length,
+        bool readOnly, int createFlags)
 {
 #if defined(__MINGW32__)
+    (void) createFlags;
+
     int     adjust;
     off64_t adjOffset;
     size_t  adjLength;
@@ -198,17 +241,29 @@ bool FileMap::create(const char* origFileName, int fd, off64_t offset, size_t le
     adjLength = length + adjust;
 
     flags = MAP_SHARED;
+#if defined(MAP_POPULATE)
+    if (createFlags & POPULATE)
+        flags |= MAP_POPULATE;
+#endif
     prot = PROT_READ;
     if (!readOnly)
         prot |= PROT_WRITE;
 
-    ptr = mmap(nullptr, adjLength, prot, flags, fd, adjOffset);
+    if ((createFlags & HUGE_PAGES) && adjLength >= kHugePageSize)
+        ptr = mmapForHugePages(adjLength, mPageSize, prot, flags, fd, adjOffset);
+    else
+        ptr = mmap(nullptr, adjLength, prot, flags, fd, adjOffset);
     if (ptr == MAP_FAILED) {
         ALOGE("mmap(%lld,%zu) failed: %s\n",
             (long long)adjOffset, adjLength, strerror(errno));
         return false;
     }
     mBasePtr = ptr;
+#if defined(MADV_HUGEPAGE)
+    // This fails on kernels without transparent huge pages, which is fine.
+    if (createFlags & HUGE_PAGES)
+        madvise(mBasePtr, adjLength, MADV_HUGEPAGE);
+#endif
 #endif // !defined(__MINGW32__)
 
     mFileName = origFileName != nullptr ? strdup(origFileName) : nullptr;
@@ -227,30 +282,56 @@ bool FileMap::create(const char* origFileName, int fd, off64_t offset, size_t le
 
 // Provide guidance to the system.
 #if !defined(_WIN32)
-int FileMap::advise(MapAdvice advice)
+static int adviseRange(FileMap::MapAdvice advice, void* addr, size_t length)
 {
     int cc, sysAdvice;
 
     switch (advice) {
-        case NORMAL:        sysAdvice = MADV_NORMAL;        break;
-        case RANDOM:        sysAdvice = MADV_RANDOM;        break;
-        case SEQUENTIAL:    sysAdvice = MADV_SEQUENTIAL;    break;
-        case WILLNEED:      sysAdvice = MADV_WILLNEED;      break;
-        case DONTNEED:      sysAdvice = MADV_DONTNEED;      break;
+        case FileMap::NORMAL:       sysAdvice = MADV_NORMAL;        break;
+        case FileMap::RANDOM:       sysAdvice = MADV_RANDOM;        break;
+        case FileMap::SEQUENTIAL:   sysAdvice = MADV_SEQUENTIAL;    break;
+        case FileMap::WILLNEED:     sysAdvice = MADV_WILLNEED;      break;
+        case FileMap::DONTNEED:     sysAdvice = MADV_DONTNEED;      break;
+#if defined(MADV_HUGEPAGE)
+        case FileMap::HUGEPAGE:     sysAdvice = MADV_HUGEPAGE;      break;
+#endif
         default:
-                            assert(false);
-                            return -1;
+                                    errno = EINVAL;
+                                    return -1;
     }
 
-    cc = madvise(mBasePtr, mBaseLength, sysAdvice);
+    cc = madvise(addr, length, sysAdvice);
     if (cc != 0)
         ALOGW("madvise(%d) failed: %s\n", sysAdvice, strerror(errno));
     return cc;
 }
 
+int FileMap::advise(MapAdvice advice)
+{
+    return adviseRange(advice, mBasePtr, mBaseLength);
+}
+
+int FileMap::advise(MapAdvice advice, size_t offset, size_t length)
+{
+    if (offset > mDataLength)
+        return -1;
+    if (length > mDataLength - offset)
+        length = mDataLength - offset;
+
+    // madvise() wants a page aligned start; mBasePtr is one.
+    size_t start = ((char*) mDataPtr - (char*) mBasePtr) + offset;
+    size_t adjust = start % mPageSize;
+    return adviseRange(advice, (char*) mBasePtr + start - adjust, length + adjust);
+}
+
 #else
 int FileMap::advise(MapAdvice /* advice */)
 {
     return -1;
 }
+
+int FileMap::advise(MapAdvice /* advice */, size_t /* offset */, size_t /* length */)
+{
+    return -1;
+}
 #endif
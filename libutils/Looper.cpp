@@ -16,6 +16,8 @@
 #include <utils/Looper.h>
 #include <sys/eventfd.h>
 
+#include <algorithm>
+
 namespace android {
 
 // --- WeakMessageHandler ---
@@ -51,20 +53,24 @@ int SimpleLooperCallback::handleEvent(int fd, int events, void* data) {
 
 // --- Looper ---
 
-// Maximum number of file descriptors for which to retrieve poll events each iteration.
-static const int EPOLL_MAX_EVENTS = 16;
+// Number of file descriptors for which to retrieve poll events each iteration.
+// The batch starts small and doubles, up to the maximum, whenever a poll fills it.
+static const size_t EPOLL_MIN_EVENTS = 16;
+static const size_t EPOLL_MAX_EVENTS = 256;
 
 static pthread_once_t gTLSOnce = PTHREAD_ONCE_INIT;
 static pthread_key_t gTLSKey = 0;
 
 Looper::Looper(bool allowNonCallbacks)
     : mAllowNonCallbacks(allowNonCallbacks),
+      mNextMessageSeq(0),
       mSendingMessage(false),
       mPolling(false),
       mEpollRebuildRequired(false),
       mNextRequestSeq(0),
       mResponseIndex(0),
-      mNextMessageUptime(LLONG_MAX) {
+      mNextMessageUptime(LLONG_MAX),
+      mEpollEvents(EPOLL_MIN_EVENTS) {
     mWakeEventFd.reset(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC));
     LOG_ALWAYS_FATAL_IF(mWakeEventFd.get() < 0, "Could not make wake event fd: %s", strerror(errno));
 
@@ -233,8 +239,8 @@ int Looper::pollInner(int timeoutMillis) {
     // We are about to idle.
     mPolling = true;
 
-    struct epoll_event eventItems[EPOLL_MAX_EVENTS];
-    int eventCount = epoll_wait(mEpollFd.get(), eventItems, EPOLL_MAX_EVENTS, timeoutMillis);
+    struct epoll_event* eventItems = mEpollEvents.data();
+    int eventCount = epoll_wait(mEpollFd.get(), eventItems, mEpollEvents.size(), timeoutMillis);
 
     // No longer idling.
     mPolling = false;
@@ -297,13 +303,19 @@ int Looper::pollInner(int timeoutMillis) {
             }
         }
     }
+
+    // A full batch means more events are likely pending; fetch them in one go next time.
+    if (static_cast<size_t>(eventCount) == mEpollEvents.size()
+            && mEpollEvents.size() < EPOLL_MAX_EVENTS) {
+        mEpollEvents.resize(mEpollEvents.size() * 2);
+    }
 Done: ;
 
     // Invoke pending message callbacks.
     mNextMessageUptime = LLONG_MAX;
     while (mMessageEnvelopes.size() != 0) {
         nsecs_t now = systemTime(SYSTEM_TIME_MONOTONIC);
-        const MessageEnvelope& messageEnvelope = mMessageEnvelopes.itemAt(0);
+        const MessageEnvelope& messageEnvelope = mMessageEnvelopes.front();
         if (messageEnvelope.uptime <= now) {
             // Remove the envelope from the list.
             // We keep a strong reference to the handler until the call to handleMessage
@@ -312,7 +324,9 @@ Done: ;
             { // obtain handler
                 sp<MessageHandler> handler = messageEnvelope.handler;
                 Message message = messageEnvelope.message;
-                mMessageEnvelopes.removeAt(0);
+                std::pop_heap(mMessageEnvelopes.begin(), mMessageEnvelopes.end(),
+                        MessageEnvelopeLater());
+                mMessageEnvelopes.pop_back();
                 mSendingMessage = true;
                 mLock.unlock();
 
@@ -588,17 +602,15 @@ void Looper::sendMessageAtTime(nsecs_t uptime, const sp<MessageHandler>& handler
             this, uptime, handler.get(), message.what);
 #endif
 
-    size_t i = 0;
+    bool atHead;
     { // acquire lock
         AutoMutex _l(mLock);
 
-        size_t messageCount = mMessageEnvelopes.size();
-        while (i < messageCount && uptime >= mMessageEnvelopes.itemAt(i).uptime) {
-            i += 1;
-        }
-
-        MessageEnvelope messageEnvelope(uptime, handler, message);
-        mMessageEnvelopes.insertAt(messageEnvelope, i, 1);
+        uint64_t seq = mNextMessageSeq++;
+        mMessageEnvelopes.emplace_back(uptime, seq, handler, message);
+        std::push_heap(mMessageEnvelopes.begin(), mMessageEnvelopes.end(),
+                MessageEnvelopeLater());
+        atHead = mMessageEnvelopes.front().seq == seq;
 
         // Optimization: If the Looper is currently sending a message, then we can skip
         // the call to wake() because the next thing the Looper will do after processing
@@ -610,7 +622,7 @@ void Looper::sendMessageAtTime(nsecs_t uptime, const sp<MessageHandler>& handler
     } // release lock
 
     // Wake the poll loop only when we enqueue a new message at the head.
-    if (i == 0) {
+    if (atHead) {
         wake();
     }
 }
@@ -623,12 +635,9 @@ void Looper::removeMessages(const sp<MessageHandler>& handler) {
     { // acquire lock
         AutoMutex _l(mLock);
 
-        for (size_t i = mMessageEnvelopes.size(); i != 0; ) {
-            const MessageEnvelope& messageEnvelope = mMessageEnvelopes.itemAt(--i);
-            if (messageEnvelope.handler == handler) {
-                mMessageEnvelopes.removeAt(i);
-            }
-        }
+        removeMessagesLocked([&handler](const MessageEnvelope& messageEnvelope) {
+            return messageEnvelope.handler == handler;
+        });
     } // release lock
 }
 
@@ -640,16 +649,22 @@ void Looper::removeMessages(const sp<MessageHandler>& handler, int what) {
     { // acquire lock
         AutoMutex _l(mLock);
 
-        for (size_t i = mMessageEnvelopes.size(); i != 0; ) {
-            const MessageEnvelope& messageEnvelope = mMessageEnvelopes.itemAt(--i);
-            if (messageEnvelope.handler == handler
-                    && messageEnvelope.message.what == what) {
-                mMessageEnvelopes.removeAt(i);
-            }
-        }
+        removeMessagesLocked([&handler, what](const MessageEnvelope& messageEnvelope) {
+            return messageEnvelope.handler == handler && messageEnvelope.message.what == what;
+        });
     } // release lock
 }
 
+template <typename Predicate>
+void Looper::removeMessagesLocked(Predicate predicate) {
+    auto end = std::remove_if(mMessageEnvelopes.begin(), mMessageEnvelopes.end(), predicate);
+    if (end != mMessageEnvelopes.end()) {
+        mMessageEnvelopes.erase(end, mMessageEnvelopes.end());
+        std::make_heap(mMessageEnvelopes.begin(), mMessageEnvelopes.end(),
+                MessageEnvelopeLater());
+    }
+}
+
 bool Looper::isPolling() const {
     return mPolling;
 }
@@ -22,8 +22,13 @@
 #include <dirent.h>
 #include <unistd.h>
 
+#include <algorithm>
+#include <atomic>
 #include <memory>
+#include <thread>
+#include <vector>
 
+#include <backtrace/BacktraceMap.h>
 #include <utils/Printer.h>
 
 namespace android {
@@ -126,16 +131,14 @@ void ProcessCallStack::clear() {
     mTimeUpdated = tm();
 }
 
-void ProcessCallStack::update() {
+bool ProcessCallStack::startUpdate() {
     std::unique_ptr<DIR, decltype(&closedir)> dp(opendir(PATH_SELF_TASK), closedir);
     if (dp == nullptr) {
         ALOGE("%s: Failed to update the process's call stacks: %s",
               __FUNCTION__, strerror(errno));
-        return;
+        return false;
     }
 
-    pid_t selfPid = getpid();
-
     clear();
 
     // Get current time.
@@ -169,8 +172,20 @@ void ProcessCallStack::update() {
                   __FUNCTION__, strerror(-idx));
             continue;
         }
+    }
+    return true;
+}
 
-        ThreadInfo& threadInfo = mThreadMap.editValueAt(static_cast<size_t>(idx));
+void ProcessCallStack::update() {
+    if (!startUpdate()) {
+        return;
+    }
+
+    pid_t selfPid = getpid();
+
+    for (size_t i = 0; i < mThreadMap.size(); ++i) {
+        pid_t tid = mThreadMap.keyAt(i);
+        ThreadInfo& threadInfo = mThreadMap.editValueAt(i);
 
         /*
          * Ignore CallStack::update and ProcessCallStack::update for current thread
@@ -189,6 +204,57 @@ void ProcessCallStack::update() {
     }
 }
 
+void ProcessCallStack::updateParallel(size_t maxThreads) {
+    std::unique_ptr<BacktraceMap> map(BacktraceMap::Create(getpid()));
+    if (map == nullptr) {
+        ALOGW("%s: Failed to read the process's maps, unwinding serially", __FUNCTION__);
+        update();
+        return;
+    }
+
+    // The helper threads are started after the list of threads is read, so
+    // they do not dump themselves.
+    if (!startUpdate()) {
+        return;
+    }
+
+    // Only the ThreadInfos are written concurrently, never mThreadMap itself.
+    std::vector<std::pair<pid_t, ThreadInfo*>> threads;
+    threads.reserve(mThreadMap.size());
+    for (size_t i = 0; i < mThreadMap.size(); ++i) {
+        threads.emplace_back(mThreadMap.keyAt(i), &mThreadMap.editValueAt(i));
+    }
+
+    if (maxThreads == 0) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        maxThreads = cpus > 0 ? static_cast<size_t>(cpus) : 1;
+    }
+    maxThreads = std::min(maxThreads, threads.size());
+
+    std::atomic<size_t> next(0);
+    auto unwindThreads = [&]() {
+        for (size_t i; (i = next.fetch_add(1, std::memory_order_relaxed)) < threads.size();) {
+            pid_t tid = threads[i].first;
+            ThreadInfo* threadInfo = threads[i].second;
+            // Every thread is unwound from another one, including the caller.
+            threadInfo->callStack.update(0, tid, map.get());
+            threadInfo->threadName = getThreadName(tid);
+
+            ALOGV("%s: Got call stack for tid %d (size %zu)",
+                  __FUNCTION__, tid, threadInfo->callStack.size());
+        }
+    };
+
+    std::vector<std::thread> helpers;
+    helpers.reserve(maxThreads);
+    for (size_t i = 0; i < maxThreads; ++i) {
+        helpers.emplace_back(unwindThreads);
+    }
+    for (std::thread& helper : helpers) {
+        helper.join();
+    }
+}
+
 void ProcessCallStack::log(const char* logtag, android_LogPriority priority,
                            const char* prefix) const {
     LogPrinter printer(logtag, priority, prefix, /*ignoreBlankLines*/false);
@@ -18,6 +18,10 @@
 
 #include <utils/PropertyMap.h>
 
+#include <algorithm>
+#include <utility>
+#include <vector>
+
 // Enables debug output for the parser.
 #define DEBUG_PARSER 0
 
@@ -41,10 +45,20 @@ PropertyMap::~PropertyMap() {
 
 void PropertyMap::clear() {
     mProperties.clear();
+    mKeyedPropertiesValid = false;
 }
 
 void PropertyMap::addProperty(const String8& key, const String8& value) {
     mProperties.add(key, value);
+    mKeyedPropertiesValid = false;
+}
+
+const KeyedVector<String8, String8>& PropertyMap::getProperties() const {
+    if (!mKeyedPropertiesValid) {
+        mKeyedProperties = mProperties.toKeyedVector();
+        mKeyedPropertiesValid = true;
+    }
+    return mKeyedProperties;
 }
 
 bool PropertyMap::hasProperty(const String8& key) const {
@@ -106,9 +120,14 @@ bool PropertyMap::tryGetProperty(const String8& key, float& outValue) const {
 }
 
 void PropertyMap::addAll(const PropertyMap* map) {
-    for (size_t i = 0; i < map->mProperties.size(); i++) {
-        mProperties.add(map->mProperties.keyAt(i), map->mProperties.valueAt(i));
+    if (mProperties.isEmpty()) {
+        mProperties = map->mProperties;
+    } else {
+        for (const auto& entry : map->mProperties) {
+            mProperties.add(entry.first, entry.second);
+        }
     }
+    mKeyedPropertiesValid = false;
 }
 
 status_t PropertyMap::load(const String8& filename, PropertyMap** outMap) {
@@ -157,6 +176,9 @@ PropertyMap::Parser::~Parser() {
 }
 
 status_t PropertyMap::Parser::parse() {
+    // Collected first and sorted once at the end, rather than inserted one by
+    // one into the sorted map.
+    std::vector<std::pair<String8, String8>> properties;
     while (!mTokenizer->isEof()) {
 #if DEBUG_PARSER
         ALOGD("Parsing %s: '%s'.", mTokenizer->getLocation().string(),
@@ -197,17 +219,25 @@ status_t PropertyMap::Parser::parse() {
                 return BAD_VALUE;
             }
 
-            if (mMap->hasProperty(keyToken)) {
-                ALOGE("%s: Duplicate property value for key '%s'.",
-                        mTokenizer->getLocation().string(), keyToken.string());
-                return BAD_VALUE;
-            }
-
-            mMap->addProperty(keyToken, valueToken);
+            properties.emplace_back(std::move(keyToken), std::move(valueToken));
         }
 
         mTokenizer->nextLine();
     }
+
+    std::stable_sort(properties.begin(), properties.end(),
+            [](const auto& lhs, const auto& rhs) { return lhs.first < rhs.first; });
+    auto duplicate = std::adjacent_find(properties.begin(), properties.end(),
+            [](const auto& lhs, const auto& rhs) { return lhs.first == rhs.first; });
+    if (duplicate != properties.end()) {
+        ALOGE("%s: Duplicate property value for key '%s'.",
+                mTokenizer->getFilename().string(), duplicate->first.string());
+        return BAD_VALUE;
+    }
+
+    // The parser only ever fills the new, empty map of load().
+    mMap->mProperties = FlatMap<String8, String8>::fromSortedUnique(std::move(properties));
+    mMap->mKeyedPropertiesValid = false;
     return OK;
 }
 
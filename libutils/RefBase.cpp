@@ -754,6 +754,101 @@ void RefBase::onLastWeakRef(const void* /*id*/)
 
 // ---------------------------------------------------------------------------
 
+// A LightWeakRefBase that got a weak reference uses a weakref_impl without an
+// mBase, following the OBJECT_LIFETIME_STRONG rules above: every strong
+// reference also holds a weak one. The object itself holds one more weak
+// reference, dropped by its destructor, so that the weakref_impl outlives the
+// object. The strong count is never INITIAL_STRONG_VALUE, hence decWeak() never
+// needs mBase, and attemptIncStrong() fails once the count is 0.
+
+static inline RefBase::weakref_type* sharedRefs(uintptr_t state)
+{
+    return reinterpret_cast<RefBase::weakref_type*>(state & ~static_cast<uintptr_t>(1));
+}
+
+void LightWeakRefBase::incStrongShared(const void* id) const
+{
+    // Once shared, mState no longer changes; loading it again pairs with the
+    // release in createWeak(), which published the counts.
+    RefBase::weakref_impl* const refs = static_cast<RefBase::weakref_impl*>(
+            sharedRefs(mState.load(std::memory_order_acquire)));
+    refs->incWeak(id);
+
+    refs->addStrongRef(id);
+    const int32_t c __unused = refs->mStrong.fetch_add(1, std::memory_order_relaxed);
+    ALOG_ASSERT(c >= 0, "incStrong() called on %p after last strong ref", this);
+#if PRINT_REFS
+    ALOGD("incStrong of %p from %p: cnt=%d\n", this, id, c);
+#endif
+}
+
+void LightWeakRefBase::decStrongShared(const void* id) const
+{
+    RefBase::weakref_impl* const refs = static_cast<RefBase::weakref_impl*>(
+            sharedRefs(mState.load(std::memory_order_acquire)));
+    refs->removeStrongRef(id);
+    const int32_t c = refs->mStrong.fetch_sub(1, std::memory_order_release);
+#if PRINT_REFS
+    ALOGD("decStrong of %p from %p: cnt=%d\n", this, id, c);
+#endif
+    LOG_ALWAYS_FATAL_IF(BAD_STRONG(c), "decStrong() called on %p too many times", this);
+    if (c == 1) {
+        std::atomic_thread_fence(std::memory_order_acquire);
+        delete this;
+    }
+    // As in RefBase::decStrong(), refs is still valid: the weak reference
+    // dropped here is only released after the object is gone. NOLINTNEXTLINE
+    refs->decWeak(id);
+}
+
+int32_t LightWeakRefBase::getStrongCount() const
+{
+    // Debugging only; No memory ordering guarantees.
+    uintptr_t state = mState.load(std::memory_order_acquire);
+    if ((state & kShared) == 0) {
+        return static_cast<int32_t>(state / kOneStrong);
+    }
+    return static_cast<RefBase::weakref_impl*>(sharedRefs(state))
+            ->mStrong.load(std::memory_order_relaxed);
+}
+
+RefBase::weakref_type* LightWeakRefBase::createWeak(const void* id) const
+{
+    uintptr_t state = mState.load(std::memory_order_acquire);
+    if ((state & kShared) == 0) {
+        // Move the counts out of the object. Strong references racing with us
+        // make the exchange fail, and are then counted in the new refs.
+        RefBase::weakref_impl* refs = new RefBase::weakref_impl(nullptr);
+        const uintptr_t shared = reinterpret_cast<uintptr_t>(refs) | kShared;
+        do {
+            const int32_t strong = static_cast<int32_t>(state / kOneStrong);
+            refs->mStrong.store(strong, std::memory_order_relaxed);
+            refs->mWeak.store(strong + 1, std::memory_order_relaxed);
+        } while ((state & kShared) == 0 &&
+                !mState.compare_exchange_weak(state, shared,
+                        std::memory_order_release, std::memory_order_acquire));
+        if ((state & kShared) == 0) {
+            state = shared;
+        } else {
+            // Another thread got there first.
+            delete refs;
+        }
+    }
+    RefBase::weakref_type* const refs = sharedRefs(state);
+    refs->incWeak(id);
+    return refs;
+}
+
+LightWeakRefBase::~LightWeakRefBase()
+{
+    uintptr_t state = mState.load(std::memory_order_acquire);
+    if ((state & kShared) != 0) {
+        sharedRefs(state)->decWeak(this);
+    }
+}
+
+// ---------------------------------------------------------------------------
+
 #if DEBUG_REFS
 void RefBase::renameRefs(size_t n, const ReferenceRenamer& renamer) {
     for (size_t i=0 ; i<n ; i++) {
@@ -44,26 +44,30 @@ static char16_t* allocFromUTF8(const char* u8str, size_t u8len)
 
     const uint8_t* u8cur = (const uint8_t*) u8str;
 
-    const ssize_t u16len = utf8_to_utf16_length(u8cur, u8len);
-    if (u16len < 0) {
+    // The UTF-16 is at most u8len code units long, exactly that for ASCII, so
+    // convert into a buffer of that size in a single pass and shrink it after.
+    if (u8len >= SIZE_MAX / sizeof(char16_t)) {
         return getEmptyString();
     }
-
-    SharedBuffer* buf = SharedBuffer::alloc(sizeof(char16_t)*(u16len+1));
-    if (buf) {
-        u8cur = (const uint8_t*) u8str;
-        char16_t* u16str = (char16_t*)buf->data();
-
-        utf8_to_utf16(u8cur, u8len, u16str, ((size_t) u16len) + 1);
-
-        //printf("Created UTF-16 string from UTF-8 \"%s\":", in);
-        //printHexData(1, str, buf->size(), 16, 1);
-        //printf("\n");
-
-        return u16str;
+    SharedBuffer* buf = SharedBuffer::alloc(sizeof(char16_t)*(u8len+1));
+    if (!buf) {
+        return getEmptyString();
     }
 
-    return getEmptyString();
+    const ssize_t u16len = utf8_to_utf16_measure(u8cur, u8len, (char16_t*)buf->data(), u8len + 1);
+    if (u16len < 0) {
+        buf->release();
+        return getEmptyString();
+    }
+    if (static_cast<size_t>(u16len) != u8len) {
+        SharedBuffer* resized = buf->editResize(sizeof(char16_t)*(u16len+1));
+        if (!resized) {
+            buf->release();
+            return getEmptyString();
+        }
+        buf = resized;
+    }
+    return (char16_t*)buf->data();
 }
 
 static char16_t* allocFromUTF16(const char16_t* u16str, size_t u16len) {
@@ -109,6 +113,14 @@ String16::String16(const String16& o)
     SharedBuffer::bufferFromData(mString)->acquire();
 }
 
+// Moves take over the other string's buffer, leaving it empty, so they cost
+// neither an allocation nor a reference count change on that buffer.
+String16::String16(String16&& o) noexcept
+    : mString(o.mString)
+{
+    o.mString = getEmptyString();
+}
+
 String16::String16(const String16& o, size_t len, size_t begin)
     : mString(getEmptyString())
 {
@@ -144,6 +156,16 @@ size_t String16::size() const
     return SharedBuffer::sizeFromData(mString)/sizeof(char16_t)-1;
 }
 
+String16& String16::operator=(String16&& other) noexcept
+{
+    if (this != &other) {
+        SharedBuffer::bufferFromData(mString)->release();
+        mString = other.mString;
+        other.mString = getEmptyString();
+    }
+    return *this;
+}
+
 void String16::setTo(const String16& other)
 {
     SharedBuffer::bufferFromData(other.mString)->acquire();
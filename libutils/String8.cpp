@@ -78,20 +78,42 @@ static char* allocFromUTF16(const char16_t* in, size_t len)
 {
     if (len == 0) return getEmptyString();
 
-     // Allow for closing '\0'
-    const ssize_t resultStrLen = utf16_to_utf8_length(in, len) + 1;
-    if (resultStrLen < 1) {
-        return getEmptyString();
-    }
-
-    SharedBuffer* buf = SharedBuffer::alloc(resultStrLen);
+    // The UTF-8 is exactly len bytes long if "in" is ASCII, so convert into a
+    // buffer of that size first. Whatever did not fit is measured, and only
+    // that part is converted once the buffer has been grown.
+    SharedBuffer* buf = SharedBuffer::alloc(len + 1);
     ALOG_ASSERT(buf, "Unable to allocate shared buffer");
     if (!buf) {
         return getEmptyString();
     }
 
+    size_t read;
+    const size_t written = utf16_to_utf8_partial(in, len, (char*)buf->data(), len, &read);
+    size_t resultLen = written;
+    if (read < len) {
+        const ssize_t rest = utf16_to_utf8_length(in + read, len - read);
+        if (rest < 0 || SIZE_MAX - 1 - written < static_cast<size_t>(rest)) {
+            buf->release();
+            return getEmptyString();
+        }
+        resultLen += rest;
+    }
+    if (resultLen != len) {
+        // Don't overwrite buf until the resize succeeded, so it can be freed.
+        SharedBuffer* resized = buf->editResize(resultLen + 1);
+        if (!resized) {
+            buf->release();
+            return getEmptyString();
+        }
+        buf = resized;
+    }
+
     char* resultStr = (char*)buf->data();
-    utf16_to_utf8(in, len, resultStr, resultStrLen);
+    if (read < len) {
+        utf16_to_utf8(in + read, len - read, resultStr + written, resultLen - written + 1);
+    } else {
+        resultStr[resultLen] = '\0';
+    }
     return resultStr;
 }
 
@@ -144,6 +166,14 @@ String8::String8(const String8& o)
     SharedBuffer::bufferFromData(mString)->acquire();
 }
 
+// Moves take over the other string's buffer, leaving it empty, so they cost
+// neither an allocation nor a reference count change on that buffer.
+String8::String8(String8&& o) noexcept
+    : mString(o.mString)
+{
+    o.mString = getEmptyString();
+}
+
 String8::String8(const char* o)
     : mString(allocFromUTF8(o, strlen(o)))
 {
@@ -218,6 +248,16 @@ void String8::clear() {
     mString = getEmptyString();
 }
 
+String8& String8::operator=(String8&& other) noexcept
+{
+    if (this != &other) {
+        SharedBuffer::bufferFromData(mString)->release();
+        mString = other.mString;
+        other.mString = getEmptyString();
+    }
+    return *this;
+}
+
 void String8::setTo(const String8& other)
 {
     SharedBuffer::bufferFromData(other.mString)->acquire();
@@ -27,9 +27,26 @@
 
 namespace android {
 
-static inline bool isDelimiter(char ch, const char* delimiters) {
-    return strchr(delimiters, ch) != nullptr;
-}
+// The delimiters of one call as a bitmap, so that the characters are checked
+// against it without a strchr() each. Like strchr(), it has the terminating
+// null, which is what makes the tokenizer stop at embedded nulls.
+class DelimiterSet {
+public:
+    explicit DelimiterSet(const char* delimiters) : mBits() {
+        do {
+            uint8_t ch = *delimiters;
+            mBits[ch >> 5] |= 1u << (ch & 31);
+        } while (*delimiters++ != '\0');
+    }
+
+    inline bool contains(char ch) const {
+        uint8_t c = ch;
+        return (mBits[c >> 5] & (1u << (c & 31))) != 0;
+    }
+
+private:
+    uint32_t mBits[8];
+};
 
 Tokenizer::Tokenizer(const String8& filename, FileMap* fileMap, char* buffer,
         bool ownBuffer, size_t length) :
@@ -110,6 +127,11 @@ String8 Tokenizer::getLocation() const {
 }
 
 String8 Tokenizer::peekRemainderOfLine() const {
+    std::string_view line = peekRemainderOfLineView();
+    return String8(line.data(), line.size());
+}
+
+std::string_view Tokenizer::peekRemainderOfLineView() const {
     const char* end = getEnd();
     const char* eol = mCurrent;
     while (eol != end) {
@@ -119,23 +141,29 @@ String8 Tokenizer::peekRemainderOfLine() const {
         }
         eol += 1;
     }
-    return String8(mCurrent, eol - mCurrent);
+    return std::string_view(mCurrent, eol - mCurrent);
 }
 
 String8 Tokenizer::nextToken(const char* delimiters) {
+    std::string_view token = nextTokenView(delimiters);
+    return String8(token.data(), token.size());
+}
+
+std::string_view Tokenizer::nextTokenView(const char* delimiters) {
 #if DEBUG_TOKENIZER
     ALOGD("nextToken");
 #endif
+    const DelimiterSet delimiterSet(delimiters);
     const char* end = getEnd();
     const char* tokenStart = mCurrent;
     while (mCurrent != end) {
         char ch = *mCurrent;
-        if (ch == '\n' || isDelimiter(ch, delimiters)) {
+        if (ch == '\n' || delimiterSet.contains(ch)) {
             break;
         }
         mCurrent += 1;
     }
-    return String8(tokenStart, mCurrent - tokenStart);
+    return std::string_view(tokenStart, mCurrent - tokenStart);
 }
 
 void Tokenizer::nextLine() {
@@ -156,10 +184,11 @@ void Tokenizer::skipDelimiters(const char* delimiters) {
 #if DEBUG_TOKENIZER
     ALOGD("skipDelimiters");
 #endif
+    const DelimiterSet delimiterSet(delimiters);
     const char* end = getEnd();
     while (mCurrent != end) {
         char ch = *mCurrent;
-        if (ch == '\n' || !isDelimiter(ch, delimiters)) {
+        if (ch == '\n' || !delimiterSet.contains(ch)) {
             break;
         }
         mCurrent += 1;
@@ -18,8 +18,15 @@
 
 #include <android-base/macros.h>
 #include <limits.h>
+#include <string.h>
 #include <utils/Unicode.h>
 
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 #include <log/log.h>
 
 #if defined(_WIN32)
@@ -66,6 +73,118 @@ static const char32_t kFirstByteMark[] = {
     0x00000000, 0x00000000, 0x000000C0, 0x000000E0, 0x000000F0
 };
 
+// --------------------------------------------------------------------------
+// ASCII fast paths
+// --------------------------------------------------------------------------
+
+// Each of these handles the ASCII run at the start of "src", up to "len" code
+// units, a block of kAsciiBlock code units at a time, and returns how many it
+// handled: a multiple of kAsciiBlock, so the caller's loop finishes the run.
+// Most strings going through binder are ASCII, so this is the common case.
+// After a miss the callers go one character at a time for a block before
+// trying again, so that text with scattered non-ASCII characters does not pay
+// for a failed block check on every character.
+
+static const size_t kAsciiBlock = 16;
+
+static inline size_t utf16_ascii_run(const char16_t* src, size_t len)
+{
+    size_t i = 0;
+    for (; i + kAsciiBlock <= len; i += kAsciiBlock) {
+#if defined(__ARM_NEON)
+        const uint16_t* s = reinterpret_cast<const uint16_t*>(src + i);
+        uint16x8_t high = vshrq_n_u16(vorrq_u16(vld1q_u16(s), vld1q_u16(s + 8)), 7);
+        if (vget_lane_u64(vreinterpret_u64_u8(vqmovn_u16(high)), 0) != 0) break;
+#elif defined(__SSE2__)
+        const __m128i* s = reinterpret_cast<const __m128i*>(src + i);
+        __m128i all = _mm_or_si128(_mm_loadu_si128(s), _mm_loadu_si128(s + 1));
+        __m128i high = _mm_and_si128(all, _mm_set1_epi16(static_cast<short>(0xff80)));
+        if (_mm_movemask_epi8(_mm_cmpeq_epi16(high, _mm_setzero_si128())) != 0xffff) break;
+#else
+        uint64_t words[4];
+        memcpy(words, src + i, sizeof(words));
+        if (((words[0] | words[1] | words[2] | words[3]) & 0xff80ff80ff80ff80ULL) != 0) break;
+#endif
+    }
+    return i;
+}
+
+static inline size_t utf16_ascii_run_to_utf8(const char16_t* src, size_t len, char* dst)
+{
+    size_t i = 0;
+    for (; i + kAsciiBlock <= len; i += kAsciiBlock) {
+#if defined(__ARM_NEON)
+        const uint16_t* s = reinterpret_cast<const uint16_t*>(src + i);
+        uint16x8_t lo = vld1q_u16(s);
+        uint16x8_t hi = vld1q_u16(s + 8);
+        uint16x8_t high = vshrq_n_u16(vorrq_u16(lo, hi), 7);
+        if (vget_lane_u64(vreinterpret_u64_u8(vqmovn_u16(high)), 0) != 0) break;
+        vst1q_u8(reinterpret_cast<uint8_t*>(dst + i), vcombine_u8(vmovn_u16(lo), vmovn_u16(hi)));
+#elif defined(__SSE2__)
+        const __m128i* s = reinterpret_cast<const __m128i*>(src + i);
+        __m128i lo = _mm_loadu_si128(s);
+        __m128i hi = _mm_loadu_si128(s + 1);
+        __m128i high = _mm_and_si128(_mm_or_si128(lo, hi),
+                                     _mm_set1_epi16(static_cast<short>(0xff80)));
+        if (_mm_movemask_epi8(_mm_cmpeq_epi16(high, _mm_setzero_si128())) != 0xffff) break;
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_packus_epi16(lo, hi));
+#else
+        if (utf16_ascii_run(src + i, kAsciiBlock) == 0) break;
+        for (size_t j = 0; j < kAsciiBlock; j++) {
+            dst[i + j] = static_cast<char>(src[i + j]);
+        }
+#endif
+    }
+    return i;
+}
+
+static inline size_t utf8_ascii_run(const uint8_t* src, size_t len)
+{
+    size_t i = 0;
+    for (; i + kAsciiBlock <= len; i += kAsciiBlock) {
+#if defined(__ARM_NEON)
+        uint64x2_t high = vreinterpretq_u64_u8(vandq_u8(vld1q_u8(src + i), vdupq_n_u8(0x80)));
+        if ((vgetq_lane_u64(high, 0) | vgetq_lane_u64(high, 1)) != 0) break;
+#elif defined(__SSE2__)
+        if (_mm_movemask_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i))) != 0) {
+            break;
+        }
+#else
+        uint64_t words[2];
+        memcpy(words, src + i, sizeof(words));
+        if (((words[0] | words[1]) & 0x8080808080808080ULL) != 0) break;
+#endif
+    }
+    return i;
+}
+
+static inline size_t utf8_ascii_run_to_utf16(const uint8_t* src, size_t len, char16_t* dst)
+{
+    size_t i = 0;
+    for (; i + kAsciiBlock <= len; i += kAsciiBlock) {
+#if defined(__ARM_NEON)
+        uint8x16_t bytes = vld1q_u8(src + i);
+        uint64x2_t high = vreinterpretq_u64_u8(vandq_u8(bytes, vdupq_n_u8(0x80)));
+        if ((vgetq_lane_u64(high, 0) | vgetq_lane_u64(high, 1)) != 0) break;
+        uint16_t* d = reinterpret_cast<uint16_t*>(dst + i);
+        vst1q_u16(d, vmovl_u8(vget_low_u8(bytes)));
+        vst1q_u16(d + 8, vmovl_u8(vget_high_u8(bytes)));
+#elif defined(__SSE2__)
+        __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        if (_mm_movemask_epi8(bytes) != 0) break;
+        __m128i* d = reinterpret_cast<__m128i*>(dst + i);
+        _mm_storeu_si128(d, _mm_unpacklo_epi8(bytes, _mm_setzero_si128()));
+        _mm_storeu_si128(d + 1, _mm_unpackhi_epi8(bytes, _mm_setzero_si128()));
+#else
+        if (utf8_ascii_run(src + i, kAsciiBlock) == 0) break;
+        for (size_t j = 0; j < kAsciiBlock; j++) {
+            dst[i + j] = src[i + j];
+        }
+#endif
+    }
+    return i;
+}
+
 // --------------------------------------------------------------------------
 // UTF-32
 // --------------------------------------------------------------------------
@@ -334,7 +453,18 @@ void utf16_to_utf8(const char16_t* src, size_t src_len, char* dst, size_t dst_le
     const char16_t* cur_utf16 = src;
     const char16_t* const end_utf16 = src + src_len;
     char *cur = dst;
+    const char16_t* ascii_retry = src;
     while (cur_utf16 < end_utf16) {
+        if (cur_utf16 >= ascii_retry && *cur_utf16 < 0x80) {
+            size_t src_left = end_utf16 - cur_utf16;
+            size_t ascii = utf16_ascii_run_to_utf8(cur_utf16,
+                    src_left < dst_len ? src_left : dst_len, cur);
+            cur_utf16 += ascii;
+            cur += ascii;
+            dst_len -= ascii;
+            if (ascii != 0) continue;
+            ascii_retry = cur_utf16 + kAsciiBlock;
+        }
         char32_t utf32;
         // surrogate pairs
         if((*cur_utf16 & 0xFC00) == 0xD800 && (cur_utf16 + 1) < end_utf16
@@ -355,6 +485,46 @@ void utf16_to_utf8(const char16_t* src, size_t src_len, char* dst, size_t dst_le
     *cur = '\0';
 }
 
+size_t utf16_to_utf8_partial(const char16_t* src, size_t src_len, char* dst, size_t dst_len,
+                             size_t* src_read)
+{
+    const char16_t* cur_utf16 = src;
+    const char16_t* const end_utf16 = src + src_len;
+    char* cur = dst;
+    const char16_t* ascii_retry = src;
+    while (cur_utf16 < end_utf16) {
+        if (cur_utf16 >= ascii_retry && *cur_utf16 < 0x80) {
+            size_t src_left = end_utf16 - cur_utf16;
+            size_t ascii = utf16_ascii_run_to_utf8(cur_utf16,
+                    src_left < dst_len ? src_left : dst_len, cur);
+            cur_utf16 += ascii;
+            cur += ascii;
+            dst_len -= ascii;
+            if (ascii != 0) continue;
+            ascii_retry = cur_utf16 + kAsciiBlock;
+        }
+        char32_t utf32;
+        size_t units = 1;
+        if ((*cur_utf16 & 0xFC00) == 0xD800 && (cur_utf16 + 1) < end_utf16
+                && (*(cur_utf16 + 1) & 0xFC00) == 0xDC00) {
+            utf32 = ((cur_utf16[0] - 0xD800) << 10 | (cur_utf16[1] - 0xDC00)) + 0x10000;
+            units = 2;
+        } else {
+            utf32 = (char32_t) *cur_utf16;
+        }
+        const size_t len = utf32_codepoint_utf8_length(utf32);
+        if (len > dst_len) {
+            break;
+        }
+        utf32_codepoint_to_utf8((uint8_t*)cur, utf32, len);
+        cur_utf16 += units;
+        cur += len;
+        dst_len -= len;
+    }
+    *src_read = cur_utf16 - src;
+    return cur - dst;
+}
+
 // --------------------------------------------------------------------------
 // UTF-8
 // --------------------------------------------------------------------------
@@ -410,9 +580,19 @@ ssize_t utf16_to_utf8_length(const char16_t *src, size_t src_len)
 
     size_t ret = 0;
     const char16_t* const end = src + src_len;
+    const char16_t* ascii_retry = src;
     while (src < end) {
         size_t char_len;
-        if ((*src & 0xFC00) == 0xD800 && (src + 1) < end
+        if (src >= ascii_retry && *src < 0x80) {
+            char_len = utf16_ascii_run(src, end - src);
+            if (char_len != 0) {
+                src += char_len;
+            } else {
+                ascii_retry = src + kAsciiBlock;
+                char_len = 1;
+                src++;
+            }
+        } else if ((*src & 0xFC00) == 0xD800 && (src + 1) < end
                 && (*(src + 1) & 0xFC00) == 0xDC00) {
             // surrogate pairs are always 4 bytes.
             char_len = 4;
@@ -531,7 +711,15 @@ ssize_t utf8_to_utf16_length(const uint8_t* u8str, size_t u8len, bool overreadIs
 
     /* Validate that the UTF-8 is the correct len */
     size_t u16measuredLen = 0;
+    const uint8_t* ascii_retry = u8str;
     while (u8cur < u8end) {
+        if (u8cur >= ascii_retry && *u8cur < 0x80) {
+            size_t ascii = utf8_ascii_run(u8cur, u8end - u8cur);
+            u8cur += ascii;
+            u16measuredLen += ascii;
+            if (ascii != 0) continue;
+            ascii_retry = u8cur + kAsciiBlock;
+        }
         u16measuredLen++;
         int u8charLen = utf8_codepoint_len(*u8cur);
         // Malformed utf8, some characters are beyond the end.
@@ -583,8 +771,19 @@ char16_t* utf8_to_utf16_no_null_terminator(
     const uint8_t* u8cur = src;
     const char16_t* const u16end = dst + dstLen;
     char16_t* u16cur = dst;
+    const uint8_t* ascii_retry = src;
 
     while (u8cur < u8end && u16cur < u16end) {
+        if (u8cur >= ascii_retry && *u8cur < 0x80) {
+            size_t u8left = u8end - u8cur;
+            size_t u16left = u16end - u16cur;
+            size_t ascii = utf8_ascii_run_to_utf16(u8cur, u8left < u16left ? u8left : u16left,
+                    u16cur);
+            u8cur += ascii;
+            u16cur += ascii;
+            if (ascii != 0) continue;
+            ascii_retry = u8cur + kAsciiBlock;
+        }
         size_t u8len = utf8_codepoint_len(*u8cur);
         uint32_t codepoint = utf8_to_utf32_codepoint(u8cur, u8len);
 
@@ -608,4 +807,57 @@ char16_t* utf8_to_utf16_no_null_terminator(
     return u16cur;
 }
 
+ssize_t utf8_to_utf16_measure(const uint8_t* src, size_t srcLen, char16_t* dst, size_t dstLen)
+{
+    const uint8_t* const u8end = src + srcLen;
+    const uint8_t* u8cur = src;
+    char16_t* u16cur = dst;
+    // Keep room for the NUL terminator.
+    size_t room = (dst == nullptr || dstLen == 0) ? 0 : dstLen - 1;
+    const uint8_t* ascii_retry = src;
+    while (u8cur < u8end) {
+        if (u8cur >= ascii_retry && *u8cur < 0x80) {
+            size_t u8left = u8end - u8cur;
+            size_t ascii = utf8_ascii_run_to_utf16(u8cur, u8left < room ? u8left : room, u16cur);
+            u8cur += ascii;
+            u16cur += ascii;
+            room -= ascii;
+            if (ascii != 0) continue;
+            ascii_retry = u8cur + kAsciiBlock;
+        }
+        size_t u8charLen = utf8_codepoint_len(*u8cur);
+        // Same validation as utf8_to_utf16_length(): never read past the end.
+        if (u8cur + u8charLen - 1 >= u8end) {
+            return -1;
+        }
+        uint32_t codepoint = utf8_to_utf32_codepoint(u8cur, u8charLen);
+        if (codepoint <= 0xFFFF) {
+            if (room < 1) break;
+            *u16cur++ = (char16_t) codepoint;
+            room -= 1;
+        } else {
+            if (room < 2) break;
+            codepoint = codepoint - 0x10000;
+            *u16cur++ = (char16_t) ((codepoint >> 10) + 0xD800);
+            *u16cur++ = (char16_t) ((codepoint & 0x3FF) + 0xDC00);
+            room -= 2;
+        }
+        u8cur += u8charLen;
+    }
+
+    const size_t written = u16cur - dst;
+    if (u8cur == u8end) {
+        if (dst != nullptr && dstLen != 0) {
+            *u16cur = 0;
+        }
+        return written;
+    }
+    // Out of room: only measure (and validate) the rest.
+    const ssize_t rest = utf8_to_utf16_length(u8cur, u8end - u8cur);
+    if (rest < 0) {
+        return -1;
+    }
+    return written + rest;
+}
+
 }
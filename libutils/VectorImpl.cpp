@@ -132,6 +132,13 @@ ssize_t VectorImpl::insertArrayAt(const void* array, size_t index, size_t length
     return where ? index : (ssize_t)NO_MEMORY;
 }
 
+void* VectorImpl::insertUninitializedAt(size_t index, size_t numItems)
+{
+    if (index > size())
+        return nullptr;
+    return _grow(index, numItems);
+}
+
 ssize_t VectorImpl::appendArray(const void* array, size_t length)
 {
     return insertArrayAt(array, size(), length);
@@ -407,11 +414,9 @@ void* VectorImpl::_grow(size_t where, size_t amount)
                             "new_alloc_size overflow");
 
         // ALOGV("grow vector %p, new_capacity=%d", this, (int)new_capacity);
-        if ((mStorage) &&
-            (mCount==where) &&
-            (mFlags & HAS_TRIVIAL_COPY) &&
-            (mFlags & HAS_TRIVIAL_DTOR))
-        {
+        if (_can_relocate()) {
+            // realloc() moves the items for us, and the tail only needs a
+            // memmove instead of a copy and destroy of every item.
             const SharedBuffer* cur_sb = SharedBuffer::bufferFromData(mStorage);
             SharedBuffer* sb = cur_sb->editResize(new_alloc_size);
             if (sb) {
@@ -419,6 +424,11 @@ void* VectorImpl::_grow(size_t where, size_t amount)
             } else {
                 return nullptr;
             }
+            if (where != mCount) {
+                uint8_t* array = reinterpret_cast<uint8_t *>(mStorage);
+                memmove(array + (where+amount)*mItemSize, array + where*mItemSize,
+                        (mCount-where)*mItemSize);
+            }
         } else {
             SharedBuffer* sb = SharedBuffer::alloc(new_alloc_size);
             if (sb) {
@@ -475,10 +485,25 @@ void VectorImpl::_shrink(size_t where, size_t amount)
         // we are always reducing the capacity of the underlying SharedBuffer.
         // In other words, (old_capacity * mItemSize) did not overflow, and
         // where < (where + amount) < new_capacity < old_capacity.
-        if ((where == new_size) &&
-            (mFlags & HAS_TRIVIAL_COPY) &&
-            (mFlags & HAS_TRIVIAL_DTOR))
-        {
+        if (_can_relocate() && SharedBuffer::bufferFromData(mStorage)->onlyOwner()) {
+            uint8_t* array = reinterpret_cast<uint8_t *>(mStorage);
+            _do_destroy(array + where*mItemSize, amount);
+            if (where != new_size) {
+                memmove(array + where*mItemSize, array + (where+amount)*mItemSize,
+                        (new_size-where)*mItemSize);
+            }
+            // Only shrinks the allocation; on failure the items stay where
+            // they are now.
+            mCount = new_size;
+            const SharedBuffer* cur_sb = SharedBuffer::bufferFromData(mStorage);
+            SharedBuffer* sb = cur_sb->editResize(new_capacity * mItemSize);
+            if (sb) {
+                mStorage = sb->data();
+            }
+            return;
+        } else if ((where == new_size) &&
+                   (mFlags & HAS_TRIVIAL_COPY) &&
+                   (mFlags & HAS_TRIVIAL_DTOR)) {
             const SharedBuffer* cur_sb = SharedBuffer::bufferFromData(mStorage);
             SharedBuffer* sb = cur_sb->editResize(new_capacity * mItemSize);
             if (sb) {
@@ -548,11 +573,31 @@ void VectorImpl::_do_splat(void* dest, const void* item, size_t num) const {
 }
 
 void VectorImpl::_do_move_forward(void* dest, const void* from, size_t num) const {
-    do_move_forward(dest, from, num);
+    if (mFlags & HAS_TRIVIAL_MOVE) {
+        memmove(dest, from, num*itemSize());
+    } else {
+        do_move_forward(dest, from, num);
+    }
 }
 
 void VectorImpl::_do_move_backward(void* dest, const void* from, size_t num) const {
-    do_move_backward(dest, from, num);
+    if (mFlags & HAS_TRIVIAL_MOVE) {
+        memmove(dest, from, num*itemSize());
+    } else {
+        do_move_backward(dest, from, num);
+    }
+}
+
+bool VectorImpl::_can_relocate() const {
+    if (!mStorage) {
+        return false;
+    }
+    if ((mFlags & HAS_TRIVIAL_COPY) && (mFlags & HAS_TRIVIAL_DTOR)) {
+        return true;
+    }
+    // Moving the items out of a buffer that other vectors still share would
+    // leave them pointing at moved-from items, so those get copied instead.
+    return (mFlags & HAS_TRIVIAL_MOVE) && SharedBuffer::bufferFromData(mStorage)->onlyOwner();
 }
 
 /*****************************************************************************/
@@ -40,6 +40,8 @@
 
 #define ALWAYS_INLINE __attribute__((always_inline))
 
+class BacktraceMap;
+
 namespace android {
 
 class Printer;
@@ -61,6 +63,11 @@ public:
     // The default is to dump the stack of the current call.
     void update(int32_t ignoreDepth = 1, pid_t tid = BACKTRACE_CURRENT_THREAD);
 
+    // Same, but unwinds with |map| instead of a new snapshot of the process's maps.
+    // Sharing one map between several, possibly concurrent, updates avoids reading the
+    // maps and parsing the ELF files again for each of them.
+    void update(int32_t ignoreDepth, pid_t tid, BacktraceMap* map);
+
     // Dump a stack trace to the log using the supplied logtag.
     void log(const char* logtag,
              android_LogPriority priority = ANDROID_LOG_DEBUG,
@@ -66,6 +66,28 @@ public:
     bool create(const char* origFileName, int fd,
                 off64_t offset, size_t length, bool readOnly);
 
+    /*
+     * Hints for create().  They are ignored where the OS doesn't support
+     * them.
+     *
+     * POPULATE reads the whole range in when it is mapped (MAP_POPULATE),
+     * rather than faulting each page in on first access.
+     *
+     * HUGE_PAGES asks for transparent huge pages (MADV_HUGEPAGE) where the
+     * file system supports them, and places the mapping so that its file
+     * offsets line up with huge page boundaries.
+     */
+    enum CreateFlags {
+        POPULATE = 1 << 0,
+        HUGE_PAGES = 1 << 1,
+    };
+
+    /*
+     * Like create() above, with a combination of CreateFlags.
+     */
+    bool create(const char* origFileName, int fd,
+                off64_t offset, size_t length, bool readOnly, int flags);
+
     ~FileMap(void);
 
     /*
@@ -93,7 +115,7 @@ public:
      * including <sys/mman.h> everywhere.
      */
     enum MapAdvice {
-        NORMAL, RANDOM, SEQUENTIAL, WILLNEED, DONTNEED
+        NORMAL, RANDOM, SEQUENTIAL, WILLNEED, DONTNEED, HUGEPAGE
     };
 
     /*
@@ -103,6 +125,15 @@ public:
      */
     int advise(MapAdvice advice);
 
+    /*
+     * Apply an madvise() call to "length" bytes at "offset" into the
+     * requested data, for example WILLNEED to read a range ahead.  The range
+     * is widened to page boundaries and clamped to the mapping.
+     *
+     * Returns 0 on success, -1 on failure.
+     */
+    int advise(MapAdvice advice, size_t offset, size_t length);
+
 protected:
 
 private:
@@ -0,0 +1,273 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_UTILS_FLAT_MAP_H
+#define ANDROID_UTILS_FLAT_MAP_H
+
+#include <stdint.h>
+#include <string.h>
+#include <sys/types.h>
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+#include <log/log.h>
+#include <utils/Errors.h>
+#include <utils/KeyedVector.h>
+#include <utils/TypeHelpers.h>
+
+namespace android {
+
+/**
+ * A map kept as one sorted, contiguous std::vector of key/value pairs, with
+ * the accessors of KeyedVector.
+ *
+ * Entries are moved rather than copied through the type helpers, and a map
+ * that is filled in one go should be built with fromUnsorted(), which sorts
+ * once instead of shifting the tail of the array on every add(). When both the
+ * key and the value have ANDROID_TRIVIAL_MOVE_TRAIT, entries are relocated
+ * with memmove like Vector does, since the moves of such types (String8 for
+ * one) can still cost a reference count update each. Keys are ordered with
+ * strictly_order_type(), like KeyedVector.
+ *
+ * Indices, references and iterators are invalidated by any change to the map.
+ */
+template <typename TKey, typename TValue>
+class FlatMap {
+public:
+    typedef std::pair<TKey, TValue> value_type;
+    typedef typename std::vector<value_type>::const_iterator const_iterator;
+
+    FlatMap() = default;
+
+    // Builds the map from |entries| in any order. Of several entries with the
+    // same key, the last one wins, as if they had been add()ed in order.
+    static FlatMap fromUnsorted(std::vector<value_type> entries);
+
+    // Builds the map from |entries| that are already sorted by key, without
+    // duplicates.
+    static FlatMap fromSortedUnique(std::vector<value_type> entries);
+
+    // Copies a KeyedVector, which is always sorted.
+    explicit FlatMap(const KeyedVector<TKey, TValue>& keyedVector);
+    KeyedVector<TKey, TValue> toKeyedVector() const;
+
+    void clear() { mEntries.clear(); }
+    size_t size() const { return mEntries.size(); }
+    bool isEmpty() const { return mEntries.empty(); }
+    size_t capacity() const { return mEntries.capacity(); }
+    void reserve(size_t size) { mEntries.reserve(size); }
+
+    const_iterator begin() const { return mEntries.begin(); }
+    const_iterator end() const { return mEntries.end(); }
+
+    // Returns the index of |key|, or NAME_NOT_FOUND.
+    ssize_t indexOfKey(const TKey& key) const;
+    const TKey& keyAt(size_t index) const { return mEntries[index].first; }
+    const TValue& valueAt(size_t index) const { return mEntries[index].second; }
+    TValue& editValueAt(size_t index) { return mEntries[index].second; }
+    // |key| must be in the map.
+    const TValue& valueFor(const TKey& key) const;
+    TValue& editValueFor(const TKey& key);
+
+    // Adds |key|, or replaces its value if it is already present. Returns the
+    // index of the entry.
+    template <typename K, typename V>
+    ssize_t add(K&& key, V&& value);
+
+    // Returns the index the key was at, or NAME_NOT_FOUND.
+    ssize_t removeItem(const TKey& key);
+    ssize_t removeItemsAt(size_t index, size_t count = 1);
+
+private:
+    enum { kTrivialMove = aggregate_traits<TKey, TValue>::has_trivial_move };
+
+    explicit FlatMap(std::vector<value_type>&& entries) : mEntries(std::move(entries)) {}
+
+    // Sorts |entries| stably by key, relocating each entry at most once.
+    static void sortTrivial(std::vector<value_type>* entries);
+
+    static bool keyLess(const value_type& entry, const TKey& key) {
+        return strictly_order_type(entry.first, key);
+    }
+
+    typename std::vector<value_type>::iterator lowerBound(const TKey& key) {
+        return std::lower_bound(mEntries.begin(), mEntries.end(), key, keyLess);
+    }
+    const_iterator lowerBound(const TKey& key) const {
+        return std::lower_bound(mEntries.begin(), mEntries.end(), key, keyLess);
+    }
+
+    std::vector<value_type> mEntries;
+};
+
+// Implementation is here, because it's fully templated
+template <typename TKey, typename TValue>
+void FlatMap<TKey, TValue>::sortTrivial(std::vector<value_type>* entries) {
+    // Sort a permutation, then apply it one cycle at a time with memcpy.
+    size_t count = entries->size();
+    value_type* data = entries->data();
+    std::vector<uint32_t> order(count);
+    for (size_t i = 0; i < count; i++) {
+        order[i] = i;
+    }
+    std::stable_sort(order.begin(), order.end(), [data](uint32_t lhs, uint32_t rhs) {
+        return strictly_order_type(data[lhs].first, data[rhs].first);
+    });
+
+    alignas(value_type) unsigned char tmp[sizeof(value_type)];
+    for (size_t start = 0; start < count; start++) {
+        if (order[start] == start) {
+            continue;
+        }
+        memcpy(tmp, static_cast<void*>(&data[start]), sizeof(value_type));
+        size_t hole = start;
+        while (order[hole] != start) {
+            size_t from = order[hole];
+            memcpy(static_cast<void*>(&data[hole]), static_cast<void*>(&data[from]),
+                   sizeof(value_type));
+            order[hole] = hole;
+            hole = from;
+        }
+        memcpy(static_cast<void*>(&data[hole]), tmp, sizeof(value_type));
+        order[hole] = hole;
+    }
+}
+
+template <typename TKey, typename TValue>
+FlatMap<TKey, TValue> FlatMap<TKey, TValue>::fromUnsorted(std::vector<value_type> entries) {
+    if (kTrivialMove) {
+        sortTrivial(&entries);
+    } else {
+        std::stable_sort(entries.begin(), entries.end(),
+                         [](const value_type& lhs, const value_type& rhs) {
+                             return strictly_order_type(lhs.first, rhs.first);
+                         });
+    }
+    // Keep the last entry of each run of equal keys.
+    auto out = entries.begin();
+    for (auto it = entries.begin(); it != entries.end(); ++it) {
+        auto next = it + 1;
+        if (next != entries.end() && !strictly_order_type(it->first, next->first)) {
+            continue;
+        }
+        if (out != it) {
+            *out = std::move(*it);
+        }
+        ++out;
+    }
+    entries.erase(out, entries.end());
+    return FlatMap(std::move(entries));
+}
+
+template <typename TKey, typename TValue>
+FlatMap<TKey, TValue> FlatMap<TKey, TValue>::fromSortedUnique(std::vector<value_type> entries) {
+    return FlatMap(std::move(entries));
+}
+
+template <typename TKey, typename TValue>
+FlatMap<TKey, TValue>::FlatMap(const KeyedVector<TKey, TValue>& keyedVector) {
+    mEntries.reserve(keyedVector.size());
+    for (size_t i = 0; i < keyedVector.size(); i++) {
+        mEntries.emplace_back(keyedVector.keyAt(i), keyedVector.valueAt(i));
+    }
+}
+
+template <typename TKey, typename TValue>
+KeyedVector<TKey, TValue> FlatMap<TKey, TValue>::toKeyedVector() const {
+    KeyedVector<TKey, TValue> keyedVector;
+    keyedVector.setCapacity(mEntries.size());
+    // In key order, so that each add() appends without moving anything.
+    for (const auto& entry : mEntries) {
+        keyedVector.add(entry.first, entry.second);
+    }
+    return keyedVector;
+}
+
+template <typename TKey, typename TValue>
+ssize_t FlatMap<TKey, TValue>::indexOfKey(const TKey& key) const {
+    auto it = lowerBound(key);
+    if (it == mEntries.end() || strictly_order_type(key, it->first)) {
+        return NAME_NOT_FOUND;
+    }
+    return it - mEntries.begin();
+}
+
+template <typename TKey, typename TValue>
+const TValue& FlatMap<TKey, TValue>::valueFor(const TKey& key) const {
+    ssize_t i = indexOfKey(key);
+    LOG_ALWAYS_FATAL_IF(i < 0, "%s: key not found", __PRETTY_FUNCTION__);
+    return mEntries[i].second;
+}
+
+template <typename TKey, typename TValue>
+TValue& FlatMap<TKey, TValue>::editValueFor(const TKey& key) {
+    ssize_t i = indexOfKey(key);
+    LOG_ALWAYS_FATAL_IF(i < 0, "%s: key not found", __PRETTY_FUNCTION__);
+    return mEntries[i].second;
+}
+
+template <typename TKey, typename TValue>
+template <typename K, typename V>
+ssize_t FlatMap<TKey, TValue>::add(K&& key, V&& value) {
+    auto it = lowerBound(key);
+    if (it != mEntries.end() && !strictly_order_type(key, it->first)) {
+        it->second = std::forward<V>(value);
+        return it - mEntries.begin();
+    }
+    if (!kTrivialMove) {
+        it = mEntries.emplace(it, std::forward<K>(key), std::forward<V>(value));
+        return it - mEntries.begin();
+    }
+
+    // Append, then relocate the new entry into place with a single memmove of
+    // the tail.
+    size_t index = it - mEntries.begin();
+    mEntries.emplace_back(std::forward<K>(key), std::forward<V>(value));
+    value_type* data = mEntries.data();
+    size_t last = mEntries.size() - 1;
+    if (index != last) {
+        alignas(value_type) unsigned char tmp[sizeof(value_type)];
+        memcpy(tmp, static_cast<void*>(&data[last]), sizeof(value_type));
+        memmove(static_cast<void*>(&data[index + 1]), static_cast<void*>(&data[index]),
+                (last - index) * sizeof(value_type));
+        memcpy(static_cast<void*>(&data[index]), tmp, sizeof(value_type));
+    }
+    return index;
+}
+
+template <typename TKey, typename TValue>
+ssize_t FlatMap<TKey, TValue>::removeItem(const TKey& key) {
+    ssize_t i = indexOfKey(key);
+    if (i >= 0) {
+        mEntries.erase(mEntries.begin() + i);
+    }
+    return i;
+}
+
+template <typename TKey, typename TValue>
+ssize_t FlatMap<TKey, TValue>::removeItemsAt(size_t index, size_t count) {
+    if (index > mEntries.size() || count > mEntries.size() - index) {
+        return BAD_INDEX;
+    }
+    mEntries.erase(mEntries.begin() + index, mEntries.begin() + index + count);
+    return index;
+}
+
+}  // namespace android
+
+#endif  // ANDROID_UTILS_FLAT_MAP_H
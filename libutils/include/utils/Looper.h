@@ -24,6 +24,8 @@
 
 #include <sys/epoll.h>
 
+#include <vector>
+
 #include <android-base/unique_fd.h>
 
 namespace android {
@@ -436,23 +438,36 @@ private:
     };
 
     struct MessageEnvelope {
-        MessageEnvelope() : uptime(0) { }
+        MessageEnvelope() : uptime(0), seq(0) { }
 
-        MessageEnvelope(nsecs_t u, const sp<MessageHandler> h,
-                const Message& m) : uptime(u), handler(h), message(m) {
+        MessageEnvelope(nsecs_t u, uint64_t s, const sp<MessageHandler> h,
+                const Message& m) : uptime(u), seq(s), handler(h), message(m) {
         }
 
         nsecs_t uptime;
+        // Breaks ties between messages due at the same time, so that they are
+        // delivered in the order in which they were sent.
+        uint64_t seq;
         sp<MessageHandler> handler;
         Message message;
     };
 
+    // Heap comparator that keeps the earliest message at the front.
+    struct MessageEnvelopeLater {
+        bool operator()(const MessageEnvelope& lhs, const MessageEnvelope& rhs) const {
+            return lhs.uptime > rhs.uptime || (lhs.uptime == rhs.uptime && lhs.seq > rhs.seq);
+        }
+    };
+
     const bool mAllowNonCallbacks; // immutable
 
     android::base::unique_fd mWakeEventFd;  // immutable
     Mutex mLock;
 
-    Vector<MessageEnvelope> mMessageEnvelopes; // guarded by mLock
+    // Min-heap ordered by MessageEnvelopeLater, so that sending a message is
+    // O(log n) no matter how many delayed messages are queued.
+    std::vector<MessageEnvelope> mMessageEnvelopes; // guarded by mLock
+    uint64_t mNextMessageSeq; // guarded by mLock
     bool mSendingMessage; // guarded by mLock
 
     // Whether we are currently waiting for work.  Not protected by a lock,
@@ -471,11 +486,14 @@ private:
     Vector<Response> mResponses;
     size_t mResponseIndex;
     nsecs_t mNextMessageUptime; // set to LLONG_MAX when none
+    std::vector<struct epoll_event> mEpollEvents; // grows while polls keep filling it
 
     int pollInner(int timeoutMillis);
     int removeFd(int fd, int seq);
     void awoken();
     void pushResponse(int events, const Request& request);
+    template <typename Predicate>
+    void removeMessagesLocked(Predicate predicate);
     void rebuildEpollLocked();
     void scheduleEpollRebuildLocked();
 
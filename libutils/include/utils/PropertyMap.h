@@ -17,6 +17,7 @@
 #ifndef _UTILS_PROPERTY_MAP_H
 #define _UTILS_PROPERTY_MAP_H
 
+#include <utils/FlatMap.h>
 #include <utils/KeyedVector.h>
 #include <utils/String8.h>
 #include <utils/Errors.h>
@@ -75,7 +76,12 @@ public:
     void addAll(const PropertyMap* map);
 
     /* Gets the underlying property map. */
-    inline const KeyedVector<String8, String8>& getProperties() const { return mProperties; }
+    inline const FlatMap<String8, String8>& getFlatProperties() const { return mProperties; }
+
+    /* Gets a copy of the property map as a KeyedVector, kept until the map next changes.
+     * Prefer getFlatProperties(), which does not copy.
+     */
+    const KeyedVector<String8, String8>& getProperties() const;
 
     /* Loads a property map from a file. */
     static status_t load(const String8& filename, PropertyMap** outMap);
@@ -98,7 +104,9 @@ private:
         status_t parseCharacterLiteral(char16_t* outCharacter);
     };
 
-    KeyedVector<String8, String8> mProperties;
+    FlatMap<String8, String8> mProperties;
+    mutable KeyedVector<String8, String8> mKeyedProperties;
+    mutable bool mKeyedPropertiesValid = false;
 };
 
 } // namespace android
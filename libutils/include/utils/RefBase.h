@@ -327,6 +327,7 @@ protected:
 
 private:
     friend class weakref_type;
+    friend class LightWeakRefBase;
     class weakref_impl;
     
                             RefBase(const RefBase& o);
@@ -348,6 +349,80 @@ private:
 
 // ---------------------------------------------------------------------------
 
+// LightWeakRefBase is a cheaper RefBase for the many objects that never, or
+// only rarely, get a wp<>. Like LightRefBase, it keeps the strong count in
+// the object itself: creating one does not allocate, and incStrong() and
+// decStrong() are a single atomic operation. The weakref_type that RefBase
+// allocates up front is only created by the first createWeak(), after which
+// the counts live there and wp<> behaves exactly as it does for RefBase.
+//
+// Compared to RefBase, there are no onFirstRef()/onLastStrongRef() callbacks
+// and no extendObjectLifetime(), an object that never had a strong reference
+// cannot be promoted, and weakref_type::refBase() returns nullptr.
+class LightWeakRefBase
+{
+public:
+    inline void incStrong(const void* id) const {
+        uintptr_t state = mState.load(std::memory_order_relaxed);
+        while ((state & kShared) == 0) {
+            if (mState.compare_exchange_weak(state, state + kOneStrong,
+                    std::memory_order_relaxed)) {
+                return;
+            }
+        }
+        incStrongShared(id);
+    }
+    inline void decStrong(const void* id) const {
+        uintptr_t state = mState.load(std::memory_order_relaxed);
+        while ((state & kShared) == 0) {
+            if (mState.compare_exchange_weak(state, state - kOneStrong,
+                    std::memory_order_release, std::memory_order_relaxed)) {
+                if (state == kOneStrong) {
+                    std::atomic_thread_fence(std::memory_order_acquire);
+                    delete this;
+                }
+                return;
+            }
+        }
+        decStrongShared(id);
+    }
+
+            //! DEBUGGING ONLY: Get current strong ref count.
+            int32_t         getStrongCount() const;
+
+            RefBase::weakref_type* createWeak(const void* id) const;
+
+    typedef LightWeakRefBase basetype;
+
+protected:
+    inline                  LightWeakRefBase() : mState(0) { }
+    virtual                 ~LightWeakRefBase();
+
+private:
+                            LightWeakRefBase(const LightWeakRefBase& o);
+            LightWeakRefBase& operator=(const LightWeakRefBase& o);
+
+    // While kShared is clear, mState is the strong count times kOneStrong.
+    // Once set, the rest of mState is the weakref_impl holding the counts.
+    static constexpr uintptr_t kShared = 1;
+    static constexpr uintptr_t kOneStrong = 2;
+
+            void            incStrongShared(const void* id) const;
+            void            decStrongShared(const void* id) const;
+
+private:
+    friend class ReferenceMover;
+    inline static void renameRefs(size_t /*n*/, const ReferenceRenamer& /*renamer*/) { }
+    inline static void renameRefId(RefBase::weakref_type* /*ref*/,
+            const void* /*old_id*/, const void* /*new_id*/) { }
+    inline static void renameRefId(LightWeakRefBase* /*ref*/,
+            const void* /*old_id*/, const void* /*new_id*/) { }
+
+    mutable std::atomic<uintptr_t> mState;
+};
+
+// ---------------------------------------------------------------------------
+
 template <typename T>
 class wp
 {
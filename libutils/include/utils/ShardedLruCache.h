@@ -0,0 +1,162 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_UTILS_SHARDED_LRU_CACHE_H
+#define ANDROID_UTILS_SHARDED_LRU_CACHE_H
+
+#include <stdint.h>
+
+#include <memory>
+#include <vector>
+
+#include "utils/LruCache.h"
+#include "utils/Mutex.h"
+#include "utils/TypeHelpers.h"  // hash_t
+
+namespace android {
+
+/**
+ * A thread-safe LruCache, split into independently locked shards.
+ *
+ * Keys are spread over the shards by hash_type(), so the key requirements are
+ * the same as for LruCache. Each shard is an LruCache with its own lock and an
+ * equal part of the capacity, so eviction is least-recently-used per shard
+ * rather than across the whole cache. Threads touching keys in different
+ * shards never contend.
+ *
+ * Unlike LruCache, get() returns the value by copy since a reference could be
+ * invalidated by another thread as soon as the shard is unlocked.
+ */
+template <typename TKey, typename TValue>
+class ShardedLruCache {
+public:
+    static constexpr uint32_t kDefaultShardCount = 16;
+
+    // |maxCapacity| may be LruCache::kUnlimitedCapacity. |shardCount| is
+    // rounded up to a power of two.
+    explicit ShardedLruCache(uint32_t maxCapacity, uint32_t shardCount = kDefaultShardCount);
+
+    // The listener is called with the shard lock held; it must not call back
+    // into the cache and must be safe to call from several threads at once.
+    void setOnEntryRemovedListener(OnEntryRemoved<TKey, TValue>* listener);
+
+    // Total number of entries. Only a snapshot if other threads are writing.
+    size_t size() const;
+    uint32_t shardCount() const { return mShards.size(); }
+
+    TValue get(const TKey& key);
+    bool put(const TKey& key, const TValue& value);
+    bool remove(const TKey& key);
+    void clear();
+
+private:
+    ShardedLruCache(const ShardedLruCache& that);  // disallow copy constructor
+
+    // Aligned so that two shards' locks never share a cache line.
+    struct alignas(64) Shard {
+        explicit Shard(uint32_t maxCapacity) : cache(maxCapacity) {}
+
+        mutable Mutex lock;
+        LruCache<TKey, TValue> cache GUARDED_BY(lock);
+    };
+
+    Shard& shardFor(const TKey& key) {
+        // LruCache buckets its entries by the same hash, so pick the shard
+        // from the high bits of a mixed hash to keep the low bits spread out
+        // within each shard.
+        uint32_t hash = static_cast<uint32_t>(hash_type(key)) * 0x9e3779b9u;
+        return *mShards[(hash >> mShardShift) & (mShards.size() - 1)];
+    }
+
+    std::vector<std::unique_ptr<Shard>> mShards;
+    uint32_t mShardShift;
+};
+
+// Implementation is here, because it's fully templated
+template <typename TKey, typename TValue>
+ShardedLruCache<TKey, TValue>::ShardedLruCache(uint32_t maxCapacity, uint32_t shardCount) {
+    uint32_t shardBits = 0;
+    while ((1u << shardBits) < shardCount && shardBits < 16) {
+        shardBits++;
+    }
+    shardCount = 1u << shardBits;
+    mShardShift = 32 - shardBits;
+    if (shardBits == 0) {
+        // A shift by 32 is undefined; the mask discards the result anyway.
+        mShardShift = 0;
+    }
+
+    uint32_t shardCapacity = LruCache<TKey, TValue>::kUnlimitedCapacity;
+    if (maxCapacity != LruCache<TKey, TValue>::kUnlimitedCapacity) {
+        shardCapacity = (maxCapacity + shardCount - 1) / shardCount;
+    }
+    mShards.reserve(shardCount);
+    for (uint32_t i = 0; i < shardCount; i++) {
+        mShards.emplace_back(new Shard(shardCapacity));
+    }
+}
+
+template <typename TKey, typename TValue>
+void ShardedLruCache<TKey, TValue>::setOnEntryRemovedListener(
+        OnEntryRemoved<TKey, TValue>* listener) {
+    for (auto& shard : mShards) {
+        Mutex::Autolock _l(shard->lock);
+        shard->cache.setOnEntryRemovedListener(listener);
+    }
+}
+
+template <typename TKey, typename TValue>
+size_t ShardedLruCache<TKey, TValue>::size() const {
+    size_t size = 0;
+    for (const auto& shard : mShards) {
+        Mutex::Autolock _l(shard->lock);
+        size += shard->cache.size();
+    }
+    return size;
+}
+
+template <typename TKey, typename TValue>
+TValue ShardedLruCache<TKey, TValue>::get(const TKey& key) {
+    Shard& shard = shardFor(key);
+    Mutex::Autolock _l(shard.lock);
+    return shard.cache.get(key);
+}
+
+template <typename TKey, typename TValue>
+bool ShardedLruCache<TKey, TValue>::put(const TKey& key, const TValue& value) {
+    Shard& shard = shardFor(key);
+    Mutex::Autolock _l(shard.lock);
+    return shard.cache.put(key, value);
+}
+
+template <typename TKey, typename TValue>
+bool ShardedLruCache<TKey, TValue>::remove(const TKey& key) {
+    Shard& shard = shardFor(key);
+    Mutex::Autolock _l(shard.lock);
+    return shard.cache.remove(key);
+}
+
+template <typename TKey, typename TValue>
+void ShardedLruCache<TKey, TValue>::clear() {
+    for (auto& shard : mShards) {
+        Mutex::Autolock _l(shard->lock);
+        shard->cache.clear();
+    }
+}
+
+}  // namespace android
+
+#endif  // ANDROID_UTILS_SHARDED_LRU_CACHE_H
@@ -50,6 +50,7 @@ public:
                                 String8();
     explicit                    String8(StaticLinkage);
                                 String8(const String8& o);
+                                String8(String8&& o) noexcept;
     explicit                    String8(const char* o);
     explicit                    String8(const char* o, size_t numChars);
 
@@ -103,6 +104,7 @@ public:
             void                getUtf32(char32_t* dst) const;
 
     inline  String8&            operator=(const String8& other);
+            String8&            operator=(String8&& other) noexcept;
     inline  String8&            operator=(const char* other);
 
     inline  String8&            operator+=(const String8& other);
@@ -18,6 +18,7 @@
 #define _UTILS_TOKENIZER_H
 
 #include <assert.h>
+#include <string_view>
 #include <utils/Errors.h>
 #include <utils/FileMap.h>
 #include <utils/String8.h>
@@ -26,6 +27,10 @@ namespace android {
 
 /**
  * A simple tokenizer for loading and parsing ASCII text files line by line.
+ *
+ * Files are memory mapped where possible. The *View() accessors return
+ * pieces of that mapping without copying them, and stay valid for as long as
+ * the tokenizer does.
  */
 class Tokenizer {
     Tokenizer(const String8& filename, FileMap* fileMap, char* buffer,
@@ -88,6 +93,11 @@ public:
      */
     String8 peekRemainderOfLine() const;
 
+    /**
+     * Like peekRemainderOfLine(), without copying the line.
+     */
+    std::string_view peekRemainderOfLineView() const;
+
     /**
      * Gets the character at the current position and advances past it.
      * Returns null at end of file.
@@ -103,6 +113,11 @@ public:
      */
     String8 nextToken(const char* delimiters);
 
+    /**
+     * Like nextToken(), without copying the token, so that it doesn't allocate.
+     */
+    std::string_view nextTokenView(const char* delimiters);
+
     /**
      * Advances to the next line.
      * Does nothing if already at the end of the file.
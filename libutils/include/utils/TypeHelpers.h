@@ -19,6 +19,7 @@
 
 #include <new>
 #include <type_traits>
+#include <utility>
 
 #include <stdint.h>
 #include <string.h>
@@ -35,7 +36,11 @@ namespace android {
 template <typename T> struct trait_trivial_ctor { enum { value = false }; };
 template <typename T> struct trait_trivial_dtor { enum { value = false }; };
 template <typename T> struct trait_trivial_copy { enum { value = false }; };
-template <typename T> struct trait_trivial_move { enum { value = false }; };
+// Trivially copyable types can always be relocated with memmove; other types
+// opt in with ANDROID_TRIVIAL_MOVE_TRAIT.
+template <typename T> struct trait_trivial_move {
+    enum { value = std::is_trivially_copyable<T>::value };
+};
 template <typename T> struct trait_pointer      { enum { value = false }; };
 template <typename T> struct trait_pointer<T*>  { enum { value = true }; };
 
@@ -208,7 +213,8 @@ move_forward_type(TYPE* d, const TYPE* s, size_t n = 1) {
         n--;
         --d, --s;
         if (!traits<TYPE>::has_trivial_copy) {
-            new(d) TYPE(*s);
+            // |s| is destroyed right below, so it can be moved from.
+            new(d) TYPE(std::move(*const_cast<TYPE*>(s)));
         } else {
             *d = *s;
         }
@@ -232,7 +238,7 @@ move_backward_type(TYPE* d, const TYPE* s, size_t n = 1) {
     while (n > 0) {
         n--;
         if (!traits<TYPE>::has_trivial_copy) {
-            new(d) TYPE(*s);
+            new(d) TYPE(std::move(*const_cast<TYPE*>(s)));
         } else {
             *d = *s;
         }
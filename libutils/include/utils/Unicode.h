@@ -110,6 +110,17 @@ ssize_t utf16_to_utf8_length(const char16_t *src, size_t src_len);
  */
 void utf16_to_utf8(const char16_t* src, size_t src_len, char* dst, size_t dst_len);
 
+/**
+ * Converts the start of a UTF-16 string to UTF-8: as many whole characters as
+ * fit in "dst_len" bytes, without a NUL terminator. Stores the number of code
+ * units converted in "src_read" and returns the number of bytes written. The
+ * rest of "src" can then be measured and converted on its own, which lets a
+ * caller convert into a buffer sized for the common case and grow it only if
+ * needed. "dst" may be NULL if "dst_len" is 0.
+ */
+size_t utf16_to_utf8_partial(const char16_t* src, size_t src_len, char* dst, size_t dst_len,
+                             size_t* src_read);
+
 /**
  * Returns the length of "src" when "src" is valid UTF-8 string.
  * Returns 0 if src is NULL or 0-length string. Returns -1 when the source
@@ -169,6 +180,19 @@ char16_t* utf8_to_utf16_no_null_terminator(
 char16_t *utf8_to_utf16(
         const uint8_t* src, size_t srcLen, char16_t* dst, size_t dstLen);
 
+/**
+ * Converts UTF-8 to UTF-16 and measures it in a single pass, validating it as
+ * utf8_to_utf16_length does: writes as many whole characters as fit in
+ * dstLen - 1 code units, followed by a NUL terminator if the whole string
+ * fit, and returns the UTF-16 length of the whole string, or -1 if it is
+ * invalid. The conversion is complete if the result is less than dstLen.
+ * dst may be NULL if dstLen is 0.
+ *
+ * UTF-16 never needs more code units than UTF-8 has bytes, so a dstLen of
+ * srcLen + 1 always converts in one pass.
+ */
+ssize_t utf8_to_utf16_measure(const uint8_t* src, size_t srcLen, char16_t* dst, size_t dstLen);
+
 }
 
 #endif
@@ -154,16 +154,20 @@ public:
     inline  ssize_t         insertAt(size_t index, size_t numItems = 1);
     //! insert one or several items initialized from a prototype item
             ssize_t         insertAt(const TYPE& prototype_item, size_t index, size_t numItems = 1);
+    //! insert an item by moving it in
+            ssize_t         insertAt(TYPE&& item, size_t index);
     //! pop the top of the stack (removes the last element). No-op if the stack's empty
     inline  void            pop();
     //! pushes an item initialized with its default constructor
     inline  void            push();
     //! pushes an item on the top of the stack
             void            push(const TYPE& item);
+            void            push(TYPE&& item);
     //! same as push() but returns the index the item was added at (or an error)
     inline  ssize_t         add();
     //! same as push() but returns the index the item was added at (or an error)
             ssize_t         add(const TYPE& item);
+            ssize_t         add(TYPE&& item);
     //! replace an item with a new one initialized with its default constructor
     inline  ssize_t         replaceAt(size_t index);
     //! replace an item with a new one
@@ -206,6 +210,7 @@ public:
      inline void reserve(size_t n) { setCapacity(n); }
      inline bool empty() const{ return isEmpty(); }
      inline void push_back(const TYPE& item)  { insertAt(item, size(), 1); }
+     inline void push_back(TYPE&& item)       { insertAt(std::move(item), size()); }
      inline void push_front(const TYPE& item) { insertAt(item, 0, 1); }
      inline iterator erase(iterator pos) {
          ssize_t index = removeItemsAt(static_cast<size_t>(pos-array()));
@@ -230,7 +235,8 @@ Vector<TYPE>::Vector()
     : VectorImpl(sizeof(TYPE),
                 ((traits<TYPE>::has_trivial_ctor   ? HAS_TRIVIAL_CTOR   : 0)
                 |(traits<TYPE>::has_trivial_dtor   ? HAS_TRIVIAL_DTOR   : 0)
-                |(traits<TYPE>::has_trivial_copy   ? HAS_TRIVIAL_COPY   : 0))
+                |(traits<TYPE>::has_trivial_copy   ? HAS_TRIVIAL_COPY   : 0)
+                |(traits<TYPE>::has_trivial_move   ? HAS_TRIVIAL_MOVE   : 0))
                 )
 {
 }
@@ -338,16 +344,37 @@ ssize_t Vector<TYPE>::insertAt(const TYPE& item, size_t index, size_t numItems)
     return VectorImpl::insertAt(&item, index, numItems);
 }
 
+template<class TYPE> inline
+ssize_t Vector<TYPE>::insertAt(TYPE&& item, size_t index) {
+    // |item| must not be an item of this vector, as growing could move it.
+    void* where = VectorImpl::insertUninitializedAt(index);
+    if (!where) {
+        return index > size() ? (ssize_t)BAD_INDEX : (ssize_t)NO_MEMORY;
+    }
+    new (where) TYPE(std::move(item));
+    return index;
+}
+
 template<class TYPE> inline
 void Vector<TYPE>::push(const TYPE& item) {
     return VectorImpl::push(&item);
 }
 
+template<class TYPE> inline
+void Vector<TYPE>::push(TYPE&& item) {
+    insertAt(std::move(item), size());
+}
+
 template<class TYPE> inline
 ssize_t Vector<TYPE>::add(const TYPE& item) {
     return VectorImpl::add(&item);
 }
 
+template<class TYPE> inline
+ssize_t Vector<TYPE>::add(TYPE&& item) {
+    return insertAt(std::move(item), size());
+}
+
 template<class TYPE> inline
 ssize_t Vector<TYPE>::replaceAt(const TYPE& item, size_t index) {
     return VectorImpl::replaceAt(&item, index);
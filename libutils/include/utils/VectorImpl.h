@@ -44,6 +44,8 @@ public:
         HAS_TRIVIAL_CTOR    = 0x00000001,
         HAS_TRIVIAL_DTOR    = 0x00000002,
         HAS_TRIVIAL_COPY    = 0x00000004,
+        // Items can be relocated with memmove/realloc, see trait_trivial_move.
+        HAS_TRIVIAL_MOVE    = 0x00000008,
     };
 
                             VectorImpl(size_t itemSize, uint32_t flags);
@@ -99,6 +101,10 @@ protected:
             size_t          itemSize() const;
             void            release_storage();
 
+            /*! makes room for numItems at where, leaving it unconstructed.
+             *  Returns its location, or nullptr. */
+            void*           insertUninitializedAt(size_t where, size_t numItems = 1);
+
     virtual void            do_construct(void* storage, size_t num) const = 0;
     virtual void            do_destroy(void* storage, size_t num) const = 0;
     virtual void            do_copy(void* dest, const void* from, size_t num) const = 0;
@@ -116,6 +122,7 @@ private:
         inline void _do_splat(void* dest, const void* item, size_t num) const;
         inline void _do_move_forward(void* dest, const void* from, size_t num) const;
         inline void _do_move_backward(void* dest, const void* from, size_t num) const;
+        inline bool _can_relocate() const;
 
             // These 2 fields are exposed in the inlines below,
             // so they're set in stone.
@@ -0,0 +1,102 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <utility>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+#include <utils/FlatMap.h>
+#include <utils/KeyedVector.h>
+#include <utils/String8.h>
+
+using android::FlatMap;
+using android::KeyedVector;
+using android::String8;
+
+// About the size of an input device configuration file.
+static constexpr int kEntries = 256;
+
+static std::vector<std::pair<String8, String8>> MakeEntries() {
+    std::vector<std::pair<String8, String8>> entries;
+    uint32_t seed = 2463534242u;
+    for (int i = 0; i < kEntries; i++) {
+        seed ^= seed << 13;
+        seed ^= seed >> 17;
+        seed ^= seed << 5;
+        entries.emplace_back(String8::format("touch.property.%08x", seed),
+                             String8::format("%d", i));
+    }
+    return entries;
+}
+
+static void BM_KeyedVector_Add(benchmark::State& state) {
+    auto entries = MakeEntries();
+    for (auto _ : state) {
+        KeyedVector<String8, String8> map;
+        for (const auto& entry : entries) {
+            map.add(entry.first, entry.second);
+        }
+        benchmark::DoNotOptimize(map.size());
+    }
+}
+BENCHMARK(BM_KeyedVector_Add);
+
+static void BM_FlatMap_Add(benchmark::State& state) {
+    auto entries = MakeEntries();
+    for (auto _ : state) {
+        FlatMap<String8, String8> map;
+        for (const auto& entry : entries) {
+            map.add(entry.first, entry.second);
+        }
+        benchmark::DoNotOptimize(map.size());
+    }
+}
+BENCHMARK(BM_FlatMap_Add);
+
+static void BM_FlatMap_FromUnsorted(benchmark::State& state) {
+    auto entries = MakeEntries();
+    for (auto _ : state) {
+        auto copy = entries;
+        auto map = FlatMap<String8, String8>::fromUnsorted(std::move(copy));
+        benchmark::DoNotOptimize(map.size());
+    }
+}
+BENCHMARK(BM_FlatMap_FromUnsorted);
+
+static void BM_KeyedVector_Lookup(benchmark::State& state) {
+    auto entries = MakeEntries();
+    KeyedVector<String8, String8> map;
+    for (const auto& entry : entries) {
+        map.add(entry.first, entry.second);
+    }
+    size_t i = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(map.indexOfKey(entries[i++ % kEntries].first));
+    }
+}
+BENCHMARK(BM_KeyedVector_Lookup);
+
+static void BM_FlatMap_Lookup(benchmark::State& state) {
+    auto entries = MakeEntries();
+    auto map = FlatMap<String8, String8>::fromUnsorted(entries);
+    size_t i = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(map.indexOfKey(entries[i++ % kEntries].first));
+    }
+}
+BENCHMARK(BM_FlatMap_Lookup);
+
+// BENCHMARK_MAIN() is in LruCache_benchmark.cpp.
@@ -0,0 +1,130 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include <utils/FlatMap.h>
+#include <utils/String8.h>
+
+namespace android {
+
+TEST(FlatMapTest, AddAndLookup) {
+    FlatMap<int, std::string> map;
+    EXPECT_TRUE(map.isEmpty());
+    EXPECT_EQ(0, map.add(3, "three"));
+    EXPECT_EQ(0, map.add(1, "one"));
+    EXPECT_EQ(1, map.add(2, "two"));
+    EXPECT_EQ(3u, map.size());
+
+    EXPECT_EQ(1, map.keyAt(0));
+    EXPECT_EQ(2, map.keyAt(1));
+    EXPECT_EQ(3, map.keyAt(2));
+    EXPECT_EQ(2, map.indexOfKey(3));
+    EXPECT_EQ(NAME_NOT_FOUND, map.indexOfKey(4));
+    EXPECT_EQ("two", map.valueFor(2));
+
+    // Adding an existing key replaces its value.
+    EXPECT_EQ(1, map.add(2, "zwei"));
+    EXPECT_EQ(3u, map.size());
+    EXPECT_EQ("zwei", map.valueAt(1));
+
+    map.editValueFor(1) = "eins";
+    EXPECT_EQ("eins", map.valueFor(1));
+}
+
+TEST(FlatMapTest, Remove) {
+    FlatMap<int, int> map;
+    for (int i = 0; i < 10; i++) {
+        map.add(i, i * i);
+    }
+    EXPECT_EQ(4, map.removeItem(4));
+    EXPECT_EQ(NAME_NOT_FOUND, map.removeItem(4));
+    EXPECT_EQ(0, map.removeItemsAt(0, 2));
+    EXPECT_EQ(BAD_INDEX, map.removeItemsAt(6, 2));
+    EXPECT_EQ(7u, map.size());
+    EXPECT_EQ(2, map.keyAt(0));
+    EXPECT_EQ(25, map.valueFor(5));
+}
+
+TEST(FlatMapTest, FromUnsortedKeepsLastDuplicate) {
+    std::vector<std::pair<int, std::string>> entries = {
+            {5, "a"}, {1, "b"}, {5, "c"}, {3, "d"}, {1, "e"}, {5, "f"},
+    };
+    auto map = FlatMap<int, std::string>::fromUnsorted(std::move(entries));
+    ASSERT_EQ(3u, map.size());
+    EXPECT_EQ("e", map.valueFor(1));
+    EXPECT_EQ("d", map.valueFor(3));
+    EXPECT_EQ("f", map.valueFor(5));
+
+    int previous = 0;
+    for (const auto& entry : map) {
+        EXPECT_LT(previous, entry.first);
+        previous = entry.first;
+    }
+}
+
+TEST(FlatMapTest, FromUnsortedRelocatesTrivialTypes) {
+    // String8 has ANDROID_TRIVIAL_MOVE_TRAIT, so this takes the memcpy path.
+    std::vector<std::pair<String8, String8>> entries;
+    for (int i = 0; i < 100; i++) {
+        entries.emplace_back(String8::format("%02d", (i * 37) % 50), String8::format("%d", i));
+    }
+    auto map = FlatMap<String8, String8>::fromUnsorted(std::move(entries));
+    ASSERT_EQ(50u, map.size());
+    for (int i = 0; i < 50; i++) {
+        EXPECT_STREQ(String8::format("%02d", i).string(), map.keyAt(i).string());
+    }
+    // 37 * 63 % 50 == 37 * 13 % 50 == 31; index 63 is added later.
+    EXPECT_STREQ("63", map.valueFor(String8("31")).string());
+
+    map.add(String8("00a"), String8("x"));
+    EXPECT_EQ(1, map.indexOfKey(String8("00a")));
+    EXPECT_STREQ("01", map.keyAt(2).string());
+}
+
+TEST(FlatMapTest, MovesValues) {
+    FlatMap<String8, String8> map;
+    String8 key("key");
+    String8 value("value");
+    map.add(std::move(key), std::move(value));
+    EXPECT_STREQ("value", map.valueFor(String8("key")).string());
+    EXPECT_TRUE(value.isEmpty());
+}
+
+TEST(FlatMapTest, KeyedVectorRoundTrip) {
+    KeyedVector<String8, int> keyedVector;
+    keyedVector.add(String8("b"), 2);
+    keyedVector.add(String8("a"), 1);
+    keyedVector.add(String8("c"), 3);
+
+    FlatMap<String8, int> map(keyedVector);
+    ASSERT_EQ(3u, map.size());
+    EXPECT_STREQ("a", map.keyAt(0).string());
+    EXPECT_EQ(3, map.valueFor(String8("c")));
+
+    map.add(String8("d"), 4);
+    KeyedVector<String8, int> copy = map.toKeyedVector();
+    ASSERT_EQ(4u, copy.size());
+    for (size_t i = 0; i < copy.size(); i++) {
+        EXPECT_EQ(map.keyAt(i), copy.keyAt(i));
+        EXPECT_EQ(map.valueAt(i), copy.valueAt(i));
+    }
+}
+
+}  // namespace android
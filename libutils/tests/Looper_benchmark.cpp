@@ -0,0 +1,66 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+#include <utils/Looper.h>
+
+using android::Looper;
+using android::Message;
+using android::MessageHandler;
+using android::sp;
+
+class NopMessageHandler : public MessageHandler {
+public:
+    virtual void handleMessage(const Message&) {}
+};
+
+// Queues state.range(0) messages at pseudo-random times well in the future,
+// then flushes them, as a handler with many pending timeouts would.
+static void BM_SendMessageDelayed(benchmark::State& state) {
+    sp<Looper> looper = new Looper(false);
+    sp<MessageHandler> handler = new NopMessageHandler();
+    const int count = state.range(0);
+    for (auto _ : state) {
+        uint32_t seed = 2463534242u;
+        for (int i = 0; i < count; i++) {
+            seed ^= seed << 13;
+            seed ^= seed >> 17;
+            seed ^= seed << 5;
+            looper->sendMessageDelayed(s2ns(60) + (seed % 1000000), handler, Message(i));
+        }
+        looper->removeMessages(handler);
+    }
+    state.SetItemsProcessed(state.iterations() * count);
+}
+BENCHMARK(BM_SendMessageDelayed)->Arg(16)->Arg(256)->Arg(4096);
+
+// Delivers state.range(0) messages that are all due, through pollOnce().
+static void BM_DispatchMessages(benchmark::State& state) {
+    sp<Looper> looper = new Looper(false);
+    sp<MessageHandler> handler = new NopMessageHandler();
+    const int count = state.range(0);
+    for (auto _ : state) {
+        nsecs_t now = systemTime(SYSTEM_TIME_MONOTONIC);
+        for (int i = 0; i < count; i++) {
+            looper->sendMessageAtTime(now - (i % 64), handler, Message(i));
+        }
+        looper->pollOnce(0);
+    }
+    state.SetItemsProcessed(state.iterations() * count);
+}
+BENCHMARK(BM_DispatchMessages)->Arg(16)->Arg(256)->Arg(4096);
+
+// BENCHMARK_MAIN() is in LruCache_benchmark.cpp.
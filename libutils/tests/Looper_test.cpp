@@ -632,6 +632,30 @@ TEST_F(LooperTest, SendMessageAtTime_WhenSentToThePresent_ShouldInvokeHandlerDur
             << "handled message";
 }
 
+TEST_F(LooperTest, SendMessageAtTime_WhenSentOutOfOrder_ShouldInvokeHandlersInTimeOrder) {
+    nsecs_t now = systemTime(SYSTEM_TIME_MONOTONIC);
+    sp<StubMessageHandler> handler = new StubMessageHandler();
+    mLooper->sendMessageAtTime(now - ms2ns(10), handler, Message(MSG_TEST3));
+    mLooper->sendMessageAtTime(now - ms2ns(30), handler, Message(MSG_TEST1));
+    mLooper->sendMessageAtTime(now - ms2ns(10), handler, Message(MSG_TEST4));
+    mLooper->sendMessageAtTime(now - ms2ns(20), handler, Message(MSG_TEST2));
+
+    int result = mLooper->pollOnce(0);
+
+    EXPECT_EQ(Looper::POLL_CALLBACK, result)
+            << "pollOnce result should be Looper::POLL_CALLBACK because messages were sent";
+    ASSERT_EQ(size_t(4), handler->messages.size())
+            << "handled all messages";
+    EXPECT_EQ(MSG_TEST1, handler->messages[0].what)
+            << "earliest message handled first";
+    EXPECT_EQ(MSG_TEST2, handler->messages[1].what)
+            << "handled message";
+    EXPECT_EQ(MSG_TEST3, handler->messages[2].what)
+            << "messages due at the same time are handled in the order sent";
+    EXPECT_EQ(MSG_TEST4, handler->messages[3].what)
+            << "messages due at the same time are handled in the order sent";
+}
+
 TEST_F(LooperTest, RemoveMessage_WhenRemovingAllMessagesForHandler_ShouldRemoveThoseMessage) {
     sp<StubMessageHandler> handler = new StubMessageHandler();
     mLooper->sendMessage(handler, Message(MSG_TEST1));
@@ -0,0 +1,77 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+#include <utils/LruCache.h>
+#include <utils/Mutex.h>
+#include <utils/ShardedLruCache.h>
+
+using android::LruCache;
+using android::Mutex;
+using android::ShardedLruCache;
+
+static constexpr uint32_t kCapacity = 4096;
+// Twice the capacity, so that lookups are a mix of hits, misses and evictions.
+static constexpr int kKeySpace = 2 * kCapacity;
+
+// A single LruCache behind one mutex, as callers have to do today.
+class LockedLruCache {
+public:
+    explicit LockedLruCache(uint32_t capacity) : mCache(capacity) {}
+
+    int get(int key) {
+        Mutex::Autolock _l(mLock);
+        return mCache.get(key);
+    }
+    bool put(int key, int value) {
+        Mutex::Autolock _l(mLock);
+        return mCache.put(key, value);
+    }
+
+private:
+    Mutex mLock;
+    LruCache<int, int> mCache GUARDED_BY(mLock);
+};
+
+template <typename Cache>
+static void Lookup(benchmark::State& state, Cache* cache) {
+    // Per-thread xorshift, so that the key generator doesn't serialize threads.
+    uint32_t seed = 2463534242u + state.thread_index * 7919u;
+    for (auto _ : state) {
+        seed ^= seed << 13;
+        seed ^= seed >> 17;
+        seed ^= seed << 5;
+        int key = seed % kKeySpace;
+        if (!cache->get(key)) {
+            cache->put(key, key + 1);
+        }
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+static void BM_LockedLruCache(benchmark::State& state) {
+    static LockedLruCache cache(kCapacity);
+    Lookup(state, &cache);
+}
+BENCHMARK(BM_LockedLruCache)->ThreadRange(1, 16)->UseRealTime();
+
+static void BM_ShardedLruCache(benchmark::State& state) {
+    static ShardedLruCache<int, int> cache(kCapacity);
+    Lookup(state, &cache);
+}
+BENCHMARK(BM_ShardedLruCache)->ThreadRange(1, 16)->UseRealTime();
+
+BENCHMARK_MAIN();
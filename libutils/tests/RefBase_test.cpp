@@ -20,6 +20,7 @@
 #include <utils/RefBase.h>
 
 #include <thread>
+#include <vector>
 #include <atomic>
 #include <sched.h>
 #include <errno.h>
@@ -256,3 +257,114 @@ TEST(RefBase, RacingPromotions) {
         ASSERT_EQ(NITERS, deleteCount) << "Deletions missed!";
     }  // Otherwise this is slow and probably pointless on a uniprocessor.
 }
+
+class LightFoo : public LightWeakRefBase {
+public:
+    LightFoo(bool* deleted_check) : mDeleted(deleted_check) {
+        *mDeleted = false;
+    }
+
+    ~LightFoo() {
+        *mDeleted = true;
+    }
+private:
+    bool* mDeleted;
+};
+
+TEST(LightWeakRefBase, StrongOnly) {
+    bool isDeleted;
+    LightFoo* foo = new LightFoo(&isDeleted);
+    ASSERT_EQ(0, foo->getStrongCount());
+    sp<LightFoo> sp1(foo);
+    {
+        sp<LightFoo> sp2 = sp1;
+        ASSERT_EQ(2, foo->getStrongCount());
+    }
+    ASSERT_EQ(1, foo->getStrongCount());
+    ASSERT_FALSE(isDeleted) << "deleted too early! still has a reference!";
+    sp1 = nullptr;
+    ASSERT_TRUE(isDeleted) << "foo was leaked!";
+}
+
+TEST(LightWeakRefBase, WeakPromotion) {
+    bool isDeleted;
+    LightFoo* foo = new LightFoo(&isDeleted);
+    sp<LightFoo> sp1(foo);
+    sp<LightFoo> sp2(sp1);
+    wp<LightFoo> wp1(sp1);
+    // The counts moved to the weakref, which also holds one weak reference
+    // for the object itself.
+    ASSERT_EQ(2, foo->getStrongCount());
+    ASSERT_EQ(4, wp1.get_refs()->getWeakCount());
+    ASSERT_EQ(nullptr, wp1.get_refs()->refBase());
+    {
+        sp<LightFoo> sp3 = wp1.promote();
+        ASSERT_EQ(foo, sp3.get());
+        ASSERT_EQ(3, foo->getStrongCount());
+        wp<LightFoo> wp2(sp3);
+        ASSERT_EQ(wp1.get_refs(), wp2.get_refs());
+        ASSERT_EQ(6, wp1.get_refs()->getWeakCount());
+    }
+    sp1 = nullptr;
+    ASSERT_FALSE(isDeleted) << "deleted too early! still has a reference!";
+    sp2 = nullptr;
+    ASSERT_TRUE(isDeleted) << "foo was leaked!";
+    ASSERT_EQ(1, wp1.get_refs()->getWeakCount());
+    ASSERT_EQ(nullptr, wp1.promote().get()) << "Dead wp promotion succeeded!";
+    // The weakref goes away with wp1; ASan catches a leak or early free.
+}
+
+TEST(LightWeakRefBase, WeakBeforeStrong) {
+    bool isDeleted;
+    LightFoo* foo = new LightFoo(&isDeleted);
+    wp<LightFoo> wp1(foo);
+    ASSERT_EQ(nullptr, wp1.promote().get())
+            << "object without a strong reference was promoted";
+    ASSERT_FALSE(isDeleted);
+    sp<LightFoo> sp1(foo);
+    ASSERT_EQ(1, foo->getStrongCount());
+    ASSERT_EQ(foo, wp1.promote().get());
+    sp1 = nullptr;
+    ASSERT_TRUE(isDeleted) << "foo was leaked!";
+    ASSERT_EQ(nullptr, wp1.promote().get()) << "Dead wp promotion succeeded!";
+}
+
+class LightBar : public LightWeakRefBase {
+public:
+    LightBar(std::atomic<int>* delete_count) : mDeleteCount(delete_count) {
+    }
+
+    ~LightBar() {
+        (*mDeleteCount)++;
+    }
+private:
+    std::atomic<int>* mDeleteCount;
+};
+
+TEST(LightWeakRefBase, RacingFirstWeak) {
+    // Strong references are taken and dropped while other threads race to
+    // create the first weak reference.
+    static constexpr int kIters = 10000;
+    static constexpr int kThreads = 4;
+    std::atomic<int> deleteCount(0);
+    for (int i = 0; i < kIters; ++i) {
+        sp<LightBar> bar = new LightBar(&deleteCount);
+        std::vector<std::thread> threads;
+        for (int t = 0; t < kThreads; ++t) {
+            threads.emplace_back([&bar, t]() {
+                if (t & 1) {
+                    wp<LightBar> weak(bar);
+                    sp<LightBar> strong = weak.promote();
+                    EXPECT_NE(nullptr, strong.get());
+                } else {
+                    sp<LightBar> strong(bar);
+                }
+            });
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        ASSERT_EQ(1, bar->getStrongCount());
+    }
+    ASSERT_EQ(kIters, deleteCount) << "Deletions missed!";
+}
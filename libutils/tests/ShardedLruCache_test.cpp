@@ -0,0 +1,126 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include <utils/ShardedLruCache.h>
+
+namespace android {
+
+typedef int SimpleKey;
+typedef const char* StringValue;
+
+class CountingCallback : public OnEntryRemoved<SimpleKey, int> {
+public:
+    void operator()(SimpleKey&, int&) { count++; }
+    std::atomic<int> count{0};
+};
+
+TEST(ShardedLruCacheTest, Empty) {
+    ShardedLruCache<SimpleKey, StringValue> cache(100);
+
+    EXPECT_EQ(nullptr, cache.get(0));
+    EXPECT_EQ(0u, cache.size());
+}
+
+TEST(ShardedLruCacheTest, Simple) {
+    ShardedLruCache<SimpleKey, StringValue> cache(100);
+
+    EXPECT_TRUE(cache.put(1, "one"));
+    EXPECT_TRUE(cache.put(2, "two"));
+    EXPECT_TRUE(cache.put(3, "three"));
+    EXPECT_FALSE(cache.put(3, "drei"));
+    EXPECT_STREQ("one", cache.get(1));
+    EXPECT_STREQ("two", cache.get(2));
+    EXPECT_STREQ("three", cache.get(3));
+    EXPECT_EQ(3u, cache.size());
+
+    EXPECT_TRUE(cache.remove(2));
+    EXPECT_FALSE(cache.remove(2));
+    EXPECT_EQ(nullptr, cache.get(2));
+    EXPECT_EQ(2u, cache.size());
+
+    cache.clear();
+    EXPECT_EQ(0u, cache.size());
+}
+
+TEST(ShardedLruCacheTest, ShardCountRoundsUp) {
+    EXPECT_EQ(1u, (ShardedLruCache<SimpleKey, StringValue>(10, 1).shardCount()));
+    EXPECT_EQ(8u, (ShardedLruCache<SimpleKey, StringValue>(10, 5).shardCount()));
+    EXPECT_EQ(16u, (ShardedLruCache<SimpleKey, StringValue>(10, 16).shardCount()));
+}
+
+TEST(ShardedLruCacheTest, SingleShardIsLru) {
+    ShardedLruCache<SimpleKey, StringValue> cache(2, 1);
+
+    cache.put(1, "one");
+    cache.put(2, "two");
+    EXPECT_STREQ("one", cache.get(1));
+    cache.put(3, "three");
+    EXPECT_STREQ("one", cache.get(1));
+    EXPECT_EQ(nullptr, cache.get(2));
+    EXPECT_STREQ("three", cache.get(3));
+    EXPECT_EQ(2u, cache.size());
+}
+
+TEST(ShardedLruCacheTest, MaxCapacity) {
+    const uint32_t kCapacity = 64;
+    ShardedLruCache<SimpleKey, int> cache(kCapacity, 4);
+    CountingCallback callback;
+    cache.setOnEntryRemovedListener(&callback);
+
+    for (int i = 0; i < 1000; i++) {
+        cache.put(i, i);
+    }
+    EXPECT_LE(cache.size(), kCapacity);
+    EXPECT_EQ(1000, callback.count + static_cast<int>(cache.size()));
+}
+
+TEST(ShardedLruCacheTest, Unlimited) {
+    ShardedLruCache<SimpleKey, int> cache(LruCache<SimpleKey, int>::kUnlimitedCapacity);
+
+    for (int i = 0; i < 1000; i++) {
+        cache.put(i, i);
+    }
+    EXPECT_EQ(1000u, cache.size());
+}
+
+TEST(ShardedLruCacheTest, ConcurrentAccess) {
+    const int kThreads = 8;
+    const int kKeysPerThread = 1000;
+    ShardedLruCache<SimpleKey, int> cache(LruCache<SimpleKey, int>::kUnlimitedCapacity);
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < kThreads; t++) {
+        threads.emplace_back([&cache, t]() {
+            for (int i = 0; i < kKeysPerThread; i++) {
+                int key = t * kKeysPerThread + i;
+                cache.put(key, key + 1);
+                EXPECT_EQ(key + 1, cache.get(key));
+                if (i % 2) cache.remove(key);
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    EXPECT_EQ(static_cast<size_t>(kThreads * kKeysPerThread / 2), cache.size());
+}
+
+}  // namespace android
@@ -96,4 +96,36 @@ TEST_F(String8Test, CheckUtf32Conversion) {
     EXPECT_EQ(10U, string8.length());
 }
 
+TEST_F(String8Test, MoveTakesBuffer) {
+    String8 src("Hello, world!");
+    const char* buffer = src.string();
+
+    String8 dst(std::move(src));
+    EXPECT_EQ(buffer, dst.string());
+    EXPECT_STREQ("", src.string());
+
+    String8 assigned("Goodbye");
+    assigned = std::move(dst);
+    EXPECT_EQ(buffer, assigned.string());
+    EXPECT_STREQ("", dst.string());
+
+    // Moved-from strings are still usable.
+    dst.append("again");
+    EXPECT_STREQ("again", dst.string());
+}
+
+TEST_F(String8Test, String16MoveTakesBuffer) {
+    String16 src(u"Hello, world!");
+    const char16_t* buffer = src.string();
+
+    String16 dst(std::move(src));
+    EXPECT_EQ(buffer, dst.string());
+    EXPECT_EQ(0U, src.size());
+
+    String16 assigned(u"Goodbye");
+    assigned = std::move(dst);
+    EXPECT_EQ(buffer, assigned.string());
+    EXPECT_EQ(0U, dst.size());
+}
+
 }
@@ -0,0 +1,88 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <memory>
+
+#include <benchmark/benchmark.h>
+#include <utils/String8.h>
+#include <utils/Tokenizer.h>
+
+using android::String8;
+using android::Tokenizer;
+
+// BENCHMARK_MAIN() is in LruCache_benchmark.cpp.
+
+static constexpr char kWhitespace[] = " \t\r";
+
+// Like a large key layout file: a header, a comment every few lines and
+// key and axis mappings.
+static String8 MakeKeyLayout() {
+    String8 contents("# Generic key layout file.\n\n");
+    for (int i = 1; i <= 2000; i++) {
+        if (i % 8 == 0) {
+            contents.appendFormat("# Keys %d to %d.\n", i, i + 7);
+        }
+        if (i % 64 == 0) {
+            contents.appendFormat("axis 0x%02x    AXIS_%d\n", i / 64, i / 64);
+        } else {
+            contents.appendFormat("key %-6d  KEYCODE_%d    VIRTUAL\n", i, i);
+        }
+    }
+    return contents;
+}
+
+// The loop of KeyLayoutMap::Parser, over either flavour of the token API.
+template <typename NextToken>
+static size_t ParseKeyLayout(Tokenizer* tokenizer, NextToken nextToken) {
+    size_t tokens = 0;
+    while (!tokenizer->isEof()) {
+        tokenizer->skipDelimiters(kWhitespace);
+        if (!tokenizer->isEol() && tokenizer->peekChar() != '#') {
+            while (!tokenizer->isEol()) {
+                tokens += nextToken(tokenizer).size() != 0;
+                tokenizer->skipDelimiters(kWhitespace);
+            }
+        }
+        tokenizer->nextLine();
+    }
+    return tokens;
+}
+
+static void BM_TokenizeString8(benchmark::State& state) {
+    String8 contents = MakeKeyLayout();
+    for (auto _ : state) {
+        Tokenizer* rawTokenizer;
+        Tokenizer::fromContents(String8("Generic.kl"), contents.string(), &rawTokenizer);
+        std::unique_ptr<Tokenizer> tokenizer(rawTokenizer);
+        benchmark::DoNotOptimize(ParseKeyLayout(
+                tokenizer.get(), [](Tokenizer* t) { return t->nextToken(kWhitespace); }));
+    }
+    state.SetBytesProcessed(state.iterations() * contents.size());
+}
+BENCHMARK(BM_TokenizeString8);
+
+static void BM_TokenizeView(benchmark::State& state) {
+    String8 contents = MakeKeyLayout();
+    for (auto _ : state) {
+        Tokenizer* rawTokenizer;
+        Tokenizer::fromContents(String8("Generic.kl"), contents.string(), &rawTokenizer);
+        std::unique_ptr<Tokenizer> tokenizer(rawTokenizer);
+        benchmark::DoNotOptimize(ParseKeyLayout(
+                tokenizer.get(), [](Tokenizer* t) { return t->nextTokenView(kWhitespace); }));
+    }
+    state.SetBytesProcessed(state.iterations() * contents.size());
+}
+BENCHMARK(BM_TokenizeView);
@@ -0,0 +1,99 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "Tokenizer_test"
+
+#include <memory>
+
+#include <android-base/file.h>
+#include <utils/Tokenizer.h>
+
+#include <gtest/gtest.h>
+
+namespace android {
+
+static const char kContents[] =
+        "# A comment\n"
+        "key 1     ESCAPE\n"
+        "key 2\t1  FUNCTION\n"
+        "\n"
+        "axis 0x00 X";
+
+static constexpr char kWhitespace[] = " \t\r";
+
+TEST(TokenizerTest, Views) {
+    Tokenizer* rawTokenizer;
+    ASSERT_EQ(OK, Tokenizer::fromContents(String8("test.kl"), kContents, &rawTokenizer));
+    std::unique_ptr<Tokenizer> tokenizer(rawTokenizer);
+
+    EXPECT_EQ("# A comment", tokenizer->peekRemainderOfLineView());
+    tokenizer->nextLine();
+
+    EXPECT_EQ("key", tokenizer->nextTokenView(kWhitespace));
+    tokenizer->skipDelimiters(kWhitespace);
+    EXPECT_EQ("1", tokenizer->nextTokenView(kWhitespace));
+    tokenizer->skipDelimiters(kWhitespace);
+    EXPECT_EQ("ESCAPE", tokenizer->nextTokenView(kWhitespace));
+    EXPECT_TRUE(tokenizer->isEol());
+    // At a delimiter or the end of the line, the token is empty.
+    EXPECT_EQ("", tokenizer->nextTokenView(kWhitespace));
+    tokenizer->nextLine();
+
+    EXPECT_EQ(3, tokenizer->getLineNumber());
+    EXPECT_EQ("key", tokenizer->nextTokenView(kWhitespace));
+    EXPECT_EQ("", tokenizer->nextTokenView(kWhitespace));
+    tokenizer->skipDelimiters(kWhitespace);
+    EXPECT_EQ("2\t1", tokenizer->nextTokenView(" "));
+    tokenizer->nextLine();
+    tokenizer->nextLine();
+
+    // The last line has no newline.
+    EXPECT_EQ("axis 0x00 X", tokenizer->peekRemainderOfLineView());
+    EXPECT_EQ("axis", tokenizer->nextTokenView(kWhitespace));
+    tokenizer->skipDelimiters(kWhitespace);
+    EXPECT_EQ("0x00", tokenizer->nextTokenView(kWhitespace));
+    tokenizer->skipDelimiters(kWhitespace);
+    std::string_view last = tokenizer->nextTokenView(kWhitespace);
+    EXPECT_EQ("X", last);
+    EXPECT_TRUE(tokenizer->isEof());
+    // The views point into the contents.
+    EXPECT_EQ(kContents + sizeof(kContents) - 2, last.data());
+}
+
+TEST(TokenizerTest, String8Wrappers) {
+    Tokenizer* rawTokenizer;
+    ASSERT_EQ(OK, Tokenizer::fromContents(String8("test.kl"), kContents, &rawTokenizer));
+    std::unique_ptr<Tokenizer> tokenizer(rawTokenizer);
+    tokenizer->nextLine();
+
+    EXPECT_STREQ("key 1     ESCAPE", tokenizer->peekRemainderOfLine().string());
+    EXPECT_STREQ("key", tokenizer->nextToken(kWhitespace).string());
+    EXPECT_STREQ("", tokenizer->nextToken(kWhitespace).string());
+}
+
+TEST(TokenizerTest, OpenMapsFile) {
+    TemporaryFile file;
+    ASSERT_TRUE(android::base::WriteStringToFd(kContents, file.fd));
+
+    Tokenizer* rawTokenizer;
+    ASSERT_EQ(OK, Tokenizer::open(String8(file.path), &rawTokenizer));
+    std::unique_ptr<Tokenizer> tokenizer(rawTokenizer);
+    EXPECT_EQ("# A comment", tokenizer->peekRemainderOfLineView());
+    tokenizer->nextLine();
+    EXPECT_EQ("key", tokenizer->nextTokenView(kWhitespace));
+}
+
+}  // namespace android
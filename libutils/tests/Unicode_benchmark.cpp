@@ -0,0 +1,86 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string>
+
+#include <benchmark/benchmark.h>
+#include <utils/String16.h>
+#include <utils/String8.h>
+#include <utils/Unicode.h>
+
+using android::String16;
+using android::String8;
+
+// BENCHMARK_MAIN() is in LruCache_benchmark.cpp.
+
+// ASCII, like most interface descriptors and names sent over binder, or with
+// one non-ASCII character every 32.
+static std::string makeUtf8(size_t len, bool ascii) {
+    std::string s;
+    while (s.size() < len) {
+        s += (!ascii && s.size() % 32 == 31) ? "\xc3\xa9" : "a";
+    }
+    return s;
+}
+
+static void BM_String16FromUtf8(benchmark::State& state) {
+    String8 src(makeUtf8(state.range(0), state.range(1)).c_str());
+    for (auto _ : state) {
+        String16 s(src);
+        benchmark::DoNotOptimize(s.string());
+    }
+    state.SetBytesProcessed(state.iterations() * src.size());
+}
+BENCHMARK(BM_String16FromUtf8)
+        ->Args({16, 1})
+        ->Args({256, 1})
+        ->Args({4096, 1})
+        ->Args({256, 0})
+        ->Args({4096, 0});
+
+static void BM_String8FromUtf16(benchmark::State& state) {
+    String16 src(makeUtf8(state.range(0), state.range(1)).c_str());
+    for (auto _ : state) {
+        String8 s(src);
+        benchmark::DoNotOptimize(s.string());
+    }
+    state.SetBytesProcessed(state.iterations() * src.size() * sizeof(char16_t));
+}
+BENCHMARK(BM_String8FromUtf16)
+        ->Args({16, 1})
+        ->Args({256, 1})
+        ->Args({4096, 1})
+        ->Args({256, 0})
+        ->Args({4096, 0});
+
+static void BM_Utf16ToUtf8Length(benchmark::State& state) {
+    String16 src(makeUtf8(state.range(0), state.range(1)).c_str());
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(utf16_to_utf8_length(src.string(), src.size()));
+    }
+    state.SetBytesProcessed(state.iterations() * src.size() * sizeof(char16_t));
+}
+BENCHMARK(BM_Utf16ToUtf8Length)->Args({4096, 1})->Args({4096, 0});
+
+static void BM_Utf8ToUtf16Length(benchmark::State& state) {
+    std::string src = makeUtf8(state.range(0), state.range(1));
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(
+                utf8_to_utf16_length(reinterpret_cast<const uint8_t*>(src.data()), src.size()));
+    }
+    state.SetBytesProcessed(state.iterations() * src.size());
+}
+BENCHMARK(BM_Utf8ToUtf16Length)->Args({4096, 1})->Args({4096, 0});
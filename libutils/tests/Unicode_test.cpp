@@ -19,7 +19,11 @@
 #include <sys/mman.h>
 #include <unistd.h>
 
+#include <string>
+
 #include <log/log.h>
+#include <utils/String16.h>
+#include <utils/String8.h>
 #include <utils/Unicode.h>
 
 #include <gtest/gtest.h>
@@ -187,4 +191,123 @@ TEST_F(UnicodeTest, InvalidUtf8OverreadDetected) {
             true /* overreadIsFatal */), "" /* regex for ASSERT_DEATH */);
 }
 
+// Long ASCII runs go through the vectorized paths; put a non-ASCII character
+// at every position around the block boundaries to check the hand-off to
+// the scalar code.
+TEST_F(UnicodeTest, UTF16toUTF8AsciiRuns) {
+    for (size_t len = 1; len < 70; len++) {
+        for (size_t pos = 0; pos <= len; pos++) {
+            std::u16string u16(len, u'a');
+            std::string expected(len, 'a');
+            if (pos < len) {
+                u16[pos] = u'\u00e9';
+                expected.replace(pos, 1, "\xc3\xa9");
+            }
+
+            ASSERT_EQ(static_cast<ssize_t>(expected.size()),
+                      utf16_to_utf8_length(u16.data(), u16.size()));
+            std::string out(expected.size() + 1, 'x');
+            utf16_to_utf8(u16.data(), u16.size(), &out[0], out.size());
+            EXPECT_EQ(expected, out.c_str()) << "len=" << len << " pos=" << pos;
+
+            std::string partial(expected.size(), 'x');
+            size_t read = 0;
+            EXPECT_EQ(expected.size(), utf16_to_utf8_partial(u16.data(), u16.size(), &partial[0],
+                                                             partial.size(), &read));
+            EXPECT_EQ(u16.size(), read);
+            EXPECT_EQ(expected, partial);
+        }
+    }
+}
+
+TEST_F(UnicodeTest, UTF8toUTF16AsciiRuns) {
+    for (size_t len = 1; len < 70; len++) {
+        for (size_t pos = 0; pos <= len; pos++) {
+            std::string u8(len, 'a');
+            std::u16string expected(len, u'a');
+            if (pos < len) {
+                u8.replace(pos, 1, "\xc3\xa9");
+                expected[pos] = u'\u00e9';
+            }
+            const uint8_t* src = reinterpret_cast<const uint8_t*>(u8.data());
+
+            ASSERT_EQ(static_cast<ssize_t>(expected.size()), utf8_to_utf16_length(src, u8.size()));
+            std::u16string out(expected.size() + 1, u'x');
+            utf8_to_utf16(src, u8.size(), &out[0], out.size());
+            EXPECT_EQ(expected, out.c_str()) << "len=" << len << " pos=" << pos;
+
+            std::u16string measured(u8.size() + 1, u'x');
+            EXPECT_EQ(static_cast<ssize_t>(expected.size()),
+                      utf8_to_utf16_measure(src, u8.size(), &measured[0], measured.size()));
+            EXPECT_EQ(expected, measured.c_str());
+        }
+    }
+}
+
+TEST_F(UnicodeTest, UTF16toUTF8PartialStopsAtWholeCharacters) {
+    // 20 ASCII characters, then a surrogate pair (4 bytes of UTF-8).
+    std::u16string u16(20, u'a');
+    u16 += u"\U0001F600";
+
+    size_t read = 1;
+    EXPECT_EQ(0u, utf16_to_utf8_partial(u16.data(), u16.size(), nullptr, 0, &read));
+    EXPECT_EQ(0u, read);
+
+    // Room for the ASCII and two more bytes: the pair is not split.
+    char out[22];
+    memset(out, 'x', sizeof(out));
+    EXPECT_EQ(20u, utf16_to_utf8_partial(u16.data(), u16.size(), out, sizeof(out), &read));
+    EXPECT_EQ(20u, read);
+    EXPECT_EQ(std::string(20, 'a'), std::string(out, 20));
+    EXPECT_EQ('x', out[20]);
+
+    // The rest converts on its own.
+    EXPECT_EQ(4, utf16_to_utf8_length(u16.data() + read, u16.size() - read));
+}
+
+TEST_F(UnicodeTest, UTF8toUTF16MeasureValidates) {
+    std::string u8(40, 'a');
+    u8 += "\xc4";  // Truncated two byte character.
+    const uint8_t* src = reinterpret_cast<const uint8_t*>(u8.data());
+    char16_t out[64];
+    EXPECT_EQ(-1, utf8_to_utf16_measure(src, u8.size(), out, 64));
+    // Also when the invalid part is only measured.
+    EXPECT_EQ(-1, utf8_to_utf16_measure(src, u8.size(), out, 20));
+
+    EXPECT_EQ(40, utf8_to_utf16_measure(src, 40, nullptr, 0));
+    EXPECT_EQ(40, utf8_to_utf16_measure(src, 40, out, 20));
+    EXPECT_EQ(u'a', out[18]);
+}
+
+TEST_F(UnicodeTest, StringConversions) {
+    const char16_t mixed[] = u"binder \u00e9t\u00e9 \U0001F600 and some more ASCII text";
+    String8 s8(mixed);
+    String16 s16(s8);
+    EXPECT_EQ(String16(mixed), s16);
+    EXPECT_EQ(strlen(s8.string()), s8.size());
+    EXPECT_EQ(strlen16(s16.string()), s16.size());
+
+    String8 ascii(String16("plain ASCII, long enough for the vector paths"));
+    EXPECT_STREQ("plain ASCII, long enough for the vector paths", ascii.string());
+    EXPECT_EQ(strlen(ascii.string()), ascii.size());
+
+    // Most of the UTF-8 does not fit in a buffer sized for ASCII.
+    String8 wide(u"\u4e2d\u6587\u4e2d\u6587 text");
+    EXPECT_STREQ("\xe4\xb8\xad\xe6\x96\x87\xe4\xb8\xad\xe6\x96\x87 text", wide.string());
+    EXPECT_EQ(17U, wide.size());
+
+    // A lone surrogate is dropped, so the UTF-8 is shorter than the UTF-16.
+    const char16_t lone[] = { 'a', 0xD800, 'b', 0 };
+    String8 dropped(lone);
+    EXPECT_STREQ("ab", dropped.string());
+    EXPECT_EQ(2U, dropped.size());
+
+    // Multi-byte characters get fewer code units than bytes.
+    String16 cjk(String8("\xe4\xb8\xad\xe6\x96\x87"));
+    EXPECT_EQ(2U, cjk.size());
+    EXPECT_EQ(0, cjk.string()[2]);
+
+    EXPECT_EQ(0U, String16(String8("\xc4")).size());
+}
+
 }
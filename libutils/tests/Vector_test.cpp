@@ -20,8 +20,12 @@
 #include <stdint.h>
 #include <unistd.h>
 
+#include <string>
+#include <vector>
+
 #include <android/log.h>
 #include <gtest/gtest.h>
+#include <utils/String8.h>
 #include <utils/Vector.h>
 
 namespace android {
@@ -136,4 +140,72 @@ TEST_F(VectorTest, editArray_Shared) {
   }
 }
 
+// Counts copies, and has no trivial move trait.
+struct CopyCounter {
+  static int copies;
+  int value = 0;
+  CopyCounter() = default;
+  explicit CopyCounter(int v) : value(v) {}
+  CopyCounter(const CopyCounter& o) : value(o.value) { copies++; }
+  CopyCounter(CopyCounter&& o) noexcept : value(o.value) { o.value = -1; }
+  CopyCounter& operator=(const CopyCounter& o) {
+    value = o.value;
+    copies++;
+    return *this;
+  }
+  ~CopyCounter() {}
+};
+int CopyCounter::copies = 0;
+
+TEST_F(VectorTest, MoveInsertion) {
+  CopyCounter::copies = 0;
+  Vector<CopyCounter> vector;
+  vector.setCapacity(16);
+  for (int i = 0; i < 10; i++) {
+    CopyCounter item(i);
+    vector.push_back(std::move(item));
+    EXPECT_EQ(-1, item.value);
+  }
+  EXPECT_EQ(0, vector.insertAt(CopyCounter(100), 0));
+  EXPECT_EQ(11, vector.add(CopyCounter(5)));
+  EXPECT_EQ(BAD_INDEX, vector.insertAt(CopyCounter(1), 100));
+
+  ASSERT_EQ(12U, vector.size());
+  EXPECT_EQ(100, vector[0].value);
+  EXPECT_EQ(0, vector[1].value);
+  EXPECT_EQ(9, vector[10].value);
+  EXPECT_EQ(5, vector[11].value);
+  // Shifting the tail to make room moves the items rather than copying them.
+  EXPECT_EQ(0, CopyCounter::copies);
+}
+
+TEST_F(VectorTest, TrivialMoveGrowthAndShrink) {
+  // String8 has the trivial move trait, so an unshared buffer is resized and
+  // shifted with realloc/memmove.
+  Vector<String8> vector;
+  std::vector<std::string> expected;
+  for (int i = 0; i < 100; i++) {
+    vector.insertAt(String8::format("%d", i), i / 2);
+    expected.insert(expected.begin() + i / 2, std::to_string(i));
+  }
+
+  Vector<String8> shared = vector;
+  std::vector<std::string> shared_expected = expected;
+  vector.insertAt(String8("x"), 10);
+  expected.insert(expected.begin() + 10, "x");
+  for (int i = 0; i < 90; i++) {
+    vector.removeAt(5);
+    expected.erase(expected.begin() + 5);
+  }
+
+  ASSERT_EQ(expected.size(), vector.size());
+  for (size_t i = 0; i < expected.size(); i++) {
+    EXPECT_EQ(expected[i], vector[i].string());
+  }
+  ASSERT_EQ(shared_expected.size(), shared.size());
+  for (size_t i = 0; i < shared_expected.size(); i++) {
+    EXPECT_EQ(shared_expected[i], shared[i].string());
+  }
+}
+
 } // namespace android
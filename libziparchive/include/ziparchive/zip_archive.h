@@ -25,8 +25,16 @@
 #include <sys/cdefs.h>
 #include <sys/types.h>
 
+#include <memory>
+
 #include "android-base/off64_t.h"
 
+namespace android {
+namespace base {
+class MappedFile;
+}  // namespace base
+}  // namespace android
+
 /* Zip compression methods we support */
 enum {
   kCompressStored = 0,    // no compression
@@ -207,6 +215,21 @@ void EndIteration(void* cookie);
  */
 int32_t ExtractEntryToFile(ZipArchiveHandle archive, ZipEntry* entry, int fd);
 
+/*
+ * Uncompress and write |count| entries, each as ExtractEntryToFile would
+ * write |entries[i]| to |fds[i]|. The entries are extracted concurrently on
+ * up to |num_threads| threads, or one per online cpu if |num_threads| is 0.
+ * The archive is read with positional reads only, so this doesn't disturb
+ * the offset of its file descriptor. On Windows the entries are extracted
+ * one at a time.
+ *
+ * Returns 0 if every entry was extracted, and otherwise the error of the
+ * first failing entry in list order. Once an entry fails, entries that
+ * haven't been started yet are left alone.
+ */
+int32_t ExtractEntriesToFiles(ZipArchiveHandle archive, ZipEntry* entries, const int* fds,
+                              size_t count, size_t num_threads = 0);
+
 /**
  * Uncompress a given zip entry to the memory region at |begin| and of
  * size |size|. This size is expected to be the same as the *declared*
@@ -237,6 +260,11 @@ namespace zip_archive {
 class Writer {
  public:
   virtual bool Append(uint8_t* buf, size_t buf_size) = 0;
+  // Returns memory for the next |length| bytes of output, which count as
+  // appended once the caller has filled them in. Writers that can hand out
+  // their destination return it, so that the whole entry can be decompressed
+  // in place; the default returns nullptr and output goes through Append.
+  virtual uint8_t* GetBuffer(size_t length);
   virtual ~Writer();
 
  protected:
@@ -273,4 +301,44 @@ class Reader {
  */
 int32_t Inflate(const Reader& reader, const uint32_t compressed_length,
                 const uint32_t uncompressed_length, Writer* writer, uint64_t* crc_out);
+
+/*
+ * Read-only, in-place view of the data of a stored entry, filled in by
+ * MapStoredEntry. For an archive opened from a file descriptor the view owns
+ * a mapping of the entry, otherwise it points into the archive's memory and
+ * must not outlive it.
+ */
+class MappedEntry {
+ public:
+  MappedEntry();
+  explicit MappedEntry(std::unique_ptr<android::base::MappedFile> map);
+  MappedEntry(const uint8_t* data, size_t size);
+  MappedEntry(MappedEntry&& other);
+  MappedEntry& operator=(MappedEntry&& other);
+  ~MappedEntry();
+
+  const uint8_t* data() const { return data_; }
+  size_t size() const { return size_; }
+
+  // Starts reading in |length| bytes at |offset| into the entry without
+  // waiting for them. Returns false if the hint couldn't be given, which is
+  // always the case for archives opened from memory.
+  bool Prefetch(size_t offset, size_t length);
+
+ private:
+  std::unique_ptr<android::base::MappedFile> map_;
+  const uint8_t* data_;
+  size_t size_;
+};
+
+/*
+ * Gives access to the data of a stored (uncompressed) entry where it lies in
+ * the archive, without copying it. |mapped_entry->data()| is page aligned if
+ * |entry->offset| is, so page aligned entries such as uncompressed native
+ * libraries can be used straight from the mapping.
+ *
+ * Returns 0 on success and negative values on failure, kMmapFailed if the
+ * entry is compressed or can't be mapped.
+ */
+int32_t MapStoredEntry(ZipArchiveHandle archive, const ZipEntry* entry, MappedEntry* mapped_entry);
 }  // namespace zip_archive
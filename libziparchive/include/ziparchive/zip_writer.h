@@ -19,6 +19,8 @@
 #include <cstdio>
 #include <ctime>
 
+#include <deque>
+#include <future>
 #include <memory>
 #include <string>
 #include <vector>
@@ -95,6 +97,16 @@ class ZipWriter {
   // Move assignment.
   ZipWriter& operator=(ZipWriter&& zipWriter) noexcept;
 
+  /**
+   * Compresses the data of entries started with ZipWriter::kCompress on up to |threads| threads.
+   * The data is deflated in fixed-size blocks, each primed with the 32KiB of data before it, and
+   * the blocks are written out in order. The archive only depends on the data written, and is
+   * the same for any number of threads greater than 1, though it differs from (and is slightly
+   * larger than) the single threaded output. 0 or 1 compresses on the calling thread, which is
+   * the default. Takes effect from the next entry.
+   */
+  void SetCompressionThreads(size_t threads);
+
   /**
    * Starts a new zip entry with the given path and flags.
    * Flags can be a bitwise OR of ZipWriter::kCompress and ZipWriter::kAlign.
@@ -164,6 +176,8 @@ class ZipWriter {
   int32_t StoreBytes(FileEntry* file, const void* data, size_t len);
   int32_t CompressBytes(FileEntry* file, const void* data, size_t len);
   int32_t FlushCompressedBytes(FileEntry* file);
+  int32_t SubmitBlock(bool last);
+  int32_t WritePendingBlock(FileEntry* file);
 
   enum class State {
     kWritingZip,
@@ -181,4 +195,13 @@ class ZipWriter {
 
   std::unique_ptr<z_stream, void (*)(z_stream*)> z_stream_;
   std::vector<uint8_t> buffer_;
+
+  // State of parallel compression, see SetCompressionThreads().
+  size_t compression_threads_;
+  bool parallel_entry_;
+  // Data of the block being filled, and the data before it.
+  std::vector<uint8_t> block_;
+  std::vector<uint8_t> dictionary_;
+  // Blocks being deflated, oldest first. An empty result means an error.
+  std::deque<std::future<std::vector<uint8_t>>> pending_blocks_;
 };
@@ -31,7 +31,10 @@
 #include <time.h>
 #include <unistd.h>
 
+#include <algorithm>
+#include <atomic>
 #include <memory>
+#include <thread>
 #include <vector>
 
 #if defined(__APPLE__)
@@ -119,8 +122,17 @@ static uint32_t ComputeHash(const ZipString& name) {
 #endif
 }
 
+// The slot is picked with the low bits of the hash, so tag the entry with the high ones.
+static inline uint16_t ComputeHashTag(uint32_t hash) {
+  return static_cast<uint16_t>(hash >> 16);
+}
+
 static bool isZipStringEqual(const uint8_t* start, const ZipString& zip_string,
-                             const ZipStringOffset& zip_string_offset) {
+                             const uint16_t hash_tag, const ZipStringOffset& zip_string_offset) {
+  if (zip_string_offset.name_hash_tag != hash_tag ||
+      zip_string_offset.name_length != zip_string.name_length) {
+    return false;
+  }
   const ZipString from_offset = zip_string_offset.GetZipString(start);
   return from_offset == zip_string;
 }
@@ -142,11 +154,12 @@ static inline uint32_t GetOffset(const uint8_t* name, const uint8_t* start) {
 static int64_t EntryToIndex(const ZipStringOffset* hash_table, const uint32_t hash_table_size,
                             const ZipString& name, const uint8_t* start) {
   const uint32_t hash = ComputeHash(name);
+  const uint16_t hash_tag = ComputeHashTag(hash);
 
   // NOTE: (hash_table_size - 1) is guaranteed to be non-negative.
   uint32_t ent = hash & (hash_table_size - 1);
   while (hash_table[ent].name_offset != 0) {
-    if (isZipStringEqual(start, name, hash_table[ent])) {
+    if (isZipStringEqual(start, name, hash_tag, hash_table[ent])) {
       return ent;
     }
     ent = (ent + 1) & (hash_table_size - 1);
@@ -161,7 +174,8 @@ static int64_t EntryToIndex(const ZipStringOffset* hash_table, const uint32_t ha
  */
 static int32_t AddToHash(ZipStringOffset* hash_table, const uint64_t hash_table_size,
                          const ZipString& name, const uint8_t* start) {
-  const uint64_t hash = ComputeHash(name);
+  const uint32_t hash = ComputeHash(name);
+  const uint16_t hash_tag = ComputeHashTag(hash);
   uint32_t ent = hash & (hash_table_size - 1);
 
   /*
@@ -169,7 +183,7 @@ static int32_t AddToHash(ZipStringOffset* hash_table, const uint64_t hash_table_
    * Further, we guarantee that the hashtable size is not 0.
    */
   while (hash_table[ent].name_offset != 0) {
-    if (isZipStringEqual(start, name, hash_table[ent])) {
+    if (isZipStringEqual(start, name, hash_tag, hash_table[ent])) {
       // We've found a duplicate entry. We don't accept it
       ALOGW("Zip: Found duplicate entry %.*s", name.name_length, name.name);
       return kDuplicateEntry;
@@ -178,6 +192,7 @@ static int32_t AddToHash(ZipStringOffset* hash_table, const uint64_t hash_table_
   }
   hash_table[ent].name_offset = GetOffset(name.name, start);
   hash_table[ent].name_length = name.name_length;
+  hash_table[ent].name_hash_tag = hash_tag;
   return 0;
 }
 
@@ -518,7 +533,7 @@ void CloseArchive(ZipArchiveHandle archive) {
   delete archive;
 }
 
-static int32_t ValidateDataDescriptor(MappedZipFile& mapped_zip, ZipEntry* entry) {
+static int32_t ValidateDataDescriptor(MappedZipFile& mapped_zip, const ZipEntry* entry) {
   uint8_t ddBuf[sizeof(DataDescriptor) + sizeof(DataDescriptor::kOptSignature)];
   off64_t offset = entry->offset;
   if (entry->method != kCompressStored) {
@@ -829,6 +844,16 @@ class MemoryWriter : public zip_archive::Writer {
     return true;
   }
 
+  virtual uint8_t* GetBuffer(size_t length) override {
+    if (bytes_written_ + length > size_) {
+      return nullptr;
+    }
+
+    uint8_t* buffer = buf_ + bytes_written_;
+    bytes_written_ += length;
+    return buffer;
+  }
+
  private:
   uint8_t* const buf_;
   const size_t size_;
@@ -960,11 +985,22 @@ namespace zip_archive {
 Reader::~Reader() {}
 Writer::~Writer() {}
 
+uint8_t* Writer::GetBuffer(size_t) {
+  return nullptr;
+}
+
 int32_t Inflate(const Reader& reader, const uint32_t compressed_length,
                 const uint32_t uncompressed_length, Writer* writer, uint64_t* crc_out) {
   const size_t kBufSize = 32768;
   std::vector<uint8_t> read_buf(kBufSize);
-  std::vector<uint8_t> write_buf(kBufSize);
+
+  // When the writer hands out its destination, the entry is inflated straight
+  // into it in one go instead of through a window sized bounce buffer.
+  uint8_t* const out_buf = uncompressed_length > 0 ? writer->GetBuffer(uncompressed_length)
+                                                   : nullptr;
+  std::vector<uint8_t> write_buf(out_buf == nullptr ? kBufSize : 0);
+  uint8_t* const write_start = out_buf != nullptr ? out_buf : write_buf.data();
+  const size_t write_size_max = out_buf != nullptr ? uncompressed_length : kBufSize;
   z_stream zstream;
   int zerr;
 
@@ -977,8 +1013,8 @@ int32_t Inflate(const Reader& reader, const uint32_t compressed_length,
   zstream.opaque = Z_NULL;
   zstream.next_in = NULL;
   zstream.avail_in = 0;
-  zstream.next_out = &write_buf[0];
-  zstream.avail_out = kBufSize;
+  zstream.next_out = write_start;
+  zstream.avail_out = write_size_max;
   zstream.data_type = Z_UNKNOWN;
 
   /*
@@ -1024,6 +1060,12 @@ int32_t Inflate(const Reader& reader, const uint32_t compressed_length,
 
     /* uncompress the data */
     zerr = inflate(&zstream, Z_NO_FLUSH);
+    if (out_buf != nullptr && zerr == Z_BUF_ERROR && zstream.avail_out == 0) {
+      // There's more data than the declared uncompressed length.
+      ALOGW("Zip: size mismatch on inflated file (more than %" PRIu32 " bytes)",
+            uncompressed_length);
+      return kInconsistentInformation;
+    }
     if (zerr != Z_OK && zerr != Z_STREAM_END) {
       ALOGW("Zip: inflate zerr=%d (nIn=%p aIn=%u nOut=%p aOut=%u)", zerr, zstream.next_in,
             zstream.avail_in, zstream.next_out, zstream.avail_out);
@@ -1031,7 +1073,8 @@ int32_t Inflate(const Reader& reader, const uint32_t compressed_length,
     }
 
     /* write when we're full or when we're done */
-    if (zstream.avail_out == 0 || (zerr == Z_STREAM_END && zstream.avail_out != kBufSize)) {
+    if (out_buf == nullptr &&
+        (zstream.avail_out == 0 || (zerr == Z_STREAM_END && zstream.avail_out != kBufSize))) {
       const size_t write_size = zstream.next_out - &write_buf[0];
       if (!writer->Append(&write_buf[0], write_size)) {
         return kIoError;
@@ -1044,6 +1087,10 @@ int32_t Inflate(const Reader& reader, const uint32_t compressed_length,
     }
   } while (zerr == Z_OK);
 
+  if (out_buf != nullptr && compute_crc) {
+    crc = crc32(crc, out_buf, zstream.next_out - out_buf);
+  }
+
   CHECK_EQ(zerr, Z_STREAM_END); /* other errors should've been caught */
 
   // NOTE: zstream.adler is always set to 0, because we're using the -MAX_WBITS
@@ -1150,6 +1197,123 @@ int32_t ExtractEntryToFile(ZipArchiveHandle archive, ZipEntry* entry, int fd) {
   return ExtractToWriter(archive, entry, &writer);
 }
 
+int32_t ExtractEntriesToFiles(ZipArchiveHandle archive, ZipEntry* entries, const int* fds,
+                              size_t count, size_t num_threads) {
+#if defined(_WIN32)
+  // ReadFullyAtOffset moves the file pointer on Windows.
+  num_threads = 1;
+#endif
+  if (num_threads == 0) {
+    num_threads = std::thread::hardware_concurrency();
+  }
+  num_threads = std::max<size_t>(1, std::min(num_threads, count));
+
+  std::vector<int32_t> results(count, 0);
+  std::atomic<size_t> next(0);
+  std::atomic<bool> failed(false);
+  auto extract = [&]() {
+    for (size_t i = next++; i < count && !failed; i = next++) {
+      results[i] = ExtractEntryToFile(archive, &entries[i], fds[i]);
+      if (results[i]) {
+        failed = true;
+      }
+    }
+  };
+
+  // The calling thread does its share of the work.
+  std::vector<std::thread> threads;
+  for (size_t i = 1; i < num_threads; i++) {
+    threads.emplace_back(extract);
+  }
+  extract();
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  for (int32_t result : results) {
+    if (result) {
+      return result;
+    }
+  }
+  return 0;
+}
+
+namespace zip_archive {
+
+MappedEntry::MappedEntry() : data_(nullptr), size_(0) {}
+
+MappedEntry::MappedEntry(std::unique_ptr<android::base::MappedFile> map)
+    : map_(std::move(map)),
+      data_(reinterpret_cast<const uint8_t*>(map_->data())),
+      size_(map_->size()) {}
+
+MappedEntry::MappedEntry(const uint8_t* data, size_t size) : data_(data), size_(size) {}
+
+MappedEntry::MappedEntry(MappedEntry&& other) = default;
+
+MappedEntry& MappedEntry::operator=(MappedEntry&& other) = default;
+
+MappedEntry::~MappedEntry() {}
+
+bool MappedEntry::Prefetch(size_t offset, size_t length) {
+  return map_ != nullptr && map_->Prefetch(offset, length);
+}
+
+int32_t MapStoredEntry(ZipArchiveHandle archive, const ZipEntry* entry,
+                       MappedEntry* mapped_entry) {
+  if (entry->method != kCompressStored) {
+    ALOGW("Zip: cannot map entry with compression method %" PRIu16, entry->method);
+    return kMmapFailed;
+  }
+  if (entry->compressed_length != entry->uncompressed_length) {
+    ALOGW("Zip: stored entry has compressed length %" PRIu32 " != uncompressed length %" PRIu32,
+          entry->compressed_length, entry->uncompressed_length);
+    return kInconsistentInformation;
+  }
+
+  // The data of every entry lies before the central directory.
+  const off64_t length = entry->uncompressed_length;
+  if (entry->offset < 0 || entry->offset > archive->directory_offset - length) {
+    ALOGW("Zip: entry of %" PRId64 " bytes at offset %" PRId64 " overlaps the central directory",
+          static_cast<int64_t>(length), static_cast<int64_t>(entry->offset));
+    return kInvalidOffset;
+  }
+
+  if (entry->has_data_descriptor) {
+    const int32_t result = ValidateDataDescriptor(archive->mapped_zip, entry);
+    if (result) {
+      return result;
+    }
+  }
+
+  const MappedZipFile& mapped_zip = archive->mapped_zip;
+  if (!mapped_zip.HasFd()) {
+    *mapped_entry = MappedEntry(static_cast<const uint8_t*>(mapped_zip.GetBasePtr()) + entry->offset,
+                                length);
+    return 0;
+  }
+  if (length == 0) {
+    *mapped_entry = MappedEntry();
+    return 0;
+  }
+
+  // Large stored entries (dex files, ICU data, models) tend to be long-lived
+  // and read at random, which is where huge pages pay off. The flag is ignored
+  // for mappings smaller than a huge page.
+  auto map = android::base::MappedFile::FromFd(mapped_zip.GetFileDescriptor(), entry->offset,
+                                               length, PROT_READ,
+                                               android::base::MappedFile::kHugePages);
+  if (!map) {
+    ALOGW("Zip: failed to map %" PRId64 " bytes at offset %" PRId64 ": %s",
+          static_cast<int64_t>(length), static_cast<int64_t>(entry->offset), strerror(errno));
+    return kMmapFailed;
+  }
+  *mapped_entry = MappedEntry(std::move(map));
+  return 0;
+}
+
+}  // namespace zip_archive
+
 const char* ErrorCodeString(int32_t error_code) {
   // Make sure that the number of entries in kErrorMessages and ErrorCodes
   // match.
@@ -1253,8 +1417,11 @@ void CentralDirectory::Initialize(void* map_base_ptr, off64_t cd_start_offset, s
 
 bool ZipArchive::InitializeCentralDirectory(off64_t cd_start_offset, size_t cd_size) {
   if (mapped_zip.HasFd()) {
+    // The whole directory is walked right away to build the hash table, so
+    // fault it in with the mmap() rather than a page at a time.
     directory_map = android::base::MappedFile::FromFd(mapped_zip.GetFileDescriptor(),
-                                                      cd_start_offset, cd_size, PROT_READ);
+                                                      cd_start_offset, cd_size, PROT_READ,
+                                                      android::base::MappedFile::kPopulate);
     if (!directory_map) return false;
 
     CHECK_EQ(directory_map->size(), cd_size);
@@ -14,6 +14,8 @@
  * limitations under the License.
  */
 
+#include <unistd.h>
+
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
@@ -47,6 +49,24 @@ static TemporaryFile* CreateZip() {
   return result;
 }
 
+// Creates an archive with |entry_count| entries named like the resources of a large APK.
+static TemporaryFile* CreateManyEntriesZip(size_t entry_count) {
+  TemporaryFile* result = new TemporaryFile;
+  FILE* fp = fdopen(result->fd, "w");
+
+  ZipWriter writer(fp);
+  for (size_t i = 0; i < entry_count; i++) {
+    std::string name = "res/drawable-xxhdpi-v4/ic_resource_" + std::to_string(i) + ".png";
+    writer.StartEntry(name.c_str(), 0);
+    writer.WriteBytes("helo", 4);
+    writer.FinishEntry();
+  }
+  writer.Finish();
+  fclose(fp);
+
+  return result;
+}
+
 static void FindEntry_no_match(benchmark::State& state) {
   // Create a temporary zip archive.
   std::unique_ptr<TemporaryFile> temp_file(CreateZip());
@@ -66,6 +86,40 @@ static void FindEntry_no_match(benchmark::State& state) {
 }
 BENCHMARK(FindEntry_no_match);
 
+static void FindEntry_no_match_many_entries(benchmark::State& state) {
+  std::unique_ptr<TemporaryFile> temp_file(CreateManyEntriesZip(state.range(0)));
+  ZipArchiveHandle handle;
+  ZipEntry data;
+  ZipString name("res/drawable-xxhdpi-v4/ic_resource_missing.png");
+
+  while (state.KeepRunning()) {
+    OpenArchive(temp_file->path, &handle);
+    FindEntry(handle, name, &data);
+    CloseArchive(handle);
+  }
+}
+BENCHMARK(FindEntry_no_match_many_entries)->Arg(10000)->Arg(60000);
+
+static void FindEntry_all_names(benchmark::State& state) {
+  const size_t entry_count = state.range(0);
+  std::unique_ptr<TemporaryFile> temp_file(CreateManyEntriesZip(entry_count));
+  ZipArchiveHandle handle;
+  OpenArchive(temp_file->path, &handle);
+  std::vector<std::string> names;
+  for (size_t i = 0; i < entry_count; i++) {
+    names.push_back("res/drawable-xxhdpi-v4/ic_resource_" + std::to_string(i) + ".png");
+  }
+  ZipEntry data;
+
+  while (state.KeepRunning()) {
+    for (const auto& name : names) {
+      FindEntry(handle, ZipString(name.c_str()), &data);
+    }
+  }
+  CloseArchive(handle);
+}
+BENCHMARK(FindEntry_all_names)->Arg(10000)->Arg(60000);
+
 static void Iterate_all_files(benchmark::State& state) {
   std::unique_ptr<TemporaryFile> temp_file(CreateZip());
   ZipArchiveHandle handle;
@@ -84,4 +138,148 @@ static void Iterate_all_files(benchmark::State& state) {
 }
 BENCHMARK(Iterate_all_files);
 
+static void Iterate_all_files_many_entries(benchmark::State& state) {
+  std::unique_ptr<TemporaryFile> temp_file(CreateManyEntriesZip(state.range(0)));
+  ZipArchiveHandle handle;
+  void* iteration_cookie;
+  ZipEntry data;
+  ZipString name;
+
+  while (state.KeepRunning()) {
+    OpenArchive(temp_file->path, &handle);
+    StartIteration(handle, &iteration_cookie, nullptr, nullptr);
+    while (Next(iteration_cookie, &data, &name) == 0) {
+    }
+    EndIteration(iteration_cookie);
+    CloseArchive(handle);
+  }
+}
+BENCHMARK(Iterate_all_files_many_entries)->Arg(10000)->Arg(60000);
+
+static TemporaryFile* CreateLargeEntriesZip(size_t entry_count, size_t entry_size) {
+  TemporaryFile* result = new TemporaryFile;
+  FILE* fp = fdopen(result->fd, "w");
+
+  ZipWriter writer(fp);
+  std::vector<uint8_t> data(entry_size);
+  for (size_t i = 0; i < entry_count; i++) {
+    // Mildly compressible data, so that inflating it takes some work.
+    for (size_t j = 0; j < data.size(); j++) {
+      data[j] = static_cast<uint8_t>((i * 7 + j * 13 + (j >> 7)) & 0x3f);
+    }
+    writer.StartEntry(("entry" + std::to_string(i)).c_str(), ZipWriter::kCompress);
+    writer.WriteBytes(data.data(), data.size());
+    writer.FinishEntry();
+  }
+  writer.Finish();
+  fclose(fp);
+
+  return result;
+}
+
+static void ExtractEntriesToFiles_threads(benchmark::State& state) {
+  static constexpr size_t kEntryCount = 16;
+  std::unique_ptr<TemporaryFile> temp_file(CreateLargeEntriesZip(kEntryCount, 1024 * 1024));
+  ZipArchiveHandle handle;
+  OpenArchive(temp_file->path, &handle);
+
+  std::vector<ZipEntry> entries(kEntryCount);
+  for (size_t i = 0; i < kEntryCount; i++) {
+    std::string name = "entry" + std::to_string(i);
+    FindEntry(handle, ZipString(name.c_str()), &entries[i]);
+  }
+  std::vector<TemporaryFile> outputs(kEntryCount);
+  std::vector<int> fds;
+  for (const auto& output : outputs) {
+    fds.push_back(output.fd);
+  }
+
+  while (state.KeepRunning()) {
+    for (int fd : fds) {
+      lseek(fd, 0, SEEK_SET);
+    }
+    ExtractEntriesToFiles(handle, entries.data(), fds.data(), kEntryCount, state.range(0));
+  }
+  CloseArchive(handle);
+}
+BENCHMARK(ExtractEntriesToFiles_threads)->Arg(1)->Arg(2)->Arg(4)->Arg(8)->UseRealTime();
+
+// Stand-ins for the entries that are read at app startup: a dex file, which
+// compresses poorly, and a resource table, which is mostly repetitive UTF-16
+// strings.
+static std::vector<uint8_t> DexLikeData() {
+  std::vector<uint8_t> data(8 * 1024 * 1024);
+  uint32_t state = 1;
+  for (size_t i = 0; i < data.size(); i++) {
+    state = state * 1103515245 + 12345;
+    data[i] = (i % 4 == 3) ? 0 : static_cast<uint8_t>((state >> 16) & 0x7f);
+  }
+  return data;
+}
+
+static std::vector<uint8_t> ArscLikeData() {
+  std::vector<uint8_t> data;
+  for (size_t i = 0; data.size() < 2 * 1024 * 1024; i++) {
+    std::string s = "com.example.app:string/label_" + std::to_string(i % 5000);
+    for (char c : s) {
+      data.push_back(c);
+      data.push_back(0);
+    }
+  }
+  return data;
+}
+
+static void ExtractToMemory_entry(benchmark::State& state, const std::vector<uint8_t>& contents) {
+  TemporaryFile temp_file;
+  FILE* fp = fdopen(temp_file.release(), "w");
+  ZipWriter writer(fp);
+  writer.StartEntry("entry", ZipWriter::kCompress);
+  writer.WriteBytes(contents.data(), contents.size());
+  writer.FinishEntry();
+  writer.Finish();
+  fclose(fp);
+
+  ZipArchiveHandle handle;
+  OpenArchive(temp_file.path, &handle);
+  ZipEntry entry;
+  FindEntry(handle, ZipString("entry"), &entry);
+  std::vector<uint8_t> buffer(entry.uncompressed_length);
+
+  while (state.KeepRunning()) {
+    ExtractToMemory(handle, &entry, buffer.data(), buffer.size());
+  }
+  state.SetBytesProcessed(state.iterations() * buffer.size());
+  CloseArchive(handle);
+}
+
+static void ExtractToMemory_dex(benchmark::State& state) {
+  ExtractToMemory_entry(state, DexLikeData());
+}
+BENCHMARK(ExtractToMemory_dex);
+
+static void ExtractToMemory_arsc(benchmark::State& state) {
+  ExtractToMemory_entry(state, ArscLikeData());
+}
+BENCHMARK(ExtractToMemory_arsc);
+
+static void ZipWriter_compress_threads(benchmark::State& state) {
+  const std::vector<uint8_t> data = ArscLikeData();
+
+  while (state.KeepRunning()) {
+    TemporaryFile temp_file;
+    FILE* fp = fdopen(temp_file.release(), "w");
+    ZipWriter writer(fp);
+    writer.SetCompressionThreads(state.range(0));
+    for (size_t i = 0; i < 4; i++) {
+      writer.StartEntry(("entry" + std::to_string(i)).c_str(), ZipWriter::kCompress);
+      writer.WriteBytes(data.data(), data.size());
+      writer.FinishEntry();
+    }
+    writer.Finish();
+    fclose(fp);
+  }
+  state.SetBytesProcessed(state.iterations() * data.size() * 4);
+}
+BENCHMARK(ZipWriter_compress_threads)->Arg(1)->Arg(2)->Arg(4)->Arg(8)->UseRealTime();
+
 BENCHMARK_MAIN();
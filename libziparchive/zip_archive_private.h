@@ -143,10 +143,14 @@ class CentralDirectory {
  * that pointer, 2 bytes. Because of alignment, the structure consumes 16 bytes, wasting 6 bytes.
  * ZipStringOffset stores a 4 byte offset from a fixed location in the memory mapped file instead
  * of the entire address, consuming 8 bytes with alignment.
+ *
+ * The remaining 2 bytes hold the top bits of the name's hash, so that most mismatches during
+ * probing are rejected without touching the name bytes in the central directory.
  */
 struct ZipStringOffset {
   uint32_t name_offset;
   uint16_t name_length;
+  uint16_t name_hash_tag;
 
   const ZipString GetZipString(const uint8_t* start) const {
     ZipString zip_string;
@@ -406,7 +406,92 @@ TEST(ziparchive, ExtractToFile) {
             lseek(tmp_file.fd, 0, SEEK_END));
 }
 
+TEST(ziparchive, ExtractEntriesToFiles) {
+  ZipArchiveHandle handle;
+  ASSERT_EQ(0, OpenArchiveWrapper(kValidZip, &handle));
+
+  const std::vector<std::string> names{kATxtName, kBTxtName, kATxtName, kBTxtName};
+  const std::vector<const std::vector<uint8_t>*> contents{&kATxtContents, &kBTxtContents,
+                                                          &kATxtContents, &kBTxtContents};
+  std::vector<ZipEntry> entries(names.size());
+  for (size_t i = 0; i < names.size(); i++) {
+    ZipString name;
+    SetZipString(&name, names[i]);
+    ASSERT_EQ(0, FindEntry(handle, name, &entries[i]));
+  }
+
+  std::vector<TemporaryFile> tmp_files(names.size());
+  std::vector<int> fds;
+  for (const auto& tmp_file : tmp_files) {
+    ASSERT_NE(-1, tmp_file.fd);
+    fds.push_back(tmp_file.fd);
+  }
+  ASSERT_EQ(0, ExtractEntriesToFiles(handle, entries.data(), fds.data(), entries.size(), 2));
+
+  for (size_t i = 0; i < names.size(); i++) {
+    std::string file_contents;
+    ASSERT_TRUE(android::base::ReadFileToString(tmp_files[i].path, &file_contents));
+    ASSERT_EQ(std::string(contents[i]->begin(), contents[i]->end()), file_contents);
+  }
+
+  // A failing entry is reported.
+  fds[1] = -1;
+  ASSERT_EQ(kIoError, ExtractEntriesToFiles(handle, entries.data(), fds.data(), entries.size()));
+
+  CloseArchive(handle);
+}
+
+TEST(ziparchive, MapStoredEntry) {
+  ZipArchiveHandle handle;
+  ASSERT_EQ(0, OpenArchiveWrapper(kLargeZip, &handle));
+
+  ZipEntry entry;
+  ZipString name;
+  SetZipString(&name, kLargeUncompressTxtName);
+  ASSERT_EQ(0, FindEntry(handle, name, &entry));
+  std::vector<uint8_t> buffer(entry.uncompressed_length);
+  ASSERT_EQ(0, ExtractToMemory(handle, &entry, buffer.data(), buffer.size()));
+
+  zip_archive::MappedEntry mapped_entry;
+  ASSERT_EQ(0, zip_archive::MapStoredEntry(handle, &entry, &mapped_entry));
+  ASSERT_EQ(buffer.size(), mapped_entry.size());
+  ASSERT_EQ(0, memcmp(buffer.data(), mapped_entry.data(), buffer.size()));
+
+  // Compressed entries can't be used in place.
+  SetZipString(&name, kLargeCompressTxtName);
+  ASSERT_EQ(0, FindEntry(handle, name, &entry));
+  ASSERT_EQ(kMmapFailed, zip_archive::MapStoredEntry(handle, &entry, &mapped_entry));
+
+  CloseArchive(handle);
+}
+
 #if !defined(_WIN32)
+TEST(ziparchive, MapStoredEntryFromMemory) {
+  const std::string zip_path = test_data_dir + "/" + kValidZip;
+  android::base::unique_fd fd(open(zip_path.c_str(), O_RDONLY | O_BINARY));
+  ASSERT_NE(-1, fd);
+  struct stat sb;
+  ASSERT_EQ(0, fstat(fd, &sb));
+  auto file_map{android::base::MappedFile::FromFd(fd, 0, sb.st_size, PROT_READ)};
+  ZipArchiveHandle handle;
+  ASSERT_EQ(0,
+            OpenArchiveFromMemory(file_map->data(), file_map->size(), zip_path.c_str(), &handle));
+
+  ZipEntry entry;
+  ZipString name;
+  SetZipString(&name, kBTxtName);
+  ASSERT_EQ(0, FindEntry(handle, name, &entry));
+  zip_archive::MappedEntry mapped_entry;
+  ASSERT_EQ(0, zip_archive::MapStoredEntry(handle, &entry, &mapped_entry));
+  ASSERT_EQ(kBTxtContents.size(), mapped_entry.size());
+  ASSERT_EQ(0, memcmp(kBTxtContents.data(), mapped_entry.data(), kBTxtContents.size()));
+  // The data is used where it is, in the caller's mapping.
+  ASSERT_EQ(reinterpret_cast<const uint8_t*>(file_map->data()) + entry.offset,
+            mapped_entry.data());
+
+  CloseArchive(handle);
+}
+
 TEST(ziparchive, OpenFromMemory) {
   const std::string zip_path = test_data_dir + "/" + kUpdateZip;
   android::base::unique_fd fd(open(zip_path.c_str(), O_RDONLY | O_BINARY));
@@ -722,6 +807,27 @@ class VectorWriter : public zip_archive::Writer {
   std::vector<uint8_t> output_;
 };
 
+// A writer that lets Inflate() decompress straight into its vector.
+class BufferWriter : public zip_archive::Writer {
+ public:
+  BufferWriter() : Writer() {}
+
+  bool Append(uint8_t* buf, size_t size) {
+    output_.insert(output_.end(), buf, buf + size);
+    return true;
+  }
+
+  uint8_t* GetBuffer(size_t length) {
+    output_.resize(output_.size() + length);
+    return &output_[output_.size() - length];
+  }
+
+  std::vector<uint8_t>& GetOutput() { return output_; }
+
+ private:
+  std::vector<uint8_t> output_;
+};
+
 class BadReader : public zip_archive::Reader {
  public:
   BadReader() : Reader() {}
@@ -775,4 +881,31 @@ TEST(ziparchive, Inflate) {
     ASSERT_EQ(kIoError, ret);
     ASSERT_EQ(0u, writer.GetOutput().size());
   }
+
+  {
+    BufferWriter writer;
+    uint64_t crc_out = 0;
+    int32_t ret =
+        zip_archive::Inflate(reader, compressed_length, uncompressed_length, &writer, &crc_out);
+    ASSERT_EQ(0, ret);
+    ASSERT_EQ(kATxtContents, writer.GetOutput());
+    ASSERT_EQ(0x950821C5u, crc_out);
+  }
+
+  {
+    // More data than declared doesn't overrun the buffer.
+    BufferWriter writer;
+    int32_t ret =
+        zip_archive::Inflate(reader, compressed_length, uncompressed_length - 1, &writer, nullptr);
+    ASSERT_EQ(kInconsistentInformation, ret);
+    ASSERT_EQ(uncompressed_length - 1, writer.GetOutput().size());
+  }
+
+  {
+    // Less data than declared.
+    BufferWriter writer;
+    int32_t ret =
+        zip_archive::Inflate(reader, compressed_length, uncompressed_length + 1, &writer, nullptr);
+    ASSERT_EQ(kInconsistentInformation, ret);
+  }
 }
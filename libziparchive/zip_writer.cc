@@ -22,6 +22,8 @@
 #include <cstdio>
 #define DEF_MEM_LEVEL 8  // normally in zutil.h?
 
+#include <algorithm>
+#include <future>
 #include <memory>
 #include <vector>
 
@@ -43,6 +45,11 @@ enum {
 // Size of the output buffer used for compression.
 static const size_t kBufSize = 32768u;
 
+// Size of the input blocks deflated separately by parallel compression, and of the preceding
+// data each block is primed with (the deflate window).
+static const size_t kParallelBlockSize = 128 * 1024u;
+static const size_t kDictionarySize = 32768u;
+
 // No error, operation completed successfully.
 static const int32_t kNoError = 0;
 
@@ -86,7 +93,9 @@ ZipWriter::ZipWriter(FILE* f)
       current_offset_(0),
       state_(State::kWritingZip),
       z_stream_(nullptr, DeleteZStream),
-      buffer_(kBufSize) {
+      buffer_(kBufSize),
+      compression_threads_(0),
+      parallel_entry_(false) {
   // Check if the file is seekable (regular file). If fstat fails, that's fine, subsequent calls
   // will fail as well.
   struct stat file_stats;
@@ -102,7 +111,12 @@ ZipWriter::ZipWriter(ZipWriter&& writer) noexcept
       state_(writer.state_),
       files_(std::move(writer.files_)),
       z_stream_(std::move(writer.z_stream_)),
-      buffer_(std::move(writer.buffer_)) {
+      buffer_(std::move(writer.buffer_)),
+      compression_threads_(writer.compression_threads_),
+      parallel_entry_(writer.parallel_entry_),
+      block_(std::move(writer.block_)),
+      dictionary_(std::move(writer.dictionary_)),
+      pending_blocks_(std::move(writer.pending_blocks_)) {
   writer.file_ = nullptr;
   writer.state_ = State::kError;
 }
@@ -115,14 +129,24 @@ ZipWriter& ZipWriter::operator=(ZipWriter&& writer) noexcept {
   files_ = std::move(writer.files_);
   z_stream_ = std::move(writer.z_stream_);
   buffer_ = std::move(writer.buffer_);
+  compression_threads_ = writer.compression_threads_;
+  parallel_entry_ = writer.parallel_entry_;
+  block_ = std::move(writer.block_);
+  dictionary_ = std::move(writer.dictionary_);
+  pending_blocks_ = std::move(writer.pending_blocks_);
   writer.file_ = nullptr;
   writer.state_ = State::kError;
   return *this;
 }
 
+void ZipWriter::SetCompressionThreads(size_t threads) {
+  compression_threads_ = threads;
+}
+
 int32_t ZipWriter::HandleError(int32_t error_code) {
   state_ = State::kError;
   z_stream_.reset();
+  pending_blocks_.clear();
   return error_code;
 }
 
@@ -216,12 +240,19 @@ int32_t ZipWriter::StartAlignedEntryWithTime(const char* path, size_t flags, tim
     return kInvalidEntryName;
   }
 
+  parallel_entry_ = false;
   if (flags & ZipWriter::kCompress) {
     file_entry.compression_method = kCompressDeflated;
 
-    int32_t result = PrepareDeflate();
-    if (result != kNoError) {
-      return result;
+    if (compression_threads_ > 1) {
+      parallel_entry_ = true;
+      block_.clear();
+      dictionary_.clear();
+    } else {
+      int32_t result = PrepareDeflate();
+      if (result != kNoError) {
+        return result;
+      }
     }
   } else {
     file_entry.compression_method = kCompressStored;
@@ -347,8 +378,114 @@ int32_t ZipWriter::StoreBytes(FileEntry* file, const void* data, size_t len) {
   return kNoError;
 }
 
+// Deflates |input| on its own, as it would be deflated following |dictionary| in a single
+// stream. All blocks but the last end with a sync flush, so they can be concatenated.
+static std::vector<uint8_t> DeflateBlock(std::vector<uint8_t> dictionary,
+                                         std::vector<uint8_t> input, bool last) {
+  z_stream stream = {};
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wold-style-cast"
+  int zerr = deflateInit2(&stream, Z_BEST_COMPRESSION, Z_DEFLATED, -MAX_WBITS, DEF_MEM_LEVEL,
+                          Z_DEFAULT_STRATEGY);
+#pragma GCC diagnostic pop
+  if (zerr != Z_OK) {
+    LOG(ERROR) << "deflateInit2 failed (zerr=" << zerr << ")";
+    return {};
+  }
+
+  if (!dictionary.empty() &&
+      (zerr = deflateSetDictionary(&stream, dictionary.data(), dictionary.size())) != Z_OK) {
+    LOG(ERROR) << "deflateSetDictionary failed (zerr=" << zerr << ")";
+    deflateEnd(&stream);
+    return {};
+  }
+
+  // deflateBound() doesn't account for the sync flush, so be ready to grow the output.
+  std::vector<uint8_t> output(deflateBound(&stream, input.size()) + 16);
+  stream.next_in = input.data();
+  stream.avail_in = input.size();
+  const int flush = last ? Z_FINISH : Z_SYNC_FLUSH;
+  while (true) {
+    stream.next_out = output.data() + stream.total_out;
+    stream.avail_out = output.size() - stream.total_out;
+    zerr = deflate(&stream, flush);
+    if (zerr == Z_STREAM_ERROR) {
+      LOG(ERROR) << "deflate failed (zerr=" << zerr << ")";
+      deflateEnd(&stream);
+      return {};
+    }
+    if (last ? zerr == Z_STREAM_END : stream.avail_out != 0) {
+      break;
+    }
+    output.resize(output.size() * 2);
+  }
+  output.resize(stream.total_out);
+  deflateEnd(&stream);
+  return output;
+}
+
+int32_t ZipWriter::SubmitBlock(bool last) {
+  std::vector<uint8_t> input;
+  input.swap(block_);
+  std::vector<uint8_t> dictionary = dictionary_;
+
+  // The next block is primed with the end of this one.
+  dictionary_.insert(dictionary_.end(), input.end() - std::min(input.size(), kDictionarySize),
+                     input.end());
+  if (dictionary_.size() > kDictionarySize) {
+    dictionary_.erase(dictionary_.begin(), dictionary_.end() - kDictionarySize);
+  }
+
+  pending_blocks_.push_back(std::async(std::launch::async, DeflateBlock, std::move(dictionary),
+                                       std::move(input), last));
+
+  // Keep every thread busy, but don't hold on to more data than that.
+  while (pending_blocks_.size() > compression_threads_) {
+    int32_t result = WritePendingBlock(&current_file_entry_);
+    if (result != kNoError) {
+      return result;
+    }
+  }
+  block_.reserve(kParallelBlockSize);
+  return kNoError;
+}
+
+int32_t ZipWriter::WritePendingBlock(FileEntry* file) {
+  std::vector<uint8_t> output = pending_blocks_.front().get();
+  pending_blocks_.pop_front();
+  if (output.empty()) {
+    return HandleError(kZlibError);
+  }
+
+  if (fwrite(output.data(), 1, output.size(), file_) != output.size()) {
+    return HandleError(kIoError);
+  }
+  file->compressed_size += output.size();
+  current_offset_ += output.size();
+  return kNoError;
+}
+
 int32_t ZipWriter::CompressBytes(FileEntry* file, const void* data, size_t len) {
   CHECK(state_ == State::kWritingEntry);
+
+  if (parallel_entry_) {
+    const uint8_t* input = reinterpret_cast<const uint8_t*>(data);
+    while (len > 0) {
+      const size_t count = std::min(len, kParallelBlockSize - block_.size());
+      block_.insert(block_.end(), input, input + count);
+      input += count;
+      len -= count;
+      if (block_.size() == kParallelBlockSize) {
+        int32_t result = SubmitBlock(false);
+        if (result != kNoError) {
+          return result;
+        }
+      }
+    }
+    return kNoError;
+  }
+
   CHECK(z_stream_);
   CHECK(z_stream_->next_out != nullptr);
   CHECK(z_stream_->avail_out != 0);
@@ -383,6 +520,15 @@ int32_t ZipWriter::CompressBytes(FileEntry* file, const void* data, size_t len)
 
 int32_t ZipWriter::FlushCompressedBytes(FileEntry* file) {
   CHECK(state_ == State::kWritingEntry);
+
+  if (parallel_entry_) {
+    int32_t result = SubmitBlock(true);
+    while (result == kNoError && !pending_blocks_.empty()) {
+      result = WritePendingBlock(file);
+    }
+    return result;
+  }
+
   CHECK(z_stream_);
   CHECK(z_stream_->next_out != nullptr);
   CHECK(z_stream_->avail_out != 0);
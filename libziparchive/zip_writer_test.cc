@@ -17,9 +17,11 @@
 #include "ziparchive/zip_writer.h"
 #include "ziparchive/zip_archive.h"
 
+#include <android-base/file.h>
 #include <android-base/test_utils.h>
 #include <gtest/gtest.h>
 #include <time.h>
+#include <algorithm>
 #include <memory>
 #include <vector>
 
@@ -286,6 +288,70 @@ TEST_F(zipwriter, WriteCompressedZipFlushFull) {
   CloseArchive(handle);
 }
 
+// Writes a few compressed entries on |threads| threads to |file|.
+static void WriteParallelCompressedZip(FILE* file, size_t threads,
+                                       const std::vector<uint8_t>& large) {
+  ZipWriter writer(file);
+  writer.SetCompressionThreads(threads);
+
+  ASSERT_EQ(0, writer.StartEntry("large.bin", ZipWriter::kCompress));
+  // Odd sized writes, so that blocks are filled across calls.
+  for (size_t offset = 0; offset < large.size(); offset += 77777) {
+    ASSERT_EQ(0, writer.WriteBytes(large.data() + offset,
+                                   std::min<size_t>(77777, large.size() - offset)));
+  }
+  ASSERT_EQ(0, writer.FinishEntry());
+
+  ASSERT_EQ(0, writer.StartEntry("small.txt", ZipWriter::kCompress));
+  ASSERT_EQ(0, writer.WriteBytes("helo", 4));
+  ASSERT_EQ(0, writer.FinishEntry());
+
+  ASSERT_EQ(0, writer.StartEntry("empty.txt", ZipWriter::kCompress));
+  ASSERT_EQ(0, writer.FinishEntry());
+
+  ASSERT_EQ(0, writer.Finish());
+}
+
+TEST_F(zipwriter, WriteCompressedZipParallel) {
+  std::vector<uint8_t> large(1024 * 1024 + 123);
+  for (size_t i = 0; i < large.size(); i++) {
+    large[i] = static_cast<uint8_t>((i * 7) ^ (i >> 10));
+  }
+  WriteParallelCompressedZip(file_, 4, large);
+  ASSERT_EQ(0, fflush(file_));
+
+  ZipArchiveHandle handle;
+  ASSERT_EQ(0, OpenArchiveFd(fd_, "temp", &handle, false));
+
+  ZipEntry data;
+  ASSERT_EQ(0, FindEntry(handle, ZipString("large.bin"), &data));
+  EXPECT_EQ(kCompressDeflated, data.method);
+  ASSERT_EQ(large.size(), data.uncompressed_length);
+  EXPECT_LT(data.compressed_length, data.uncompressed_length);
+  std::vector<uint8_t> decompress(large.size());
+  ASSERT_EQ(0, ExtractToMemory(handle, &data, decompress.data(), decompress.size()));
+  EXPECT_EQ(large, decompress);
+
+  ASSERT_EQ(0, FindEntry(handle, ZipString("small.txt"), &data));
+  ASSERT_TRUE(AssertFileEntryContentsEq("helo", handle, &data));
+  ASSERT_EQ(0, FindEntry(handle, ZipString("empty.txt"), &data));
+  ASSERT_TRUE(AssertFileEntryContentsEq("", handle, &data));
+  CloseArchive(handle);
+
+  // The output doesn't depend on the number of threads.
+  TemporaryFile other_file;
+  FILE* other = fdopen(other_file.release(), "w");
+  ASSERT_NE(nullptr, other);
+  WriteParallelCompressedZip(other, 2, large);
+  fclose(other);
+
+  std::string contents;
+  std::string other_contents;
+  ASSERT_TRUE(android::base::ReadFileToString(temp_file_->path, &contents));
+  ASSERT_TRUE(android::base::ReadFileToString(other_file.path, &other_contents));
+  EXPECT_EQ(contents, other_contents);
+}
+
 TEST_F(zipwriter, CheckStartEntryErrors) {
   ZipWriter writer(file_);
 
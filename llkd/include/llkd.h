@@ -49,6 +49,8 @@ unsigned llkCheckMilliseconds(void);
 #define LLK_CHECK_MS_PROPERTY          "ro.llk.check_ms"
 /* LLK_CHECK_MS_DEFAULT = actual timeout_ms / LLK_CHECKS_PER_TIMEOUT_DEFAULT */
 #define LLK_CHECKS_PER_TIMEOUT_DEFAULT 5
+#define LLK_FULL_SCAN_MS_PROPERTY      "ro.llk.full_scan_ms"
+/* LLK_FULL_SCAN_MS_DEFAULT = LLK_CHECK_MS, every check reads all threads */
 #define LLK_CHECK_STACK_PROPERTY       "ro.llk.stack"
 #define LLK_CHECK_STACK_DEFAULT        \
     "cma_alloc,__get_user_pages,bit_wait_io,wait_on_page_bit_killable"
@@ -85,6 +85,9 @@ enum {                                               // enum of state indexes
 milliseconds llkStateTimeoutMs[llkNumStates];        // timeout override for each detection state
 milliseconds llkCheckMs;                             // checking interval to inspect any
                                                      // persistent live-locked states
+milliseconds llkFullScanMs;                          // interval to re-read all threads,
+                                                     // in between only D, Z or new ones
+milliseconds llkFullScanUpdate;                      // llkUpdate of the last full scan
 bool llkLowRam;                                      // ro.config.low_ram
 bool llkEnableSysrqT = LLK_ENABLE_SYSRQ_T_DEFAULT;   // sysrq stack trace dump
 bool khtEnable = LLK_ENABLE_DEFAULT;                 // [khungtaskd] panic
@@ -232,6 +235,16 @@ std::string ReadFile(std::string&& path) {
     return content;
 }
 
+// Same as above, but reads into the caller's buffer so that a scan over
+// every task reuses one allocation instead of making one per read.
+bool ReadFile(const std::string& path, std::string* content) {
+    if (!android::base::ReadFileToString(path, content)) {
+        PLOG(DEBUG) << "Read " << path << " failed";
+        content->clear();
+    }
+    return !content->empty();
+}
+
 std::string llkProcGetName(pid_t tid, const char* node = "/cmdline") {
     std::string content = ReadFile(procdir + std::to_string(tid) + node);
     static constexpr char needles[] = " \t\r\n";  // including trailing nul
@@ -415,6 +428,7 @@ void llkValidate() {
     }
 
     llkCheckMs = std::max(llkCheckMs, LLK_CHECK_MS_MINIMUM);
+    llkFullScanMs = std::max(llkFullScanMs, llkCheckMs);
     if (llkCycle == 0ms) {
         llkCycle = llkCheckMs;
     }
@@ -907,6 +921,7 @@ void llkLogConfig(void) {
               << "\n"
 #endif
               << LLK_CHECK_MS_PROPERTY "=" << llkFormat(llkCheckMs) << "\n"
+              << LLK_FULL_SCAN_MS_PROPERTY "=" << llkFormat(llkFullScanMs) << "\n"
 #ifdef __PTRACE_ENABLED__
               << LLK_CHECK_STACK_PROPERTY "=" << llkFormat(llkCheckStackSymbols) << "\n"
               << LLK_BLACKLIST_STACK_PROPERTY "=" << llkFormat(llkBlacklistStack) << "\n"
@@ -990,6 +1005,16 @@ milliseconds llkCheck(bool checkRunning) {
     auto myPid = ::getpid();
     auto myTid = ::gettid();
     auto dump = true;
+    // Threads that were last seen outside of D or Z state are only re-read every
+    // llkFullScanMs, so that most checks scale with the suspicious threads.  Stack
+    // symbol checking looks at threads in any state, so it always scans everything.
+    auto fullScan = tids.empty() || (llkFullScanMs <= llkCheckMs) ||
+                    ((llkUpdate - llkFullScanUpdate) >= llkFullScanMs);
+#ifdef __PTRACE_ENABLED__
+    if (!llkCheckStackSymbols.empty()) fullScan = true;
+#endif
+    if (fullScan) llkFullScanUpdate = llkUpdate;
+    std::string stat;
     for (auto dp = llkTopDirectory.read(); dp != nullptr; dp = llkTopDirectory.read()) {
         std::string piddir;
 
@@ -1011,9 +1036,20 @@ milliseconds llkCheck(bool checkRunning) {
                 continue;
             }
 
+            if (!fullScan) {
+                auto procp = llkTidLookup(::atoi(tp->d_name));
+                if ((procp != nullptr) && (procp->state != '?') &&
+                    !llkIsMonitorState(procp->state)) {
+                    procp->updated = true;
+                    if (pid == -1) {
+                        pid = procp->pid;
+                    }
+                    continue;
+                }
+            }
+
             // Get the process stat
-            std::string stat = ReadFile(piddir + "/stat");
-            if (stat.empty()) {
+            if (!ReadFile(piddir + "/stat", &stat)) {
                 continue;
             }
             unsigned tid = -1;
@@ -1288,6 +1324,7 @@ bool llkInit(const char* threadname) {
     llkStateTimeoutMs[llkStateStack] = GetUintProperty(LLK_STACK_TIMEOUT_MS_PROPERTY, llkTimeoutMs);
 #endif
     llkCheckMs = GetUintProperty(LLK_CHECK_MS_PROPERTY, llkCheckMs);
+    llkFullScanMs = GetUintProperty(LLK_FULL_SCAN_MS_PROPERTY, llkCheckMs);
     llkValidate();  // validate all (effectively minus llkTimeoutMs)
 #ifdef __PTRACE_ENABLED__
     if (debuggable) {
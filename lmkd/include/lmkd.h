@@ -32,6 +32,7 @@ enum lmk_cmd {
     LMK_PROCREMOVE,  /* Unregister a process */
     LMK_PROCPURGE,   /* Purge all registered processes */
     LMK_GETKILLCNT,  /* Get number of kills */
+    LMK_PROCPRIO_BATCH, /* Register processes and set their oom_adj_scores */
 };
 
 /*
@@ -39,12 +40,17 @@ enum lmk_cmd {
  */
 #define MAX_TARGETS 6
 
+/*
+ * Max number of processes in LMK_PROCPRIO_BATCH command.
+ */
+#define MAX_PROCPRIO_BATCH 16
+
 /*
  * Max packet length in bytes.
- * Longest packet is LMK_TARGET followed by MAX_TARGETS
- * of minfree and oom_adj_score values
+ * Longest packet is LMK_PROCPRIO_BATCH followed by MAX_PROCPRIO_BATCH
+ * of pid, uid and oom_adj_score values
  */
-#define CTRL_PACKET_MAX_SIZE (sizeof(int) * (MAX_TARGETS * 2 + 1))
+#define CTRL_PACKET_MAX_SIZE (sizeof(int) * (MAX_PROCPRIO_BATCH * 3 + 1))
 
 /* LMKD packet - first int is lmk_cmd followed by payload */
 typedef int LMKD_CTRL_PACKET[CTRL_PACKET_MAX_SIZE / sizeof(int)];
@@ -119,6 +125,36 @@ inline size_t lmkd_pack_set_procprio(LMKD_CTRL_PACKET packet,
     return 4 * sizeof(int);
 }
 
+/*
+ * For LMK_PROCPRIO_BATCH packet get proc_idx-th payload.
+ * Warning: no checks performed, caller should ensure valid parameters.
+ */
+inline void lmkd_pack_get_procprio_batch(LMKD_CTRL_PACKET packet,
+                                         int proc_idx, struct lmk_procprio *params) {
+    params->pid = (pid_t)ntohl(packet[proc_idx * 3 + 1]);
+    params->uid = (uid_t)ntohl(packet[proc_idx * 3 + 2]);
+    params->oomadj = ntohl(packet[proc_idx * 3 + 3]);
+}
+
+/*
+ * Prepare LMK_PROCPRIO_BATCH packet and return packet size in bytes.
+ * Warning: no checks performed, caller should ensure valid parameters.
+ */
+inline size_t lmkd_pack_set_procprio_batch(LMKD_CTRL_PACKET packet,
+                                           struct lmk_procprio *params,
+                                           size_t proc_cnt) {
+    int idx = 0;
+    packet[idx++] = htonl(LMK_PROCPRIO_BATCH);
+    while (proc_cnt) {
+        packet[idx++] = htonl(params->pid);
+        packet[idx++] = htonl(params->uid);
+        packet[idx++] = htonl(params->oomadj);
+        params++;
+        proc_cnt--;
+    }
+    return idx * sizeof(int);
+}
+
 /* LMK_PROCREMOVE packet payload */
 struct lmk_procremove {
     pid_t pid;
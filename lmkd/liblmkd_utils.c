@@ -42,6 +42,26 @@ int lmkd_register_proc(int sock, struct lmk_procprio *params) {
     return (ret < 0) ? -1 : 0;
 }
 
+int lmkd_register_procs(int sock, struct lmk_procprio *params, size_t proc_cnt) {
+    LMKD_CTRL_PACKET packet;
+    size_t batch_cnt;
+    size_t size;
+    int ret;
+
+    while (proc_cnt > 0) {
+        batch_cnt = proc_cnt < MAX_PROCPRIO_BATCH ? proc_cnt : MAX_PROCPRIO_BATCH;
+        size = lmkd_pack_set_procprio_batch(packet, params, batch_cnt);
+        ret = TEMP_FAILURE_RETRY(write(sock, packet, size));
+        if (ret < 0) {
+            return -1;
+        }
+        params += batch_cnt;
+        proc_cnt -= batch_cnt;
+    }
+
+    return 0;
+}
+
 int create_memcg(uid_t uid, pid_t pid) {
     char buf[256];
     int tasks_file;
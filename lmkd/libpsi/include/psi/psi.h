@@ -0,0 +1,66 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef __ANDROID_PSI_H__
+#define __ANDROID_PSI_H__
+
+#include <sys/cdefs.h>
+#include <sys/types.h>
+
+__BEGIN_DECLS
+
+enum psi_stall_type {
+    PSI_SOME,
+    PSI_FULL,
+    PSI_TYPE_COUNT
+};
+
+/*
+ * Initializes psi monitor and returns its file descriptor.
+ * stall_type selects whether any (PSI_SOME) or all (PSI_FULL) non-idle tasks
+ * have to be stalled on memory for the time to count, and the monitor
+ * triggers once that time exceeds threshold_us within window_us.
+ * On success returns the file descriptor of the monitor.
+ * On error, -1 is returned, and errno is set appropriately.
+ */
+int init_psi_monitor(enum psi_stall_type stall_type,
+                     int threshold_us, int window_us);
+
+/*
+ * Registers psi monitor file descriptor fd on the epoll instance epollfd.
+ * data is stored in the event and returned by epoll_wait.
+ * On success returns 0.
+ * On error, -1 is returned, and errno is set appropriately.
+ */
+int register_psi_monitor(int epollfd, int fd, void* data);
+
+/*
+ * Unregisters psi monitor file descriptor fd from the epoll instance epollfd.
+ * On success returns 0.
+ * On error, -1 is returned, and errno is set appropriately.
+ */
+int unregister_psi_monitor(int epollfd, int fd);
+
+/*
+ * Destroys psi monitor.
+ * fd is the file descriptor returned by init_psi_monitor.
+ */
+void destroy_psi_monitor(int fd);
+
+__END_DECLS
+
+#endif  // __ANDROID_PSI_H__
@@ -31,8 +31,10 @@
 #include <sys/mman.h>
 #include <sys/resource.h>
 #include <sys/socket.h>
+#include <sys/syscall.h>
 #include <sys/sysinfo.h>
 #include <sys/time.h>
+#include <sys/timerfd.h>
 #include <sys/types.h>
 #include <time.h>
 #include <unistd.h>
@@ -44,6 +46,7 @@
 #include <log/log.h>
 #include <log/log_event_list.h>
 #include <log/log_time.h>
+#include <psi/psi.h>
 #include <system/thread_defs.h>
 
 #ifdef LMKD_LOG_STATS
@@ -93,6 +96,7 @@
 #define TARGET_UPDATE_MIN_INTERVAL_MS 1000
 
 #define NS_PER_MS (NS_PER_SEC / MS_PER_SEC)
+#define US_PER_MS (US_PER_SEC / MS_PER_SEC)
 
 /* Defined as ProcessList.SYSTEM_ADJ in ProcessList.java */
 #define SYSTEM_ADJ (-900)
@@ -104,6 +108,19 @@
 
 #define FAIL_REPORT_RLIMIT_MS 1000
 
+#ifndef __NR_pidfd_open
+#define __NR_pidfd_open 434
+#endif
+
+/* Stall time over which psi monitors are triggered, in ms */
+#define PSI_WINDOW_SIZE_MS 1000
+/* Partial stall time that triggers the low psi monitor */
+#define PSI_LOW_STALL_MS 70
+/* Default partial stall time that triggers the medium psi monitor */
+#define PSI_PARTIAL_STALL_MS 100
+/* Default complete stall time that triggers the critical psi monitor */
+#define PSI_COMPLETE_STALL_MS 70
+
 /* default to old in-kernel interface if no memory pressure events */
 static bool use_inkernel_interface = true;
 static bool has_inkernel_module;
@@ -127,14 +144,26 @@ struct {
     int64_t max_nr_free_pages;
 } low_pressure_mem = { -1, -1 };
 
+struct psi_threshold {
+    enum psi_stall_type stall_type;
+    int threshold_ms;
+};
+
 static int level_oomadj[VMPRESS_LEVEL_COUNT];
 static int mpevfd[VMPRESS_LEVEL_COUNT] = { -1, -1, -1 };
+static bool use_psi_monitors = false;
+static struct psi_threshold psi_thresholds[VMPRESS_LEVEL_COUNT] = {
+    { PSI_SOME, PSI_LOW_STALL_MS },
+    { PSI_SOME, PSI_PARTIAL_STALL_MS },
+    { PSI_FULL, PSI_COMPLETE_STALL_MS },
+};
 static bool debug_process_killing;
 static bool enable_pressure_upgrade;
 static int64_t upgrade_pressure;
 static int64_t downgrade_pressure;
 static bool low_ram_device;
 static bool kill_heaviest_task;
+static unsigned long proc_size_refresh_ms;
 static unsigned long kill_timeout_ms;
 static bool use_minfree_levels;
 static bool per_app_memcg;
@@ -164,8 +193,18 @@ static struct sock_event_handler_info data_sock[MAX_DATA_CONN];
 /* vmpressure event handler data */
 static struct event_handler_info vmpressure_hinfo[VMPRESS_LEVEL_COUNT];
 
-/* 3 memory pressure levels, 1 ctrl listen socket, 2 ctrl data socket */
-#define MAX_EPOLL_EVENTS (1 + MAX_DATA_CONN + VMPRESS_LEVEL_COUNT)
+/* killed process exit handler data */
+static struct event_handler_info kill_done_hinfo;
+
+/* process size refresh timer handler data */
+static struct event_handler_info proc_size_hinfo;
+static int proc_size_timerfd = -1;
+
+/*
+ * 3 memory pressure levels, 1 ctrl listen socket, 2 ctrl data socket,
+ * 1 process size refresh timer, 1 pidfd of the last killed process
+ */
+#define MAX_EPOLL_EVENTS (1 + MAX_DATA_CONN + VMPRESS_LEVEL_COUNT + 1 + 1)
 static int epollfd;
 static int maxevents;
 
@@ -300,6 +339,8 @@ struct proc {
     int pid;
     uid_t uid;
     int oomadj;
+    /* rss in pages when last sampled, only tracked with kill_heaviest_task */
+    int size;
     struct proc *pidhash_next;
 };
 
@@ -346,19 +387,25 @@ static bool parse_int64(const char* str, int64_t* ret) {
     return true;
 }
 
+/*
+ * The kernel prints the fields in a fixed order, so the search starts right
+ * after the previously matched field (passed in *field_idx) and wraps around.
+ * That way a known line is usually matched with a single strcmp.
+ */
 static enum field_match_result match_field(const char* cp, const char* ap,
                                    const char* const field_names[],
                                    int field_count, int64_t* field,
                                    int *field_idx) {
-    int64_t val;
-    int i;
+    int start = (*field_idx + 1) % field_count;
+    int i = start;
 
-    for (i = 0; i < field_count; i++) {
+    do {
         if (!strcmp(cp, field_names[i])) {
             *field_idx = i;
             return parse_int64(ap, field) ? PARSE_SUCCESS : PARSE_FAIL;
         }
-    }
+        i = (i + 1) % field_count;
+    } while (i != start);
     return NO_MATCH;
 }
 
@@ -454,8 +501,19 @@ static struct adjslot_list *adjslot_tail(struct adjslot_list *head) {
 
 static void proc_slot(struct proc *procp) {
     int adjslot = ADJTOSLOT(procp->oomadj);
+    struct adjslot_list *head = &procadjslot_list[adjslot];
+    struct adjslot_list *prev = head;
 
-    adjslot_insert(&procadjslot_list[adjslot], &procp->asl);
+    /*
+     * When killing the heaviest task slots are kept sorted by size, largest
+     * first, so that picking a victim doesn't need to read every process size.
+     */
+    if (kill_heaviest_task) {
+        while (prev->next != head && ((struct proc *)prev->next)->size > procp->size) {
+            prev = prev->next;
+        }
+    }
+    adjslot_insert(prev, &procp->asl);
 }
 
 static void proc_unslot(struct proc *procp) {
@@ -526,17 +584,16 @@ static inline long get_time_diff_ms(struct timespec *from,
            (to->tv_nsec - from->tv_nsec) / (long)NS_PER_MS;
 }
 
-static void cmd_procprio(LMKD_CTRL_PACKET packet) {
+static int proc_get_size(int pid);
+
+static void apply_proc_prio(struct lmk_procprio params) {
     struct proc *procp;
     char path[80];
     char val[20];
     int soft_limit_mult;
-    struct lmk_procprio params;
     bool is_system_server;
     struct passwd *pwdrec;
 
-    lmkd_pack_get_procprio(packet, &params);
-
     if (params.oomadj < OOM_SCORE_ADJ_MIN ||
         params.oomadj > OOM_SCORE_ADJ_MAX) {
         ALOGE("Invalid PROCPRIO oomadj argument %d", params.oomadj);
@@ -614,14 +671,46 @@ static void cmd_procprio(LMKD_CTRL_PACKET packet) {
             procp->pid = params.pid;
             procp->uid = params.uid;
             procp->oomadj = params.oomadj;
+            procp->size = kill_heaviest_task ? proc_get_size(params.pid) : 0;
             proc_insert(procp);
     } else {
         proc_unslot(procp);
         procp->oomadj = params.oomadj;
+        if (kill_heaviest_task) {
+            procp->size = proc_get_size(params.pid);
+        }
         proc_slot(procp);
     }
 }
 
+static void cmd_procprio(LMKD_CTRL_PACKET packet) {
+    struct lmk_procprio params;
+
+    lmkd_pack_get_procprio(packet, &params);
+    apply_proc_prio(params);
+}
+
+static void cmd_procprio_batch(int proc_cnt, LMKD_CTRL_PACKET packet) {
+    struct lmk_procprio params[MAX_PROCPRIO_BATCH];
+    int i, j;
+
+    for (i = 0; i < proc_cnt; i++) {
+        lmkd_pack_get_procprio_batch(packet, i, &params[i]);
+    }
+
+    /*
+     * Bursts of state changes often update the same process more than once,
+     * only its last update is applied so oom_score_adj is written just once.
+     */
+    for (i = 0; i < proc_cnt; i++) {
+        for (j = i + 1; j < proc_cnt && params[j].pid != params[i].pid; j++)
+            ;
+        if (j == proc_cnt) {
+            apply_proc_prio(params[i]);
+        }
+    }
+}
+
 static void cmd_procremove(LMKD_CTRL_PACKET packet) {
     struct lmk_procremove params;
 
@@ -848,6 +937,7 @@ static void ctrl_command_handler(int dsock_idx) {
     enum lmk_cmd cmd;
     int nargs;
     int targets;
+    int procs;
     int kill_cnt;
 
     len = ctrl_data_read(dsock_idx, (char *)packet, CTRL_PACKET_MAX_SIZE);
@@ -894,6 +984,12 @@ static void ctrl_command_handler(int dsock_idx) {
         if (ctrl_data_write(dsock_idx, (char *)packet, len) != len)
             return;
         break;
+    case LMK_PROCPRIO_BATCH:
+        procs = nargs / 3;
+        if (nargs % 3 || procs == 0 || procs > MAX_PROCPRIO_BATCH)
+            goto wronglen;
+        cmd_procprio_batch(procs, packet);
+        break;
     default:
         ALOGE("Received unknown command code %d", cmd);
         return;
@@ -1058,12 +1154,11 @@ static int64_t zoneinfo_parse_protection(char *cp) {
     return max;
 }
 
-static bool zoneinfo_parse_line(char *line, union zoneinfo *zi) {
+static bool zoneinfo_parse_line(char *line, union zoneinfo *zi, int *field_idx) {
     char *cp = line;
     char *ap;
     char *save_ptr;
     int64_t val;
-    int field_idx;
 
     cp = strtok_r(line, " ", &save_ptr);
     if (!cp) {
@@ -1081,9 +1176,9 @@ static bool zoneinfo_parse_line(char *line, union zoneinfo *zi) {
     }
 
     switch (match_field(cp, ap, zoneinfo_field_names,
-                        ZI_FIELD_COUNT, &val, &field_idx)) {
+                        ZI_FIELD_COUNT, &val, field_idx)) {
     case (PARSE_SUCCESS):
-        zi->arr[field_idx] += val;
+        zi->arr[*field_idx] += val;
         break;
     case (NO_MATCH):
         if (!strcmp(cp, "protection:")) {
@@ -1106,6 +1201,7 @@ static int zoneinfo_parse(union zoneinfo *zi) {
     char buf[PAGE_SIZE];
     char *save_ptr;
     char *line;
+    int field_idx = -1;
 
     memset(zi, 0, sizeof(union zoneinfo));
 
@@ -1115,7 +1211,7 @@ static int zoneinfo_parse(union zoneinfo *zi) {
 
     for (line = strtok_r(buf, "\n", &save_ptr); line;
          line = strtok_r(NULL, "\n", &save_ptr)) {
-        if (!zoneinfo_parse_line(line, zi)) {
+        if (!zoneinfo_parse_line(line, zi, &field_idx)) {
             ALOGE("%s parse error", file_data.filename);
             return -1;
         }
@@ -1126,12 +1222,11 @@ static int zoneinfo_parse(union zoneinfo *zi) {
 }
 
 /* /prop/meminfo parsing routines */
-static bool meminfo_parse_line(char *line, union meminfo *mi) {
+static bool meminfo_parse_line(char *line, union meminfo *mi, int *field_idx) {
     char *cp = line;
     char *ap;
     char *save_ptr;
     int64_t val;
-    int field_idx;
     enum field_match_result match_res;
 
     cp = strtok_r(line, " ", &save_ptr);
@@ -1145,9 +1240,9 @@ static bool meminfo_parse_line(char *line, union meminfo *mi) {
     }
 
     match_res = match_field(cp, ap, meminfo_field_names, MI_FIELD_COUNT,
-        &val, &field_idx);
+        &val, field_idx);
     if (match_res == PARSE_SUCCESS) {
-        mi->arr[field_idx] = val / page_k;
+        mi->arr[*field_idx] = val / page_k;
     }
     return (match_res != PARSE_FAIL);
 }
@@ -1160,6 +1255,7 @@ static int meminfo_parse(union meminfo *mi) {
     char buf[PAGE_SIZE];
     char *save_ptr;
     char *line;
+    int field_idx = -1;
 
     memset(mi, 0, sizeof(union meminfo));
 
@@ -1169,7 +1265,7 @@ static int meminfo_parse(union meminfo *mi) {
 
     for (line = strtok_r(buf, "\n", &save_ptr); line;
          line = strtok_r(NULL, "\n", &save_ptr)) {
-        if (!meminfo_parse_line(line, mi)) {
+        if (!meminfo_parse_line(line, mi, &field_idx)) {
             ALOGE("%s parse error", file_data.filename);
             return -1;
         }
@@ -1243,27 +1339,80 @@ static struct proc *proc_adj_lru(int oomadj) {
     return (struct proc *)adjslot_tail(&procadjslot_list[ADJTOSLOT(oomadj)]);
 }
 
+/*
+ * Slots are sorted by the last sampled process size when killing the
+ * heaviest task, so the heaviest process is the first one in its slot.
+ */
 static struct proc *proc_get_heaviest(int oomadj) {
     struct adjslot_list *head = &procadjslot_list[ADJTOSLOT(oomadj)];
-    struct adjslot_list *curr = head->next;
-    struct proc *maxprocp = NULL;
-    int maxsize = 0;
-    while (curr != head) {
-        int pid = ((struct proc *)curr)->pid;
-        int tasksize = proc_get_size(pid);
-        if (tasksize <= 0) {
-            struct adjslot_list *next = curr->next;
-            pid_remove(pid);
-            curr = next;
-        } else {
-            if (tasksize > maxsize) {
-                maxsize = tasksize;
-                maxprocp = (struct proc *)curr;
+
+    return head->next == head ? NULL : (struct proc *)head->next;
+}
+
+/*
+ * Samples the size of every registered process and resorts the slots,
+ * outside of memory pressure events so that those don't have to.
+ */
+static void proc_size_refresh(int data __unused, uint32_t events __unused) {
+    uint64_t expirations;
+    struct proc *procp;
+    struct proc *next;
+    int size;
+    int i;
+
+    /* Reading the timer rearms it for epoll */
+    if (TEMP_FAILURE_RETRY(read(proc_size_timerfd, &expirations,
+                                sizeof(expirations))) < 0 && errno != EAGAIN) {
+        ALOGE("process size refresh timer read failed; errno=%d", errno);
+    }
+
+    for (i = 0; i < PIDHASH_SZ; i++) {
+        for (procp = pidhash[i]; procp; procp = next) {
+            next = procp->pidhash_next;
+            size = proc_get_size(procp->pid);
+            if (size <= 0) {
+                pid_remove(procp->pid);
+            } else if (size != procp->size) {
+                proc_unslot(procp);
+                procp->size = size;
+                proc_slot(procp);
             }
-            curr = curr->next;
         }
     }
-    return maxprocp;
+}
+
+static bool init_proc_size_refresh(void) {
+    struct itimerspec interval;
+    struct epoll_event epev;
+
+    proc_size_timerfd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (proc_size_timerfd < 0) {
+        ALOGE("timerfd_create for process size refresh failed; errno=%d", errno);
+        return false;
+    }
+
+    interval.it_interval.tv_sec = proc_size_refresh_ms / MS_PER_SEC;
+    interval.it_interval.tv_nsec = (proc_size_refresh_ms % MS_PER_SEC) * NS_PER_MS;
+    interval.it_value = interval.it_interval;
+    if (timerfd_settime(proc_size_timerfd, 0, &interval, NULL) < 0) {
+        ALOGE("timerfd_settime for process size refresh failed; errno=%d", errno);
+        goto err;
+    }
+
+    epev.events = EPOLLIN;
+    proc_size_hinfo.handler = proc_size_refresh;
+    epev.data.ptr = (void *)&proc_size_hinfo;
+    if (epoll_ctl(epollfd, EPOLL_CTL_ADD, proc_size_timerfd, &epev) == -1) {
+        ALOGE("epoll_ctl for process size refresh timer failed; errno=%d", errno);
+        goto err;
+    }
+    maxevents++;
+    return true;
+
+err:
+    close(proc_size_timerfd);
+    proc_size_timerfd = -1;
+    return false;
 }
 
 static void set_process_group_and_prio(int pid, SchedPolicy sp, int prio) {
@@ -1302,6 +1451,152 @@ static void set_process_group_and_prio(int pid, SchedPolicy sp, int prio) {
 }
 
 static int last_killed_pid = -1;
+/* pidfd of the last killed process until its exit is reported, otherwise -1 */
+static int last_kill_pidfd = -1;
+static bool pidfd_supported;
+
+static int pidfd_open(pid_t pid, unsigned int flags) {
+    return syscall(__NR_pidfd_open, pid, flags);
+}
+
+static void stop_wait_for_proc_kill(void) {
+    if (last_kill_pidfd < 0) {
+        return;
+    }
+
+    if (epoll_ctl(epollfd, EPOLL_CTL_DEL, last_kill_pidfd, NULL)) {
+        ALOGE("epoll_ctl for last killed process failed; errno=%d", errno);
+    }
+    maxevents--;
+    close(last_kill_pidfd);
+    last_kill_pidfd = -1;
+}
+
+static void kill_done_handler(int data, uint32_t events __unused) {
+    /* A later kill might have replaced the pidfd this event was queued for */
+    if (data != last_kill_pidfd) {
+        return;
+    }
+
+    if (debug_process_killing) {
+        ALOGI("Process %d exited", last_killed_pid);
+    }
+    stop_wait_for_proc_kill();
+    last_killed_pid = -1;
+}
+
+/*
+ * The pidfd becomes readable once the process has exited and released its
+ * memory, which ends the wait in mp_event_common() right when the kill has
+ * taken effect.
+ */
+static void start_wait_for_proc_kill(int pidfd) {
+    struct epoll_event epev;
+
+    stop_wait_for_proc_kill();
+
+    epev.events = EPOLLIN;
+    kill_done_hinfo.handler = kill_done_handler;
+    kill_done_hinfo.data = pidfd;
+    epev.data.ptr = (void *)&kill_done_hinfo;
+    if (epoll_ctl(epollfd, EPOLL_CTL_ADD, pidfd, &epev) != 0) {
+        ALOGE("epoll_ctl for last killed process failed; errno=%d", errno);
+        close(pidfd);
+        return;
+    }
+    maxevents++;
+    last_kill_pidfd = pidfd;
+}
+
+/*
+ * Reporting a kill reads the victim's memory stats and writes to logd and
+ * statsd, none of which has to happen before the victim is killed. Reports
+ * are queued as kills happen and sent once the events that caused them have
+ * been handled, in the order they were queued.
+ */
+enum kill_report_type {
+    KILL_REPORT_KILL,
+#ifdef LMKD_LOG_STATS
+    /* Follows the reports of the kills it ends */
+    KILL_REPORT_STATE_STOP,
+#endif
+};
+
+struct kill_report {
+    enum kill_report_type type;
+    int pid;
+    uid_t uid;
+    int oomadj;
+    int tasksize;
+    char taskname[LINE_MAX];
+};
+
+#define MAX_KILL_REPORTS 16
+static struct kill_report kill_reports[MAX_KILL_REPORTS];
+static int kill_report_count;
+
+static void send_kill_report(struct kill_report *report) {
+#ifdef LMKD_LOG_STATS
+    struct memory_stat mem_st = {};
+    int memory_stat_parse_result = -1;
+
+    if (report->type == KILL_REPORT_STATE_STOP) {
+        stats_write_lmk_state_changed(log_ctx, LMK_STATE_CHANGED, LMK_STATE_CHANGE_STOP);
+        return;
+    }
+#endif
+
+    ALOGI("Kill '%s' (%d), uid %d, oom_adj %d to free %ldkB",
+        report->taskname, report->pid, report->uid, report->oomadj, report->tasksize * page_k);
+
+#ifdef LMKD_LOG_STATS
+    if (!enable_stats_log) {
+        return;
+    }
+    /*
+     * The victim is dying or gone by now. Its fault counts and start time
+     * stay readable until it is reaped, but its resident memory is being
+     * released, so report the size sampled before it was killed.
+     */
+    if (per_app_memcg) {
+        memory_stat_parse_result = memory_stat_from_cgroup(&mem_st, report->pid, report->uid);
+    } else {
+        memory_stat_parse_result = memory_stat_from_procfs(&mem_st, report->pid);
+    }
+    if (memory_stat_parse_result == 0) {
+        stats_write_lmk_kill_occurred(log_ctx, LMK_KILL_OCCURRED, report->uid, report->taskname,
+                report->oomadj, mem_st.pgfault, mem_st.pgmajfault,
+                (int64_t)report->tasksize * page_k * BYTES_IN_KILOBYTE,
+                mem_st.cache_in_bytes, mem_st.swap_in_bytes, mem_st.process_start_time_ns);
+    } else {
+        stats_write_lmk_kill_occurred(log_ctx, LMK_KILL_OCCURRED, report->uid, report->taskname,
+                                      report->oomadj, -1, -1, report->tasksize * BYTES_IN_KILOBYTE,
+                                      -1, -1, -1);
+    }
+#endif
+}
+
+static void send_kill_reports(void) {
+    int i;
+
+    for (i = 0; i < kill_report_count; i++) {
+        send_kill_report(&kill_reports[i]);
+    }
+    kill_report_count = 0;
+}
+
+static struct kill_report *queue_kill_report(enum kill_report_type type) {
+    struct kill_report *report;
+
+    if (kill_report_count == MAX_KILL_REPORTS) {
+        /* Not expected within one epoll cycle, make room the slow way */
+        send_kill_reports();
+    }
+    report = &kill_reports[kill_report_count++];
+    memset(report, 0, sizeof(*report));
+    report->type = type;
+    return report;
+}
 
 /* Kill one process specified by procp.  Returns the size of the process killed */
 static int kill_one_process(struct proc* procp) {
@@ -1309,13 +1604,10 @@ static int kill_one_process(struct proc* procp) {
     uid_t uid = procp->uid;
     char *taskname;
     int tasksize;
+    int pidfd = -1;
     int r;
     int result = -1;
-
-#ifdef LMKD_LOG_STATS
-    struct memory_stat mem_st = {};
-    int memory_stat_parse_result = -1;
-#endif
+    struct kill_report *report;
 
     taskname = proc_get_name(pid);
     if (!taskname) {
@@ -1327,17 +1619,15 @@ static int kill_one_process(struct proc* procp) {
         goto out;
     }
 
-#ifdef LMKD_LOG_STATS
-    if (enable_stats_log) {
-        if (per_app_memcg) {
-            memory_stat_parse_result = memory_stat_from_cgroup(&mem_st, pid, uid);
-        } else {
-            memory_stat_parse_result = memory_stat_from_procfs(&mem_st, pid);
+    TRACE_KILL_START(pid);
+
+    /* Open the pidfd first, the process can be reaped as soon as it's killed */
+    if (pidfd_supported) {
+        pidfd = pidfd_open(pid, 0);
+        if (pidfd < 0) {
+            ALOGE("pidfd_open for pid %d failed; errno=%d", pid, errno);
         }
     }
-#endif
-
-    TRACE_KILL_START(pid);
 
     /* CAP_KILL required */
     r = kill(pid, SIGKILL);
@@ -1345,8 +1635,6 @@ static int kill_one_process(struct proc* procp) {
     set_process_group_and_prio(pid, SP_FOREGROUND, ANDROID_PRIORITY_HIGHEST);
 
     inc_killcnt(procp->oomadj);
-    ALOGI("Kill '%s' (%d), uid %d, oom_adj %d to free %ldkB",
-        taskname, pid, uid, procp->oomadj, tasksize * page_k);
 
     TRACE_KILL_END();
 
@@ -1354,18 +1642,20 @@ static int kill_one_process(struct proc* procp) {
 
     if (r) {
         ALOGE("kill(%d): errno=%d", pid, errno);
+        if (pidfd >= 0) {
+            close(pidfd);
+        }
         goto out;
     } else {
-#ifdef LMKD_LOG_STATS
-        if (memory_stat_parse_result == 0) {
-            stats_write_lmk_kill_occurred(log_ctx, LMK_KILL_OCCURRED, uid, taskname,
-                    procp->oomadj, mem_st.pgfault, mem_st.pgmajfault, mem_st.rss_in_bytes,
-                    mem_st.cache_in_bytes, mem_st.swap_in_bytes, mem_st.process_start_time_ns);
-        } else if (enable_stats_log) {
-            stats_write_lmk_kill_occurred(log_ctx, LMK_KILL_OCCURRED, uid, taskname, procp->oomadj,
-                                          -1, -1, tasksize * BYTES_IN_KILOBYTE, -1, -1, -1);
+        if (pidfd >= 0) {
+            start_wait_for_proc_kill(pidfd);
         }
-#endif
+        report = queue_kill_report(KILL_REPORT_KILL);
+        report->pid = pid;
+        report->uid = uid;
+        report->oomadj = procp->oomadj;
+        report->tasksize = tasksize;
+        strlcpy(report->taskname, taskname, sizeof(report->taskname));
         result = tasksize;
     }
 
@@ -1419,7 +1709,7 @@ static int find_and_kill_process(int min_score_adj) {
 
 #ifdef LMKD_LOG_STATS
     if (enable_stats_log && lmk_state_change_start) {
-        stats_write_lmk_state_changed(log_ctx, LMK_STATE_CHANGED, LMK_STATE_CHANGE_STOP);
+        queue_kill_report(KILL_REPORT_STATE_STOP);
     }
 #endif
 
@@ -1486,6 +1776,10 @@ enum vmpressure_level downgrade_level(enum vmpressure_level level) {
 static bool is_kill_pending(void) {
     char buf[24];
 
+    if (last_kill_pidfd >= 0) {
+        return true;
+    }
+
     if (last_killed_pid < 0) {
         return false;
     }
@@ -1524,17 +1818,19 @@ static void mp_event_common(int data, uint32_t events __unused) {
         .fd = -1,
     };
 
-    /*
-     * Check all event counters from low to critical
-     * and upgrade to the highest priority one. By reading
-     * eventfd we also reset the event counters.
-     */
-    for (lvl = VMPRESS_LEVEL_LOW; lvl < VMPRESS_LEVEL_COUNT; lvl++) {
-        if (mpevfd[lvl] != -1 &&
-            TEMP_FAILURE_RETRY(read(mpevfd[lvl],
-                               &evcount, sizeof(evcount))) > 0 &&
-            evcount > 0 && lvl > level) {
-            level = lvl;
+    if (!use_psi_monitors) {
+        /*
+         * Check all event counters from low to critical
+         * and upgrade to the highest priority one. By reading
+         * eventfd we also reset the event counters.
+         */
+        for (lvl = VMPRESS_LEVEL_LOW; lvl < VMPRESS_LEVEL_COUNT; lvl++) {
+            if (mpevfd[lvl] != -1 &&
+                TEMP_FAILURE_RETRY(read(mpevfd[lvl],
+                                   &evcount, sizeof(evcount))) > 0 &&
+                evcount > 0 && lvl > level) {
+                level = lvl;
+            }
         }
     }
 
@@ -1545,12 +1841,18 @@ static void mp_event_common(int data, uint32_t events __unused) {
 
     if (kill_timeout_ms) {
         // If we're within the timeout, see if there's pending reclaim work
-        // from the last killed process. If there is (as evidenced by
-        // /proc/<pid> continuing to exist), skip killing for now.
-        if ((get_time_diff_ms(&last_kill_tm, &curr_tm) < kill_timeout_ms) &&
-            (low_ram_device || is_kill_pending())) {
-            kill_skip_count++;
-            return;
+        // from the last killed process. If there is (as evidenced by its
+        // pidfd not having reported its exit yet or /proc/<pid> continuing
+        // to exist), skip killing for now. Low ram devices wait for the whole
+        // timeout unless the exit of the process can be tracked exactly.
+        if (get_time_diff_ms(&last_kill_tm, &curr_tm) < kill_timeout_ms) {
+            if ((low_ram_device && !pidfd_supported) || is_kill_pending()) {
+                kill_skip_count++;
+                return;
+            }
+        } else {
+            // The last killed process is taking too long to die, stop waiting for it.
+            stop_wait_for_proc_kill();
         }
     }
 
@@ -1722,6 +2024,60 @@ do_kill:
     }
 }
 
+static bool init_mp_psi(enum vmpressure_level level) {
+    int fd = init_psi_monitor(psi_thresholds[level].stall_type,
+        psi_thresholds[level].threshold_ms * US_PER_MS,
+        PSI_WINDOW_SIZE_MS * US_PER_MS);
+
+    if (fd < 0) {
+        return false;
+    }
+
+    vmpressure_hinfo[level].handler = mp_event_common;
+    vmpressure_hinfo[level].data = level;
+    if (register_psi_monitor(epollfd, fd, &vmpressure_hinfo[level]) < 0) {
+        destroy_psi_monitor(fd);
+        return false;
+    }
+    maxevents++;
+    mpevfd[level] = fd;
+
+    return true;
+}
+
+static void destroy_mp_psi(enum vmpressure_level level) {
+    int fd = mpevfd[level];
+
+    if (unregister_psi_monitor(epollfd, fd) < 0) {
+        ALOGE("Failed to unregister psi monitor for %s memory pressure; errno=%d",
+            level_name[level], errno);
+    }
+    destroy_psi_monitor(fd);
+    mpevfd[level] = -1;
+    maxevents--;
+}
+
+/*
+ * psi monitors only wake lmkd up when tasks actually stall on memory for
+ * longer than the threshold within a window, instead of on every vmpressure
+ * event, which is reported every time reclaim runs.
+ */
+static bool init_psi_monitors() {
+    if (!init_mp_psi(VMPRESS_LEVEL_LOW)) {
+        return false;
+    }
+    if (!init_mp_psi(VMPRESS_LEVEL_MEDIUM)) {
+        destroy_mp_psi(VMPRESS_LEVEL_LOW);
+        return false;
+    }
+    if (!init_mp_psi(VMPRESS_LEVEL_CRITICAL)) {
+        destroy_mp_psi(VMPRESS_LEVEL_MEDIUM);
+        destroy_mp_psi(VMPRESS_LEVEL_LOW);
+        return false;
+    }
+    return true;
+}
+
 static bool init_mp_common(enum vmpressure_level level) {
     int mpfd;
     int evfd;
@@ -1791,6 +2147,7 @@ err_open_mpfd:
 
 static int init(void) {
     struct epoll_event epev;
+    int pidfd;
     int i;
     int ret;
 
@@ -1831,18 +2188,37 @@ static int init(void) {
     }
     maxevents++;
 
+    /* Probe pidfd support, which is used to find out when killed processes are gone */
+    pidfd = pidfd_open(getpid(), 0);
+    if (pidfd < 0) {
+        pidfd_supported = false;
+    } else {
+        pidfd_supported = true;
+        close(pidfd);
+    }
+    ALOGI("Process exit tracking with pidfd is %ssupported", pidfd_supported ? "" : "not ");
+
     has_inkernel_module = !access(INKERNEL_MINFREE_PATH, W_OK);
     use_inkernel_interface = has_inkernel_module;
 
     if (use_inkernel_interface) {
         ALOGI("Using in-kernel low memory killer interface");
     } else {
-        if (!init_mp_common(VMPRESS_LEVEL_LOW) ||
+        /* Try to use psi monitor first if kernel has it */
+        use_psi_monitors = property_get_bool("ro.lmk.use_psi", false) &&
+            init_psi_monitors();
+        if (use_psi_monitors) {
+            ALOGI("Using psi monitors for memory pressure detection");
+        } else if (!init_mp_common(VMPRESS_LEVEL_LOW) ||
             !init_mp_common(VMPRESS_LEVEL_MEDIUM) ||
             !init_mp_common(VMPRESS_LEVEL_CRITICAL)) {
             ALOGE("Kernel does not support memory pressure events or in-kernel low memory killer");
             return -1;
         }
+
+        if (kill_heaviest_task && proc_size_refresh_ms) {
+            init_proc_size_refresh();
+        }
     }
 
     for (i = 0; i <= ADJTOSLOT(OOM_SCORE_ADJ_MAX); i++) {
@@ -1901,6 +2277,9 @@ static void mainloop(void) {
                 handler_info->handler(handler_info->data, evt->events);
             }
         }
+
+        /* Whatever was killed is on its way out, now tell everyone about it */
+        send_kill_reports();
     }
 }
 
@@ -1927,6 +2306,8 @@ int main(int argc __unused, char **argv __unused) {
         (int64_t)property_get_int32("ro.lmk.downgrade_pressure", 100);
     kill_heaviest_task =
         property_get_bool("ro.lmk.kill_heaviest_task", false);
+    proc_size_refresh_ms =
+        (unsigned long)property_get_int32("ro.lmk.proc_size_refresh_ms", 10000);
     low_ram_device = property_get_bool("ro.config.low_ram", false);
     kill_timeout_ms =
         (unsigned long)property_get_int32("ro.lmk.kill_timeout_ms", 0);
@@ -1936,6 +2317,10 @@ int main(int argc __unused, char **argv __unused) {
         property_get_bool("ro.config.per_app_memcg", low_ram_device);
     swap_free_low_percentage =
         property_get_int32("ro.lmk.swap_free_low_percentage", 10);
+    psi_thresholds[VMPRESS_LEVEL_MEDIUM].threshold_ms =
+        property_get_int32("ro.lmk.psi_partial_stall_ms", PSI_PARTIAL_STALL_MS);
+    psi_thresholds[VMPRESS_LEVEL_CRITICAL].threshold_ms =
+        property_get_int32("ro.lmk.psi_complete_stall_ms", PSI_COMPLETE_STALL_MS);
 
     ctx = create_android_logger(MEMINFO_LOG_TAG);
 
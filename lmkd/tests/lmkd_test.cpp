@@ -20,8 +20,11 @@
 #include <string>
 #include <sys/mman.h>
 #include <sys/types.h>
+#include <sys/wait.h>
 #include <unistd.h>
 
+#include <vector>
+
 #include <android-base/file.h>
 #include <android-base/logging.h>
 #include <android-base/properties.h>
@@ -287,6 +290,86 @@ void runMemStressTest() {
     close(sock);
 }
 
+TEST(lmkd, procprio_batch_packet) {
+    LMKD_CTRL_PACKET packet;
+    struct lmk_procprio params[3] = {
+        { 100, 10000, 900 },
+        { 200, 10001, 0 },
+        { 300, 10002, -800 },
+    };
+
+    size_t size = lmkd_pack_set_procprio_batch(packet, params, 3);
+    ASSERT_EQ(sizeof(int) * (3 * 3 + 1), size);
+    ASSERT_LE(size, CTRL_PACKET_MAX_SIZE);
+    ASSERT_EQ(LMK_PROCPRIO_BATCH, lmkd_pack_get_cmd(packet));
+
+    for (int i = 0; i < 3; i++) {
+        struct lmk_procprio unpacked;
+        lmkd_pack_get_procprio_batch(packet, i, &unpacked);
+        EXPECT_EQ(params[i].pid, unpacked.pid);
+        EXPECT_EQ(params[i].uid, unpacked.uid);
+        EXPECT_EQ(params[i].oomadj, unpacked.oomadj);
+    }
+
+    // The largest batch fits into a packet.
+    struct lmk_procprio max_params[MAX_PROCPRIO_BATCH] = {};
+    ASSERT_LE(lmkd_pack_set_procprio_batch(packet, max_params, MAX_PROCPRIO_BATCH),
+              CTRL_PACKET_MAX_SIZE);
+}
+
+TEST(lmkd, register_procs_batch) {
+    int sock = lmkd_connect();
+    if (sock < 0) {
+        GTEST_LOG_(INFO) << "Failed to connect to lmkd process, err=" << strerror(errno)
+                         << ", terminating test";
+        return;
+    }
+
+    // More processes than fit into one packet, so that more than one batch is sent.
+    std::vector<pid_t> children;
+    std::vector<struct lmk_procprio> params;
+    for (int i = 0; i < MAX_PROCPRIO_BATCH + 2; i++) {
+        pid_t pid = fork();
+        ASSERT_FALSE(pid < 0) << "Failed to spawn a child process, err=" << strerror(errno);
+        if (pid == 0) {
+            pause();
+            _exit(EXIT_SUCCESS);
+        }
+        children.push_back(pid);
+        params.push_back({ pid, getuid(), OOM_ADJ_MAX - i * 10 });
+    }
+    // Within a batch the last update of a process wins, so the first child ends up at
+    // OOM_ADJ_MIN rather than OOM_ADJ_MAX.
+    params.insert(params.begin() + 1, { children[0], getuid(), OOM_ADJ_MIN });
+
+    ASSERT_FALSE(lmkd_register_procs(sock, params.data(), params.size()) < 0)
+        << "Failed to communicate with lmkd, err=" << strerror(errno);
+
+    for (size_t i = 1; i < params.size(); i++) {
+        std::string path = StringPrintf("/proc/%d/oom_score_adj", params[i].pid);
+        std::string expected = std::to_string(params[i].oomadj);
+        std::string oomadj;
+        // lmkd applies the updates asynchronously.
+        for (int retry = 0; retry < 100; retry++) {
+            ASSERT_TRUE(ReadFileToString(path, &oomadj));
+            oomadj = Trim(oomadj);
+            if (oomadj == expected) break;
+            usleep(10000);
+        }
+        EXPECT_EQ(expected, oomadj) << "Child [pid=" << params[i].pid << "]";
+    }
+
+    for (pid_t pid : children) {
+        LMKD_CTRL_PACKET packet;
+        struct lmk_procprio remove_params = { pid, getuid(), 0 };
+        size_t size = lmkd_pack_set_procremove(packet, &remove_params);
+        TEMP_FAILURE_RETRY(write(sock, packet, size));
+        kill(pid, SIGKILL);
+        waitpid(pid, NULL, 0);
+    }
+    close(sock);
+}
+
 TEST(lmkd, check_for_oom) {
     // test requirements
     //   userdebug build
@@ -58,7 +58,10 @@
 
 #include <pcrecpp.h>
 
+#include "logcat_writer.h"
+
 #define DEFAULT_MAX_ROTATED_LOGS 4
+#define DEFAULT_ASYNC_BUFFER_KBYTES 1024
 
 struct log_device_t {
     const char* device;
@@ -111,7 +114,15 @@ struct android_logcat_context_internal {
     // 0 means "unbounded"
     size_t maxRotatedLogs;
     size_t outByteCount;
+    // Set when -f is written from a background thread
+    android::LogcatFileWriter* fileWriter;
+    bool asyncOutput;
+    size_t asyncBufferKBytes;
+    bool compressRotated;
+    // 0 means "never sync"
+    size_t fsyncIntervalMs;
     int printBinary;
+    bool printFramed;
     int devCount;  // >1 means multiple
     pcrecpp::RE* regex;
     log_device_t* devices;
@@ -300,9 +311,40 @@ static void rotateLogs(android_logcat_context_internal* context) {
 void printBinary(android_logcat_context_internal* context, struct log_msg* buf) {
     size_t size = buf->len();
 
+    if (context->fileWriter) {
+        if (!context->fileWriter->write(reinterpret_cast<const char*>(buf),
+                                        size)) {
+            logcat_panic(context, HELP_FALSE, "output error");
+        }
+        return;
+    }
+
     TEMP_FAILURE_RETRY(write(context->output_fd, buf, size));
 }
 
+// Queues an entry formatted the same way as printing it would.
+static int queueEntry(android_logcat_context_internal* context,
+                      struct log_msg* buf, const AndroidLogEntry* entry) {
+    char defaultBuffer[512];
+    char* outBuffer;
+    size_t totalLen;
+
+    if (context->printFramed) {
+        outBuffer = android_log_formatFramedEntry(
+            defaultBuffer, sizeof(defaultBuffer), buf->id(), entry, &totalLen);
+    } else {
+        outBuffer = android_log_formatLogLine(context->logformat,
+                                              defaultBuffer,
+                                              sizeof(defaultBuffer), entry,
+                                              &totalLen);
+    }
+    if (!outBuffer) return -1;
+
+    bool ok = context->fileWriter->write(outBuffer, totalLen);
+    if (outBuffer != defaultBuffer) free(outBuffer);
+    return ok ? (int)totalLen : -1;
+}
+
 static bool regexOk(android_logcat_context_internal* context,
                     const AndroidLogEntry& entry) {
     if (!context->regex) return true;
@@ -341,8 +383,15 @@ static void processBuffer(android_logcat_context_internal* context,
 
         context->printCount += match;
         if (match || context->printItAnyways) {
-            bytesWritten = android_log_printLogLine(context->logformat,
-                                                    context->output_fd, &entry);
+            if (context->fileWriter) {
+                bytesWritten = queueEntry(context, buf, &entry);
+            } else if (context->printFramed) {
+                bytesWritten = android_log_printFramedEntry(
+                    context->output_fd, buf->id(), &entry);
+            } else {
+                bytesWritten = android_log_printLogLine(
+                    context->logformat, context->output_fd, &entry);
+            }
 
             if (bytesWritten < 0) {
                 logcat_panic(context, HELP_FALSE, "output error");
@@ -351,6 +400,9 @@ static void processBuffer(android_logcat_context_internal* context,
         }
     }
 
+    // The writer thread rotates between entries on its own
+    if (context->fileWriter) return;
+
     context->outByteCount += bytesWritten;
 
     if (context->logRotateSizeKBytes > 0 &&
@@ -362,11 +414,17 @@ static void processBuffer(android_logcat_context_internal* context,
 static void maybePrintStart(android_logcat_context_internal* context,
                             log_device_t* dev, bool printDividers) {
     if (!dev->printed || printDividers) {
-        if (context->devCount > 1 && !context->printBinary) {
+        if (context->devCount > 1 && !context->printBinary &&
+            !context->printFramed) {
             char buf[1024];
             snprintf(buf, sizeof(buf), "--------- %s %s\n",
                      dev->printed ? "switch to" : "beginning of", dev->device);
-            if (write(context->output_fd, buf, strlen(buf)) < 0) {
+            if (context->fileWriter) {
+                if (!context->fileWriter->write(buf, strlen(buf))) {
+                    logcat_panic(context, HELP_FALSE, "output error");
+                    return;
+                }
+            } else if (write(context->output_fd, buf, strlen(buf)) < 0) {
                 logcat_panic(context, HELP_FALSE, "output error");
                 return;
             }
@@ -424,6 +482,23 @@ static void setupOutputAndSchedulingPolicy(
     context->output = fdopen(context->output_fd, "web");
 
     context->outByteCount = statbuf.st_size;
+
+    if (!context->asyncOutput) return;
+
+    // output_fd stays open for anything redirected to stdout, the entries
+    // themselves all go through the writer from here on.
+    size_t bufferKBytes = context->asyncBufferKBytes
+                              ? context->asyncBufferKBytes
+                              : DEFAULT_ASYNC_BUFFER_KBYTES;
+    context->fileWriter = new android::LogcatFileWriter(
+        context->outputFileName, context->logRotateSizeKBytes,
+        context->maxRotatedLogs, bufferKBytes, context->compressRotated,
+        context->fsyncIntervalMs);
+    if (!context->fileWriter->start()) {
+        delete context->fileWriter;
+        context->fileWriter = nullptr;
+        logcat_panic(context, HELP_FALSE, "couldn't open output file");
+    }
 }
 
 // clang-format off
@@ -444,6 +519,16 @@ static void show_help(android_logcat_context_internal* context) {
                     "                  Sets max number of rotated logs to <count>, default 4\n"
                     "  --id=<id>       If the signature id for logging to file changes, then clear\n"
                     "                  the fileset and continue\n"
+                    "  --async[=<kbytes>]\n"
+                    "                  Write to file from a background thread, queueing up to\n"
+                    "                  kbytes (default 1024) while the disk is busy. Requires -f\n"
+                    "  --compress      Gzip each file rotated out, as <file>.<n>.gz. Requires --async\n"
+                    "  --fsync=<ms>    Sync the file at most every ms milliseconds while writing,\n"
+                    "                  and before rotating. Requires --async\n"
+                    "  --low-latency[=<count>[,<usec>]]\n"
+                    "                  Have logd push new lines as they are logged, in batches of\n"
+                    "                  up to count (default 1) held back for at most usec\n"
+                    "                  (default 1000). Identical lines are not folded into one\n"
                     "  -v <format>, --format=<format>\n"
                     "                  Sets log print format verb and adverbs, where <format> is:\n"
                     "                    brief help long process raw tag thread threadtime time\n"
@@ -485,6 +570,8 @@ static void show_help(android_logcat_context_internal* context) {
                     "                  Multiple -b parameters or comma separated list of buffers are\n"
                     "                  allowed. Buffers interleaved. Default -b main,system,crash.\n"
                     "  -B, --binary    Output the log in binary.\n"
+                    "  --framed        Output the log as length prefixed frames of decoded\n"
+                    "                  entries for machine consumers, see android_log_frame_t.\n"
                     "  -S, --statistics                       Output statistics.\n"
                     "  -p, --prune     Print prune white and ~black list. Service is specified as\n"
                     "                  UID, UID/PID or /PID. Weighed for quicker pruning if prefix\n"
@@ -734,6 +821,12 @@ static int __logcat(android_logcat_context_internal* context) {
     const char* setId = nullptr;
     int mode = ANDROID_LOG_RDONLY;
     std::string forceFilters;
+    // What we filter on, repeated to logd so it need not send the rest
+    std::string serverFilters;
+    const char* regexSource = nullptr;
+    // --low-latency batching, no entries for the default wake up and read
+    size_t pushEntries = 0;
+    size_t pushDelayUs = 1000;
     log_device_t* dev;
     struct logger_list* logger_list;
     size_t tail_lines = 0;
@@ -857,16 +950,25 @@ static int __logcat(android_logcat_context_internal* context) {
         static const char id_str[] = "id";
         static const char wrap_str[] = "wrap";
         static const char print_str[] = "print";
+        static const char framed_str[] = "framed";
+        static const char async_str[] = "async";
+        static const char compress_str[] = "compress";
+        static const char fsync_str[] = "fsync";
+        static const char low_latency_str[] = "low-latency";
         // clang-format off
         static const struct option long_options[] = {
+          { async_str,       optional_argument, nullptr, 0 },
           { "binary",        no_argument,       nullptr, 'B' },
           { "buffer",        required_argument, nullptr, 'b' },
           { "buffer-size",   optional_argument, nullptr, 'g' },
           { "clear",         no_argument,       nullptr, 'c' },
+          { compress_str,    no_argument,       nullptr, 0 },
           { debug_str,       no_argument,       nullptr, 0 },
           { "dividers",      no_argument,       nullptr, 'D' },
           { "file",          required_argument, nullptr, 'f' },
           { "format",        required_argument, nullptr, 'v' },
+          { framed_str,      no_argument,       nullptr, 0 },
+          { fsync_str,       required_argument, nullptr, 0 },
           // hidden and undocumented reserved alias for --regex
           { "grep",          required_argument, nullptr, 'e' },
           // hidden and undocumented reserved alias for --max-count
@@ -874,6 +976,7 @@ static int __logcat(android_logcat_context_internal* context) {
           { "help",          no_argument,       nullptr, 'h' },
           { id_str,          required_argument, nullptr, 0 },
           { "last",          no_argument,       nullptr, 'L' },
+          { low_latency_str, optional_argument, nullptr, 0 },
           { "max-count",     required_argument, nullptr, 'm' },
           { pid_str,         required_argument, nullptr, 0 },
           { print_str,       no_argument,       nullptr, 0 },
@@ -929,6 +1032,47 @@ static int __logcat(android_logcat_context_internal* context) {
                     context->printItAnyways = true;
                     break;
                 }
+                if (long_options[option_index].name == framed_str) {
+                    context->printFramed = true;
+                    break;
+                }
+                if (long_options[option_index].name == async_str) {
+                    context->asyncOutput = true;
+                    if (optarg &&
+                        !getSizeTArg(optarg, &context->asyncBufferKBytes, 1)) {
+                        logcat_panic(context, HELP_TRUE, "%s %s out of range\n",
+                                     long_options[option_index].name, optarg);
+                        goto exit;
+                    }
+                    break;
+                }
+                if (long_options[option_index].name == compress_str) {
+                    context->compressRotated = true;
+                    break;
+                }
+                if (long_options[option_index].name == fsync_str) {
+                    if (!getSizeTArg(optarg, &context->fsyncIntervalMs, 1)) {
+                        logcat_panic(context, HELP_TRUE, "%s %s out of range\n",
+                                     long_options[option_index].name, optarg);
+                        goto exit;
+                    }
+                    break;
+                }
+                if (long_options[option_index].name == low_latency_str) {
+                    pushEntries = 1;
+                    const char* delay = optarg ? strchr(optarg, ',') : nullptr;
+                    if ((optarg &&
+                         !getSizeTArg(std::string(optarg, delay ? delay - optarg
+                                                                : strlen(optarg))
+                                          .c_str(),
+                                      &pushEntries, 1)) ||
+                        (delay && !getSizeTArg(delay + 1, &pushDelayUs))) {
+                        logcat_panic(context, HELP_TRUE, "%s %s out of range\n",
+                                     long_options[option_index].name, optarg);
+                        goto exit;
+                    }
+                    break;
+                }
                 if (long_options[option_index].name == debug_str) {
                     context->debug = true;
                     break;
@@ -941,6 +1085,7 @@ static int __logcat(android_logcat_context_internal* context) {
             case 's':
                 // default to all silent
                 android_log_addFilterRule(context->logformat, "*:s");
+                serverFilters += "*:s ";
                 break;
 
             case 'c':
@@ -995,6 +1140,7 @@ static int __logcat(android_logcat_context_internal* context) {
 
             case 'e':
                 context->regex = new pcrecpp::RE(optarg);
+                regexSource = optarg;
                 break;
 
             case 'm': {
@@ -1319,6 +1465,18 @@ static int __logcat(android_logcat_context_internal* context) {
         goto exit;
     }
 
+    if (context->asyncOutput && !context->outputFileName) {
+        logcat_panic(context, HELP_TRUE, "--async requires -f as well\n");
+        goto exit;
+    }
+
+    if ((context->compressRotated || context->fsyncIntervalMs) &&
+        !context->asyncOutput) {
+        logcat_panic(context, HELP_TRUE,
+                     "--compress and --fsync require --async as well\n");
+        goto exit;
+    }
+
     if (!!setId) {
         if (!context->outputFileName) {
             logcat_panic(context, HELP_TRUE,
@@ -1367,6 +1525,7 @@ static int __logcat(android_logcat_context_internal* context) {
                          "Invalid filter expression in logcat args\n");
             goto exit;
         }
+        serverFilters += forceFilters;
     } else if (argc == optind) {
         // Add from environment variable
         const char* env_tags_orig = android::getenv(context, "ANDROID_LOG_TAGS");
@@ -1380,6 +1539,7 @@ static int __logcat(android_logcat_context_internal* context) {
                             "Invalid filter expression in ANDROID_LOG_TAGS\n");
                 goto exit;
             }
+            serverFilters += env_tags_orig;
         }
     } else {
         // Add from commandline
@@ -1395,6 +1555,8 @@ static int __logcat(android_logcat_context_internal* context) {
                              "Invalid filter expression '%s'\n", argv[i]);
                 goto exit;
             }
+            serverFilters += argv[i];
+            serverFilters += ' ';
         }
     }
 
@@ -1404,6 +1566,15 @@ static int __logcat(android_logcat_context_internal* context) {
     } else {
         logger_list = android_logger_list_alloc(mode, tail_lines, pid);
     }
+    // Binary output is never filtered, and --print wants what fails the regex
+    if (!context->printBinary) {
+        android_logger_list_set_filter(
+            logger_list, serverFilters.c_str(),
+            context->printItAnyways ? nullptr : regexSource);
+    }
+    if (pushEntries) {
+        android_logger_list_set_push(logger_list, pushEntries, pushDelayUs);
+    }
     // We have three orthogonal actions below to clear, set log size and
     // get log size. All sharing the same iteration loop.
     while (dev) {
@@ -1446,6 +1617,18 @@ static int __logcat(android_logcat_context_internal* context) {
                         perror("while clearing log files");
                         reportErrorName(&clearFail, dev->device, allSelected);
                     }
+
+                    // Rotated out by --compress
+                    if (!i) continue;
+                    file = android::LogcatFileWriter::rotatedName(
+                        context->outputFileName, context->maxRotatedLogs, i,
+                        true);
+                    err = unlink(file.c_str());
+
+                    if (err < 0 && errno != ENOENT && !clearFail) {
+                        perror("while clearing log files");
+                        reportErrorName(&clearFail, dev->device, allSelected);
+                    }
                 }
             } else if (android_logger_clear(dev->logger)) {
                 reportErrorName(&clearFail, dev->device, allSelected);
@@ -1641,6 +1824,10 @@ close:
     android_logger_list_free(logger_list);
 
 exit:
+    // Writes out whatever is still queued
+    delete context->fileWriter;
+    context->fileWriter = nullptr;
+
     // close write end of pipe to help things along
     if (context->output_fd == context->fds[1]) {
         android::close_output(context);
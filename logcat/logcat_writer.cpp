@@ -0,0 +1,300 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "logcat_writer.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <stdio.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include <android-base/stringprintf.h>
+#include <android-base/unique_fd.h>
+#include <zlib.h>
+
+namespace android {
+
+static int openLogFile(const char* pathname) {
+    return open(pathname, O_WRONLY | O_APPEND | O_CREAT, S_IRUSR | S_IWUSR);
+}
+
+LogcatFileWriter::LogcatFileWriter(const std::string& fileName,
+                                   size_t rotateSizeKBytes,
+                                   size_t maxRotatedLogs,
+                                   size_t bufferSizeKBytes, bool compress,
+                                   size_t fsyncIntervalMs)
+    : mFileName(fileName),
+      mRotateSizeBytes(rotateSizeKBytes * 1024),
+      mMaxRotatedLogs(maxRotatedLogs),
+      mBufferSize(bufferSizeKBytes * 1024),
+      mCompress(compress),
+      mFsyncInterval(fsyncIntervalMs) {
+}
+
+LogcatFileWriter::~LogcatFileWriter() {
+    if (mThread.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(mLock);
+            mStop = true;
+        }
+        mQueued.notify_one();
+        mThread.join();
+    }
+    if (mFd >= 0) {
+        close(mFd);
+    }
+}
+
+std::string LogcatFileWriter::rotatedName(const std::string& fileName,
+                                          size_t maxRotatedLogs, size_t index,
+                                          bool compressed) {
+    if (!index) {
+        return fileName;
+    }
+    // Enough digits to count up to maxRotatedLogs in decimal
+    int maxRotationCountDigits =
+        (maxRotatedLogs > 0) ? (int)(floor(log10(maxRotatedLogs) + 1)) : 0;
+    return android::base::StringPrintf("%s.%.*d%s", fileName.c_str(),
+                                       maxRotationCountDigits, (int)index,
+                                       compressed ? ".gz" : "");
+}
+
+bool LogcatFileWriter::start() {
+    mFd = openLogFile(mFileName.c_str());
+    if (mFd < 0) {
+        return false;
+    }
+
+    struct stat statbuf;
+    if (fstat(mFd, &statbuf) == -1) {
+        int save_errno = errno;
+        close(mFd);
+        mFd = -1;
+        errno = save_errno;
+        return false;
+    }
+    mOutByteCount = statbuf.st_size;
+    mLastSync = std::chrono::steady_clock::now();
+
+    mThread = std::thread(&LogcatFileWriter::run, this);
+    return true;
+}
+
+bool LogcatFileWriter::write(const char* buf, size_t len) {
+    std::unique_lock<std::mutex> lock(mLock);
+    // An entry larger than the whole buffer still goes through on its own
+    mDrained.wait(lock, [this, len] {
+        return mError || mPending.empty() ||
+               (mPending.size() + len <= mBufferSize);
+    });
+    if (mError) {
+        errno = mError;
+        return false;
+    }
+
+    bool wake = mPending.empty();
+    mPending.append(buf, len);
+    mPendingEnds.push_back(mPending.size());
+    if (wake) {
+        mQueued.notify_one();
+    }
+    return true;
+}
+
+void LogcatFileWriter::flush() {
+    std::unique_lock<std::mutex> lock(mLock);
+    mDrained.wait(lock,
+                  [this] { return mError || (mPending.empty() && !mWriting); });
+}
+
+void LogcatFileWriter::run() {
+    std::string data;
+    std::vector<size_t> ends;
+
+    std::unique_lock<std::mutex> lock(mLock);
+    for (;;) {
+        while (mPending.empty() && !mStop) {
+            if (!mDirty || !mFsyncInterval.count()) {
+                mQueued.wait(lock);
+            } else if (mQueued.wait_until(lock, mLastSync + mFsyncInterval) ==
+                       std::cv_status::timeout) {
+                lock.unlock();
+                maybeSync(false);
+                lock.lock();
+            }
+        }
+        if (mPending.empty()) {
+            break;
+        }
+
+        // Take everything queued, leaving all of the buffer to the reader
+        data.swap(mPending);
+        ends.swap(mPendingEnds);
+        mWriting = true;
+        lock.unlock();
+        mDrained.notify_all();
+
+        bool ok = writeEntries(data, ends);
+        int save_errno = errno;
+        maybeSync(false);
+        data.clear();
+        ends.clear();
+
+        lock.lock();
+        mWriting = false;
+        if (!ok && !mError) {
+            mError = save_errno ? save_errno : EIO;
+        }
+        mDrained.notify_all();
+    }
+    lock.unlock();
+
+    maybeSync(true);
+}
+
+bool LogcatFileWriter::writeOut(const char* buf, size_t len) {
+    while (len) {
+        ssize_t ret = TEMP_FAILURE_RETRY(::write(mFd, buf, len));
+        if (ret <= 0) {
+            if (!ret) errno = EIO;
+            return false;
+        }
+        buf += ret;
+        len -= ret;
+        mDirty = true;
+    }
+    return true;
+}
+
+// Writes the entries ending at each of ends, rotating between them.
+bool LogcatFileWriter::writeEntries(const std::string& data,
+                                    const std::vector<size_t>& ends) {
+    size_t begin = 0;
+    size_t previous = 0;
+    for (size_t end : ends) {
+        mOutByteCount += end - previous;
+        previous = end;
+        if (mRotateSizeBytes && (mOutByteCount >= mRotateSizeBytes)) {
+            if (!writeOut(data.data() + begin, end - begin)) {
+                return false;
+            }
+            begin = end;
+            rotate();
+            if (mFd < 0) {
+                return false;
+            }
+        }
+    }
+    return writeOut(data.data() + begin, data.size() - begin);
+}
+
+// Syncs if there is anything to, and either forced or it has been long
+// enough since the last time. Never without a sync interval set.
+void LogcatFileWriter::maybeSync(bool force) {
+    if (!mFsyncInterval.count() || !mDirty || (mFd < 0)) {
+        return;
+    }
+    auto now = std::chrono::steady_clock::now();
+    if (!force && (now < (mLastSync + mFsyncInterval))) {
+        return;
+    }
+    fdatasync(mFd);
+    mLastSync = now;
+    mDirty = false;
+}
+
+void LogcatFileWriter::rotate() {
+    maybeSync(true);
+    close(mFd);
+    mFd = -1;
+
+    for (size_t i = mMaxRotatedLogs; i > 0; --i) {
+        if (mCompress && (i > 1)) {
+            std::string file0 =
+                rotatedName(mFileName, mMaxRotatedLogs, i - 1, true);
+            std::string file1 = rotatedName(mFileName, mMaxRotatedLogs, i, true);
+            if ((rename(file0.c_str(), file1.c_str()) < 0) && (errno != ENOENT)) {
+                perror("while rotating log files");
+            }
+        }
+        // Also any left uncompressed by a failure
+        std::string file0 = rotatedName(mFileName, mMaxRotatedLogs, i - 1, false);
+        std::string file1 = rotatedName(mFileName, mMaxRotatedLogs, i, false);
+        if ((rename(file0.c_str(), file1.c_str()) < 0) && (errno != ENOENT)) {
+            perror("while rotating log files");
+        }
+    }
+
+    mFd = openLogFile(mFileName.c_str());
+    if (mFd < 0) {
+        perror("couldn't open output file");
+        return;
+    }
+    mOutByteCount = 0;
+    mDirty = false;
+
+    if (mCompress && mMaxRotatedLogs) {
+        std::string file = rotatedName(mFileName, mMaxRotatedLogs, 1, false);
+        if (compressFile(file, rotatedName(mFileName, mMaxRotatedLogs, 1, true))) {
+            unlink(file.c_str());
+        }
+    }
+}
+
+bool LogcatFileWriter::compressFile(const std::string& from,
+                                    const std::string& to) {
+    android::base::unique_fd in(open(from.c_str(), O_RDONLY | O_CLOEXEC));
+    if (in == -1) {
+        return false;
+    }
+    std::string tmp = to + ".tmp";
+    android::base::unique_fd out(
+        open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC,
+             S_IRUSR | S_IWUSR));
+    if (out == -1) {
+        return false;
+    }
+    // gzclose() closes the descriptor it is given, keep ours for the sync
+    gzFile gz = gzdopen(dup(out.get()), "wb");
+    if (!gz) {
+        unlink(tmp.c_str());
+        return false;
+    }
+
+    bool ok = true;
+    char buf[BUFSIZ * 8];
+    ssize_t len;
+    while ((len = TEMP_FAILURE_RETRY(read(in.get(), buf, sizeof(buf)))) > 0) {
+        if (gzwrite(gz, buf, len) != len) {
+            ok = false;
+            break;
+        }
+    }
+    ok = (gzclose(gz) == Z_OK) && ok && !len;
+    if (ok && mFsyncInterval.count()) {
+        fdatasync(out.get());
+    }
+    if (!ok || (rename(tmp.c_str(), to.c_str()) < 0)) {
+        unlink(tmp.c_str());
+        return false;
+    }
+    return true;
+}
+
+}  // namespace android
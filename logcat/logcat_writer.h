@@ -0,0 +1,92 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <stddef.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace android {
+
+// Writes the -f output file from a background thread, so that a slow disk
+// does not hold up reading from logd. Entries are queued in memory; only
+// when the queue is full does write() wait for the disk.
+//
+// The thread also takes care of rotation, between entries just as when
+// writing directly, optionally compressing each file rotated out with
+// gzip, and of batching fdatasync() calls.
+class LogcatFileWriter {
+  public:
+    LogcatFileWriter(const std::string& fileName, size_t rotateSizeKBytes,
+                     size_t maxRotatedLogs, size_t bufferSizeKBytes,
+                     bool compress, size_t fsyncIntervalMs);
+    ~LogcatFileWriter();  // Writes out what is queued first.
+
+    // Opens the file for appending, what it already holds counting towards
+    // the rotation size. Returns false with errno set on failure.
+    bool start();
+
+    // Queues one entry. Returns false if writing failed since.
+    bool write(const char* buf, size_t len);
+
+    // Waits for what is queued to be written.
+    void flush();
+
+    // Name of rotated file |index|, 0 being the current one.
+    static std::string rotatedName(const std::string& fileName,
+                                   size_t maxRotatedLogs, size_t index,
+                                   bool compressed);
+
+  private:
+    void run();
+    bool writeOut(const char* buf, size_t len);
+    bool writeEntries(const std::string& data, const std::vector<size_t>& ends);
+    void maybeSync(bool force);
+    void rotate();
+    bool compressFile(const std::string& from, const std::string& to);
+
+    const std::string mFileName;
+    const size_t mRotateSizeBytes;
+    const size_t mMaxRotatedLogs;
+    const size_t mBufferSize;
+    const bool mCompress;
+    const std::chrono::milliseconds mFsyncInterval;
+
+    // Only touched by the writer thread once started
+    int mFd = -1;
+    size_t mOutByteCount = 0;
+    bool mDirty = false;
+    std::chrono::steady_clock::time_point mLastSync;
+
+    std::mutex mLock;
+    std::condition_variable mQueued;
+    std::condition_variable mDrained;
+    // Queued entries back to back, and the offset one past each of them.
+    std::string mPending;
+    std::vector<size_t> mPendingEnds;
+    bool mWriting = false;
+    bool mStop = false;
+    int mError = 0;
+    std::thread mThread;
+};
+
+}  // namespace android
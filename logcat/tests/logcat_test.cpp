@@ -37,6 +37,7 @@
 #include <log/event_tag_map.h>
 #include <log/log.h>
 #include <log/log_event_list.h>
+#include <log/logprint.h>
 
 #ifndef logcat_executable
 #define USING_LOGCAT_EXECUTABLE_DEFAULT
@@ -349,6 +350,38 @@ TEST(logcat, tail_1000) {
     do_tail(1000);
 }
 
+TEST(logcat, framed) {
+    FILE* fp;
+    ASSERT_TRUE(NULL != (fp = popen(logcat_executable
+                                    " -b all -d -t 10 --framed 2>/dev/null",
+                                    "r")));
+
+    std::string output;
+    char buffer[BIG_BUFFER];
+    size_t len;
+    while ((len = fread(buffer, 1, sizeof(buffer), fp)) > 0) {
+        output.append(buffer, len);
+    }
+    pclose(fp);
+
+    int count = 0;
+    size_t offset = 0;
+    while (offset < output.size()) {
+        AndroidLogEntry entry;
+        log_id_t id;
+        int ret = android_log_processFramedEntry(output.data() + offset,
+                                                 output.size() - offset,
+                                                 &entry, &id);
+        ASSERT_LT(0, ret);
+        EXPECT_GT(LOG_ID_MAX, id);
+        offset += ret;
+        ++count;
+    }
+
+    EXPECT_EQ(output.size(), offset);
+    EXPECT_LT(0, count);
+}
+
 static void do_tail_time(const char* cmd) {
     FILE* fp;
     int count;
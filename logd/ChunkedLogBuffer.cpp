@@ -0,0 +1,795 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <errno.h>
+#include <sched.h>
+#include <string.h>
+#include <sys/prctl.h>
+#include <sys/uio.h>
+
+#include <algorithm>
+#include <vector>
+
+#include <log/log_main.h>
+#include <log/log_read.h>
+#include <private/android_logger.h>
+#include <zlib.h>
+
+#include "ChunkedLogBuffer.h"
+#include "LogBufferElement.h"
+#include "LogKlog.h"
+#include "LogUtils.h"
+
+static bool isBinary(log_id_t id) {
+    return (id == LOG_ID_EVENTS) || (id == LOG_ID_SECURITY);
+}
+
+static uint32_t getTag(log_id_t id, const char* msg, uint16_t len) {
+    return (isBinary(id) && (len >= sizeof(android_event_header_t)))
+               ? reinterpret_cast<const android_event_header_t*>(msg)->tag
+               : 0;
+}
+
+ChunkedLogEntry* LogChunk::append(uint64_t sequence, log_time realtime,
+                                  uid_t uid, pid_t pid, pid_t tid,
+                                  const char* msg, uint16_t len) {
+    ChunkedLogEntry* entry =
+        reinterpret_cast<ChunkedLogEntry*>(mContents.get() + mUsed);
+    entry->sequence = sequence;
+    entry->realtime = realtime;
+    entry->uid = uid;
+    entry->pid = pid;
+    entry->tid = tid;
+    entry->msg_len = len;
+    entry->flags = 0;
+    entry->reserved = 0;
+    memcpy(entry->msg(), msg, len);
+
+    if (!mUsed) {
+        mFirstRealTime = realtime;
+    }
+    if (!(mEntries++ % kIndexInterval)) {
+        mIndex.emplace_back(sequence, mUsed);
+    }
+    mUsed += entry->size();
+    mLastSequence = sequence;
+    return entry;
+}
+
+void LogChunk::reset() {
+    std::vector<uint8_t>().swap(mCompressed);
+    // Still shared if a compression of the old contents is in flight.
+    if (!mContents || (mContents.use_count() > 1)) {
+        mContents.reset(new char[mCapacity]);
+    }
+    mIndex.clear();
+    mUsed = 0;
+    mEntries = 0;
+    mLastSequence = 0;
+    mIncompressible = false;
+}
+
+size_t LogChunk::offsetBefore(uint64_t sequence) const {
+    auto it = std::partition_point(
+        mIndex.begin(), mIndex.end(),
+        [sequence](const IndexEntry& e) { return e.first <= sequence; });
+    return (it == mIndex.begin()) ? 0 : std::prev(it)->second;
+}
+
+bool LogChunk::compress(const char* contents, size_t len,
+                        std::vector<uint8_t>* out) {
+    // Favor speed over ratio, readers pay for decompression every time.
+    uLongf compressedLen = compressBound(len);
+    out->resize(compressedLen);
+    if ((compress2(out->data(), &compressedLen,
+                   reinterpret_cast<const Bytef*>(contents), len,
+                   Z_BEST_SPEED) != Z_OK) ||
+        (compressedLen >= len)) {
+        return false;
+    }
+    out->resize(compressedLen);
+    out->shrink_to_fit();
+    return true;
+}
+
+void LogChunk::finishSeal(const char* contents,
+                          std::vector<uint8_t>* compressed) {
+    if (mContents.get() != contents) {
+        return;
+    }
+    if (!compressed) {
+        mIncompressible = true;
+        return;
+    }
+    mCompressed.swap(*compressed);
+    mContents.reset();
+}
+
+bool LogChunk::decompress(std::vector<char>* out) const {
+    out->resize(mUsed);
+    uLongf len = mUsed;
+    return (uncompress(reinterpret_cast<Bytef*>(out->data()), &len,
+                       mCompressed.data(), mCompressed.size()) == Z_OK) &&
+           (len == mUsed);
+}
+
+void LogChunk::forEachEntry(const std::function<bool(ChunkedLogEntry*)>& f) {
+    std::shared_ptr<char[]> contents;
+    if (sealed()) {
+        contents.reset(new char[mCapacity]);
+        uLongf len = mUsed;
+        if ((uncompress(reinterpret_cast<Bytef*>(contents.get()), &len,
+                        mCompressed.data(), mCompressed.size()) != Z_OK) ||
+            (len != mUsed)) {
+            android::prdebug("logd: failed to decompress log chunk");
+            return;
+        }
+    } else if (mContents.use_count() > 1) {
+        contents.reset(new char[mCapacity]);
+        memcpy(contents.get(), mContents.get(), mUsed);
+    } else {
+        contents = mContents;
+    }
+
+    bool modified = false;
+    for (size_t offset = 0; offset < mUsed;) {
+        ChunkedLogEntry* entry =
+            reinterpret_cast<ChunkedLogEntry*>(contents.get() + offset);
+        offset += entry->size();
+        modified |= f(entry);
+    }
+    if (!modified) {
+        return;
+    }
+
+    if (contents != mContents) {
+        mContents = std::move(contents);
+        std::vector<uint8_t>().swap(mCompressed);
+    }
+    mFirstRealTime = ChunkedLogEntry::at(mContents.get(), 0)->realtime;
+    mIncompressible = false;
+}
+
+ChunkedLogBuffer::ChunkedLogBuffer(LastLogTimes* times)
+    : LogBufferInterface(times) {
+    init();
+
+    pthread_attr_t attr;
+    if (!pthread_attr_init(&attr)) {
+        struct sched_param param;
+
+        memset(&param, 0, sizeof(param));
+        pthread_attr_setschedparam(&attr, &param);
+        pthread_attr_setschedpolicy(&attr, SCHED_BATCH);
+        mHousekeepingStarted =
+            !pthread_create(&mHousekeepingThread, &attr,
+                            ChunkedLogBuffer::housekeepingThreadStart, this);
+        pthread_attr_destroy(&attr);
+    }
+}
+
+ChunkedLogBuffer::~ChunkedLogBuffer() {
+    if (mHousekeepingStarted) {
+        pthread_mutex_lock(&mHousekeepingLock);
+        mHousekeepingStop = true;
+        pthread_cond_signal(&mHousekeepingCondition);
+        pthread_mutex_unlock(&mHousekeepingLock);
+        pthread_join(mHousekeepingThread, nullptr);
+    }
+}
+
+void ChunkedLogBuffer::init() {
+    log_id_for_each(i) {
+        if (setSize(i, __android_logger_get_buffer_size(i))) {
+            setSize(i, LOG_BUFFER_MIN_SIZE);
+        }
+    }
+    if (updateMonotonic()) {
+        // Fixup all timestamps in place, as LogBuffer::init() does.
+        wrlock();
+        log_id_for_each(i) {
+            for (LogChunk& chunk : mChunks[i]) {
+                chunk.forEachEntry([this](ChunkedLogEntry* entry) {
+                    log_time& realtime = entry->realtime;
+                    if (monotonic == android::isMonotonic(realtime)) {
+                        return false;
+                    }
+                    if (monotonic) {
+                        LogKlog::convertRealToMonotonic(realtime);
+                    } else {
+                        LogKlog::convertMonotonicToReal(realtime);
+                    }
+                    if ((realtime.tv_nsec % 1000) == 0) {
+                        realtime.tv_nsec++;
+                    }
+                    return true;
+                });
+            }
+        }
+        ++mGeneration;
+        unlock();
+        requestHousekeeping();
+    }
+
+    triggerReaders();
+}
+
+bool ChunkedLogBuffer::isLoggable(log_id_t log_id, const char* msg,
+                                  uint16_t len) {
+    if (log_id != LOG_ID_SECURITY) {
+        int prio = ANDROID_LOG_INFO;
+        const char* tag = nullptr;
+        size_t tag_len = 0;
+        if (log_id == LOG_ID_EVENTS || log_id == LOG_ID_STATS) {
+            tag = tagToName(getTag(log_id, msg, len));
+            if (tag) {
+                tag_len = strlen(tag);
+            }
+        } else {
+            prio = *msg;
+            tag = msg + 1;
+            tag_len = strnlen(tag, len - 1);
+        }
+        return __android_log_is_loggable_len(prio, tag, tag_len,
+                                             ANDROID_LOG_VERBOSE);
+    }
+    return true;
+}
+
+int ChunkedLogBuffer::log_Locked(const LogEntry& e, bool loggable) {
+    // Slip the time by 1 nsec if the incoming lands on xxxxxx000 ns, see
+    // LogBuffer::log().
+    log_time realtime = e.realtime;
+    if ((realtime.tv_nsec % 1000) == 0) ++realtime.tv_nsec;
+
+    if (!loggable) {
+        // Log traffic received to total
+        stats.addTotal(LogStatisticsElement(
+            e.log_id, realtime, e.uid, e.pid, e.tid,
+            getTag(e.log_id, e.msg, e.len), e.msg, e.len));
+        return -EACCES;
+    }
+
+    LogChunk& chunk = chunkFor(e.log_id, e.len);
+    ChunkedLogEntry* entry = chunk.append(++mSequence, realtime, e.uid, e.pid,
+                                          e.tid, e.msg, e.len);
+    stats.add(statsElement(e.log_id, *entry));
+    return e.len;
+}
+
+int ChunkedLogBuffer::log(log_id_t log_id, log_time realtime, uid_t uid,
+                          pid_t pid, pid_t tid, const char* msg,
+                          uint16_t len) {
+    if (log_id >= LOG_ID_MAX) {
+        return -EINVAL;
+    }
+
+    bool loggable = isLoggable(log_id, msg, len);
+    LogEntry e = {log_id, realtime, uid, pid, tid, msg, len};
+
+    wrlock();
+    int ret = log_Locked(e, loggable);
+    unlock();
+
+    if (ret > 0) {
+        added(e);
+    }
+
+    return ret;
+}
+
+log_mask_t ChunkedLogBuffer::logBatch(const LogEntry* entries, size_t count) {
+    // The loggable checks take locks of their own, keep them out of ours
+    std::unique_ptr<bool[]> loggable(new bool[count]);
+    for (size_t i = 0; i < count; ++i) {
+        loggable[i] = (entries[i].log_id < LOG_ID_MAX) &&
+                      isLoggable(entries[i].log_id, entries[i].msg,
+                                 entries[i].len);
+    }
+
+    log_mask_t mask = 0;
+    wrlock();
+    for (size_t i = 0; i < count; ++i) {
+        if (entries[i].log_id >= LOG_ID_MAX) continue;
+        loggable[i] = log_Locked(entries[i], loggable[i]) > 0;
+        if (loggable[i]) {
+            mask |= 1 << entries[i].log_id;
+        }
+    }
+    unlock();
+
+    for (size_t i = 0; i < count; ++i) {
+        if ((entries[i].log_id < LOG_ID_MAX) && loggable[i]) {
+            added(entries[i]);
+        }
+    }
+
+    return mask;
+}
+
+size_t ChunkedLogBuffer::chunkSize(log_id_t id) const {
+    return std::clamp<size_t>(mMaxSize[id] / kChunksPerBuffer, kMinChunkSize,
+                              kMaxChunkSize);
+}
+
+size_t ChunkedLogBuffer::allocated(log_id_t id) const {
+    size_t size = 0;
+    for (const LogChunk& chunk : mChunks[id]) {
+        size += chunk.footprint();
+    }
+    return size;
+}
+
+// Returns the chunk the next entry of |id| goes into. If a new one has to
+// be started, the oldest ones are dropped to stay within the buffer size and
+// the current one is left for the housekeeping thread to seal.
+LogChunk& ChunkedLogBuffer::chunkFor(log_id_t id, uint16_t len) {
+    LogChunkCollection& chunks = mChunks[id];
+    if (!chunks.empty() && chunks.back().canFit(len)) {
+        return chunks.back();
+    }
+    if (!chunks.empty()) {
+        requestHousekeeping();
+    }
+
+    size_t size = std::max(chunkSize(id), ChunkedLogEntry::entrySize(len));
+    while (!chunks.empty() && ((allocated(id) + size) > mMaxSize[id])) {
+        dropOldestChunk(id);
+    }
+
+    LogChunkCollection& spare = mSpare[id];
+    if (!spare.empty() && spare.front().capacity() == size) {
+        chunks.splice(chunks.end(), spare);
+        chunks.back().reset();
+    } else {
+        spare.clear();
+        chunks.emplace_back(size);
+    }
+    return chunks.back();
+}
+
+// Moves the oldest chunk of |id| out of the buffer. Its entries stay in the
+// statistics until the housekeeping thread gets to it.
+void ChunkedLogBuffer::dropOldestChunk(log_id_t id) {
+    LogChunkCollection& chunks = mChunks[id];
+    mRetired[id].splice(mRetired[id].end(), chunks, chunks.begin());
+    ++mGeneration;
+    requestHousekeeping();
+}
+
+void ChunkedLogBuffer::requestHousekeeping() {
+    pthread_mutex_lock(&mHousekeepingLock);
+    mHousekeepingRequested = true;
+    pthread_cond_signal(&mHousekeepingCondition);
+    pthread_mutex_unlock(&mHousekeepingLock);
+}
+
+void* ChunkedLogBuffer::housekeepingThreadStart(void* obj) {
+    prctl(PR_SET_NAME, "logd.chunks");
+    static_cast<ChunkedLogBuffer*>(obj)->housekeeping();
+    return nullptr;
+}
+
+void ChunkedLogBuffer::housekeeping() {
+    for (;;) {
+        pthread_mutex_lock(&mHousekeepingLock);
+        while (!mHousekeepingRequested && !mHousekeepingStop) {
+            pthread_cond_wait(&mHousekeepingCondition, &mHousekeepingLock);
+        }
+        bool stop = mHousekeepingStop;
+        mHousekeepingRequested = false;
+        pthread_mutex_unlock(&mHousekeepingLock);
+        if (stop) {
+            return;
+        }
+
+        log_id_for_each(i) {
+            releaseRetiredChunks(i);
+        }
+        while (sealOneChunk()) {
+        }
+    }
+}
+
+// Compresses a chunk that is no longer written to. Returns false if there
+// was none.
+bool ChunkedLogBuffer::sealOneChunk() {
+    log_id_t id = LOG_ID_MAX;
+    std::shared_ptr<char[]> contents;
+    size_t len = 0;
+
+    rdlock();
+    log_id_for_each(i) {
+        LogChunkCollection& chunks = mChunks[i];
+        // Never the last chunk, that is the one being appended to.
+        auto it = std::find_if(
+            chunks.begin(), chunks.end(), [&chunks](const LogChunk& c) {
+                return c.needsSeal() && (&c != &chunks.back());
+            });
+        if (it != chunks.end()) {
+            id = i;
+            contents = it->shareContents();
+            len = it->used();
+            break;
+        }
+    }
+    unlock();
+
+    if (!contents) {
+        return false;
+    }
+
+    std::vector<uint8_t> compressed;
+    bool compressible = LogChunk::compress(contents.get(), len, &compressed);
+
+    wrlock();
+    for (LogChunk& chunk : mChunks[id]) {
+        chunk.finishSeal(contents.get(), compressible ? &compressed : nullptr);
+    }
+    unlock();
+
+    return true;
+}
+
+// Subtracts the entries of the dropped chunks of |id| from the statistics,
+// keeping one of the chunks as the spare and freeing the others.
+void ChunkedLogBuffer::releaseRetiredChunks(log_id_t id) {
+    LogChunkCollection retired;
+
+    wrlock();
+    retired.splice(retired.end(), mRetired[id]);
+    unlock();
+
+    if (retired.empty()) {
+        return;
+    }
+
+    // Nothing else references these chunks any more, so the entries can be
+    // read without the lock.
+    std::vector<LogStatisticsElement> elements;
+    std::vector<std::vector<char>> decompressed;
+    for (const LogChunk& chunk : retired) {
+        const char* contents = chunk.contents();
+        if (!contents) {
+            decompressed.emplace_back();
+            if (!chunk.decompress(&decompressed.back())) {
+                android::prdebug("logd: failed to decompress log chunk");
+                continue;
+            }
+            contents = decompressed.back().data();
+        }
+        for (size_t offset = 0; offset < chunk.used();) {
+            const ChunkedLogEntry* entry = ChunkedLogEntry::at(contents, offset);
+            offset += entry->size();
+            if (!(entry->flags & ChunkedLogEntry::kCleared)) {
+                elements.push_back(statsElement(id, *entry));
+            }
+        }
+    }
+
+    wrlock();
+    for (const LogStatisticsElement& element : elements) {
+        stats.subtract(element);
+    }
+    // Keep the most recently dropped chunk as the spare. The others, the old
+    // spare included, are freed once we let go of the lock.
+    LogChunkCollection::iterator newest = std::prev(retired.end());
+    retired.splice(retired.end(), mSpare[id]);
+    mSpare[id].splice(mSpare[id].end(), retired, newest);
+    unlock();
+}
+
+LogStatisticsElement ChunkedLogBuffer::statsElement(
+    log_id_t id, const ChunkedLogEntry& entry) const {
+    return LogStatisticsElement(id, entry.realtime, entry.uid, entry.pid,
+                                entry.tid,
+                                getTag(id, entry.msg(), entry.msg_len),
+                                entry.msg(), entry.msg_len);
+}
+
+// Positions |cursor| at the first entry of |id| after |sequence|.
+void ChunkedLogBuffer::seek(log_id_t id, uint64_t sequence, Cursor* cursor) {
+    LogChunkCollection& chunks = mChunks[id];
+    cursor->consumed = sequence;
+    cursor->chunk = std::partition_point(
+        chunks.begin(), chunks.end(),
+        [sequence](const LogChunk& c) { return c.lastSequence() <= sequence; });
+    if (cursor->chunk == chunks.end()) {
+        if (!chunks.empty()) {
+            --cursor->chunk;
+            cursor->offset = cursor->chunk->used();
+        } else {
+            cursor->offset = 0;
+        }
+        return;
+    }
+    cursor->offset = cursor->chunk->offsetBefore(sequence);
+    const ChunkedLogEntry* entry;
+    while ((entry = peek(id, cursor)) && (entry->sequence <= sequence)) {
+        cursor->offset += entry->size();
+    }
+}
+
+// Positions |cursor| at the first entry of |id| a reader that has seen
+// everything up to |start| has yet to see. Like LogBuffer::flushTo(), this
+// settles on the entry after one matching |start| exactly, or failing that
+// the first newer one in the neighborhood, since timestamps are not strictly
+// ordered.
+void ChunkedLogBuffer::seekTime(log_id_t id, const log_time& start,
+                                Cursor* cursor) {
+    LogChunkCollection& chunks = mChunks[id];
+    if ((start == log_time::EPOCH) || chunks.empty()) {
+        seek(id, 0, cursor);
+        return;
+    }
+
+    cursor->chunk = chunks.end();
+    do {
+        --cursor->chunk;
+    } while ((cursor->chunk != chunks.begin()) &&
+             (cursor->chunk->firstRealTime() > start));
+    cursor->offset = 0;
+
+    uint64_t consumed = (cursor->chunk == chunks.begin())
+                            ? 0
+                            : std::prev(cursor->chunk)->lastSequence();
+    bool found = false;
+    const ChunkedLogEntry* entry;
+    while ((entry = peek(id, cursor))) {
+        if (entry->realtime == start) {
+            consumed = entry->sequence;
+            found = true;
+        } else if (found) {
+            // Look no further than the chunk of the first match.
+        } else if (entry->realtime > start) {
+            consumed = entry->sequence - 1;
+            found = true;
+        } else {
+            consumed = entry->sequence;
+        }
+        cursor->offset += entry->size();
+        if (found && (cursor->offset >= cursor->chunk->used())) {
+            break;
+        }
+    }
+    seek(id, consumed, cursor);
+}
+
+// Returns the entry at |cursor|, or nullptr if |id| has nothing more.
+const ChunkedLogEntry* ChunkedLogBuffer::peek(log_id_t id, Cursor* cursor) {
+    LogChunkCollection& chunks = mChunks[id];
+    if (cursor->chunk == chunks.end()) {
+        // Empty when we looked, anything added since is new to us.
+        if (chunks.empty()) {
+            return nullptr;
+        }
+        cursor->chunk = chunks.begin();
+        cursor->offset = 0;
+    }
+    for (;;) {
+        while (cursor->offset >= cursor->chunk->used()) {
+            LogChunkCollection::iterator next = std::next(cursor->chunk);
+            if (next == chunks.end()) {
+                return nullptr;
+            }
+            cursor->chunk = next;
+            cursor->offset = 0;
+        }
+
+        const LogChunk& chunk = *cursor->chunk;
+        if (chunk.contents()) {
+            return ChunkedLogEntry::at(chunk.contents(), cursor->offset);
+        }
+        if (cursor->cached != &chunk) {
+            cursor->cached = nullptr;
+            if (!chunk.decompress(&cursor->cache)) {
+                android::prdebug("logd: failed to decompress log chunk");
+                cursor->offset = chunk.used();
+                continue;
+            }
+            cursor->cached = &chunk;
+        }
+        return ChunkedLogEntry::at(cursor->cache.data(), cursor->offset);
+    }
+}
+
+log_time ChunkedLogBuffer::flushTo(SocketClient* reader, const log_time& start,
+                                   pid_t* lastTid, bool privileged,
+                                   bool security, LogBufferFilter filter,
+                                   void* arg, uint64_t* sequence,
+                                   LogBufferMessageFilter messageFilter,
+                                   LogBufferSink sink) {
+    uid_t uid = reader ? reader->getUid() : AID_ROOT;
+    Cursor cursors[LOG_ID_MAX];
+    std::vector<char> msg;
+
+    rdlock();
+
+    log_id_for_each(i) {
+        if (sequence && *sequence) {
+            seek(i, *sequence, &cursors[i]);
+        } else {
+            seekTime(i, start, &cursors[i]);
+        }
+    }
+    uint64_t generation = mGeneration;
+
+    log_time curr = start;
+
+    static const size_t maxSkip = 4194304;  // maximum entries to skip
+    size_t skip = maxSkip;
+    for (;;) {
+        if (generation != mGeneration) {
+            // Chunks were dropped or modified while we were sending, find
+            // our place again.
+            log_id_for_each(i) {
+                cursors[i].cached = nullptr;
+                seek(i, cursors[i].consumed, &cursors[i]);
+            }
+            generation = mGeneration;
+        }
+
+        // Merge the log ids in the order the entries arrived in, so that a
+        // single sequence number is enough to pick up where we left off.
+        log_id_t id = LOG_ID_MAX;
+        const ChunkedLogEntry* entry = nullptr;
+        log_id_for_each(i) {
+            const ChunkedLogEntry* e = peek(i, &cursors[i]);
+            if (e && (!entry || (e->sequence < entry->sequence))) {
+                entry = e;
+                id = i;
+            }
+        }
+        if (!entry) {
+            break;
+        }
+        cursors[id].consumed = entry->sequence;
+        cursors[id].offset += entry->size();
+
+        if (!--skip) {
+            android::prdebug("reader.per: too many elements skipped");
+            break;
+        }
+
+        bool wanted = !(entry->flags & ChunkedLogEntry::kCleared) &&
+                      (privileged || (entry->uid == uid)) &&
+                      (security || (id != LOG_ID_SECURITY));
+
+        // NB: calling out to another object with rdlock() held (safe)
+        if (wanted && filter) {
+            int ret = (*filter)(id, entry->pid, entry->realtime, 0,
+                                entry->msg(), entry->msg_len, arg);
+            if ((ret != false) && (ret != true)) {
+                break;
+            }
+            wanted = ret;
+        }
+
+        if (sequence) {
+            *sequence = entry->sequence;
+        }
+        if (!wanted) {
+            continue;
+        }
+
+        if (lastTid) {
+            lastTid[id] = entry->tid;
+        }
+
+        struct logger_entry_v4 hdr;
+        memset(&hdr, 0, sizeof(hdr));
+        hdr.hdr_size = privileged ? sizeof(struct logger_entry_v4)
+                                  : sizeof(struct logger_entry_v3);
+        hdr.lid = id;
+        hdr.pid = entry->pid;
+        hdr.tid = entry->tid;
+        hdr.uid = entry->uid;
+        hdr.sec = entry->realtime.tv_sec;
+        hdr.nsec = entry->realtime.tv_nsec;
+        hdr.len = entry->msg_len;
+
+        // The entry may be dropped as soon as we let go of the lock.
+        msg.assign(entry->msg(), entry->msg() + entry->msg_len);
+        log_time realtime = entry->realtime;
+
+        unlock();
+
+        if (messageFilter &&
+            !(*messageFilter)(id, msg.data(), hdr.len, arg)) {
+            rdlock();
+            continue;
+        }
+
+        if (sink) {
+            if (!(*sink)(&hdr, msg.data(), arg)) {
+                return LogBufferElement::FLUSH_ERROR;
+            }
+        } else {
+            struct iovec iovec[2];
+            iovec[0].iov_base = &hdr;
+            iovec[0].iov_len = hdr.hdr_size;
+            iovec[1].iov_base = msg.data();
+            iovec[1].iov_len = hdr.len;
+            if (reader->sendDatav(iovec, 1 + (hdr.len != 0))) {
+                return LogBufferElement::FLUSH_ERROR;
+            }
+        }
+        curr = realtime;
+
+        skip = maxSkip;
+        rdlock();
+    }
+    unlock();
+
+    return curr;
+}
+
+bool ChunkedLogBuffer::clear(log_id_t id, uid_t uid) {
+    wrlock();
+    if (uid == AID_ROOT) {
+        while (!mChunks[id].empty()) {
+            dropOldestChunk(id);
+        }
+    } else {
+        for (LogChunk& chunk : mChunks[id]) {
+            chunk.forEachEntry([this, id, uid](ChunkedLogEntry* entry) {
+                if ((entry->uid != uid) ||
+                    (entry->flags & ChunkedLogEntry::kCleared)) {
+                    return false;
+                }
+                stats.subtract(statsElement(id, *entry));
+                entry->flags |= ChunkedLogEntry::kCleared;
+                return true;
+            });
+        }
+        ++mGeneration;
+        requestHousekeeping();
+    }
+    unlock();
+    // Readers never hold entries in place, so we are never busy.
+    return false;
+}
+
+// get the used space associated with "id".
+unsigned long ChunkedLogBuffer::getSizeUsed(log_id_t id) {
+    rdlock();
+    size_t retval = stats.sizes(id);
+    unlock();
+    return retval;
+}
+
+// set the total space allocated to "id"
+int ChunkedLogBuffer::setSize(log_id_t id, unsigned long size) {
+    // Reasonable limits ...
+    if (!__android_logger_valid_buffer_size(size)) {
+        return -1;
+    }
+    wrlock();
+    mMaxSize[id] = size;
+    while (!mChunks[id].empty() && (allocated(id) > size)) {
+        dropOldestChunk(id);
+    }
+    unlock();
+    return 0;
+}
+
+// get the total space allocated to "id"
+unsigned long ChunkedLogBuffer::getSize(log_id_t id) {
+    rdlock();
+    size_t retval = mMaxSize[id];
+    unlock();
+    return retval;
+}
@@ -0,0 +1,253 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _LOGD_CHUNKED_LOG_BUFFER_H__
+#define _LOGD_CHUNKED_LOG_BUFFER_H__
+
+#include <pthread.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#include <functional>
+#include <list>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include <log/log_id.h>
+#include <log/log_time.h>
+#include <private/android_filesystem_config.h>
+#include <sysutils/SocketClient.h>
+
+#include "LogBufferInterface.h"
+#include "LogStatistics.h"
+#include "LogTimes.h"
+
+// Header of one entry in a LogChunk, immediately followed by msg_len bytes
+// of payload and then padding up to the next kEntryAlignment boundary.
+struct ChunkedLogEntry {
+    static constexpr uint8_t kCleared = 1;  // removed by a per-uid clear
+
+    uint64_t sequence;
+    log_time realtime;
+    uint32_t uid;
+    uint32_t pid;
+    uint32_t tid;
+    uint16_t msg_len;
+    uint8_t flags;
+    uint8_t reserved;
+
+    static size_t entrySize(uint16_t len) {
+        return (sizeof(ChunkedLogEntry) + len + alignof(ChunkedLogEntry) - 1) &
+               ~(alignof(ChunkedLogEntry) - 1);
+    }
+    static const ChunkedLogEntry* at(const char* contents, size_t offset) {
+        return reinterpret_cast<const ChunkedLogEntry*>(contents + offset);
+    }
+
+    size_t size() const {
+        return entrySize(msg_len);
+    }
+    const char* msg() const {
+        return reinterpret_cast<const char*>(this + 1);
+    }
+    char* msg() {
+        return reinterpret_cast<char*>(this + 1);
+    }
+};
+
+// A fixed-size, append-only arena holding the entries of a single log id
+// back to back.
+//
+// Once a chunk is no longer written to it is sealed: its contents are
+// compressed and the uncompressed copy is freed. Sealed chunks are only ever
+// read through decompress(), into a buffer of the reader's own.
+//
+// The compression runs without the buffer lock held, on a reference to the
+// contents from shareContents(). Contents are never written while shared,
+// anything that needs to modify them works on a copy instead, which makes
+// the later finishSeal() a no-op.
+class LogChunk {
+   public:
+    explicit LogChunk(size_t capacity)
+        : mContents(new char[capacity]), mCapacity(capacity) {
+    }
+
+    size_t capacity() const {
+        return mCapacity;
+    }
+    // Memory held for the contents, what counts against the buffer size.
+    size_t footprint() const {
+        return sealed() ? mCompressed.size() : mCapacity;
+    }
+    // Offset one past the last entry; entries start at offset 0.
+    size_t used() const {
+        return mUsed;
+    }
+    uint64_t lastSequence() const {
+        return mLastSequence;
+    }
+    log_time firstRealTime() const {
+        return mFirstRealTime;
+    }
+    bool sealed() const {
+        return !mContents;
+    }
+    // The uncompressed contents, or nullptr once sealed.
+    const char* contents() const {
+        return mContents.get();
+    }
+    bool canFit(uint16_t len) const {
+        return !sealed() &&
+               (mUsed + ChunkedLogEntry::entrySize(len) <= mCapacity);
+    }
+    // Offset to start scanning from for the first entry after |sequence|.
+    size_t offsetBefore(uint64_t sequence) const;
+
+    // Caller must have checked canFit(len).
+    ChunkedLogEntry* append(uint64_t sequence, log_time realtime, uid_t uid,
+                            pid_t pid, pid_t tid, const char* msg,
+                            uint16_t len);
+    void reset();
+
+    bool needsSeal() const {
+        return !sealed() && mUsed && !mIncompressible;
+    }
+    std::shared_ptr<char[]> shareContents() const {
+        return mContents;
+    }
+    // Compresses |len| bytes of |contents| to |out|. Returns false if that
+    // would not save any memory.
+    static bool compress(const char* contents, size_t len,
+                         std::vector<uint8_t>* out);
+    // Replaces |contents| with |compressed|, unless the chunk has moved on
+    // from them. A nullptr |compressed| marks the contents incompressible.
+    void finishSeal(const char* contents, std::vector<uint8_t>* compressed);
+    // Copies the uncompressed contents of a sealed chunk to |out|.
+    bool decompress(std::vector<char>* out) const;
+
+    // Calls |f| on every entry. |f| returns true if it modified the entry, in
+    // which case a sealed chunk is left unsealed.
+    void forEachEntry(const std::function<bool(ChunkedLogEntry*)>& f);
+
+   private:
+    // Sequence number and offset of every kIndexInterval'th entry.
+    static constexpr size_t kIndexInterval = 64;
+    typedef std::pair<uint64_t, uint32_t> IndexEntry;
+
+    std::shared_ptr<char[]> mContents;
+    std::vector<uint8_t> mCompressed;
+    std::vector<IndexEntry> mIndex;
+    size_t mCapacity;
+    size_t mUsed = 0;
+    size_t mEntries = 0;
+    uint64_t mLastSequence = 0;
+    log_time mFirstRealTime;
+    bool mIncompressible = false;
+};
+
+typedef std::list<LogChunk> LogChunkCollection;
+
+// LogBufferInterface implementation that packs entries into large chunks per
+// log id instead of allocating each one separately. Pruning drops the oldest
+// chunk as a whole, so there is no chatty accounting and no reader is ever
+// kicked: a reader that falls behind simply resumes at the oldest entry left.
+// All but the newest chunk of each log id are kept compressed, so the same
+// buffer size holds several times the history.
+class ChunkedLogBuffer : public LogBufferInterface {
+   public:
+    explicit ChunkedLogBuffer(LastLogTimes* times);
+    ~ChunkedLogBuffer() override;
+    void init() override;
+
+    int log(log_id_t log_id, log_time realtime, uid_t uid, pid_t pid, pid_t tid,
+            const char* msg, uint16_t len) override;
+    log_mask_t logBatch(const LogEntry* entries, size_t count) override;
+    log_time flushTo(SocketClient* writer, const log_time& start,
+                     pid_t* lastTid, bool privileged, bool security,
+                     LogBufferFilter filter = nullptr, void* arg = nullptr,
+                     uint64_t* sequence = nullptr,
+                     LogBufferMessageFilter messageFilter = nullptr,
+                     LogBufferSink sink = nullptr) override;
+
+    bool clear(log_id_t id, uid_t uid = AID_ROOT) override;
+    unsigned long getSize(log_id_t id) override;
+    int setSize(log_id_t id, unsigned long size) override;
+    unsigned long getSizeUsed(log_id_t id) override;
+
+   private:
+    // Chunks are sized to hold roughly an eighth of the buffer, so pruning
+    // gives back at most that much history at a time.
+    static constexpr size_t kChunksPerBuffer = 8;
+    static constexpr size_t kMinChunkSize = 16 * 1024;
+    static constexpr size_t kMaxChunkSize = 2 * 1024 * 1024;
+
+    // Read position of flushTo() in one log id.
+    struct Cursor {
+        LogChunkCollection::iterator chunk;
+        size_t offset = 0;
+        // Sequence number of the last entry of this log id at or before the
+        // position, used to find our place again after chunks are dropped.
+        uint64_t consumed = 0;
+        // The sealed chunk whose contents are in |cache|, if any.
+        const LogChunk* cached = nullptr;
+        std::vector<char> cache;
+    };
+
+    bool isLoggable(log_id_t log_id, const char* msg, uint16_t len);
+    int log_Locked(const LogEntry& entry, bool loggable);
+    size_t chunkSize(log_id_t id) const;
+    size_t allocated(log_id_t id) const;
+    LogChunk& chunkFor(log_id_t id, uint16_t len);
+    void dropOldestChunk(log_id_t id);
+    void requestHousekeeping();
+
+    // Seals chunks and releases dropped ones in the background, so that
+    // neither costs log() time under the lock.
+    static void* housekeepingThreadStart(void* obj);
+    void housekeeping();
+    bool sealOneChunk();
+    void releaseRetiredChunks(log_id_t id);
+    LogStatisticsElement statsElement(log_id_t id,
+                                      const ChunkedLogEntry& entry) const;
+    void seek(log_id_t id, uint64_t sequence, Cursor* cursor);
+    void seekTime(log_id_t id, const log_time& start, Cursor* cursor);
+    const ChunkedLogEntry* peek(log_id_t id, Cursor* cursor);
+
+    LogChunkCollection mChunks[LOG_ID_MAX];
+    // Dropped chunks whose entries are still to be subtracted from stats.
+    LogChunkCollection mRetired[LOG_ID_MAX];
+    // The most recently dropped chunk of each log id, kept for reuse.
+    LogChunkCollection mSpare[LOG_ID_MAX];
+    unsigned long mMaxSize[LOG_ID_MAX];
+
+    uint64_t mSequence = 0;
+    // Bumped whenever chunks are dropped or entries are modified, so that
+    // flushTo() knows to revalidate its cursors after sleeping without the
+    // lock.
+    uint64_t mGeneration = 0;
+
+    pthread_t mHousekeepingThread;
+    bool mHousekeepingStarted = false;
+    // Protect and signal mHousekeepingRequested and mHousekeepingStop. Taken
+    // with or without the buffer lock held, never the other way around.
+    pthread_mutex_t mHousekeepingLock = PTHREAD_MUTEX_INITIALIZER;
+    pthread_cond_t mHousekeepingCondition = PTHREAD_COND_INITIALIZER;
+    bool mHousekeepingRequested = false;
+    bool mHousekeepingStop = false;
+};
+
+#endif  // _LOGD_CHUNKED_LOG_BUFFER_H__
@@ -37,7 +37,7 @@
 #include "LogCommand.h"
 #include "LogUtils.h"
 
-CommandListener::CommandListener(LogBuffer* buf, LogReader* /*reader*/,
+CommandListener::CommandListener(LogBufferInterface* buf, LogReader* /*reader*/,
                                  LogListener* /*swl*/)
     : FrameworkListener(getLogSocket()) {
     // registerCmd(new ShutdownCmd(buf, writer, swl));
@@ -64,7 +64,7 @@ int CommandListener::ShutdownCmd::runCommand(SocketClient* /*cli*/,
     exit(0);
 }
 
-CommandListener::ClearCmd::ClearCmd(LogBuffer* buf)
+CommandListener::ClearCmd::ClearCmd(LogBufferInterface* buf)
     : LogCommand("clear"), mBuf(*buf) {
 }
 
@@ -99,7 +99,7 @@ int CommandListener::ClearCmd::runCommand(SocketClient* cli, int argc,
     return 0;
 }
 
-CommandListener::GetBufSizeCmd::GetBufSizeCmd(LogBuffer* buf)
+CommandListener::GetBufSizeCmd::GetBufSizeCmd(LogBufferInterface* buf)
     : LogCommand("getLogSize"), mBuf(*buf) {
 }
 
@@ -124,7 +124,7 @@ int CommandListener::GetBufSizeCmd::runCommand(SocketClient* cli, int argc,
     return 0;
 }
 
-CommandListener::SetBufSizeCmd::SetBufSizeCmd(LogBuffer* buf)
+CommandListener::SetBufSizeCmd::SetBufSizeCmd(LogBufferInterface* buf)
     : LogCommand("setLogSize"), mBuf(*buf) {
 }
 
@@ -157,7 +157,7 @@ int CommandListener::SetBufSizeCmd::runCommand(SocketClient* cli, int argc,
     return 0;
 }
 
-CommandListener::GetBufSizeUsedCmd::GetBufSizeUsedCmd(LogBuffer* buf)
+CommandListener::GetBufSizeUsedCmd::GetBufSizeUsedCmd(LogBufferInterface* buf)
     : LogCommand("getLogSizeUsed"), mBuf(*buf) {
 }
 
@@ -182,7 +182,7 @@ int CommandListener::GetBufSizeUsedCmd::runCommand(SocketClient* cli, int argc,
     return 0;
 }
 
-CommandListener::GetStatisticsCmd::GetStatisticsCmd(LogBuffer* buf)
+CommandListener::GetStatisticsCmd::GetStatisticsCmd(LogBufferInterface* buf)
     : LogCommand("getStatistics"), mBuf(*buf) {
 }
 
@@ -233,7 +233,7 @@ int CommandListener::GetStatisticsCmd::runCommand(SocketClient* cli, int argc,
     return 0;
 }
 
-CommandListener::GetPruneListCmd::GetPruneListCmd(LogBuffer* buf)
+CommandListener::GetPruneListCmd::GetPruneListCmd(LogBufferInterface* buf)
     : LogCommand("getPruneList"), mBuf(*buf) {
 }
 
@@ -244,7 +244,7 @@ int CommandListener::GetPruneListCmd::runCommand(SocketClient* cli,
     return 0;
 }
 
-CommandListener::SetPruneListCmd::SetPruneListCmd(LogBuffer* buf)
+CommandListener::SetPruneListCmd::SetPruneListCmd(LogBufferInterface* buf)
     : LogCommand("setPruneList"), mBuf(*buf) {
 }
 
@@ -276,7 +276,7 @@ int CommandListener::SetPruneListCmd::runCommand(SocketClient* cli, int argc,
     return 0;
 }
 
-CommandListener::GetEventTagCmd::GetEventTagCmd(LogBuffer* buf)
+CommandListener::GetEventTagCmd::GetEventTagCmd(LogBufferInterface* buf)
     : LogCommand("getEventTag"), mBuf(*buf) {
 }
 
@@ -19,8 +19,8 @@
 #include <private/android_filesystem_config.h>
 
 #include "FlushCommand.h"
-#include "LogBuffer.h"
 #include "LogBufferElement.h"
+#include "LogBufferInterface.h"
 #include "LogCommand.h"
 #include "LogReader.h"
 #include "LogTimes.h"
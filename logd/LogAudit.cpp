@@ -35,7 +35,7 @@
 #include <private/android_logger.h>
 
 #include "LogAudit.h"
-#include "LogBuffer.h"
+#include "LogBufferInterface.h"
 #include "LogKlog.h"
 #include "LogReader.h"
 #include "LogUtils.h"
@@ -45,10 +45,11 @@
     '<', '0' + LOG_MAKEPRI(LOG_AUTH, LOG_PRI(PRI)) / 10, \
         '0' + LOG_MAKEPRI(LOG_AUTH, LOG_PRI(PRI)) % 10, '>'
 
-LogAudit::LogAudit(LogBuffer* buf, LogReader* reader, int fdDmesg)
+LogAudit::LogAudit(LogBufferInterface* buf, LogReader* reader, int fdDmesg)
     : SocketListener(getLogSocket(), false),
       logbuf(buf),
       reader(reader),
+      batch("auditd", buf, reader),
       fdDmesg(fdDmesg),
       main(__android_logger_property_get_bool("ro.logd.auditd.main",
                                               BOOL_DEFAULT_TRUE)),
@@ -97,6 +98,23 @@ bool LogAudit::onDataAvailable(SocketClient* cli) {
 
     logPrint("type=%d %.*s", rep.nlh.nlmsg_type, rep.nlh.nlmsg_len, rep.data);
 
+    // Drain whatever else a denial storm has queued up into the same batch,
+    // up to a bound on how long it holds back what it has.
+    static const size_t max_drain = 64;
+    for (size_t count = 1; count < max_drain; ++count) {
+        rep.nlh.nlmsg_type = 0;
+        rep.nlh.nlmsg_len = 0;
+        rep.data[0] = '\0';
+        if (audit_get_reply(cli->getSocket(), &rep, GET_REPLY_NONBLOCKING,
+                            0) < 0) {
+            break;
+        }
+        if (!rep.nlh.nlmsg_len) break;  // nothing more for now
+        logPrint("type=%d %.*s", rep.nlh.nlmsg_type, rep.nlh.nlmsg_len,
+                 rep.data);
+    }
+    commit();
+
     return true;
 }
 
@@ -348,12 +366,10 @@ int LogAudit::logPrint(const char* fmt, ...) {
         memcpy(event->data + str_len - denial_metadata.length(),
                denial_metadata.c_str(), denial_metadata.length());
 
-        rc = logbuf->log(
+        batch.add(
             LOG_ID_EVENTS, now, uid, pid, tid, reinterpret_cast<char*>(event),
             (message_len <= UINT16_MAX) ? (uint16_t)message_len : UINT16_MAX);
-        if (rc >= 0) {
-            notify |= 1 << LOG_ID_EVENTS;
-        }
+        notify |= 1 << LOG_ID_EVENTS;
         // end scope for event buffer
     }
 
@@ -404,24 +420,19 @@ int LogAudit::logPrint(const char* fmt, ...) {
         strncpy(newstr + 1 + str_len + prefix_len + suffix_len,
                 denial_metadata.c_str(), denial_metadata.length());
 
-        rc = logbuf->log(
+        batch.add(
             LOG_ID_MAIN, now, uid, pid, tid, newstr,
             (message_len <= UINT16_MAX) ? (uint16_t)message_len : UINT16_MAX);
-
-        if (rc >= 0) {
-            notify |= 1 << LOG_ID_MAIN;
-        }
+        notify |= 1 << LOG_ID_MAIN;
         // end scope for main buffer
     }
 
     free(const_cast<char*>(commfree));
     free(str);
 
+    // Readers are notified once the batch is committed
     if (notify) {
-        reader->notifyNewLog(notify);
-        if (rc < 0) {
-            rc = message_len;
-        }
+        rc = message_len;
     }
 
     return rc;
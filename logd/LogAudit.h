@@ -21,21 +21,27 @@
 
 #include <sysutils/SocketListener.h>
 
-#include "LogBuffer.h"
+#include "LogBatch.h"
+#include "LogBufferInterface.h"
 
 class LogReader;
 
 class LogAudit : public SocketListener {
-    LogBuffer* logbuf;
+    LogBufferInterface* logbuf;
     LogReader* reader;
+    LogBatch batch;
     int fdDmesg;  // fdDmesg >= 0 is functionally bool dmesg
     bool main;
     bool events;
     bool initialized;
 
    public:
-    LogAudit(LogBuffer* buf, LogReader* reader, int fdDmesg);
+    LogAudit(LogBufferInterface* buf, LogReader* reader, int fdDmesg);
     int log(char* buf, size_t len);
+    // Adds what log() staged to the buffer.
+    void commit() {
+        batch.commit();
+    }
     bool isMonotonic() {
         return logbuf->isMonotonic();
     }
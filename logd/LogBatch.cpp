@@ -0,0 +1,88 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <inttypes.h>
+
+#include <android-base/stringprintf.h>
+
+#include "LogBatch.h"
+#include "LogReader.h"
+
+LogBatch::LogBatch(const char* name, LogBufferInterface* logbuf,
+                   LogReader* reader)
+    : mName(name),
+      mLogBuf(logbuf),
+      mReader(reader),
+      mBatches(0),
+      mEntriesTotal(0),
+      mLargest(0) {
+    mEntries.reserve(kMaxEntries);
+    mOffsets.reserve(kMaxEntries);
+    mData.reserve(kMaxBytes);
+    mLogBuf->addBatch(this);
+}
+
+LogBatch::~LogBatch() {
+    commit();
+    mLogBuf->removeBatch(this);
+}
+
+void LogBatch::add(log_id_t log_id, log_time realtime, uid_t uid, pid_t pid,
+                   pid_t tid, const char* msg, uint16_t len) {
+    if ((mEntries.size() >= kMaxEntries) ||
+        ((mData.size() + len) > kMaxBytes)) {
+        commit();
+    }
+
+    mOffsets.push_back(mData.size());
+    mData.append(msg, len);
+    mEntries.push_back({log_id, realtime, uid, pid, tid, nullptr, len});
+}
+
+void LogBatch::commit() {
+    size_t count = mEntries.size();
+    if (!count) return;
+
+    // Only now that mData is done growing
+    for (size_t i = 0; i < count; ++i) {
+        mEntries[i].msg = mData.data() + mOffsets[i];
+    }
+    log_mask_t mask = mLogBuf->logBatch(mEntries.data(), count);
+
+    mEntries.clear();
+    mOffsets.clear();
+    mData.clear();
+
+    mBatches.fetch_add(1, std::memory_order_relaxed);
+    mEntriesTotal.fetch_add(count, std::memory_order_relaxed);
+    if (count > mLargest.load(std::memory_order_relaxed)) {
+        mLargest.store(count, std::memory_order_relaxed);
+    }
+
+    if (mask && mReader) {
+        mReader->notifyNewLog(mask);
+    }
+}
+
+std::string LogBatch::format() const {
+    uint64_t batches = mBatches.load(std::memory_order_relaxed);
+    uint64_t entries = mEntriesTotal.load(std::memory_order_relaxed);
+    return android::base::StringPrintf(
+        "%-10s%10" PRIu64 " entries in %" PRIu64
+        " batches, %.1f average, %zu largest\n",
+        mName, entries, batches, batches ? (double)entries / batches : 0.0,
+        mLargest.load(std::memory_order_relaxed));
+}
@@ -0,0 +1,72 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _LOGD_LOG_BATCH_H__
+#define _LOGD_LOG_BATCH_H__
+
+#include <stdint.h>
+#include <sys/types.h>
+
+#include <atomic>
+#include <string>
+#include <vector>
+
+#include <log/log_id.h>
+#include <log/log_time.h>
+
+#include "LogBufferInterface.h"
+
+class LogReader;
+
+// Stages the entries of one kernel source, LogKlog or LogAudit, so that a
+// burst of them goes into the buffer under a single hold of the lock and
+// wakes the readers once, rather than contending with LogListener entry by
+// entry. Owned by the source and only ever used by one thread at a time,
+// so staging itself takes no lock at all.
+class LogBatch {
+   public:
+    LogBatch(const char* name, LogBufferInterface* logbuf, LogReader* reader);
+    ~LogBatch();
+
+    // Copies the entry in, committing what is staged first if full.
+    void add(log_id_t log_id, log_time realtime, uid_t uid, pid_t pid,
+             pid_t tid, const char* msg, uint16_t len);
+    // Hands what is staged to the buffer and notifies the readers.
+    void commit();
+
+    // One line of counters for the statistics.
+    std::string format() const;
+
+   private:
+    static constexpr size_t kMaxEntries = 256;
+    static constexpr size_t kMaxBytes = 64 * 1024;
+
+    const char* mName;
+    LogBufferInterface* mLogBuf;
+    LogReader* mReader;
+
+    std::vector<LogBufferInterface::LogEntry> mEntries;
+    // Where the payload of each of mEntries starts in mData.
+    std::vector<size_t> mOffsets;
+    std::string mData;
+
+    // Read by the statistics from other threads.
+    std::atomic<uint64_t> mBatches;
+    std::atomic<uint64_t> mEntriesTotal;
+    std::atomic<size_t> mLargest;
+};
+
+#endif  // _LOGD_LOG_BATCH_H__
@@ -26,6 +26,7 @@
 #include <time.h>
 #include <unistd.h>
 
+#include <memory>
 #include <unordered_map>
 
 #include <cutils/properties.h>
@@ -54,9 +55,7 @@ void LogBuffer::init() {
             setSize(i, LOG_BUFFER_MIN_SIZE);
         }
     }
-    bool lastMonotonic = monotonic;
-    monotonic = android_log_clockid() == CLOCK_MONOTONIC;
-    if (lastMonotonic != monotonic) {
+    if (updateMonotonic()) {
         //
         // Fixup all timestamps, may not be 100% accurate, but better than
         // throwing what we have away when we get 'surprised' by a change.
@@ -101,22 +100,10 @@ void LogBuffer::init() {
     //
     // NB: this is _not_ performed in the context of a SIGHUP, it is
     // performed during startup, and in context of reinit administrative thread
-    LogTimeEntry::wrlock();
-
-    LastLogTimes::iterator times = mTimes.begin();
-    while (times != mTimes.end()) {
-        LogTimeEntry* entry = times->get();
-        entry->triggerReader_Locked();
-        times++;
-    }
-
-    LogTimeEntry::unlock();
+    triggerReaders();
 }
 
-LogBuffer::LogBuffer(LastLogTimes* times)
-    : monotonic(android_log_clockid() == CLOCK_MONOTONIC), mTimes(*times) {
-    pthread_rwlock_init(&mLogElementsLock, nullptr);
-
+LogBuffer::LogBuffer(LastLogTimes* times) : LogBufferInterface(times) {
     log_id_for_each(i) {
         lastLoggedElements[i] = nullptr;
         droppedElements[i] = nullptr;
@@ -196,12 +183,11 @@ static enum match_type identical(LogBufferElement* elem,
     return SAME;
 }
 
-int LogBuffer::log(log_id_t log_id, log_time realtime, uid_t uid, pid_t pid,
-                   pid_t tid, const char* msg, uint16_t len) {
-    if (log_id >= LOG_ID_MAX) {
-        return -EINVAL;
-    }
-
+// Creates the element for an entry, nullptr if it is not loggable.
+LogBufferElement* LogBuffer::newElement(log_id_t log_id, log_time realtime,
+                                        uid_t uid, pid_t pid, pid_t tid,
+                                        const char* msg, uint16_t len,
+                                        bool* loggable) {
     // Slip the time by 1 nsec if the incoming lands on xxxxxx000 ns.
     // This prevents any chance that an outside source can request an
     // exact entry with time specified in ms or us precision.
@@ -209,6 +195,7 @@ int LogBuffer::log(log_id_t log_id, log_time realtime, uid_t uid, pid_t pid,
 
     LogBufferElement* elem =
         new LogBufferElement(log_id, realtime, uid, pid, tid, msg, len);
+    *loggable = true;
     if (log_id != LOG_ID_SECURITY) {
         int prio = ANDROID_LOG_INFO;
         const char* tag = nullptr;
@@ -223,18 +210,75 @@ int LogBuffer::log(log_id_t log_id, log_time realtime, uid_t uid, pid_t pid,
             tag = msg + 1;
             tag_len = strnlen(tag, len - 1);
         }
-        if (!__android_log_is_loggable_len(prio, tag, tag_len,
-                                           ANDROID_LOG_VERBOSE)) {
-            // Log traffic received to total
-            wrlock();
-            stats.addTotal(elem);
-            unlock();
-            delete elem;
-            return -EACCES;
-        }
+        *loggable = __android_log_is_loggable_len(prio, tag, tag_len,
+                                                  ANDROID_LOG_VERBOSE);
+    }
+    return elem;
+}
+
+int LogBuffer::log(log_id_t log_id, log_time realtime, uid_t uid, pid_t pid,
+                   pid_t tid, const char* msg, uint16_t len) {
+    if (log_id >= LOG_ID_MAX) {
+        return -EINVAL;
     }
 
+    bool loggable;
+    LogBufferElement* elem =
+        newElement(log_id, realtime, uid, pid, tid, msg, len, &loggable);
+
+    wrlock();
+    int ret = loggable ? log_Locked(elem) : reject_Locked(elem);
+    unlock();
+
+    if (ret > 0) {
+        added(log_id, realtime, uid, pid, tid, msg, len);
+    }
+
+    return ret;
+}
+
+log_mask_t LogBuffer::logBatch(const LogEntry* entries, size_t count) {
+    std::unique_ptr<LogBufferElement*[]> elems(new LogBufferElement*[count]);
+    std::unique_ptr<bool[]> loggable(new bool[count]);
+    for (size_t i = 0; i < count; ++i) {
+        const LogEntry& e = entries[i];
+        elems[i] = (e.log_id < LOG_ID_MAX)
+                       ? newElement(e.log_id, e.realtime, e.uid, e.pid, e.tid,
+                                    e.msg, e.len, &loggable[i])
+                       : nullptr;
+    }
+
+    log_mask_t mask = 0;
     wrlock();
+    for (size_t i = 0; i < count; ++i) {
+        if (!elems[i]) continue;
+        log_id_t log_id = entries[i].log_id;
+        int ret = loggable[i] ? log_Locked(elems[i]) : reject_Locked(elems[i]);
+        loggable[i] = ret > 0;
+        if (loggable[i]) mask |= 1 << log_id;
+    }
+    unlock();
+
+    for (size_t i = 0; i < count; ++i) {
+        if (elems[i] && loggable[i]) added(entries[i]);
+    }
+
+    return mask;
+}
+
+// Log traffic received to total, owns elem
+int LogBuffer::reject_Locked(LogBufferElement* elem) {
+    stats.addTotal(elem->toLogStatisticsElement());
+    delete elem;
+    return -EACCES;
+}
+
+// assumes LogBuffer::wrlock() held, owns elem, does the chatty collapsing
+// of identical entries before passing them on to log(elem)
+int LogBuffer::log_Locked(LogBufferElement* elem) {
+    log_id_t log_id = elem->getLogId();
+    uint16_t len = elem->getMsgLen();
+
     LogBufferElement* currentLast = lastLoggedElements[log_id];
     if (currentLast) {
         LogBufferElement* dropped = droppedElements[log_id];
@@ -335,14 +379,12 @@ int LogBuffer::log(log_id_t log_id, log_time realtime, uid_t uid, pid_t pid,
                     // check for overflow
                     if (total >= UINT32_MAX) {
                         log(currentLast);
-                        unlock();
                         return len;
                     }
-                    stats.addTotal(currentLast);
+                    stats.addTotal(currentLast->toLogStatisticsElement());
                     delete currentLast;
                     swab = total;
                     event->payload.data = htole32(swab);
-                    unlock();
                     return len;
                 }
                 if (count == USHRT_MAX) {
@@ -354,12 +396,11 @@ int LogBuffer::log(log_id_t log_id, log_time realtime, uid_t uid, pid_t pid,
                 }
             }
             if (count) {
-                stats.addTotal(currentLast);
+                stats.addTotal(currentLast->toLogStatisticsElement());
                 currentLast->setDropped(count);
             }
             droppedElements[log_id] = currentLast;
             lastLoggedElements[log_id] = elem;
-            unlock();
             return len;
         }
         if (dropped) {         // State 1 or 2
@@ -377,7 +418,6 @@ int LogBuffer::log(log_id_t log_id, log_time realtime, uid_t uid, pid_t pid,
     lastLoggedElements[log_id] = new LogBufferElement(*elem);
 
     log(elem);
-    unlock();
 
     return len;
 }
@@ -398,6 +438,7 @@ void LogBuffer::log(LogBufferElement* elem) {
                         (elem->getLogId() != LOG_ID_KERNEL) &&
                         ((*it)->getLogId() != LOG_ID_KERNEL))) {
         mLogElements.push_back(elem);
+        linkSameKey(--mLogElements.end(), mLogElements.end());
     } else {
         log_time end(log_time::EPOCH);
         bool end_set = false;
@@ -422,6 +463,7 @@ void LogBuffer::log(LogBufferElement* elem) {
 
         if (end_always || (end_set && (end > (*it)->getRealTime()))) {
             mLogElements.push_back(elem);
+            linkSameKey(--mLogElements.end(), mLogElements.end());
         } else {
             // should be short as timestamps are localized near end()
             do {
@@ -432,12 +474,20 @@ void LogBuffer::log(LogBufferElement* elem) {
                 --it;
             } while (((*it)->getRealTime() > elem->getRealTime()) &&
                      (!end_set || (end <= (*it)->getRealTime())));
-            mLogElements.insert(last, elem);
+            it = mLogElements.insert(last, elem);
+            // also short, the next entry with the same key is near end()
+            uid_t key = pruneKey(elem);
+            while ((last != mLogElements.end()) &&
+                   (((*last)->getLogId() != elem->getLogId()) ||
+                    (pruneKey(*last) != key))) {
+                ++last;
+            }
+            linkSameKey(it, last);
         }
         LogTimeEntry::unlock();
     }
 
-    stats.add(elem);
+    stats.add(elem->toLogStatisticsElement());
     maybePrune(elem->getLogId());
 }
 
@@ -465,6 +515,76 @@ void LogBuffer::maybePrune(log_id_t id) {
     }
 }
 
+// The same key links are end() at either end of a chain.
+static LogBufferElementCollection::iterator loadSameKey(
+    const uint8_t (&link)[sizeof(LogBufferElementCollection::iterator)]) {
+    LogBufferElementCollection::iterator it;
+    memcpy(&it, link, sizeof(it));
+    return it;
+}
+
+static void storeSameKey(
+    uint8_t (&link)[sizeof(LogBufferElementCollection::iterator)],
+    LogBufferElementCollection::iterator it) {
+    memcpy(link, &it, sizeof(it));
+}
+
+void LogBuffer::linkSameKey(LogBufferElementCollection::iterator it,
+                            LogBufferElementCollection::iterator next) {
+    LogBufferElement* element = *it;
+    LogBufferElementCollection::iterator prev;
+    if (next == mLogElements.end()) {
+        LogBufferIteratorMap& tails = mSameKeyTail[element->getLogId()];
+        uid_t key = pruneKey(element);
+        LogBufferIteratorMap::iterator found = tails.find(key);
+        if (found == tails.end()) {
+            prev = mLogElements.end();
+            tails.emplace(key, it);
+        } else {
+            prev = found->second;
+            found->second = it;
+        }
+    } else {
+        prev = loadSameKey((*next)->mSameKeyPrev);
+        storeSameKey((*next)->mSameKeyPrev, it);
+    }
+    if (prev != mLogElements.end()) {
+        storeSameKey((*prev)->mSameKeyNext, it);
+    }
+    storeSameKey(element->mSameKeyPrev, prev);
+    storeSameKey(element->mSameKeyNext, next);
+}
+
+void LogBuffer::unlinkSameKey(LogBufferElementCollection::iterator it) {
+    LogBufferElement* element = *it;
+    LogBufferElementCollection::iterator prev =
+        loadSameKey(element->mSameKeyPrev);
+    LogBufferElementCollection::iterator next =
+        loadSameKey(element->mSameKeyNext);
+    if (prev != mLogElements.end()) {
+        storeSameKey((*prev)->mSameKeyNext, next);
+    }
+    if (next != mLogElements.end()) {
+        storeSameKey((*next)->mSameKeyPrev, prev);
+        return;
+    }
+    LogBufferIteratorMap& tails = mSameKeyTail[element->getLogId()];
+    LogBufferIteratorMap::iterator found = tails.find(pruneKey(element));
+    if (found == tails.end()) {  // impossible
+        return;
+    }
+    if (prev == mLogElements.end()) {
+        tails.erase(found);
+    } else {
+        found->second = prev;
+    }
+}
+
+LogBufferElementCollection::iterator LogBuffer::nextSameKey(
+    const LogBufferElement* element) {
+    return loadSameKey(element->mSameKeyNext);
+}
+
 LogBufferElementCollection::iterator LogBuffer::erase(
     LogBufferElementCollection::iterator it, bool coalesce) {
     LogBufferElement* element = *it;
@@ -506,6 +626,7 @@ LogBufferElementCollection::iterator LogBuffer::erase(
                   ? element->getTag()
                   : element->getUid();
 #endif
+    unlinkSameKey(it);
     it = mLogElements.erase(it);
     if (doSetLast) {
         log_id_for_each(i) {
@@ -541,9 +662,9 @@ LogBufferElementCollection::iterator LogBuffer::erase(
     }
 #endif
     if (coalesce) {
-        stats.erase(element);
+        stats.erase(element->toLogStatisticsElement());
     } else {
-        stats.subtract(element);
+        stats.subtract(element->toLogStatisticsElement());
     }
     delete element;
 
@@ -744,7 +865,16 @@ bool LogBuffer::prune(log_id_t id, unsigned long pruneRows, uid_t caller_uid) {
                 break;
             }
 
-            it = erase(it);
+            // the uid is the key outside of the binary logs, so only its own
+            // entries need visiting from here on.
+            if (element->isBinary()) {
+                it = erase(it);
+            } else {
+                LogBufferElementCollection::iterator next =
+                    nextSameKey(element);
+                erase(it);
+                it = next;
+            }
             if (--pruneRows == 0) {
                 break;
             }
@@ -790,6 +920,10 @@ bool LogBuffer::prune(log_id_t id, unsigned long pruneRows, uid_t caller_uid) {
 
         bool kick = false;
         bool leading = true;
+        // Without a blacklist to match, only the entries of the worst key
+        // matter once past the leading ones, so the walk follows their chain
+        // from the first one it meets instead of visiting every entry.
+        bool chain = !hasBlacklist && (worst != -1);
         it = mLastSet[id] ? mLast[id] : mLogElements.begin();
         // Perform at least one mandatory garbage collection cycle in following
         // - clear leading chatty tags
@@ -851,15 +985,20 @@ bool LogBuffer::prune(log_id_t id, unsigned long pruneRows, uid_t caller_uid) {
                 continue;
             }
 
+            int key = pruneKey(element);
+            LogBufferElementCollection::iterator next = it;
+            if (chain && !leading && (key == worst)) {
+                next = nextSameKey(element);
+            } else {
+                ++next;
+            }
+
             if (dropped && last.coalesce(element, dropped)) {
-                it = erase(it, true);
+                erase(it, true);
+                it = next;
                 continue;
             }
 
-            int key = ((id == LOG_ID_EVENTS) || (id == LOG_ID_SECURITY))
-                          ? element->getTag()
-                          : element->getUid();
-
             if (hasBlacklist && mPrune.naughty(element)) {
                 last.clear(element);
                 it = erase(it);
@@ -902,7 +1041,7 @@ bool LogBuffer::prune(log_id_t id, unsigned long pruneRows, uid_t caller_uid) {
                     (mLastWorst[id].find(key) == mLastWorst[id].end())) {
                     mLastWorst[id][key] = it;
                 }
-                ++it;
+                it = next;
                 continue;
             }
 
@@ -910,7 +1049,7 @@ bool LogBuffer::prune(log_id_t id, unsigned long pruneRows, uid_t caller_uid) {
                 (worstPid && (element->getPid() != worstPid))) {
                 leading = false;
                 last.clear(element);
-                ++it;
+                it = next;
                 continue;
             }
             // key == worst below here
@@ -929,10 +1068,11 @@ bool LogBuffer::prune(log_id_t id, unsigned long pruneRows, uid_t caller_uid) {
             if (leading) {
                 it = erase(it);
             } else {
-                stats.drop(element);
+                stats.drop(element->toLogStatisticsElement());
                 element->setDropped(1);
                 if (last.coalesce(element, 1)) {
-                    it = erase(it, true);
+                    erase(it, true);
+                    it = next;
                 } else {
                     last.add(element);
                     if (worstPid &&
@@ -947,7 +1087,7 @@ bool LogBuffer::prune(log_id_t id, unsigned long pruneRows, uid_t caller_uid) {
                         (mLastWorst[id].find(worst) == mLastWorst[id].end())) {
                         mLastWorst[id][worst] = it;
                     }
-                    ++it;
+                    it = next;
                 }
             }
             if (worst_sizes < second_worst_sizes) {
@@ -1099,11 +1239,12 @@ unsigned long LogBuffer::getSize(log_id_t id) {
 
 log_time LogBuffer::flushTo(SocketClient* reader, const log_time& start,
                             pid_t* lastTid, bool privileged, bool security,
-                            int (*filter)(const LogBufferElement* element,
-                                          void* arg),
-                            void* arg) {
+                            LogBufferFilter filter, void* arg,
+                            uint64_t* /*sequence*/,
+                            LogBufferMessageFilter messageFilter,
+                            LogBufferSink sink) {
     LogBufferElementCollection::iterator it;
-    uid_t uid = reader->getUid();
+    uid_t uid = reader ? reader->getUid() : AID_ROOT;
 
     rdlock();
 
@@ -1161,7 +1302,9 @@ log_time LogBuffer::flushTo(SocketClient* reader, const log_time& start,
 
         // NB: calling out to another object with wrlock() held (safe)
         if (filter) {
-            int ret = (*filter)(element, arg);
+            int ret = (*filter)(element->getLogId(), element->getPid(),
+                                element->getRealTime(), element->getDropped(),
+                                element->getMsg(), element->getMsgLen(), arg);
             if (ret == false) {
                 continue;
             }
@@ -1185,7 +1328,24 @@ log_time LogBuffer::flushTo(SocketClient* reader, const log_time& start,
         unlock();
 
         // range locking in LastLogTimes looks after us
-        curr = element->flushTo(reader, this, privileged, sameTid);
+        if (messageFilter && element->getMsg() &&
+            !(*messageFilter)(element->getLogId(), element->getMsg(),
+                              element->getMsgLen(), arg)) {
+            rdlock();
+            continue;
+        }
+        if (sink) {
+            struct logger_entry_v4 entry;
+            char* buffer = nullptr;
+            const char* msg = element->serialize(&entry, buffer, this, sameTid);
+            curr = element->getRealTime();
+            if (msg && !(*sink)(&entry, msg, arg)) {
+                curr = element->FLUSH_ERROR;
+            }
+            free(buffer);
+        } else {
+            curr = element->flushTo(reader, this, privileged, sameTid);
+        }
 
         if (curr == element->FLUSH_ERROR) {
             return curr;
@@ -1198,14 +1358,3 @@ log_time LogBuffer::flushTo(SocketClient* reader, const log_time& start,
 
     return curr;
 }
-
-std::string LogBuffer::formatStatistics(uid_t uid, pid_t pid,
-                                        unsigned int logMask) {
-    wrlock();
-
-    std::string ret = stats.format(uid, pid, logMask);
-
-    unlock();
-
-    return ret;
-}
@@ -33,55 +33,14 @@
 #include "LogTimes.h"
 #include "LogWhiteBlackList.h"
 
-//
-// We are either in 1970ish (MONOTONIC) or 2016+ish (REALTIME) so to
-// differentiate without prejudice, we use 1972 to delineate, earlier
-// is likely monotonic, later is real. Otherwise we start using a
-// dividing line between monotonic and realtime if more than a minute
-// difference between them.
-//
-namespace android {
-
-static bool isMonotonic(const log_time& mono) {
-    static const uint32_t EPOCH_PLUS_2_YEARS = 2 * 24 * 60 * 60 * 1461 / 4;
-    static const uint32_t EPOCH_PLUS_MINUTE = 60;
-
-    if (mono.tv_sec >= EPOCH_PLUS_2_YEARS) {
-        return false;
-    }
-
-    log_time now(CLOCK_REALTIME);
-
-    /* Timezone and ntp time setup? */
-    if (now.tv_sec >= EPOCH_PLUS_2_YEARS) {
-        return true;
-    }
-
-    /* no way to differentiate realtime from monotonic time */
-    if (now.tv_sec < EPOCH_PLUS_MINUTE) {
-        return false;
-    }
-
-    log_time cpu(CLOCK_MONOTONIC);
-    /* too close to call to differentiate monotonic times from realtime */
-    if ((cpu.tv_sec + EPOCH_PLUS_MINUTE) >= now.tv_sec) {
-        return false;
-    }
-
-    /* dividing line half way between monotonic and realtime */
-    return mono.tv_sec < ((cpu.tv_sec + now.tv_sec) / 2);
-}
-}
-
 typedef std::list<LogBufferElement*> LogBufferElementCollection;
 
+// The default LogBufferInterface implementation: every entry is a separately
+// allocated LogBufferElement, and pruning favors evicting the chattiest
+// sources, leaving chatty summaries behind.
 class LogBuffer : public LogBufferInterface {
     LogBufferElementCollection mLogElements;
-    pthread_rwlock_t mLogElementsLock;
-
-    LogStatistics stats;
 
-    PruneList mPrune;
     // watermark for last per log id
     LogBufferElementCollection::iterator mLast[LOG_ID_MAX];
     bool mLastSet[LOG_ID_MAX];
@@ -93,90 +52,40 @@ class LogBuffer : public LogBufferInterface {
     typedef std::unordered_map<pid_t, LogBufferElementCollection::iterator>
         LogBufferPidIteratorMap;
     LogBufferPidIteratorMap mLastWorstPidOfSystem[LOG_ID_MAX];
+    // newest entry per prune key, the tail of the chain of entries with that
+    // key that lets pruning for the worst key skip over all others
+    LogBufferIteratorMap mSameKeyTail[LOG_ID_MAX];
 
     unsigned long mMaxSize[LOG_ID_MAX];
 
-    bool monotonic;
-
-    LogTags tags;
-
     LogBufferElement* lastLoggedElements[LOG_ID_MAX];
     LogBufferElement* droppedElements[LOG_ID_MAX];
     void log(LogBufferElement* elem);
+    LogBufferElement* newElement(log_id_t log_id, log_time realtime, uid_t uid,
+                                 pid_t pid, pid_t tid, const char* msg,
+                                 uint16_t len, bool* loggable);
+    int log_Locked(LogBufferElement* elem);
+    int reject_Locked(LogBufferElement* elem);
 
    public:
-    LastLogTimes& mTimes;
-
     explicit LogBuffer(LastLogTimes* times);
     ~LogBuffer() override;
-    void init();
-    bool isMonotonic() {
-        return monotonic;
-    }
+    void init() override;
 
     int log(log_id_t log_id, log_time realtime, uid_t uid, pid_t pid, pid_t tid,
             const char* msg, uint16_t len) override;
-    // lastTid is an optional context to help detect if the last previous
-    // valid message was from the same source so we can differentiate chatty
-    // filter types (identical or expired)
+    log_mask_t logBatch(const LogEntry* entries, size_t count) override;
     log_time flushTo(SocketClient* writer, const log_time& start,
-                     pid_t* lastTid,  // &lastTid[LOG_ID_MAX] or nullptr
-                     bool privileged, bool security,
-                     int (*filter)(const LogBufferElement* element,
-                                   void* arg) = nullptr,
-                     void* arg = nullptr);
-
-    bool clear(log_id_t id, uid_t uid = AID_ROOT);
-    unsigned long getSize(log_id_t id);
-    int setSize(log_id_t id, unsigned long size);
-    unsigned long getSizeUsed(log_id_t id);
-
-    std::string formatStatistics(uid_t uid, pid_t pid, unsigned int logMask);
+                     pid_t* lastTid, bool privileged, bool security,
+                     LogBufferFilter filter = nullptr, void* arg = nullptr,
+                     uint64_t* sequence = nullptr,
+                     LogBufferMessageFilter messageFilter = nullptr,
+                     LogBufferSink sink = nullptr) override;
 
-    void enableStatistics() {
-        stats.enableStatistics();
-    }
-
-    int initPrune(const char* cp) {
-        return mPrune.init(cp);
-    }
-    std::string formatPrune() {
-        return mPrune.format();
-    }
-
-    std::string formatGetEventTag(uid_t uid, const char* name,
-                                  const char* format) {
-        return tags.formatGetEventTag(uid, name, format);
-    }
-    std::string formatEntry(uint32_t tag, uid_t uid) {
-        return tags.formatEntry(tag, uid);
-    }
-    const char* tagToName(uint32_t tag) {
-        return tags.tagToName(tag);
-    }
-
-    // helper must be protected directly or implicitly by wrlock()/unlock()
-    const char* pidToName(pid_t pid) {
-        return stats.pidToName(pid);
-    }
-    virtual uid_t pidToUid(pid_t pid) override {
-        return stats.pidToUid(pid);
-    }
-    virtual pid_t tidToPid(pid_t tid) override {
-        return stats.tidToPid(tid);
-    }
-    const char* uidToName(uid_t uid) {
-        return stats.uidToName(uid);
-    }
-    void wrlock() {
-        pthread_rwlock_wrlock(&mLogElementsLock);
-    }
-    void rdlock() {
-        pthread_rwlock_rdlock(&mLogElementsLock);
-    }
-    void unlock() {
-        pthread_rwlock_unlock(&mLogElementsLock);
-    }
+    bool clear(log_id_t id, uid_t uid = AID_ROOT) override;
+    unsigned long getSize(log_id_t id) override;
+    int setSize(log_id_t id, unsigned long size) override;
+    unsigned long getSizeUsed(log_id_t id) override;
 
    private:
     static constexpr size_t minPrune = 4;
@@ -190,6 +99,20 @@ class LogBuffer : public LogBufferInterface {
     bool prune(log_id_t id, unsigned long pruneRows, uid_t uid = AID_ROOT);
     LogBufferElementCollection::iterator erase(
         LogBufferElementCollection::iterator it, bool coalesce = false);
+
+    // The key worst offenders are picked by: the tag for binary logs, the uid
+    // otherwise.
+    static uid_t pruneKey(const LogBufferElement* element) {
+        return element->isBinary() ? element->getTag() : element->getUid();
+    }
+    // Links the entry at |it| into the chain of its key, ahead of |next|, the
+    // following entry with the same key, or end() if there is none.
+    void linkSameKey(LogBufferElementCollection::iterator it,
+                     LogBufferElementCollection::iterator next);
+    void unlinkSameKey(LogBufferElementCollection::iterator it);
+    // The next entry with the same log id and key, or end().
+    static LogBufferElementCollection::iterator nextSameKey(
+        const LogBufferElement* element);
 };
 
 #endif  // _LOGD_LOG_BUFFER_H__
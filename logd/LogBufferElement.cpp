@@ -239,35 +239,40 @@ size_t LogBufferElement::populateDroppedMessage(char*& buffer, LogBuffer* parent
     return retval;
 }
 
+const char* LogBufferElement::serialize(struct logger_entry_v4* entry,
+                                        char*& buffer, LogBuffer* parent,
+                                        bool lastSame) {
+    memset(entry, 0, sizeof(struct logger_entry_v4));
+
+    entry->hdr_size = sizeof(struct logger_entry_v4);
+    entry->lid = mLogId;
+    entry->pid = mPid;
+    entry->tid = mTid;
+    entry->uid = mUid;
+    entry->sec = mRealTime.tv_sec;
+    entry->nsec = mRealTime.tv_nsec;
+
+    if (mDropped) {
+        entry->len = populateDroppedMessage(buffer, parent, lastSame);
+        return entry->len ? buffer : nullptr;
+    }
+    entry->len = mMsgLen;
+    return mMsg;
+}
+
 log_time LogBufferElement::flushTo(SocketClient* reader, LogBuffer* parent,
                                    bool privileged, bool lastSame) {
     struct logger_entry_v4 entry;
+    char* buffer = nullptr;
 
-    memset(&entry, 0, sizeof(struct logger_entry_v4));
-
-    entry.hdr_size = privileged ? sizeof(struct logger_entry_v4)
-                                : sizeof(struct logger_entry_v3);
-    entry.lid = mLogId;
-    entry.pid = mPid;
-    entry.tid = mTid;
-    entry.uid = mUid;
-    entry.sec = mRealTime.tv_sec;
-    entry.nsec = mRealTime.tv_nsec;
+    const char* msg = serialize(&entry, buffer, parent, lastSame);
+    if (!msg) return mRealTime;
+    if (!privileged) entry.hdr_size = sizeof(struct logger_entry_v3);
 
     struct iovec iovec[2];
     iovec[0].iov_base = &entry;
     iovec[0].iov_len = entry.hdr_size;
-
-    char* buffer = nullptr;
-
-    if (mDropped) {
-        entry.len = populateDroppedMessage(buffer, parent, lastSame);
-        if (!entry.len) return mRealTime;
-        iovec[1].iov_base = buffer;
-    } else {
-        entry.len = mMsgLen;
-        iovec[1].iov_base = mMsg;
-    }
+    iovec[1].iov_base = const_cast<char*>(msg);
     iovec[1].iov_len = entry.len;
 
     log_time retval = reader->sendDatav(iovec, 1 + (entry.len != 0))
@@ -22,9 +22,13 @@
 #include <stdlib.h>
 #include <sys/types.h>
 
+#include <list>
+
 #include <log/log.h>
 #include <sysutils/SocketClient.h>
 
+#include "LogStatistics.h"
+
 class LogBuffer;
 
 #define EXPIRE_HOUR_THRESHOLD 24  // Only expire chatty UID logs to preserve
@@ -48,6 +52,11 @@ class __attribute__((packed)) LogBufferElement {
     };
     const uint8_t mLogId;
     bool mDropped;
+    // The entries before and after this one with the same log id and prune
+    // key, maintained by LogBuffer. They are list iterators kept as bytes, as
+    // such members would stop the class from being packed.
+    uint8_t mSameKeyPrev[sizeof(std::list<LogBufferElement*>::iterator)];
+    uint8_t mSameKeyNext[sizeof(std::list<LogBufferElement*>::iterator)];
 
     static atomic_int_fast64_t sequence;
 
@@ -91,8 +100,18 @@ class __attribute__((packed)) LogBufferElement {
     log_time getRealTime(void) const {
         return mRealTime;
     }
+    LogStatisticsElement toLogStatisticsElement() const {
+        return LogStatisticsElement(getLogId(), mRealTime, mUid, mPid, mTid,
+                                    getTag(), getMsg(), getMsgLen(),
+                                    getDropped());
+    }
 
     static const log_time FLUSH_ERROR;
+    // Fills in entry as a privileged reader gets it and returns the payload
+    // to go with it, made up in buffer (to free()) for dropped entries.
+    // Returns nullptr if there is nothing to send.
+    const char* serialize(struct logger_entry_v4* entry, char*& buffer,
+                          LogBuffer* parent, bool lastSame);
     log_time flushTo(SocketClient* writer, LogBuffer* parent, bool privileged,
                      bool lastSame);
 };
@@ -14,16 +14,91 @@
  * limitations under the License.
  */
 
+#include <algorithm>
+
+#include <log/log.h>
+
+#include "LogBatch.h"
 #include "LogBufferInterface.h"
 #include "LogUtils.h"
 
-LogBufferInterface::LogBufferInterface() {
+LogBufferInterface::LogBufferInterface(LastLogTimes* times)
+    : mTimes(*times),
+      monotonic(android_log_clockid() == CLOCK_MONOTONIC),
+      mMirror(LogPmsgMirror::create()) {
+    // Readers come and go with every entry they send, by default their
+    // steady stream of rdlock() calls can hold off log() indefinitely.
+    // Preferring writers means rdlock() must never be taken recursively.
+    pthread_rwlockattr_t attr;
+    pthread_rwlockattr_init(&attr);
+    pthread_rwlockattr_setkind_np(&attr,
+                                  PTHREAD_RWLOCK_PREFER_WRITER_NONRECURSIVE_NP);
+    pthread_rwlock_init(&mLogElementsLock, &attr);
+    pthread_rwlockattr_destroy(&attr);
 }
+
 LogBufferInterface::~LogBufferInterface() {
+    pthread_rwlock_destroy(&mLogElementsLock);
+}
+
+std::string LogBufferInterface::formatStatistics(uid_t uid, pid_t pid,
+                                                 unsigned int logMask) {
+    wrlock();
+
+    std::string ret = stats.format(uid, pid, logMask);
+
+    if (!pid && !mBatches.empty()) {
+        ret += "\nKernel sources staged in batches:\n";
+        for (const LogBatch* batch : mBatches) {
+            ret += batch->format();
+        }
+    }
+
+    unlock();
+
+    return ret;
 }
-uid_t LogBufferInterface::pidToUid(pid_t pid) {
-    return android::pidToUid(pid);
+
+void LogBufferInterface::addBatch(const LogBatch* batch) {
+    wrlock();
+    mBatches.push_back(batch);
+    unlock();
 }
-pid_t LogBufferInterface::tidToPid(pid_t tid) {
-    return android::tidToPid(tid);
+
+void LogBufferInterface::removeBatch(const LogBatch* batch) {
+    wrlock();
+    mBatches.erase(std::remove(mBatches.begin(), mBatches.end(), batch),
+                   mBatches.end());
+    unlock();
+}
+
+log_mask_t LogBufferInterface::logBatch(const LogEntry* entries,
+                                        size_t count) {
+    log_mask_t mask = 0;
+    for (size_t i = 0; i < count; ++i) {
+        const LogEntry& e = entries[i];
+        if (log(e.log_id, e.realtime, e.uid, e.pid, e.tid, e.msg, e.len) > 0) {
+            mask |= 1 << e.log_id;
+        }
+    }
+    return mask;
+}
+
+bool LogBufferInterface::updateMonotonic() {
+    bool lastMonotonic = monotonic;
+    monotonic = android_log_clockid() == CLOCK_MONOTONIC;
+    return lastMonotonic != monotonic;
+}
+
+void LogBufferInterface::triggerReaders() {
+    LogTimeEntry::wrlock();
+
+    LastLogTimes::iterator times = mTimes.begin();
+    while (times != mTimes.end()) {
+        LogTimeEntry* entry = times->get();
+        entry->triggerReader_Locked();
+        times++;
+    }
+
+    LogTimeEntry::unlock();
 }
@@ -17,24 +17,232 @@
 #ifndef _LOGD_LOG_BUFFER_INTERFACE_H__
 #define _LOGD_LOG_BUFFER_INTERFACE_H__
 
+#include <pthread.h>
 #include <sys/types.h>
 
+#include <memory>
+#include <string>
+#include <vector>
+
 #include <android-base/macros.h>
 #include <log/log_id.h>
 #include <log/log_time.h>
+#include <private/android_filesystem_config.h>
+#include <sysutils/SocketClient.h>
+
+#include "LogPmsgMirror.h"
+#include "LogReaderStream.h"
+#include "LogStatistics.h"
+#include "LogTags.h"
+#include "LogTimes.h"
+#include "LogWhiteBlackList.h"
+
+//
+// We are either in 1970ish (MONOTONIC) or 2016+ish (REALTIME) so to
+// differentiate without prejudice, we use 1972 to delineate, earlier
+// is likely monotonic, later is real. Otherwise we start using a
+// dividing line between monotonic and realtime if more than a minute
+// difference between them.
+//
+namespace android {
+
+static bool isMonotonic(const log_time& mono) {
+    static const uint32_t EPOCH_PLUS_2_YEARS = 2 * 24 * 60 * 60 * 1461 / 4;
+    static const uint32_t EPOCH_PLUS_MINUTE = 60;
+
+    if (mono.tv_sec >= EPOCH_PLUS_2_YEARS) {
+        return false;
+    }
+
+    log_time now(CLOCK_REALTIME);
+
+    /* Timezone and ntp time setup? */
+    if (now.tv_sec >= EPOCH_PLUS_2_YEARS) {
+        return true;
+    }
 
-// Abstract interface that handles log when log available.
+    /* no way to differentiate realtime from monotonic time */
+    if (now.tv_sec < EPOCH_PLUS_MINUTE) {
+        return false;
+    }
+
+    log_time cpu(CLOCK_MONOTONIC);
+    /* too close to call to differentiate monotonic times from realtime */
+    if ((cpu.tv_sec + EPOCH_PLUS_MINUTE) >= now.tv_sec) {
+        return false;
+    }
+
+    /* dividing line half way between monotonic and realtime */
+    return mono.tv_sec < ((cpu.tv_sec + now.tv_sec) / 2);
+}
+}
+
+// flushTo filter callback, called with the lock held. msg is nullptr for
+// entries that only stand for dropped ones. Returns true to send the entry,
+// false to skip it, or any other value to stop.
+typedef int (*LogBufferFilter)(log_id_t log_id, pid_t pid, log_time realtime,
+                               uint16_t dropped_count, const char* msg,
+                               uint16_t len, void* arg);
+// Optional flushTo filter callback on the message of an entry that passed
+// LogBufferFilter, for checks too expensive to make with the lock held.
+// Called without the lock, just before the entry would be sent. Returns
+// whether to send it.
+typedef bool (*LogBufferMessageFilter)(log_id_t log_id, const char* msg,
+                                       uint16_t len, void* arg);
+// Optional flushTo callback that takes the place of the reader's socket, for
+// a walk made on behalf of several readers. Called without the lock with
+// the header as a privileged reader gets it, followed by entry->len bytes
+// of payload. Returns false to stop.
+typedef bool (*LogBufferSink)(const struct logger_entry_v4* entry,
+                              const char* msg, void* arg);
+
+class LogBatch;
+
+// Abstract interface to the storage of log entries. LogListener, LogAudit
+// and LogKlog add entries as they become available, readers and
+// administrative commands consume them.
+//
+// Statistics, event tags and the prune list are common to all
+// implementations, as is the lock that wrlock()/rdlock()/unlock() manage.
 class LogBufferInterface {
    public:
-    LogBufferInterface();
+    LastLogTimes& mTimes;
+
+    explicit LogBufferInterface(LastLogTimes* times);
     virtual ~LogBufferInterface();
+
+    // (Re)reads buffer sizes and the timestamp source from properties.
+    virtual void init() = 0;
+
     // Handles a log entry when available in LogListener.
     // Returns the size of the handled log message.
     virtual int log(log_id_t log_id, log_time realtime, uid_t uid, pid_t pid,
                     pid_t tid, const char* msg, uint16_t len) = 0;
 
-    virtual uid_t pidToUid(pid_t pid);
-    virtual pid_t tidToPid(pid_t tid);
+    // One entry for logBatch(), msg pointing at len bytes of payload.
+    struct LogEntry {
+        log_id_t log_id;
+        log_time realtime;
+        uid_t uid;
+        pid_t pid;
+        pid_t tid;
+        const char* msg;
+        uint16_t len;
+    };
+    // Adds entries as log() would each of them in turn, but taking the lock
+    // only once for all. Returns the mask of log ids any were added to.
+    virtual log_mask_t logBatch(const LogEntry* entries, size_t count);
+    // lastTid is an optional context to help detect if the last previous
+    // valid message was from the same source so we can differentiate chatty
+    // filter types (identical or expired)
+    // sequence is an optional cursor for implementations that number their
+    // entries: if non-zero on entry, flushing resumes after that entry rather
+    // than searching for start, and on return it holds the number of the
+    // last entry passed. Others leave it untouched.
+    // writer may be nullptr if a sink is given, which requires privileged.
+    virtual log_time flushTo(SocketClient* writer, const log_time& start,
+                             pid_t* lastTid,  // &lastTid[LOG_ID_MAX] or nullptr
+                             bool privileged, bool security,
+                             LogBufferFilter filter = nullptr,
+                             void* arg = nullptr,
+                             uint64_t* sequence = nullptr,
+                             LogBufferMessageFilter messageFilter = nullptr,
+                             LogBufferSink sink = nullptr) = 0;
+
+    virtual bool clear(log_id_t id, uid_t uid = AID_ROOT) = 0;
+    virtual unsigned long getSize(log_id_t id) = 0;
+    virtual int setSize(log_id_t id, unsigned long size) = 0;
+    virtual unsigned long getSizeUsed(log_id_t id) = 0;
+
+    std::string formatStatistics(uid_t uid, pid_t pid, unsigned int logMask);
+    // Lists the batch in the statistics for as long as it exists.
+    void addBatch(const LogBatch* batch);
+    void removeBatch(const LogBatch* batch);
+
+    // Set once by LogReader, before entries are added.
+    void setStream(LogReaderStream* stream) {
+        mStream = stream;
+    }
+
+    bool isMonotonic() {
+        return monotonic;
+    }
+
+    void enableStatistics() {
+        stats.enableStatistics();
+    }
+
+    int initPrune(const char* cp) {
+        return mPrune.init(cp);
+    }
+    std::string formatPrune() {
+        return mPrune.format();
+    }
+
+    std::string formatGetEventTag(uid_t uid, const char* name,
+                                  const char* format) {
+        return tags.formatGetEventTag(uid, name, format);
+    }
+    std::string formatEntry(uint32_t tag, uid_t uid) {
+        return tags.formatEntry(tag, uid);
+    }
+    const char* tagToName(uint32_t tag) {
+        return tags.tagToName(tag);
+    }
+
+    // helper must be protected directly or implicitly by wrlock()/unlock()
+    const char* pidToName(pid_t pid) {
+        return stats.pidToName(pid);
+    }
+    virtual uid_t pidToUid(pid_t pid) {
+        return stats.pidToUid(pid);
+    }
+    virtual pid_t tidToPid(pid_t tid) {
+        return stats.tidToPid(tid);
+    }
+    const char* uidToName(uid_t uid) {
+        return stats.uidToName(uid);
+    }
+    void wrlock() {
+        pthread_rwlock_wrlock(&mLogElementsLock);
+    }
+    void rdlock() {
+        pthread_rwlock_rdlock(&mLogElementsLock);
+    }
+    void unlock() {
+        pthread_rwlock_unlock(&mLogElementsLock);
+    }
+
+   protected:
+    // Picks up a change of the timestamp source. Returns true if it changed,
+    // in which case the caller must convert the timestamps it holds.
+    bool updateMonotonic();
+    // Releases any sleeping reader threads to dump their current content.
+    void triggerReaders();
+    // Hands an entry that was added to the buffer on to pstore if so
+    // configured, and to the readers it is pushed to. Called without the
+    // lock.
+    void added(log_id_t log_id, log_time realtime, uid_t uid, pid_t pid,
+               pid_t tid, const char* msg, uint16_t len) {
+        if (mMirror && mMirror->wants(log_id)) {
+            mMirror->append(log_id, realtime, uid, pid, tid, msg, len);
+        }
+        if (mStream) {
+            mStream->append(log_id, realtime, uid, pid, tid, msg, len);
+        }
+    }
+    void added(const LogEntry& e) {
+        added(e.log_id, e.realtime, e.uid, e.pid, e.tid, e.msg, e.len);
+    }
+
+    pthread_rwlock_t mLogElementsLock;
+    LogStatistics stats;
+    PruneList mPrune;
+    bool monotonic;
+    LogTags tags;
+    std::vector<const LogBatch*> mBatches;
+    std::unique_ptr<LogPmsgMirror> mMirror;
+    LogReaderStream* mStream = nullptr;
 
    private:
     DISALLOW_COPY_AND_ASSIGN(LogBufferInterface);
@@ -28,7 +28,7 @@
 #include <private/android_filesystem_config.h>
 #include <private/android_logger.h>
 
-#include "LogBuffer.h"
+#include "LogBufferInterface.h"
 #include "LogKlog.h"
 #include "LogReader.h"
 
@@ -201,11 +201,12 @@ log_time LogKlog::correction = (log_time(CLOCK_REALTIME) < log_time(CLOCK_MONOTO
                                        ? log_time(log_time::EPOCH)
                                        : (log_time(CLOCK_REALTIME) - log_time(CLOCK_MONOTONIC));
 
-LogKlog::LogKlog(LogBuffer* buf, LogReader* reader, int fdWrite, int fdRead,
+LogKlog::LogKlog(LogBufferInterface* buf, LogReader* reader, int fdWrite, int fdRead,
                  bool auditd)
     : SocketListener(fdRead, false),
       logbuf(buf),
       reader(reader),
+      batch("klogd", buf, reader),
       signature(CLOCK_MONOTONIC),
       initialized(false),
       enableLogging(true),
@@ -238,6 +239,7 @@ bool LogKlog::onDataAvailable(SocketClient* cli) {
             break;
         }
         if (retval < 0) {
+            commit();
             return false;
         }
         len += retval;
@@ -257,6 +259,7 @@ bool LogKlog::onDataAvailable(SocketClient* cli) {
                 log(tok, sublen);
             }
         }
+        commit();
     }
 
     return true;
@@ -814,13 +817,8 @@ int LogKlog::log(const char* buf, ssize_t len) {
         }
     }
 
-    // Log message
-    int rc = logbuf->log(LOG_ID_KERNEL, now, uid, pid, tid, newstr, (uint16_t)n);
+    // Log message, readers are notified once the batch is committed
+    batch.add(LOG_ID_KERNEL, now, uid, pid, tid, newstr, (uint16_t)n);
 
-    // notify readers
-    if (rc > 0) {
-        reader->notifyNewLog(static_cast<log_mask_t>(1 << LOG_ID_KERNEL));
-    }
-
-    return rc;
+    return n;
 }
@@ -20,12 +20,15 @@
 #include <private/android_logger.h>
 #include <sysutils/SocketListener.h>
 
-class LogBuffer;
+#include "LogBatch.h"
+
+class LogBufferInterface;
 class LogReader;
 
 class LogKlog : public SocketListener {
-    LogBuffer* logbuf;
+    LogBufferInterface* logbuf;
     LogReader* reader;
+    LogBatch batch;
     const log_time signature;
     // Set once thread is started, separates KLOG_ACTION_READ_ALL
     // and KLOG_ACTION_READ phases.
@@ -39,9 +42,13 @@ class LogKlog : public SocketListener {
     static log_time correction;
 
    public:
-    LogKlog(LogBuffer* buf, LogReader* reader, int fdWrite, int fdRead,
+    LogKlog(LogBufferInterface* buf, LogReader* reader, int fdWrite, int fdRead,
             bool auditd);
     int log(const char* buf, ssize_t len);
+    // Adds what log() staged to the buffer.
+    void commit() {
+        batch.commit();
+    }
     void synchronize(const char* buf, ssize_t len);
 
     bool isMonotonic() {
@@ -28,7 +28,7 @@
 #include <private/android_filesystem_config.h>
 #include <private/android_logger.h>
 
-#include "LogBuffer.h"
+#include "LogBufferInterface.h"
 #include "LogListener.h"
 #include "LogUtils.h"
 
@@ -43,9 +43,11 @@ bool LogListener::onDataAvailable(SocketClient* cli) {
         name_set = true;
     }
 
+    static_assert(LOGGER_BATCH_MAX_SIZE >= LOGGER_ENTRY_MAX_PAYLOAD,
+                  "batches must be able to hold any entry");
     // + 1 to ensure null terminator if MAX_PAYLOAD buffer is received
     char buffer[sizeof_log_id_t + sizeof(uint16_t) + sizeof(log_time) +
-                LOGGER_ENTRY_MAX_PAYLOAD + 1];
+                LOGGER_BATCH_MAX_SIZE + 1];
     struct iovec iov = { buffer, sizeof(buffer) - 1 };
 
     alignas(4) char control[CMSG_SPACE(sizeof(struct ucred))];
@@ -94,9 +96,51 @@ bool LogListener::onDataAvailable(SocketClient* cli) {
 
     android_log_header_t* header =
         reinterpret_cast<android_log_header_t*>(buffer);
+    char* msg = ((char*)buffer) + sizeof(android_log_header_t);
+    n -= sizeof(android_log_header_t);
+
+    // NB: hdr.msg_flags & MSG_TRUNC is not tested, silently passing a
+    // truncated message to the logs.
+
+    log_mask_t mask = 0;
+    if (header->id != LOG_ID_BATCH) {
+        if (!logEntry(cred, header, msg, n, &mask)) {
+            return false;
+        }
+        if (mask && reader != nullptr) {
+            reader->notifyNewLog(mask);
+        }
+        return true;
+    }
+
+    // A batch from a single thread, wake up the readers only once for all of
+    // its entries.
+    while ((size_t)n >= sizeof(android_log_batch_entry_t)) {
+        android_log_batch_entry_t* entry =
+            reinterpret_cast<android_log_batch_entry_t*>(msg);
+        size_t len = entry->len;
+        msg += sizeof(*entry);
+        n -= sizeof(*entry);
+        if (len > (size_t)n) {
+            break;  // truncated
+        }
+        logEntry(cred, &entry->header, msg, len, &mask);
+        msg += len;
+        n -= len;
+    }
+    if (mask && reader != nullptr) {
+        reader->notifyNewLog(mask);
+    }
+
+    return true;
+}
+
+bool LogListener::logEntry(struct ucred* cred,
+                           const android_log_header_t* header, char* msg,
+                           size_t len, log_mask_t* mask) {
     log_id_t logId = static_cast<log_id_t>(header->id);
     if (/* logId < LOG_ID_MIN || */ logId >= LOG_ID_MAX ||
-        logId == LOG_ID_KERNEL) {
+        logId == LOG_ID_KERNEL || !len) {
         return false;
     }
 
@@ -127,18 +171,12 @@ bool LogListener::onDataAvailable(SocketClient* cli) {
         if (uid != AID_LOGD) cred->uid = uid;
     }
 
-    char* msg = ((char*)buffer) + sizeof(android_log_header_t);
-    n -= sizeof(android_log_header_t);
-
-    // NB: hdr.msg_flags & MSG_TRUNC is not tested, silently passing a
-    // truncated message to the logs.
-
     if (logbuf != nullptr) {
         int res = logbuf->log(
             logId, header->realtime, cred->uid, cred->pid, header->tid, msg,
-            ((size_t)n <= UINT16_MAX) ? (uint16_t)n : UINT16_MAX);
-        if (res > 0 && reader != nullptr) {
-            reader->notifyNewLog(static_cast<log_mask_t>(1 << logId));
+            (len <= UINT16_MAX) ? (uint16_t)len : UINT16_MAX);
+        if (res > 0) {
+            *mask |= static_cast<log_mask_t>(1 << logId);
         }
     }
 
@@ -17,6 +17,9 @@
 #ifndef _LOGD_LOG_LISTENER_H__
 #define _LOGD_LOG_LISTENER_H__
 
+#include <sys/socket.h>
+
+#include <private/android_logger.h>
 #include <sysutils/SocketListener.h>
 #include "LogReader.h"
 
@@ -42,6 +45,10 @@ class LogListener : public SocketListener {
 
    private:
     static int getLogSocket();
+    // Returns false if the entry was rejected, adds the log id to |mask| if
+    // it was logged.
+    bool logEntry(struct ucred* cred, const android_log_header_t* header,
+                  char* msg, size_t len, log_mask_t* mask);
 };
 
 #endif
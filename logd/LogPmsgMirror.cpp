@@ -0,0 +1,211 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <errno.h>
+#include <inttypes.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/prctl.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <android-base/strings.h>
+#include <cutils/properties.h>
+#include <log/log_properties.h>
+#include <private/android_logger.h>
+
+#include "LogPmsgMirror.h"
+#include "LogUtils.h"
+
+LogPmsgMirror* LogPmsgMirror::create() {
+    char property[PROPERTY_VALUE_MAX];
+    if (property_get("ro.logd.pmsg_mirror", property, "") <= 0) {
+        return nullptr;
+    }
+
+    log_mask_t mask = 0;
+    for (const auto& name : android::base::Split(property, ",")) {
+        if (name == "all") {
+            mask = (log_mask_t)-1;
+            continue;
+        }
+        log_id_t log_id = android_name_to_log_id(name.c_str());
+        if (log_id < LOG_ID_MAX) {
+            mask |= 1 << log_id;
+        }
+    }
+    // Every client already writes the security log to pmsg itself, and on
+    // debuggable builds all but the kernel log, see pmsgAvailable().
+    mask &= ~(1 << LOG_ID_SECURITY);
+    if (__android_log_is_debuggable()) {
+        mask &= 1 << LOG_ID_KERNEL;
+    }
+    if (!mask) {
+        return nullptr;
+    }
+
+    int fd = TEMP_FAILURE_RETRY(open("/dev/pmsg0", O_WRONLY | O_CLOEXEC));
+    if (fd < 0) {
+        android::prdebug("pmsg mirror disabled, %s", strerror(errno));
+        return nullptr;
+    }
+
+    LogPmsgMirror* mirror = new LogPmsgMirror(mask, fd);
+    if (!mirror->mStarted) {
+        delete mirror;
+        return nullptr;
+    }
+    return mirror;
+}
+
+LogPmsgMirror::LogPmsgMirror(log_mask_t mask, int fd) : mMask(mask), mFd(fd) {
+    pthread_condattr_t condattr;
+    pthread_condattr_init(&condattr);
+    pthread_condattr_setclock(&condattr, CLOCK_MONOTONIC);
+    pthread_cond_init(&mCondition, &condattr);
+    pthread_condattr_destroy(&condattr);
+
+    mPending.reserve(kMaxBacklog);
+
+    pthread_attr_t attr;
+    if (!pthread_attr_init(&attr)) {
+        mStarted = !pthread_create(&mThread, &attr, threadStart, this);
+        pthread_attr_destroy(&attr);
+    }
+}
+
+LogPmsgMirror::~LogPmsgMirror() {
+    if (mStarted) {
+        pthread_mutex_lock(&mLock);
+        mStop = true;
+        pthread_cond_signal(&mCondition);
+        pthread_mutex_unlock(&mLock);
+        pthread_join(mThread, nullptr);
+    }
+    pthread_cond_destroy(&mCondition);
+    close(mFd);
+}
+
+void LogPmsgMirror::append(log_id_t log_id, log_time realtime, uid_t uid,
+                           pid_t pid, pid_t tid, const char* msg,
+                           uint16_t len) {
+    if (len > LOGGER_ENTRY_MAX_PAYLOAD) {
+        len = LOGGER_ENTRY_MAX_PAYLOAD;
+    }
+
+    // The same records as pmsgWrite(), so that pmsgRead() takes them as is.
+    android_pmsg_log_header_t pmsgHeader;
+    android_log_header_t header;
+    pmsgHeader.magic = LOGGER_MAGIC;
+    pmsgHeader.len = sizeof(pmsgHeader) + sizeof(header) + len;
+    pmsgHeader.uid = uid;
+    pmsgHeader.pid = pid;
+    header.id = log_id;
+    header.tid = tid;
+    header.realtime = realtime;
+
+    size_t size = pmsgHeader.len;
+    pthread_mutex_lock(&mLock);
+    if ((mPending.size() + size) > kMaxBacklog) {
+        ++mDropped;
+    } else {
+        bool wake = mPending.empty() ||
+                    ((mPending.size() < kBatchSize) &&
+                     ((mPending.size() + size) >= kBatchSize));
+        mPending.append(reinterpret_cast<const char*>(&pmsgHeader),
+                        sizeof(pmsgHeader));
+        mPending.append(reinterpret_cast<const char*>(&header), sizeof(header));
+        mPending.append(msg, len);
+        if (wake) {
+            pthread_cond_signal(&mCondition);
+        }
+    }
+    pthread_mutex_unlock(&mLock);
+}
+
+void* LogPmsgMirror::threadStart(void* obj) {
+    prctl(PR_SET_NAME, "logd.pmsg");
+
+    reinterpret_cast<LogPmsgMirror*>(obj)->run();
+
+    return nullptr;
+}
+
+void LogPmsgMirror::run() {
+    std::string writing;
+    writing.reserve(kMaxBacklog);
+
+    pthread_mutex_lock(&mLock);
+    for (;;) {
+        while (mPending.empty() && !mStop) {
+            pthread_cond_wait(&mCondition, &mLock);
+        }
+        if (mPending.empty()) {
+            break;
+        }
+
+        // Give the batch a chance to fill up
+        struct timespec deadline;
+        clock_gettime(CLOCK_MONOTONIC, &deadline);
+        deadline.tv_sec += kFlushIntervalMs / 1000;
+        deadline.tv_nsec += (kFlushIntervalMs % 1000) * 1000000;
+        if (deadline.tv_nsec >= NS_PER_SEC) {
+            deadline.tv_nsec -= NS_PER_SEC;
+            ++deadline.tv_sec;
+        }
+        while ((mPending.size() < kBatchSize) && !mStop) {
+            if (pthread_cond_timedwait(&mCondition, &mLock, &deadline) ==
+                ETIMEDOUT) {
+                break;
+            }
+        }
+
+        writing.swap(mPending);
+        uint64_t dropped = mDropped;
+        mDropped = 0;
+        pthread_mutex_unlock(&mLock);
+
+        if (dropped) {
+            android::prdebug("pmsg mirror dropped %" PRIu64 " entries",
+                             dropped);
+        }
+        // Whole records up to kBatchSize at a time, a reader resynchronizes
+        // on the next magic should a write be cut short.
+        const char* cp = writing.data();
+        const char* end = cp + writing.size();
+        while (cp < end) {
+            const char* batchEnd = cp;
+            while (batchEnd < end) {
+                const android_pmsg_log_header_t* record =
+                    reinterpret_cast<const android_pmsg_log_header_t*>(
+                        batchEnd);
+                if ((batchEnd != cp) &&
+                    ((batchEnd + record->len - cp) > (ssize_t)kBatchSize)) {
+                    break;
+                }
+                batchEnd += record->len;
+            }
+            if (TEMP_FAILURE_RETRY(write(mFd, cp, batchEnd - cp)) < 0) {
+                break;
+            }
+            cp = batchEnd;
+        }
+        writing.clear();
+
+        pthread_mutex_lock(&mLock);
+    }
+    pthread_mutex_unlock(&mLock);
+}
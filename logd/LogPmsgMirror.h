@@ -0,0 +1,75 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _LOGD_LOG_PMSG_MIRROR_H__
+#define _LOGD_LOG_PMSG_MIRROR_H__
+
+#include <pthread.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#include <string>
+
+#include <log/log_id.h>
+#include <log/log_time.h>
+
+#include "LogTimes.h"
+
+// Copies the entries of selected log ids, as they are added to the buffer,
+// on to pstore through /dev/pmsg0. The ramoops pmsg region is a ring in
+// memory that survives a reset, so logcat -L reads the most recent of them
+// back on the next boot. Entries are staged and written out by a thread of
+// our own in batches, many pmsg records to a write(), rather than with a
+// syscall each. Best effort: entries are dropped while the backlog is full.
+class LogPmsgMirror {
+   public:
+    // From ro.logd.pmsg_mirror, nullptr if nothing is to be mirrored.
+    static LogPmsgMirror* create();
+    ~LogPmsgMirror();
+
+    bool wants(log_id_t log_id) const {
+        return mMask & (1 << log_id);
+    }
+    void append(log_id_t log_id, log_time realtime, uid_t uid, pid_t pid,
+                pid_t tid, const char* msg, uint16_t len);
+
+   private:
+    // Written out once this much is staged, or kFlushIntervalMs after the
+    // first entry staged at the latest. The interval bounds what a reset
+    // loses, the size keeps each write well within the pmsg region.
+    static constexpr size_t kBatchSize = 16 * 1024;
+    static constexpr uint32_t kFlushIntervalMs = 200;
+    static constexpr size_t kMaxBacklog = 4 * kBatchSize;
+
+    LogPmsgMirror(log_mask_t mask, int fd);
+
+    static void* threadStart(void* obj);
+    void run();
+
+    const log_mask_t mMask;
+    const int mFd;
+
+    pthread_t mThread;
+    bool mStarted = false;
+    // Protect and signal everything below.
+    pthread_mutex_t mLock = PTHREAD_MUTEX_INITIALIZER;
+    pthread_cond_t mCondition;
+    std::string mPending;
+    bool mStop = false;
+    uint64_t mDropped = 0;
+};
+
+#endif  // _LOGD_LOG_PMSG_MIRROR_H__
@@ -21,17 +21,24 @@
 #include <sys/socket.h>
 #include <sys/types.h>
 
+#include <algorithm>
+#include <string>
+
 #include <cutils/sockets.h>
 #include <private/android_logger.h>
 
 #include "FlushCommand.h"
-#include "LogBuffer.h"
+#include "LogBufferInterface.h"
 #include "LogBufferElement.h"
 #include "LogReader.h"
+#include "LogReaderFilter.h"
 #include "LogUtils.h"
 
-LogReader::LogReader(LogBuffer* logbuf)
-    : SocketListener(getLogSocket(), true), mLogbuf(*logbuf) {
+LogReader::LogReader(LogBufferInterface* logbuf)
+    : SocketListener(getLogSocket(), true),
+      mLogbuf(*logbuf),
+      mFanOut(*logbuf) {
+    logbuf->setStream(&mStream);
 }
 
 // When we are notified a new log entry is available, inform
@@ -49,7 +56,7 @@ bool LogReader::onDataAvailable(SocketClient* cli) {
         name_set = true;
     }
 
-    char buffer[255];
+    char buffer[1024];
 
     int len = read(cli->getSocket(), buffer, sizeof(buffer) - 1);
     if (len <= 0) {
@@ -70,9 +77,27 @@ bool LogReader::onDataAvailable(SocketClient* cli) {
     }
     LogTimeEntry::unlock();
 
+    // Runs to the end of the command, so must be taken off before anything
+    // else is looked for.
+    std::string regex;
+    static const char _regex[] = " regex=";
+    char* cp = strstr(buffer, _regex);
+    if (cp) {
+        regex = cp + sizeof(_regex) - 1;
+        *cp = '\0';
+    }
+
+    std::string filter;
+    static const char _filter[] = " filter=";
+    cp = strstr(buffer, _filter);
+    if (cp) {
+        cp += sizeof(_filter) - 1;
+        filter.assign(cp, strcspn(cp, " "));
+    }
+
     unsigned long tail = 0;
     static const char _tail[] = " tail=";
-    char* cp = strstr(buffer, _tail);
+    cp = strstr(buffer, _tail);
     if (cp) {
         tail = atol(cp + sizeof(_tail) - 1);
     }
@@ -120,6 +145,23 @@ bool LogReader::onDataAvailable(SocketClient* cli) {
         pid = atol(cp + sizeof(_pid) - 1);
     }
 
+    // push=<entries>[,<usec>]: low latency, entries are pushed to the reader
+    // as they are added, in batches of up to <entries> held back for no more
+    // than <usec>.
+    size_t pushEntries = 0;
+    uint32_t pushDelayUs = 1000;
+    static const char _push[] = " push=";
+    cp = strstr(buffer, _push);
+    if (cp) {
+        char* ep;
+        pushEntries = strtoul(cp + sizeof(_push) - 1, &ep, 10);
+        if (*ep == ',') {
+            pushDelayUs = strtoul(ep + 1, nullptr, 10);
+        }
+        pushEntries = std::min(pushEntries, LogReaderStream::kMaxBatchEntries);
+        pushDelayUs = std::min(pushDelayUs, LogReaderStream::kMaxBatchDelayUs);
+    }
+
     bool nonBlock = false;
     if (!fastcmp<strncmp>(buffer, "dumpAndClose", 12)) {
         // Allow writer to get some cycles, and wait for pending notifications
@@ -166,11 +208,13 @@ bool LogReader::onDataAvailable(SocketClient* cli) {
                   mIsMonotonic(isMonotonic) {
             }
 
-            static int callback(const LogBufferElement* element, void* obj) {
+            static int callback(log_id_t log_id, pid_t pid, log_time real,
+                                uint16_t /*dropped_count*/,
+                                const char* /*msg*/, uint16_t /*len*/,
+                                void* obj) {
                 LogFindStart* me = reinterpret_cast<LogFindStart*>(obj);
-                if ((!me->mPid || (me->mPid == element->getPid())) &&
-                    (me->mLogMask & (1 << element->getLogId()))) {
-                    log_time real = element->getRealTime();
+                if ((!me->mPid || (me->mPid == pid)) &&
+                    (me->mLogMask & (1 << log_id))) {
                     if (me->mStart == real) {
                         me->mSequence = real;
                         me->mStartTimeSet = true;
@@ -208,17 +252,27 @@ bool LogReader::onDataAvailable(SocketClient* cli) {
 
     android::prdebug(
         "logdr: UID=%d GID=%d PID=%d %c tail=%lu logMask=%x pid=%d "
-        "start=%" PRIu64 "ns timeout=%" PRIu64 "ns\n",
+        "start=%" PRIu64 "ns timeout=%" PRIu64 "ns push=%zu,%" PRIu32
+        " filter=%s regex=%s\n",
         cli->getUid(), cli->getGid(), cli->getPid(), nonBlock ? 'n' : 'b', tail,
-        logMask, (int)pid, sequence.nsec(), timeout);
+        logMask, (int)pid, sequence.nsec(), timeout, pushEntries, pushDelayUs,
+        filter.c_str(), regex.c_str());
 
     if (sequence == log_time::EPOCH) {
         timeout = 0;
     }
 
+    std::unique_ptr<LogReaderFilter> readerFilter;
+    if (!filter.empty() || !regex.empty()) {
+        readerFilter = std::make_unique<LogReaderFilter>(filter.c_str(),
+                                                         regex.c_str());
+    }
+
     LogTimeEntry::wrlock();
-    auto entry = std::make_unique<LogTimeEntry>(
-        *this, cli, nonBlock, tail, logMask, pid, sequence, timeout);
+    auto entry = std::make_unique<LogTimeEntry>(*this, cli, nonBlock, tail,
+                                                logMask, pid, sequence, timeout,
+                                                std::move(readerFilter),
+                                                pushEntries, pushDelayUs);
     if (!entry->startReader_Locked()) {
         LogTimeEntry::unlock();
         return false;
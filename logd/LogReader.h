@@ -19,22 +19,32 @@
 
 #include <sysutils/SocketListener.h>
 
+#include "LogReaderFanOut.h"
+#include "LogReaderStream.h"
 #include "LogTimes.h"
 
 #define LOGD_SNDTIMEO 32
 
-class LogBuffer;
+class LogBufferInterface;
 
 class LogReader : public SocketListener {
-    LogBuffer& mLogbuf;
+    LogBufferInterface& mLogbuf;
+    LogReaderFanOut mFanOut;
+    LogReaderStream mStream;
 
    public:
-    explicit LogReader(LogBuffer* logbuf);
+    explicit LogReader(LogBufferInterface* logbuf);
     void notifyNewLog(log_mask_t logMask);
 
-    LogBuffer& logbuf(void) const {
+    LogBufferInterface& logbuf(void) const {
         return mLogbuf;
     }
+    LogReaderFanOut& fanOut(void) {
+        return mFanOut;
+    }
+    LogReaderStream& stream(void) {
+        return mStream;
+    }
 
    protected:
     virtual bool onDataAvailable(SocketClient* cli);
@@ -0,0 +1,286 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <sys/prctl.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+#include <algorithm>
+
+#include <private/android_logger.h>
+
+#include "LogBufferInterface.h"
+#include "LogReaderFanOut.h"
+#include "LogReaderFilter.h"
+#include "LogTimes.h"
+
+LogReaderFanOut::LogReaderFanOut(LogBufferInterface& logbuf)
+    : mLogbuf(logbuf),
+      mEnabled(__android_logger_property_get_bool("ro.logd.reader_fanout",
+                                                  BOOL_DEFAULT_TRUE)) {
+}
+
+bool LogReaderFanOut::join_Locked(LogTimeEntry* entry, bool privileged,
+                                  bool security) {
+    if (!mEnabled) {
+        return false;
+    }
+
+    if (!mStarted) {
+        pthread_attr_t attr;
+        if (pthread_attr_init(&attr)) {
+            return false;
+        }
+        if (!pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED) &&
+            !pthread_create(&mThread, &attr, threadStart, this)) {
+            mStarted = true;
+        }
+        pthread_attr_destroy(&attr);
+        if (!mStarted) {
+            return false;
+        }
+    }
+
+    mMembers.push_back({ entry, privileged, security, false });
+    entry->mFannedOut = true;
+    // Anything logged since the reader's last walk has not triggered us.
+    trigger_Locked();
+    return true;
+}
+
+void LogReaderFanOut::leave_Locked(LogTimeEntry* entry) {
+    auto it = std::find_if(
+        mMembers.begin(), mMembers.end(),
+        [entry](const Member& member) { return member.entry == entry; });
+    if (it == mMembers.end()) {
+        return;
+    }
+    mMembers.erase(it);
+    mWanted.erase(std::remove(mWanted.begin(), mWanted.end(), entry),
+                  mWanted.end());
+
+    entry->mFannedOut = false;
+    pthread_cond_signal(&entry->threadTriggeredCondition);
+}
+
+void LogReaderFanOut::waitIdle_Locked() {
+    while (mInFlight) {
+        pthread_cond_wait(&mIdleCondition, &LogTimeEntry::timesLock);
+    }
+}
+
+void LogReaderFanOut::trigger_Locked() {
+    mTriggered = true;
+    pthread_cond_signal(&mTriggeredCondition);
+}
+
+LogReaderFanOut::Member* LogReaderFanOut::find_Locked(LogTimeEntry* entry) {
+    for (Member& member : mMembers) {
+        if (member.entry == entry) {
+            return &member;
+        }
+    }
+    return nullptr;
+}
+
+bool LogReaderFanOut::alreadySent_Locked(const LogTimeEntry* entry,
+                                         log_time realtime) const {
+    return mBySequence ? (mSequence <= entry->mSequence)
+                       : (realtime < entry->mStart);
+}
+
+void* LogReaderFanOut::threadStart(void* obj) {
+    prctl(PR_SET_NAME, "logd.reader.fan");
+
+    LogReaderFanOut* me = reinterpret_cast<LogReaderFanOut*>(obj);
+
+    LogTimeEntry::wrlock();
+    for (;;) {
+        while (!me->mTriggered || me->mMembers.empty()) {
+            pthread_cond_wait(&me->mTriggeredCondition,
+                              &LogTimeEntry::timesLock);
+        }
+        me->mTriggered = false;
+        me->walk();
+    }
+
+    return nullptr;
+}
+
+// Called and returns with the lock held, which it lets go of for the walk.
+void LogReaderFanOut::walk() {
+    // Start with the member furthest behind, the others skip what they have
+    // been sent already.
+    log_time start;
+    uint64_t sequence = 0;
+    bool first = true;
+    for (Member& member : mMembers) {
+        member.active = true;
+        LogTimeEntry* entry = member.entry;
+        if (first || (entry->mStart < start)) {
+            start = entry->mStart;
+        }
+        if (first || (entry->mSequence < sequence)) {
+            sequence = entry->mSequence;
+        }
+        first = false;
+    }
+    mBySequence = sequence != 0;
+    mSequence = sequence;
+    mLastRealTime = start;
+
+    LogTimeEntry::unlock();
+
+    // mStart is one past the last entry sent, flushTo() wants the entry
+    mLogbuf.flushTo(nullptr, start - log_time(0, 1), nullptr, true, true,
+                    FilterEntry, this, &mSequence, nullptr, SendEntry);
+
+    LogTimeEntry::wrlock();
+
+    // Whoever is left has been through everything there is.
+    for (Member& member : mMembers) {
+        if (!member.active) {
+            continue;
+        }
+        LogTimeEntry* entry = member.entry;
+        if (mBySequence && (entry->mSequence < mSequence)) {
+            entry->mSequence = mSequence;
+        }
+        if (entry->mStart <= mLastRealTime) {
+            entry->mStart = mLastRealTime + log_time(0, 1);
+        }
+    }
+    mWanted.clear();
+    mInFlight = false;
+    pthread_cond_broadcast(&mIdleCondition);
+}
+
+// Everything but what depends on the message, with the buffer lock held
+int LogReaderFanOut::FilterEntry(log_id_t log_id, pid_t pid,
+                                 log_time realtime, uint16_t /*dropped_count*/,
+                                 const char* msg, uint16_t len, void* obj) {
+    LogReaderFanOut* me = reinterpret_cast<LogReaderFanOut*>(obj);
+
+    LogTimeEntry::wrlock();
+
+    // Nothing was sent of the previous entry
+    if (me->mInFlight) {
+        me->mInFlight = false;
+        pthread_cond_broadcast(&me->mIdleCondition);
+    }
+    if (me->mLastRealTime < realtime) {
+        me->mLastRealTime = realtime;
+    }
+
+    me->mWanted.clear();
+    bool active = false;
+    for (const Member& member : me->mMembers) {
+        if (!member.active) {
+            continue;
+        }
+        active = true;
+        LogTimeEntry* entry = member.entry;
+        if (entry->mRelease || !entry->isWatching(log_id) ||
+            (entry->mPid && (entry->mPid != pid)) ||
+            (!me->mBySequence && me->alreadySent_Locked(entry, realtime)) ||
+            (entry->mFilter && !entry->mFilter->tagMatches(log_id, msg, len))) {
+            continue;
+        }
+        me->mWanted.push_back(entry);
+    }
+
+    int ret = active ? !me->mWanted.empty() : -1;
+    me->mInFlight = ret == true;
+
+    LogTimeEntry::unlock();
+
+    return ret;
+}
+
+// The rest of the filtering and sending, without the buffer lock
+bool LogReaderFanOut::SendEntry(const struct logger_entry_v4* entry,
+                                const char* msg, void* obj) {
+    LogReaderFanOut* me = reinterpret_cast<LogReaderFanOut*>(obj);
+    log_time realtime(entry->sec, entry->nsec);
+    std::vector<Target>& targets = me->mTargets;
+
+    targets.clear();
+
+    // No member can go away while the entry is in flight, so the pointers
+    // stay good after we let go of the lock.
+    LogTimeEntry::wrlock();
+    for (LogTimeEntry* reader : me->mWanted) {
+        const Member* member = me->find_Locked(reader);
+        if (!member || me->alreadySent_Locked(reader, realtime) ||
+            (!member->privileged && (entry->uid != reader->mClient->getUid())) ||
+            (!member->security && (entry->lid == LOG_ID_SECURITY))) {
+            continue;
+        }
+        targets.push_back({ reader, reader->mClient, reader->mFilter.get(),
+                            member->privileged, false });
+    }
+    LogTimeEntry::unlock();
+
+    struct logger_entry_v4 hdr = *entry;
+    struct iovec iovec[2];
+    iovec[0].iov_base = &hdr;
+    iovec[1].iov_base = const_cast<char*>(msg);
+    iovec[1].iov_len = entry->len;
+    struct msghdr message = {};
+    message.msg_iov = iovec;
+    message.msg_iovlen = 1 + (entry->len != 0);
+
+    for (Target& target : targets) {
+        if (target.filter &&
+            !target.filter->messageMatches(static_cast<log_id_t>(entry->lid),
+                                           msg, entry->len)) {
+            continue;
+        }
+        hdr.hdr_size = target.privileged ? sizeof(struct logger_entry_v4)
+                                         : sizeof(struct logger_entry_v3);
+        iovec[0].iov_len = hdr.hdr_size;
+        // Never wait for one reader at the expense of the others
+        target.failed =
+            TEMP_FAILURE_RETRY(sendmsg(target.client->getSocket(), &message,
+                                       MSG_DONTWAIT | MSG_NOSIGNAL)) < 0;
+    }
+
+    LogTimeEntry::wrlock();
+    // Readers we could not send to leave before taking the entry as sent,
+    // their threads pick up with it.
+    for (const Target& target : targets) {
+        if (target.failed) {
+            me->leave_Locked(target.entry);
+        }
+    }
+    for (Member& member : me->mMembers) {
+        LogTimeEntry* reader = member.entry;
+        if (!member.active || me->alreadySent_Locked(reader, realtime)) {
+            continue;
+        }
+        if (me->mBySequence) {
+            reader->mSequence = me->mSequence;
+        }
+        if (reader->mStart <= realtime) {
+            reader->mStart = realtime + log_time(0, 1);
+        }
+    }
+    me->mInFlight = false;
+    pthread_cond_broadcast(&me->mIdleCondition);
+    LogTimeEntry::unlock();
+
+    return true;
+}
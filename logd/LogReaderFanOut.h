@@ -0,0 +1,110 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _LOGD_LOG_READER_FAN_OUT_H__
+#define _LOGD_LOG_READER_FAN_OUT_H__
+
+#include <pthread.h>
+#include <stdint.h>
+
+#include <vector>
+
+#include <log/log_id.h>
+#include <log/log_read.h>
+#include <log/log_time.h>
+#include <sysutils/SocketClient.h>
+
+class LogBufferInterface;
+class LogReaderFilter;
+class LogTimeEntry;
+
+// Sends new entries to all readers that have caught up with the buffer in a
+// single walk, instead of one walk per reader thread. Each entry is
+// serialized once and then written to the socket of every reader it passes
+// the filters of.
+//
+// A reader joins once its own thread has sent everything there is, and
+// its thread then sleeps until the group lets go of it again. That happens
+// when it needs to skip ahead for pruning, or as soon as its socket can not
+// take an entry without blocking, so that one slow reader does not hold up
+// the others; its thread then picks up from where the group left it.
+//
+// All state is protected by LogTimeEntry's lock.
+class LogReaderFanOut {
+   public:
+    explicit LogReaderFanOut(LogBufferInterface& logbuf);
+
+    // Returns false if the reader has to carry on by itself.
+    bool join_Locked(LogTimeEntry* entry, bool privileged, bool security);
+    // Wakes the reader's own thread, which then carries on by itself.
+    void leave_Locked(LogTimeEntry* entry);
+    // Waits for the entry being sent, if any, to be done with. A reader
+    // that has left must do so before it may be freed.
+    void waitIdle_Locked();
+    void trigger_Locked();
+
+   private:
+    struct Member {
+        LogTimeEntry* entry;
+        bool privileged;
+        bool security;
+        // Taking part in the current walk, rather than waiting for the next
+        // one to start from where it is.
+        bool active;
+    };
+    // Reader the entry in flight is to be sent to.
+    struct Target {
+        LogTimeEntry* entry;
+        SocketClient* client;
+        const LogReaderFilter* filter;
+        bool privileged;
+        bool failed;
+    };
+
+    Member* find_Locked(LogTimeEntry* entry);
+    bool alreadySent_Locked(const LogTimeEntry* entry, log_time realtime) const;
+    void walk();
+
+    static void* threadStart(void* me);
+    static int FilterEntry(log_id_t log_id, pid_t pid, log_time realtime,
+                           uint16_t dropped_count, const char* msg,
+                           uint16_t len, void* me);
+    static bool SendEntry(const struct logger_entry_v4* entry,
+                          const char* msg, void* me);
+
+    LogBufferInterface& mLogbuf;
+    const bool mEnabled;
+    bool mStarted = false;
+    pthread_t mThread;
+    pthread_cond_t mTriggeredCondition = PTHREAD_COND_INITIALIZER;
+    bool mTriggered = false;
+    // Set from FilterEntry() until SendEntry() is done with the entry.
+    pthread_cond_t mIdleCondition = PTHREAD_COND_INITIALIZER;
+    bool mInFlight = false;
+
+    std::vector<Member> mMembers;
+    // Active members that passed the filter for the entry in flight.
+    std::vector<LogTimeEntry*> mWanted;
+
+    // Position of the walk, resuming by sequence number where the buffer
+    // has those, by time otherwise.
+    bool mBySequence = false;
+    uint64_t mSequence = 0;
+    log_time mLastRealTime;
+    std::vector<Target> mTargets;
+};
+
+#endif  // _LOGD_LOG_READER_FAN_OUT_H__
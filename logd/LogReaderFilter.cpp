@@ -0,0 +1,177 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <ctype.h>
+#include <inttypes.h>
+#include <string.h>
+
+#include <android-base/stringprintf.h>
+#include <pcrecpp.h>
+#include <private/android_logger.h>
+
+#include "LogReaderFilter.h"
+#include "LogUtils.h"
+
+// Bound the work a pathological regex can make us do per message.
+static const int kRegexMatchLimit = 100000;
+
+// Same as filterCharToPri() in liblog's logprint.
+static android_LogPriority priorityFromChar(char c) {
+    c = tolower(c);
+    if ((c >= '0') && (c <= '9')) {
+        if (c >= ('0' + ANDROID_LOG_SILENT)) {
+            return ANDROID_LOG_VERBOSE;
+        }
+        return static_cast<android_LogPriority>(c - '0');
+    }
+    switch (c) {
+        case 'v':
+            return ANDROID_LOG_VERBOSE;
+        case 'd':
+            return ANDROID_LOG_DEBUG;
+        case 'i':
+            return ANDROID_LOG_INFO;
+        case 'w':
+            return ANDROID_LOG_WARN;
+        case 'e':
+            return ANDROID_LOG_ERROR;
+        case 'f':
+            return ANDROID_LOG_FATAL;
+        case 's':
+            return ANDROID_LOG_SILENT;
+        case '*':
+            return ANDROID_LOG_DEFAULT;
+    }
+    return ANDROID_LOG_UNKNOWN;
+}
+
+LogReaderFilter::LogReaderFilter(const char* rules, const char* regex)
+    : mGlobalPriority(ANDROID_LOG_UNKNOWN) {
+    while (rules && *rules) {
+        size_t len = strcspn(rules, ",");
+        std::string rule(rules, len);
+        rules += len;
+        if (*rules == ',') {
+            ++rules;
+        }
+        if (rule.empty()) {
+            continue;
+        }
+
+        // As android_log_addFilterRule()
+        size_t tagLen = rule.find(':');
+        android_LogPriority pri = ANDROID_LOG_DEFAULT;
+        if (tagLen != std::string::npos) {
+            pri = (tagLen + 1 < rule.length())
+                      ? priorityFromChar(rule[tagLen + 1])
+                      : ANDROID_LOG_UNKNOWN;
+            rule.erase(tagLen);
+        }
+        if (rule.empty() || (pri == ANDROID_LOG_UNKNOWN)) {
+            mRules.clear();
+            mGlobalPriority = ANDROID_LOG_UNKNOWN;
+            break;
+        }
+        if (rule == "*") {
+            mGlobalPriority =
+                (pri == ANDROID_LOG_DEFAULT) ? ANDROID_LOG_DEBUG : pri;
+        } else {
+            mRules.emplace_back(std::move(rule), (pri == ANDROID_LOG_DEFAULT)
+                                                     ? ANDROID_LOG_VERBOSE
+                                                     : pri);
+        }
+    }
+
+    if (regex && *regex) {
+        pcrecpp::RE_Options options;
+        options.set_match_limit(kRegexMatchLimit);
+        options.set_match_limit_recursion(kRegexMatchLimit);
+        mRegex.reset(new pcrecpp::RE(regex, options));
+        if (!mRegex->error().empty()) {
+            mRegex.reset();
+        }
+    }
+}
+
+LogReaderFilter::~LogReaderFilter() {
+}
+
+android_LogPriority LogReaderFilter::priorityForTag(const char* tag,
+                                                    size_t len) const {
+    for (auto it = mRules.rbegin(); it != mRules.rend(); ++it) {
+        if ((it->first.length() == len) && !memcmp(it->first.data(), tag, len)) {
+            return (it->second == ANDROID_LOG_DEFAULT) ? mGlobalPriority
+                                                       : it->second;
+        }
+    }
+    return mGlobalPriority;
+}
+
+bool LogReaderFilter::tagMatches(log_id_t log_id, const char* msg,
+                                 uint16_t len) const {
+    if (!filtersTags() || !msg) {
+        return true;
+    }
+
+    if ((log_id == LOG_ID_EVENTS) || (log_id == LOG_ID_STATS) ||
+        (log_id == LOG_ID_SECURITY)) {
+        // Like logcat, go by the tag name, at the priority binary logs have
+        if (len < sizeof(android_event_header_t)) {
+            return true;
+        }
+        uint32_t tag =
+            reinterpret_cast<const android_event_header_t*>(msg)->tag;
+        const char* name = android::tagToName(tag);
+        if (name) {
+            return ANDROID_LOG_INFO >= priorityForTag(name, strlen(name));
+        }
+        std::string number = android::base::StringPrintf("[%" PRIu32 "]", tag);
+        return ANDROID_LOG_INFO >=
+               priorityForTag(number.data(), number.length());
+    }
+
+    // <priority:1><tag:N>\0<message:N>\0
+    if (len < 3) {
+        return true;
+    }
+    const char* tag = msg + 1;
+    const char* end = static_cast<const char*>(memchr(tag, '\0', len - 1));
+    if (!end) {
+        return true;
+    }
+    return msg[0] >= priorityForTag(tag, end - tag);
+}
+
+bool LogReaderFilter::messageMatches(log_id_t log_id, const char* msg,
+                                     uint16_t len) const {
+    if (!mRegex || !msg) {
+        return true;
+    }
+    // Binary logs are only matched by logcat once decoded to text
+    if ((log_id == LOG_ID_EVENTS) || (log_id == LOG_ID_STATS) ||
+        (log_id == LOG_ID_SECURITY) || (len < 3)) {
+        return true;
+    }
+
+    const char* tag = msg + 1;
+    const char* end = static_cast<const char*>(memchr(tag, '\0', len - 1));
+    if (!end) {
+        return true;
+    }
+    const char* message = end + 1;
+    size_t messageLen = strnlen(message, msg + len - message);
+    return mRegex->PartialMatch(pcrecpp::StringPiece(message, messageLen));
+}
@@ -0,0 +1,66 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _LOGD_LOG_READER_FILTER_H__
+#define _LOGD_LOG_READER_FILTER_H__
+
+#include <stdint.h>
+
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <android/log.h>
+#include <log/log_id.h>
+
+namespace pcrecpp {
+class RE;
+}
+
+// The tag:priority rules and message regex of a reader, applied by logd so
+// that entries the reader would throw away are not sent in the first place.
+// The rules have the meaning logcat gives them. The reader filters again, so
+// anything that can not be decided here, such as the regex on binary
+// entries, is let through.
+class LogReaderFilter {
+    // Most recently added rule last
+    std::vector<std::pair<std::string, android_LogPriority>> mRules;
+    android_LogPriority mGlobalPriority;
+    std::unique_ptr<pcrecpp::RE> mRegex;
+
+    android_LogPriority priorityForTag(const char* tag, size_t len) const;
+
+   public:
+    // rules is a comma separated list of tag:priority, either may be null.
+    // Rules that do not parse turn off tag filtering altogether, as does a
+    // regex that does not compile for the message filtering.
+    LogReaderFilter(const char* rules, const char* regex);
+    ~LogReaderFilter();
+
+    bool filtersTags() const {
+        return !mRules.empty() || (mGlobalPriority != ANDROID_LOG_UNKNOWN);
+    }
+    bool filtersMessages() const {
+        return mRegex != nullptr;
+    }
+
+    // Cheap enough to call with the buffer lock held.
+    bool tagMatches(log_id_t log_id, const char* msg, uint16_t len) const;
+    bool messageMatches(log_id_t log_id, const char* msg, uint16_t len) const;
+};
+
+#endif  // _LOGD_LOG_READER_FILTER_H__
@@ -0,0 +1,353 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <errno.h>
+#include <string.h>
+#include <sys/prctl.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+#include <algorithm>
+
+#include <private/android_logger.h>
+
+#include "LogReaderFilter.h"
+#include "LogReaderStream.h"
+#include "LogTimes.h"
+
+// What may pile up unsent, staged for all or queued for a member that has
+// yet to go live, before members are let go to carry on by themselves.
+static constexpr size_t kMaxStaging = 1024 * 1024;
+static constexpr size_t kMaxQueue = 256 * 1024;
+
+LogReaderStream::LogReaderStream() {
+    pthread_condattr_t condattr;
+    pthread_condattr_init(&condattr);
+    pthread_condattr_setclock(&condattr, CLOCK_MONOTONIC);
+    pthread_cond_init(&mCondition, &condattr);
+    pthread_condattr_destroy(&condattr);
+}
+
+void LogReaderStream::stage(log_id_t log_id, log_time realtime, uid_t uid,
+                            pid_t pid, pid_t tid, const char* msg,
+                            uint16_t len) {
+    struct logger_entry_v4 entry = {};
+    entry.len = len;
+    entry.hdr_size = sizeof(entry);
+    entry.pid = pid;
+    entry.tid = tid;
+    entry.sec = realtime.tv_sec;
+    entry.nsec = realtime.tv_nsec;
+    entry.lid = log_id;
+    entry.uid = uid;
+
+    pthread_mutex_lock(&mLock);
+    if ((mStaging.size() + sizeof(entry) + len) > kMaxStaging) {
+        // The thread can not keep up, everyone is better off on their own
+        mOverflow = true;
+    } else {
+        bool wake = mStaging.empty();
+        mStaging.append(reinterpret_cast<const char*>(&entry), sizeof(entry));
+        mStaging.append(msg, len);
+        if (wake) {
+            pthread_cond_signal(&mCondition);
+        }
+    }
+    pthread_mutex_unlock(&mLock);
+}
+
+bool LogReaderStream::join_Locked(LogTimeEntry* entry, bool privileged,
+                                  bool security) {
+    if (!mStarted) {
+        pthread_attr_t attr;
+        if (pthread_attr_init(&attr)) {
+            return false;
+        }
+        if (!pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED) &&
+            !pthread_create(&mThread, &attr, threadStart, this)) {
+            mStarted = true;
+        }
+        pthread_attr_destroy(&attr);
+        if (!mStarted) {
+            return false;
+        }
+    }
+
+    Member member;
+    member.entry = entry;
+    member.client = entry->mClient;
+    member.filter = entry->mFilter.get();
+    member.logMask = entry->mLogMask;
+    member.pid = entry->mPid;
+    member.uid = entry->mClient->getUid();
+    member.privileged = privileged;
+    member.security = security;
+    member.batchEntries = entry->mPushEntries;
+    member.batchDelayUs = entry->mPushDelayUs;
+    // Taken in by the thread on its next round, it may be busy with the
+    // others right now.
+    mJoining.push_back(std::move(member));
+    entry->mStreamed = true;
+    // From now on whatever is added gets queued for the reader.
+    mActive.store(true, std::memory_order_relaxed);
+    return true;
+}
+
+LogReaderStream::Member* LogReaderStream::find_Locked(LogTimeEntry* entry) {
+    for (Member& member : mJoining) {
+        if ((member.entry == entry) && !member.gone) {
+            return &member;
+        }
+    }
+    for (Member& member : mMembers) {
+        if ((member.entry == entry) && !member.gone) {
+            return &member;
+        }
+    }
+    return nullptr;
+}
+
+bool LogReaderStream::live_Locked(LogTimeEntry* entry) {
+    Member* member = find_Locked(entry);
+    if (!member) {
+        return false;
+    }
+    member->goLive = true;
+    member->liveStart = entry->mStart;
+
+    pthread_mutex_lock(&mLock);
+    mTriggered = true;
+    pthread_cond_signal(&mCondition);
+    pthread_mutex_unlock(&mLock);
+    return true;
+}
+
+void LogReaderStream::leave_Locked(LogTimeEntry* entry) {
+    Member* member = find_Locked(entry);
+    if (!member) {
+        return;
+    }
+    // Only dropped by the thread, which may be looking at it right now.
+    member->gone = true;
+
+    entry->mStreamed = false;
+    pthread_cond_signal(&entry->threadTriggeredCondition);
+}
+
+void LogReaderStream::waitIdle_Locked() {
+    while (mInFlight) {
+        pthread_cond_wait(&mIdleCondition, &LogTimeEntry::timesLock);
+    }
+}
+
+void* LogReaderStream::threadStart(void* obj) {
+    prctl(PR_SET_NAME, "logd.reader.push");
+
+    reinterpret_cast<LogReaderStream*>(obj)->run();
+
+    return nullptr;
+}
+
+void LogReaderStream::run() {
+    std::string staging;
+    staging.reserve(kMaxStaging);
+    bool deadlineSet = false;
+    log_time deadline;
+
+    for (;;) {
+        // Wait for entries, or for the next batch to be due
+        pthread_mutex_lock(&mLock);
+        while (mStaging.empty() && !mTriggered) {
+            if (!deadlineSet) {
+                pthread_cond_wait(&mCondition, &mLock);
+                continue;
+            }
+            struct timespec ts = { static_cast<time_t>(deadline.tv_sec),
+                                   static_cast<long>(deadline.tv_nsec) };
+            if (pthread_cond_timedwait(&mCondition, &mLock, &ts) ==
+                ETIMEDOUT) {
+                break;
+            }
+        }
+        mTriggered = false;
+        bool overflow = mOverflow;
+        mOverflow = false;
+        staging.swap(mStaging);
+        pthread_mutex_unlock(&mLock);
+
+        LogTimeEntry::wrlock();
+        mMembers.splice(mMembers.end(), mJoining);
+        for (auto it = mMembers.begin(); it != mMembers.end();) {
+            Member& member = *it;
+            if (member.gone) {
+                it = mMembers.erase(it);
+                continue;
+            }
+            member.failed |= overflow;
+            if (member.goLive) {
+                // Whatever the reader's own pass sent already goes
+                member.goLive = false;
+                member.live = true;
+                std::string queued;
+                queued.swap(member.queue);
+                std::vector<Record> records;
+                records.swap(member.records);
+                for (const Record& record : records) {
+                    if (record.realtime < member.liveStart) {
+                        continue;
+                    }
+                    if (member.records.empty()) {
+                        member.firstQueued = log_time(CLOCK_MONOTONIC);
+                    }
+                    member.records.push_back(
+                        { member.queue.size(), record.size, record.realtime });
+                    member.queue.append(queued, record.offset, record.size);
+                }
+            }
+            ++it;
+        }
+        mActive.store(!mMembers.empty(), std::memory_order_relaxed);
+        mInFlight = true;
+        LogTimeEntry::unlock();
+
+        const char* cp = staging.data();
+        const char* end = cp + staging.size();
+        while (cp < end) {
+            const struct logger_entry_v4* entry =
+                reinterpret_cast<const struct logger_entry_v4*>(cp);
+            const char* msg = cp + entry->hdr_size;
+            cp = msg + entry->len;
+            for (Member& member : mMembers) {
+                if (!member.failed) {
+                    queue(member, entry, msg);
+                }
+            }
+        }
+        staging.clear();
+
+        log_time now(CLOCK_MONOTONIC);
+        deadlineSet = false;
+        for (Member& member : mMembers) {
+            if (member.failed || member.records.empty()) {
+                continue;
+            }
+            log_time due = member.firstQueued +
+                           log_time(member.batchDelayUs / 1000000,
+                                    (member.batchDelayUs % 1000000) * 1000);
+            if (!member.live) {
+                member.failed = member.queue.size() > kMaxQueue;
+                continue;
+            }
+            if ((member.records.size() >= member.batchEntries) ||
+                (due <= now)) {
+                send(member);
+                continue;
+            }
+            if (!deadlineSet || (due < deadline)) {
+                deadline = due;
+                deadlineSet = true;
+            }
+        }
+
+        LogTimeEntry::wrlock();
+        for (Member& member : mMembers) {
+            LogTimeEntry* reader = member.entry;
+            if (member.gone) {
+                continue;
+            }
+            if (member.sent) {
+                member.sent = false;
+                log_time start = member.lastSent + log_time(0, 1);
+                if (reader->mStart < start) {
+                    reader->mStart = start;
+                }
+            }
+            if (member.failed) {
+                // Its own thread picks up from what we sent last.
+                leave_Locked(reader);
+            }
+        }
+        mInFlight = false;
+        pthread_cond_broadcast(&mIdleCondition);
+        LogTimeEntry::unlock();
+    }
+}
+
+// The filters of LogTimeEntry::FilterSecondPass() and FlushCommand that
+// apply to entries as they come in.
+void LogReaderStream::queue(Member& member, const struct logger_entry_v4* entry,
+                            const char* msg) {
+    log_id_t log_id = static_cast<log_id_t>(entry->lid);
+    if (!(member.logMask & (1 << log_id)) ||
+        (member.pid && (member.pid != entry->pid)) ||
+        (!member.privileged && (member.uid != entry->uid)) ||
+        (!member.security && (log_id == LOG_ID_SECURITY))) {
+        return;
+    }
+    if (member.filter &&
+        (!member.filter->tagMatches(log_id, msg, entry->len) ||
+         !member.filter->messageMatches(log_id, msg, entry->len))) {
+        return;
+    }
+
+    struct logger_entry_v4 hdr = *entry;
+    hdr.hdr_size = member.privileged ? sizeof(struct logger_entry_v4)
+                                     : sizeof(struct logger_entry_v3);
+    if (member.records.empty()) {
+        member.firstQueued = log_time(CLOCK_MONOTONIC);
+    }
+    member.records.push_back({ member.queue.size(),
+                               (size_t)hdr.hdr_size + entry->len,
+                               log_time(entry->sec, entry->nsec) });
+    member.queue.append(reinterpret_cast<const char*>(&hdr), hdr.hdr_size);
+    member.queue.append(msg, entry->len);
+}
+
+void LogReaderStream::send(Member& member) {
+    struct mmsghdr messages[kMaxBatchEntries];
+    struct iovec iovecs[kMaxBatchEntries];
+    int sock = member.client->getSocket();
+
+    size_t done = 0;
+    while (done < member.records.size()) {
+        size_t count =
+            std::min(member.records.size() - done, kMaxBatchEntries);
+        memset(messages, 0, sizeof(messages[0]) * count);
+        for (size_t i = 0; i < count; ++i) {
+            const Record& record = member.records[done + i];
+            iovecs[i].iov_base = &member.queue[record.offset];
+            iovecs[i].iov_len = record.size;
+            messages[i].msg_hdr.msg_iov = &iovecs[i];
+            messages[i].msg_hdr.msg_iovlen = 1;
+        }
+        // Never wait for one reader at the expense of the others
+        int ret = TEMP_FAILURE_RETRY(
+            sendmmsg(sock, messages, count, MSG_DONTWAIT | MSG_NOSIGNAL));
+        if (ret <= 0) {
+            member.failed = true;
+            break;
+        }
+        done += ret;
+        member.lastSent = member.records[done - 1].realtime;
+        member.sent = true;
+        if ((size_t)ret < count) {
+            member.failed = true;
+            break;
+        }
+    }
+    member.queue.clear();
+    member.records.clear();
+}
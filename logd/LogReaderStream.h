@@ -0,0 +1,150 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _LOGD_LOG_READER_STREAM_H__
+#define _LOGD_LOG_READER_STREAM_H__
+
+#include <pthread.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#include <atomic>
+#include <list>
+#include <string>
+#include <vector>
+
+#include <log/log_id.h>
+#include <log/log_read.h>
+#include <log/log_time.h>
+#include <sysutils/SocketClient.h>
+
+#include "LogTimes.h"
+
+class LogReaderFilter;
+
+// Pushes entries to the readers that asked for low latency (push= in the
+// reader command) as they are added to the buffer, rather than waking them
+// to walk the buffer for what is new. Adding an entry only copies it to a
+// staging area. A thread of our own then queues it for every member it
+// passes the filters of, and sends a member's queue with one sendmmsg()
+// once it holds the member's batch of entries, or the member's delay after
+// the oldest of them was queued.
+//
+// Members get entries as they were written: identical lines are not folded
+// into chatty summaries for them.
+//
+// A reader joins once its own thread has sent everything there is, makes
+// one more pass of its own for what was added while it joined, and then
+// goes live; what was queued for it meanwhile and is older than where that
+// pass left off is dropped. As for LogReaderFanOut, the member is handed
+// back to its own thread when it needs to skip ahead for pruning, or as soon
+// as its socket can not take a batch without blocking.
+//
+// Members are protected by LogTimeEntry's lock, the staging area by our own.
+class LogReaderStream {
+   public:
+    // Most entries sent in one batch, and most time to wait for a batch to
+    // fill up.
+    static constexpr size_t kMaxBatchEntries = 64;
+    static constexpr uint32_t kMaxBatchDelayUs = 1000000;
+
+    LogReaderStream();
+
+    // Called without any lock once an entry has been added to the buffer.
+    void append(log_id_t log_id, log_time realtime, uid_t uid, pid_t pid,
+                pid_t tid, const char* msg, uint16_t len) {
+        if (mActive.load(std::memory_order_relaxed)) {
+            stage(log_id, realtime, uid, pid, tid, msg, len);
+        }
+    }
+
+    // Returns false if the reader has to carry on by itself.
+    bool join_Locked(LogTimeEntry* entry, bool privileged, bool security);
+    // Once the reader's own pass after join_Locked() left off at its mStart.
+    // Returns false if it was let go of meanwhile.
+    bool live_Locked(LogTimeEntry* entry);
+    // Wakes the reader's own thread, which then carries on by itself.
+    void leave_Locked(LogTimeEntry* entry);
+    // Waits for the batch being sent, if any, to be done with. A reader that
+    // has left must do so before it may be freed.
+    void waitIdle_Locked();
+
+   private:
+    // An entry queued for a member, a record as the member reads it.
+    struct Record {
+        size_t offset;
+        size_t size;
+        log_time realtime;
+    };
+    struct Member {
+        LogTimeEntry* entry;
+        // Copied from the entry, so that we need no lock to look at them.
+        SocketClient* client;
+        const LogReaderFilter* filter;
+        log_mask_t logMask;
+        pid_t pid;
+        uid_t uid;
+        bool privileged;
+        bool security;
+        size_t batchEntries;
+        uint32_t batchDelayUs;
+
+        // Set under the lock, taken over by the thread on its next round.
+        bool goLive = false;
+        log_time liveStart;
+        bool gone = false;
+
+        // Ours alone
+        bool live = false;
+        std::string queue;
+        std::vector<Record> records;
+        log_time firstQueued;  // monotonic
+        bool failed = false;
+        log_time lastSent;
+        bool sent = false;
+    };
+
+    Member* find_Locked(LogTimeEntry* entry);
+    void stage(log_id_t log_id, log_time realtime, uid_t uid, pid_t pid,
+               pid_t tid, const char* msg, uint16_t len);
+
+    static void* threadStart(void* obj);
+    void run();
+    void queue(Member& member, const struct logger_entry_v4* entry,
+               const char* msg);
+    void send(Member& member);
+
+    std::atomic<bool> mActive{false};
+    bool mStarted = false;
+    pthread_t mThread;
+
+    // Protects and signals mStaging, mOverflow and mTriggered
+    pthread_mutex_t mLock = PTHREAD_MUTEX_INITIALIZER;
+    pthread_cond_t mCondition;
+    // logger_entry_v4 headers, each followed by its payload.
+    std::string mStaging;
+    bool mOverflow = false;
+    bool mTriggered = false;
+
+    // Joined since the thread's last round, moved to mMembers on the next.
+    std::list<Member> mJoining;
+    std::list<Member> mMembers;
+    // Set while the thread works on mMembers without the lock.
+    pthread_cond_t mIdleCondition = PTHREAD_COND_INITIALIZER;
+    bool mInFlight = false;
+};
+
+#endif  // _LOGD_LOG_READER_STREAM_H__
@@ -27,6 +27,7 @@
 
 #include <private/android_logger.h>
 
+#include "LogBufferElement.h"
 #include "LogStatistics.h"
 
 static const uint64_t hourSec = 60 * 60;
@@ -79,19 +80,19 @@ char* pidToName(pid_t pid) {
 }
 }
 
-void LogStatistics::addTotal(LogBufferElement* element) {
-    if (element->getDropped()) return;
+void LogStatistics::addTotal(const LogStatisticsElement& element) {
+    if (element.getDropped()) return;
 
-    log_id_t log_id = element->getLogId();
-    uint16_t size = element->getMsgLen();
+    log_id_t log_id = element.getLogId();
+    uint16_t size = element.getMsgLen();
     mSizesTotal[log_id] += size;
     SizesTotal += size;
     ++mElementsTotal[log_id];
 }
 
-void LogStatistics::add(LogBufferElement* element) {
-    log_id_t log_id = element->getLogId();
-    uint16_t size = element->getMsgLen();
+void LogStatistics::add(const LogStatisticsElement& element) {
+    log_id_t log_id = element.getLogId();
+    uint16_t size = element.getMsgLen();
     mSizes[log_id] += size;
     ++mElements[log_id];
 
@@ -100,7 +101,7 @@ void LogStatistics::add(LogBufferElement* element) {
     // evaluated and trimmed, thus recording size and number of
     // elements, but we must recognize the manufactured dropped
     // entry as not contributing to the lifetime totals.
-    if (element->getDropped()) {
+    if (element.getDropped()) {
         ++mDroppedElements[log_id];
     } else {
         mSizesTotal[log_id] += size;
@@ -108,7 +109,7 @@ void LogStatistics::add(LogBufferElement* element) {
         ++mElementsTotal[log_id];
     }
 
-    log_time stamp(element->getRealTime());
+    log_time stamp(element.getRealTime());
     if (mNewest[log_id] < stamp) {
         // A major time update invalidates the statistics :-(
         log_time diff = stamp - mNewest[log_id];
@@ -133,19 +134,19 @@ void LogStatistics::add(LogBufferElement* element) {
         return;
     }
 
-    uidTable[log_id].add(element->getUid(), element);
-    if (element->getUid() == AID_SYSTEM) {
-        pidSystemTable[log_id].add(element->getPid(), element);
+    uidTable[log_id].add(element.getUid(), element);
+    if (element.getUid() == AID_SYSTEM) {
+        pidSystemTable[log_id].add(element.getPid(), element);
     }
 
     if (!enable) {
         return;
     }
 
-    pidTable.add(element->getPid(), element);
-    tidTable.add(element->getTid(), element);
+    pidTable.add(element.getPid(), element);
+    tidTable.add(element.getTid(), element);
 
-    uint32_t tag = element->getTag();
+    uint32_t tag = element.getTag();
     if (tag) {
         if (log_id == LOG_ID_SECURITY) {
             securityTagTable.add(tag, element);
@@ -154,41 +155,41 @@ void LogStatistics::add(LogBufferElement* element) {
         }
     }
 
-    if (!element->getDropped()) {
+    if (!element.getDropped()) {
         tagNameTable.add(TagNameKey(element), element);
     }
 }
 
-void LogStatistics::subtract(LogBufferElement* element) {
-    log_id_t log_id = element->getLogId();
-    uint16_t size = element->getMsgLen();
+void LogStatistics::subtract(const LogStatisticsElement& element) {
+    log_id_t log_id = element.getLogId();
+    uint16_t size = element.getMsgLen();
     mSizes[log_id] -= size;
     --mElements[log_id];
-    if (element->getDropped()) {
+    if (element.getDropped()) {
         --mDroppedElements[log_id];
     }
 
-    if (mOldest[log_id] < element->getRealTime()) {
-        mOldest[log_id] = element->getRealTime();
+    if (mOldest[log_id] < element.getRealTime()) {
+        mOldest[log_id] = element.getRealTime();
     }
 
     if (log_id == LOG_ID_KERNEL) {
         return;
     }
 
-    uidTable[log_id].subtract(element->getUid(), element);
-    if (element->getUid() == AID_SYSTEM) {
-        pidSystemTable[log_id].subtract(element->getPid(), element);
+    uidTable[log_id].subtract(element.getUid(), element);
+    if (element.getUid() == AID_SYSTEM) {
+        pidSystemTable[log_id].subtract(element.getPid(), element);
     }
 
     if (!enable) {
         return;
     }
 
-    pidTable.subtract(element->getPid(), element);
-    tidTable.subtract(element->getTid(), element);
+    pidTable.subtract(element.getPid(), element);
+    tidTable.subtract(element.getTid(), element);
 
-    uint32_t tag = element->getTag();
+    uint32_t tag = element.getTag();
     if (tag) {
         if (log_id == LOG_ID_SECURITY) {
             securityTagTable.subtract(tag, element);
@@ -197,36 +198,36 @@ void LogStatistics::subtract(LogBufferElement* element) {
         }
     }
 
-    if (!element->getDropped()) {
+    if (!element.getDropped()) {
         tagNameTable.subtract(TagNameKey(element), element);
     }
 }
 
 // Atomically set an entry to drop
 // entry->setDropped(1) must follow this call, caller should do this explicitly.
-void LogStatistics::drop(LogBufferElement* element) {
-    log_id_t log_id = element->getLogId();
-    uint16_t size = element->getMsgLen();
+void LogStatistics::drop(const LogStatisticsElement& element) {
+    log_id_t log_id = element.getLogId();
+    uint16_t size = element.getMsgLen();
     mSizes[log_id] -= size;
     ++mDroppedElements[log_id];
 
-    if (mNewestDropped[log_id] < element->getRealTime()) {
-        mNewestDropped[log_id] = element->getRealTime();
+    if (mNewestDropped[log_id] < element.getRealTime()) {
+        mNewestDropped[log_id] = element.getRealTime();
     }
 
-    uidTable[log_id].drop(element->getUid(), element);
-    if (element->getUid() == AID_SYSTEM) {
-        pidSystemTable[log_id].drop(element->getPid(), element);
+    uidTable[log_id].drop(element.getUid(), element);
+    if (element.getUid() == AID_SYSTEM) {
+        pidSystemTable[log_id].drop(element.getPid(), element);
     }
 
     if (!enable) {
         return;
     }
 
-    pidTable.drop(element->getPid(), element);
-    tidTable.drop(element->getTid(), element);
+    pidTable.drop(element.getPid(), element);
+    tidTable.drop(element.getTid(), element);
 
-    uint32_t tag = element->getTag();
+    uint32_t tag = element.getTag();
     if (tag) {
         if (log_id == LOG_ID_SECURITY) {
             securityTagTable.drop(tag, element);
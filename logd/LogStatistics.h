@@ -26,9 +26,13 @@
 
 #include <algorithm>  // std::max
 #include <memory>
+#include <new>
 #include <string>
 #include <string_view>
+#include <tuple>
+#include <type_traits>
 #include <unordered_map>
+#include <utility>
 
 #include <android-base/stringprintf.h>
 #include <android/log.h>
@@ -36,14 +40,144 @@
 #include <private/android_filesystem_config.h>
 #include <utils/FastStrcmp.h>
 
-#include "LogBufferElement.h"
 #include "LogUtils.h"
 
 #define log_id_for_each(i) \
     for (log_id_t i = LOG_ID_MIN; (i) < LOG_ID_MAX; (i) = (log_id_t)((i) + 1))
 
+// The parts of a log entry that LogStatistics accounts for, independent of
+// how the entry is stored by the buffer that holds it.
+class LogStatisticsElement {
+    uid_t mUid;
+    pid_t mPid;
+    pid_t mTid;
+    uint32_t mTag;
+    log_time mRealTime;
+    const char* mMsg;
+    uint16_t mMsgLen;
+    uint16_t mDroppedCount;
+    log_id_t mLogId;
+
+   public:
+    LogStatisticsElement(log_id_t log_id, log_time realtime, uid_t uid,
+                         pid_t pid, pid_t tid, uint32_t tag, const char* msg,
+                         uint16_t len, uint16_t dropped_count = 0)
+        : mUid(uid),
+          mPid(pid),
+          mTid(tid),
+          mTag(tag),
+          mRealTime(realtime),
+          mMsg(msg),
+          mMsgLen(len),
+          mDroppedCount(dropped_count),
+          mLogId(log_id) {
+    }
+
+    bool isBinary(void) const {
+        return (mLogId == LOG_ID_EVENTS) || (mLogId == LOG_ID_SECURITY);
+    }
+    log_id_t getLogId() const {
+        return mLogId;
+    }
+    uid_t getUid(void) const {
+        return mUid;
+    }
+    pid_t getPid(void) const {
+        return mPid;
+    }
+    pid_t getTid(void) const {
+        return mTid;
+    }
+    uint32_t getTag() const {
+        return mTag;
+    }
+    uint16_t getDropped(void) const {
+        return mDroppedCount;
+    }
+    uint16_t getMsgLen() const {
+        return mMsgLen;
+    }
+    const char* getMsg() const {
+        return mMsg;
+    }
+    log_time getRealTime(void) const {
+        return mRealTime;
+    }
+};
+
 class LogStatistics;
 
+// The |len| entries of [begin, end) with the largest sizes, for the tables
+// below.
+template <typename TEntry, typename TIterator>
+std::unique_ptr<const TEntry* []> logTableSort(TIterator begin, TIterator end,
+                                               uid_t uid, pid_t pid,
+                                               size_t len) {
+    if (!len) {
+        std::unique_ptr<const TEntry* []> sorted(nullptr);
+        return sorted;
+    }
+
+    const TEntry** retval = new const TEntry*[len];
+    memset(retval, 0, sizeof(*retval) * len);
+
+    for (TIterator it = begin; it != end; ++it) {
+        const TEntry& entry = it->second;
+
+        if ((uid != AID_ROOT) && (uid != entry.getUid())) {
+            continue;
+        }
+        if (pid && entry.getPid() && (pid != entry.getPid())) {
+            continue;
+        }
+
+        size_t sizes = entry.getSizes();
+        ssize_t index = len - 1;
+        while ((!retval[index] || (sizes > retval[index]->getSizes())) &&
+               (--index >= 0))
+            ;
+        if (++index < (ssize_t)len) {
+            size_t num = len - index - 1;
+            if (num) {
+                memmove(&retval[index + 1], &retval[index],
+                        num * sizeof(retval[0]));
+            }
+            retval[index] = &entry;
+        }
+    }
+    std::unique_ptr<const TEntry* []> sorted(retval);
+    return sorted;
+}
+
+template <typename TTable>
+std::string logTableFormat(const TTable& table, const LogStatistics& stat,
+                           uid_t uid, pid_t pid, const std::string& name,
+                           log_id_t id) {
+    static const size_t maximum_sorted_entries = 32;
+    std::string output;
+    auto sorted = table.sort(uid, pid, maximum_sorted_entries);
+    if (!sorted.get()) {
+        return output;
+    }
+    bool headerPrinted = false;
+    for (size_t index = 0; index < maximum_sorted_entries; ++index) {
+        const auto* entry = sorted[index];
+        if (!entry) {
+            break;
+        }
+        if (entry->getSizes() <= (sorted[0]->getSizes() / 100)) {
+            break;
+        }
+        if (!headerPrinted) {
+            output += "\n\n";
+            output += entry->formatHeader(name, id);
+            headerPrinted = true;
+        }
+        output += entry->format(stat, id);
+    }
+    return output;
+}
+
 template <typename TKey, typename TEntry>
 class LogHashtable {
     std::unordered_map<TKey, TEntry> map;
@@ -81,43 +215,10 @@ class LogHashtable {
 
     std::unique_ptr<const TEntry* []> sort(uid_t uid, pid_t pid,
                                            size_t len) const {
-        if (!len) {
-            std::unique_ptr<const TEntry* []> sorted(nullptr);
-            return sorted;
-        }
-
-        const TEntry** retval = new const TEntry*[len];
-        memset(retval, 0, sizeof(*retval) * len);
-
-        for (const_iterator it = map.begin(); it != map.end(); ++it) {
-            const TEntry& entry = it->second;
-
-            if ((uid != AID_ROOT) && (uid != entry.getUid())) {
-                continue;
-            }
-            if (pid && entry.getPid() && (pid != entry.getPid())) {
-                continue;
-            }
-
-            size_t sizes = entry.getSizes();
-            ssize_t index = len - 1;
-            while ((!retval[index] || (sizes > retval[index]->getSizes())) &&
-                   (--index >= 0))
-                ;
-            if (++index < (ssize_t)len) {
-                size_t num = len - index - 1;
-                if (num) {
-                    memmove(&retval[index + 1], &retval[index],
-                            num * sizeof(retval[0]));
-                }
-                retval[index] = &entry;
-            }
-        }
-        std::unique_ptr<const TEntry* []> sorted(retval);
-        return sorted;
+        return logTableSort<TEntry>(begin(), end(), uid, pid, len);
     }
 
-    inline iterator add(const TKey& key, const LogBufferElement* element) {
+    inline iterator add(const TKey& key, const LogStatisticsElement& element) {
         iterator it = map.find(key);
         if (it == map.end()) {
             it = map.insert(std::make_pair(key, TEntry(element))).first;
@@ -137,21 +238,21 @@ class LogHashtable {
         return it;
     }
 
-    void subtract(TKey&& key, const LogBufferElement* element) {
+    void subtract(TKey&& key, const LogStatisticsElement& element) {
         iterator it = map.find(std::move(key));
         if ((it != map.end()) && it->second.subtract(element)) {
             map.erase(it);
         }
     }
 
-    void subtract(const TKey& key, const LogBufferElement* element) {
+    void subtract(const TKey& key, const LogStatisticsElement& element) {
         iterator it = map.find(key);
         if ((it != map.end()) && it->second.subtract(element)) {
             map.erase(it);
         }
     }
 
-    inline void drop(TKey key, const LogBufferElement* element) {
+    inline void drop(TKey key, const LogStatisticsElement& element) {
         iterator it = map.find(key);
         if (it != map.end()) {
             it->second.drop(element);
@@ -174,30 +275,257 @@ class LogHashtable {
     std::string format(const LogStatistics& stat, uid_t uid, pid_t pid,
                        const std::string& name = std::string(""),
                        log_id_t id = LOG_ID_MAX) const {
-        static const size_t maximum_sorted_entries = 32;
-        std::string output;
-        std::unique_ptr<const TEntry* []> sorted =
-            sort(uid, pid, maximum_sorted_entries);
-        if (!sorted.get()) {
-            return output;
-        }
-        bool headerPrinted = false;
-        for (size_t index = 0; index < maximum_sorted_entries; ++index) {
-            const TEntry* entry = sorted[index];
-            if (!entry) {
-                break;
+        return logTableFormat(*this, stat, uid, pid, name, id);
+    }
+};
+
+// Open addressing replacement for LogHashtable, for the tables keyed by an
+// integer that are updated for every entry added or removed. All slots are
+// allocated up front, so accounting an entry costs a probe through a small
+// array of keys and no allocation. Beyond three quarters full, the table is
+// rehashed into twice the slots; removed entries leave tombstones behind
+// until the next rehash.
+template <typename TKey, typename TEntry, size_t InitialCapacity>
+class LogFlatHashtable {
+    static_assert(std::is_integral<TKey>::value &&
+                      (sizeof(TKey) <= sizeof(uint32_t)),
+                  "keys must be 32 bit integers");
+    static_assert((InitialCapacity >= 4) &&
+                      !(InitialCapacity & (InitialCapacity - 1)),
+                  "capacity must be a power of two");
+
+   public:
+    typedef std::pair<const TKey, TEntry> value_type;
+
+   private:
+    enum : uint8_t { kEmpty, kUsed, kErased };
+    struct Slot {
+        TKey key;
+        uint8_t state;
+    };
+    typedef typename std::aligned_storage<sizeof(value_type),
+                                          alignof(value_type)>::type Storage;
+
+    std::unique_ptr<Slot[]> mSlots;
+    std::unique_ptr<Storage[]> mValues;
+    size_t mCapacity = 0;
+    unsigned mShift = 0;
+    size_t mSize = 0;
+    size_t mErased = 0;
+
+    size_t hash(TKey key) const {
+        // Fibonacci hashing, so that runs of pids spread over the table.
+        return (static_cast<uint32_t>(key) * UINT32_C(2654435769)) >> mShift;
+    }
+    size_t next(size_t index) const {
+        return (index + 1) & (mCapacity - 1);
+    }
+    value_type& valueAt(size_t index) {
+        return *reinterpret_cast<value_type*>(&mValues[index]);
+    }
+    const value_type& valueAt(size_t index) const {
+        return *reinterpret_cast<const value_type*>(&mValues[index]);
+    }
+
+    void allocate(size_t capacity) {
+        mSlots.reset(new Slot[capacity]());
+        mValues.reset(new Storage[capacity]);
+        mCapacity = capacity;
+        mShift = 32;
+        while (capacity > 1) {
+            capacity >>= 1;
+            --mShift;
+        }
+        mSize = 0;
+        mErased = 0;
+    }
+
+    void rehash(size_t capacity) {
+        std::unique_ptr<Slot[]> slots(std::move(mSlots));
+        std::unique_ptr<Storage[]> values(std::move(mValues));
+        size_t oldCapacity = mCapacity;
+        allocate(capacity);
+        for (size_t index = 0; index < oldCapacity; ++index) {
+            if (slots[index].state != kUsed) {
+                continue;
             }
-            if (entry->getSizes() <= (sorted[0]->getSizes() / 100)) {
-                break;
+            value_type& value = *reinterpret_cast<value_type*>(&values[index]);
+            new (&mValues[insertSlot(slots[index].key)])
+                value_type(std::move(value));
+            value.~value_type();
+        }
+    }
+
+    // Index of the slot holding |key|, or mCapacity if there is none. There
+    // is always an empty slot left to end the probe.
+    size_t find(TKey key) const {
+        for (size_t index = hash(key);; index = next(index)) {
+            const Slot& slot = mSlots[index];
+            if (slot.state == kEmpty) {
+                return mCapacity;
             }
-            if (!headerPrinted) {
-                output += "\n\n";
-                output += entry->formatHeader(name, id);
-                headerPrinted = true;
+            if ((slot.state == kUsed) && (slot.key == key)) {
+                return index;
             }
-            output += entry->format(stat, id);
         }
-        return output;
+    }
+
+    // Claims a slot for |key|, which must not be in the table yet, for the
+    // caller to construct the value in.
+    size_t insertSlot(TKey key) {
+        size_t index = hash(key);
+        while (mSlots[index].state == kUsed) {
+            index = next(index);
+        }
+        if (mSlots[index].state == kErased) {
+            --mErased;
+        }
+        mSlots[index].key = key;
+        mSlots[index].state = kUsed;
+        ++mSize;
+        return index;
+    }
+
+    void erase(size_t index) {
+        valueAt(index).~value_type();
+        mSlots[index].state = kErased;
+        --mSize;
+        ++mErased;
+    }
+
+    template <typename... Args>
+    size_t emplace(TKey key, Args&&... args) {
+        if (((mSize + mErased + 1) * 4) > (mCapacity * 3)) {
+            // Only grow if the live entries need it, else just drop the
+            // tombstones.
+            rehash((((mSize + 1) * 2) > mCapacity) ? (mCapacity * 2)
+                                                   : mCapacity);
+        }
+        size_t index = insertSlot(key);
+        new (&mValues[index])
+            value_type(std::piecewise_construct, std::forward_as_tuple(key),
+                       std::forward_as_tuple(std::forward<Args>(args)...));
+        return index;
+    }
+
+    template <typename TTable, typename TValue>
+    class Iterator {
+        friend LogFlatHashtable;
+
+        TTable* mTable;
+        size_t mIndex;
+
+        Iterator(TTable* table, size_t index) : mTable(table), mIndex(index) {
+            skip();
+        }
+        void skip() {
+            while ((mIndex < mTable->mCapacity) &&
+                   (mTable->mSlots[mIndex].state != kUsed)) {
+                ++mIndex;
+            }
+        }
+
+       public:
+        TValue& operator*() const {
+            return mTable->valueAt(mIndex);
+        }
+        TValue* operator->() const {
+            return &mTable->valueAt(mIndex);
+        }
+        Iterator& operator++() {
+            ++mIndex;
+            skip();
+            return *this;
+        }
+        bool operator==(const Iterator& rval) const {
+            return mIndex == rval.mIndex;
+        }
+        bool operator!=(const Iterator& rval) const {
+            return mIndex != rval.mIndex;
+        }
+    };
+
+   public:
+    typedef Iterator<LogFlatHashtable, value_type> iterator;
+    typedef Iterator<const LogFlatHashtable, const value_type> const_iterator;
+
+    LogFlatHashtable() {
+        allocate(InitialCapacity);
+    }
+    ~LogFlatHashtable() {
+        for (size_t index = 0; index < mCapacity; ++index) {
+            if (mSlots[index].state == kUsed) {
+                valueAt(index).~value_type();
+            }
+        }
+    }
+    LogFlatHashtable(const LogFlatHashtable&) = delete;
+    LogFlatHashtable& operator=(const LogFlatHashtable&) = delete;
+
+    size_t size() const {
+        return mSize;
+    }
+
+    size_t sizeOf() const {
+        return sizeof(*this) + mCapacity * (sizeof(Slot) + sizeof(Storage));
+    }
+
+    std::unique_ptr<const TEntry* []> sort(uid_t uid, pid_t pid,
+                                           size_t len) const {
+        return logTableSort<TEntry>(begin(), end(), uid, pid, len);
+    }
+
+    inline iterator add(TKey key, const LogStatisticsElement& element) {
+        size_t index = find(key);
+        if (index == mCapacity) {
+            index = emplace(key, element);
+        } else {
+            valueAt(index).second.add(element);
+        }
+        return iterator(this, index);
+    }
+
+    inline iterator add(TKey key) {
+        size_t index = find(key);
+        if (index == mCapacity) {
+            index = emplace(key, key);
+        } else {
+            valueAt(index).second.add(key);
+        }
+        return iterator(this, index);
+    }
+
+    void subtract(TKey key, const LogStatisticsElement& element) {
+        size_t index = find(key);
+        if ((index != mCapacity) && valueAt(index).second.subtract(element)) {
+            erase(index);
+        }
+    }
+
+    inline void drop(TKey key, const LogStatisticsElement& element) {
+        size_t index = find(key);
+        if (index != mCapacity) {
+            valueAt(index).second.drop(element);
+        }
+    }
+
+    inline iterator begin() {
+        return iterator(this, 0);
+    }
+    inline const_iterator begin() const {
+        return const_iterator(this, 0);
+    }
+    inline iterator end() {
+        return iterator(this, mCapacity);
+    }
+    inline const_iterator end() const {
+        return const_iterator(this, mCapacity);
+    }
+
+    std::string format(const LogStatistics& stat, uid_t uid, pid_t pid,
+                       const std::string& name = std::string(""),
+                       log_id_t id = LOG_ID_MAX) const {
+        return logTableFormat(*this, stat, uid, pid, name, id);
     }
 };
 
@@ -211,19 +539,19 @@ struct EntryBase {
 
     EntryBase() : size(0) {
     }
-    explicit EntryBase(const LogBufferElement* element)
-        : size(element->getMsgLen()) {
+    explicit EntryBase(const LogStatisticsElement& element)
+        : size(element.getMsgLen()) {
     }
 
     size_t getSizes() const {
         return size;
     }
 
-    inline void add(const LogBufferElement* element) {
-        size += element->getMsgLen();
+    inline void add(const LogStatisticsElement& element) {
+        size += element.getMsgLen();
     }
-    inline bool subtract(const LogBufferElement* element) {
-        size -= element->getMsgLen();
+    inline bool subtract(const LogStatisticsElement& element) {
+        size -= element.getMsgLen();
         return !size;
     }
 
@@ -253,23 +581,23 @@ struct EntryBaseDropped : public EntryBase {
 
     EntryBaseDropped() : dropped(0) {
     }
-    explicit EntryBaseDropped(const LogBufferElement* element)
-        : EntryBase(element), dropped(element->getDropped()) {
+    explicit EntryBaseDropped(const LogStatisticsElement& element)
+        : EntryBase(element), dropped(element.getDropped()) {
     }
 
     size_t getDropped() const {
         return dropped;
     }
 
-    inline void add(const LogBufferElement* element) {
-        dropped += element->getDropped();
+    inline void add(const LogStatisticsElement& element) {
+        dropped += element.getDropped();
         EntryBase::add(element);
     }
-    inline bool subtract(const LogBufferElement* element) {
-        dropped -= element->getDropped();
+    inline bool subtract(const LogStatisticsElement& element) {
+        dropped -= element.getDropped();
         return EntryBase::subtract(element) && !dropped;
     }
-    inline void drop(const LogBufferElement* element) {
+    inline void drop(const LogStatisticsElement& element) {
         dropped += 1;
         EntryBase::subtract(element);
     }
@@ -279,10 +607,10 @@ struct UidEntry : public EntryBaseDropped {
     const uid_t uid;
     pid_t pid;
 
-    explicit UidEntry(const LogBufferElement* element)
+    explicit UidEntry(const LogStatisticsElement& element)
         : EntryBaseDropped(element),
-          uid(element->getUid()),
-          pid(element->getPid()) {
+          uid(element.getUid()),
+          pid(element.getPid()) {
     }
 
     inline const uid_t& getKey() const {
@@ -295,8 +623,8 @@ struct UidEntry : public EntryBaseDropped {
         return pid;
     }
 
-    inline void add(const LogBufferElement* element) {
-        if (pid != element->getPid()) {
+    inline void add(const LogStatisticsElement& element) {
+        if (pid != element.getPid()) {
             pid = -1;
         }
         EntryBaseDropped::add(element);
@@ -317,10 +645,10 @@ struct PidEntry : public EntryBaseDropped {
           uid(android::pidToUid(pid)),
           name(android::pidToName(pid)) {
     }
-    explicit PidEntry(const LogBufferElement* element)
+    explicit PidEntry(const LogStatisticsElement& element)
         : EntryBaseDropped(element),
-          pid(element->getPid()),
-          uid(element->getUid()),
+          pid(element.getPid()),
+          uid(element.getUid()),
           name(android::pidToName(pid)) {
     }
     PidEntry(const PidEntry& element)
@@ -329,6 +657,13 @@ struct PidEntry : public EntryBaseDropped {
           uid(element.uid),
           name(element.name ? strdup(element.name) : nullptr) {
     }
+    PidEntry(PidEntry&& element) noexcept
+        : EntryBaseDropped(element),
+          pid(element.pid),
+          uid(element.uid),
+          name(element.name) {
+        element.name = nullptr;
+    }
     ~PidEntry() {
         free(name);
     }
@@ -356,14 +691,14 @@ struct PidEntry : public EntryBaseDropped {
         }
     }
 
-    inline void add(const LogBufferElement* element) {
-        uid_t incomingUid = element->getUid();
+    inline void add(const LogStatisticsElement& element) {
+        uid_t incomingUid = element.getUid();
         if (getUid() != incomingUid) {
             uid = incomingUid;
             free(name);
-            name = android::pidToName(element->getPid());
+            name = android::pidToName(element.getPid());
         } else {
-            add(element->getPid());
+            add(element.getPid());
         }
         EntryBaseDropped::add(element);
     }
@@ -392,11 +727,11 @@ struct TidEntry : public EntryBaseDropped {
           uid(android::pidToUid(tid)),
           name(android::tidToName(tid)) {
     }
-    explicit TidEntry(const LogBufferElement* element)
+    explicit TidEntry(const LogStatisticsElement& element)
         : EntryBaseDropped(element),
-          tid(element->getTid()),
-          pid(element->getPid()),
-          uid(element->getUid()),
+          tid(element.getTid()),
+          pid(element.getPid()),
+          uid(element.getUid()),
           name(android::tidToName(tid)) {
     }
     TidEntry(const TidEntry& element)
@@ -406,6 +741,14 @@ struct TidEntry : public EntryBaseDropped {
           uid(element.uid),
           name(element.name ? strdup(element.name) : nullptr) {
     }
+    TidEntry(TidEntry&& element) noexcept
+        : EntryBaseDropped(element),
+          tid(element.tid),
+          pid(element.pid),
+          uid(element.uid),
+          name(element.name) {
+        element.name = nullptr;
+    }
     ~TidEntry() {
         free(name);
     }
@@ -436,16 +779,16 @@ struct TidEntry : public EntryBaseDropped {
         }
     }
 
-    inline void add(const LogBufferElement* element) {
-        uid_t incomingUid = element->getUid();
-        pid_t incomingPid = element->getPid();
+    inline void add(const LogStatisticsElement& element) {
+        uid_t incomingUid = element.getUid();
+        pid_t incomingPid = element.getPid();
         if ((getUid() != incomingUid) || (getPid() != incomingPid)) {
             uid = incomingUid;
             pid = incomingPid;
             free(name);
-            name = android::tidToName(element->getTid());
+            name = android::tidToName(element.getTid());
         } else {
-            add(element->getTid());
+            add(element.getTid());
         }
         EntryBaseDropped::add(element);
     }
@@ -459,11 +802,11 @@ struct TagEntry : public EntryBaseDropped {
     pid_t pid;
     uid_t uid;
 
-    explicit TagEntry(const LogBufferElement* element)
+    explicit TagEntry(const LogStatisticsElement& element)
         : EntryBaseDropped(element),
-          tag(element->getTag()),
-          pid(element->getPid()),
-          uid(element->getUid()) {
+          tag(element.getTag()),
+          pid(element.getPid()),
+          uid(element.getUid()) {
     }
 
     const uint32_t& getKey() const {
@@ -479,11 +822,11 @@ struct TagEntry : public EntryBaseDropped {
         return android::tagToName(tag);
     }
 
-    inline void add(const LogBufferElement* element) {
-        if (uid != element->getUid()) {
+    inline void add(const LogStatisticsElement& element) {
+        if (uid != element.getUid()) {
             uid = -1;
         }
-        if (pid != element->getPid()) {
+        if (pid != element.getPid()) {
             pid = -1;
         }
         EntryBaseDropped::add(element);
@@ -497,10 +840,10 @@ struct TagNameKey {
     std::string* alloc;
     std::string_view name;  // Saves space if const char*
 
-    explicit TagNameKey(const LogBufferElement* element)
+    explicit TagNameKey(const LogStatisticsElement& element)
         : alloc(nullptr), name("", strlen("")) {
-        if (element->isBinary()) {
-            uint32_t tag = element->getTag();
+        if (element.isBinary()) {
+            uint32_t tag = element.getTag();
             if (tag) {
                 const char* cp = android::tagToName(tag);
                 if (cp) {
@@ -514,13 +857,13 @@ struct TagNameKey {
             name = std::string_view(alloc->c_str(), alloc->size());
             return;
         }
-        const char* msg = element->getMsg();
+        const char* msg = element.getMsg();
         if (!msg) {
             name = std::string_view("chatty", strlen("chatty"));
             return;
         }
         ++msg;
-        uint16_t len = element->getMsgLen();
+        uint16_t len = element.getMsgLen();
         len = (len <= 1) ? 0 : strnlen(msg, len - 1);
         if (!len) {
             name = std::string_view("<NULL>", strlen("<NULL>"));
@@ -586,11 +929,11 @@ struct TagNameEntry : public EntryBase {
     uid_t uid;
     TagNameKey name;
 
-    explicit TagNameEntry(const LogBufferElement* element)
+    explicit TagNameEntry(const LogStatisticsElement& element)
         : EntryBase(element),
-          tid(element->getTid()),
-          pid(element->getPid()),
-          uid(element->getUid()),
+          tid(element.getTid()),
+          pid(element.getPid()),
+          uid(element.getUid()),
           name(element) {
     }
 
@@ -613,14 +956,14 @@ struct TagNameEntry : public EntryBase {
         return name.getAllocLength();
     }
 
-    inline void add(const LogBufferElement* element) {
-        if (uid != element->getUid()) {
+    inline void add(const LogStatisticsElement& element) {
+        if (uid != element.getUid()) {
             uid = -1;
         }
-        if (pid != element->getPid()) {
+        if (pid != element.getPid()) {
             pid = -1;
         }
-        if (tid != element->getTid()) {
+        if (tid != element.getTid()) {
             tid = -1;
         }
         EntryBase::add(element);
@@ -681,27 +1024,28 @@ class LogStatistics {
     bool enable;
 
     // uid to size list
-    typedef LogHashtable<uid_t, UidEntry> uidTable_t;
+    typedef LogFlatHashtable<uid_t, UidEntry, 32> uidTable_t;
     uidTable_t uidTable[LOG_ID_MAX];
 
     // pid of system to size list
-    typedef LogHashtable<pid_t, PidEntry> pidSystemTable_t;
+    typedef LogFlatHashtable<pid_t, PidEntry, 32> pidSystemTable_t;
     pidSystemTable_t pidSystemTable[LOG_ID_MAX];
 
     // pid to uid list
-    typedef LogHashtable<pid_t, PidEntry> pidTable_t;
+    typedef LogFlatHashtable<pid_t, PidEntry, 256> pidTable_t;
     pidTable_t pidTable;
 
     // tid to uid list
-    typedef LogHashtable<pid_t, TidEntry> tidTable_t;
+    typedef LogFlatHashtable<pid_t, TidEntry, 512> tidTable_t;
     tidTable_t tidTable;
 
     // tag list
-    typedef LogHashtable<uint32_t, TagEntry> tagTable_t;
+    typedef LogFlatHashtable<uint32_t, TagEntry, 256> tagTable_t;
     tagTable_t tagTable;
 
     // security tag list
-    tagTable_t securityTagTable;
+    typedef LogFlatHashtable<uint32_t, TagEntry, 32> securityTagTable_t;
+    securityTagTable_t securityTagTable;
 
     // global tag list
     typedef LogHashtable<TagNameKey, TagNameEntry> tagNameTable_t;
@@ -713,15 +1057,17 @@ class LogStatistics {
                       tagNameTable.sizeOf() +
                       (pidTable.size() * sizeof(pidTable_t::iterator)) +
                       (tagTable.size() * sizeof(tagTable_t::iterator));
-        for (auto it : pidTable) {
+        for (const auto& it : pidTable) {
             const char* name = it.second.getName();
             if (name) size += strlen(name) + 1;
         }
-        for (auto it : tidTable) {
+        for (const auto& it : tidTable) {
             const char* name = it.second.getName();
             if (name) size += strlen(name) + 1;
         }
-        for (auto it : tagNameTable) size += it.second.getNameAllocLength();
+        for (const auto& it : tagNameTable) {
+            size += it.second.getNameAllocLength();
+        }
         log_id_for_each(id) {
             size += uidTable[id].sizeOf();
             size += uidTable[id].size() * sizeof(uidTable_t::iterator);
@@ -739,14 +1085,14 @@ class LogStatistics {
         enable = true;
     }
 
-    void addTotal(LogBufferElement* entry);
-    void add(LogBufferElement* entry);
-    void subtract(LogBufferElement* entry);
+    void addTotal(const LogStatisticsElement& entry);
+    void add(const LogStatisticsElement& entry);
+    void subtract(const LogStatisticsElement& entry);
     // entry->setDropped(1) must follow this call
-    void drop(LogBufferElement* entry);
+    void drop(const LogStatisticsElement& entry);
     // Correct for coalescing two entries referencing dropped content
-    void erase(LogBufferElement* element) {
-        log_id_t log_id = element->getLogId();
+    void erase(const LogStatisticsElement& element) {
+        log_id_t log_id = element.getLogId();
         --mElements[log_id];
         --mDroppedElements[log_id];
     }
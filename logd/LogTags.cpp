@@ -35,6 +35,7 @@
 #include <log/log_event_list.h>
 #include <log/log_properties.h>
 #include <private/android_filesystem_config.h>
+#include <private/android_logger.h>
 
 #include "LogTags.h"
 #include "LogUtils.h"
@@ -185,6 +186,43 @@ void LogTags::AddEventLogTags(uint32_t tag, uid_t uid, const std::string& Name,
     }
 }
 
+// Take the system event log tags out of the table compiled from them at
+// build time, if it is still current, rather than parse the text again.
+bool LogTags::ReadCompiledEventLogTags(const char* filename, bool warn) {
+    const android_event_tag_table_t* table =
+        __android_log_map_event_tags(EVENT_TAG_TABLE_FILE, filename);
+    if (!table) return false;
+
+    const char* strings =
+        reinterpret_cast<const char*>(table) + table->strings_offset;
+    size_t avail = table->size - table->strings_offset;
+    const android_event_tag_table_entry_t* entry =
+        reinterpret_cast<const android_event_tag_table_entry_t*>(table + 1);
+    for (uint32_t i = 0; i < table->count; ++i, ++entry) {
+        if ((entry->name_offset >= avail) ||
+            (entry->name_len >= (avail - entry->name_offset)) ||
+            (entry->format_offset >= avail) ||
+            (entry->format_len >= (avail - entry->format_offset))) {
+            break;
+        }
+        AddEventLogTags(entry->tag, AID_ROOT,
+                        std::string(strings + entry->name_offset,
+                                    entry->name_len),
+                        std::string(strings + entry->format_offset,
+                                    entry->format_len),
+                        filename, warn);
+    }
+
+    {
+        android::RWLock::AutoWLock writeLock(rwlock);
+
+        file2watermark[filename] = table->source_size;
+    }
+
+    __android_log_unmap_event_tags(table);
+    return true;
+}
+
 // Read the event log tags file, and build up our internal database
 void LogTags::ReadFileEventLogTags(const char* filename, bool warn) {
     bool etc = !strcmp(filename, system_event_log_tags);
@@ -192,6 +230,8 @@ void LogTags::ReadFileEventLogTags(const char* filename, bool warn) {
 
     if (!etc) {
         RebuildFileEventLogTags(filename, warn);
+    } else if (ReadCompiledEventLogTags(filename, warn)) {
+        return;
     }
     std::string content;
     if (android::base::ReadFileToString(filename, &content)) {
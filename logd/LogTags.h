@@ -98,6 +98,8 @@ class LogTags {
 
     static const uint32_t emptyTag = uint32_t(-1);
 
+    bool ReadCompiledEventLogTags(const char* filename, bool warn);
+
    public:
     static const char system_event_log_tags[];
     static const char dynamic_event_log_tags[];
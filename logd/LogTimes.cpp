@@ -21,15 +21,20 @@
 #include <private/android_logger.h>
 
 #include "FlushCommand.h"
-#include "LogBuffer.h"
+#include "LogBufferElement.h"
+#include "LogBufferInterface.h"
 #include "LogReader.h"
+#include "LogReaderFanOut.h"
+#include "LogReaderStream.h"
 #include "LogTimes.h"
 
 pthread_mutex_t LogTimeEntry::timesLock = PTHREAD_MUTEX_INITIALIZER;
 
 LogTimeEntry::LogTimeEntry(LogReader& reader, SocketClient* client,
                            bool nonBlock, unsigned long tail, log_mask_t logMask,
-                           pid_t pid, log_time start, uint64_t timeout)
+                           pid_t pid, log_time start, uint64_t timeout,
+                           std::unique_ptr<LogReaderFilter> filter,
+                           size_t pushEntries, uint32_t pushDelayUs)
     : leadingDropped(false),
       mReader(reader),
       mLogMask(logMask),
@@ -37,6 +42,9 @@ LogTimeEntry::LogTimeEntry(LogReader& reader, SocketClient* client,
       mCount(0),
       mTail(tail),
       mIndex(0),
+      mFilter(std::move(filter)),
+      mPushEntries(pushEntries),
+      mPushDelayUs(pushDelayUs),
       mClient(client),
       mStart(start),
       mNonBlock(nonBlock),
@@ -72,7 +80,7 @@ void* LogTimeEntry::threadStart(void* obj) {
 
     SocketClient* client = me->mClient;
 
-    LogBuffer& logbuf = me->mReader.logbuf();
+    LogBufferInterface& logbuf = me->mReader.logbuf();
 
     bool privileged = FlushCommand::hasReadLogs(client);
     bool security = FlushCommand::hasSecurityLogs(client);
@@ -98,12 +106,16 @@ void* LogTimeEntry::threadStart(void* obj) {
         unlock();
 
         if (me->mTail) {
+            uint64_t firstPassSequence = me->mSequence;
             logbuf.flushTo(client, start, nullptr, privileged, security,
-                           FilterFirstPass, me);
+                           FilterFirstPass, me, &firstPassSequence);
             me->leadingDropped = true;
         }
-        start = logbuf.flushTo(client, start, me->mLastTid, privileged,
-                               security, FilterSecondPass, me);
+        start = logbuf.flushTo(
+            client, start, me->mLastTid, privileged, security,
+            FilterSecondPass, me, &me->mSequence,
+            (me->mFilter && me->mFilter->filtersMessages()) ? FilterMessage
+                                                            : nullptr);
 
         wrlock();
 
@@ -120,11 +132,43 @@ void* LogTimeEntry::threadStart(void* obj) {
         me->cleanSkip_Locked();
 
         if (!me->mTimeout.tv_sec && !me->mTimeout.tv_nsec) {
-            pthread_cond_wait(&me->threadTriggeredCondition, &timesLock);
+            LogReaderStream& stream = me->mReader.stream();
+            if (me->mStreamed) {
+                // The pass above sent what was added while we joined, the
+                // rest is pushed to us until the stream lets go of us.
+                if (stream.live_Locked(me)) {
+                    while (me->mStreamed && !me->mRelease) {
+                        pthread_cond_wait(&me->threadTriggeredCondition,
+                                          &timesLock);
+                    }
+                }
+                // What was pushed is only known by time
+                me->mSequence = 0;
+                start = me->mStart - log_time(0, 1);
+            } else if (me->mPushEntries && !me->mTail && !me->leadingDropped &&
+                       stream.join_Locked(me, privileged, security)) {
+                continue;
+            } else if (!me->mTail && !me->leadingDropped &&
+                       me->mReader.fanOut().join_Locked(me, privileged,
+                                                        security)) {
+                // Once caught up, leave sending what arrives to the shared
+                // walk until that lets go of us.
+                while (me->mFannedOut && !me->mRelease) {
+                    pthread_cond_wait(&me->threadTriggeredCondition,
+                                      &timesLock);
+                }
+                start = me->mStart - log_time(0, 1);
+            } else {
+                pthread_cond_wait(&me->threadTriggeredCondition, &timesLock);
+            }
         }
     }
 
     LogReader& reader = me->mReader;
+    reader.fanOut().leave_Locked(me);
+    reader.fanOut().waitIdle_Locked();
+    reader.stream().leave_Locked(me);
+    reader.stream().waitIdle_Locked();
     reader.release(client);
 
     client->decRef();
@@ -144,13 +188,15 @@ void* LogTimeEntry::threadStart(void* obj) {
 }
 
 // A first pass to count the number of elements
-int LogTimeEntry::FilterFirstPass(const LogBufferElement* element, void* obj) {
+int LogTimeEntry::FilterFirstPass(log_id_t log_id, pid_t pid, log_time realtime,
+                                  uint16_t dropped_count, const char*, uint16_t,
+                                  void* obj) {
     LogTimeEntry* me = reinterpret_cast<LogTimeEntry*>(obj);
 
     LogTimeEntry::wrlock();
 
     if (me->leadingDropped) {
-        if (element->getDropped()) {
+        if (dropped_count) {
             LogTimeEntry::unlock();
             return false;
         }
@@ -158,11 +204,11 @@ int LogTimeEntry::FilterFirstPass(const LogBufferElement* element, void* obj) {
     }
 
     if (me->mCount == 0) {
-        me->mStart = element->getRealTime();
+        me->mStart = realtime;
     }
 
-    if ((!me->mPid || (me->mPid == element->getPid())) &&
-        (me->isWatching(element->getLogId()))) {
+    if ((!me->mPid || (me->mPid == pid)) &&
+        (me->isWatching(log_id))) {
         ++me->mCount;
     }
 
@@ -172,20 +218,22 @@ int LogTimeEntry::FilterFirstPass(const LogBufferElement* element, void* obj) {
 }
 
 // A second pass to send the selected elements
-int LogTimeEntry::FilterSecondPass(const LogBufferElement* element, void* obj) {
+int LogTimeEntry::FilterSecondPass(log_id_t log_id, pid_t pid,
+                                   log_time realtime, uint16_t dropped_count,
+                                   const char* msg, uint16_t len, void* obj) {
     LogTimeEntry* me = reinterpret_cast<LogTimeEntry*>(obj);
 
     LogTimeEntry::wrlock();
 
-    me->mStart = element->getRealTime();
+    me->mStart = realtime;
 
-    if (me->skipAhead[element->getLogId()]) {
-        me->skipAhead[element->getLogId()]--;
+    if (me->skipAhead[log_id]) {
+        me->skipAhead[log_id]--;
         goto skip;
     }
 
     if (me->leadingDropped) {
-        if (element->getDropped()) {
+        if (dropped_count) {
             goto skip;
         }
         me->leadingDropped = false;
@@ -196,11 +244,11 @@ int LogTimeEntry::FilterSecondPass(const LogBufferElement* element, void* obj) {
         goto stop;
     }
 
-    if (!me->isWatching(element->getLogId())) {
+    if (!me->isWatching(log_id)) {
         goto skip;
     }
 
-    if (me->mPid && (me->mPid != element->getPid())) {
+    if (me->mPid && (me->mPid != pid)) {
         goto skip;
     }
 
@@ -223,7 +271,13 @@ int LogTimeEntry::FilterSecondPass(const LogBufferElement* element, void* obj) {
     }
 
 ok:
-    if (!me->skipAhead[element->getLogId()]) {
+    // After the tail selection, -t counts entries before any filtering
+    // just as when the reader does all of the filtering itself.
+    if (me->mFilter && !me->mFilter->tagMatches(log_id, msg, len)) {
+        goto skip;
+    }
+
+    if (!me->skipAhead[log_id]) {
         LogTimeEntry::unlock();
         return true;
     }
@@ -238,6 +292,31 @@ stop:
     return -1;
 }
 
+// The reader's regex, run without any lock held
+bool LogTimeEntry::FilterMessage(log_id_t log_id, const char* msg,
+                                 uint16_t len, void* obj) {
+    LogTimeEntry* me = reinterpret_cast<LogTimeEntry*>(obj);
+    return me->mFilter->messageMatches(log_id, msg, len);
+}
+
+void LogTimeEntry::triggerReader_Locked(void) {
+    if (mStreamed) {
+        return;  // pushed to as entries are added
+    }
+    if (mFannedOut) {
+        mReader.fanOut().trigger_Locked();
+        return;
+    }
+    pthread_cond_signal(&threadTriggeredCondition);
+}
+
+void LogTimeEntry::triggerSkip_Locked(log_id_t id, unsigned int skip) {
+    // Skipping ahead is up to our own thread
+    mReader.fanOut().leave_Locked(this);
+    mReader.stream().leave_Locked(this);
+    skipAhead[id] = skip;
+}
+
 void LogTimeEntry::cleanSkip_Locked(void) {
     memset(skipAhead, 0, sizeof(skipAhead));
 }
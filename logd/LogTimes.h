@@ -28,12 +28,16 @@
 #include <log/log.h>
 #include <sysutils/SocketClient.h>
 
+#include "LogReaderFilter.h"
+
 typedef unsigned int log_mask_t;
 
 class LogReader;
-class LogBufferElement;
 
 class LogTimeEntry {
+    friend class LogReaderFanOut;
+    friend class LogReaderStream;
+
     static pthread_mutex_t timesLock;
     bool mRelease = false;
     bool leadingDropped;
@@ -48,11 +52,24 @@ class LogTimeEntry {
     unsigned long mCount;
     unsigned long mTail;
     unsigned long mIndex;
+    // Immutable once constructed, so usable without timesLock.
+    const std::unique_ptr<LogReaderFilter> mFilter;
+    // Left to LogReaderFanOut to send to rather than our own thread.
+    bool mFannedOut = false;
+    // Where we left off, for buffers that can resume from there directly.
+    uint64_t mSequence = 0;
+    // Batching asked for by a low latency reader, 0 entries otherwise.
+    const size_t mPushEntries;
+    const uint32_t mPushDelayUs;
+    // Left to LogReaderStream to push to rather than our own thread.
+    bool mStreamed = false;
 
    public:
     LogTimeEntry(LogReader& reader, SocketClient* client, bool nonBlock,
                  unsigned long tail, log_mask_t logMask, pid_t pid,
-                 log_time start, uint64_t timeout);
+                 log_time start, uint64_t timeout,
+                 std::unique_ptr<LogReaderFilter> filter = nullptr,
+                 size_t pushEntries = 0, uint32_t pushDelayUs = 0);
 
     SocketClient* mClient;
     log_time mStart;
@@ -73,13 +90,8 @@ class LogTimeEntry {
 
     bool startReader_Locked();
 
-    void triggerReader_Locked(void) {
-        pthread_cond_signal(&threadTriggeredCondition);
-    }
-
-    void triggerSkip_Locked(log_id_t id, unsigned int skip) {
-        skipAhead[id] = skip;
-    }
+    void triggerReader_Locked(void);
+    void triggerSkip_Locked(log_id_t id, unsigned int skip);
     void cleanSkip_Locked(void);
 
     void release_Locked(void) {
@@ -96,8 +108,14 @@ class LogTimeEntry {
         return mLogMask & logMask;
     }
     // flushTo filter callbacks
-    static int FilterFirstPass(const LogBufferElement* element, void* me);
-    static int FilterSecondPass(const LogBufferElement* element, void* me);
+    static int FilterFirstPass(log_id_t log_id, pid_t pid, log_time realtime,
+                               uint16_t dropped_count, const char* msg,
+                               uint16_t len, void* me);
+    static int FilterSecondPass(log_id_t log_id, pid_t pid, log_time realtime,
+                                uint16_t dropped_count, const char* msg,
+                                uint16_t len, void* me);
+    static bool FilterMessage(log_id_t log_id, const char* msg, uint16_t len,
+                              void* me);
 };
 
 typedef std::list<std::unique_ptr<LogTimeEntry>> LastLogTimes;
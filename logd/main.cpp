@@ -46,6 +46,7 @@
 #include <processgroup/sched_policy.h>
 #include <utils/threads.h>
 
+#include "ChunkedLogBuffer.h"
 #include "CommandListener.h"
 #include "LogAudit.h"
 #include "LogBuffer.h"
@@ -211,7 +212,7 @@ static char* name;
 
 static sem_t reinit;
 static bool reinit_running = false;
-static LogBuffer* logBuf = nullptr;
+static LogBufferInterface* logBuf = nullptr;
 
 static bool package_list_parser_cb(pkg_info* info, void* /* userdata */) {
     bool rc = true;
@@ -370,6 +371,8 @@ static void readDmesg(LogAudit* al, LogKlog* kl) {
             rc = kl->log(tok, sublen);
         }
     }
+    if (al) al->commit();
+    if (kl) kl->commit();
 }
 
 static int issueReinit() {
@@ -476,7 +479,13 @@ int main(int argc, char* argv[]) {
     // LogBuffer is the object which is responsible for holding all
     // log entries.
 
-    logBuf = new LogBuffer(times);
+    char buffer_type[PROPERTY_VALUE_MAX];
+    property_get("ro.logd.buffer_type", buffer_type, "chatty");
+    if (!strcmp(buffer_type, "chunked")) {
+        logBuf = new ChunkedLogBuffer(times);
+    } else {
+        logBuf = new LogBuffer(times);
+    }
 
     signal(SIGHUP, reinit_signal_handler);
 
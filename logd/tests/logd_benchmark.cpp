@@ -0,0 +1,189 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <errno.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include <memory>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+#include <private/android_filesystem_config.h>
+#include <private/android_logger.h>
+#include <sysutils/SocketClient.h>
+
+#include "ChunkedLogBuffer.h"
+#include "LogBuffer.h"
+#include "LogListener.h"
+#include "LogStatistics.h"
+
+static const char message[] = "\4logd_benchmark\0a typical message";
+
+// A cheap and repeatable sequence of keys in [0, range).
+static std::vector<uint32_t> keySequence(size_t range) {
+    std::vector<uint32_t> keys(4096);
+    uint32_t state = 1;
+    for (auto& key : keys) {
+        state = state * 1103515245 + 12345;
+        key = (state >> 8) % range;
+    }
+    return keys;
+}
+
+static LogStatisticsElement uidElement(uid_t uid) {
+    return LogStatisticsElement(LOG_ID_MAIN, log_time(CLOCK_REALTIME), uid,
+                                getpid(), gettid(), 0, message,
+                                sizeof(message));
+}
+
+// Accounting for one entry in a table that already holds its key, the
+// common case for every message logged.
+template <typename TTable>
+static void BM_table_add_subtract(benchmark::State& state) {
+    TTable table;
+    std::vector<LogStatisticsElement> elements;
+    for (uid_t uid = 0; uid < state.range(0); ++uid) {
+        elements.push_back(uidElement(AID_APP + uid));
+        table.add(AID_APP + uid, elements.back());
+    }
+    std::vector<uint32_t> keys = keySequence(state.range(0));
+
+    size_t index = 0;
+    while (state.KeepRunning()) {
+        const LogStatisticsElement& element = elements[keys[index]];
+        table.add(element.getUid(), element);
+        table.subtract(element.getUid(), element);
+        index = (index + 1) % keys.size();
+    }
+}
+
+typedef LogHashtable<uid_t, UidEntry> LogHashtableUid;
+BENCHMARK_TEMPLATE(BM_table_add_subtract, LogHashtableUid)
+    ->Arg(16)
+    ->Arg(256)
+    ->Arg(2048);
+
+typedef LogFlatHashtable<uid_t, UidEntry, 32> LogFlatHashtableUid;
+BENCHMARK_TEMPLATE(BM_table_add_subtract, LogFlatHashtableUid)
+    ->Arg(16)
+    ->Arg(256)
+    ->Arg(2048);
+
+// Everything LogStatistics accounts for per event, over a range of tags. All
+// entries come from our own uid, pid and tid, so that the name lookups in
+// /proc only happen once.
+static void BM_stats_add_subtract(benchmark::State& state) {
+    static const char event[] = "\0\0\0\0\0\0\0\0";
+    LogStatistics stats;
+    stats.enableStatistics();
+    std::vector<LogStatisticsElement> elements;
+    for (uint32_t tag = 0; tag < state.range(0); ++tag) {
+        elements.push_back(LogStatisticsElement(
+            LOG_ID_EVENTS, log_time(CLOCK_REALTIME), getuid(), getpid(),
+            gettid(), 100000 + tag, event, sizeof(event)));
+        stats.add(elements.back());
+    }
+    std::vector<uint32_t> keys = keySequence(state.range(0));
+
+    size_t index = 0;
+    while (state.KeepRunning()) {
+        const LogStatisticsElement& element = elements[keys[index]];
+        stats.add(element);
+        stats.subtract(element);
+        index = (index + 1) % keys.size();
+    }
+}
+BENCHMARK(BM_stats_add_subtract)->Arg(16)->Arg(256);
+
+// Hands LogListener datagrams from a socket of our own, rather than from the
+// logdw socket that the running logd listens on.
+class BenchmarkLogListener : public LogListener {
+   public:
+    explicit BenchmarkLogListener(LogBufferInterface* buf)
+        : LogListener(buf, nullptr) {
+    }
+    bool onDataAvailable(SocketClient* cli) override {
+        return LogListener::onDataAvailable(cli);
+    }
+};
+
+// Appends one main log entry as liblog frames it, to a datagram or a batch.
+static void appendEntry(std::vector<char>* datagram, bool batch) {
+    android_log_header_t header;
+    header.id = LOG_ID_MAIN;
+    header.tid = gettid();
+    header.realtime = log_time(CLOCK_REALTIME);
+    uint16_t len = sizeof(message);
+    const char* begin = reinterpret_cast<const char*>(&header);
+    datagram->insert(datagram->end(), begin, begin + sizeof(header));
+    if (batch) {
+        begin = reinterpret_cast<const char*>(&len);
+        datagram->insert(datagram->end(), begin, begin + sizeof(len));
+    }
+    datagram->insert(datagram->end(), message, message + sizeof(message));
+}
+
+// Messages per second LogListener gets into the buffer, from receiving the
+// datagram to having added every entry, without readers to wake up. Takes
+// the number of entries per datagram, 1 for a plain one, else a batch.
+template <typename TLogBuffer>
+static void BM_listener_ingest(benchmark::State& state) {
+    LastLogTimes times;
+    std::unique_ptr<TLogBuffer> logbuf(new TLogBuffer(&times));
+    BenchmarkLogListener listener(logbuf.get());
+
+    size_t entries = state.range(0);
+    std::vector<char> datagram;
+    if (entries > 1) {
+        android_log_header_t header = {};
+        header.id = LOG_ID_BATCH;
+        const char* begin = reinterpret_cast<const char*>(&header);
+        datagram.insert(datagram.end(), begin, begin + sizeof(header));
+    }
+    for (size_t i = 0; i < entries; ++i) {
+        appendEntry(&datagram, entries > 1);
+    }
+
+    int sv[2];
+    if (socketpair(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0, sv)) {
+        state.SkipWithError(strerror(errno));
+        return;
+    }
+    int on = 1;
+    setsockopt(sv[0], SOL_SOCKET, SO_PASSCRED, &on, sizeof(on));
+    SocketClient client(sv[0], false);
+
+    while (state.KeepRunning()) {
+        if (send(sv[1], datagram.data(), datagram.size(), 0) < 0 ||
+            !listener.onDataAvailable(&client)) {
+            state.SkipWithError("entry not taken");
+            break;
+        }
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations()) *
+                            entries);
+
+    close(sv[1]);
+    close(sv[0]);
+}
+BENCHMARK_TEMPLATE(BM_listener_ingest, LogBuffer)->Arg(1)->Arg(32);
+BENCHMARK_TEMPLATE(BM_listener_ingest, ChunkedLogBuffer)->Arg(1)->Arg(32);
+
+BENCHMARK_MAIN();
@@ -25,7 +25,9 @@
 #include <sys/types.h>
 #include <unistd.h>
 
+#include <algorithm>
 #include <string>
+#include <vector>
 
 #include <android-base/file.h>
 #include <android-base/macros.h>
@@ -885,6 +887,102 @@ TEST(logd, SNDTIMEO) {
 #endif
 }
 
+#ifdef __ANDROID__
+// Median time in ns from writing a line to reading it back, over a reader
+// whose command ends in extra. 0 if not every line came back.
+static uint64_t write_to_read_latency(const char* extra) {
+    static const char tag[] = "logd_latency";
+    static const size_t warmup = 16;
+    static const size_t count = 200;
+
+    // Something for tail=1 to find, so that what follows is all new
+    EXPECT_LT(0, __android_log_buf_write(LOG_ID_MAIN, ANDROID_LOG_INFO, tag,
+                                         "primer"));
+
+    int fd = socket_local_client("logdr", ANDROID_SOCKET_NAMESPACE_RESERVED,
+                                 SOCK_SEQPACKET);
+    if (fd < 0) {
+        return 0;
+    }
+
+    struct sigaction ignore, old_sigaction;
+    memset(&ignore, 0, sizeof(ignore));
+    ignore.sa_handler = caught_signal;
+    sigemptyset(&ignore.sa_mask);
+    sigaction(SIGALRM, &ignore, &old_sigaction);
+    unsigned int old_alarm = alarm(30);
+
+    std::string ask = android::base::StringPrintf(
+        "stream lids=%d pid=%d tail=1%s", LOG_ID_MAIN, getpid(), extra);
+    bool ok = write(fd, ask.c_str(), ask.length() + 1) ==
+              (ssize_t)(ask.length() + 1);
+
+    log_msg msg;
+    ok = ok && (recv(fd, msg.buf, sizeof(msg), 0) > 0);
+
+    std::vector<uint64_t> latencies;
+    for (size_t i = 0; ok && (i < warmup + count); ++i) {
+        std::string line = android::base::StringPrintf("line %zu", i);
+        log_time written(CLOCK_MONOTONIC);
+        ok = __android_log_buf_write(LOG_ID_MAIN, ANDROID_LOG_INFO, tag,
+                                     line.c_str()) > 0;
+        while (ok) {
+            ssize_t ret = recv(fd, msg.buf, sizeof(msg) - 1, 0);
+            if (ret <= 0) {
+                ok = false;
+                break;
+            }
+            msg.buf[ret] = '\0';
+            const char* payload = msg.msg();
+            if ((msg.entry.len < sizeof(tag) + 1) ||
+                strcmp(payload + 1, tag)) {
+                continue;
+            }
+            if (line == (payload + 1 + sizeof(tag))) {
+                break;
+            }
+        }
+        if (ok && (i >= warmup)) {
+            latencies.push_back((log_time(CLOCK_MONOTONIC) - written).nsec());
+        }
+    }
+
+    alarm(old_alarm);
+    sigaction(SIGALRM, &old_sigaction, nullptr);
+    close(fd);
+
+    if (!ok) {
+        return 0;
+    }
+    std::sort(latencies.begin(), latencies.end());
+    return latencies[latencies.size() / 2];
+}
+#endif
+
+// Lines pushed to a push= reader as they are added get to it at least
+// about as fast as to a reader woken up to go and look for them.
+TEST(logd, push_latency) {
+#ifdef __ANDROID__
+    uint64_t woken = write_to_read_latency("");
+    uint64_t pushed = write_to_read_latency(" push=1");
+    uint64_t batched = write_to_read_latency(" push=8,500");
+
+    fprintf(stderr, "median write to read latency: woken %" PRIu64
+                    "us pushed %" PRIu64 "us batched %" PRIu64 "us\n",
+            woken / 1000, pushed / 1000, batched / 1000);
+
+    EXPECT_NE(0U, woken);
+    EXPECT_NE(0U, pushed);
+    EXPECT_NE(0U, batched);
+    // Generous, the comparison is for the record above
+    EXPECT_GT(100 * (NS_PER_SEC / MS_PER_SEC), pushed);
+    // A batch is sent once its oldest line was held back for 500us
+    EXPECT_GT(100 * (NS_PER_SEC / MS_PER_SEC), batched);
+#else
+    GTEST_LOG_(INFO) << "This test does nothing.\n";
+#endif
+}
+
 TEST(logd, getEventTag_list) {
 #ifdef __ANDROID__
     char buffer[256];
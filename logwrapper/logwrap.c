@@ -35,7 +35,15 @@
 #define ARRAY_SIZE(x)   (sizeof(x) / sizeof(*(x)))
 #define MIN(a,b) (((a)<(b))?(a):(b))
 
-static pthread_mutex_t fd_mutex = PTHREAD_MUTEX_INITIALIZER;
+/*
+ * Children run concurrently when called from several threads. SIGINT and
+ * SIGQUIT are process wide though, so they are ignored while any caller that
+ * asked for it has a child running, and restored after the last one.
+ */
+static pthread_mutex_t signal_mutex = PTHREAD_MUTEX_INITIALIZER;
+static int ignore_int_quit_count;
+static struct sigaction saved_intact;
+static struct sigaction saved_quitact;
 
 #define ERROR(fmt, args...)                                                   \
 do {                                                                          \
@@ -478,8 +486,6 @@ int android_fork_execvp_ext(int argc, char* argv[], int *status, bool ignore_int
     pid_t pid;
     int parent_ptty;
     int child_ptty;
-    struct sigaction intact;
-    struct sigaction quitact;
     sigset_t blockset;
     sigset_t oldset;
     int rc = 0;
@@ -487,14 +493,9 @@ int android_fork_execvp_ext(int argc, char* argv[], int *status, bool ignore_int
     LOG_ALWAYS_FATAL_IF(unused_opts != NULL);
     LOG_ALWAYS_FATAL_IF(unused_opts_len != 0);
 
-    rc = pthread_mutex_lock(&fd_mutex);
-    if (rc) {
-        ERROR("failed to lock signal_fd mutex\n");
-        goto err_lock;
-    }
-
-    /* Use ptty instead of socketpair so that STDOUT is not buffered */
-    parent_ptty = TEMP_FAILURE_RETRY(open("/dev/ptmx", O_RDWR));
+    /* Use ptty instead of socketpair so that STDOUT is not buffered. The ends
+     * are close-on-exec so that children of other threads don't keep them. */
+    parent_ptty = TEMP_FAILURE_RETRY(open("/dev/ptmx", O_RDWR | O_CLOEXEC));
     if (parent_ptty < 0) {
         ERROR("Cannot create parent ptty\n");
         rc = -1;
@@ -509,7 +510,7 @@ int android_fork_execvp_ext(int argc, char* argv[], int *status, bool ignore_int
         goto err_ptty;
     }
 
-    child_ptty = TEMP_FAILURE_RETRY(open(child_devname, O_RDWR));
+    child_ptty = TEMP_FAILURE_RETRY(open(child_devname, O_RDWR | O_CLOEXEC));
     if (child_ptty < 0) {
         ERROR("Cannot open child_ptty\n");
         rc = -1;
@@ -521,14 +522,21 @@ int android_fork_execvp_ext(int argc, char* argv[], int *status, bool ignore_int
     sigaddset(&blockset, SIGQUIT);
     pthread_sigmask(SIG_BLOCK, &blockset, &oldset);
 
+    /* Hold the lock across fork() so the child sees consistent dispositions */
+    pthread_mutex_lock(&signal_mutex);
     pid = fork();
     if (pid < 0) {
+        pthread_mutex_unlock(&signal_mutex);
         close(child_ptty);
         ERROR("Failed to fork\n");
         rc = -1;
         goto err_fork;
     } else if (pid == 0) {
-        pthread_mutex_unlock(&fd_mutex);
+        /* Undo the ignoring done for another thread's child */
+        if (ignore_int_quit_count) {
+            sigaction(SIGINT, &saved_intact, NULL);
+            sigaction(SIGQUIT, &saved_quitact, NULL);
+        }
         pthread_sigmask(SIG_SETMASK, &oldset, NULL);
         close(parent_ptty);
 
@@ -538,23 +546,28 @@ int android_fork_execvp_ext(int argc, char* argv[], int *status, bool ignore_int
 
         child(argc, argv);
     } else {
-        close(child_ptty);
-        if (ignore_int_quit) {
+        if (ignore_int_quit && ignore_int_quit_count++ == 0) {
             struct sigaction ignact;
 
             memset(&ignact, 0, sizeof(ignact));
             ignact.sa_handler = SIG_IGN;
-            sigaction(SIGINT, &ignact, &intact);
-            sigaction(SIGQUIT, &ignact, &quitact);
+            sigaction(SIGINT, &ignact, &saved_intact);
+            sigaction(SIGQUIT, &ignact, &saved_quitact);
         }
+        pthread_mutex_unlock(&signal_mutex);
+        close(child_ptty);
 
         rc = parent(argv[0], parent_ptty, pid, status, log_target,
                     abbreviated, file_path);
     }
 
     if (ignore_int_quit) {
-        sigaction(SIGINT, &intact, NULL);
-        sigaction(SIGQUIT, &quitact, NULL);
+        pthread_mutex_lock(&signal_mutex);
+        if (--ignore_int_quit_count == 0) {
+            sigaction(SIGINT, &saved_intact, NULL);
+            sigaction(SIGQUIT, &saved_quitact, NULL);
+        }
+        pthread_mutex_unlock(&signal_mutex);
     }
 err_fork:
     pthread_sigmask(SIG_SETMASK, &oldset, NULL);
@@ -562,7 +575,5 @@ err_child_ptty:
 err_ptty:
     close(parent_ptty);
 err_open:
-    pthread_mutex_unlock(&fd_mutex);
-err_lock:
     return rc;
 }
@@ -54,6 +54,14 @@ struct TrieNodeInternal {
   uint32_t exact_match_entries;
 };
 
+// A slot of the exact match table, which maps the full names of the exact matches of the trie to
+// the indexes that a lookup in the trie returns for them.  name_offset is 0 for empty slots.
+struct ExactMatchTableEntry {
+  uint32_t name_offset;
+  uint32_t context_index;
+  uint32_t type_index;
+};
+
 struct PropertyInfoAreaHeader {
   // The current version of this data as created by property service.
   uint32_t current_version;
@@ -63,6 +71,9 @@ struct PropertyInfoAreaHeader {
   uint32_t contexts_offset;
   uint32_t types_offset;
   uint32_t root_offset;
+  // Since version 2: the offset of a uint32_t count of slots, a power of 2, followed by an open
+  // addressed hash table of ExactMatchTableEntry; 0 if there's no table.  Older parsers ignore it.
+  uint32_t exact_match_table_offset;
 };
 
 class SerializedData {
@@ -171,7 +182,15 @@ class PropertyInfoArea : private SerializedData {
 
   TrieNode root_node() const { return trie(header()->root_offset); }
 
+  uint32_t exact_match_table_offset() const {
+    return current_version() >= 2 ? header()->exact_match_table_offset : 0;
+  }
+
+  // The hash of property names used for the slots of the exact match table.
+  static uint32_t ExactMatchHash(const char* name);
+
  private:
+  bool FindExactMatch(const char* name, uint32_t* context_index, uint32_t* type_index) const;
   void CheckPrefixMatch(const char* remaining_name, const TrieNode& trie_node,
                         uint32_t* context_index, uint32_t* type_index) const;
 
@@ -88,6 +88,41 @@ bool TrieNode::FindChildForString(const char* name, uint32_t namelen, TrieNode*
   return true;
 }
 
+// FNV-1a.
+uint32_t PropertyInfoArea::ExactMatchHash(const char* name) {
+  uint32_t hash = 2166136261u;
+  for (; *name != '\0'; ++name) {
+    hash ^= static_cast<unsigned char>(*name);
+    hash *= 16777619u;
+  }
+  return hash;
+}
+
+// Looks up one of the names the trie has an exact match for, with a single hash probe in most
+// cases.  Returns false for other names, which need the full trie walk.
+bool PropertyInfoArea::FindExactMatch(const char* name, uint32_t* context_index,
+                                      uint32_t* type_index) const {
+  uint32_t table_offset = exact_match_table_offset();
+  if (table_offset == 0) return false;
+
+  uint32_t num_slots = uint32(table_offset);
+  if (num_slots == 0 || num_slots == ~0u) return false;
+  auto slots = reinterpret_cast<const ExactMatchTableEntry*>(data_base() + table_offset +
+                                                             sizeof(uint32_t));
+  uint32_t mask = num_slots - 1;
+  for (uint32_t i = ExactMatchHash(name) & mask, probes = 0; probes < num_slots;
+       i = (i + 1) & mask, ++probes) {
+    const ExactMatchTableEntry& slot = slots[i];
+    if (slot.name_offset == 0) return false;
+    if (!strcmp(c_string(slot.name_offset), name)) {
+      if (context_index != nullptr) *context_index = slot.context_index;
+      if (type_index != nullptr) *type_index = slot.type_index;
+      return true;
+    }
+  }
+  return false;
+}
+
 void PropertyInfoArea::CheckPrefixMatch(const char* remaining_name, const TrieNode& trie_node,
                                         uint32_t* context_index, uint32_t* type_index) const {
   const uint32_t remaining_name_size = strlen(remaining_name);
@@ -109,6 +144,8 @@ void PropertyInfoArea::CheckPrefixMatch(const char* remaining_name, const TrieNo
 
 void PropertyInfoArea::GetPropertyInfoIndexes(const char* name, uint32_t* context_index,
                                               uint32_t* type_index) const {
+  if (FindExactMatch(name, context_index, type_index)) return;
+
   uint32_t return_context_index = ~0u;
   uint32_t return_type_index = ~0u;
   const char* remaining_name = name;
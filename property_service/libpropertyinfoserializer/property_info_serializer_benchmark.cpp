@@ -0,0 +1,89 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "property_info_serializer/property_info_serializer.h"
+
+#include "property_info_parser/property_info_parser.h"
+
+#include <string>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+namespace android {
+namespace properties {
+
+// Property contexts shaped like a device's: prefixes for the main namespaces and a few hundred
+// exact names below them.
+static std::string BuildSerializedTrie(bool with_exact_match_table) {
+  auto property_info = std::vector<PropertyInfoEntry>{
+      {"persist.", "u:object_r:persist_prop:s0", "", false},
+      {"ro.", "u:object_r:ro_prop:s0", "", false},
+      {"sys.", "u:object_r:sys_prop:s0", "", false},
+      {"vendor.", "u:object_r:vendor_prop:s0", "", false},
+  };
+  for (const char* prefix : {"persist.sys.", "ro.boot.", "sys.usb.", "vendor.camera."}) {
+    for (int i = 0; i < 100; ++i) {
+      property_info.emplace_back(prefix + std::string("property_") + std::to_string(i),
+                                 "u:object_r:exact_prop:s0", "string", true);
+    }
+  }
+
+  std::string serialized_trie;
+  std::string error;
+  BuildTrie(property_info, "u:object_r:default_prop:s0", "string", &serialized_trie, &error);
+  if (!with_exact_match_table) {
+    reinterpret_cast<PropertyInfoAreaHeader*>(serialized_trie.data())->exact_match_table_offset =
+        0;
+  }
+  return serialized_trie;
+}
+
+static void LookUp(benchmark::State& state, bool with_exact_match_table, const char* name) {
+  auto serialized_trie = BuildSerializedTrie(with_exact_match_table);
+  auto property_info_area = reinterpret_cast<const PropertyInfoArea*>(serialized_trie.data());
+  while (state.KeepRunning()) {
+    const char* context;
+    const char* type;
+    property_info_area->GetPropertyInfo(name, &context, &type);
+    benchmark::DoNotOptimize(context);
+  }
+}
+
+static void BM_ExactMatch_Trie(benchmark::State& state) {
+  LookUp(state, false, "vendor.camera.property_42");
+}
+BENCHMARK(BM_ExactMatch_Trie);
+
+static void BM_ExactMatch_Table(benchmark::State& state) {
+  LookUp(state, true, "vendor.camera.property_42");
+}
+BENCHMARK(BM_ExactMatch_Table);
+
+static void BM_PrefixMatch_Trie(benchmark::State& state) {
+  LookUp(state, false, "vendor.camera.other_property");
+}
+BENCHMARK(BM_PrefixMatch_Trie);
+
+static void BM_PrefixMatch_Table(benchmark::State& state) {
+  LookUp(state, true, "vendor.camera.other_property");
+}
+BENCHMARK(BM_PrefixMatch_Table);
+
+}  // namespace properties
+}  // namespace android
+
+BENCHMARK_MAIN();
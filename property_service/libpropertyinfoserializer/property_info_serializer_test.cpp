@@ -39,7 +39,7 @@ TEST(propertyinfoserializer, TrieNodeCheck) {
   auto property_info_area = reinterpret_cast<const PropertyInfoArea*>(serialized_trie.data());
 
   // Initial checks for property area.
-  EXPECT_EQ(1U, property_info_area->current_version());
+  EXPECT_EQ(2U, property_info_area->current_version());
   EXPECT_EQ(1U, property_info_area->minimum_supported_version());
 
   // Check the root node
@@ -885,5 +885,65 @@ TEST(propertyinfoserializer, GetPropertyInfo_empty_context_and_type) {
   EXPECT_STREQ("5th", type);
 }
 
+TEST(propertyinfoserializer, ExactMatchTable) {
+  auto property_info = std::vector<PropertyInfoEntry>{
+      {"persist.", "1st", "", false},
+      {"persist.exact_match", "", "", true},
+      {"persist.exact_match2", "2nd", "int", true},
+      {"persist.sys.", "3rd", "", false},
+      {"persist.sys.exact", "4th", "", true},
+      {"ro.", "5th", "bool", false},
+      {"ro.a.b.c.d", "6th", "", true},
+      {"ro.a.b.c.", "7th", "", false},
+      {"top", "8th", "", true},
+  };
+  for (int i = 0; i < 100; ++i) {
+    property_info.emplace_back("vendor.exact." + std::to_string(i), "9th", "", true);
+  }
+
+  auto serialized_trie = std::string();
+  auto build_trie_error = std::string();
+  ASSERT_TRUE(BuildTrie(property_info, "default", "default", &serialized_trie, &build_trie_error))
+      << build_trie_error;
+  auto property_info_area = reinterpret_cast<const PropertyInfoArea*>(serialized_trie.data());
+  ASSERT_NE(0U, property_info_area->exact_match_table_offset());
+
+  // The same data without the table, which makes every lookup walk the trie.
+  auto trie_only = serialized_trie;
+  reinterpret_cast<PropertyInfoAreaHeader*>(trie_only.data())->exact_match_table_offset = 0;
+  auto trie_only_area = reinterpret_cast<const PropertyInfoArea*>(trie_only.data());
+
+  auto names = std::vector<std::string>{
+      "persist.exact_match", "persist.exact_match2", "persist.exact_match3", "persist.sys.exact",
+      "persist.sys.exactly", "ro.a.b.c.d",          "ro.a.b.c.e",           "ro.a.b.c",
+      "top",                 "top.level",           "persist",              "",
+  };
+  for (int i = 0; i < 110; ++i) {
+    names.emplace_back("vendor.exact." + std::to_string(i));
+  }
+  for (const auto& name : names) {
+    uint32_t context_index;
+    uint32_t type_index;
+    property_info_area->GetPropertyInfoIndexes(name.c_str(), &context_index, &type_index);
+    uint32_t trie_context_index;
+    uint32_t trie_type_index;
+    trie_only_area->GetPropertyInfoIndexes(name.c_str(), &trie_context_index, &trie_type_index);
+    EXPECT_EQ(trie_context_index, context_index) << name;
+    EXPECT_EQ(trie_type_index, type_index) << name;
+  }
+
+  const char* context;
+  const char* type;
+  property_info_area->GetPropertyInfo("persist.exact_match", &context, &type);
+  EXPECT_STREQ("1st", context);
+  EXPECT_STREQ("default", type);
+  property_info_area->GetPropertyInfo("persist.exact_match2", &context, &type);
+  EXPECT_STREQ("2nd", context);
+  EXPECT_STREQ("int", type);
+  property_info_area->GetPropertyInfo("ro.a.b.c.d", &context, &type);
+  EXPECT_STREQ("6th", context);
+  EXPECT_STREQ("bool", type);
+}
+
 }  // namespace properties
 }  // namespace android
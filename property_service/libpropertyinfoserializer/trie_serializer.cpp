@@ -16,6 +16,8 @@
 
 #include "trie_serializer.h"
 
+#include <string.h>
+
 namespace android {
 namespace properties {
 
@@ -55,7 +57,8 @@ uint32_t TrieSerializer::WritePropertyEntry(const PropertyEntryBuilder& property
   return offset;
 }
 
-uint32_t TrieSerializer::WriteTrieNode(const TrieBuilderNode& builder_node) {
+uint32_t TrieSerializer::WriteTrieNode(const TrieBuilderNode& builder_node,
+                                       const std::string& prefix) {
   uint32_t trie_offset;
   auto trie = arena_->AllocateObject<TrieNodeInternal>(&trie_offset);
 
@@ -92,6 +95,8 @@ uint32_t TrieSerializer::WriteTrieNode(const TrieBuilderNode& builder_node) {
   for (unsigned int i = 0; i < sorted_exact_matches.size(); ++i) {
     uint32_t property_entry_offset = WritePropertyEntry(sorted_exact_matches[i]);
     arena_->uint32_array(exact_match_entries_array_offset)[i] = property_entry_offset;
+    uint32_t name_offset = arena_->AllocateAndWriteString(prefix + sorted_exact_matches[i].name);
+    exact_match_names_.emplace_back(prefix + sorted_exact_matches[i].name, name_offset);
   }
 
   // Write children
@@ -104,18 +109,44 @@ uint32_t TrieSerializer::WriteTrieNode(const TrieBuilderNode& builder_node) {
   trie->child_nodes = children_offset_array_offset;
 
   for (unsigned int i = 0; i < sorted_children.size(); ++i) {
-    arena_->uint32_array(children_offset_array_offset)[i] = WriteTrieNode(sorted_children[i]);
+    arena_->uint32_array(children_offset_array_offset)[i] =
+        WriteTrieNode(sorted_children[i], prefix + sorted_children[i].name() + ".");
   }
   return trie_offset;
 }
 
+// The table holds what a walk of the finished trie returns for each name, so that using it can't
+// change the result of any lookup.  It is kept at most half full.
+uint32_t TrieSerializer::WriteExactMatchTable() {
+  uint32_t num_slots = 1;
+  while (num_slots < exact_match_names_.size() * 2) num_slots *= 2;
+
+  std::vector<ExactMatchTableEntry> slots(num_slots, ExactMatchTableEntry{0, ~0u, ~0u});
+  for (const auto& [name, name_offset] : exact_match_names_) {
+    uint32_t context_index;
+    uint32_t type_index;
+    serialized_info()->GetPropertyInfoIndexes(name.c_str(), &context_index, &type_index);
+
+    uint32_t i = PropertyInfoArea::ExactMatchHash(name.c_str()) & (num_slots - 1);
+    while (slots[i].name_offset != 0) i = (i + 1) & (num_slots - 1);
+    slots[i] = {name_offset, context_index, type_index};
+  }
+
+  uint32_t table_offset = arena_->AllocateUint32Array(1 + num_slots * 3);
+  arena_->uint32_array(table_offset)[0] = num_slots;
+  memcpy(arena_->uint32_array(table_offset) + 1, slots.data(),
+         slots.size() * sizeof(ExactMatchTableEntry));
+  return table_offset;
+}
+
 TrieSerializer::TrieSerializer() {}
 
 std::string TrieSerializer::SerializeTrie(const TrieBuilder& trie_builder) {
   arena_.reset(new TrieNodeArena());
+  exact_match_names_.clear();
 
   auto header = arena_->AllocateObject<PropertyInfoAreaHeader>(nullptr);
-  header->current_version = 1;
+  header->current_version = 2;
   header->minimum_supported_version = 1;
 
   // Store where we're about to write the contexts.
@@ -129,9 +160,14 @@ std::string TrieSerializer::SerializeTrie(const TrieBuilder& trie_builder) {
   // We need to store size() up to this point now for Find*Offset() to work.
   header->size = arena_->size();
 
-  uint32_t root_trie_offset = WriteTrieNode(trie_builder.builder_root());
+  uint32_t root_trie_offset = WriteTrieNode(trie_builder.builder_root(), "");
   header->root_offset = root_trie_offset;
 
+  // The trie has to be complete and within size() for WriteExactMatchTable() to look up names.
+  header->exact_match_table_offset = 0;
+  header->size = arena_->size();
+  header->exact_match_table_offset = WriteExactMatchTable();
+
   // Record the real size now that we've written everything
   header->size = arena_->size();
 
@@ -38,15 +38,21 @@ class TrieSerializer {
   void SerializeStrings(const std::set<std::string>& strings);
   uint32_t WritePropertyEntry(const PropertyEntryBuilder& property_entry);
 
-  // Writes a new TrieNode to arena, and recursively writes its children.
+  // Writes a new TrieNode to arena, and recursively writes its children.  'prefix' is the name of
+  // the node including its parents and a trailing '.', and is empty for the root.
   // Returns the offset within arena.
-  uint32_t WriteTrieNode(const TrieBuilderNode& builder_node);
+  uint32_t WriteTrieNode(const TrieBuilderNode& builder_node, const std::string& prefix);
+
+  // Writes the exact match table for exact_match_names_, and returns its offset within arena.
+  uint32_t WriteExactMatchTable();
 
   const PropertyInfoArea* serialized_info() const {
     return reinterpret_cast<const PropertyInfoArea*>(arena_->data().data());
   }
 
   std::unique_ptr<TrieNodeArena> arena_;
+  // The full names of the exact matches written so far, with the offsets of those names.
+  std::vector<std::pair<std::string, uint32_t>> exact_match_names_;
 };
 
 }  // namespace properties
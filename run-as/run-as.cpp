@@ -60,16 +60,6 @@
 //  - Run the 'gdbserver' binary executable to allow native debugging
 //
 
-static bool packagelist_parse_callback(pkg_info* this_package, void* userdata) {
-  pkg_info* p = reinterpret_cast<pkg_info*>(userdata);
-  if (strcmp(p->name, this_package->name) == 0) {
-    *p = *this_package;
-    return false; // Stop searching.
-  }
-  packagelist_free(this_package);
-  return true; // Keep searching.
-}
-
 static bool check_directory(const char* path, uid_t uid) {
   struct stat st;
   if (TEMP_FAILURE_RETRY(lstat(path, &st)) == -1) return false;
@@ -186,8 +176,15 @@ int main(int argc, char* argv[]) {
   pkg_info info;
   memset(&info, 0, sizeof(info));
   info.name = pkgname;
-  if (!packagelist_parse(packagelist_parse_callback, &info)) {
-    error(1, errno, "packagelist_parse failed");
+  packagelist_index* index = packagelist_index_open();
+  if (index == nullptr) {
+    error(1, errno, "packagelist_index_open failed");
+  }
+  // The strings of |found| are kept for the lifetime of the process.
+  pkg_info* found = packagelist_index_find_name(index, pkgname);
+  packagelist_index_close(index);
+  if (found != nullptr) {
+    info = *found;
   }
 
   // Handle a multi-user data path
@@ -81,6 +81,7 @@ class storaged_t : public android::hardware::health::V2_0::IHealthInfoCallback,
     time_t mTimer;
     storaged_config mConfig;
     unique_ptr<disk_stats_monitor> mDsm;
+    disk_latency_monitor mDlm;
     uid_monitor mUidm;
     time_t mStarttime;
     sp<android::hardware::health::V2_0::IHealth> health;
@@ -120,6 +121,8 @@ class storaged_t : public android::hardware::health::V2_0::IHealthInfoCallback,
 
     uint32_t get_recent_perf(void) { return storage_info->get_recent_perf(); }
 
+    string get_disk_latency(void) { return mDlm.dump(); }
+
     map<uint64_t, struct uid_records> get_uid_records(
             double hours, uint64_t threshold, bool force_report) {
         return mUidm.dump(hours, threshold, force_report);
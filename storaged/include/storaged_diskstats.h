@@ -19,6 +19,10 @@
 
 #include <stdint.h>
 
+#include <map>
+#include <mutex>
+#include <string>
+
 #include <android/hardware/health/2.0/IHealth.h>
 
 // number of attributes diskstats has
@@ -26,6 +30,7 @@
 
 #define MMC_DISK_STATS_PATH "/sys/block/mmcblk0/stat"
 #define SDA_DISK_STATS_PATH "/sys/block/sda/stat"
+#define PROC_DISK_STATS_PATH "/proc/diskstats"
 
 struct disk_stats {
     /* It will be extremely unlikely for any of the following entries to overflow.
@@ -196,4 +201,58 @@ public:
   void publish(void);
 };
 
+// Histogram of I/O latency, built from diskstats deltas: the I/Os completed over
+// an interval are all counted in the bucket of their mean latency over it.
+class latency_histogram {
+public:
+    // Bucket i holds latencies under 2^i ms, the last one everything slower.
+    static const int NUM_BUCKETS = 11;
+
+    latency_histogram() : mBuckets(), mIos(0), mTicks(0) {}
+    void add(uint64_t ios, uint64_t ticks);
+    void add(const latency_histogram& other);
+    void reset() { *this = latency_histogram(); }
+    uint64_t ios() const { return mIos; }
+    uint64_t bucket(int i) const { return mBuckets[i]; }
+    double get_mean() const { return mIos ? (double)mTicks / mIos : 0; }
+    std::string to_string() const;
+
+private:
+    uint64_t mBuckets[NUM_BUCKETS];
+    uint64_t mIos;
+    uint64_t mTicks;  // ms
+};
+
+// Read and write latency histograms of each block device in /proc/diskstats.
+// A device regressed when the mean latency of the period that publish() ends
+// is over mFactor times that of the device's history since storaged started.
+class disk_latency_monitor {
+private:
+    FRIEND_TEST(storaged_test, disk_latency_monitor);
+    enum { LAT_READ, LAT_WRITE, LAT_TYPES };
+    struct device_latency {
+        bool valid = false;
+        uint64_t ios[LAT_TYPES];            // last diskstats reading
+        uint64_t ticks[LAT_TYPES];
+        latency_histogram period[LAT_TYPES];   // reset after publish
+        latency_histogram history[LAT_TYPES];  // all past periods
+        bool regressed[LAT_TYPES] = {};
+    };
+    std::mutex mLock;
+    std::map<std::string, device_latency> mDevices;
+    const double mFactor;
+    const uint64_t mMinIos;         // to tell anything from a period or history
+    const bool mWholeDisksOnly;     // skip partitions, going by /sys/block
+
+    void update_locked(const std::string& diskstats);
+
+public:
+    disk_latency_monitor(double factor = 2.0, uint64_t min_ios = 1000,
+                         bool whole_disks_only = true)
+        : mFactor(factor), mMinIos(min_ios), mWholeDisksOnly(whole_disks_only) {}
+    void update(void);
+    void publish(void);
+    std::string dump(void);
+};
+
 #endif /* _STORAGED_DISKSTATS_H_ */
@@ -21,6 +21,7 @@
 
 #include <string>
 #include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
 #include <cutils/multiuser.h>
@@ -37,9 +38,19 @@ using namespace storaged_proto;
 using namespace android;
 using namespace android::os::storaged;
 
+/*
+ * The system user is the initial user that is implicitly created on first boot
+ * and hosts most of the system services. Keep this in sync with
+ * frameworks/base/core/java/android/os/UserManager.java
+ */
+constexpr int USER_SYSTEM = 0;
+
 class uid_info : public UidInfo {
 public:
-    bool parse_uid_io_stats(string&& s);
+    // Parses a uid line of /proc/uid_io/stats in [s, end).
+    bool parse_uid_io_stats(const char* s, const char* end);
+    // set while reading /proc/uid_io/stats, for dropping uids that are gone
+    bool seen = false;
 };
 
 class io_usage {
@@ -80,13 +91,22 @@ class uid_monitor {
 private:
     FRIEND_TEST(storaged_test, uid_monitor);
     FRIEND_TEST(storaged_test, load_uid_io_proto);
+    FRIEND_TEST(storaged_test, update_changed_protos);
 
     // last dump from /proc/uid_io/stats, uid -> uid_info
     unordered_map<uint32_t, uid_info> last_uid_io_stats_;
+    // the dump before last, refilled by the next read and then swapped with
+    // last_uid_io_stats_, so that periodic reads reuse its entries
+    unordered_map<uint32_t, uid_info> next_uid_io_stats_;
+    // reused buffer for the contents of /proc/uid_io/stats
+    string uid_io_buffer_;
     // current io usage for next report, app name -> uid_io_usage
     unordered_map<string, uid_io_usage> curr_io_stats_;
     // io usage records, end timestamp -> {start timestamp, vector of records}
     map<uint64_t, uid_records> io_history_;
+    // users whose part of io_history changed since it was last written to
+    // protobuf; the system user is written every time for perf history
+    unordered_set<userid_t> changed_users_;
     // charger ON/OFF
     charger_stat_t charger_stat_;
     // protects curr_io_stats, last_uid_io_stats, records and charger_stat
@@ -96,14 +116,18 @@ private:
     // true if UID_IO_STATS_PATH is accessible
     const bool enabled_;
 
-    // reads from /proc/uid_io/stats
-    unordered_map<uint32_t, uid_info> get_uid_io_stats_locked();
+    // reads from /proc/uid_io/stats into uid_io_stats, updating entries in
+    // place and removing uids that no longer exist
+    bool read_uid_io_stats_locked(unordered_map<uint32_t, uid_info>* uid_io_stats);
     // flushes curr_io_stats to records
     void add_records_locked(uint64_t curr_ts);
     // updates curr_io_stats and set last_uid_io_stats
     void update_curr_io_stats_locked();
-    // writes io_history to protobuf
-    void update_uid_io_proto(unordered_map<int, StoragedProto>* protos);
+    // writes the changed users' io_history to protobuf
+    void update_protos_locked(unordered_map<int, StoragedProto>* protos);
+    // writes io_history to protobuf, only for |users| if it is not null
+    void update_uid_io_proto(unordered_map<int, StoragedProto>* protos,
+                             const unordered_set<userid_t>* users = nullptr);
 
     // Ensure that io_history_ can append |n| items without exceeding
     // MAX_UID_RECORDS_SIZE in size.
@@ -123,6 +147,9 @@ public:
     // called by storaged periodic_chore or dump with force_report
     bool enabled() { return enabled_; };
     void report(unordered_map<int, StoragedProto>* protos);
+    // writes the io_history of users whose records changed since the last
+    // call, plus the system user, to protobuf
+    void update_changed_protos(unordered_map<int, StoragedProto>* protos);
     // restores io_history from protobuf
     void load_uid_io_proto(userid_t user_id, const UidIOUsage& proto);
     void clear_user_history(userid_t user_id);
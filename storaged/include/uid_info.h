@@ -56,7 +56,8 @@ public:
     std::string comm;
     pid_t pid;
     io_stats io[UID_STATS];
-    bool parse_task_io_stats(std::string&& s);
+    // Parses a "task,..." line of /proc/uid_io/stats in [s, end).
+    bool parse_task_io_stats(const char* s, const char* end);
 };
 
 class UidInfo : public Parcelable {
@@ -49,13 +49,6 @@ using namespace storaged_proto;
 
 namespace {
 
-/*
- * The system user is the initial user that is implicitly created on first boot
- * and hosts most of the system services. Keep this in sync with
- * frameworks/base/core/java/android/os/UserManager.java
- */
-constexpr int USER_SYSTEM = 0;
-
 constexpr ssize_t benchmark_unit_size = 16 * 1024;  // 16KB
 
 constexpr ssize_t min_benchmark_size = 128 * 1024;  // 128KB
@@ -319,15 +312,24 @@ void storaged_t::event(void) {
         }
     }
 
+    mDlm.update();
+    if (!(mTimer % mConfig.periodic_chores_interval_disk_stats_publish)) {
+        mDlm.publish();
+    }
+
+    // Protos are only built on the ticks that write them out.
+    bool flush = !(mTimer % mConfig.periodic_chores_interval_flush_proto);
     if (!(mTimer % mConfig.periodic_chores_interval_uid_io)) {
-        mUidm.report(&protos);
+        mUidm.report(flush ? &protos : nullptr);
+    } else if (flush) {
+        mUidm.update_changed_protos(&protos);
     }
 
     if (storage_info) {
         storage_info->refresh(protos[USER_SYSTEM].mutable_perf_history());
     }
 
-    if (!(mTimer % mConfig.periodic_chores_interval_flush_proto)) {
+    if (flush) {
         flush_protos(&protos);
     }
 
@@ -16,13 +16,17 @@
 
 #define LOG_TAG "storaged"
 
+#include <inttypes.h>
 #include <stdint.h>
 #include <stdlib.h>
+#include <unistd.h>
 
 #include <sstream>
 
 #include <android-base/file.h>
 #include <android-base/logging.h>
+#include <android-base/stringprintf.h>
+#include <android-base/strings.h>
 #include <log/log_event_list.h>
 
 #include "storaged.h"
@@ -328,3 +332,130 @@ void disk_stats_monitor::publish(void)
     // Reset global structures
     memset(&mAccumulate_pub, 0, sizeof(struct disk_stats));
 }
+
+/* latency_histogram */
+void latency_histogram::add(uint64_t ios, uint64_t ticks)
+{
+    if (ios == 0) return;
+
+    uint64_t mean = ticks / ios;
+    int i = 0;
+    while (i < NUM_BUCKETS - 1 && mean >= (1ULL << i)) {
+        ++i;
+    }
+    mBuckets[i] += ios;
+    mIos += ios;
+    mTicks += ticks;
+}
+
+void latency_histogram::add(const latency_histogram& other)
+{
+    for (int i = 0; i < NUM_BUCKETS; ++i) {
+        mBuckets[i] += other.mBuckets[i];
+    }
+    mIos += other.mIos;
+    mTicks += other.mTicks;
+}
+
+std::string latency_histogram::to_string() const
+{
+    std::string buckets;
+    for (int i = 0; i < NUM_BUCKETS; ++i) {
+        buckets += (i ? "," : "") + std::to_string(mBuckets[i]);
+    }
+    return android::base::StringPrintf("ios=%" PRIu64 " mean_ms=%.2f buckets=%s", mIos,
+                                       get_mean(), buckets.c_str());
+}
+
+/* disk_latency_monitor */
+void disk_latency_monitor::update_locked(const std::string& diskstats)
+{
+    for (const auto& line : android::base::Split(diskstats, "\n")) {
+        std::stringstream ss(line);
+        uint64_t major, minor;
+        std::string name;
+        uint64_t stats[8];  // the read and write fields of struct disk_stats
+        ss >> major >> minor >> name;
+        for (uint64_t& stat : stats) {
+            ss >> stat;
+        }
+        if (ss.fail()) continue;
+
+        // Loop devices only show the latency of what they are backed by.
+        if (android::base::StartsWith(name, "loop") || android::base::StartsWith(name, "ram")) {
+            continue;
+        }
+        if (mWholeDisksOnly && access(("/sys/block/" + name).c_str(), F_OK)) {
+            continue;
+        }
+
+        device_latency& dev = mDevices[name];
+        const uint64_t ios[LAT_TYPES] = { stats[0], stats[4] };
+        const uint64_t ticks[LAT_TYPES] = { stats[3], stats[7] };
+        for (int type = 0; type < LAT_TYPES; ++type) {
+            // Counters going backwards mean the device was recreated.
+            if (dev.valid && ios[type] >= dev.ios[type] && ticks[type] >= dev.ticks[type]) {
+                dev.period[type].add(ios[type] - dev.ios[type], ticks[type] - dev.ticks[type]);
+            }
+            dev.ios[type] = ios[type];
+            dev.ticks[type] = ticks[type];
+        }
+        dev.valid = true;
+    }
+}
+
+void disk_latency_monitor::update(void)
+{
+    std::string buffer;
+    if (!android::base::ReadFileToString(PROC_DISK_STATS_PATH, &buffer)) {
+        PLOG_TO(SYSTEM, ERROR) << PROC_DISK_STATS_PATH << ": ReadFileToString failed.";
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(mLock);
+    update_locked(buffer);
+}
+
+void disk_latency_monitor::publish(void)
+{
+    static const char* const type_names[LAT_TYPES] = { "read", "write" };
+
+    std::lock_guard<std::mutex> lock(mLock);
+    for (auto& it : mDevices) {
+        device_latency& dev = it.second;
+        for (int type = 0; type < LAT_TYPES; ++type) {
+            latency_histogram& period = dev.period[type];
+            latency_histogram& history = dev.history[type];
+            if (period.ios() >= mMinIos && history.ios() >= mMinIos) {
+                bool regressed = period.get_mean() > mFactor * history.get_mean();
+                if (regressed && !dev.regressed[type]) {
+                    LOG_TO(SYSTEM, WARNING) << it.first << " " << type_names[type]
+                        << " latency regressed: mean " << period.get_mean()
+                        << " ms, was " << history.get_mean() << " ms";
+                }
+                dev.regressed[type] = regressed;
+            }
+            history.add(period);
+            period.reset();
+        }
+    }
+}
+
+std::string disk_latency_monitor::dump(void)
+{
+    static const char* const type_names[LAT_TYPES] = { "read", "write" };
+
+    std::lock_guard<std::mutex> lock(mLock);
+    std::string out;
+    for (const auto& it : mDevices) {
+        const device_latency& dev = it.second;
+        for (int type = 0; type < LAT_TYPES; ++type) {
+            if (dev.period[type].ios() == 0 && dev.history[type].ios() == 0) continue;
+            out += android::base::StringPrintf(
+                "%s %s regressed=%d period: %s history: %s\n", it.first.c_str(),
+                type_names[type], dev.regressed[type], dev.period[type].to_string().c_str(),
+                dev.history[type].to_string().c_str());
+        }
+    }
+    return out;
+}
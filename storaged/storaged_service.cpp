@@ -107,6 +107,7 @@ status_t StoragedService::dump(int fd, const Vector<String16>& args) {
     uint64_t threshold = 0;
     bool force_report = false;
     bool debug = false;
+    bool latency = false;
     for (size_t i = 0; i < args.size(); i++) {
         const auto& arg = args[i];
         if (arg == String16("--hours")) {
@@ -138,6 +139,15 @@ status_t StoragedService::dump(int fd, const Vector<String16>& args) {
             debug = true;
             continue;
         }
+        if (arg == String16("--latency")) {
+            latency = true;
+            continue;
+        }
+    }
+
+    if (latency) {
+        dprintf(fd, "%s", storaged_sp->get_disk_latency().c_str());
+        return OK;
     }
 
     uint64_t last_ts = 0;
@@ -16,7 +16,9 @@
 
 #define LOG_TAG "storaged"
 
+#include <ctype.h>
 #include <stdint.h>
+#include <string.h>
 #include <time.h>
 
 #include <string>
@@ -52,55 +54,101 @@ const char* UID_IO_STATS_PATH = "/proc/uid_io/stats";
 std::unordered_map<uint32_t, uid_info> uid_monitor::get_uid_io_stats()
 {
     Mutex::Autolock _l(uidm_mutex_);
-    return get_uid_io_stats_locked();
+    std::unordered_map<uint32_t, uid_info> uid_io_stats;
+    read_uid_io_stats_locked(&uid_io_stats);
+    return uid_io_stats;
 };
 
+namespace {
+
+/*
+ * Parses |count| unsigned decimal fields separated by |sep| from *p, without
+ * any allocation, and advances *p past them. Anything after the last field
+ * is left alone.
+ */
+bool scan_uint_fields(const char** p, const char* end, char sep,
+                      uint64_t* fields, size_t count)
+{
+    const char* c = *p;
+    for (size_t i = 0; i < count; i++) {
+        if (i > 0 && (c == end || *c++ != sep)) {
+            return false;
+        }
+        if (c == end || !isdigit(*c)) {
+            return false;
+        }
+        uint64_t val = 0;
+        for (; c != end && isdigit(*c); c++) {
+            uint64_t digit = *c - '0';
+            if (val > (UINT64_MAX - digit) / 10) {
+                return false;
+            }
+            val = val * 10 + digit;
+        }
+        fields[i] = val;
+    }
+    *p = c;
+    return true;
+}
+
+/* the 10 counters at the end of both uid and task lines */
+void set_io_stats(io_stats* io, const uint64_t* fields)
+{
+    io[FOREGROUND].rchar = fields[0];
+    io[FOREGROUND].wchar = fields[1];
+    io[FOREGROUND].read_bytes = fields[2];
+    io[FOREGROUND].write_bytes = fields[3];
+    io[BACKGROUND].rchar = fields[4];
+    io[BACKGROUND].wchar = fields[5];
+    io[BACKGROUND].read_bytes = fields[6];
+    io[BACKGROUND].write_bytes = fields[7];
+    io[FOREGROUND].fsync = fields[8];
+    io[BACKGROUND].fsync = fields[9];
+}
+
+} // namespace
+
 /* return true on parse success and false on failure */
-bool uid_info::parse_uid_io_stats(std::string&& s)
+bool uid_info::parse_uid_io_stats(const char* s, const char* end)
 {
-    std::vector<std::string> fields = Split(s, " ");
-    if (fields.size() < 11 ||
-        !ParseUint(fields[0],  &uid) ||
-        !ParseUint(fields[1],  &io[FOREGROUND].rchar) ||
-        !ParseUint(fields[2],  &io[FOREGROUND].wchar) ||
-        !ParseUint(fields[3],  &io[FOREGROUND].read_bytes) ||
-        !ParseUint(fields[4],  &io[FOREGROUND].write_bytes) ||
-        !ParseUint(fields[5],  &io[BACKGROUND].rchar) ||
-        !ParseUint(fields[6],  &io[BACKGROUND].wchar) ||
-        !ParseUint(fields[7],  &io[BACKGROUND].read_bytes) ||
-        !ParseUint(fields[8],  &io[BACKGROUND].write_bytes) ||
-        !ParseUint(fields[9],  &io[FOREGROUND].fsync) ||
-        !ParseUint(fields[10], &io[BACKGROUND].fsync)) {
+    uint64_t fields[11];
+    const char* p = s;
+    if (!scan_uint_fields(&p, end, ' ', fields, 11) ||
+        (p != end && *p != ' ') || fields[0] > UINT32_MAX) {
         LOG_TO(SYSTEM, WARNING) << "Invalid uid I/O stats: \""
-                                << s << "\"";
+                                << std::string(s, end) << "\"";
         return false;
     }
+    uid = fields[0];
+    set_io_stats(io, fields + 1);
     return true;
 }
 
 /* return true on parse success and false on failure */
-bool task_info::parse_task_io_stats(std::string&& s)
+bool task_info::parse_task_io_stats(const char* s, const char* end)
 {
-    std::vector<std::string> fields = Split(s, ",");
-    size_t size = fields.size();
-    if (size < 13 ||
-        !ParseInt(fields[size - 11],  &pid) ||
-        !ParseUint(fields[size - 10],  &io[FOREGROUND].rchar) ||
-        !ParseUint(fields[size - 9],  &io[FOREGROUND].wchar) ||
-        !ParseUint(fields[size - 8],  &io[FOREGROUND].read_bytes) ||
-        !ParseUint(fields[size - 7],  &io[FOREGROUND].write_bytes) ||
-        !ParseUint(fields[size - 6],  &io[BACKGROUND].rchar) ||
-        !ParseUint(fields[size - 5],  &io[BACKGROUND].wchar) ||
-        !ParseUint(fields[size - 4],  &io[BACKGROUND].read_bytes) ||
-        !ParseUint(fields[size - 3], &io[BACKGROUND].write_bytes) ||
-        !ParseUint(fields[size - 2], &io[FOREGROUND].fsync) ||
-        !ParseUint(fields[size - 1], &io[BACKGROUND].fsync)) {
+    // "task,<comm>,<pid>,<10 counters>", where comm may contain commas, so
+    // the numeric fields are found from the end of the line.
+    static constexpr char kPrefix[] = "task,";
+    const char* comm_start = s + strlen(kPrefix);
+    const char* comm_end = end;
+    for (int i = 0; i < 11 && comm_end != nullptr; i++) {
+        comm_end = static_cast<const char*>(memrchr(s, ',', comm_end - s));
+    }
+
+    uint64_t fields[11];
+    const char* p = comm_end ? comm_end + 1 : end;
+    if (comm_end == nullptr || comm_end < comm_start ||
+        strncmp(s, kPrefix, strlen(kPrefix)) ||
+        !scan_uint_fields(&p, end, ',', fields, 11) || p != end ||
+        fields[0] > INT32_MAX) {
         LOG_TO(SYSTEM, WARNING) << "Invalid task I/O stats: \""
-                                << s << "\"";
+                                << std::string(s, end) << "\"";
         return false;
     }
-    comm = Join(std::vector<std::string>(
-                fields.begin() + 1, fields.end() - 11), ',');
+    pid = fields[0];
+    set_io_stats(io, fields + 1);
+    comm.assign(comm_start, comm_end);
     return true;
 }
 
@@ -153,42 +201,70 @@ void get_uid_names(const vector<int>& uids, const vector<std::string*>& uid_name
 
 } // namespace
 
-std::unordered_map<uint32_t, uid_info> uid_monitor::get_uid_io_stats_locked()
+bool uid_monitor::read_uid_io_stats_locked(
+    std::unordered_map<uint32_t, uid_info>* uid_io_stats)
 {
-    std::unordered_map<uint32_t, uid_info> uid_io_stats;
-    std::string buffer;
-    if (!ReadFileToString(UID_IO_STATS_PATH, &buffer)) {
+    if (!ReadFileToString(UID_IO_STATS_PATH, &uid_io_buffer_)) {
         PLOG_TO(SYSTEM, ERROR) << UID_IO_STATS_PATH << ": ReadFileToString failed";
-        return uid_io_stats;
+        uid_io_stats->clear();
+        return false;
     }
 
-    std::vector<std::string> io_stats = Split(std::move(buffer), "\n");
+    for (auto& it : *uid_io_stats) {
+        it.second.seen = false;
+    }
+
+    // Entries of uids seen in an earlier read are updated in place, so a
+    // steady state read only allocates for new uids and tasks.
     uid_info u;
+    uid_info* curr = nullptr;
+    task_info t;
     vector<int> uids;
     vector<std::string*> uid_names;
 
-    for (uint32_t i = 0; i < io_stats.size(); i++) {
-        if (io_stats[i].empty()) {
+    const char* end = uid_io_buffer_.data() + uid_io_buffer_.size();
+    for (const char* line = uid_io_buffer_.data(); line < end;) {
+        const char* line_end = static_cast<const char*>(memchr(line, '\n', end - line));
+        if (line_end == nullptr) {
+            line_end = end;
+        }
+        const char* next = line_end + 1;
+        if (line == line_end) {
+            line = next;
             continue;
         }
 
-        if (io_stats[i].compare(0, 4, "task")) {
-            if (!u.parse_uid_io_stats(std::move(io_stats[i])))
+        if ((line_end - line) < 4 || strncmp(line, "task", 4)) {
+            curr = nullptr;
+            if (!u.parse_uid_io_stats(line, line_end)) {
+                line = next;
                 continue;
-            uid_io_stats[u.uid] = u;
-            uid_io_stats[u.uid].name = std::to_string(u.uid);
+            }
+            curr = &(*uid_io_stats)[u.uid];
+            curr->uid = u.uid;
+            memcpy(curr->io, u.io, sizeof(curr->io));
+            curr->tasks.clear();
+            curr->seen = true;
             uids.push_back(u.uid);
-            uid_names.push_back(&uid_io_stats[u.uid].name);
-            if (last_uid_io_stats_.find(u.uid) == last_uid_io_stats_.end()) {
+            uid_names.push_back(&curr->name);
+            auto last = last_uid_io_stats_.find(u.uid);
+            if (last == last_uid_io_stats_.end()) {
+                curr->name = std::to_string(u.uid);
                 refresh_uid_names = true;
             } else {
-                uid_io_stats[u.uid].name = last_uid_io_stats_[u.uid].name;
+                curr->name = last->second.name;
             }
+        } else if (curr != nullptr && t.parse_task_io_stats(line, line_end)) {
+            curr->tasks[t.pid] = t;
+        }
+        line = next;
+    }
+
+    for (auto it = uid_io_stats->begin(); it != uid_io_stats->end();) {
+        if (it->second.seen) {
+            ++it;
         } else {
-            task_info t;
-            if (!t.parse_task_io_stats(std::move(io_stats[i])))
-                continue;
-            uid_io_stats[u.uid].tasks[t.pid] = t;
+            it = uid_io_stats->erase(it);
         }
     }
 
@@ -196,7 +272,7 @@ std::unordered_map<uint32_t, uid_info> uid_monitor::get_uid_io_stats_locked()
         get_uid_names(uids, uid_names);
     }
 
-    return uid_io_stats;
+    return !uid_io_stats->empty();
 }
 
 namespace {
@@ -233,6 +309,7 @@ void uid_monitor::add_records_locked(uint64_t curr_ts)
                     record.ios.task_ios[p_task.first] = p_task.second;
             }
             new_records.entries.push_back(record);
+            changed_users_.insert(record.ios.user_id);
         }
     }
 
@@ -254,6 +331,9 @@ void uid_monitor::maybe_shrink_history_for_items(size_t nitems) {
     while (overflow > 0 && io_history_.size() > 0) {
         auto del_it = io_history_.begin();
         overflow -= del_it->second.entries.size();
+        for (const auto& rec : del_it->second.entries) {
+            changed_users_.insert(rec.ios.user_id);
+        }
         io_history_.erase(io_history_.begin());
     }
 }
@@ -305,29 +385,34 @@ std::map<uint64_t, struct uid_records> uid_monitor::dump(
 
 void uid_monitor::update_curr_io_stats_locked()
 {
-    std::unordered_map<uint32_t, uid_info> uid_io_stats =
-        get_uid_io_stats_locked();
-    if (uid_io_stats.empty()) {
+    if (!read_uid_io_stats_locked(&next_uid_io_stats_)) {
         return;
     }
 
-    for (const auto& it : uid_io_stats) {
+    static const uid_info empty_uid = {};
+    static const task_info empty_task = {};
+    for (const auto& it : next_uid_io_stats_) {
         const uid_info& uid = it.second;
-        if (curr_io_stats_.find(uid.name) == curr_io_stats_.end()) {
-            curr_io_stats_[uid.name] = {};
+        auto last_it = last_uid_io_stats_.find(uid.uid);
+        const uid_info& last =
+            last_it == last_uid_io_stats_.end() ? empty_uid : last_it->second;
+        // Task counters add up to the uid's, so a uid whose counters didn't
+        // move has nothing to report. Most uids are idle in most periods.
+        if (&last != &empty_uid && !memcmp(uid.io, last.io, sizeof(uid.io))) {
+            continue;
         }
 
         struct uid_io_usage& usage = curr_io_stats_[uid.name];
         usage.user_id = multiuser_get_user_id(uid.uid);
 
         int64_t fg_rd_delta = uid.io[FOREGROUND].read_bytes -
-            last_uid_io_stats_[uid.uid].io[FOREGROUND].read_bytes;
+            last.io[FOREGROUND].read_bytes;
         int64_t bg_rd_delta = uid.io[BACKGROUND].read_bytes -
-            last_uid_io_stats_[uid.uid].io[BACKGROUND].read_bytes;
+            last.io[BACKGROUND].read_bytes;
         int64_t fg_wr_delta = uid.io[FOREGROUND].write_bytes -
-            last_uid_io_stats_[uid.uid].io[FOREGROUND].write_bytes;
+            last.io[FOREGROUND].write_bytes;
         int64_t bg_wr_delta = uid.io[BACKGROUND].write_bytes -
-            last_uid_io_stats_[uid.uid].io[BACKGROUND].write_bytes;
+            last.io[BACKGROUND].write_bytes;
 
         usage.uid_ios.bytes[READ][FOREGROUND][charger_stat_] +=
             (fg_rd_delta < 0) ? 0 : fg_rd_delta;
@@ -342,14 +427,17 @@ void uid_monitor::update_curr_io_stats_locked()
             const task_info& task = task_it.second;
             const pid_t pid = task_it.first;
             const std::string& comm = task_it.second.comm;
+            auto last_task_it = last.tasks.find(pid);
+            const task_info& last_task =
+                last_task_it == last.tasks.end() ? empty_task : last_task_it->second;
             int64_t task_fg_rd_delta = task.io[FOREGROUND].read_bytes -
-                last_uid_io_stats_[uid.uid].tasks[pid].io[FOREGROUND].read_bytes;
+                last_task.io[FOREGROUND].read_bytes;
             int64_t task_bg_rd_delta = task.io[BACKGROUND].read_bytes -
-                last_uid_io_stats_[uid.uid].tasks[pid].io[BACKGROUND].read_bytes;
+                last_task.io[BACKGROUND].read_bytes;
             int64_t task_fg_wr_delta = task.io[FOREGROUND].write_bytes -
-                last_uid_io_stats_[uid.uid].tasks[pid].io[FOREGROUND].write_bytes;
+                last_task.io[FOREGROUND].write_bytes;
             int64_t task_bg_wr_delta = task.io[BACKGROUND].write_bytes -
-                last_uid_io_stats_[uid.uid].tasks[pid].io[BACKGROUND].write_bytes;
+                last_task.io[BACKGROUND].write_bytes;
 
             io_usage& task_usage = usage.task_ios[comm];
             task_usage.bytes[READ][FOREGROUND][charger_stat_] +=
@@ -363,7 +451,8 @@ void uid_monitor::update_curr_io_stats_locked()
         }
     }
 
-    last_uid_io_stats_ = uid_io_stats;
+    // The old dump is kept around to be refilled by the next read.
+    last_uid_io_stats_.swap(next_uid_io_stats_);
 }
 
 void uid_monitor::report(unordered_map<int, StoragedProto>* protos)
@@ -376,10 +465,27 @@ void uid_monitor::report(unordered_map<int, StoragedProto>* protos)
     add_records_locked(time(NULL));
 
     if (protos) {
-        update_uid_io_proto(protos);
+        update_protos_locked(protos);
     }
 }
 
+void uid_monitor::update_changed_protos(unordered_map<int, StoragedProto>* protos)
+{
+    if (!enabled()) return;
+
+    Mutex::Autolock _l(uidm_mutex_);
+
+    update_protos_locked(protos);
+}
+
+void uid_monitor::update_protos_locked(unordered_map<int, StoragedProto>* protos)
+{
+    // Users without new or dropped records keep the file they already have.
+    changed_users_.insert(USER_SYSTEM);
+    update_uid_io_proto(protos, &changed_users_);
+    changed_users_.clear();
+}
+
 namespace {
 
 void set_io_usage_proto(IOUsage* usage_proto, const io_usage& usage)
@@ -408,7 +514,8 @@ void get_io_usage_proto(io_usage* usage, const IOUsage& io_proto)
 
 } // namespace
 
-void uid_monitor::update_uid_io_proto(unordered_map<int, StoragedProto>* protos)
+void uid_monitor::update_uid_io_proto(unordered_map<int, StoragedProto>* protos,
+                                      const unordered_set<userid_t>* users)
 {
     for (const auto& item : io_history_) {
         const uint64_t& end_ts = item.first;
@@ -417,6 +524,9 @@ void uid_monitor::update_uid_io_proto(unordered_map<int, StoragedProto>* protos)
 
         for (const auto& entry : recs.entries) {
             userid_t user_id = entry.ios.user_id;
+            if (users && !users->count(user_id)) {
+                continue;
+            }
             UidIOItem* item_proto = user_items[user_id];
             if (item_proto == nullptr) {
                 item_proto = (*protos)[user_id].mutable_uid_io_usage()
@@ -452,6 +562,7 @@ void uid_monitor::clear_user_history(userid_t user_id)
 {
     Mutex::Autolock _l(uidm_mutex_);
 
+    changed_users_.erase(user_id);
     for (auto& item : io_history_) {
         vector<uid_record>* entries = &item.second.entries;
         entries->erase(
@@ -476,6 +587,8 @@ void uid_monitor::load_uid_io_proto(userid_t user_id, const UidIOUsage& uid_io_p
 
     Mutex::Autolock _l(uidm_mutex_);
 
+    // The file gets rewritten with the merged history.
+    changed_users_.insert(user_id);
     for (const auto& item_proto : uid_io_proto.uid_io_items()) {
         const UidIORecords& records_proto = item_proto.records();
         struct uid_records* recs = &io_history_[item_proto.end_ts()];
@@ -17,12 +17,14 @@
 #include <chrono>
 #include <deque>
 #include <fcntl.h>
+#include <inttypes.h>
 #include <random>
 #include <string.h>
 #include <stdio.h>
 #include <sys/stat.h>
 #include <unistd.h>
 
+#include <android-base/stringprintf.h>
 #include <gtest/gtest.h>
 
 #include <healthhalutils/HealthHalUtils.h>
@@ -357,6 +359,69 @@ TEST(storaged_test, disk_stats_monitor) {
     }
 }
 
+TEST(storaged_test, latency_histogram) {
+    latency_histogram hist;
+    hist.add(10, 5);      // 0.5ms
+    hist.add(10, 30);     // 3ms
+    hist.add(1, 10000);   // 10s
+    hist.add(0, 100);     // nothing completed
+
+    EXPECT_EQ(21u, hist.ios());
+    EXPECT_EQ(10u, hist.bucket(0));
+    EXPECT_EQ(10u, hist.bucket(2));
+    EXPECT_EQ(1u, hist.bucket(latency_histogram::NUM_BUCKETS - 1));
+    EXPECT_DOUBLE_EQ(10035.0 / 21, hist.get_mean());
+
+    latency_histogram other;
+    other.add(hist);
+    EXPECT_EQ(hist.to_string(), other.to_string());
+    other.reset();
+    EXPECT_EQ(0u, other.ios());
+}
+
+TEST(storaged_test, disk_latency_monitor) {
+    // reads, read merges, read sectors, read ms, writes, write merges, write sectors, write ms
+    auto diskstats = [](uint64_t reads, uint64_t read_ms, uint64_t writes, uint64_t write_ms) {
+        return android::base::StringPrintf(
+            "   7       0 loop0 100 0 800 %" PRIu64 " 0 0 0 0 0 100 100\n"
+            "   8       0 sda %" PRIu64 " 0 0 %" PRIu64 " %" PRIu64 " 0 0 %" PRIu64 " 0 0 0\n",
+            read_ms, reads, read_ms, writes, write_ms);
+    };
+
+    disk_latency_monitor dlm(2.0, 100, false);
+    dlm.update_locked(diskstats(0, 0, 0, 0));
+    // 1ms reads and 2ms writes, for a while
+    for (int i = 1; i <= 10; ++i) {
+        dlm.update_locked(diskstats(i * 1000, i * 1000, i * 100, i * 200));
+        dlm.publish();
+    }
+    ASSERT_EQ(1u, dlm.mDevices.size());
+    auto& sda = dlm.mDevices["sda"];
+    EXPECT_EQ(10000u, sda.history[disk_latency_monitor::LAT_READ].ios());
+    EXPECT_EQ(10000u, sda.history[disk_latency_monitor::LAT_READ].bucket(1));
+    EXPECT_EQ(1000u, sda.history[disk_latency_monitor::LAT_WRITE].bucket(2));
+    EXPECT_FALSE(sda.regressed[disk_latency_monitor::LAT_READ]);
+    EXPECT_FALSE(sda.regressed[disk_latency_monitor::LAT_WRITE]);
+
+    // Reads slow down to 5ms, writes stay as they were
+    dlm.update_locked(diskstats(11000, 15000, 1100, 2200));
+    dlm.publish();
+    EXPECT_TRUE(sda.regressed[disk_latency_monitor::LAT_READ]);
+    EXPECT_FALSE(sda.regressed[disk_latency_monitor::LAT_WRITE]);
+
+    // Too few I/Os to tell either way
+    dlm.update_locked(diskstats(11010, 15010, 1100, 2200));
+    dlm.publish();
+    EXPECT_TRUE(sda.regressed[disk_latency_monitor::LAT_READ]);
+
+    EXPECT_NE(std::string::npos, dlm.dump().find("sda read regressed=1"));
+    EXPECT_NE(std::string::npos, dlm.dump().find("sda write regressed=0"));
+
+    // Counters restarting are not taken for I/O
+    dlm.update_locked(diskstats(10, 10, 0, 0));
+    EXPECT_EQ(0u, sda.period[disk_latency_monitor::LAT_READ].ios());
+}
+
 TEST(storaged_test, storage_info_t) {
     storage_info_t si;
     time_point<steady_clock> tp;
@@ -441,6 +506,44 @@ TEST(storaged_test, storage_info_t_proto) {
     }
 }
 
+static bool parse_uid_line(uid_info* u, const std::string& line) {
+    return u->parse_uid_io_stats(line.data(), line.data() + line.size());
+}
+
+static bool parse_task_line(task_info* t, const std::string& line) {
+    return t->parse_task_io_stats(line.data(), line.data() + line.size());
+}
+
+TEST(storaged_test, parse_uid_io_stats) {
+    uid_info u;
+    ASSERT_TRUE(parse_uid_line(&u, "10001 1 2 3 4 5 6 7 8 9 10"));
+    EXPECT_EQ(u.uid, 10001U);
+    EXPECT_EQ(u.io[FOREGROUND].rchar, 1U);
+    EXPECT_EQ(u.io[FOREGROUND].write_bytes, 4U);
+    EXPECT_EQ(u.io[BACKGROUND].rchar, 5U);
+    EXPECT_EQ(u.io[BACKGROUND].write_bytes, 8U);
+    EXPECT_EQ(u.io[FOREGROUND].fsync, 9U);
+    EXPECT_EQ(u.io[BACKGROUND].fsync, 10U);
+
+    EXPECT_FALSE(parse_uid_line(&u, "10001 1 2 3 4 5 6 7 8 9"));
+    EXPECT_FALSE(parse_uid_line(&u, "10001 1 2 3 4 5 6 7 8 9 10x"));
+    EXPECT_FALSE(parse_uid_line(&u, "uid 1 2 3 4 5 6 7 8 9 10"));
+
+    task_info t;
+    // comm may contain commas
+    ASSERT_TRUE(parse_task_line(&t, "task,com.foo,bar,123,1,2,3,4,5,6,7,8,9,10"));
+    EXPECT_EQ(t.comm, "com.foo,bar");
+    EXPECT_EQ(t.pid, 123);
+    EXPECT_EQ(t.io[FOREGROUND].rchar, 1U);
+    EXPECT_EQ(t.io[BACKGROUND].fsync, 10U);
+    ASSERT_TRUE(parse_task_line(&t, "task,,124,1,2,3,4,5,6,7,8,9,10"));
+    EXPECT_EQ(t.comm, "");
+    EXPECT_EQ(t.pid, 124);
+
+    EXPECT_FALSE(parse_task_line(&t, "task,125,1,2,3,4,5,6,7,8,9,10"));
+    EXPECT_FALSE(parse_task_line(&t, "task,foo,125,1,2,3,4,5,6,7,8,9,"));
+}
+
 TEST(storaged_test, uid_monitor) {
     uid_monitor uidm;
     auto& io_history = uidm.io_history();
@@ -684,3 +787,47 @@ TEST(storaged_test, load_uid_io_proto) {
     uidm.load_uid_io_proto(0, user_0);
     ASSERT_LE(io_history.size(), size_t(uid_monitor::MAX_UID_RECORDS_SIZE));
 }
+
+TEST(storaged_test, update_changed_protos) {
+    uid_monitor uidm;
+    auto& io_history = uidm.io_history();
+
+    io_history[200] = {
+        .start_ts = 100,
+        .entries = {
+            { "app1", {
+                .user_id = 0,
+                .uid_ios.bytes[WRITE][FOREGROUND][CHARGER_ON] = 1000,
+              }
+            },
+            { "app1", {
+                .user_id = 1,
+                .uid_ios.bytes[READ][FOREGROUND][CHARGER_OFF] = 2000,
+              }
+            },
+        },
+    };
+
+    unordered_map<int, StoragedProto> protos;
+    uidm.update_uid_io_proto(&protos);
+    ASSERT_EQ(protos.size(), size_t(2));
+    UidIOUsage user_1 = protos[1].uid_io_usage();
+
+    // Nothing changed for user 1, so only the system user is written.
+    protos.clear();
+    uidm.update_changed_protos(&protos);
+    EXPECT_EQ(protos.size(), size_t(1));
+    EXPECT_EQ(protos.count(0), size_t(1));
+    EXPECT_EQ(protos[0].uid_io_usage().uid_io_items_size(), 1);
+
+    // Loading user 1's file marks it for rewriting, once.
+    uidm.load_uid_io_proto(1, user_1);
+    protos.clear();
+    uidm.update_changed_protos(&protos);
+    EXPECT_EQ(protos.size(), size_t(2));
+    EXPECT_EQ(protos[1].uid_io_usage().uid_io_items_size(), 1);
+
+    protos.clear();
+    uidm.update_changed_protos(&protos);
+    EXPECT_EQ(protos.size(), size_t(1));
+}
@@ -32,6 +32,9 @@
 
 static int tipc_fd = -1;
 
+/* result of the first failed command of the batch in progress */
+static uint32_t batch_result = STORAGE_NO_ERROR;
+
 int ipc_connect(const char *device, const char *port)
 {
     int rc;
@@ -100,6 +103,25 @@ int ipc_respond(struct storage_msg *msg, void *out, size_t out_size)
 
     assert(tipc_fd >=  0);
 
+    /*
+     * Commands with STORAGE_MSG_FLAG_BATCH set are not answered; the first
+     * command without it gets the first error of the whole batch, if any.
+     * Batched response payloads are dropped, so only commands without one
+     * are worth batching.
+     */
+    if (msg->flags & STORAGE_MSG_FLAG_BATCH) {
+        if (batch_result == STORAGE_NO_ERROR)
+            batch_result = msg->result;
+        return 0;
+    }
+    if (batch_result != STORAGE_NO_ERROR) {
+        if (msg->result == STORAGE_NO_ERROR) {
+            msg->result = batch_result;
+            out = NULL;
+        }
+        batch_result = STORAGE_NO_ERROR;
+    }
+
     msg->cmd |= STORAGE_RESP_BIT;
 
     rc = writev(tipc_fd, iovs, out ? 2 : 1);
@@ -83,9 +83,11 @@ static int lookup_fd(uint32_t handle, bool dirty)
     return handle;
 }
 
-static int remove_fd(uint32_t handle)
+static int remove_fd(uint32_t handle, bool *dirty)
 {
+    *dirty = true; /* untracked fds may be dirty */
     if (handle < FD_TBL_SIZE) {
+        *dirty = (fd_state[handle] == SS_DIRTY);
         fd_state[handle] = SS_UNUSED; /* set to uninstalled */
     }
     return handle;
@@ -307,16 +309,21 @@ int storage_file_close(struct storage_msg *msg,
         goto err_response;
     }
 
-    int fd = remove_fd(req->handle);
+    bool dirty;
+    int fd = remove_fd(req->handle, &dirty);
     ALOGV("%s: handle = %u: fd = %u\n", __func__, req->handle, fd);
 
-    int rc = fsync(fd);
-    if (rc < 0) {
-        rc = errno;
-        ALOGE("%s: fsync failed for fd=%u: %s\n",
-              __func__, fd, strerror(errno));
-        msg->result = translate_errno(rc);
-        goto err_response;
+    /* files that were only read, or already synced by a checkpoint, need no fsync */
+    int rc;
+    if (dirty) {
+        rc = fsync(fd);
+        if (rc < 0) {
+            rc = errno;
+            ALOGE("%s: fsync failed for fd=%u: %s\n",
+                  __func__, fd, strerror(errno));
+            msg->result = translate_errno(rc);
+            goto err_response;
+        }
     }
 
     rc = close(fd);
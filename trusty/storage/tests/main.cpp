@@ -16,6 +16,7 @@
 
 #include <assert.h>
 #include <stdint.h>
+#include <chrono>
 #include <gtest/gtest.h>
 
 #include <trusty/lib/storage.h>
@@ -2325,6 +2326,38 @@ TEST_P(StorageServiceTest, TransactCommitWriteMany) {
 }
 
 
+TEST_P(StorageServiceTest, TransactCommitWriteManyTimed) {
+    int rc;
+    file_handle_t handle;
+    size_t blk = 2048;
+    size_t exp_len = 256 * 1024;
+    const char *fname = "test_transact_commit_write_timed_file";
+
+    rc = storage_open_file(session_, &handle, fname,
+                           STORAGE_FILE_OPEN_CREATE | STORAGE_FILE_OPEN_TRUNCATE,
+                           STORAGE_OP_COMPLETE);
+    ASSERT_EQ(0, rc);
+
+    // many writes in a single transaction, which the proxy flushes once
+    auto start = std::chrono::steady_clock::now();
+    WritePattern(handle, 0, exp_len, blk, false);
+    ASSERT_FALSE(HasFatalFailure());
+
+    rc = storage_end_transaction(session_, true);
+    ASSERT_EQ(0, rc);
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    RecordProperty("commit_us",
+                   std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count());
+
+    ReadPatternEOF(handle, 0, blk, exp_len);
+    ASSERT_FALSE(HasFatalFailure());
+
+    // cleanup
+    storage_close_file(handle);
+    storage_delete_file(session_, fname, STORAGE_OP_COMPLETE);
+}
+
+
 TEST_P(StorageServiceTest, TransactCommitDeleteCreate) {
     int rc;
     file_handle_t handle;